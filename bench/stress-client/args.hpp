@@ -161,9 +161,11 @@ public:
         : clients(64), duration(10000000L, duration_t::queries_t), op_ratios(op_ratios_t()),
             keys(distr_t(8, 16)), values(distr_t(8, 128)),
             batch_factor(distr_t(1, 16)), range_size(distr_t(16, 128)),
-            distr(rnd_uniform_t), mu(1), pipeline_limit(0), ignore_protocol_errors(0)
+            distr(rnd_uniform_t), mu(1), pipeline_limit(0), ignore_protocol_errors(0), rate(0)
         {
             latency_file[0] = 0;
+            latency_histogram_file[0] = 0;
+            latency_timeline_file[0] = 0;
             worst_latency_file[0] = 0;
             qps_file[0] = 0;
             out_file[0] = 0;
@@ -202,6 +204,9 @@ public:
         // Adding one because users are 1-based, unlike our code for
         // pipelines, which is 0-based
         printf("Pipeline-limit....%d\n", pipeline_limit + 1);
+        if (rate > 0) {
+            printf("Rate..............%g ops/s (open loop)\n", rate);
+        }
         printf("\n");
     }
 
@@ -219,24 +224,29 @@ public:
     int mu;
     char latency_file[MAX_FILE];
     char worst_latency_file[MAX_FILE];
+    char latency_histogram_file[MAX_FILE];
+    char latency_timeline_file[MAX_FILE];
     char qps_file[MAX_FILE];
     char out_file[MAX_FILE];
     char in_file[MAX_FILE];
     char db_file[MAX_FILE];
     int pipeline_limit;
     int ignore_protocol_errors;
+    double rate;
 };
 
 /* List supported protocols. */
 void list_protocols() {
     // I'll just cheat here.
-    printf("rethinkdb");
     printf("sockmemcached,");
 #ifdef USE_MYSQL
     printf("mysql,");
 #endif
 #ifdef USE_LIBMEMCACHED
     printf("libmemcached,");
+#endif
+#ifdef USE_RETHINKDB
+    printf("rethinkdb,");
 #endif
     printf("sqlite");
 }
@@ -297,6 +307,12 @@ void usage(const char *name) {
            "\t\tThe information is not outputted if this argument is skipped.\n");
     printf("\t-L, --worst-latency-file\n\t\tFile name to output worst latency each second.\n" \
            "\t\tThe information is not outputted if this argument is skipped.\n");
+    printf("\t-H, --latency-histogram-file\n\t\tFile name to output the percentile distribution of every latency\n" \
+           "\t\tin the run (in us), in HdrHistogram's format.\n" \
+           "\t\tThe information is not outputted if this argument is skipped.\n");
+    printf("\t-T, --latency-timeline-file\n\t\tFile name to output each second's query count and 50th, 90th, 99th and\n" \
+           "\t\t99.9th percentile and worst latencies (in us).\n" \
+           "\t\tThe information is not outputted if this argument is skipped.\n");
     printf("\t-q, --qps-file\n\t\tFile name to output QPS information. '-' for stdout.\n" \
            "\t\tThe information is not outputted if this argument is skipped.\n");
     printf("\t-o, --out-file\n\t\tIf present, dump all inserted keys to this file.\n");
@@ -306,6 +322,9 @@ void usage(const char *name) {
     printf("\t-r, --distr\n\t\tA key access distrubution. Possible values: 'uniform' (default), and 'normal'.\n");
     printf("\t-m, --mu\n\t\tControl normal distribution. Percent of the database size within one standard\n\t\tdistribution (defaults to 1%%).\n");
     printf("\t-p, --pipeline\n\t\tMaximum number of operations that may be queued to server (defaults to 1).\n");
+    printf("\t-e, --rate\n\t\tRun open-loop: start this many operations per second in total, spread evenly\n" \
+           "\t\tover the clients, whether or not the server keeps up. Latencies are measured\n" \
+           "\t\tfrom when each operation should have started. Defaults to closed-loop clients.\n");
 
     printf("\nAdditional information:\n");
     printf("\t\tDISTR format describes a range and can be specified in as NUM or MIN-MAX.\n\n");
@@ -347,6 +366,8 @@ void parse(config_t *config, int argc, char *argv[]) {
                 {"range-size",         required_argument, 0, 'R'},
                 {"latency-file",       required_argument, 0, 'l'},
                 {"worst-latency-file", required_argument, 0, 'L'},
+                {"latency-histogram-file", required_argument, 0, 'H'},
+                {"latency-timeline-file", required_argument, 0, 'T'},
                 {"qps-file",           required_argument, 0, 'q'},
                 {"out-file",           required_argument, 0, 'o'},
                 {"in-file",            required_argument, 0, 'i'},
@@ -354,6 +375,7 @@ void parse(config_t *config, int argc, char *argv[]) {
                 {"distr",              required_argument, 0, 'r'},
                 {"mu",                 required_argument, 0, 'm'},
                 {"pipeline",           required_argument, 0, 'p'},
+                {"rate",               required_argument, 0, 'e'},
                 {"client-suffix",      no_argument, 0, 'a'},
                 {"ignore-protocol-errors", no_argument, &config->ignore_protocol_errors, 1},
                 {"help",               no_argument, &do_help, 1},
@@ -361,7 +383,7 @@ void parse(config_t *config, int argc, char *argv[]) {
             };
 
         int option_index = 0;
-        int c = getopt_long(argc, argv, "s:n:p:r:c:w:k:K:v:d:b:R:l:L:q:o:i:h:f:m:", long_options, &option_index);
+        int c = getopt_long(argc, argv, "s:n:p:r:c:w:k:K:v:d:b:R:l:L:H:T:q:o:i:h:f:m:e:", long_options, &option_index);
 
         if(do_help)
             c = 'h';
@@ -414,6 +436,12 @@ void parse(config_t *config, int argc, char *argv[]) {
         case 'L':
             strncpy(config->worst_latency_file, optarg, MAX_FILE);
             break;
+        case 'H':
+            strncpy(config->latency_histogram_file, optarg, MAX_FILE);
+            break;
+        case 'T':
+            strncpy(config->latency_timeline_file, optarg, MAX_FILE);
+            break;
         case 'q':
             strncpy(config->qps_file, optarg, MAX_FILE);
             break;
@@ -449,6 +477,13 @@ void parse(config_t *config, int argc, char *argv[]) {
             // the code is structured in a way where zero means no pipelining, so we subtract one
             config->pipeline_limit--;
             break;
+        case 'e':
+            config->rate = atof(optarg);
+            if (config->rate <= 0) {
+                fprintf(stderr, "The rate must be a positive number of operations per second.\n");
+                usage(argv[0]);
+            }
+            break;
         case 'h':
             usage(argv[0]);
             break;
@@ -13,10 +13,11 @@ using namespace std;
 /* Structure that represents a running client */
 struct client_t {
 
-    client_t(int _pipeline_limit = 0, int _ignore_protocol_errors = 0) :
+    client_t(int _pipeline_limit = 0, int _ignore_protocol_errors = 0, double _rate = 0) :
         total_freq(0),
         pipeline_limit(_pipeline_limit),
         ignore_protocol_errors(_ignore_protocol_errors),
+        rate(_rate),
         keep_running(false),
         print_further_protocol_errors(true)
         { }
@@ -65,6 +66,11 @@ struct client_t {
     int pipeline_limit;
     int ignore_protocol_errors;
 
+    /* If `rate` isn't zero, the client is open-loop: it starts `rate` ops a second on a
+    fixed schedule, rather than starting each op as soon as the last one is done, and
+    it catches up on the ops it missed when the server holds it up. */
+    double rate;
+
 private:
     // This spinlock protects keep_running from race conditions
     spinlock_t spinlock;
@@ -84,6 +90,8 @@ private:
 
         spinlock.lock();
         std::queue<op_t *> outstanding_ops;
+        ticks_t schedule_start = get_ticks();
+        uint64_t ops_scheduled = 0;
         while(keep_running) {
             spinlock.unlock();
 
@@ -104,6 +112,14 @@ private:
                 exit(-1);
             }
 
+            if (rate > 0) {
+                ticks_t scheduled_start = schedule_start + static_cast<ticks_t>(ops_scheduled * (secs_to_ticks(1) / rate));
+                ticks_t now = get_ticks();
+                if (now < scheduled_start) sleep_ticks(scheduled_start - now);
+                op_to_do->scheduled_start = scheduled_start;
+                ops_scheduled++;
+            }
+
             try {
                 op_to_do->start();
                 outstanding_ops.push(op_to_do);
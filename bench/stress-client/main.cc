@@ -53,6 +53,8 @@ int main(int argc, char *argv[])
     FILE *qps_fd = get_out_file(config.qps_file, "QPS");
     FILE *latencies_fd = get_out_file(config.latency_file, "latencies");
     FILE *worst_latencies_fd = get_out_file(config.worst_latency_file, "worst latencies");
+    FILE *latency_histogram_fd = get_out_file(config.latency_histogram_file, "the latency histogram");
+    FILE *latency_timeline_fd = get_out_file(config.latency_timeline_file, "the latency timeline");
 
     /* make a directory for our sqlite files */
     if (config.db_file[0]) {
@@ -143,7 +145,7 @@ int main(int argc, char *argv[])
             range_read_op_generator(config->pipeline_limit + 1, protocol, distr_t(50, 50), config->range_size, config->key_prefix),
 
             /* Construct the client object */
-            client(config->pipeline_limit, config->ignore_protocol_errors)
+            client(config->pipeline_limit, config->ignore_protocol_errors, config->rate / config->clients)
         {
             int expected_batch_factor = (config->batch_factor.min + config->batch_factor.max) / 2;
 
@@ -294,6 +296,18 @@ int main(int argc, char *argv[])
             fflush(worst_latencies_fd);
         }
 
+        if (latency_timeline_fd) {
+            const latency_histogram_t &h = round_stats.latency_histogram;
+            fprintf(latency_timeline_fd, "%d\t\t%llu\t%llu\t%llu\t%llu\t%llu\t%llu\n",
+                total_time, (unsigned long long)h.total,
+                (unsigned long long)h.value_at_percentile(50),
+                (unsigned long long)h.value_at_percentile(90),
+                (unsigned long long)h.value_at_percentile(99),
+                (unsigned long long)h.value_at_percentile(99.9),
+                (unsigned long long)h.max_us);
+            fflush(latency_timeline_fd);
+        }
+
         /* Update the aggregate total stats, and check if we are done running */
         total_stats.aggregate(round_stats);
         total_inserts_minus_deletes += round_inserts_minus_deletes;
@@ -335,6 +349,11 @@ int main(int argc, char *argv[])
     printf("Total operations: %d\n", total_stats.queries);
     printf("Total keys inserted minus keys deleted: %d\n", total_inserts_minus_deletes);
 
+    if (latency_histogram_fd) {
+        total_stats.latency_histogram.write_percentile_distribution(latency_histogram_fd);
+        fflush(latency_histogram_fd);
+    }
+
     // Dump key vectors if we have an out file
     if(config.out_file[0] != 0) {
         FILE *out_file = fopen(config.out_file, "w");
@@ -359,6 +378,8 @@ int main(int argc, char *argv[])
     if (qps_fd && qps_fd != stdout) fclose(qps_fd);
     if (latencies_fd && latencies_fd != stdout) fclose(latencies_fd);
     if (worst_latencies_fd && worst_latencies_fd != stdout) fclose(worst_latencies_fd);
+    if (latency_histogram_fd && latency_histogram_fd != stdout) fclose(latency_histogram_fd);
+    if (latency_timeline_fd && latency_timeline_fd != stdout) fclose(latency_timeline_fd);
 
     return 0;
 }
@@ -12,6 +12,9 @@ struct query_stats_t {
     bool enable_latency_samples;
     reservoir_sample_t<ticks_t> latency_samples;
 
+    // Unlike the samples, the histogram counts every query.
+    latency_histogram_t latency_histogram;
+
 
     query_stats_t() : queries(0), worst_latency(0), enable_latency_samples(true) { }
 
@@ -20,12 +23,14 @@ struct query_stats_t {
         worst_latency = 0;
 
         latency_samples.clear();
+        latency_histogram.clear();
     }
 
     void push(ticks_t latency, int batch_count) {
         lock.lock();
         queries += batch_count;
         worst_latency = std::max(worst_latency, latency);
+        latency_histogram.record(latency, batch_count);
         if (enable_latency_samples) {
             for (int i = 0; i < batch_count; i++) latency_samples.push(latency);
         }
@@ -36,6 +41,7 @@ struct query_stats_t {
         queries += other.queries;
         worst_latency = std::max(worst_latency, other.worst_latency);
         latency_samples += other.latency_samples;
+        latency_histogram += other.latency_histogram;
     }
 
     void set_enable_latency_samples(bool val) {
@@ -50,15 +56,23 @@ public:
 
 struct op_t {
 
-    op_t(query_stats_t *_stats) : stats(_stats) { }
+    op_t(query_stats_t *_stats) : stats(_stats), scheduled_start(0) { }
     virtual ~op_t() { }
 
     void push_stats(float latency, int count) {
+        /* An open-loop client counts the time the op spent waiting for its turn
+        too; otherwise a server stall would only show up as one slow op, however many
+        ops it held back. */
+        if (scheduled_start) latency = get_ticks() - scheduled_start;
         stats->push(latency, count);
     }
 
     query_stats_t *stats;
 
+    /* When the client runs at a fixed rate, the time the op was supposed to start at,
+    which latencies are measured from. Zero for a closed-loop client. */
+    ticks_t scheduled_start;
+
     virtual void start() = 0;
 
     virtual bool end_maybe() = 0;
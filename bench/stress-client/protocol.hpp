@@ -64,6 +64,9 @@ enum protocol_enum_t {
 #endif
 #ifdef USE_LIBMEMCACHED
     protocol_libmemcached,
+#endif
+#ifdef USE_RETHINKDB
+    protocol_rethinkdb,
 #endif
     protocol_sqlite,
 };
@@ -83,6 +86,10 @@ struct server_t {
 #ifdef USE_LIBMEMCACHED
         } else if (strcmp(name, "libmemcached") == 0) {
             return protocol_libmemcached;
+#endif
+#ifdef USE_RETHINKDB
+        } else if (strcmp(name, "rethinkdb") == 0) {
+            return protocol_rethinkdb;
 #endif
         } else if(strcmp(name, "sqlite") == 0) {
             return protocol_sqlite;
@@ -117,6 +124,10 @@ struct server_t {
 #ifdef USE_LIBMEMCACHED
         } else if (protocol == protocol_libmemcached) {
             printf("libmemcached");
+#endif
+#ifdef USE_RETHINKDB
+        } else if (protocol == protocol_rethinkdb) {
+            printf("rethinkdb");
 #endif
         } else if (protocol == protocol_sqlite) {
             printf("sqlite");
@@ -0,0 +1,439 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef USE_RETHINKDB
+#error "This file shouldn't be included if USE_RETHINKDB is not set."
+#endif
+
+#ifndef __STRESS_CLIENT_PROTOCOLS_RETHINKDB_PROTOCOL_HPP__
+#define __STRESS_CLIENT_PROTOCOLS_RETHINKDB_PROTOCOL_HPP__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "protocol.hpp"
+#include "ql2.pb.h"
+
+#define RETHINKDB_CONN_STR_MESSAGE ("The connection string for RethinkDB should be of the form " \
+    "\"host:port\", \"host:port+database+table\" or \"host:port+database+table+" \
+    "insert_batch[+sindex]\".")
+
+/* rethinkdb_protocol_t speaks ReQL to the server's client driver port, sending the same
+serialized `Query` protobufs that the drivers do.  Each key is a document whose primary
+key `id` is the key and whose `val` field is the value; the table has to exist already.
+
+Inserts are sent `insert_batch` at a time, as a single INSERT of an array.  Any other
+operation sends the inserts that are still waiting first, so the operations the client
+does see each other in order.  Reads of more than one key use GET_ALL, through the
+secondary index `sindex` if one is given (it should be defined on `id`, for example with
+`index_create('sindex', r.row('id'))`), and range reads use BETWEEN with a LIMIT. */
+
+struct rethinkdb_protocol_t : public protocol_t {
+
+    static bool parse_conn_str(char *conn_str, const char **host, int *port,
+            const char **database, const char **table, int *insert_batch,
+            const char **sindex) {
+
+        *database = "test";
+        *table = "stress";
+        *insert_batch = 1;
+        *sindex = NULL;
+
+        *host = conn_str;
+        conn_str = strstr(conn_str, ":");
+        if (!conn_str) return false;
+        *conn_str++ = '\0';
+
+        const char *port_str = conn_str;
+        conn_str = strstr(conn_str, "+");
+        if (conn_str) *conn_str++ = '\0';
+        *port = atoi(port_str);
+        if (*port == 0) return false;
+        if (!conn_str) return true;
+
+        *database = conn_str;
+        conn_str = strstr(conn_str, "+");
+        if (!conn_str) return false;
+        *conn_str++ = '\0';
+
+        *table = conn_str;
+        conn_str = strstr(conn_str, "+");
+        if (!conn_str) return true;
+        *conn_str++ = '\0';
+
+        const char *batch_str = conn_str;
+        conn_str = strstr(conn_str, "+");
+        if (conn_str) *conn_str++ = '\0';
+        *insert_batch = atoi(batch_str);
+        if (*insert_batch <= 0) return false;
+        if (!conn_str) return true;
+
+        *sindex = conn_str;
+        return strstr(conn_str, "+") == NULL && **sindex != '\0';
+    }
+
+    rethinkdb_protocol_t(const char *conn_str) : sockfd(-1), next_token(1) {
+
+        // Parse the host string
+        char buffer[512];
+        strncpy(buffer, conn_str, sizeof(buffer));
+        buffer[sizeof(buffer) - 1] = '\0';
+        const char *_host, *dbname, *tablename, *_sindex;
+        int port;
+        if (!parse_conn_str(buffer, &_host, &port, &dbname, &tablename, &insert_batch,
+                &_sindex)) {
+            fprintf(stderr, "%s Your input was \"%s\".\n", RETHINKDB_CONN_STR_MESSAGE, conn_str);
+            exit(-1);
+        }
+        database = dbname;
+        table = tablename;
+        if (_sindex) sindex = _sindex;
+
+        // init the socket
+        sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (sockfd < 0) {
+            fprintf(stderr, "Could not create socket\n");
+            exit(-1);
+        }
+
+        // Setup the host/port data structures
+        struct sockaddr_in sin;
+        struct hostent *host = gethostbyname(_host);
+        if (!host) {
+            herror("Could not gethostbyname()");
+            exit(-1);
+        }
+        memcpy(&sin.sin_addr.s_addr, host->h_addr, host->h_length);
+        sin.sin_family = AF_INET;
+        sin.sin_port = htons(port);
+
+        // Connect to server
+        int res = ::connect(sockfd, (struct sockaddr *)&sin, sizeof(sin));
+        if (res < 0) {
+            int err = errno;
+            fprintf(stderr, "Could not connect to server (%d)\n", err);
+            exit(-1);
+        }
+
+        // Say hello with an empty authorization key
+        int32_t magic = VersionDummy::V0_2;
+        uint32_t auth_key_length = 0;
+        send_all(&magic, sizeof(magic));
+        send_all(&auth_key_length, sizeof(auth_key_length));
+
+        std::string reply;
+        for (;;) {
+            char c;
+            recv_all(&c, 1);
+            if (c == '\0') break;
+            reply += c;
+        }
+        if (reply != "SUCCESS") {
+            fprintf(stderr, "Could not connect to server: %s\n", reply.c_str());
+            exit(-1);
+        }
+    }
+
+    virtual ~rethinkdb_protocol_t() {
+        if (sockfd != -1) {
+            try {
+                flush_inserts();
+            } catch (const protocol_error_t &e) {
+                fprintf(stderr, "Could not insert the last keys: %s\n", e.c_str());
+            }
+            int res = close(sockfd);
+            if (res != 0) {
+                fprintf(stderr, "Could not close socket\n");
+                exit(-1);
+            }
+        }
+    }
+
+    virtual void remove(const char *key, size_t key_size) {
+        flush_inserts();
+
+        Query query;
+        Term *del = start_query(&query, Term::DELETE);
+        make_get(del->mutable_args(0), key, key_size);
+        run(&query);
+    }
+
+    virtual void update(const char *key, size_t key_size,
+                        const char *value, size_t value_size)
+    {
+        flush_inserts();
+
+        Query query;
+        Term *update = start_query(&query, Term::UPDATE);
+        make_get(update->mutable_args(0), key, key_size);
+        Term *obj = update->add_args();
+        obj->set_type(Term::MAKE_OBJ);
+        make_string(add_optarg(obj, "val"), value, value_size);
+        run(&query);
+    }
+
+    virtual void insert(const char *key, size_t key_size,
+                        const char *value, size_t value_size)
+    {
+        pending_inserts.push_back(std::make_pair(std::string(key, key_size),
+                                                 std::string(value, value_size)));
+        if (static_cast<int>(pending_inserts.size()) >= insert_batch) {
+            flush_inserts();
+        }
+    }
+
+    virtual void read(payload_t *keys, int count, UNUSED payload_t *values = NULL) {
+        flush_inserts();
+
+        Query query;
+        if (count == 1 && sindex.empty()) {
+            Term *get = start_query(&query, Term::GET);
+            make_table(get->mutable_args(0));
+            make_string(get->add_args(), keys[0].first, keys[0].second);
+        } else {
+            Term *get_all = start_query(&query, Term::GET_ALL);
+            make_table(get_all->mutable_args(0));
+            for (int i = 0; i < count; i++) {
+                make_string(get_all->add_args(), keys[i].first, keys[i].second);
+            }
+            if (!sindex.empty()) {
+                make_string(add_optarg(get_all, "index"), sindex.data(), sindex.size());
+            }
+        }
+        run(&query);
+    }
+
+    virtual void range_read(char* lkey, size_t lkey_size, char* rkey, size_t rkey_size, int count_limit, UNUSED payload_t *values = NULL) {
+        flush_inserts();
+
+        Query query;
+        Term *limit = start_query(&query, Term::LIMIT);
+        Term *between = limit->mutable_args(0);
+        between->set_type(Term::BETWEEN);
+        make_table(between->add_args());
+        make_string(between->add_args(), lkey, lkey_size);
+        make_string(between->add_args(), rkey, rkey_size);
+        make_string(add_optarg(between, "right_bound"), "closed", strlen("closed"));
+        make_number(limit->add_args(), count_limit);
+        run(&query);
+    }
+
+    virtual void append(const char *key, size_t key_size,
+                        const char *value, size_t value_size)
+    {
+        concat(key, key_size, value, value_size, true);
+    }
+
+    virtual void prepend(const char *key, size_t key_size,
+                          const char *value, size_t value_size)
+    {
+        concat(key, key_size, value, value_size, false);
+    }
+
+private:
+    // The terms are built up in place, so `start_query()` returns the outermost term
+    // with an empty first argument for the caller to fill in.
+    Term *start_query(Query *query, Term::TermType type) {
+        query->set_type(Query::START);
+        query->set_token(next_token++);
+        Term *term = query->mutable_query();
+        term->set_type(type);
+        term->add_args();
+        return term;
+    }
+
+    void make_table(Term *term) {
+        term->set_type(Term::TABLE);
+        Term *db = term->add_args();
+        db->set_type(Term::DB);
+        make_string(db->add_args(), database.data(), database.size());
+        make_string(term->add_args(), table.data(), table.size());
+    }
+
+    void make_get(Term *term, const char *key, size_t key_size) {
+        term->set_type(Term::GET);
+        make_table(term->add_args());
+        make_string(term->add_args(), key, key_size);
+    }
+
+    static Term *add_optarg(Term *term, const char *name) {
+        Term::AssocPair *pair = term->add_optargs();
+        pair->set_key(name);
+        return pair->mutable_val();
+    }
+
+    static void make_string(Term *term, const char *str, size_t size) {
+        term->set_type(Term::DATUM);
+        Datum *datum = term->mutable_datum();
+        datum->set_type(Datum::R_STR);
+        datum->set_r_str(str, size);
+    }
+
+    static void make_number(Term *term, double num) {
+        term->set_type(Term::DATUM);
+        Datum *datum = term->mutable_datum();
+        datum->set_type(Datum::R_NUM);
+        datum->set_r_num(num);
+    }
+
+    /* Sends every insert that's waiting as one INSERT. */
+    void flush_inserts() {
+        if (pending_inserts.empty()) return;
+
+        Query query;
+        Term *insert = start_query(&query, Term::INSERT);
+        make_table(insert->mutable_args(0));
+        Term *docs = insert->add_args();
+        docs->set_type(Term::MAKE_ARRAY);
+        for (size_t i = 0; i < pending_inserts.size(); i++) {
+            Term *doc = docs->add_args();
+            doc->set_type(Term::MAKE_OBJ);
+            make_string(add_optarg(doc, "id"),
+                        pending_inserts[i].first.data(), pending_inserts[i].first.size());
+            make_string(add_optarg(doc, "val"),
+                        pending_inserts[i].second.data(), pending_inserts[i].second.size());
+        }
+        pending_inserts.clear();
+        run(&query);
+    }
+
+    /* Appends or prepends `value` to the key's value on the server, with
+    `get(key).update(function(x) { return {val: x('val') + value}; })`. */
+    void concat(const char *key, size_t key_size, const char *value, size_t value_size,
+                bool append) {
+        flush_inserts();
+
+        Query query;
+        Term *update = start_query(&query, Term::UPDATE);
+        make_get(update->mutable_args(0), key, key_size);
+
+        Term *func = update->add_args();
+        func->set_type(Term::FUNC);
+        Term *params = func->add_args();
+        params->set_type(Term::MAKE_ARRAY);
+        make_number(params->add_args(), 1);
+
+        Term *obj = func->add_args();
+        obj->set_type(Term::MAKE_OBJ);
+        Term *add = add_optarg(obj, "val");
+        add->set_type(Term::ADD);
+        Term *old_value = append ? add->add_args() : NULL;
+        make_string(add->add_args(), value, value_size);
+        if (!old_value) old_value = add->add_args();
+        old_value->set_type(Term::GET_FIELD);
+        Term *var = old_value->add_args();
+        var->set_type(Term::VAR);
+        make_number(var->add_args(), 1);
+        make_string(old_value->add_args(), "val", strlen("val"));
+
+        run(&query);
+    }
+
+    /* Sends the query and waits for its whole result, continuing it if the server only
+    sends part of a sequence at first. */
+    void run(Query *query) {
+        for (;;) {
+            send_query(*query);
+            Response response;
+            recv_response(&response);
+            if (response.token() != query->token()) {
+                throw protocol_error_t("Response for the wrong query");
+            }
+
+            switch (response.type()) {
+            case Response::SUCCESS_ATOM:
+            case Response::SUCCESS_SEQUENCE:
+                return;
+            case Response::SUCCESS_PARTIAL: {
+                int64_t token = query->token();
+                query->Clear();
+                query->set_type(Query::CONTINUE);
+                query->set_token(token);
+            } break;
+            default: {
+                std::string message = "Query failed";
+                if (response.response_size() > 0
+                    && response.response(0).type() == Datum::R_STR) {
+                    message += ": " + response.response(0).r_str();
+                }
+                throw protocol_error_t(message);
+            }
+            }
+        }
+    }
+
+    void send_query(const Query &query) {
+        std::string data;
+        if (!query.SerializeToString(&data)) {
+            fprintf(stderr, "Could not serialize query\n");
+            exit(-1);
+        }
+        int32_t size = data.size();
+        send_buffer.resize(sizeof(size) + data.size());
+        memcpy(send_buffer.data(), &size, sizeof(size));
+        memcpy(send_buffer.data() + sizeof(size), data.data(), data.size());
+        send_all(send_buffer.data(), send_buffer.size());
+    }
+
+    void recv_response(Response *response) {
+        int32_t size;
+        recv_all(&size, sizeof(size));
+        if (size < 0) {
+            fprintf(stderr, "Server sent a negative response size (%d)\n", size);
+            exit(-1);
+        }
+        recv_buffer.resize(size);
+        recv_all(recv_buffer.data(), size);
+        if (!response->ParseFromArray(recv_buffer.data(), size)) {
+            fprintf(stderr, "Could not parse response\n");
+            exit(-1);
+        }
+    }
+
+    void send_all(const void *data, size_t size) {
+        const char *p = static_cast<const char *>(data);
+        while (size > 0) {
+            ssize_t res = send(sockfd, p, size, 0);
+            if (res < 0 && errno == EINTR) continue;
+            if (res <= 0) {
+                perror("Unable to write to socket");
+                exit(-1);
+            }
+            p += res;
+            size -= res;
+        }
+    }
+
+    void recv_all(void *data, size_t size) {
+        char *p = static_cast<char *>(data);
+        while (size > 0) {
+            ssize_t res = recv(sockfd, p, size, 0);
+            if (res < 0 && errno == EINTR) continue;
+            if (res == 0) {
+                fprintf(stderr, "rethinkdb_protocol: error: server closed the connection\n");
+                exit(-1);
+            } else if (res < 0) {
+                perror("Unable to read from socket");
+                exit(-1);
+            }
+            p += res;
+            size -= res;
+        }
+    }
+
+    int sockfd;
+    int64_t next_token;
+
+    std::string database, table, sindex;
+    int insert_batch;
+    std::vector<std::pair<std::string, std::string> > pending_inserts;
+
+    std::vector<char> send_buffer, recv_buffer;
+};
+
+#endif // __STRESS_CLIENT_PROTOCOLS_RETHINKDB_PROTOCOL_HPP__
@@ -3,6 +3,7 @@
 #include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <math.h>
 #include "utils.hpp"
 
 #if __MACH__
@@ -95,3 +96,31 @@ int count_decimal_digits(int n) {
     }
     return digits;
 }
+
+void latency_histogram_t::write_percentile_distribution(FILE *out) const {
+    fprintf(out, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+
+    double sum = 0, sum_of_squares = 0;
+    uint64_t seen = 0;
+    for (int i = 0; i < num_buckets; i++) {
+        if (counts[i] == 0) continue;
+        double value = std::min(highest_value_in(i), max_us);
+        sum += value * counts[i];
+        sum_of_squares += value * value * counts[i];
+        seen += counts[i];
+
+        double percentile = static_cast<double>(seen) / total;
+        if (seen < total) {
+            fprintf(out, "%12.3f %2.12f %10llu %14.2f\n",
+                value, percentile, (unsigned long long)seen, 1.0 / (1.0 - percentile));
+        } else {
+            fprintf(out, "%12.3f %2.12f %10llu\n", value, percentile, (unsigned long long)seen);
+        }
+    }
+
+    double mean = total ? sum / total : 0;
+    double variance = total ? sum_of_squares / total - mean * mean : 0;
+    fprintf(out, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", mean, variance > 0 ? sqrt(variance) : 0);
+    fprintf(out, "#[Max     = %12.3f, Total count    = %12llu]\n", (double)max_us, (unsigned long long)total);
+    fprintf(out, "#[Buckets = %12d, SubBuckets     = %12d]\n", num_buckets / sub_buckets, 2 * sub_buckets);
+}
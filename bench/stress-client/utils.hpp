@@ -4,6 +4,9 @@
 
 #include <assert.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 #include <algorithm>
 
 #define UNUSED __attribute__((unused))
@@ -185,5 +188,74 @@ struct reservoir_sample_t {
     }
 };
 
+/* latency_histogram_t counts every latency it's given, in microseconds, the way an HDR
+histogram does: values below 128us are counted exactly and larger ones in buckets that
+are within 1/64 of their value, so that percentiles far out in the tail are still
+accurate without keeping every sample. */
+struct latency_histogram_t {
+
+    static const int sub_buckets = 64;
+    static const int num_buckets = 2 * sub_buckets + 30 * sub_buckets;
+
+    uint64_t counts[num_buckets];
+    uint64_t total;
+    uint64_t max_us;
+
+    latency_histogram_t() {
+        clear();
+    }
+
+    void record(ticks_t latency, int count = 1) {
+        uint64_t us = latency / 1000;
+        counts[bucket_for(us)] += count;
+        total += count;
+        max_us = std::max(max_us, us);
+    }
+
+    latency_histogram_t &operator+=(const latency_histogram_t &h) {
+        for (int i = 0; i < num_buckets; i++) counts[i] += h.counts[i];
+        total += h.total;
+        max_us = std::max(max_us, h.max_us);
+        return *this;
+    }
+
+    /* Returns the highest latency (in microseconds) that `percentile` percent of the
+    counted latencies are at or below. */
+    uint64_t value_at_percentile(double percentile) const {
+        if (total == 0) return 0;
+        uint64_t goal = std::max<uint64_t>(1, static_cast<uint64_t>(total * percentile / 100.0 + 0.5));
+        uint64_t seen = 0;
+        for (int i = 0; i < num_buckets; i++) {
+            seen += counts[i];
+            if (seen >= goal) return std::min(highest_value_in(i), max_us);
+        }
+        return max_us;
+    }
+
+    /* Writes the percentile distribution in the text format that HdrHistogram's
+    `outputPercentileDistribution()` uses, so the usual plotting tools can read it. */
+    void write_percentile_distribution(FILE *out) const;
+
+    void clear() {
+        memset(counts, 0, sizeof(counts));
+        total = 0;
+        max_us = 0;
+    }
+
+    static int bucket_for(uint64_t us) {
+        if (us < 2 * sub_buckets) return us;
+        int magnitude = 63 - __builtin_clzll(us) - 6;   // `us >> magnitude` is in [64, 128)
+        int bucket = 2 * sub_buckets + (magnitude - 1) * sub_buckets + ((us >> magnitude) - sub_buckets);
+        return std::min(bucket, num_buckets - 1);
+    }
+
+    static uint64_t highest_value_in(int bucket) {
+        if (bucket < 2 * sub_buckets) return bucket;
+        int magnitude = (bucket - 2 * sub_buckets) / sub_buckets + 1;
+        uint64_t sub_bucket = (bucket - 2 * sub_buckets) % sub_buckets + sub_buckets;
+        return ((sub_bucket + 1) << magnitude) - 1;
+    }
+};
+
 #endif // __STRESS_CLIENT_UTILS_HPP__
 
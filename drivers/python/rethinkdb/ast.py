@@ -894,8 +894,8 @@ class DB(RqlTopLevelQuery):
     def table_list(self):
         return TableList(self)
 
-    def table_create(self, table_name, primary_key=(), datacenter=(), cache_size=(), durability=()):
-        return TableCreate(self, table_name, primary_key=primary_key, datacenter=datacenter, cache_size=cache_size, durability=durability)
+    def table_create(self, table_name, primary_key=(), datacenter=(), cache_size=(), cpu_sharding_factor=(), inline_value_size=(), write_buffer_size=(), time_ordered_keys=(), durability=()):
+        return TableCreate(self, table_name, primary_key=primary_key, datacenter=datacenter, cache_size=cache_size, cpu_sharding_factor=cpu_sharding_factor, inline_value_size=inline_value_size, write_buffer_size=write_buffer_size, time_ordered_keys=time_ordered_keys, durability=durability)
 
     def table_drop(self, table_name):
         return TableDrop(self, table_name)
@@ -929,9 +929,22 @@ class Table(RqlQuery):
     def get_all(self, *keys, **kwargs):
         return GetAll(self, *keys, **kwargs)
 
-    def index_create(self, name, fundef=(), multi=()):
+    def get_in_box(self, corner1, corner2, index):
+        return GetInBox(self, corner1, corner2, index=index)
+
+    def get_in_circle(self, center, radius, index):
+        return GetInCircle(self, center, radius, index=index)
+
+    def get_by_words(self, text, index):
+        return GetByWords(self, text, index=index)
+
+    def index_create(self, name, fundef=(), multi=(), geo=(), text=()):
         args = [self, name] + ([func_wrap(fundef)] if fundef else [])
         kwargs = {"multi" : multi} if multi else {}
+        if geo:
+            kwargs["geo"] = geo
+        if text:
+            kwargs["text"] = text
         return IndexCreate(*args, **kwargs)
 
     def index_drop(self, name):
@@ -949,6 +962,12 @@ class Table(RqlQuery):
     def sync(self):
         return Sync(self)
 
+    def changes(self):
+        return Changes(self)
+
+    def shard_map(self):
+        return ShardMap(self)
+
     def compose(self, args, optargs):
         if isinstance(self.args[0], DB):
             return T(args[0], '.table(', args[1], ')')
@@ -963,6 +982,18 @@ class GetAll(RqlMethodQuery):
     tt = p.Term.GET_ALL
     st = 'get_all'
 
+class GetInBox(RqlMethodQuery):
+    tt = p.Term.GET_IN_BOX
+    st = 'get_in_box'
+
+class GetInCircle(RqlMethodQuery):
+    tt = p.Term.GET_IN_CIRCLE
+    st = 'get_in_circle'
+
+class GetByWords(RqlMethodQuery):
+    tt = p.Term.GET_BY_WORDS
+    st = 'get_by_words'
+
 class Reduce(RqlMethodQuery):
     tt = p.Term.REDUCE
     st = 'reduce'
@@ -1127,6 +1158,14 @@ class Sync(RqlMethodQuery):
     tt = p.Term.SYNC
     st = 'sync'
 
+class Changes(RqlMethodQuery):
+    tt = p.Term.CHANGES
+    st = 'changes'
+
+class ShardMap(RqlMethodQuery):
+    tt = p.Term.SHARD_MAP
+    st = 'shard_map'
+
 class Branch(RqlTopLevelQuery):
     tt = p.Term.BRANCH
     st = "branch"
@@ -22,6 +22,13 @@ class RqlRuntimeError(RqlError):
     def __str__(self):
         return self.message+" in:\n"+self.query_printer.print_query()+'\n'+self.query_printer.print_carrots()
 
+# The query's `shard_map_version` global optarg is out of date.  `shard_map` is the
+# table's current shard map, which says where to send the query instead.
+class RqlStaleShardMapError(RqlError):
+    def __init__(self, shard_map, term):
+        RqlError.__init__(self, "Stale shard map.", term, [])
+        self.shard_map = shard_map
+
 class RqlDriverError(Exception):
     def __init__(self, message):
         self.message = message
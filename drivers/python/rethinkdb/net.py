@@ -279,6 +279,8 @@ class Connection(object):
             backtrace = response.backtrace
             frames = backtrace.frames or []
             raise RqlClientError(message, term, frames)
+        elif response.type == p.Response.STALE_SHARD_MAP:
+            raise RqlStaleShardMapError(Datum.deconstruct(response.response[0]), term)
 
     def _send_query(self, query, term, opts={}, async=False):
         # Error if this connection has closed
@@ -35,8 +35,8 @@ def db_drop(db_name):
 def db_list():
     return DbList()
 
-def table_create(table_name, primary_key=(), datacenter=(), cache_size=(), durability=()):
-    return TableCreateTL(table_name, primary_key=primary_key, datacenter=datacenter, cache_size=cache_size, durability=durability)
+def table_create(table_name, primary_key=(), datacenter=(), cache_size=(), cpu_sharding_factor=(), inline_value_size=(), write_buffer_size=(), time_ordered_keys=(), durability=()):
+    return TableCreateTL(table_name, primary_key=primary_key, datacenter=datacenter, cache_size=cache_size, cpu_sharding_factor=cpu_sharding_factor, inline_value_size=inline_value_size, write_buffer_size=write_buffer_size, time_ordered_keys=time_ordered_keys, durability=durability)
 
 def table_drop(table_name):
     return TableDropTL(table_name)
@@ -0,0 +1,4 @@
+
+#include <boost/bind.hpp>
+int main(){ return 0; }
+
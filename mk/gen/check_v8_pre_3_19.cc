@@ -0,0 +1,7 @@
+#include <v8.h>
+int main() {
+    v8::Local<v8::Context> lc = v8::Context::New(v8::Isolate::GetCurrent());
+    v8::Persistent<v8::Context> ps;
+    ps.Reset(v8::Isolate::GetCurrent(), lc);
+    v8::Local<v8::Context> lh = v8::Local<v8::Context>::New(v8::Isolate::GetCurrent(), ps);
+}
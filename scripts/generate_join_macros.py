@@ -23,6 +23,22 @@ def generate_make_semilattice_joinable_macro(nfields):
     # Putting this here makes us require a semicolon after macro invocation.
     print "    extern int semilattice_joinable_force_semicolon_declaration"
 
+def generate_make_semilattice_delta_macro(nfields):
+    print "#define RDB_MAKE_SEMILATTICE_DELTA_%d(type_t%s) \\" % \
+        (nfields, "".join(", field%d" % (i+1) for i in xrange(nfields)))
+    unused = "UNUSED " if nfields == 0 else ""
+    print "    inline type_t semilattice_delta(%sconst type_t &_a_, %sconst type_t &_b_) { \\" % (unused, unused)
+    # So fields whose types have no overload of their own get the default one
+    # even when `type_t` isn't in the global namespace.
+    print "        using ::semilattice_delta; \\"
+    print "        type_t _d_; \\"
+    for i in xrange(nfields):
+        print "        _d_.field%d = semilattice_delta(_a_.field%d, _b_.field%d); \\" % (i + 1, i + 1, i + 1)
+    print "        return _d_; \\"
+    print "    } \\"
+    # Putting this here makes us require a semicolon after macro invocation.
+    print "    extern int semilattice_delta_force_semicolon_declaration"
+
 def generate_make_equality_comparable_macro(nfields):
     print "#define RDB_MAKE_EQUALITY_COMPARABLE_%d(type_t%s) \\" % \
         (nfields, "".join(", field%d" % (i+1) for i in xrange(nfields)))
@@ -80,12 +96,29 @@ You can also use this with templated types, but it's pretty hacky:
     };
     template<class T>
     RDB_MAKE_SEMILATTICE_JOINABLE_2(pair_t<T>, a, b)
+
+`semilattice_delta(a, b)`, where `b` is `a` joined with something, returns a
+value that brings anything that already has `a` up to `b` when it's joined in.
+The `semilattice_manager_t` sends these instead of the whole metadata. By
+default it's just `b`; maps and `cow_ptr_t`s only keep what changed, and types
+made with `RDB_MAKE_SEMILATTICE_DELTA_[n]()` take the delta of each field, so
+you only need that macro on types that lead down to big maps. Their fields must
+be assignable and the type default-constructible.
 */
     """.strip()
     print
 
+    print """
+template <class T>
+T semilattice_delta(UNUSED const T &a, const T &b) {
+    return b;
+}
+    """.strip()
+    print
+
     for nfields in xrange(0, 20):
         generate_make_semilattice_joinable_macro(nfields)
+        generate_make_semilattice_delta_macro(nfields)
         generate_make_equality_comparable_macro(nfields)
         generate_make_me_equality_comparable_macro(nfields)
         print
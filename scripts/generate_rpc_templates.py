@@ -75,8 +75,9 @@ def generate_async_message_template(nargs):
     print "    typedef mailbox_addr_t< void(%s) > address_t;" % csep("arg#_t")
     print
     print "    mailbox_t(mailbox_manager_t *manager,"
-    print "              const boost::function< void(%s)> &f) :" % csep("arg#_t")
-    print "        reader(this), fun(f), mailbox(manager, &reader)"
+    print "              const boost::function< void(%s)> &f," % csep("arg#_t")
+    print "              message_class_t message_class = message_class_t::query) :"
+    print "        reader(this), fun(f), mailbox(manager, &reader, message_class)"
     print "        { }"
     print
     print "    address_t get_address() const {"
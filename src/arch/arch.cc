@@ -1,6 +1,7 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "arch/arch.hpp"
 
+#include "arch/runtime/coro_wait_profiler.hpp"
 #include "arch/runtime/coroutines.hpp"
 
 struct io_coroutine_adapter_t : public iocallback_t {
@@ -12,6 +13,7 @@ struct io_coroutine_adapter_t : public iocallback_t {
 };
 
 void co_read(file_t *file, int64_t offset, size_t length, void *buf, file_account_t *account) {
+    coro_wait_site_t wait_site("disk read");
     io_coroutine_adapter_t adapter;
     file->read_async(offset, length, buf, account, &adapter);
     coro_t::wait();
@@ -19,6 +21,7 @@ void co_read(file_t *file, int64_t offset, size_t length, void *buf, file_accoun
 
 void co_write(file_t *file, int64_t offset, size_t length, void *buf,
               file_account_t *account, file_t::wrap_in_datasyncs_t wrap_in_datasyncs) {
+    coro_wait_site_t wait_site("disk write");
     io_coroutine_adapter_t adapter;
     file->write_async(offset, length, buf, account, &adapter, wrap_in_datasyncs);
     coro_t::wait();
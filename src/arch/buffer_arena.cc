@@ -0,0 +1,223 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/buffer_arena.hpp"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "arch/spinlock.hpp"
+#include "config/args.hpp"
+#include "logger.hpp"
+#include "utils.hpp"
+
+namespace {
+
+// The size of the huge pages on x86-64, and the unit in which the arena maps
+// memory and binds it to a NUMA node.
+const size_t ARENA_CHUNK_SIZE = 2 * MEGABYTE;
+
+const size_t NUM_SIZE_CLASSES = BUFFER_ARENA_MAX_BUFFER_SIZE / DEVICE_BLOCK_SIZE;
+
+// From <numaif.h>, which isn't always installed.
+const int ARENA_MPOL_PREFERRED = 1;
+
+struct free_buffer_t {
+    free_buffer_t *next;
+};
+
+// The buffers of one size class on one NUMA node.  Buffers that have been freed
+// are reused first; after that they are handed out from the chunk that was mapped
+// last, which is why the buffers of a new chunk don't have to be touched (and
+// thereby faulted in) before they are needed.
+struct size_class_list_t {
+    size_class_list_t() : free_list(NULL), chunk_pos(NULL), chunk_end(NULL) { }
+
+    spinlock_t lock;
+    free_buffer_t *free_list;
+    char *chunk_pos;
+    char *chunk_end;
+};
+
+struct buffer_arena_t {
+    huge_page_mode_t mode;
+    char *base;
+    size_t num_chunks;
+    // How many chunks have been taken, only ever incremented atomically.
+    size_t next_chunk;
+    // The size class and NUMA node of each taken chunk, which are set before any
+    // buffer of the chunk is handed out.
+    uint16_t *chunk_size_classes;
+    uint8_t *chunk_nodes;
+    size_class_list_t lists[BUFFER_ARENA_MAX_NUMA_NODES][NUM_SIZE_CLASSES];
+};
+
+buffer_arena_t *arena = NULL;
+
+size_t size_class_of(size_t size) {
+    return ceil_divide(size, DEVICE_BLOCK_SIZE) - 1;
+}
+
+size_t size_class_buffer_size(size_t size_class) {
+    return (size_class + 1) * DEVICE_BLOCK_SIZE;
+}
+
+int current_numa_node() {
+    unsigned cpu, node;
+    if (syscall(__NR_getcpu, &cpu, &node, NULL) != 0) {
+        return 0;
+    }
+    return node % BUFFER_ARENA_MAX_NUMA_NODES;
+}
+
+bool map_huge_chunk(char *chunk, bool explicit_pages) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED;
+#ifdef MAP_HUGETLB
+    if (explicit_pages) {
+        flags |= MAP_HUGETLB;
+    }
+#else
+    if (explicit_pages) {
+        return false;
+    }
+#endif
+    void *res = mmap(chunk, ARENA_CHUNK_SIZE, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (res == MAP_FAILED) {
+        return false;
+    }
+    guarantee(res == chunk);
+#ifdef MADV_HUGEPAGE
+    if (!explicit_pages) {
+        // Failure just means we get normal pages.
+        madvise(chunk, ARENA_CHUNK_SIZE, MADV_HUGEPAGE);
+    }
+#endif
+    return true;
+}
+
+// Backs the chunk with memory, preferably on `node`.  The memory is only faulted in
+// as the buffers are used, so binding it afterwards is soon enough.
+bool map_chunk(char *chunk, int node) {
+    if (!(arena->mode == huge_page_mode_t::explicit_desired
+          && map_huge_chunk(chunk, true))
+        && !map_huge_chunk(chunk, false)) {
+        return false;
+    }
+    unsigned long nodemask = 1UL << node;  // NOLINT(runtime/int)
+    // Fails harmlessly on kernels without NUMA support.
+    syscall(__NR_mbind, chunk, ARENA_CHUNK_SIZE, ARENA_MPOL_PREFERRED,
+            &nodemask, BUFFER_ARENA_MAX_NUMA_NODES + 1, 0);
+    return true;
+}
+
+// Returns NULL if the arena has no chunks left.  The caller holds the list's lock.
+void *allocate_from_list(size_class_list_t *list, size_t size_class, int node) {
+    if (list->free_list != NULL) {
+        free_buffer_t *buf = list->free_list;
+        list->free_list = buf->next;
+        return buf;
+    }
+
+    const size_t buffer_size = size_class_buffer_size(size_class);
+    if (list->chunk_pos == NULL
+        || static_cast<size_t>(list->chunk_end - list->chunk_pos) < buffer_size) {
+        const size_t chunk_index = __sync_fetch_and_add(&arena->next_chunk, 1);
+        if (chunk_index >= arena->num_chunks) {
+            return NULL;
+        }
+        char *chunk = arena->base + chunk_index * ARENA_CHUNK_SIZE;
+        if (!map_chunk(chunk, node)) {
+            // The address range stays reserved; we just won't use this chunk.
+            return NULL;
+        }
+        arena->chunk_size_classes[chunk_index] = size_class;
+        arena->chunk_nodes[chunk_index] = node;
+        list->chunk_pos = chunk;
+        list->chunk_end = chunk + ARENA_CHUNK_SIZE;
+    }
+
+    void *res = list->chunk_pos;
+    list->chunk_pos += buffer_size;
+    return res;
+}
+
+}  // namespace
+
+void init_buffer_arena(huge_page_mode_t mode) {
+    guarantee(arena == NULL);
+    if (mode == huge_page_mode_t::disabled) {
+        return;
+    }
+
+    // Reserve one chunk more than needed, to be able to align the range to a huge
+    // page boundary.
+    const size_t reservation = BUFFER_ARENA_RESERVATION + ARENA_CHUNK_SIZE;
+    void *range = mmap(NULL, reservation, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (range == MAP_FAILED) {
+        logWRN("Could not reserve address space for the buffer arena (errno %d), "
+               "huge pages are disabled.", get_errno());
+        return;
+    }
+    const uintptr_t aligned = ceil_aligned(reinterpret_cast<uintptr_t>(range),
+                                           ARENA_CHUNK_SIZE);
+
+    buffer_arena_t *a = new buffer_arena_t;
+    a->mode = mode;
+    a->base = reinterpret_cast<char *>(aligned);
+    a->num_chunks = BUFFER_ARENA_RESERVATION / ARENA_CHUNK_SIZE;
+    a->next_chunk = 0;
+    a->chunk_size_classes = new uint16_t[a->num_chunks];
+    a->chunk_nodes = new uint8_t[a->num_chunks];
+    arena = a;
+
+    if (mode == huge_page_mode_t::explicit_desired) {
+        // Probe the hugetlbfs pool with the first chunk, so that a missing pool is
+        // reported once instead of silently costing a system call per chunk.
+        if (!map_huge_chunk(arena->base, true)) {
+            logWRN("No huge pages are available from the hugetlbfs pool, using "
+                   "transparent huge pages instead.");
+            arena->mode = huge_page_mode_t::transparent_desired;
+        } else {
+            munmap(arena->base, ARENA_CHUNK_SIZE);
+            void *res = mmap(arena->base, ARENA_CHUNK_SIZE, PROT_NONE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+                             -1, 0);
+            guarantee_err(res != MAP_FAILED, "Could not re-reserve arena chunk");
+        }
+    }
+}
+
+void *buffer_arena_malloc(size_t size) {
+    if (arena == NULL || size == 0 || size > BUFFER_ARENA_MAX_BUFFER_SIZE) {
+        return malloc_aligned(size, DEVICE_BLOCK_SIZE);
+    }
+
+    const size_t size_class = size_class_of(size);
+    const int node = current_numa_node();
+    size_class_list_t *list = &arena->lists[node][size_class];
+    void *res;
+    {
+        spinlock_acq_t acq(&list->lock);
+        res = allocate_from_list(list, size_class, node);
+    }
+    return res != NULL ? res : malloc_aligned(size, DEVICE_BLOCK_SIZE);
+}
+
+void buffer_arena_free(void *ptr) {
+    char *p = static_cast<char *>(ptr);
+    if (arena == NULL || p < arena->base
+        || p >= arena->base + arena->num_chunks * ARENA_CHUNK_SIZE) {
+        free(ptr);
+        return;
+    }
+
+    const size_t chunk_index = (p - arena->base) / ARENA_CHUNK_SIZE;
+    size_class_list_t *list = &arena->lists[arena->chunk_nodes[chunk_index]]
+        [arena->chunk_size_classes[chunk_index]];
+    free_buffer_t *buf = reinterpret_cast<free_buffer_t *>(p);
+    spinlock_acq_t acq(&list->lock);
+    buf->next = list->free_list;
+    list->free_list = buf;
+}
@@ -0,0 +1,103 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_BUFFER_ARENA_HPP_
+#define ARCH_BUFFER_ARENA_HPP_
+
+#include <stddef.h>
+
+#include <utility>
+
+#include "errors.hpp"
+
+/* The buffer arena hands out the page-sized, DEVICE_BLOCK_SIZE-aligned buffers that
+the serializer and the cache keep blocks in.  Rather than getting each of them from
+malloc, it carves them out of 2MB chunks of one big reserved address range, so that
+the kernel can back the cache with huge pages and the TLB doesn't get thrashed by
+random accesses to a big cache.  Each chunk is bound to the NUMA node of the thread
+that first needed it, and buffers that are freed go back to the free list of their
+chunk's node, so a buffer is reused near where its memory lives.
+
+Buffers that don't fit a size class, buffers requested when the arena is disabled
+or exhausted, and buffers in chunks that couldn't be mapped come from
+malloc_aligned() instead; `buffer_arena_free()` tells them apart by address. */
+
+enum class huge_page_mode_t {
+    // Don't use the arena at all; every buffer comes from malloc_aligned().
+    disabled,
+    // Ask for transparent huge pages with madvise(MADV_HUGEPAGE), and use normal
+    // pages if the kernel doesn't oblige.
+    transparent_desired,
+    // Use pages from the hugetlbfs pool, and fall back to transparent huge pages
+    // when the pool is empty or not configured.
+    explicit_desired
+};
+
+// Must be called at most once, before any buffers are allocated (that is, before
+// the thread pool starts).  Without it the arena stays disabled.
+void init_buffer_arena(huge_page_mode_t mode);
+
+// Returns a DEVICE_BLOCK_SIZE-aligned buffer of at least `size` bytes.
+void *buffer_arena_malloc(size_t size);
+// Takes buffers from buffer_arena_malloc() as well as any other malloc()ed ones.
+void buffer_arena_free(void *ptr);
+
+// Like scoped_malloc_t, but for buffers that belong to the arena.
+template <class T>
+class scoped_arena_ptr_t {
+public:
+    scoped_arena_ptr_t() : ptr_(NULL) { }
+    explicit scoped_arena_ptr_t(void *ptr) : ptr_(static_cast<T *>(ptr)) { }
+    explicit scoped_arena_ptr_t(size_t n)
+        : ptr_(static_cast<T *>(buffer_arena_malloc(n))) { }
+    scoped_arena_ptr_t(scoped_arena_ptr_t &&movee)
+        : ptr_(movee.ptr_) {
+        movee.ptr_ = NULL;
+    }
+
+    ~scoped_arena_ptr_t() {
+        if (ptr_ != NULL) {
+            buffer_arena_free(ptr_);
+        }
+    }
+
+    void operator=(scoped_arena_ptr_t &&movee) {
+        scoped_arena_ptr_t tmp(std::move(movee));
+        swap(tmp);
+    }
+
+    void init(void *ptr) {
+        guarantee(ptr_ == NULL);
+        ptr_ = static_cast<T *>(ptr);
+    }
+
+    T *get() const { return ptr_; }
+    T *operator->() const { return ptr_; }
+    T &operator*() const { return *ptr_; }
+
+    T *release() {
+        T *tmp = ptr_;
+        ptr_ = NULL;
+        return tmp;
+    }
+
+    void reset() {
+        scoped_arena_ptr_t tmp;
+        swap(tmp);
+    }
+
+    bool has() const {
+        return ptr_ != NULL;
+    }
+
+private:
+    void swap(scoped_arena_ptr_t &other) {  // NOLINT
+        T *tmp = ptr_;
+        ptr_ = other.ptr_;
+        other.ptr_ = tmp;
+    }
+
+    T *ptr_;
+
+    DISABLE_COPYING(scoped_arena_ptr_t);
+};
+
+#endif  // ARCH_BUFFER_ARENA_HPP_
@@ -0,0 +1,78 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/crc32c.hpp"
+
+#include <string.h>
+
+namespace {
+
+// The Castagnoli polynomial, bit-reversed.
+const uint32_t CRC32C_POLYNOMIAL = 0x82f63b78;
+
+struct crc32c_table_t {
+    crc32c_table_t() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLYNOMIAL : 0);
+            }
+            entries[i] = crc;
+        }
+    }
+    uint32_t entries[256];
+};
+
+uint32_t crc32c_software(uint32_t crc, const uint8_t *p, size_t size) {
+    static const crc32c_table_t table;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table.entries[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((__target__("sse4.2")))
+uint32_t crc32c_sse42(uint32_t crc, const uint8_t *p, size_t size) {
+    // Eight bytes at a time, once `p` is aligned for it.
+    while (size > 0 && reinterpret_cast<uintptr_t>(p) % 8 != 0) {
+        crc = __builtin_ia32_crc32qi(crc, *p);
+        ++p;
+        --size;
+    }
+    uint64_t crc64 = crc;
+    while (size >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc64 = __builtin_ia32_crc32di(crc64, word);
+        p += 8;
+        size -= 8;
+    }
+    crc = crc64;
+    while (size > 0) {
+        crc = __builtin_ia32_crc32qi(crc, *p);
+        ++p;
+        --size;
+    }
+    return crc;
+}
+
+bool cpu_has_sse42() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+
+#endif  // defined(__x86_64__)
+
+}  // namespace
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t size) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+#if defined(__x86_64__)
+    static const bool has_sse42 = cpu_has_sse42();
+    if (has_sse42) {
+        return ~crc32c_sse42(crc, p, size);
+    }
+#endif
+    return ~crc32c_software(crc, p, size);
+}
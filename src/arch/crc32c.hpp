@@ -0,0 +1,14 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_CRC32C_HPP_
+#define ARCH_CRC32C_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Extends `crc`, the CRC32C (Castagnoli) checksum of some bytes, by the `size` bytes at
+`data`.  The checksum of no bytes is 0.  It uses the SSE 4.2 `crc32` instruction when
+the CPU has it, which checksums a 4 KB block in well under a microsecond, and falls
+back on a lookup table otherwise. */
+uint32_t crc32c(uint32_t crc, const void *data, size_t size);
+
+#endif  // ARCH_CRC32C_HPP_
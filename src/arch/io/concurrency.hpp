@@ -2,7 +2,9 @@
 #ifndef ARCH_IO_CONCURRENCY_HPP_
 #define ARCH_IO_CONCURRENCY_HPP_
 
+#include <errno.h>
 #include <pthread.h>
+#include <time.h>
 
 // Class that wraps a pthread mutex
 class system_mutex_t {
@@ -53,6 +55,15 @@ public:
         int res = pthread_cond_wait(&c, &mutex->m);
         guarantee_xerr(res == 0, res, "Could not wait on pthread cond.");
     }
+    // Returns false if `deadline`, on the `CLOCK_REALTIME` clock, passed first.
+    bool timed_wait(system_mutex_t *mutex, const struct timespec &deadline) {
+        int res = pthread_cond_timedwait(&c, &mutex->m, &deadline);
+        if (res == ETIMEDOUT) {
+            return false;
+        }
+        guarantee_xerr(res == 0, res, "Could not wait on pthread cond.");
+        return true;
+    }
     void signal() {
         int res = pthread_cond_signal(&c);
         guarantee_xerr(res == 0, res, "Could not signal pthread cond.");
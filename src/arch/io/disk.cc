@@ -19,6 +19,7 @@
 #include "arch/runtime/runtime.hpp"
 #include "arch/io/disk/filestat.hpp"
 #include "arch/io/disk/pool.hpp"
+#include "arch/io/disk/uring.hpp"
 #include "arch/io/disk/conflict_resolving.hpp"
 #include "arch/io/disk/stats.hpp"
 #include "arch/io/disk/accounting.hpp"
@@ -44,14 +45,41 @@ public:
     linux_disk_manager_t(linux_event_queue_t *queue,
                          int batch_factor,
                          int max_concurrent_io_requests,
+                         file_io_backend_t io_backend,
                          perfmon_collection_t *stats) :
         stack_stats(stats, "stack"),
         conflict_resolver(stats),
-        accounter(batch_factor),
+        accounter(batch_factor, stats),
         backend_stats(stats, "backend", accounter.producer),
-        backend(queue, backend_stats.producer, max_concurrent_io_requests),
+        flush_message(this),
         outstanding_txn(0)
     {
+        /* Set up whichever backend pops the IO operations off the queue. Both
+        backends run the same `pool_diskmgr_t::action_t`s, so the rest of the stack
+        (including the stats) doesn't care which one it is. */
+        if (io_backend == file_io_backend_t::uring_desired) {
+#if USE_IO_URING
+            if (uring_diskmgr_t::is_supported()) {
+                uring_backend.init(new uring_diskmgr_t(queue, backend_stats.producer,
+                                                       max_concurrent_io_requests));
+                uring_backend->done_fun = std::bind(&stats_diskmgr_2_t::done,
+                                                    &backend_stats, ph::_1);
+            } else {
+                logWRN("io_uring is not available on this system, falling back to "
+                       "the thread pool disk backend.\n");
+            }
+#else
+            logWRN("This build does not support io_uring, falling back to the thread "
+                   "pool disk backend.\n");
+#endif
+        }
+        if (!has_uring_backend()) {
+            pool_backend.init(new pool_diskmgr_t(queue, backend_stats.producer,
+                                                 max_concurrent_io_requests));
+            pool_backend->done_fun = std::bind(&stats_diskmgr_2_t::done,
+                                               &backend_stats, ph::_1);
+        }
+
         /* Hook up the `submit_fun`s of the parts of the IO stack that are above the
         queue. (The parts below the queue use the `passive_producer_t` interface instead
         of a callback function.) */
@@ -59,9 +87,12 @@ public:
                                            &conflict_resolver, ph::_1);
         conflict_resolver.submit_fun = std::bind(&accounting_diskmgr_t::submit,
                                                  &accounter, ph::_1);
+        /* Let the conflict resolver coalesce the writes that get submitted during one
+        pass of the event loop. */
+        conflict_resolver.schedule_flush_fun =
+            std::bind(&linux_disk_manager_t::schedule_flush_ready_writes, this);
 
-        /* Hook up everything's `done_fun`. */
-        backend.done_fun = std::bind(&stats_diskmgr_2_t::done, &backend_stats, ph::_1);
+        /* Hook up everything's `done_fun`. (The backend's was hooked up above.) */
         backend_stats.done_fun = std::bind(&accounting_diskmgr_t::done, &accounter, ph::_1);
         accounter.done_fun = std::bind(&conflict_resolving_diskmgr_t::done,
                                        &conflict_resolver, ph::_1);
@@ -73,6 +104,14 @@ public:
         rassert(outstanding_txn == 0, "Closing a file with outstanding txns\n");
     }
 
+    bool has_uring_backend() const {
+#if USE_IO_URING
+        return uring_backend.has();
+#else
+        return false;
+#endif
+    }
+
     void *create_account(int pri, int outstanding_requests_limit) {
         return new accounting_diskmgr_t::account_t(&accounter, pri, outstanding_requests_limit);
     }
@@ -87,6 +126,14 @@ public:
                                          account));
     }
 
+    void set_account_latency_target(void *account, int64_t latency_target_ms) {
+        // Ordered with respect to the operations we submit from this thread.
+        do_on_thread(home_thread(),
+                     std::bind(&accounting_diskmgr_t::account_t::set_latency_target,
+                               static_cast<accounting_diskmgr_t::account_t *>(account),
+                               latency_target_ms));
+    }
+
     void submit_action_to_stack_stats(action_t *a) {
         assert_thread();
         outstanding_txn++;
@@ -155,6 +202,25 @@ public:
     }
 
 private:
+    struct flush_message_t : public linux_thread_message_t {
+        explicit flush_message_t(linux_disk_manager_t *_parent)
+            : parent(_parent), scheduled(false) { }
+        void on_thread_switch() {
+            scheduled = false;
+            parent->conflict_resolver.flush_ready_writes();
+        }
+        linux_disk_manager_t *parent;
+        bool scheduled;
+    };
+
+    void schedule_flush_ready_writes() {
+        assert_thread();
+        if (!flush_message.scheduled) {
+            flush_message.scheduled = true;
+            call_later_on_this_thread(&flush_message);
+        }
+    }
+
     /* These fields describe the entire IO stack. At the top level, we allocate a new
     action_t object for each operation and record its callback. Then it passes through
     the conflict resolver, which enforces ordering constraints between IO operations by
@@ -168,13 +234,20 @@ private:
     will tell you how many IO operations are queued. The "backend stats" will tell you
     how long the OS takes to perform the operations. Note that it's not perfect, because
     it counts operations that have been queued by the backend but not sent to the OS yet
-    as having been sent to the OS. */
+    as having been sent to the OS.
+
+    Exactly one of `pool_backend` and `uring_backend` is set. */
 
     stats_diskmgr_t stack_stats;
     conflict_resolving_diskmgr_t conflict_resolver;
     accounting_diskmgr_t accounter;
     stats_diskmgr_2_t backend_stats;
-    pool_diskmgr_t backend;
+    scoped_ptr_t<pool_diskmgr_t> pool_backend;
+#if USE_IO_URING
+    scoped_ptr_t<uring_diskmgr_t> uring_backend;
+#endif
+
+    flush_message_t flush_message;
 
 
     int outstanding_txn;
@@ -183,22 +256,31 @@ private:
 };
 
 io_backender_t::io_backender_t(file_direct_io_mode_t _direct_io_mode,
-                               int max_concurrent_io_requests)
+                               int max_concurrent_io_requests,
+                               file_io_backend_t io_backend)
     : direct_io_mode(_direct_io_mode),
       diskmgr(new linux_disk_manager_t(&linux_thread_pool_t::get_thread()->queue,
                                        DEFAULT_IO_BATCH_FACTOR,
                                        max_concurrent_io_requests,
+                                       io_backend,
                                        &stats)) { }
 
 io_backender_t::~io_backender_t() { }
 
 file_direct_io_mode_t io_backender_t::get_direct_io_mode() const { return direct_io_mode; }
 
+file_io_backend_t io_backender_t::get_io_backend() const {
+    return diskmgr->has_uring_backend()
+        ? file_io_backend_t::uring_desired
+        : file_io_backend_t::pool;
+}
+
 
 /* Disk file object */
 
 linux_file_t::linux_file_t(scoped_fd_t &&_fd, int64_t _file_size, linux_disk_manager_t *_diskmgr)
-    : fd(std::move(_fd)), file_size(_file_size), diskmgr(_diskmgr) {
+    : fd(std::move(_fd)), file_size(_file_size), preallocated_size(_file_size),
+      can_preallocate(true), can_discard(true), diskmgr(_diskmgr) {
     // TODO: Why do we care whether we're in a thread pool?  (Maybe it's that you can't create a
     // file_account_t outside of the thread pool?  But they're associated with the diskmgr,
     // aren't they?)
@@ -223,15 +305,77 @@ void linux_file_t::set_size(int64_t size) {
     guarantee_xerr(errcode == 0, errcode, "Could not sync after ftruncate");
 
     file_size = size;
+    // Truncating the file frees what we had allocated past its end.
+    preallocated_size = std::min(preallocated_size, size);
 }
 
 void linux_file_t::set_size_at_least(int64_t size) {
     /* Grow in large chunks at a time */
     if (file_size < size) {
+        preallocate(size);
         set_size(ceil_aligned(size, DEVICE_BLOCK_SIZE * 128));
     }
 }
 
+void linux_file_t::preallocate(int64_t size) {
+#ifdef __linux__
+    if (!can_preallocate || size <= preallocated_size) {
+        return;
+    }
+    const int64_t end = ceil_aligned(size, FILE_PREALLOCATION_CHUNK_SIZE);
+    int res;
+    do {
+        // FALLOC_FL_KEEP_SIZE, since the extent manager relies on the file's size.
+        res = fallocate(fd.get(), FALLOC_FL_KEEP_SIZE, preallocated_size,
+                        end - preallocated_size);
+    } while (res == -1 && get_errno() == EINTR);
+    if (res == 0) {
+        preallocated_size = end;
+    } else {
+        // The file just grows as it's written then, like it always used to.
+        can_preallocate = false;
+        const int errsv = get_errno();
+        if (errsv != EOPNOTSUPP && errsv != ENOSYS) {
+            logWRN("Could not preallocate disk space for a data file, so it may "
+                   "end up fragmented: %s", errno_string(errsv).c_str());
+        }
+    }
+#else
+    (void)size;
+#endif  // __linux__
+}
+
+void linux_file_t::discard(int64_t offset, int64_t length) {
+#ifdef __linux__
+    if (!can_discard) {
+        return;
+    }
+    int res;
+    do {
+        res = fallocate(fd.get(), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                        offset, length);
+    } while (res == -1 && get_errno() == EINTR);
+    if (res == -1) {
+        // There's no harm in keeping the data around, so we just stop trying.
+        can_discard = false;
+        const int errsv = get_errno();
+        if (errsv != EOPNOTSUPP && errsv != ENOSYS) {
+            logWRN("Could not discard freed space in a data file: %s",
+                   errno_string(errsv).c_str());
+        }
+    }
+#else
+    (void)offset;
+    (void)length;
+#endif  // __linux__
+}
+
+void linux_file_t::datasync() {
+    int res;
+    thread_pool_t::run_in_blocker_pool([&]() { res = perform_datasync(fd.get()); });
+    guarantee_xerr(res == 0, res, "Could not sync a data file");
+}
+
 void linux_file_t::read_async(int64_t offset, size_t length, void *buf, file_account_t *account, linux_iocallback_t *callback) {
     rassert(diskmgr, "No diskmgr has been constructed (are we running without an event queue?)");
     verify_aligned_file_access(file_size, offset, length, buf);
@@ -326,6 +470,10 @@ void linux_file_t::destroy_account(void *account) {
     diskmgr->destroy_account(account);
 }
 
+void linux_file_t::set_account_latency_target(void *account, int64_t latency_target_ms) {
+    diskmgr->set_account_latency_target(account, latency_target_ms);
+}
+
 
 
 linux_file_t::~linux_file_t() {
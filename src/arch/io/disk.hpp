@@ -28,10 +28,13 @@ public:
     // stops us from specifying this on a file-by-file basis, but right now there's no desire for
     // that.  See https://github.com/rethinkdb/rethinkdb/issues/97#issuecomment-19778177 .
     io_backender_t(file_direct_io_mode_t direct_io_mode,
-                   int max_concurrent_io_requests = DEFAULT_MAX_CONCURRENT_IO_REQUESTS);
+                   int max_concurrent_io_requests = DEFAULT_MAX_CONCURRENT_IO_REQUESTS,
+                   file_io_backend_t io_backend = file_io_backend_t::pool);
     ~io_backender_t();
     linux_disk_manager_t *get_diskmgr_ptr() { return diskmgr.get(); }
     file_direct_io_mode_t get_direct_io_mode() const;
+    // The backend that is actually in use, after any fallback.
+    file_io_backend_t get_io_backend() const;
 
 protected:
     const file_direct_io_mode_t direct_io_mode;
@@ -71,6 +74,8 @@ public:
     int64_t get_size();
     void set_size(int64_t size);
     void set_size_at_least(int64_t size);
+    void discard(int64_t offset, int64_t length);
+    void datasync();
 
     void read_async(int64_t offset, size_t length, void *buf, file_account_t *account, linux_iocallback_t *cb);
     void write_async(int64_t offset, size_t length, const void *buf, file_account_t *account, linux_iocallback_t *cb,
@@ -84,6 +89,7 @@ public:
 
     void *create_account(int priority, int outstanding_requests_limit);
     void destroy_account(void *account);
+    void set_account_latency_target(void *account, int64_t latency_target_ms);
 
     ~linux_file_t();
 
@@ -93,9 +99,19 @@ private:
                                         io_backender_t *backender,
                                         scoped_ptr_t<file_t> *out);
 
+    // Allocates disk space for the file up to at least `size`, ahead of the
+    // writes that will need it, so that they don't leave the file fragmented.
+    void preallocate(int64_t size);
+
     scoped_fd_t fd;
     int64_t file_size;
 
+    // How far into the file we've allocated disk space (see `preallocate`).
+    int64_t preallocated_size;
+    // Cleared once the file system turns down fallocate() for either.
+    bool can_preallocate;
+    bool can_discard;
+
     linux_disk_manager_t *diskmgr;
 
     scoped_ptr_t<file_account_t> default_account;
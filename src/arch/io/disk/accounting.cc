@@ -28,6 +28,9 @@ struct accounting_diskmgr_eager_account_t : public semaphore_available_callback_
     semaphore_t *get_outstanding_requests_limiter() {
         return &outstanding_requests_limiter;
     }
+    void set_latency_target(int64_t latency_target_ms) {
+        account.set_latency_target(latency_target_ms * MILLION);
+    }
 
 private:
     // It would be nice if we could just use a limited_fifo_queue to
@@ -49,7 +52,8 @@ accounting_diskmgr_account_t::accounting_diskmgr_account_t(accounting_diskmgr_t
                                                            int _pri,
                                                            int _outstanding_requests_limit)
         : par(_par), pri(_pri),
-          outstanding_requests_limit(_outstanding_requests_limit) { }
+          outstanding_requests_limit(_outstanding_requests_limit),
+          latency_target_ms(0) { }
 
 accounting_diskmgr_account_t::~accounting_diskmgr_account_t() {
     par->assert_thread();
@@ -70,10 +74,21 @@ semaphore_t *accounting_diskmgr_account_t::get_outstanding_requests_limiter() {
     return eager_account->get_outstanding_requests_limiter();
 }
 
+void accounting_diskmgr_account_t::set_latency_target(int64_t _latency_target_ms) {
+    par->assert_thread();
+    latency_target_ms = _latency_target_ms;
+    if (eager_account.has()) {
+        eager_account->set_latency_target(latency_target_ms);
+    }
+}
+
 void accounting_diskmgr_account_t::maybe_init(){
     if (!eager_account.has()) {
         par->assert_thread();
         eager_account.init(new eager_account_t(par, pri, outstanding_requests_limit));
+        if (latency_target_ms != 0) {
+            eager_account->set_latency_target(latency_target_ms);
+        }
     }
 }
 
@@ -94,12 +109,15 @@ accounting_diskmgr_t::~accounting_diskmgr_t() {
 }
 
 void accounting_diskmgr_t::submit(action_t *a) {
+    ++outstanding;
+    queue_depth_sampler.record(outstanding);
     a->account->push(a);
 }
 
 void accounting_diskmgr_t::done(accounting_payload_t *p) {
     // p really is an action_t...
     action_t *a = static_cast<action_t *>(p);
+    --outstanding;
     a->account->get_outstanding_requests_limiter()->unlock(1);
     done_fun(static_cast<action_t *>(p));
 }
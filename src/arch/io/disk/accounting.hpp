@@ -33,7 +33,8 @@ private:
 };
 
 /* `accounting_diskmgr_t` shares disk throughput proportionally between a
-number of different "accounts". */
+number of different "accounts", and serves accounts that are past their latency
+target first. See `accounting_queue_t` for the scheduling policy. */
 
 typedef stats_diskmgr_2_t::action_t accounting_payload_t;
 
@@ -55,6 +56,7 @@ struct accounting_diskmgr_account_t {
     void push(action_t *action);
     void on_semaphore_available();
     semaphore_t *get_outstanding_requests_limiter();
+    void set_latency_target(int64_t latency_target_ms);
 
 private:
     typedef accounting_diskmgr_eager_account_t eager_account_t;
@@ -64,6 +66,7 @@ private:
     accounting_diskmgr_t *par;
     int pri;
     int outstanding_requests_limit;
+    int64_t latency_target_ms;
     scoped_ptr_t<eager_account_t> eager_account;
 
     DISABLE_COPYING(accounting_diskmgr_account_t);
@@ -80,9 +83,14 @@ void debug_print(printf_buffer_t *buf,
 
 class accounting_diskmgr_t : public home_thread_mixin_t {
 public:
-    explicit accounting_diskmgr_t(int batch_factor)
+    accounting_diskmgr_t(int batch_factor, perfmon_collection_t *stats)
         : producer(&caster),
-          queue(batch_factor),
+          queue_depth_sampler(secs_to_ticks(1), false),
+          stats_membership(stats,
+                           &queue_depth_sampler, "accounting_queue_depth",
+                           &overdue_pops, "accounting_deadline_pops"),
+          outstanding(0),
+          queue(batch_factor, &overdue_pops),
           caster(&queue),
           auto_drainer(new auto_drainer_t()) { }
 
@@ -106,6 +114,14 @@ public:
 private:
     friend struct accounting_diskmgr_eager_account_t;
 
+    /* The number of actions that have been submitted but aren't done, sampled on
+    each submission, and how often an account got served because it was past its
+    latency target. */
+    perfmon_sampler_t queue_depth_sampler;
+    perfmon_counter_t overdue_pops;
+    perfmon_multi_membership_t stats_membership;
+    int64_t outstanding;
+
     accounting_queue_t<action_t *> queue;
     casting_passive_producer_t<action_t *, accounting_payload_t *> caster;
     scoped_ptr_t<auto_drainer_t> auto_drainer;
@@ -1,8 +1,10 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "arch/io/disk/conflict_resolving.hpp"
 
+#include <algorithm>
 #include <deque>
 #include <map>
+#include <vector>
 
 #include "perfmon/perfmon.hpp"
 
@@ -16,10 +18,15 @@ void debug_print(printf_buffer_t *buf,
 
 conflict_resolving_diskmgr_t::conflict_resolving_diskmgr_t(perfmon_collection_t *stats) :
     conflict_sampler(secs_to_ticks(1), true),
-    conflict_sampler_membership(stats, &conflict_sampler, "conflict")
+    coalesce_sampler(secs_to_ticks(1), true),
+    stats_membership(stats,
+                     &conflict_sampler, "conflict",
+                     &coalesce_sampler, "coalesced_writes")
 { }
 
 conflict_resolving_diskmgr_t::~conflict_resolving_diskmgr_t() {
+    rassert(ready_writes.empty());
+
     /* Make sure there are no requests still out. */
     for (std::map<fd_t, std::map<int64_t, std::deque<action_t *> > >::iterator
              fd_t_chunk_queues = all_chunk_queues.begin();
@@ -153,8 +160,7 @@ void conflict_resolving_diskmgr_t::submit(action_t *action) {
 
     /* If there are no conflicts, we can start right away. */
     if (action->conflict_count == 0) {
-        accounting_diskmgr_action_t *payload = action;
-        submit_fun(payload);
+        start_action(action);
     } else {
         // TODO: Refine the perfmon such that it measures the actual time that ops spend
         // in a waiting state
@@ -162,10 +168,128 @@ void conflict_resolving_diskmgr_t::submit(action_t *action) {
     }
 }
 
+void conflict_resolving_diskmgr_t::start_action(action_t *action) {
+#if USE_WRITEV
+    /* Datasync-wrapped writes are metablock writes; they don't have neighbors worth
+    waiting for. */
+    if (schedule_flush_fun && action->get_is_write() && !action->get_wrap_in_datasyncs()) {
+        if (ready_writes.empty()) {
+            schedule_flush_fun();
+        }
+        ready_writes.push_back(action);
+        return;
+    }
+#endif  // USE_WRITEV
+    accounting_diskmgr_action_t *payload = action;
+    submit_fun(payload);
+}
+
+bool ready_write_less(const conflict_resolving_diskmgr_action_t *a,
+                      const conflict_resolving_diskmgr_action_t *b) {
+    return a->get_fd() < b->get_fd()
+        || (a->get_fd() == b->get_fd() && a->get_offset() < b->get_offset());
+}
+
+void conflict_resolving_diskmgr_t::flush_ready_writes() {
+    /* Submitting may complete actions synchronously, which may make new writes
+    ready, so we detach the current batch first. */
+    std::vector<action_t *> writes;
+    writes.swap(ready_writes);
+
+    /* The ready writes are all at the front of their chunk queues, so none of them
+    overlap and we are free to reorder them. */
+    std::stable_sort(writes.begin(), writes.end(), &ready_write_less);
+
+    size_t i = 0;
+    while (i < writes.size()) {
+        std::vector<action_t *> run(1, writes[i]);
+        int64_t run_end = writes[i]->get_offset() + writes[i]->get_count();
+        size_t run_size = writes[i]->get_count();
+        ++i;
+        while (i < writes.size()
+               && writes[i]->get_fd() == run.front()->get_fd()
+               && writes[i]->account == run.front()->account
+               && writes[i]->get_offset() == run_end
+               && run_size + writes[i]->get_count() <= MAX_COALESCED_WRITE_SIZE) {
+            run.push_back(writes[i]);
+            run_end += writes[i]->get_count();
+            run_size += writes[i]->get_count();
+            ++i;
+        }
+
+        if (run.size() == 1) {
+            accounting_diskmgr_action_t *payload = run.front();
+            submit_fun(payload);
+        } else {
+            submit_coalesced_writes(std::move(run));
+        }
+    }
+}
+
+void conflict_resolving_diskmgr_t::submit_coalesced_writes(std::vector<action_t *> &&run) {
+#if USE_WRITEV
+    size_t total_count = 0;
+    size_t total_vecs = 0;
+    for (auto it = run.begin(); it != run.end(); ++it) {
+        iovec *vecs;
+        size_t vecs_len;
+        (*it)->get_bufs(&vecs, &vecs_len);
+        total_vecs += vecs_len;
+        total_count += (*it)->get_count();
+    }
+
+    scoped_array_t<iovec> iovecs(total_vecs);
+    size_t vec_index = 0;
+    for (auto it = run.begin(); it != run.end(); ++it) {
+        iovec *vecs;
+        size_t vecs_len;
+        (*it)->get_bufs(&vecs, &vecs_len);
+        std::copy(vecs, vecs + vecs_len, iovecs.data() + vec_index);
+        vec_index += vecs_len;
+    }
+
+    action_t *coalesced = new action_t;
+    coalesced->make_writev(run.front()->get_fd(), std::move(iovecs), total_count,
+                           run.front()->get_offset());
+    coalesced->account = run.front()->account;
+    coalesced->conflict_count = 0;
+    coalesce_sampler.record(run.size());
+    coalesced->coalesced_writes = std::move(run);
+
+    accounting_diskmgr_action_t *payload = coalesced;
+    submit_fun(payload);
+#else
+    // Without pwritev() there's nothing to gain; just run the writes one by one.
+    for (auto it = run.begin(); it != run.end(); ++it) {
+        accounting_diskmgr_action_t *payload = *it;
+        submit_fun(payload);
+    }
+#endif  // USE_WRITEV
+}
+
 void conflict_resolving_diskmgr_t::done(accounting_diskmgr_action_t *payload) {
     /* The only payloads we get back via done() should be payloads that we sent into
     submit_fun(), which means they should actually be action_t objects secretly. */
     action_t *action = static_cast<action_t *>(payload);
+
+    if (!action->coalesced_writes.empty()) {
+        /* This is an action we made up in submit_coalesced_writes(). Finish each of
+        the writes it ran in its place. */
+        std::vector<action_t *> writes;
+        writes.swap(action->coalesced_writes);
+        for (auto it = writes.begin(); it != writes.end(); ++it) {
+            (*it)->set_result_from(*action);
+        }
+        delete action;
+        for (auto it = writes.begin(); it != writes.end(); ++it) {
+            finish_action(*it);
+        }
+    } else {
+        finish_action(action);
+    }
+}
+
+void conflict_resolving_diskmgr_t::finish_action(action_t *action) {
     std::map<int64_t, std::deque<action_t *> > *chunk_queues = &all_chunk_queues[action->get_fd()];
 
     int64_t start, end;
@@ -220,12 +344,11 @@ void conflict_resolving_diskmgr_t::done(accounting_diskmgr_action_t *payload) {
                     that we just provided a subset of our data to. So that request might
                     not be able to short-circuit another watier, while we might have
                     been able. This should be more of an academic concern though. */
-                    done(waiter);
+                    finish_action(waiter);
 
                 } else {
                     /* The shortcut didn't work out; do things the normal way */
-                    accounting_diskmgr_action_t *waiter_payload = waiter;
-                    submit_fun(waiter_payload);
+                    start_action(waiter);
                 }
             }
         } else {
@@ -4,6 +4,7 @@
 
 #include <map>
 #include <deque>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/function.hpp>
@@ -50,11 +51,23 @@ functions:
     size_t get_count() const;
     void *get_buf() const;
 
-You should make a separate conflict_resolving_diskmgr_t for each file. */
+You should make a separate conflict_resolving_diskmgr_t for each file.
+
+If you provide a `schedule_flush_fun`, conflict_resolving_diskmgr_t also coalesces
+writes. Writes that are ready to run are then held back until the function you
+provided calls flush_ready_writes() (typically once per event loop iteration), and
+runs of writes that are contiguous in the same file and belong to the same account
+get sent down the chain as a single `pwritev()`. The data block manager writes
+blocks sequentially into the active extent, so flush bursts turn into a few large
+writes instead of many small ones. */
 
 
 struct conflict_resolving_diskmgr_action_t : public accounting_diskmgr_action_t {
     int conflict_count;
+
+    /* If this action was created by the conflict resolver to run several contiguous
+    writes at once, these are the writes. Otherwise it's empty. */
+    std::vector<conflict_resolving_diskmgr_action_t *> coalesced_writes;
 };
 
 void debug_print(printf_buffer_t *buf,
@@ -77,7 +90,22 @@ struct conflict_resolving_diskmgr_t {
     boost::function<void(accounting_diskmgr_action_t *)> submit_fun;
     void done(accounting_diskmgr_action_t *payload);
 
+    /* If set, conflict_resolving_diskmgr_t calls schedule_flush_fun() when it starts
+    holding back writes, and expects flush_ready_writes() to be called soon after. */
+    boost::function<void()> schedule_flush_fun;
+    void flush_ready_writes();
+
 private:
+    /* Sends an action that no longer conflicts with anything down the chain, or
+    holds it back in `ready_writes` to be coalesced. */
+    void start_action(action_t *action);
+
+    /* Sends a run of contiguous writes down the chain as a single action. */
+    void submit_coalesced_writes(std::vector<action_t *> &&run);
+
+    /* Does the work of done() for an action that was actually submitted by the user,
+    as opposed to one we made to coalesce writes. */
+    void finish_action(action_t *action);
 
     /* Memory usage analysis: If there are no conflicts, we use 1 bit of memory per
     DEVICE_BLOCK_SIZE-sized chunk of the file. */
@@ -101,8 +129,13 @@ private:
 
     std::map<fd_t, std::map<int64_t, std::deque<action_t *> > > all_chunk_queues;
 
+    /* Writes that conflict with nothing and are waiting for flush_ready_writes(), in
+    the order they became ready. */
+    std::vector<action_t *> ready_writes;
+
     perfmon_sampler_t conflict_sampler;
-    perfmon_membership_t conflict_sampler_membership;
+    perfmon_sampler_t coalesce_sampler;
+    perfmon_multi_membership_t stats_membership;
 };
 
 #endif /* ARCH_IO_DISK_CONFLICT_RESOLVING_HPP_ */
@@ -22,6 +22,7 @@
 
 struct iovec;
 class pool_diskmgr_t;
+class uring_diskmgr_t;
 
 /* The pool disk manager uses a thread pool in conjunction with synchronous
 (blocking) IO calls to asynchronously run IO requests. */
@@ -77,8 +78,14 @@ struct pool_diskmgr_action_t
     }
     size_t get_count() const { return buf_and_count.iov_len; }
     int64_t get_offset() const { return offset; }
+    bool get_wrap_in_datasyncs() const { return wrap_in_datasyncs; }
 
     void set_successful_due_to_conflict() { io_result = get_count(); }
+    // Gives this action the outcome of `other`, which performed this action's I/O as
+    // part of a bigger operation.
+    void set_result_from(const pool_diskmgr_action_t &other) {
+        io_result = other.get_succeeded() ? get_count() : other.io_result;
+    }
     bool get_succeeded() const { return io_result == static_cast<int64_t>(get_count()); }
     int get_errno() const {
         rassert(io_result < 0);
@@ -87,6 +94,9 @@ struct pool_diskmgr_action_t
 
 private:
     friend class pool_diskmgr_t;
+    // `uring_diskmgr_t` runs the same actions, but submits them to the kernel instead
+    // of to the blocker pool.
+    friend class uring_diskmgr_t;
     pool_diskmgr_t *parent;
 
     bool is_read;
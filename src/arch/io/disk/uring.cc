@@ -0,0 +1,278 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/io/disk/uring.hpp"
+
+#if USE_IO_URING
+
+#include <linux/io_uring.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "arch/io/disk.hpp"
+
+namespace {
+
+// The kernel refuses rings larger than 32768 entries; we stay well below that.
+const int MAX_URING_QUEUE_DEPTH = 4096;
+
+int uring_queue_depth(int max_concurrent_io_requests) {
+    guarantee(max_concurrent_io_requests > 0);
+    guarantee(max_concurrent_io_requests < MAXIMUM_MAX_CONCURRENT_IO_REQUESTS);
+    return std::min(max_concurrent_io_requests, MAX_URING_QUEUE_DEPTH);
+}
+
+int sys_io_uring_setup(unsigned entries, io_uring_params *params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                       unsigned flags) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                   static_cast<sigset_t *>(NULL), 0);
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+void *map_ring(int fd, size_t size, off_t offset) {
+    void *res = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     fd, offset);
+    guarantee_err(res != MAP_FAILED, "Could not map io_uring ring");
+    return res;
+}
+
+}  // namespace
+
+bool uring_diskmgr_t::is_supported() {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    scoped_fd_t fd(sys_io_uring_setup(1, &params));
+    if (fd.get() == INVALID_FD) {
+        return false;
+    }
+    eventfd_event_t event;
+    int event_fd = event.get_notify_fd();
+    int res = sys_io_uring_register(fd.get(), IORING_REGISTER_EVENTFD, &event_fd, 1);
+    return res == 0;
+}
+
+uring_diskmgr_t::request_t::request_t(action_t *_action)
+    : action(_action),
+      step(action->wrap_in_datasyncs ? LEADING_DATASYNC : TRANSFER),
+      iov_index(0),
+      partial_offset(action->get_offset()),
+      expected_result(0),
+      sum(0) { }
+
+uring_diskmgr_t::uring_diskmgr_t(linux_event_queue_t *_queue,
+                                 passive_producer_t<action_t *> *_source,
+                                 int max_concurrent_io_requests)
+    : queue_depth(uring_queue_depth(max_concurrent_io_requests)),
+      source(_source),
+      queue(_queue),
+      to_submit(0),
+      n_pending(0) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd.reset(sys_io_uring_setup(queue_depth, &params));
+    guarantee_err(ring_fd.get() != INVALID_FD, "Could not set up io_uring");
+    // Every pending action has at most one entry in flight, so this guarantees that
+    // neither ring can ever overflow.
+    guarantee(params.sq_entries >= static_cast<unsigned>(queue_depth));
+    guarantee(params.cq_entries >= static_cast<unsigned>(queue_depth));
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        sq_ring_ptr = map_ring(ring_fd.get(), sq_ring_size, IORING_OFF_SQ_RING);
+        cq_ring_ptr = NULL;
+    } else {
+        sq_ring_ptr = map_ring(ring_fd.get(), sq_ring_size, IORING_OFF_SQ_RING);
+        cq_ring_ptr = map_ring(ring_fd.get(), cq_ring_size, IORING_OFF_CQ_RING);
+    }
+    char *sq_base = static_cast<char *>(sq_ring_ptr);
+    char *cq_base = static_cast<char *>(cq_ring_ptr == NULL ? sq_ring_ptr : cq_ring_ptr);
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe *>(map_ring(ring_fd.get(), sqes_size,
+                                                IORING_OFF_SQES));
+
+    sq_tail = reinterpret_cast<unsigned *>(sq_base + params.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned *>(sq_base + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned *>(sq_base + params.sq_off.array);
+    cq_head = reinterpret_cast<unsigned *>(cq_base + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq_base + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned *>(cq_base + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq_base + params.cq_off.cqes);
+
+    int event_fd = completion_event.get_notify_fd();
+    int res = sys_io_uring_register(ring_fd.get(), IORING_REGISTER_EVENTFD, &event_fd, 1);
+    guarantee_err(res == 0, "Could not register eventfd with io_uring");
+    queue->watch_resource(completion_event.get_notify_fd(), poll_event_in, this);
+
+    if (source->available->get()) { pump(); }
+    source->available->set_callback(this);
+}
+
+uring_diskmgr_t::~uring_diskmgr_t() {
+    assert_thread();
+    rassert(n_pending == 0);
+    source->available->unset_callback();
+    queue->forget_resource(completion_event.get_notify_fd(), this);
+
+    munmap(sqes, sqes_size);
+    if (cq_ring_ptr != NULL) {
+        munmap(cq_ring_ptr, cq_ring_size);
+    }
+    munmap(sq_ring_ptr, sq_ring_size);
+    // ring_fd's destructor closes the ring.
+}
+
+void uring_diskmgr_t::on_source_availability_changed() {
+    assert_thread();
+    if (source->available->get()) pump();
+}
+
+void uring_diskmgr_t::on_event(DEBUG_VAR int events) {
+    assert_thread();
+    rassert(events == poll_event_in);
+    completion_event.consume_wakey_wakeys();
+    reap_completions();
+    pump();
+}
+
+void uring_diskmgr_t::pump() {
+    assert_thread();
+    while (source->available->get() && n_pending < queue_depth) {
+        action_t *a = source->pop();
+        n_pending++;
+        prepare_step(new request_t(a));
+    }
+    submit_pending();
+}
+
+void uring_diskmgr_t::prepare_step(request_t *request) {
+    const unsigned tail = *sq_tail;
+    const unsigned index = tail & sq_mask;
+    io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = request->action->get_fd();
+    sqe->user_data = reinterpret_cast<uintptr_t>(request);
+
+    switch (request->step) {
+    case request_t::LEADING_DATASYNC:
+    case request_t::TRAILING_DATASYNC:
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        break;
+    case request_t::TRANSFER: {
+        iovec *vecs;
+        size_t vecs_len;
+        request->action->get_bufs(&vecs, &vecs_len);
+        rassert(request->iov_index < vecs_len);
+        const size_t len = std::min<size_t>(IOV_MAX, vecs_len - request->iov_index);
+        request->expected_result = 0;
+        for (size_t i = request->iov_index; i < request->iov_index + len; ++i) {
+            request->expected_result += vecs[i].iov_len;
+        }
+        sqe->opcode = request->action->get_is_read() ? IORING_OP_READV : IORING_OP_WRITEV;
+        sqe->addr = reinterpret_cast<uintptr_t>(vecs + request->iov_index);
+        sqe->len = len;
+        sqe->off = request->partial_offset;
+    } break;
+    default:
+        unreachable();
+    }
+
+    sq_array[index] = index;
+    // Make the entry visible to the kernel before the tail moves past it.
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++to_submit;
+}
+
+void uring_diskmgr_t::submit_pending() {
+    while (to_submit > 0) {
+        int res = sys_io_uring_enter(ring_fd.get(), to_submit, 0, 0);
+        if (res == -1 && (get_errno() == EINTR || get_errno() == EAGAIN)) {
+            continue;
+        }
+        guarantee_err(res != -1, "io_uring_enter failed");
+        rassert(static_cast<unsigned>(res) <= to_submit);
+        to_submit -= res;
+    }
+}
+
+void uring_diskmgr_t::reap_completions() {
+    unsigned head = *cq_head;
+    for (;;) {
+        // Read the tail before the entries it covers.
+        const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            break;
+        }
+        for (; head != tail; ++head) {
+            const io_uring_cqe *cqe = &cqes[head & cq_mask];
+            request_t *request = reinterpret_cast<request_t *>(cqe->user_data);
+            const int32_t res = cqe->res;
+            // Release the slot before handling it, because handling may prepare
+            // further entries.
+            __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+            on_step_complete(request, res);
+        }
+    }
+    submit_pending();
+}
+
+void uring_diskmgr_t::on_step_complete(request_t *request, int32_t res) {
+    if (res < 0) {
+        finish_request(request, res);
+        return;
+    }
+
+    switch (request->step) {
+    case request_t::LEADING_DATASYNC:
+        request->step = request_t::TRANSFER;
+        prepare_step(request);
+        break;
+    case request_t::TRANSFER: {
+        // `pool_diskmgr_t` insists on complete transfers too.
+        guarantee(res == request->expected_result);
+        request->sum += res;
+        request->partial_offset += res;
+
+        iovec *vecs;
+        size_t vecs_len;
+        request->action->get_bufs(&vecs, &vecs_len);
+        request->iov_index += std::min<size_t>(IOV_MAX, vecs_len - request->iov_index);
+        if (request->iov_index < vecs_len) {
+            prepare_step(request);
+        } else if (request->action->wrap_in_datasyncs) {
+            request->step = request_t::TRAILING_DATASYNC;
+            prepare_step(request);
+        } else {
+            finish_request(request, request->sum);
+        }
+    } break;
+    case request_t::TRAILING_DATASYNC:
+        finish_request(request, request->sum);
+        break;
+    default:
+        unreachable();
+    }
+}
+
+void uring_diskmgr_t::finish_request(request_t *request, int64_t io_result) {
+    action_t *a = request->action;
+    delete request;
+    a->io_result = io_result;
+    n_pending--;
+    done_fun(a);
+}
+
+#endif  // USE_IO_URING
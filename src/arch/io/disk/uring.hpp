@@ -0,0 +1,120 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_URING_HPP_
+#define ARCH_IO_DISK_URING_HPP_
+
+#include <sys/uio.h>
+
+#include "errors.hpp"
+#include <boost/function.hpp>
+
+#include "arch/runtime/event_queue.hpp"
+#include "arch/io/disk/pool.hpp"
+#include "arch/io/io_utils.hpp"
+#include "concurrency/queue/passive_producer.hpp"
+
+#if !defined(__linux) || defined(NO_IO_URING) || defined(NO_EVENTFD) || !USE_WRITEV
+#define USE_IO_URING 0
+#else
+#define USE_IO_URING 1
+#endif
+
+#if USE_IO_URING
+
+#include "arch/runtime/system_event/eventfd_event.hpp"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/* The uring disk manager runs the same actions as `pool_diskmgr_t`, but instead of
+handing them to blocker pool threads that make blocking `preadv()`/`pwritev()` calls,
+it submits them directly to the kernel through an io_uring submission queue.
+Completions are signalled through an eventfd that is watched by the thread's event
+queue, so an I/O operation never leaves the disk manager's home thread.
+
+Linux 5.2 or newer is needed (for `IORING_REGISTER_EVENTFD`); use
+`uring_diskmgr_t::is_supported()` to check before constructing one. */
+
+class uring_diskmgr_t : private availability_callback_t,
+                        private linux_event_callback_t,
+                        public home_thread_mixin_debug_only_t {
+public:
+    typedef pool_diskmgr_t::action_t action_t;
+
+    /* The `uring_diskmgr_t` will draw actions to run from `source`. It will call
+    `done_fun` on each one when it's done. */
+    uring_diskmgr_t(linux_event_queue_t *queue, passive_producer_t<action_t *> *source,
+                    int max_concurrent_io_requests);
+    boost::function<void(action_t *)> done_fun;
+    ~uring_diskmgr_t();
+
+    /* Returns true if the running kernel lets us set up an io_uring and attach an
+    eventfd to it. (Seccomp profiles of some container runtimes deny the syscalls
+    even on new kernels.) */
+    static bool is_supported();
+
+private:
+    /* An action is run as a sequence of steps, each of which is a single submission
+    queue entry: an optional leading datasync, one `readv`/`writev` per `IOV_MAX`
+    iovecs, and an optional trailing datasync. */
+    struct request_t {
+        enum step_t { LEADING_DATASYNC, TRANSFER, TRAILING_DATASYNC };
+
+        explicit request_t(action_t *_action);
+
+        action_t *action;
+        step_t step;
+        // The index of the first iovec and the file offset of the transfer that is
+        // currently in flight.
+        size_t iov_index;
+        int64_t partial_offset;
+        // How many bytes the transfer in flight covers.
+        int64_t expected_result;
+        ssize_t sum;
+    };
+
+    void on_source_availability_changed();
+    void on_event(int events);
+
+    void pump();
+    void prepare_step(request_t *request);
+    void submit_pending();
+    void reap_completions();
+    void on_step_complete(request_t *request, int32_t res);
+    void finish_request(request_t *request, int64_t io_result);
+
+    const int queue_depth;
+    passive_producer_t<action_t *> *source;
+    linux_event_queue_t *queue;
+
+    // The io_uring file descriptor and the shared memory rings that belong to it.
+    scoped_fd_t ring_fd;
+    void *sq_ring_ptr;
+    size_t sq_ring_size;
+    void *cq_ring_ptr;
+    size_t cq_ring_size;
+    io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    io_uring_cqe *cqes;
+
+    // Submission queue entries that have been filled in but not yet passed to
+    // `io_uring_enter()`.
+    unsigned to_submit;
+
+    eventfd_event_t completion_event;
+
+    // The number of actions that have been popped from `source` but not finished.
+    int n_pending;
+
+    DISABLE_COPYING(uring_diskmgr_t);
+};
+
+#endif  // USE_IO_URING
+
+#endif  // ARCH_IO_DISK_URING_HPP_
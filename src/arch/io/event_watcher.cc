@@ -49,7 +49,7 @@ linux_event_watcher_t::watch_t::~watch_t() {
 
 bool linux_event_watcher_t::is_watching(int event) {
     assert_thread();
-    return *get_watch_slot(event) == NULL;
+    return *get_watch_slot(event) != NULL;
 }
 
 linux_event_watcher_t::watch_t **linux_event_watcher_t::get_watch_slot(int event) {
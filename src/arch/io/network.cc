@@ -4,6 +4,7 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/tcp.h>
@@ -15,6 +16,8 @@
 #include "utils.hpp"
 #include <boost/bind.hpp>
 
+#include "arch/runtime/coro_wait_profiler.hpp"
+#include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "arch/timing.hpp"
@@ -87,6 +90,18 @@ int create_socket_wrapper(int address_family) {
     return res;
 }
 
+// With `--busy-poll`, ask the kernel to busy-poll the device queue for this socket
+// too.  Raising it past `net.core.busy_read` needs CAP_NET_ADMIN, and older kernels
+// don't have it at all, so failing just means we don't get it.
+void maybe_set_busy_poll(UNUSED fd_t sock) {
+#ifdef SO_BUSY_POLL
+    int usec = get_event_queue_busy_poll_usec();
+    if (usec > 0) {
+        UNUSED int res = setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec));
+    }
+#endif
+}
+
 // Network connection object
 linux_tcp_conn_t::linux_tcp_conn_t(const ip_address_t &peer,
                                    int port,
@@ -95,6 +110,10 @@ linux_tcp_conn_t::linux_tcp_conn_t(const ip_address_t &peer,
         write_perfmon(NULL),
         sock(create_socket_wrapper(peer.get_address_family())),
         event_watcher(new linux_event_watcher_t(sock.get(), this)),
+        tls_sends_in_kernel(false),
+        buffer_memory(memory_category_t::network_buffers),
+        read_buffer_start(0), read_buffer_end(0),
+        read_chunk_size(IO_BUFFER_SIZE),
         read_in_progress(false), write_in_progress(false),
         write_handler(this),
         write_queue_limiter(WRITE_QUEUE_MAX_SIZE),
@@ -102,6 +121,7 @@ linux_tcp_conn_t::linux_tcp_conn_t(const ip_address_t &peer,
         current_write_buffer(get_write_buffer()),
         drainer(new auto_drainer_t) {
     guarantee_err(fcntl(sock.get(), F_SETFL, O_NONBLOCK) == 0, "Could not make socket non-blocking");
+    maybe_set_busy_poll(sock.get());
 
     if (local_port != 0) {
         // Set the socket to reusable so we don't block out other sockets from this port
@@ -141,6 +161,10 @@ linux_tcp_conn_t::linux_tcp_conn_t(fd_t s) :
     write_perfmon(NULL),
     sock(s),
     event_watcher(new linux_event_watcher_t(sock.get(), this)),
+    tls_sends_in_kernel(false),
+    buffer_memory(memory_category_t::network_buffers),
+    read_buffer_start(0), read_buffer_end(0),
+    read_chunk_size(IO_BUFFER_SIZE),
     read_in_progress(false), write_in_progress(false),
     write_handler(this),
     write_queue_limiter(WRITE_QUEUE_MAX_SIZE),
@@ -152,6 +176,8 @@ linux_tcp_conn_t::linux_tcp_conn_t(fd_t s) :
 
     int res = fcntl(sock.get(), F_SETFL, O_NONBLOCK);
     guarantee_err(res == 0, "Could not make socket non-blocking");
+
+    maybe_set_busy_poll(sock.get());
 }
 
 linux_tcp_conn_t::write_buffer_t * linux_tcp_conn_t::get_write_buffer() {
@@ -159,6 +185,7 @@ linux_tcp_conn_t::write_buffer_t * linux_tcp_conn_t::get_write_buffer() {
 
     if (unused_write_buffers.empty()) {
         buffer = new write_buffer_t;
+        buffer_memory.add(sizeof(write_buffer_t));
     } else {
         buffer = unused_write_buffers.head();
         unused_write_buffers.pop_front();
@@ -193,15 +220,16 @@ size_t linux_tcp_conn_t::read_internal(void *buffer, size_t size) THROWS_ONLY(tc
     rassert(!read_closed.is_pulsed());
 
     while (true) {
-        ssize_t res = ::read(sock.get(), buffer, size);
+        int event = poll_event_in;
+        ssize_t res = tls.has()
+            ? tls->read(buffer, size, &event)
+            : ::read(sock.get(), buffer, size);
 
         if (res == -1 && (get_errno() == EAGAIN || get_errno() == EWOULDBLOCK)) {
             /* There's no data available right now, so we must wait for a notification from the
             epoll queue, or for an order to shut down. */
 
-            linux_event_watcher_t::watch_t watch(event_watcher.get(), poll_event_in);
-            wait_any_t waiter(&watch, &read_closed);
-            waiter.wait_lazily_unordered();
+            wait_for_event(event, &read_closed);
 
             if (read_closed.is_pulsed()) {
                 /* We were closed for whatever reason. Something else has already called
@@ -235,11 +263,11 @@ size_t linux_tcp_conn_t::read_some(void *buf, size_t size, signal_t *closer) THR
     rassert(size > 0);
     read_op_wrapper_t sentry(this, closer);
 
-    if (read_buffer.size()) {
+    if (read_buffer_size() > 0) {
         /* Return the data from the peek buffer */
-        size_t read_buffer_bytes = std::min(read_buffer.size(), size);
-        memcpy(buf, read_buffer.data(), read_buffer_bytes);
-        read_buffer.erase(read_buffer.begin(), read_buffer.begin() + read_buffer_bytes);
+        size_t read_buffer_bytes = std::min(read_buffer_size(), size);
+        memcpy(buf, read_buffer_data(), read_buffer_bytes);
+        consume_read_buffer(read_buffer_bytes);
         return read_buffer_bytes;
     } else {
         /* Go to the kernel _once_. */
@@ -251,9 +279,9 @@ void linux_tcp_conn_t::read(void *buf, size_t size, signal_t *closer) THROWS_ONL
     read_op_wrapper_t sentry(this, closer);
 
     /* First, consume any data in the peek buffer */
-    int read_buffer_bytes = std::min(read_buffer.size(), size);
-    memcpy(buf, read_buffer.data(), read_buffer_bytes);
-    read_buffer.erase(read_buffer.begin(), read_buffer.begin() + read_buffer_bytes);
+    size_t read_buffer_bytes = std::min(read_buffer_size(), size);
+    memcpy(buf, read_buffer_data(), read_buffer_bytes);
+    consume_read_buffer(read_buffer_bytes);
     buf = reinterpret_cast<void *>(reinterpret_cast<char *>(buf) + read_buffer_bytes);
     size -= read_buffer_bytes;
 
@@ -269,11 +297,49 @@ void linux_tcp_conn_t::read(void *buf, size_t size, signal_t *closer) THROWS_ONL
 void linux_tcp_conn_t::read_more_buffered(signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
     read_op_wrapper_t sentry(this, closer);
 
-    size_t old_size = read_buffer.size();
-    read_buffer.resize(old_size + IO_BUFFER_SIZE);
-    size_t delta = read_internal(read_buffer.data() + old_size, IO_BUFFER_SIZE);
+    reserve_read_buffer(read_chunk_size);
+    size_t delta = read_internal(read_buffer.data() + read_buffer_end, read_chunk_size);
+    read_buffer_end += delta;
+
+    if (delta == read_chunk_size && read_chunk_size < MAX_READ_CHUNK_SIZE) {
+        read_chunk_size *= 2;
+    } else if (delta < read_chunk_size / 4) {
+        read_chunk_size = std::max<size_t>(read_chunk_size / 2, IO_BUFFER_SIZE);
+    }
+}
 
-    read_buffer.resize(old_size + delta);
+void linux_tcp_conn_t::consume_read_buffer(size_t size) {
+    rassert(size <= read_buffer_size());
+    read_buffer_start += size;
+    if (read_buffer_start == read_buffer_end) {
+        read_buffer_start = read_buffer_end = 0;
+        /* Don't hold on to the room a huge message needed */
+        if (read_buffer.size() > 2 * MAX_READ_CHUNK_SIZE) {
+            buffer_memory.add(-static_cast<int64_t>(read_buffer.size()));
+            read_buffer.reset();
+        }
+    }
+}
+
+void linux_tcp_conn_t::reserve_read_buffer(size_t size) {
+    if (read_buffer_end + size <= read_buffer.size()) {
+        return;
+    }
+
+    const size_t buffered = read_buffer_size();
+    if (buffered + size <= read_buffer.size() && buffered <= read_buffer_start) {
+        /* There's room if we move the data to the front, and that costs no more than
+        what was consumed to make the room. */
+        memmove(read_buffer.data(), read_buffer_data(), buffered);
+    } else {
+        scoped_array_t<char> new_buffer(std::max(buffered + size, read_buffer.size() * 2));
+        memcpy(new_buffer.data(), read_buffer_data(), buffered);
+        buffer_memory.add(static_cast<int64_t>(new_buffer.size())
+                          - static_cast<int64_t>(read_buffer.size()));
+        read_buffer.swap(new_buffer);
+    }
+    read_buffer_start = 0;
+    read_buffer_end = buffered;
 }
 
 const_charslice linux_tcp_conn_t::peek() const THROWS_ONLY(tcp_conn_read_closed_exc_t) {
@@ -281,14 +347,14 @@ const_charslice linux_tcp_conn_t::peek() const THROWS_ONLY(tcp_conn_read_closed_
     rassert(!read_in_progress);   // Is there a read already in progress?
     if (read_closed.is_pulsed()) throw tcp_conn_read_closed_exc_t();
 
-    return const_charslice(read_buffer.data(), read_buffer.data() + read_buffer.size());
+    return const_charslice(read_buffer_data(), read_buffer_data() + read_buffer_size());
 }
 
 const_charslice linux_tcp_conn_t::peek(size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
-    while (read_buffer.size() < size) {
+    while (read_buffer_size() < size) {
         read_more_buffered(closer);
     }
-    return const_charslice(read_buffer.data(), read_buffer.data() + size);
+    return const_charslice(read_buffer_data(), read_buffer_data() + size);
 }
 
 void linux_tcp_conn_t::pop(size_t len, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
@@ -297,7 +363,7 @@ void linux_tcp_conn_t::pop(size_t len, signal_t *closer) THROWS_ONLY(tcp_conn_re
     if (read_closed.is_pulsed()) throw tcp_conn_read_closed_exc_t();
 
     peek(len, closer);
-    read_buffer.erase(read_buffer.begin(), read_buffer.begin() + len);  // INEFFICIENT
+    consume_read_buffer(len);
 }
 
 void linux_tcp_conn_t::shutdown_read() {
@@ -325,7 +391,9 @@ linux_tcp_conn_t::write_handler_t::write_handler_t(linux_tcp_conn_t *_parent) :
 { }
 
 void linux_tcp_conn_t::write_handler_t::coro_pool_callback(write_queue_op_t *operation, UNUSED signal_t *interruptor) {
-    if (operation->buffer != NULL) {
+    if (operation->bufs != NULL) {
+        parent->perform_writev(operation->bufs, operation->count);
+    } else if (operation->buffer != NULL) {
         parent->perform_write(operation->buffer, operation->size);
         if (operation->dealloc != NULL) {
             parent->release_write_buffer(operation->dealloc);
@@ -351,6 +419,7 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
     op->buffer = current_write_buffer->buffer;
     op->size = current_write_buffer->size;
     op->dealloc = current_write_buffer.release();
+    op->bufs = NULL;
     op->cond = NULL;
     op->keepalive = auto_drainer_t::lock_t(drainer.get());
     current_write_buffer.init(get_write_buffer());
@@ -365,6 +434,13 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
 }
 
 void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
+    iovec buf_vec;
+    buf_vec.iov_base = const_cast<void *>(buf);
+    buf_vec.iov_len = size;
+    perform_writev(&buf_vec, 1);
+}
+
+void linux_tcp_conn_t::perform_writev(iovec *bufs, size_t count) {
     assert_thread();
 
     if (write_closed.is_pulsed()) {
@@ -374,15 +450,22 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
         return;
     }
 
-    while (size > 0) {
-        ssize_t res = ::write(sock.get(), buf, size);
+    while (count > 0) {
+        if (bufs->iov_len == 0) {
+            ++bufs;
+            --count;
+            continue;
+        }
+
+        int event = poll_event_out;
+        ssize_t res = tls.has() && !tls_sends_in_kernel
+            ? tls->write(bufs->iov_base, bufs->iov_len, &event)
+            : ::writev(sock.get(), bufs, std::min<size_t>(count, IOV_MAX));
 
         if (res == -1 && (get_errno() == EAGAIN || get_errno() == EWOULDBLOCK)) {
             /* Wait for a notification from the event queue, or for an order to
             shut down */
-            linux_event_watcher_t::watch_t watch(event_watcher.get(), poll_event_out);
-            wait_any_t waiter(&watch, &write_closed);
-            waiter.wait_lazily_unordered();
+            wait_for_event(event, &write_closed);
 
             if (write_closed.is_pulsed()) {
                 /* We were closed for whatever reason. Whatever signalled us has already called
@@ -408,19 +491,79 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
         } else if (res == 0) {
             /* This should never happen either, but it's better to write an error message than to
                crash completely. */
-            logERR("Didn't expect write() to return 0.");
+            logERR("Didn't expect a write to return 0.");
             on_shutdown_write();
             break;
 
         } else {
-            rassert(res <= static_cast<ssize_t>(size));
-            buf = reinterpret_cast<const void *>(reinterpret_cast<const char *>(buf) + res);
-            size -= res;
             if (write_perfmon) write_perfmon->record(res);
+            size_t written = res;
+            while (written > 0) {
+                rassert(count > 0);
+                if (written >= bufs->iov_len) {
+                    written -= bufs->iov_len;
+                    ++bufs;
+                    --count;
+                } else {
+                    bufs->iov_base = static_cast<char *>(bufs->iov_base) + written;
+                    bufs->iov_len -= written;
+                    written = 0;
+                }
+            }
         }
     }
 }
 
+bool linux_tcp_conn_t::start_tls(tls_ctx_t *ctx, tls_role_t role, signal_t *closer) {
+    try {
+        read_op_wrapper_t read_sentry(this, closer);
+        write_op_wrapper_t write_sentry(this, closer);
+        rassert(!tls.has());
+        rassert(read_buffer_size() == 0);
+
+        tls.init(new tls_conn_t(ctx, sock.get(), role));
+        while (true) {
+            int event;
+            int res = tls->handshake(&event);
+            if (res == 1) {
+                tls_sends_in_kernel = tls->kernel_sends();
+                return true;
+            } else if (res == -1 && get_errno() == EAGAIN) {
+                wait_any_t closed(&read_closed, &write_closed);
+                wait_for_event(event, &closed);
+                if (closed.is_pulsed()) {
+                    break;
+                }
+            } else {
+                break;
+            }
+        }
+    } catch (const tcp_conn_read_closed_exc_t &) {
+    } catch (const tcp_conn_write_closed_exc_t &) {
+    }
+
+    if (is_read_open()) shutdown_read();
+    if (is_write_open()) shutdown_write();
+    return false;
+}
+
+void linux_tcp_conn_t::wait_for_event(int event, signal_t *closed) {
+    coro_wait_site_t wait_site(event == poll_event_in ? "network read" : "network write");
+    if (event_watcher->is_watching(event)) {
+        /* With TLS, reading can have to wait until the socket is writable and vice
+        versa, in which case the other direction may already be waiting for the same
+        event. It will wake up when the event arrives, so we check back soon. */
+        signal_timer_t timer;
+        timer.start(1);
+        wait_any_t waiter(&timer, closed);
+        waiter.wait_lazily_unordered();
+    } else {
+        linux_event_watcher_t::watch_t watch(event_watcher.get(), event);
+        wait_any_t waiter(&watch, closed);
+        waiter.wait_lazily_unordered();
+    }
+}
+
 void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     write_op_wrapper_t sentry(this, closer);
 
@@ -436,6 +579,7 @@ void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THR
     /* Enqueue the write so it will happen eventually */
     op.buffer = buf;
     op.size = size;
+    op.bufs = NULL;
     op.dealloc = NULL;
     op.cond = &to_signal_when_done;
     write_queue.push(&op);
@@ -443,7 +587,39 @@ void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THR
     /* Wait for the write to be done. If the write half of the network connection
     is closed before or during our write, then `perform_write()` will turn into a
     no-op, so the cond will still get pulsed. */
-    to_signal_when_done.wait();
+    {
+        coro_wait_site_t wait_site("network write");
+        to_signal_when_done.wait();
+    }
+
+    if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
+}
+
+void linux_tcp_conn_t::writev(const iovec *bufs, size_t count, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+    write_op_wrapper_t sentry(this, closer);
+
+    write_queue_op_t op;
+    cond_t to_signal_when_done;
+
+    /* Flush out any data that's been buffered, so that things don't get out of order */
+    if (current_write_buffer->size > 0) internal_flush_write_buffer();
+
+    /* `perform_writev()` adjusts the buffers as it goes, so it gets a copy. The data
+    itself isn't copied; like `write()`, we block until it has all been sent. */
+    scoped_array_t<iovec> bufs_copy(count);
+    std::copy(bufs, bufs + count, bufs_copy.data());
+
+    op.buffer = NULL;
+    op.bufs = bufs_copy.data();
+    op.count = count;
+    op.dealloc = NULL;
+    op.cond = &to_signal_when_done;
+    write_queue.push(&op);
+
+    {
+        coro_wait_site_t wait_site("network write");
+        to_signal_when_done.wait();
+    }
 
     if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
 }
@@ -495,10 +671,14 @@ void linux_tcp_conn_t::flush_buffer(signal_t *closer) THROWS_ONLY(tcp_conn_write
     write_queue_op_t op;
     cond_t to_signal_when_done;
     op.buffer = NULL;
+    op.bufs = NULL;
     op.dealloc = NULL;
     op.cond = &to_signal_when_done;
     write_queue.push(&op);
-    to_signal_when_done.wait();
+    {
+        coro_wait_site_t wait_site("network write");
+        to_signal_when_done.wait();
+    }
 
     if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
 }
@@ -633,11 +813,13 @@ void linux_tcp_conn_descriptor_t::make_overcomplicated(linux_tcp_conn_t **tcp_co
 /* Network listener object */
 linux_nonthrowing_tcp_listener_t::linux_nonthrowing_tcp_listener_t(
         const std::set<ip_address_t> &bind_addresses, int _port,
-        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &cb) :
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &cb,
+        bool _reuse_port) :
     callback(cb),
     local_addresses(bind_addresses),
     port(_port),
     bound(false),
+    reuse_port(_reuse_port),
     socks(),
     last_used_socket_index(0),
     event_watchers(),
@@ -720,6 +902,17 @@ int linux_nonthrowing_tcp_listener_t::init_sockets() {
          */
         res = setsockopt(sock_fd, IPPROTO_TCP, TCP_NODELAY, &sockoptval, sizeof(sockoptval));
         guarantee_err(res != -1, "Could not set TCP_NODELAY option");
+
+        if (reuse_port) {
+#ifdef SO_REUSEPORT
+            res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &sockoptval, sizeof(sockoptval));
+            if (res != 0) {
+                return get_errno();
+            }
+#else
+            return ENOPROTOOPT;
+#endif
+        }
     }
     return 0;
 }
@@ -975,6 +1168,76 @@ int linux_tcp_listener_t::get_port() const {
     return listener->get_port();
 }
 
+// Checks whether the kernel lets us bind several listening sockets to one port.
+static bool reuse_port_supported() {
+#ifdef SO_REUSEPORT
+    scoped_fd_t sock(socket(AF_INET, SOCK_STREAM, 0));
+    if (sock.get() == INVALID_FD) {
+        return false;
+    }
+    int sockoptval = 1;
+    return setsockopt(sock.get(), SOL_SOCKET, SO_REUSEPORT,
+                      &sockoptval, sizeof(sockoptval)) == 0;
+#else
+    return false;
+#endif
+}
+
+linux_sharded_tcp_listener_t::linux_sharded_tcp_listener_t(
+    const std::set<ip_address_t> &bind_addresses,
+    int _port,
+    const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback) :
+        sharded(can_shard()),
+        port(_port),
+        listeners(sharded ? get_num_db_threads() : 1)
+{
+    // The listeners start one at a time, so that if we were given `ANY_PORT` the first
+    // one picks a port and the others bind to the same one.
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        bool listening;
+        {
+            on_thread_t thread_switcher(get_listener_thread(i));
+            listeners[i].init(new linux_nonthrowing_tcp_listener_t(
+                bind_addresses, port, callback, sharded));
+            listening = listeners[i]->begin_listening();
+            port = listeners[i]->get_port();
+        }
+        if (!listening) {
+            reset_listeners();
+            throw address_in_use_exc_t("localhost", port);
+        }
+    }
+}
+
+bool linux_sharded_tcp_listener_t::can_shard() {
+    return get_num_db_threads() > 1 && reuse_port_supported();
+}
+
+linux_sharded_tcp_listener_t::~linux_sharded_tcp_listener_t() {
+    reset_listeners();
+}
+
+int linux_sharded_tcp_listener_t::get_port() const {
+    return port;
+}
+
+bool linux_sharded_tcp_listener_t::is_sharded() const {
+    return sharded;
+}
+
+threadnum_t linux_sharded_tcp_listener_t::get_listener_thread(size_t i) const {
+    return sharded ? threadnum_t(static_cast<int32_t>(i)) : home_thread();
+}
+
+void linux_sharded_tcp_listener_t::reset_listeners() {
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        if (listeners[i].has()) {
+            on_thread_t thread_switcher(get_listener_thread(i));
+            listeners[i].reset();
+        }
+    }
+}
+
 linux_repeated_nonthrowing_tcp_listener_t::linux_repeated_nonthrowing_tcp_listener_t(
     const std::set<ip_address_t> &bind_addresses,
     int port,
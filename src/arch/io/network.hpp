@@ -5,6 +5,7 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <ifaddrs.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -22,6 +23,7 @@
 #include "arch/address.hpp"
 #include "arch/io/event_watcher.hpp"
 #include "arch/io/io_utils.hpp"
+#include "arch/io/tls.hpp"
 #include "arch/runtime/event_queue.hpp"
 #include "arch/types.hpp"
 #include "concurrency/cond_var.hpp"
@@ -29,6 +31,7 @@
 #include "concurrency/semaphore.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "containers/intrusive_list.hpp"
+#include "perfmon/memory.hpp"
 #include "perfmon/types.hpp"
 
 /* linux_tcp_conn_t provides a disgusting wrapper around a TCP network connection. */
@@ -58,6 +61,12 @@ public:
     // NB. interruptor cannot be NULL.
     linux_tcp_conn_t(const ip_address_t &host, int port, signal_t *interruptor, int local_port = ANY_PORT) THROWS_ONLY(connect_failed_exc_t, interrupted_exc_t);
 
+    /* start_tls() runs a TLS handshake over the connection, after which everything
+    read and written is encrypted. It must be called before any data is read or
+    written. Returns false, with the connection shut down, if the handshake fails
+    (which is logged), the connection closes, or `closer` is pulsed. */
+    MUST_USE bool start_tls(tls_ctx_t *ctx, tls_role_t role, signal_t *closer);
+
     /* Reading */
 
     /* If you know beforehand how many bytes you want to read, use read() with a
@@ -104,6 +113,10 @@ public:
     pipe and throws `tcp_conn_write_closed_exc_t`. */
     void write(const void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
 
+    /* writev() is like write(), but sends the `count` buffers in `bufs` one after
+    another, in as few system calls as it can, without copying them. */
+    void writev(const iovec *bufs, size_t count, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
+
     /* write_buffered() is like write(), but it might not send the data until
     flush_buffer*() or write() is called. Internally, it bundles together the
     buffered writes; this may improve performance. */
@@ -217,14 +230,41 @@ private:
     thread, and otherwise is an object that's valid for the current thread. */
     scoped_ptr_t<linux_event_watcher_t> event_watcher;
 
+    /* Set by `start_tls()`. If the kernel encrypts what we send, we write to the
+    socket directly and only go through `tls` to read. */
+    scoped_ptr_t<tls_conn_t> tls;
+    bool tls_sends_in_kernel;
+
+    /* Waits until `event` arrives on the socket or `closed` is pulsed. */
+    void wait_for_event(int event, signal_t *closed);
+
     /* True if there is a pending read or write */
     bool read_in_progress, write_in_progress;
 
     /* These are pulsed if and only if the read/write end of the connection has been closed. */
     cond_t read_closed, write_closed;
 
-    /* Holds data that we read from the socket but hasn't been consumed yet */
-    std::vector<char> read_buffer;
+    /* Counts `read_buffer` and the write buffers in the node's memory accounting. */
+    memory_accounted_t buffer_memory;
+
+    /* Holds data that we read from the socket but hasn't been consumed yet, which is
+    `read_buffer[read_buffer_start, read_buffer_end)`. Consuming data just moves
+    `read_buffer_start`; what's left is only moved to the front when we need the
+    room. */
+    scoped_array_t<char> read_buffer;
+    size_t read_buffer_start, read_buffer_end;
+
+    /* How much `read_more_buffered()` asks the kernel for. It doubles whenever a
+    read fills it, so large messages take fewer calls, and halves when reads come
+    back mostly empty. */
+    size_t read_chunk_size;
+    static const size_t MAX_READ_CHUNK_SIZE = 256 * KILOBYTE;
+
+    size_t read_buffer_size() const { return read_buffer_end - read_buffer_start; }
+    const char *read_buffer_data() const { return read_buffer.data() + read_buffer_start; }
+    void consume_read_buffer(size_t size);
+    /* Makes room for at least `size` more bytes after `read_buffer_end` */
+    void reserve_read_buffer(size_t size);
 
     /* Reads up to the given number of bytes, but not necessarily that many. Simple wrapper around
     ::read(). Returns the number of bytes read or throws tcp_conn_read_closed_exc_t. Bypasses read_buffer. */
@@ -243,6 +283,9 @@ private:
         write_buffer_t *dealloc;
         const void *buffer;
         size_t size;
+        /* If non-NULL, the op writes these `count` buffers instead of `buffer` */
+        iovec *bufs;
+        size_t count;
         cond_t *cond;
         auto_drainer_t::lock_t keepalive;
     };
@@ -301,6 +344,9 @@ private:
     `size` bytes from `buffer` to the socket. */
     void perform_write(const void *buffer, size_t size);
 
+    /* Like `perform_write()`, but writes `count` buffers. Uses up `bufs` as it goes. */
+    void perform_writev(iovec *bufs, size_t count);
+
     scoped_ptr_t<auto_drainer_t> drainer;
 };
 
@@ -331,8 +377,11 @@ the provided callback will be called in a new coroutine every time something con
 
 class linux_nonthrowing_tcp_listener_t : private linux_event_callback_t {
 public:
+    // With `_reuse_port`, the sockets are made with SO_REUSEPORT so that other
+    // listeners can bind the same port (see `linux_sharded_tcp_listener_t`).
     linux_nonthrowing_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int _port,
-        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback);
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback,
+        bool _reuse_port = false);
 
     ~linux_nonthrowing_tcp_listener_t();
 
@@ -375,6 +424,9 @@ private:
     // Inidicates successful binding to a port
     bool bound;
 
+    // Whether to set SO_REUSEPORT on our sockets
+    const bool reuse_port;
+
     // The sockets to listen for connections on
     scoped_array_t<scoped_fd_t> socks;
 
@@ -430,6 +482,38 @@ private:
     auto_drainer_t drainer;
 };
 
+/* Listens on a port with a set of sockets on every db thread, all bound with
+SO_REUSEPORT, so that the kernel spreads new connections between the threads and
+each connection is accepted on the thread that will serve it. `callback` is called
+on whichever thread accepted the connection, so it must be safe to call from any
+thread. Where SO_REUSEPORT isn't available this is a single listener on the current
+thread instead; `is_sharded()` tells the two apart. Throws `address_in_use_exc_t`
+like `linux_tcp_listener_t`. */
+class linux_sharded_tcp_listener_t : public home_thread_mixin_t {
+public:
+    linux_sharded_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int port,
+        const boost::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t>&)> &callback);
+    ~linux_sharded_tcp_listener_t();
+
+    // Whether a listener made now would be sharded
+    static bool can_shard();
+
+    int get_port() const;
+    bool is_sharded() const;
+
+private:
+    threadnum_t get_listener_thread(size_t i) const;
+    void reset_listeners();
+
+    bool sharded;
+    int port;
+
+    // One per db thread if we're sharded, otherwise just one on the home thread
+    scoped_array_t<scoped_ptr_t<linux_nonthrowing_tcp_listener_t> > listeners;
+
+    DISABLE_COPYING(linux_sharded_tcp_listener_t);
+};
+
 std::vector<std::string> get_ips();
 
 #endif // ARCH_IO_NETWORK_HPP_
@@ -0,0 +1,158 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/io/tls.hpp"
+
+#include <errno.h>
+#include <limits.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <algorithm>
+
+#include "arch/runtime/event_queue.hpp"
+#include "logger.hpp"
+#include "utils.hpp"
+
+// Describes and clears the calling thread's OpenSSL errors
+static std::string get_tls_errors() {
+    std::string ret;
+    while (unsigned long err = ERR_get_error()) {  // NOLINT(runtime/int)
+        char buf[256];
+        ERR_error_string_n(err, buf, sizeof(buf));
+        ret += ret.empty() ? "" : "; ";
+        ret += buf;
+    }
+    return ret.empty() ? "unknown error" : ret;
+}
+
+tls_ctx_t::tls_ctx_t(const std::string &cert_file,
+                     const std::string &key_file,
+                     const std::string &ca_file) THROWS_ONLY(tls_error_exc_t) {
+    ctx = SSL_CTX_new(TLS_method());
+    guarantee(ctx != NULL, "Could not create TLS context: %s", get_tls_errors().c_str());
+
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    // Writes may send only part of the buffer, like `::write()` does
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE);
+#ifdef SSL_OP_ENABLE_KTLS
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+
+    if (SSL_CTX_use_certificate_chain_file(ctx, cert_file.c_str()) != 1) {
+        std::string errors = get_tls_errors();
+        SSL_CTX_free(ctx);
+        throw tls_error_exc_t(strprintf("Could not load TLS certificate from '%s': %s",
+                                        cert_file.c_str(), errors.c_str()));
+    }
+    if (SSL_CTX_use_PrivateKey_file(ctx, key_file.c_str(), SSL_FILETYPE_PEM) != 1
+        || SSL_CTX_check_private_key(ctx) != 1) {
+        std::string errors = get_tls_errors();
+        SSL_CTX_free(ctx);
+        throw tls_error_exc_t(strprintf("Could not load TLS key from '%s': %s",
+                                        key_file.c_str(), errors.c_str()));
+    }
+    if (!ca_file.empty()) {
+        if (SSL_CTX_load_verify_locations(ctx, ca_file.c_str(), NULL) != 1) {
+            std::string errors = get_tls_errors();
+            SSL_CTX_free(ctx);
+            throw tls_error_exc_t(strprintf("Could not load TLS CA from '%s': %s",
+                                            ca_file.c_str(), errors.c_str()));
+        }
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+    }
+}
+
+tls_ctx_t::~tls_ctx_t() {
+    SSL_CTX_free(ctx);
+}
+
+tls_conn_t::tls_conn_t(tls_ctx_t *ctx, fd_t fd, tls_role_t role) {
+    ssl = SSL_new(ctx->get());
+    guarantee(ssl != NULL, "Could not create TLS connection: %s", get_tls_errors().c_str());
+    guarantee(SSL_set_fd(ssl, fd) == 1);
+    if (role == tls_role_t::server) {
+        SSL_set_accept_state(ssl);
+    } else {
+        SSL_set_connect_state(ssl);
+    }
+}
+
+tls_conn_t::~tls_conn_t() {
+    SSL_free(ssl);
+}
+
+int tls_conn_t::handshake(int *event_out) {
+    start_call();
+    return result(SSL_do_handshake(ssl), event_out);
+}
+
+ssize_t tls_conn_t::read(void *buf, size_t size, int *event_out) {
+    start_call();
+    return result(SSL_read(ssl, buf, std::min<size_t>(size, INT_MAX)), event_out);
+}
+
+ssize_t tls_conn_t::write(const void *buf, size_t size, int *event_out) {
+    start_call();
+    return result(SSL_write(ssl, buf, std::min<size_t>(size, INT_MAX)), event_out);
+}
+
+bool tls_conn_t::kernel_sends() {
+#ifdef BIO_get_ktls_send
+    return BIO_get_ktls_send(SSL_get_wbio(ssl)) == 1;
+#else
+    return false;
+#endif
+}
+
+void tls_conn_t::start_call() {
+    // `result()` looks at both of these to tell what went wrong
+    ERR_clear_error();
+    set_errno(0);
+}
+
+ssize_t tls_conn_t::result(int res, int *event_out) {
+    if (res > 0) {
+        return res;
+    }
+    switch (SSL_get_error(ssl, res)) {
+    case SSL_ERROR_WANT_READ:
+        *event_out = poll_event_in;
+        set_errno(EAGAIN);
+        return -1;
+    case SSL_ERROR_WANT_WRITE:
+        *event_out = poll_event_out;
+        set_errno(EAGAIN);
+        return -1;
+    case SSL_ERROR_ZERO_RETURN:
+        // The peer closed the TLS session cleanly
+        return 0;
+    case SSL_ERROR_SYSCALL:
+        // The socket failed, or the peer closed it without a TLS close
+        if (get_errno() == 0) {
+            set_errno(ECONNRESET);
+        }
+        return -1;
+    default:
+        logWRN("TLS error: %s", get_tls_errors().c_str());
+        set_errno(EPROTO);
+        return -1;
+    }
+}
+
+static tls_ctx_t *driver_tls_ctx = NULL;
+static tls_ctx_t *cluster_tls_ctx = NULL;
+
+void set_driver_tls_ctx(tls_ctx_t *ctx) {
+    driver_tls_ctx = ctx;
+}
+
+tls_ctx_t *get_driver_tls_ctx() {
+    return driver_tls_ctx;
+}
+
+void set_cluster_tls_ctx(tls_ctx_t *ctx) {
+    cluster_tls_ctx = ctx;
+}
+
+tls_ctx_t *get_cluster_tls_ctx() {
+    return cluster_tls_ctx;
+}
@@ -0,0 +1,82 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_TLS_HPP_
+#define ARCH_IO_TLS_HPP_
+
+#include <sys/types.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "arch/runtime/runtime_utils.hpp"
+#include "errors.hpp"
+
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_st SSL;
+
+class tls_error_exc_t : public std::exception {
+public:
+    explicit tls_error_exc_t(const std::string &_info) : info(_info) { }
+    ~tls_error_exc_t() throw () { }
+    const char *what() const throw () { return info.c_str(); }
+private:
+    std::string info;
+};
+
+enum class tls_role_t { client, server };
+
+/* A certificate and key to offer peers, and optionally a CA to check theirs against.
+One `tls_ctx_t` is shared by every connection on every thread that uses it. */
+class tls_ctx_t {
+public:
+    // If `ca_file` is empty, peers aren't asked for certificates and the ones
+    // servers offer aren't checked. Otherwise both sides must offer one signed by
+    // that CA. Throws `tls_error_exc_t` if the files can't be loaded.
+    tls_ctx_t(const std::string &cert_file,
+              const std::string &key_file,
+              const std::string &ca_file) THROWS_ONLY(tls_error_exc_t);
+    ~tls_ctx_t();
+
+    SSL_CTX *get() { return ctx; }
+
+private:
+    SSL_CTX *ctx;
+
+    DISABLE_COPYING(tls_ctx_t);
+};
+
+/* The TLS state of one non-blocking socket. The calls below work like `::read()` and
+`::write()`: when they fail with `EAGAIN`, `*event_out` is set to the poll event to
+wait for before trying again, which may be the opposite direction's. Protocol errors
+are logged and reported as `EPROTO`. */
+class tls_conn_t {
+public:
+    tls_conn_t(tls_ctx_t *ctx, fd_t fd, tls_role_t role);
+    ~tls_conn_t();
+
+    // Returns 1 once the handshake is done
+    int handshake(int *event_out);
+    ssize_t read(void *buf, size_t size, int *event_out);
+    ssize_t write(const void *buf, size_t size, int *event_out);
+
+    // True if the kernel encrypts what we send (kernel TLS), so plain writes to the
+    // socket can be used instead of `write()`. Only meaningful after the handshake.
+    bool kernel_sends();
+
+private:
+    void start_call();
+    ssize_t result(int res, int *event_out);
+
+    SSL *ssl;
+
+    DISABLE_COPYING(tls_conn_t);
+};
+
+/* The contexts for client driver connections and for connections between nodes. Like
+the other process-wide settings, these are set from the command line before the
+thread pool starts. NULL means plain TCP. */
+void set_driver_tls_ctx(tls_ctx_t *ctx);
+tls_ctx_t *get_driver_tls_ctx();
+void set_cluster_tls_ctx(tls_ctx_t *ctx);
+tls_ctx_t *get_cluster_tls_ctx();
+
+#endif  // ARCH_IO_TLS_HPP_
@@ -0,0 +1,193 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/memory_stats.hpp"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include "containers/archive/file_stream.hpp"
+#include "utils.hpp"
+
+namespace {
+
+bool read_file(const std::string &path, std::string *contents_out) {
+    blocking_read_file_stream_t file;
+    if (!file.init(path.c_str())) {
+        return false;
+    }
+    contents_out->clear();
+    char buf[4096];
+    for (;;) {
+        const int64_t res = file.read(buf, sizeof(buf));
+        if (res == -1) {
+            return false;
+        } else if (res == 0) {
+            return true;
+        }
+        contents_out->append(buf, res);
+    }
+}
+
+// Parses the number at the start of `str`, after any spaces.
+bool parse_number(const char *str, uint64_t *out) {
+    while (*str == ' ') {
+        ++str;
+    }
+    const char *end;
+    *out = strtou64_strict(str, &end, 10);
+    return end != str;
+}
+
+// Finds the line of `contents` that starts with `key` and parses the number after
+// it, like the "MemTotal:" of /proc/meminfo or the "inactive_file " of memory.stat.
+bool find_field(const std::string &contents, const std::string &key, uint64_t *out) {
+    for (size_t pos = 0; pos < contents.size();) {
+        size_t end = contents.find('\n', pos);
+        if (end == std::string::npos) {
+            end = contents.size();
+        }
+        if (contents.compare(pos, key.size(), key) == 0) {
+            return parse_number(contents.c_str() + pos + key.size(), out);
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+bool read_number_file(const std::string &path, uint64_t *out) {
+    std::string contents;
+    return read_file(path, &contents) && parse_number(contents.c_str(), out);
+}
+
+// The directory of the process's memory cgroup, and whether it's cgroup v2.  A
+// container usually can't see its cgroup's path from /proc/self/cgroup under
+// /sys/fs/cgroup, but has the cgroup mounted there as the root instead.
+bool find_memory_cgroup(std::string *dir_out, bool *v2_out) {
+    std::string contents;
+    if (!read_file("/proc/self/cgroup", &contents)) {
+        return false;
+    }
+    std::string v1_dir, v2_dir;
+    for (size_t pos = 0; pos < contents.size();) {
+        size_t end = contents.find('\n', pos);
+        if (end == std::string::npos) {
+            end = contents.size();
+        }
+        // Each line is "hierarchy-id:controllers:path".
+        const std::string line = contents.substr(pos, end - pos);
+        pos = end + 1;
+        const size_t colon1 = line.find(':');
+        const size_t colon2 = colon1 == std::string::npos
+            ? std::string::npos : line.find(':', colon1 + 1);
+        if (colon2 == std::string::npos) {
+            continue;
+        }
+        const std::string controllers
+            = ',' + line.substr(colon1 + 1, colon2 - colon1 - 1) + ',';
+        const std::string path = line.substr(colon2 + 1);
+        if (controllers == ",,") {
+            v2_dir = "/sys/fs/cgroup" + path;
+        } else if (controllers.find(",memory,") != std::string::npos) {
+            v1_dir = "/sys/fs/cgroup/memory" + path;
+        }
+    }
+
+    // On hybrid systems the memory controller is still on v1.
+    std::string dir = !v1_dir.empty() ? v1_dir : v2_dir;
+    if (dir.empty()) {
+        return false;
+    }
+    *v2_out = v1_dir.empty();
+    const std::string limit_file = *v2_out ? "/memory.max" : "/memory.limit_in_bytes";
+    if (access((dir + limit_file).c_str(), R_OK) != 0) {
+        dir = *v2_out ? "/sys/fs/cgroup" : "/sys/fs/cgroup/memory";
+        if (access((dir + limit_file).c_str(), R_OK) != 0) {
+            return false;
+        }
+    }
+    *dir_out = dir;
+    return true;
+}
+
+uint64_t get_physical_memory() {
+    return static_cast<uint64_t>(sysconf(_SC_PHYS_PAGES))
+        * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+// The limit of the process's memory cgroup, if it has one less than the machine's
+// memory.  (Without a limit, v2 says "max" and v1 says some huge number.)
+bool get_cgroup_limit(const std::string &dir, bool v2, uint64_t *limit_out) {
+    uint64_t limit;
+    if (!read_number_file(dir + (v2 ? "/memory.max" : "/memory.limit_in_bytes"),
+                          &limit)
+        || limit >= get_physical_memory()) {
+        return false;
+    }
+    *limit_out = limit;
+    return true;
+}
+
+}  // namespace
+
+uint64_t get_memory_limit() {
+    std::string dir;
+    bool v2;
+    uint64_t limit;
+    if (find_memory_cgroup(&dir, &v2) && get_cgroup_limit(dir, v2, &limit)) {
+        return limit;
+    }
+    return get_physical_memory();
+}
+
+bool get_memory_usage(uint64_t *usage_out) {
+    std::string dir;
+    bool v2;
+    uint64_t limit;
+    std::string contents;
+    if (find_memory_cgroup(&dir, &v2) && get_cgroup_limit(dir, v2, &limit)) {
+        uint64_t usage;
+        if (!read_number_file(
+                dir + (v2 ? "/memory.current" : "/memory.usage_in_bytes"), &usage)) {
+            return false;
+        }
+        uint64_t inactive_file;
+        if (read_file(dir + "/memory.stat", &contents)
+            && find_field(contents, v2 ? "inactive_file " : "total_inactive_file ",
+                          &inactive_file)) {
+            usage -= std::min(usage, inactive_file);
+        }
+        *usage_out = usage;
+        return true;
+    }
+
+    uint64_t total_kb, available_kb;
+    if (!read_file("/proc/meminfo", &contents)
+        || !find_field(contents, "MemTotal:", &total_kb)
+        || !find_field(contents, "MemAvailable:", &available_kb)) {
+        return false;
+    }
+    *usage_out = (total_kb - std::min(total_kb, available_kb)) * KILOBYTE;
+    return true;
+}
+
+bool get_memory_pressure(double *pressure_out) {
+    std::string dir;
+    bool v2;
+    std::string contents;
+    if (!(find_memory_cgroup(&dir, &v2) && v2
+          && read_file(dir + "/memory.pressure", &contents))
+        && !read_file("/proc/pressure/memory", &contents)) {
+        return false;
+    }
+    // The first line is "some avg10=... avg60=... avg300=... total=...".
+    const std::string key = "some avg10=";
+    if (contents.compare(0, key.size(), key) != 0) {
+        return false;
+    }
+    const char *start = contents.c_str() + key.size();
+    char *end;
+    *pressure_out = strtod(start, &end);
+    return end != start;
+}
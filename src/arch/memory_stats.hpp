@@ -0,0 +1,27 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_MEMORY_STATS_HPP_
+#define ARCH_MEMORY_STATS_HPP_
+
+#include <stdint.h>
+
+/* What the kernel says about the memory the process can use.  Inside a container,
+that's the limit of the process's cgroup (v1 or v2) rather than the machine's
+memory.  These read small files in /proc and /sys/fs/cgroup with blocking I/O, which
+never waits for a disk. */
+
+// The memory the process may use: the machine's physical memory, or its cgroup's
+// limit if that's smaller.
+uint64_t get_memory_limit();
+
+// How much of that is in use, not counting page cache the kernel can drop: the
+// cgroup's usage if it has a limit, and otherwise the machine's memory that isn't
+// available.  Returns false if it can't tell.
+bool get_memory_usage(uint64_t *usage_out);
+
+// The percentage of the last ten seconds in which some of the cgroup's (or, if the
+// cgroup doesn't say, the machine's) tasks were stalled waiting for memory, from
+// the kernel's pressure stall information.  Returns false if the kernel doesn't
+// report it.
+bool get_memory_pressure(double *pressure_out);
+
+#endif  // ARCH_MEMORY_STATS_HPP_
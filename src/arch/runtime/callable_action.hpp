@@ -2,6 +2,7 @@
 #define ARCH_RUNTIME_CALLABLE_ACTION_HPP_
 
 #include "errors.hpp"
+#include "arch/runtime/slab_allocator.hpp"
 
 /* The below classes may be used to create a generic callable object without
   boost::function so as to avoid the heap allocation that boost::functions use.
@@ -11,7 +12,7 @@
 
 #define CALLABLE_CUTOFF_SIZE 128
 
-class callable_action_t {
+class callable_action_t : public slab_allocated_t {
 public:
     virtual void run_action() = 0;
     callable_action_t() { }
@@ -5,6 +5,8 @@
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #ifndef NDEBUG
 #include <cxxabi.h>   // For __cxa_current_exception_type (see below)
 #endif
@@ -16,6 +18,7 @@
 #include "arch/runtime/thread_pool.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "arch/io/concurrency.hpp"
+#include "config/args.hpp"
 #include "containers/scoped.hpp"
 #include "errors.hpp"
 #include "utils.hpp"
@@ -39,8 +42,12 @@ bool artificial_stack_context_ref_t::is_nil() {
 
 artificial_stack_t::artificial_stack_t(void (*initial_fun)(void), size_t _stack_size)
     : stack_size(_stack_size) {
-    /* Allocate the stack */
-    stack = malloc_aligned(stack_size, getpagesize());
+    /* Allocate the stack. We map it ourselves rather than going through malloc so
+    that its pages only get committed when they're touched, and so that
+    `release_unused_pages()` can hand them back. */
+    stack = mmap(NULL, stack_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    guarantee_err(stack != MAP_FAILED, "could not allocate coroutine stack");
 
     /* Protect the end of the stack so that we crash when we get a stack
     overflow instead of corrupting memory. */
@@ -130,11 +137,37 @@ artificial_stack_t::~artificial_stack_t() {
 #endif
 #endif
 
-    /* Undo protections changes */
-    mprotect(stack, getpagesize(), PROT_READ | PROT_WRITE);
+    /* Release the stack we allocated, protection page and all */
+    DEBUG_VAR int res = munmap(stack, stack_size);
+    rassert_err(res == 0, "could not unmap coroutine stack");
+}
+
+void artificial_stack_t::release_unused_pages() {
+    rassert(!context.is_nil(), "the stack is still running");
+
+    /* Everything below the saved context is dead. We keep the topmost few pages
+    anyway, since most coroutines never get any deeper than that. */
+    const uintptr_t page_size = getpagesize();
+    const uintptr_t start = reinterpret_cast<uintptr_t>(stack) + page_size;
+    const uintptr_t end = std::min(
+        floor_aligned(reinterpret_cast<uintptr_t>(context.pointer), page_size),
+        floor_aligned(reinterpret_cast<uintptr_t>(get_stack_base())
+                      - COROUTINE_STACK_RETAINED_SIZE, page_size));
+    if (end <= start) {
+        return;
+    }
 
-    /* Release the stack we allocated */
-    free(stack);
+    void *addr = reinterpret_cast<void *>(start);
+    const size_t length = end - start;
+#ifdef MADV_FREE
+    /* The kernel only takes MADV_FREE pages back when it needs them, which is
+    cheaper than dropping them right away if we're about to use them again. Older
+    kernels don't know about it, though. */
+    if (madvise(addr, length, MADV_FREE) == 0) {
+        return;
+    }
+#endif
+    UNUSED int res = madvise(addr, length, MADV_DONTNEED);
 }
 
 bool artificial_stack_t::address_in_stack(void *addr) {
@@ -65,6 +65,11 @@ public:
     /* Returns the end of the stack */
     void *get_stack_bound() { return stack; }
 
+    /* Gives the pages below the saved context back to the kernel; they get
+    committed again as the stack grows back into them. Only call this while the
+    stack is switched out. */
+    void release_unused_pages();
+
 private:
     void *stack;
     size_t stack_size;
@@ -174,6 +179,9 @@ public:
     /* Returns the end of the stack */
     void *get_stack_bound();
 
+    /* The real stack belongs to the thread, so there's nothing to release. */
+    void release_unused_pages() { }
+
 private:
     static void *internal_run(void *p);
     void get_stack_addr_size(void **stackaddr_out, size_t *stacksize_out);
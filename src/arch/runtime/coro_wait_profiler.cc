@@ -0,0 +1,116 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/coro_wait_profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <map>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/pmap.hpp"
+#include "config/args.hpp"
+
+coro_wait_site_t::coro_wait_site_t(const char *description)
+    : description_(description),
+      coro_(coro_t::self()),
+      parent_(coro_ == NULL ? NULL : coro_->wait_site_) {
+    if (coro_ != NULL) {
+        coro_->wait_site_ = this;
+    }
+}
+
+coro_wait_site_t::~coro_wait_site_t() {
+    if (coro_ != NULL) {
+        rassert(coro_->wait_site_ == this);
+        coro_->wait_site_ = parent_;
+    }
+}
+
+struct per_thread_waits_t {
+    per_thread_waits_t() : waits_since_sample(0) { }
+    int waits_since_sample;
+    // The sampled waits' time for each stack of wait site descriptions, outermost
+    // first.  Only touched on its own thread.
+    std::map<std::vector<const char *>, ticks_t> ticks_by_stack;
+};
+
+static std::atomic<bool> profiler_enabled(false);
+static std::array<cache_line_padded_t<per_thread_waits_t>, MAX_THREADS> per_thread_waits;
+
+static void clear_thread_waits(int thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    per_thread_waits[thread].value = per_thread_waits_t();
+}
+
+void coro_wait_profiler_t::set_enabled(bool enabled) {
+    if (enabled && !profiler_enabled.load()) {
+        pmap(get_num_threads(), &clear_thread_waits);
+    }
+    profiler_enabled.store(enabled);
+}
+
+bool coro_wait_profiler_t::is_enabled() {
+    return profiler_enabled.load();
+}
+
+bool coro_wait_profiler_t::should_sample() {
+    if (!profiler_enabled.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    per_thread_waits_t *waits = &per_thread_waits[get_thread_id().threadnum].value;
+    if (++waits->waits_since_sample < CORO_WAIT_PROFILER_SAMPLE_INTERVAL) {
+        return false;
+    }
+    waits->waits_since_sample = 0;
+    return true;
+}
+
+void coro_wait_profiler_t::record_wait(const coro_wait_site_t *site, ticks_t duration) {
+    std::vector<const char *> stack;
+    for (; site != NULL; site = site->parent_) {
+        stack.push_back(site->description_);
+    }
+    std::reverse(stack.begin(), stack.end());
+    per_thread_waits[get_thread_id().threadnum].value.ticks_by_stack[stack] += duration;
+}
+
+static void get_thread_waits(int thread,
+                             std::vector<std::map<std::vector<const char *>,
+                                                  ticks_t> > *out) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    (*out)[thread] = per_thread_waits[thread].value.ticks_by_stack;
+}
+
+std::string coro_wait_profiler_t::get_folded_stacks() {
+    std::vector<std::map<std::vector<const char *>, ticks_t> >
+        per_thread(get_num_threads());
+    pmap(get_num_threads(), std::bind(&get_thread_waits, ph::_1, &per_thread));
+
+    // Two sites can have the same description at different addresses, so we merge
+    // stacks by their text.
+    std::map<std::string, ticks_t> ticks_by_folded_stack;
+    for (auto thread = per_thread.begin(); thread != per_thread.end(); ++thread) {
+        for (auto it = thread->begin(); it != thread->end(); ++it) {
+            std::string folded;
+            for (auto desc = it->first.begin(); desc != it->first.end(); ++desc) {
+                folded += folded.empty() ? "" : ";";
+                folded += *desc;
+            }
+            ticks_by_folded_stack[folded.empty() ? "other" : folded] += it->second;
+        }
+    }
+
+    std::string out;
+    for (auto it = ticks_by_folded_stack.begin();
+         it != ticks_by_folded_stack.end();
+         ++it) {
+        // Every sampled wait stands for `CORO_WAIT_PROFILER_SAMPLE_INTERVAL` waits
+        double usecs = ticks_to_secs(it->second) * 1e6
+            * CORO_WAIT_PROFILER_SAMPLE_INTERVAL;
+        out += strprintf("%s %" PRIu64 "\n", it->first.c_str(),
+                         static_cast<uint64_t>(usecs));
+    }
+    return out;
+}
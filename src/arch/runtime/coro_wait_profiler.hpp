@@ -0,0 +1,61 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_CORO_WAIT_PROFILER_HPP_
+#define ARCH_RUNTIME_CORO_WAIT_PROFILER_HPP_
+
+#include <string>
+
+#include "errors.hpp"
+#include "utils.hpp"
+
+class coro_t;
+
+/* A `coro_wait_site_t` names what the coroutine that constructed it waits for until
+it's destroyed, such as "disk read" or "lock".  Sites nest, so a coroutine waiting
+in a "disk read" inside a "serializer block read" is in both.  Constructing one
+outside of a coroutine does nothing.  `description` must be a string literal (or
+otherwise live forever). */
+class coro_wait_site_t {
+public:
+    explicit coro_wait_site_t(const char *description);
+    ~coro_wait_site_t();
+
+private:
+    friend class coro_wait_profiler_t;
+
+    const char *const description_;
+    coro_t *const coro_;
+    coro_wait_site_t *const parent_;
+
+    DISABLE_COPYING(coro_wait_site_t);
+};
+
+/* `coro_wait_profiler_t` finds out what coroutines spend their time waiting for,
+cheaply enough to turn on in production.  It's off until someone turns it on,
+which the admin HTTP server's `ajax/coro_profiler` does.  While it's on, one in
+every `CORO_WAIT_PROFILER_SAMPLE_INTERVAL` `coro_t::wait()`s on each thread is
+timed, and the time goes to the stack of `coro_wait_site_t`s that the coroutine
+was in.  While it's off, `coro_t::wait()` only checks a flag.
+
+The results come out as "folded stacks", one line per stack of wait sites,
+outermost first, with the estimated microseconds spent waiting in it:
+
+    serializer block read;disk read 81920
+
+which is what flamegraph.pl takes.  Waits outside of any site are under "other".
+This is unrelated to the debugging `coro_profiler_t`, which needs a special build
+and takes a backtrace at every yield. */
+class coro_wait_profiler_t {
+public:
+    // Turning the profiler on throws away what it collected before.  These must be
+    // called in a coroutine.
+    static void set_enabled(bool enabled);
+    static bool is_enabled();
+    static std::string get_folded_stacks();
+
+    // Used by `coro_t::wait()`.  When `should_sample()` returns true, the wait must
+    // be timed and passed to `record_wait()`.
+    static bool should_sample();
+    static void record_wait(const coro_wait_site_t *site, ticks_t duration);
+};
+
+#endif  // ARCH_RUNTIME_CORO_WAIT_PROFILER_HPP_
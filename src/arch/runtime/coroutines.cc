@@ -11,10 +11,12 @@
 
 #include "arch/runtime/context_switching.hpp"
 #include "arch/runtime/coro_profiler.hpp"
+#include "arch/runtime/coro_wait_profiler.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "config/args.hpp"
 #include "do_on_thread.hpp"
+#include "perfmon/memory.hpp"
 #include "perfmon/perfmon.hpp"
 #include "rethinkdb_backtrace.hpp"
 #include "thread_local.hpp"
@@ -41,6 +43,10 @@ struct coro_globals_t {
     /* A list of coro_t objects that are not in use. */
     intrusive_list_t<coro_t> free_coros;
 
+    /* Unused coro_t objects that didn't fit in `free_coros`, with most of their
+    stack pages given back to the kernel. */
+    intrusive_list_t<coro_t> released_coros;
+
 #ifndef NDEBUG
 
     /* An integer counting the number of coros on this thread */
@@ -82,6 +88,10 @@ struct coro_globals_t {
             free_coros.remove(s);
             delete s;
         }
+        while (coro_t *s = released_coros.head()) {
+            released_coros.remove(s);
+            delete s;
+        }
     }
 
 };
@@ -122,9 +132,11 @@ TLS_with_init(int64_t, coro_selfname_counter, 0);
 
 coro_t::coro_t() :
     stack(&coro_t::run, coro_stack_size),
+    stack_size_(coro_stack_size),
     current_thread_(linux_thread_pool_t::get_thread_id()),
     notified_(false),
-    waiting_(false)
+    waiting_(false),
+    wait_site_(NULL)
 #ifndef NDEBUG
     , selfname_number(get_thread_id().threadnum + MAX_THREADS *
           // The comma here is the comma operator, to implement the semantics
@@ -137,6 +149,7 @@ coro_t::coro_t() :
 #endif
 {
     ++pm_allocated_coroutines;
+    note_memory_change(memory_category_t::coroutine_stacks, stack_size_);
 
 #ifndef NDEBUG
     TLS_get_cglobals()->coro_count++;
@@ -153,8 +166,15 @@ void coro_t::return_coro_to_free_list(coro_t *coro) {
 void coro_t::maybe_evict_from_free_list() {
     coro_globals_t *cglobals = TLS_get_cglobals();
     while (cglobals->free_coros.size() > COROUTINE_FREE_LIST_SIZE) {
-        coro_t *coro_to_delete = cglobals->free_coros.tail();
-        cglobals->free_coros.remove(coro_to_delete);
+        // The head is the one that has been unused the longest
+        coro_t *coro_to_release = cglobals->free_coros.head();
+        cglobals->free_coros.remove(coro_to_release);
+        coro_to_release->stack.release_unused_pages();
+        cglobals->released_coros.push_back(coro_to_release);
+    }
+    while (cglobals->released_coros.size() > COROUTINE_RELEASED_FREE_LIST_SIZE) {
+        coro_t *coro_to_delete = cglobals->released_coros.head();
+        cglobals->released_coros.remove(coro_to_delete);
         delete coro_to_delete;
     }
 }
@@ -167,6 +187,7 @@ coro_t::~coro_t() {
     TLS_get_cglobals()->coro_count--;
 #endif
     --pm_allocated_coroutines;
+    note_memory_change(memory_category_t::coroutine_stacks, -stack_size_);
 }
 
 void coro_t::run() {
@@ -244,6 +265,9 @@ void coro_t::wait() {   /* class method */
     rassert(!self()->waiting_);
     self()->waiting_ = true;
 
+    const bool sample_wait = coro_wait_profiler_t::should_sample();
+    const ticks_t wait_start = sample_wait ? get_ticks() : 0;
+
     PROFILER_CORO_YIELD(1);
     if (TLS_get_cglobals()->prev_coro) {
         context_switch(&self()->stack.context, &TLS_get_cglobals()->prev_coro->stack.context);
@@ -252,6 +276,10 @@ void coro_t::wait() {   /* class method */
     }
     PROFILER_CORO_RESUME;
 
+    if (sample_wait) {
+        coro_wait_profiler_t::record_wait(self()->wait_site_, get_ticks() - wait_start);
+    }
+
     rassert(self());
     rassert(self()->waiting_);
     self()->waiting_ = false;
@@ -376,7 +404,12 @@ coro_t * coro_t::get_coro() {
     coro_t *coro;
 
     if (TLS_get_cglobals()->free_coros.size() == 0) {
-        coro = new coro_t();
+        if (TLS_get_cglobals()->released_coros.size() == 0) {
+            coro = new coro_t();
+        } else {
+            coro = TLS_get_cglobals()->released_coros.tail();
+            TLS_get_cglobals()->released_coros.remove(coro);
+        }
     } else {
         coro = TLS_get_cglobals()->free_coros.tail();
         TLS_get_cglobals()->free_coros.remove(coro);
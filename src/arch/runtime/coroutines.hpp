@@ -21,6 +21,7 @@ const size_t MAX_COROUTINE_STACK_SIZE = 8*1024*1024;
 
 threadnum_t get_thread_id();
 struct coro_globals_t;
+class coro_wait_site_t;
 
 
 struct coro_profiler_mixin_t {
@@ -193,11 +194,14 @@ private:
 
     friend class coro_profiler_t;
     friend struct coro_globals_t;
+    friend class coro_wait_site_t;
     ~coro_t();
 
     virtual void on_thread_switch();
 
     coro_stack_t stack;
+    // What `stack` counts for in the node's memory accounting.
+    const int64_t stack_size_;
 
     threadnum_t current_thread_;
 
@@ -205,6 +209,9 @@ private:
     bool notified_;
     bool waiting_;
 
+    // The innermost `coro_wait_site_t` we're in, for `coro_wait_profiler_t`
+    coro_wait_site_t *wait_site_;
+
     callable_action_wrapper_t action_wrapper;
 
 #ifndef NDEBUG
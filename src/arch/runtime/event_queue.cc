@@ -5,6 +5,7 @@
 
 #include "arch/runtime/thread_pool.hpp"
 #include "concurrency/cond_var.hpp"
+#include "config/args.hpp"
 #include "utils.hpp"
 #include "perfmon/perfmon.hpp"
 
@@ -15,6 +16,17 @@ perfmon_duration_sampler_t *pm_eventloop_singleton_t::get() {
     return &pm_eventloop;
 }
 
+static int event_queue_busy_poll_usec = 0;
+
+void set_event_queue_busy_poll_usec(int usec) {
+    guarantee(usec >= 0 && usec <= MAX_EVENT_QUEUE_BUSY_POLL_USEC);
+    event_queue_busy_poll_usec = usec;
+}
+
+int get_event_queue_busy_poll_usec() {
+    return event_queue_busy_poll_usec;
+}
+
 std::string format_poll_event(int event) {
     std::string s;
     if (event & poll_event_in) {
@@ -27,6 +27,13 @@ struct pm_eventloop_singleton_t {
     static perfmon_duration_sampler_t *get();
 };
 
+// For how many microseconds an event queue that has just handled events keeps
+// polling for more before it goes to sleep in the kernel, and the `SO_BUSY_POLL`
+// value for TCP connections.  Zero, the default, turns busy polling off.  Only the
+// epoll queue busy-polls, and this must be set before the thread pool starts.
+void set_event_queue_busy_poll_usec(int usec);
+int get_event_queue_busy_poll_usec();
+
 /* Pick the queue now*/
 #if !defined(__linux) || defined(NO_EPOLL)
 
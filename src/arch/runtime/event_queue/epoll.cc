@@ -46,20 +46,35 @@ int epoll_to_user(int mode) {
 }
 
 epoll_event_queue_t::epoll_event_queue_t(linux_queue_parent_t *_parent)
-    : parent(_parent) {
+    : parent(_parent), nevents(0), last_events_ticks(0) {
     // Create a poll fd
 
     epoll_fd = epoll_create1(0);
     guarantee_err(epoll_fd >= 0, "Could not create epoll fd");
 }
 
+int epoll_event_queue_t::wait_for_events() {
+    const int busy_poll_usec = get_event_queue_busy_poll_usec();
+    if (busy_poll_usec > 0) {
+        // Only spin if we were busy a moment ago, so that idle threads still sleep.
+        const ticks_t deadline = last_events_ticks + busy_poll_usec * 1000LL;
+        while (get_ticks() < deadline) {
+            int res = epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, 0);
+            if (res != 0) {
+                return res;
+            }
+        }
+    }
+    return epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, -1);
+}
+
 void epoll_event_queue_t::run() {
     int res;
 
     // Now, start the loop
     while (!parent->should_shut_down()) {
         // Grab the events from the kernel!
-        res = epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, -1);
+        res = wait_for_events();
 
         // epoll_wait might return with EINTR in some cases (in
         // particular under GDB), we just need to retry.
@@ -77,6 +92,9 @@ void epoll_event_queue_t::run() {
 
         // nevents might be used by forget_resource during the loop
         nevents = res;
+        if (nevents > 0) {
+            last_events_ticks = get_ticks();
+        }
 
 #ifndef NDEBUG
         /* Sanity check: Make sure epoll() didn't give us any events we didn't ask for */
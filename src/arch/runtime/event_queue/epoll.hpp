@@ -11,6 +11,7 @@
 #include "arch/runtime/event_queue_types.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "config/args.hpp"
+#include "utils.hpp"
 
 // Event queue structure
 struct epoll_event_queue_t {
@@ -26,6 +27,10 @@ public:
     void forget_resource(fd_t resource, linux_event_callback_t *cb);
 
 private:
+    // Waits for events, spinning first if we've had some recently (see
+    // `get_event_queue_busy_poll_usec()`).  Returns like `epoll_wait`.
+    int wait_for_events();
+
     linux_queue_parent_t *parent;
 
     fd_t epoll_fd;
@@ -36,6 +41,9 @@ private:
     epoll_event events[MAX_IO_EVENT_PROCESSING_BATCH_SIZE];
     int nevents;
 
+    // When we last got any events, for deciding whether to busy-poll
+    ticks_t last_events_ticks;
+
 #ifndef NDEBUG
     /* In debug mode, check to make sure epoll() doesn't give us events that
     we didn't ask for. The ints stored here are combinations of poll_event_in
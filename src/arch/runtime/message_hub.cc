@@ -8,17 +8,44 @@
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "logger.hpp"
+#include "perfmon/perfmon.hpp"
 
 // Set this to 1 if you would like some "unordered" messages to be unordered.
 #ifndef NDEBUG
 #define RDB_RELOOP_MESSAGES 0
 #endif
 
+// Like `pm_eventloop_singleton_t`, these can't be plain statics because their
+// memberships would race with the initialization of coroutine globals.
+struct pm_message_hub_t {
+    static pm_message_hub_t *get() {
+        static pm_message_hub_t stats;
+        return &stats;
+    }
+
+    // Messages handed to another thread
+    perfmon_counter_t messages;
+    // Times a sender had to write to the receiving thread's eventfd
+    perfmon_counter_t wakeups;
+    // Times a sender didn't, because the receiver was already going to look
+    perfmon_counter_t wakeups_suppressed;
+
+private:
+    pm_message_hub_t()
+        : membership(&get_global_perfmon_collection(),
+                     &messages, "cross_thread_messages",
+                     &wakeups, "cross_thread_wakeups",
+                     &wakeups_suppressed, "cross_thread_wakeups_suppressed") { }
+
+    perfmon_multi_membership_t membership;
+};
+
 linux_message_hub_t::linux_message_hub_t(linux_event_queue_t *queue,
                                          linux_thread_pool_t *thread_pool,
                                          threadnum_t current_thread)
     : queue_(queue),
       thread_pool_(thread_pool),
+      incoming_messages_(NULL),
       is_woken_up_(false),
       current_thread_(current_thread) {
 
@@ -43,7 +70,7 @@ linux_message_hub_t::~linux_message_hub_t() {
         guarantee(get_priority_msg_list(p).empty());
     }
 
-    guarantee(incoming_messages_.empty());
+    guarantee(incoming_messages_.load() == NULL);
 }
 
 void linux_message_hub_t::do_store_message(threadnum_t nthread, linux_thread_message_t *msg) {
@@ -90,17 +117,41 @@ void linux_message_hub_t::store_message_sometime(threadnum_t nthread, linux_thre
 
 
 void linux_message_hub_t::insert_external_message(linux_thread_message_t *msg) {
-    bool do_wake_up;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        do_wake_up = !check_and_set_is_woken_up();
-        incoming_messages_.push_back(msg);
+    msg_list_t msgs;
+    msgs.push_back(msg);
+    push_incoming_messages(&msgs);
+}
+
+bool linux_message_hub_t::push_incoming_messages(msg_list_t *msgs) {
+    rassert(!msgs->empty());
+
+    // Chain the batch up back to front, so that `top` is the last message sent
+    linux_thread_message_t *top = NULL;
+    linux_thread_message_t *bottom = NULL;
+    while (linux_thread_message_t *m = msgs->head()) {
+        msgs->remove(m);
+        m->next_incoming = top;
+        top = m;
+        if (bottom == NULL) {
+            bottom = m;
+        }
     }
 
-    // Wakey wakey eggs and bakey
-    if (do_wake_up) {
-        event_.wakey_wakey();
+    linux_thread_message_t *old_top = incoming_messages_.load(std::memory_order_relaxed);
+    do {
+        bottom->next_incoming = old_top;
+    } while (!incoming_messages_.compare_exchange_weak(old_top, top));
+
+    // This has to come after the push (both are sequentially consistent): the
+    // receiver clears `is_woken_up_` before it takes the stack, so either it
+    // sees our messages or we see that it needs waking.
+    if (check_and_set_is_woken_up()) {
+        return false;
     }
+
+    // Wakey wakey eggs and bakey
+    event_.wakey_wakey();
+    return true;
 }
 
 linux_message_hub_t::msg_list_t &linux_message_hub_t::get_priority_msg_list(int priority) {
@@ -174,12 +225,7 @@ void linux_message_hub_t::on_event(int events) {
             // Place wakey_wakey and then yield to the event processing.
             // It will wake us up again immediately, but can handle a few
             // OS events (such as timers, network messages etc.) in the meantime.
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&incoming_messages_lock_);
-                do_wake_up = !check_and_set_is_woken_up();
-            }
-            if (do_wake_up) {
+            if (!check_and_set_is_woken_up()) {
                 event_.wakey_wakey();
             }
             break;
@@ -188,17 +234,17 @@ void linux_message_hub_t::on_event(int events) {
 }
 
 void linux_message_hub_t::sort_incoming_messages_by_priority() {
-    // We do this in two steps to release the spinlock faster.
-    // append_and_clear is a very cheap operation, while
-    // assigning each message to a different priority queue
-    // is more expensive.
+    // 1. Take the messages.  Anybody who pushes after this will wake us up again.
+    is_woken_up_.store(false);
+    linux_thread_message_t *top = incoming_messages_.exchange(NULL);
 
-    // 1. Pull the messages
+    // The stack has the newest message on top, so build the list front first.
     msg_list_t new_messages;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        new_messages.append_and_clear(&incoming_messages_);
-        is_woken_up_ = false;
+    while (top != NULL) {
+        linux_thread_message_t *next = top->next_incoming;
+        top->next_incoming = NULL;
+        new_messages.push_front(top);
+        top = next;
     }
 
     // 2. Sort the messages into their respective priority queues
@@ -218,36 +264,24 @@ void linux_message_hub_t::sort_incoming_messages_by_priority() {
 }
 
 bool linux_message_hub_t::check_and_set_is_woken_up() {
-    const bool was_woken_up = is_woken_up_;
-    is_woken_up_ = true;
-    return was_woken_up;
+    return is_woken_up_.exchange(true);
 }
 
-// Pushes messages collected locally global lists available to all
-// threads.
+// Pushes messages collected locally onto the incoming stacks of the threads
+// they're for.
 void linux_message_hub_t::push_messages() {
     for (int i = 0; i < thread_pool_->n_threads; i++) {
-        // Append the local list for ith thread to that thread's global
-        // message list.
         thread_queue_t *queue = &queues_[i];
         if (!queue->msg_local_list.empty()) {
-            // Transfer messages to the other core
-
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&thread_pool_->threads[i]->message_hub.incoming_messages_lock_);
+            pm_message_hub_t *stats = pm_message_hub_t::get();
+            stats->messages += queue->msg_local_list.size();
 
-                // We only need to do a wake up if we're the first people to do a
-                // wake up.
-                do_wake_up =
-                    !thread_pool_->threads[i]->message_hub.check_and_set_is_woken_up();
-
-                thread_pool_->threads[i]->message_hub.incoming_messages_.append_and_clear(&queue->msg_local_list);
-            }
-
-            // Wakey wakey, perhaps eggs and bakey
-            if (do_wake_up) {
-                thread_pool_->threads[i]->message_hub.event_.wakey_wakey();
+            // Transfer messages to the other core
+            if (thread_pool_->threads[i]->message_hub.push_incoming_messages(
+                    &queue->msg_local_list)) {
+                ++stats->wakeups;
+            } else {
+                ++stats->wakeups_suppressed;
             }
         }
     }
@@ -5,10 +5,11 @@
 #include <pthread.h>
 #include <strings.h>
 
+#include <atomic>
+
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "arch/runtime/system_event.hpp"
-#include "arch/spinlock.hpp"
 #include "config/args.hpp"
 #include "containers/intrusive_list.hpp"
 #include "utils.hpp"
@@ -74,11 +75,23 @@ private:
         msg_list_t msg_local_list;
     } queues_[MAX_THREADS];
 
-    // Must only be used with acquired incoming_messages_lock_
+    // Called by other threads to hand us a batch of messages, which leaves `msgs`
+    // empty.  Wakes us up unless somebody else already has, and returns whether it
+    // did.
+    bool push_incoming_messages(msg_list_t *msgs);
+
+    // Returns whether we had already been woken up, and makes sure we have been.
     bool check_and_set_is_woken_up();
-    bool is_woken_up_;
-    msg_list_t incoming_messages_;
-    spinlock_t incoming_messages_lock_;
+
+    // Messages that other threads have handed us, as a lock-free stack linked
+    // through `linux_thread_message_t::next_incoming`.  Each batch goes on in
+    // reverse, so that reversing the whole stack gives back the order in which
+    // the messages were sent.
+    std::atomic<linux_thread_message_t *> incoming_messages_;
+
+    // Set from the first wakeup until we take the incoming messages, so that
+    // senders don't write to `event_` again while we're still going to look.
+    std::atomic<bool> is_woken_up_;
 
     // Use `sort_incoming_messages_by_priority()` to sort incoming_messages_ into
     // these lists.
@@ -0,0 +1,148 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/slab_allocator.hpp"
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <new>
+
+#include "arch/runtime/thread_pool.hpp"
+#include "config/args.hpp"
+#include "utils.hpp"
+
+namespace {
+
+const size_t size_classes[] = { 16, 32, 48, 64, 80, 96, 128, 160, 192, 256 };
+const int num_size_classes = sizeof(size_classes) / sizeof(size_classes[0]);
+
+static_assert(SLAB_MAX_OBJECT_SIZE == 256, "size_class_by_sixteenths needs updating");
+static_assert((SLAB_SIZE & (SLAB_SIZE - 1)) == 0, "slabs are found by masking");
+
+// The size class of an object of `size` bytes, for every multiple of 16 up to
+// `SLAB_MAX_OBJECT_SIZE`.
+const int size_class_by_sixteenths[SLAB_MAX_OBJECT_SIZE / 16 + 1] = {
+    0, 0, 1, 2, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9, 9, 9, 9
+};
+
+int size_class_of(size_t size) {
+    return size_class_by_sixteenths[(size + 15) / 16];
+}
+
+struct free_block_t {
+    free_block_t *next;
+};
+
+// At the start of every slab; the blocks start at the next cache line.
+struct slab_header_t {
+    int owner;
+    int size_class;
+};
+
+const size_t slab_blocks_offset = CACHE_LINE_SIZE;
+
+struct slab_heap_t {
+    // Only the owner uses these.
+    free_block_t *free_lists[num_size_classes];
+    // Other threads push the owner's blocks onto these.
+    std::atomic<free_block_t *> remote_frees[num_size_classes];
+};
+
+// One heap per thread in the pool, and one more, under `shared_heap_mutex`, for threads
+// outside it.
+const int shared_heap = MAX_THREADS;
+cache_line_padded_t<slab_heap_t> heaps[MAX_THREADS + 1];
+pthread_mutex_t shared_heap_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+int this_heap() {
+    return linux_thread_pool_t::get_thread() != NULL
+        ? linux_thread_pool_t::get_thread_id()
+        : shared_heap;
+}
+
+class heap_lock_t {
+public:
+    explicit heap_lock_t(int heap) : locked(heap == shared_heap) {
+        if (locked) {
+            int res = pthread_mutex_lock(&shared_heap_mutex);
+            guarantee_xerr(res == 0, res, "could not lock the shared slab heap");
+        }
+    }
+    ~heap_lock_t() {
+        if (locked) {
+            int res = pthread_mutex_unlock(&shared_heap_mutex);
+            guarantee_xerr(res == 0, res, "could not unlock the shared slab heap");
+        }
+    }
+private:
+    const bool locked;
+    DISABLE_COPYING(heap_lock_t);
+};
+
+// Returns the first block of a new slab, with the rest chained after it.
+free_block_t *carve_slab(int owner, int size_class) {
+    char *slab = static_cast<char *>(malloc_aligned(SLAB_SIZE, SLAB_SIZE));
+    slab_header_t *header = reinterpret_cast<slab_header_t *>(slab);
+    header->owner = owner;
+    header->size_class = size_class;
+
+    const size_t block_size = size_classes[size_class];
+    const size_t count = (SLAB_SIZE - slab_blocks_offset) / block_size;
+    char *first = slab + slab_blocks_offset;
+    for (size_t i = 0; i + 1 < count; ++i) {
+        reinterpret_cast<free_block_t *>(first + i * block_size)->next
+            = reinterpret_cast<free_block_t *>(first + (i + 1) * block_size);
+    }
+    reinterpret_cast<free_block_t *>(first + (count - 1) * block_size)->next = NULL;
+    return reinterpret_cast<free_block_t *>(first);
+}
+
+}  // namespace
+
+void *slab_allocate(size_t size) {
+    if (size > SLAB_MAX_OBJECT_SIZE) {
+        return ::operator new(size);
+    }
+    const int size_class = size_class_of(size);
+    const int heap_index = this_heap();
+    slab_heap_t *heap = &heaps[heap_index].value;
+    heap_lock_t lock(heap_index);
+
+    free_block_t *block = heap->free_lists[size_class];
+    if (block == NULL) {
+        block = heap->remote_frees[size_class].exchange(NULL, std::memory_order_acquire);
+        if (block == NULL) {
+            block = carve_slab(heap_index, size_class);
+        }
+    }
+    heap->free_lists[size_class] = block->next;
+    return block;
+}
+
+void slab_deallocate(void *p, size_t size) {
+    if (p == NULL) {
+        return;
+    }
+    if (size > SLAB_MAX_OBJECT_SIZE) {
+        ::operator delete(p);
+        return;
+    }
+    const slab_header_t *header = reinterpret_cast<const slab_header_t *>(
+        reinterpret_cast<uintptr_t>(p) & ~static_cast<uintptr_t>(SLAB_SIZE - 1));
+    const int size_class = header->size_class;
+    rassert(size_class == size_class_of(size));
+    slab_heap_t *heap = &heaps[header->owner].value;
+    free_block_t *block = static_cast<free_block_t *>(p);
+
+    if (header->owner == this_heap()) {
+        heap_lock_t lock(header->owner);
+        block->next = heap->free_lists[size_class];
+        heap->free_lists[size_class] = block;
+    } else {
+        std::atomic<free_block_t *> *remote = &heap->remote_frees[size_class];
+        block->next = remote->load(std::memory_order_relaxed);
+        while (!remote->compare_exchange_weak(block->next, block,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) { }
+    }
+}
@@ -0,0 +1,40 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_SLAB_ALLOCATOR_HPP_
+#define ARCH_RUNTIME_SLAB_ALLOCATOR_HPP_
+
+#include <stddef.h>
+
+/* A size-class slab allocator for the small objects that the runtime and the query
+language create and destroy all the time.  Each thread hands out blocks of each size
+class from slabs of its own, without locking.  A block freed on a thread other than the
+one that allocated it goes on the owning thread's remote-free list for its size class,
+which the owner takes back in one go when its own free list runs dry.  Threads outside
+the thread pool (the blocker pool's, for instance) share one more heap under a mutex.
+
+Objects bigger than `SLAB_MAX_OBJECT_SIZE` come from the system allocator.  Slabs are
+never given back; their blocks get reused. */
+
+void *slab_allocate(size_t size);
+// `size` must be what was passed to `slab_allocate()`.
+void slab_deallocate(void *p, size_t size);
+
+/* Deriving from `slab_allocated_t` makes `new` and `delete` use the slab allocator.  A
+class deleted through a pointer to one of its bases must have a virtual destructor,
+so that `delete` passes the right size. */
+class slab_allocated_t {
+public:
+    static void *operator new(size_t size) {
+        return slab_allocate(size);
+    }
+    static void operator delete(void *p, size_t size) {
+        slab_deallocate(p, size);
+    }
+
+    // Declaring the above hides the global placement forms.
+    static void *operator new(size_t, void *p) {
+        return p;
+    }
+    static void operator delete(void *, void *) { }
+};
+
+#endif  // ARCH_RUNTIME_SLAB_ALLOCATOR_HPP_
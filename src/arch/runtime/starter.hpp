@@ -9,8 +9,10 @@
 
 /* `run_in_thread_pool()` starts a RethinkDB thread pool, runs the given
 function in a coroutine inside of it, waits for the function to return, and then
-shuts down the thread pool. */
+shuts down the thread pool.  With `pin_threads`, each thread is pinned to a core,
+and threads with neighbouring ids get cores on the same NUMA node. */
 
-void run_in_thread_pool(const std::function<void()> &fun, int worker_threads);
+void run_in_thread_pool(const std::function<void()> &fun, int worker_threads,
+                        bool pin_threads = false);
 
 #endif  // ARCH_RUNTIME_STARTER_HPP_
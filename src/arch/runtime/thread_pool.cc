@@ -7,6 +7,10 @@
 #include <unistd.h>
 #include <sys/time.h>
 
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "arch/barrier.hpp"
 #include "arch/os_signal.hpp"
 #include "arch/io/timer_provider.hpp"
@@ -41,6 +45,63 @@ NOINLINE void linux_thread_pool_t::set_thread(linux_thread_t *val) {
     thread = val;
 }
 
+// Parses a sysfs CPU list like "0-3,8-11".
+std::vector<int> parse_cpu_list(const std::string &list) {
+    std::vector<int> cpus;
+    const char *p = list.c_str();
+    while (*p != '\0' && *p != '\n') {
+        char *end;
+        const long first = strtol(p, &end, 10);  // NOLINT(runtime/int)
+        if (end == p) {
+            break;
+        }
+        long last = first;  // NOLINT(runtime/int)
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {  // NOLINT(runtime/int)
+            cpus.push_back(cpu);
+        }
+        if (*p == ',') {
+            ++p;
+        }
+    }
+    return cpus;
+}
+
+// Returns (NUMA node, CPU) pairs for all the CPUs, ordered by node, so that the
+// threads given neighbouring CPUs in it use the same node's memory (the buffer arena
+// allocates from the node a thread runs on).  Without NUMA information in sysfs,
+// all the CPUs are on node 0.
+std::vector<std::pair<int, int> > cpus_by_numa_node() {
+    std::vector<std::pair<int, int> > cpus;
+    for (int node = 0; node < BUFFER_ARENA_MAX_NUMA_NODES; ++node) {
+        const std::string path
+            = strprintf("/sys/devices/system/node/node%d/cpulist", node);
+        FILE *file = fopen(path.c_str(), "r");
+        if (file == NULL) {
+            continue;
+        }
+        char buf[1024];
+        const bool got_line = fgets(buf, sizeof(buf), file) != NULL;
+        fclose(file);
+        if (got_line) {
+            const std::vector<int> node_cpus = parse_cpu_list(buf);
+            for (size_t i = 0; i < node_cpus.size(); ++i) {
+                cpus.push_back(std::make_pair(node, node_cpus[i]));
+            }
+        }
+    }
+    if (cpus.empty()) {
+        for (int cpu = 0; cpu < get_cpu_count(); ++cpu) {
+            cpus.push_back(std::make_pair(0, cpu));
+        }
+    }
+    return cpus;
+}
+
 linux_thread_pool_t::linux_thread_pool_t(int worker_threads, bool _do_set_affinity) :
 #ifndef NDEBUG
       coroutine_summary(false),
@@ -187,6 +248,7 @@ void linux_thread_pool_t::run_thread_pool(linux_thread_message_t *initial_messag
 
     // Start child threads
     thread_barrier_t barrier(n_threads + 1);
+    const std::vector<std::pair<int, int> > cpus = cpus_by_numa_node();
 
     for (int i = 0; i < n_threads; i++) {
         thread_data_t *tdata = new thread_data_t();
@@ -199,14 +261,16 @@ void linux_thread_pool_t::run_thread_pool(linux_thread_message_t *initial_messag
         int res = pthread_create(&pthreads[i], NULL, &start_thread, tdata);
         guarantee_xerr(res == 0, res, "Could not create thread");
 
+        numa_nodes[i] = -1;
         if (do_set_affinity) {
             // On Apple, the thread affinity API has awful documentation, so we don't even bother.
 #ifdef _GNU_SOURCE
-            // Distribute threads evenly among CPUs
-            int ncpus = get_cpu_count();
+            // Threads with neighbouring ids share a NUMA node, see `cpus_by_numa_node`.
+            const std::pair<int, int> cpu = cpus[i * cpus.size() / n_threads];
+            numa_nodes[i] = cpu.first;
             cpu_set_t mask;
             CPU_ZERO(&mask);
-            CPU_SET(i % ncpus, &mask);
+            CPU_SET(cpu.second, &mask);
             res = pthread_setaffinity_np(pthreads[i], sizeof(cpu_set_t), &mask);
             guarantee_xerr(res == 0, res, "Could not set thread affinity");
 #endif
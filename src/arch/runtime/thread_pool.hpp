@@ -14,6 +14,7 @@
 #include "arch/runtime/coroutines.hpp"
 #include "arch/io/blocker_pool.hpp"
 #include "arch/io/timer_provider.hpp"
+#include "arch/spinlock.hpp"
 #include "arch/timer.hpp"
 
 class linux_thread_t;
@@ -91,6 +92,8 @@ public:
 
     int n_threads;
     bool do_set_affinity;
+    // The NUMA node each thread is pinned to, or -1 if the threads aren't pinned.
+    int numa_nodes[MAX_THREADS];
 
     // Non-inlinable getters and setters for the thread local variables.
     // See thread_local.hpp for an explanation of why these must not be
@@ -3,11 +3,15 @@
 #include "arch/runtime/thread_pool.hpp"
 #include "utils.hpp"
 
-class timer_token_t : public intrusive_priority_queue_node_t<timer_token_t> {
+const int64_t TIMER_WHEEL_TICK_NANOS = TIMER_WHEEL_TICK_MS * MILLION;
+
+class timer_token_t : public intrusive_priority_queue_node_t<timer_token_t>,
+                      public intrusive_list_node_t<timer_token_t> {
     friend class timer_handler_t;
 
 private:
-    timer_token_t() : interval_nanos(-1), next_time_in_nanos(-1), callback(NULL) { }
+    timer_token_t()
+        : interval_nanos(-1), next_time_in_nanos(-1), callback(NULL), wheel_list(NULL) { }
 
     friend bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *right);
 
@@ -20,6 +24,10 @@ private:
     // The callback we call upon each 'ring'.
     timer_callback_t *callback;
 
+    // The wheel slot (or `due_tokens`) the token is in, or NULL if it's in the
+    // priority queue.
+    intrusive_list_t<timer_token_t> *wheel_list;
+
     DISABLE_COPYING(timer_token_t);
 };
 
@@ -29,12 +37,71 @@ bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *rig
 
 timer_handler_t::timer_handler_t(linux_event_queue_t *queue)
     : timer_provider(queue),
-      expected_oneshot_time_in_nanos(0) {
+      expected_oneshot_time_in_nanos(0),
+      wheel_tick(0),
+      wheel_size(0) {
     // Right now, we have no tokens.  So we don't ask the timer provider to do anything for us.
 }
 
 timer_handler_t::~timer_handler_t() {
     guarantee(token_queue.empty());
+    guarantee(wheel_size == 0);
+}
+
+void timer_handler_t::add_to_wheel(timer_token_t *token) {
+    if (wheel_size == 0) {
+        // Nothing's been looking at the slots, so start from the present.
+        wheel_tick = get_ticks() / TIMER_WHEEL_TICK_NANOS;
+    }
+    // The token goes in the first tick that ends at or after its time, so that it
+    // never rings early.
+    const int64_t tick =
+        (token->next_time_in_nanos + TIMER_WHEEL_TICK_NANOS - 1) / TIMER_WHEEL_TICK_NANOS;
+    rassert(tick > wheel_tick);
+    token->wheel_list = &wheel[tick % TIMER_WHEEL_SLOTS];
+    token->wheel_list->push_back(token);
+    ++wheel_size;
+}
+
+void timer_handler_t::advance_wheel(int64_t ticks) {
+    const int64_t now_tick = ticks / TIMER_WHEEL_TICK_NANOS;
+    // After a long stall, one turn of the wheel looks at every slot.
+    const int64_t last_tick = std::min(now_tick, wheel_tick + TIMER_WHEEL_SLOTS);
+    for (int64_t tick = wheel_tick + 1; tick <= last_tick; ++tick) {
+        intrusive_list_t<timer_token_t> *slot = &wheel[tick % TIMER_WHEEL_SLOTS];
+        timer_token_t *token = slot->head();
+        while (token != NULL) {
+            timer_token_t *next = slot->next(token);
+            // Tokens for later turns of the wheel stay where they are.
+            if (token->next_time_in_nanos <= ticks) {
+                slot->remove(token);
+                token->wheel_list = &due_tokens;
+                due_tokens.push_back(token);
+            }
+            token = next;
+        }
+    }
+    wheel_tick = std::max(wheel_tick, now_tick);
+}
+
+void timer_handler_t::ring(timer_token_t *token, int64_t real_ticks) {
+    // Put the repeating timer back on the queue or wheel before the callback can be called (so
+    // that it may be canceled).
+    if (token->interval_nanos != 0) {
+        token->next_time_in_nanos = real_ticks + token->interval_nanos;
+        if (token->wheel_list != NULL) {
+            add_to_wheel(token);
+        } else {
+            token_queue.push(token);
+        }
+    }
+
+    token->callback->on_timer();
+
+    // Delete nonrepeating timer tokens.
+    if (token->interval_nanos == 0) {
+        delete token;
+    }
 }
 
 void timer_handler_t::on_oneshot() {
@@ -45,26 +112,40 @@ void timer_handler_t::on_oneshot() {
     int64_t ticks = std::max(real_ticks, expected_oneshot_time_in_nanos);
 
     while (!token_queue.empty() && token_queue.peek()->next_time_in_nanos <= ticks) {
-        timer_token_t *token = token_queue.pop();
-
-        // Put the repeating timer back on the queue before the callback can be called (so that it
-        // may be canceled).
-        if (token->interval_nanos != 0) {
-            token->next_time_in_nanos = real_ticks + token->interval_nanos;
-            token_queue.push(token);
-        }
-
-        token->callback->on_timer();
+        ring(token_queue.pop(), real_ticks);
+    }
 
-        // Delete nonrepeating timer tokens.
-        if (token->interval_nanos == 0) {
-            delete token;
+    if (wheel_size != 0) {
+        advance_wheel(ticks);
+        // A callback may cancel tokens that are still in `due_tokens`, so they're
+        // taken off one at a time.
+        while (!due_tokens.empty()) {
+            timer_token_t *token = due_tokens.head();
+            due_tokens.remove(token);
+            --wheel_size;
+            ring(token, real_ticks);
         }
     }
 
     // We've processed young tokens.  Now schedule a new one-shot (if necessary).
+    schedule_next_oneshot();
+}
+
+void timer_handler_t::schedule_next_oneshot() {
+    int64_t next_time_in_nanos = INT64_MAX;
     if (!token_queue.empty()) {
-        timer_provider.schedule_oneshot(token_queue.peek()->next_time_in_nanos, this);
+        next_time_in_nanos = token_queue.peek()->next_time_in_nanos;
+    }
+    if (wheel_size != 0) {
+        next_time_in_nanos = std::min(next_time_in_nanos,
+                                      (wheel_tick + 1) * TIMER_WHEEL_TICK_NANOS);
+    }
+
+    if (next_time_in_nanos == INT64_MAX) {
+        timer_provider.unschedule_oneshot();
+    } else {
+        expected_oneshot_time_in_nanos = next_time_in_nanos;
+        timer_provider.schedule_oneshot(next_time_in_nanos, this);
     }
 }
 
@@ -79,21 +160,34 @@ timer_token_t *timer_handler_t::add_timer_internal(const int64_t ms, timer_callb
     token->next_time_in_nanos = next_time_in_nanos;
     token->callback = callback;
 
-    const timer_token_t *top_entry = token_queue.peek();
-    token_queue.push(token);
+    if (ms >= TIMER_WHEEL_MIN_MS) {
+        const bool wheel_was_empty = wheel_size == 0;
+        add_to_wheel(token);
+        if (wheel_was_empty) {
+            schedule_next_oneshot();
+        }
+    } else {
+        const timer_token_t *top_entry = token_queue.peek();
+        token_queue.push(token);
 
-    if (top_entry == NULL || next_time_in_nanos < top_entry->next_time_in_nanos) {
-        timer_provider.schedule_oneshot(next_time_in_nanos, this);
+        if (top_entry == NULL || next_time_in_nanos < top_entry->next_time_in_nanos) {
+            schedule_next_oneshot();
+        }
     }
 
     return token;
 }
 
 void timer_handler_t::cancel_timer(timer_token_t *token) {
-    token_queue.remove(token);
+    if (token->wheel_list != NULL) {
+        token->wheel_list->remove(token);
+        --wheel_size;
+    } else {
+        token_queue.remove(token);
+    }
     delete token;
 
-    if (token_queue.empty()) {
+    if (token_queue.empty() && wheel_size == 0) {
         timer_provider.unschedule_oneshot();
     }
 }
@@ -2,8 +2,10 @@
 #ifndef ARCH_TIMER_HPP_
 #define ARCH_TIMER_HPP_
 
+#include "containers/intrusive_list.hpp"
 #include "containers/intrusive_priority_queue.hpp"
 #include "arch/io/timer_provider.hpp"
+#include "config/args.hpp"
 
 class timer_token_t;
 
@@ -14,7 +16,11 @@ struct timer_callback_t {
 
 /* This timer class uses the underlying OS timer provider to get one-shot timing events. It then
  * manages a list of application timers based on that lower level interface. Everyone who needs a
- * timer should use this class (through the thread pool). */
+ * timer should use this class (through the thread pool).
+ *
+ * Timers of at least TIMER_WHEEL_MIN_MS (timeouts, mostly, of which there can be very many) go in
+ * a hashed timing wheel, where adding and canceling them takes constant time, and they ring up to
+ * TIMER_WHEEL_TICK_MS late.  The others go in a priority queue and ring on time. */
 class timer_handler_t : private timer_provider_callback_t {
 public:
     explicit timer_handler_t(linux_event_queue_t *queue);
@@ -26,6 +32,14 @@ public:
 private:
     void on_oneshot();
 
+    void add_to_wheel(timer_token_t *token);
+    // Moves the wheel's tokens that are due at `ticks` to `due_tokens`.
+    void advance_wheel(int64_t ticks);
+    void ring(timer_token_t *token, int64_t real_ticks);
+    // Schedules the next one-shot for whichever comes first, the queue's first token
+    // or the wheel's next tick.
+    void schedule_next_oneshot();
+
     // The timer provider, a platform-dependent typedef for interfacing with the OS.
     timer_provider_t timer_provider;
 
@@ -36,6 +50,16 @@ private:
     // A priority queue of timer tokens, ordered by the soonest.
     intrusive_priority_queue_t<timer_token_t> token_queue;
 
+    // The timing wheel: a token that rings in tick t (counting ticks of
+    // TIMER_WHEEL_TICK_MS from get_ticks()'s zero) is in slot t % TIMER_WHEEL_SLOTS,
+    // whichever turn of the wheel it's for.
+    intrusive_list_t<timer_token_t> wheel[TIMER_WHEEL_SLOTS];
+    // The last tick whose slot has been looked at.
+    int64_t wheel_tick;
+    size_t wheel_size;
+    // The wheel's tokens that are about to ring.
+    intrusive_list_t<timer_token_t> due_tokens;
+
     DISABLE_COPYING(timer_handler_t);
 };
 
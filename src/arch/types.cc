@@ -8,3 +8,7 @@ file_account_t::~file_account_t() {
     parent->destroy_account(account);
 }
 
+void file_account_t::set_latency_target(int64_t latency_target_ms) {
+    parent->set_account_latency_target(account, latency_target_ms);
+}
+
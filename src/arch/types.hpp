@@ -99,6 +99,9 @@ typedef linux_tcp_listener_t tcp_listener_t;
 class linux_repeated_nonthrowing_tcp_listener_t;
 typedef linux_repeated_nonthrowing_tcp_listener_t repeated_nonthrowing_tcp_listener_t;
 
+class linux_sharded_tcp_listener_t;
+typedef linux_sharded_tcp_listener_t sharded_tcp_listener_t;
+
 class linux_tcp_conn_descriptor_t;
 typedef linux_tcp_conn_descriptor_t tcp_conn_descriptor_t;
 
@@ -110,6 +113,13 @@ enum class file_direct_io_mode_t {
     buffered_desired
 };
 
+// Which mechanism runs disk I/O operations.  `uring_desired` falls back to the blocker
+// pool if the kernel (or the build) lacks io_uring support.
+enum class file_io_backend_t {
+    pool,
+    uring_desired
+};
+
 
 
 class semantic_checking_file_t {
@@ -137,6 +147,13 @@ public:
     virtual int64_t get_size() = 0;
     virtual void set_size(int64_t size) = 0;
     virtual void set_size_at_least(int64_t size) = 0;
+    // Tells the file system (and through it, the device) that nothing needs the data
+    // in the range any more, so that an SSD doesn't have to carry it around.  Reads
+    // of the range return zeros afterwards.  Files that can't do that ignore it.
+    virtual void discard(UNUSED int64_t offset, UNUSED int64_t length) { }
+    // Blocks until everything written to the file is on disk.  Must be called in a
+    // coroutine.  Files that never lose writes (like in-memory ones) ignore it.
+    virtual void datasync() { }
 
     virtual void read_async(int64_t offset, size_t length, void *buf,
                             file_account_t *account, linux_iocallback_t *cb) = 0;
@@ -149,6 +166,9 @@ public:
 
     virtual void *create_account(int priority, int outstanding_requests_limit) = 0;
     virtual void destroy_account(void *account) = 0;
+    // Files that don't schedule I/O between accounts can ignore latency targets.
+    virtual void set_account_latency_target(UNUSED void *account,
+                                            UNUSED int64_t latency_target_ms) { }
 
     virtual bool coop_lock_and_check() = 0;
 
@@ -162,6 +182,10 @@ public:
     ~file_account_t();
     void *get_account() { return account; }
 
+    // Asks the I/O scheduler to serve this account ahead of its fair share once its
+    // operations have been waiting for `latency_target_ms`.  Zero means no target.
+    void set_latency_target(int64_t latency_target_ms);
+
 private:
     file_t *parent;
     /* account is internally a pointer to a accounting_diskmgr_t::account_t object. It has to be
@@ -2,9 +2,11 @@
 #include "btree/backfill.hpp"
 
 #include <algorithm>
+#include <map>
 
 #include "errors.hpp"
 #include <boost/bind.hpp>
+#include <boost/optional.hpp>
 
 #include "arch/runtime/coroutines.hpp"
 #include "btree/node.hpp"
@@ -13,6 +15,7 @@
 #include "btree/parallel_traversal.hpp"
 #include "btree/secondary_operations.hpp"
 #include "buffer_cache/alt/alt.hpp"
+#include "config/args.hpp"
 #include "protocol_api.hpp"
 
 struct backfill_traversal_helper_t : public btree_traversal_helper_t, public home_thread_mixin_debug_only_t {
@@ -63,6 +66,63 @@ struct backfill_traversal_helper_t : public btree_traversal_helper_t, public hom
         x.interruptor = interruptor;
 
         leaf::dump_entries_since_time(sizer_, data, since_when_, leaf_node_buf->get_recency(), &x);
+
+        mark_sent(left_exclusive_or_null, right_inclusive_or_null);
+        ++leaves_since_progress_;
+        if (leaves_since_progress_ >= BACKFILL_PROGRESS_INTERVAL_LEAVES
+            && sent_from_start_ && !sent_to_end_) {
+            leaves_since_progress_ = 0;
+            // Leaves are processed in parallel, so only report the keys from the
+            // beginning of the tree up to the first one that isn't done yet.
+            key_range_t sent_range(key_range_t::none, store_key_t(),
+                                   key_range_t::closed, sent_through_);
+            sent_range = sent_range.intersection(key_range_);
+            if (!sent_range.is_empty()) {
+                callback_->on_progress(sent_range, interruptor);
+            }
+        }
+    }
+
+    // Notes that everything in (left, right] has been passed to `callback_`,
+    // either by `process_a_leaf()` or by skipping a subtree with nothing to send.
+    // The leaves and skipped subtrees partition the key space, so their bounds
+    // line up exactly.
+    void mark_sent(const btree_key_t *left_exclusive_or_null,
+                   const btree_key_t *right_inclusive_or_null) {
+        boost::optional<store_key_t> right;
+        if (right_inclusive_or_null != NULL) {
+            right = store_key_t(right_inclusive_or_null);
+        }
+        if (left_exclusive_or_null == NULL) {
+            extend_sent(right);
+        } else {
+            store_key_t left(left_exclusive_or_null);
+            if (sent_from_start_ && !sent_to_end_ && left == sent_through_) {
+                extend_sent(right);
+            } else {
+                not_yet_contiguous_.insert(std::make_pair(left, right));
+            }
+        }
+    }
+
+    void extend_sent(const boost::optional<store_key_t> &right) {
+        sent_from_start_ = true;
+        sent_to_end_ = !right;
+        if (right) {
+            sent_through_ = *right;
+        }
+        while (!sent_to_end_) {
+            std::map<store_key_t, boost::optional<store_key_t> >::iterator it
+                = not_yet_contiguous_.find(sent_through_);
+            if (it == not_yet_contiguous_.end()) {
+                break;
+            }
+            sent_to_end_ = !it->second;
+            if (it->second) {
+                sent_through_ = *it->second;
+            }
+            not_yet_contiguous_.erase(it);
+        }
     }
 
     void postprocess_internal_node(UNUSED buf_lock_t *internal_node_buf) {
@@ -84,14 +144,18 @@ struct backfill_traversal_helper_t : public btree_traversal_helper_t, public hom
             block_id_t id;
             ids_source->get_block_id_and_bounding_interval(i, &id, &left, &right);
             if (overlaps(left, right, key_range_.left, key_range_.right)) {
-                repli_timestamp_t recency;
-                {
-                    buf_lock_t lock(parent, id, access_t::read);
-                    recency = lock.get_recency();
-                }
+                // The child's recency is the newest of its subtree's, since writes
+                // acquire every node on their way down.  We don't acquire the child
+                // to learn it, because that would load the child from disk.
+                const repli_timestamp_t recency
+                    = buf_lock_t::get_child_recency(parent, id);
                 if (recency >= since_when_) {
                     cb->receive_interesting_child(i);
+                } else {
+                    mark_sent(left, right);
                 }
+            } else {
+                mark_sent(left, right);
             }
         }
         cb->no_more_interesting_children();
@@ -131,9 +195,20 @@ struct backfill_traversal_helper_t : public btree_traversal_helper_t, public hom
     value_sizer_t<void> *sizer_;
     const key_range_t& key_range_;
 
+    // Everything from the beginning of the tree through `sent_through_` (or to
+    // the end, if `sent_to_end_`) has been sent.  `not_yet_contiguous_` maps the
+    // left-exclusive bound of each other sent interval to its right-inclusive
+    // bound.
+    bool sent_from_start_;
+    bool sent_to_end_;
+    store_key_t sent_through_;
+    std::map<store_key_t, boost::optional<store_key_t> > not_yet_contiguous_;
+    int leaves_since_progress_;
+
     backfill_traversal_helper_t(agnostic_backfill_callback_t *callback, repli_timestamp_t since_when,
                                 value_sizer_t<void> *sizer, const key_range_t& key_range)
-        : callback_(callback), since_when_(since_when), sizer_(sizer), key_range_(key_range) { }
+        : callback_(callback), since_when_(since_when), sizer_(sizer), key_range_(key_range),
+          sent_from_start_(false), sent_to_end_(false), leaves_since_progress_(0) { }
 };
 
 void do_agnostic_btree_backfill(value_sizer_t<void> *sizer,
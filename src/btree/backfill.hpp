@@ -29,6 +29,8 @@ public:
                          const btree_key_t *key, const void *value,
                          signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
     virtual void on_sindexes(const std::map<std::string, secondary_index_t> &sindexes, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
+    // Every change in `sent_range` has already been passed to the other methods.
+    virtual void on_progress(const key_range_t &sent_range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
     virtual ~agnostic_backfill_callback_t() { }
 };
 
@@ -1,9 +1,12 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "btree/btree_store.hpp"
 
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
 #include "btree/operations.hpp"
 #include "btree/secondary_operations.hpp"
 #include "buffer_cache/alt/alt.hpp"
+#include "buffer_cache/alt/cache_balancer.hpp"
 #include "concurrency/wait_any.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "serializer/config.hpp"
@@ -38,6 +41,7 @@ btree_store_t<protocol_t>::btree_store_t(serializer_t *serializer,
     {
         alt_cache_config_t config;
         config.page_config.memory_limit = cache_target;
+        config.page_config.balancer = get_global_cache_balancer();
         cache.init(new cache_t(serializer, config, &perfmon_collection));
         general_cache_conn.init(new cache_conn_t(cache.get()));
     }
@@ -58,6 +62,7 @@ btree_store_t<protocol_t>::btree_store_t(serializer_t *serializer,
     }
 
     btree.init(new btree_slice_t(cache.get(), &perfmon_collection, "primary"));
+    btree->set_field_dictionary(&field_dictionary);
 
     // Initialize sindex slices
     {
@@ -73,6 +78,11 @@ btree_store_t<protocol_t>::btree_store_t(serializer_t *serializer,
         acquire_superblock_for_read(&token_pair.main_read_token, &txn,
                                     &superblock, &dummy_interruptor, false);
 
+        load_field_dictionary(superblock->get(), &field_dictionary);
+        // The messages are loaded even if the buffer is turned off, so that they're
+        // flushed rather than lost.
+        write_buffer.load(superblock->get());
+
         buf_lock_t sindex_block
             = acquire_sindex_block_for_read(superblock->expose_buf(),
                                             superblock->get_sindex_block_id());
@@ -81,10 +91,7 @@ btree_store_t<protocol_t>::btree_store_t(serializer_t *serializer,
         get_secondary_indexes(&sindex_block, &sindexes);
 
         for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
-            secondary_index_slices.insert(it->first,
-                                          new btree_slice_t(cache.get(),
-                                                            &perfmon_collection,
-                                                            it->first));
+            secondary_index_slices.insert(it->first, new_sindex_slice(it->first));
         }
     }
 }
@@ -92,6 +99,8 @@ btree_store_t<protocol_t>::btree_store_t(serializer_t *serializer,
 template <class protocol_t>
 btree_store_t<protocol_t>::~btree_store_t() {
     assert_thread();
+    guarantee(!defragmenter_drainer.has(),
+              "The protocol's store didn't stop the defragmenter.");
 }
 
 template <class protocol_t>
@@ -104,12 +113,21 @@ void btree_store_t<protocol_t>::read(
         signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t) {
     assert_thread();
+    // Batch reads run (and read their blocks, see page_cache_t) at a lower priority.
+    with_priority_t p(read.priority() == QUERY_PRIORITY_BATCH
+                      ? CORO_PRIORITY_BATCH_QUERY : coro_t::self()->get_priority());
     scoped_ptr_t<txn_t> txn;
     scoped_ptr_t<real_superblock_t> superblock;
 
-    acquire_superblock_for_read(&token_pair->main_read_token, &txn, &superblock,
-                                interruptor,
-                                read.use_snapshot());
+    if (protocol_read_merges_write_buffer(read)) {
+        acquire_superblock_for_read(&token_pair->main_read_token, &txn, &superblock,
+                                    interruptor,
+                                    read.use_snapshot());
+    } else {
+        acquire_flushed_superblock_for_read(&token_pair->main_read_token, &txn,
+                                            &superblock, interruptor,
+                                            read.use_snapshot());
+    }
 
     DEBUG_ONLY(check_metainfo(DEBUG_ONLY(metainfo_checker, ) superblock.get());)
 
@@ -129,6 +147,8 @@ void btree_store_t<protocol_t>::write(
         signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t) {
     assert_thread();
+    with_priority_t p(write.priority() == QUERY_PRIORITY_BATCH
+                      ? CORO_PRIORITY_BATCH_QUERY : coro_t::self()->get_priority());
 
     scoped_ptr_t<txn_t> txn;
     scoped_ptr_t<real_superblock_t> real_superblock;
@@ -139,6 +159,18 @@ void btree_store_t<protocol_t>::write(
 
     check_and_update_metainfo(DEBUG_ONLY(metainfo_checker, ) new_metainfo,
                               real_superblock.get());
+    // Names get their ids (on disk) before any value can be written with them.
+    if (field_dictionary.assign_pending_ids()) {
+        save_field_dictionary(real_superblock->get(), field_dictionary);
+    }
+    if (buffers_writes() && protocol_write_can_be_buffered(write)) {
+        if (write_buffer.full()) {
+            flush_write_buffer(real_superblock.get());
+        }
+        write_buffer.prepare(real_superblock->get());
+    } else if (!write_buffer.empty()) {
+        flush_write_buffer(real_superblock.get());
+    }
     scoped_ptr_t<superblock_t> superblock(real_superblock.release());
     protocol_write(write, response, timestamp, btree.get(), &superblock,
                    interruptor);
@@ -194,6 +226,10 @@ void btree_store_t<protocol_t>::receive_backfill(
                                  &txn,
                                  &superblock,
                                  interruptor);
+    // The chunk's values must not be shadowed by older messages.
+    if (!write_buffer.empty()) {
+        flush_write_buffer(superblock.get());
+    }
 
     protocol_receive_backfill(btree.get(),
                               superblock.get(),
@@ -233,12 +269,120 @@ void btree_store_t<protocol_t>::reset_data(
     get_metainfo_internal(superblock->get(), &old_metainfo);
     update_metainfo(old_metainfo, new_metainfo, superblock.get());
 
+    if (!write_buffer.empty()) {
+        flush_write_buffer(superblock.get());
+    }
     protocol_reset_data(subregion,
                         btree.get(),
                         superblock.get(),
                         interruptor);
 }
 
+template <class protocol_t>
+void btree_store_t<protocol_t>::start_defragmenter(int64_t interval_secs) {
+    assert_thread();
+    guarantee(!defragmenter_drainer.has());
+    if (interval_secs <= 0) {
+        return;
+    }
+    defragmenter_drainer.init(new auto_drainer_t);
+    coro_t::spawn_sometime(std::bind(&btree_store_t<protocol_t>::run_defragmenter,
+                                     this, interval_secs,
+                                     auto_drainer_t::lock_t(defragmenter_drainer.get())));
+}
+
+template <class protocol_t>
+void btree_store_t<protocol_t>::stop_defragmenter() {
+    assert_thread();
+    defragmenter_drainer.reset();
+}
+
+template <class protocol_t>
+btree_slice_t *btree_store_t<protocol_t>::new_sindex_slice(const std::string &id) {
+    btree_slice_t *slice = new btree_slice_t(cache.get(), &perfmon_collection, id);
+    slice->set_field_dictionary(&field_dictionary);
+    return slice;
+}
+
+template <class protocol_t>
+void btree_store_t<protocol_t>::flush_write_buffer(real_superblock_t *superblock) {
+    assert_thread();
+    // Writes stop going through the buffer before a secondary index can be added
+    // (see buffers_writes()), and every write that adds one flushes the buffer, so
+    // flushes have no indexes to update.
+    rassert(secondary_index_slices.empty());
+    btree_write_buffer_t::message_map_t messages;
+    write_buffer.take_all(superblock->expose_buf(), &messages);
+    protocol_flush_write_buffer(btree.get(), superblock, messages);
+}
+
+template <class protocol_t>
+void btree_store_t<protocol_t>::flush_write_buffer_in_own_txn() {
+    assert_thread();
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    // The leaves get the messages' timestamps, which are all older than the buffer's
+    // latest one, so backfills still find them.
+    // A flush changes at most one leaf per buffered key, plus the log's block.
+    const int expected_change_count = static_cast<int>(write_buffer.message_count()) + 1;
+    get_btree_superblock_and_txn(general_cache_conn.get(), write_access_t::write,
+                                 expected_change_count,
+                                 write_buffer.latest_timestamp(),
+                                 write_durability_t::SOFT, &superblock, &txn);
+    superblock->set_routing_cache(btree->routing_cache());
+    // Another reader may have flushed the buffer while we waited for the superblock.
+    if (!write_buffer.empty()) {
+        flush_write_buffer(superblock.get());
+    }
+}
+
+template <class protocol_t>
+void btree_store_t<protocol_t>::run_defragmenter(int64_t interval_secs,
+                                                 auto_drainer_t::lock_t keepalive) {
+    try {
+        for (;;) {
+            nap(interval_secs * THOUSAND, keepalive.get_drain_signal());
+            defragment_btree(keepalive.get_drain_signal());
+        }
+    } catch (const interrupted_exc_t &) {
+        // The store is going away.
+    }
+}
+
+template <class protocol_t>
+void btree_store_t<protocol_t>::defragment_btree(signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t) {
+    store_key_t start_key = store_key_t::min();
+    for (bool more = true; more;) {
+        write_token_pair_t token_pair;
+        store_view_t<protocol_t>::new_write_token_pair(&token_pair);
+
+        // The txn must be destructed before the cache_account.
+        scoped_ptr_t<alt_cache_account_t> cache_account;
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+
+        // Nothing changes but where the leaves are, so soft durability is enough.
+        acquire_superblock_for_write(repli_timestamp_t::distant_past,
+                                     DEFRAGMENT_BATCH_LEAVES,
+                                     write_durability_t::SOFT,
+                                     &token_pair,
+                                     &txn,
+                                     &superblock,
+                                     interruptor);
+        txn->cache()->create_cache_account(DEFRAGMENT_CACHE_PRIORITY, &cache_account);
+        txn->set_account(cache_account.get());
+
+        more = protocol_defragment_leaves(btree.get(), superblock.get(), &start_key,
+                                          DEFRAGMENT_BATCH_LEAVES);
+        superblock.reset();
+        txn.reset();
+
+        // Give foreground writes the btree for a while.
+        nap(DEFRAGMENT_BATCH_DELAY_MS, interruptor);
+    }
+}
+
 template <class protocol_t>
 void btree_store_t<protocol_t>::lock_sindex_queue(buf_lock_t *sindex_block,
                                                   mutex_t::acq_t *acq) {
@@ -335,6 +479,16 @@ progress_completion_fraction_t btree_store_t<protocol_t>::get_progress(uuid_u id
     }
 }
 
+template <class protocol_t>
+double btree_store_t<protocol_t>::get_progress_elapsed_secs(uuid_u id) {
+    auto it = progress_trackers.find(id);
+    if (it == progress_trackers.end()) {
+        return 0;
+    } else {
+        return ticks_to_secs(get_ticks() - it->second->get_start_ticks());
+    }
+}
+
 // KSI: If we're going to have these functions at all, we could just pass the
 // real_superblock_t directly.
 template <class protocol_t>
@@ -386,8 +540,7 @@ bool btree_store_t<protocol_t>::add_sindex(
                                            std::vector<char>(), std::vector<char>());
         }
 
-        secondary_index_slices.insert(
-            id, new btree_slice_t(cache.get(), &perfmon_collection, id));
+        secondary_index_slices.insert(id, new_sindex_slice(id));
 
         sindex.post_construction_complete = false;
 
@@ -468,7 +621,7 @@ void btree_store_t<protocol_t>::set_sindexes(
             }
 
             std::string id = it->first;
-            secondary_index_slices.insert(id, new btree_slice_t(cache.get(), &perfmon_collection, it->first));
+            secondary_index_slices.insert(id, new_sindex_slice(id));
 
             sindex.post_construction_complete = false;
 
@@ -574,7 +727,8 @@ MUST_USE bool btree_store_t<protocol_t>::acquire_sindex_superblock_for_read(
 
     buf_lock_t superblock_lock(&sindex_block, sindex.superblock, access_t::read);
     sindex_block.reset_buf_lock();
-    sindex_sb_out->init(new real_superblock_t(std::move(superblock_lock)));
+    sindex_sb_out->init(new real_superblock_t(std::move(superblock_lock),
+                                              leaf_key_format_t::prefix_compressed));
     return true;
 }
 
@@ -606,7 +760,8 @@ MUST_USE bool btree_store_t<protocol_t>::acquire_sindex_superblock_for_write(
     buf_lock_t superblock_lock(&sindex_block, sindex.superblock,
                                access_t::write);
     sindex_block.reset_buf_lock();
-    sindex_sb_out->init(new real_superblock_t(std::move(superblock_lock)));
+    sindex_sb_out->init(new real_superblock_t(std::move(superblock_lock),
+                                              leaf_key_format_t::prefix_compressed));
     return true;
 }
 
@@ -681,7 +836,8 @@ bool btree_store_t<protocol_t>::acquire_sindex_superblocks_for_write(
 
         sindex_sbs_out->push_back(new
                 sindex_access_t(get_sindex_slice(it->first), it->second, new
-                    real_superblock_t(std::move(superblock_lock))));
+                    real_superblock_t(std::move(superblock_lock),
+                                      leaf_key_format_t::prefix_compressed)));
     }
 
     //return's true if we got all of the sindexes requested.
@@ -713,7 +869,8 @@ bool btree_store_t<protocol_t>::acquire_sindex_superblocks_for_write(
 
         sindex_sbs_out->push_back(new
                 sindex_access_t(get_sindex_slice(it->first), it->second, new
-                    real_superblock_t(std::move(superblock_lock))));
+                    real_superblock_t(std::move(superblock_lock),
+                                      leaf_key_format_t::prefix_compressed)));
     }
 
     //return's true if we got all of the sindexes requested.
@@ -859,6 +1016,7 @@ void btree_store_t<protocol_t>::acquire_superblock_for_read(
         use_snapshot ? CACHE_SNAPSHOTTED_YES : CACHE_SNAPSHOTTED_NO;
     get_btree_superblock_and_txn_for_reading(
         general_cache_conn.get(), cache_snapshotted, sb_out, txn_out);
+    (*sb_out)->set_routing_cache(btree->routing_cache());
 }
 
 template <class protocol_t>
@@ -876,6 +1034,46 @@ void btree_store_t<protocol_t>::acquire_superblock_for_backfill(
     get_btree_superblock_and_txn_for_backfilling(general_cache_conn.get(),
                                                  btree->get_backfill_account(),
                                                  sb_out, txn_out);
+    // Backfills traverse the btree, so they need the buffer's messages in it.  See
+    // acquire_flushed_superblock_for_read.
+    if (!write_buffer.empty()) {
+        sb_out->reset();
+        txn_out->reset();
+        flush_write_buffer_in_own_txn();
+        get_btree_superblock_and_txn_for_backfilling(general_cache_conn.get(),
+                                                     btree->get_backfill_account(),
+                                                     sb_out, txn_out);
+    }
+}
+
+template <class protocol_t>
+void btree_store_t<protocol_t>::acquire_flushed_superblock_for_read(
+        object_buffer_t<fifo_enforcer_sink_t::exit_read_t> *token,
+        scoped_ptr_t<txn_t> *txn_out,
+        scoped_ptr_t<real_superblock_t> *sb_out,
+        signal_t *interruptor,
+        bool use_snapshot)
+        THROWS_ONLY(interrupted_exc_t) {
+    assert_thread();
+
+    object_buffer_t<fifo_enforcer_sink_t::exit_read_t>::destruction_sentinel_t destroyer(token);
+    wait_interruptible(token->get(), interruptor);
+
+    cache_snapshotted_t cache_snapshotted =
+        use_snapshot ? CACHE_SNAPSHOTTED_YES : CACHE_SNAPSHOTTED_NO;
+    get_btree_superblock_and_txn_for_reading(
+        general_cache_conn.get(), cache_snapshotted, sb_out, txn_out);
+    // Once we have the superblock, the writes before us are done with the buffer,
+    // and the ones after us wait for our token, so the buffer has exactly the
+    // messages we have to see.
+    if (!write_buffer.empty()) {
+        sb_out->reset();
+        txn_out->reset();
+        flush_write_buffer_in_own_txn();
+        get_btree_superblock_and_txn_for_reading(
+            general_cache_conn.get(), cache_snapshotted, sb_out, txn_out);
+    }
+    (*sb_out)->set_routing_cache(btree->routing_cache());
 }
 
 template <class protocol_t>
@@ -912,6 +1110,7 @@ void btree_store_t<protocol_t>::acquire_superblock_for_write(
     get_btree_superblock_and_txn(general_cache_conn.get(), write_access_t::write,
                                  expected_change_count, timestamp,
                                  durability, sb_out, txn_out);
+    (*sb_out)->set_routing_cache(btree->routing_cache());
 }
 
 /* store_view_t interface */
@@ -13,7 +13,9 @@
 #include <boost/ptr_container/ptr_vector.hpp>
 
 #include "btree/erase_range.hpp"
+#include "btree/field_dictionary.hpp"
 #include "btree/secondary_operations.hpp"
+#include "btree/write_buffer.hpp"
 #include "buffer_cache/types.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "containers/disk_backed_queue.hpp"
@@ -26,9 +28,12 @@ struct rdb_protocol_t;
 template <class T> class btree_store_t;
 
 class btree_slice_t;
+class cache_conn_t;
+class cache_t;
 class io_backender_t;
 class superblock_t;
 class real_superblock_t;
+class txn_t;
 
 class sindex_not_post_constructed_exc_t : public std::exception {
 public:
@@ -139,6 +144,9 @@ public:
         uuid_u id, const parallel_traversal_progress_t *p);
 
     progress_completion_fraction_t get_progress(uuid_u id);
+    // How many seconds the traversal tracked under `id` has been running, or 0 if
+    // there's none.
+    double get_progress_elapsed_secs(uuid_u id);
 
     MUST_USE buf_lock_t acquire_sindex_block_for_read(
             buf_parent_t parent,
@@ -271,6 +279,42 @@ public:
                                      superblock_t *superblock,
                                      signal_t *interruptor) = 0;
 
+    // See `btree_defragment_leaves`.
+    virtual bool protocol_defragment_leaves(btree_slice_t *btree,
+                                            superblock_t *superblock,
+                                            store_key_t *start_key,
+                                            int max_leaves) = 0;
+
+    // Whether `write` may go through the write buffer (see btree/write_buffer.hpp).
+    // When it may and `buffers_writes()` is true, `protocol_write` must add it to
+    // the buffer (which write() has prepared) instead of writing it to the btree.
+    virtual bool protocol_write_can_be_buffered(
+            const typename protocol_t::write_t &write) = 0;
+
+    // Whether `read` looks for its keys in the write buffer, so that read() doesn't
+    // need to flush the buffer first.
+    virtual bool protocol_read_merges_write_buffer(
+            const typename protocol_t::read_t &read) = 0;
+
+    // Writes `messages` to the btree, in key order.  The superblock stays acquired.
+    virtual void protocol_flush_write_buffer(
+            btree_slice_t *btree,
+            superblock_t *superblock,
+            const btree_write_buffer_t::message_map_t &messages) = 0;
+
+    // Whether writes that can go through the write buffer do.  Tables with
+    // secondary indexes write to the btree, since the indexes are updated from it.
+    bool buffers_writes() const {
+        return write_buffer.enabled() && secondary_index_slices.empty();
+    }
+
+    /* Every `interval_secs` seconds, rewrites the leaves of the primary btree in key
+    order, DEFRAGMENT_BATCH_LEAVES at a time, in low-priority write transactions of
+    their own.  The protocol's store has to call `stop_defragmenter` in its
+    destructor, since the defragmenter calls `protocol_defragment_leaves`. */
+    void start_defragmenter(int64_t interval_secs);
+    void stop_defragmenter();
+
     void get_metainfo_internal(buf_lock_t *sb_buf,
                                region_map_t<protocol_t, binary_blob_t> *out)
         const THROWS_NOTHING;
@@ -335,7 +379,13 @@ public:
     // before we destruct perfmon_collection
     scoped_ptr_t<cache_t> cache;
     scoped_ptr_t<cache_conn_t> general_cache_conn;
+    // The table's field names, which all of its slices write and read rdb values
+    // with.  Names get ids at the start of write().
+    field_dictionary_t field_dictionary;
     scoped_ptr_t<btree_slice_t> btree;
+    // The writes that haven't been applied to `btree` yet.  Its size is set by
+    // whoever creates the store; the buffer is off until then.
+    btree_write_buffer_t write_buffer;
     io_backender_t *io_backender_;
     base_path_t base_path_;
     perfmon_membership_t perfmon_collection_membership;
@@ -352,6 +402,32 @@ public:
     auto_drainer_t drainer;
 
 private:
+    btree_slice_t *new_sindex_slice(const std::string &id);
+
+    // Like acquire_superblock_for_read, except that the write buffer is flushed (in
+    // a transaction of its own) before the superblock is acquired for the read.
+    void acquire_flushed_superblock_for_read(
+            object_buffer_t<fifo_enforcer_sink_t::exit_read_t> *token,
+            scoped_ptr_t<txn_t> *txn_out,
+            scoped_ptr_t<real_superblock_t> *sb_out,
+            signal_t *interruptor,
+            bool use_snapshot)
+            THROWS_ONLY(interrupted_exc_t);
+
+    // Moves the write buffer's messages to the btree, with `superblock` held for
+    // write.
+    void flush_write_buffer(real_superblock_t *superblock);
+    // The same, in a write transaction of its own.  Flushing doesn't change what's
+    // in the store, just where it's kept, so readers can do this while they hold
+    // their read tokens.
+    void flush_write_buffer_in_own_txn();
+
+    void run_defragmenter(int64_t interval_secs, auto_drainer_t::lock_t keepalive);
+    // Defragments the whole btree once.
+    void defragment_btree(signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
+
+    scoped_ptr_t<auto_drainer_t> defragmenter_drainer;
+
     DISABLE_COPYING(btree_store_t);
 };
 
@@ -0,0 +1,301 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/bulk_load.hpp"
+
+#include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
+#include "btree/operations.hpp"
+
+struct btree_bulk_loader_t::level_t {
+    level_t() : has_last_child(false), last_child_id(NULL_BLOCK_ID),
+                prev_last_child_id(NULL_BLOCK_ID), detached_node_id(NULL_BLOCK_ID),
+                detached_prev_node_id(NULL_BLOCK_ID) { }
+
+    // The internal node being filled, if there is one.
+    buf_lock_t node;
+
+    // The child most recently added to the level.  It's the rightmost child of
+    // `node` (if there is a node), and its key hasn't been put in any node yet,
+    // because that only happens once we know the next child.
+    bool has_last_child;
+    block_id_t last_child_id;
+    store_key_t last_child_key;
+
+    // The level's previous node, and its rightmost child.  We hold on to the node
+    // until the next one gets created, so that if the level ends up with a single
+    // child that doesn't have a node of its own, we can add the child to this one
+    // instead of giving it a node by itself.
+    buf_lock_t prev_node;
+    block_id_t prev_last_child_id;
+    store_key_t prev_last_child_key;
+
+    // While the loader is detached, the block ids of `node` and `prev_node`.
+    block_id_t detached_node_id;
+    block_id_t detached_prev_node_id;
+};
+
+namespace {
+
+// We stop filling an internal node while it still has room for two more pairs: one
+// for the child that `finish()` might have to add to it, and one so that our first
+// write to the node doesn't have to split it.
+bool has_room_for_two_pairs(const internal_node_t *node) {
+    return sizeof(internal_node_t) + (node->npairs + 2) * sizeof(*node->pair_offsets)
+        + 2 * INTERNAL_EPSILON < node->frontmost_offset;
+}
+
+void insert_internal_pair(block_size_t block_size, buf_lock_t *node_buf,
+                          const btree_key_t *key, block_id_t lnode, block_id_t rnode) {
+    buf_write_t write(node_buf);
+    internal_node_t *node = static_cast<internal_node_t *>(write.get_data_write());
+    bool success = internal_node::insert(block_size, node, key, lnode, rnode);
+    guarantee(success);
+}
+
+block_id_t release_node(buf_lock_t *node) {
+    if (node->empty()) {
+        return NULL_BLOCK_ID;
+    }
+    const block_id_t block_id = node->block_id();
+    node->reset_buf_lock();
+    return block_id;
+}
+
+void reacquire_node(buf_parent_t parent, block_id_t block_id, buf_lock_t *node_out) {
+    rassert(node_out->empty());
+    if (block_id != NULL_BLOCK_ID) {
+        buf_lock_t lock(parent, block_id, access_t::write);
+        *node_out = std::move(lock);
+    }
+}
+
+void delete_subtree(buf_parent_t parent, block_id_t block_id) {
+    buf_lock_t lock(parent, block_id, access_t::write);
+    std::vector<block_id_t> children;
+    {
+        buf_read_t read(&lock);
+        const node_t *node = static_cast<const node_t *>(read.get_data_read());
+        if (node::is_internal(node)) {
+            const internal_node_t *internal
+                = reinterpret_cast<const internal_node_t *>(node);
+            for (int i = 0; i < internal->npairs; ++i) {
+                children.push_back(internal_node::get_pair_by_index(internal, i)->lnode);
+            }
+        }
+    }
+    for (auto it = children.begin(); it != children.end(); ++it) {
+        delete_subtree(buf_parent_t(&lock), *it);
+    }
+    lock.mark_deleted();
+}
+
+}  // namespace
+
+btree_bulk_loader_t::btree_bulk_loader_t(value_sizer_t<void> *sizer,
+                                         superblock_t *superblock,
+                                         repli_timestamp_t timestamp)
+    : sizer_(sizer), superblock_(superblock), timestamp_(timestamp),
+      num_pairs_(0), finished_(false), detached_(false),
+      detached_leaf_id_(NULL_BLOCK_ID) {
+    guarantee(superblock_->get_root_block_id() == NULL_BLOCK_ID,
+              "Bulk loading into a btree that isn't empty.");
+}
+
+btree_bulk_loader_t::~btree_bulk_loader_t() {
+    rassert(finished_ || num_pairs_ == 0,
+            "btree_bulk_loader_t destroyed without finish() being called.");
+}
+
+void btree_bulk_loader_t::add(const btree_key_t *key, const void *value) {
+    guarantee(!finished_ && !detached_);
+    guarantee(num_pairs_ == 0 || btree_key_cmp(last_key_.btree_key(), key) < 0,
+              "Bulk loaded keys must come in increasing order.");
+
+    if (!leaf_.empty()) {
+        bool full;
+        {
+            buf_read_t read(&leaf_);
+            full = leaf::is_full(sizer_, static_cast<const leaf_node_t *>(read.get_data_read()),
+                                 key, value);
+        }
+        if (full) {
+            finish_leaf();
+        }
+    }
+
+    if (leaf_.empty()) {
+        buf_lock_t lock(superblock_->expose_buf(), alt_create_t::create);
+        leaf_ = std::move(lock);
+        buf_write_t write(&leaf_);
+        leaf::init(sizer_, static_cast<leaf_node_t *>(write.get_data_write()),
+                   superblock_->leaf_key_format());
+    }
+
+    {
+        buf_write_t write(&leaf_);
+        leaf_node_t *node = static_cast<leaf_node_t *>(write.get_data_write());
+        rassert(!leaf::is_full(sizer_, node, key, value));
+        leaf::insert(sizer_, node, key, value, timestamp_,
+                     key_modification_proof_t::real_proof());
+    }
+
+    last_key_.assign(key);
+    ++num_pairs_;
+}
+
+void btree_bulk_loader_t::finish_leaf() {
+    rassert(!leaf_.empty());
+    const block_id_t leaf_id = leaf_.block_id();
+    leaf_.reset_buf_lock();
+    add_child(0, leaf_id, last_key_.btree_key());
+}
+
+void btree_bulk_loader_t::add_child(size_t level, block_id_t child_id,
+                                    const btree_key_t *child_key) {
+    if (level == levels_.size()) {
+        levels_.push_back(make_scoped<level_t>());
+    }
+    // Adding a child can add a level, but the levels themselves don't move.
+    level_t *l = levels_[level].get();
+
+    if (!l->has_last_child) {
+        l->has_last_child = true;
+        l->last_child_id = child_id;
+        l->last_child_key.assign(child_key);
+        return;
+    }
+
+    const block_size_t block_size = sizer_->block_size();
+    if (l->node.empty()) {
+        l->prev_node.reset_buf_lock();
+        buf_lock_t lock(superblock_->expose_buf(), alt_create_t::create);
+        l->node = std::move(lock);
+        buf_write_t write(&l->node);
+        internal_node::init(block_size,
+                            static_cast<internal_node_t *>(write.get_data_write()));
+    }
+
+    insert_internal_pair(block_size, &l->node, l->last_child_key.btree_key(),
+                         l->last_child_id, child_id);
+    l->last_child_id = child_id;
+    l->last_child_key.assign(child_key);
+
+    bool room;
+    {
+        buf_read_t read(&l->node);
+        room = has_room_for_two_pairs(
+            static_cast<const internal_node_t *>(read.get_data_read()));
+    }
+    if (!room) {
+        finish_internal_node(level);
+    }
+}
+
+void btree_bulk_loader_t::finish_internal_node(size_t level) {
+    level_t *l = levels_[level].get();
+    rassert(!l->node.empty());
+    rassert(l->has_last_child);
+
+    l->prev_node = std::move(l->node);
+    l->prev_last_child_id = l->last_child_id;
+    l->prev_last_child_key = l->last_child_key;
+    l->has_last_child = false;
+
+    // The node's keys go up to its rightmost child's.
+    add_child(level + 1, l->prev_node.block_id(), l->prev_last_child_key.btree_key());
+}
+
+void btree_bulk_loader_t::detach() {
+    guarantee(!finished_ && !detached_);
+    detached_ = true;
+    superblock_ = NULL;
+
+    detached_leaf_id_ = release_node(&leaf_);
+    for (auto it = levels_.begin(); it != levels_.end(); ++it) {
+        (*it)->detached_node_id = release_node(&(*it)->node);
+        (*it)->detached_prev_node_id = release_node(&(*it)->prev_node);
+    }
+}
+
+void btree_bulk_loader_t::attach(superblock_t *superblock) {
+    guarantee(detached_);
+    detached_ = false;
+    superblock_ = superblock;
+    guarantee(superblock_->get_root_block_id() == NULL_BLOCK_ID);
+
+    // The nodes aren't in the btree yet, so they hang off of the txn.
+    const buf_parent_t parent(superblock_->expose_buf().txn());
+    reacquire_node(parent, detached_leaf_id_, &leaf_);
+    for (auto it = levels_.begin(); it != levels_.end(); ++it) {
+        reacquire_node(parent, (*it)->detached_node_id, &(*it)->node);
+        reacquire_node(parent, (*it)->detached_prev_node_id, &(*it)->prev_node);
+    }
+}
+
+void btree_bulk_loader_t::abandon(buf_parent_t parent) {
+    guarantee(detached_ && !finished_);
+    finished_ = true;
+
+    // Every node is a descendant of a node we were holding, except for the
+    // children waiting for a node to be added to.  (A level's previous node is
+    // a child of the level above.)
+    if (detached_leaf_id_ != NULL_BLOCK_ID) {
+        delete_subtree(parent, detached_leaf_id_);
+    }
+    for (auto it = levels_.begin(); it != levels_.end(); ++it) {
+        if ((*it)->detached_node_id != NULL_BLOCK_ID) {
+            delete_subtree(parent, (*it)->detached_node_id);
+        } else if ((*it)->has_last_child) {
+            delete_subtree(parent, (*it)->last_child_id);
+        }
+    }
+    levels_.clear();
+}
+
+void btree_bulk_loader_t::finish() {
+    guarantee(!finished_ && !detached_);
+    finished_ = true;
+
+    if (num_pairs_ == 0) {
+        return;
+    }
+    finish_leaf();
+
+    // Finishing a level adds a child to the one above it, so this loop goes until
+    // the top level is left with a single child: the root.
+    for (size_t i = 0; i < levels_.size(); ++i) {
+        level_t *l = levels_[i].get();
+        const bool is_top = i + 1 == levels_.size();
+
+        if (!l->node.empty()) {
+            finish_internal_node(i);
+        } else if (l->has_last_child && !is_top) {
+            // A single child left over.  Every leaf must be at the same depth, so
+            // we add it to the level's previous node (which has room for it), and
+            // that node's keys now go up to the child's.
+            guarantee(!l->prev_node.empty());
+            insert_internal_pair(sizer_->block_size(), &l->prev_node,
+                                 l->prev_last_child_key.btree_key(),
+                                 l->prev_last_child_id, l->last_child_id);
+            l->has_last_child = false;
+
+            level_t *parent = levels_[i + 1].get();
+            guarantee(parent->has_last_child
+                      && parent->last_child_id == l->prev_node.block_id());
+            parent->last_child_key = l->last_child_key;
+        }
+        l->prev_node.reset_buf_lock();
+    }
+
+    level_t *top = levels_.back().get();
+    guarantee(top->has_last_child && top->node.empty());
+    insert_root(top->last_child_id, superblock_);
+    levels_.clear();
+
+    ensure_stat_block(superblock_);
+    buf_lock_t stat_block(buf_parent_t(superblock_->expose_buf().txn()),
+                          superblock_->get_stat_block_id(), access_t::write);
+    buf_write_t stat_block_write(&stat_block);
+    static_cast<btree_statblock_t *>(stat_block_write.get_data_write())->population
+        += num_pairs_;
+}
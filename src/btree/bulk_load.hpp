@@ -0,0 +1,83 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BTREE_BULK_LOAD_HPP_
+#define BTREE_BULK_LOAD_HPP_
+
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "containers/scoped.hpp"
+#include "repli_timestamp.hpp"
+
+class superblock_t;
+template <class> class value_sizer_t;
+
+/* Builds a btree bottom-up out of key/value pairs that come in increasing key
+order, instead of inserting them one at a time from the root.  Leaf nodes are
+filled up completely, one after the other, and the internal nodes above them are
+built along with them, so every node is written exactly once and the blocks get
+created in key order.  The btree must be empty when the loader is constructed, and
+nothing else may touch it until `finish()` is called.
+
+The nodes are created in the superblock's transaction, so they're written out when
+it commits.  To spread a big load over several transactions, call `detach()` before
+releasing the superblock and `attach()` with the next transaction's superblock.  The
+nodes written so far aren't reachable from the superblock until `finish()`, so if
+the load has to be given up on, `abandon()` deletes them. */
+class btree_bulk_loader_t {
+public:
+    btree_bulk_loader_t(value_sizer_t<void> *sizer, superblock_t *superblock,
+                        repli_timestamp_t timestamp);
+    ~btree_bulk_loader_t();
+
+    // `key` must be greater than the previously added key.  The value must be a
+    // value of the sizer's type (whose blocks, if any, have been created already).
+    void add(const btree_key_t *key, const void *value);
+
+    // Finishes the internal nodes, and makes the btree's root point at the new
+    // nodes.
+    void finish();
+
+    // Releases the nodes the loader is holding on to, so that the superblock's
+    // transaction can commit.  No other calls are allowed until `attach()` or
+    // `abandon()`.
+    void detach();
+
+    // Acquires the nodes again, in the transaction of `superblock`, which must be
+    // the superblock of the same btree.
+    void attach(superblock_t *superblock);
+
+    // Deletes every node the loader created, instead of finishing.  The loader
+    // must be detached.  The values aren't deleted: they still belong to the
+    // caller.
+    void abandon(buf_parent_t parent);
+
+    int64_t num_pairs() const { return num_pairs_; }
+
+private:
+    struct level_t;
+
+    void finish_leaf();
+    void add_child(size_t level, block_id_t child_id, const btree_key_t *child_key);
+    void finish_internal_node(size_t level);
+
+    value_sizer_t<void> *const sizer_;
+    superblock_t *superblock_;
+    const repli_timestamp_t timestamp_;
+
+    buf_lock_t leaf_;
+    store_key_t last_key_;
+    int64_t num_pairs_;
+    bool finished_;
+
+    // While we're detached, the block ids of the nodes we were holding.
+    bool detached_;
+    block_id_t detached_leaf_id_;
+
+    // levels_[0] is the level right above the leaf nodes.
+    std::vector<scoped_ptr_t<level_t> > levels_;
+
+    DISABLE_COPYING(btree_bulk_loader_t);
+};
+
+#endif  // BTREE_BULK_LOAD_HPP_
@@ -1,9 +1,15 @@
 #include "btree/concurrent_traversal.hpp"
 
+#include <algorithm>
+#include <deque>
+#include <vector>
+
 #include "arch/runtime/coroutines.hpp"
+#include "btree/operations.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/semaphore.hpp"
 #include "concurrency/fifo_enforcer.hpp"
+#include "concurrency/wait_any.hpp"
 
 class incr_decr_t {
 public:
@@ -137,21 +143,213 @@ void concurrent_traversal_fifo_enforcer_signal_t::wait_interruptible()
     ::wait_interruptible(eval_exclusivity_signal_, parent_->failure_cond_);
 }
 
+// Waits for `cond`, or for `stop`, and resets `cond` if it was pulsed.
+static void wait_and_reset(cond_t *cond, signal_t *stop) {
+    {
+        wait_any_t waiter(cond, stop);
+        waiter.wait_lazily_unordered();
+    }
+    if (cond->is_pulsed()) {
+        cond->reset();
+    }
+}
+
+/* The callback of one subrange's traversal, when a traversal is split up.  It holds
+on to the subrange's pairs until the coroutine that goes through the subranges in
+order gets to them, and it stops the subrange's traversal while it's holding
+CONCURRENT_TRAVERSAL_SUBRANGE_LOOKAHEAD of them. */
+class subrange_buffer_t : public depth_first_traversal_callback_t {
+public:
+    explicit subrange_buffer_t(signal_t *stop) : stop_(stop), done_(false) { }
+
+    void traverse(btree_slice_t *slice, counted_t<counted_buf_lock_t> block,
+                  const key_range_t &range, direction_t direction,
+                  auto_drainer_t::lock_t) {
+        btree_depth_first_traversal(slice, std::move(block), range, this, direction);
+        done_ = true;
+        pair_added_.pulse_if_not_already_pulsed();
+    }
+
+    virtual bool handle_pair(scoped_key_value_t &&keyvalue) {
+        while (pairs_.size() >= CONCURRENT_TRAVERSAL_SUBRANGE_LOOKAHEAD
+               && !stop_->is_pulsed()) {
+            wait_and_reset(&pair_taken_, stop_);
+        }
+        if (stop_->is_pulsed()) {
+            return false;
+        }
+        pairs_.push_back(std::move(keyvalue));
+        pair_added_.pulse_if_not_already_pulsed();
+        return true;
+    }
+
+    // Waits until there's a pair to take, returning false if the subrange's
+    // traversal finished instead.
+    bool wait_for_pair() {
+        while (pairs_.empty() && !done_ && !stop_->is_pulsed()) {
+            wait_and_reset(&pair_added_, stop_);
+        }
+        return !pairs_.empty();
+    }
+
+    scoped_key_value_t take_pair() {
+        guarantee(!pairs_.empty());
+        scoped_key_value_t keyvalue(std::move(pairs_.front()));
+        pairs_.pop_front();
+        pair_taken_.pulse_if_not_already_pulsed();
+        return keyvalue;
+    }
+
+private:
+    signal_t *const stop_;
+    std::deque<scoped_key_value_t> pairs_;
+    bool done_;
+    cond_t pair_added_;
+    cond_t pair_taken_;
+
+    DISABLE_COPYING(subrange_buffer_t);
+};
+
+/* Splits `range` at the boundaries between the children of the highest node whose
+children the range is spread over, into at most `max_subranges` subranges.  If the
+range is all in one leaf, it isn't split. */
+static void split_traversal_range(counted_t<counted_buf_lock_t> block,
+                                  const key_range_t &range, int max_subranges,
+                                  std::vector<key_range_t> *subranges_out) {
+    for (;;) {
+        block_id_t child_id;
+        {
+            buf_read_t read(block.get());
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+            if (node::is_leaf(node)) {
+                break;
+            }
+            const internal_node_t *inode
+                = reinterpret_cast<const internal_node_t *>(node);
+            const int start_index
+                = internal_node::get_offset_index(inode, range.left.btree_key());
+            int end_index;
+            if (range.right.unbounded) {
+                end_index = inode->npairs;
+            } else {
+                store_key_t r = range.right.key;
+                r.decrement();
+                end_index = internal_node::get_offset_index(inode, r.btree_key()) + 1;
+            }
+            const int num_children = end_index - start_index;
+
+            if (num_children >= 2) {
+                const int n = std::min(max_subranges, num_children);
+                key_range_t subrange = range;
+                for (int k = 1; k < n; ++k) {
+                    // The children up to the boundary have keys no greater than
+                    // the key of the pair before it.
+                    const int boundary = start_index + k * num_children / n;
+                    store_key_t split(
+                        &internal_node::get_pair_by_index(inode, boundary - 1)->key);
+                    if (!split.increment() || !(subrange.left < split)
+                        || (!range.right.unbounded && !(split < range.right.key))) {
+                        continue;
+                    }
+                    subrange.right = key_range_t::right_bound_t(split);
+                    subranges_out->push_back(subrange);
+                    subrange.left = split;
+                }
+                subrange.right = range.right;
+                subranges_out->push_back(subrange);
+                return;
+            }
+            child_id = internal_node::get_pair_by_index(inode, start_index)->lnode;
+        }
+        block = make_counted<counted_buf_lock_t>(block.get(), child_id, access_t::read);
+    }
+    subranges_out->push_back(range);
+}
+
+/* Like btree_depth_first_traversal, but the range is split up into subranges that
+get traversed at the same time, so that their blocks get loaded at the same time.
+The callback still gets the pairs in order, one subrange after the other. */
+static bool split_depth_first_traversal(btree_slice_t *slice,
+                                        superblock_t *superblock,
+                                        const key_range_t &range,
+                                        depth_first_traversal_callback_t *cb,
+                                        direction_t direction,
+                                        int max_subranges) {
+    const block_id_t root_block_id = superblock->get_root_block_id();
+    if (root_block_id == NULL_BLOCK_ID) {
+        superblock->release();
+        return true;
+    }
+    counted_t<counted_buf_lock_t> root_block
+        = make_counted<counted_buf_lock_t>(superblock->expose_buf(), root_block_id,
+                                           access_t::read);
+    superblock->release();
+
+    std::vector<key_range_t> subranges;
+    split_traversal_range(root_block, range, max_subranges, &subranges);
+    if (subranges.size() == 1) {
+        return btree_depth_first_traversal(slice, std::move(root_block), range, cb,
+                                           direction);
+    }
+    if (direction == BACKWARD) {
+        std::reverse(subranges.begin(), subranges.end());
+    }
+
+    // Tells the subranges' traversals to stop, because we're done with them.
+    cond_t stop;
+    std::vector<scoped_ptr_t<subrange_buffer_t> > buffers;
+    bool reached_end = true;
+    {
+        auto_drainer_t drainer;
+        for (auto it = subranges.begin(); it != subranges.end(); ++it) {
+            buffers.push_back(make_scoped<subrange_buffer_t>(&stop));
+            coro_t::spawn_sometime(std::bind(&subrange_buffer_t::traverse,
+                                             buffers.back().get(), slice, root_block,
+                                             *it, direction,
+                                             auto_drainer_t::lock_t(&drainer)));
+        }
+        root_block.reset();
+
+        for (auto it = buffers.begin(); reached_end && it != buffers.end(); ++it) {
+            while (reached_end && (*it)->wait_for_pair()) {
+                reached_end = cb->handle_pair((*it)->take_pair());
+            }
+        }
+        stop.pulse();
+    }
+    return reached_end;
+}
+
 bool btree_concurrent_traversal(btree_slice_t *slice,
                                 superblock_t *superblock, const key_range_t &range,
                                 concurrent_traversal_callback_t *cb,
-                                direction_t direction) {
+                                direction_t direction,
+                                cache_access_pattern_t access_pattern,
+                                int max_subranges) {
+    // The traversal releases the superblock, but the transaction outlives it.
+    txn_t *txn = superblock->expose_buf().txn();
+    const cache_access_pattern_t old_access_pattern = txn->access_pattern();
+    txn->set_access_pattern(access_pattern);
+
     cond_t failure_cond;
     bool failure_seen;
     {
         concurrent_traversal_adapter_t adapter(cb, &failure_cond);
-        failure_seen = !btree_depth_first_traversal(slice, superblock,
-                                                    range, &adapter, direction);
+        // Profiling traces can't follow subranges being traversed at once.
+        if (max_subranges > 1 && cb->get_trace() == NULL) {
+            failure_seen = !split_depth_first_traversal(slice, superblock, range,
+                                                        &adapter, direction,
+                                                        max_subranges);
+        } else {
+            failure_seen = !btree_depth_first_traversal(slice, superblock,
+                                                        range, &adapter, direction);
+        }
     }
     // Now that adapter is destroyed, the operations that might have failed have all
     // drained.  (If we fail, we try to report it to btree_depth_first_traversal (to
     // kill the traversal), but it's possible for us to fail after
     // btree_depth_first_traversal returns.)
     guarantee(!(failure_seen && !failure_cond.is_pulsed()));
+    txn->set_access_pattern(old_access_pattern);
     return !failure_cond.is_pulsed();
 }
@@ -2,6 +2,7 @@
 #define BTREE_CONCURRENT_TRAVERSAL_HPP_
 
 #include "btree/depth_first_traversal.hpp"
+#include "buffer_cache/types.hpp"
 
 class concurrent_traversal_adapter_t;
 
@@ -42,10 +43,18 @@ private:
     DISABLE_COPYING(concurrent_traversal_callback_t);
 };
 
+// access_pattern is passed on to the cache as a hint for the blocks the traversal
+// reads; callers that sweep a large range should pass one_shot.  If max_subranges is
+// more than 1, the range is split at internal node boundaries into up to that many
+// subranges, which are traversed at the same time (so that many more blocks get
+// read at once), while cb still sees the pairs in order.  That only pays off for
+// callers that are going to read all (or most) of the range.
 bool btree_concurrent_traversal(btree_slice_t *slice,
                                 superblock_t *superblock, const key_range_t &range,
                                 concurrent_traversal_callback_t *cb,
-                                direction_t direction);
+                                direction_t direction,
+                                cache_access_pattern_t access_pattern,
+                                int max_subranges);
 
 
 
@@ -0,0 +1,124 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/defragment.hpp"
+
+#include "btree/internal_node.hpp"
+#include "btree/operations.hpp"
+#include "buffer_cache/alt/alt.hpp"
+
+bool defragment_leaves_with_writer(value_sizer_t<void> *sizer,
+                                   superblock_t *superblock,
+                                   btree_routing_cache_t *routing_cache,
+                                   store_key_t *start_key,
+                                   int max_leaves) {
+    // The keys in the parent's subtree are all at most `right_bound`, if there is one.
+    bool has_right_bound = false;
+    store_key_t right_bound;
+    bool superblock_released = false;
+
+    // Walk down to the leaf that holds `*start_key`, like a write does.
+    buf_lock_t parent;
+    buf_lock_t leaf = get_root(sizer, superblock);
+    for (;;) {
+        {
+            buf_read_t read(&leaf);
+            if (!node::is_internal(static_cast<const node_t *>(read.get_data_read()))) {
+                break;
+            }
+        }
+
+        if (!parent.empty() && !superblock_released) {
+            superblock->release();
+            superblock_released = true;
+        }
+        parent.reset_buf_lock();
+
+        block_id_t child_id;
+        {
+            buf_read_t read(&leaf);
+            auto node = static_cast<const internal_node_t *>(read.get_data_read());
+            const int index = internal_node::get_offset_index(node, start_key->btree_key());
+            const btree_internal_pair *pair = internal_node::get_pair_by_index(node, index);
+            child_id = pair->lnode;
+            if (index < node->npairs - 1) {
+                has_right_bound = true;
+                right_bound.assign(&pair->key);
+            }
+        }
+
+        buf_lock_t child(&leaf, child_id, access_t::write);
+        parent = std::move(leaf);
+        leaf = std::move(child);
+    }
+
+    store_key_t cursor = *start_key;
+    for (int num_leaves = 1; ; ++num_leaves) {
+        if (!parent.empty()) {
+            // `cursor` is in the leaf's range of keys, so the leaf's siblings are
+            // found through it.  (The defragmenter doesn't keep track of the
+            // tree's right edge, so it levels the leaves there too.)
+            check_and_handle_underfull(sizer, &leaf, &parent, superblock, routing_cache,
+                                       cursor.btree_key(), false);
+            if (!superblock_released
+                && superblock->get_root_block_id() != parent.block_id()) {
+                // The root's last two children were merged into the new root.
+                parent.reset_buf_lock();
+            }
+        }
+
+        {
+            buf_write_t write(&leaf);
+            write.get_data_write();
+        }
+        leaf.reset_buf_lock();
+
+        if (parent.empty()) {
+            // The root is a leaf.
+            return false;
+        }
+
+        block_id_t next_id;
+        {
+            buf_read_t read(&parent);
+            auto node = static_cast<const internal_node_t *>(read.get_data_read());
+            const int index = internal_node::get_offset_index(node, cursor.btree_key());
+            if (index == node->npairs - 1) {
+                // That was the parent's last leaf; the next batch starts in the next
+                // subtree.
+                *start_key = right_bound;
+                return has_right_bound && start_key->increment();
+            }
+            cursor.assign(&internal_node::get_pair_by_index(node, index)->key);
+            if (!cursor.increment()) {
+                return false;
+            }
+            next_id = internal_node::get_pair_by_index(node, index + 1)->lnode;
+        }
+
+        if (num_leaves == max_leaves) {
+            *start_key = cursor;
+            return true;
+        }
+        leaf = buf_lock_t(&parent, next_id, access_t::write);
+    }
+}
+
+bool btree_defragment_leaves(value_sizer_t<void> *sizer,
+                             superblock_t *superblock,
+                             store_key_t *start_key,
+                             int max_leaves) {
+    guarantee(max_leaves > 0);
+    if (superblock->get_root_block_id() == NULL_BLOCK_ID) {
+        return false;
+    }
+
+    btree_routing_cache_t *routing_cache = superblock->routing_cache();
+    if (routing_cache != NULL) {
+        routing_cache->add_writer();
+    }
+    const bool more = defragment_leaves_with_writer(sizer, superblock, routing_cache,
+                                                    start_key, max_leaves);
+    if (routing_cache != NULL) {
+        routing_cache->remove_writer();
+    }
+    return more;
+}
@@ -0,0 +1,27 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BTREE_DEFRAGMENT_HPP_
+#define BTREE_DEFRAGMENT_HPP_
+
+#include "btree/node.hpp"
+
+struct store_key_t;
+class superblock_t;
+
+/* After many inserts and deletes, the leaves of a btree end up scattered over the
+serializer's extents, and many of them are partly empty, since writes only merge
+leaves on deletes.  Range scans then read their leaves from all over the disk.
+
+This rewrites up to `max_leaves` leaves with the same parent, in key order, starting
+with the one that holds `*start_key`.  Each of them is merged or leveled with a
+neighbour if it's underfull, and then dirtied, so that the leaves of the batch are
+all written out together by the same flush.  `superblock` must be held for write;
+it gets released once it's no longer needed, like in a write.
+
+Returns false if the batch reached the end of the btree, and otherwise sets
+`*start_key` to where the next batch should start. */
+bool btree_defragment_leaves(value_sizer_t<void> *sizer,
+                             superblock_t *superblock,
+                             store_key_t *start_key,
+                             int max_leaves);
+
+#endif  // BTREE_DEFRAGMENT_HPP_
@@ -1,17 +1,13 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "btree/depth_first_traversal.hpp"
 
+#include <algorithm>
+#include <vector>
+
 #include "btree/operations.hpp"
+#include "config/args.hpp"
 #include "rdb_protocol/profile.hpp"
 
-/* Returns `true` if we reached the end of the subtree or range, and `false` if
-`cb->handle_value()` returned `false`. */
-bool btree_depth_first_traversal(btree_slice_t *slice,
-                                 counted_t<counted_buf_lock_t> block,
-                                 const key_range_t &range,
-                                 depth_first_traversal_callback_t *cb,
-                                 direction_t direction);
-
 bool btree_depth_first_traversal(btree_slice_t *slice, superblock_t *superblock,
                                  const key_range_t &range,
                                  depth_first_traversal_callback_t *cb,
@@ -41,6 +37,19 @@ bool btree_depth_first_traversal(btree_slice_t *slice, superblock_t *superblock,
     }
 }
 
+static void prefetch_children(buf_lock_t *block, const internal_node_t *inode,
+                              int start_index, int end_index, int i,
+                              direction_t direction) {
+    const int n = std::min(BTREE_TRAVERSAL_PREFETCH_WINDOW, (end_index - start_index) - i);
+    std::vector<block_id_t> block_ids;
+    block_ids.reserve(n);
+    for (int j = i; j < i + n; ++j) {
+        int true_index = (direction == FORWARD ? start_index + j : (end_index - 1) - j);
+        block_ids.push_back(internal_node::get_pair_by_index(inode, true_index)->lnode);
+    }
+    block->cache()->prefetch(block_ids);
+}
+
 bool btree_depth_first_traversal(btree_slice_t *slice,
                                  counted_t<counted_buf_lock_t> block,
                                  const key_range_t &range,
@@ -59,7 +68,14 @@ bool btree_depth_first_traversal(btree_slice_t *slice,
             r.decrement();
             end_index = internal_node::get_offset_index(inode, r.btree_key()) + 1;
         }
-        for (int i = 0; i < end_index - start_index; ++i) {
+        const int num_children = end_index - start_index;
+        for (int i = 0; i < num_children; ++i) {
+            if (num_children > 1 && i % BTREE_TRAVERSAL_PREFETCH_WINDOW == 0) {
+                // We're about to acquire the next few children one after the other,
+                // so let the cache load them all at once.
+                prefetch_children(block.get(), inode, start_index, end_index, i,
+                                  direction);
+            }
             int true_index = (direction == FORWARD ? start_index + i : (end_index - 1) - i);
             const btree_internal_pair *pair = internal_node::get_pair_by_index(inode, true_index);
             counted_t<counted_buf_lock_t> lock;
@@ -102,7 +118,7 @@ bool btree_depth_first_traversal(btree_slice_t *slice,
             for (/* assignment above */; it != leaf::rend(*lnode); ++it) {
                 key = (*it).first;
 
-                if (btree_key_cmp(key, range.left.btree_key()) <= 0) {
+                if (btree_key_cmp(key, range.left.btree_key()) < 0) {
                     break;
                 }
 
@@ -115,3 +131,78 @@ bool btree_depth_first_traversal(btree_slice_t *slice,
         return true;
     }
 }
+
+static bool btree_keys_traversal(counted_t<counted_buf_lock_t> block,
+                                 std::vector<store_key_t>::const_iterator begin,
+                                 std::vector<store_key_t>::const_iterator end,
+                                 depth_first_traversal_callback_t *cb) {
+    buf_read_t read(block.get());
+    const node_t *node = static_cast<const node_t *>(read.get_data_read());
+    if (node::is_internal(node)) {
+        const internal_node_t *inode = reinterpret_cast<const internal_node_t *>(node);
+        // The children that lead to the keys, and the first key each one leads to.
+        // The keys are sorted, so each child's keys come one after the other.
+        std::vector<block_id_t> block_ids;
+        std::vector<std::vector<store_key_t>::const_iterator> firsts;
+        int last_index = -1;
+        for (auto it = begin; it != end; ++it) {
+            int index = internal_node::get_offset_index(inode, it->btree_key());
+            if (index != last_index) {
+                block_ids.push_back(internal_node::get_pair_by_index(inode, index)->lnode);
+                firsts.push_back(it);
+                last_index = index;
+            }
+        }
+        if (block_ids.size() > 1) {
+            block->cache()->prefetch(block_ids);
+        }
+        for (size_t i = 0; i < block_ids.size(); ++i) {
+            counted_t<counted_buf_lock_t> lock;
+            {
+                profile::starter_t starter("Acquire block for read.", cb->get_trace());
+                lock = make_counted<counted_buf_lock_t>(block.get(), block_ids[i],
+                                                        access_t::read);
+            }
+            if (!btree_keys_traversal(std::move(lock), firsts[i],
+                                      i + 1 < firsts.size() ? firsts[i + 1] : end,
+                                      cb)) {
+                return false;
+            }
+        }
+        return true;
+    } else {
+        const leaf_node_t *lnode = reinterpret_cast<const leaf_node_t *>(node);
+        for (auto it = begin; it != end; ++it) {
+            auto jt = leaf::inclusive_lower_bound(it->btree_key(), *lnode);
+            if (jt == leaf::end(*lnode)
+                || btree_key_cmp((*jt).first, it->btree_key()) != 0) {
+                continue;
+            }
+            if (!cb->handle_pair(scoped_key_value_t((*jt).first, (*jt).second,
+                                                    movable_t<counted_buf_lock_t>(block)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+bool btree_keys_traversal(superblock_t *superblock,
+                          const std::vector<store_key_t> &keys,
+                          depth_first_traversal_callback_t *cb) {
+    block_id_t root_block_id = superblock->get_root_block_id();
+    if (root_block_id == NULL_BLOCK_ID || keys.empty()) {
+        superblock->release();
+        return true;
+    }
+    counted_t<counted_buf_lock_t> root_block;
+    {
+        profile::starter_t starter("Acquire block for read.", cb->get_trace());
+        root_block = make_counted<counted_buf_lock_t>(superblock->expose_buf(),
+                                                      root_block_id,
+                                                      access_t::read);
+        superblock->release();
+        root_block->read_acq_signal()->wait();
+    }
+    return btree_keys_traversal(std::move(root_block), keys.begin(), keys.end(), cb);
+}
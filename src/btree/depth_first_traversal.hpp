@@ -2,6 +2,8 @@
 #ifndef BTREE_DEPTH_FIRST_TRAVERSAL_HPP_
 #define BTREE_DEPTH_FIRST_TRAVERSAL_HPP_
 
+#include <vector>
+
 #include "btree/keys.hpp"
 #include "btree/slice.hpp"
 #include "buffer_cache/alt/alt.hpp"
@@ -21,6 +23,8 @@ public:
 
 // A btree leaf key/value pair that also owns a reference to the buf_lock_t that
 // contains said key/value pair.
+// The key is copied, because the leaf node may not hold it as is (see
+// leaf_key_format_t); the value is not.
 class scoped_key_value_t {
 public:
     scoped_key_value_t(const btree_key_t *key,
@@ -34,13 +38,12 @@ public:
         : key_(movee.key_),
           value_(movee.value_),
           buf_(std::move(movee.buf_)) {
-        movee.key_ = NULL;
         movee.value_ = NULL;
     }
 
     const btree_key_t *key() const {
         guarantee(buf_.has());
-        return key_;
+        return key_.btree_key();
     }
     const void *value() const {
         guarantee(buf_.has());
@@ -56,7 +59,7 @@ public:
     void reset() { buf_.reset(); }
 
 private:
-    const btree_key_t *key_;
+    store_key_t key_;
     const void *value_;
     movable_t<counted_buf_lock_t> buf_;
 };
@@ -85,4 +88,20 @@ bool btree_depth_first_traversal(btree_slice_t *slice, superblock_t *superblock,
                                  depth_first_traversal_callback_t *cb,
                                  direction_t direction);
 
+/* The same, but for the subtree of `block`, returning `true` if we reached the end
+of the subtree or range.  Several traversals can start from the same block at once.
+*/
+bool btree_depth_first_traversal(btree_slice_t *slice,
+                                 counted_t<counted_buf_lock_t> block,
+                                 const key_range_t &range,
+                                 depth_first_traversal_callback_t *cb,
+                                 direction_t direction);
+
+/* Calls `cb->handle_pair()` for each of the sorted `keys` that is in the btree, in
+order.  Each block on the way to the keys gets acquired once, however many of them
+it leads to.  Returns `false` if `cb->handle_pair()` returned `false`. */
+bool btree_keys_traversal(superblock_t *superblock,
+                          const std::vector<store_key_t> &keys,
+                          depth_first_traversal_callback_t *cb);
+
 #endif /* BTREE_DEPTH_FIRST_TRAVERSAL_HPP_ */
@@ -1,13 +1,107 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "btree/erase_range.hpp"
 
+#include <functional>
+#include <set>
+
+#include "arch/runtime/coroutines.hpp"
 #include "buffer_cache/alt/alt.hpp"
+#include "btree/internal_node.hpp"
 #include "btree/leaf_node.hpp"
 #include "btree/node.hpp"
+#include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
+#include "btree/routing_cache.hpp"
 #include "btree/slice.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "concurrency/fifo_checker.hpp"
 
+namespace {
+
+// Deletes the values and the blocks of a subtree that has been detached from its
+// btree (so `parent` is a txn_t).  Returns how many keys the subtree had.
+int64_t delete_detached_subtree(value_sizer_t<void> *sizer,
+                                value_deleter_t *deleter,
+                                buf_parent_t parent,
+                                block_id_t block_id) {
+    buf_lock_t lock(parent, block_id, access_t::write);
+    int64_t population = 0;
+    std::vector<block_id_t> children;
+    {
+        buf_read_t read(&lock);
+        const node_t *node = static_cast<const node_t *>(read.get_data_read());
+        if (node::is_internal(node)) {
+            const internal_node_t *internal
+                = reinterpret_cast<const internal_node_t *>(node);
+            for (int i = 0; i < internal->npairs; ++i) {
+                children.push_back(internal_node::get_pair_by_index(internal, i)->lnode);
+            }
+        } else {
+            const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+            scoped_malloc_t<char> value(sizer->max_possible_size());
+            for (auto it = leaf::begin(*leaf); it != leaf::end(*leaf); ++it) {
+                if (!(*it).first) {
+                    break;
+                }
+                // The deleter gets a copy, since it may modify the value.
+                memcpy(value.get(), (*it).second, sizer->size((*it).second));
+                deleter->delete_value(buf_parent_t(&lock), value.get());
+                ++population;
+            }
+        }
+    }
+    for (auto it = children.begin(); it != children.end(); ++it) {
+        population += delete_detached_subtree(sizer, deleter, buf_parent_t(&lock), *it);
+    }
+    lock.mark_deleted();
+    return population;
+}
+
+void subtract_from_population(txn_t *txn, block_id_t stat_block_id,
+                              int64_t population) {
+    if (population == 0) {
+        return;
+    }
+    // Like parallel_traversal's population updates, this doesn't need the stat
+    // block's parent.
+    buf_lock_t stat_block(buf_parent_t(txn), stat_block_id, access_t::write);
+    buf_write_t write(&stat_block);
+    static_cast<btree_statblock_t *>(write.get_data_write())->population
+        -= population;
+}
+
+// Checks if (x_l_excl, x_r_incl] is a subset of (y_l_excl, y_r_incl].
+bool range_contains(const btree_key_t *y_l_excl, const btree_key_t *y_r_incl,
+                    const btree_key_t *x_l_excl, const btree_key_t *x_r_incl) {
+    return (y_l_excl == NULL || (x_l_excl != NULL && sized_strcmp(y_l_excl->contents, y_l_excl->size, x_l_excl->contents, x_l_excl->size) <= 0))
+        && (y_r_incl == NULL || (x_r_incl != NULL && sized_strcmp(x_r_incl->contents, x_r_incl->size, y_r_incl->contents, y_r_incl->size) <= 0));
+}
+
+// Dropped leaves must not be routed to, so an erase that drops subtrees counts as a
+// writer to the routing cache until they're gone.
+class routing_cache_writer_t {
+public:
+    explicit routing_cache_writer_t(btree_routing_cache_t *routing_cache)
+        : routing_cache_(routing_cache) {
+        if (routing_cache_ != NULL) {
+            routing_cache_->add_writer();
+            routing_cache_->invalidate();
+        }
+    }
+    ~routing_cache_writer_t() {
+        if (routing_cache_ != NULL) {
+            routing_cache_->remove_writer();
+        }
+    }
+
+private:
+    btree_routing_cache_t *routing_cache_;
+
+    DISABLE_COPYING(routing_cache_writer_t);
+};
+
+}  // namespace
+
 class erase_range_helper_t : public btree_traversal_helper_t {
 public:
     erase_range_helper_t(value_sizer_t<void> *sizer, key_tester_t *tester,
@@ -16,9 +110,17 @@ public:
                          const btree_key_t *right_inclusive_or_null)
         : sizer_(sizer), tester_(tester), deleter_(deleter),
           left_exclusive_or_null_(left_exclusive_or_null),
-          right_inclusive_or_null_(right_inclusive_or_null)
+          right_inclusive_or_null_(right_inclusive_or_null),
+          drop_subtrees_(tester->erases_all_keys()),
+          stat_block_id_(NULL_BLOCK_ID)
     { }
 
+    void read_stat_block(buf_lock_t *stat_block) {
+        // We always have one, because we traverse for write.
+        guarantee(stat_block != NULL);
+        stat_block_id_ = stat_block->block_id();
+    }
+
     void process_a_leaf(buf_lock_t *leaf_node_buf,
                         const btree_key_t *l_excl,
                         const btree_key_t *r_incl,
@@ -57,20 +159,76 @@ public:
         *population_change_out = -static_cast<int>(keys_to_delete.size());
     }
 
-    void postprocess_internal_node(UNUSED buf_lock_t *internal_node_buf) {
-        // We don't want to do anything here.
+    // Takes the children that filter_interesting_children chose to drop out of the
+    // node, and deletes them in the background.
+    void postprocess_internal_node(buf_lock_t *internal_node_buf) {
+        if (children_to_drop_.empty()) {
+            return;
+        }
+
+        std::vector<int> indices;
+        std::vector<block_id_t> dropped;
+        {
+            buf_read_t read(internal_node_buf);
+            const internal_node_t *node
+                = static_cast<const internal_node_t *>(read.get_data_read());
+            // Backwards, so that removing a pair doesn't change the indices of the
+            // ones we have yet to remove.
+            for (int i = node->npairs - 1; i >= 0; --i) {
+                const block_id_t child_id
+                    = internal_node::get_pair_by_index(node, i)->lnode;
+                if (children_to_drop_.erase(child_id) != 0) {
+                    indices.push_back(i);
+                    dropped.push_back(child_id);
+                }
+            }
+        }
+        if (indices.empty()) {
+            return;
+        }
+
+        {
+            buf_write_t write(internal_node_buf);
+            internal_node_t *node
+                = static_cast<internal_node_t *>(write.get_data_write());
+            for (auto it = indices.begin(); it != indices.end(); ++it) {
+                internal_node::remove_by_index(sizer_->block_size(), node, *it);
+            }
+        }
+
+        for (auto it = dropped.begin(); it != dropped.end(); ++it) {
+            internal_node_buf->detach_child(*it);
+            coro_t::spawn_sometime(std::bind(&erase_range_helper_t::delete_subtree,
+                                             this, internal_node_buf->txn(), *it,
+                                             auto_drainer_t::lock_t(&drainer_)));
+        }
     }
 
     void filter_interesting_children(buf_parent_t,
                                      ranged_block_ids_t *ids_source,
                                      interesting_children_callback_t *cb) {
-        for (int i = 0, e = ids_source->num_block_ids(); i < e; ++i) {
+        const int num_children = ids_source->num_block_ids();
+        int num_dropped = 0;
+        for (int i = 0; i < num_children; ++i) {
             block_id_t block_id;
             const btree_key_t *left, *right;
             ids_source->get_block_id_and_bounding_interval(i, &block_id, &left, &right);
 
             if (overlaps(left, right, left_exclusive_or_null_, right_inclusive_or_null_)) {
-                cb->receive_interesting_child(i);
+                // We drop children whose keys all get erased, as long as their parent
+                // is an internal node (not the superblock, at level 0) and keeps at
+                // least two children.  The rest of its children are descended into
+                // as usual.
+                if (drop_subtrees_
+                    && ids_source->get_level() > 0
+                    && num_children - num_dropped > 2
+                    && range_contains(left_exclusive_or_null_, right_inclusive_or_null_,
+                                      left, right)) {
+                    children_to_drop_.insert(block_id);
+                    ++num_dropped;
+                } else {
+                    cb->receive_interesting_child(i);
+                }
             }
         }
 
@@ -104,11 +262,26 @@ public:
     }
 
 private:
+    void delete_subtree(txn_t *txn, block_id_t block_id, auto_drainer_t::lock_t) {
+        const int64_t population
+            = delete_detached_subtree(sizer_, deleter_, buf_parent_t(txn), block_id);
+        subtract_from_population(txn, stat_block_id_, population);
+    }
+
     value_sizer_t<void> *sizer_;
     key_tester_t *tester_;
     value_deleter_t *deleter_;
     const btree_key_t *left_exclusive_or_null_;
     const btree_key_t *right_inclusive_or_null_;
+    const bool drop_subtrees_;
+    block_id_t stat_block_id_;
+
+    // Children that filter_interesting_children chose to drop, which their parents
+    // haven't let go of yet.
+    std::set<block_id_t> children_to_drop_;
+
+    // Destroyed first, so that we wait for the dropped subtrees to be deleted.
+    auto_drainer_t drainer_;
 
     DISABLE_COPYING(erase_range_helper_t);
 };
@@ -118,10 +291,40 @@ void btree_erase_range_generic(value_sizer_t<void> *sizer,
         const btree_key_t *left_exclusive_or_null,
         const btree_key_t *right_inclusive_or_null,
         superblock_t *superblock, signal_t *interruptor, bool release_superblock) {
-    erase_range_helper_t helper(sizer, tester, deleter,
-                                left_exclusive_or_null, right_inclusive_or_null);
-    btree_parallel_traversal(superblock, &helper, interruptor,
-                             release_superblock);
+    if (!tester->erases_all_keys()) {
+        erase_range_helper_t helper(sizer, tester, deleter,
+                                    left_exclusive_or_null, right_inclusive_or_null);
+        btree_parallel_traversal(superblock, &helper, interruptor,
+                                 release_superblock);
+        return;
+    }
+
+    routing_cache_writer_t routing_cache_writer(superblock->routing_cache());
+
+    if (left_exclusive_or_null == NULL && right_inclusive_or_null == NULL) {
+        // The whole btree goes, so we don't even look at the root.
+        ensure_stat_block(superblock);
+        const block_id_t stat_block_id = superblock->get_stat_block_id();
+        const block_id_t root_id = superblock->get_root_block_id();
+        txn_t *txn = superblock->expose_buf().txn();
+        if (root_id != NULL_BLOCK_ID) {
+            superblock->set_root_block_id(NULL_BLOCK_ID);
+            superblock->expose_buf().detach_child(root_id);
+        }
+        if (release_superblock) {
+            superblock->release();
+        }
+        if (root_id != NULL_BLOCK_ID) {
+            const int64_t population
+                = delete_detached_subtree(sizer, deleter, buf_parent_t(txn), root_id);
+            subtract_from_population(txn, stat_block_id, population);
+        }
+    } else {
+        erase_range_helper_t helper(sizer, tester, deleter,
+                                    left_exclusive_or_null, right_inclusive_or_null);
+        btree_parallel_traversal(superblock, &helper, interruptor,
+                                 release_superblock);
+    }
 }
 
 // KSI: Wait, seriously?  Is it actually correct and proper for our
@@ -134,6 +337,7 @@ void erase_all(value_sizer_t<void> *sizer,
                bool release_superblock) {
     struct always_true_tester_t : public key_tester_t {
         bool key_should_be_erased(const btree_key_t *) { return true; }
+        bool erases_all_keys() { return true; }
     } always_true_tester;
 
     btree_erase_range_generic(sizer, &always_true_tester,
@@ -18,6 +18,11 @@ public:
     key_tester_t() { }
     virtual bool key_should_be_erased(const btree_key_t *key) = 0;
 
+    // True if `key_should_be_erased` is true for every key in the range being
+    // erased.  That lets the erase drop whole subtrees without looking at their
+    // keys one by one.
+    virtual bool erases_all_keys() { return false; }
+
 protected:
     virtual ~key_tester_t() { }
 private:
@@ -28,6 +33,7 @@ struct always_true_key_tester_t : public key_tester_t {
     bool key_should_be_erased(UNUSED const btree_key_t *key) {
         return true;
     }
+    bool erases_all_keys() { return true; }
 };
 
 class value_deleter_t {
@@ -41,6 +47,11 @@ protected:
     DISABLE_COPYING(value_deleter_t);
 };
 
+/* Erases the keys in (`left_exclusive_or_null`, `right_inclusive_or_null`] that
+`tester` says to erase.  If the tester erases all of them, subtrees that lie wholly
+inside the range are detached from their parents instead of being descended into,
+and their blocks (and values) get deleted in the background, while the rest of the
+erase goes on.  That includes the root, when the whole btree is erased. */
 void btree_erase_range_generic(value_sizer_t<void> *sizer,
                                key_tester_t *tester,
                                value_deleter_t *deleter,
@@ -0,0 +1,230 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/external_sort.hpp"
+
+#include <algorithm>
+
+#include "containers/archive/stl_types.hpp"
+#include "containers/disk_backed_queue.hpp"
+#include "containers/uuid.hpp"
+
+struct external_sorter_t::run_t {
+    run_t(io_backender_t *io_backender, const serializer_filepath_t &filename,
+          perfmon_collection_t *stats_parent)
+        : queue(io_backender, filename, stats_parent), pos(0) { }
+
+    // Makes `head()` the run's smallest remaining pair, reading in the next chunk
+    // if we're done with this one.  Returns false if there are no pairs left.
+    bool load_head() {
+        if (pos == chunk.size()) {
+            chunk.clear();
+            pos = 0;
+            if (queue.empty()) {
+                return false;
+            }
+            queue.pop(&chunk);
+            guarantee(!chunk.empty());
+        }
+        return true;
+    }
+
+    const pair_t &head() const { return chunk[pos]; }
+
+    disk_backed_queue_t<std::vector<pair_t> > queue;
+
+    // The chunk we're reading from, and how far we've gotten in it.
+    std::vector<pair_t> chunk;
+    size_t pos;
+};
+
+namespace {
+
+// The space a pair takes up in memory, which is about what it takes on disk, too.
+size_t pair_size(const external_sorter_t::pair_t &pair) {
+    return sizeof(pair) + pair.second.size();
+}
+
+bool pair_key_less(const external_sorter_t::pair_t &left,
+                   const external_sorter_t::pair_t &right) {
+    return left.first < right.first;
+}
+
+// Writes pairs onto a run's queue, a chunk at a time.
+class chunk_writer_t {
+public:
+    explicit chunk_writer_t(disk_backed_queue_t<std::vector<external_sorter_t::pair_t> > *queue)
+        : queue_(queue), chunk_bytes_(0) { }
+
+    ~chunk_writer_t() {
+        rassert(chunk_.empty(), "chunk_writer_t destroyed without being flushed.");
+    }
+
+    void write(external_sorter_t::pair_t *pair) {
+        chunk_bytes_ += pair_size(*pair);
+        chunk_.push_back(std::move(*pair));
+        if (chunk_bytes_ >= EXTERNAL_SORT_CHUNK_SIZE) {
+            flush();
+        }
+    }
+
+    void flush() {
+        if (!chunk_.empty()) {
+            queue_->push(chunk_);
+            chunk_.clear();
+            chunk_bytes_ = 0;
+        }
+    }
+
+private:
+    disk_backed_queue_t<std::vector<external_sorter_t::pair_t> > *const queue_;
+    std::vector<external_sorter_t::pair_t> chunk_;
+    size_t chunk_bytes_;
+
+    DISABLE_COPYING(chunk_writer_t);
+};
+
+}  // namespace
+
+external_sorter_t::external_sorter_t(io_backender_t *io_backender,
+                                     const base_path_t &base_path,
+                                     const std::string &name,
+                                     perfmon_collection_t *stats_parent,
+                                     size_t buffer_size,
+                                     size_t fan_in)
+    : io_backender_(io_backender), base_path_(base_path), name_(name),
+      stats_parent_(stats_parent), buffer_size_(buffer_size), fan_in_(fan_in),
+      buffer_bytes_(0), num_pairs_(0), finished_adding_(false), buffer_pos_(0) {
+    guarantee(fan_in_ >= 2);
+}
+
+external_sorter_t::~external_sorter_t() { }
+
+void external_sorter_t::add(const store_key_t &key, const std::vector<char> &value) {
+    guarantee(!finished_adding_);
+    buffer_.push_back(std::make_pair(key, value));
+    buffer_bytes_ += pair_size(buffer_.back());
+    ++num_pairs_;
+
+    if (buffer_bytes_ >= buffer_size_) {
+        // We take the pairs out of the buffer before writing them, so that other
+        // calls can go on adding while we block.
+        std::vector<pair_t> pairs;
+        pairs.swap(buffer_);
+        buffer_bytes_ = 0;
+        std::sort(pairs.begin(), pairs.end(), &pair_key_less);
+        scoped_ptr_t<run_t> run = write_run(&pairs);
+        runs_.push_back(std::move(run));
+    }
+}
+
+void external_sorter_t::finish_adding() {
+    guarantee(!finished_adding_);
+    finished_adding_ = true;
+
+    std::sort(buffer_.begin(), buffer_.end(), &pair_key_less);
+    if (runs_.empty()) {
+        // Everything fit in memory.
+        return;
+    }
+
+    if (!buffer_.empty()) {
+        scoped_ptr_t<run_t> run = write_run(&buffer_);
+        runs_.push_back(std::move(run));
+        buffer_.clear();
+        buffer_bytes_ = 0;
+    }
+
+    // Each pass merges the oldest runs into a new one, until there are few enough
+    // left to merge all at once.
+    size_t begin = 0;
+    while (runs_.size() - begin > fan_in_) {
+        merge_runs(begin, begin + fan_in_);
+        begin += fan_in_;
+    }
+    runs_.erase(runs_.begin(), runs_.begin() + begin);
+
+    start_merging(0, runs_.size());
+}
+
+bool external_sorter_t::pop(pair_t *pair_out) {
+    guarantee(finished_adding_);
+    if (runs_.empty()) {
+        if (buffer_pos_ == buffer_.size()) {
+            return false;
+        }
+        *pair_out = std::move(buffer_[buffer_pos_]);
+        ++buffer_pos_;
+        return true;
+    }
+    return pop_merged(pair_out);
+}
+
+scoped_ptr_t<external_sorter_t::run_t> external_sorter_t::create_run() {
+    return make_scoped<run_t>(
+        io_backender_,
+        serializer_filepath_t(base_path_,
+                              name_ + "_" + uuid_to_str(generate_uuid())),
+        stats_parent_);
+}
+
+scoped_ptr_t<external_sorter_t::run_t> external_sorter_t::write_run(
+        std::vector<pair_t> *sorted_pairs) {
+    scoped_ptr_t<run_t> run = create_run();
+    chunk_writer_t writer(&run->queue);
+    for (auto it = sorted_pairs->begin(); it != sorted_pairs->end(); ++it) {
+        writer.write(&*it);
+    }
+    writer.flush();
+    return run;
+}
+
+void external_sorter_t::merge_runs(size_t begin, size_t end) {
+    start_merging(begin, end);
+
+    scoped_ptr_t<run_t> merged = create_run();
+    {
+        chunk_writer_t writer(&merged->queue);
+        pair_t pair;
+        while (pop_merged(&pair)) {
+            writer.write(&pair);
+        }
+        writer.flush();
+    }
+
+    // Destroying the merged runs deletes their files.
+    for (size_t i = begin; i < end; ++i) {
+        runs_[i].reset();
+    }
+    runs_.push_back(std::move(merged));
+}
+
+void external_sorter_t::start_merging(size_t begin, size_t end) {
+    rassert(merge_heap_.empty());
+    for (size_t i = begin; i < end; ++i) {
+        if (runs_[i]->load_head()) {
+            merge_heap_.push_back(runs_[i].get());
+        }
+    }
+    std::make_heap(merge_heap_.begin(), merge_heap_.end(), &run_head_greater);
+}
+
+bool external_sorter_t::pop_merged(pair_t *pair_out) {
+    if (merge_heap_.empty()) {
+        return false;
+    }
+
+    std::pop_heap(merge_heap_.begin(), merge_heap_.end(), &run_head_greater);
+    run_t *run = merge_heap_.back();
+    *pair_out = std::move(run->chunk[run->pos]);
+    ++run->pos;
+
+    if (run->load_head()) {
+        std::push_heap(merge_heap_.begin(), merge_heap_.end(), &run_head_greater);
+    } else {
+        merge_heap_.pop_back();
+    }
+    return true;
+}
+
+bool external_sorter_t::run_head_greater(run_t *left, run_t *right) {
+    return right->head().first < left->head().first;
+}
@@ -0,0 +1,85 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BTREE_EXTERNAL_SORT_HPP_
+#define BTREE_EXTERNAL_SORT_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "containers/scoped.hpp"
+#include "utils.hpp"
+
+class io_backender_t;
+class perfmon_collection_t;
+
+/* Sorts key/value pairs that don't all fit in memory, so that they can be handed to
+a `btree_bulk_loader_t`.  Pairs are collected in memory until they take up
+`buffer_size` bytes, and then they're sorted and written out to a run: a
+disk_backed_queue_t file of sorted chunks of pairs.  Once all the pairs have been
+added, `finish_adding()` merges the runs until there are at most `fan_in` of them
+left, and `pop()` merges those, giving back the pairs in key order.  If all of the
+pairs fit in the buffer, nothing gets written to disk at all.
+
+The run files are unlinked as soon as they're created, so they go away with the
+sorter (or the process). */
+class external_sorter_t {
+public:
+    typedef std::pair<store_key_t, std::vector<char> > pair_t;
+
+    external_sorter_t(io_backender_t *io_backender,
+                      const base_path_t &base_path,
+                      const std::string &name,
+                      perfmon_collection_t *stats_parent,
+                      size_t buffer_size,
+                      size_t fan_in);
+    ~external_sorter_t();
+
+    // Coroutines on the sorter's thread can call this concurrently: a call that has
+    // to write out a run doesn't stop the others from filling up the next buffer.
+    void add(const store_key_t &key, const std::vector<char> &value);
+
+    // Must be called once, after the last `add()` call returns.
+    void finish_adding();
+
+    // Returns false once every pair has been popped.  Pairs with equal keys come
+    // out in no particular order.
+    bool pop(pair_t *pair_out);
+
+    int64_t num_pairs() const { return num_pairs_; }
+
+private:
+    struct run_t;
+
+    scoped_ptr_t<run_t> write_run(std::vector<pair_t> *sorted_pairs);
+    scoped_ptr_t<run_t> create_run();
+    void merge_runs(size_t begin, size_t end);
+    void start_merging(size_t begin, size_t end);
+    bool pop_merged(pair_t *pair_out);
+
+    static bool run_head_greater(run_t *left, run_t *right);
+
+    io_backender_t *const io_backender_;
+    const base_path_t base_path_;
+    const std::string name_;
+    perfmon_collection_t *const stats_parent_;
+    const size_t buffer_size_;
+    const size_t fan_in_;
+
+    std::vector<pair_t> buffer_;
+    size_t buffer_bytes_;
+    int64_t num_pairs_;
+    bool finished_adding_;
+
+    // If there are no runs, `pop()` goes through `buffer_` instead.
+    size_t buffer_pos_;
+
+    std::vector<scoped_ptr_t<run_t> > runs_;
+
+    // The runs being merged, as a heap ordered by their smallest pairs.
+    std::vector<run_t *> merge_heap_;
+
+    DISABLE_COPYING(external_sorter_t);
+};
+
+#endif  // BTREE_EXTERNAL_SORT_HPP_
@@ -0,0 +1,140 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/field_dictionary.hpp"
+
+#include "btree/node.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "buffer_cache/alt/alt_serialize_onto_blob.hpp"
+#include "buffer_cache/alt/blob.hpp"
+#include "config/args.hpp"
+#include "containers/archive/stl_types.hpp"
+
+field_dictionary_t::field_dictionary_t() { }
+
+bool field_dictionary_t::find(const std::string &name, uint64_t *id_out) const {
+    auto it = ids_.find(name);
+    if (it == ids_.end()) {
+        return false;
+    }
+    *id_out = it->second;
+    return true;
+}
+
+const std::string *field_dictionary_t::name(uint64_t id) const {
+    return id < names_.size() ? &names_[id] : NULL;
+}
+
+void field_dictionary_t::note_missing(const std::string &name) {
+    assert_thread();
+    if (name.size() < FIELD_DICTIONARY_MIN_NAME_SIZE
+        || name.size() > FIELD_DICTIONARY_MAX_NAME_SIZE
+        || names_.size() >= FIELD_DICTIONARY_MAX_NAMES) {
+        return;
+    }
+    auto it = candidates_.find(name);
+    if (it == candidates_.end()) {
+        if (candidates_.size() >= FIELD_DICTIONARY_MAX_CANDIDATES) {
+            candidates_.clear();
+        }
+        it = candidates_.insert(std::make_pair(name, 0)).first;
+    }
+    ++it->second;
+}
+
+bool field_dictionary_t::assign_pending_ids() {
+    assert_thread();
+    bool assigned = false;
+    for (auto it = candidates_.begin(); it != candidates_.end();) {
+        if (it->second >= FIELD_DICTIONARY_PROMOTE_COUNT
+            && names_.size() < FIELD_DICTIONARY_MAX_NAMES) {
+            assigned |= add_name(it->first);
+            candidates_.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    return assigned;
+}
+
+std::vector<std::string> field_dictionary_t::names() const {
+    return std::vector<std::string>(names_.begin(), names_.end());
+}
+
+void field_dictionary_t::set_names(const std::vector<std::string> &names) {
+    assert_thread();
+    names_.clear();
+    ids_.clear();
+    candidates_.clear();
+    for (auto it = names.begin(); it != names.end(); ++it) {
+        guarantee(add_name(*it), "Duplicate name in the field dictionary.");
+    }
+}
+
+bool field_dictionary_t::add_name(const std::string &name) {
+    if (!ids_.insert(std::make_pair(name, names_.size())).second) {
+        return false;
+    }
+    names_.push_back(name);
+    return true;
+}
+
+// Superblocks from before the field dictionary have zero, SUPERBLOCK_ID, in place of
+// its block id.
+static block_id_t get_field_dictionary_block_id(buf_lock_t *superblock) {
+    buf_read_t read(superblock);
+    const btree_superblock_t *sb
+        = static_cast<const btree_superblock_t *>(read.get_data_read());
+    return sb->field_dictionary_block == SUPERBLOCK_ID
+        ? NULL_BLOCK_ID : sb->field_dictionary_block;
+}
+
+void load_field_dictionary(buf_lock_t *superblock,
+                           field_dictionary_t *dictionary_out) {
+    const block_id_t block_id = get_field_dictionary_block_id(superblock);
+    if (block_id == NULL_BLOCK_ID) {
+        dictionary_out->set_names(std::vector<std::string>());
+        return;
+    }
+
+    buf_lock_t block(superblock, block_id, access_t::read);
+    buf_read_t read(&block);
+    const btree_field_dictionary_block_t *data
+        = static_cast<const btree_field_dictionary_block_t *>(read.get_data_read());
+    guarantee(data->magic == btree_field_dictionary_block_t::expected_magic);
+
+    blob_t blob(block.cache()->get_block_size(),
+                const_cast<char *>(data->field_dictionary_blob),
+                btree_field_dictionary_block_t::FIELD_DICTIONARY_BLOB_MAXREFLEN);
+    std::vector<std::string> names;
+    deserialize_from_blob(buf_parent_t(&block), &blob, &names);
+    dictionary_out->set_names(names);
+}
+
+void save_field_dictionary(buf_lock_t *superblock,
+                           const field_dictionary_t &dictionary) {
+    const block_id_t block_id = get_field_dictionary_block_id(superblock);
+    buf_lock_t block;
+    if (block_id == NULL_BLOCK_ID) {
+        block = buf_lock_t(superblock, alt_create_t::create);
+        {
+            buf_write_t write(&block);
+            btree_field_dictionary_block_t *data
+                = static_cast<btree_field_dictionary_block_t *>(write.get_data_write());
+            data->magic = btree_field_dictionary_block_t::expected_magic;
+            memset(data->field_dictionary_blob, 0,
+                   btree_field_dictionary_block_t::FIELD_DICTIONARY_BLOB_MAXREFLEN);
+        }
+        buf_write_t sb_write(superblock);
+        btree_superblock_t *sb
+            = static_cast<btree_superblock_t *>(sb_write.get_data_write());
+        sb->field_dictionary_block = block.block_id();
+    } else {
+        block = buf_lock_t(superblock, block_id, access_t::write);
+    }
+
+    buf_write_t write(&block);
+    btree_field_dictionary_block_t *data
+        = static_cast<btree_field_dictionary_block_t *>(write.get_data_write());
+    blob_t blob(block.cache()->get_block_size(), data->field_dictionary_blob,
+                btree_field_dictionary_block_t::FIELD_DICTIONARY_BLOB_MAXREFLEN);
+    serialize_onto_blob(buf_parent_t(&block), &blob, dictionary.names());
+}
@@ -0,0 +1,73 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BTREE_FIELD_DICTIONARY_HPP_
+#define BTREE_FIELD_DICTIONARY_HPP_
+
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils.hpp"
+
+class buf_lock_t;
+
+/* A table's dictionary of field names, which lets its stored documents refer to the
+names of their fields by small ids instead of spelling them out in every row (see
+`serialize_for_storage` in rdb_protocol/datum.hpp).  Ids are never reassigned, so a
+stored document stays readable; the dictionary only grows.
+
+Writes note the names they had to spell out, and the ones that get noted often enough
+are given ids by `assign_pending_ids`, which btree_store_t::write calls (and then
+saves the dictionary) while it holds the superblock for write, before it writes any
+documents.  So a document never refers to an id that isn't on disk.  The dictionary
+lives in its own block, which the table's superblock points to. */
+class field_dictionary_t : public home_thread_mixin_debug_only_t {
+public:
+    field_dictionary_t();
+
+    // Sets `*id_out` and returns true if `name` has an id.
+    bool find(const std::string &name, uint64_t *id_out) const;
+
+    // The name with the given id, or NULL if there's no such id.  The name stays
+    // where it is for as long as the dictionary exists.
+    const std::string *name(uint64_t id) const;
+
+    size_t size() const { return names_.size(); }
+
+    // Notes that a document was written with `name` spelled out.
+    void note_missing(const std::string &name);
+
+    // Gives ids to the names that have been noted often enough, and returns whether
+    // there were any.
+    bool assign_pending_ids();
+
+    std::vector<std::string> names() const;
+    // Replaces the dictionary's names with the ones loaded from disk.
+    void set_names(const std::vector<std::string> &names);
+
+private:
+    bool add_name(const std::string &name);
+
+    // A deque, so that the names that readers point to don't move when it grows.
+    std::deque<std::string> names_;
+    std::unordered_map<std::string, uint64_t> ids_;
+
+    // How many times each name that doesn't have an id yet has been noted.
+    std::map<std::string, int> candidates_;
+
+    DISABLE_COPYING(field_dictionary_t);
+};
+
+// Loads the names of the dictionary that `superblock` points to, if it has one.
+void load_field_dictionary(buf_lock_t *superblock,
+                           field_dictionary_t *dictionary_out);
+
+// Saves `dictionary` in the block that `superblock` points to, creating the block if
+// it doesn't have one.
+void save_field_dictionary(buf_lock_t *superblock,
+                           const field_dictionary_t &dictionary);
+
+#endif  // BTREE_FIELD_DICTIONARY_HPP_
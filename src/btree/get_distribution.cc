@@ -1,9 +1,12 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "btree/get_distribution.hpp"
 
+#include <algorithm>
+
 #include "btree/internal_node.hpp"
 #include "btree/node.hpp"
 #include "btree/leaf_node.hpp"
+#include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "buffer_cache/alt/alt.hpp"
 #include "utils.hpp"
@@ -97,3 +100,185 @@ void get_btree_key_distribution(superblock_t *superblock, int depth_limit,
     btree_parallel_traversal(superblock, &helper, &non_interruptor);
     *key_count_out = helper.key_count;
 }
+
+namespace {
+
+// A key from a sampled leaf, with estimates of how many keys and bytes it stands for.
+struct distribution_sample_t {
+    store_key_t key;
+    double key_weight;
+    double byte_weight;
+};
+
+bool distribution_sample_less(const distribution_sample_t &left,
+                              const distribution_sample_t &right) {
+    return left.key < right.key;
+}
+
+// Walks from the root down to a random leaf, and adds the leaf's keys to
+// `samples_out`.  Each of them stands for `weight` keys times the number of leaves
+// the leaf stands for.
+void sample_a_leaf(superblock_t *superblock, block_id_t root_id,
+                   distribution_value_sizer_t *value_sizer, double weight,
+                   std::vector<distribution_sample_t> *samples_out) {
+    buf_lock_t buf(superblock->expose_buf(), root_id, access_t::read);
+    for (;;) {
+        block_id_t node_id;
+        {
+            buf_read_t read(&buf);
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+            if (!node::is_internal(node)) {
+                const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+                for (auto it = leaf::begin(*leaf); it != leaf::end(*leaf); ++it) {
+                    const btree_key_t *key = (*it).first;
+                    distribution_sample_t sample;
+                    sample.key = store_key_t(key);
+                    sample.key_weight = weight;
+                    sample.byte_weight
+                        = weight * (key->size + value_sizer->value_bytes((*it).second));
+                    samples_out->push_back(sample);
+                }
+                return;
+            }
+
+            const internal_node_t *internal
+                = reinterpret_cast<const internal_node_t *>(node);
+            node_id = internal_node::get_pair_by_index(internal,
+                                                       randint(internal->npairs))->lnode;
+            weight *= internal->npairs;
+        }
+
+        buf_lock_t tmp(&buf, node_id, access_t::read);
+        buf.reset_buf_lock();
+        buf = std::move(tmp);
+    }
+}
+
+// Cuts the sorted samples into buckets that each have about the same weight.
+void build_equi_depth_histogram(const std::vector<distribution_sample_t> &samples,
+                                bool by_bytes, int num_buckets,
+                                const store_key_t &left_key,
+                                std::map<store_key_t, int64_t> *histogram_out) {
+    double total_weight = 0;
+    for (auto it = samples.begin(); it != samples.end(); ++it) {
+        total_weight += by_bytes ? it->byte_weight : it->key_weight;
+    }
+    const double bucket_weight = total_weight / num_buckets;
+
+    store_key_t bucket_start = left_key;
+    double weight_so_far = 0;
+    double weight_before_bucket = 0;
+    for (auto it = samples.begin(); it != samples.end(); ++it) {
+        // A leaf that was sampled twice gives us its keys twice, and a bucket
+        // mustn't start at the same key as the one before it.
+        if (weight_so_far - weight_before_bucket >= bucket_weight
+            && bucket_start < it->key) {
+            (*histogram_out)[bucket_start]
+                = static_cast<int64_t>(weight_so_far - weight_before_bucket + 0.5);
+            bucket_start = it->key;
+            weight_before_bucket = weight_so_far;
+        }
+        weight_so_far += by_bytes ? it->byte_weight : it->key_weight;
+    }
+    (*histogram_out)[bucket_start]
+        = static_cast<int64_t>(weight_so_far - weight_before_bucket + 0.5);
+}
+
+}  // namespace
+
+void get_btree_sampled_distribution(superblock_t *superblock,
+                                    distribution_value_sizer_t *value_sizer,
+                                    int num_samples, int num_buckets,
+                                    const store_key_t &left_key,
+                                    std::map<store_key_t, int64_t> *key_counts_out,
+                                    std::map<store_key_t, int64_t> *byte_counts_out) {
+    guarantee(num_samples > 0);
+    guarantee(num_buckets > 0);
+    rassert(key_counts_out->empty() && byte_counts_out->empty());
+
+    std::vector<distribution_sample_t> samples;
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (root_id != NULL_BLOCK_ID) {
+        for (int i = 0; i < num_samples; ++i) {
+            sample_a_leaf(superblock, root_id, value_sizer, 1.0 / num_samples,
+                          &samples);
+        }
+    }
+    superblock->release();
+
+    std::sort(samples.begin(), samples.end(), &distribution_sample_less);
+    build_equi_depth_histogram(samples, false, num_buckets, left_key, key_counts_out);
+    build_equi_depth_histogram(samples, true, num_buckets, left_key, byte_counts_out);
+}
+
+namespace {
+
+// Finds the smallest (or biggest) key in the btree rooted at `root_id`.
+bool get_end_key(superblock_t *superblock, block_id_t root_id, bool rightmost,
+                 store_key_t *key_out) {
+    buf_lock_t buf(superblock->expose_buf(), root_id, access_t::read);
+    for (;;) {
+        block_id_t node_id;
+        {
+            buf_read_t read(&buf);
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+            if (!node::is_internal(node)) {
+                const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+                if (!rightmost) {
+                    auto it = leaf::begin(*leaf);
+                    if (it == leaf::end(*leaf)) {
+                        return false;
+                    }
+                    *key_out = store_key_t((*it).first);
+                } else {
+                    auto it = leaf::rbegin(*leaf);
+                    if (it == leaf::rend(*leaf)) {
+                        return false;
+                    }
+                    *key_out = store_key_t((*it).first);
+                }
+                return true;
+            }
+
+            const internal_node_t *internal
+                = reinterpret_cast<const internal_node_t *>(node);
+            node_id = internal_node::get_pair_by_index(
+                internal, rightmost ? internal->npairs - 1 : 0)->lnode;
+        }
+
+        buf_lock_t tmp(&buf, node_id, access_t::read);
+        buf.reset_buf_lock();
+        buf = std::move(tmp);
+    }
+}
+
+}  // namespace
+
+bool get_btree_key_count_if_covered(superblock_t *superblock,
+                                    const key_range_t &range,
+                                    int64_t *count_out) {
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (root_id == NULL_BLOCK_ID) {
+        *count_out = 0;
+        return true;
+    }
+
+    store_key_t leftmost, rightmost;
+    if (!get_end_key(superblock, root_id, false, &leftmost)
+        || !get_end_key(superblock, root_id, true, &rightmost)
+        || !range.contains_key(leftmost) || !range.contains_key(rightmost)) {
+        return false;
+    }
+
+    const block_id_t stat_block_id = superblock->get_stat_block_id();
+    if (stat_block_id == NULL_BLOCK_ID) {
+        return false;
+    }
+    // As in `apply_keyvalue_change`, the stat block isn't kept consistent with the
+    // rest of the btree.
+    buf_lock_t stat_block(buf_parent_t(superblock->expose_buf().txn()),
+                          stat_block_id, access_t::read);
+    buf_read_t read(&stat_block);
+    *count_out = static_cast<const btree_statblock_t *>(read.get_data_read())->population;
+    return true;
+}
@@ -2,6 +2,7 @@
 #ifndef BTREE_GET_DISTRIBUTION_HPP_
 #define BTREE_GET_DISTRIBUTION_HPP_
 
+#include <map>
 #include <vector>
 
 #include "btree/keys.hpp"
@@ -13,4 +14,39 @@ void get_btree_key_distribution(superblock_t *superblock, int depth_limit,
                                 int64_t *key_count_out,
                                 std::vector<store_key_t> *keys_out);
 
+// Tells get_btree_sampled_distribution how many bytes a leaf node's value stands
+// for, which may be more than it takes up in the leaf.
+class distribution_value_sizer_t {
+public:
+    virtual int64_t value_bytes(const void *value) = 0;
+protected:
+    virtual ~distribution_value_sizer_t() { }
+};
+
+/* Estimates how the btree's keys and bytes are spread out by walking down to
+`num_samples` leaves, choosing each node's child at random.  A leaf reached through
+nodes with n1, n2, ... children stands for n1 * n2 * ... leaves, which makes the
+estimates unbiased even when the tree is lopsided.  The sampled keys are then cut
+into at most `num_buckets` equi-depth buckets, once weighting each key by one and
+once by its size in bytes.  Each histogram maps the first key of every bucket to the
+estimated number of keys (or bytes) in it, the first bucket starting at `left_key`.
+
+The superblock is held until we're done, so it should be snapshotted if writes
+shouldn't wait for the sampling. */
+void get_btree_sampled_distribution(superblock_t *superblock,
+                                    distribution_value_sizer_t *value_sizer,
+                                    int num_samples, int num_buckets,
+                                    const store_key_t &left_key,
+                                    std::map<store_key_t, int64_t> *key_counts_out,
+                                    std::map<store_key_t, int64_t> *byte_counts_out);
+
+/* Counts the keys in `range` without visiting them, if it can.  It walks down to the
+leaves at either end of the btree, and if its smallest and biggest keys are both in
+`range`, every key is, so the count is the population the stat block keeps.
+Returns false if not (or if an end leaf has nothing but deletion entries in it).
+Like the stat block, the count may include writes that are still going on. */
+bool get_btree_key_count_if_covered(superblock_t *superblock,
+                                    const key_range_t &range,
+                                    int64_t *count_out);
+
 #endif /* BTREE_GET_DISTRIBUTION_HPP_ */
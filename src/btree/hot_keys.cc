@@ -0,0 +1,143 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/hot_keys.hpp"
+
+#include <algorithm>
+
+#include "arch/runtime/runtime.hpp"
+#include "btree/keys.hpp"
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+
+hot_key_sketch_t::hot_key_sketch_t(size_t capacity) : capacity_(capacity) {
+    guarantee(capacity_ > 0);
+    entries_.reserve(capacity_);
+}
+
+void hot_key_sketch_t::record(const std::string &key) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        ++entries_[it->second].count;
+        return;
+    }
+
+    if (entries_.size() < capacity_) {
+        index_.insert(std::make_pair(key, entries_.size()));
+        entry_t entry;
+        entry.key = key;
+        entry.count = 1;
+        entry.error = 0;
+        entries_.push_back(entry);
+        return;
+    }
+
+    size_t min_index = 0;
+    for (size_t i = 1; i < entries_.size(); ++i) {
+        if (entries_[i].count < entries_[min_index].count) {
+            min_index = i;
+        }
+    }
+    entry_t *entry = &entries_[min_index];
+    index_.erase(entry->key);
+    index_.insert(std::make_pair(key, min_index));
+    entry->key = key;
+    entry->error = entry->count;
+    ++entry->count;
+}
+
+void hot_key_sketch_t::decay() {
+    std::vector<entry_t> kept;
+    kept.reserve(capacity_);
+    index_.clear();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->count / 2 == 0) {
+            continue;
+        }
+        index_.insert(std::make_pair(it->key, kept.size()));
+        kept.push_back(*it);
+        kept.back().count /= 2;
+        kept.back().error /= 2;
+    }
+    entries_.swap(kept);
+}
+
+std::vector<hot_key_sketch_t::entry_t> hot_key_sketch_t::top(size_t n) const {
+    std::vector<entry_t> ret = entries_;
+    n = std::min(n, ret.size());
+    std::partial_sort(ret.begin(), ret.begin() + n, ret.end(),
+                      [](const entry_t &x, const entry_t &y) {
+                          return x.count > y.count;
+                      });
+    ret.resize(n);
+    return ret;
+}
+
+perfmon_hot_keys_t::perfmon_hot_keys_t()
+    : accesses_(0),
+      samples_(0),
+      keys_(HOT_KEYS_TRACKED),
+      ranges_(HOT_KEYS_TRACKED) { }
+
+bool perfmon_hot_keys_t::should_sample() {
+    assert_thread();
+    ++accesses_;
+    return accesses_ % HOT_KEYS_SAMPLE_INTERVAL == 0;
+}
+
+void perfmon_hot_keys_t::note_sample() {
+    ++samples_;
+    if (samples_ % HOT_KEYS_DECAY_SAMPLES == 0) {
+        keys_.decay();
+        ranges_.decay();
+    }
+}
+
+void perfmon_hot_keys_t::record(const store_key_t &key) {
+    if (should_sample()) {
+        keys_.record(key_to_debug_str(key));
+        note_sample();
+    }
+}
+
+void perfmon_hot_keys_t::record(const key_range_t &range) {
+    if (should_sample()) {
+        ranges_.record(key_range_to_string(range));
+        note_sample();
+    }
+}
+
+struct hot_keys_stats_t {
+    std::vector<hot_key_sketch_t::entry_t> keys;
+    std::vector<hot_key_sketch_t::entry_t> ranges;
+};
+
+void *perfmon_hot_keys_t::begin_stats() {
+    return new hot_keys_stats_t;
+}
+
+void perfmon_hot_keys_t::visit_stats(void *ctx) {
+    // The sketches are only touched on the btree's thread.
+    if (get_thread_id() == home_thread()) {
+        hot_keys_stats_t *stats = static_cast<hot_keys_stats_t *>(ctx);
+        stats->keys = keys_.top(HOT_KEYS_REPORTED);
+        stats->ranges = ranges_.top(HOT_KEYS_REPORTED);
+    }
+}
+
+scoped_ptr_t<perfmon_result_t> to_hot_keys_result(
+        const std::vector<hot_key_sketch_t::entry_t> &entries) {
+    scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        // Each sample stands for HOT_KEYS_SAMPLE_INTERVAL accesses.
+        result->insert(it->key, new perfmon_result_t(
+            strprintf("%" PRIu64, it->count * HOT_KEYS_SAMPLE_INTERVAL)));
+    }
+    return result;
+}
+
+scoped_ptr_t<perfmon_result_t> perfmon_hot_keys_t::end_stats(void *ctx) {
+    scoped_ptr_t<hot_keys_stats_t> stats(static_cast<hot_keys_stats_t *>(ctx));
+    scoped_ptr_t<perfmon_result_t> result = perfmon_result_t::alloc_map_result();
+    result->insert("hot_keys", to_hot_keys_result(stats->keys).release());
+    result->insert("hot_ranges", to_hot_keys_result(stats->ranges).release());
+    return result;
+}
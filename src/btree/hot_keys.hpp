@@ -0,0 +1,74 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BTREE_HOT_KEYS_HPP_
+#define BTREE_HOT_KEYS_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "perfmon/core.hpp"
+#include "utils.hpp"
+
+struct key_range_t;
+struct store_key_t;
+
+/* Finds the most frequent of a stream of keys, with the "space-saving" algorithm of
+Metwally, Agrawal and El Abbadi.  It counts at most `capacity` keys; a key it isn't
+counting takes the place of the one with the lowest count, and starts from that count.
+Any key that's more than a 1/capacity fraction of the stream is counted, and each
+count overestimates by at most the `error` it was started from. */
+class hot_key_sketch_t {
+public:
+    struct entry_t {
+        std::string key;
+        uint64_t count;
+        uint64_t error;
+    };
+
+    explicit hot_key_sketch_t(size_t capacity);
+
+    void record(const std::string &key);
+
+    // Halves the counts, so that the keys that were hot a while ago give way to the
+    // keys that are hot now.
+    void decay();
+
+    // The `n` keys with the highest counts, highest first.
+    std::vector<entry_t> top(size_t n) const;
+
+private:
+    const size_t capacity_;
+    std::vector<entry_t> entries_;
+    // The index of each key in `entries_`.
+    std::map<std::string, size_t> index_;
+
+    DISABLE_COPYING(hot_key_sketch_t);
+};
+
+/* The hot keys and hot ranges of a btree, for its stats.  It samples one in
+HOT_KEYS_SAMPLE_INTERVAL of the accesses it's told about, so that only the sampled
+ones pay for printing their key.  It must be used on the btree's thread. */
+class perfmon_hot_keys_t : public perfmon_t, public home_thread_mixin_t {
+public:
+    perfmon_hot_keys_t();
+
+    void record(const store_key_t &key);
+    void record(const key_range_t &range);
+
+    void *begin_stats();
+    void visit_stats(void *ctx);
+    scoped_ptr_t<perfmon_result_t> end_stats(void *ctx);
+
+private:
+    bool should_sample();
+    void note_sample();
+
+    uint64_t accesses_;
+    uint64_t samples_;
+    hot_key_sketch_t keys_;
+    hot_key_sketch_t ranges_;
+
+    DISABLE_COPYING(perfmon_hot_keys_t);
+};
+
+#endif  // BTREE_HOT_KEYS_HPP_
@@ -71,7 +71,12 @@ bool insert(UNUSED block_size_t block_size, internal_node_t *node, const btree_k
 }
 
 bool remove(block_size_t block_size, internal_node_t *node, const btree_key_t *key) {
-    int index = get_offset_index(node, key);
+    remove_by_index(block_size, node, get_offset_index(node, key));
+    return true;
+}
+
+void remove_by_index(block_size_t block_size, internal_node_t *node, int index) {
+    rassert(index >= 0 && index < node->npairs);
     impl::delete_pair(node, node->pair_offsets[index]);
     impl::delete_offset(node, index);
 
@@ -80,19 +85,10 @@ bool remove(block_size_t block_size, internal_node_t *node, const btree_key_t *k
     }
 
     validate(block_size, node);
-    return true;
 }
 
-void split(block_size_t block_size, internal_node_t *node, internal_node_t *rnode, btree_key_t *median) {
-    uint16_t total_pairs = block_size.value() - node->frontmost_offset;
-    uint16_t first_pairs = 0;
-    int index = 0;
-    while (first_pairs < total_pairs/2) { // finds the median index
-        first_pairs += pair_size(get_pair_by_index(node, index));
-        index++;
-    }
-    int median_index = index;
-
+// Moves the pairs from `median_index` on to `rnode`.
+static void split_at(block_size_t block_size, internal_node_t *node, internal_node_t *rnode, btree_key_t *median, int median_index) {
     // Equality takes the left branch, so the median should be from this node.
     const btree_key_t *median_key = &get_pair_by_index(node, median_index-1)->key;
     keycpy(median, median_key);
@@ -101,7 +97,7 @@ void split(block_size_t block_size, internal_node_t *node, internal_node_t *rnod
 
     // TODO: This is really slow because most pairs will likely be copied
     // repeatedly.  There should be a better way.
-    for (index = median_index; index < node->npairs; index++) {
+    for (int index = median_index; index < node->npairs; index++) {
         impl::delete_pair(node, node->pair_offsets[index]);
     }
 
@@ -114,6 +110,37 @@ void split(block_size_t block_size, internal_node_t *node, internal_node_t *rnod
     validate(block_size, rnode);
 }
 
+void split(block_size_t block_size, internal_node_t *node, internal_node_t *rnode, btree_key_t *median) {
+    uint16_t total_pairs = block_size.value() - node->frontmost_offset;
+    uint16_t first_pairs = 0;
+    int index = 0;
+    while (first_pairs < total_pairs/2) { // finds the median index
+        first_pairs += pair_size(get_pair_by_index(node, index));
+        index++;
+    }
+    split_at(block_size, node, rnode, median, index);
+}
+
+void split_for_append(block_size_t block_size, internal_node_t *node, internal_node_t *rnode, btree_key_t *median) {
+    rassert(node->npairs > INTERNAL_APPEND_SPLIT_PAIRS);
+    int index = node->npairs;
+    size_t moved_size = 0;
+    // Leave the node room for a pair, so that it isn't full (and split again) as
+    // soon as a write goes through it.
+    while (index > 1
+           && (index > node->npairs - INTERNAL_APPEND_SPLIT_PAIRS
+               || moved_size < sizeof(*node->pair_offsets)
+                               + impl::pair_size_with_key_size(MAX_KEY_SIZE))) {
+        --index;
+        moved_size += sizeof(*node->pair_offsets) + pair_size(get_pair_by_index(node, index));
+    }
+    split_at(block_size, node, rnode, median, index);
+}
+
+bool is_append(const internal_node_t *node, const btree_key_t *key) {
+    return get_offset_index(node, key) == node->npairs - 1;
+}
+
 void merge(block_size_t block_size, const internal_node_t *node, internal_node_t *rnode, const internal_node_t *parent) {
     validate(block_size, node);
     validate(block_size, rnode);
@@ -272,6 +299,15 @@ bool is_full(const internal_node_t *node) {
     return sizeof(internal_node_t) + (node->npairs + 1) * sizeof(*node->pair_offsets) + impl::pair_size_with_key_size(MAX_KEY_SIZE) >=  node->frontmost_offset;
 }
 
+int num_free_pairs(const internal_node_t *node) {
+    const int free_space = node->frontmost_offset
+        - static_cast<int>(sizeof(internal_node_t) + node->npairs * sizeof(*node->pair_offsets));
+    const int max_pair_space = sizeof(*node->pair_offsets)
+        + impl::pair_size_with_key_size(MAX_KEY_SIZE);
+    // is_full is true once there's only room for one more pair.
+    return free_space > 0 ? (free_space - 1) / max_pair_space : 0;
+}
+
 bool change_unsafe(const internal_node_t *node) {
     return sizeof(internal_node_t) + node->npairs * sizeof(*node->pair_offsets) + MAX_KEY_SIZE >= node->frontmost_offset;
 }
@@ -338,7 +374,21 @@ btree_internal_pair *get_pair_by_index(internal_node_t *node, int index) {
 }
 
 int get_offset_index(const internal_node_t *node, const btree_key_t *key) {
-    return std::lower_bound(node->pair_offsets, node->pair_offsets+node->npairs-1, (uint16_t) internal_key_comp::faux_offset, internal_key_comp(node, key)) - node->pair_offsets;
+    // The index of the first pair (not counting the last one, whose key is
+    // always empty) whose key is not less than `key`.  This is std::lower_bound
+    // with internal_key_comp, except that we compare key prefixes first.
+    const uint64_t key_prefix = btree_key_prefix(key);
+    int beg = 0;
+    int end = node->npairs - 1;
+    while (beg < end) {
+        const int test_point = beg + (end - beg) / 2;
+        if (btree_key_cmp(key, key_prefix, &get_pair_by_index(node, test_point)->key) > 0) {
+            beg = test_point + 1;
+        } else {
+            end = test_point;
+        }
+    }
+    return beg;
 }
 
 int nodecmp(const internal_node_t *node1, const internal_node_t *node2) {
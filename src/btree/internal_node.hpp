@@ -13,6 +13,11 @@ struct internal_node_t;
 /* EPSILON used to prevent split then merge */
 #define INTERNAL_EPSILON (sizeof(btree_key_t) + MAX_KEY_SIZE + sizeof(block_id_t))
 
+/* How many pairs the right node gets when a node at the right edge of the tree is
+split for appends.  At least three, so that it keeps two children (and so a sibling
+for each of them) after one of its children merges. */
+#define INTERNAL_APPEND_SPLIT_PAIRS 3
+
 //Note: This struct is stored directly on disk.  Changing it invalidates old data.
 struct btree_internal_pair {
     block_id_t lnode;
@@ -31,13 +36,25 @@ void init(block_size_t block_size, internal_node_t *node, const internal_node_t
 block_id_t lookup(const internal_node_t *node, const btree_key_t *key);
 bool insert(block_size_t block_size, internal_node_t *node, const btree_key_t *key, block_id_t lnode, block_id_t rnode);
 bool remove(block_size_t block_size, internal_node_t *node, const btree_key_t *key);
+// Removes the pair at `index`, so that the next pair's child covers its keys too
+// (or the previous pair's child, if it was the last pair).
+void remove_by_index(block_size_t block_size, internal_node_t *node, int index);
 void split(block_size_t block_size, internal_node_t *node, internal_node_t *rnode, btree_key_t *median);
+// Splits `node` so that the right node only gets its last few pairs (at least
+// INTERNAL_APPEND_SPLIT_PAIRS, and enough that `node` isn't full), for a node at the
+// right edge of the tree that keys are being appended to.
+void split_for_append(block_size_t block_size, internal_node_t *node, internal_node_t *rnode, btree_key_t *median);
+// Whether `key` goes to the node's last child.
+bool is_append(const internal_node_t *node, const btree_key_t *key);
 void merge(block_size_t block_size, const internal_node_t *node, internal_node_t *rnode, const internal_node_t *parent);
 bool level(block_size_t block_size, internal_node_t *node, internal_node_t *rnode, btree_key_t *replacement_key, const internal_node_t *parent);
 int sibling(const internal_node_t *node, const btree_key_t *key, block_id_t *sib_id, store_key_t *key_in_middle_out);
 void update_key(internal_node_t *node, const btree_key_t *key_to_replace, const btree_key_t *replacement_key);
 int nodecmp(const internal_node_t *node1, const internal_node_t *node2);
 bool is_full(const internal_node_t *node);
+// How many more pairs with the largest possible keys fit in the node, so that it
+// stays not full after each insertion.  Zero if the node is full.
+int num_free_pairs(const internal_node_t *node);
 bool is_underfull(block_size_t block_size, const internal_node_t *node);
 bool change_unsafe(const internal_node_t *node);
 bool is_mergable(block_size_t block_size, const internal_node_t *node, const internal_node_t *sibling, const internal_node_t *parent);
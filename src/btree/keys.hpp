@@ -34,6 +34,42 @@ inline int btree_key_cmp(const btree_key_t *left, const btree_key_t *right) {
     return sized_strcmp(left->contents, left->size, right->contents, right->size);
 }
 
+// The first eight bytes of the key (zero-padded), as a big-endian integer.  If two
+// keys' prefixes differ, comparing the prefixes orders the keys; if they're equal,
+// the keys have to be compared in full.  Node searches compute the prefix of the
+// key they're looking for once, and so get by with one integer comparison for
+// most of their probes instead of a memcmp call.
+inline uint64_t btree_key_prefix(const btree_key_t *key) {
+    uint64_t prefix;
+    if (key->size >= sizeof(prefix)) {
+        memcpy(&prefix, key->contents, sizeof(prefix));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        return __builtin_bswap64(prefix);
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return prefix;
+#endif
+    }
+    prefix = 0;
+    for (size_t i = 0; i < sizeof(prefix); ++i) {
+        prefix = (prefix << 8) | (i < key->size ? key->contents[i] : 0);
+    }
+    return prefix;
+}
+
+// Like btree_key_cmp, given left's btree_key_prefix.
+inline int btree_key_cmp(const btree_key_t *left, uint64_t left_prefix,
+                         const btree_key_t *right) {
+    const uint64_t right_prefix = btree_key_prefix(right);
+    if (left_prefix != right_prefix) {
+        return left_prefix < right_prefix ? -1 : 1;
+    }
+    if (left->size >= sizeof(uint64_t) && right->size >= sizeof(uint64_t)) {
+        return sized_strcmp(left->contents + sizeof(uint64_t), left->size - sizeof(uint64_t),
+                            right->contents + sizeof(uint64_t), right->size - sizeof(uint64_t));
+    }
+    return sized_strcmp(left->contents, left->size, right->contents, right->size);
+}
+
 struct store_key_t {
 public:
     store_key_t() {
@@ -77,11 +77,68 @@ const int SKIP_ENTRY_RESERVED = 251;
 // itself three bytes, so it can't fit in a slot of size one or two. We don't
 // expect to actually see many entries of size one or two, but it pays to be
 // thorough.
+//
+// A prefix-compressed leaf node (see `leaf_key_format_t`) also stores a key
+// prefix, as a [btree key] that immediately follows pair_offsets (so it moves
+// whenever num_pairs changes).  Its entries' keys only hold what comes after the
+// bytes they share with that prefix, followed by the number of bytes they share:
+//
+//   [btree key suffix][shared][btree value]        -- a live entry
+//   [255][btree key suffix][shared]                -- a deletion entry
+//
+// A key that doesn't share all of the prefix is just stored with a smaller
+// [shared], so nothing gets rewritten when keys are inserted.  The prefix starts
+// out empty, and is grown to the common prefix of the node's keys when the node is
+// split.  Binary search doesn't need restart points: every entry knows its full
+// key, because [shared] is relative to the node's prefix and not to the previous
+// key.  The node's magic is that of the value type's leaf nodes with "px" in
+// front, so that the format can be told from the node alone.
 
 
 struct entry_t;
 struct value_t;
 
+bool is_prefix_compressed(const leaf_node_t *node) {
+    return node->magic.bytes[0] == 'p' && node->magic.bytes[1] == 'x';
+}
+
+block_magic_t prefix_compressed_magic(block_magic_t magic) {
+    block_magic_t ret = { { 'p', 'x', magic.bytes[0], magic.bytes[1] } };
+    return ret;
+}
+
+const btree_key_t *node_prefix(const leaf_node_t *node) {
+    rassert(is_prefix_compressed(node));
+    return reinterpret_cast<const btree_key_t *>(node->pair_offsets + node->num_pairs);
+}
+
+btree_key_t *node_prefix(leaf_node_t *node) {
+    rassert(is_prefix_compressed(node));
+    return reinterpret_cast<btree_key_t *>(node->pair_offsets + node->num_pairs);
+}
+
+// The space taken up by the node's prefix (if it has one).
+int prefix_cost(const leaf_node_t *node) {
+    return is_prefix_compressed(node) ? node_prefix(node)->full_size() : 0;
+}
+
+// The offset of the end of pair_offsets and the node's prefix.
+int header_end(const leaf_node_t *node) {
+    return offsetof(leaf_node_t, pair_offsets) + sizeof(uint16_t) * node->num_pairs
+        + prefix_cost(node);
+}
+
+// Sets num_pairs, moving the node's prefix to the new end of pair_offsets.  When
+// adding pair offsets, call this before filling them in; when removing them,
+// after.
+void set_num_pairs(leaf_node_t *node, int num_pairs) {
+    if (is_prefix_compressed(node)) {
+        memmove(node->pair_offsets + num_pairs, node->pair_offsets + node->num_pairs,
+                node_prefix(node)->full_size());
+    }
+    node->num_pairs = num_pairs;
+}
+
 bool entry_is_deletion(const entry_t *p) {
     uint8_t x = *reinterpret_cast<const uint8_t *>(p);
     rassert(x != SKIP_ENTRY_RESERVED);
@@ -107,19 +164,112 @@ const btree_key_t *entry_key(const entry_t *p) {
     }
 }
 
-const void *entry_value(const entry_t *p) {
+// The number of bytes of the node's prefix that the entry's key starts with.
+int entry_shared_size(const leaf_node_t *node, const entry_t *p) {
+    if (!is_prefix_compressed(node)) {
+        return 0;
+    }
+    const btree_key_t *key = entry_key(p);
+    return *(reinterpret_cast<const uint8_t *>(key) + key->full_size());
+}
+
+// The space taken up by the entry's key (including [shared]).
+int entry_key_cost(const leaf_node_t *node, const entry_t *p) {
+    return entry_key(p)->full_size() + (is_prefix_compressed(node) ? 1 : 0);
+}
+
+// Copies the entry's full key (which is at most MAX_KEY_SIZE bytes) to key_out.
+void entry_full_key(const leaf_node_t *node, const entry_t *p, btree_key_t *key_out) {
+    const btree_key_t *key = entry_key(p);
+    const int shared = entry_shared_size(node, p);
+    if (shared > 0) {
+        memcpy(key_out->contents, node_prefix(node)->contents, shared);
+    }
+    memmove(key_out->contents + shared, key->contents, key->size);
+    key_out->size = shared + key->size;
+}
+
+// Returns the entry's full key, which is only put together in *buf if the entry
+// doesn't hold it as is.
+const btree_key_t *entry_full_key(const leaf_node_t *node, const entry_t *p,
+                                  store_key_t *buf) {
+    if (!is_prefix_compressed(node)) {
+        return entry_key(p);
+    }
+    entry_full_key(node, p, buf->btree_key());
+    return buf->btree_key();
+}
+
+// Compares `key` with the entry's full key.
+int entry_key_cmp(const btree_key_t *key, const leaf_node_t *node, const entry_t *p) {
+    const btree_key_t *ek = entry_key(p);
+    if (!is_prefix_compressed(node)) {
+        return sized_strcmp(key->contents, key->size, ek->contents, ek->size);
+    }
+    const int shared = entry_shared_size(node, p);
+    int res = memcmp(key->contents, node_prefix(node)->contents,
+                     std::min<int>(key->size, shared));
+    if (res != 0) {
+        return res;
+    }
+    if (key->size < shared) {
+        return -1;
+    }
+    return sized_strcmp(key->contents + shared, key->size - shared,
+                        ek->contents, ek->size);
+}
+
+// The number of bytes of the node's prefix that `key` starts with.
+int shared_prefix_size(const leaf_node_t *node, const btree_key_t *key) {
+    if (!is_prefix_compressed(node)) {
+        return 0;
+    }
+    const btree_key_t *prefix = node_prefix(node);
+    const int n = std::min(key->size, prefix->size);
+    int i = 0;
+    while (i < n && key->contents[i] == prefix->contents[i]) {
+        ++i;
+    }
+    return i;
+}
+
+// The space `key` would take up as the key of an entry in the node.
+int encoded_key_cost(const leaf_node_t *node, const btree_key_t *key) {
+    if (!is_prefix_compressed(node)) {
+        return key->full_size();
+    }
+    return key->full_size() - shared_prefix_size(node, key) + 1;
+}
+
+// Writes `key` as the key of an entry in the node at `p`, and returns where the
+// rest of the entry goes.
+char *write_encoded_key(const leaf_node_t *node, const btree_key_t *key, char *p) {
+    if (!is_prefix_compressed(node)) {
+        memcpy(p, key, key->full_size());
+        return p + key->full_size();
+    }
+    const int shared = shared_prefix_size(node, key);
+    btree_key_t *suffix = reinterpret_cast<btree_key_t *>(p);
+    suffix->size = key->size - shared;
+    memcpy(suffix->contents, key->contents + shared, suffix->size);
+    p += suffix->full_size();
+    *reinterpret_cast<uint8_t *>(p) = shared;
+    return p + 1;
+}
+
+const void *entry_value(const leaf_node_t *node, const entry_t *p) {
     if (entry_is_deletion(p)) {
         return NULL;
     } else {
-        return reinterpret_cast<const char *>(p) + entry_key(p)->full_size();
+        return reinterpret_cast<const char *>(p) + entry_key_cost(node, p);
     }
 }
 
-int entry_size(value_sizer_t<void> *sizer, const entry_t *p) {
+int entry_size(value_sizer_t<void> *sizer, const leaf_node_t *node, const entry_t *p) {
     uint8_t code = *reinterpret_cast<const uint8_t *>(p);
     switch (code) {
     case DELETE_ENTRY_CODE:
-        return 1 + entry_key(p)->full_size();
+        return 1 + entry_key_cost(node, p);
     case SKIP_ENTRY_CODE_ONE:
         return 1;
     case SKIP_ENTRY_CODE_TWO:
@@ -128,7 +278,7 @@ int entry_size(value_sizer_t<void> *sizer, const entry_t *p) {
         return 3 + *reinterpret_cast<const uint16_t *>(1 + reinterpret_cast<const char *>(p));
     default:
         rassert(code <= MAX_KEY_SIZE);
-        return entry_key(p)->full_size() + sizer->size(entry_value(p));
+        return entry_key_cost(node, p) + sizer->size(entry_value(node, p));
     }
 }
 
@@ -154,7 +304,7 @@ struct entry_iter_t {
     void step(value_sizer_t<void> *sizer, const leaf_node_t *node) {
         rassert(!done(sizer));
 
-        offset += entry_size(sizer, get_entry(node, offset)) + (offset < node->tstamp_cutpoint ? sizeof(repli_timestamp_t) : 0);
+        offset += entry_size(sizer, node, get_entry(node, offset)) + (offset < node->tstamp_cutpoint ? sizeof(repli_timestamp_t) : 0);
     }
 
     bool done(value_sizer_t<void> *sizer) const {
@@ -170,17 +320,71 @@ struct entry_iter_t {
     }
 };
 
-void strprint_entry(std::string *out, value_sizer_t<void> *sizer, const entry_t *entry) {
+// Whether entries can be copied from fro to tow byte for byte.
+bool same_key_encoding(const leaf_node_t *fro, const leaf_node_t *tow) {
+    if (is_prefix_compressed(fro) != is_prefix_compressed(tow)) {
+        return false;
+    }
+    if (!is_prefix_compressed(fro)) {
+        return true;
+    }
+    const btree_key_t *fro_prefix = node_prefix(fro);
+    const btree_key_t *tow_prefix = node_prefix(tow);
+    return fro_prefix->size == tow_prefix->size
+        && memcmp(fro_prefix->contents, tow_prefix->contents, fro_prefix->size) == 0;
+}
+
+// The space the (live or deletion) entry in fro would take up in tow.
+int copied_entry_size(value_sizer_t<void> *sizer, const leaf_node_t *fro,
+                      const entry_t *ent, const leaf_node_t *tow) {
+    const int sz = entry_size(sizer, fro, ent);
+    if (same_key_encoding(fro, tow)) {
+        return sz;
+    }
+    store_key_t key;
+    entry_full_key(fro, ent, key.btree_key());
+    return sz - entry_key_cost(fro, ent) + encoded_key_cost(tow, key.btree_key());
+}
+
+// Copies the (live or deletion) entry in fro to `dest` in tow, re-encoding its
+// key if necessary, and returns the space it takes up there.
+int copy_entry(value_sizer_t<void> *sizer, const leaf_node_t *fro, const entry_t *ent,
+               const leaf_node_t *tow, char *dest) {
+    if (same_key_encoding(fro, tow)) {
+        const int sz = entry_size(sizer, fro, ent);
+        memmove(dest, ent, sz);
+        return sz;
+    }
+
+    store_key_t key;
+    entry_full_key(fro, ent, key.btree_key());
+    char *p = dest;
+    if (entry_is_deletion(ent)) {
+        *p = static_cast<char>(DELETE_ENTRY_CODE);
+        p = write_encoded_key(tow, key.btree_key(), p + 1);
+    } else {
+        rassert(entry_is_live(ent));
+        const void *value = entry_value(fro, ent);
+        const int value_size = sizer->size(value);
+        p = write_encoded_key(tow, key.btree_key(), p);
+        memmove(p, value, value_size);
+        p += value_size;
+    }
+    return p - dest;
+}
+
+void strprint_entry(std::string *out, value_sizer_t<void> *sizer, const leaf_node_t *node, const entry_t *entry) {
+    store_key_t key_buf;
     if (entry_is_live(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = entry_full_key(node, entry, &key_buf);
         *out += strprintf("%.*s:", static_cast<int>(key->size), key->contents);
-        *out += strprintf("[entry size=%d]", entry_size(sizer, entry));
-        *out += strprintf("[value size=%d]", sizer->size(entry_value(entry)));
+        *out += strprintf("[entry size=%d]", entry_size(sizer, node, entry));
+        *out += strprintf("[value size=%d]", sizer->size(entry_value(node, entry)));
     } else if (entry_is_deletion(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = entry_full_key(node, entry, &key_buf);
         *out += strprintf("%.*s:[deletion]", static_cast<int>(key->size), key->contents);
     } else if (entry_is_skip(entry)) {
-        *out += strprintf("[skip %d]", entry_size(sizer, entry));
+        *out += strprintf("[skip %d]", entry_size(sizer, node, entry));
     } else {
         *out += strprintf("[code %d]", *reinterpret_cast<const uint8_t *>(entry));
     }
@@ -192,6 +396,11 @@ std::string strprint_leaf(value_sizer_t<void> *sizer, const leaf_node_t *node) {
     out += strprintf("Leaf(magic='%4.4s', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u)\n",
             node->magic.bytes, node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint);
 
+    if (is_prefix_compressed(node)) {
+        const btree_key_t *prefix = node_prefix(node);
+        out += strprintf("  Prefix: %.*s\n", static_cast<int>(prefix->size), prefix->contents);
+    }
+
     out += strprintf("  Offsets:");
     for (int i = 0; i < node->num_pairs; ++i) {
         out += strprintf(" %d", node->pair_offsets[i]);
@@ -201,7 +410,7 @@ std::string strprint_leaf(value_sizer_t<void> *sizer, const leaf_node_t *node) {
     out += strprintf("  By Key:");
     for (int i = 0; i < node->num_pairs; ++i) {
         out += strprintf(" %d:", node->pair_offsets[i]);
-        strprint_entry(&out, sizer, get_entry(node, node->pair_offsets[i]));
+        strprint_entry(&out, sizer, node, get_entry(node, node->pair_offsets[i]));
     }
     out += strprintf("\n");
 
@@ -214,7 +423,7 @@ std::string strprint_leaf(value_sizer_t<void> *sizer, const leaf_node_t *node) {
             repli_timestamp_t tstamp = get_timestamp(node, iter.offset);
             out += strprintf("[t=%" PRIu64 "]", tstamp.longtime);
         }
-        strprint_entry(&out, sizer, get_entry(node, iter.offset));
+        strprint_entry(&out, sizer, node, get_entry(node, iter.offset));
         iter.step(sizer, node);
     }
     out += strprintf("\n");
@@ -223,17 +432,18 @@ std::string strprint_leaf(value_sizer_t<void> *sizer, const leaf_node_t *node) {
 }
 
 
-void print_entry(FILE *fp, value_sizer_t<void> *sizer, const entry_t *entry) {
+void print_entry(FILE *fp, value_sizer_t<void> *sizer, const leaf_node_t *node, const entry_t *entry) {
+    store_key_t key_buf;
     if (entry_is_live(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = entry_full_key(node, entry, &key_buf);
         fprintf(fp, "%.*s:", static_cast<int>(key->size), key->contents);
-        fprintf(fp, "[entry size=%d]", entry_size(sizer, entry));
-        fprintf(fp, "[value size=%d]", sizer->size(entry_value(entry)));
+        fprintf(fp, "[entry size=%d]", entry_size(sizer, node, entry));
+        fprintf(fp, "[value size=%d]", sizer->size(entry_value(node, entry)));
     } else if (entry_is_deletion(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = entry_full_key(node, entry, &key_buf);
         fprintf(fp, "%.*s:[deletion]", static_cast<int>(key->size), key->contents);
     } else if (entry_is_skip(entry)) {
-        fprintf(fp, "[skip %d]", entry_size(sizer, entry));
+        fprintf(fp, "[skip %d]", entry_size(sizer, node, entry));
     } else {
         fprintf(fp, "[code %d]", *reinterpret_cast<const uint8_t *>(entry));
     }
@@ -245,6 +455,11 @@ void print(FILE *fp, value_sizer_t<void> *sizer, const leaf_node_t *node) {
     fprintf(fp, "Leaf(magic='%4.4s', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u)\n",
             node->magic.bytes, node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint);
 
+    if (is_prefix_compressed(node)) {
+        const btree_key_t *prefix = node_prefix(node);
+        fprintf(fp, "  Prefix: %.*s\n", static_cast<int>(prefix->size), prefix->contents);
+    }
+
     fprintf(fp, "  Offsets:");
     for (int i = 0; i < node->num_pairs; ++i) {
         fprintf(fp, " %d", node->pair_offsets[i]);
@@ -255,7 +470,7 @@ void print(FILE *fp, value_sizer_t<void> *sizer, const leaf_node_t *node) {
     fprintf(fp, "  By Key:");
     for (int i = 0; i < node->num_pairs; ++i) {
         fprintf(fp, " %d:", node->pair_offsets[i]);
-        print_entry(fp, sizer, get_entry(node, node->pair_offsets[i]));
+        print_entry(fp, sizer, node, get_entry(node, node->pair_offsets[i]));
     }
     fprintf(fp, "\n");
 
@@ -271,7 +486,7 @@ void print(FILE *fp, value_sizer_t<void> *sizer, const leaf_node_t *node) {
             fprintf(fp, "[t=%" PRIu64 "]", tstamp.longtime);
             fflush(fp);
         }
-        print_entry(fp, sizer, get_entry(node, iter.offset));
+        print_entry(fp, sizer, node, get_entry(node, iter.offset));
         iter.step(sizer, node);
     }
     fprintf(fp, "\n");
@@ -307,10 +522,14 @@ bool fsck(value_sizer_t<void> *sizer, const btree_key_t *left_exclusive_or_null,
     // is not before the end of pair_offsets
 
     // Basic sanity checks on fields' values.
-    if (failed(node->magic == sizer->btree_leaf_magic(),
+    if (failed(is_leaf_magic(sizer, node->magic),
                "bad leaf magic")
         || failed(node->frontmost >= offsetof(leaf_node_t, pair_offsets) + node->num_pairs * sizeof(uint16_t),
                   "frontmost offset is before the end of pair_offsets")
+        || failed(!is_prefix_compressed(node)
+                  || (node->frontmost > offsetof(leaf_node_t, pair_offsets) + node->num_pairs * sizeof(uint16_t)
+                      && header_end(node) <= node->frontmost),
+                  "frontmost offset is before the end of the key prefix")
         || failed(node->live_size <= (sizer->block_size().value() - node->frontmost) + sizeof(uint16_t) * node->num_pairs,
                   "live_size is impossibly large")
         || failed(node->tstamp_cutpoint >= node->frontmost,
@@ -368,21 +587,30 @@ bool fsck(value_sizer_t<void> *sizer, const btree_key_t *left_exclusive_or_null,
         }
 
         const entry_t *ent = get_entry(node, offset);
+        if (is_prefix_compressed(node) && !entry_is_skip(ent)
+            && failed(entry_shared_size(node, ent) <= node_prefix(node)->size
+                      && entry_shared_size(node, ent) + entry_key(ent)->size <= MAX_KEY_SIZE,
+                      "bad shared key prefix size")) {
+            return false;
+        }
+
         if (entry_is_live(ent)) {
-            const void *value = entry_value(ent);
+            const void *value = entry_value(node, ent);
             int space = sizer->block_size().value() - (reinterpret_cast<const char *>(value) - reinterpret_cast<const char *>(node));
+            store_key_t key_buf;
+            const btree_key_t *key = entry_full_key(node, ent, &key_buf);
             if (!sizer->fits(value, space)) {
-                *msg_out = strprintf("problem with key %.*s: value does not fit\n", entry_key(ent)->size, entry_key(ent)->contents);
+                *msg_out = strprintf("problem with key %.*s: value does not fit\n", key->size, key->contents);
                 return false;
             }
 
             std::string fscker_msg;
-            if (!fscker->fsck(sizer, entry_key(ent), value, &fscker_msg)) {
-                *msg_out = strprintf("Problem with key %.*s: %s\n", entry_key(ent)->size, entry_key(ent)->contents, fscker_msg.c_str());
+            if (!fscker->fsck(sizer, key, value, &fscker_msg)) {
+                *msg_out = strprintf("Problem with key %.*s: %s\n", key->size, key->contents, fscker_msg.c_str());
                 return false;
             }
 
-            observed_live_size += sizeof(uint16_t) + entry_size(sizer, ent);
+            observed_live_size += sizeof(uint16_t) + entry_size(sizer, node, ent);
             if (failed(i < node->num_pairs, "missing entry offsets")
                 || failed(offset == offs[i], "missing live entries or entry offsets")) {
                 return false;
@@ -410,14 +638,17 @@ bool fsck(value_sizer_t<void> *sizer, const btree_key_t *left_exclusive_or_null,
 
     // Entries look valid, check key ordering.
 
+    store_key_t last_buf;
     const btree_key_t *last = left_exclusive_or_null;
     for (int k = 0; k < node->num_pairs; ++k) {
-        const btree_key_t *key = entry_key(get_entry(node, node->pair_offsets[k]));
+        store_key_t key_buf;
+        const btree_key_t *key = entry_full_key(node, get_entry(node, node->pair_offsets[k]), &key_buf);
         if (failed(last == NULL || sized_strcmp(last->contents, last->size, key->contents, key->size) < 0,
                    "keys out of order")) {
             return false;
         }
-        last = key;
+        last_buf.assign(key);
+        last = last_buf.btree_key();
     }
 
     if (failed(last == NULL || right_inclusive_or_null == NULL
@@ -441,11 +672,31 @@ void validate(DEBUG_VAR value_sizer_t<void> *sizer, DEBUG_VAR const leaf_node_t
 }
 
 void init(value_sizer_t<void> *sizer, leaf_node_t *node) {
-    node->magic = sizer->btree_leaf_magic();
+    init(sizer, node, leaf_key_format_t::full);
+}
+
+void init(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_key_format_t format) {
+    node->magic = format == leaf_key_format_t::prefix_compressed
+        ? prefix_compressed_magic(sizer->btree_leaf_magic())
+        : sizer->btree_leaf_magic();
     node->num_pairs = 0;
     node->live_size = 0;
     node->frontmost = sizer->block_size().value();
     node->tstamp_cutpoint = node->frontmost;
+    if (format == leaf_key_format_t::prefix_compressed) {
+        node_prefix(node)->size = 0;
+    }
+}
+
+leaf_key_format_t key_format(const leaf_node_t *node) {
+    return is_prefix_compressed(node)
+        ? leaf_key_format_t::prefix_compressed
+        : leaf_key_format_t::full;
+}
+
+bool is_leaf_magic(value_sizer_t<void> *sizer, block_magic_t magic) {
+    return magic == sizer->btree_leaf_magic()
+        || magic == prefix_compressed_magic(sizer->btree_leaf_magic());
 }
 
 int free_space(value_sizer_t<void> *sizer) {
@@ -456,11 +707,12 @@ int free_space(value_sizer_t<void> *sizer) {
 // in the closed interval [0, free_space(sizer)].  Outputs the offset
 // of the first entry for which storing a timestamp is not mandatory.
 int mandatory_cost(value_sizer_t<void> *sizer, const leaf_node_t *node, int required_timestamps, int *tstamp_back_offset_out) {
-    int size = node->live_size;
+    int size = node->live_size + prefix_cost(node);
 
     // node->live_size does not include deletion entries, deletion
     // entries' timestamps, and live entries' timestamps.  We add that
-    // to size.
+    // to size.  (Nor does it include the node's key prefix, which we
+    // just added.)
 
     entry_iter_t iter = entry_iter_t::make(node);
     int count = 0;
@@ -473,7 +725,7 @@ int mandatory_cost(value_sizer_t<void> *sizer, const leaf_node_t *node, int requ
                 break;
             }
 
-            int this_entry_cost = sizeof(uint16_t) + sizeof(repli_timestamp_t) + entry_size(sizer, ent);
+            int this_entry_cost = sizeof(uint16_t) + sizeof(repli_timestamp_t) + entry_size(sizer, node, ent);
             deletions_cost += this_entry_cost;
             size += this_entry_cost;
             ++count;
@@ -495,6 +747,25 @@ int mandatory_cost(value_sizer_t<void> *sizer, const leaf_node_t *node, int requ
     return mandatory_cost(sizer, node, required_timestamps, &ignored);
 }
 
+// Like mandatory_cost, but for prefix-compressed nodes this counts the mandatory
+// entries as if their keys were stored in full, and doesn't count the prefix.
+// That's (at least) the space the entries would take up in any other node.
+int mandatory_weight(value_sizer_t<void> *sizer, const leaf_node_t *node, int required_timestamps) {
+    int tstamp_back_offset;
+    int weight = mandatory_cost(sizer, node, required_timestamps, &tstamp_back_offset);
+    if (is_prefix_compressed(node)) {
+        weight -= prefix_cost(node);
+        for (int i = 0; i < node->num_pairs; ++i) {
+            const int offset = node->pair_offsets[i];
+            const entry_t *ent = get_entry(node, offset);
+            if (entry_is_live(ent) || offset < tstamp_back_offset) {
+                weight += entry_shared_size(node, ent);
+            }
+        }
+    }
+    return weight;
+}
+
 int leaf_epsilon(value_sizer_t<void> *sizer) {
     // Returns the maximum possible entry size, i.e. the key cost plus
     // the value cost plus pair_offsets plus timestamp cost.
@@ -532,7 +803,7 @@ bool is_full(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_ke
     // insert.  We conservatively assume the key is not already
     // contained in the node.
 
-    size += sizeof(uint16_t) + sizeof(repli_timestamp_t) + key->full_size() + sizer->size(value);
+    size += sizeof(uint16_t) + sizeof(repli_timestamp_t) + encoded_key_cost(node, key) + sizer->size(value);
 
     // The node is full if we can't fit all that data within the free space.
     return size > free_space(sizer);
@@ -554,7 +825,28 @@ bool is_underfull(value_sizer_t<void> *sizer, const leaf_node_t *node) {
     // free_space / 2 - leaf_epsilon.  We don't want an immediately
     // split node to be underfull, hence the threshold used below.
 
-    return mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS) < free_space(sizer) / 2 - leaf_epsilon(sizer);
+    if (!is_prefix_compressed(node)) {
+        return mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS) < free_space(sizer) / 2 - leaf_epsilon(sizer);
+    }
+
+    // A prefix-compressed node's entries can take up more space once they're
+    // moved to a sibling with a different prefix, so we judge the node by that
+    // space (see mandatory_weight), and leave room for the sibling's prefix.  This
+    // way two underfull nodes can always be merged.  A split node is still never
+    // underfull, because the split evenly divides the entries' actual costs (and
+    // the node's prefix is at most 1 + MAX_KEY_SIZE).
+
+    return mandatory_weight(sizer, node, MANDATORY_TIMESTAMPS) < free_space(sizer) / 2 - leaf_epsilon(sizer) - (1 + MAX_KEY_SIZE);
+}
+
+bool is_safe_for_write(value_sizer_t<void> *sizer, const leaf_node_t *node) {
+    // Like is_full, for the largest key and value.  A key that shares none of a
+    // prefix-compressed node's prefix costs one byte more than its full size.
+    int size = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS);
+    size += sizeof(uint16_t) + sizeof(repli_timestamp_t)
+        + (1 + MAX_KEY_SIZE) + (is_prefix_compressed(node) ? 1 : 0)
+        + sizer->max_possible_size();
+    return size <= free_space(sizer) && !is_underfull(sizer, node);
 }
 
 
@@ -595,7 +887,7 @@ void garbage_collect(value_sizer_t<void> *sizer, leaf_node_t *node, int num_tsta
 
         entry_t *ent = get_entry(node, offset);
         if (entry_is_live(ent)) {
-            int sz = entry_size(sizer, ent);
+            int sz = entry_size(sizer, node, ent);
             w -= sz;
             memmove(get_at_offset(node, w), ent, sz);
             node->pair_offsets[indices[i]] = w;
@@ -612,7 +904,7 @@ void garbage_collect(value_sizer_t<void> *sizer, leaf_node_t *node, int num_tsta
         int offset = node->pair_offsets[indices[i]];
 
         // Preserve the timestamp.
-        int sz = sizeof(repli_timestamp_t) + entry_size(sizer, get_entry(node, offset));
+        int sz = sizeof(repli_timestamp_t) + entry_size(sizer, node, get_entry(node, offset));
 
         w -= sz;
 
@@ -639,7 +931,7 @@ void garbage_collect(value_sizer_t<void> *sizer, leaf_node_t *node, int num_tsta
         *preserved_index = j;
     }
 
-    node->num_pairs = j;
+    set_num_pairs(node, j);
 
     validate(sizer, node);
 }
@@ -673,21 +965,35 @@ void clean_entry(void *p, int sz) {
 }
 
 // Moves entries with pair_offsets indices in the clopen range [beg,
-// end) from fro to tow.
+// end) from fro to tow.  fro_copysize is the space the mandatory
+// entries among them take up in fro, not counting their pair offsets.
 void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int end, int wpoint, leaf_node_t *tow, int fro_copysize, int fro_mand_offset) {
     rassert(is_underfull(sizer, tow));
 
+    // If the nodes don't store keys the same way (because of their key
+    // prefixes), the entries' keys get re-encoded, which changes their sizes.
+    int tow_copysize = fro_copysize;
+    if (!same_key_encoding(fro, tow)) {
+        for (int i = beg; i < end; ++i) {
+            int offset = fro->pair_offsets[i];
+            const entry_t *ent = get_entry(fro, offset);
+            if (entry_is_live(ent) || offset < fro_mand_offset) {
+                tow_copysize += copied_entry_size(sizer, fro, ent, tow) - entry_size(sizer, fro, ent);
+            }
+        }
+    }
+
     // This assertion is a bit loose.
-    rassert(fro_copysize + mandatory_cost(sizer, tow, MANDATORY_TIMESTAMPS) <= free_space(sizer));
+    rassert(tow_copysize + mandatory_cost(sizer, tow, MANDATORY_TIMESTAMPS) <= free_space(sizer));
 
     // Make tow have a nice big region we can copy entries to.  Also,
     // this means we have no "skip" entries in tow.
     garbage_collect(sizer, tow, MANDATORY_TIMESTAMPS, &wpoint);
 
     // Now resize and move tow's pair_offsets.
-    memmove(tow->pair_offsets + wpoint + (end - beg), tow->pair_offsets + wpoint, sizeof(uint16_t) * (tow->num_pairs - wpoint));
-
-    tow->num_pairs += end - beg;
+    const int old_tow_num_pairs = tow->num_pairs;
+    set_num_pairs(tow, old_tow_num_pairs + (end - beg));
+    memmove(tow->pair_offsets + wpoint + (end - beg), tow->pair_offsets + wpoint, sizeof(uint16_t) * (old_tow_num_pairs - wpoint));
 
     // pos a
 
@@ -709,7 +1015,7 @@ void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int en
     int fro_index = wpoint;
     int fro_index_end = wpoint + (end - beg);
 
-    const int new_frontmost = tow->frontmost - fro_copysize;
+    const int new_frontmost = tow->frontmost - tow_copysize;
 
     int wri_offset = new_frontmost;
 
@@ -757,12 +1063,13 @@ void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int en
         // Greater timestamps go first.
         if (tow_tstamp < fro_tstamp) {
             entry_t *ent = get_entry(fro, fro_offset);
-            int entsz = entry_size(sizer, ent);
-            int sz = sizeof(repli_timestamp_t) + entsz;
-            memmove(get_at_offset(tow, wri_offset), get_at_offset(fro, fro_offset), sz);
+            int entsz = entry_size(sizer, fro, ent);
+            memmove(get_at_offset(tow, wri_offset), get_at_offset(fro, fro_offset), sizeof(repli_timestamp_t));
+            int towsz = copy_entry(sizer, fro, ent, tow, get_at_offset(tow, wri_offset + sizeof(repli_timestamp_t)));
+            int sz = sizeof(repli_timestamp_t) + towsz;
 
             if (entry_is_live(ent)) {
-                livesize += entsz + sizeof(uint16_t);
+                livesize += towsz + sizeof(uint16_t);
                 fro_live_size_adjustment -= entsz + sizeof(uint16_t);
             }
 
@@ -777,7 +1084,7 @@ void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int en
             fro_index++;
 
         } else {
-            int sz = sizeof(repli_timestamp_t) + entry_size(sizer, get_entry(tow, tow_offset));
+            int sz = sizeof(repli_timestamp_t) + entry_size(sizer, tow, get_entry(tow, tow_offset));
             memmove(get_at_offset(tow, wri_offset), get_at_offset(tow, tow_offset), sz);
 
             // Update the pair offset of the entry we've moved.
@@ -805,21 +1112,21 @@ void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int en
         int fro_offset = fro->pair_offsets[beg + tow->pair_offsets[fro_index]];
         entry_t *ent = get_entry(fro, fro_offset);
         if (entry_is_live(ent)) {
-            int sz = entry_size(sizer, ent);
-            memmove(get_at_offset(tow, wri_offset), ent, sz);
+            int sz = entry_size(sizer, fro, ent);
+            int towsz = copy_entry(sizer, fro, ent, tow, get_at_offset(tow, wri_offset));
             clean_entry(ent, sz);
             fro_live_size_adjustment -= sz + sizeof(uint16_t);
 
             fro->pair_offsets[beg + tow->pair_offsets[fro_index]] = wri_offset;
-            wri_offset += sz;
-            livesize += sz + sizeof(uint16_t);
+            wri_offset += towsz;
+            livesize += towsz + sizeof(uint16_t);
         } else {
             rassert(entry_is_deletion(ent));
 
             // This is a dead entry.  We'll need to squash this dead entry later.
             fro->pair_offsets[beg + tow->pair_offsets[fro_index]] = 0;
 
-            int sz = entry_size(sizer, ent);
+            int sz = entry_size(sizer, fro, ent);
             clean_entry(ent, sz);
         }
     }
@@ -832,7 +1139,7 @@ void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int en
         rassert(wri_offset <= tow_offset);
 
         entry_t *ent = get_entry(tow, tow_offset);
-        int sz = entry_size(sizer, ent);
+        int sz = entry_size(sizer, tow, ent);
         if (entry_is_live(ent)) {
             memmove(get_at_offset(tow, wri_offset), ent, sz);
 
@@ -883,7 +1190,7 @@ void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int en
     memcpy(tow->pair_offsets + wpoint, fro->pair_offsets + beg,
            sizeof(uint16_t) * (end - beg));
     memmove(fro->pair_offsets + beg, fro->pair_offsets + end, sizeof(uint16_t) * (fro->num_pairs - end));
-    fro->num_pairs -= end - beg;
+    set_num_pairs(fro, fro->num_pairs - (end - beg));
 
     tow->frontmost = new_frontmost;
 
@@ -904,26 +1211,140 @@ void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int en
                 j += 1;
             }
         }
-        tow->num_pairs = j;
+        set_num_pairs(tow, j);
     }
 
     validate(sizer, fro);
     validate(sizer, tow);
 }
 
-void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out) {
+// Rewrites the prefix-compressed node with a new prefix, re-encoding every entry's
+// key and dropping skip entries.  The caller must make sure the entries still fit.
+void set_prefix(value_sizer_t<void> *sizer, leaf_node_t *node, const btree_key_t *prefix) {
+    rassert(is_prefix_compressed(node));
+    const int bs = sizer->block_size().value();
+    scoped_malloc_t<leaf_node_t> old(bs);
+    memcpy(old.get(), node, bs);
+
+    scoped_array_t<uint16_t> indices(node->num_pairs);
+    for (int i = 0; i < node->num_pairs; ++i) {
+        indices[i] = i;
+    }
+    std::sort(indices.data(), indices.data() + node->num_pairs, indirect_index_comparator_t(old->pair_offsets));
+
+    keycpy(node_prefix(node), prefix);
+    node->live_size = 0;
+    node->tstamp_cutpoint = bs;
+
+    // Like garbage_collect, we write from the back, so that the entries (and
+    // their timestamps) stay in the same order.
+    int w = bs;
+    for (int i = node->num_pairs - 1; i >= 0; --i) {
+        const int offset = old->pair_offsets[indices[i]];
+        const bool has_tstamp = offset < old->tstamp_cutpoint;
+        if (has_tstamp && node->tstamp_cutpoint == bs) {
+            node->tstamp_cutpoint = w;
+        }
+
+        const entry_t *ent = get_entry(old.get(), offset);
+        const int sz = copied_entry_size(sizer, old.get(), ent, node);
+        w -= sz;
+        UNUSED int written = copy_entry(sizer, old.get(), ent, node, get_at_offset(node, w));
+        rassert(written == sz);
+        if (entry_is_live(ent)) {
+            node->live_size += sizeof(uint16_t) + sz;
+        }
+
+        if (has_tstamp) {
+            w -= sizeof(repli_timestamp_t);
+            *reinterpret_cast<repli_timestamp_t *>(get_at_offset(node, w)) = get_timestamp(old.get(), offset);
+        }
+        node->pair_offsets[indices[i]] = w;
+    }
+    if (node->tstamp_cutpoint == bs) {
+        node->tstamp_cutpoint = w;
+    }
+    node->frontmost = w;
+
+    rassert(header_end(node) <= node->frontmost);
+    validate(sizer, node);
+}
+
+// Grows a prefix-compressed node's prefix to the common prefix of all its keys.
+void extend_prefix(value_sizer_t<void> *sizer, leaf_node_t *node) {
+    if (!is_prefix_compressed(node) || node->num_pairs == 0) {
+        return;
+    }
+
+    // The keys are sorted, so the first and last keys' common prefix is that of
+    // all the keys.
+    store_key_t first;
+    store_key_t last;
+    entry_full_key(node, get_entry(node, node->pair_offsets[0]), first.btree_key());
+    entry_full_key(node, get_entry(node, node->pair_offsets[node->num_pairs - 1]), last.btree_key());
+
+    const btree_key_t *f = first.btree_key();
+    const btree_key_t *l = last.btree_key();
+    int n = 0;
+    while (n < f->size && n < l->size && f->contents[n] == l->contents[n]) {
+        ++n;
+    }
+
+    // Every entry's key gets at least (n - prefix size) bytes shorter, which pays
+    // for the longer prefix.
+    if (n > node_prefix(node)->size) {
+        first.btree_key()->size = n;
+        set_prefix(sizer, node, first.btree_key());
+    }
+}
+
+// Sets `separator_out` to the shortest key that is at least `left`'s last key and
+// less than `right`'s first, for the parent to tell the nodes apart with.  (Keys
+// equal to a separator go to its left.)  A prefix of `right`'s first key one byte
+// longer than its common prefix with `left`'s last key will do, unless that's the
+// whole key, in which case we fall back on `left`'s last key.  Short separators let
+// internal nodes hold many more children when the keys are long, as secondary
+// index keys often are.
+static void shortest_separator(const leaf_node_t *left, const leaf_node_t *right,
+                               btree_key_t *separator_out) {
+    rassert(left->num_pairs > 0 && right->num_pairs > 0);
+    entry_full_key(left, get_entry(left, left->pair_offsets[left->num_pairs - 1]),
+                   separator_out);
+    store_key_t buf;
+    const btree_key_t *right_first
+        = entry_full_key(right, get_entry(right, right->pair_offsets[0]), &buf);
+    rassert(btree_key_cmp(separator_out, right_first) < 0);
+
+    int common = 0;
+    while (common < separator_out->size && common < right_first->size
+           && separator_out->contents[common] == right_first->contents[common]) {
+        ++common;
+    }
+    if (common + 1 < right_first->size) {
+        memcpy(separator_out->contents, right_first->contents, common + 1);
+        separator_out->size = common + 1;
+    }
+}
+
+// Moves the entries at the end of `node` to `rnode`, which get at least
+// `target_rcost` of its mandatory cost.  If `even` is true, the target is half the
+// cost, and the split point is whichever is closer to it.
+static void split_at(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode,
+                     btree_key_t *median_out, bool even) {
     int tstamp_back_offset;
     int mandatory = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
 
     rassert(mandatory >= free_space(sizer) - leaf_epsilon(sizer));
 
-    // We shall split the mandatory cost of this node as evenly as possible.
+    // We shall split the mandatory cost of this node as evenly as possible, or
+    // else give rnode only the last mandatory entry.
+    const int target_rcost = even ? mandatory / 2 : 1;
 
     int num_mandatories = 0;
     int i = node->num_pairs - 1;
     int prev_rcost = 0;
     int rcost = 0;
-    while (i >= 0 && rcost < mandatory / 2) {
+    while (i >= 0 && rcost < target_rcost) {
         int offset = node->pair_offsets[i];
         entry_t *ent = get_entry(node, offset);
 
@@ -935,7 +1356,7 @@ void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, bt
 
         if (entry_is_live(ent)) {
             prev_rcost = rcost;
-            rcost += entry_size(sizer, ent) + sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
+            rcost += entry_size(sizer, node, ent) + sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
 
             ++num_mandatories;
         } else {
@@ -943,7 +1364,7 @@ void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, bt
 
             if (offset < tstamp_back_offset) {
                 prev_rcost = rcost;
-                rcost += entry_size(sizer, ent) + sizeof(uint16_t) + sizeof(repli_timestamp_t);
+                rcost += entry_size(sizer, node, ent) + sizeof(uint16_t) + sizeof(repli_timestamp_t);
 
                 ++num_mandatories;
             }
@@ -954,15 +1375,15 @@ void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, bt
 
     // Since the mandatory_cost is at least free_space - leaf_epsilon there's no way i can equal num_pairs or zero.
     rassert(i < node->num_pairs);
-    rassert(i > 0);
+    rassert(even ? i > 0 : i >= 0);
 
-    // Now prev_rcost and rcost envelope mandatory / 2.
-    rassert(prev_rcost < mandatory / 2);
-    rassert(rcost >= mandatory / 2, "rcost = %d, mandatory / 2 = %d, i = %d", rcost, mandatory / 2, i);
+    // Now prev_rcost and rcost envelope the target.
+    rassert(prev_rcost < target_rcost);
+    rassert(rcost >= target_rcost, "rcost = %d, target_rcost = %d, i = %d", rcost, target_rcost, i);
 
     int s;
     int end_rcost;
-    if ((mandatory - prev_rcost) - prev_rcost < rcost - (mandatory - rcost)) {
+    if (even && (mandatory - prev_rcost) - prev_rcost < rcost - (mandatory - rcost)) {
         end_rcost = prev_rcost;
         s = i + 2;
         --num_mandatories;
@@ -972,18 +1393,42 @@ void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, bt
     }
 
     // If our math was right, neither node can be underfull just
-    // considering the split of the mandatory costs.
-    rassert(end_rcost >= free_space(sizer) / 2 - leaf_epsilon(sizer));
-    rassert(mandatory - end_rcost >= free_space(sizer) / 2 - leaf_epsilon(sizer));
+    // considering the split of the mandatory costs.  (The node's key
+    // prefix counts towards its mandatory cost, but isn't split.)
+    rassert(!even || end_rcost >= free_space(sizer) / 2 - leaf_epsilon(sizer) - prefix_cost(node));
+    rassert(mandatory - end_rcost >= free_space(sizer) / 2 - leaf_epsilon(sizer) - prefix_cost(node));
 
     // Now we wish to move the elements at indices [s, num_pairs) to rnode.
+    // rnode gets the same key prefix, so that the entries can be moved as they
+    // are.
 
-    init(sizer, rnode);
+    init(sizer, rnode, key_format(node));
+    if (is_prefix_compressed(node)) {
+        keycpy(node_prefix(rnode), node_prefix(node));
+    }
 
     int node_copysize = end_rcost - num_mandatories * sizeof(uint16_t);
     move_elements(sizer, node, s, node->num_pairs, 0, rnode, node_copysize, tstamp_back_offset);
 
-    keycpy(median_out, entry_key(get_entry(node, node->pair_offsets[s - 1])));
+    shortest_separator(node, rnode, median_out);
+
+    // Each half's keys probably have a longer common prefix than the
+    // whole node's did.
+    extend_prefix(sizer, node);
+    extend_prefix(sizer, rnode);
+}
+
+void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out) {
+    split_at(sizer, node, rnode, median_out, true);
+}
+
+void split_for_append(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out) {
+    split_at(sizer, node, rnode, median_out, false);
+}
+
+bool is_append(const leaf_node_t *node, const btree_key_t *key) {
+    int index;
+    return !find_key(node, key, &index) && index == node->num_pairs;
 }
 
 void merge(value_sizer_t<void> *sizer, leaf_node_t *left, leaf_node_t *right) {
@@ -995,7 +1440,8 @@ void merge(value_sizer_t<void> *sizer, leaf_node_t *left, leaf_node_t *right) {
     int tstamp_back_offset;
     int mandatory = mandatory_cost(sizer, left, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
 
-    int left_copysize = mandatory;
+    // Uncount the key prefix, which doesn't get copied.
+    int left_copysize = mandatory - prefix_cost(left);
     // Uncount the uint16_t cost of mandatory  entries.  Sigh.
     for (int i = 0; i < left->num_pairs; ++i) {
         if (left->pair_offsets[i] < tstamp_back_offset || entry_is_deletion(get_entry(left, left->pair_offsets[i]))) {
@@ -1017,11 +1463,21 @@ bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, leaf_node_t *n
     // First figure out the inclusive range [beg, end] of elements we want to move from sibling.
     int beg, end, *w, wstep;
 
-    int node_weight = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS);
+    // We balance the nodes' weights (see mandatory_weight), which are their
+    // mandatory costs unless they're prefix-compressed.  We also keep track of
+    // the space the moved entries really take up, in sibling and in node.
+    int node_weight = mandatory_weight(sizer, node, MANDATORY_TIMESTAMPS);
+    int sibling_weight = mandatory_weight(sizer, sibling, MANDATORY_TIMESTAMPS);
     int tstamp_back_offset;
-    int sibling_weight = mandatory_cost(sizer, sibling, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
+    mandatory_cost(sizer, sibling, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
+    int node_cost = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS);
 
-    rassert(node_weight < sibling_weight);
+    if (node_weight >= sibling_weight) {
+        // This can only happen with nodes of different key formats, whose
+        // underfullness is judged differently.
+        rassert(key_format(node) != key_format(sibling));
+        return false;
+    }
 
     if (nodecmp_node_with_sib < 0) {
         // node is to the left of sibling, so we want to move elements
@@ -1047,33 +1503,34 @@ bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, leaf_node_t *n
     int weight_movement = 0;
     int num_mandatories = 0;
     int prev_diff = sizer->block_size().value();  // some impossibly large value
+    bool node_would_overflow = false;
     for (;;) {
         int offset = sibling->pair_offsets[*w];
         entry_t *ent = get_entry(sibling, offset);
 
         // We only take mandatory entries' costs into consideration.
-        if (entry_is_live(ent)) {
-            int sz = entry_size(sizer, ent) + sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
+        if (entry_is_live(ent) || offset < tstamp_back_offset) {
+            rassert(entry_is_live(ent) || entry_is_deletion(ent));
+            int extra = sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
+            int sz = entry_size(sizer, sibling, ent) + extra;
+            int weight = sz + entry_shared_size(sibling, ent);
+            int node_sz = copied_entry_size(sizer, sibling, ent, node) + extra;
+            if (node_cost + node_sz > free_space(sizer)) {
+                // Our weights don't tell us how much space the entries take up
+                // in a node with a different key prefix.
+                node_would_overflow = true;
+                break;
+            }
             prev_diff = sibling_weight - node_weight;
             prev_weight_movement = weight_movement;
             weight_movement += sz;
-            node_weight += sz;
-            sibling_weight -= sz;
+            node_weight += weight;
+            sibling_weight -= weight;
+            node_cost += node_sz;
 
             ++num_mandatories;
         } else {
             rassert(entry_is_deletion(ent));
-
-            if (offset < tstamp_back_offset) {
-                int sz = entry_size(sizer, ent) + sizeof(uint16_t) + sizeof(repli_timestamp_t);
-                prev_diff = sibling_weight - node_weight;
-                prev_weight_movement = weight_movement;
-                weight_movement += sz;
-                node_weight += sz;
-                sibling_weight -= sz;
-
-                ++num_mandatories;
-            }
         }
 
         if (end - beg == sibling->num_pairs - 1 || node_weight >= sibling_weight) {
@@ -1085,7 +1542,9 @@ bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, leaf_node_t *n
 
     rassert(end - beg < sibling->num_pairs - 1);
 
-    if (prev_diff <= sibling_weight - node_weight) {
+    if (node_would_overflow) {
+        *w -= wstep;
+    } else if (prev_diff <= sibling_weight - node_weight) {
         *w -= wstep;
         --num_mandatories;
         weight_movement = prev_weight_movement;
@@ -1104,16 +1563,43 @@ bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, leaf_node_t *n
     guarantee(sibling->num_pairs > 0);
 
     if (nodecmp_node_with_sib < 0) {
-        keycpy(replacement_key_out, entry_key(get_entry(node, node->pair_offsets[node->num_pairs - 1])));
+        shortest_separator(node, sibling, replacement_key_out);
     } else {
-        keycpy(replacement_key_out, entry_key(get_entry(sibling, sibling->pair_offsets[sibling->num_pairs - 1])));
+        shortest_separator(sibling, node, replacement_key_out);
     }
 
     return true;
 }
 
+// The mandatory cost tow would have if fro's entries were merged into it.
+int merged_cost(value_sizer_t<void> *sizer, const leaf_node_t *fro, const leaf_node_t *tow) {
+    int tstamp_back_offset;
+    mandatory_cost(sizer, fro, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
+    int cost = mandatory_cost(sizer, tow, MANDATORY_TIMESTAMPS);
+    for (int i = 0; i < fro->num_pairs; ++i) {
+        const int offset = fro->pair_offsets[i];
+        const entry_t *ent = get_entry(fro, offset);
+        if (entry_is_live(ent) || offset < tstamp_back_offset) {
+            cost += sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0)
+                + copied_entry_size(sizer, fro, ent, tow);
+        }
+    }
+    return cost;
+}
+
 bool is_mergable(value_sizer_t<void> *sizer, const leaf_node_t *node, const leaf_node_t *sibling) {
-    return is_underfull(sizer, node) && is_underfull(sizer, sibling);
+    if (!is_underfull(sizer, node) || !is_underfull(sizer, sibling)) {
+        return false;
+    }
+    if (key_format(node) == key_format(sibling)) {
+        return true;
+    }
+
+    // A full-key node's entries get a byte longer each when they're moved into a
+    // prefix-compressed node that they don't share a prefix with, so with mixed
+    // formats we have to check.  We don't know which way the nodes get merged.
+    return merged_cost(sizer, node, sibling) <= free_space(sizer)
+        && merged_cost(sizer, sibling, node) <= free_space(sizer);
 }
 
 // Sets *index_out to the index for the live entry or deletion entry
@@ -1123,6 +1609,9 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
     int beg = 0;
     int end = node->num_pairs;
 
+    const bool compressed = is_prefix_compressed(node);
+    const uint64_t key_prefix = btree_key_prefix(key);
+
     // beg == 0 or key > *(beg - 1).
     // end == num_pairs or key < *end.
 
@@ -1130,9 +1619,10 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
         // when (end - beg) > 0, (end - beg) / 2 is always less than (end - beg).  So beg <= test_point < end.
         int test_point = beg + (end - beg) / 2;
 
-        const btree_key_t *ek = entry_key(get_entry(node, node->pair_offsets[test_point]));
-
-        int res = sized_strcmp(key->contents, key->size, ek->contents, ek->size);
+        const entry_t *ent = get_entry(node, node->pair_offsets[test_point]);
+        int res = compressed
+            ? entry_key_cmp(key, node, ent)
+            : btree_key_cmp(key, key_prefix, entry_key(ent));
 
         if (res < 0) {
             // key < *test_point.
@@ -1159,7 +1649,7 @@ bool lookup(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_key
     if (find_key(node, key, &index)) {
         const entry_t *ent = get_entry(node, node->pair_offsets[index]);
         if (entry_is_live(ent)) {
-            const void *val = entry_value(ent);
+            const void *val = entry_value(node, ent);
             memcpy(value_out, val, sizer->size(val));
             return true;
         }
@@ -1206,7 +1696,7 @@ MUST_USE bool prepare_space_for_new_entry(value_sizer_t<void> *sizer, leaf_node_
         int offset = node->pair_offsets[index];
         entry_t *ent = get_entry(node, offset);
 
-        int sz = entry_size(sizer, ent);
+        int sz = entry_size(sizer, node, ent);
 
         if (entry_is_live(ent)) {
             node->live_size -= sizeof(uint16_t) + sz;
@@ -1229,6 +1719,7 @@ MUST_USE bool prepare_space_for_new_entry(value_sizer_t<void> *sizer, leaf_node_
 
     if (offsetof(leaf_node_t, pair_offsets) +
             sizeof(uint16_t) * (node->num_pairs + (found ? 0 : 1)) +
+            prefix_cost(node) +
             sizeof(repli_timestamp_t) +
             new_entry_size >
             node->frontmost) {
@@ -1240,7 +1731,7 @@ MUST_USE bool prepare_space_for_new_entry(value_sizer_t<void> *sizer, leaf_node_
                 node->pair_offsets + index,
                 node->pair_offsets + index + 1,
                 sizeof(uint16_t) * (node->num_pairs - index - 1));
-            --node->num_pairs;
+            set_num_pairs(node, node->num_pairs - 1);
         }
 
         /* Passing `&index` as the last parameter to `garbage_collect()`
@@ -1303,7 +1794,7 @@ MUST_USE bool prepare_space_for_new_entry(value_sizer_t<void> *sizer, leaf_node_
                 node->pair_offsets + index,
                 node->pair_offsets + index + 1,
                 sizeof(uint16_t) * (node->num_pairs - index - 1));
-            --node->num_pairs;
+            set_num_pairs(node, node->num_pairs - 1);
         }
 
         return false;
@@ -1315,11 +1806,11 @@ MUST_USE bool prepare_space_for_new_entry(value_sizer_t<void> *sizer, leaf_node_
     create a new entry or not. */
 
     if (!found) {
+        set_num_pairs(node, node->num_pairs + 1);
         memmove(
             node->pair_offsets + index + 1,
             node->pair_offsets + index,
-            sizeof(uint16_t) * (node->num_pairs - index));
-        ++node->num_pairs;
+            sizeof(uint16_t) * (node->num_pairs - 1 - index));
     }
 
     /* Now that we know where in the leaf node to write our entry, make space if
@@ -1349,7 +1840,7 @@ MUST_USE bool prepare_space_for_new_entry(value_sizer_t<void> *sizer, leaf_node_
     }
 
     node->frontmost -= total_space_for_new_entry;
-    rassert(offsetof(leaf_node_t, pair_offsets) + sizeof(uint16_t) * node->num_pairs <= node->frontmost);
+    rassert(header_end(node) <= node->frontmost);
 
     /* Write the timestamp if we need one, and update `node->tstamp_cutpoint` if
     we don't. */
@@ -1384,20 +1875,20 @@ void insert(value_sizer_t<void> *sizer, leaf_node_t *node, const btree_key_t *ke
 
     /* Make space for the entry itself */
 
+    const int key_cost = encoded_key_cost(node, key);
     char *location_to_write_data;
     DEBUG_VAR bool should_write = prepare_space_for_new_entry(sizer, node,
-        key, key->full_size() + sizer->size(value), tstamp,
+        key, key_cost + sizer->size(value), tstamp,
         true,
         &location_to_write_data);
     rassert(should_write);
 
     /* Now copy the data into the node itself */
 
-    memcpy(location_to_write_data, key, key->full_size());
-    location_to_write_data += key->full_size();
+    location_to_write_data = write_encoded_key(node, key, location_to_write_data);
     memcpy(location_to_write_data, value, sizer->size(value));
 
-    node->live_size += sizeof(uint16_t) + key->full_size() + sizer->size(value);
+    node->live_size += sizeof(uint16_t) + key_cost + sizer->size(value);
 
     validate(sizer, node);
 }
@@ -1419,13 +1910,13 @@ void remove(value_sizer_t<void> *sizer, leaf_node_t *node, const btree_key_t *ke
     char *location_to_write_data;
     if (prepare_space_for_new_entry(sizer, node,
             key,
-            1 + key->full_size(),   /* 1 for `DELETE_ENTRY_CODE` */
+            1 + encoded_key_cost(node, key),   /* 1 for `DELETE_ENTRY_CODE` */
             tstamp,
             false,
             &location_to_write_data)) {
         *location_to_write_data = static_cast<char>(DELETE_ENTRY_CODE);
         ++location_to_write_data;
-        memcpy(location_to_write_data, key, key->full_size());
+        write_encoded_key(node, key, location_to_write_data);
     }
 
     validate(sizer, node);
@@ -1441,7 +1932,7 @@ void erase_presence(value_sizer_t<void> *sizer, leaf_node_t *node, const btree_k
         int offset = node->pair_offsets[index];
         entry_t *ent = get_entry(node, offset);
 
-        int sz = entry_size(sizer, ent);
+        int sz = entry_size(sizer, node, ent);
         if (entry_is_live(ent)) {
             node->live_size -= sizeof(uint16_t) + sz;
         }
@@ -1449,7 +1940,7 @@ void erase_presence(value_sizer_t<void> *sizer, leaf_node_t *node, const btree_k
         clean_entry(ent, sz);
 
         memmove(node->pair_offsets + index, node->pair_offsets + index + 1, (node->num_pairs - (index + 1)) * sizeof(uint16_t));
-        node->num_pairs -= 1;
+        set_num_pairs(node, node->num_pairs - 1);
     }
 
 
@@ -1493,6 +1984,7 @@ void dump_entries_since_time(value_sizer_t<void> *sizer, const leaf_node_t *node
     {
         entry_iter_t iter = entry_iter_t::make(node);
         repli_timestamp_t last_seen_tstamp = maximum_possible_timestamp;
+        store_key_t key_buf;
         while (iter.offset < stop_offset) {
             repli_timestamp_t tstamp;
             if (iter.offset < node->tstamp_cutpoint) {
@@ -1505,9 +1997,9 @@ void dump_entries_since_time(value_sizer_t<void> *sizer, const leaf_node_t *node
             const entry_t *ent = get_entry(node, iter.offset);
 
             if (entry_is_live(ent)) {
-                cb->key_value(entry_key(ent), entry_value(ent), tstamp);
+                cb->key_value(entry_full_key(node, ent, &key_buf), entry_value(node, ent), tstamp);
             } else if (entry_is_deletion(ent) && include_deletions) {
-                cb->deletion(entry_key(ent), tstamp);
+                cb->deletion(entry_full_key(node, ent, &key_buf), tstamp);
             }
 
             iter.step(sizer, node);
@@ -1525,7 +2017,7 @@ std::pair<const btree_key_t *, const void *> iterator::operator*() const {
     guarantee(index_ < static_cast<int>(node_->num_pairs));
     guarantee(index_ >= 0);
     const entry_t *entree = get_entry(node_, node_->pair_offsets[index_]);
-    return std::make_pair(entry_key(entree), entry_value(entree));
+    return std::make_pair(entry_full_key(node_, entree, &key_buf_), entry_value(node_, entree));
 }
 
 iterator &iterator::operator++() {
@@ -1616,9 +2108,7 @@ leaf::reverse_iterator inclusive_upper_bound(const btree_key_t *key, const leaf_
     leaf::find_key(&leaf_node, key, &index);
     if (index < leaf_node.num_pairs) {
         const leaf::entry_t *entry = leaf::get_entry(&leaf_node, leaf_node.pair_offsets[index]);
-        const btree_key_t *ekey = leaf::entry_key(entry);
-        if (entry_is_live(entry) &&
-            sized_strcmp(ekey->contents, ekey->size, key->contents, key->size) == 0) {
+        if (entry_is_live(entry) && entry_key_cmp(key, &leaf_node, entry) == 0) {
             return leaf_node_t::reverse_iterator(&leaf_node, index);
         }
     }
@@ -5,11 +5,11 @@
 #include <string>
 #include <utility>
 
+#include "btree/keys.hpp"
 #include "buffer_cache/types.hpp"
 #include "errors.hpp"
 
 template <class> class value_sizer_t;
-struct btree_key_t;
 class repli_timestamp_t;
 
 // TODO: Could key_modification_proof_t not go in this file?
@@ -62,6 +62,18 @@ struct leaf_node_t {
     typedef leaf::reverse_iterator reverse_iterator;
 };
 
+// How a leaf node stores its keys.  A btree's new leaf nodes get the format its
+// superblock asks for, and leaf nodes of both formats can be found in the same
+// btree.
+enum class leaf_key_format_t {
+    // Every entry holds its full key.
+    full,
+    // Entries don't repeat the prefix that the node's keys have in common, which
+    // makes room for more entries when keys are long and similar, as secondary
+    // index keys tend to be.
+    prefix_compressed
+};
+
 namespace leaf {
 
 leaf_node_t::iterator begin(const leaf_node_t &leaf_node);
@@ -118,6 +130,12 @@ bool fsck(value_sizer_t<void> *sizer, const btree_key_t *left_exclusive_or_null,
 void validate(value_sizer_t<void> *sizer, const leaf_node_t *node);
 
 void init(value_sizer_t<void> *sizer, leaf_node_t *node);
+void init(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_key_format_t format);
+
+leaf_key_format_t key_format(const leaf_node_t *node);
+
+// Whether `magic` is that of a leaf node (of either format) for the sizer's values.
+bool is_leaf_magic(value_sizer_t<void> *sizer, block_magic_t magic);
 
 bool is_empty(const leaf_node_t *node);
 
@@ -125,8 +143,21 @@ bool is_full(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_ke
 
 bool is_underfull(value_sizer_t<void> *sizer, const leaf_node_t *node);
 
+// Whether no write of a single key can make the node split or merge: any key and
+// value fit in it, and it isn't underfull.  (A removal can still leave it underfull,
+// but then the next write to it will merge it.)
+bool is_safe_for_write(value_sizer_t<void> *sizer, const leaf_node_t *node);
+
 void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out);
 
+// Splits `node` so that it keeps all but its last entry, for a node at the right
+// edge of the tree that keys are being appended to.  The right node is underfull,
+// but gets filled by the appends.
+void split_for_append(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out);
+
+// Whether `key` would go after all of the node's keys.
+bool is_append(const leaf_node_t *node, const btree_key_t *key);
+
 void merge(value_sizer_t<void> *sizer, leaf_node_t *left, leaf_node_t *right);
 
 bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, leaf_node_t *node, leaf_node_t *sibling, btree_key_t *replacement_key_out);
@@ -168,6 +199,7 @@ class iterator {
 public:
     iterator();
     iterator(const leaf_node_t *node, int index);
+    // The key is only valid until the iterator is next dereferenced or destroyed.
     std::pair<const btree_key_t *, const void *> operator*() const;
     iterator &operator++();
     iterator &operator--();
@@ -182,6 +214,8 @@ private:
     int cmp(const iterator &other) const;
     const leaf_node_t *node_;
     int index_;
+    // Where a prefix-compressed node's keys are put together.
+    mutable store_key_t key_buf_;
 };
 
 class reverse_iterator {
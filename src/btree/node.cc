@@ -7,11 +7,13 @@
 const block_magic_t btree_superblock_t::expected_magic = { { 's', 'u', 'p', 'e' } };
 const block_magic_t internal_node_t::expected_magic = { { 'i', 'n', 't', 'e' } };
 const block_magic_t btree_sindex_block_t::expected_magic = { { 's', 'i', 'n', 'd' } };
+const block_magic_t btree_field_dictionary_block_t::expected_magic = { { 'f', 'd', 'i', 'c' } };
+const block_magic_t btree_write_buffer_block_t::expected_magic = { { 'w', 'b', 'u', 'f' } };
 
 namespace node {
 
 bool is_underfull(value_sizer_t<void> *sizer, const node_t *node) {
-    if (node->magic == sizer->btree_leaf_magic()) {
+    if (leaf::is_leaf_magic(sizer, node->magic)) {
         return leaf::is_underfull(sizer, reinterpret_cast<const leaf_node_t *>(node));
     } else {
         rassert(is_internal(node));
@@ -20,7 +22,7 @@ bool is_underfull(value_sizer_t<void> *sizer, const node_t *node) {
 }
 
 bool is_mergable(value_sizer_t<void> *sizer, const node_t *node, const node_t *sibling, const internal_node_t *parent) {
-    if (sizer->btree_leaf_magic() == node->magic) {
+    if (leaf::is_leaf_magic(sizer, node->magic)) {
         return leaf::is_mergable(sizer, reinterpret_cast<const leaf_node_t *>(node), reinterpret_cast<const leaf_node_t *>(sibling));
     } else {
         rassert(is_internal(node));
@@ -39,6 +41,24 @@ void split(value_sizer_t<void> *sizer, node_t *node, node_t *rnode, btree_key_t
     }
 }
 
+void split_for_append(value_sizer_t<void> *sizer, node_t *node, node_t *rnode, btree_key_t *median) {
+    if (is_leaf(node)) {
+        leaf::split_for_append(sizer, reinterpret_cast<leaf_node_t *>(node),
+                               reinterpret_cast<leaf_node_t *>(rnode), median);
+    } else {
+        internal_node::split_for_append(sizer->block_size(), reinterpret_cast<internal_node_t *>(node),
+                                        reinterpret_cast<internal_node_t *>(rnode), median);
+    }
+}
+
+bool is_append(const node_t *node, const btree_key_t *key) {
+    if (is_leaf(node)) {
+        return leaf::is_append(reinterpret_cast<const leaf_node_t *>(node), key);
+    } else {
+        return internal_node::is_append(reinterpret_cast<const internal_node_t *>(node), key);
+    }
+}
+
 void merge(value_sizer_t<void> *sizer, node_t *node, node_t *rnode, const internal_node_t *parent) {
     if (is_leaf(node)) {
         leaf::merge(sizer, reinterpret_cast<leaf_node_t *>(node), reinterpret_cast<leaf_node_t *>(rnode));
@@ -63,7 +83,7 @@ bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, node_t *node,
 
 void validate(DEBUG_VAR value_sizer_t<void> *sizer, DEBUG_VAR const node_t *node) {
 #ifndef NDEBUG
-    if (node->magic == sizer->btree_leaf_magic()) {
+    if (leaf::is_leaf_magic(sizer, node->magic)) {
         leaf::validate(sizer, reinterpret_cast<const leaf_node_t *>(node));
     } else if (node->magic == internal_node_t::expected_magic) {
         internal_node::validate(sizer->block_size(), reinterpret_cast<const internal_node_t *>(node));
@@ -49,6 +49,15 @@ struct btree_superblock_t {
 
     char metainfo_blob[METAINFO_BLOB_MAXREFLEN];
 
+    // The block of the table's field dictionary (see field_dictionary_t), or
+    // NULL_BLOCK_ID if it hasn't needed one yet.  Superblocks from before it was
+    // added have zero here, the superblock's own id, which means the same thing.
+    block_id_t field_dictionary_block;
+
+    // The block of the store's write buffer log (see btree_write_buffer_t), or
+    // NULL_BLOCK_ID (or zero, as above) if it hasn't needed one yet.
+    block_id_t write_buffer_block;
+
     static const block_magic_t expected_magic;
 } __attribute__((packed));
 
@@ -70,6 +79,24 @@ struct btree_sindex_block_t {
     static const block_magic_t expected_magic;
 };
 
+struct btree_field_dictionary_block_t {
+    static const int FIELD_DICTIONARY_BLOB_MAXREFLEN = 4076;
+
+    block_magic_t magic;
+    char field_dictionary_blob[FIELD_DICTIONARY_BLOB_MAXREFLEN];
+
+    static const block_magic_t expected_magic;
+};
+
+struct btree_write_buffer_block_t {
+    static const int WRITE_BUFFER_BLOB_MAXREFLEN = 4076;
+
+    block_magic_t magic;
+    char write_buffer_blob[WRITE_BUFFER_BLOB_MAXREFLEN];
+
+    static const block_magic_t expected_magic;
+};
+
 //Note: This struct is stored directly on disk.  Changing it invalidates old data.
 struct internal_node_t {
     block_magic_t magic;
@@ -107,6 +134,13 @@ bool is_underfull(value_sizer_t<void> *sizer, const node_t *node);
 
 void split(value_sizer_t<void> *sizer, node_t *node, node_t *rnode, btree_key_t *median);
 
+// Splits a node at the right edge of the tree, that keys are being appended to, so
+// that it stays full (see leaf::split_for_append and internal_node::split_for_append).
+void split_for_append(value_sizer_t<void> *sizer, node_t *node, node_t *rnode, btree_key_t *median);
+
+// Whether `key` goes after all of the node's keys (or to its last child).
+bool is_append(const node_t *node, const btree_key_t *key);
+
 void merge(value_sizer_t<void> *sizer, node_t *node, node_t *rnode, const internal_node_t *parent);
 
 bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, node_t *node, node_t *rnode, btree_key_t *replacement_key, const internal_node_t *parent);
@@ -3,13 +3,28 @@
 
 #include <stdint.h>
 
+#include "btree/routing_cache.hpp"
 #include "btree/slice.hpp"
 #include "buffer_cache/alt/alt.hpp"
 #include "buffer_cache/alt/blob.hpp"
 #include "containers/archive/vector_stream.hpp"
 
 real_superblock_t::real_superblock_t(buf_lock_t &&sb_buf)
-    : sb_buf_(std::move(sb_buf)) {}
+    : sb_buf_(std::move(sb_buf)), leaf_key_format_(leaf_key_format_t::full),
+      routing_cache_(NULL) {}
+
+real_superblock_t::real_superblock_t(buf_lock_t &&sb_buf,
+                                     leaf_key_format_t leaf_key_format)
+    : sb_buf_(std::move(sb_buf)), leaf_key_format_(leaf_key_format),
+      routing_cache_(NULL) {}
+
+btree_routing_cache_t *real_superblock_t::routing_cache() {
+    // A snapshotted read sees an older tree than the routes describe.
+    if (!sb_buf_.empty() && sb_buf_.is_snapshotted()) {
+        return NULL;
+    }
+    return routing_cache_;
+}
 
 void real_superblock_t::release() {
     sb_buf_.reset_buf_lock();
@@ -330,6 +345,10 @@ void clear_superblock_metainfo(buf_lock_t *superblock) {
 }
 
 void insert_root(block_id_t root_id, superblock_t* sb) {
+    btree_routing_cache_t *routing_cache = sb->routing_cache();
+    if (routing_cache != NULL) {
+        routing_cache->invalidate();
+    }
     sb->set_root_block_id(root_id);
 }
 
@@ -357,13 +376,30 @@ buf_lock_t get_root(value_sizer_t<void> *sizer, superblock_t *sb) {
         buf_lock_t lock(sb->expose_buf(), alt_create_t::create);
         {
             buf_write_t write(&lock);
-            leaf::init(sizer, static_cast<leaf_node_t *>(write.get_data_write()));
+            leaf::init(sizer, static_cast<leaf_node_t *>(write.get_data_write()),
+                       sb->leaf_key_format());
         }
         insert_root(lock.block_id(), sb);
         return lock;
     }
 }
 
+bool is_on_right_edge(buf_lock_t *buf, buf_lock_t *last_buf,
+                      bool parent_on_right_edge) {
+    if (last_buf->empty()) {
+        // The root's keys go on forever.
+        return true;
+    }
+    if (!parent_on_right_edge) {
+        return false;
+    }
+    buf_read_t last_buf_read(last_buf);
+    const internal_node_t *parent
+        = static_cast<const internal_node_t *>(last_buf_read.get_data_read());
+    return internal_node::get_pair_by_index(parent, parent->npairs - 1)->lnode
+        == buf->block_id();
+}
+
 // Split the node if necessary. If the node is a leaf_node, provide the new
 // value that will be inserted; if it's an internal node, provide NULL (we
 // split internal nodes proactively).
@@ -371,7 +407,14 @@ void check_and_handle_split(value_sizer_t<void> *sizer,
                             buf_lock_t *buf,
                             buf_lock_t *last_buf,
                             superblock_t *sb,
-                            const btree_key_t *key, void *new_value) {
+                            btree_routing_cache_t *routing_cache,
+                            const btree_key_t *key, void *new_value,
+                            bool parent_on_right_edge) {
+    // Keys that go past the end of the tree's right edge are probably being
+    // appended in order (by timestamp, say).  Then splitting the node in the middle
+    // would leave each node half empty once the appends move on, so the node keeps
+    // its keys and the appends fill the new node instead.
+    bool append;
     {
         buf_read_t buf_read(buf);
         const node_t *node = static_cast<const node_t *>(buf_read.get_data_read());
@@ -389,6 +432,13 @@ void check_and_handle_split(value_sizer_t<void> *sizer,
                 return;
             }
         }
+        append = node::is_append(node, key);
+    }
+    append = append && is_on_right_edge(buf, last_buf, parent_on_right_edge);
+
+    // Any leaf's range of keys might change.
+    if (routing_cache != NULL) {
+        routing_cache->invalidate();
     }
 
     // Allocate a new node to split into, and some temporary memory to keep
@@ -401,10 +451,17 @@ void check_and_handle_split(value_sizer_t<void> *sizer,
     {
         buf_write_t buf_write(buf);
         buf_write_t rbuf_write(&rbuf);
-        node::split(sizer,
-                    static_cast<node_t *>(buf_write.get_data_write()),
-                    static_cast<node_t *>(rbuf_write.get_data_write()),
-                    median);
+        if (append) {
+            node::split_for_append(sizer,
+                                   static_cast<node_t *>(buf_write.get_data_write()),
+                                   static_cast<node_t *>(rbuf_write.get_data_write()),
+                                   median);
+        } else {
+            node::split(sizer,
+                        static_cast<node_t *>(buf_write.get_data_write()),
+                        static_cast<node_t *>(rbuf_write.get_data_write()),
+                        median);
+        }
     }
 
     // Insert the key that sets the two nodes apart into the parent.
@@ -448,7 +505,9 @@ void check_and_handle_underfull(value_sizer_t<void> *sizer,
                                 buf_lock_t *buf,
                                 buf_lock_t *last_buf,
                                 superblock_t *sb,
-                                const btree_key_t *key) {
+                                btree_routing_cache_t *routing_cache,
+                                const btree_key_t *key,
+                                bool parent_on_right_edge) {
     bool node_is_underfull;
     {
         if (last_buf->empty()) {
@@ -461,6 +520,10 @@ void check_and_handle_underfull(value_sizer_t<void> *sizer,
         }
     }
     if (node_is_underfull) {
+        if (routing_cache != NULL) {
+            routing_cache->invalidate();
+        }
+
         // Acquire a sibling to merge or level with.
         store_key_t key_in_middle;
         block_id_t sib_node_id;
@@ -479,6 +542,7 @@ void check_and_handle_underfull(value_sizer_t<void> *sizer,
         buf_lock_t sib_buf(last_buf, sib_node_id, access_t::write);
 
         bool node_is_mergable;
+        bool keeps_appends;
         {
             buf_read_t sib_buf_read(&sib_buf);
             const node_t *sib_node
@@ -496,6 +560,14 @@ void check_and_handle_underfull(value_sizer_t<void> *sizer,
                 = static_cast<const internal_node_t *>(last_buf_read.get_data_read());
 
             node_is_mergable = node::is_mergable(sizer, node, sib_node, parent_node);
+
+            // A node at the right edge of the tree is left underfull by
+            // split_for_append, and leveling it would undo that.  An internal node
+            // needs enough pairs that each of its children still has a sibling.
+            keeps_appends = is_on_right_edge(buf, last_buf, parent_on_right_edge)
+                && (node::is_leaf(node)
+                    || reinterpret_cast<const internal_node_t *>(node)->npairs
+                       >= INTERNAL_APPEND_SPLIT_PAIRS);
         }
 
         if (node_is_mergable) {
@@ -553,7 +625,7 @@ void check_and_handle_underfull(value_sizer_t<void> *sizer,
                 last_buf->mark_deleted();
                 insert_root(buf->block_id(), sb);
             }
-        } else {
+        } else if (!keeps_appends) {
             // Level.
             store_key_t replacement_key_buffer;
             btree_key_t *replacement_key = replacement_key_buffer.btree_key();
@@ -8,6 +8,7 @@
 
 #include "btree/leaf_node.hpp"
 #include "btree/node.hpp"
+#include "btree/routing_cache.hpp"
 #include "buffer_cache/alt/alt.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/promise.hpp"
@@ -41,6 +42,14 @@ public:
 
     virtual buf_parent_t expose_buf() = 0;
 
+    // The format of the btree's new leaf nodes.
+    virtual leaf_key_format_t leaf_key_format() { return leaf_key_format_t::full; }
+
+    // The btree's leaf routes, which reads may follow and which writes must
+    // invalidate when they restructure the tree.  NULL if the btree has no routing
+    // cache, or if this is a snapshotted read.
+    virtual btree_routing_cache_t *routing_cache() { return NULL; }
+
     cache_t *cache() { return expose_buf().cache(); }
 
 private:
@@ -52,6 +61,7 @@ private:
 class real_superblock_t : public superblock_t {
 public:
     explicit real_superblock_t(buf_lock_t &&sb_buf);
+    real_superblock_t(buf_lock_t &&sb_buf, leaf_key_format_t leaf_key_format);
 
     void release();
     buf_lock_t *get() { return &sb_buf_; }
@@ -67,8 +77,18 @@ public:
 
     buf_parent_t expose_buf() { return buf_parent_t(&sb_buf_); }
 
+    leaf_key_format_t leaf_key_format() { return leaf_key_format_; }
+
+    btree_routing_cache_t *routing_cache();
+    void set_routing_cache(btree_routing_cache_t *routing_cache) {
+        routing_cache_ = routing_cache;
+    }
+
 private:
     buf_lock_t sb_buf_;
+    const leaf_key_format_t leaf_key_format_;
+
+    btree_routing_cache_t *routing_cache_;
 };
 
 class btree_stats_t;
@@ -82,12 +102,15 @@ public:
     keyvalue_location_t()
         : superblock(NULL), pass_back_superblock(NULL),
           there_originally_was_value(false), stat_block(NULL_BLOCK_ID),
-          stats(NULL) { }
+          stats(NULL), routing_cache(NULL), parent_on_right_edge(false) { }
 
     ~keyvalue_location_t() {
         if (pass_back_superblock != NULL && superblock != NULL) {
             pass_back_superblock->pulse(superblock);
         }
+        if (routing_cache != NULL) {
+            routing_cache->remove_writer();
+        }
     }
 
     superblock_t *superblock;
@@ -113,6 +136,8 @@ public:
         std::swap(there_originally_was_value, other.there_originally_was_value);
         std::swap(stats, other.stats);
         value.swap(other.value);
+        std::swap(routing_cache, other.routing_cache);
+        std::swap(parent_on_right_edge, other.parent_on_right_edge);
     }
 
 
@@ -120,6 +145,14 @@ public:
     block_id_t stat_block;
 
     btree_stats_t *stats;
+
+    // Set by find_keyvalue_location_for_write if the btree has a routing cache,
+    // which doesn't follow any routes until this write is done.
+    btree_routing_cache_t *routing_cache;
+
+    // Whether last_buf is at the right edge of the tree (see is_on_right_edge), set
+    // by find_keyvalue_location_for_write.
+    bool parent_on_right_edge;
 private:
 
     DISABLE_COPYING(keyvalue_location_t);
@@ -206,17 +239,26 @@ private:
 
 buf_lock_t get_root(value_sizer_t<void> *sizer, superblock_t *sb);
 
+// Whether `buf`'s node is at the right edge of the tree, so that no key is past its
+// range of keys, given whether its parent `last_buf` (if it has one) is.
+bool is_on_right_edge(buf_lock_t *buf, buf_lock_t *last_buf,
+                      bool parent_on_right_edge);
+
 void check_and_handle_split(value_sizer_t<void> *sizer,
                             buf_lock_t *buf,
                             buf_lock_t *last_buf,
                             superblock_t *sb,
-                            const btree_key_t *key, void *new_value);
+                            btree_routing_cache_t *routing_cache,
+                            const btree_key_t *key, void *new_value,
+                            bool parent_on_right_edge);
 
 void check_and_handle_underfull(value_sizer_t<void> *sizer,
                                 buf_lock_t *buf,
                                 buf_lock_t *last_buf,
                                 superblock_t *sb,
-                                const btree_key_t *key);
+                                btree_routing_cache_t *routing_cache,
+                                const btree_key_t *key,
+                                bool parent_on_right_edge);
 
 // Metainfo functions
 bool get_superblock_metainfo(buf_lock_t *superblock,
@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "btree/operations.hpp"
 
+#include <algorithm>
+
 #include "btree/internal_node.hpp"
 #include "btree/leaf_node.hpp"
 #include "btree/node.hpp"
@@ -31,6 +33,14 @@ void find_keyvalue_location_for_write(
     keyvalue_location_out->superblock = superblock;
     keyvalue_location_out->pass_back_superblock = pass_back_superblock;
 
+    // Reads mustn't jump straight to leaves that we might split or merge.
+    btree_routing_cache_t *routing_cache = superblock->routing_cache();
+    if (routing_cache != NULL) {
+        rassert(keyvalue_location_out->routing_cache == NULL);
+        routing_cache->add_writer();
+        keyvalue_location_out->routing_cache = routing_cache;
+    }
+
     ensure_stat_block(superblock);
     keyvalue_location_out->stat_block = keyvalue_location_out->superblock->get_stat_block_id();
 
@@ -50,6 +60,7 @@ void find_keyvalue_location_for_write(
     }
 
     // Walk down the tree to the leaf.
+    bool parent_on_right_edge = true;
     for (;;) {
         {
             buf_read_t read(&buf);
@@ -60,14 +71,18 @@ void find_keyvalue_location_for_write(
         // Check if the node is overfull and proactively split it if it is (since this is an internal node).
         {
             profile::starter_t starter("Perhaps split node.", trace);
-            check_and_handle_split(&sizer, &buf, &last_buf, superblock, key, static_cast<Value *>(NULL));
+            check_and_handle_split(&sizer, &buf, &last_buf, superblock, routing_cache,
+                                   key, static_cast<Value *>(NULL),
+                                   parent_on_right_edge);
         }
 
         // Check if the node is underfull, and merge/level if it is.
         {
             profile::starter_t starter("Perhaps merge nodes.", trace);
-            check_and_handle_underfull(&sizer, &buf, &last_buf, superblock, key);
+            check_and_handle_underfull(&sizer, &buf, &last_buf, superblock, routing_cache,
+                                       key, parent_on_right_edge);
         }
+        parent_on_right_edge = is_on_right_edge(&buf, &last_buf, parent_on_right_edge);
 
         // Release the superblock, if we've gone past the root (and haven't
         // already released it). If we're still at the root or at one of
@@ -120,6 +135,41 @@ void find_keyvalue_location_for_write(
 
     keyvalue_location_out->last_buf.swap(last_buf);
     keyvalue_location_out->buf.swap(buf);
+    keyvalue_location_out->parent_on_right_edge = parent_on_right_edge;
+}
+
+/* Releases the leaf's parent, and the superblock if we still have it, if the write
+can't split or merge the leaf (see leaf::is_safe_for_write).  Then writes to the
+leaf's siblings don't have to wait while this one reads the old value or computes
+the new one, and a following write that was waiting for the superblock can start
+down the tree.  Writes that go on to use the parent, like the batched writes below,
+mustn't call this. */
+template <class Value>
+void release_ancestors_if_leaf_is_safe(keyvalue_location_t<Value> *kv_location) {
+    if (kv_location->last_buf.empty() && kv_location->superblock == NULL) {
+        return;
+    }
+    value_sizer_t<Value> sizer(kv_location->buf.cache()->max_block_size());
+    {
+        buf_read_t read(&kv_location->buf);
+        auto node = static_cast<const leaf_node_t *>(read.get_data_read());
+        if (!leaf::is_safe_for_write(&sizer, node)) {
+            return;
+        }
+    }
+
+    // With no parent, check_and_handle_split and check_and_handle_underfull take
+    // the leaf for the root, which they neither split (since it isn't full) nor
+    // merge.
+    kv_location->last_buf.reset_buf_lock();
+    if (kv_location->superblock != NULL) {
+        if (kv_location->pass_back_superblock != NULL) {
+            kv_location->pass_back_superblock->pulse(kv_location->superblock);
+        } else {
+            kv_location->superblock->release();
+        }
+        kv_location->superblock = NULL;
+    }
 }
 
 template <class Value>
@@ -139,39 +189,24 @@ void find_keyvalue_location_for_read(
         return;
     }
 
+    btree_routing_cache_t *routing_cache = superblock->routing_cache();
     buf_lock_t buf;
-    {
+    block_id_t leaf_id;
+    if (routing_cache != NULL && routing_cache->find_leaf(key, &leaf_id)) {
+        // We know which leaf holds the key, so we can skip the internal nodes.
+        // Nobody is writing to the tree, so any writer that comes along will line
+        // up behind us for the leaf.
         profile::starter_t starter("Acquire a block for read.", trace);
-        buf_lock_t tmp(superblock->expose_buf(), root_id, access_t::read);
+        buf_lock_t tmp(superblock->expose_buf(), leaf_id, access_t::read);
         superblock->release();
         buf = std::move(tmp);
-    }
-
-#ifndef NDEBUG
-    {
-        buf_read_t read(&buf);
-        node::validate(&sizer, static_cast<const node_t *>(read.get_data_read()));
-    }
-#endif  // NDEBUG
-
-    for (;;) {
-        block_id_t node_id;
-        {
-            buf_read_t read(&buf);
-            const void *data = read.get_data_read();
-            if (!node::is_internal(static_cast<const node_t *>(data))) {
-                break;
-            }
-
-            node_id = internal_node::lookup(static_cast<const internal_node_t *>(data),
-                                            key);
-        }
-        rassert(node_id != NULL_BLOCK_ID && node_id != SUPERBLOCK_ID);
-
+    } else {
+        const uint64_t routing_version
+            = routing_cache != NULL ? routing_cache->version() : 0;
         {
             profile::starter_t starter("Acquire a block for read.", trace);
-            buf_lock_t tmp(&buf, node_id, access_t::read);
-            buf.reset_buf_lock();
+            buf_lock_t tmp(superblock->expose_buf(), root_id, access_t::read);
+            superblock->release();
             buf = std::move(tmp);
         }
 
@@ -181,6 +216,61 @@ void find_keyvalue_location_for_read(
             node::validate(&sizer, static_cast<const node_t *>(read.get_data_read()));
         }
 #endif  // NDEBUG
+
+        // The range of keys the node in `buf` holds, for the routing cache.
+        store_key_t left_exclusive;
+        bool has_left = false;
+        store_key_t right_inclusive;
+        bool has_right = false;
+
+        for (;;) {
+            block_id_t node_id;
+            {
+                buf_read_t read(&buf);
+                const void *data = read.get_data_read();
+                if (!node::is_internal(static_cast<const node_t *>(data))) {
+                    break;
+                }
+
+                const internal_node_t *node = static_cast<const internal_node_t *>(data);
+                const int index = internal_node::get_offset_index(node, key);
+                node_id = internal_node::get_pair_by_index(node, index)->lnode;
+                if (routing_cache != NULL) {
+                    // The last pair's key is always empty.
+                    if (index > 0) {
+                        left_exclusive = store_key_t(
+                            &internal_node::get_pair_by_index(node, index - 1)->key);
+                        has_left = true;
+                    }
+                    if (index < node->npairs - 1) {
+                        right_inclusive = store_key_t(
+                            &internal_node::get_pair_by_index(node, index)->key);
+                        has_right = true;
+                    }
+                }
+            }
+            rassert(node_id != NULL_BLOCK_ID && node_id != SUPERBLOCK_ID);
+
+            {
+                profile::starter_t starter("Acquire a block for read.", trace);
+                buf_lock_t tmp(&buf, node_id, access_t::read);
+                buf.reset_buf_lock();
+                buf = std::move(tmp);
+            }
+
+#ifndef NDEBUG
+            {
+                buf_read_t read(&buf);
+                node::validate(&sizer, static_cast<const node_t *>(read.get_data_read()));
+            }
+#endif  // NDEBUG
+        }
+
+        if (routing_cache != NULL) {
+            routing_cache->add_leaf(has_left ? left_exclusive.btree_key() : NULL,
+                                    has_right ? right_inclusive.btree_key() : NULL,
+                                    buf.block_id(), routing_version);
+        }
     }
 
     // Got down to the leaf, now probe it.
@@ -223,7 +313,9 @@ void apply_keyvalue_change(keyvalue_location_t<Value> *kv_loc,
         // node won't grow.
 
         check_and_handle_split(&sizer, &kv_loc->buf, &kv_loc->last_buf,
-                               kv_loc->superblock, key, kv_loc->value.get());
+                               kv_loc->superblock, kv_loc->routing_cache,
+                               key, kv_loc->value.get(),
+                               kv_loc->parent_on_right_edge);
 
         {
 #ifndef NDEBUG
@@ -289,7 +381,8 @@ void apply_keyvalue_change(keyvalue_location_t<Value> *kv_loc,
     // Check to see if the leaf is underfull (following a change in
     // size or a deletion, and merge/level if it is.
     check_and_handle_underfull(&sizer, &kv_loc->buf, &kv_loc->last_buf,
-                               kv_loc->superblock, key);
+                               kv_loc->superblock, kv_loc->routing_cache, key,
+                               kv_loc->parent_on_right_edge);
 
     // Modify the stats block.  The stats block is detached from the rest of the
     // btree, we don't keep a consistent view of it, so we pass the txn as its
@@ -301,3 +394,87 @@ void apply_keyvalue_change(keyvalue_location_t<Value> *kv_loc,
         = static_cast<btree_statblock_t *>(stat_block_write.get_data_write());
     stat_block_buf->population += population_change;
 }
+
+/* The functions below let writes to several keys share one walk down the tree, by
+doing them all under the parent of the leaf that find_keyvalue_location_for_write
+found for the first of them. */
+
+/* How many writes, counting the one `kv_location` was found for, can be done under
+its leaf's parent.  Each of them might split, merge, or level one of the parent's
+children, so the parent must have room for a pair per write, and must keep more than
+two pairs (or else a merge could replace it, if it's the root). */
+template <class Value>
+int max_writes_under_parent(keyvalue_location_t<Value> *kv_location) {
+    if (kv_location->last_buf.empty()) {
+        // The leaf is the root.
+        return 1;
+    }
+    buf_read_t read(&kv_location->last_buf);
+    auto node = static_cast<const internal_node_t *>(read.get_data_read());
+    return std::max(1, std::min(internal_node::num_free_pairs(node),
+                                node->npairs - 2));
+}
+
+/* True if `key` is known to belong under the parent of `kv_location`'s leaf, where
+`found_key` is the key that `kv_location` was found for. */
+template <class Value>
+bool key_is_under_parent(keyvalue_location_t<Value> *kv_location,
+                         const btree_key_t *found_key,
+                         const btree_key_t *key) {
+    guarantee(!kv_location->last_buf.empty());
+    buf_read_t read(&kv_location->last_buf);
+    auto node = static_cast<const internal_node_t *>(read.get_data_read());
+
+    // The parent holds an interval of keys, which has `found_key` and the keys of
+    // the parent's pairs (but the last one, which is empty) in it.
+    const btree_key_t *lowest = found_key;
+    const btree_key_t *highest = found_key;
+    if (node->npairs > 1) {
+        const btree_key_t *first = &internal_node::get_pair_by_index(node, 0)->key;
+        const btree_key_t *last
+            = &internal_node::get_pair_by_index(node, node->npairs - 2)->key;
+        if (sized_strcmp(first->contents, first->size,
+                         lowest->contents, lowest->size) < 0) {
+            lowest = first;
+        }
+        if (sized_strcmp(last->contents, last->size,
+                         highest->contents, highest->size) > 0) {
+            highest = last;
+        }
+    }
+    return sized_strcmp(lowest->contents, lowest->size, key->contents, key->size) <= 0
+        && sized_strcmp(key->contents, key->size, highest->contents, highest->size) <= 0;
+}
+
+/* Makes `kv_location` refer to `key`, once the write it was found for has been
+applied.  `key` must be under the same parent (see key_is_under_parent), but may be
+in another of its children, which then gets acquired in place of the old leaf. */
+template <class Value>
+void move_keyvalue_location_for_write(keyvalue_location_t<Value> *kv_location,
+                                      const btree_key_t *key) {
+    value_sizer_t<Value> sizer(kv_location->buf.cache()->max_block_size());
+
+    block_id_t leaf_id;
+    {
+        buf_read_t read(&kv_location->last_buf);
+        auto node = static_cast<const internal_node_t *>(read.get_data_read());
+        leaf_id = internal_node::lookup(node, key);
+    }
+    if (leaf_id != kv_location->buf.block_id()) {
+        kv_location->buf.reset_buf_lock();
+        buf_lock_t tmp(&kv_location->last_buf, leaf_id, access_t::write);
+        kv_location->buf = std::move(tmp);
+    }
+
+    kv_location->there_originally_was_value = false;
+    kv_location->value.reset();
+    {
+        scoped_malloc_t<Value> tmp(sizer.max_possible_size());
+        buf_read_t read(&kv_location->buf);
+        auto node = static_cast<const leaf_node_t *>(read.get_data_read());
+        if (leaf::lookup(&sizer, node, key, tmp.get())) {
+            kv_location->there_originally_was_value = true;
+            kv_location->value = std::move(tmp);
+        }
+    }
+}
@@ -155,7 +155,7 @@ void btree_parallel_traversal(
 
 class parallel_traversal_progress_t : public traversal_progress_t {
 public:
-    parallel_traversal_progress_t() : height(-1) { }
+    parallel_traversal_progress_t() : height(-1), start_ticks(get_ticks()) { }
 
     enum action_t {
         LEARN,
@@ -173,6 +173,9 @@ public:
 
     progress_completion_fraction_t guess_completion() const;
 
+    // When the traversal started, to estimate how long it has left.
+    ticks_t get_start_ticks() const { return start_ticks; }
+
 private:
     std::vector<int> learned; //How many nodes at each level we believe exist
     std::vector<int> acquired; //How many nodes at each level we've acquired
@@ -180,6 +183,8 @@ private:
 
     int height; //The height we've learned the tree has. Or -1 if we're still unsure;
 
+    ticks_t start_ticks;
+
     DISABLE_COPYING(parallel_traversal_progress_t);
 };
 
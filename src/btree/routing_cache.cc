@@ -0,0 +1,69 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/routing_cache.hpp"
+
+#include "config/args.hpp"
+
+btree_routing_cache_t::btree_routing_cache_t() : version_(0), num_writers_(0) { }
+
+bool btree_routing_cache_t::find_leaf(const btree_key_t *key,
+                                      block_id_t *leaf_id_out) const {
+    assert_thread();
+    if (num_writers_ > 0) {
+        return false;
+    }
+
+    // The first route whose right bound isn't less than `key`.
+    auto it = routes_.lower_bound(store_key_t(key));
+    if (it == routes_.end()) {
+        return false;
+    }
+    const route_t &route = it->second;
+    if (route.has_left && btree_key_cmp(key, route.left_exclusive.btree_key()) <= 0) {
+        // There's a gap between the routes we know about, and `key` is in it.
+        return false;
+    }
+    *leaf_id_out = route.leaf_id;
+    return true;
+}
+
+void btree_routing_cache_t::add_leaf(const btree_key_t *left_exclusive_or_null,
+                                     const btree_key_t *right_inclusive_or_null,
+                                     block_id_t leaf_id,
+                                     uint64_t version) {
+    assert_thread();
+    if (version != version_) {
+        return;
+    }
+    if (routes_.size() >= BTREE_ROUTING_CACHE_MAX_ROUTES) {
+        // Routes are cheap to record again, so rather than keeping track of which
+        // ones are in use we just start over.
+        routes_.clear();
+    }
+
+    route_t route;
+    route.has_left = left_exclusive_or_null != NULL;
+    if (route.has_left) {
+        route.left_exclusive = store_key_t(left_exclusive_or_null);
+    }
+    route.leaf_id = leaf_id;
+    routes_[right_inclusive_or_null == NULL
+            ? store_key_t::max()
+            : store_key_t(right_inclusive_or_null)] = route;
+}
+
+void btree_routing_cache_t::invalidate() {
+    assert_thread();
+    ++version_;
+    routes_.clear();
+}
+
+void btree_routing_cache_t::add_writer() {
+    assert_thread();
+    ++num_writers_;
+}
+
+void btree_routing_cache_t::remove_writer() {
+    assert_thread();
+    guarantee(num_writers_ > 0);
+    --num_writers_;
+}
@@ -0,0 +1,67 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BTREE_ROUTING_CACHE_HPP_
+#define BTREE_ROUTING_CACHE_HPP_
+
+#include <map>
+
+#include "btree/keys.hpp"
+#include "buffer_cache/types.hpp"
+#include "utils.hpp"
+
+/* Remembers which leaf node holds which range of keys, so that a point read can
+acquire the leaf straight from the superblock instead of walking down from the root
+through the internal nodes.  Each route is recorded by a read that walked down the
+tree, and every split, merge, leveling, or root change throws all of the routes
+away, since any of them could now be wrong.
+
+Routes are only followed while no write to the btree is in progress.  A write that
+hasn't split or merged anything yet might still do so, and a reader that jumped
+past the internal nodes wouldn't be ordered against it the way the buffer cache
+orders readers and writers that descend through the same nodes. */
+class btree_routing_cache_t : public home_thread_mixin_debug_only_t {
+public:
+    btree_routing_cache_t();
+
+    // Returns true and sets `*leaf_id_out` if a route to the leaf that holds `key`
+    // is known and may be followed.
+    bool find_leaf(const btree_key_t *key, block_id_t *leaf_id_out) const;
+
+    // Remembers that `leaf_id` holds the keys in (left_exclusive_or_null,
+    // right_inclusive_or_null].  `version` is what `version()` returned before the
+    // walk down to the leaf began; if the tree has been restructured since then, the
+    // route is dropped.
+    void add_leaf(const btree_key_t *left_exclusive_or_null,
+                  const btree_key_t *right_inclusive_or_null,
+                  block_id_t leaf_id,
+                  uint64_t version);
+
+    // Called whenever a node is split, merged, leveled, made the root, or dropped by
+    // an erase.
+    void invalidate();
+
+    uint64_t version() const { return version_; }
+
+    // Writers call these while they hold the superblock for write.
+    void add_writer();
+    void remove_writer();
+
+    size_t num_routes() const { return routes_.size(); }
+
+private:
+    struct route_t {
+        bool has_left;
+        store_key_t left_exclusive;
+        block_id_t leaf_id;
+    };
+
+    // Routes, by the right (inclusive) bound of their leaf's keys.  The rightmost
+    // leaf's route has `store_key_t::max()` as its bound.
+    std::map<store_key_t, route_t> routes_;
+
+    uint64_t version_;
+    int num_writers_;
+
+    DISABLE_COPYING(btree_routing_cache_t);
+};
+
+#endif  // BTREE_ROUTING_CACHE_HPP_
@@ -5,6 +5,7 @@
 #include "btree/operations.hpp"
 #include "btree/secondary_operations.hpp"
 #include "btree/slice.hpp"
+#include "buffer_cache/alt/blob.hpp"
 #include "concurrency/cond_var.hpp"
 #include "repli_timestamp.hpp"
 
@@ -24,6 +25,8 @@ void btree_slice_t::init_superblock(buf_lock_t *superblock,
     sb->root_block = NULL_BLOCK_ID;
     sb->stat_block = NULL_BLOCK_ID;
     sb->sindex_block = NULL_BLOCK_ID;
+    sb->field_dictionary_block = NULL_BLOCK_ID;
+    sb->write_buffer_block = NULL_BLOCK_ID;
 
     set_superblock_metainfo(superblock, metainfo_key, metainfo_value);
 
@@ -35,7 +38,9 @@ void btree_slice_t::init_superblock(buf_lock_t *superblock,
 btree_slice_t::btree_slice_t(cache_t *c, perfmon_collection_t *parent,
                              const std::string &identifier)
     : stats(parent, identifier),
-      cache_(c) {
+      cache_(c),
+      value_maxreflen_(blob::btree_maxreflen),
+      field_dictionary_(NULL) {
     cache()->create_cache_account(BACKFILL_CACHE_PRIORITY, &backfill_account_);
 }
 
@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 
+#include "btree/hot_keys.hpp"
+#include "btree/routing_cache.hpp"
 #include "buffer_cache/types.hpp"
 #include "containers/scoped.hpp"
 #include "perfmon/perfmon.hpp"
@@ -14,6 +16,7 @@ class backfill_callback_t;
 class buf_lock_t;
 class buf_parent_t;
 class cache_t;
+class field_dictionary_t;
 class key_tester_t;
 
 
@@ -28,7 +31,8 @@ public:
           pm_keys_membership(&btree_collection,
               &pm_keys_read, "keys_read",
               &pm_keys_set, "keys_set",
-              &pm_keys_expired, "keys_expired")
+              &pm_keys_expired, "keys_expired"),
+          pm_hot_keys_membership(&btree_collection, &pm_hot_keys, "")
     { }
 
     perfmon_collection_t btree_collection;
@@ -38,6 +42,9 @@ public:
         pm_keys_set,
         pm_keys_expired;
     perfmon_multi_membership_t pm_keys_membership;
+    // Spliced into the btree's collection as `hot_keys` and `hot_ranges`.
+    perfmon_hot_keys_t pm_hot_keys;
+    perfmon_membership_t pm_hot_keys_membership;
 };
 
 /* btree_slice_t is a thin wrapper around cache_t that handles initializing the buffer
@@ -60,12 +67,35 @@ public:
 
     cache_t *cache() { return cache_; }
     alt_cache_account_t *get_backfill_account() { return backfill_account_.get(); }
+    btree_routing_cache_t *routing_cache() { return &routing_cache_; }
+
+    // The maxreflen of the blob references of new values, which says how big a value
+    // can get before it's kept out of the leaf node.  Only rdb values (which say
+    // what maxreflen they were written with) look at it.
+    int value_maxreflen() const { return value_maxreflen_; }
+    void set_value_maxreflen(int maxreflen) { value_maxreflen_ = maxreflen; }
+
+    // The dictionary of field names that rdb values are written and read with, or
+    // NULL.  A btree_store_t gives its one to all of its slices, since secondary
+    // index values are copies of primary ones.
+    field_dictionary_t *field_dictionary() const { return field_dictionary_; }
+    void set_field_dictionary(field_dictionary_t *dictionary) {
+        field_dictionary_ = dictionary;
+    }
 
     btree_stats_t stats;
 
 private:
     cache_t *cache_;
 
+    // Leaf routes for point reads.  A btree_store_t hands this to the superblocks
+    // it acquires for its primary btree.
+    btree_routing_cache_t routing_cache_;
+
+    int value_maxreflen_;
+
+    field_dictionary_t *field_dictionary_;
+
     // Cache account to be used when backfilling.
     scoped_ptr_t<alt_cache_account_t> backfill_account_;
 
@@ -46,6 +46,10 @@ public:
         return sub_superblock->expose_buf();
     }
 
+    btree_routing_cache_t *routing_cache() {
+        return sub_superblock->routing_cache();
+    }
+
 private:
     superblock_t *sub_superblock;
     int refcount;
@@ -0,0 +1,157 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/write_buffer.hpp"
+
+#include <string>
+
+#include "btree/node.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "buffer_cache/alt/blob.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "containers/archive/string_stream.hpp"
+
+btree_write_buffer_t::btree_write_buffer_t()
+    : latest_timestamp_(repli_timestamp_t::distant_past),
+      log_size_(0), max_size_(0), block_id_(NULL_BLOCK_ID) { }
+
+void btree_write_buffer_t::set_max_size(int64_t max_size) {
+    assert_thread();
+    rassert(max_size >= 0);
+    max_size_ = max_size;
+}
+
+const btree_write_buffer_t::message_t *
+btree_write_buffer_t::find(const store_key_t &key) const {
+    auto it = messages_.find(key);
+    return it == messages_.end() ? NULL : &it->second;
+}
+
+repli_timestamp_t btree_write_buffer_t::latest_timestamp() const {
+    return latest_timestamp_;
+}
+
+// Superblocks from before the write buffer have zero, SUPERBLOCK_ID, in place of its
+// block id.
+static block_id_t get_write_buffer_block_id(buf_lock_t *superblock) {
+    buf_read_t read(superblock);
+    const btree_superblock_t *sb
+        = static_cast<const btree_superblock_t *>(read.get_data_read());
+    return sb->write_buffer_block == SUPERBLOCK_ID
+        ? NULL_BLOCK_ID : sb->write_buffer_block;
+}
+
+void btree_write_buffer_t::load(buf_lock_t *superblock) {
+    assert_thread();
+    messages_.clear();
+    latest_timestamp_ = repli_timestamp_t::distant_past;
+    log_size_ = 0;
+    block_id_ = get_write_buffer_block_id(superblock);
+    if (block_id_ == NULL_BLOCK_ID) {
+        return;
+    }
+
+    buf_lock_t block(superblock, block_id_, access_t::read);
+    buf_read_t read(&block);
+    const btree_write_buffer_block_t *data
+        = static_cast<const btree_write_buffer_block_t *>(read.get_data_read());
+    guarantee(data->magic == btree_write_buffer_block_t::expected_magic);
+
+    blob_t blob(block.cache()->get_block_size(),
+                const_cast<char *>(data->write_buffer_blob),
+                btree_write_buffer_block_t::WRITE_BUFFER_BLOB_MAXREFLEN);
+    log_size_ = blob.valuesize();
+
+    // Later messages for a key replace earlier ones, as they did when they were added.
+    blob_read_stream_t stream(buf_parent_t(&block), data->write_buffer_blob,
+                              btree_write_buffer_block_t::WRITE_BUFFER_BLOB_MAXREFLEN);
+    for (;;) {
+        store_key_t key;
+        archive_result_t res = deserialize(&stream, &key);
+        if (res == ARCHIVE_SOCK_EOF) {
+            break;
+        }
+        guarantee_deserialization(res, "write buffer key");
+        message_t message;
+        res = deserialize(&stream, &message.timestamp);
+        guarantee_deserialization(res, "write buffer timestamp");
+        res = deserialize(&stream, &message.deletion);
+        guarantee_deserialization(res, "write buffer deletion");
+        res = deserialize(&stream, &message.value);
+        guarantee_deserialization(res, "write buffer value");
+
+        latest_timestamp_ = superceding_recency(latest_timestamp_, message.timestamp);
+        messages_[key] = std::move(message);
+    }
+}
+
+void btree_write_buffer_t::prepare(buf_lock_t *superblock) {
+    assert_thread();
+    if (block_id_ != NULL_BLOCK_ID) {
+        return;
+    }
+
+    buf_lock_t block(superblock, alt_create_t::create);
+    {
+        buf_write_t write(&block);
+        btree_write_buffer_block_t *data
+            = static_cast<btree_write_buffer_block_t *>(write.get_data_write());
+        data->magic = btree_write_buffer_block_t::expected_magic;
+        memset(data->write_buffer_blob, 0,
+               btree_write_buffer_block_t::WRITE_BUFFER_BLOB_MAXREFLEN);
+    }
+    buf_write_t sb_write(superblock);
+    btree_superblock_t *sb
+        = static_cast<btree_superblock_t *>(sb_write.get_data_write());
+    sb->write_buffer_block = block.block_id();
+    block_id_ = block.block_id();
+}
+
+void btree_write_buffer_t::add(buf_parent_t superblock, const store_key_t &key,
+                               const message_t &message) {
+    assert_thread();
+    guarantee(block_id_ != NULL_BLOCK_ID, "The write buffer wasn't prepared.");
+
+    write_message_t wm;
+    wm << key;
+    wm << message.timestamp;
+    wm << message.deletion;
+    wm << message.value;
+    string_stream_t record;
+    int res = send_write_message(&record, &wm);
+    guarantee(!res);
+
+    buf_lock_t block(superblock, block_id_, access_t::write);
+    {
+        buf_write_t write(&block);
+        btree_write_buffer_block_t *data
+            = static_cast<btree_write_buffer_block_t *>(write.get_data_write());
+        blob_t blob(block.cache()->get_block_size(), data->write_buffer_blob,
+                    btree_write_buffer_block_t::WRITE_BUFFER_BLOB_MAXREFLEN);
+        const int64_t offset = blob.valuesize();
+        blob.append_region(buf_parent_t(&block), record.str().size());
+        blob.write_from_string(record.str(), buf_parent_t(&block), offset);
+        log_size_ = blob.valuesize();
+    }
+
+    latest_timestamp_ = superceding_recency(latest_timestamp_, message.timestamp);
+    messages_[key] = message;
+}
+
+void btree_write_buffer_t::take_all(buf_parent_t superblock,
+                                    message_map_t *messages_out) {
+    assert_thread();
+    messages_out->clear();
+    messages_out->swap(messages_);
+    latest_timestamp_ = repli_timestamp_t::distant_past;
+    log_size_ = 0;
+    if (block_id_ == NULL_BLOCK_ID) {
+        return;
+    }
+
+    buf_lock_t block(superblock, block_id_, access_t::write);
+    buf_write_t write(&block);
+    btree_write_buffer_block_t *data
+        = static_cast<btree_write_buffer_block_t *>(write.get_data_write());
+    blob_t blob(block.cache()->get_block_size(), data->write_buffer_blob,
+                btree_write_buffer_block_t::WRITE_BUFFER_BLOB_MAXREFLEN);
+    blob.clear(buf_parent_t(&block));
+}
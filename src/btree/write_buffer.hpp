@@ -0,0 +1,95 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BTREE_WRITE_BUFFER_HPP_
+#define BTREE_WRITE_BUFFER_HPP_
+
+#include <stdint.h>
+
+#include <map>
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "buffer_cache/types.hpp"
+#include "repli_timestamp.hpp"
+#include "utils.hpp"
+
+class buf_lock_t;
+class buf_parent_t;
+
+/* A store's buffer of writes that haven't been applied to its btree's leaf nodes
+yet, for tables that take many more writes than reads.  Writing a document straight
+to the btree dirties its leaf node, so a stream of writes to random keys writes out
+a leaf node per document.  With a write buffer, writes are instead appended (as
+messages) to a log hanging off of the superblock, and the btree only sees them when
+the buffer gets full (or something needs the btree to be up to date) and all of the
+messages are flushed down to the leaves at once, in key order, in one transaction.
+Each leaf node then gets written once per flush rather than once per document.
+
+This is a B-epsilon tree's buffering, with a single buffer at the root of the tree
+rather than one in every internal node.  Point reads look for their keys in the
+buffer before going to the btree; btree_store_t flushes the buffer before any other
+read or backfill, and before writes that can't go through the buffer.
+
+The messages are kept in memory (only the latest one for each key) as well as in the
+log, which is only read when the store is started.  Everything here happens while
+the superblock is held for write, except for `find`, which needs it held for read. */
+class btree_write_buffer_t : public home_thread_mixin_debug_only_t {
+public:
+    struct message_t {
+        message_t() : deletion(false) { }
+
+        repli_timestamp_t timestamp;
+        // Whether the message deletes its key, rather than setting it to `value`.
+        bool deletion;
+        // The key's new value, serialized the way the protocol likes.
+        std::vector<char> value;
+    };
+
+    typedef std::map<store_key_t, message_t> message_map_t;
+
+    btree_write_buffer_t();
+
+    // How many bytes the log may grow to before the buffer is full.  Zero turns the
+    // buffer off, which doesn't get rid of any messages it already has.
+    void set_max_size(int64_t max_size);
+    bool enabled() const { return max_size_ > 0; }
+
+    bool empty() const { return messages_.empty(); }
+    // The number of keys that have messages, which is what a flush writes.
+    size_t message_count() const { return messages_.size(); }
+    bool full() const { return log_size_ >= max_size_; }
+
+    // The latest message for `key`, or NULL if the buffer has none.
+    const message_t *find(const store_key_t &key) const;
+
+    // The latest timestamp of the buffer's messages.
+    repli_timestamp_t latest_timestamp() const;
+
+    // Loads the messages in the log that `superblock` points to, if it has one.
+    void load(buf_lock_t *superblock);
+
+    // Makes `superblock` point to a log block, if it doesn't already, so that `add`
+    // can append to it.
+    void prepare(buf_lock_t *superblock);
+
+    // Appends a message for `key` to the log, after which it is `key`'s latest.
+    void add(buf_parent_t superblock, const store_key_t &key,
+             const message_t &message);
+
+    // Hands out each key's latest message, and empties the buffer and its log.
+    void take_all(buf_parent_t superblock, message_map_t *messages_out);
+
+private:
+    message_map_t messages_;
+    repli_timestamp_t latest_timestamp_;
+
+    // The size of the log, which counts every message added since the last flush.
+    int64_t log_size_;
+    int64_t max_size_;
+
+    // The log's block, or NULL_BLOCK_ID if the superblock doesn't have one yet.
+    block_id_t block_id_;
+
+    DISABLE_COPYING(btree_write_buffer_t);
+};
+
+#endif  // BTREE_WRITE_BUFFER_HPP_
@@ -1,9 +1,14 @@
 #include "buffer_cache/alt/alt.hpp"
 
+#include <math.h>
+
+#include <algorithm>
 #include <stack>
 
 #include "arch/types.hpp"
+#include "arch/runtime/coro_wait_profiler.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
 #include "buffer_cache/alt/stats.hpp"
 #include "concurrency/auto_drainer.hpp"
 
@@ -18,6 +23,16 @@ using alt::tracker_acq_t;
 
 const int SOFT_UNWRITTEN_CHANGES_LIMIT = 200;
 
+// Transactions get paced once this many changes are unwritten, and up to
+// PACING_BURST_CHANGES of them can get in at once after a lull.
+const int PACING_UNWRITTEN_CHANGES = SOFT_UNWRITTEN_CHANGES_LIMIT / 2;
+const int PACING_BURST_CHANGES = SOFT_UNWRITTEN_CHANGES_LIMIT / 4;
+
+// The flush rate is measured over windows of this many seconds, and each window's
+// rate is mixed into the estimate with this weight.
+const double FLUSH_RATE_WINDOW_SECS = 0.1;
+const double FLUSH_RATE_SMOOTHING = 0.25;
+
 // There are very few ASSERT_NO_CORO_WAITING calls (instead we have
 // ASSERT_FINITE_CORO_WAITING) because most of the time we're at the mercy of the
 // page cache, which often may need to load or evict blocks, which may involve a
@@ -52,8 +67,13 @@ private:
     DISABLE_COPYING(alt_snapshot_node_t);
 };
 
-alt_memory_tracker_t::alt_memory_tracker_t()
-    : unwritten_changes_semaphore_(SOFT_UNWRITTEN_CHANGES_LIMIT) { }
+alt_memory_tracker_t::alt_memory_tracker_t(lock_stats_t *throttle_stats)
+    : unwritten_changes_semaphore_(SOFT_UNWRITTEN_CHANGES_LIMIT, throttle_stats),
+      flush_rate_(0),
+      changes_flushed_in_window_(0),
+      window_start_(get_ticks()),
+      tokens_(PACING_BURST_CHANGES),
+      tokens_refilled_(get_ticks()) { }
 alt_memory_tracker_t::~alt_memory_tracker_t() { }
 
 void alt_memory_tracker_t::inform_memory_change(UNUSED uint64_t in_memory_size,
@@ -61,24 +81,61 @@ void alt_memory_tracker_t::inform_memory_change(UNUSED uint64_t in_memory_size,
     // KSI: implement this (for issue 97).
 }
 
+void alt_memory_tracker_t::refill_tokens() {
+    const ticks_t now = get_ticks();
+    const double secs = ticks_to_secs(now - tokens_refilled_);
+    tokens_ = std::min<double>(PACING_BURST_CHANGES, tokens_ + flush_rate_ * secs);
+    tokens_refilled_ = now;
+}
+
+void alt_memory_tracker_t::pace_txn(int64_t expected_change_count) {
+    refill_tokens();
+    if (flush_rate_ == 0
+        || unwritten_changes_semaphore_.current() < PACING_UNWRITTEN_CHANGES) {
+        return;
+    }
+    // Concurrent transactions take their tokens in turn, so each one waits for the
+    // changes of those before it to be paid for too.
+    tokens_ -= expected_change_count;
+    if (tokens_ < 0) {
+        nap(static_cast<int64_t>(ceil(-tokens_ * 1000 / flush_rate_)));
+    }
+}
+
 // KSI: An interface problem here is that this is measured in blocks while
 // inform_memory_change is measured in bytes.
 tracker_acq_t alt_memory_tracker_t::begin_txn_or_throttle(int64_t expected_change_count) {
+    pace_txn(expected_change_count);
     tracker_acq_t acq;
     acq.semaphore_acq_.init(&unwritten_changes_semaphore_, expected_change_count);
     acq.semaphore_acq_.acquisition_signal()->wait();
     return acq;
 }
 
-void alt_memory_tracker_t::end_txn(UNUSED tracker_acq_t acq) {
-    // Just let the acq destructor do its thing.
+void alt_memory_tracker_t::end_txn(tracker_acq_t acq) {
+    changes_flushed_in_window_ += acq.semaphore_acq_.count();
+    const ticks_t now = get_ticks();
+    const double secs = ticks_to_secs(now - window_start_);
+    if (secs >= FLUSH_RATE_WINDOW_SECS) {
+        // Only windows in which changes were waiting to be written tell us how fast
+        // the flushes can go; in the others they wrote whatever they got.
+        if (unwritten_changes_semaphore_.current() >= PACING_UNWRITTEN_CHANGES) {
+            const double rate = changes_flushed_in_window_ / secs;
+            flush_rate_ = flush_rate_ == 0
+                ? rate
+                : FLUSH_RATE_SMOOTHING * rate + (1 - FLUSH_RATE_SMOOTHING) * flush_rate_;
+        }
+        changes_flushed_in_window_ = 0;
+        window_start_ = now;
+    }
+    // The acq's destructor gives its changes back to the semaphore.
 }
 
 cache_t::cache_t(serializer_t *serializer, const alt_cache_config_t &config,
                  perfmon_collection_t *perfmon_collection)
     : stats_(make_scoped<alt_cache_stats_t>(perfmon_collection)),
-      tracker_(),
-      page_cache_(serializer, config.page_config, &tracker_) { }
+      tracker_(&stats_->unwritten_changes_throttle),
+      page_cache_(serializer, config.page_config, &tracker_, stats_.get()) { }
 
 cache_t::~cache_t() { }
 
@@ -91,6 +148,14 @@ void cache_t::create_cache_account(int priority,
     page_cache_.create_cache_account(priority, out);
 }
 
+void cache_t::prefetch(const std::vector<block_id_t> &block_ids) {
+    page_cache_.prefetch(block_ids);
+}
+
+void cache_t::start_warm_manifest(const std::string &path) {
+    page_cache_.start_warm_manifest(path);
+}
+
 alt_snapshot_node_t *
 cache_t::matching_snapshot_node_or_null(block_id_t block_id,
                                         block_version_t block_version) {
@@ -166,7 +231,8 @@ txn_t::txn_t(cache_conn_t *cache_conn,
              read_access_t)
     : cache_(cache_conn->cache()),
       access_(access_t::read),
-      durability_(write_durability_t::SOFT) {
+      durability_(write_durability_t::SOFT),
+      access_pattern_(cache_access_pattern_t::normal) {
     // Right now, cache_conn is only used to control flushing of write txns.  When we
     // need to support other cache_conn_t related features (like read operations
     // magically passing write operations), we'll need to do something fancier with
@@ -180,7 +246,8 @@ txn_t::txn_t(cache_conn_t *cache_conn,
              int64_t expected_change_count)
     : cache_(cache_conn->cache()),
       access_(access_t::write),
-      durability_(durability) {
+      durability_(durability),
+      access_pattern_(cache_access_pattern_t::normal) {
     help_construct(txn_timestamp, expected_change_count, cache_conn);
 }
 
@@ -490,6 +557,7 @@ void buf_lock_t::wait_for_parent(buf_parent_t parent, access_t access) {
     if (parent.lock_or_null_ != NULL) {
         buf_lock_t *lock = parent.lock_or_null_;
         guarantee(is_subordinate(lock->access(), access));
+        coro_wait_site_t wait_site("cache lock");
         if (access == access_t::write) {
             lock->write_acq_signal()->wait();
         } else {
@@ -661,11 +729,35 @@ repli_timestamp_t buf_lock_t::get_recency() const {
     return current_page_acq()->recency();
 }
 
+repli_timestamp_t buf_lock_t::get_child_recency(buf_parent_t parent,
+                                                block_id_t child_id) {
+    ASSERT_NO_CORO_WAITING;
+    cache_t *cache = parent.cache();
+    buf_lock_t *parent_lock = parent.lock_or_null_;
+    if (parent_lock != NULL && parent_lock->snapshot_node_ != NULL) {
+        // This follows get_or_create_child_snapshot_node: if a write has acquired
+        // the child since the parent was snapshotted, the parent's snapshot node
+        // has the child's version from before then.
+        auto it = parent_lock->snapshot_node_->children_.find(child_id);
+        if (it != parent_lock->snapshot_node_->children_.end()) {
+            guarantee(it->second != NULL,
+                      "Tried to get the recency (in cache %p) of a deleted block "
+                      "(%" PRIu64 " as child of %" PRIu64 ").",
+                      cache, child_id, parent_lock->block_id());
+            return it->second->current_page_acq_->recency();
+        }
+    }
+    return cache->page_cache_.recency_for_new_read_acquirer(child_id);
+}
+
 page_t *buf_lock_t::get_held_page_for_read() {
     guarantee(!empty());
     current_page_acq_t *cpa = current_page_acq();
     guarantee(cpa != NULL);
-    cpa->read_acq_signal()->wait();
+    {
+        coro_wait_site_t wait_site("cache lock");
+        cpa->read_acq_signal()->wait();
+    }
 
     ASSERT_FINITE_CORO_WAITING;
     guarantee(!empty());
@@ -675,7 +767,10 @@ page_t *buf_lock_t::get_held_page_for_read() {
 page_t *buf_lock_t::get_held_page_for_write() {
     guarantee(!empty());
     rassert(snapshot_node_ == NULL);
-    current_page_acq_->write_acq_signal()->wait();
+    {
+        coro_wait_site_t wait_site("cache lock");
+        current_page_acq_->write_acq_signal()->wait();
+    }
 
     ASSERT_FINITE_CORO_WAITING;
     guarantee(!empty());
@@ -698,9 +793,12 @@ const void *buf_read_t::get_data_read(uint32_t *block_size_out) {
     if (!page_acq_.has()) {
         page_acq_.init(page, &lock_->cache()->page_cache_);
     }
-    page_acq_.buf_ready_signal()->wait();
+    {
+        coro_wait_site_t wait_site("cache page load");
+        page_acq_.buf_ready_signal()->wait();
+    }
     *block_size_out = page_acq_.get_buf_size();
-    return page_acq_.get_buf_read();
+    return page_acq_.get_buf_read(lock_->txn()->access_pattern());
 }
 
 buf_write_t::buf_write_t(buf_lock_t *lock)
@@ -721,7 +819,10 @@ void *buf_write_t::get_data_write(uint32_t block_size) {
     if (!page_acq_.has()) {
         page_acq_.init(page, &lock_->cache()->page_cache_);
     }
-    page_acq_.buf_ready_signal()->wait();
+    {
+        coro_wait_site_t wait_site("cache page load");
+        page_acq_.buf_ready_signal()->wait();
+    }
     return page_acq_.get_buf_write();
 }
 
@@ -3,6 +3,7 @@
 #define BUFFER_CACHE_ALT_ALT_HPP_
 
 #include <map>
+#include <string>
 #include <vector>
 #include <utility>
 
@@ -23,7 +24,8 @@ class alt_snapshot_node_t;
 // inform_memory_change (right now) so this is just a nonsensical mixing of notions.
 class alt_memory_tracker_t : public memory_tracker_t {
 public:
-    alt_memory_tracker_t();
+    // `throttle_stats` may be NULL.
+    explicit alt_memory_tracker_t(lock_stats_t *throttle_stats = NULL);
     ~alt_memory_tracker_t();
 
     alt::tracker_acq_t begin_txn_or_throttle(int64_t expected_change_count);
@@ -35,7 +37,23 @@ private:
     void inform_memory_change(uint64_t in_memory_size,
                               uint64_t memory_limit);
 
+    // Once the unwritten changes back up, new transactions are let in at the rate
+    // the flushes have been writing changes out (a token bucket), so that writers
+    // wait a little each instead of all of them stalling on the semaphore until a
+    // flush completes.
+    void pace_txn(int64_t expected_change_count);
+    void refill_tokens();
+
     new_semaphore_t unwritten_changes_semaphore_;
+
+    // How many changes per second the flushes write out, when they're backed up,
+    // or 0 if we don't know yet.
+    double flush_rate_;
+    int64_t changes_flushed_in_window_;
+    ticks_t window_start_;
+
+    double tokens_;
+    ticks_t tokens_refilled_;
     DISABLE_COPYING(alt_memory_tracker_t);
 };
 
@@ -57,6 +75,12 @@ public:
     // might consider supporting a mem_cap paremeter.
     void create_cache_account(int priority, scoped_ptr_t<alt_cache_account_t> *out);
 
+    // See page_cache_t::prefetch.
+    void prefetch(const std::vector<block_id_t> &block_ids);
+
+    // See page_cache_t::start_warm_manifest.
+    void start_warm_manifest(const std::string &path);
+
 private:
     friend class txn_t;
     friend class buf_read_t;
@@ -99,6 +123,13 @@ public:
 
     void set_account(alt_cache_account_t *cache_account);
 
+    // How the blocks this transaction reads are expected to be used, as a hint to
+    // the page cache's eviction policy.  Defaults to cache_access_pattern_t::normal.
+    void set_access_pattern(cache_access_pattern_t access_pattern) {
+        access_pattern_ = access_pattern;
+    }
+    cache_access_pattern_t access_pattern() const { return access_pattern_; }
+
 private:
     static void inform_tracker(cache_t *cache,
                                alt::tracker_acq_t tracker_acq);
@@ -119,6 +150,8 @@ private:
     // Only applicable if access_ == write.
     const write_durability_t durability_;
 
+    cache_access_pattern_t access_pattern_;
+
     scoped_ptr_t<alt::page_txn_t> page_txn_;
 
     DISABLE_COPYING(txn_t);
@@ -186,6 +219,9 @@ public:
 
     void snapshot_subdag();
 
+    // True once snapshot_subdag() has been called.
+    bool is_snapshotted() const { return snapshot_node_ != NULL; }
+
     void detach_child(block_id_t child_id);
 
     block_id_t block_id() const {
@@ -195,6 +231,13 @@ public:
 
     repli_timestamp_t get_recency() const;
 
+    // The recency that acquiring `child_id` for read as a child of `parent` would
+    // give, found without acquiring it.  That matters for snapshotted parents,
+    // because acquiring their children snapshots the children, which loads them.
+    // The parent must already be read-acquired.
+    static repli_timestamp_t get_child_recency(buf_parent_t parent,
+                                               block_id_t child_id);
+
     access_t access() const {
         guarantee(!empty());
         return current_page_acq()->access();
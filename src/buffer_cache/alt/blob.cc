@@ -2,7 +2,9 @@
 #include "buffer_cache/alt/blob.hpp"
 
 #include <stdint.h>
+#include <string.h>
 
+#include <algorithm>
 #include <limits>
 
 #include "buffer_cache/alt/alt.hpp"
@@ -220,6 +222,11 @@ int btree_maxreflen = 251;
 block_magic_t internal_node_magic = { { 'l', 'a', 'r', 'i' } };
 block_magic_t leaf_node_magic = { { 'l', 'a', 'r', 'l' } };
 
+bool is_blob_block(const void *cache_data) {
+    const block_magic_t magic = *static_cast<const block_magic_t *>(cache_data);
+    return magic == leaf_node_magic || magic == internal_node_magic;
+}
+
 
 int64_t ref_value_offset(const char *ref, int maxreflen) {
     return is_small(ref, maxreflen) ? 0 : big_offset(ref, maxreflen);
@@ -353,6 +360,83 @@ void blob_t::expose_all(buf_parent_t parent, access_t mode,
     expose_region(parent, mode, 0, valuesize(), buffer_group_out, acq_group_out);
 }
 
+blob_read_stream_t::blob_read_stream_t(buf_parent_t parent, const char *ref,
+                                       int maxreflen)
+    : next_leaf_(0), pos_(NULL), end_(NULL) {
+    if (blob::is_small(ref, maxreflen)) {
+        pos_ = ref + blob::big_size_offset(maxreflen);
+        end_ = pos_ + blob::small_size(ref, maxreflen);
+    } else {
+        const int levels = blob::ref_info(parent.cache()->max_block_size(),
+                                          ref, maxreflen).levels;
+        add_leaves(parent, levels, blob::big_offset(ref, maxreflen),
+                   blob::big_size(ref, maxreflen), blob::block_ids(ref, maxreflen));
+    }
+}
+
+blob_read_stream_t::~blob_read_stream_t() { }
+
+void blob_read_stream_t::add_leaves(buf_parent_t parent, int levels,
+                                    int64_t offset, int64_t size,
+                                    const block_id_t *block_ids) {
+    const block_size_t block_size = parent.cache()->max_block_size();
+    int lo, hi;
+    blob::compute_acquisition_offsets(block_size, levels, offset, size, &lo, &hi);
+    for (int i = lo; i < hi; ++i) {
+        int64_t suboffset, subsize;
+        blob::shrink(block_size, levels, offset, size, i, &suboffset, &subsize);
+        if (levels > 1) {
+            buf_lock_t *lock = new buf_lock_t(parent, block_ids[i], access_t::read);
+            buf_read_t *read = new buf_read_t(lock);
+            internal_nodes_.add_buf(lock, read);
+            uint32_t unused_block_size;
+            const block_id_t *sub_ids
+                = blob::internal_node_block_ids(read->get_data_read(&unused_block_size));
+            add_leaves(buf_parent_t(lock), levels - 1, suboffset, subsize, sub_ids);
+        } else {
+            leaf_t leaf;
+            leaf.parent = parent;
+            leaf.block_id = block_ids[i];
+            leaf.offset = suboffset;
+            leaf.size = subsize;
+            leaves_.push_back(leaf);
+        }
+    }
+}
+
+bool blob_read_stream_t::acquire_next_leaf() {
+    leaf_read_.reset();
+    leaf_lock_.reset();
+    if (next_leaf_ == leaves_.size()) {
+        return false;
+    }
+
+    const leaf_t &leaf = leaves_[next_leaf_];
+    ++next_leaf_;
+    leaf_lock_.init(new buf_lock_t(leaf.parent, leaf.block_id, access_t::read));
+    leaf_read_.init(new buf_read_t(leaf_lock_.get()));
+    uint32_t unused_block_size;
+    pos_ = blob::leaf_node_data(leaf_read_->get_data_read(&unused_block_size))
+        + leaf.offset;
+    end_ = pos_ + leaf.size;
+    return true;
+}
+
+int64_t blob_read_stream_t::read(void *p, int64_t n) {
+    char *out = static_cast<char *>(p);
+    int64_t num_read = 0;
+    while (num_read < n) {
+        if (pos_ == end_ && !acquire_next_leaf()) {
+            break;
+        }
+        const int64_t num_copied = std::min<int64_t>(n - num_read, end_ - pos_);
+        memcpy(out + num_read, pos_, num_copied);
+        pos_ += num_copied;
+        num_read += num_copied;
+    }
+    return num_read;
+}
+
 namespace blob {
 
 struct region_tree_filler_t {
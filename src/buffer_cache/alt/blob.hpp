@@ -9,9 +9,12 @@
 #include <vector>
 #include <utility>
 
+#include "buffer_cache/alt/alt.hpp"
 #include "buffer_cache/types.hpp"
 #include "concurrency/access.hpp"
+#include "containers/archive/archive.hpp"
 #include "containers/buffer_group.hpp"
+#include "containers/scoped.hpp"
 #include "errors.hpp"
 #include "serializer/types.hpp"
 
@@ -142,6 +145,9 @@ const char *leaf_node_data(const void *buf);
 // Returns the internal offset of the ref value, which is especially useful when it's not inlined.
 int64_t ref_value_offset(const char *ref, int maxreflen);
 
+// Returns true if the block with this data is one of a blob's internal or leaf nodes.
+bool is_blob_block(const void *cache_data);
+
 }  // namespace blob
 
 class blob_t {
@@ -235,5 +241,46 @@ private:
     DISABLE_COPYING(blob_t);
 };
 
+// Reads a blob's value in order, acquiring its leaf blocks one at a time as the
+// reader gets to them, rather than all at once like expose_all() does.  That way
+// deserializing a multi-megabyte value can get going once its first block is
+// loaded, and the value's blocks don't all have to sit in the cache until the last
+// one is done.  The stream holds the blob's internal nodes (and the current leaf)
+// for its lifetime, so it must not outlive the blob's parent.
+class blob_read_stream_t : public read_stream_t {
+public:
+    blob_read_stream_t(buf_parent_t parent, const char *ref, int maxreflen);
+    virtual ~blob_read_stream_t();
+
+    virtual MUST_USE int64_t read(void *p, int64_t n);
+
+private:
+    struct leaf_t {
+        buf_parent_t parent;
+        block_id_t block_id;
+        int64_t offset;
+        int64_t size;
+    };
+
+    void add_leaves(buf_parent_t parent, int levels, int64_t offset, int64_t size,
+                    const block_id_t *block_ids);
+    // Lets go of the current leaf and acquires the next one.  Returns false at the
+    // end of the value.
+    bool acquire_next_leaf();
+
+    // The internal nodes, which the leaves' buf_parent_t's point into.
+    blob_acq_t internal_nodes_;
+    std::vector<leaf_t> leaves_;
+    size_t next_leaf_;
+
+    scoped_ptr_t<buf_lock_t> leaf_lock_;
+    scoped_ptr_t<buf_read_t> leaf_read_;
+    // The part of the current leaf (or small blob's ref) that hasn't been read yet.
+    const char *pos_;
+    const char *end_;
+
+    DISABLE_COPYING(blob_read_stream_t);
+};
+
 
 #endif  // BUFFER_CACHE_ALT_BLOB_HPP_
@@ -0,0 +1,194 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "buffer_cache/alt/cache_balancer.hpp"
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <functional>
+
+#include "arch/memory_stats.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "buffer_cache/alt/evicter.hpp"
+#include "concurrency/pmap.hpp"
+#include "logger.hpp"
+
+static alt_cache_balancer_t *global_cache_balancer = NULL;
+
+alt_cache_balancer_t *get_global_cache_balancer() {
+    return global_cache_balancer;
+}
+
+alt_cache_balancer_t::alt_cache_balancer_t(uint64_t total_cache_size)
+    : max_total_cache_size_(total_cache_size),
+      total_cache_size_(total_cache_size),
+      rebalance_in_progress_(false),
+      timer_(CACHE_BALANCER_INTERVAL_MS, this) {
+    guarantee(global_cache_balancer == NULL);
+    global_cache_balancer = this;
+}
+
+alt_cache_balancer_t::~alt_cache_balancer_t() {
+    assert_thread();
+    rassert(global_cache_balancer == this);
+    global_cache_balancer = NULL;
+}
+
+void alt_cache_balancer_t::add_evicter(alt::evicter_t *evicter) {
+    std::set<alt::evicter_t *> *evicters = evicters_.get();
+    auto res = evicters->insert(evicter);
+    guarantee(res.second);
+}
+
+void alt_cache_balancer_t::remove_evicter(alt::evicter_t *evicter) {
+    std::set<alt::evicter_t *> *evicters = evicters_.get();
+    size_t num_erased = evicters->erase(evicter);
+    guarantee(num_erased == 1);
+}
+
+void alt_cache_balancer_t::on_ring() {
+    assert_thread();
+    if (rebalance_in_progress_) {
+        return;
+    }
+    rebalance_in_progress_ = true;
+    coro_t::spawn_sometime(std::bind(&alt_cache_balancer_t::rebalance,
+                                     this, drainer_.lock()));
+}
+
+void alt_cache_balancer_t::rebalance(UNUSED auto_drainer_t::lock_t lock) {
+    assert_thread();
+    const int num_threads = get_num_threads();
+
+    std::vector<thread_data_t> data(num_threads);
+    pmap(num_threads, std::bind(&alt_cache_balancer_t::collect_thread_data,
+                                this, ph::_1, &data));
+
+    const uint64_t old_total = total_cache_size_;
+    total_cache_size_ = compute_total_cache_size(old_total, max_total_cache_size_,
+                                                 get_memory_state());
+    if (total_cache_size_ < old_total && old_total == max_total_cache_size_) {
+        logWRN("Memory is running short, so the cache is giving some back (it "
+               "will have %" PRIu64 " MB).", total_cache_size_ / MEGABYTE);
+    } else if (total_cache_size_ == max_total_cache_size_
+               && old_total < max_total_cache_size_) {
+        logINF("The cache is back to its full size of %" PRIu64 " MB.",
+               total_cache_size_ / MEGABYTE);
+    }
+
+    std::vector<cache_data_t> caches;
+    for (auto it = data.begin(); it != data.end(); ++it) {
+        for (auto jt = it->begin(); jt != it->end(); ++jt) {
+            caches.push_back(jt->second);
+        }
+    }
+    const std::vector<uint64_t> new_limits
+        = compute_memory_limits(total_cache_size_, caches);
+
+    std::vector<thread_limits_t> limits(num_threads);
+    size_t i = 0;
+    for (int thread = 0; thread < num_threads; ++thread) {
+        for (auto jt = data[thread].begin(); jt != data[thread].end(); ++jt) {
+            limits[thread].push_back(std::make_pair(jt->first, new_limits[i]));
+            ++i;
+        }
+    }
+    rassert(i == new_limits.size());
+
+    pmap(num_threads, std::bind(&alt_cache_balancer_t::apply_thread_limits,
+                                this, ph::_1, &limits));
+
+    rebalance_in_progress_ = false;
+}
+
+void alt_cache_balancer_t::collect_thread_data(int thread,
+                                               std::vector<thread_data_t> *data_out) {
+    on_thread_t th((threadnum_t(thread)));
+    const std::set<alt::evicter_t *> *evicters = evicters_.get();
+    for (auto it = evicters->begin(); it != evicters->end(); ++it) {
+        (*data_out)[thread].push_back(
+            std::make_pair(*it, cache_data_t((*it)->get_in_memory_size(),
+                                             (*it)->take_bytes_loaded())));
+    }
+}
+
+void alt_cache_balancer_t::apply_thread_limits(
+        int thread, const std::vector<thread_limits_t> *limits) {
+    on_thread_t th((threadnum_t(thread)));
+    const std::set<alt::evicter_t *> *evicters = evicters_.get();
+    const thread_limits_t &thread_limits = (*limits)[thread];
+    for (auto it = thread_limits.begin(); it != thread_limits.end(); ++it) {
+        // The evicter might have gone away while we weren't on its thread.
+        if (evicters->count(it->first) == 1) {
+            it->first->set_memory_limit(it->second);
+        }
+    }
+}
+
+std::vector<uint64_t> alt_cache_balancer_t::compute_memory_limits(
+        uint64_t total_cache_size, const std::vector<cache_data_t> &caches) {
+    const uint64_t num_caches = caches.size();
+    if (num_caches == 0) {
+        return std::vector<uint64_t>();
+    }
+    if (total_cache_size / num_caches <= CACHE_BALANCER_MIN_CACHE_SIZE) {
+        return std::vector<uint64_t>(num_caches, total_cache_size / num_caches);
+    }
+
+    uint64_t total_in_memory_size = 0;
+    uint64_t total_bytes_loaded = 0;
+    for (auto it = caches.begin(); it != caches.end(); ++it) {
+        total_in_memory_size += it->in_memory_size;
+        total_bytes_loaded += it->bytes_loaded;
+    }
+
+    const uint64_t spare = total_cache_size - num_caches * CACHE_BALANCER_MIN_CACHE_SIZE;
+    std::vector<uint64_t> limits;
+    limits.reserve(num_caches);
+    for (auto it = caches.begin(); it != caches.end(); ++it) {
+        double share = total_in_memory_size == 0
+            ? 1.0 / num_caches
+            : static_cast<double>(it->in_memory_size) / total_in_memory_size;
+        if (total_bytes_loaded != 0) {
+            share = 0.5 * share
+                + 0.5 * static_cast<double>(it->bytes_loaded) / total_bytes_loaded;
+        }
+        limits.push_back(CACHE_BALANCER_MIN_CACHE_SIZE
+                         + static_cast<uint64_t>(spare * share));
+    }
+    return limits;
+}
+
+alt_cache_balancer_t::memory_state_t alt_cache_balancer_t::get_memory_state() {
+    const uint64_t limit = get_memory_limit();
+    uint64_t usage;
+    const bool has_usage = get_memory_usage(&usage);
+    double pressure;
+    if ((has_usage && usage > limit * CACHE_BALANCER_HIGH_MEMORY_USAGE)
+        || (get_memory_pressure(&pressure)
+            && pressure > CACHE_BALANCER_MAX_MEMORY_PRESSURE)) {
+        return memory_state_t::SHORT;
+    }
+    if (has_usage && usage > limit * CACHE_BALANCER_LOW_MEMORY_USAGE) {
+        return memory_state_t::TIGHT;
+    }
+    return memory_state_t::PLENTY;
+}
+
+uint64_t alt_cache_balancer_t::compute_total_cache_size(
+        uint64_t current_total, uint64_t max_total, memory_state_t memory_state) {
+    switch (memory_state) {
+    case memory_state_t::SHORT: {
+        const uint64_t min_total
+            = std::min<uint64_t>(max_total, CACHE_BALANCER_MIN_TOTAL_CACHE_SIZE);
+        return std::max<uint64_t>(
+            min_total, current_total * (1 - CACHE_BALANCER_SHRINK_RATIO));
+    }
+    case memory_state_t::TIGHT:
+        return std::min(current_total, max_total);
+    case memory_state_t::PLENTY:
+        return std::min<uint64_t>(
+            max_total, current_total + max_total * CACHE_BALANCER_GROW_RATIO + 1);
+    default:
+        unreachable();
+    }
+}
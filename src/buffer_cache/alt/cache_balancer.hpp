@@ -0,0 +1,100 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_ALT_CACHE_BALANCER_HPP_
+#define BUFFER_CACHE_ALT_CACHE_BALANCER_HPP_
+
+#include <stdint.h>
+
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "arch/timing.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/one_per_thread.hpp"
+
+namespace alt {
+class evicter_t;
+}  // namespace alt
+
+/* The cache balancer periodically redistributes a fixed amount of memory among the
+page caches registered with it, instead of each table keeping the memory limit it was
+created with.  Every CACHE_BALANCER_INTERVAL_MS it looks at how much memory each
+cache uses and how many bytes it had to read from disk since the last time, and gives
+each cache a share of the total that is half proportional to its use and half
+proportional to its misses.  So memory flows from tables that no longer read anything
+to the ones that do, and the sum of the limits never exceeds the total.
+
+The total itself shrinks while the process (or its container's cgroup) is short of
+memory, and grows back to the size it was given once it isn't, so that the caches
+give memory back before the kernel has to kill something.
+
+There is at most one cache balancer per process (see get_global_cache_balancer()),
+and it has to outlive all the caches registered with it.  Evicters register and
+unregister themselves on their own threads. */
+class alt_cache_balancer_t : public home_thread_mixin_t,
+                             private repeating_timer_callback_t {
+public:
+    explicit alt_cache_balancer_t(uint64_t total_cache_size);
+    ~alt_cache_balancer_t();
+
+    // These must be called on the evicter's home thread.
+    void add_evicter(alt::evicter_t *evicter);
+    void remove_evicter(alt::evicter_t *evicter);
+
+    struct cache_data_t {
+        cache_data_t() : in_memory_size(0), bytes_loaded(0) { }
+        cache_data_t(uint64_t _in_memory_size, uint64_t _bytes_loaded)
+            : in_memory_size(_in_memory_size), bytes_loaded(_bytes_loaded) { }
+        uint64_t in_memory_size;
+        // The bytes the cache read from disk since the last rebalancing.
+        uint64_t bytes_loaded;
+    };
+
+    // Returns the new memory limit of each cache.  (Public for the unit tests.)
+    static std::vector<uint64_t> compute_memory_limits(
+            uint64_t total_cache_size, const std::vector<cache_data_t> &caches);
+
+    // SHORT: memory is nearly all used, or tasks are stalling for it.  TIGHT: it's
+    // not short, but not plentiful enough to take more of it either.
+    enum class memory_state_t { SHORT, TIGHT, PLENTY };
+
+    // Returns the caches' new total, given the current total and the most it can
+    // be.  (Public for the unit tests.)
+    static uint64_t compute_total_cache_size(
+            uint64_t current_total, uint64_t max_total, memory_state_t memory_state);
+
+private:
+    typedef std::vector<std::pair<alt::evicter_t *, cache_data_t> > thread_data_t;
+    typedef std::vector<std::pair<alt::evicter_t *, uint64_t> > thread_limits_t;
+
+    void on_ring();
+    void rebalance(auto_drainer_t::lock_t lock);
+    void collect_thread_data(int thread, std::vector<thread_data_t> *data_out);
+    void apply_thread_limits(int thread, const std::vector<thread_limits_t> *limits);
+
+    static memory_state_t get_memory_state();
+
+    // The most memory the caches get in all, and what they get now.
+    const uint64_t max_total_cache_size_;
+    uint64_t total_cache_size_;
+
+    // The evicters registered on each thread.  Each set is only touched on its own
+    // thread.
+    one_per_thread_t<std::set<alt::evicter_t *> > evicters_;
+
+    bool rebalance_in_progress_;
+
+    auto_drainer_t drainer_;
+
+    // Destroyed before drainer_, so that it can't start a rebalancing while we're
+    // draining.
+    repeating_timer_t timer_;
+
+    DISABLE_COPYING(alt_cache_balancer_t);
+};
+
+// Returns the process's cache balancer, or NULL if the server was started without a
+// total cache size.
+alt_cache_balancer_t *get_global_cache_balancer();
+
+#endif  // BUFFER_CACHE_ALT_CACHE_BALANCER_HPP_
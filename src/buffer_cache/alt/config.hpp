@@ -2,24 +2,44 @@
 #ifndef BUFFER_CACHE_ALT_CONFIG_HPP_
 #define BUFFER_CACHE_ALT_CONFIG_HPP_
 
+#include "containers/archive/archive.hpp"
 #include "rpc/serialize_macros.hpp"
 
 // KSI: Maybe this config struct can just go away completely.  For now we have it to
 // conform to some aspects of the interface of the mirrored cache, putting off until
 // later whether certain configuration options may be removed.
 
+// sampled_lru evicts whatever page of a random sample was accessed least recently.
+// scan_resistant (a sampled approximation of 2Q/SLRU) keeps pages that have been
+// accessed more than once in a separate protected segment, so that pages touched
+// only once, such as by a table scan, are evicted first.
+enum class eviction_policy_t { sampled_lru, scan_resistant };
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(eviction_policy_t, int8_t,
+                                      eviction_policy_t::sampled_lru,
+                                      eviction_policy_t::scan_resistant);
+
+class alt_cache_balancer_t;
+
 class page_cache_config_t {
 public:
     page_cache_config_t()
         : io_priority_reads(CACHE_READS_IO_PRIORITY),
           io_priority_writes(CACHE_WRITES_IO_PRIORITY),
-          memory_limit(GIGABYTE) { }
+          memory_limit(GIGABYTE),
+          eviction_policy(eviction_policy_t::scan_resistant),
+          balancer(NULL) { }
 
     int32_t io_priority_reads;
     int32_t io_priority_writes;
+    // With a balancer, this is only the limit until the first rebalancing.
     uint64_t memory_limit;
+    eviction_policy_t eviction_policy;
+    // If non-NULL, the balancer takes charge of memory_limit.  This is local to the
+    // process, so it's not serialized.
+    alt_cache_balancer_t *balancer;
 
-    RDB_MAKE_ME_SERIALIZABLE_3(io_priority_reads, io_priority_writes, memory_limit);
+    RDB_MAKE_ME_SERIALIZABLE_4(io_priority_reads, io_priority_writes, memory_limit,
+                               eviction_policy);
 };
 
 class alt_cache_config_t {
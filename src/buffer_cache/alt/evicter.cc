@@ -1,15 +1,47 @@
 #include "buffer_cache/alt/evicter.hpp"
 
+#include "buffer_cache/alt/cache_balancer.hpp"
 #include "buffer_cache/alt/page.hpp"
+#include "buffer_cache/alt/stats.hpp"
 
 namespace alt {
 
-evicter_t::evicter_t(memory_tracker_t *tracker, uint64_t memory_limit)
-    : tracker_(tracker), memory_limit_(memory_limit),
-      access_time_counter_(INITIAL_ACCESS_TIME) { }
+// The share of the memory limit that pages accessed more than once may take up
+// before the least recently used of them are demoted to evictable_disk_backed_.
+// The rest is what a scan gets to churn through.
+static const double FREQUENT_PAGES_MEMORY_SHARE = 0.75;
+
+evicter_t::evicter_t(memory_tracker_t *tracker, uint64_t memory_limit,
+                     eviction_policy_t policy, alt_cache_balancer_t *balancer,
+                     alt_cache_stats_t *stats)
+    : tracker_(tracker), memory_limit_(memory_limit), policy_(policy),
+      balancer_(balancer), stats_(stats), bytes_loaded_(0),
+      access_time_counter_(INITIAL_ACCESS_TIME),
+      memory_(memory_category_t::page_cache) {
+    if (balancer_ != NULL) {
+        balancer_->add_evicter(this);
+    }
+}
 
 evicter_t::~evicter_t() {
     assert_thread();
+    if (balancer_ != NULL) {
+        balancer_->remove_evicter(this);
+    }
+}
+
+void evicter_t::set_memory_limit(uint64_t memory_limit) {
+    assert_thread();
+    memory_limit_ = memory_limit;
+    inform_tracker();
+    evict_if_necessary();
+}
+
+uint64_t evicter_t::take_bytes_loaded() {
+    assert_thread();
+    const uint64_t ret = bytes_loaded_;
+    bytes_loaded_ = 0;
+    return ret;
 }
 
 
@@ -51,6 +83,7 @@ void evicter_t::move_unevictable_to_evictable(page_t *page) {
     unevictable_.remove(page, page->ser_buf_size_);
     eviction_bag_t *new_bag = correct_eviction_category(page);
     rassert(new_bag == &evictable_disk_backed_
+            || new_bag == &evictable_frequent_
             || new_bag == &evictable_unbacked_);
     new_bag->add(page, page->ser_buf_size_);
     inform_tracker();
@@ -75,7 +108,10 @@ eviction_bag_t *evicter_t::correct_eviction_category(page_t *page) {
     } else if (!page->buf_.has()) {
         return &evicted_;
     } else if (page->block_token_.has()) {
-        return &evictable_disk_backed_;
+        return policy_ == eviction_policy_t::scan_resistant
+            && page->frequently_accessed_
+            ? &evictable_frequent_
+            : &evictable_disk_backed_;
     } else {
         return &evictable_unbacked_;
     }
@@ -91,10 +127,32 @@ void evicter_t::remove_page(page_t *page) {
     evict_if_necessary();
 }
 
+void evicter_t::note_access(page_t *page, cache_access_pattern_t pattern) {
+    assert_thread();
+    // The page has a waiter, so it's in unevictable_ and changing
+    // frequently_accessed_ doesn't put it in the wrong bag.
+    rassert(unevictable_.has_page(page));
+    if (pattern == cache_access_pattern_t::one_shot
+        && policy_ == eviction_policy_t::scan_resistant) {
+        // The page keeps its place in line, so that a scan neither protects nor
+        // refreshes the pages it passes over.
+        return;
+    }
+    page->access_time_ = next_access_time();
+    // An evicted page_t stays around as long as its current_page_t does, so this
+    // also catches pages that get reloaded soon after having been evicted, like a
+    // 2Q ghost entry would.
+    if (page->accessed_before_) {
+        page->frequently_accessed_ = true;
+    }
+    page->accessed_before_ = true;
+}
+
 uint64_t evicter_t::in_memory_size() const {
     assert_thread();
     return unevictable_.size()
         + evictable_disk_backed_.size()
+        + evictable_frequent_.size()
         + evictable_unbacked_.size();
 }
 
@@ -110,14 +168,38 @@ void evicter_t::evict_if_necessary() {
     // currently being written for the purpose of eviction.
 
     page_t *page;
+    if (in_memory_size() > memory_limit_) {
+        // Frequently accessed pages that no longer fit in their share go back to
+        // evictable_disk_backed_, where they have to earn their way back in.
+        const uint64_t frequent_limit = memory_limit_ * FREQUENT_PAGES_MEMORY_SHARE;
+        size_t pages_examined = 0;
+        while (evictable_frequent_.size() > frequent_limit
+               && evictable_frequent_.remove_oldish(&page, access_time_counter_,
+                                                    &pages_examined)) {
+            page->frequently_accessed_ = false;
+            evictable_disk_backed_.add(page, page->ser_buf_size_);
+        }
+    }
+
+    size_t scan_length = 0;
     while (in_memory_size() > memory_limit_
-           && evictable_disk_backed_.remove_oldish(&page, access_time_counter_)) {
+           && (evictable_disk_backed_.remove_oldish(&page, access_time_counter_,
+                                                    &scan_length)
+               || evictable_frequent_.remove_oldish(&page, access_time_counter_,
+                                                    &scan_length))) {
+        if (stats_ != NULL) {
+            stats_->record_eviction(access_time_counter_ - page->access_time_,
+                                    scan_length);
+        }
+        scan_length = 0;
         evicted_.add(page, page->ser_buf_size_);
         page->evict_self();
     }
+    memory_.set(in_memory_size());
 }
 
-void evicter_t::inform_tracker() const {
+void evicter_t::inform_tracker() {
+    memory_.set(in_memory_size());
     tracker_->inform_memory_change(in_memory_size(),
                                    memory_limit_);
 }
@@ -3,7 +3,10 @@
 
 #include <stdint.h>
 
+#include "buffer_cache/alt/config.hpp"
 #include "buffer_cache/alt/eviction_bag.hpp"
+#include "buffer_cache/types.hpp"
+#include "perfmon/memory.hpp"
 #include "utils.hpp"
 
 class memory_tracker_t {
@@ -13,6 +16,9 @@ public:
                                       uint64_t memory_limit) = 0;
 };
 
+class alt_cache_balancer_t;
+class alt_cache_stats_t;
+
 namespace alt {
 
 class evicter_t : public home_thread_mixin_debug_only_t {
@@ -27,15 +33,32 @@ public:
     eviction_bag_t *correct_eviction_category(page_t *page);
     void remove_page(page_t *page);
 
-    explicit evicter_t(memory_tracker_t *tracker,
-                       uint64_t memory_limit);
+    // Called the first time each page_acq_t gets at the page's buffer.
+    void note_access(page_t *page, cache_access_pattern_t pattern);
+
+    // balancer and stats may be NULL.
+    evicter_t(memory_tracker_t *tracker,
+              uint64_t memory_limit,
+              eviction_policy_t policy,
+              alt_cache_balancer_t *balancer,
+              alt_cache_stats_t *stats);
     ~evicter_t();
 
+    // For the cache balancer.
+    void set_memory_limit(uint64_t memory_limit);
+    uint64_t get_memory_limit() const { return memory_limit_; }
+    uint64_t get_in_memory_size() const { return in_memory_size(); }
+    // Returns the bytes read from disk since the last call.
+    uint64_t take_bytes_loaded();
+    // Called when a page's buffer has been read from disk.
+    void note_bytes_loaded(uint32_t ser_buf_size) { bytes_loaded_ += ser_buf_size; }
+
     bool interested_in_read_ahead_block(uint32_t ser_block_size) const;
 
     uint64_t next_access_time() {
         return ++access_time_counter_;
     }
+    uint64_t current_access_time() const { return access_time_counter_; }
 
     static const uint64_t INITIAL_ACCESS_TIME = UINT64_MAX - 100;
 
@@ -43,21 +66,34 @@ private:
     void evict_if_necessary();
     uint64_t in_memory_size() const;
 
-    void inform_tracker() const;
+    // Also updates `memory_`.
+    void inform_tracker();
 
     // LSI: Implement issue 97.
     memory_tracker_t *const tracker_;
     uint64_t memory_limit_;
+    const eviction_policy_t policy_;
+    alt_cache_balancer_t *const balancer_;
+    alt_cache_stats_t *const stats_;
+
+    uint64_t bytes_loaded_;
 
     // This gets incremented every time a page is accessed.
     uint64_t access_time_counter_;
 
     // These track whether every page's eviction status.
     eviction_bag_t unevictable_;
+    // With the scan_resistant policy, this holds only the disk-backed pages that
+    // have not been accessed more than once (since they were last demoted), and
+    // the ones that have are in evictable_frequent_.
     eviction_bag_t evictable_disk_backed_;
+    eviction_bag_t evictable_frequent_;
     eviction_bag_t evictable_unbacked_;
     eviction_bag_t evicted_;
 
+    // The node's memory accounting's share of in_memory_size().
+    memory_accounted_t memory_;
+
     DISABLE_COPYING(evicter_t);
 };
 
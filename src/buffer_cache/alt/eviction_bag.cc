@@ -2,7 +2,10 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 #include "buffer_cache/alt/page.hpp"
+#include "config/args.hpp"
 #include "utils.hpp"
 
 namespace alt {
@@ -40,14 +43,45 @@ bool eviction_bag_t::has_page(page_t *page) const {
     return bag_.has_element(page);
 }
 
-bool eviction_bag_t::remove_oldish(page_t **page_out, uint64_t access_time_offset) {
+bool eviction_bag_t::remove_oldish(page_t **page_out, uint64_t access_time_offset,
+                                   size_t *pages_examined) {
     if (bag_.size() == 0) {
         return false;
     } else {
-        const size_t num_randoms = 5;
-        page_t *oldest = bag_.access_random(randsize(bag_.size()));
-        for (size_t i = 1; i < num_randoms; ++i) {
-            page_t *page = bag_.access_random(randsize(bag_.size()));
+        const size_t bag_size = bag_.size();
+        const size_t num_randoms = std::min<size_t>(EVICTION_SAMPLE_SIZE, bag_size);
+        *pages_examined += num_randoms;
+
+        // We sample without replacement, with the first num_randoms steps of a
+        // Fisher-Yates shuffle of the bag's indices.  Instead of an array of every
+        // index, we only remember the slots that earlier steps swapped into: step i
+        // moves whatever is at slot i to the slot j it drew, and never looks at
+        // slots below i again.
+        size_t swapped_slots[EVICTION_SAMPLE_SIZE];
+        size_t swapped_indices[EVICTION_SAMPLE_SIZE];
+        size_t num_swapped = 0;
+        page_t *oldest = NULL;
+        for (size_t i = 0; i < num_randoms; ++i) {
+            const size_t j = i + randsize(bag_size - i);
+            size_t index_at_i = i;
+            size_t index_at_j = j;
+            for (size_t k = 0; k < num_swapped; ++k) {
+                if (swapped_slots[k] == i) {
+                    index_at_i = swapped_indices[k];
+                }
+                if (swapped_slots[k] == j) {
+                    index_at_j = swapped_indices[k];
+                }
+            }
+            swapped_slots[num_swapped] = j;
+            swapped_indices[num_swapped] = index_at_i;
+            ++num_swapped;
+
+            page_t *page = bag_.access_random(index_at_j);
+            if (oldest == NULL) {
+                oldest = page;
+                continue;
+            }
             // We compare relative to the access time offset, so that in the unlikely
             // event of a 64-bit overflow, performance degradation is "smooth".
             if (access_time_offset - page->access_time_ >
@@ -33,7 +33,11 @@ public:
 
     uint64_t size() const { return size_; }
 
-    bool remove_oldish(page_t **page_out, uint64_t access_time_offset);
+    // Removes the least recently accessed page of a small random sample, so that it
+    // takes constant time however many pages the bag holds.  Returns false if the
+    // bag is empty.  Adds the number of pages it looked at to *pages_examined.
+    bool remove_oldish(page_t **page_out, uint64_t access_time_offset,
+                       size_t *pages_examined);
 
 private:
     backindex_bag_t<page_t *> bag_;
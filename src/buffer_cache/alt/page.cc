@@ -17,6 +17,8 @@ page_t::page_t(block_id_t block_id, page_cache_t *page_cache)
     : destroy_ptr_(NULL),
       ser_buf_size_(0),
       access_time_(page_cache->evicter().next_access_time()),
+      accessed_before_(false),
+      frequently_accessed_(false),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
     coro_t::spawn_now_dangerously(std::bind(&page_t::load_with_block_id,
@@ -25,18 +27,20 @@ page_t::page_t(block_id_t block_id, page_cache_t *page_cache)
                                             page_cache));
 }
 
-page_t::page_t(block_size_t block_size, scoped_malloc_t<ser_buffer_t> buf,
+page_t::page_t(block_size_t block_size, scoped_arena_ptr_t<ser_buffer_t> buf,
                page_cache_t *page_cache)
     : destroy_ptr_(NULL),
       ser_buf_size_(block_size.ser_value()),
       buf_(std::move(buf)),
       access_time_(page_cache->evicter().next_access_time()),
+      accessed_before_(false),
+      frequently_accessed_(false),
       snapshot_refcount_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_unbacked(this);
 }
 
-page_t::page_t(scoped_malloc_t<ser_buffer_t> buf,
+page_t::page_t(scoped_arena_ptr_t<ser_buffer_t> buf,
                const counted_t<standard_block_token_t> &block_token,
                page_cache_t *page_cache)
     : destroy_ptr_(NULL),
@@ -44,6 +48,8 @@ page_t::page_t(scoped_malloc_t<ser_buffer_t> buf,
       buf_(std::move(buf)),
       block_token_(block_token),
       access_time_(READ_AHEAD_ACCESS_TIME),
+      accessed_before_(false),
+      frequently_accessed_(false),
       snapshot_refcount_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_disk_backed(this);
@@ -53,6 +59,8 @@ page_t::page_t(page_t *copyee, page_cache_t *page_cache)
     : destroy_ptr_(NULL),
       ser_buf_size_(0),
       access_time_(page_cache->evicter().next_access_time()),
+      accessed_before_(copyee->accessed_before_),
+      frequently_accessed_(copyee->frequently_accessed_),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
     coro_t::spawn_now_dangerously(std::bind(&page_t::load_from_copyee,
@@ -78,6 +86,36 @@ void page_t::load_from_copyee(page_t *page, page_t *copyee,
     auto_drainer_t::lock_t lock(page_cache->drainer_.get());
     page_ptr_t copyee_ptr(copyee, page_cache);
 
+    if (!copyee->buf_.has() && copyee->destroy_ptr_ == NULL
+        && copyee->block_token_.has()) {
+        // The copyee has been evicted.  We read the block into our own buffer
+        // instead of loading the copyee just to copy it; the snapshotters that still
+        // hold the copyee can load it again if they ever get to it.
+        counted_t<standard_block_token_t> block_token = copyee->block_token_;
+        scoped_arena_ptr_t<ser_buffer_t> buf;
+        {
+            serializer_t *const serializer = page_cache->serializer_;
+            buf = serializer->malloc();
+            on_thread_t th(serializer->home_thread());
+            serializer->block_read(block_token,
+                                   buf.get(),
+                                   page_cache->current_reads_io_account());
+        }
+
+        ASSERT_FINITE_CORO_WAITING;
+        if (!page_destroyed) {
+            page->ser_buf_size_ = block_token->block_size().ser_value();
+            page->buf_ = std::move(buf);
+            page->destroy_ptr_ = NULL;
+
+            page_cache->evicter().note_bytes_loaded(page->ser_buf_size_);
+            page_cache->evicter().add_now_loaded_size(page->ser_buf_size_);
+
+            page->pulse_waiters_or_make_evictable(page_cache);
+        }
+        return;
+    }
+
     // Okay, it's safe to block.
     {
         page_acq_t acq;
@@ -86,16 +124,20 @@ void page_t::load_from_copyee(page_t *page, page_t *copyee,
 
         ASSERT_FINITE_CORO_WAITING;
         if (!page_destroyed) {
-            // RSP: If somehow there are no snapshotters of copyee now (besides
-            // ourself), maybe we could avoid copying this memory.  We need to
-            // carefully track snapshotters anyway, once we're comfortable with that,
-            // we could do it.
-
             uint32_t ser_buf_size = copyee->ser_buf_size_;
             rassert(copyee->buf_.has());
-            scoped_malloc_t<ser_buffer_t> buf = page_cache->serializer_->malloc();
-
-            memcpy(buf.get(), copyee->buf_.get(), ser_buf_size);
+            scoped_arena_ptr_t<ser_buffer_t> buf;
+            if (copyee->num_snapshot_references() == 1) {
+                // The snapshotters let go of the copyee while it was being loaded.
+                // Nobody else can get at its buffer now, and the copyee is destroyed
+                // along with copyee_ptr, so we take the buffer instead of copying
+                // it.  The evicter stops counting the copyee's size once acq lets
+                // go of it and it turns out to have no buffer.
+                buf = std::move(copyee->buf_);
+            } else {
+                buf = page_cache->serializer_->malloc();
+                memcpy(buf.get(), copyee->buf_.get(), ser_buf_size);
+            }
 
             page->ser_buf_size_ = ser_buf_size;
             page->buf_ = std::move(buf);
@@ -119,7 +161,7 @@ void page_t::load_with_block_id(page_t *page, block_id_t block_id,
 
     auto_drainer_t::lock_t lock(page_cache->drainer_.get());
 
-    scoped_malloc_t<ser_buffer_t> buf;
+    scoped_arena_ptr_t<ser_buffer_t> buf;
     counted_t<standard_block_token_t> block_token;
     {
         serializer_t *const serializer = page_cache->serializer_;
@@ -131,7 +173,7 @@ void page_t::load_with_block_id(page_t *page, block_id_t block_id,
         rassert(block_token.has());
         serializer->block_read(block_token,
                                buf.get(),
-                               page_cache->reads_io_account_.get());
+                               page_cache->current_reads_io_account());
     }
 
     ASSERT_FINITE_CORO_WAITING;
@@ -146,6 +188,7 @@ void page_t::load_with_block_id(page_t *page, block_id_t block_id,
     page->buf_ = std::move(buf);
     page->block_token_ = std::move(block_token);
     page->destroy_ptr_ = NULL;
+    page_cache->evicter().note_bytes_loaded(page->ser_buf_size_);
     page_cache->evicter().add_now_loaded_size(page->ser_buf_size_);
 
     page->pulse_waiters_or_make_evictable(page_cache);
@@ -224,7 +267,7 @@ void page_t::load_using_block_token(page_t *page, page_cache_t *page_cache) {
     counted_t<standard_block_token_t> block_token = page->block_token_;
     rassert(block_token.has());
 
-    scoped_malloc_t<ser_buffer_t> buf;
+    scoped_arena_ptr_t<ser_buffer_t> buf;
     {
         serializer_t *const serializer = page_cache->serializer_;
         buf = serializer->malloc();  // Call malloc() on our home thread because
@@ -233,7 +276,7 @@ void page_t::load_using_block_token(page_t *page, page_cache_t *page_cache) {
         on_thread_t th(serializer->home_thread());
         serializer->block_read(block_token,
                                buf.get(),
-                               page_cache->reads_io_account_.get());
+                               page_cache->current_reads_io_account());
     }
 
     ASSERT_FINITE_CORO_WAITING;
@@ -247,6 +290,7 @@ void page_t::load_using_block_token(page_t *page, page_cache_t *page_cache) {
     block_token.reset();
     page->buf_ = std::move(buf);
     page->destroy_ptr_ = NULL;
+    page_cache->evicter().note_bytes_loaded(page->ser_buf_size_);
 
     page->pulse_waiters_or_make_evictable(page_cache);
 }
@@ -257,12 +301,15 @@ uint32_t page_t::get_page_buf_size() {
     return block_size_t::unsafe_make(ser_buf_size_).value();
 }
 
-void *page_t::get_page_buf(page_cache_t *page_cache) {
+void *page_t::get_page_buf() {
     rassert(buf_.has());
-    access_time_ = page_cache->evicter().next_access_time();
     return buf_->cache_data;
 }
 
+void page_t::note_access(page_cache_t *page_cache, cache_access_pattern_t pattern) {
+    page_cache->evicter().note_access(this, pattern);
+}
+
 void page_t::reset_block_token() {
     // The page is supposed to have its buffer acquired in reset_block_token -- it's
     // the thing modifying the page.  We thus assume that the page is unevictable and
@@ -291,7 +338,7 @@ void page_t::evict_self() {
 }
 
 
-page_acq_t::page_acq_t() : page_(NULL), page_cache_(NULL) {
+page_acq_t::page_acq_t() : page_(NULL), page_cache_(NULL), accessed_(false) {
 }
 
 void page_acq_t::init(page_t *page, page_cache_t *page_cache) {
@@ -325,13 +372,22 @@ uint32_t page_acq_t::get_buf_size() {
 
 void *page_acq_t::get_buf_write() {
     buf_ready_signal_.wait();
+    note_access(cache_access_pattern_t::normal);
     page_->reset_block_token();
-    return page_->get_page_buf(page_cache_);
+    return page_->get_page_buf();
 }
 
-const void *page_acq_t::get_buf_read() {
+const void *page_acq_t::get_buf_read(cache_access_pattern_t pattern) {
     buf_ready_signal_.wait();
-    return page_->get_page_buf(page_cache_);
+    note_access(pattern);
+    return page_->get_page_buf();
+}
+
+void page_acq_t::note_access(cache_access_pattern_t pattern) {
+    if (!accessed_) {
+        accessed_ = true;
+        page_->note_access(page_cache_, pattern);
+    }
 }
 
 page_ptr_t::page_ptr_t() : page_(NULL), page_cache_(NULL) {
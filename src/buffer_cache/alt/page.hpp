@@ -1,6 +1,7 @@
 #ifndef BUFFER_CACHE_ALT_PAGE_HPP_
 #define BUFFER_CACHE_ALT_PAGE_HPP_
 
+#include "buffer_cache/types.hpp"
 #include "concurrency/cond_var.hpp"
 #include "containers/backindex_bag.hpp"
 #include "serializer/types.hpp"
@@ -15,9 +16,9 @@ class page_acq_t;
 // in-place, but still a definite known value).
 class page_t {
 public:
-    page_t(block_size_t block_size, scoped_malloc_t<ser_buffer_t> buf,
+    page_t(block_size_t block_size, scoped_arena_ptr_t<ser_buffer_t> buf,
            page_cache_t *page_cache);
-    page_t(scoped_malloc_t<ser_buffer_t> buf,
+    page_t(scoped_arena_ptr_t<ser_buffer_t> buf,
            const counted_t<standard_block_token_t> &token,
            page_cache_t *page_cache);
     page_t(block_id_t block_id, page_cache_t *page_cache);
@@ -32,7 +33,8 @@ public:
 private:
     friend class page_acq_t;
     // These may not be called until the page_acq_t's buf_ready_signal is pulsed.
-    void *get_page_buf(page_cache_t *page_cache);
+    void *get_page_buf();
+    void note_access(page_cache_t *page_cache, cache_access_pattern_t pattern);
     void reset_block_token();
     uint32_t get_page_buf_size();
 
@@ -66,10 +68,15 @@ private:
     // One of destroy_ptr_, buf_, or block_token_ is non-null.
     bool *destroy_ptr_;
     uint32_t ser_buf_size_;
-    scoped_malloc_t<ser_buffer_t> buf_;
+    scoped_arena_ptr_t<ser_buffer_t> buf_;
     counted_t<standard_block_token_t> block_token_;
 
     uint64_t access_time_;
+    // Used by the evicter's scan_resistant policy: whether the page has been
+    // accessed (other than one-shot) at all, and whether it has been accessed again
+    // since.  These only change while the page has waiters.
+    bool accessed_before_;
+    bool frequently_accessed_;
 
     // How many page_ptr_t's point at this page, expecting nothing to modify it,
     // other than themselves.
@@ -86,7 +93,8 @@ private:
     // if destroy_ptr_ is non-null:  unevictable_pages_
     // else if waiters_ is non-empty: unevictable_pages_
     // else if buf_ is null: evicted_pages_ (and block_token_ is non-null)
-    // else if block_token_ is non-null: evictable_disk_backed_pages_
+    // else if block_token_ is non-null: evictable_disk_backed_pages_ (or
+    //     evictable_frequent_, if frequently_accessed_ is set)
     // else: evictable_unbacked_pages_ (buf_ is non-null, block_token_ is null)
     //
     // So, when destroy_ptr_, waiters_, buf_, or block_token_ is touched, we might
@@ -155,13 +163,18 @@ public:
     // These block, uninterruptibly waiting for buf_ready_signal() to be pulsed.
     uint32_t get_buf_size();
     void *get_buf_write();
-    const void *get_buf_read();
+    const void *get_buf_read(cache_access_pattern_t pattern);
 
 private:
     friend class page_t;
 
+    void note_access(cache_access_pattern_t pattern);
+
     page_t *page_;
     page_cache_t *page_cache_;
+    // Whether this acquirer has already told the evicter about its access, so that
+    // getting at the buffer more than once doesn't make the page look hot.
+    bool accessed_;
     cond_t buf_ready_signal_;
     DISABLE_COPYING(page_acq_t);
 };
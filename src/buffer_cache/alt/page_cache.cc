@@ -5,6 +5,8 @@
 #include <stack>
 
 #include "arch/runtime/coroutines.hpp"
+#include "buffer_cache/alt/stats.hpp"
+#include "buffer_cache/alt/warm_manifest.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "do_on_thread.hpp"
 #include "serializer/serializer.hpp"
@@ -43,10 +45,10 @@ page_read_ahead_cb_t::~page_read_ahead_cb_t() { }
 
 void page_read_ahead_cb_t::offer_read_ahead_buf(
         block_id_t block_id,
-        scoped_malloc_t<ser_buffer_t> *buf_ptr,
+        scoped_arena_ptr_t<ser_buffer_t> *buf_ptr,
         const counted_t<standard_block_token_t> &token) {
     assert_thread();
-    scoped_malloc_t<ser_buffer_t> buf = std::move(*buf_ptr);
+    scoped_arena_ptr_t<ser_buffer_t> buf = std::move(*buf_ptr);
 
     if (bytes_remaining_ == 0) {
         return;
@@ -102,19 +104,148 @@ void page_cache_t::add_read_ahead_buf(block_id_t block_id,
                                       const counted_t<standard_block_token_t> &token) {
     assert_thread();
 
-    scoped_malloc_t<ser_buffer_t> buf(buf_ptr);
+    if (!add_loaded_buf(block_id, scoped_arena_ptr_t<ser_buffer_t>(buf_ptr), token)) {
+        have_read_ahead_cb_destroyed();
+    }
+}
+
+bool page_cache_t::add_loaded_buf(block_id_t block_id,
+                                  scoped_arena_ptr_t<ser_buffer_t> buf,
+                                  const counted_t<standard_block_token_t> &token) {
+    assert_thread();
 
     if (!evicter_.interested_in_read_ahead_block(token->block_size().ser_value())) {
-        have_read_ahead_cb_destroyed();
-        return;
+        return false;
     }
 
     resize_current_pages_to_id(block_id);
-    if (current_pages_[block_id] != NULL) {
+    if (current_pages_[block_id] == NULL) {
+        current_pages_[block_id] = new current_page_t(std::move(buf), token, this);
+    }
+    return true;
+}
+
+struct hot_page_t {
+    hot_page_t(uint64_t _age, block_id_t _block_id)
+        : age(_age), block_id(_block_id) { }
+    uint64_t age;
+    block_id_t block_id;
+};
+
+struct hot_page_younger_t {
+    bool operator()(const hot_page_t &x, const hot_page_t &y) const {
+        return x.age < y.age;
+    }
+};
+
+std::vector<block_id_t> page_cache_t::hot_block_ids() const {
+    assert_thread();
+
+    // Access times wrap around, so we compare ages rather than the times
+    // themselves.
+    const uint64_t now = evicter_.current_access_time();
+    std::vector<hot_page_t> pages;
+    for (block_id_t block_id = 0; block_id < current_pages_.size(); ++block_id) {
+        current_page_t *current_page = current_pages_[block_id];
+        if (current_page == NULL || current_page->is_deleted()
+            || !current_page->page_.has()) {
+            continue;
+        }
+        page_t *page = current_page->page_.get_page_for_read();
+        if (page->buf_.has()) {
+            pages.push_back(hot_page_t(now - page->access_time_, block_id));
+        }
+    }
+    std::sort(pages.begin(), pages.end(), hot_page_younger_t());
+
+    std::vector<block_id_t> ret;
+    ret.reserve(pages.size());
+    for (auto it = pages.begin(); it != pages.end(); ++it) {
+        ret.push_back(it->block_id);
+    }
+    return ret;
+}
+
+struct prefetched_page_t {
+    prefetched_page_t(int64_t _offset, page_t *_page)
+        : offset(_offset), page(_page) { }
+    int64_t offset;
+    page_t *page;
+};
+
+struct prefetched_page_offset_less_t {
+    bool operator()(const prefetched_page_t &x, const prefetched_page_t &y) const {
+        return x.offset < y.offset;
+    }
+};
+
+void page_cache_t::prefetch(const std::vector<block_id_t> &block_ids) {
+    assert_thread();
+
+    // Pages that got evicted again before their reader got to them would just be
+    // wasted reads.
+    if (block_ids.size() * max_block_size().ser_value()
+        > evicter_.get_memory_limit() / CACHE_PREFETCH_MAX_MEMORY_SHARE) {
         return;
     }
 
-    current_pages_[block_id] = new current_page_t(std::move(buf), token, this);
+    std::vector<prefetched_page_t> evicted_pages;
+    for (auto it = block_ids.begin(); it != block_ids.end(); ++it) {
+        const block_id_t block_id = *it;
+        if (recency_for_block_id(block_id) == repli_timestamp_t::invalid) {
+            // The block doesn't exist (anymore).
+            continue;
+        }
+        resize_current_pages_to_id(block_id);
+        current_page_t *current_page = current_pages_[block_id];
+        if (current_page == NULL) {
+            current_page = new current_page_t();
+            current_pages_[block_id] = current_page;
+        } else if (current_page->is_deleted()) {
+            continue;
+        }
+
+        if (!current_page->page_.has()) {
+            // The page starts loading (by block id) as soon as it's constructed.
+            current_page->page_.init(new page_t(block_id, this), this);
+        } else {
+            page_t *page = current_page->page_.get_page_for_read();
+            if (!page->buf_.has() && page->destroy_ptr_ == NULL) {
+                // Only disk-backed pages get evicted.
+                rassert(page->block_token_.has());
+                evicted_pages.push_back(prefetched_page_t(page->block_token_->offset(),
+                                                          page));
+            }
+        }
+    }
+
+    std::sort(evicted_pages.begin(), evicted_pages.end(),
+              prefetched_page_offset_less_t());
+    for (auto it = evicted_pages.begin(); it != evicted_pages.end(); ++it) {
+        coro_t::spawn_now_dangerously(std::bind(&page_cache_t::load_prefetched_page,
+                                                this, it->page, drainer_->lock()));
+    }
+}
+
+void page_cache_t::load_prefetched_page(page_cache_t *page_cache, page_t *page,
+                                        auto_drainer_t::lock_t) {
+    // This is called using spawn_now_dangerously, so page is still alive.  The
+    // page_ptr_t keeps it alive, and the page_acq_t makes it load (and stay loaded
+    // until the read is done).
+    page_ptr_t page_ptr(page, page_cache);
+    page_acq_t acq;
+    acq.init(page, page_cache);
+    // The page is in the unevictable bag now, so it's fine to touch its access
+    // time.  We don't count this as an access, or else every prefetched page would
+    // look frequently accessed once its reader gets to it.
+    page->access_time_ = page_cache->evicter().next_access_time();
+    acq.buf_ready_signal()->wait();
+}
+
+void page_cache_t::start_warm_manifest(const std::string &path) {
+    assert_thread();
+    guarantee(!warm_manifest_.has());
+    warm_manifest_.init(new warm_manifest_t(this, path));
 }
 
 void page_cache_t::have_read_ahead_cb_destroyed() {
@@ -139,11 +270,15 @@ void page_cache_t::read_ahead_cb_is_destroyed() {
 
 page_cache_t::page_cache_t(serializer_t *serializer,
                            const page_cache_config_t &config,
-                           memory_tracker_t *tracker)
+                           memory_tracker_t *tracker,
+                           alt_cache_stats_t *stats)
     : dynamic_config_(config),
+      flushes_in_flight_(0),
       serializer_(serializer),
       free_list_(serializer),
-      evicter_(tracker, config.memory_limit),
+      stats_(stats),
+      evicter_(tracker, config.memory_limit, config.eviction_policy,
+               config.balancer, stats),
       read_ahead_cb_(NULL),
       drainer_(make_scoped<auto_drainer_t>()) {
 
@@ -159,7 +294,10 @@ page_cache_t::page_cache_t(serializer_t *serializer,
                                                       config.memory_limit);
         }
         reads_io_account_.init(serializer->make_io_account(config.io_priority_reads));
+        reads_io_account_->set_latency_target(CACHE_READS_IO_LATENCY_TARGET_MS);
         writes_io_account_.init(serializer->make_io_account(config.io_priority_writes));
+        background_reads_io_account_.init(serializer->make_io_account(
+            std::max(1, config.io_priority_reads * BACKGROUND_READS_CACHE_PRIORITY / 100)));
         index_write_sink_.init(new fifo_enforcer_sink_t);
         recencies_ = serializer->get_all_recencies();
     }
@@ -168,6 +306,8 @@ page_cache_t::page_cache_t(serializer_t *serializer,
 page_cache_t::~page_cache_t() {
     assert_thread();
 
+    warm_manifest_.reset();
+
     have_read_ahead_cb_destroyed();
 
     drainer_.reset();
@@ -180,10 +320,17 @@ page_cache_t::~page_cache_t() {
         on_thread_t thread_switcher(serializer_->home_thread());
         reads_io_account_.reset();
         writes_io_account_.reset();
+        background_reads_io_account_.reset();
         index_write_sink_.reset();
     }
 }
 
+file_account_t *page_cache_t::current_reads_io_account() {
+    return coro_t::self()->get_priority() < MESSAGE_SCHEDULER_DEFAULT_PRIORITY
+        ? background_reads_io_account_.get()
+        : reads_io_account_.get();
+}
+
 // We go a bit old-school, with a self-destroying callback.
 class flush_and_destroy_txn_waiter_t : public signal_t::subscription_t {
 public:
@@ -256,6 +403,26 @@ current_page_t *page_cache_t::page_for_block_id(block_id_t block_id) {
     return current_pages_[block_id];
 }
 
+repli_timestamp_t page_cache_t::recency_for_new_read_acquirer(block_id_t block_id) {
+    assert_thread();
+    // This is what current_page_t::add_acquirer would give it.
+    if (block_id < current_pages_.size() && current_pages_[block_id] != NULL) {
+        current_page_acq_t *back = current_pages_[block_id]->acquirers_.tail();
+        if (back != NULL) {
+            return back->recency();
+        }
+    }
+    return recency_for_block_id(block_id);
+}
+
+lock_stats_t *page_cache_t::page_lock_stats(block_id_t block_id) {
+    if (stats_ == NULL) {
+        return NULL;
+    }
+    // Every write txn goes through the superblock, so it gets its own stats.
+    return block_id == SUPERBLOCK_ID ? &stats_->superblock_lock : &stats_->page_lock;
+}
+
 current_page_t *page_cache_t::page_for_new_block_id(block_id_t *block_id_out) {
     assert_thread();
     block_id_t block_id = free_list_.acquire_block_id();
@@ -276,7 +443,7 @@ current_page_t *page_cache_t::internal_page_for_new_chosen(block_id_t block_id)
     rassert(recency_for_block_id(block_id) == repli_timestamp_t::invalid,
             "expected chosen block %" PR_BLOCK_ID "to be deleted", block_id);
 
-    scoped_malloc_t<ser_buffer_t> buf = serializer_->malloc();
+    scoped_arena_ptr_t<ser_buffer_t> buf = serializer_->malloc();
 
 #if !defined(NDEBUG) || defined(VALGRIND)
     // KSI: This should actually _not_ exist -- we are ignoring legitimate errors
@@ -339,26 +506,26 @@ struct current_page_help_t {
 };
 
 current_page_acq_t::current_page_acq_t()
-    : page_cache_(NULL), the_txn_(NULL) { }
+    : page_cache_(NULL), the_txn_(NULL), queued_at_(0) { }
 
 current_page_acq_t::current_page_acq_t(page_txn_t *txn,
                                        block_id_t block_id,
                                        access_t access,
                                        page_create_t create)
-    : page_cache_(NULL), the_txn_(NULL) {
+    : page_cache_(NULL), the_txn_(NULL), queued_at_(0) {
     init(txn, block_id, access, create);
 }
 
 current_page_acq_t::current_page_acq_t(page_txn_t *txn,
                                        alt_create_t create)
-    : page_cache_(NULL), the_txn_(NULL) {
+    : page_cache_(NULL), the_txn_(NULL), queued_at_(0) {
     init(txn, create);
 }
 
 current_page_acq_t::current_page_acq_t(page_cache_t *page_cache,
                                        block_id_t block_id,
                                        read_access_t read)
-    : page_cache_(NULL), the_txn_(NULL) {
+    : page_cache_(NULL), the_txn_(NULL), queued_at_(0) {
     init(page_cache, block_id, read);
 }
 
@@ -524,14 +691,23 @@ current_page_help_t current_page_acq_t::help() const {
 
 void current_page_acq_t::pulse_read_available() {
     assert_thread();
+    note_granted(access_t::read);
     read_cond_.pulse_if_not_already_pulsed();
 }
 
 void current_page_acq_t::pulse_write_available() {
     assert_thread();
+    note_granted(access_t::write);
     write_cond_.pulse_if_not_already_pulsed();
 }
 
+void current_page_acq_t::note_granted(access_t access) {
+    if (queued_at_ != 0 && access_ == access) {
+        page_cache()->page_lock_stats(block_id_)->note_contended(queued_at_);
+        queued_at_ = 0;
+    }
+}
+
 current_page_t::current_page_t()
     : is_deleted_(false),
       last_modifier_(NULL) {
@@ -542,7 +718,7 @@ current_page_t::current_page_t()
 }
 
 current_page_t::current_page_t(block_size_t block_size,
-                               scoped_malloc_t<ser_buffer_t> buf,
+                               scoped_arena_ptr_t<ser_buffer_t> buf,
                                page_cache_t *page_cache)
     : page_(new page_t(block_size, std::move(buf), page_cache), page_cache),
       is_deleted_(false),
@@ -553,7 +729,7 @@ current_page_t::current_page_t(block_size_t block_size,
     block_version_ = block_version_.subsequent();
 }
 
-current_page_t::current_page_t(scoped_malloc_t<ser_buffer_t> buf,
+current_page_t::current_page_t(scoped_arena_ptr_t<ser_buffer_t> buf,
                                const counted_t<standard_block_token_t> &token,
                                page_cache_t *page_cache)
     : page_(new page_t(std::move(buf), token, page_cache), page_cache),
@@ -571,7 +747,7 @@ current_page_t::~current_page_t() {
 }
 
 void current_page_t::make_non_deleted(block_size_t block_size,
-                                      scoped_malloc_t<ser_buffer_t> buf,
+                                      scoped_arena_ptr_t<ser_buffer_t> buf,
                                       page_cache_t *page_cache) {
     rassert(is_deleted_);
     rassert(!page_.has());
@@ -607,6 +783,17 @@ void current_page_t::add_acquirer(current_page_acq_t *acq) {
 
     acquirers_.push_back(acq);
     pulse_pulsables(acq);
+
+    lock_stats_t *stats = acq->page_cache()->page_lock_stats(acq->block_id());
+    if (stats != NULL) {
+        const cond_t *granted = acq->access_ == access_t::read
+            ? &acq->read_cond_ : &acq->write_cond_;
+        if (granted->is_pulsed()) {
+            stats->note_uncontended();
+        } else {
+            acq->queued_at_ = get_ticks();
+        }
+    }
 }
 
 void current_page_t::remove_acquirer(current_page_acq_t *acq) {
@@ -684,7 +871,7 @@ void current_page_t::pulse_pulsables(current_page_acq_t *const acq) {
                     // page to a full-sized page.
                     // TODO: We should consider whether we really want this behavior.
 
-                    scoped_malloc_t<ser_buffer_t> buf
+                    scoped_arena_ptr_t<ser_buffer_t> buf
                         = help.page_cache->serializer()->malloc();
 
 #if !defined(NDEBUG) || defined(VALGRIND)
@@ -918,6 +1105,16 @@ void page_txn_t::announce_waiting_for_flush() {
     page_cache_->im_waiting_for_flush(std::move(txns));
 }
 
+bool page_cache_t::has_changes(const std::set<page_txn_t *> &txns) {
+    for (auto it = txns.begin(); it != txns.end(); ++it) {
+        if (!(*it)->snapshotted_dirtied_pages_.empty()
+            || !(*it)->touched_pages_.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
 std::map<block_id_t, page_cache_t::block_change_t>
 page_cache_t::compute_changes(const std::set<page_txn_t *> &txns) {
     // We combine changes, using the block_version_t value to see which change
@@ -1174,17 +1371,19 @@ void page_cache_t::do_flush_changes(page_cache_t *page_cache,
 
         blocks_releasable_cb.wait();
 
-        // LSI: Pass in the exiter to index_write, so that subsequent index_write
-        // operations don't have to wait for one another to finish.  (Note: Doing
-        // this requires some sort of semaphore to prevent a zillion index_writes to
-        // queue up.)
         fifo_enforcer_sink_t::exit_write_t exiter(page_cache->index_write_sink_.get(),
                                                   index_write_token);
         exiter.wait();
 
+        // We leave the fifo as soon as the serializer has put our index write in
+        // line, so that the next flush's index write can go to disk while ours is
+        // still in flight.  (How many can pile up is limited by
+        // DEFAULT_MAX_CONCURRENT_FLUSHES.)
         rassert(!write_ops.empty());
-        page_cache->serializer_->index_write(write_ops,
-                                             page_cache->writes_io_account_.get());
+        page_cache->serializer_->index_write(
+            write_ops,
+            std::bind(&fifo_enforcer_sink_t::exit_write_t::end, &exiter),
+            page_cache->writes_io_account_.get());
     }
 
     // Set the page_t's block token field to their new block tokens.  KSI: Can we
@@ -1229,11 +1428,20 @@ void page_cache_t::do_flush_txn_set(page_cache_t *page_cache,
 
     fifo_enforcer_write_token_t index_write_token
         = page_cache->index_write_source_.enter_write();
+    fifo_enforcer_write_token_t flush_complete_token
+        = page_cache->flush_complete_source_.enter_write();
 
     // Okay, yield, thank you.
     coro_t::yield();
     do_flush_changes(page_cache, changes, index_write_token);
 
+    // Index writes can be in flight concurrently, and their callers aren't
+    // necessarily woken up in order.  But our txns might have preceders flushed by
+    // an earlier txn set, which must be removed from the graph before ours.
+    fifo_enforcer_sink_t::exit_write_t exiter(&page_cache->flush_complete_sink_,
+                                              flush_complete_token);
+    exiter.wait();
+
     // Flush complete.
 
     // KSI: Can't we remove_txn_set_from_graph before flushing?  Make pulsing
@@ -1241,6 +1449,9 @@ void page_cache_t::do_flush_txn_set(page_cache_t *page_cache,
     std::set<page_txn_t *> unblocked
         = page_cache_t::remove_txn_set_from_graph(page_cache, txns);
 
+    rassert(page_cache->flushes_in_flight_ > 0);
+    --page_cache->flushes_in_flight_;
+    // This also spawns the flush of whatever became pending in the meantime.
     page_cache->im_waiting_for_flush(std::move(unblocked));
 }
 
@@ -1310,11 +1521,8 @@ void page_cache_t::im_waiting_for_flush(std::set<page_txn_t *> queue) {
         // flush and haven't started flushing yet) ready to flush?  If so, this node must
         // have been the one that pushed them over the line (since they haven't started
         // flushing yet).  So we begin flushing this node and all of its preceders
-        // (recursively) in one atomic flush.
-
-
-        // LSI: Every transaction is getting its own flush, basically, the way things are
-        // right now.
+        // (recursively) in one atomic flush.  (Or rather, we add them to the next
+        // flush, which might contain other txn sets too.)
 
         std::set<page_txn_t *> flush_set;
         if (exists_flushable_txn_set(txn, &flush_set)) {
@@ -1323,14 +1531,11 @@ void page_cache_t::im_waiting_for_flush(std::set<page_txn_t *> queue) {
                 (*it)->spawned_flush_ = true;
             }
 
-            std::map<block_id_t, block_change_t> changes
-                = page_cache_t::compute_changes(flush_set);
-
-            if (!changes.empty()) {
-                coro_t::spawn_now_dangerously(std::bind(&page_cache_t::do_flush_txn_set,
-                                                        this,
-                                                        &changes,
-                                                        flush_set));
+            if (page_cache_t::has_changes(flush_set)) {
+                // Because flush_set contains all of its txns' preceders that
+                // haven't begun flushing, the union of pending sets is itself a
+                // flushable txn set.
+                pending_flush_txns_.insert(flush_set.begin(), flush_set.end());
             } else {
                 // Flush complete.  do_flush_txn_set does this in the write case.
                 std::set<page_txn_t *> unblocked
@@ -1342,6 +1547,28 @@ void page_cache_t::im_waiting_for_flush(std::set<page_txn_t *> queue) {
             }
         }
     }
+
+    spawn_pending_flush();
+}
+
+void page_cache_t::spawn_pending_flush() {
+    assert_thread();
+    if (pending_flush_txns_.empty()
+        || flushes_in_flight_ >= DEFAULT_MAX_CONCURRENT_FLUSHES) {
+        return;
+    }
+
+    std::set<page_txn_t *> flush_set;
+    flush_set.swap(pending_flush_txns_);
+    std::map<block_id_t, block_change_t> changes
+        = page_cache_t::compute_changes(flush_set);
+    rassert(!changes.empty());
+
+    ++flushes_in_flight_;
+    coro_t::spawn_now_dangerously(std::bind(&page_cache_t::do_flush_txn_set,
+                                            this,
+                                            &changes,
+                                            flush_set));
 }
 
 
@@ -3,6 +3,7 @@
 #define BUFFER_CACHE_ALT_PAGE_CACHE_HPP_
 
 #include <map>
+#include <string>
 #include <utility>
 #include <vector>
 #include <set>
@@ -24,15 +25,18 @@
 #include "repli_timestamp.hpp"
 #include "serializer/types.hpp"
 
+class alt_cache_stats_t;
 class alt_memory_tracker_t;
 class auto_drainer_t;
 class cache_t;
 class file_account_t;
+class lock_stats_t;
 
 namespace alt {
 class current_page_acq_t;
 class page_cache_t;
 class page_txn_t;
+class warm_manifest_t;
 
 enum class page_create_t { no, yes };
 
@@ -88,9 +92,9 @@ struct current_page_help_t;
 class current_page_t {
 public:
     // Constructs a fresh, empty page.
-    current_page_t(block_size_t block_size, scoped_malloc_t<ser_buffer_t> buf,
+    current_page_t(block_size_t block_size, scoped_arena_ptr_t<ser_buffer_t> buf,
                    page_cache_t *page_cache);
-    current_page_t(scoped_malloc_t<ser_buffer_t> buf,
+    current_page_t(scoped_arena_ptr_t<ser_buffer_t> buf,
                    const counted_t<standard_block_token_t> &token,
                    page_cache_t *page_cache);
     // Constructs a page to be loaded from the serializer.
@@ -127,7 +131,7 @@ private:
     bool is_deleted() const { return is_deleted_; }
 
     void make_non_deleted(block_size_t block_size,
-                          scoped_malloc_t<ser_buffer_t> buf,
+                          scoped_arena_ptr_t<ser_buffer_t> buf,
                           page_cache_t *page_cache);
 
     // page_ can be null if we haven't tried loading the page yet.  We don't want to
@@ -218,6 +222,8 @@ private:
 
     void pulse_read_available();
     void pulse_write_available();
+    // Records a contended acquisition if we were waiting for `access`.
+    void note_granted(access_t access);
 
     page_cache_t *page_cache_;
     page_txn_t *the_txn_;
@@ -231,6 +237,8 @@ private:
     page_ptr_t snapshotted_page_;
     cond_t read_cond_;
     cond_t write_cond_;
+    // When we got in line, if the cache has stats and we weren't let in right away.
+    ticks_t queued_at_;
 
     // The recency for our acquisition of the page.
     repli_timestamp_t recency_;
@@ -257,7 +265,7 @@ public:
                          uint64_t bytes_to_send);
 
     void offer_read_ahead_buf(block_id_t block_id,
-                              scoped_malloc_t<ser_buffer_t> *buf,
+                              scoped_arena_ptr_t<ser_buffer_t> *buf,
                               const counted_t<standard_block_token_t> &token);
 
     void destroy_self();
@@ -299,9 +307,11 @@ private:
 
 class page_cache_t : public home_thread_mixin_t {
 public:
+    // stats may be NULL.
     page_cache_t(serializer_t *serializer,
                  const page_cache_config_t &config,
-                 memory_tracker_t *tracker);
+                 memory_tracker_t *tracker,
+                 alt_cache_stats_t *stats);
     ~page_cache_t();
 
     // Takes a txn to be flushed.  Calls on_flush_complete() when done.
@@ -313,21 +323,54 @@ public:
     current_page_t *page_for_new_block_id(block_id_t *block_id_out);
     current_page_t *page_for_new_chosen_block_id(block_id_t block_id);
 
+    // The recency that a read acquisition of the block would get, if it got in line
+    // right now.
+    repli_timestamp_t recency_for_new_read_acquirer(block_id_t block_id);
+
     // Returns how much memory is being used by all the pages in the cache at this
     // moment in time.
     size_t total_page_memory() const;
     size_t evictable_page_memory() const;
 
+    // The stats for acquirers of the given block, or NULL if we have no stats.
+    lock_stats_t *page_lock_stats(block_id_t block_id);
+
     block_size_t max_block_size() const;
 
     void create_cache_account(int priority, scoped_ptr_t<alt_cache_account_t> *out);
 
+    // Starts loading the pages of the given blocks that aren't in memory, without
+    // waiting for them, so that a txn about to acquire the blocks one at a time
+    // finds them loaded or on their way.  The reads of evicted pages are issued
+    // together, in the order of their offsets in the file.  The batch is skipped if
+    // it's too big for the cache to hold on to until it gets used.
+    void prefetch(const std::vector<block_id_t> &block_ids);
+
+    // Keeps a warm-cache manifest at `path` (see warm_manifest.hpp), and starts
+    // loading the blocks it lists if the file exists.  Blocks.
+    void start_warm_manifest(const std::string &path);
+
 private:
     friend class page_read_ahead_cb_t;
     void add_read_ahead_buf(block_id_t block_id,
                             ser_buffer_t *buf,
                             const counted_t<standard_block_token_t> &token);
 
+    // Makes the block's current page hold a buffer that has been read from the
+    // serializer, unless the block already has a current page.  Returns false (and
+    // drops the buffer) if the cache has no room left for it.
+    bool add_loaded_buf(block_id_t block_id,
+                        scoped_arena_ptr_t<ser_buffer_t> buf,
+                        const counted_t<standard_block_token_t> &token);
+
+    friend class warm_manifest_t;
+    // The ids of the blocks whose pages are in memory, most recently accessed first.
+    std::vector<block_id_t> hot_block_ids() const;
+
+    // Waits for an evicted page to be loaded back in, on behalf of prefetch().
+    static void load_prefetched_page(page_cache_t *page_cache, page_t *page,
+                                     auto_drainer_t::lock_t lock);
+
     void have_read_ahead_cb_destroyed();
 
     void read_ahead_cb_is_destroyed();
@@ -371,12 +414,18 @@ private:
 
     static std::map<block_id_t, block_change_t>
     compute_changes(const std::set<page_txn_t *> &txns);
+    // Whether compute_changes(txns) would be non-empty.
+    static bool has_changes(const std::set<page_txn_t *> &txns);
 
     bool exists_flushable_txn_set(page_txn_t *txn,
                                   std::set<page_txn_t *> *flush_set_out);
 
     void im_waiting_for_flush(std::set<page_txn_t *> txns);
 
+    // Flushes the txn sets in pending_flush_txns_, all together, unless
+    // DEFAULT_MAX_CONCURRENT_FLUSHES flushes are in flight already.
+    void spawn_pending_flush();
+
     repli_timestamp_t recency_for_block_id(block_id_t id) {
         return recencies_.size() <= id
             ? repli_timestamp_t::invalid
@@ -410,12 +459,28 @@ private:
     // separation might be tricky in practice.
     scoped_ptr_t<file_account_t> reads_io_account_;
     scoped_ptr_t<file_account_t> writes_io_account_;
+    // Coroutines running below the default priority read with this one instead, so
+    // that background work gives way to the reads of interactive queries.  The page
+    // loads that an acquirer spawns inherit its priority.
+    scoped_ptr_t<file_account_t> background_reads_io_account_;
+    file_account_t *current_reads_io_account();
 
     // This fifo enforcement pair ensures ordering of index_write operations after we
     // move to the serializer thread and get a bunch of blocks written.
     // index_write_sink's pointee's home thread is on the serializer.
     fifo_enforcer_source_t index_write_source_;
     scoped_ptr_t<fifo_enforcer_sink_t> index_write_sink_;
+    // Makes txn sets get their flushes completed (and get removed from the txn
+    // graph) in the order in which they began flushing.
+    fifo_enforcer_source_t flush_complete_source_;
+    fifo_enforcer_sink_t flush_complete_sink_;
+
+    // Txn sets that are ready to flush while the maximum number of flushes is in
+    // flight get collected here, and become part of the same flush once one of those
+    // is done.  That way, under load, many small (hard durability) txns share one
+    // index write and one metablock fsync instead of each waiting for their own.
+    std::set<page_txn_t *> pending_flush_txns_;
+    int flushes_in_flight_;
 
     serializer_t *serializer_;
     segmented_vector_t<repli_timestamp_t> recencies_;
@@ -425,6 +490,8 @@ private:
 
     free_list_t free_list_;
 
+    alt_cache_stats_t *const stats_;
+
     evicter_t evicter_;
 
     // KSI: I bet this read_ahead_cb_ and read_ahead_cb_existence_ type could be
@@ -435,6 +502,9 @@ private:
     // destroyed and all possible read-ahead operations have completed.
     auto_drainer_t::lock_t read_ahead_cb_existence_;
 
+    // Destroyed first, while the pages it records are still there.
+    scoped_ptr_t<warm_manifest_t> warm_manifest_;
+
     scoped_ptr_t<auto_drainer_t> drainer_;
 
     DISABLE_COPYING(page_cache_t);
@@ -6,5 +6,41 @@
 alt_cache_stats_t::alt_cache_stats_t(perfmon_collection_t *parent)
     : cache_collection(),
       cache_membership(parent, &cache_collection, "cache"),
-      cache_collection_membership(&cache_collection) { }
+      pm_evictions(secs_to_ticks(1)),
+      pm_eviction_scan_length(secs_to_ticks(1), false),
+      pm_victim_age_0_15(secs_to_ticks(1)),
+      pm_victim_age_16_255(secs_to_ticks(1)),
+      pm_victim_age_256_4095(secs_to_ticks(1)),
+      pm_victim_age_4096_65535(secs_to_ticks(1)),
+      pm_victim_age_65536_1048575(secs_to_ticks(1)),
+      pm_victim_age_1048576_up(secs_to_ticks(1)),
+      cache_collection_membership(&cache_collection,
+          &pm_evictions, "evictions",
+          &pm_eviction_scan_length, "eviction_scan_length",
+          &pm_victim_age_0_15, "victim_age_0-15",
+          &pm_victim_age_16_255, "victim_age_16-255",
+          &pm_victim_age_256_4095, "victim_age_256-4095",
+          &pm_victim_age_4096_65535, "victim_age_4096-65535",
+          &pm_victim_age_65536_1048575, "victim_age_65536-1048575",
+          &pm_victim_age_1048576_up, "victim_age_1048576+"),
+      superblock_lock(&cache_collection, "superblock_lock"),
+      page_lock(&cache_collection, "page_lock"),
+      unwritten_changes_throttle(&cache_collection, "unwritten_changes_throttle") { }
 
+void alt_cache_stats_t::record_eviction(uint64_t victim_age, size_t scan_length) {
+    pm_evictions.record();
+    pm_eviction_scan_length.record(scan_length);
+    if (victim_age < (1 << 4)) {
+        pm_victim_age_0_15.record();
+    } else if (victim_age < (1 << 8)) {
+        pm_victim_age_16_255.record();
+    } else if (victim_age < (1 << 12)) {
+        pm_victim_age_256_4095.record();
+    } else if (victim_age < (1 << 16)) {
+        pm_victim_age_4096_65535.record();
+    } else if (victim_age < (1 << 20)) {
+        pm_victim_age_65536_1048575.record();
+    } else {
+        pm_victim_age_1048576_up.record();
+    }
+}
@@ -2,20 +2,40 @@
 #ifndef BUFFER_CACHE_ALT_STATS_HPP_
 #define BUFFER_CACHE_ALT_STATS_HPP_
 
+#include "concurrency/lock_stats.hpp"
 #include "perfmon/perfmon.hpp"
 
 class alt_cache_stats_t {
 public:
     explicit alt_cache_stats_t(perfmon_collection_t *parent);
 
+    // victim_age is how many page accesses the cache has seen since the victim was
+    // last accessed, and scan_length is how many pages the evicter looked at to
+    // pick it.
+    void record_eviction(uint64_t victim_age, size_t scan_length);
+
     perfmon_collection_t cache_collection;
     perfmon_membership_t cache_membership;
 
-    /*
-      LSI: insert perfmons here
-    */
+    perfmon_rate_monitor_t pm_evictions;
+    perfmon_sampler_t pm_eviction_scan_length;
+
+    // A histogram of recent victims' ages, in powers of 16.
+    perfmon_rate_monitor_t
+        pm_victim_age_0_15,
+        pm_victim_age_16_255,
+        pm_victim_age_256_4095,
+        pm_victim_age_4096_65535,
+        pm_victim_age_65536_1048575,
+        pm_victim_age_1048576_up;
 
     perfmon_multi_membership_t cache_collection_membership;
+
+    // Waits for the superblock, for every other block, and for transactions being
+    // throttled by the number of unwritten changes.
+    lock_stats_t superblock_lock;
+    lock_stats_t page_lock;
+    lock_stats_t unwritten_changes_throttle;
 };
 
 
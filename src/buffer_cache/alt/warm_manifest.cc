@@ -0,0 +1,293 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "buffer_cache/alt/warm_manifest.hpp"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+
+#include "arch/io/io_utils.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "buffer_cache/alt/page_cache.hpp"
+#include "concurrency/pmap.hpp"
+#include "logger.hpp"
+#include "serializer/serializer.hpp"
+
+namespace alt {
+
+namespace {
+
+const char WARM_MANIFEST_MAGIC[8] = { 'r', 'd', 'b', 'w', 'a', 'r', 'm', '1' };
+
+struct warm_manifest_header_t {
+    char magic[sizeof(WARM_MANIFEST_MAGIC)];
+    uint64_t num_block_ids;
+};
+
+typedef std::pair<counted_t<standard_block_token_t>, block_id_t> warm_block_t;
+
+struct warm_block_offset_less_t {
+    bool operator()(const warm_block_t &x, const warm_block_t &y) const {
+        return x.first->offset() < y.first->offset();
+    }
+};
+
+bool read_fully(int fd, void *buf, size_t size) {
+    char *p = static_cast<char *>(buf);
+    while (size > 0) {
+        ssize_t res = ::read(fd, p, size);
+        if (res == -1 && get_errno() == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            return false;
+        }
+        p += res;
+        size -= res;
+    }
+    return true;
+}
+
+bool write_fully(int fd, const void *buf, size_t size) {
+    const char *p = static_cast<const char *>(buf);
+    while (size > 0) {
+        ssize_t res = ::write(fd, p, size);
+        if (res == -1 && get_errno() == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            return false;
+        }
+        p += res;
+        size -= res;
+    }
+    return true;
+}
+
+void read_warm_manifest_blocking(const std::string *path,
+                                 std::vector<block_id_t> *block_ids_out,
+                                 bool *success_out) {
+    *success_out = read_warm_manifest(*path, block_ids_out);
+}
+
+void write_warm_manifest_blocking(const std::string *path,
+                                  const std::vector<block_id_t> *block_ids,
+                                  bool *success_out) {
+    *success_out = write_warm_manifest(*path, *block_ids);
+}
+
+void read_warm_block(serializer_t *serializer,
+                     const std::vector<warm_block_t> *blocks,
+                     size_t first,
+                     std::vector<scoped_arena_ptr_t<ser_buffer_t> > *bufs,
+                     file_account_t *io_account,
+                     int i) {
+    serializer->block_read((*blocks)[first + i].first, (*bufs)[i].get(), io_account);
+}
+
+}  // namespace
+
+bool read_warm_manifest(const std::string &path,
+                        std::vector<block_id_t> *block_ids_out) {
+    block_ids_out->clear();
+
+    scoped_fd_t fd;
+    {
+        int res;
+        do {
+            res = ::open(path.c_str(), O_RDONLY);
+        } while (res == INVALID_FD && get_errno() == EINTR);
+        fd.reset(res);
+    }
+    if (fd.get() == INVALID_FD) {
+        return false;
+    }
+
+    struct stat st;
+    warm_manifest_header_t header;
+    if (fstat(fd.get(), &st) != 0
+        || static_cast<uint64_t>(st.st_size) < sizeof(header)
+        || !read_fully(fd.get(), &header, sizeof(header))
+        || memcmp(header.magic, WARM_MANIFEST_MAGIC, sizeof(header.magic)) != 0) {
+        return false;
+    }
+    // A corrupt count could overflow the size computation below or make us allocate
+    // far more than the file could hold, so we check it against the file first.
+    const uint64_t max_block_ids
+        = (static_cast<uint64_t>(st.st_size) - sizeof(header)) / sizeof(block_id_t);
+    if (header.num_block_ids > max_block_ids
+        || static_cast<uint64_t>(st.st_size)
+           != sizeof(header) + header.num_block_ids * sizeof(block_id_t)) {
+        return false;
+    }
+
+    std::vector<block_id_t> block_ids(header.num_block_ids);
+    if (!block_ids.empty()
+        && !read_fully(fd.get(), block_ids.data(),
+                       block_ids.size() * sizeof(block_id_t))) {
+        return false;
+    }
+    *block_ids_out = std::move(block_ids);
+    return true;
+}
+
+bool write_warm_manifest(const std::string &path,
+                         const std::vector<block_id_t> &block_ids) {
+    // We write the new manifest next to the old one and rename it over the old one,
+    // so that a crash can't leave half a manifest behind.
+    const std::string tmp_path = path + ".tmp";
+    scoped_fd_t fd;
+    {
+        int res;
+        do {
+            res = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        } while (res == INVALID_FD && get_errno() == EINTR);
+        fd.reset(res);
+    }
+    if (fd.get() == INVALID_FD) {
+        return false;
+    }
+
+    warm_manifest_header_t header;
+    memcpy(header.magic, WARM_MANIFEST_MAGIC, sizeof(header.magic));
+    header.num_block_ids = block_ids.size();
+    if (!write_fully(fd.get(), &header, sizeof(header))
+        || (!block_ids.empty()
+            && !write_fully(fd.get(), block_ids.data(),
+                            block_ids.size() * sizeof(block_id_t)))
+        || fsync(fd.get()) != 0) {
+        fd.reset();
+        ::unlink(tmp_path.c_str());
+        return false;
+    }
+    fd.reset();
+
+    return ::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+warm_manifest_t::warm_manifest_t(page_cache_t *page_cache, const std::string &path)
+    : page_cache_(page_cache),
+      path_(path),
+      prefetch_done_(true),
+      save_in_progress_(false),
+      save_failure_reported_(false),
+      drainer_(make_scoped<auto_drainer_t>()) {
+    page_cache_->assert_thread();
+
+    std::vector<block_id_t> block_ids;
+    bool success;
+    thread_pool_t::run_in_blocker_pool(std::bind(&read_warm_manifest_blocking,
+                                                 &path_, &block_ids, &success));
+    if (success && !block_ids.empty()) {
+        // The serializer's read-ahead would fill the cache with whatever happens to
+        // be at the beginning of the file.  We know better.
+        page_cache_->have_read_ahead_cb_destroyed();
+        prefetch_done_ = false;
+        coro_t::spawn_sometime(std::bind(&warm_manifest_t::prefetch, this,
+                                         std::move(block_ids), drainer_->lock()));
+    }
+
+    timer_.init(new repeating_timer_t(WARM_MANIFEST_SAVE_INTERVAL_MS, this));
+}
+
+warm_manifest_t::~warm_manifest_t() {
+    assert_thread();
+    timer_.reset();
+    drainer_.reset();
+    if (prefetch_done_) {
+        save_now();
+    }
+}
+
+void warm_manifest_t::on_ring() {
+    assert_thread();
+    if (!prefetch_done_ || save_in_progress_) {
+        return;
+    }
+    save_in_progress_ = true;
+    coro_t::spawn_sometime(std::bind(&warm_manifest_t::save, this, drainer_->lock()));
+}
+
+void warm_manifest_t::save(auto_drainer_t::lock_t) {
+    save_now();
+    save_in_progress_ = false;
+}
+
+void warm_manifest_t::save_now() {
+    const std::vector<block_id_t> block_ids = page_cache_->hot_block_ids();
+    bool success;
+    thread_pool_t::run_in_blocker_pool(std::bind(&write_warm_manifest_blocking,
+                                                 &path_, &block_ids, &success));
+    if (!success && !save_failure_reported_) {
+        save_failure_reported_ = true;
+        logWRN("Could not write the warm-cache manifest %s.  The cache will start "
+               "out cold after a restart.", path_.c_str());
+    }
+}
+
+void warm_manifest_t::prefetch(const std::vector<block_id_t> &block_ids,
+                               auto_drainer_t::lock_t lock) {
+    serializer_t *const serializer = page_cache_->serializer_;
+    // The evicter's limit is the one the cache is held to right now, which can be
+    // lower than the configured one (see `alt_cache_balancer_t`).
+    const uint64_t memory_limit = page_cache_->evicter().get_memory_limit();
+    std::vector<warm_block_t> blocks;
+    scoped_ptr_t<file_account_t> io_account;
+    {
+        on_thread_t th(serializer->home_thread());
+        io_account.init(serializer->make_io_account(WARM_MANIFEST_IO_PRIORITY));
+
+        // The block ids are hottest first, so if the cache has gotten smaller since
+        // the manifest was recorded we load the hottest blocks that fit.
+        uint64_t bytes = 0;
+        for (auto it = block_ids.begin(); it != block_ids.end(); ++it) {
+            counted_t<standard_block_token_t> token = serializer->index_read(*it);
+            if (!token.has()) {
+                // The block has been deleted since.
+                continue;
+            }
+            bytes += token->block_size().ser_value();
+            if (bytes > memory_limit) {
+                break;
+            }
+            blocks.push_back(warm_block_t(std::move(token), *it));
+        }
+        std::sort(blocks.begin(), blocks.end(), warm_block_offset_less_t());
+    }
+
+    bool interested = true;
+    for (size_t i = 0;
+         i < blocks.size() && interested && !lock.get_drain_signal()->is_pulsed();
+         i += WARM_MANIFEST_PREFETCH_BATCH_SIZE) {
+        const size_t n = std::min<size_t>(WARM_MANIFEST_PREFETCH_BATCH_SIZE,
+                                          blocks.size() - i);
+        std::vector<scoped_arena_ptr_t<ser_buffer_t> > bufs(n);
+        for (size_t j = 0; j < n; ++j) {
+            bufs[j] = serializer->malloc();
+        }
+        {
+            on_thread_t th(serializer->home_thread());
+            pmap(n, std::bind(&read_warm_block, serializer, &blocks, i, &bufs,
+                              io_account.get(), ph::_1));
+        }
+        for (size_t j = 0; j < n && interested; ++j) {
+            interested = page_cache_->add_loaded_buf(blocks[i + j].second,
+                                                     std::move(bufs[j]),
+                                                     blocks[i + j].first);
+        }
+    }
+
+    {
+        on_thread_t th(serializer->home_thread());
+        blocks.clear();
+        io_account.reset();
+    }
+    prefetch_done_ = true;
+}
+
+}  // namespace alt
@@ -0,0 +1,66 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_ALT_WARM_MANIFEST_HPP_
+#define BUFFER_CACHE_ALT_WARM_MANIFEST_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "arch/timing.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "containers/scoped.hpp"
+#include "serializer/types.hpp"
+#include "utils.hpp"
+
+namespace alt {
+
+class page_cache_t;
+
+/* A warm-cache manifest is a small file next to a table's data file that lists the
+blocks a page cache had in memory, hottest first.  The page cache records it every
+WARM_MANIFEST_SAVE_INTERVAL_MS and when it's destroyed, and a page cache that starts
+up with a manifest loads those blocks in the background, in the order of their
+offsets in the file so that the disk mostly reads sequentially, instead of waiting
+for the queries to fault them in one random read at a time.  Blocks that have been
+loaded (or created) by queries in the meantime are left alone. */
+class warm_manifest_t : public repeating_timer_callback_t,
+                        public home_thread_mixin_t {
+public:
+    // Blocks, reading the manifest at `path` (if it exists).
+    warm_manifest_t(page_cache_t *page_cache, const std::string &path);
+    // Blocks, recording the manifest one last time.
+    ~warm_manifest_t();
+
+private:
+    void on_ring();
+
+    void save(auto_drainer_t::lock_t lock);
+    void save_now();
+
+    void prefetch(const std::vector<block_id_t> &block_ids,
+                  auto_drainer_t::lock_t lock);
+
+    page_cache_t *const page_cache_;
+    const std::string path_;
+
+    // We don't overwrite the manifest until its blocks have been loaded, or else a
+    // server that's restarted twice in short order would forget most of them.
+    bool prefetch_done_;
+    bool save_in_progress_;
+    bool save_failure_reported_;
+
+    scoped_ptr_t<auto_drainer_t> drainer_;
+    scoped_ptr_t<repeating_timer_t> timer_;
+
+    DISABLE_COPYING(warm_manifest_t);
+};
+
+// These block, so they must be run in the blocker pool.  read_warm_manifest returns
+// false if there is no valid manifest at `path`.
+bool read_warm_manifest(const std::string &path, std::vector<block_id_t> *block_ids_out);
+bool write_warm_manifest(const std::string &path,
+                         const std::vector<block_id_t> &block_ids);
+
+}  // namespace alt
+
+#endif  // BUFFER_CACHE_ALT_WARM_MANIFEST_HPP_
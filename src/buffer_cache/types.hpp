@@ -14,6 +14,11 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(write_durability_t, int8_t,
                                       write_durability_t::SOFT,
                                       write_durability_t::HARD);
 
+// A hint from whoever reads a block about whether the read says anything about
+// future reads.  Traversals that sweep a large range touch each block once, and
+// one_shot keeps them from displacing the cache's hot pages.
+enum class cache_access_pattern_t { normal, one_shot };
+
 
 typedef uint32_t block_magic_comparison_t;
 
@@ -0,0 +1,28 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/http/coro_profiler_app.hpp"
+
+#include <string>
+
+#include "arch/runtime/coro_wait_profiler.hpp"
+
+void coro_profiler_http_app_t::handle(const http_req_t &req, http_res_t *result,
+                                      signal_t *) {
+    std::string resource = req.resource.as_string();
+    if (resource == "/" || resource == "") {
+        if (req.method != GET) {
+            *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+            return;
+        }
+        *result = http_res_t(HTTP_OK, "text/plain",
+                             coro_wait_profiler_t::get_folded_stacks());
+    } else if (resource == "/start" || resource == "/stop") {
+        if (req.method != POST) {
+            *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+            return;
+        }
+        coro_wait_profiler_t::set_enabled(resource == "/start");
+        *result = http_res_t(HTTP_OK);
+    } else {
+        *result = http_res_t(HTTP_NOT_FOUND);
+    }
+}
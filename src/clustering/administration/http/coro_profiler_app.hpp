@@ -0,0 +1,19 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_CORO_PROFILER_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_CORO_PROFILER_APP_HPP_
+
+#include "http/http.hpp"
+
+/* Controls this server's `coro_wait_profiler_t`.  POSTing to `start` or `stop` turns
+it on or off, and GETting the root returns what it has collected as folded stacks
+for flamegraph.pl. */
+class coro_profiler_http_app_t : public http_app_t {
+public:
+    coro_profiler_http_app_t() { }
+    void handle(const http_req_t &, http_res_t *result, signal_t *interruptor);
+
+private:
+    DISABLE_COPYING(coro_profiler_http_app_t);
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_CORO_PROFILER_APP_HPP_ */
@@ -2,6 +2,7 @@
 #include <string>
 
 #include "errors.hpp"
+#include <boost/bind.hpp>
 #include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
 
@@ -10,7 +11,13 @@
 #include "clustering/administration/http/directory_app.hpp"
 
 directory_http_app_t::directory_http_app_t(const clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> > >& _directory_metadata)
-    : directory_metadata(_directory_metadata) { }
+    : directory_metadata(_directory_metadata),
+      root_history(boost::bind(&directory_http_app_t::get_root, this, _1)),
+      directory_subscription(boost::bind(&json_history_t::invalidate, &root_history)) {
+    watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> >::freeze_t
+        freeze(directory_metadata);
+    directory_subscription.reset(directory_metadata, &freeze);
+}
 
 static const char *any_machine_id_wildcard = "_";
 
@@ -61,11 +68,15 @@ void directory_http_app_t::get_root(scoped_cJSON_t *json_out) {
     }
 }
 
-void directory_http_app_t::handle(const http_req_t &req, http_res_t *result, signal_t *) {
+void directory_http_app_t::handle(const http_req_t &req, http_res_t *result, signal_t *interruptor) {
     if (req.method != GET) {
         *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
         return;
     }
+    if (req.resource.begin() == req.resource.end()) {
+        root_history.handle_root_get(req, result, interruptor);
+        return;
+    }
     try {
         std::map<peer_id_t, cluster_directory_metadata_t> md = directory_metadata->get().get_inner();
 
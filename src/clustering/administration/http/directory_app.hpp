@@ -4,6 +4,7 @@
 
 #include <map>
 
+#include "clustering/administration/http/json_history.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "http/http.hpp"
 #include "http/json/cJSON.hpp"
@@ -21,6 +22,10 @@ private:
 
     clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> > > directory_metadata;
 
+    // Answers GETs of the root, which the web UI polls.
+    json_history_t root_history;
+    watchable_t<change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> >::subscription_t directory_subscription;
+
     DISABLE_COPYING(directory_http_app_t);
 };
 
@@ -40,8 +40,44 @@ void distribution_app_t::handle(const http_req_t &req, http_res_t *result, signa
     cow_ptr_t<namespaces_semilattice_metadata_t<memcached_protocol_t> > ns_snapshot = namespaces_sl_metadata->get();
     cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > rdb_ns_snapshot = rdb_namespaces_sl_metadata->get();
 
+    // Tables are sampled unless they ask for a depth.  Memcached namespaces can't
+    // be sampled.
+    distribution_method_t method = distribution_method_t::SAMPLE;
     uint64_t depth = DEFAULT_DEPTH;
     boost::optional<std::string> maybe_depth = req.find_query_param("depth");
+    boost::optional<std::string> maybe_method = req.find_query_param("method");
+
+    if (maybe_method) {
+        if (maybe_method.get() == "sample") {
+            method = distribution_method_t::SAMPLE;
+        } else if (maybe_method.get() == "depth") {
+            method = distribution_method_t::DEPTH;
+        } else {
+            *result = http_error_res("Invalid method value.");
+            return;
+        }
+    } else if (maybe_depth) {
+        method = distribution_method_t::DEPTH;
+    }
+
+    // Sampled distributions can be weighed by the rows' sizes instead.
+    bool by_bytes = false;
+    boost::optional<std::string> maybe_weight = req.find_query_param("weight");
+
+    if (maybe_weight) {
+        if (maybe_weight.get() == "bytes") {
+            by_bytes = true;
+        } else if (maybe_weight.get() != "keys") {
+            *result = http_error_res("Invalid weight value.");
+            return;
+        }
+    }
+
+    if (by_bytes && (method != distribution_method_t::SAMPLE
+                     || std_contains(ns_snapshot->namespaces, n_id))) {
+        *result = http_error_res("Only sampled distributions can be weighed by bytes.");
+        return;
+    }
 
     if (maybe_depth) {
         if (!strtou64_strict(maybe_depth.get(), 10, &depth) || depth == 0 || depth > MAX_DEPTH) {
@@ -71,7 +107,7 @@ void distribution_app_t::handle(const http_req_t &req, http_res_t *result, signa
                                                         interruptor);
 
             scoped_cJSON_t data(render_as_json(&boost::get<distribution_result_t>(db_res.result).key_counts));
-            http_json_res(data.get(), result);
+            http_json_res(&data, result);
         } catch (const cannot_perform_query_exc_t &) {
             *result = http_res_t(HTTP_INTERNAL_SERVER_ERROR);
         }
@@ -79,15 +115,19 @@ void distribution_app_t::handle(const http_req_t &req, http_res_t *result, signa
         try {
             namespace_repo_t<rdb_protocol_t>::access_t rdb_ns_access(rdb_ns_repo, n_id, interruptor);
 
-            rdb_protocol_t::distribution_read_t inner_read(depth, limit);
+            rdb_protocol_t::distribution_read_t inner_read(method, depth, limit);
             rdb_protocol_t::read_t read(inner_read, profile_bool_t::DONT_PROFILE);
             rdb_protocol_t::read_response_t db_res;
             rdb_ns_access.get_namespace_if()->read_outdated(read,
                                                             &db_res,
                                                             interruptor);
 
-            scoped_cJSON_t data(render_as_json(&boost::get<rdb_protocol_t::distribution_read_response_t>(db_res.response).key_counts));
-            http_json_res(data.get(), result);
+            rdb_protocol_t::distribution_read_response_t *distribution
+                = &boost::get<rdb_protocol_t::distribution_read_response_t>(db_res.response);
+            scoped_cJSON_t data(render_as_json(by_bytes
+                                               ? &distribution->byte_counts
+                                               : &distribution->key_counts));
+            http_json_res(&data, result);
         } catch (const cannot_perform_query_exc_t &) {
             *result = http_res_t(HTTP_INTERNAL_SERVER_ERROR);
         }
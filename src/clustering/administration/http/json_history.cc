@@ -0,0 +1,170 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/http/json_history.hpp"
+
+#include <string>
+#include <vector>
+
+#include "arch/timing.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
+
+json_history_t::json_history_t(const render_fn_t &_render)
+    : render(_render), instance_id(generate_uuid()), version(0), stale(true) { }
+
+void json_history_t::invalidate() {
+    assert_thread();
+    stale = true;
+    for (auto it = waiters.begin(); it != waiters.end(); ++it) {
+        (*it)->pulse_if_not_already_pulsed();
+    }
+}
+
+void json_history_t::refresh() {
+    if (!stale) {
+        return;
+    }
+    stale = false;
+    scoped_cJSON_t json;
+    render(&json);
+    if (!snapshots.empty() && cJSON_Equal(snapshots.rbegin()->second->get(), json.get())) {
+        return;
+    }
+    ++version;
+    uint64_t key = version;
+    snapshots.insert(key, new scoped_cJSON_t(json.release()));
+    while (snapshots.size() > ADMIN_JSON_HISTORY_LENGTH) {
+        snapshots.erase(snapshots.begin());
+    }
+}
+
+std::string json_history_t::version_token() const {
+    return strprintf("%s-%" PRIu64, uuid_to_str(instance_id).c_str(), version);
+}
+
+std::string json_history_t::etag() const {
+    return "\"" + version_token() + "\"";
+}
+
+bool json_history_t::parse_version_token(const std::string &token,
+                                         uint64_t *version_out) const {
+    const size_t dash = token.rfind('-');
+    uuid_u token_instance_id;
+    if (dash == std::string::npos
+        || !str_to_uuid(token.substr(0, dash), &token_instance_id)
+        || !strtou64_strict(token.substr(dash + 1), 10, version_out)) {
+        return false;
+    }
+    // Versions from other instances may as well be ancient.
+    if (token_instance_id != instance_id) {
+        *version_out = 0;
+    }
+    return true;
+}
+
+static cJSON *path_json(const std::vector<std::string> &path) {
+    cJSON *res = cJSON_CreateArray();
+    for (auto it = path.begin(); it != path.end(); ++it) {
+        cJSON_AddItemToArray(res, cJSON_CreateString(it->c_str()));
+    }
+    return res;
+}
+
+static void add_change(const std::vector<std::string> &path, cJSON *value,
+                       cJSON *changes_out) {
+    cJSON *change = cJSON_CreateObject();
+    cJSON_AddItemToObject(change, "path", path_json(path));
+    if (value != NULL) {
+        cJSON_AddItemToObject(change, "value", cJSON_DeepCopy(value));
+    } else {
+        cJSON_AddTrueToObject(change, "deleted");
+    }
+    cJSON_AddItemToArray(changes_out, change);
+}
+
+// Adds to `changes_out` the smallest subtrees that differ between `old_json` and
+// `new_json`; objects are compared key by key, anything else as a whole.
+static void diff_json(cJSON *old_json, cJSON *new_json, std::vector<std::string> *path,
+                      cJSON *changes_out) {
+    if (old_json->type != cJSON_Object || new_json->type != cJSON_Object) {
+        if (!cJSON_Equal(old_json, new_json)) {
+            add_change(*path, new_json, changes_out);
+        }
+        return;
+    }
+    json_object_iterator_t new_it(new_json);
+    while (cJSON *new_child = new_it.next()) {
+        path->push_back(new_child->string);
+        cJSON *old_child = cJSON_GetObjectItem(old_json, new_child->string);
+        if (old_child == NULL) {
+            add_change(*path, new_child, changes_out);
+        } else {
+            diff_json(old_child, new_child, path, changes_out);
+        }
+        path->pop_back();
+    }
+    json_object_iterator_t old_it(old_json);
+    while (cJSON *old_child = old_it.next()) {
+        if (cJSON_GetObjectItem(new_json, old_child->string) == NULL) {
+            path->push_back(old_child->string);
+            add_change(*path, NULL, changes_out);
+            path->pop_back();
+        }
+    }
+}
+
+void json_history_t::handle_root_get(const http_req_t &req, http_res_t *result,
+                                     signal_t *interruptor) {
+    assert_thread();
+    refresh();
+
+    boost::optional<std::string> since_param = req.find_query_param("since");
+    if (!since_param) {
+        boost::optional<std::string> if_none_match = req.find_header_line("If-None-Match");
+        if (if_none_match && *if_none_match == etag()) {
+            *result = http_res_t(HTTP_NOT_MODIFIED);
+        } else {
+            scoped_cJSON_t json(cJSON_DeepCopy(snapshots.rbegin()->second->get()));
+            http_json_res(&json, result);
+        }
+        result->add_header_line("ETag", etag());
+        return;
+    }
+
+    uint64_t since;
+    if (!parse_version_token(*since_param, &since) || since > version) {
+        *result = http_error_res("Invalid value for since: " + *since_param);
+        return;
+    }
+
+    if (since == version) {
+        signal_timer_t timer;
+        timer.start(ADMIN_LONG_POLL_TIMEOUT_MS);
+        while (since == version && !timer.is_pulsed() && !interruptor->is_pulsed()) {
+            cond_t changed;
+            if (!stale) {
+                waiters.insert(&changed);
+                wait_any_t waiter(&changed, &timer, interruptor);
+                waiter.wait_lazily_unordered();
+                waiters.erase(&changed);
+            }
+            refresh();
+        }
+    }
+
+    scoped_cJSON_t body(cJSON_CreateObject());
+    body.AddItemToObject("version", cJSON_CreateString(version_token().c_str()));
+    auto old_it = snapshots.find(since);
+    cJSON *current = snapshots.rbegin()->second->get();
+    if (old_it == snapshots.end()) {
+        body.AddItemToObject("full", cJSON_CreateTrue());
+        body.AddItemToObject("value", cJSON_DeepCopy(current));
+    } else {
+        body.AddItemToObject("full", cJSON_CreateFalse());
+        cJSON *changes = cJSON_CreateArray();
+        std::vector<std::string> path;
+        diff_json(old_it->second->get(), current, &path, changes);
+        body.AddItemToObject("changes", changes);
+    }
+    http_json_res(body.get(), result);
+    result->add_header_line("ETag", etag());
+}
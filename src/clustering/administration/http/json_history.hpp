@@ -0,0 +1,66 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_JSON_HISTORY_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_JSON_HISTORY_HPP_
+
+#include <stdint.h>
+
+#include <set>
+
+#include "errors.hpp"
+#include <boost/function.hpp>
+#include <boost/ptr_container/ptr_map.hpp>
+
+#include "concurrency/cond_var.hpp"
+#include "containers/uuid.hpp"
+#include "http/http.hpp"
+#include "http/json.hpp"
+
+/* Version-stamped renderings of an admin app's root, so that the web UI doesn't have
+to fetch (and the server doesn't have to print) the whole root every time it polls.
+
+The app calls `invalidate()` whenever its data might have changed; the root is only
+re-rendered when it is next asked for, and gets a new version if it actually came out
+different.  GETs of the root then get an ETag, and:
+ - `If-None-Match` with the current ETag gets 304 Not Modified.
+ - `?since=<version>`, with the "version" of an earlier answer, gets
+   `{"version": ..., "full": false, "changes": [...]}`, with
+   a `{"path": [...], "value": ...}` or `{"path": [...], "deleted": true}` for every
+   subtree that changed since that version.  If the root hasn't changed since then,
+   the request waits (up to ADMIN_LONG_POLL_TIMEOUT_MS) for it to.  If that version
+   is too old (or from another server process), the answer is
+   `{"version": ..., "full": true, "value": <the root>}` instead. */
+class json_history_t : public home_thread_mixin_t {
+public:
+    typedef boost::function<void(scoped_cJSON_t *)> render_fn_t;
+
+    explicit json_history_t(const render_fn_t &render);
+
+    // Doesn't block, so it can be called from subscription callbacks.
+    void invalidate();
+
+    void handle_root_get(const http_req_t &req, http_res_t *result,
+                         signal_t *interruptor);
+
+private:
+    void refresh();
+    // Versions go out as "<instance id>-<version>"; the ETag is that, quoted.
+    std::string version_token() const;
+    std::string etag() const;
+    bool parse_version_token(const std::string &token, uint64_t *version_out) const;
+
+    render_fn_t render;
+
+    // Tells versions from before a restart apart from ours.
+    const uuid_u instance_id;
+
+    uint64_t version;
+    bool stale;
+    boost::ptr_map<uint64_t, scoped_cJSON_t> snapshots;
+
+    // Pulsed by `invalidate()`, for long polls.
+    std::set<cond_t *> waiters;
+
+    DISABLE_COPYING(json_history_t);
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_JSON_HISTORY_HPP_ */
@@ -128,7 +128,7 @@ void log_http_app_t::handle(const http_req_t &req, http_res_t *result, signal_t
         map_to_fill.get(),
         interruptor));
 
-    http_json_res(map_to_fill.get(), result);
+    http_json_res(&map_to_fill, result);
 }
 
 void log_http_app_t::fetch_logs(int i,
@@ -0,0 +1,107 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/http/metrics_app.hpp"
+
+#include <stdlib.h>
+
+#include <map>
+#include <vector>
+
+#include "clustering/administration/http/stat_app.hpp"
+#include "containers/uuid.hpp"
+#include "http/json.hpp"
+#include "perfmon/snapshot.hpp"
+
+metrics_http_app_t::metrics_http_app_t(perfmon_snapshotter_t *_snapshotter)
+    : snapshotter(_snapshotter) { }
+
+void metrics_http_app_t::handle(const http_req_t &req, http_res_t *result,
+                                signal_t *) {
+    if (req.method != GET) {
+        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        return;
+    }
+    std::string resource = req.resource.as_string();
+    if (resource == "/" || resource == "") {
+        scoped_ptr_t<perfmon_result_t> stats = snapshotter->get_stats();
+        *result = http_res_t(HTTP_OK, "text/plain; version=0.0.4",
+                             render_as_prometheus(*stats));
+    } else if (resource == "/json") {
+        scoped_ptr_t<perfmon_result_t> stats, deltas;
+        double interval_secs;
+        snapshotter->get_stats_and_deltas(&stats, &deltas, &interval_secs);
+
+        scoped_cJSON_t body(cJSON_CreateObject());
+        body.AddItemToObject("interval_secs", cJSON_CreateNumber(interval_secs));
+        body.AddItemToObject("stats", render_as_json(stats.get()));
+        body.AddItemToObject("deltas", render_as_json(deltas.get()));
+        http_json_res(body.get(), result);
+    } else {
+        *result = http_res_t(HTTP_NOT_FOUND);
+    }
+}
+
+static std::string metric_name_part(const std::string &key) {
+    std::string ret = key;
+    for (size_t i = 0; i < ret.size(); ++i) {
+        char c = ret[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+              || (c >= '0' && c <= '9'))) {
+            ret[i] = '_';
+        }
+    }
+    return ret;
+}
+
+// Adds a line for each numeric stat under `stats` to `samples`, grouped by metric
+// name, because Prometheus wants all of a metric's samples together.
+static void collect_samples(const perfmon_result_t &stats,
+                            const std::string &name,
+                            const std::vector<std::string> &labels,
+                            std::map<std::string, std::vector<std::string> > *samples) {
+    if (stats.is_map()) {
+        for (auto it = stats.begin(); it != stats.end(); ++it) {
+            if (is_uuid(it->first)) {
+                const std::string label = labels.empty()
+                    ? "id" : strprintf("id_%zu", labels.size() + 1);
+                std::vector<std::string> child_labels = labels;
+                child_labels.push_back(label + "=\"" + it->first + "\"");
+                collect_samples(*it->second, name, child_labels, samples);
+            } else {
+                collect_samples(*it->second, name + "_" + metric_name_part(it->first),
+                                labels, samples);
+            }
+        }
+        return;
+    }
+
+    const std::string &value = *stats.get_string();
+    const char *begin = value.c_str();
+    char *end;
+    strtod(begin, &end);
+    if (end == begin || *end != '\0') {
+        return;
+    }
+    std::string line = name;
+    if (!labels.empty()) {
+        line += "{";
+        for (size_t i = 0; i < labels.size(); ++i) {
+            line += (i == 0 ? "" : ",") + labels[i];
+        }
+        line += "}";
+    }
+    (*samples)[name].push_back(line + " " + value + "\n");
+}
+
+std::string render_as_prometheus(const perfmon_result_t &stats) {
+    std::map<std::string, std::vector<std::string> > samples;
+    collect_samples(stats, "rethinkdb", std::vector<std::string>(), &samples);
+
+    std::string ret;
+    for (auto it = samples.begin(); it != samples.end(); ++it) {
+        ret += "# TYPE " + it->first + " untyped\n";
+        for (auto line = it->second.begin(); line != it->second.end(); ++line) {
+            ret += *line;
+        }
+    }
+    return ret;
+}
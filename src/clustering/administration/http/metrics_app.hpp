@@ -0,0 +1,30 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_METRICS_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_METRICS_APP_HPP_
+
+#include <string>
+
+#include "http/http.hpp"
+
+class perfmon_result_t;
+class perfmon_snapshotter_t;
+
+/* Serves this server's latest stats snapshot.  `GET /` returns it in the Prometheus
+text exposition format, and `GET /json` returns it as JSON along with how much each
+stat changed since the snapshot before. */
+class metrics_http_app_t : public http_app_t {
+public:
+    explicit metrics_http_app_t(perfmon_snapshotter_t *_snapshotter);
+    void handle(const http_req_t &req, http_res_t *result, signal_t *interruptor);
+
+private:
+    perfmon_snapshotter_t *snapshotter;
+
+    DISABLE_COPYING(metrics_http_app_t);
+};
+
+// Renders the numeric stats in `stats` as Prometheus metrics.  Stat paths become
+// metric names, except that UUIDs in them (like table IDs) become labels.
+std::string render_as_prometheus(const perfmon_result_t &stats);
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_METRICS_APP_HPP_ */
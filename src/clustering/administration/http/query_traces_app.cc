@@ -0,0 +1,45 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/http/query_traces_app.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "http/json.hpp"
+#include "rdb_protocol/query_trace_log.hpp"
+
+query_traces_http_app_t::query_traces_http_app_t(query_trace_log_t *_query_traces)
+    : query_traces(_query_traces) { }
+
+static bool slower(const traced_query_t &a, const traced_query_t &b) {
+    return a.duration_secs > b.duration_secs;
+}
+
+void query_traces_http_app_t::handle(const http_req_t &req, http_res_t *result,
+                                     signal_t *) {
+    if (req.method != GET) {
+        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        return;
+    }
+    std::string resource = req.resource.as_string();
+    if (resource != "/" && resource != "") {
+        *result = http_res_t(HTTP_NOT_FOUND);
+        return;
+    }
+
+    std::vector<traced_query_t> queries = query_traces->get_queries();
+    std::stable_sort(queries.begin(), queries.end(), &slower);
+
+    scoped_cJSON_t json(cJSON_CreateArray());
+    for (auto it = queries.begin(); it != queries.end(); ++it) {
+        scoped_cJSON_t entry(cJSON_CreateObject());
+        entry.AddItemToObject("query", cJSON_CreateString(it->query.c_str()));
+        entry.AddItemToObject("start_time",
+                              cJSON_CreateNumber(it->start_time / 1000000.0));
+        entry.AddItemToObject("duration", cJSON_CreateNumber(it->duration_secs));
+        cJSON *trace = it->trace_json.empty()
+            ? NULL : cJSON_Parse(it->trace_json.c_str());
+        entry.AddItemToObject("trace", trace != NULL ? trace : cJSON_CreateNull());
+        json.AddItemToArray(entry.release());
+    }
+    http_json_res(json.get(), result);
+}
@@ -0,0 +1,22 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_QUERY_TRACES_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_QUERY_TRACES_APP_HPP_
+
+#include "http/http.hpp"
+
+class query_trace_log_t;
+
+/* Serves the queries this server's `query_trace_log_t` kept, slowest first, with
+their traces if they were sampled. */
+class query_traces_http_app_t : public http_app_t {
+public:
+    explicit query_traces_http_app_t(query_trace_log_t *_query_traces);
+    void handle(const http_req_t &, http_res_t *result, signal_t *interruptor);
+
+private:
+    query_trace_log_t *query_traces;
+
+    DISABLE_COPYING(query_traces_http_app_t);
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_QUERY_TRACES_APP_HPP_ */
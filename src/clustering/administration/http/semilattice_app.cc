@@ -4,6 +4,7 @@
 
 #include "errors.hpp"
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/bind.hpp>
 
 #include "http/http.hpp"
 #include "clustering/administration/http/json_adapters.hpp"
@@ -18,7 +19,10 @@ semilattice_http_app_t<metadata_t>::semilattice_http_app_t(
         uuid_u _us) :
     directory_metadata(_directory_metadata),
     us(_us),
-    metadata_change_handler(_metadata_change_handler) {
+    metadata_change_handler(_metadata_change_handler),
+    root_history(boost::bind(&semilattice_http_app_t<metadata_t>::get_root, this, _1)),
+    metadata_subscription(boost::bind(&json_history_t::invalidate, &root_history),
+                          metadata_change_handler->get_view()) {
     // Do nothing
 }
 
@@ -37,7 +41,11 @@ void semilattice_http_app_t<metadata_t>::get_root(scoped_cJSON_t *json_out) {
 }
 
 template <class metadata_t>
-void semilattice_http_app_t<metadata_t>::handle(const http_req_t &req, http_res_t *result, signal_t *) {
+void semilattice_http_app_t<metadata_t>::handle(const http_req_t &req, http_res_t *result, signal_t *interruptor) {
+    if (req.method == GET && req.resource.begin() == req.resource.end()) {
+        root_history.handle_root_get(req, result, interruptor);
+        return;
+    }
     try {
         metadata_t metadata = metadata_change_handler->get();
 
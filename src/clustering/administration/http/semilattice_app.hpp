@@ -8,6 +8,7 @@
 #include "errors.hpp"
 #include <boost/optional.hpp>
 
+#include "clustering/administration/http/json_history.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "http/json.hpp"
 
@@ -47,6 +48,10 @@ private:
 
     metadata_change_handler_t<metadata_t> *metadata_change_handler;
 
+    // Answers GETs of the root, which the web UI polls.
+    json_history_t root_history;
+    typename semilattice_read_view_t<metadata_t>::subscription_t metadata_subscription;
+
     DISABLE_COPYING(semilattice_http_app_t);
 };
 
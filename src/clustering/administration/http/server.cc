@@ -1,13 +1,16 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/administration/http/server.hpp"
 
+#include "clustering/administration/http/coro_profiler_app.hpp"
 #include "clustering/administration/http/cyanide.hpp"
 #include "clustering/administration/http/directory_app.hpp"
 #include "clustering/administration/http/distribution_app.hpp"
 #include "clustering/administration/http/issues_app.hpp"
 #include "clustering/administration/http/last_seen_app.hpp"
 #include "clustering/administration/http/log_app.hpp"
+#include "clustering/administration/http/metrics_app.hpp"
 #include "clustering/administration/http/progress_app.hpp"
+#include "clustering/administration/http/query_traces_app.hpp"
 #include "clustering/administration/http/semilattice_app.hpp"
 #include "clustering/administration/http/stat_app.hpp"
 #include "clustering/administration/http/combining_app.hpp"
@@ -44,6 +47,8 @@ administrative_http_server_manager_t::administrative_http_server_manager_t(
         namespace_repo_t<rdb_protocol_t> *_rdb_namespace_repo,
         admin_tracker_t *_admin_tracker,
         http_app_t *reql_app,
+        query_trace_log_t *query_traces,
+        perfmon_snapshotter_t *perfmon_snapshotter,
         uuid_u _us,
         std::string path)
 {
@@ -236,6 +241,9 @@ administrative_http_server_manager_t::administrative_http_server_manager_t(
         _directory_metadata->subview(&get_log_mailbox),
         _directory_metadata->subview(&get_machine_id)));
     progress_app.init(new progress_app_t(_directory_metadata, mbox_manager));
+    query_traces_app.init(new query_traces_http_app_t(query_traces));
+    metrics_app.init(new metrics_http_app_t(perfmon_snapshotter));
+    coro_profiler_app.init(new coro_profiler_http_app_t);
     distribution_app.init(new distribution_app_t(metadata_field(&cluster_semilattice_metadata_t::memcached_namespaces, _semilattice_metadata), _namespace_repo,
                                                  metadata_field(&cluster_semilattice_metadata_t::rdb_namespaces, _semilattice_metadata), _rdb_namespace_repo));
 
@@ -250,6 +258,9 @@ administrative_http_server_manager_t::administrative_http_server_manager_t(
     ajax_routes["last_seen"] = last_seen_app.get();
     ajax_routes["log"] = log_app.get();
     ajax_routes["progress"] = progress_app.get();
+    ajax_routes["query_traces"] = query_traces_app.get();
+    ajax_routes["metrics"] = metrics_app.get();
+    ajax_routes["coro_profiler"] = coro_profiler_app.get();
     ajax_routes["distribution"] = distribution_app.get();
     ajax_routes["semilattice"] = cluster_semilattice_app.get();
     ajax_routes["auth"] = auth_semilattice_app.get();
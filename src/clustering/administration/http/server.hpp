@@ -25,9 +25,14 @@ class stat_http_app_t;
 class last_seen_http_app_t;
 class log_http_app_t;
 class progress_app_t;
+class query_traces_http_app_t;
+class query_trace_log_t;
+class metrics_http_app_t;
+class perfmon_snapshotter_t;
 class stat_manager_t;
 class distribution_app_t;
 class cyanide_http_app_t;
+class coro_profiler_http_app_t;
 class combining_http_app_t;
 
 class administrative_http_server_manager_t {
@@ -45,6 +50,8 @@ public:
         namespace_repo_t<rdb_protocol_t> *_rdb_namespace_repo,
         admin_tracker_t *_admin_tracker,
         http_app_t *reql_app,
+        query_trace_log_t *query_traces,
+        perfmon_snapshotter_t *perfmon_snapshotter,
         uuid_u _us,
         std::string _path);
     ~administrative_http_server_manager_t();
@@ -61,6 +68,9 @@ private:
     scoped_ptr_t<last_seen_http_app_t> last_seen_app;
     scoped_ptr_t<log_http_app_t> log_app;
     scoped_ptr_t<progress_app_t> progress_app;
+    scoped_ptr_t<query_traces_http_app_t> query_traces_app;
+    scoped_ptr_t<metrics_http_app_t> metrics_app;
+    scoped_ptr_t<coro_profiler_http_app_t> coro_profiler_app;
     scoped_ptr_t<distribution_app_t> distribution_app;
     scoped_ptr_t<combining_http_app_t> combining_app;
 #ifndef NDEBUG
@@ -207,5 +207,5 @@ void stat_http_app_t::handle(const http_req_t &req, http_res_t *result, signal_t
 
     cJSON_AddItemToObject(body.get(), "machines", prepare_machine_info(not_replied));
 
-    http_json_res(body.get(), result);
+    http_json_res(&body, result);
 }
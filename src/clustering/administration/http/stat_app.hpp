@@ -10,6 +10,9 @@
 #include "http/http.hpp"
 
 template <class> class watchable_t;
+class perfmon_result_t;
+
+cJSON *render_as_json(perfmon_result_t *target);
 
 class stat_http_app_t : public http_app_t {
 public:
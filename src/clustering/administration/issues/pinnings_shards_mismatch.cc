@@ -1,6 +1,8 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/administration/issues/pinnings_shards_mismatch.hpp"
 
+#include <utility>
+
 #include "clustering/administration/http/json_adapters.hpp"
 #include "http/json/json_adapter.hpp"
 #include "utils.hpp"
@@ -61,53 +63,76 @@ pinnings_shards_mismatch_issue_tracker_t<protocol_t>::pinnings_shards_mismatch_i
 template <class protocol_t>
 pinnings_shards_mismatch_issue_tracker_t<protocol_t>::~pinnings_shards_mismatch_issue_tracker_t() { }
 
+template <class protocol_t>
+static bool pinnings_mismatch_shards(
+        const nonoverlapping_regions_t<protocol_t> &shards,
+        const region_map_t<protocol_t, machine_id_t> &primary_pinnings,
+        const region_map_t<protocol_t, std::set<machine_id_t> > &secondary_pinnings) {
+    for (typename std::set<typename protocol_t::region_t>::iterator shit = shards.begin();
+         shit != shards.end(); ++shit) {
+        /* Check primary pinnings for problem. */
+        region_map_t<protocol_t, machine_id_t> primary_masked_pinnings = primary_pinnings.mask(*shit);
+
+        machine_id_t primary_expected_val = primary_masked_pinnings.begin()->second;
+        for (typename region_map_t<protocol_t, machine_id_t>::iterator pit = primary_masked_pinnings.begin();
+             pit != primary_masked_pinnings.end(); ++pit) {
+            if (pit->second != primary_expected_val) {
+                return true;
+            }
+        }
+
+        /* Check secondary pinnings for problem. */
+        region_map_t<protocol_t, std::set<machine_id_t> > secondary_masked_pinnings = secondary_pinnings.mask(*shit);
+
+        std::set<machine_id_t> secondary_expected_val = secondary_masked_pinnings.begin()->second;
+        for (typename region_map_t<protocol_t, std::set<machine_id_t> >::iterator pit  = secondary_masked_pinnings.begin();
+                                                                                  pit != secondary_masked_pinnings.end();
+                                                                                  ++pit) {
+            if (pit->second != secondary_expected_val) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 template <class protocol_t>
 std::list<clone_ptr_t<global_issue_t> > pinnings_shards_mismatch_issue_tracker_t<protocol_t>::get_issues() {
     std::list<clone_ptr_t<global_issue_t> > res;
 
     cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > namespaces = semilattice_view->get();
 
+    // Namespaces that were deleted drop out of the cache here.
+    pinnings_map_t pinnings;
     for (typename namespaces_semilattice_metadata_t<protocol_t>::namespace_map_t::const_iterator it = namespaces->namespaces.begin();
          it != namespaces->namespaces.end();
          ++it) {
         if (it->second.is_deleted()) {
             continue;
         }
-        nonoverlapping_regions_t<protocol_t> shards = it->second.get_ref().shards.get();
-        region_map_t<protocol_t, machine_id_t> primary_pinnings = it->second.get_ref().primary_pinnings.get();
-        region_map_t<protocol_t, std::set<machine_id_t> > secondary_pinnings = it->second.get_ref().secondary_pinnings.get();
-        for (typename std::set<typename protocol_t::region_t>::iterator shit = shards.begin();
-             shit != shards.end(); ++shit) {
-            /* Check primary pinnings for problem. */
-            region_map_t<protocol_t, machine_id_t> primary_masked_pinnings = primary_pinnings.mask(*shit);
-
-            machine_id_t primary_expected_val = primary_masked_pinnings.begin()->second;
-            for (typename region_map_t<protocol_t, machine_id_t>::iterator pit = primary_masked_pinnings.begin();
-                 pit != primary_masked_pinnings.end(); ++pit) {
-                if (pit->second != primary_expected_val) {
-                    res.push_back(clone_ptr_t<global_issue_t>(new pinnings_shards_mismatch_issue_t<protocol_t>(it->first, shards, primary_pinnings, secondary_pinnings)));
-                    goto namespace_has_issue;
-                }
-            }
-
-            /* Check secondary pinnings for problem. */
-            region_map_t<protocol_t, std::set<machine_id_t> > secondary_masked_pinnings = secondary_pinnings.mask(*shit);
-
-            std::set<machine_id_t> secondary_expected_val = secondary_masked_pinnings.begin()->second;
-            for (typename region_map_t<protocol_t, std::set<machine_id_t> >::iterator pit  = secondary_masked_pinnings.begin();
-                                                                                      pit != secondary_masked_pinnings.end();
-                                                                                      ++pit) {
-                if (pit->second!= secondary_expected_val) {
-                    res.push_back(clone_ptr_t<global_issue_t>(new pinnings_shards_mismatch_issue_t<protocol_t>(it->first, shards, primary_pinnings, secondary_pinnings)));
-                    goto namespace_has_issue;
-                }
-            }
+        const nonoverlapping_regions_t<protocol_t> &shards = it->second.get_ref().shards.get_ref();
+        const region_map_t<protocol_t, machine_id_t> &primary_pinnings = it->second.get_ref().primary_pinnings.get_ref();
+        const region_map_t<protocol_t, std::set<machine_id_t> > &secondary_pinnings = it->second.get_ref().secondary_pinnings.get_ref();
+
+        namespace_pinnings_t *entry = &pinnings[it->first];
+        typename pinnings_map_t::iterator last = last_pinnings.find(it->first);
+        if (last != last_pinnings.end()
+            && last->second.shards == shards
+            && last->second.primary_pinnings == primary_pinnings
+            && last->second.secondary_pinnings == secondary_pinnings) {
+            *entry = std::move(last->second);
+        } else {
+            entry->shards = shards;
+            entry->primary_pinnings = primary_pinnings;
+            entry->secondary_pinnings = secondary_pinnings;
+            entry->mismatched = pinnings_mismatch_shards(shards, primary_pinnings, secondary_pinnings);
         }
 
-    namespace_has_issue:
-        (void)0;
-        // do nothing, continue around loop.
+        if (entry->mismatched) {
+            res.push_back(clone_ptr_t<global_issue_t>(new pinnings_shards_mismatch_issue_t<protocol_t>(it->first, shards, primary_pinnings, secondary_pinnings)));
+        }
     }
+    last_pinnings.swap(pinnings);
 
     return res;
 }
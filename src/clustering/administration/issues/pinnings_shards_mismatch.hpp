@@ -3,6 +3,7 @@
 #define CLUSTERING_ADMINISTRATION_ISSUES_PINNINGS_SHARDS_MISMATCH_HPP_
 
 #include <list>
+#include <map>
 #include <set>
 #include <string>
 
@@ -46,8 +47,22 @@ public:
     std::list<clone_ptr_t<global_issue_t> > get_issues();
 
 private:
+    /* A namespace's shards and pinnings the last time `get_issues()` looked at it,
+    and whether they mismatched.  Masking the pinnings by every shard is slow for
+    big tables, and the admin UI polls constantly, so `get_issues()` only checks the
+    namespaces whose shards or pinnings changed since. */
+    struct namespace_pinnings_t {
+        nonoverlapping_regions_t<protocol_t> shards;
+        region_map_t<protocol_t, machine_id_t> primary_pinnings;
+        region_map_t<protocol_t, std::set<machine_id_t> > secondary_pinnings;
+        bool mismatched;
+    };
+    typedef std::map<namespace_id_t, namespace_pinnings_t> pinnings_map_t;
+
     boost::shared_ptr<semilattice_read_view_t<cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > > > semilattice_view;
 
+    pinnings_map_t last_pinnings;
+
     DISABLE_COPYING(pinnings_shards_mismatch_issue_tracker_t);
 };
 
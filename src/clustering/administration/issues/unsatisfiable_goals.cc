@@ -1,6 +1,8 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "clustering/administration/issues/unsatisfiable_goals.hpp"
 
+#include <utility>
+
 #include "rpc/semilattice/view.hpp"
 
 unsatisfiable_goals_issue_t::unsatisfiable_goals_issue_t(
@@ -76,44 +78,68 @@ static bool is_satisfiable(
     return true;
 }
 
+unsatisfiable_goals_issue_tracker_t::unsatisfiable_goals_issue_tracker_t(boost::shared_ptr<semilattice_read_view_t<cluster_semilattice_metadata_t> > _semilattice_view)
+    : semilattice_view(_semilattice_view) { }
+unsatisfiable_goals_issue_tracker_t::~unsatisfiable_goals_issue_tracker_t() { }
+
 template<class protocol_t>
-static void make_issues(const cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > &namespaces,
-        const std::map<datacenter_id_t, int> &actual_machines_in_datacenters,
+void unsatisfiable_goals_issue_tracker_t::make_issues(
+        const cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > &namespaces,
+        goals_map_t *goals_out,
         std::list<clone_ptr_t<global_issue_t> > *issues_out) {
     for (typename namespaces_semilattice_metadata_t<protocol_t>::namespace_map_t::const_iterator it = namespaces->namespaces.begin();
             it != namespaces->namespaces.end(); it++) {
         if (it->second.is_deleted()) {
             continue;
         }
-        namespace_semilattice_metadata_t<protocol_t> ns = it->second.get_ref();
+        const namespace_semilattice_metadata_t<protocol_t> &ns = it->second.get_ref();
         if (ns.primary_datacenter.in_conflict() || ns.replica_affinities.in_conflict()) {
             continue;
         }
-        if (!is_satisfiable(ns.primary_datacenter.get(), ns.replica_affinities.get(), actual_machines_in_datacenters)) {
+        const datacenter_id_t &primary_datacenter = ns.primary_datacenter.get_ref();
+        const std::map<datacenter_id_t, int32_t> &replica_affinities = ns.replica_affinities.get_ref();
+
+        namespace_goals_t *goals = &(*goals_out)[it->first];
+        typename goals_map_t::iterator last = last_goals.find(it->first);
+        if (last != last_goals.end()
+            && last->second.primary_datacenter == primary_datacenter
+            && last->second.replica_affinities == replica_affinities) {
+            *goals = std::move(last->second);
+        } else {
+            goals->primary_datacenter = primary_datacenter;
+            goals->replica_affinities = replica_affinities;
+            goals->satisfiable = is_satisfiable(primary_datacenter, replica_affinities, actual_machines_in_datacenters);
+        }
+
+        if (!goals->satisfiable) {
             issues_out->push_back(clone_ptr_t<global_issue_t>(
-                new unsatisfiable_goals_issue_t(it->first, ns.primary_datacenter.get(), ns.replica_affinities.get(), actual_machines_in_datacenters)));
+                new unsatisfiable_goals_issue_t(it->first, primary_datacenter, replica_affinities, actual_machines_in_datacenters)));
         }
     }
 }
 
-unsatisfiable_goals_issue_tracker_t::unsatisfiable_goals_issue_tracker_t(boost::shared_ptr<semilattice_read_view_t<cluster_semilattice_metadata_t> > _semilattice_view)
-    : semilattice_view(_semilattice_view) { }
-unsatisfiable_goals_issue_tracker_t::~unsatisfiable_goals_issue_tracker_t() { }
-
 std::list<clone_ptr_t<global_issue_t> > unsatisfiable_goals_issue_tracker_t::get_issues() {
     cluster_semilattice_metadata_t metadata = semilattice_view->get();
 
-    std::map<datacenter_id_t, int> actual_machines_in_datacenters;
+    std::map<datacenter_id_t, int> machines_in_datacenters;
     for (machines_semilattice_metadata_t::machine_map_t::iterator it = metadata.machines.machines.begin();
             it != metadata.machines.machines.end(); it++) {
         if (!it->second.is_deleted() && !it->second.get_ref().datacenter.in_conflict()) {
-            ++actual_machines_in_datacenters[it->second.get_ref().datacenter.get()];
+            ++machines_in_datacenters[it->second.get_ref().datacenter.get()];
         }
     }
+    if (machines_in_datacenters != actual_machines_in_datacenters) {
+        // Every namespace's goals have to be checked again.
+        actual_machines_in_datacenters.swap(machines_in_datacenters);
+        last_goals.clear();
+    }
 
+    // Namespaces that were deleted drop out of the cache here.
+    goals_map_t goals;
     std::list<clone_ptr_t<global_issue_t> > issues;
-    make_issues(metadata.rdb_namespaces, actual_machines_in_datacenters, &issues);
-    make_issues(metadata.dummy_namespaces, actual_machines_in_datacenters, &issues);
-    make_issues(metadata.memcached_namespaces, actual_machines_in_datacenters, &issues);
+    make_issues(metadata.rdb_namespaces, &goals, &issues);
+    make_issues(metadata.dummy_namespaces, &goals, &issues);
+    make_issues(metadata.memcached_namespaces, &goals, &issues);
+    last_goals.swap(goals);
     return issues;
 }
@@ -42,8 +42,27 @@ public:
     std::list<clone_ptr_t<global_issue_t> > get_issues();
 
 private:
+    /* The goals a namespace had the last time `get_issues()` looked at it, and
+    whether they could be met.  The admin UI polls constantly, so `get_issues()` only
+    checks the namespaces whose goals changed since (or all of them, if the
+    machines did). */
+    struct namespace_goals_t {
+        datacenter_id_t primary_datacenter;
+        std::map<datacenter_id_t, int32_t> replica_affinities;
+        bool satisfiable;
+    };
+    typedef std::map<namespace_id_t, namespace_goals_t> goals_map_t;
+
+    template <class protocol_t>
+    void make_issues(const cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > &namespaces,
+                     goals_map_t *goals_out,
+                     std::list<clone_ptr_t<global_issue_t> > *issues_out);
+
     boost::shared_ptr<semilattice_read_view_t<cluster_semilattice_metadata_t> > semilattice_view;
 
+    std::map<datacenter_id_t, int> actual_machines_in_datacenters;
+    goals_map_t last_goals;
+
     DISABLE_COPYING(unsatisfiable_goals_issue_tracker_t);
 };
 
@@ -20,10 +20,15 @@
 
 #include <functional>
 
+#include "arch/buffer_arena.hpp"
 #include "arch/io/disk.hpp"
+#include "arch/io/tls.hpp"
+#include "arch/memory_stats.hpp"
 #include "arch/os_signal.hpp"
+#include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/starter.hpp"
 #include "extproc/extproc_spawner.hpp"
+#include "extproc/js_runner.hpp"
 #include "clustering/administration/cli/admin_command_parser.hpp"
 #include "clustering/administration/main/names.hpp"
 #include "clustering/administration/main/options.hpp"
@@ -35,6 +40,7 @@
 #include "clustering/administration/persist.hpp"
 #include "logger.hpp"
 #include "mock/dummy_protocol.hpp"
+#include "rpc/connectivity/cluster.hpp"
 #include "utils.hpp"
 
 #define RETHINKDB_EXPORT_SCRIPT "rethinkdb-export"
@@ -308,16 +314,29 @@ public:
     serve_info_t(const std::vector<host_and_port_t> &_joins,
                  service_address_ports_t _ports,
                  std::string _web_assets,
-                 boost::optional<std::string> _config_file):
+                 boost::optional<std::string> _config_file,
+                 uint64_t _total_cache_size,
+                 bool _share_table_files,
+                 const table_file_options_t &_table_file_options,
+                 const query_capture_options_t &_query_capture_options):
         joins(&_joins),
         ports(_ports),
         web_assets(_web_assets),
-        config_file(_config_file) { }
+        config_file(_config_file),
+        total_cache_size(_total_cache_size),
+        share_table_files(_share_table_files),
+        table_file_options(_table_file_options),
+        query_capture_options(_query_capture_options) { }
 
     const std::vector<host_and_port_t> *joins;
     service_address_ports_t ports;
     std::string web_assets;
     boost::optional<std::string> config_file;
+    // Zero if the tables' caches aren't balanced.
+    uint64_t total_cache_size;
+    bool share_table_files;
+    table_file_options_t table_file_options;
+    query_capture_options_t query_capture_options;
 };
 
 // Used for options that don't take parameters, such as --help or --exit-failure, tells whether the
@@ -603,6 +622,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
                           const name_string_t &machine_name,
                           const file_direct_io_mode_t direct_io_mode,
                           const int max_concurrent_io_requests,
+                          const file_io_backend_t io_backend,
                           bool *const result_out) {
     machine_id_t our_machine_id = generate_uuid();
 
@@ -614,7 +634,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
     machine_semilattice_metadata.datacenter = vclock_t<datacenter_id_t>(nil_uuid(), our_machine_id);
     cluster_metadata.machines.machines.insert(std::make_pair(our_machine_id, make_deletable(machine_semilattice_metadata)));
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, io_backend);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -709,6 +729,7 @@ void run_rethinkdb_serve(const base_path_t &base_path,
                          const serve_info_t &serve_info,
                          const file_direct_io_mode_t direct_io_mode,
                          const int max_concurrent_io_requests,
+                         const file_io_backend_t io_backend,
                          const machine_id_t *our_machine_id,
                          const cluster_semilattice_metadata_t *cluster_metadata,
                          directory_lock_t *data_directory_lock,
@@ -719,7 +740,7 @@ void run_rethinkdb_serve(const base_path_t &base_path,
 
     logINF("Loading data from directory %s\n", base_path.path().c_str());
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, io_backend);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -765,7 +786,11 @@ void run_rethinkdb_serve(const base_path_t &base_path,
                             serve_info.ports,
                             serve_info.web_assets,
                             &sigint_cond,
-                            serve_info.config_file);
+                            serve_info.config_file,
+                            serve_info.total_cache_size,
+                            serve_info.share_table_files,
+                            serve_info.table_file_options,
+                            serve_info.query_capture_options);
 
     } catch (const metadata_persistence::file_in_use_exc_t &ex) {
         logINF("Directory '%s' is in use by another rethinkdb process.\n", base_path.path().c_str());
@@ -780,13 +805,14 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
                              const name_string_t &machine_name,
                              const file_direct_io_mode_t direct_io_mode,
                              const int max_concurrent_io_requests,
+                             const file_io_backend_t io_backend,
                              const bool new_directory,
                              const serve_info_t &serve_info,
                              directory_lock_t *data_directory_lock,
                              bool *const result_out) {
     if (!new_directory) {
         run_rethinkdb_serve(base_path, serve_info,
-                            direct_io_mode, max_concurrent_io_requests,
+                            direct_io_mode, max_concurrent_io_requests, io_backend,
                             NULL, NULL, data_directory_lock,
                             result_out);
     } else {
@@ -819,7 +845,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
         }
 
         run_rethinkdb_serve(base_path, serve_info,
-                            direct_io_mode, max_concurrent_io_requests,
+                            direct_io_mode, max_concurrent_io_requests, io_backend,
                             &our_machine_id, &cluster_metadata,
                             data_directory_lock, result_out);
     }
@@ -834,7 +860,8 @@ void run_rethinkdb_proxy(const serve_info_t &serve_info, bool *const result_out)
                                   serve_info.ports,
                                   serve_info.web_assets,
                                   &sigint_cond,
-                                  serve_info.config_file);
+                                  serve_info.config_file,
+                                  serve_info.query_capture_options);
     } catch (const host_lookup_exc_t &ex) {
         logERR("%s\n", ex.what());
         *result_out = false;
@@ -875,6 +902,38 @@ options::help_section_t get_file_options(std::vector<options::option_t> *options
     options_out->push_back(options::option_t(options::names_t("--no-direct-io"),
                                              options::OPTIONAL_NO_PARAMETER));
     help.add("--no-direct-io", "disable direct I/O");
+    options_out->push_back(options::option_t(options::names_t("--share-table-files"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--share-table-files",
+             "store new tables in files shared with other tables, instead of a file "
+             "per table (for servers with many small tables)");
+    options_out->push_back(options::option_t(options::names_t("--stripe-directory"),
+                                             options::OPTIONAL_REPEAT));
+    help.add("--stripe-directory path",
+             "also spread new tables' files over this directory, usually on another "
+             "device (may be given more than once; tables keep the stripe "
+             "directories they were created with)");
+    options_out->push_back(options::option_t(options::names_t("--ssd-cache-directory"),
+                                             options::OPTIONAL));
+    help.add("--ssd-cache-directory path",
+             "keep a cache of each table's recently read blocks in this directory, "
+             "usually on an SSD in front of slower data devices");
+    options_out->push_back(options::option_t(options::names_t("--ssd-cache-size"),
+                                             options::OPTIONAL,
+                                             strprintf("%d", DEFAULT_SSD_CACHE_SIZE_MB)));
+    help.add("--ssd-cache-size mb",
+             "the size of each table's SSD cache, in megabytes");
+    options_out->push_back(options::option_t(options::names_t("--defragment-interval"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--defragment-interval secs",
+             "rewrite each table's btree leaves in key order this often, to keep range "
+             "scans fast after many deletes (0, the default, disables it)");
+    options_out->push_back(options::option_t(options::names_t("--io-backend"),
+                                             options::OPTIONAL,
+                                             "pool"));
+    help.add("--io-backend {pool|uring}",
+             "run disk I/O on a thread pool or through io_uring (Linux 5.2+)");
     return help;
 }
 
@@ -948,6 +1007,35 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
                                              options::OPTIONAL_REPEAT));
     help.add("--canonical-address addr", "address that other rethinkdb instances will use to connect to us, can be specified multiple times");
 
+    options_out->push_back(options::option_t(options::names_t("--cluster-compression"),
+                                             options::OPTIONAL,
+                                             "none"));
+    help.add("--cluster-compression {none|bulk|all}",
+             "offer to compress backfills (bulk), or backfills and queries (all), on "
+             "connections to other nodes that offer the same");
+
+    return help;
+}
+
+options::help_section_t get_tls_options(std::vector<options::option_t> *options_out) {
+    options::help_section_t help("TLS options");
+    options_out->push_back(options::option_t(options::names_t("--driver-tls"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--driver-tls", "require TLS on the client driver port");
+    options_out->push_back(options::option_t(options::names_t("--cluster-tls"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--cluster-tls",
+             "require TLS on connections between nodes, with every node offering a "
+             "certificate signed by the --tls-ca");
+    options_out->push_back(options::option_t(options::names_t("--tls-cert"),
+                                             options::OPTIONAL));
+    help.add("--tls-cert file", "certificate chain (PEM) to offer clients and other nodes");
+    options_out->push_back(options::option_t(options::names_t("--tls-key"),
+                                             options::OPTIONAL));
+    help.add("--tls-key file", "private key (PEM) for the --tls-cert");
+    options_out->push_back(options::option_t(options::names_t("--tls-ca"),
+                                             options::OPTIONAL));
+    help.add("--tls-ca file", "CA certificates (PEM) to check other nodes' certificates against");
     return help;
 }
 
@@ -957,9 +1045,141 @@ options::help_section_t get_cpu_options(std::vector<options::option_t> *options_
                                              options::OPTIONAL,
                                              strprintf("%d", get_cpu_count())));
     help.add("-c [ --cores ] n", "the number of cores to use");
+    options_out->push_back(options::option_t(options::names_t("--busy-poll"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--busy-poll usec",
+             "keep polling for events this long after a thread was last busy instead "
+             "of going to sleep, to cut wakeup latency (0, the default, disables it)");
+    options_out->push_back(options::option_t(options::names_t("--pin-threads"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--pin-threads",
+             "pin each thread to a core, keeping each table's threads and memory on "
+             "one NUMA node where possible");
     return help;
 }
 
+options::help_section_t get_cache_options(std::vector<options::option_t> *options_out) {
+    options::help_section_t help("Cache options");
+    options_out->push_back(options::option_t(options::names_t("--cache-size"),
+                                             options::OPTIONAL));
+    help.add("--cache-size {mb|auto}",
+             "total memory for the tables' caches, shared between them according to "
+             "use and given back when memory runs short; 'auto' is half the memory "
+             "of the machine or container (by default each table gets its own fixed "
+             "cache size)");
+    options_out->push_back(options::option_t(options::names_t("--huge-pages"),
+                                             options::OPTIONAL,
+                                             "off"));
+    help.add("--huge-pages {off|transparent|explicit}",
+             "keep cached blocks in transparent huge pages, or in huge pages from the "
+             "hugetlbfs pool falling back to transparent ones");
+    return help;
+}
+
+MUST_USE bool parse_cache_size_option(const std::map<std::string, options::values_t> &opts,
+                                      uint64_t *total_cache_size_out) {
+    if (!exists_option(opts, "--cache-size")) {
+        *total_cache_size_out = 0;
+        return true;
+    }
+    if (get_single_option(opts, "--cache-size") == "auto") {
+        *total_cache_size_out = static_cast<uint64_t>(
+            get_memory_limit() * DEFAULT_MAX_CACHE_RATIO);
+        return true;
+    }
+    const int cache_size_mb = get_single_int(opts, "--cache-size");
+    if (cache_size_mb <= 0) {
+        fprintf(stderr, "ERROR: cache-size must be a positive number of megabytes\n");
+        return false;
+    }
+    *total_cache_size_out = static_cast<uint64_t>(cache_size_mb) * MEGABYTE;
+    return true;
+}
+
+MUST_USE bool parse_huge_pages_option(const std::map<std::string, options::values_t> &opts,
+                                      huge_page_mode_t *huge_page_mode_out) {
+    const std::string huge_pages = get_single_option(opts, "--huge-pages");
+    if (huge_pages == "off") {
+        *huge_page_mode_out = huge_page_mode_t::disabled;
+    } else if (huge_pages == "transparent") {
+        *huge_page_mode_out = huge_page_mode_t::transparent_desired;
+    } else if (huge_pages == "explicit") {
+        *huge_page_mode_out = huge_page_mode_t::explicit_desired;
+    } else {
+        fprintf(stderr, "ERROR: huge-pages must be 'off', 'transparent' or 'explicit'\n");
+        return false;
+    }
+    return true;
+}
+
+MUST_USE bool parse_busy_poll_option(const std::map<std::string, options::values_t> &opts) {
+    int busy_poll_usec = get_single_int(opts, "--busy-poll");
+    if (busy_poll_usec < 0 || busy_poll_usec > MAX_EVENT_QUEUE_BUSY_POLL_USEC) {
+        fprintf(stderr, "ERROR: busy-poll must be between 0 and %d microseconds\n",
+                MAX_EVENT_QUEUE_BUSY_POLL_USEC);
+        return false;
+    }
+    set_event_queue_busy_poll_usec(busy_poll_usec);
+    return true;
+}
+
+// Loads the contexts into `driver_tls_out` and `cluster_tls_out`, which must outlive
+// the thread pool, and makes them the process-wide ones.
+MUST_USE bool parse_tls_options(const std::map<std::string, options::values_t> &opts,
+                                scoped_ptr_t<tls_ctx_t> *driver_tls_out,
+                                scoped_ptr_t<tls_ctx_t> *cluster_tls_out) {
+    const bool driver_tls = exists_option(opts, "--driver-tls");
+    const bool cluster_tls = exists_option(opts, "--cluster-tls");
+    if (!driver_tls && !cluster_tls) {
+        return true;
+    }
+
+    const boost::optional<std::string> cert = get_optional_option(opts, "--tls-cert");
+    const boost::optional<std::string> key = get_optional_option(opts, "--tls-key");
+    const boost::optional<std::string> ca = get_optional_option(opts, "--tls-ca");
+    if (!cert || !key) {
+        fprintf(stderr, "ERROR: driver-tls and cluster-tls need a tls-cert and a tls-key\n");
+        return false;
+    }
+    if (cluster_tls && !ca) {
+        fprintf(stderr, "ERROR: cluster-tls needs a tls-ca to check other nodes against\n");
+        return false;
+    }
+
+    try {
+        if (driver_tls) {
+            driver_tls_out->init(new tls_ctx_t(*cert, *key, ""));
+            set_driver_tls_ctx(driver_tls_out->get());
+        }
+        if (cluster_tls) {
+            cluster_tls_out->init(new tls_ctx_t(*cert, *key, *ca));
+            set_cluster_tls_ctx(cluster_tls_out->get());
+        }
+    } catch (const tls_error_exc_t &ex) {
+        fprintf(stderr, "ERROR: %s\n", ex.what());
+        return false;
+    }
+    return true;
+}
+
+MUST_USE bool parse_cluster_compression_option(const std::map<std::string, options::values_t> &opts) {
+    const std::string compression = get_single_option(opts, "--cluster-compression");
+    const uint8_t bulk = 1 << static_cast<int>(message_class_t::bulk);
+    const uint8_t query = 1 << static_cast<int>(message_class_t::query);
+    if (compression == "none") {
+        set_cluster_compressed_classes(0);
+    } else if (compression == "bulk") {
+        set_cluster_compressed_classes(bulk);
+    } else if (compression == "all") {
+        set_cluster_compressed_classes(bulk | query);
+    } else {
+        fprintf(stderr, "ERROR: cluster-compression must be 'none', 'bulk' or 'all'\n");
+        return false;
+    }
+    return true;
+}
+
 MUST_USE bool parse_cores_option(const std::map<std::string, options::values_t> &opts,
                                  int *num_workers_out) {
     int num_workers = get_single_int(opts, "--cores");
@@ -971,6 +1191,52 @@ MUST_USE bool parse_cores_option(const std::map<std::string, options::values_t>
     return true;
 }
 
+options::help_section_t get_query_capture_options(std::vector<options::option_t> *options_out) {
+    options::help_section_t help("Query capture options");
+    options_out->push_back(options::option_t(options::names_t("--capture-queries"),
+                                             options::OPTIONAL));
+    help.add("--capture-queries file",
+             "write the queries clients send to a file, for test/performance/replay.py "
+             "to replay against a test cluster");
+    options_out->push_back(options::option_t(options::names_t("--capture-queries-sample"),
+                                             options::OPTIONAL,
+                                             "1"));
+    help.add("--capture-queries-sample n",
+             "only capture the queries of one in every n client connections");
+    return help;
+}
+
+MUST_USE bool parse_query_capture_options(const std::map<std::string, options::values_t> &opts,
+                                          query_capture_options_t *options_out) {
+    options_out->file = get_optional_option(opts, "--capture-queries");
+    options_out->connection_sample_interval = get_single_int(opts, "--capture-queries-sample");
+    if (options_out->connection_sample_interval <= 0) {
+        fprintf(stderr, "ERROR: capture-queries-sample must be a positive number\n");
+        return false;
+    }
+    return true;
+}
+
+options::help_section_t get_js_options(std::vector<options::option_t> *options_out) {
+    options::help_section_t help("JavaScript options");
+    options_out->push_back(options::option_t(options::names_t("--js-in-process"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--js-in-process",
+             "run r.js functions inside the server process instead of in worker "
+             "processes, which is much faster, but lets a script that crashes the "
+             "JavaScript engine take the server down with it");
+    return help;
+}
+
+MUST_USE bool parse_js_options(const std::map<std::string, options::values_t> &opts) {
+    if (!set_js_in_process(exists_option(opts, "--js-in-process"))) {
+        fprintf(stderr, "ERROR: js-in-process needs a newer version of V8 than this "
+                "rethinkdb was built with\n");
+        return false;
+    }
+    return true;
+}
+
 options::help_section_t get_service_options(std::vector<options::option_t> *options_out) {
     options::help_section_t help("Service options");
     options_out->push_back(options::option_t(options::names_t("--pid-file"),
@@ -1019,8 +1285,12 @@ void get_rethinkdb_serve_options(std::vector<options::help_section_t> *help_out,
                                  std::vector<options::option_t> *options_out) {
     help_out->push_back(get_file_options(options_out));
     help_out->push_back(get_network_options(false, options_out));
+    help_out->push_back(get_tls_options(options_out));
     help_out->push_back(get_web_options(options_out));
     help_out->push_back(get_cpu_options(options_out));
+    help_out->push_back(get_cache_options(options_out));
+    help_out->push_back(get_query_capture_options(options_out));
+    help_out->push_back(get_js_options(options_out));
     help_out->push_back(get_service_options(options_out));
     help_out->push_back(get_setuser_options(options_out));
     help_out->push_back(get_help_options(options_out));
@@ -1031,7 +1301,10 @@ void get_rethinkdb_serve_options(std::vector<options::help_section_t> *help_out,
 void get_rethinkdb_proxy_options(std::vector<options::help_section_t> *help_out,
                                  std::vector<options::option_t> *options_out) {
     help_out->push_back(get_network_options(true, options_out));
+    help_out->push_back(get_tls_options(options_out));
     help_out->push_back(get_web_options(options_out));
+    help_out->push_back(get_query_capture_options(options_out));
+    help_out->push_back(get_js_options(options_out));
     help_out->push_back(get_service_options(options_out));
     help_out->push_back(get_setuser_options(options_out));
     help_out->push_back(get_help_options(options_out));
@@ -1064,6 +1337,7 @@ void get_rethinkdb_admin_options(std::vector<options::help_section_t> *help_out,
     help.add("-x [ --exit-failure ]", "exit with an error code immediately if a command fails");
 
     help_out->push_back(help);
+    help_out->push_back(get_tls_options(options_out));
 }
 
 void get_rethinkdb_porcelain_options(std::vector<options::help_section_t> *help_out,
@@ -1071,8 +1345,12 @@ void get_rethinkdb_porcelain_options(std::vector<options::help_section_t> *help_
     help_out->push_back(get_file_options(options_out));
     help_out->push_back(get_machine_options(options_out));
     help_out->push_back(get_network_options(false, options_out));
+    help_out->push_back(get_tls_options(options_out));
     help_out->push_back(get_web_options(options_out));
     help_out->push_back(get_cpu_options(options_out));
+    help_out->push_back(get_cache_options(options_out));
+    help_out->push_back(get_query_capture_options(options_out));
+    help_out->push_back(get_js_options(options_out));
     help_out->push_back(get_service_options(options_out));
     help_out->push_back(get_setuser_options(options_out));
     help_out->push_back(get_help_options(options_out));
@@ -1146,12 +1424,90 @@ MUST_USE bool parse_io_threads_option(const std::map<std::string, options::value
     return true;
 }
 
+// Makes the --stripe-directory paths absolute and gives each of them a fresh
+// temporary directory, like the data directory's.
+MUST_USE bool parse_stripe_directory_options(const std::map<std::string, options::values_t> &opts,
+                                             std::vector<base_path_t> *stripe_paths_out) {
+    const std::vector<std::string> &paths = all_options(opts, "--stripe-directory");
+    for (auto it = paths.begin(); it != paths.end(); ++it) {
+        if (::access(it->c_str(), R_OK | W_OK | X_OK) != 0) {
+            fprintf(stderr, "ERROR: stripe directory '%s' is not accessible: %s\n",
+                    it->c_str(), errno_string(get_errno()).c_str());
+            return false;
+        }
+        base_path_t stripe_path(*it);
+        stripe_path.make_absolute();
+        recreate_temporary_directory(stripe_path);
+        stripe_paths_out->push_back(stripe_path);
+    }
+    return true;
+}
+
+MUST_USE bool parse_ssd_cache_options(const std::map<std::string, options::values_t> &opts,
+                                      boost::optional<base_path_t> *ssd_cache_path_out,
+                                      int64_t *ssd_cache_size_out) {
+    const boost::optional<std::string> path
+        = get_optional_option(opts, "--ssd-cache-directory");
+    if (!path) {
+        return true;
+    }
+    if (::access(path->c_str(), R_OK | W_OK | X_OK) != 0) {
+        fprintf(stderr, "ERROR: SSD cache directory '%s' is not accessible: %s\n",
+                path->c_str(), errno_string(get_errno()).c_str());
+        return false;
+    }
+    const int size_mb = get_single_int(opts, "--ssd-cache-size");
+    if (size_mb <= 0) {
+        fprintf(stderr, "ERROR: ssd-cache-size must be a positive number of megabytes\n");
+        return false;
+    }
+    base_path_t ssd_cache_path(*path);
+    ssd_cache_path.make_absolute();
+    *ssd_cache_path_out = ssd_cache_path;
+    *ssd_cache_size_out = static_cast<int64_t>(size_mb) * MEGABYTE;
+    return true;
+}
+
+MUST_USE bool parse_defragment_interval_option(const std::map<std::string, options::values_t> &opts,
+                                               int64_t *defragment_interval_secs_out) {
+    const int interval_secs = get_single_int(opts, "--defragment-interval");
+    if (interval_secs < 0) {
+        fprintf(stderr, "ERROR: defragment-interval must not be negative\n");
+        return false;
+    }
+    *defragment_interval_secs_out = interval_secs;
+    return true;
+}
+
+MUST_USE bool parse_table_file_options(const std::map<std::string, options::values_t> &opts,
+                                       table_file_options_t *table_file_options_out) {
+    return parse_stripe_directory_options(opts, &table_file_options_out->stripe_paths)
+        && parse_ssd_cache_options(opts, &table_file_options_out->ssd_cache_path,
+                                   &table_file_options_out->ssd_cache_size)
+        && parse_defragment_interval_option(
+            opts, &table_file_options_out->defragment_interval_secs);
+}
+
 file_direct_io_mode_t parse_direct_io_mode_option(const std::map<std::string, options::values_t> &opts) {
     return exists_option(opts, "--no-direct-io") ?
         file_direct_io_mode_t::buffered_desired :
         file_direct_io_mode_t::direct_desired;
 }
 
+MUST_USE bool parse_io_backend_option(const std::map<std::string, options::values_t> &opts,
+                                      file_io_backend_t *io_backend_out) {
+    const std::string io_backend = get_single_option(opts, "--io-backend");
+    if (io_backend == "pool") {
+        *io_backend_out = file_io_backend_t::pool;
+    } else if (io_backend == "uring") {
+        *io_backend_out = file_io_backend_t::uring_desired;
+    } else {
+        fprintf(stderr, "ERROR: io-backend must be either 'pool' or 'uring'\n");
+        return false;
+    }
+    return true;
+}
+
 int main_rethinkdb_create(int argc, char *argv[]) {
     std::vector<options::option_t> options;
     std::vector<options::help_section_t> help;
@@ -1182,6 +1538,11 @@ int main_rethinkdb_create(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        file_io_backend_t io_backend;
+        if (!parse_io_backend_option(opts, &io_backend)) {
+            return EXIT_FAILURE;
+        }
+
         const int num_workers = get_cpu_count();
 
         bool is_new_directory = false;
@@ -1203,6 +1564,7 @@ int main_rethinkdb_create(int argc, char *argv[]) {
                                      machine_name,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      &result),
                            num_workers);
 
@@ -1288,11 +1650,48 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        if (!parse_busy_poll_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
             return EXIT_FAILURE;
         }
 
+        file_io_backend_t io_backend;
+        if (!parse_io_backend_option(opts, &io_backend)) {
+            return EXIT_FAILURE;
+        }
+
+        uint64_t total_cache_size;
+        if (!parse_cache_size_option(opts, &total_cache_size)) {
+            return EXIT_FAILURE;
+        }
+
+        query_capture_options_t query_capture_options;
+        if (!parse_query_capture_options(opts, &query_capture_options)) {
+            return EXIT_FAILURE;
+        }
+
+        huge_page_mode_t huge_page_mode;
+        if (!parse_huge_pages_option(opts, &huge_page_mode)) {
+            return EXIT_FAILURE;
+        }
+
+        scoped_ptr_t<tls_ctx_t> driver_tls, cluster_tls;
+        if (!parse_tls_options(opts, &driver_tls, &cluster_tls)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_cluster_compression_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_js_options(opts)) {
+            return EXIT_FAILURE;
+        }
+
         // Open and lock the directory, but do not create it
         bool is_new_directory = false;
         directory_lock_t data_directory_lock(base_path, false, &is_new_directory);
@@ -1303,6 +1702,11 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
         base_path.make_absolute();
         initialize_logfile(opts, base_path);
 
+        table_file_options_t table_file_options;
+        if (!parse_table_file_options(opts, &table_file_options)) {
+            return EXIT_FAILURE;
+        }
+
         if (check_pid_file(opts) != EXIT_SUCCESS) {
             return EXIT_FAILURE;
         }
@@ -1319,20 +1723,27 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
         extproc_spawner_t extproc_spawner;
 
         serve_info_t serve_info(joins, address_ports, web_path,
-                                get_optional_option(opts, "--config-file"));
+                                get_optional_option(opts, "--config-file"),
+                                total_cache_size,
+                                exists_option(opts, "--share-table-files"),
+                                table_file_options,
+                                query_capture_options);
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
 
+        init_buffer_arena(huge_page_mode);
+
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_serve, base_path,
                                      serve_info,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      static_cast<machine_id_t*>(NULL),
                                      static_cast<cluster_semilattice_metadata_t*>(NULL),
                                      &data_directory_lock,
                                      &result),
-                           num_workers);
+                           num_workers, exists_option(opts, "--pin-threads"));
         return result ? EXIT_SUCCESS : EXIT_FAILURE;
     } catch (const options::named_error_t &ex) {
         output_named_error(ex, help);
@@ -1369,6 +1780,11 @@ int main_rethinkdb_admin(int argc, char *argv[]) {
 
         const bool exit_on_failure = exists_option(opts, "--exit-failure");
 
+        scoped_ptr_t<tls_ctx_t> driver_tls, cluster_tls;
+        if (!parse_tls_options(opts, &driver_tls, &cluster_tls)) {
+            return EXIT_FAILURE;
+        }
+
         const int num_workers = get_cpu_count();
 
         bool result;
@@ -1411,6 +1827,19 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        scoped_ptr_t<tls_ctx_t> driver_tls, cluster_tls;
+        if (!parse_tls_options(opts, &driver_tls, &cluster_tls)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_cluster_compression_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_js_options(opts)) {
+            return EXIT_FAILURE;
+        }
+
         set_user_group(opts);
 
         // Default to putting the log file in the current working directory
@@ -1435,8 +1864,17 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
 
         extproc_spawner_t extproc_spawner;
 
+        query_capture_options_t query_capture_options;
+        if (!parse_query_capture_options(opts, &query_capture_options)) {
+            return EXIT_FAILURE;
+        }
+
         serve_info_t serve_info(joins, address_ports, web_path,
-                                get_optional_option(opts, "--config-file"));
+                                get_optional_option(opts, "--config-file"),
+                                0,
+                                false,
+                                table_file_options_t(),
+                                query_capture_options);
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_proxy, serve_info, &result),
@@ -1544,11 +1982,48 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        if (!parse_busy_poll_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
             return EXIT_FAILURE;
         }
 
+        file_io_backend_t io_backend;
+        if (!parse_io_backend_option(opts, &io_backend)) {
+            return EXIT_FAILURE;
+        }
+
+        uint64_t total_cache_size;
+        if (!parse_cache_size_option(opts, &total_cache_size)) {
+            return EXIT_FAILURE;
+        }
+
+        query_capture_options_t query_capture_options;
+        if (!parse_query_capture_options(opts, &query_capture_options)) {
+            return EXIT_FAILURE;
+        }
+
+        huge_page_mode_t huge_page_mode;
+        if (!parse_huge_pages_option(opts, &huge_page_mode)) {
+            return EXIT_FAILURE;
+        }
+
+        scoped_ptr_t<tls_ctx_t> driver_tls, cluster_tls;
+        if (!parse_tls_options(opts, &driver_tls, &cluster_tls)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_cluster_compression_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_js_options(opts)) {
+            return EXIT_FAILURE;
+        }
+
         // Attempt to create the directory early so that the log file can use it.
         // If we create the file, it will be cleaned up unless directory_initialized()
         // is called on it.  This will be done after the metadata files have been created.
@@ -1560,6 +2035,11 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
         base_path.make_absolute();
         initialize_logfile(opts, base_path);
 
+        table_file_options_t table_file_options;
+        if (!parse_table_file_options(opts, &table_file_options)) {
+            return EXIT_FAILURE;
+        }
+
         if (check_pid_file(opts) != EXIT_SUCCESS) {
             return EXIT_FAILURE;
         }
@@ -1579,21 +2059,28 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
         extproc_spawner_t extproc_spawner;
 
         serve_info_t serve_info(joins, address_ports, web_path,
-                                get_optional_option(opts, "--config-file"));
+                                get_optional_option(opts, "--config-file"),
+                                total_cache_size,
+                                exists_option(opts, "--share-table-files"),
+                                table_file_options,
+                                query_capture_options);
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
 
+        init_buffer_arena(huge_page_mode);
+
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_porcelain,
                                      base_path,
                                      machine_name,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      is_new_directory,
                                      serve_info,
                                      &data_directory_lock,
                                      &result),
-                           num_workers);
+                           num_workers, exists_option(opts, "--pin-threads"));
 
         return result ? EXIT_SUCCESS : EXIT_FAILURE;
     } catch (const options::named_error_t &ex) {
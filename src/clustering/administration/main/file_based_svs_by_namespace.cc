@@ -1,8 +1,16 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "clustering/administration/main/file_based_svs_by_namespace.hpp"
 
+#include "arch/runtime/runtime.hpp"
+#include "btree/btree_store.hpp"
+#include "btree/slice.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "clustering/administration/main/shared_table_files.hpp"
 #include "clustering/immediate_consistency/branch/multistore.hpp"
 #include "clustering/reactor/reactor.hpp"
+#include "config/args.hpp"
+#include "logger.hpp"
+#include "mock/dummy_protocol.hpp"
 #include "serializer/config.hpp"
 #include "serializer/translator.hpp"
 #include "serializer/merger.hpp"
@@ -15,32 +23,95 @@ template <class protocol_t>
 struct store_args_t {
     store_args_t(io_backender_t *_io_backender, const base_path_t &_base_path,
             namespace_id_t _namespace_id, int64_t _cache_size,
+            int _inline_value_size, int64_t _write_buffer_size,
+            int64_t _defragment_interval_secs,
             perfmon_collection_t *_serializers_perfmon_collection, typename
-            protocol_t::context_t *_ctx)
+            protocol_t::context_t *_ctx, const std::string &_serializer_path)
         : io_backender(_io_backender), base_path(_base_path),
           namespace_id(_namespace_id), cache_size(_cache_size),
+          inline_value_size(_inline_value_size),
+          write_buffer_size(_write_buffer_size),
+          defragment_interval_secs(_defragment_interval_secs),
           serializers_perfmon_collection(_serializers_perfmon_collection),
-          ctx(_ctx)
+          ctx(_ctx), serializer_path(_serializer_path)
     { }
 
     io_backender_t *io_backender;
     base_path_t base_path;
     namespace_id_t namespace_id;
     int64_t cache_size;
+    int inline_value_size;
+    int64_t write_buffer_size;
+    int64_t defragment_interval_secs;
     perfmon_collection_t *serializers_perfmon_collection;
     typename protocol_t::context_t *ctx;
+    std::string serializer_path;
 };
 
 std::string hash_shard_perfmon_name(int hash_shard_number) {
     return strprintf("shard_%d", hash_shard_number);
 }
 
+// Each store's cache keeps its warm-cache manifest next to the table's data file.
+std::string warm_manifest_path(const std::string &serializer_path,
+                               int hash_shard_number) {
+    return strprintf("%s.warm_shard_%d", serializer_path.c_str(), hash_shard_number);
+}
+
+template <class protocol_t>
+void start_warm_manifest(btree_store_t<protocol_t> *store, const std::string &path) {
+    store->cache->start_warm_manifest(path);
+}
+
+void start_warm_manifest(mock::dummy_protocol_t::store_t *, const std::string &) {
+    // The dummy protocol's stores don't have caches.
+}
+
+template <class protocol_t>
+void set_inline_value_size(btree_store_t<protocol_t> *store, int inline_value_size) {
+    store->btree->set_value_maxreflen(inline_value_size);
+}
+
+void set_inline_value_size(mock::dummy_protocol_t::store_t *, int) {
+    // The dummy protocol's stores don't have btrees.
+}
+
+template <class protocol_t>
+void set_write_buffer_size(btree_store_t<protocol_t> *store, int64_t write_buffer_size) {
+    store->write_buffer.set_max_size(write_buffer_size);
+}
+
+void set_write_buffer_size(mock::dummy_protocol_t::store_t *, int64_t) {
+    // The dummy protocol's stores don't have btrees.
+}
+
+template <class protocol_t>
+void start_defragmenter(btree_store_t<protocol_t> *store, int64_t interval_secs) {
+    store->start_defragmenter(interval_secs);
+}
+
+void start_defragmenter(mock::dummy_protocol_t::store_t *, int64_t) {
+    // The dummy protocol's stores don't have btrees.
+}
+
+// Whether the `count` threads starting at `first` are all on the same NUMA node.
+bool threads_share_numa_node(threadnum_t first, int count, int num_db_threads) {
+    const int node = get_thread_numa_node(first);
+    for (int i = 1; i < count; ++i) {
+        if (get_thread_numa_node(threadnum_t((first.threadnum + i) % num_db_threads))
+            != node) {
+            return false;
+        }
+    }
+    return true;
+}
+
 template <class protocol_t>
 void do_construct_existing_store(
     const std::vector<threadnum_t> &threads,
     int thread_offset,
     store_args_t<protocol_t> store_args,
-    serializer_multiplexer_t *multiplexer,
+    const std::vector<translator_serializer_t *> *serializers,
     scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > *stores_out_stores,
     store_view_t<protocol_t> **store_views) {
 
@@ -49,9 +120,14 @@ void do_construct_existing_store(
     on_thread_t th(threads[thread_offset]);
     // TODO: Can we pass serializers_perfmon_collection across threads like this?
     typename protocol_t::store_t *store = new typename protocol_t::store_t(
-        multiplexer->proxies[thread_offset], hash_shard_perfmon_name(thread_offset),
+        (*serializers)[thread_offset], hash_shard_perfmon_name(thread_offset),
         store_args.cache_size, false, store_args.serializers_perfmon_collection,
         store_args.ctx, store_args.io_backender, store_args.base_path);
+    start_warm_manifest(store, warm_manifest_path(store_args.serializer_path,
+                                                  thread_offset));
+    set_inline_value_size(store, store_args.inline_value_size);
+    set_write_buffer_size(store, store_args.write_buffer_size);
+    start_defragmenter(store, store_args.defragment_interval_secs);
     (*stores_out_stores)[thread_offset].init(store);
     store_views[thread_offset] = store;
 }
@@ -61,25 +137,97 @@ void do_create_new_store(
     const std::vector<threadnum_t> &threads,
     int thread_offset,
     store_args_t<protocol_t> store_args,
-    serializer_multiplexer_t *multiplexer,
+    const std::vector<translator_serializer_t *> *serializers,
     scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > *stores_out_stores,
     store_view_t<protocol_t> **store_views) {
 
     on_thread_t th(threads[thread_offset]);
     typename protocol_t::store_t *store = new typename protocol_t::store_t(
-        multiplexer->proxies[thread_offset], hash_shard_perfmon_name(thread_offset),
+        (*serializers)[thread_offset], hash_shard_perfmon_name(thread_offset),
         store_args.cache_size, true, store_args.serializers_perfmon_collection,
         store_args.ctx, store_args.io_backender, store_args.base_path);
+    start_warm_manifest(store, warm_manifest_path(store_args.serializer_path,
+                                                  thread_offset));
+    set_inline_value_size(store, store_args.inline_value_size);
+    set_write_buffer_size(store, store_args.write_buffer_size);
+    start_defragmenter(store, store_args.defragment_interval_secs);
     (*stores_out_stores)[thread_offset].init(store);
     store_views[thread_offset] = store;
 }
 
+// Makes a store on each of `serializers`, which are all new or all existing.
+template <class protocol_t>
+void make_stores(const std::vector<translator_serializer_t *> &serializers,
+                 bool is_new,
+                 threadnum_t serializer_thread,
+                 int cpu_sharding_factor,
+                 store_args_t<protocol_t> store_args,
+                 stores_lifetimer_t<protocol_t> *stores_out,
+                 scoped_ptr_t<multistore_ptr_t<protocol_t> > *mptr_out) {
+    // A table keeps the number of stores it was created with.
+    const int num_stores = serializers.size();
+    if (num_stores != cpu_sharding_factor) {
+        logWRN("Table %s was created with %d hash shards on this server, but "
+               "its metadata says %d.\n", uuid_to_str(store_args.namespace_id).c_str(),
+               num_stores, cpu_sharding_factor);
+    }
+    store_args.cache_size /= num_stores;
+
+    // The stores go on the threads following the serializer's.
+    const int num_db_threads = get_num_db_threads();
+    std::vector<threadnum_t> store_threads;
+    for (int i = 0; i < num_stores; ++i) {
+        store_threads.push_back(
+            threadnum_t((serializer_thread.threadnum + 1 + i) % num_db_threads));
+    }
+
+    scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > *stores_out_stores
+        = stores_out->stores();
+    stores_out_stores->init(num_stores);
+    scoped_array_t<store_view_t<protocol_t> *> store_views(num_stores);
+
+    // TODO: Exceptions?  Can exceptions happen, and then
+    // store_views' values would leak.  That is, are we handling
+    // them in the pmap?  No.
+    if (is_new) {
+        pmap(num_stores, boost::bind(do_create_new_store<protocol_t>,
+                                     store_threads, _1, store_args,
+                                     &serializers,
+                                     stores_out_stores, store_views.data()));
+    } else {
+        pmap(num_stores, boost::bind(do_construct_existing_store<protocol_t>,
+                                     store_threads, _1, store_args,
+                                     &serializers,
+                                     stores_out_stores, store_views.data()));
+    }
+    mptr_out->init(new multistore_ptr_t<protocol_t>(store_views.data(), num_stores));
+
+    if (is_new) {
+        // Initialize the metadata in the underlying stores.
+        object_buffer_t<fifo_enforcer_sink_t::exit_write_t> write_token;
+        (*mptr_out)->new_write_token(&write_token);
+        cond_t dummy_interruptor;
+        order_source_t order_source;  // TODO: order_token_t::ignore.  Use the svs.
+        guarantee((*mptr_out)->get_region() == protocol_t::region_t::universe());
+        (*mptr_out)->set_metainfo(
+            region_map_t<protocol_t, binary_blob_t>(
+                (*mptr_out)->get_region(),
+                binary_blob_t(version_range_t(version_t::zero()))),
+            order_source.check_in("file_based_svs_by_namespace_t"),
+            &write_token,
+            &dummy_interruptor);
+    }
+}
+
 template <class protocol_t>
 void
 file_based_svs_by_namespace_t<protocol_t>::get_svs(
             perfmon_collection_t *serializers_perfmon_collection,
             namespace_id_t namespace_id,
             int64_t cache_size,
+            int cpu_sharding_factor,
+            int inline_value_size,
+            int64_t write_buffer_size,
             stores_lifetimer_t<protocol_t> *stores_out,
             scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
             typename protocol_t::context_t *ctx) {
@@ -95,101 +243,84 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
     // TODO: We should use N slices on M serializers, not N slices
     // on N serializers.
 
-    const int num_stores = CPU_SHARDING_FACTOR;
-    scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > *stores_out_stores
-        = stores_out->stores();
-    stores_out_stores->init(num_stores);
+    threadnum_t serializer_thread = next_thread(num_db_threads);
+    // If the threads are pinned to NUMA nodes, keep the table's threads (and so its
+    // buffers) on one node, if there's room on one.
+    for (int i = 0;
+         i < num_db_threads
+             && !threads_share_numa_node(serializer_thread, cpu_sharding_factor + 1,
+                                         num_db_threads);
+         ++i) {
+        serializer_thread = next_thread(num_db_threads);
+    }
+    thread_counter_ = (thread_counter_ + cpu_sharding_factor) % num_db_threads;
 
-    const threadnum_t serializer_thread = next_thread(num_db_threads);
-    std::vector<threadnum_t> store_threads;
-    for (int i = 0; i < num_stores; ++i) {
-        store_threads.push_back(next_thread(num_db_threads));
+    const serializer_filepath_t serializer_filepath = file_name_for(namespace_id);
+    store_args_t<protocol_t> store_args(io_backender_, base_path_,
+                                        namespace_id, cache_size, inline_value_size,
+                                        write_buffer_size,
+                                        table_file_options_.defragment_interval_secs,
+                                        serializers_perfmon_collection, ctx,
+                                        serializer_filepath.permanent_path());
+    int res = access(serializer_filepath.permanent_path().c_str(), R_OK | W_OK);
+
+    scoped_ptr_t<multistore_ptr_t<protocol_t> > mptr;
+    std::vector<translator_serializer_t *> serializers;
+    if (res != 0 && shared_table_files_ != NULL
+        && (shared_table_files_->find_table(namespace_id, &serializers)
+            || shared_table_files_->share_new_tables())) {
+        // The table doesn't have a file of its own.
+        const bool is_new = serializers.empty();
+        if (is_new) {
+            serializers = shared_table_files_->create_table(namespace_id,
+                                                            cpu_sharding_factor);
+        }
+        make_stores(serializers, is_new, serializer_thread, cpu_sharding_factor,
+                    store_args, stores_out, &mptr);
+        if (is_new) {
+            shared_table_files_->table_created(namespace_id);
+        }
+        svs_out->init(mptr.release());
+        return;
     }
 
     scoped_ptr_t<serializer_t> serializer;
     scoped_ptr_t<serializer_multiplexer_t> multiplexer;
-    scoped_ptr_t<multistore_ptr_t<protocol_t> > mptr;
     {
         on_thread_t th(serializer_thread);
-        scoped_array_t<store_view_t<protocol_t> *> store_views(num_stores);
-
-        const serializer_filepath_t serializer_filepath = file_name_for(namespace_id);
-        int res = access(serializer_filepath.permanent_path().c_str(), R_OK | W_OK);
-        store_args_t<protocol_t> store_args(io_backender_, base_path_,
-                                            namespace_id, cache_size / num_stores,
-                                            serializers_perfmon_collection, ctx);
-        filepath_file_opener_t file_opener(serializer_filepath, io_backender_);
-        if (res == 0) {
-            // TODO: Could we handle failure when loading the serializer?  Right
-            // now, we don't.
-
-            {
-                scoped_ptr_t<serializer_t> ser
-                    = make_scoped<standard_serializer_t>(
-                        standard_serializer_t::dynamic_config_t(),
-                        &file_opener,
-                        serializers_perfmon_collection);
-                ser = make_scoped<merger_serializer_t>(std::move(ser),
-                                                       MERGER_SERIALIZER_MAX_ACTIVE_WRITES);
-                serializer = std::move(ser);
-            }
-
-            std::vector<serializer_t *> ptrs;
-            ptrs.push_back(serializer.get());
-            multiplexer.init(new serializer_multiplexer_t(ptrs));
-
-            // TODO: Exceptions?  Can exceptions happen, and then
-            // store_views' values would leak.  That is, are we handling
-            // them in the pmap?  No.
-            pmap(num_stores, boost::bind(do_construct_existing_store<protocol_t>,
-                                         store_threads, _1, store_args,
-                                         multiplexer.get(),
-                                         stores_out_stores, store_views.data()));
-            mptr.init(new multistore_ptr_t<protocol_t>(store_views.data(), num_stores));
-        } else {
+
+        const bool is_new = res != 0;
+        filepath_file_opener_t file_opener(serializer_filepath, io_backender_,
+                                           stripe_file_names_for(namespace_id),
+                                           ssd_cache_file_for(namespace_id));
+        if (is_new) {
             standard_serializer_t::create(&file_opener,
                                           standard_serializer_t::static_config_t());
-            {
-                scoped_ptr_t<serializer_t> ser
-                    = make_scoped<standard_serializer_t>(
-                        standard_serializer_t::dynamic_config_t(),
-                        &file_opener,
-                        serializers_perfmon_collection);
-                ser = make_scoped<merger_serializer_t>(std::move(ser),
-                                                       MERGER_SERIALIZER_MAX_ACTIVE_WRITES);
-                serializer = std::move(ser);
-            }
-
-            std::vector<serializer_t *> ptrs;
-            ptrs.push_back(serializer.get());
-            serializer_multiplexer_t::create(ptrs, num_stores);
-            multiplexer.init(new serializer_multiplexer_t(ptrs));
-
-            // TODO: How do we specify what the stores' regions are?
-            // TODO: Exceptions?  Can exceptions happen, and then store_views'
-            // values would leak.
-            // The files do not exist, create them.
-            // TODO: This should use pmap.
-            pmap(num_stores, boost::bind(do_create_new_store<protocol_t>,
-                                         store_threads, _1, store_args,
-                                         multiplexer.get(),
-                                         stores_out_stores, store_views.data()));
-            mptr.init(new multistore_ptr_t<protocol_t>(store_views.data(), num_stores));
-
-            // Initialize the metadata in the underlying stores.
-            object_buffer_t<fifo_enforcer_sink_t::exit_write_t> write_token;
-            mptr->new_write_token(&write_token);
-            cond_t dummy_interruptor;
-            order_source_t order_source;  // TODO: order_token_t::ignore.  Use the svs.
-            guarantee(mptr->get_region() == protocol_t::region_t::universe());
-            mptr->set_metainfo(
-                region_map_t<protocol_t, binary_blob_t>(
-                    mptr->get_region(),
-                    binary_blob_t(version_range_t(version_t::zero()))),
-                order_source.check_in("file_based_svs_by_namespace_t"),
-                &write_token,
-                &dummy_interruptor);
+        }
+        // TODO: Could we handle failure when loading the serializer?  Right
+        // now, we don't.
+        {
+            scoped_ptr_t<serializer_t> ser
+                = make_scoped<standard_serializer_t>(
+                    standard_serializer_t::dynamic_config_t(),
+                    &file_opener,
+                    serializers_perfmon_collection);
+            ser = make_scoped<merger_serializer_t>(std::move(ser),
+                                                   MERGER_SERIALIZER_MAX_ACTIVE_WRITES);
+            serializer = std::move(ser);
+        }
+
+        std::vector<serializer_t *> ptrs;
+        ptrs.push_back(serializer.get());
+        if (is_new) {
+            serializer_multiplexer_t::create(ptrs, cpu_sharding_factor);
+        }
+        multiplexer.init(new serializer_multiplexer_t(ptrs));
 
+        make_stores(multiplexer->proxies, is_new, serializer_thread, cpu_sharding_factor,
+                    store_args, stores_out, &mptr);
+
+        if (is_new) {
             // Finally, the store is created.
             file_opener.move_serializer_file_to_permanent_location();
         }
@@ -205,9 +336,38 @@ void file_based_svs_by_namespace_t<protocol_t>::destroy_svs(namespace_id_t names
     // TODO: Handle errors?  It seems like we can't really handle the error so
     // let's just ignore it?
     const std::string filepath = file_name_for(namespace_id).permanent_path();
-    const int res = ::unlink(filepath.c_str());
-    guarantee_err(res == 0 || get_errno() == ENOENT,
-                  "unlink failed for file %s", filepath.c_str());
+    if (shared_table_files_ == NULL
+        || !shared_table_files_->destroy_table(namespace_id)) {
+        const int res = ::unlink(filepath.c_str());
+        guarantee_err(res == 0 || get_errno() == ENOENT,
+                      "unlink failed for file %s", filepath.c_str());
+
+        const std::vector<serializer_filepath_t> stripes
+            = stripe_file_names_for(namespace_id);
+        for (auto it = stripes.begin(); it != stripes.end(); ++it) {
+            const std::string stripe_path = it->permanent_path();
+            const int stripe_res = ::unlink(stripe_path.c_str());
+            guarantee_err(stripe_res == 0 || get_errno() == ENOENT,
+                          "unlink failed for file %s", stripe_path.c_str());
+        }
+
+        const boost::optional<ssd_cache_file_t> cache_file
+            = ssd_cache_file_for(namespace_id);
+        if (cache_file) {
+            const int cache_res = ::unlink(cache_file->path.c_str());
+            guarantee_err(cache_res == 0 || get_errno() == ENOENT,
+                          "unlink failed for file %s", cache_file->path.c_str());
+        }
+    }
+
+    // We don't know how many stores the table had, so remove as many manifests as
+    // it could have had.
+    for (int i = 0; i < MAX_CPU_SHARDING_FACTOR; ++i) {
+        const std::string manifest_path = warm_manifest_path(filepath, i);
+        const int manifest_res = ::unlink(manifest_path.c_str());
+        guarantee_err(manifest_res == 0 || get_errno() == ENOENT,
+                      "unlink failed for file %s", manifest_path.c_str());
+    }
 }
 
 template<class protocol_t>
@@ -215,6 +375,28 @@ serializer_filepath_t file_based_svs_by_namespace_t<protocol_t>::file_name_for(n
     return serializer_filepath_t(base_path_, uuid_to_str(namespace_id));
 }
 
+template<class protocol_t>
+std::vector<serializer_filepath_t>
+file_based_svs_by_namespace_t<protocol_t>::stripe_file_names_for(namespace_id_t namespace_id) {
+    std::vector<serializer_filepath_t> names;
+    const std::vector<base_path_t> &paths = table_file_options_.stripe_paths;
+    for (auto it = paths.begin(); it != paths.end(); ++it) {
+        names.push_back(serializer_filepath_t(*it, uuid_to_str(namespace_id)));
+    }
+    return names;
+}
+
+template<class protocol_t>
+boost::optional<ssd_cache_file_t>
+file_based_svs_by_namespace_t<protocol_t>::ssd_cache_file_for(namespace_id_t namespace_id) {
+    if (!table_file_options_.ssd_cache_path) {
+        return boost::none;
+    }
+    return ssd_cache_file_t(table_file_options_.ssd_cache_path->path() + "/"
+                            + uuid_to_str(namespace_id) + ".cache",
+                            table_file_options_.ssd_cache_size);
+}
+
 template<class protocol_t>
 threadnum_t file_based_svs_by_namespace_t<protocol_t>::next_thread(int num_db_threads) {
     thread_counter_ = (thread_counter_ + 1) % num_db_threads;
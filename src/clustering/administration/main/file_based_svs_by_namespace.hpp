@@ -3,19 +3,48 @@
 #define CLUSTERING_ADMINISTRATION_MAIN_FILE_BASED_SVS_BY_NAMESPACE_HPP_
 
 #include <string>
+#include <vector>
 
 #include "clustering/administration/reactor_driver.hpp"
+#include "serializer/log/log_serializer.hpp"
+
+class shared_table_files_t;
+
+// Where the files of tables that have files of their own go, besides the data
+// directory, and how they're looked after.
+struct table_file_options_t {
+    table_file_options_t() : ssd_cache_size(0), defragment_interval_secs(0) { }
+
+    // The other directories the files are striped over (see `striped_file_t`).
+    std::vector<base_path_t> stripe_paths;
+    // Where each table keeps an SSD cache of `ssd_cache_size` bytes (see
+    // `ssd_block_cache_t`), if anywhere.
+    boost::optional<base_path_t> ssd_cache_path;
+    int64_t ssd_cache_size;
+    // How often each store defragments its btree (see
+    // `btree_store_t::start_defragmenter`), or 0 for never.
+    int64_t defragment_interval_secs;
+};
 
 template <class protocol_t>
 class file_based_svs_by_namespace_t : public svs_by_namespace_t<protocol_t> {
 public:
+    // Tables that are in `shared_table_files` (which may be NULL) are opened from
+    // there, and it decides whether new tables go there too.
     file_based_svs_by_namespace_t(io_backender_t *io_backender,
-                                  const base_path_t& base_path)
-        : io_backender_(io_backender), base_path_(base_path), thread_counter_(0) { }
+                                  const base_path_t& base_path,
+                                  const table_file_options_t &table_file_options,
+                                  shared_table_files_t *shared_table_files)
+        : io_backender_(io_backender), base_path_(base_path),
+          table_file_options_(table_file_options),
+          shared_table_files_(shared_table_files), thread_counter_(0) { }
 
     void get_svs(perfmon_collection_t *serializers_perfmon_collection,
                  namespace_id_t namespace_id,
                  int64_t cache_size,
+                 int cpu_sharding_factor,
+                 int inline_value_size,
+                 int64_t write_buffer_size,
                  stores_lifetimer_t<protocol_t> *stores_out,
                  scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
                  typename protocol_t::context_t *);
@@ -23,10 +52,14 @@ public:
     void destroy_svs(namespace_id_t namespace_id);
 
     serializer_filepath_t file_name_for(namespace_id_t namespace_id);
+    std::vector<serializer_filepath_t> stripe_file_names_for(namespace_id_t namespace_id);
+    boost::optional<ssd_cache_file_t> ssd_cache_file_for(namespace_id_t namespace_id);
 
 private:
     io_backender_t *io_backender_;
     const base_path_t base_path_;
+    const table_file_options_t table_file_options_;
+    shared_table_files_t *const shared_table_files_;
 
     threadnum_t next_thread(int num_db_threads);
     int thread_counter_; // should only be used by `next_thread`
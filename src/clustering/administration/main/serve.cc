@@ -5,6 +5,7 @@
 
 #include "arch/arch.hpp"
 #include "arch/os_signal.hpp"
+#include "buffer_cache/alt/cache_balancer.hpp"
 #include "clustering/administration/admin_tracker.hpp"
 #include "clustering/administration/auto_reconnect.hpp"
 #include "clustering/administration/http/server.hpp"
@@ -13,6 +14,7 @@
 #include "clustering/administration/main/file_based_svs_by_namespace.hpp"
 #include "clustering/administration/main/initial_join.hpp"
 #include "clustering/administration/main/ports.hpp"
+#include "clustering/administration/main/shared_table_files.hpp"
 #include "clustering/administration/main/watchable_fields.hpp"
 #include "containers/incremental_lenses.hpp"
 #include "clustering/administration/metadata.hpp"
@@ -28,8 +30,10 @@
 #include "memcached/tcp_conn.hpp"
 #include "mock/dummy_protocol.hpp"
 #include "mock/dummy_protocol_parser.hpp"
+#include "perfmon/snapshot.hpp"
 #include "rdb_protocol/pb_server.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/query_capture.hpp"
 #include "rpc/connectivity/cluster.hpp"
 #include "rpc/connectivity/multiplexer.hpp"
 #include "rpc/connectivity/heartbeat.hpp"
@@ -72,7 +76,11 @@ bool do_serve(
     service_address_ports_t address_ports,
     std::string web_assets,
     os_signal_cond_t *stop_cond,
-    const boost::optional<std::string> &config_file) {
+    const boost::optional<std::string> &config_file,
+    uint64_t total_cache_size,
+    bool share_table_files,
+    const table_file_options_t &table_file_options,
+    const query_capture_options_t &query_capture_options) {
     try {
         extproc_pool_t extproc_pool(get_num_threads());
 
@@ -119,7 +127,8 @@ bool do_serve(
         // Initialize the stat manager before the directory manager so that we
         // could initialize the cluster directory metadata with the proper
         // stat_manager mailbox address
-        stat_manager_t stat_manager(&mailbox_manager);
+        perfmon_snapshotter_t perfmon_snapshotter;
+        stat_manager_t stat_manager(&mailbox_manager, &perfmon_snapshotter);
 
         metadata_change_handler_t<cluster_semilattice_metadata_t> metadata_change_handler(&mailbox_manager, semilattice_manager_cluster.get_root_view());
         metadata_change_handler_t<auth_semilattice_metadata_t> auth_change_handler(&mailbox_manager, auth_manager_cluster.get_root_view());
@@ -245,7 +254,10 @@ bool do_serve(
                                           auth_manager_cluster.get_root_view(),
                                           &directory_read_manager,
                                           machine_id,
-                                          &get_global_perfmon_collection());
+                                          &get_global_perfmon_collection(),
+                                          io_backender,
+                                          base_path,
+                                          &mailbox_manager);
 
         namespace_repo_t<rdb_protocol_t> rdb_namespace_repo(&mailbox_manager,
             directory_read_manager.get_root_view()->incremental_subview(
@@ -255,6 +267,22 @@ bool do_serve(
         //This is an annoying chicken and egg problem here
         rdb_ctx.ns_repo = &rdb_namespace_repo;
 
+        // The stores, which the reactor drivers create, register their caches with
+        // the balancer, so it has to outlive the reactor drivers.
+        scoped_ptr_t<alt_cache_balancer_t> cache_balancer;
+        if (i_am_a_server && total_cache_size != 0) {
+            cache_balancer.init(new alt_cache_balancer_t(total_cache_size));
+        }
+
+        // Likewise for the shared table files, which hold some of the stores.  We
+        // open them even if new tables won't go there, for the tables that already
+        // do.
+        scoped_ptr_t<shared_table_files_t> shared_table_files;
+        if (i_am_a_server) {
+            shared_table_files.init(new shared_table_files_t(io_backender, base_path,
+                                                             share_table_files));
+        }
+
         {
             // Reactor drivers
 
@@ -266,7 +294,7 @@ bool do_serve(
 
             if (i_am_a_server) {
                 dummy_svs_source.init(new file_based_svs_by_namespace_t<mock::dummy_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, base_path, table_file_options, shared_table_files.get()));
                 dummy_reactor_driver.init(new reactor_driver_t<mock::dummy_protocol_t>(
                     base_path,
                     io_backender,
@@ -299,7 +327,7 @@ bool do_serve(
 
             if (i_am_a_server) {
                 memcached_svs_source.init(new file_based_svs_by_namespace_t<memcached_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, base_path, table_file_options, shared_table_files.get()));
                 memcached_reactor_driver.init(new reactor_driver_t<memcached_protocol_t>(
                     base_path,
                     io_backender,
@@ -332,7 +360,7 @@ bool do_serve(
 
             if (i_am_a_server) {
                 rdb_svs_source.init(new file_based_svs_by_namespace_t<rdb_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, base_path, table_file_options, shared_table_files.get()));
                 rdb_reactor_driver.init(new reactor_driver_t<rdb_protocol_t>(
                         base_path,
                         io_backender,
@@ -376,10 +404,24 @@ bool do_serve(
                     &local_issue_tracker,
                     &perfmon_repo);
 
+                scoped_ptr_t<query_capture_t> query_capture;
+                if (query_capture_options.file) {
+                    query_capture.init(new query_capture_t(query_capture_options));
+                    logINF("Capturing one in %d client connections' queries to '%s'\n",
+                           query_capture_options.connection_sample_interval,
+                           query_capture_options.file->c_str());
+                }
+
                 query2_server_t rdb_pb2_server(address_ports.local_addresses,
-                                               address_ports.reql_port, &rdb_ctx);
+                                               address_ports.reql_port, &rdb_ctx,
+                                               query_capture.get());
                 logINF("Listening for client driver connections on port %d\n",
                        rdb_pb2_server.get_port());
+                our_root_directory_variable.apply_atomic_op(
+                    [&](cluster_directory_metadata_t *directory) -> bool {
+                        directory->reql_port = rdb_pb2_server.get_port();
+                        return true;
+                    });
 
                 scoped_ptr_t<metadata_persistence::semilattice_watching_persister_t<cluster_semilattice_metadata_t> >
                     cluster_metadata_persister;
@@ -415,6 +457,8 @@ bool do_serve(
                                 &rdb_namespace_repo,
                                 &admin_tracker,
                                 rdb_pb2_server.get_http_app(),
+                                &rdb_ctx.query_traces,
+                                &perfmon_snapshotter,
                                 machine_id,
                                 web_assets));
                         logINF("Listening for administrative HTTP connections on port %d\n", admin_server_ptr->get_port());
@@ -472,6 +516,9 @@ bool do_serve(
     } catch (const tcp_socket_exc_t &ex) {
         logERR("%s.\n", ex.what());
         return false;
+    } catch (const query_capture_exc_t &ex) {
+        logERR("%s.\n", ex.what());
+        return false;
     }
 
     return true;
@@ -485,7 +532,11 @@ bool serve(io_backender_t *io_backender,
            service_address_ports_t address_ports,
            std::string web_assets,
            os_signal_cond_t *stop_cond,
-           const boost::optional<std::string>& config_file) {
+           const boost::optional<std::string>& config_file,
+           uint64_t total_cache_size,
+           bool share_table_files,
+           const table_file_options_t &table_file_options,
+           const query_capture_options_t &query_capture_options) {
     return do_serve(io_backender,
                     true,
                     base_path,
@@ -495,14 +546,19 @@ bool serve(io_backender_t *io_backender,
                     address_ports,
                     web_assets,
                     stop_cond,
-                    config_file);
+                    config_file,
+                    total_cache_size,
+                    share_table_files,
+                    table_file_options,
+                    query_capture_options);
 }
 
 bool serve_proxy(const peer_address_set_t &joins,
                  service_address_ports_t address_ports,
                  std::string web_assets,
                  os_signal_cond_t *stop_cond,
-                 const boost::optional<std::string>& config_file) {
+                 const boost::optional<std::string>& config_file,
+                 const query_capture_options_t &query_capture_options) {
     // TODO: filepath doesn't _seem_ ignored.
     // filepath and persistent_file are ignored for proxies, so we use the empty string & NULL respectively.
     return do_serve(NULL,
@@ -514,5 +570,9 @@ bool serve_proxy(const peer_address_set_t &joins,
                     address_ports,
                     web_assets,
                     stop_cond,
-                    config_file);
+                    config_file,
+                    0,
+                    false,
+                    table_file_options_t(),
+                    query_capture_options);
 }
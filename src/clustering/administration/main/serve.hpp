@@ -5,9 +5,11 @@
 #include <set>
 #include <string>
 
+#include "clustering/administration/main/file_based_svs_by_namespace.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "clustering/administration/persist.hpp"
 #include "arch/address.hpp"
+#include "rdb_protocol/query_capture.hpp"
 
 class os_signal_cond_t;
 
@@ -85,6 +87,12 @@ struct service_address_ports_t {
 /* This has been factored out from `command_line.hpp` because it takes a very
 long time to compile. */
 
+// If total_cache_size is non-zero, the page caches of all tables share that many
+// bytes, balanced between them, instead of each having its own cache size.  If
+// share_table_files is true, new tables' stores go in shared_table_files_t's
+// files instead of a file per table.  `table_file_options` says where else tables
+// with files of their own keep them.  If `query_capture_options.file` is set, client
+// queries are captured there (see `query_capture_t`).
 bool serve(io_backender_t *io_backender,
            const base_path_t &base_path,
            metadata_persistence::cluster_persistent_file_t *cluster_persistent_file,
@@ -93,12 +101,17 @@ bool serve(io_backender_t *io_backender,
            service_address_ports_t ports,
            std::string web_assets,
            os_signal_cond_t *stop_cond,
-           const boost::optional<std::string>& config_file);
+           const boost::optional<std::string>& config_file,
+           uint64_t total_cache_size,
+           bool share_table_files,
+           const table_file_options_t &table_file_options,
+           const query_capture_options_t &query_capture_options);
 
 bool serve_proxy(const peer_address_set_t &joins,
                  service_address_ports_t ports,
                  std::string web_assets,
                  os_signal_cond_t *stop_cond,
-                 const boost::optional<std::string>& config_file);
+                 const boost::optional<std::string>& config_file,
+                 const query_capture_options_t &query_capture_options);
 
 #endif /* CLUSTERING_ADMINISTRATION_MAIN_SERVE_HPP_ */
@@ -0,0 +1,336 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/main/shared_table_files.hpp"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <functional>
+
+#include "arch/io/io_utils.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "config/args.hpp"
+#include "serializer/config.hpp"
+#include "serializer/merger.hpp"
+#include "serializer/translator.hpp"
+#include "stl_utils.hpp"
+
+struct shared_table_files_t::shared_file_t {
+    explicit shared_file_t(threadnum_t _thread) : thread(_thread) { }
+
+    const threadnum_t thread;
+    perfmon_collection_t stats;
+    scoped_ptr_t<perfmon_membership_t> stats_membership;
+    scoped_ptr_t<serializer_t> serializer;
+    scoped_ptr_t<serializer_multiplexer_t> multiplexer;
+    // The table using each slot, or nil if it's free
+    std::vector<namespace_id_t> slot_owners;
+};
+
+namespace {
+
+std::string shared_file_name(int file_index) {
+    return strprintf("shared_tables_%d", file_index);
+}
+
+std::string manifest_path(const base_path_t &base_path) {
+    return base_path.path() + "/shared_tables";
+}
+
+void read_manifest_blocking(const std::string *path, std::string *contents_out,
+                            bool *success_out) {
+    *success_out = blocking_read_file(path->c_str(), contents_out);
+}
+
+// Like the warm-cache manifests, the manifest is written next to the old one and
+// renamed over it.
+void write_manifest_blocking(const std::string *path, const std::string *contents,
+                             bool *success_out) {
+    *success_out = false;
+    const std::string tmp_path = *path + ".tmp";
+    scoped_fd_t fd;
+    {
+        int res;
+        do {
+            res = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        } while (res == INVALID_FD && get_errno() == EINTR);
+        fd.reset(res);
+    }
+    if (fd.get() == INVALID_FD) {
+        return;
+    }
+    const char *p = contents->data();
+    size_t size = contents->size();
+    while (size > 0) {
+        ssize_t res = ::write(fd.get(), p, size);
+        if (res == -1 && get_errno() == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            return;
+        }
+        p += res;
+        size -= res;
+    }
+    if (fsync(fd.get()) != 0) {
+        return;
+    }
+    fd.reset();
+    *success_out = ::rename(tmp_path.c_str(), path->c_str()) == 0;
+}
+
+}  // namespace
+
+shared_table_files_t::shared_table_files_t(io_backender_t *io_backender,
+                                           const base_path_t &base_path,
+                                           bool share_new_tables)
+    : io_backender_(io_backender), base_path_(base_path),
+      share_new_tables_(share_new_tables) {
+    for (int i = 0; ; ++i) {
+        const serializer_filepath_t filepath(base_path_, shared_file_name(i));
+        if (access(filepath.permanent_path().c_str(), R_OK | W_OK) != 0) {
+            break;
+        }
+        open_file(i, false);
+    }
+
+    /* Each line of the manifest is a table's uuid followed by its stores' slots, in
+    the form "<file index>:<slot>". */
+    const std::string path = manifest_path(base_path_);
+    std::string contents;
+    bool success;
+    thread_pool_t::run_in_blocker_pool(std::bind(&read_manifest_blocking,
+                                                 &path, &contents, &success));
+    if (!success) {
+        if (!files_.empty()) {
+            fail_due_to_user_error("The shared table files in %s have no manifest (%s).",
+                                   base_path_.path().c_str(), path.c_str());
+        }
+        return;
+    }
+
+    size_t line_begin = 0;
+    while (line_begin < contents.size()) {
+        size_t line_end = contents.find('\n', line_begin);
+        if (line_end == std::string::npos) {
+            line_end = contents.size();
+        }
+        std::vector<std::string> words;
+        size_t word_begin = line_begin;
+        while (word_begin < line_end) {
+            size_t word_end = contents.find(' ', word_begin);
+            if (word_end == std::string::npos || word_end > line_end) {
+                word_end = line_end;
+            }
+            if (word_end > word_begin) {
+                words.push_back(contents.substr(word_begin, word_end - word_begin));
+            }
+            word_begin = word_end + 1;
+        }
+        line_begin = line_end + 1;
+        if (words.empty()) {
+            continue;
+        }
+
+        namespace_id_t table_id;
+        bool valid = str_to_uuid(words[0], &table_id) && words.size() > 1
+            && !std_contains(tables_, table_id);
+        std::vector<slot_t> slots;
+        for (size_t i = 1; valid && i < words.size(); ++i) {
+            int file_index, slot;
+            char extra;
+            valid = sscanf(words[i].c_str(), "%d:%d%c", &file_index, &slot, &extra) == 2
+                && file_index >= 0 && file_index < static_cast<int>(files_.size())
+                && slot >= 0
+                && slot < static_cast<int>(files_[file_index]->slot_owners.size())
+                && files_[file_index]->slot_owners[slot].is_nil();
+            if (valid) {
+                files_[file_index]->slot_owners[slot] = table_id;
+                slots.push_back(slot_t(file_index, slot));
+            }
+        }
+        if (!valid) {
+            fail_due_to_user_error("The shared table manifest %s is corrupt.",
+                                   path.c_str());
+        }
+        tables_[table_id] = slots;
+    }
+}
+
+shared_table_files_t::~shared_table_files_t() {
+    assert_thread();
+    guarantee(new_tables_.empty());
+    for (auto it = files_.begin(); it != files_.end(); ++it) {
+        {
+            on_thread_t th((*it)->thread);
+            (*it)->multiplexer.reset();
+            (*it)->serializer.reset();
+        }
+        delete *it;
+    }
+}
+
+bool shared_table_files_t::find_table(
+        namespace_id_t table_id,
+        std::vector<translator_serializer_t *> *serializers_out) {
+    assert_thread();
+    auto it = tables_.find(table_id);
+    if (it == tables_.end()) {
+        return false;
+    }
+    serializers_out->clear();
+    for (auto jt = it->second.begin(); jt != it->second.end(); ++jt) {
+        serializers_out->push_back(get_serializer(*jt));
+    }
+    return true;
+}
+
+std::vector<translator_serializer_t *> shared_table_files_t::create_table(
+        namespace_id_t table_id, int num_stores) {
+    assert_thread();
+    guarantee(!std_contains(tables_, table_id) && !std_contains(new_tables_, table_id));
+    guarantee(num_stores > 0);
+
+    mutex_t::acq_t acq(&create_mutex_);
+    if (files_.empty()) {
+        // There must be a manifest whenever there are files.
+        save_manifest();
+    }
+
+    std::vector<slot_t> slots;
+    for (;;) {
+        for (size_t i = 0; i < files_.size(); ++i) {
+            std::vector<namespace_id_t> *owners = &files_[i]->slot_owners;
+            for (size_t j = 0; j < owners->size(); ++j) {
+                if (static_cast<int>(slots.size()) < num_stores && (*owners)[j].is_nil()) {
+                    (*owners)[j] = table_id;
+                    slots.push_back(slot_t(i, j));
+                }
+            }
+        }
+        if (static_cast<int>(slots.size()) == num_stores) {
+            break;
+        }
+        open_file(files_.size(), true);
+    }
+    new_tables_[table_id] = slots;
+
+    std::vector<translator_serializer_t *> serializers;
+    for (auto it = slots.begin(); it != slots.end(); ++it) {
+        wipe_slot(*it);
+        serializers.push_back(get_serializer(*it));
+    }
+    return serializers;
+}
+
+void shared_table_files_t::table_created(namespace_id_t table_id) {
+    assert_thread();
+    auto it = new_tables_.find(table_id);
+    guarantee(it != new_tables_.end());
+    tables_[table_id] = it->second;
+    new_tables_.erase(it);
+    save_manifest();
+}
+
+bool shared_table_files_t::destroy_table(namespace_id_t table_id) {
+    assert_thread();
+    auto it = tables_.find(table_id);
+    if (it == tables_.end()) {
+        return false;
+    }
+    const std::vector<slot_t> slots = it->second;
+    tables_.erase(it);
+    save_manifest();
+
+    // The slots don't go back to the free pool until they're wiped, so that a new
+    // table can't start using them in the meantime.
+    for (auto jt = slots.begin(); jt != slots.end(); ++jt) {
+        wipe_slot(*jt);
+        files_[jt->first]->slot_owners[jt->second] = nil_uuid();
+    }
+    return true;
+}
+
+void shared_table_files_t::open_file(int file_index, bool create) {
+    assert_thread();
+    guarantee(file_index == static_cast<int>(files_.size()));
+    scoped_ptr_t<shared_file_t> file(
+        new shared_file_t(threadnum_t(file_index % get_num_db_threads())));
+    file->stats_membership.init(new perfmon_membership_t(
+        &get_global_perfmon_collection(), &file->stats, shared_file_name(file_index)));
+    {
+        on_thread_t th(file->thread);
+        const serializer_filepath_t filepath(base_path_, shared_file_name(file_index));
+        filepath_file_opener_t file_opener(filepath, io_backender_);
+        if (create) {
+            standard_serializer_t::create(&file_opener,
+                                          standard_serializer_t::static_config_t());
+        }
+        {
+            scoped_ptr_t<serializer_t> ser
+                = make_scoped<standard_serializer_t>(
+                    standard_serializer_t::dynamic_config_t(),
+                    &file_opener,
+                    &file->stats);
+            ser = make_scoped<merger_serializer_t>(std::move(ser),
+                                                   MERGER_SERIALIZER_MAX_ACTIVE_WRITES);
+            file->serializer = std::move(ser);
+        }
+
+        std::vector<serializer_t *> ptrs;
+        ptrs.push_back(file->serializer.get());
+        if (create) {
+            serializer_multiplexer_t::create(ptrs, SHARED_TABLE_FILE_SLOTS);
+        }
+        file->multiplexer.init(new serializer_multiplexer_t(ptrs));
+
+        if (create) {
+            file_opener.move_serializer_file_to_permanent_location();
+        }
+    }
+    file->slot_owners.resize(file->multiplexer->proxies.size(), nil_uuid());
+    files_.push_back(file.release());
+}
+
+translator_serializer_t *shared_table_files_t::get_serializer(slot_t slot) {
+    return files_[slot.first]->multiplexer->proxies[slot.second];
+}
+
+void shared_table_files_t::wipe_slot(slot_t slot) {
+    translator_serializer_t *serializer = get_serializer(slot);
+    on_thread_t th(serializer->home_thread());
+
+    std::vector<index_write_op_t> ops;
+    const block_id_t end = serializer->max_block_id();
+    for (block_id_t id = 0; id < end; ++id) {
+        if (!serializer->get_delete_bit(id)) {
+            ops.push_back(index_write_op_t(id,
+                                           counted_t<standard_block_token_t>(),
+                                           repli_timestamp_t::invalid));
+        }
+    }
+    if (!ops.empty()) {
+        serializer->index_write(ops, DEFAULT_DISK_ACCOUNT);
+    }
+}
+
+void shared_table_files_t::save_manifest() {
+    assert_thread();
+    mutex_t::acq_t acq(&manifest_mutex_);
+
+    std::string contents;
+    for (auto it = tables_.begin(); it != tables_.end(); ++it) {
+        contents += uuid_to_str(it->first);
+        for (auto jt = it->second.begin(); jt != it->second.end(); ++jt) {
+            contents += strprintf(" %d:%d", jt->first, jt->second);
+        }
+        contents += "\n";
+    }
+
+    const std::string path = manifest_path(base_path_);
+    bool success;
+    thread_pool_t::run_in_blocker_pool(std::bind(&write_manifest_blocking,
+                                                 &path, &contents, &success));
+    guarantee_err(success, "could not write the shared table manifest %s",
+                  path.c_str());
+}
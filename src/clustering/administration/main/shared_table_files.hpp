@@ -0,0 +1,87 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_MAIN_SHARED_TABLE_FILES_HPP_
+#define CLUSTERING_ADMINISTRATION_MAIN_SHARED_TABLE_FILES_HPP_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "concurrency/mutex.hpp"
+#include "containers/scoped.hpp"
+#include "containers/uuid.hpp"
+#include "perfmon/perfmon.hpp"
+#include "utils.hpp"
+
+class io_backender_t;
+class serializer_t;
+class serializer_multiplexer_t;
+class translator_serializer_t;
+
+/* Data files that hold the stores of many tables, for servers with lots of small
+tables.  A table with a file of its own has a log serializer, with its LBA, its
+metablock buffers and its file descriptor, for every table; these files instead
+each hold `SHARED_TABLE_FILE_SLOTS` stores, one per `translator_serializer_t` of
+a `serializer_multiplexer_t`, so the tables in a file share one serializer and one
+garbage collector.  Files are added as the slots run out.
+
+Which slots each table uses is recorded in a small manifest next to the files.
+A slot is wiped when its table is dropped, and again when it's given to a new
+table, in case the server crashed before its old table's blocks were gone. */
+class shared_table_files_t : public home_thread_mixin_t {
+public:
+    // Blocks, opening the files that already exist.  New tables only go in the
+    // shared files if `share_new_tables` is true, but the tables that are already
+    // there stay there either way.
+    shared_table_files_t(io_backender_t *io_backender, const base_path_t &base_path,
+                         bool share_new_tables);
+    ~shared_table_files_t();
+
+    bool share_new_tables() const { return share_new_tables_; }
+
+    // Returns true and the serializers for the table's stores if the table is in
+    // the shared files.
+    bool find_table(namespace_id_t table_id,
+                    std::vector<translator_serializer_t *> *serializers_out);
+
+    // Picks `num_stores` empty slots for a new table.  The table only becomes
+    // findable after `table_created()`, which should be called once the stores'
+    // metainfo has been written.
+    std::vector<translator_serializer_t *> create_table(namespace_id_t table_id,
+                                                        int num_stores);
+    void table_created(namespace_id_t table_id);
+
+    // Returns false if the table isn't in the shared files.  The table's stores
+    // must have been destroyed.
+    bool destroy_table(namespace_id_t table_id);
+
+private:
+    // A file index and a slot in that file
+    typedef std::pair<int, int> slot_t;
+
+    struct shared_file_t;
+
+    void open_file(int file_index, bool create);
+    translator_serializer_t *get_serializer(slot_t slot);
+    void wipe_slot(slot_t slot);
+    void save_manifest();
+
+    io_backender_t *const io_backender_;
+    const base_path_t base_path_;
+    const bool share_new_tables_;
+
+    std::vector<shared_file_t *> files_;
+    std::map<namespace_id_t, std::vector<slot_t> > tables_;
+    // Tables being created, which hold their slots but aren't in the manifest yet
+    std::map<namespace_id_t, std::vector<slot_t> > new_tables_;
+
+    // Lets one table at a time look for slots, so that two tables don't both add
+    // a file.
+    mutex_t create_mutex_;
+    // Keeps manifest writes in order.
+    mutex_t manifest_mutex_;
+
+    DISABLE_COPYING(shared_table_files_t);
+};
+
+#endif  // CLUSTERING_ADMINISTRATION_MAIN_SHARED_TABLE_FILES_HPP_
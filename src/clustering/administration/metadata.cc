@@ -206,6 +206,7 @@ json_adapter_if_t::json_adapter_map_t get_json_subfields(cluster_directory_metad
     res["peer_id"] = boost::shared_ptr<json_adapter_if_t>(new json_adapter_t<peer_id_t>(&target->peer_id));
     res["ips"] = boost::shared_ptr<json_adapter_if_t>(new json_adapter_t<std::vector<std::string> >(&target->ips));
     res["peer_type"] = boost::shared_ptr<json_adapter_if_t>(new json_adapter_t<cluster_directory_peer_type_t>(&target->peer_type));
+    res["reql_port"] = boost::shared_ptr<json_adapter_if_t>(new json_read_only_adapter_t<int>(&target->reql_port));
     return res;
 }
 
@@ -217,6 +218,25 @@ void apply_json_to(cJSON *change, cluster_directory_metadata_t *target) {
     apply_as_directory(change, target);
 }
 
+bool directory_reuse_unchanged(const cluster_directory_metadata_t &old_value,
+                               cluster_directory_metadata_t *new_value) {
+    /* Don't short-circuit; every table map should share what it can. */
+    bool changed = directory_reuse_unchanged(old_value.dummy_namespaces, &new_value->dummy_namespaces);
+    changed |= directory_reuse_unchanged(old_value.memcached_namespaces, &new_value->memcached_namespaces);
+    changed |= directory_reuse_unchanged(old_value.rdb_namespaces, &new_value->rdb_namespaces);
+    return changed
+        || !(old_value.machine_id == new_value->machine_id)
+        || !(old_value.peer_id == new_value->peer_id)
+        || old_value.ips != new_value->ips
+        || !(old_value.get_stats_mailbox_address == new_value->get_stats_mailbox_address)
+        || !(old_value.semilattice_change_mailbox == new_value->semilattice_change_mailbox)
+        || !(old_value.auth_change_mailbox == new_value->auth_change_mailbox)
+        || !(old_value.log_mailbox == new_value->log_mailbox)
+        || !(old_value.local_issues == new_value->local_issues)
+        || old_value.peer_type != new_value->peer_type
+        || old_value.reql_port != new_value->reql_port;
+}
+
 
 
 
@@ -258,6 +278,10 @@ json_adapter_if_t::json_adapter_map_t with_ctx_get_json_subfields(namespace_semi
     res["primary_key"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<std::string>(&target->primary_key, ctx));
     res["database"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<database_id_t>(&target->database, ctx));
     res["cache_size"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<int64_t>(&target->cache_size, ctx));
+    res["cpu_sharding_factor"] = boost::shared_ptr<json_adapter_if_t>(new json_ctx_read_only_adapter_t<vclock_t<int32_t>, vclock_ctx_t>(&target->cpu_sharding_factor, ctx));
+    res["inline_value_size"] = boost::shared_ptr<json_adapter_if_t>(new json_ctx_read_only_adapter_t<vclock_t<int32_t>, vclock_ctx_t>(&target->inline_value_size, ctx));
+    res["write_buffer_size"] = boost::shared_ptr<json_adapter_if_t>(new json_ctx_read_only_adapter_t<vclock_t<int64_t>, vclock_ctx_t>(&target->write_buffer_size, ctx));
+    res["time_ordered_keys"] = boost::shared_ptr<json_adapter_if_t>(new json_ctx_read_only_adapter_t<vclock_t<bool>, vclock_ctx_t>(&target->time_ordered_keys, ctx));
     return res;
 }
 
@@ -297,6 +321,14 @@ inline json_adapter_if_t::json_adapter_map_t with_ctx_get_json_subfields(namespa
 
     default_namespace.cache_size = default_namespace.cache_size.make_new_version(GIGABYTE, ctx.us);
 
+    default_namespace.cpu_sharding_factor = default_namespace.cpu_sharding_factor.make_new_version(CPU_SHARDING_FACTOR, ctx.us);
+
+    default_namespace.inline_value_size = default_namespace.inline_value_size.make_new_version(DEFAULT_INLINE_VALUE_SIZE, ctx.us);
+
+    default_namespace.write_buffer_size = default_namespace.write_buffer_size.make_new_version(DEFAULT_WRITE_BUFFER_SIZE, ctx.us);
+
+    default_namespace.time_ordered_keys = default_namespace.time_ordered_keys.make_new_version(false, ctx.us);
+
     deletable_t<namespace_semilattice_metadata_t<protocol_t> > default_ns_in_deletable(default_namespace);
     return json_ctx_adapter_with_inserter_t<typename namespaces_semilattice_metadata_t<protocol_t>::namespace_map_t, vclock_ctx_t>(&target->namespaces, generate_uuid, ctx, default_ns_in_deletable).get_subfields();
 }
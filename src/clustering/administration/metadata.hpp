@@ -48,6 +48,7 @@ public:
 };
 
 RDB_MAKE_SEMILATTICE_JOINABLE_6(cluster_semilattice_metadata_t, dummy_namespaces, memcached_namespaces, rdb_namespaces, machines, datacenters, databases);
+RDB_MAKE_SEMILATTICE_DELTA_6(cluster_semilattice_metadata_t, dummy_namespaces, memcached_namespaces, rdb_namespaces, machines, datacenters, databases);
 RDB_MAKE_EQUALITY_COMPARABLE_6(cluster_semilattice_metadata_t, dummy_namespaces, memcached_namespaces, rdb_namespaces, machines, datacenters, databases);
 
 //json adapter concept for cluster_semilattice_metadata_t
@@ -85,7 +86,7 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(cluster_directory_peer_type_t, int8_t, ADM
 class cluster_directory_metadata_t {
 public:
 
-    cluster_directory_metadata_t() { }
+    cluster_directory_metadata_t() : reql_port(0) { }
     cluster_directory_metadata_t(
             machine_id_t mid,
             peer_id_t pid,
@@ -102,7 +103,8 @@ public:
         semilattice_change_mailbox(_semilattice_change_mailbox),
         auth_change_mailbox(_auth_change_mailbox),
         log_mailbox(lmb),
-        peer_type(_peer_type) { }
+        peer_type(_peer_type),
+        reql_port(0) { }
     /* Move constructor */
     cluster_directory_metadata_t(cluster_directory_metadata_t &&other) {
         *this = std::move(other);
@@ -125,6 +127,7 @@ public:
         log_mailbox = other.log_mailbox;
         local_issues = std::move(other.local_issues);
         peer_type = other.peer_type;
+        reql_port = other.reql_port;
 
         return *this;
     }
@@ -144,6 +147,7 @@ public:
         log_mailbox = other.log_mailbox;
         local_issues = other.local_issues;
         peer_type = other.peer_type;
+        reql_port = other.reql_port;
 
         return *this;
     }
@@ -166,9 +170,18 @@ public:
     std::list<local_issue_t> local_issues;
     cluster_directory_peer_type_t peer_type;
 
-    RDB_MAKE_ME_SERIALIZABLE_12(dummy_namespaces, memcached_namespaces, rdb_namespaces, machine_id, peer_id, ips, get_stats_mailbox_address, semilattice_change_mailbox, auth_change_mailbox, log_mailbox, local_issues, peer_type);
+    /* The port we listen for client drivers on, so that they can be sent straight
+    to us (see `SHARD_MAP`), or 0 until we do. */
+    int reql_port;
+
+    RDB_MAKE_ME_SERIALIZABLE_13(dummy_namespaces, memcached_namespaces, rdb_namespaces, machine_id, peer_id, ips, get_stats_mailbox_address, semilattice_change_mailbox, auth_change_mailbox, log_mailbox, local_issues, peer_type, reql_port);
 };
 
+/* Shares each table's business card with `old_value` unless it changed, and
+returns false if nothing changed at all */
+bool directory_reuse_unchanged(const cluster_directory_metadata_t &old_value,
+                               cluster_directory_metadata_t *new_value);
+
 // ctx-less json adapter for directory_echo_wrapper_t
 template <typename T>
 json_adapter_if_t::json_adapter_map_t get_json_subfields(directory_echo_wrapper_t<T> *target) {
@@ -41,6 +41,11 @@ public:
         return metadata_view->get();
     }
 
+    // For subscribing to changes, local or not
+    boost::shared_ptr<semilattice_read_view_t<metadata_t> > get_view() {
+        return metadata_view;
+    }
+
     void update(const metadata_t& metadata) {
         for (std::set<cond_t*>::iterator i = coro_invalid_conditions.begin(); i != coro_invalid_conditions.end(); ++i) {
             (*i)->pulse_if_not_already_pulsed();
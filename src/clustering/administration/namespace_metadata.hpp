@@ -16,6 +16,7 @@
 #include "clustering/reactor/directory_echo.hpp"
 #include "clustering/reactor/reactor_json_adapters.hpp"
 #include "clustering/reactor/metadata.hpp"
+#include "config/args.hpp"
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/cow_ptr_type.hpp"
 #include "containers/cow_ptr.hpp"
@@ -61,7 +62,11 @@ void debug_print(printf_buffer_t *buf, const ack_expectation_t &x);
 template<class protocol_t>
 class namespace_semilattice_metadata_t {
 public:
-    namespace_semilattice_metadata_t() : cache_size(GIGABYTE) { }
+    namespace_semilattice_metadata_t()
+        : cache_size(GIGABYTE), cpu_sharding_factor(CPU_SHARDING_FACTOR),
+          inline_value_size(DEFAULT_INLINE_VALUE_SIZE),
+          write_buffer_size(DEFAULT_WRITE_BUFFER_SIZE),
+          time_ordered_keys(false) { }
 
     vclock_t<persistable_blueprint_t<protocol_t> > blueprint;
     vclock_t<datacenter_id_t> primary_datacenter;
@@ -75,8 +80,24 @@ public:
     vclock_t<std::string> primary_key; //TODO this should actually never be changed...
     vclock_t<database_id_t> database;
     vclock_t<int64_t> cache_size;
-
-    RDB_MAKE_ME_SERIALIZABLE_12(blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size);
+    // How many hash-based stores each machine splits the table into.  Only read
+    // when a machine creates its files for the table, so it can't be changed
+    // afterwards.
+    vclock_t<int32_t> cpu_sharding_factor;
+    // How big the blob references of new documents are (see `rdb_value_t`), which
+    // is how big a document can be and still be kept in its leaf node.  Stores read
+    // it when they're started.
+    vclock_t<int32_t> inline_value_size;
+    // How many bytes of writes each store may buffer before writing them to its
+    // btree (see `btree_write_buffer_t`), or zero for none.  Stores read it when
+    // they're started.
+    vclock_t<int64_t> write_buffer_size;
+    // Whether the primary keys that inserts generate start with the time, so that
+    // new documents go at the end of each store's btree (see
+    // `generate_time_ordered_uuid`).
+    vclock_t<bool> time_ordered_keys;
+
+    RDB_MAKE_ME_SERIALIZABLE_16(blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size, cpu_sharding_factor, inline_value_size, write_buffer_size, time_ordered_keys);
 };
 
 template <class protocol_t>
@@ -103,6 +124,14 @@ void debug_print(printf_buffer_t *buf, const namespace_semilattice_metadata_t<pr
     debug_print(buf, m.primary_key);
     buf->appendf(", database=");
     debug_print(buf, m.database);
+    buf->appendf(", cpu_sharding_factor=");
+    debug_print(buf, m.cpu_sharding_factor);
+    buf->appendf(", inline_value_size=");
+    debug_print(buf, m.inline_value_size);
+    buf->appendf(", write_buffer_size=");
+    debug_print(buf, m.write_buffer_size);
+    buf->appendf(", time_ordered_keys=");
+    debug_print(buf, m.time_ordered_keys);
     buf->appendf("}");
 }
 
@@ -110,7 +139,8 @@ template<class protocol_t>
 namespace_semilattice_metadata_t<protocol_t> new_namespace(
     uuid_u machine, uuid_u database, uuid_u datacenter,
     const name_string_t &name, const std::string &key, int port,
-    int64_t cache_size) {
+    int64_t cache_size, int32_t cpu_sharding_factor, int32_t inline_value_size,
+    int64_t write_buffer_size, bool time_ordered_keys) {
 
     namespace_semilattice_metadata_t<protocol_t> ns;
     ns.database           = make_vclock(database, machine);
@@ -137,14 +167,18 @@ namespace_semilattice_metadata_t<protocol_t> new_namespace(
     ns.secondary_pinnings = make_vclock(secondary_pinnings, machine);
 
     ns.cache_size = make_vclock(cache_size, machine);
+    ns.cpu_sharding_factor = make_vclock(cpu_sharding_factor, machine);
+    ns.inline_value_size = make_vclock(inline_value_size, machine);
+    ns.write_buffer_size = make_vclock(write_buffer_size, machine);
+    ns.time_ordered_keys = make_vclock(time_ordered_keys, machine);
     return ns;
 }
 
 template<class protocol_t>
-RDB_MAKE_SEMILATTICE_JOINABLE_12(namespace_semilattice_metadata_t<protocol_t>, blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size);
+RDB_MAKE_SEMILATTICE_JOINABLE_16(namespace_semilattice_metadata_t<protocol_t>, blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size, cpu_sharding_factor, inline_value_size, write_buffer_size, time_ordered_keys);
 
 template<class protocol_t>
-RDB_MAKE_EQUALITY_COMPARABLE_12(namespace_semilattice_metadata_t<protocol_t>, blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size);
+RDB_MAKE_EQUALITY_COMPARABLE_16(namespace_semilattice_metadata_t<protocol_t>, blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size, cpu_sharding_factor, inline_value_size, write_buffer_size, time_ordered_keys);
 
 // ctx-less json adapter concept for ack_expectation_t
 json_adapter_if_t::json_adapter_map_t get_json_subfields(ack_expectation_t *target);
@@ -177,6 +211,9 @@ public:
 template<class protocol_t>
 RDB_MAKE_SEMILATTICE_JOINABLE_1(namespaces_semilattice_metadata_t<protocol_t>, namespaces);
 
+template<class protocol_t>
+RDB_MAKE_SEMILATTICE_DELTA_1(namespaces_semilattice_metadata_t<protocol_t>, namespaces);
+
 template<class protocol_t>
 RDB_MAKE_EQUALITY_COMPARABLE_1(namespaces_semilattice_metadata_t<protocol_t>, namespaces);
 
@@ -227,6 +264,25 @@ template <class protocol_t>
 RDB_MAKE_EQUALITY_COMPARABLE_1(namespaces_directory_metadata_t<protocol_t>,
     reactor_bcards);
 
+/* Takes the business cards that haven't changed from `old_value`, so that the
+reactor and `namespace_repo_t` see the same `cow_ptr_t` for every table except
+the ones that changed. See `directory_reuse_unchanged()` in
+`rpc/directory/read_manager.hpp`. */
+template <class protocol_t>
+bool directory_reuse_unchanged(const namespaces_directory_metadata_t<protocol_t> &old_value,
+                               namespaces_directory_metadata_t<protocol_t> *new_value) {
+    bool changed = old_value.reactor_bcards.size() != new_value->reactor_bcards.size();
+    for (auto it = new_value->reactor_bcards.begin(); it != new_value->reactor_bcards.end(); ++it) {
+        auto jt = old_value.reactor_bcards.find(it->first);
+        if (jt != old_value.reactor_bcards.end() && jt->second.is_same_version(it->second)) {
+            it->second = jt->second;
+        } else {
+            changed = true;
+        }
+    }
+    return changed;
+}
+
 // ctx-less json adapter concept for namespaces_directory_metadata_t
 template <class protocol_t>
 json_adapter_if_t::json_adapter_map_t get_json_subfields(namespaces_directory_metadata_t<protocol_t> *target);
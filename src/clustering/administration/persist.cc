@@ -47,12 +47,12 @@ static void write_blob(buf_parent_t parent, char *ref, int maxreflen,
     intrusive_list_t<write_buffer_t> *buffers = msg.unsafe_expose_buffers();
     size_t slen = 0;
     for (write_buffer_t *p = buffers->head(); p != NULL; p = buffers->next(p)) {
-        slen += p->size;
+        slen += p->get_size();
     }
     std::string str;
     str.reserve(slen);
     for (write_buffer_t *p = buffers->head(); p != NULL; p = buffers->next(p)) {
-        str.append(p->data, p->size);
+        str.append(p->get_data(), p->get_size());
     }
     guarantee(str.size() == slen);
     blob_t blob(parent.cache()->get_block_size(), ref, maxreflen);
@@ -351,6 +351,7 @@ public:
         std::pair<typename std::map<branch_id_t, branch_birth_certificate_t<protocol_t> >::iterator, bool>
             insert_res = bh.branches.insert(std::make_pair(branch_id, bc));
         guarantee(insert_res.second);
+        recent_branches.insert(branch_id);
         flush(interruptor);
     }
 
@@ -380,11 +381,31 @@ public:
                                signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
         home_thread_mixin_t::assert_thread();
         for (typename std::map<branch_id_t, branch_birth_certificate_t<protocol_t> >::const_iterator it = new_records.branches.begin(); it != new_records.branches.end(); it++) {
-            bh.branches.insert(std::make_pair(it->first, it->second));
+            if (bh.branches.insert(std::make_pair(it->first, it->second)).second) {
+                recent_branches.insert(it->first);
+            }
         }
         flush(interruptor);
     }
 
+    void compact_branch_history(const std::set<branch_id_t> &live_branches,
+                                signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        home_thread_mixin_t::assert_thread();
+        std::set<branch_id_t> roots = live_branches;
+        roots.insert(recent_branches.begin(), recent_branches.end());
+        recent_branches.clear();
+
+        branch_history_t<protocol_t> live;
+        collect_branch_ancestry(bh, roots, &live);
+        if (live.branches.size() == bh.branches.size()) {
+            return;
+        }
+        logINF("Compacting the branch history from %zu to %zu branches.\n",
+               bh.branches.size(), live.branches.size());
+        bh.branches.swap(live.branches);
+        flush(interruptor);
+    }
+
 private:
     void flush(UNUSED signal_t *interruptor) {
         object_buffer_t<txn_t> txn;
@@ -401,6 +422,9 @@ private:
     cluster_persistent_file_t *parent;
     char (cluster_metadata_superblock_t::*field_name)[cluster_metadata_superblock_t::BRANCH_HISTORY_BLOB_MAXREFLEN];
     branch_history_t<protocol_t> bh;
+
+    // Branches created or imported since the last compaction.
+    std::set<branch_id_t> recent_branches;
 };
 
 /* These must be defined when the definition of
@@ -10,6 +10,7 @@
 
 #include "clustering/administration/machine_id_to_peer_id.hpp"
 #include "clustering/administration/metadata.hpp"
+#include "clustering/administration/store_opening_queue.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "clustering/reactor/blueprint.hpp"
 #include "concurrency/watchable.hpp"
@@ -66,7 +67,8 @@ template <class protocol_t>
 class svs_by_namespace_t {
 public:
     virtual void get_svs(perfmon_collection_t *perfmon_collection, namespace_id_t namespace_id,
-                         int64_t cache_size,
+                         int64_t cache_size, int cpu_sharding_factor,
+                         int inline_value_size, int64_t write_buffer_size,
                          stores_lifetimer_t<protocol_t> *stores_out,
                          scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
                          typename protocol_t::context_t *) = 0;
@@ -116,6 +118,11 @@ private:
         const namespace_id_t reactor_namespace,
         const boost::optional<reactor_directory_entry_t> &new_value);
     void commit_directory_changes(auto_drainer_t::lock_t lock);
+    // Every `BRANCH_HISTORY_COMPACTION_INTERVAL_MS`, drops the branches that
+    // neither our stores nor anybody's reactor business cards refer to.
+    void compact_branch_history_periodically(auto_drainer_t::lock_t lock);
+    bool get_live_branches(std::set<branch_id_t> *branches_out, signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t);
     // This function is passed by `commit_directory_changes()` into the
     // `apply_read()` method of the directory watchable
     static bool apply_directory_changes(
@@ -150,6 +157,10 @@ private:
     // until after reactor_data is destructed.
     auto_drainer_t directory_change_drainer;
 
+    // New reactors wait in this for their turn to open their tables' stores.  It
+    // must stay alive until after reactor_data is destructed.
+    store_opening_queue_t store_opening_queue;
+
     reactor_map_t reactor_data;
 
     auto_drainer_t drainer;
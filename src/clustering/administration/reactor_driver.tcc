@@ -7,6 +7,7 @@
 #include <map>
 #include <set>
 #include <utility>
+#include <vector>
 
 #include "clustering/administration/machine_id_to_peer_id.hpp"
 #include "clustering/administration/metadata.hpp"
@@ -117,6 +118,10 @@ public:
                             reactor_driver_t<protocol_t> *parent,
                             namespace_id_t namespace_id,
                             int64_t _cache_size,
+                            int _cpu_sharding_factor,
+                            int _inline_value_size,
+                            int64_t _write_buffer_size,
+                            bool _is_primary,
                             const blueprint_t<protocol_t> &bp,
                             svs_by_namespace_t<protocol_t> *svs_by_namespace,
                             typename protocol_t::context_t *_ctx) :
@@ -126,7 +131,11 @@ public:
         parent_(parent),
         namespace_id_(namespace_id),
         svs_by_namespace_(svs_by_namespace),
-        cache_size(_cache_size)
+        cache_size(_cache_size),
+        cpu_sharding_factor(_cpu_sharding_factor),
+        inline_value_size(_inline_value_size),
+        write_buffer_size(_write_buffer_size),
+        is_primary(_is_primary)
     {
         coro_t::spawn_sometime(boost::bind(&watchable_and_reactor_t<protocol_t>::initialize_reactor, this, io_backender));
     }
@@ -276,6 +285,32 @@ public:
         return compute_write_durability(peer, namespace_id_, parent_->ack_info->per_thread_ack_info());
     }
 
+    /* Adds the branches that the stores' metainfo refers to to `branches_out`, or
+    returns false if the stores aren't open yet. */
+    bool get_store_branches(std::set<branch_id_t> *branches_out, signal_t *interruptor)
+            THROWS_ONLY(interrupted_exc_t) {
+        if (!reactor_has_been_initialized_.is_pulsed()) {
+            return false;
+        }
+        auto_drainer_t::lock_t keepalive(&store_drainer_);
+        wait_any_t interruptor_or_destroyed(interruptor, keepalive.get_drain_signal());
+
+        order_source_t order_source;
+        object_buffer_t<fifo_enforcer_sink_t::exit_read_t> read_token;
+        svs_->new_read_token(&read_token);
+        region_map_t<protocol_t, binary_blob_t> metainfo;
+        svs_->do_get_metainfo(order_source.check_in("watchable_and_reactor_t::get_store_branches").with_read_mode(),
+                              &read_token, &interruptor_or_destroyed, &metainfo);
+
+        region_map_t<protocol_t, version_range_t> versions = to_version_range_map(metainfo);
+        for (typename region_map_t<protocol_t, version_range_t>::const_iterator it = versions.begin();
+             it != versions.end(); ++it) {
+            branches_out->insert(it->second.earliest.branch);
+            branches_out->insert(it->second.latest.branch);
+        }
+        return true;
+    }
+
 private:
     typedef boost::optional<directory_echo_wrapper_t<cow_ptr_t<reactor_business_card_t<protocol_t> > > >
         extract_reactor_directory_per_peer_result_type;
@@ -303,8 +338,15 @@ private:
         perfmon_collection_t *namespace_collection = &perfmon_collections->namespace_collection;
         perfmon_collection_t *serializers_collection = &perfmon_collections->serializers_collection;
 
-        // TODO: We probably shouldn't have to pass in this perfmon collection.
-        svs_by_namespace_->get_svs(serializers_collection, namespace_id_, cache_size, &stores_lifetimer_, &svs_, ctx);
+        {
+            store_opening_queue_t::acq_t opening_slot(&parent_->store_opening_queue,
+                                                      is_primary);
+            // TODO: We probably shouldn't have to pass in this perfmon collection.
+            svs_by_namespace_->get_svs(serializers_collection, namespace_id_, cache_size, cpu_sharding_factor, inline_value_size, write_buffer_size, &stores_lifetimer_, &svs_, ctx);
+        }
+        logINF("Table %s is open (%zu more tables waiting to open).\n",
+               uuid_to_str(namespace_id_).c_str(),
+               parent_->store_opening_queue.num_waiting());
 
         auto const extract_reactor_directory_per_peer_fun =
             boost::bind(&watchable_and_reactor_t<protocol_t>::extract_reactor_directory_per_peer,
@@ -358,6 +400,15 @@ private:
 
     scoped_ptr_t<typename watchable_t<directory_echo_wrapper_t<cow_ptr_t<reactor_business_card_t<protocol_t> > > >::subscription_t> reactor_directory_subscription_;
     int64_t cache_size;
+    int cpu_sharding_factor;
+    int inline_value_size;
+    int64_t write_buffer_size;
+    // Whether this server is a primary for any of the table's shards, which lets
+    // it open the table's stores sooner at startup.
+    bool is_primary;
+
+    // Keeps `svs_` alive for `get_store_branches()`.
+    auto_drainer_t store_drainer_;
 
     DISABLE_COPYING(watchable_and_reactor_t);
 };
@@ -386,6 +437,7 @@ reactor_driver_t<protocol_t>::reactor_driver_t(const base_path_t &_base_path,
       svs_by_namespace(_svs_by_namespace),
       ack_info(new ack_info_t<protocol_t>(machine_id_translation_table, machines_view, namespaces_view)),
       watchable_variable(namespaces_directory_metadata_t<protocol_t>()),
+      store_opening_queue(MAX_CONCURRENT_STORE_OPENINGS),
       semilattice_subscription(boost::bind(&reactor_driver_t<protocol_t>::on_change, this), namespaces_view),
       translation_table_subscription(boost::bind(&reactor_driver_t<protocol_t>::on_change, this)),
       perfmon_collection_repo(_perfmon_collection_repo)
@@ -393,6 +445,10 @@ reactor_driver_t<protocol_t>::reactor_driver_t(const base_path_t &_base_path,
     watchable_t<change_tracking_map_t<peer_id_t, machine_id_t> >::freeze_t freeze(machine_id_translation_table);
     translation_table_subscription.reset(machine_id_translation_table, &freeze);
     on_change();
+
+    coro_t::spawn_sometime(
+        boost::bind(&reactor_driver_t<protocol_t>::compact_branch_history_periodically,
+                    this, auto_drainer_t::lock_t(&drainer)));
 }
 
 template<class protocol_t>
@@ -476,6 +532,107 @@ void reactor_driver_t<protocol_t>::delete_reactor_data(
     svs_by_namespace->destroy_svs(namespace_id);
 }
 
+/* The branches that a reactor business card refers to. */
+template <class protocol_t>
+class branch_collector_t : public boost::static_visitor<void> {
+public:
+    explicit branch_collector_t(std::set<branch_id_t> *_branches) : branches(_branches) { }
+
+    void operator()(const typename reactor_business_card_t<protocol_t>::primary_t &primary) const {
+        branches->insert(primary.broadcaster.branch_id);
+    }
+    void operator()(const typename reactor_business_card_t<protocol_t>::secondary_up_to_date_t &secondary) const {
+        branches->insert(secondary.branch_id);
+    }
+    void operator()(const typename reactor_business_card_t<protocol_t>::secondary_without_primary_t &secondary) const {
+        add_version_map(secondary.current_state);
+    }
+    void operator()(const typename reactor_business_card_t<protocol_t>::nothing_when_safe_t &nothing) const {
+        add_version_map(nothing.current_state);
+    }
+    template <class activity_t>
+    void operator()(const activity_t &) const { }
+
+    void add_version_map(const region_map_t<protocol_t, version_range_t> &versions) const {
+        for (typename region_map_t<protocol_t, version_range_t>::const_iterator it = versions.begin();
+             it != versions.end(); ++it) {
+            branches->insert(it->second.earliest.branch);
+            branches->insert(it->second.latest.branch);
+        }
+    }
+
+private:
+    std::set<branch_id_t> *branches;
+};
+
+template<class protocol_t>
+void reactor_driver_t<protocol_t>::compact_branch_history_periodically(auto_drainer_t::lock_t lock) {
+    try {
+        for (;;) {
+            nap(BRANCH_HISTORY_COMPACTION_INTERVAL_MS, lock.get_drain_signal());
+            std::set<branch_id_t> live_branches;
+            if (get_live_branches(&live_branches, lock.get_drain_signal())) {
+                branch_history_manager->compact_branch_history(live_branches,
+                                                               lock.get_drain_signal());
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        // We're shutting down.
+    }
+}
+
+/* Returns false if we can't tell for sure which branches our stores refer to: if a
+table's blueprint is in conflict (so it may have data here without a reactor) or
+a reactor hasn't opened its stores yet. */
+template<class protocol_t>
+bool reactor_driver_t<protocol_t>::get_live_branches(std::set<branch_id_t> *branches_out,
+                                                     signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t) {
+    cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > namespaces = namespaces_view->get();
+    std::vector<namespace_id_t> namespace_ids;
+    for (typename namespaces_semilattice_metadata_t<protocol_t>::namespace_map_t::const_iterator
+             it = namespaces->namespaces.begin(); it != namespaces->namespaces.end(); ++it) {
+        if (it->second.is_deleted()) {
+            continue;
+        }
+        if (it->second.get_ref().blueprint.in_conflict()) {
+            return false;
+        }
+        namespace_ids.push_back(it->first);
+    }
+
+    /* Whatever branches the peers' reactors (and ours) are advertising. Peers send
+    the histories of their own stores' branches along when it matters, but there's
+    no harm in keeping these. */
+    std::map<peer_id_t, namespaces_directory_metadata_t<protocol_t> > directory
+        = directory_view->get().get_inner();
+    for (typename std::map<peer_id_t, namespaces_directory_metadata_t<protocol_t> >::const_iterator
+             it = directory.begin(); it != directory.end(); ++it) {
+        for (auto jt = it->second.reactor_bcards.begin(); jt != it->second.reactor_bcards.end(); ++jt) {
+            const reactor_business_card_t<protocol_t> &bcard = *jt->second.internal;
+            for (auto kt = bcard.activities.begin(); kt != bcard.activities.end(); ++kt) {
+                boost::apply_visitor(branch_collector_t<protocol_t>(branches_out),
+                                     kt->second.activity);
+            }
+        }
+    }
+
+    /* Whatever our stores' metainfo refers to, which is what we really can't lose.
+    The reactors may come and go while we wait for the stores, so we look each one up
+    again every time. */
+    for (auto it = namespace_ids.begin(); it != namespace_ids.end(); ++it) {
+        typename reactor_map_t::iterator reactor_it = reactor_data.find(*it);
+        if (reactor_it == reactor_data.end()) {
+            continue;
+        }
+        if (!reactor_it->second->get_store_branches(branches_out, interruptor)) {
+            return false;
+        }
+    }
+    branches_out->erase(nil_uuid());
+    return true;
+}
+
 template<class protocol_t>
 void reactor_driver_t<protocol_t>::on_change() {
     cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > namespaces = namespaces_view->get();
@@ -538,8 +695,65 @@ void reactor_driver_t<protocol_t>::on_change() {
                                 it->second.get_ref().name.in_conflict() ? "Name in conflict" : it->second.get_ref().name.get().c_str());
                     }
 
+                    int cpu_sharding_factor;
+                    if (it->second.get_ref().cpu_sharding_factor.in_conflict()) {
+                        cpu_sharding_factor = CPU_SHARDING_FACTOR;
+                    } else {
+                        cpu_sharding_factor = it->second.get_ref().cpu_sharding_factor.get();
+                    }
+
+                    if (cpu_sharding_factor < 1
+                        || cpu_sharding_factor > MAX_CPU_SHARDING_FACTOR) {
+                        cpu_sharding_factor = CPU_SHARDING_FACTOR;
+                        logWRN("Namespace %s(%s) has an invalid cpu sharding factor. Using %d instead.\n",
+                                uuid_to_str(it->first).c_str(),
+                                it->second.get_ref().name.in_conflict() ? "Name in conflict" : it->second.get_ref().name.get().c_str(),
+                                cpu_sharding_factor);
+                    }
+
+                    int inline_value_size;
+                    if (it->second.get_ref().inline_value_size.in_conflict()) {
+                        inline_value_size = DEFAULT_INLINE_VALUE_SIZE;
+                    } else {
+                        inline_value_size = it->second.get_ref().inline_value_size.get();
+                    }
+
+                    if (inline_value_size < DEFAULT_INLINE_VALUE_SIZE
+                        || inline_value_size > MAX_INLINE_VALUE_SIZE) {
+                        inline_value_size = DEFAULT_INLINE_VALUE_SIZE;
+                        logWRN("Namespace %s(%s) has an invalid inline value size. Using %d instead.\n",
+                                uuid_to_str(it->first).c_str(),
+                                it->second.get_ref().name.in_conflict() ? "Name in conflict" : it->second.get_ref().name.get().c_str(),
+                                inline_value_size);
+                    }
+
+                    int64_t write_buffer_size;
+                    if (it->second.get_ref().write_buffer_size.in_conflict()) {
+                        write_buffer_size = DEFAULT_WRITE_BUFFER_SIZE;
+                    } else {
+                        write_buffer_size = it->second.get_ref().write_buffer_size.get();
+                    }
+
+                    if (write_buffer_size < 0
+                        || write_buffer_size > MAX_WRITE_BUFFER_SIZE) {
+                        write_buffer_size = DEFAULT_WRITE_BUFFER_SIZE;
+                        logWRN("Namespace %s(%s) has an invalid write buffer size. Using %" PRIi64 " instead.\n",
+                                uuid_to_str(it->first).c_str(),
+                                it->second.get_ref().name.in_conflict() ? "Name in conflict" : it->second.get_ref().name.get().c_str(),
+                                write_buffer_size);
+                    }
+
+                    bool is_primary = false;
+                    const typename blueprint_t<protocol_t>::region_to_role_map_t &roles
+                        = bp.peers_roles.find(mbox_manager->get_connectivity_service()->get_me())->second;
+                    for (auto role_it = roles.begin(); role_it != roles.end(); ++role_it) {
+                        if (role_it->second == blueprint_role_primary) {
+                            is_primary = true;
+                        }
+                    }
+
                     namespace_id_t tmp = it->first;
-                    reactor_data.insert(tmp, new watchable_and_reactor_t<protocol_t>(base_path, io_backender, this, it->first, cache_size, bp, svs_by_namespace, ctx));
+                    reactor_data.insert(tmp, new watchable_and_reactor_t<protocol_t>(base_path, io_backender, this, it->first, cache_size, cpu_sharding_factor, inline_value_size, write_buffer_size, is_primary, bp, svs_by_namespace, ctx));
                 } else {
                     struct op_closure_t {
                         static bool apply(const blueprint_t<protocol_t> &_bp,
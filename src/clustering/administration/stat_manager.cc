@@ -6,10 +6,12 @@
 #include "concurrency/watchable.hpp"
 #include "perfmon/collect.hpp"
 #include "perfmon/archive.hpp"
+#include "perfmon/snapshot.hpp"
 #include "stl_utils.hpp"
 
-stat_manager_t::stat_manager_t(mailbox_manager_t* mm) :
+stat_manager_t::stat_manager_t(mailbox_manager_t* mm, perfmon_snapshotter_t *ss) :
     mailbox_manager(mm),
+    snapshotter(ss),
     get_stats_mailbox(mailbox_manager, boost::bind(&stat_manager_t::on_stats_request, this, _1, _2))
     { }
 
@@ -23,7 +25,8 @@ void stat_manager_t::on_stats_request(const return_address_t& reply_address, con
 
 void stat_manager_t::perform_stats_request(const return_address_t& reply_address, const std::set<std::string>& requested_stats, auto_drainer_t::lock_t) {
     perfmon_filter_t request(requested_stats);
-    scoped_ptr_t<perfmon_result_t> perfmon_result(perfmon_get_stats());
+    scoped_ptr_t<perfmon_result_t> perfmon_result(
+        snapshotter != NULL ? snapshotter->get_stats() : perfmon_get_stats());
     request.filter(&perfmon_result);
     guarantee(perfmon_result.has());
     send(mailbox_manager, reply_address, *perfmon_result);
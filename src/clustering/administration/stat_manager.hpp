@@ -9,6 +9,8 @@
 #include "perfmon/types.hpp"
 #include "rpc/mailbox/typed.hpp"
 
+class perfmon_snapshotter_t;
+
 class stat_manager_t {
 public:
     typedef std::string stat_id_t;
@@ -16,7 +18,10 @@ public:
     typedef mailbox_t<void(return_address_t, std::set<stat_id_t>)> get_stats_mailbox_t;
     typedef get_stats_mailbox_t::address_t get_stats_mailbox_address_t;
 
-    explicit stat_manager_t(mailbox_manager_t* mailbox_manager);
+    // If `snapshotter` isn't NULL, requests are answered from its latest snapshot
+    // instead of by collecting the stats there and then.
+    explicit stat_manager_t(mailbox_manager_t* mailbox_manager,
+                            perfmon_snapshotter_t *snapshotter = NULL);
 
     get_stats_mailbox_address_t get_address();
 
@@ -25,6 +30,7 @@ private:
     void perform_stats_request(const return_address_t& reply_address, const std::set<stat_id_t>& requested_stats, auto_drainer_t::lock_t);
 
     mailbox_manager_t *mailbox_manager;
+    perfmon_snapshotter_t *snapshotter;
     get_stats_mailbox_t get_stats_mailbox;
 
     auto_drainer_t drainer;
@@ -0,0 +1,43 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/store_opening_queue.hpp"
+
+store_opening_queue_t::store_opening_queue_t(int capacity)
+    : free_slots_(capacity) {
+    guarantee(capacity > 0);
+}
+
+store_opening_queue_t::~store_opening_queue_t() {
+    assert_thread();
+    guarantee(primary_waiters_.empty() && other_waiters_.empty());
+}
+
+void store_opening_queue_t::release_slot() {
+    assert_thread();
+    std::deque<cond_t *> *waiters
+        = !primary_waiters_.empty() ? &primary_waiters_ : &other_waiters_;
+    if (waiters->empty()) {
+        ++free_slots_;
+    } else {
+        // The slot goes straight to the next waiter.
+        cond_t *next = waiters->front();
+        waiters->pop_front();
+        next->pulse();
+    }
+}
+
+store_opening_queue_t::acq_t::acq_t(store_opening_queue_t *parent, bool is_primary)
+    : parent_(parent) {
+    parent_->assert_thread();
+    if (parent_->free_slots_ > 0) {
+        --parent_->free_slots_;
+        return;
+    }
+    cond_t got_slot;
+    (is_primary ? &parent_->primary_waiters_ : &parent_->other_waiters_)
+        ->push_back(&got_slot);
+    got_slot.wait();
+}
+
+store_opening_queue_t::acq_t::~acq_t() {
+    parent_->release_slot();
+}
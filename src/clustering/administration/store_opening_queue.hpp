@@ -0,0 +1,48 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_STORE_OPENING_QUEUE_HPP_
+#define CLUSTERING_ADMINISTRATION_STORE_OPENING_QUEUE_HPP_
+
+#include <deque>
+
+#include "concurrency/cond_var.hpp"
+#include "utils.hpp"
+
+/* When a server with many tables starts, every table opens its serializer and caches
+at once, and they all wait on the disk together, so none of them is ready until
+nearly all of them are.  A `store_opening_queue_t` lets only `capacity` tables open
+their stores at a time, and lets the tables this server is a primary for go ahead of
+the others, since they're the ones clients are waiting on.  It must be used on a
+single thread. */
+class store_opening_queue_t : public home_thread_mixin_t {
+public:
+    explicit store_opening_queue_t(int capacity);
+    ~store_opening_queue_t();
+
+    // Holds one of the queue's slots for as long as it exists.  The constructor
+    // blocks until there is one.
+    class acq_t {
+    public:
+        acq_t(store_opening_queue_t *parent, bool is_primary);
+        ~acq_t();
+
+    private:
+        store_opening_queue_t *parent_;
+
+        DISABLE_COPYING(acq_t);
+    };
+
+    size_t num_waiting() const {
+        return primary_waiters_.size() + other_waiters_.size();
+    }
+
+private:
+    void release_slot();
+
+    int free_slots_;
+    std::deque<cond_t *> primary_waiters_;
+    std::deque<cond_t *> other_waiters_;
+
+    DISABLE_COPYING(store_opening_queue_t);
+};
+
+#endif  // CLUSTERING_ADMINISTRATION_STORE_OPENING_QUEUE_HPP_
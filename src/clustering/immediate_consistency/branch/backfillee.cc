@@ -1,42 +1,76 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/immediate_consistency/branch/backfillee.hpp"
 
+#include <map>
+#include <set>
+
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/fifo_enforcer_queue.hpp"
+#include "concurrency/pmap.hpp"
 #include "concurrency/promise.hpp"
 #include "concurrency/queue/unlimited_fifo.hpp"
+#include "concurrency/semaphore.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
 #include "containers/death_runner.hpp"
+#include "containers/map_sentries.hpp"
 
 #define ALLOCATION_CHUNK 50
 
+/* How many hash sub-ranges of each CPU shard `backfillee()` backfills as
+separate sessions, and how many of those sessions may run at once. */
+#define BACKFILLEE_SUBRANGES_PER_CPU_SHARD 4
+#define BACKFILLEE_MAX_PARALLEL_SESSIONS 4
+
 template <class protocol_t>
 struct backfill_queue_entry_t {
+    enum type_t {
+        /* An actual backfill chunk */
+        CHUNK,
+        /* Everything for `sent_region` was sent before this */
+        PROGRESS,
+        /* The backfill is over */
+        DONE
+    };
+
     // TODO: The fact that fifo_enforcer_queue_t requires a default
     // constructor (and assignment operator, presumably) is completely asinine.
     backfill_queue_entry_t() { }
-    backfill_queue_entry_t(bool _is_not_last_backfill_chunk,
+    backfill_queue_entry_t(type_t _type,
                            const typename protocol_t::backfill_chunk_t &_chunk,
+                           const typename protocol_t::region_t &_sent_region,
                            fifo_enforcer_write_token_t _write_token)
-        : is_not_last_backfill_chunk(_is_not_last_backfill_chunk),
+        : type(_type),
           chunk(_chunk),
+          sent_region(_sent_region),
           write_token(_write_token) { }
 
-    bool is_not_last_backfill_chunk;
+    type_t type;
     typename protocol_t::backfill_chunk_t chunk;
+    typename protocol_t::region_t sent_region;
     fifo_enforcer_write_token_t write_token;
 };
 
 template <class protocol_t>
 void push_chunk_on_queue(fifo_enforcer_queue_t<backfill_queue_entry_t<protocol_t> > *queue,
                          typename protocol_t::backfill_chunk_t chunk, fifo_enforcer_write_token_t token) {
-    queue->push(token, backfill_queue_entry_t<protocol_t>(true, chunk, token));
+    queue->push(token, backfill_queue_entry_t<protocol_t>(backfill_queue_entry_t<protocol_t>::CHUNK,
+                                                          chunk, typename protocol_t::region_t(), token));
+}
+
+template <class protocol_t>
+void push_progress_on_queue(fifo_enforcer_queue_t<backfill_queue_entry_t<protocol_t> > *queue,
+                            typename protocol_t::region_t sent_region, fifo_enforcer_write_token_t token) {
+    queue->push(token, backfill_queue_entry_t<protocol_t>(backfill_queue_entry_t<protocol_t>::PROGRESS,
+                                                          typename protocol_t::backfill_chunk_t(), sent_region, token));
 }
 
 template <class protocol_t>
 void push_finish_on_queue(fifo_enforcer_queue_t<backfill_queue_entry_t<protocol_t> > *queue, fifo_enforcer_write_token_t token) {
-    queue->push(token, backfill_queue_entry_t<protocol_t>(false, typename protocol_t::backfill_chunk_t(), token));
+    queue->push(token, backfill_queue_entry_t<protocol_t>(backfill_queue_entry_t<protocol_t>::DONE,
+                                                          typename protocol_t::backfill_chunk_t(), typename protocol_t::region_t(), token));
 }
 
 
@@ -48,10 +82,12 @@ class chunk_callback_t : public coro_pool_callback_t<backfill_queue_entry_t<prot
 public:
     chunk_callback_t(store_view_t<protocol_t> *_svs,
                      fifo_enforcer_queue_t<backfill_queue_entry_t<protocol_t> > *_chunk_queue, mailbox_manager_t *_mbox_manager,
-                     mailbox_addr_t<void(int)> _allocation_mailbox) :
+                     mailbox_addr_t<void(int)> _allocation_mailbox,
+                     const region_map_t<protocol_t, version_range_t> *_end_point) :
         svs(_svs), chunk_queue(_chunk_queue), mbox_manager(_mbox_manager),
-        allocation_mailbox(_allocation_mailbox), unacked_chunks(0),
-        done_message_arrived(false), num_outstanding_chunks(0)
+        allocation_mailbox(_allocation_mailbox), end_point(_end_point), unacked_chunks(0),
+        done_message_arrived(false), num_outstanding_chunks(0),
+        num_chunks_started(0), num_chunks_applied_in_order(0)
     { }
 
     void apply_backfill_chunk(fifo_enforcer_write_token_t chunk_token, const typename protocol_t::backfill_chunk_t& chunk, signal_t *interruptor) {
@@ -63,10 +99,49 @@ public:
         svs->receive_backfill(chunk, &token_pair, interruptor);
     }
 
+    /* Once every chunk before the progress message has been applied, records
+    in the metainfo that `sent_region` has reached the end point, so that if
+    this session is interrupted, the next one starts from there. */
+    void apply_progress(fifo_enforcer_write_token_t progress_token, const typename protocol_t::region_t &sent_region, signal_t *interruptor) {
+        const uint64_t chunks_before = num_chunks_started;
+        object_buffer_t<fifo_enforcer_sink_t::exit_write_t> write_token;
+        svs->new_write_token(&write_token);
+        chunk_queue->finish_write(progress_token);
+
+        if (num_chunks_applied_in_order < chunks_before) {
+            cond_t applied;
+            multimap_insertion_sentry_t<uint64_t, cond_t *> waiter(&applied_waiters, chunks_before, &applied);
+            wait_interruptible(&applied, interruptor);
+        }
+
+        svs->set_metainfo(
+            region_map_transform<protocol_t, version_range_t, binary_blob_t>(end_point->mask(sent_region),
+                                                                             &binary_blob_t::make<version_range_t>),
+            order_token_t::ignore,
+            &write_token,
+            interruptor);
+    }
+
+    /* Chunks finish in any order; this tracks how many of the first chunks have
+    all finished and wakes up the progress messages that were waiting on them. */
+    void note_chunk_applied(uint64_t chunk_number) {
+        chunks_applied_out_of_order.insert(chunk_number);
+        while (!chunks_applied_out_of_order.empty()
+               && *chunks_applied_out_of_order.begin() == num_chunks_applied_in_order) {
+            chunks_applied_out_of_order.erase(chunks_applied_out_of_order.begin());
+            ++num_chunks_applied_in_order;
+        }
+        for (typename std::multimap<uint64_t, cond_t *>::iterator it = applied_waiters.begin();
+             it != applied_waiters.end() && it->first <= num_chunks_applied_in_order;
+             ++it) {
+            it->second->pulse_if_not_already_pulsed();
+        }
+    }
+
     void coro_pool_callback(backfill_queue_entry_t<protocol_t> chunk, signal_t *interruptor) {
         assert_thread();
         try {
-            if (chunk.is_not_last_backfill_chunk) {
+            if (chunk.type == backfill_queue_entry_t<protocol_t>::CHUNK) {
                 /* This is an actual backfill chunk */
 
                 /* Before letting the next thing go, increment
@@ -76,9 +151,11 @@ public:
                    latter is so that the backfill chunks acquire the
                    superblock in the correct order. */
                 num_outstanding_chunks++;
+                const uint64_t chunk_number = num_chunks_started++;
 
                 // We acquire the write token in apply_backfill_chunk.
                 apply_backfill_chunk(chunk.write_token, chunk.chunk, interruptor);
+                note_chunk_applied(chunk_number);
 
                 /* Allow the backfiller to send us more data */
                 int chunks_to_send_out = 0;
@@ -100,6 +177,14 @@ public:
 
                 num_outstanding_chunks--;
 
+            } else if (chunk.type == backfill_queue_entry_t<protocol_t>::PROGRESS) {
+                /* The backfiller has sent everything for `sent_region`. This
+                counts as outstanding so that the final metainfo isn't written
+                underneath it. */
+                num_outstanding_chunks++;
+                apply_progress(chunk.write_token, chunk.sent_region, interruptor);
+                num_outstanding_chunks--;
+
             } else {
                 /* This is a fake backfill "chunk" that just indicates
                    that the backfill is over */
@@ -117,7 +202,8 @@ public:
                before the queue drains. That can only happen if we are
                being interrupted or if we lost contact with the backfiller.
                In either case, abort; the store will be left in a
-               half-backfilled state. */
+               half-backfilled state, except for the parts that progress
+               messages already recorded. */
         }
     }
 
@@ -128,10 +214,19 @@ private:
     fifo_enforcer_queue_t<backfill_queue_entry_t<protocol_t> > *chunk_queue;
     mailbox_manager_t *mbox_manager;
     mailbox_addr_t<void(int)> allocation_mailbox;
+    const region_map_t<protocol_t, version_range_t> *end_point;
     int unacked_chunks;
     bool done_message_arrived;
     int num_outstanding_chunks;
 
+    /* Chunks are numbered in the order they come off the queue. Every chunk
+    numbered below `num_chunks_applied_in_order` has been applied, and so have
+    the ones in `chunks_applied_out_of_order`. */
+    uint64_t num_chunks_started;
+    uint64_t num_chunks_applied_in_order;
+    std::set<uint64_t> chunks_applied_out_of_order;
+    std::multimap<uint64_t, cond_t *> applied_waiters;
+
     DISABLE_COPYING(chunk_callback_t);
 };
 
@@ -142,18 +237,19 @@ void receive_end_point_message(promise_t<std::pair<region_map_t<protocol_t, vers
     promise->pulse(std::make_pair(end_point, associated_branch_history));
 }
 
+/* Runs one backfill session over `region`, which ends with the metainfo for
+`region` set to the backfiller's version as of when the session started. */
 template<class protocol_t>
-void backfillee(
+void backfillee_session(
         mailbox_manager_t *mailbox_manager,
         branch_history_manager_t<protocol_t> *branch_history_manager,
         store_view_t<protocol_t> *svs,
-        typename protocol_t::region_t region,
-        clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t<protocol_t> > > > > backfiller_metadata,
+        const typename protocol_t::region_t &region,
+        const clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t<protocol_t> > > > > &backfiller_metadata,
         backfill_session_id_t backfill_session_id,
         signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t)
 {
-    rassert(region_is_superset(svs->get_region(), region));
     resource_access_t<backfiller_business_card_t<protocol_t> > backfiller(backfiller_metadata);
 
     /* Read the metadata to determine where we're starting from */
@@ -199,9 +295,17 @@ void backfillee(
             boost::bind(&push_finish_on_queue<protocol_t>, &chunk_queue, _1));
 
         /* The backfiller will send individual chunks of the backfill to
-        `chunk_mailbox`. */
+        `chunk_mailbox`. They go in the bulk class so they don't hold up other
+        traffic with the backfiller; `chunk_queue` puts them back in order with
+        the done message. */
         mailbox_t<void(backfill_chunk_t, fifo_enforcer_write_token_t)> chunk_mailbox(
-            mailbox_manager, boost::bind(&push_chunk_on_queue<protocol_t>, &chunk_queue, _1, _2));
+            mailbox_manager, boost::bind(&push_chunk_on_queue<protocol_t>, &chunk_queue, _1, _2),
+            message_class_t::bulk);
+
+        /* Every so often the backfiller tells `progress_mailbox` that it has
+        sent all of a part of `region`. These go in order with the chunks. */
+        mailbox_t<void(typename protocol_t::region_t, fifo_enforcer_write_token_t)> progress_mailbox(
+            mailbox_manager, boost::bind(&push_progress_on_queue<protocol_t>, &chunk_queue, _1, _2));
 
         /* The backfiller will register for allocations on the allocation
          * registration box. */
@@ -216,6 +320,7 @@ void backfillee(
             start_point, start_point_associated_history,
             end_point_mailbox.get_address(),
             chunk_mailbox.get_address(),
+            progress_mailbox.get_address(),
             done_mailbox.get_address(),
             alloc_registration_mbox.get_address());
 
@@ -317,7 +422,7 @@ void backfillee(
             &write_token,
             interruptor);
 
-        chunk_callback_t<protocol_t> chunk_callback(svs, &chunk_queue, mailbox_manager, allocation_mailbox);
+        chunk_callback_t<protocol_t> chunk_callback(svs, &chunk_queue, mailbox_manager, allocation_mailbox, &end_point);
 
         coro_pool_t<backfill_queue_entry_t<protocol_t> > backfill_workers(10, &chunk_queue, &chunk_callback);
 
@@ -348,6 +453,116 @@ void backfillee(
         interruptor);
 }
 
+/* Backfills one of the sub-ranges of a region as its own session, once one of
+the `BACKFILLEE_MAX_PARALLEL_SESSIONS` slots is free. If it loses the backfiller,
+it pulses `failed`, which interrupts the other sub-ranges. */
+template <class protocol_t>
+class subrange_backfillee_t {
+public:
+    subrange_backfillee_t(mailbox_manager_t *_mailbox_manager,
+                          branch_history_manager_t<protocol_t> *_branch_history_manager,
+                          store_view_t<protocol_t> *_svs,
+                          const std::vector<typename protocol_t::region_t> *_subregions,
+                          const clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t<protocol_t> > > > > *_backfiller_metadata,
+                          backfill_session_id_t _backfill_session_id,
+                          semaphore_t *_session_semaphore,
+                          cond_t *_failed,
+                          signal_t *_interruptor)
+        : mailbox_manager(_mailbox_manager),
+          branch_history_manager(_branch_history_manager),
+          svs(_svs),
+          subregions(_subregions),
+          backfiller_metadata(_backfiller_metadata),
+          backfill_session_id(_backfill_session_id),
+          session_semaphore(_session_semaphore),
+          failed(_failed),
+          interruptor(_interruptor) { }
+
+    void operator()(int i) const {
+        try {
+            session_semaphore->co_lock_interruptible(interruptor);
+            try {
+                backfillee_session<protocol_t>(mailbox_manager, branch_history_manager, svs,
+                                               (*subregions)[i], *backfiller_metadata,
+                                               backfill_session_id, interruptor);
+            } catch (...) {
+                session_semaphore->unlock();
+                throw;
+            }
+            session_semaphore->unlock();
+        } catch (const interrupted_exc_t &) {
+            /* Either our caller was interrupted or another sub-range failed;
+            `backfillee()` checks which. */
+        } catch (const resource_lost_exc_t &) {
+            failed->pulse_if_not_already_pulsed();
+        }
+    }
+
+private:
+    mailbox_manager_t *mailbox_manager;
+    branch_history_manager_t<protocol_t> *branch_history_manager;
+    store_view_t<protocol_t> *svs;
+    const std::vector<typename protocol_t::region_t> *subregions;
+    const clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t<protocol_t> > > > > *backfiller_metadata;
+    backfill_session_id_t backfill_session_id;
+    semaphore_t *session_semaphore;
+    cond_t *failed;
+    signal_t *interruptor;
+};
+
+template<class protocol_t>
+void backfillee(
+        mailbox_manager_t *mailbox_manager,
+        branch_history_manager_t<protocol_t> *branch_history_manager,
+        store_view_t<protocol_t> *svs,
+        typename protocol_t::region_t region,
+        clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t<protocol_t> > > > > backfiller_metadata,
+        backfill_session_id_t backfill_session_id,
+        signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t)
+{
+    rassert(region_is_superset(svs->get_region(), region));
+
+    /* Split `region` into hash sub-ranges that each fit in one CPU shard, and
+    backfill them concurrently over separate sessions. Each session records its
+    end point in the metainfo as soon as it's done, so if we're interrupted, the
+    next backfill only has to catch up on what changed since then. */
+    std::vector<typename protocol_t::region_t> subregions;
+    const int num_subspaces = CPU_SHARDING_FACTOR * BACKFILLEE_SUBRANGES_PER_CPU_SHARD;
+    for (int i = 0; i < num_subspaces; ++i) {
+        typename protocol_t::region_t subregion =
+            region_intersection(region, protocol_t::cpu_sharding_subspace(i, num_subspaces));
+        if (!region_is_empty(subregion)) {
+            subregions.push_back(subregion);
+        }
+    }
+
+    if (subregions.size() > 1) {
+        static_semaphore_t session_semaphore(BACKFILLEE_MAX_PARALLEL_SESSIONS);
+        cond_t failed;
+        wait_any_t subrange_interruptor(interruptor, &failed);
+        pmap(subregions.size(), subrange_backfillee_t<protocol_t>(
+            mailbox_manager, branch_history_manager, svs, &subregions,
+            &backfiller_metadata, backfill_session_id,
+            &session_semaphore, &failed, &subrange_interruptor));
+
+        if (interruptor->is_pulsed()) {
+            throw interrupted_exc_t();
+        }
+        if (failed.is_pulsed()) {
+            throw resource_lost_exc_t();
+        }
+    }
+
+    /* The sub-ranges finished at different times, so they're at different
+    versions, and `listener_t` needs the whole region at a single one. This last
+    session brings them all up to date; it only has to send what changed since
+    each sub-range finished. */
+    backfillee_session<protocol_t>(mailbox_manager, branch_history_manager, svs,
+                                   region, backfiller_metadata,
+                                   backfill_session_id, interruptor);
+}
+
 
 #include "memcached/protocol.hpp"
 #include "mock/dummy_protocol.hpp"
@@ -11,7 +11,9 @@ template <class> class clone_ptr_t;
 template <class> class watchable_t;
 
 /* `backfillee()` contacts the given backfiller and requests a backfill from it.
-It takes responsibility for updating the metainfo. */
+It takes responsibility for updating the metainfo. The hash sub-ranges of
+`region` are backfilled concurrently and each one's metainfo is updated as soon
+as it's done, so an interrupted backfill doesn't have to start over. */
 
 template<class protocol_t>
 void backfillee(
@@ -5,6 +5,7 @@
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/semaphore.hpp"
+#include "containers/map_sentries.hpp"
 #include "rpc/semilattice/view.hpp"
 #include "stl_utils.hpp"
 
@@ -21,7 +22,9 @@ backfiller_t<protocol_t>::backfiller_t(mailbox_manager_t *mm,
     : mailbox_manager(mm), branch_history_manager(bhm),
       svs(_svs),
       backfill_mailbox(mailbox_manager,
-                       boost::bind(&backfiller_t::on_backfill, this, _1, _2, _3, _4, _5, _6, _7, auto_drainer_t::lock_t(&drainer))),
+                       std::bind(&backfiller_t::on_backfill, this,
+                                 ph::_1, ph::_2, ph::_3, ph::_4, ph::_5, ph::_6, ph::_7, ph::_8,
+                                 auto_drainer_t::lock_t(&drainer))),
       cancel_backfill_mailbox(mailbox_manager,
                               boost::bind(&backfiller_t::on_cancel_backfill, this, _1, auto_drainer_t::lock_t(&drainer))),
       request_progress_mailbox(mailbox_manager,
@@ -103,6 +106,7 @@ public:
                                         mailbox_addr_t<void(region_map_t<protocol_t, version_range_t>, branch_history_t<protocol_t>)> end_point_cont,
                                         mailbox_manager_t *mailbox_manager,
                                         mailbox_addr_t<void(typename protocol_t::backfill_chunk_t, fifo_enforcer_write_token_t)> chunk_cont,
+                                        mailbox_addr_t<void(typename protocol_t::region_t, fifo_enforcer_write_token_t)> progress_cont,
                                         fifo_enforcer_source_t *fifo_src,
                                         semaphore_t *chunk_semaphore,
                                         backfiller_t<protocol_t> *backfiller)
@@ -110,6 +114,7 @@ public:
           end_point_cont_(end_point_cont),
           mailbox_manager_(mailbox_manager),
           chunk_cont_(chunk_cont),
+          progress_cont_(progress_cont),
           fifo_src_(fifo_src),
           chunk_semaphore_(chunk_semaphore),
           backfiller_(backfiller) { }
@@ -121,11 +126,19 @@ public:
     void send_chunk(const typename protocol_t::backfill_chunk_t &chunk, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
         do_send_chunk<protocol_t>(mailbox_manager_, chunk_cont_, chunk, fifo_src_, chunk_semaphore_, interruptor);
     }
+
+    /* Progress messages don't count against the chunk allocation, but they go
+    through `fifo_src_` so that the backfillee sees them after every chunk that
+    was sent before them. */
+    void send_progress(const typename protocol_t::region_t &sent_region, UNUSED signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        send(mailbox_manager_, progress_cont_, sent_region, fifo_src_->enter_write());
+    }
 private:
     const region_map_t<protocol_t, version_range_t> *start_point_;
     mailbox_addr_t<void(region_map_t<protocol_t, version_range_t>, branch_history_t<protocol_t>)> end_point_cont_;
     mailbox_manager_t *mailbox_manager_;
     mailbox_addr_t<void(typename protocol_t::backfill_chunk_t, fifo_enforcer_write_token_t)> chunk_cont_;
+    mailbox_addr_t<void(typename protocol_t::region_t, fifo_enforcer_write_token_t)> progress_cont_;
     fifo_enforcer_source_t *fifo_src_;
     semaphore_t *chunk_semaphore_;
     backfiller_t<protocol_t> *backfiller_;
@@ -139,6 +152,7 @@ void backfiller_t<protocol_t>::on_backfill(backfill_session_id_t session_id,
                                            const branch_history_t<protocol_t> &start_point_associated_branch_history,
                                            mailbox_addr_t<void(region_map_t<protocol_t, version_range_t>, branch_history_t<protocol_t>)> end_point_cont,
                                            mailbox_addr_t<void(typename protocol_t::backfill_chunk_t, fifo_enforcer_write_token_t)> chunk_cont,
+                                           mailbox_addr_t<void(typename protocol_t::region_t, fifo_enforcer_write_token_t)> progress_cont,
                                            mailbox_addr_t<void(fifo_enforcer_write_token_t)> done_cont,
                                            mailbox_addr_t<void(mailbox_addr_t<void(int)>)> allocation_registration_box,
                                            auto_drainer_t::lock_t keepalive) {
@@ -149,11 +163,11 @@ void backfiller_t<protocol_t>::on_backfill(backfill_session_id_t session_id,
     /* Set up a local interruptor cond and put it in the map so that this
        session can be interrupted if the backfillee decides to abort */
     cond_t local_interruptor;
-    map_insertion_sentry_t<backfill_session_id_t, cond_t *> be_interruptible(&local_interruptors, session_id, &local_interruptor);
+    multimap_insertion_sentry_t<backfill_session_id_t, cond_t *> be_interruptible(&local_interruptors, session_id, &local_interruptor);
 
     /* Set up a local progress monitor so people can query us for progress. */
     traversal_progress_combiner_t local_progress;
-    map_insertion_sentry_t<backfill_session_id_t, traversal_progress_combiner_t *> display_progress(&local_backfill_progress, session_id, &local_progress);
+    multimap_insertion_sentry_t<backfill_session_id_t, traversal_progress_combiner_t *> display_progress(&local_backfill_progress, session_id, &local_progress);
 
     /* Set up a cond that gets pulsed if we're interrupted by either the
        backfillee stopping or the backfiller destructor being called, but don't
@@ -177,7 +191,7 @@ void backfiller_t<protocol_t>::on_backfill(backfill_session_id_t session_id,
         svs->new_read_token_pair(&send_backfill_token_pair);
 
         backfiller_send_backfill_callback_t<protocol_t>
-            send_backfill_cb(&start_point, end_point_cont, mailbox_manager, chunk_cont, &fifo_src, &chunk_semaphore, this);
+            send_backfill_cb(&start_point, end_point_cont, mailbox_manager, chunk_cont, progress_cont, &fifo_src, &chunk_semaphore, this);
 
         /* Actually perform the backfill */
         svs->send_backfill(
@@ -186,7 +200,7 @@ void backfiller_t<protocol_t>::on_backfill(backfill_session_id_t session_id,
                                                       &get_earliest_timestamp_of_version_range
                                                       ),
                      &send_backfill_cb,
-                     local_backfill_progress[session_id],
+                     &local_progress,
                      &send_backfill_token_pair,
                      &interrupted);
 
@@ -207,10 +221,13 @@ void backfiller_t<protocol_t>::on_cancel_backfill(backfill_session_id_t session_
 
     assert_thread();
 
-    typename std::map<backfill_session_id_t, cond_t *>::iterator it =
-        local_interruptors.find(session_id);
-    if (it != local_interruptors.end()) {
-        it->second->pulse();
+    typedef typename std::multimap<backfill_session_id_t, cond_t *>::iterator interruptor_iterator_t;
+    std::pair<interruptor_iterator_t, interruptor_iterator_t> range =
+        local_interruptors.equal_range(session_id);
+    if (range.first != range.second) {
+        for (interruptor_iterator_t it = range.first; it != range.second; ++it) {
+            it->second->pulse_if_not_already_pulsed();
+        }
     } else {
         /* The backfill ended on its own right as we were trying to cancel
            it. Since the backfill was over, we removed the local interruptor
@@ -225,9 +242,24 @@ template <class protocol_t>
 void backfiller_t<protocol_t>::request_backfill_progress(backfill_session_id_t session_id,
                                                          mailbox_addr_t<void(std::pair<int, int>)> response_mbox,
                                                          auto_drainer_t::lock_t) {
-    if (std_contains(local_backfill_progress, session_id) && local_backfill_progress[session_id]) {
-        progress_completion_fraction_t fraction = local_backfill_progress[session_id]->guess_completion();
-        std::pair<int, int> pair_fraction = std::make_pair(fraction.estimate_of_released_nodes, fraction.estimate_of_total_nodes);
+    typedef typename std::multimap<backfill_session_id_t, traversal_progress_combiner_t *>::iterator progress_iterator_t;
+    std::pair<progress_iterator_t, progress_iterator_t> range =
+        local_backfill_progress.equal_range(session_id);
+    if (range.first != range.second) {
+        /* Add up the progress of all the sub-ranges being backfilled under this
+        session ID, skipping the ones that can't guess yet. */
+        progress_completion_fraction_t total;
+        for (progress_iterator_t it = range.first; it != range.second; ++it) {
+            progress_completion_fraction_t fraction = it->second->guess_completion();
+            if (!fraction.invalid()) {
+                if (total.invalid()) {
+                    total = progress_completion_fraction_t(0, 0);
+                }
+                total.estimate_of_released_nodes += fraction.estimate_of_released_nodes;
+                total.estimate_of_total_nodes += fraction.estimate_of_total_nodes;
+            }
+        }
+        std::pair<int, int> pair_fraction = std::make_pair(total.estimate_of_released_nodes, total.estimate_of_total_nodes);
         send(mailbox_manager, response_mbox, pair_fraction);
     } else {
         send(mailbox_manager, response_mbox, std::make_pair(-1, -1));
@@ -39,6 +39,7 @@ private:
             const branch_history_t<protocol_t> &start_point_associated_branch_history,
             mailbox_addr_t<void(region_map_t<protocol_t, version_range_t>, branch_history_t<protocol_t>)> end_point_cont,
             mailbox_addr_t<void(typename protocol_t::backfill_chunk_t, fifo_enforcer_write_token_t)> chunk_cont,
+            mailbox_addr_t<void(typename protocol_t::region_t, fifo_enforcer_write_token_t)> progress_cont,
             mailbox_addr_t<void(fifo_enforcer_write_token_t)> done_cont,
             mailbox_addr_t<void(mailbox_addr_t<void(int)>)> allocation_registration_box,
             auto_drainer_t::lock_t keepalive);
@@ -54,8 +55,10 @@ private:
 
     store_view_t<protocol_t> *const svs;
 
-    std::map<backfill_session_id_t, cond_t *> local_interruptors;
-    std::map<backfill_session_id_t, traversal_progress_combiner_t *> local_backfill_progress;
+    /* A backfillee may backfill several sub-ranges under the same session ID at
+    once, so these can have more than one entry per session. */
+    std::multimap<backfill_session_id_t, cond_t *> local_interruptors;
+    std::multimap<backfill_session_id_t, traversal_progress_combiner_t *> local_backfill_progress;
     auto_drainer_t drainer;
 
     typename backfiller_business_card_t<protocol_t>::backfill_mailbox_t backfill_mailbox;
@@ -4,19 +4,28 @@
 #include "utils.hpp"
 #include <boost/make_shared.hpp>
 
+#include "arch/timing.hpp"
 #include "concurrency/coro_fifo.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
+#include "containers/archive/archive.hpp"
 #include "containers/death_runner.hpp"
 #include "containers/uuid.hpp"
 #include "clustering/immediate_consistency/branch/listener.hpp"
 #include "clustering/immediate_consistency/branch/multistore.hpp"
 // TODO: Make us not include master.hpp -- we do it only for the ack_checker_t type.
 #include "clustering/immediate_consistency/query/master.hpp"
+#include "logger.hpp"
 #include "rpc/mailbox/typed.hpp"
 #include "rpc/semilattice/view/field.hpp"
 #include "rpc/semilattice/view/member.hpp"
 
+/* Writes that pile up for a readable mirror while the broadcaster is busy are sent
+together, in messages of at most this many writes. */
+#define BROADCASTER_MAX_WRITEREAD_BATCH_SIZE 64
+
 template <class protocol_t>
 broadcaster_t<protocol_t>::write_callback_t::write_callback_t() : write(NULL) { }
 
@@ -37,6 +46,8 @@ broadcaster_t<protocol_t>::broadcaster_t(mailbox_manager_t *mm,
         signal_t *interruptor) THROWS_ONLY(interrupted_exc_t)
     : broadcaster_collection(),
       broadcaster_membership(parent_perfmon_collection, &broadcaster_collection, "broadcaster"),
+      backpressure_waits(),
+      backpressure_waits_membership(&broadcaster_collection, &backpressure_waits, "backpressure_waits"),
       mailbox_manager(mm),
       branch_id(generate_uuid()),
       branch_history_manager(bhm),
@@ -130,11 +141,13 @@ store_view_t<protocol_t> *broadcaster_t<protocol_t>::release_bootstrap_svs_for_l
 template <class protocol_t>
 class broadcaster_t<protocol_t>::incomplete_write_t : public home_thread_mixin_debug_only_t {
 public:
-    incomplete_write_t(broadcaster_t *p, const typename protocol_t::write_t &w, transition_timestamp_t ts, write_callback_t *cb) :
-        write(w), timestamp(ts), callback(cb), parent(p), incomplete_count(0) { }
+    incomplete_write_t(broadcaster_t *p, const typename protocol_t::write_t &w, transition_timestamp_t ts, size_t sz, write_callback_t *cb) :
+        write(w), timestamp(ts), size(sz), callback(cb), parent(p), incomplete_count(0) { }
 
     const typename protocol_t::write_t write;
     const transition_timestamp_t timestamp;
+    /* How big `write` is when we send it to a mirror */
+    const size_t size;
     write_callback_t *callback;
 
 private:
@@ -193,6 +206,18 @@ private:
     boost::shared_ptr<incomplete_write_t> write;
 };
 
+template <class protocol_t>
+class broadcaster_t<protocol_t>::pending_writeread_t {
+public:
+    pending_writeread_t(const incomplete_write_ref_t &w, order_token_t ot,
+                        fifo_enforcer_write_token_t t, write_durability_t d)
+        : write_ref(w), order_token(ot), token(t), durability(d) { }
+    incomplete_write_ref_t write_ref;
+    order_token_t order_token;
+    fifo_enforcer_write_token_t token;
+    write_durability_t durability;
+};
+
 /* The `registrar_t` constructs a `dispatchee_t` for every mirror that
    connects to us. */
 
@@ -203,12 +228,19 @@ public:
         write_mailbox(d.write_mailbox), is_readable(false),
         queue_count(),
         queue_count_membership(&c->broadcaster_collection, &queue_count, uuid_to_str(d.write_mailbox.get_peer().get_uuid()) + "_broadcast_queue_count"),
+        unacked_bytes(0), is_lagging(false), is_exempt_from_backpressure(false),
+        lag_writes(),
+        lag_writes_membership(&c->broadcaster_collection, &lag_writes, uuid_to_str(d.write_mailbox.get_peer().get_uuid()) + "_broadcast_lag_writes"),
+        lag_bytes(),
+        lag_bytes_membership(&c->broadcaster_collection, &lag_bytes, uuid_to_str(d.write_mailbox.get_peer().get_uuid()) + "_broadcast_lag_bytes"),
+        ack_latency(secs_to_ticks(1), false),
+        ack_latency_membership(&c->broadcaster_collection, &ack_latency, uuid_to_str(d.write_mailbox.get_peer().get_uuid()) + "_broadcast_ack_latency"),
         background_write_queue(&queue_count),
         // TODO magic constant
         background_write_workers(100, &background_write_queue, &background_write_caller),
         controller(c),
         upgrade_mailbox(controller->mailbox_manager,
-            boost::bind(&dispatchee_t::upgrade, this, _1, _2, auto_drainer_t::lock_t(&drainer))),
+            boost::bind(&dispatchee_t::upgrade, this, _1, _2, _3, auto_drainer_t::lock_t(&drainer))),
         downgrade_mailbox(controller->mailbox_manager,
             boost::bind(&dispatchee_t::downgrade, this, _1, auto_drainer_t::lock_t(&drainer)))
     {
@@ -233,6 +265,7 @@ public:
         for (typename std::list<boost::shared_ptr<incomplete_write_t> >::iterator it = controller->incomplete_writes.begin();
                 it != controller->incomplete_writes.end(); it++) {
 
+            controller->begin_mirror_write(this, it->get());
             coro_t::spawn_sometime(boost::bind(&broadcaster_t::background_write, controller,
                                                this, auto_drainer_t::lock_t(&drainer), incomplete_write_ref_t(*it), order_source.check_in("dispatchee_t"), fifo_source.enter_write()));
         }
@@ -243,6 +276,8 @@ public:
         ASSERT_FINITE_CORO_WAITING;
         if (is_readable) controller->readable_dispatchees.remove(this);
         controller->dispatchees.erase(this);
+        /* We might have been the mirror that writes were being held back for. */
+        controller->pulse_lag_waiters();
         controller->assert_thread();
     }
 
@@ -266,6 +301,7 @@ private:
 
     /* `upgrade()` and `downgrade()` are mailbox callbacks. */
     void upgrade(typename listener_business_card_t<protocol_t>::writeread_mailbox_t::address_t wrm,
+                 typename listener_business_card_t<protocol_t>::writeread_batch_mailbox_t::address_t wrbm,
                  typename listener_business_card_t<protocol_t>::read_mailbox_t::address_t rm,
                  auto_drainer_t::lock_t)
             THROWS_NOTHING {
@@ -274,6 +310,7 @@ private:
         guarantee(!is_readable);
         is_readable = true;
         writeread_mailbox = wrm;
+        writeread_batch_mailbox = wrbm;
         read_mailbox = rm;
         controller->readable_dispatchees.push_back(this);
     }
@@ -295,8 +332,13 @@ public:
     typename listener_business_card_t<protocol_t>::write_mailbox_t::address_t write_mailbox;
     bool is_readable;
     typename listener_business_card_t<protocol_t>::writeread_mailbox_t::address_t writeread_mailbox;
+    typename listener_business_card_t<protocol_t>::writeread_batch_mailbox_t::address_t writeread_batch_mailbox;
     typename listener_business_card_t<protocol_t>::read_mailbox_t::address_t read_mailbox;
 
+    /* Writes for `writeread_mailbox` that haven't been sent yet. If it's not
+    empty, `send_pending_writereads()` has been spawned to send them. */
+    std::vector<pending_writeread_t> pending_writereads;
+
     /* This is used to enforce that operations are performed on the
        destination machine in the same order that we send them, even if the
        network layer reorders the messages. */
@@ -311,6 +353,24 @@ public:
 
     perfmon_counter_t queue_count;
     perfmon_membership_t queue_count_membership;
+
+    /* Writes we've sent this mirror (or queued up to send it) that it hasn't
+    acked yet, keyed by their timestamps, with when we sent them. */
+    std::map<state_timestamp_t, ticks_t> unacked_writes;
+    int64_t unacked_bytes;
+    /* `is_lagging` is set when the mirror reaches `BROADCASTER_MAX_LAG_WRITES` or
+    `BROADCASTER_MAX_LAG_BYTES`, and cleared when it gets back under half of
+    them. `is_exempt_from_backpressure` is set if holding back writes didn't
+    let it catch up, so we stop holding them back for it while it's lagging. */
+    bool is_lagging;
+    bool is_exempt_from_backpressure;
+
+    perfmon_counter_t lag_writes;
+    perfmon_membership_t lag_writes_membership;
+    perfmon_counter_t lag_bytes;
+    perfmon_membership_t lag_bytes_membership;
+    perfmon_sampler_t ack_latency;
+    perfmon_membership_t ack_latency_membership;
     unlimited_fifo_queue_t<boost::function<void()> > background_write_queue;
     calling_callback_t background_write_caller;
 
@@ -394,7 +454,14 @@ void broadcaster_t<protocol_t>::spawn_write(const typename protocol_t::write_t &
 
     order_token.assert_write_mode();
 
+    write_message_t size_msg;
+    size_msg << write;
+    const size_t write_size = size_msg.size();
+
     wait_interruptible(lock, interruptor);
+    /* We hold back the write while we're at the head of the queue, so the
+    writes behind us wait too. */
+    wait_for_lagging_mirrors(interruptor);
     ASSERT_FINITE_CORO_WAITING;
 
     sanity_check();
@@ -414,7 +481,7 @@ void broadcaster_t<protocol_t>::spawn_write(const typename protocol_t::write_t &
     order_token = order_checkpoint.check_through(order_token);
 
     boost::shared_ptr<incomplete_write_t> write_wrapper = boost::make_shared<incomplete_write_t>(
-        this, write, timestamp, cb);
+        this, write, timestamp, write_size, cb);
     incomplete_writes.push_back(write_wrapper);
 
     // You can't reuse the same callback for two writes.
@@ -435,6 +502,7 @@ void broadcaster_t<protocol_t>::spawn_write(const typename protocol_t::write_t &
         that we don't check `interruptor` until the write is on its way
         to every dispatchee. */
         fifo_enforcer_write_token_t fifo_enforcer_token = it->first->fifo_source.enter_write();
+        begin_mirror_write(it->first, write_wrapper.get());
         if (it->first->is_readable) {
             durability_requirement_t durability_requirement = write.durability();
             write_durability_t durability;
@@ -452,8 +520,14 @@ void broadcaster_t<protocol_t>::spawn_write(const typename protocol_t::write_t &
                 unreachable();
             }
 
-            it->first->background_write_queue.push(boost::bind(&broadcaster_t::background_writeread, this,
-                it->first, it->second, write_ref, order_token, fifo_enforcer_token, durability));
+            std::vector<pending_writeread_t> *pending = &it->first->pending_writereads;
+            if (pending->empty()) {
+                coro_t::spawn_later_ordered(boost::bind(
+                    &broadcaster_t::send_pending_writereads, this,
+                    it->first, it->second));
+            }
+            pending->push_back(pending_writeread_t(
+                write_ref, order_token, fifo_enforcer_token, durability));
         } else {
             it->first->background_write_queue.push(boost::bind(&broadcaster_t::background_write, this,
                 it->first, it->second, write_ref, order_token, fifo_enforcer_token));
@@ -507,8 +581,10 @@ void broadcaster_t<protocol_t>::background_write(dispatchee_t *mirror, auto_drai
                                    write_ref.get()->write, write_ref.get()->timestamp, order_token, token,
                                    mirror_lock.get_drain_signal());
     } catch (const interrupted_exc_t &) {
-        return;
+        /* `mirror` is going away, but it's still there as long as we hold
+        `mirror_lock`. */
     }
+    end_mirror_write(mirror, write_ref.get().get());
 }
 
 template<class protocol_t>
@@ -523,6 +599,7 @@ void broadcaster_t<protocol_t>::background_writeread(dispatchee_t *mirror, auto_
         send(mailbox_manager, mirror->writeread_mailbox, write_ref.get()->write, write_ref.get()->timestamp, order_token, token, response_mailbox.get_address(), durability);
 
         wait_interruptible(&response_cond, mirror_lock.get_drain_signal());
+        end_mirror_write(mirror, write_ref.get().get());
 
         // TODO: Require that everybody provide a callback.
         if (write_ref.get()->callback) {
@@ -530,7 +607,65 @@ void broadcaster_t<protocol_t>::background_writeread(dispatchee_t *mirror, auto_
         }
 
     } catch (const interrupted_exc_t &) {
-        return;
+        end_mirror_write(mirror, write_ref.get().get());
+    }
+}
+
+template<class protocol_t>
+void broadcaster_t<protocol_t>::send_pending_writereads(dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock) THROWS_NOTHING {
+    ASSERT_FINITE_CORO_WAITING;
+    std::vector<pending_writeread_t> *pending = &mirror->pending_writereads;
+    guarantee(!pending->empty());
+    if (pending->size() == 1) {
+        const pending_writeread_t &w = pending->front();
+        mirror->background_write_queue.push(boost::bind(&broadcaster_t::background_writeread, this,
+            mirror, mirror_lock, w.write_ref, w.order_token, w.token, w.durability));
+    } else {
+        for (size_t i = 0; i < pending->size(); i += BROADCASTER_MAX_WRITEREAD_BATCH_SIZE) {
+            size_t end = std::min<size_t>(pending->size(), i + BROADCASTER_MAX_WRITEREAD_BATCH_SIZE);
+            boost::shared_ptr<std::vector<pending_writeread_t> > batch =
+                boost::make_shared<std::vector<pending_writeread_t> >(
+                    pending->begin() + i, pending->begin() + end);
+            mirror->background_write_queue.push(boost::bind(&broadcaster_t::background_writeread_batch, this,
+                mirror, mirror_lock, batch));
+        }
+    }
+    pending->clear();
+}
+
+template<class protocol_t>
+void broadcaster_t<protocol_t>::background_writeread_batch(dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock, boost::shared_ptr<std::vector<pending_writeread_t> > batch) THROWS_NOTHING {
+    try {
+        std::vector<listener_writeread_t<protocol_t> > writes;
+        writes.reserve(batch->size());
+        for (auto it = batch->begin(); it != batch->end(); ++it) {
+            writes.push_back(listener_writeread_t<protocol_t>(
+                it->write_ref.get()->write, it->write_ref.get()->timestamp,
+                it->order_token, it->token, it->durability));
+        }
+
+        cond_t response_cond;
+        std::vector<typename protocol_t::write_response_t> responses;
+        mailbox_t<void(std::vector<typename protocol_t::write_response_t>)> response_mailbox(
+            mailbox_manager,
+            boost::bind(&store_listener_response<std::vector<typename protocol_t::write_response_t> >,
+                        &responses, _1, &response_cond));
+
+        send(mailbox_manager, mirror->writeread_batch_mailbox, writes, response_mailbox.get_address());
+
+        wait_interruptible(&response_cond, mirror_lock.get_drain_signal());
+
+        guarantee(responses.size() == batch->size());
+        for (size_t i = 0; i < batch->size(); ++i) {
+            end_mirror_write(mirror, (*batch)[i].write_ref.get().get());
+            if ((*batch)[i].write_ref.get()->callback) {
+                (*batch)[i].write_ref.get()->callback->on_response(mirror->get_peer(), responses[i]);
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        for (auto it = batch->begin(); it != batch->end(); ++it) {
+            end_mirror_write(mirror, it->write_ref.get().get());
+        }
     }
 }
 
@@ -565,6 +700,97 @@ void broadcaster_t<protocol_t>::end_write(boost::shared_ptr<incomplete_write_t>
     }
 }
 
+template<class protocol_t>
+void broadcaster_t<protocol_t>::begin_mirror_write(dispatchee_t *mirror, const incomplete_write_t *write) THROWS_NOTHING {
+    ASSERT_NO_CORO_WAITING;
+    mirror->unacked_writes[write->timestamp.timestamp_after()] = get_ticks();
+    mirror->unacked_bytes += write->size;
+    ++mirror->lag_writes;
+    mirror->lag_bytes += write->size;
+
+    if (!mirror->is_lagging
+        && (mirror->unacked_writes.size() >= BROADCASTER_MAX_LAG_WRITES
+            || mirror->unacked_bytes >= BROADCASTER_MAX_LAG_BYTES)) {
+        mirror->is_lagging = true;
+        const ticks_t oldest = mirror->unacked_writes.begin()->second;
+        logWRN("Replica %s is falling behind: it hasn't acked %zu writes (%" PRIi64
+               " bytes), the oldest of them sent %.3f seconds ago. Writes to it will "
+               "be held back until it catches up.",
+               uuid_to_str(mirror->get_peer().get_uuid()).c_str(),
+               mirror->unacked_writes.size(), mirror->unacked_bytes,
+               ticks_to_secs(get_ticks() - oldest));
+    }
+}
+
+template<class protocol_t>
+void broadcaster_t<protocol_t>::end_mirror_write(dispatchee_t *mirror, const incomplete_write_t *write) THROWS_NOTHING {
+    ASSERT_NO_CORO_WAITING;
+    auto it = mirror->unacked_writes.find(write->timestamp.timestamp_after());
+    guarantee(it != mirror->unacked_writes.end());
+    mirror->ack_latency.record(ticks_to_secs(get_ticks() - it->second));
+    mirror->unacked_writes.erase(it);
+    mirror->unacked_bytes -= write->size;
+    --mirror->lag_writes;
+    mirror->lag_bytes -= write->size;
+
+    if (mirror->is_lagging
+        && mirror->unacked_writes.size() < BROADCASTER_MAX_LAG_WRITES / 2
+        && mirror->unacked_bytes < BROADCASTER_MAX_LAG_BYTES / 2) {
+        mirror->is_lagging = false;
+        mirror->is_exempt_from_backpressure = false;
+        logINF("Replica %s has caught up.",
+               uuid_to_str(mirror->get_peer().get_uuid()).c_str());
+    }
+    pulse_lag_waiters();
+}
+
+template<class protocol_t>
+void broadcaster_t<protocol_t>::wait_for_lagging_mirrors(signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+    signal_timer_t timeout;
+    for (;;) {
+        dispatchee_t *lagging = NULL;
+        for (auto it = dispatchees.begin(); it != dispatchees.end(); ++it) {
+            if (it->first->is_lagging && !it->first->is_exempt_from_backpressure) {
+                lagging = it->first;
+                break;
+            }
+        }
+        if (lagging == NULL) {
+            return;
+        }
+
+        if (!timeout.is_running()) {
+            ++backpressure_waits;
+            timeout.start(BROADCASTER_MAX_BACKPRESSURE_DELAY_MS);
+        } else if (timeout.is_pulsed()) {
+            lagging->is_exempt_from_backpressure = true;
+            logWRN("Replica %s isn't catching up even with writes held back for it; "
+                   "writes won't wait for it until it does.",
+                   uuid_to_str(lagging->get_peer().get_uuid()).c_str());
+            continue;
+        }
+
+        cond_t lag_changed;
+        lag_waiters.insert(&lag_changed);
+        wait_any_t waiter(&lag_changed, &timeout);
+        try {
+            wait_interruptible(&waiter, interruptor);
+        } catch (const interrupted_exc_t &) {
+            lag_waiters.erase(&lag_changed);
+            throw;
+        }
+        lag_waiters.erase(&lag_changed);
+    }
+}
+
+template<class protocol_t>
+void broadcaster_t<protocol_t>::pulse_lag_waiters() THROWS_NOTHING {
+    for (auto it = lag_waiters.begin(); it != lag_waiters.end(); ++it) {
+        (*it)->pulse();
+    }
+    lag_waiters.clear();
+}
+
 template<class protocol_t>
 void broadcaster_t<protocol_t>::single_read(
     const typename protocol_t::read_t &read,
@@ -4,6 +4,7 @@
 
 #include <list>
 #include <map>
+#include <set>
 #include <vector>
 
 #include "utils.hpp"
@@ -96,6 +97,10 @@ private:
 
     class dispatchee_t;
 
+    /* A write that `spawn_write()` has queued up for a readable dispatchee but
+    that hasn't been sent yet */
+    class pending_writeread_t;
+
     /* Reads need to pick a single readable mirror to perform the operation.
     Writes need to choose a readable mirror to get the reply from. Both use
     `pick_a_readable_dispatchee()` to do the picking. You must hold
@@ -118,8 +123,26 @@ private:
         dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock,
         incomplete_write_ref_t write_ref, order_token_t order_token,
         fifo_enforcer_write_token_t token, write_durability_t durability) THROWS_NOTHING;
+    /* Spawned by `spawn_write()` for the first write queued up for a readable
+    dispatchee, so that the writes that follow it in the same pass of the event
+    loop can go in the same message */
+    void send_pending_writereads(
+        dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock) THROWS_NOTHING;
+    void background_writeread_batch(
+        dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock,
+        boost::shared_ptr<std::vector<pending_writeread_t> > batch) THROWS_NOTHING;
     void end_write(boost::shared_ptr<incomplete_write_t> write) THROWS_NOTHING;
 
+    /* `begin_mirror_write()` is called when a write is sent (or queued to be
+    sent) to a mirror, and `end_mirror_write()` when the mirror acks it or goes
+    away, so we know how far behind each mirror is. */
+    void begin_mirror_write(dispatchee_t *mirror, const incomplete_write_t *write) THROWS_NOTHING;
+    void end_mirror_write(dispatchee_t *mirror, const incomplete_write_t *write) THROWS_NOTHING;
+    /* Holds back a new write while some mirror is too far behind, so that a slow
+    mirror slows writes down instead of being dropped once its queues blow up. */
+    void wait_for_lagging_mirrors(signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
+    void pulse_lag_waiters() THROWS_NOTHING;
+
     void single_read(
         const typename protocol_t::read_t &r,
         typename protocol_t::read_response_t *response,
@@ -143,6 +166,9 @@ private:
     perfmon_collection_t broadcaster_collection;
     perfmon_membership_t broadcaster_membership;
 
+    perfmon_counter_t backpressure_waits;
+    perfmon_membership_t backpressure_waits_membership;
+
     mailbox_manager_t *mailbox_manager;
 
     branch_id_t branch_id;
@@ -175,6 +201,10 @@ private:
     std::map<dispatchee_t *, auto_drainer_t::lock_t> dispatchees;
     intrusive_list_t<dispatchee_t> readable_dispatchees;
 
+    /* Pulsed (and removed) whenever a mirror acks a write or goes away, for
+    `wait_for_lagging_mirrors()` to check again. */
+    std::set<cond_t *> lag_waiters;
+
     registrar_t<listener_business_card_t<protocol_t>, broadcaster_t *, dispatchee_t>
         registrar;
 
@@ -1,6 +1,8 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/immediate_consistency/branch/history.hpp"
 
+#include <map>
+#include <set>
 #include <stack>
 
 template <class protocol_t>
@@ -83,6 +85,38 @@ bool version_is_divergent(
 }
 
 
+template <class protocol_t>
+void collect_branch_ancestry(
+        const branch_history_t<protocol_t> &history,
+        const std::set<branch_id_t> &branches,
+        branch_history_t<protocol_t> *out) {
+    std::set<branch_id_t> to_process;
+    for (std::set<branch_id_t>::const_iterator it = branches.begin(); it != branches.end(); ++it) {
+        if (!it->is_nil() && history.branches.count(*it) == 1 && out->branches.count(*it) == 0) {
+            to_process.insert(*it);
+        }
+    }
+    while (!to_process.empty()) {
+        branch_id_t next = *to_process.begin();
+        to_process.erase(to_process.begin());
+        typename std::map<branch_id_t, branch_birth_certificate_t<protocol_t> >::const_iterator bc_it = history.branches.find(next);
+        rassert(bc_it != history.branches.end());
+        out->branches.insert(*bc_it);
+        const region_map_t<protocol_t, version_range_t> &origin = bc_it->second.origin;
+        for (typename region_map_t<protocol_t, version_range_t>::const_iterator it = origin.begin(); it != origin.end(); ++it) {
+            // `version_is_ancestor()` follows `earliest`, exporting follows `latest`.
+            const branch_id_t parents[2] = { it->second.earliest.branch, it->second.latest.branch };
+            for (size_t i = 0; i < 2; ++i) {
+                if (!parents[i].is_nil() && out->branches.count(parents[i]) == 0
+                    && history.branches.count(parents[i]) == 1) {
+                    to_process.insert(parents[i]);
+                }
+            }
+        }
+    }
+}
+
+
 template <class protocol_t>
 region_map_t<protocol_t, version_range_t> to_version_range_map(const region_map_t<protocol_t, binary_blob_t> &blob_map) {
     return region_map_transform<protocol_t, binary_blob_t, version_range_t>(blob_map,
@@ -140,8 +174,23 @@ bool version_is_divergent<rdb_protocol_t>(
         version_t v2,
         const rdb_protocol_t::region_t &relevant_region);
 
+template void collect_branch_ancestry<mock::dummy_protocol_t>(
+        const branch_history_t<mock::dummy_protocol_t> &history,
+        const std::set<branch_id_t> &branches,
+        branch_history_t<mock::dummy_protocol_t> *out);
+
 template region_map_t<mock::dummy_protocol_t, version_range_t> to_version_range_map<mock::dummy_protocol_t>(const region_map_t<mock::dummy_protocol_t, binary_blob_t> &blob_map);
 
+template void collect_branch_ancestry<memcached_protocol_t>(
+        const branch_history_t<memcached_protocol_t> &history,
+        const std::set<branch_id_t> &branches,
+        branch_history_t<memcached_protocol_t> *out);
+
 template region_map_t<memcached_protocol_t, version_range_t> to_version_range_map<memcached_protocol_t>(const region_map_t<memcached_protocol_t, binary_blob_t> &blob_map);
 
+template void collect_branch_ancestry<rdb_protocol_t>(
+        const branch_history_t<rdb_protocol_t> &history,
+        const std::set<branch_id_t> &branches,
+        branch_history_t<rdb_protocol_t> *out);
+
 template region_map_t<rdb_protocol_t, version_range_t> to_version_range_map<rdb_protocol_t>(const region_map_t<rdb_protocol_t, binary_blob_t> &blob_map);
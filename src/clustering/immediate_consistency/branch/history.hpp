@@ -214,8 +214,25 @@ public:
     B-tree's metainfo and then crash, we had better be able to find the
     `branch_birth_certificate_t` when we start back up. */
     virtual void import_branch_history(const branch_history_t<protocol_t> &new_records, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
+
+    /* Forgets every branch that isn't in `live_branches` or an ancestor of one,
+    so that the history doesn't grow forever. Branches that were created or
+    imported since the last compaction are kept regardless, because their IDs may
+    not have reached any of the places that the caller got `live_branches` from
+    yet. Blocks until the smaller history is safely on disk. */
+    virtual void compact_branch_history(const std::set<branch_id_t> &live_branches, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
 };
 
+/* `collect_branch_ancestry()` copies the records in `history` for the branches in
+`branches` and for all of their ancestors into `out`. Branches that `history`
+doesn't know about are skipped. */
+
+template <class protocol_t>
+void collect_branch_ancestry(
+        const branch_history_t<protocol_t> &history,
+        const std::set<branch_id_t> &branches,
+        branch_history_t<protocol_t> *out);
+
 /* `version_is_ancestor()` returns `true` if every key in `relevant_region` of
 the table passed through `ancestor` version on the way to `descendent` version.
 Also returns true if `ancestor` and `descendent` are the same version. */
@@ -8,11 +8,16 @@
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/pmap.hpp"
 
 
-/* `WRITE_QUEUE_CORO_POOL_SIZE` is the number of coroutines that will be used
-when draining the write queue after completing a backfill. */
+/* The write queue is drained by between `WRITE_QUEUE_CORO_POOL_MIN_SIZE` and
+`WRITE_QUEUE_CORO_POOL_SIZE` coroutines; more are used while writes wait longer than
+`WRITE_QUEUE_TARGET_WAIT_MS` in the queue, for as long as they help (see
+`coro_pool_sizer_t`). */
 #define WRITE_QUEUE_CORO_POOL_SIZE 1000
+#define WRITE_QUEUE_CORO_POOL_MIN_SIZE 16
+#define WRITE_QUEUE_TARGET_WAIT_MS 10
 
 /* When we have caught up to the master to within
 `WRITE_QUEUE_SEMAPHORE_LONG_TERM_CAPACITY` elements, then we consider ourselves
@@ -79,6 +84,8 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
         boost::bind(&listener_t::on_write, this, _1, _2, _3, _4, _5)),
     writeread_mailbox_(mailbox_manager_,
         boost::bind(&listener_t::on_writeread, this, _1, _2, _3, _4, _5, _6)),
+    writeread_batch_mailbox_(mailbox_manager_,
+        boost::bind(&listener_t::on_writeread_batch, this, _1, _2)),
     read_mailbox_(mailbox_manager_,
         boost::bind(&listener_t::on_read, this, _1, _2, _3, _4, _5))
 {
@@ -212,8 +219,11 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
     current_timestamp_ = backfill_end_timestamp;
     write_queue_coro_pool_callback_.init(new boost_function_callback_t<write_queue_entry_t>(
             boost::bind(&listener_t<protocol_t>::perform_enqueued_write, this, _1, backfill_end_timestamp, _2)));
+    write_queue_coro_pool_sizer_.init(new coro_pool_sizer_t(
+            WRITE_QUEUE_CORO_POOL_MIN_SIZE, WRITE_QUEUE_CORO_POOL_SIZE,
+            WRITE_QUEUE_TARGET_WAIT_MS, &perfmon_collection_, "write_queue_workers"));
     write_queue_coro_pool_.init(new coro_pool_t<write_queue_entry_t>(
-            WRITE_QUEUE_CORO_POOL_SIZE, &write_queue_, write_queue_coro_pool_callback_.get()));
+            write_queue_coro_pool_sizer_.get(), &write_queue_, write_queue_coro_pool_callback_.get()));
     write_queue_semaphore_.set_capacity(WRITE_QUEUE_SEMAPHORE_LONG_TERM_CAPACITY);
 
     if (write_queue_.size() <= WRITE_QUEUE_SEMAPHORE_LONG_TERM_CAPACITY) {
@@ -248,6 +258,8 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
         boost::bind(&listener_t::on_write, this, _1, _2, _3, _4, _5)),
     writeread_mailbox_(mailbox_manager_,
         boost::bind(&listener_t::on_writeread, this, _1, _2, _3, _4, _5, _6)),
+    writeread_batch_mailbox_(mailbox_manager_,
+        boost::bind(&listener_t::on_writeread_batch, this, _1, _2)),
     read_mailbox_(mailbox_manager_,
         boost::bind(&listener_t::on_read, this, _1, _2, _3, _4, _5))
 {
@@ -299,9 +311,12 @@ listener_t<protocol_t>::listener_t(const base_path_t &base_path,
     current_timestamp_ = listener_intro.broadcaster_begin_timestamp;
     write_queue_coro_pool_callback_.init(new boost_function_callback_t<write_queue_entry_t>(
             boost::bind(&listener_t<protocol_t>::perform_enqueued_write, this, _1, current_timestamp_, _2)));
+    write_queue_coro_pool_sizer_.init(new coro_pool_sizer_t(
+            WRITE_QUEUE_CORO_POOL_MIN_SIZE, WRITE_QUEUE_CORO_POOL_SIZE,
+            WRITE_QUEUE_TARGET_WAIT_MS, &perfmon_collection_, "write_queue_workers"));
     write_queue_coro_pool_.init(
         new coro_pool_t<write_queue_entry_t>(
-            WRITE_QUEUE_CORO_POOL_SIZE, &write_queue_, write_queue_coro_pool_callback_.get()));
+            write_queue_coro_pool_sizer_.get(), &write_queue_, write_queue_coro_pool_callback_.get()));
 }
 
 template <class protocol_t>
@@ -491,51 +506,111 @@ void listener_t<protocol_t>::perform_writeread(const typename protocol_t::write_
         const write_durability_t durability,
         auto_drainer_t::lock_t keepalive) THROWS_NOTHING {
     try {
-        write_token_pair_t write_token_pair;
-        {
-            {
-                /* Briefly pass through `write_queue_entrance_sink_` in case we
-                are receiving a mix of writes and write-reads */
-                fifo_enforcer_sink_t::exit_write_t fifo_exit_1(&write_queue_entrance_sink_, fifo_token);
-            }
+        typename protocol_t::write_response_t response;
+        apply_writeread(write, transition_timestamp, order_token, fifo_token,
+                        durability, &response, keepalive.get_drain_signal());
+        send(mailbox_manager_, ack_addr, response);
+    } catch (const interrupted_exc_t &) {
+        /* pass */
+    }
+}
 
-            fifo_enforcer_sink_t::exit_write_t fifo_exit_2(&store_entrance_sink_, fifo_token);
-            wait_interruptible(&fifo_exit_2, keepalive.get_drain_signal());
+template <class protocol_t>
+void listener_t<protocol_t>::on_writeread_batch(
+        const std::vector<listener_writeread_t<protocol_t> > &writes,
+        mailbox_addr_t<void(std::vector<typename protocol_t::write_response_t>)> ack_addr)
+        THROWS_NOTHING {
+    for (auto it = writes.begin(); it != writes.end(); ++it) {
+        rassert(region_is_superset(our_branch_region_, it->write.get_region()));
+        rassert(!region_is_empty(it->write.get_region()));
+        rassert(region_is_superset(svs_->get_region(), it->write.get_region()));
+        it->order_token.assert_write_mode();
+    }
 
-            advance_current_timestamp_and_pulse_waiters(transition_timestamp);
+    coro_t::spawn_sometime(boost::bind(
+        &listener_t<protocol_t>::perform_writeread_batch, this,
+        writes, ack_addr, auto_drainer_t::lock_t(&drainer_)));
+}
 
-            svs_->new_write_token_pair(&write_token_pair);
+template <class protocol_t>
+void listener_t<protocol_t>::perform_writeread_batch(
+        const std::vector<listener_writeread_t<protocol_t> > &writes,
+        mailbox_addr_t<void(std::vector<typename protocol_t::write_response_t>)> ack_addr,
+        auto_drainer_t::lock_t keepalive) THROWS_NOTHING {
+    /* The writes go through the store one at a time like any others, but they
+    can all be waiting for their turn at once, just as if they had come in
+    separate messages. */
+    std::vector<typename protocol_t::write_response_t> responses(writes.size());
+    bool interrupted = false;
+    pmap(writes.size(), boost::bind(&listener_t<protocol_t>::perform_batched_writeread,
+                                    this, &writes, &responses, &interrupted,
+                                    keepalive.get_drain_signal(), _1));
+    if (!interrupted) {
+        send(mailbox_manager_, ack_addr, responses);
+    }
+}
+
+template <class protocol_t>
+void listener_t<protocol_t>::perform_batched_writeread(
+        const std::vector<listener_writeread_t<protocol_t> > *writes,
+        std::vector<typename protocol_t::write_response_t> *responses,
+        bool *interrupted,
+        signal_t *interruptor,
+        int i) THROWS_NOTHING {
+    const listener_writeread_t<protocol_t> &w = (*writes)[i];
+    try {
+        apply_writeread(w.write, w.transition_timestamp, w.order_token, w.fifo_token,
+                        w.durability, &(*responses)[i], interruptor);
+    } catch (const interrupted_exc_t &) {
+        *interrupted = true;
+    }
+}
+
+template <class protocol_t>
+void listener_t<protocol_t>::apply_writeread(const typename protocol_t::write_t &write,
+        transition_timestamp_t transition_timestamp,
+        order_token_t order_token,
+        fifo_enforcer_write_token_t fifo_token,
+        const write_durability_t durability,
+        typename protocol_t::write_response_t *response_out,
+        signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+    write_token_pair_t write_token_pair;
+    {
+        {
+            /* Briefly pass through `write_queue_entrance_sink_` in case we
+            are receiving a mix of writes and write-reads */
+            fifo_enforcer_sink_t::exit_write_t fifo_exit_1(&write_queue_entrance_sink_, fifo_token);
         }
 
-        // Make sure we can serve the entire operation without masking it.
-        // (We shouldn't have been signed up for writereads if we couldn't.)
-        rassert(region_is_superset(svs_->get_region(), write.get_region()));
+        fifo_enforcer_sink_t::exit_write_t fifo_exit_2(&store_entrance_sink_, fifo_token);
+        wait_interruptible(&fifo_exit_2, interruptor);
 
+        advance_current_timestamp_and_pulse_waiters(transition_timestamp);
 
-#ifndef NDEBUG
-        version_leq_metainfo_checker_callback_t<protocol_t> metainfo_checker_callback(transition_timestamp.timestamp_before());
-        metainfo_checker_t<protocol_t> metainfo_checker(&metainfo_checker_callback, svs_->get_region());
-#endif
+        svs_->new_write_token_pair(&write_token_pair);
+    }
 
-        // Perform the operation
-        typename protocol_t::write_response_t response;
+    // Make sure we can serve the entire operation without masking it.
+    // (We shouldn't have been signed up for writereads if we couldn't.)
+    rassert(region_is_superset(svs_->get_region(), write.get_region()));
 
-        svs_->write(DEBUG_ONLY(metainfo_checker, )
-                    region_map_t<protocol_t, binary_blob_t>(svs_->get_region(),
-                                                            binary_blob_t(version_range_t(version_t(branch_id_, transition_timestamp.timestamp_after())))),
-                    write,
-                    &response,
-                    durability,
-                    transition_timestamp,
-                    order_token,
-                    &write_token_pair,
-                    keepalive.get_drain_signal());
 
-        send(mailbox_manager_, ack_addr, response);
+#ifndef NDEBUG
+    version_leq_metainfo_checker_callback_t<protocol_t> metainfo_checker_callback(transition_timestamp.timestamp_before());
+    metainfo_checker_t<protocol_t> metainfo_checker(&metainfo_checker_callback, svs_->get_region());
+#endif
 
-    } catch (const interrupted_exc_t &) {
-        /* pass */
-    }
+    // Perform the operation
+    svs_->write(DEBUG_ONLY(metainfo_checker, )
+                region_map_t<protocol_t, binary_blob_t>(svs_->get_region(),
+                                                        binary_blob_t(version_range_t(version_t(branch_id_, transition_timestamp.timestamp_after())))),
+                write,
+                response_out,
+                durability,
+                transition_timestamp,
+                order_token,
+                &write_token_pair,
+                interruptor);
 }
 
 template <class protocol_t>
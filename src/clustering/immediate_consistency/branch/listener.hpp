@@ -23,6 +23,7 @@ template <class> class replier_t;
 template <class> class semilattice_read_view_t;
 template <class> class semilattice_readwrite_view_t;
 template <class> class watchable_t;
+class coro_pool_sizer_t;
 
 /* `listener_t` keeps a store-view in sync with a branch. Its constructor
 contacts a `broadcaster_t` to sign up for real-time updates, and also backfills
@@ -108,12 +109,22 @@ public:
         return writeread_mailbox_.get_address();
     }
 
+    typename listener_business_card_t<protocol_t>::writeread_batch_mailbox_t::address_t writeread_batch_address() const {
+        return writeread_batch_mailbox_.get_address();
+    }
+
     typename listener_business_card_t<protocol_t>::read_mailbox_t::address_t read_address() const {
         return read_mailbox_.get_address();
     }
 
     void wait_for_version(state_timestamp_t timestamp, signal_t *interruptor);
 
+    /* The timestamp of the last write we've applied. Call this on the store's
+    home thread. */
+    state_timestamp_t get_current_timestamp() const {
+        return current_timestamp_;
+    }
+
     const listener_intro_t<protocol_t> &registration_done_cond_value() const {
         return registration_done_cond_.wait();
     }
@@ -188,6 +199,34 @@ private:
             auto_drainer_t::lock_t keepalive)
         THROWS_NOTHING;
 
+    void on_writeread_batch(const std::vector<listener_writeread_t<protocol_t> > &writes,
+            mailbox_addr_t<void(std::vector<typename protocol_t::write_response_t>)> ack_addr)
+        THROWS_NOTHING;
+
+    void perform_writeread_batch(const std::vector<listener_writeread_t<protocol_t> > &writes,
+            mailbox_addr_t<void(std::vector<typename protocol_t::write_response_t>)> ack_addr,
+            auto_drainer_t::lock_t keepalive)
+        THROWS_NOTHING;
+
+    /* Called by `perform_writeread_batch()` for each of the writes, all at once;
+    the fifo tokens put them in order. Sets `*interrupted` instead of throwing. */
+    void perform_batched_writeread(const std::vector<listener_writeread_t<protocol_t> > *writes,
+            std::vector<typename protocol_t::write_response_t> *responses,
+            bool *interrupted,
+            signal_t *interruptor,
+            int i)
+        THROWS_NOTHING;
+
+    /* Does the work of `perform_writeread()` up to sending the response */
+    void apply_writeread(const typename protocol_t::write_t &write,
+            transition_timestamp_t transition_timestamp,
+            order_token_t order_token,
+            fifo_enforcer_write_token_t fifo_token,
+            write_durability_t durability,
+            typename protocol_t::write_response_t *response_out,
+            signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t);
+
     void on_read(const typename protocol_t::read_t &read,
             state_timestamp_t expected_timestamp,
             order_token_t order_token,
@@ -237,6 +276,7 @@ private:
     disk_backed_queue_wrapper_t<write_queue_entry_t> write_queue_;
     fifo_enforcer_sink_t write_queue_entrance_sink_;
     scoped_ptr_t<boost_function_callback_t<write_queue_entry_t> > write_queue_coro_pool_callback_;
+    scoped_ptr_t<coro_pool_sizer_t> write_queue_coro_pool_sizer_;
     adjustable_semaphore_t write_queue_semaphore_;
     cond_t write_queue_has_drained_;
 
@@ -257,6 +297,7 @@ private:
     stays alive. The reason `read_mailbox` is here is for consistency, and to
     have all the query-handling code in one place. */
     typename listener_business_card_t<protocol_t>::writeread_mailbox_t writeread_mailbox_;
+    typename listener_business_card_t<protocol_t>::writeread_batch_mailbox_t writeread_batch_mailbox_;
     typename listener_business_card_t<protocol_t>::read_mailbox_t read_mailbox_;
 
     scoped_ptr_t<registrant_t<listener_business_card_t<protocol_t> > > registrant_;
@@ -4,12 +4,14 @@
 
 #include <map>
 #include <utility>
+#include <vector>
 
 #include "clustering/generic/registration_metadata.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "concurrency/fifo_checker.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/promise.hpp"
+#include "containers/archive/stl_types.hpp"
 #include "containers/uuid.hpp"
 #include "protocol_api.hpp"
 #include "rpc/mailbox/typed.hpp"
@@ -19,6 +21,30 @@
 
 template <class> class listener_intro_t;
 
+/* One of the writes in a message to a `writeread_batch_mailbox_t`. The fields are
+the same as the arguments of a message to a `writeread_mailbox_t`. */
+template <class protocol_t>
+class listener_writeread_t {
+public:
+    listener_writeread_t() : durability(write_durability_t::INVALID) { }
+    listener_writeread_t(const typename protocol_t::write_t &w,
+                         transition_timestamp_t ts,
+                         order_token_t ot,
+                         fifo_enforcer_write_token_t ft,
+                         write_durability_t d)
+        : write(w), transition_timestamp(ts), order_token(ot), fifo_token(ft),
+          durability(d) { }
+
+    typename protocol_t::write_t write;
+    transition_timestamp_t transition_timestamp;
+    order_token_t order_token;
+    fifo_enforcer_write_token_t fifo_token;
+    write_durability_t durability;
+
+    RDB_MAKE_ME_SERIALIZABLE_5(write, transition_timestamp, order_token, fifo_token,
+                               durability);
+};
+
 /* Every `listener_t` constructs a `listener_business_card_t` and sends it to
 the `broadcaster_t`. */
 
@@ -48,12 +74,20 @@ public:
                            fifo_enforcer_read_token_t,
                            mailbox_addr_t<void(typename protocol_t::read_response_t)>)> read_mailbox_t;
 
+    /* The broadcaster sends the writes that pile up for a readable mirror while
+    it's busy to `writeread_batch_mailbox` in one message instead of one message
+    each to `writeread_mailbox`. The responses come back together, in the same
+    order, once all of the writes are done. */
+    typedef mailbox_t<void(std::vector<listener_writeread_t<protocol_t> >,
+                           mailbox_addr_t<void(std::vector<typename protocol_t::write_response_t>)>)> writeread_batch_mailbox_t;
+
     /* The master sends a single message to `intro_mailbox` at the
     very beginning. This tells the mirror what timestamp it's at, the
     master's cpu sharding subspace count, and also tells it where to
     send upgrade/downgrade messages. */
 
     typedef mailbox_t<void(typename writeread_mailbox_t::address_t,
+                           typename writeread_batch_mailbox_t::address_t,
                            typename read_mailbox_t::address_t)> upgrade_mailbox_t;
 
     typedef mailbox_t<void(mailbox_addr_t<void()>)> downgrade_mailbox_t;
@@ -108,6 +142,7 @@ struct backfiller_business_card_t {
             branch_history_t<protocol_t>
             ) >,
         mailbox_addr_t<void(typename protocol_t::backfill_chunk_t, fifo_enforcer_write_token_t)>,
+        mailbox_addr_t<void(typename protocol_t::region_t, fifo_enforcer_write_token_t)>,
         mailbox_t<void(fifo_enforcer_write_token_t)>::address_t,
         mailbox_t<void(mailbox_addr_t<void(int)>)>::address_t
         )> backfill_mailbox_t;
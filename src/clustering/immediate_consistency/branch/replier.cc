@@ -39,6 +39,7 @@ replier_t<protocol_t>::replier_t(listener_t<protocol_t> *li,
     send(mailbox_manager_,
          listener_->registration_done_cond_value().upgrade_mailbox,
          listener_->writeread_address(),
+         listener_->writeread_batch_address(),
          listener_->read_address());
 }
 
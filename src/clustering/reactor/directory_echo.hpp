@@ -28,6 +28,12 @@ private:
     directory_echo_version_t version;
     mailbox_addr_t<void(peer_id_t, directory_echo_version_t)> ack_mailbox;
 public:
+    /* True if `other` came from the same writer at the same version, which
+    means `internal` is the same too. Much cheaper than comparing `internal`. */
+    bool is_same_version(const directory_echo_wrapper_t &other) const {
+        return version == other.version && ack_mailbox == other.ack_mailbox;
+    }
+
     RDB_MAKE_ME_SERIALIZABLE_3(internal, version, ack_mailbox);
     RDB_MAKE_ME_EQUALITY_COMPARABLE_3(directory_echo_wrapper_t<internal_t>,
         internal, version, ack_mailbox);
@@ -60,17 +60,20 @@ template <class protocol_t>
 class primary_t {
 public:
     explicit primary_t(broadcaster_business_card_t<protocol_t> _broadcaster)
-        : broadcaster(_broadcaster)
+        : broadcaster(_broadcaster), current_timestamp(state_timestamp_t::zero()),
+          writes_per_second(0)
     { }
 
     primary_t(broadcaster_business_card_t<protocol_t> _broadcaster,
             replier_business_card_t<protocol_t> _replier,
             master_business_card_t<protocol_t> _master,
-            direct_reader_business_card_t<protocol_t> _direct_reader)
-        : broadcaster(_broadcaster), replier(_replier), master(_master), direct_reader(_direct_reader)
+            direct_reader_business_card_t<protocol_t> _direct_reader,
+            state_timestamp_t _current_timestamp)
+        : broadcaster(_broadcaster), replier(_replier), master(_master), direct_reader(_direct_reader),
+          current_timestamp(_current_timestamp), writes_per_second(0)
     { }
 
-    primary_t() { }
+    primary_t() : current_timestamp(state_timestamp_t::zero()), writes_per_second(0) { }
 
     broadcaster_business_card_t<protocol_t> broadcaster;
 
@@ -86,9 +89,19 @@ public:
     boost::optional<master_business_card_t<protocol_t> > master;
     boost::optional<direct_reader_business_card_t<protocol_t> > direct_reader;
 
-    RDB_MAKE_ME_SERIALIZABLE_4(broadcaster, replier, master, direct_reader);
-    RDB_MAKE_ME_EQUALITY_COMPARABLE_4(primary_t<protocol_t>,
-        broadcaster, replier, master, direct_reader);
+    /* The timestamp our listener had reached when this was last published. It's
+    republished every `REACTOR_PUBLISH_TIMESTAMP_INTERVAL` ms. */
+    state_timestamp_t current_timestamp;
+
+    /* How many writes the shard took per second over the last interval, which
+    the suggester uses to spread the load. */
+    uint64_t writes_per_second;
+
+    RDB_MAKE_ME_SERIALIZABLE_6(broadcaster, replier, master, direct_reader,
+        current_timestamp, writes_per_second);
+    RDB_MAKE_ME_EQUALITY_COMPARABLE_6(primary_t<protocol_t>,
+        broadcaster, replier, master, direct_reader, current_timestamp,
+        writes_per_second);
 };
 
 /* This peer is currently a secondary in working order. */
@@ -97,19 +110,24 @@ class secondary_up_to_date_t {
 public:
     secondary_up_to_date_t(branch_id_t _branch_id,
             replier_business_card_t<protocol_t> _replier,
-            direct_reader_business_card_t<protocol_t> _direct_reader)
-        : branch_id(_branch_id), replier(_replier), direct_reader(_direct_reader)
+            direct_reader_business_card_t<protocol_t> _direct_reader,
+            state_timestamp_t _current_timestamp)
+        : branch_id(_branch_id), replier(_replier), direct_reader(_direct_reader),
+          current_timestamp(_current_timestamp)
     { }
 
-    secondary_up_to_date_t() { }
+    secondary_up_to_date_t() : current_timestamp(state_timestamp_t::zero()) { }
 
     branch_id_t branch_id;
     replier_business_card_t<protocol_t> replier;
     direct_reader_business_card_t<protocol_t> direct_reader;
 
-    RDB_MAKE_ME_SERIALIZABLE_3(branch_id, replier, direct_reader);
-    RDB_MAKE_ME_EQUALITY_COMPARABLE_3(secondary_up_to_date_t<protocol_t>,
-        branch_id, replier, direct_reader);
+    /* Like `primary_t::current_timestamp`. */
+    state_timestamp_t current_timestamp;
+
+    RDB_MAKE_ME_SERIALIZABLE_4(branch_id, replier, direct_reader, current_timestamp);
+    RDB_MAKE_ME_EQUALITY_COMPARABLE_4(secondary_up_to_date_t<protocol_t>,
+        branch_id, replier, direct_reader, current_timestamp);
 };
 
 /* This peer would like to be a secondary but cannot because it failed to
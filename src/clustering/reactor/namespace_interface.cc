@@ -6,6 +6,20 @@
 #include "clustering/immediate_consistency/query/master_access.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/watchable.hpp"
+#include "containers/death_runner.hpp"
+#include "perfmon/perfmon.hpp"
+
+/* How much each direct read's latency counts towards its peer's moving
+average. */
+#define PEER_LATENCY_EWMA_WEIGHT 0.2
+
+/* How direct reads (outdated or bounded-staleness) were routed, summed over
+every namespace interface. */
+static perfmon_counter_t pm_direct_reads_local, pm_direct_reads_remote, pm_direct_reads_load_compared;
+static perfmon_multi_membership_t pm_direct_reads_membership(&get_global_perfmon_collection(),
+    &pm_direct_reads_local, "direct_reads_routed_local",
+    &pm_direct_reads_remote, "direct_reads_routed_remote",
+    &pm_direct_reads_load_compared, "direct_reads_load_compared");
 
 template <class protocol_t>
 cluster_namespace_interface_t<protocol_t>::cluster_namespace_interface_t(
@@ -52,7 +66,13 @@ void cluster_namespace_interface_t<protocol_t>::read_outdated(const typename pro
     /* This seems kind of silly. We do it this way because
        `dispatch_outdated_read` needs to be able to see `outdated_read_info_t`,
        which is defined in the `private` section. */
-    dispatch_outdated_read(r, response, interruptor);
+    dispatch_outdated_read(r, response, boost::none, interruptor);
+}
+
+template <class protocol_t>
+void cluster_namespace_interface_t<protocol_t>::read_bounded_staleness(const typename protocol_t::read_t &r, typename protocol_t::read_response_t *response, uint64_t max_staleness, signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) {
+    dispatch_outdated_read(r, response, max_staleness, interruptor);
 }
 
 template <class protocol_t>
@@ -207,6 +227,7 @@ void
 cluster_namespace_interface_t<protocol_t>::dispatch_outdated_read(
     const typename protocol_t::read_t &op,
     typename protocol_t::read_response_t *response,
+    boost::optional<uint64_t> max_staleness,
     signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) {
 
@@ -221,28 +242,48 @@ cluster_namespace_interface_t<protocol_t>::dispatch_outdated_read(
             relationship_t *chosen_relationship = NULL;
 
             const std::set<relationship_t *> *relationship_map = &it->second;
+
+            /* Replicas are compared against what the primary last published;
+            both lag behind by up to `REACTOR_PUBLISH_TIMESTAMP_INTERVAL`. */
+            boost::optional<state_timestamp_t> primary_timestamp;
+            if (max_staleness) {
+                for (auto jt = relationship_map->begin();
+                     jt != relationship_map->end();
+                     ++jt) {
+                    if ((*jt)->master_access) {
+                        primary_timestamp = (*jt)->published_timestamp->get();
+                    }
+                }
+                if (!primary_timestamp) {
+                    throw cannot_perform_query_exc_t("No primary available to bound staleness against");
+                }
+            }
+
             for (auto jt = relationship_map->begin();
                  jt != relationship_map->end();
                  ++jt) {
-                if ((*jt)->direct_reader_access) {
-                    if ((*jt)->is_local) {
-                        chosen_relationship = *jt;
-                        break;
-                    } else {
-                        potential_relationships.push_back(*jt);
+                if (max_staleness) {
+                    boost::optional<state_timestamp_t> timestamp = (*jt)->published_timestamp->get();
+                    if (!timestamp || primary_timestamp->writes_since(*timestamp) > *max_staleness) {
+                        continue;
                     }
                 }
+                if ((*jt)->direct_reader_access) {
+                    potential_relationships.push_back(*jt);
+                }
             }
-            if (!chosen_relationship && !potential_relationships.empty()) {
-                chosen_relationship
-                    = potential_relationships[
-                        distributor_rng.randint(potential_relationships.size())];
-            }
+            chosen_relationship = choose_least_loaded(potential_relationships);
             if (!chosen_relationship) {
                 /* Don't bother looking for masters; if there are no direct
                    readers, there won't be any masters either. */
                 throw cannot_perform_query_exc_t("No direct reader available");
             }
+            if (chosen_relationship->is_local) {
+                ++pm_direct_reads_local;
+            } else {
+                ++pm_direct_reads_remote;
+            }
+            new_op_info->peer_id = chosen_relationship->peer_id;
             new_op_info->direct_reader_access
                 = chosen_relationship->direct_reader_access;
             new_op_info->keepalive = auto_drainer_t::lock_t(
@@ -268,6 +309,53 @@ cluster_namespace_interface_t<protocol_t>::dispatch_outdated_read(
     op.unshard(results.data(), results.size(), response, ctx, interruptor);
 }
 
+template <class protocol_t>
+typename cluster_namespace_interface_t<protocol_t>::relationship_t *
+cluster_namespace_interface_t<protocol_t>::choose_least_loaded(
+        const std::vector<relationship_t *> &candidates) {
+    if (candidates.empty()) {
+        return NULL;
+    } else if (candidates.size() == 1) {
+        return candidates[0];
+    }
+
+    /* Comparing two random candidates instead of all of them keeps everyone
+    from piling onto whichever peer looked best a moment ago. */
+    int first = distributor_rng.randint(candidates.size());
+    int second = distributor_rng.randint(candidates.size() - 1);
+    if (second >= first) {
+        ++second;
+    }
+    ++pm_direct_reads_load_compared;
+
+    double costs[2];
+    relationship_t *choices[2] = { candidates[first], candidates[second] };
+    for (int i = 0; i < 2; ++i) {
+        peer_load_t *load = &peer_loads[choices[i]->peer_id];
+        /* Peers we haven't heard back from yet look as fast as possible, so
+        they get tried. */
+        costs[i] = (load->outstanding_reads + 1) * (load->latency_ewma_ms + 1);
+    }
+    return costs[1] < costs[0] ? choices[1] : choices[0];
+}
+
+template <class protocol_t>
+void cluster_namespace_interface_t<protocol_t>::remove_peer_relationship(peer_id_t peer_id) {
+    guarantee(peer_loads[peer_id].relationships > 0);
+    --peer_loads[peer_id].relationships;
+    release_peer_load(peer_id);
+}
+
+template <class protocol_t>
+void cluster_namespace_interface_t<protocol_t>::release_peer_load(const peer_id_t &peer_id) {
+    typename std::map<peer_id_t, peer_load_t>::iterator it = peer_loads.find(peer_id);
+    if (it != peer_loads.end()
+        && it->second.relationships == 0
+        && it->second.outstanding_reads == 0) {
+        peer_loads.erase(it);
+    }
+}
+
 template <class protocol_t>
 void outdated_read_store_result(typename protocol_t::read_response_t *result_out, const typename protocol_t::read_response_t &result_in, cond_t *done) {
     *result_out = result_in;
@@ -285,6 +373,11 @@ void cluster_namespace_interface_t<protocol_t>::perform_outdated_read(
 {
     outdated_read_info_t *direct_reader_to_contact = &(*direct_readers_to_contact)[i];
 
+    /* The entry can't go away while we count as an outstanding read. */
+    peer_load_t *load = &peer_loads[direct_reader_to_contact->peer_id];
+    ++load->outstanding_reads;
+    ticks_t start_time = get_ticks();
+
     try {
         cond_t done;
         mailbox_t<void(typename protocol_t::read_response_t)> cont(mailbox_manager,
@@ -294,6 +387,9 @@ void cluster_namespace_interface_t<protocol_t>::perform_outdated_read(
         wait_any_t waiter(direct_reader_to_contact->direct_reader_access->get_failed_signal(), &done);
         wait_interruptible(&waiter, interruptor);
         direct_reader_to_contact->direct_reader_access->access();   /* throws if `get_failed_signal()->is_pulsed()` */
+
+        double latency_ms = ticks_to_secs(get_ticks() - start_time) * 1000;
+        load->latency_ewma_ms += PEER_LATENCY_EWMA_WEIGHT * (latency_ms - load->latency_ewma_ms);
     } catch (const resource_lost_exc_t &) {
         failures->at(i).assign("lost contact with direct reader");
     } catch (const interrupted_exc_t &) {
@@ -302,6 +398,9 @@ void cluster_namespace_interface_t<protocol_t>::perform_outdated_read(
            `read_outdated()` will notice that the interruptor has been pulsed
            and won't try to access our result. */
     }
+
+    --load->outstanding_reads;
+    release_peer_load(direct_reader_to_contact->peer_id);
 }
 
 template <class protocol_t>
@@ -413,6 +512,26 @@ cluster_namespace_interface_t<protocol_t>::extract_direct_reader_business_card_f
     return ret;
 }
 
+template <class protocol_t>
+boost::optional<state_timestamp_t>
+cluster_namespace_interface_t<protocol_t>::extract_published_timestamp(const std::map<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > &map, const peer_id_t &peer, const reactor_activity_id_t &activity_id) {
+    typename std::map<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > >::const_iterator it = map.find(peer);
+    if (it != map.end()) {
+        typename reactor_business_card_t<protocol_t>::activity_map_t::const_iterator jt = it->second->activities.find(activity_id);
+        if (jt != it->second->activities.end()) {
+            if (const reactor_business_card_details::primary_t<protocol_t> *primary_record =
+                boost::get<reactor_business_card_details::primary_t<protocol_t> >(&jt->second.activity)) {
+                return primary_record->current_timestamp;
+            }
+            if (const reactor_business_card_details::secondary_up_to_date_t<protocol_t> *secondary_up_to_date_record =
+                boost::get<reactor_business_card_details::secondary_up_to_date_t<protocol_t> >(&jt->second.activity)) {
+                return secondary_up_to_date_record->current_timestamp;
+            }
+        }
+    }
+    return boost::none;
+}
+
 template <class protocol_t>
 void cluster_namespace_interface_t<protocol_t>::relationship_coroutine(peer_id_t peer_id, reactor_activity_id_t activity_id,
                                                                        bool is_start, bool is_primary, const typename protocol_t::region_t &region,
@@ -430,15 +549,21 @@ void cluster_namespace_interface_t<protocol_t>::relationship_coroutine(peer_id_t
         }
 
         relationship_t relationship_record;
+        relationship_record.peer_id = peer_id;
         relationship_record.is_local = (peer_id == mailbox_manager->get_connectivity_service()->get_me());
         relationship_record.region = region;
         relationship_record.master_access = master_access.has() ? master_access.get() : NULL;
         relationship_record.direct_reader_access = direct_reader_access.has() ? direct_reader_access.get() : NULL;
+        relationship_record.published_timestamp = directory_view->subview(std::bind(&cluster_namespace_interface_t<protocol_t>::extract_published_timestamp, ph::_1, peer_id, activity_id));
 
         region_map_set_membership_t<protocol_t, relationship_t *> relationship_map_insertion(&relationships,
                                                                                              region,
                                                                                              &relationship_record);
 
+        ++peer_loads[peer_id].relationships;
+        death_runner_t peer_load_releaser(std::bind(
+            &cluster_namespace_interface_t::remove_peer_relationship, this, peer_id));
+
         if (is_start) {
             guarantee(start_count > 0);
             start_count--;
@@ -77,6 +77,11 @@ public:
 
     void read_outdated(const typename protocol_t::read_t &r, typename protocol_t::read_response_t *response, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
 
+    /* Spreads reads across the primary and the up-to-date secondaries whose
+    last published timestamp is at most `max_staleness` writes behind the
+    primary's. */
+    void read_bounded_staleness(const typename protocol_t::read_t &r, typename protocol_t::read_response_t *response, uint64_t max_staleness, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
+
     void write(const typename protocol_t::write_t &w, typename protocol_t::write_response_t *response, order_token_t order_token, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
 
     std::set<typename protocol_t::region_t> get_sharding_scheme() THROWS_ONLY(cannot_perform_query_exc_t);
@@ -84,10 +89,14 @@ public:
 private:
     class relationship_t {
     public:
+        peer_id_t peer_id;
         bool is_local;
         typename protocol_t::region_t region;
         master_access_t<protocol_t> *master_access;
         resource_access_t<direct_reader_business_card_t<protocol_t> > *direct_reader_access;
+        /* The timestamp the peer last published for this activity, if it's a
+        primary or an up-to-date secondary. */
+        clone_ptr_t<watchable_t<boost::optional<state_timestamp_t> > > published_timestamp;
         auto_drainer_t drainer;
     };
 
@@ -107,10 +116,21 @@ private:
     class outdated_read_info_t {
     public:
         typename protocol_t::read_t sharded_op;
+        peer_id_t peer_id;
         resource_access_t<direct_reader_business_card_t<protocol_t> > *direct_reader_access;
         auto_drainer_t::lock_t keepalive;
     };
 
+    /* How busy a peer looks from here, judging by the direct reads we've sent
+    it. Entries go away once the peer has no relationships and no reads left. */
+    class peer_load_t {
+    public:
+        peer_load_t() : relationships(0), outstanding_reads(0), latency_ewma_ms(0) { }
+        int relationships;
+        int outstanding_reads;
+        double latency_ewma_ms;
+    };
+
     template <class op_type, class fifo_enforcer_token_type, class op_response_type>
     void dispatch_immediate_op(
             /* `how_to_make_token` and `how_to_run_query` have type pointer-to-member-function. */
@@ -137,9 +157,12 @@ private:
             signal_t *interruptor)
         THROWS_NOTHING;
 
+    /* If `max_staleness` is set, only replicas at most that many writes behind
+    the primary are used. */
     void dispatch_outdated_read(
             const typename protocol_t::read_t &op,
             typename protocol_t::read_response_t *response,
+            boost::optional<uint64_t> max_staleness,
             signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
 
@@ -151,6 +174,13 @@ private:
             signal_t *interruptor)
         THROWS_NOTHING;
 
+    /* Picks two of `candidates` at random and returns the one whose peer looks
+    less loaded, or NULL if there are no candidates. */
+    relationship_t *choose_least_loaded(const std::vector<relationship_t *> &candidates);
+
+    void remove_peer_relationship(peer_id_t peer_id);
+    void release_peer_load(const peer_id_t &peer_id);
+
     void update_registrants(bool is_start);
 
     static boost::optional<boost::optional<master_business_card_t<protocol_t> > > extract_master_business_card(const std::map<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > &map, const peer_id_t &peer, const reactor_activity_id_t &activity_id);
@@ -158,6 +188,8 @@ private:
 
     static boost::optional<boost::optional<direct_reader_business_card_t<protocol_t> > > extract_direct_reader_business_card_from_secondary(const std::map<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > &map, const peer_id_t &peer, const reactor_activity_id_t &activity_id);
 
+    static boost::optional<state_timestamp_t> extract_published_timestamp(const std::map<peer_id_t, cow_ptr_t<reactor_business_card_t<protocol_t> > > &map, const peer_id_t &peer, const reactor_activity_id_t &activity_id);
+
 
     void relationship_coroutine(peer_id_t peer_id, reactor_activity_id_t activity_id,
                                 bool is_start, bool is_primary, const typename protocol_t::region_t &region,
@@ -172,6 +204,8 @@ private:
     std::set<reactor_activity_id_t> handled_activity_ids;
     region_map_t<protocol_t, std::set<relationship_t *> > relationships;
 
+    std::map<peer_id_t, peer_load_t> peer_loads;
+
     /* `start_cond` will be pulsed when we have either successfully connected to
     or tried and failed to connect to every peer present when the constructor
     was called. `start_count` is the number of peers we're still waiting for. */
@@ -196,7 +196,48 @@ void reactor_t<protocol_t>::try_spawn_roles() THROWS_NOTHING {
             current_role_t *role = new current_role_t(it->second, blueprint);
             current_roles.insert(std::make_pair(it->first, role));
             coro_t::spawn_sometime(boost::bind(&reactor_t<protocol_t>::run_role, this, it->first,
-                                               role, auto_drainer_t::lock_t(&drainer)));
+                                               role, false, auto_drainer_t::lock_t(&drainer)));
+        }
+    }
+}
+
+/* Called by `run_role()` when the shard it was running has been split. Each new
+shard that lies inside the old one starts its role right away on the same
+stores, before `old_region` is released, so nothing else can claim it first. The
+stores' metainfo still describes the data under the old shard's version, so
+`be_primary()` counts it as `present_in_our_store` and a secondary's listener
+backfills only the writes made since then. New shards that reach outside
+`old_region` (merges) wait for `try_spawn_roles()` as before. */
+template<class protocol_t>
+void reactor_t<protocol_t>::hand_off_split_region(
+        const typename protocol_t::region_t &old_region,
+        const blueprint_t<protocol_t> &blueprint,
+        auto_drainer_t::lock_t keepalive) THROWS_NOTHING {
+    ASSERT_NO_CORO_WAITING;
+    typename std::map<peer_id_t, std::map<typename protocol_t::region_t, blueprint_role_t> >::const_iterator role_it = blueprint.peers_roles.find(get_me());
+    guarantee(role_it != blueprint.peers_roles.end(), "reactor_t assumes that it is mentioned in the blueprint it's given.");
+
+    for (typename std::map<typename protocol_t::region_t, blueprint_role_t>::const_iterator it = role_it->second.begin();
+         it != role_it->second.end(); ++it) {
+        if (!region_is_superset(old_region, it->first)) {
+            continue;
+        }
+
+        bool none_overlap = true;
+        for (typename std::map<typename protocol_t::region_t, current_role_t *>::iterator it2 = current_roles.begin();
+             it2 != current_roles.end(); ++it2) {
+            if (it2->first != old_region && region_overlaps(it->first, it2->first)) {
+                none_overlap = false;
+                break;
+            }
+        }
+
+        if (none_overlap) {
+            //This state will be cleaned up in run_role
+            current_role_t *role = new current_role_t(it->second, blueprint);
+            current_roles.insert(std::make_pair(it->first, role));
+            coro_t::spawn_sometime(boost::bind(&reactor_t<protocol_t>::run_role, this, it->first,
+                                               role, true, keepalive));
         }
     }
 }
@@ -242,33 +283,64 @@ template<class protocol_t>
 void reactor_t<protocol_t>::run_role(
         typename protocol_t::region_t region,
         current_role_t *role,
+        bool seen_our_bcard,
         auto_drainer_t::lock_t keepalive) THROWS_NOTHING {
 
     //A store_view_t derived object that acts as a store for the specified region
     multistore_ptr_t<protocol_t> svs_subview(underlying_svs, region);
 
-    {
-        //All of the be_{role} functions respond identically to blueprint changes
-        //and interruptions... so we just unify those signals
-        wait_any_t wait_any(&role->abort_roles, keepalive.get_drain_signal());
-
-        try {
-            /* Notice this is necessary because the reactor first creates the
-             * reactor and then inserts its business card in to the map However
-             * we had an issue (#1132) in which reactor_be_primary was making
-             * the assumption that the bcard would be set while it was run. We
-             * decided that it was a good idea to have this actually be a
-             * correct assumption. The below line waits until the bcard shows
-             * up in the directory thus make sure that the bcard is in the
-             * directory before the be_role functions get called. */
-            directory_echo_mirror.get_internal()->run_until_satisfied(
-                boost::bind(&we_see_our_bcard<protocol_t>, _1, get_me()), &wait_any,
-                REACTOR_RUN_UNTIL_SATISFIED_NAP);
-            // guarantee(CLUSTER_CPU_SHARDING_FACTOR == svs_subview.num_stores());
-
-            pmap(svs_subview.num_stores(), boost::bind(&reactor_t<protocol_t>::run_cpu_sharded_role, this, _1, role, region, &svs_subview, &wait_any, &role->abort_roles));
-        } catch (const interrupted_exc_t &) {
+    while (true) {
+        {
+            //All of the be_{role} functions respond identically to blueprint changes
+            //and interruptions... so we just unify those signals
+            wait_any_t wait_any(&role->abort_roles, keepalive.get_drain_signal());
+
+            try {
+                if (!seen_our_bcard) {
+                    /* Notice this is necessary because the reactor first creates the
+                     * reactor and then inserts its business card in to the map However
+                     * we had an issue (#1132) in which reactor_be_primary was making
+                     * the assumption that the bcard would be set while it was run. We
+                     * decided that it was a good idea to have this actually be a
+                     * correct assumption. The below line waits until the bcard shows
+                     * up in the directory thus make sure that the bcard is in the
+                     * directory before the be_role functions get called. */
+                    directory_echo_mirror.get_internal()->run_until_satisfied(
+                        boost::bind(&we_see_our_bcard<protocol_t>, _1, get_me()), &wait_any,
+                        REACTOR_RUN_UNTIL_SATISFIED_NAP);
+                    seen_our_bcard = true;
+                }
+                // guarantee(CLUSTER_CPU_SHARDING_FACTOR == svs_subview.num_stores());
+
+                pmap(svs_subview.num_stores(), boost::bind(&reactor_t<protocol_t>::run_cpu_sharded_role, this, _1, role, region, &svs_subview, &wait_any, &role->abort_roles));
+            } catch (const interrupted_exc_t &) {
+            }
+        }
+
+        if (keepalive.get_drain_signal()->is_pulsed()) {
+            break;
         }
+
+        /* If the shard is still ours and only our role for it changed (say an
+        up-to-date secondary being promoted to primary), start the new role right
+        here. That keeps the store subview and skips the trip through
+        `try_spawn_roles()`, and since the store's metainfo is already up to date
+        `be_primary()` won't backfill anything it already has. */
+        blueprint_t<protocol_t> blueprint = blueprint_watchable->get();
+        typename std::map<peer_id_t, std::map<typename protocol_t::region_t, blueprint_role_t> >::const_iterator role_it = blueprint.peers_roles.find(get_me());
+        guarantee(role_it != blueprint.peers_roles.end(), "reactor_t assumes that it is mentioned in the blueprint it's given.");
+        typename std::map<typename protocol_t::region_t, blueprint_role_t>::const_iterator region_it = role_it->second.find(region);
+        if (region_it == role_it->second.end()) {
+            /* The shard was split (or merged); pass the parts of it that are
+            still ours straight on to their new roles. */
+            hand_off_split_region(region, blueprint, keepalive);
+            break;
+        }
+
+        current_role_t *next_role = new current_role_t(region_it->second, blueprint);
+        current_roles[region] = next_role;
+        delete role;
+        role = next_role;
     }
 
     //As promised, clean up the state from try_spawn_roles
@@ -73,6 +73,10 @@ private:
 
     void on_blueprint_changed() THROWS_NOTHING;
     void try_spawn_roles() THROWS_NOTHING;
+    void hand_off_split_region(
+            const typename protocol_t::region_t &old_region,
+            const blueprint_t<protocol_t> &blueprint,
+            auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
     void run_cpu_sharded_role(
             int cpu_shard_number,
             current_role_t *role,
@@ -83,6 +87,7 @@ private:
     void run_role(
             typename protocol_t::region_t region,
             current_role_t *role,
+            bool seen_our_bcard,
             auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
 
     /* Implemented in clustering/reactor/reactor_be_primary.tcc */
@@ -7,6 +7,7 @@
 #include "errors.hpp"
 #include <boost/ptr_container/ptr_vector.hpp>
 
+#include "arch/timing.hpp"
 #include "clustering/administration/http/json_adapters.hpp"
 #include "clustering/immediate_consistency/branch/backfillee.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
@@ -338,6 +339,12 @@ bool reactor_t<protocol_t>::attempt_backfill_from_peers(directory_entry_t *direc
         }
     }
 
+    /* When a shard is split, `hand_off_split_region()` starts us on the new
+     * shard with the data still in our store, under the metainfo the old shard
+     * left behind. Those parts of the region are `present_in_our_store` and
+     * aren't backfilled at all, so only the parts that some other peer has a
+     * newer version of are copied. */
+
     /* We may be backfilling from several sources, each requires a
      * promise be passed in which gets pulsed with a value indicating
      * whether or not the backfill succeeded. */
@@ -450,17 +457,40 @@ void reactor_t<protocol_t>::be_primary(typename protocol_t::region_t region, sto
         replier_t<protocol_t> replier(&listener, mailbox_manager, branch_history_manager);
         master_t<protocol_t> master(mailbox_manager, ack_checker, region, &broadcaster);
         direct_reader_t<protocol_t> direct_reader(mailbox_manager, svs);
+        state_timestamp_t current_timestamp = listener.get_current_timestamp();
 
         on_thread_t th4(this->home_thread());
 
-        directory_entry.update_without_changing_id(
-            typename reactor_business_card_t<protocol_t>::primary_t(
-                broadcaster.get_business_card(),
-                replier.get_business_card(),
-                master.get_business_card(),
-                direct_reader.get_business_card()));
-
-        interruptor->wait_lazily_unordered();
+        typename reactor_business_card_t<protocol_t>::primary_t activity(
+            broadcaster.get_business_card(),
+            replier.get_business_card(),
+            master.get_business_card(),
+            direct_reader.get_business_card(),
+            current_timestamp);
+        directory_entry.update_without_changing_id(activity);
+
+        /* Republish how far we've gotten every so often, so that readers can
+        tell how far behind us the secondaries are. Every write advances the
+        timestamp by one, so this also tells us the write rate. */
+        while (true) {
+            signal_timer_t timer;
+            timer.start(REACTOR_PUBLISH_TIMESTAMP_INTERVAL);
+            wait_interruptible(&timer, interruptor);
+
+            {
+                on_thread_t th5(svs->home_thread());
+                current_timestamp = listener.get_current_timestamp();
+            }
+            const uint64_t writes_per_second =
+                current_timestamp.writes_since(activity.current_timestamp) * 1000
+                / REACTOR_PUBLISH_TIMESTAMP_INTERVAL;
+            if (current_timestamp != activity.current_timestamp
+                || writes_per_second != activity.writes_per_second) {
+                activity.current_timestamp = current_timestamp;
+                activity.writes_per_second = writes_per_second;
+                directory_entry.update_without_changing_id(activity);
+            }
+        }
 
     } catch (const interrupted_exc_t &) {
         /* ignore */
@@ -1,6 +1,7 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "clustering/reactor/reactor.hpp"
 
+#include "arch/timing.hpp"
 #include "clustering/immediate_consistency/branch/listener.hpp"
 #include "clustering/immediate_consistency/branch/replier.hpp"
 #include "clustering/immediate_consistency/query/direct_reader.hpp"
@@ -256,14 +257,32 @@ void reactor_t<protocol_t>::be_secondary(typename protocol_t::region_t region, s
                 direct_reader_t<protocol_t> direct_reader(mailbox_manager, svs);
 
                 cross_thread_signal_t ct_broadcaster_lost_signal(listener.get_broadcaster_lost_signal(), this->home_thread());
+                state_timestamp_t current_timestamp = listener.get_current_timestamp();
                 on_thread_t th2(this->home_thread());
 
                 /* Make the directory reflect the new role that we are filling.
                  * (Being a secondary). */
-                directory_entry.set(typename reactor_business_card_t<protocol_t>::secondary_up_to_date_t(branch_id, replier.get_business_card(), direct_reader.get_business_card()));
+                typename reactor_business_card_t<protocol_t>::secondary_up_to_date_t
+                    activity(branch_id, replier.get_business_card(), direct_reader.get_business_card(), current_timestamp);
+                directory_entry.set(activity);
 
-                /* Wait for something to change. */
-                wait_interruptible(&ct_broadcaster_lost_signal, interruptor);
+                /* Wait for something to change, republishing how far we've
+                 * gotten every so often for reads with bounded staleness. */
+                while (!ct_broadcaster_lost_signal.is_pulsed()) {
+                    signal_timer_t timer;
+                    timer.start(REACTOR_PUBLISH_TIMESTAMP_INTERVAL);
+                    wait_any_t waiter(&timer, &ct_broadcaster_lost_signal);
+                    wait_interruptible(&waiter, interruptor);
+
+                    {
+                        on_thread_t th3(svs->home_thread());
+                        current_timestamp = listener.get_current_timestamp();
+                    }
+                    if (current_timestamp != activity.current_timestamp) {
+                        activity.current_timestamp = current_timestamp;
+                        directory_entry.update_without_changing_id(activity);
+                    }
+                }
             } catch (const typename listener_t<protocol_t>::backfiller_lost_exc_t &) {
                 /* We lost the replier which means we should retry, just
                  * going back to the top of the while loop accomplishes this.
@@ -1,6 +1,10 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/suggester/suggester.hpp"
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include "stl_utils.hpp"
 #include "containers/priority_queue.hpp"
 #include "clustering/generic/nonoverlapping_regions.hpp"
@@ -15,6 +19,12 @@
 #define PRIMARY_USAGE_COST  10
 #define SECONDARY_USAGE_COST  8
 
+// Busy shards count for more than idle ones: a shard's usage costs are
+// multiplied by one plus the number of times it takes this many writes per
+// second, up to `MAX_SHARD_WEIGHT` times.
+#define WRITES_PER_SECOND_PER_SHARD_WEIGHT  100
+#define MAX_SHARD_WEIGHT  100
+
 namespace {
 
 struct priority_t {
@@ -161,6 +171,33 @@ double estimate_cost_to_get_up_to_date(
     return sum / count;
 }
 
+/* Returns how many times the usage costs of an idle shard being a primary or a
+secondary for `shard` should count, going by the write rates that the shard's
+primaries published. */
+
+template<class protocol_t>
+int estimate_shard_weight(
+        const std::map<machine_id_t, reactor_business_card_t<protocol_t> > &directory,
+        const typename protocol_t::region_t &shard) {
+    typedef reactor_business_card_t<protocol_t> rb_t;
+    uint64_t writes_per_second = 0;
+    for (typename std::map<machine_id_t, rb_t>::const_iterator it = directory.begin();
+            it != directory.end(); ++it) {
+        for (typename rb_t::activity_map_t::const_iterator jt = it->second.activities.begin();
+                jt != it->second.activities.end(); ++jt) {
+            const typename rb_t::primary_t *primary = boost::get<typename rb_t::primary_t>(&jt->second.activity);
+            /* If the shard boundaries have changed this counts all of an old
+            shard's writes against each new shard it overlaps, which is good
+            enough until the new primaries publish their own rates. */
+            if (primary != NULL && region_overlaps(jt->second.region, shard)) {
+                writes_per_second += primary->writes_per_second;
+            }
+        }
+    }
+    return 1 + std::min<uint64_t>(writes_per_second / WRITES_PER_SECOND_PER_SHARD_WEIGHT,
+                                  MAX_SHARD_WEIGHT - 1);
+}
+
 std::vector<machine_id_t> pick_n_best(priority_queue_t<priority_t> *candidates, int n, const datacenter_id_t &datacenter) {
     std::vector<machine_id_t> result;
     while (result.size() < static_cast<size_t>(n)) {
@@ -199,6 +236,7 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
         const std::map<machine_id_t, datacenter_id_t> &machine_data_centers,
         const std::set<machine_id_t> &primary_pinnings,
         const std::set<machine_id_t> &secondary_pinnings,
+        int shard_weight,
         std::map<machine_id_t, int> *usage,
         bool prioritize_distribution) {
 
@@ -232,7 +270,7 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
         sub_blueprint[primary] = blueprint_role_primary;
 
         //Update primary_usage
-        (*usage)[primary] += PRIMARY_USAGE_COST;
+        (*usage)[primary] += PRIMARY_USAGE_COST * shard_weight;
     }
 
 
@@ -253,7 +291,7 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
 
         for (std::vector<machine_id_t>::iterator jt = secondaries.begin(); jt != secondaries.end(); jt++) {
             //Update secondary usage
-            (*usage)[*jt] += SECONDARY_USAGE_COST;
+            (*usage)[*jt] += SECONDARY_USAGE_COST * shard_weight;
             sub_blueprint[*jt] = blueprint_role_secondary;
             unused_machines.erase(*jt);
         }
@@ -275,7 +313,7 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
         sub_blueprint[primary] = blueprint_role_primary;
 
         //Update primary_usage
-        (*usage)[primary] += PRIMARY_USAGE_COST;
+        (*usage)[primary] += PRIMARY_USAGE_COST * shard_weight;
     }
 
     /* Finally pick the secondaries for the nil datacenter */
@@ -290,7 +328,7 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
 
         for (std::vector<machine_id_t>::iterator jt = secondaries.begin(); jt != secondaries.end(); jt++) {
             //Update secondary usage
-            (*usage)[*jt] += SECONDARY_USAGE_COST;
+            (*usage)[*jt] += SECONDARY_USAGE_COST * shard_weight;
             sub_blueprint[*jt] = blueprint_role_secondary;
             unused_machines.erase(*jt);
         }
@@ -306,6 +344,11 @@ std::map<machine_id_t, blueprint_role_t> suggest_blueprint_for_shard(
     return sub_blueprint;
 }
 
+template<class region_t>
+bool heavier_shard(const std::pair<int, region_t> &x, const std::pair<int, region_t> &y) {
+    return x.first > y.first;
+}
+
 template<class protocol_t>
 persistable_blueprint_t<protocol_t> suggest_blueprint(
         const std::map<machine_id_t, reactor_business_card_t<protocol_t> > &directory,
@@ -323,10 +366,20 @@ persistable_blueprint_t<protocol_t> suggest_blueprint(
 
     persistable_blueprint_t<protocol_t> blueprint;
 
+    /* Place the busiest shards first, while every machine still has room for
+    them; the idle ones can then fill in around them. */
+    std::vector<std::pair<int, typename protocol_t::region_t> > weighted_shards;
     for (typename nonoverlapping_regions_t<protocol_t>::iterator it = shards.begin();
             it != shards.end(); it++) {
+        weighted_shards.push_back(std::make_pair(estimate_shard_weight(directory, *it), *it));
+    }
+    std::stable_sort(weighted_shards.begin(), weighted_shards.end(),
+                     &heavier_shard<typename protocol_t::region_t>);
+
+    for (auto ws = weighted_shards.begin(); ws != weighted_shards.end(); ++ws) {
+        const typename protocol_t::region_t &shard = ws->second;
         std::set<machine_id_t> machines_shard_primary_is_pinned_to;
-        primary_pinnings_map_t primary_masked_map = primary_pinnings.mask(*it);
+        primary_pinnings_map_t primary_masked_map = primary_pinnings.mask(shard);
 
         for (typename primary_pinnings_map_t::iterator pit  = primary_masked_map.begin();
                                                        pit != primary_masked_map.end();
@@ -335,7 +388,7 @@ persistable_blueprint_t<protocol_t> suggest_blueprint(
         }
 
         std::set<machine_id_t> machines_shard_secondary_is_pinned_to;
-        secondary_pinnings_map_t secondary_masked_map = secondary_pinnings.mask(*it);
+        secondary_pinnings_map_t secondary_masked_map = secondary_pinnings.mask(shard);
 
         for (typename secondary_pinnings_map_t::iterator pit  = secondary_masked_map.begin();
                                                          pit != secondary_masked_map.end();
@@ -345,13 +398,13 @@ persistable_blueprint_t<protocol_t> suggest_blueprint(
 
         std::map<machine_id_t, blueprint_role_t> shard_blueprint =
             suggest_blueprint_for_shard(directory, primary_datacenter,
-                    datacenter_affinities, *it, machine_data_centers,
+                    datacenter_affinities, shard, machine_data_centers,
                     machines_shard_primary_is_pinned_to,
-                    machines_shard_secondary_is_pinned_to, usage,
+                    machines_shard_secondary_is_pinned_to, ws->first, usage,
                     prioritize_distribution);
         for (typename std::map<machine_id_t, blueprint_role_t>::iterator jt = shard_blueprint.begin();
                 jt != shard_blueprint.end(); jt++) {
-            blueprint.machines_roles[jt->first][*it] = jt->second;
+            blueprint.machines_roles[jt->first][shard] = jt->second;
         }
     }
 
@@ -0,0 +1,114 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "concurrency/admission_control.hpp"
+
+#include <algorithm>
+
+#include "arch/timing.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
+
+// How much of each query's latency goes into the smoothed latency.
+const double ADMISSION_LATENCY_SMOOTHING = 0.1;
+// How far the baseline latency moves towards a higher latency, per query.
+const double ADMISSION_BASELINE_DRIFT = 0.01;
+// How much of the limit is left after it shrinks.
+const double ADMISSION_LIMIT_DECREASE = 0.9;
+
+admission_controller_t::admission_controller_t(int max_running, int max_waiting)
+    : min_limit_(std::min(max_running, ADMISSION_MIN_RUNNING_QUERIES)),
+      max_limit_(max_running),
+      max_waiting_(max_waiting),
+      limit_(max_running),
+      num_running_(0),
+      baseline_latency_(-1),
+      smoothed_latency_(-1),
+      num_finished_(0) {
+    guarantee(max_running > 0);
+    guarantee(max_waiting >= 0);
+}
+
+admission_controller_t::~admission_controller_t() {
+    assert_thread();
+    guarantee(num_running_ == 0);
+    guarantee(waiters_.empty());
+}
+
+void admission_controller_t::start(ticket_t *ticket) {
+    ++num_running_;
+    ticket->admitted_ = true;
+    ticket->admitted_ticks_ = get_ticks();
+}
+
+void admission_controller_t::finish(ticks_t latency_ticks) {
+    assert_thread();
+    --num_running_;
+
+    const double latency = ticks_to_secs(latency_ticks);
+    if (baseline_latency_ < 0) {
+        baseline_latency_ = smoothed_latency_ = latency;
+    } else {
+        baseline_latency_ = latency < baseline_latency_
+            ? latency
+            : baseline_latency_ + (latency - baseline_latency_) * ADMISSION_BASELINE_DRIFT;
+        smoothed_latency_ += (latency - smoothed_latency_) * ADMISSION_LATENCY_SMOOTHING;
+    }
+
+    ++num_finished_;
+    if (num_finished_ >= limit_) {
+        num_finished_ = 0;
+        if (smoothed_latency_ > baseline_latency_ * ADMISSION_LATENCY_TOLERANCE) {
+            limit_ = std::max(min_limit_, limit_ * ADMISSION_LIMIT_DECREASE);
+        } else if (num_running_ + static_cast<int64_t>(waiters_.size()) >= limit_ / 2) {
+            limit_ = std::min(max_limit_, limit_ + 1);
+        }
+    }
+
+    admit_waiters();
+}
+
+void admission_controller_t::admit_waiters() {
+    while (!waiters_.empty() && num_running_ < limit()) {
+        ticket_t *next = waiters_.head();
+        waiters_.remove(next);
+        start(next);
+        next->turn_.pulse();
+    }
+}
+
+admission_controller_t::ticket_t::ticket_t()
+    : parent_(NULL), admitted_(false), admitted_ticks_(0) { }
+
+admission_controller_t::ticket_t::~ticket_t() {
+    if (admitted_) {
+        parent_->finish(get_ticks() - admitted_ticks_);
+    } else if (in_a_list()) {
+        parent_->waiters_.remove(this);
+    }
+}
+
+bool admission_controller_t::ticket_t::admit(admission_controller_t *parent,
+                                             signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t) {
+    guarantee(parent_ == NULL);
+    parent->assert_thread();
+    parent_ = parent;
+
+    if (parent_->waiters_.empty() && parent_->num_running_ < parent_->limit()) {
+        parent_->start(this);
+        return true;
+    }
+    if (parent_->waiters_.size() >= parent_->max_waiting_) {
+        return false;
+    }
+
+    parent_->waiters_.push_back(this);
+    signal_timer_t timeout;
+    timeout.start(ADMISSION_MAX_WAIT_MS);
+    wait_any_t turn_or_timeout(&turn_, &timeout);
+    // If this is interrupted, the destructor takes the ticket out of line.
+    wait_interruptible(&turn_or_timeout, interruptor);
+    if (!admitted_) {
+        parent_->waiters_.remove(this);
+    }
+    return admitted_;
+}
@@ -0,0 +1,78 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_ADMISSION_CONTROL_HPP_
+#define CONCURRENCY_ADMISSION_CONTROL_HPP_
+
+#include "concurrency/cond_var.hpp"
+#include "containers/intrusive_list.hpp"
+#include "utils.hpp"
+
+/* Decides how many client queries run at once on a thread, so that an overloaded
+server answers some of its queries quickly and turns the rest away, instead of
+taking on every query it's sent until they all time out.
+
+Up to `limit()` queries run at once, and up to `max_waiting` more wait in line for
+their turn, for at most ADMISSION_MAX_WAIT_MS.  Queries that don't fit in the line or
+wait too long are refused, and the client gets an error right away.
+
+The limit starts at `max_running` and follows the queries' latency, much like TCP's
+congestion window.  After each limit's worth of queries, it shrinks by a tenth if
+their (smoothed) latency has grown to more than ADMISSION_LATENCY_TOLERANCE times the
+lowest recent latency, and otherwise grows by one if the queries are using it.  It
+never goes below ADMISSION_MIN_RUNNING_QUERIES (or `max_running`, if that's lower).
+It must be used on a single thread. */
+class admission_controller_t : public home_thread_mixin_t {
+public:
+    admission_controller_t(int max_running, int max_waiting);
+    ~admission_controller_t();
+
+    // A query's place in the controller.  Once admitted, it counts as running until
+    // it's destroyed.
+    class ticket_t : public intrusive_list_node_t<ticket_t> {
+    public:
+        ticket_t();
+        ~ticket_t();
+
+        // Waits for the query's turn to run.  Returns false if there are too many
+        // queries waiting already, or if its turn doesn't come in time.
+        MUST_USE bool admit(admission_controller_t *parent, signal_t *interruptor)
+            THROWS_ONLY(interrupted_exc_t);
+
+    private:
+        friend class admission_controller_t;
+
+        admission_controller_t *parent_;
+        bool admitted_;
+        ticks_t admitted_ticks_;
+        cond_t turn_;
+
+        DISABLE_COPYING(ticket_t);
+    };
+
+    int limit() const { return static_cast<int>(limit_); }
+    int num_running() const { return num_running_; }
+    size_t num_waiting() const { return waiters_.size(); }
+
+private:
+    void start(ticket_t *ticket);
+    void finish(ticks_t latency);
+    void admit_waiters();
+
+    const double min_limit_;
+    const double max_limit_;
+    const size_t max_waiting_;
+
+    double limit_;
+    int num_running_;
+    intrusive_list_t<ticket_t> waiters_;
+
+    // The lowest latency lately, which creeps up towards the latencies seen after
+    // it, and the smoothed latency, in seconds.
+    double baseline_latency_;
+    double smoothed_latency_;
+    // How many queries have finished since the limit was last looked at.
+    int num_finished_;
+
+    DISABLE_COPYING(admission_controller_t);
+};
+
+#endif  // CONCURRENCY_ADMISSION_CONTROL_HPP_
@@ -0,0 +1,93 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "concurrency/coro_pool.hpp"
+
+#include <algorithm>
+
+#include "config/args.hpp"
+
+coro_pool_sizer_t::coro_pool_sizer_t(int _min_workers, int _max_workers,
+                                     int64_t target_wait_ms,
+                                     perfmon_collection_t *parent, const char *name)
+    : min_workers(_min_workers),
+      max_workers(_max_workers),
+      target_wait(target_wait_ms * MILLION),
+      current_limit(_min_workers),
+      backlogged(false),
+      backlog_since(0),
+      interval_start(get_ticks()),
+      finished(0),
+      peak_active(0),
+      probing(false),
+      limit_before_probe(0),
+      throughput_before_probe(0),
+      hold_intervals(0),
+      collection(),
+      membership(parent, &collection, name),
+      pm_limit(),
+      pm_queue_wait(secs_to_ticks(1)),
+      collection_membership(&collection,
+          &pm_limit, "worker_limit",
+          &pm_queue_wait, "queue_wait") {
+    guarantee(min_workers > 0);
+    guarantee(max_workers >= min_workers);
+    pm_limit += current_limit;
+}
+
+void coro_pool_sizer_t::note_backlogged() {
+    if (!backlogged) {
+        backlogged = true;
+        backlog_since = get_ticks();
+    }
+}
+
+void coro_pool_sizer_t::note_drained() {
+    backlogged = false;
+}
+
+void coro_pool_sizer_t::note_dequeued() {
+    pm_queue_wait.record(backlogged ? ticks_to_secs(get_ticks() - backlog_since) : 0);
+}
+
+bool coro_pool_sizer_t::note_finished(int active_workers) {
+    ++finished;
+    peak_active = std::max(peak_active, active_workers);
+    const int old_limit = current_limit;
+    const ticks_t now = get_ticks();
+    if (now - interval_start >= CORO_POOL_SIZER_INTERVAL_MS * MILLION) {
+        adjust(now);
+    }
+    return current_limit > old_limit;
+}
+
+void coro_pool_sizer_t::adjust(ticks_t now) {
+    const double throughput = finished / ticks_to_secs(now - interval_start);
+    const int old_limit = current_limit;
+
+    if (probing) {
+        probing = false;
+        if (throughput < throughput_before_probe * (1 + CORO_POOL_SIZER_MIN_GAIN)) {
+            // More workers didn't help, so they're waiting on something else.
+            current_limit = limit_before_probe;
+            hold_intervals = CORO_POOL_SIZER_HOLD_INTERVALS;
+        }
+    }
+    if (backlogged && now - backlog_since > target_wait
+               && current_limit < max_workers && hold_intervals == 0) {
+        probing = true;
+        limit_before_probe = current_limit;
+        throughput_before_probe = throughput;
+        current_limit = std::min(max_workers,
+                                 current_limit + std::max(1, current_limit / 4));
+    } else if (!backlogged && peak_active < current_limit) {
+        current_limit = std::max(std::max(min_workers, peak_active),
+                                 current_limit - std::max(1, current_limit / 8));
+    }
+    if (hold_intervals > 0) {
+        --hold_intervals;
+    }
+
+    pm_limit += current_limit - old_limit;
+    interval_start = now;
+    finished = 0;
+    peak_active = 0;
+}
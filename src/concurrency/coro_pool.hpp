@@ -7,10 +7,79 @@
 
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/queue/passive_producer.hpp"
+#include "perfmon/perfmon.hpp"
 
 /* coro_pool_t maintains a bunch of coroutines; when you give it tasks, it
 distributes them among the coroutines. It draws its tasks from a
-`passive_producer_t`. */
+`passive_producer_t`. It runs at most a fixed number of coroutines at once, unless
+it's given a `coro_pool_sizer_t`, which changes the number with the load. */
+
+/* `coro_pool_sizer_t` makes a `coro_pool_t` elastic.  The pool runs at most `limit()`
+workers, which the sizer moves between `min_workers` and `max_workers`.
+
+When work has been queued without a worker free to take it for longer than
+`target_wait_ms`, the sizer grows the limit by a quarter.  If that doesn't get at
+least `CORO_POOL_SIZER_MIN_GAIN` more work done, then something other than the
+number of workers is the bottleneck (usually the disk), so it goes back to the old
+limit and doesn't try growing again for a while.  When the workers aren't all busy it
+shrinks the limit towards the number that were.
+
+The pool doesn't know when each item was queued, so the wait it reports is how long
+ago the queue last had no work waiting for a worker; that's an upper bound on how
+long the item a worker takes has been waiting.
+
+It appears in `parent` as a collection named `name`, with the current limit and the
+wait. */
+class coro_pool_sizer_t {
+public:
+    coro_pool_sizer_t(int _min_workers, int _max_workers, int64_t target_wait_ms,
+                      perfmon_collection_t *parent, const char *name);
+
+    int limit() const { return current_limit; }
+
+    // These are called by the pool.
+
+    // There's work queued that no worker is free to take.
+    void note_backlogged();
+    // The queue has run dry.
+    void note_drained();
+    // A worker is about to take an item from the queue.
+    void note_dequeued();
+    // A worker finished an item while `active_workers` workers (counting itself) were
+    // running.  Returns true if the limit grew, so the pool should start more workers.
+    bool note_finished(int active_workers);
+
+private:
+    void adjust(ticks_t now);
+
+    const int min_workers, max_workers;
+    const ticks_t target_wait;
+    int current_limit;
+
+    bool backlogged;
+    ticks_t backlog_since;
+
+    // What happened since the current interval started.
+    ticks_t interval_start;
+    int64_t finished;
+    int peak_active;
+
+    // Whether the limit was grown at the end of the last interval, and what it and
+    // the throughput were before that.
+    bool probing;
+    int limit_before_probe;
+    double throughput_before_probe;
+    // How many more intervals to wait before growing again.
+    int hold_intervals;
+
+    perfmon_collection_t collection;
+    perfmon_membership_t membership;
+    perfmon_counter_t pm_limit;
+    perfmon_histogram_t pm_queue_wait;
+    perfmon_multi_membership_t collection_membership;
+
+    DISABLE_COPYING(coro_pool_sizer_t);
+};
 
 template <class T>
 class coro_pool_callback_t {
@@ -40,6 +109,7 @@ public:
     coro_pool_t(size_t _worker_count, passive_producer_t<T> *_source, coro_pool_callback_t<T> *_callback)
         : max_worker_count(_worker_count),
           active_worker_count(0),
+          sizer(NULL),
           source(_source),
           callback(_callback) {
         rassert(max_worker_count > 0);
@@ -47,6 +117,18 @@ public:
         source->available->set_callback(this);
     }
 
+    // `_sizer` must outlive the pool.
+    coro_pool_t(coro_pool_sizer_t *_sizer, passive_producer_t<T> *_source, coro_pool_callback_t<T> *_callback)
+        : max_worker_count(0),
+          active_worker_count(0),
+          sizer(_sizer),
+          source(_source),
+          callback(_callback) {
+        rassert(sizer != NULL);
+        on_source_availability_changed();   // Start process if necessary
+        source->available->set_callback(this);
+    }
+
     ~coro_pool_t() {
         assert_thread();
         source->available->unset_callback();
@@ -66,9 +148,19 @@ private:
         try {
             while (!coro_drain_semaphore_lock.get_drain_signal()->is_pulsed()) {
                 callback->coro_pool_callback(object, coro_drain_semaphore_lock.get_drain_signal());
-                if (source->available->get()) {
+                if (sizer != NULL && sizer->note_finished(active_worker_count)) {
+                    on_source_availability_changed();
+                }
+                // If the limit shrank, this worker leaves the rest to the others.
+                if (source->available->get() && active_worker_count <= worker_limit()) {
+                    if (sizer != NULL) {
+                        sizer->note_dequeued();
+                    }
                     object = source->pop();
                 } else {
+                    if (sizer != NULL && !source->available->get()) {
+                        sizer->note_drained();
+                    }
                     break;
                 }
                 coro_t::yield();
@@ -81,15 +173,30 @@ private:
 
     void on_source_availability_changed() {
         assert_thread();
-        while (source->available->get() && active_worker_count < max_worker_count) {
+        while (source->available->get() && active_worker_count < worker_limit()) {
             ++active_worker_count;
+            if (sizer != NULL) {
+                sizer->note_dequeued();
+            }
             coro_t::spawn_sometime(std::bind(
                 &coro_pool_t::worker_run, this,
                 source->pop(), auto_drainer_t::lock_t(&coro_drain_semaphore)));
         }
+        if (sizer != NULL) {
+            if (source->available->get()) {
+                sizer->note_backlogged();
+            } else {
+                sizer->note_drained();
+            }
+        }
+    }
+
+    int worker_limit() const {
+        return sizer != NULL ? sizer->limit() : max_worker_count;
     }
 
     int max_worker_count, active_worker_count;
+    coro_pool_sizer_t *sizer;
     passive_producer_t<T> *source;
     coro_pool_callback_t<T> *callback;
     auto_drainer_t coro_drain_semaphore;
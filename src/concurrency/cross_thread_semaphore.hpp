@@ -33,8 +33,14 @@ public:
         explicit lock_t(cross_thread_semaphore_t *_parent, signal_t *interruptor) :
             parent(_parent), value(parent->lock(interruptor)) { }
 
+        // Doesn't wait: if no element is available, `get_value()` returns NULL
+        explicit lock_t(cross_thread_semaphore_t *_parent) :
+            parent(_parent), value(parent->try_lock()) { }
+
         ~lock_t() {
-            parent->unlock(value);
+            if (value != NULL) {
+                parent->unlock(value);
+            }
         }
 
         value_t *get_value() { return value; }
@@ -92,6 +98,7 @@ private:
     };
 
     value_t *lock(signal_t *interruptor);
+    value_t *try_lock();
     void unlock(value_t *value);
 
     // Mutex to control access, since a lock may be constructed from any thread
@@ -151,6 +158,22 @@ value_t *cross_thread_semaphore_t<value_t>::lock(signal_t *interruptor) {
     return result;
 }
 
+template <class value_t>
+value_t *cross_thread_semaphore_t<value_t>::try_lock() {
+    system_mutex_t::lock_t lock(&mutex);
+
+    if (available_value_index == values.size()) {
+        return NULL;
+    }
+
+    value_t *result = values[available_value_index];
+    values[available_value_index] = NULL;
+    ++available_value_index;
+
+    guarantee(result != NULL);
+    return result;
+}
+
 template <class value_t>
 void cross_thread_semaphore_t<value_t>::unlock(value_t *value) {
     system_mutex_t::lock_t lock(&mutex);
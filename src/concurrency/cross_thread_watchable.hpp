@@ -6,6 +6,8 @@
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/queue/single_value_producer.hpp"
 #include "concurrency/coro_pool.hpp"
+#include "containers/counted.hpp"
+#include "containers/scoped.hpp"
 
 /* `cross_thread_watchable_variable_t` is used to "proxy" a `watchable_t` from
 one thread to another. Create the `cross_thread_watchable_variable_t` on the
@@ -110,6 +112,119 @@ private:
     DISABLE_COPYING(cross_thread_watchable_variable_t);
 };
 
+/* `cross_thread_watchable_snapshots_t` does the job of a
+`cross_thread_watchable_variable_t` for every thread at once, for values that are
+expensive to copy.  When the value changes it's copied once, into an immutable
+reference-counted snapshot that every thread shares; a thread only swaps its pointer
+to the snapshot it's on.  Threads are told about changes lazily: a thread that hasn't
+caught up with one change yet skips straight to the latest one, so a burst of changes
+costs each thread one notification rather than one per change.
+
+Every change gets the next version number.  A thread never goes back to an older
+version but it may skip some.  A snapshot is freed once every thread has moved past
+it and nobody still holds it from `get_snapshot()`. */
+
+template <class value_t>
+class cross_thread_watchable_snapshots_t
+{
+public:
+    class snapshot_t : public slow_atomic_countable_t<snapshot_t> {
+    public:
+        snapshot_t(const value_t &_value, uint64_t _version) :
+            value(_value), version(_version) { }
+        const value_t value;
+        const uint64_t version;
+    private:
+        DISABLE_COPYING(snapshot_t);
+    };
+
+    // Must be constructed and destroyed on `watchable`'s home thread.
+    explicit cross_thread_watchable_snapshots_t(
+            const clone_ptr_t<watchable_t<value_t> > &watchable);
+
+    // Returns a watchable whose home thread is the calling thread.
+    clone_ptr_t<watchable_t<value_t> > get_watchable() {
+        return clone_ptr_t<watchable_t<value_t> >(new w_t(this, get_thread_id()));
+    }
+
+    // Returns the snapshot the calling thread is on, without copying the value.
+    counted_t<const snapshot_t> get_snapshot() {
+        return thread_states[get_thread_id().threadnum].current;
+    }
+
+    threadnum_t home_thread() { return watchable_thread; }
+
+private:
+    // Each field is only used on the thread noted next to it.
+    struct thread_state_t {
+        thread_state_t() : delivery_pending(false) { }
+        publisher_controller_t<boost::function<void()> > publisher_controller;  // dest
+        rwi_lock_assertion_t rwi_lock_assertion;  // dest
+        counted_t<const snapshot_t> current;  // dest
+        // Whether a coroutine is on its way to move the thread to `latest`.
+        bool delivery_pending;  // source
+    };
+
+    void on_value_changed();
+    void deliver(int thread, auto_drainer_t::lock_t keepalive);
+
+    class w_t : public watchable_t<value_t> {
+    public:
+        w_t(cross_thread_watchable_snapshots_t<value_t> *p, threadnum_t thread) :
+            parent(p), state(&p->thread_states[thread.threadnum]) {
+            home_thread_mixin_t::real_home_thread = thread;
+        }
+
+        w_t *clone() const {
+            return new w_t(parent, home_thread_mixin_t::home_thread());
+        }
+        value_t get() {
+            home_thread_mixin_t::assert_thread();
+            return state->current->value;
+        }
+        void apply_read(const std::function<void(const value_t*)> &read) {
+            home_thread_mixin_t::assert_thread();
+            ASSERT_NO_CORO_WAITING;
+            read(&state->current->value);
+        }
+        publisher_t<boost::function<void()> > *get_publisher() {
+            return state->publisher_controller.get_publisher();
+        }
+        rwi_lock_assertion_t *get_rwi_lock_assertion() {
+            return &state->rwi_lock_assertion;
+        }
+    private:
+        cross_thread_watchable_snapshots_t<value_t> *parent;
+        thread_state_t *state;
+    };
+
+    clone_ptr_t<watchable_t<value_t> > original;
+    threadnum_t watchable_thread;
+
+    // The newest snapshot; only used on the source thread.
+    counted_t<const snapshot_t> latest;
+
+    scoped_array_t<thread_state_t> thread_states;
+
+    /* Rethreads each thread's publisher and lock assertion to that thread, and back
+    again when it's destroyed, which must happen after `drainer` is destroyed. */
+    class rethreader_t {
+    public:
+        explicit rethreader_t(cross_thread_watchable_snapshots_t *p);
+        ~rethreader_t();
+    private:
+        cross_thread_watchable_snapshots_t *parent;
+    } rethreader;
+
+    auto_drainer_t drainer;
+
+    /* Must be destroyed before `drainer`, so that no more deliveries start while it's
+    draining the ones in flight. */
+    typename watchable_t<value_t>::subscription_t subs;
+
+    DISABLE_COPYING(cross_thread_watchable_snapshots_t);
+};
+
 #include "concurrency/cross_thread_watchable.tcc"
 
 #endif  // CONCURRENCY_CROSS_THREAD_WATCHABLE_HPP_
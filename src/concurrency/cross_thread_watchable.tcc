@@ -1,4 +1,5 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
+#include "arch/runtime/coroutines.hpp"
 #include "arch/runtime/runtime.hpp"
 
 template <class value_t>
@@ -30,3 +31,72 @@ void cross_thread_watchable_variable_t<value_t>::deliver(value_t new_value) {
     value = new_value;
     publisher_controller.publish(&cross_thread_watchable_variable_t<value_t>::call);
 }
+
+template <class value_t>
+cross_thread_watchable_snapshots_t<value_t>::cross_thread_watchable_snapshots_t(
+        const clone_ptr_t<watchable_t<value_t> > &w) :
+    original(w),
+    watchable_thread(get_thread_id()),
+    thread_states(get_num_threads()),
+    rethreader(this),
+    subs(boost::bind(&cross_thread_watchable_snapshots_t<value_t>::on_value_changed,
+                     this))
+{
+    rassert(original->get_rwi_lock_assertion()->home_thread() == watchable_thread);
+    typename watchable_t<value_t>::freeze_t freeze(original);
+    latest = make_counted<const snapshot_t>(original->get(), 0);
+    for (size_t i = 0; i < thread_states.size(); ++i) {
+        // Nothing can look at the other threads' states until we return.
+        thread_states[i].current = latest;
+    }
+    subs.reset(original, &freeze);
+}
+
+template <class value_t>
+cross_thread_watchable_snapshots_t<value_t>::rethreader_t::rethreader_t(
+        cross_thread_watchable_snapshots_t *p) : parent(p) {
+    for (size_t i = 0; i < parent->thread_states.size(); ++i) {
+        threadnum_t thread(i);
+        parent->thread_states[i].publisher_controller.rethread(thread);
+        parent->thread_states[i].rwi_lock_assertion.rethread(thread);
+    }
+}
+
+template <class value_t>
+cross_thread_watchable_snapshots_t<value_t>::rethreader_t::~rethreader_t() {
+    for (size_t i = 0; i < parent->thread_states.size(); ++i) {
+        parent->thread_states[i].publisher_controller.rethread(parent->watchable_thread);
+        parent->thread_states[i].rwi_lock_assertion.rethread(parent->watchable_thread);
+    }
+}
+
+template <class value_t>
+void cross_thread_watchable_snapshots_t<value_t>::on_value_changed() {
+    latest = make_counted<const snapshot_t>(original->get(), latest->version + 1);
+    for (size_t i = 0; i < thread_states.size(); ++i) {
+        if (!thread_states[i].delivery_pending) {
+            thread_states[i].delivery_pending = true;
+            coro_t::spawn_sometime(std::bind(
+                &cross_thread_watchable_snapshots_t<value_t>::deliver, this, i,
+                auto_drainer_t::lock_t(&drainer)));
+        }
+    }
+}
+
+template <class value_t>
+void cross_thread_watchable_snapshots_t<value_t>::deliver(
+        int thread, UNUSED auto_drainer_t::lock_t keepalive) {
+    thread_state_t *state = &thread_states[thread];
+    // Any change after this point spawns another delivery.
+    state->delivery_pending = false;
+    counted_t<const snapshot_t> snapshot = latest;
+
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    // A later delivery may have overtaken us on the way here.
+    if (snapshot->version > state->current->version) {
+        DEBUG_VAR rwi_lock_assertion_t::write_acq_t acquisition(
+            &state->rwi_lock_assertion);
+        state->current = snapshot;
+        state->publisher_controller.publish(&call_function);
+    }
+}
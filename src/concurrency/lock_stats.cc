@@ -0,0 +1,19 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "concurrency/lock_stats.hpp"
+
+lock_stats_t::lock_stats_t(perfmon_collection_t *parent, const char *name)
+    : collection(),
+      membership(parent, &collection, name),
+      pm_acquisitions(),
+      pm_contended(),
+      pm_wait_duration(secs_to_ticks(1)),
+      collection_membership(&collection,
+          &pm_acquisitions, "acquisitions",
+          &pm_contended, "contended",
+          &pm_wait_duration, "contended_wait_duration") { }
+
+void lock_stats_t::note_contended(ticks_t queued_at) {
+    ++pm_acquisitions;
+    ++pm_contended;
+    pm_wait_duration.record(ticks_to_secs(get_ticks() - queued_at));
+}
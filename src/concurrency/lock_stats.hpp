@@ -0,0 +1,36 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_LOCK_STATS_HPP_
+#define CONCURRENCY_LOCK_STATS_HPP_
+
+#include "perfmon/perfmon.hpp"
+
+/* `lock_stats_t` counts how often one kind of lock gets acquired and how long the
+acquirers that had to get in line waited.  `mutex_t`, `rwlock_t`, `new_semaphore_t` and
+the cache's page locks take an optional pointer to one of these; it appears in `parent`
+as a collection named `name`.  Uncontended acquisitions only bump a counter, so only
+contended ones pay for `get_ticks()`. */
+class lock_stats_t {
+public:
+    lock_stats_t(perfmon_collection_t *parent, const char *name);
+
+    void note_uncontended() {
+        ++pm_acquisitions;
+    }
+
+    // `queued_at` is when the acquirer got in line.
+    void note_contended(ticks_t queued_at);
+
+private:
+    perfmon_collection_t collection;
+    perfmon_membership_t membership;
+
+    perfmon_counter_t pm_acquisitions;
+    perfmon_counter_t pm_contended;
+    perfmon_histogram_t pm_wait_duration;
+
+    perfmon_multi_membership_t collection_membership;
+
+    DISABLE_COPYING(lock_stats_t);
+};
+
+#endif  // CONCURRENCY_LOCK_STATS_HPP_
@@ -1,7 +1,9 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "concurrency/mutex.hpp"
 
+#include "arch/runtime/coro_wait_profiler.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "concurrency/lock_stats.hpp"
 
 mutex_t::acq_t::acq_t(mutex_t *l, bool eager) : lock_(NULL), eager_(false) {
     reset(l, eager);
@@ -27,10 +29,18 @@ void mutex_t::acq_t::reset(mutex_t *l, bool eager) {
 
 void co_lock_mutex(mutex_t *mutex) {
     if (mutex->locked) {
+        coro_wait_site_t wait_site("mutex");
+        const ticks_t queued_at = mutex->stats != NULL ? get_ticks() : 0;
         mutex->waiters.push_back(coro_t::self());
         coro_t::wait();
+        if (mutex->stats != NULL) {
+            mutex->stats->note_contended(queued_at);
+        }
     } else {
         mutex->locked = true;
+        if (mutex->stats != NULL) {
+            mutex->stats->note_uncontended();
+        }
     }
 }
 
@@ -8,6 +8,7 @@
 #include "utils.hpp"
 
 class coro_t;
+class lock_stats_t;
 class mutex_t;
 
 void co_lock_mutex(mutex_t *mutex);
@@ -33,7 +34,8 @@ public:
         DISABLE_COPYING(acq_t);
     };
 
-    mutex_t() : locked(false) { }
+    // `stats` may be NULL.
+    explicit mutex_t(lock_stats_t *_stats = NULL) : locked(false), stats(_stats) { }
     ~mutex_t() { rassert(!locked); }
 
     bool is_locked() {
@@ -46,6 +48,7 @@ public:
 private:
     bool locked;
     std::deque<coro_t *> waiters;
+    lock_stats_t *const stats;
 
     DISABLE_COPYING(mutex_t);
 };
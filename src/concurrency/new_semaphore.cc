@@ -1,7 +1,9 @@
 #include "concurrency/new_semaphore.hpp"
 
-new_semaphore_t::new_semaphore_t(int64_t capacity)
-    : capacity_(capacity), current_(0) { }
+#include "concurrency/lock_stats.hpp"
+
+new_semaphore_t::new_semaphore_t(int64_t capacity, lock_stats_t *stats)
+    : capacity_(capacity), current_(0), stats_(stats) { }
 
 new_semaphore_t::~new_semaphore_t() {
     guarantee(current_ == 0);
@@ -11,6 +13,13 @@ new_semaphore_t::~new_semaphore_t() {
 void new_semaphore_t::add_acquirer(new_semaphore_acq_t *acq) {
     waiters_.push_back(acq);
     pulse_waiters();
+    if (stats_ != NULL) {
+        if (acq->cond_.is_pulsed()) {
+            stats_->note_uncontended();
+        } else {
+            acq->queued_at_ = get_ticks();
+        }
+    }
 }
 
 void new_semaphore_t::remove_acquirer(new_semaphore_acq_t *acq) {
@@ -28,6 +37,10 @@ void new_semaphore_t::pulse_waiters() {
         if (acq->count_ <= capacity_ - current_ || current_ == 0) {
             current_ += acq->count_;
             waiters_.remove(acq);
+            if (acq->queued_at_ != 0) {
+                stats_->note_contended(acq->queued_at_);
+                acq->queued_at_ = 0;
+            }
             acq->cond_.pulse();
         } else {
             break;
@@ -44,15 +57,16 @@ void new_semaphore_acq_t::reset() {
         semaphore_->remove_acquirer(this);
         semaphore_ = NULL;
         count_ = 0;
+        queued_at_ = 0;
         cond_.reset();
     }
 }
 
 new_semaphore_acq_t::new_semaphore_acq_t()
-    : semaphore_(NULL), count_(0) { }
+    : semaphore_(NULL), count_(0), queued_at_(0) { }
 
 new_semaphore_acq_t::new_semaphore_acq_t(new_semaphore_t *semaphore, int64_t count)
-    : semaphore_(NULL), count_(0) {
+    : semaphore_(NULL), count_(0), queued_at_(0) {
     init(semaphore, count);
 }
 
@@ -69,9 +83,11 @@ new_semaphore_acq_t::new_semaphore_acq_t(new_semaphore_acq_t &&movee)
     : intrusive_list_node_t<new_semaphore_acq_t>(std::move(movee)),
       semaphore_(movee.semaphore_),
       count_(movee.count_),
+      queued_at_(movee.queued_at_),
       cond_(std::move(movee.cond_)) {
     movee.semaphore_ = NULL;
     movee.count_ = 0;
+    movee.queued_at_ = 0;
     movee.cond_.reset();
 }
 
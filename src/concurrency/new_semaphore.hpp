@@ -12,11 +12,13 @@
 // such access was requested.  Also, there aren't problems with starvation.  Also, it
 // doesn't have naked lock and unlock functions, you have to use new_semaphore_acq_t.
 
+class lock_stats_t;
 class new_semaphore_acq_t;
 
 class new_semaphore_t {
 public:
-    explicit new_semaphore_t(int64_t capacity);
+    // `stats` may be NULL.
+    explicit new_semaphore_t(int64_t capacity, lock_stats_t *stats = NULL);
     ~new_semaphore_t();
 
     int64_t capacity() const { return capacity_; }
@@ -39,6 +41,8 @@ private:
 
     intrusive_list_t<new_semaphore_acq_t> waiters_;
 
+    lock_stats_t *const stats_;
+
     DISABLE_COPYING(new_semaphore_t);
 };
 
@@ -82,6 +86,10 @@ private:
     // non-NULL).
     int64_t count_;
 
+    // When we got in line, if the semaphore has stats and we weren't let in right
+    // away.
+    ticks_t queued_at_;
+
     // Gets pulsed when we have successfully acquired the semaphore.
     cond_t cond_;
     DISABLE_COPYING(new_semaphore_acq_t);
@@ -2,8 +2,14 @@
 #ifndef CONCURRENCY_QUEUE_ACCOUNTING_HPP_
 #define CONCURRENCY_QUEUE_ACCOUNTING_HPP_
 
+#include <stdint.h>
+
+#include <algorithm>
+
 #include "concurrency/queue/passive_producer.hpp"
 #include "containers/intrusive_list.hpp"
+#include "perfmon/perfmon.hpp"
+#include "utils.hpp"
 
 /* `accounting_queue_t` is useful when you have some number of actors competing
 for a shared resource, and you want them to be granted access to the resource in
@@ -15,7 +21,24 @@ from a number of other `passive_producer_t`s. To associate the
 `account_t`s determines which `passive_producer_t`s the `accounting_queue_t`
 will `pop()` from when its own `pop()` method is called. When one of the sub-
 `passive_producer_t`s is not available, then it is ignored until it becomes
-available. */
+available.
+
+Accounts are scheduled with start-time fair queueing: every account has a
+virtual time that advances by `1 / shares` each time we pop from it, and we pop
+from the available account with the smallest virtual time. An account that
+becomes available again starts at the current virtual time, so it cannot build
+up credit while it is idle, and a busy low-share account (such as GC or
+backfilling) cannot delay a high-share one (such as cache reads) by more than a
+few pops.
+
+An account can also have a latency target. If an account with a target has
+been waiting for longer than its target, it gets served before the fair
+schedule resumes. (We can't see how long the value at the head of an account's
+source has been waiting, so we measure from when the account last got served or
+became available, which is a lower bound.)
+
+`batch_factor` is how many values we pop from an account in a row before
+picking an account again. Sequential runs matter on rotational drives. */
 
 template<class value_t>
 class accounting_queue_t :
@@ -23,11 +46,14 @@ class accounting_queue_t :
     public home_thread_mixin_debug_only_t
 {
 public:
-    explicit accounting_queue_t(int _batch_factor) :
+    explicit accounting_queue_t(int _batch_factor,
+                                perfmon_counter_t *_overdue_pops = NULL) :
         passive_producer_t<value_t>(&available_control),
-        total_shares(0),
-        selector(0),
-        batch_factor(_batch_factor) {
+        virtual_time(0),
+        batch_factor(_batch_factor),
+        batch_account(NULL),
+        batch_remaining(0),
+        overdue_pops(_overdue_pops) {
 
         rassert(batch_factor > 0);
     }
@@ -39,8 +65,10 @@ public:
 
     class account_t : private availability_callback_t, public intrusive_list_node_t<account_t> {
     public:
-        account_t(accounting_queue_t *p, passive_producer_t<value_t> *s, int _shares)
-            : parent(p), source(s), shares(_shares), active(false) {
+        account_t(accounting_queue_t *p, passive_producer_t<value_t> *s, int _shares,
+                  ticks_t _latency_target = 0)
+            : parent(p), source(s), shares(_shares), latency_target(_latency_target),
+              active(false), virtual_time(0), waiting_since(0) {
             parent->assert_thread();
             rassert(shares > 0);
             if (source->available->get()) {
@@ -62,6 +90,12 @@ public:
             parent->available_control.set_available(!parent->active_accounts.empty());
         }
 
+        /* Zero means that the account has no latency target. */
+        void set_latency_target(ticks_t target) {
+            parent->assert_thread();
+            latency_target = target;
+        }
+
     private:
         friend class accounting_queue_t;
 
@@ -80,50 +114,103 @@ public:
         void activate() {
             active = true;
             parent->active_accounts.push_back(this);
-            parent->total_shares += shares;
+            virtual_time = std::max(virtual_time, parent->virtual_time);
+            waiting_since = get_ticks();
         }
         void deactivate() {
             active = false;
             parent->active_accounts.remove(this);
-            parent->total_shares -= shares;
+            if (parent->batch_account == this) {
+                parent->batch_account = NULL;
+            }
+        }
+
+        /* How far past its latency target the account is, or zero. */
+        ticks_t overdue_by(ticks_t now) const {
+            if (latency_target == 0 || now - waiting_since <= latency_target) {
+                return 0;
+            }
+            return now - waiting_since - latency_target;
         }
 
         accounting_queue_t *parent;
         passive_producer_t<value_t> *source;
         int shares;
+        ticks_t latency_target;
         bool active;
+        /* The virtual time at which the account will next be served; we store it
+        scaled by `VIRTUAL_TIME_SCALE` to avoid floating point. */
+        uint64_t virtual_time;
+        ticks_t waiting_since;
     };
 
 private:
     friend class account_t;
 
+    /* Large enough that `VIRTUAL_TIME_SCALE / shares` is precise for any
+    reasonable number of shares. */
+    static const uint64_t VIRTUAL_TIME_SCALE = 1 << 20;
+
+    account_t *pick_account() {
+        const ticks_t now = get_ticks();
+
+        /* Deadlines come first. */
+        account_t *most_overdue = NULL;
+        ticks_t most_overdue_by = 0;
+        for (account_t *acct = active_accounts.head(); acct != NULL;
+             acct = active_accounts.next(acct)) {
+            const ticks_t overdue = acct->overdue_by(now);
+            if (overdue > most_overdue_by) {
+                most_overdue = acct;
+                most_overdue_by = overdue;
+            }
+        }
+        if (most_overdue != NULL) {
+            if (overdue_pops != NULL) {
+                ++*overdue_pops;
+            }
+            batch_account = NULL;
+            return most_overdue;
+        }
+
+        if (batch_account != NULL && batch_remaining > 0) {
+            return batch_account;
+        }
+
+        account_t *earliest = active_accounts.head();
+        for (account_t *acct = active_accounts.next(earliest); acct != NULL;
+             acct = active_accounts.next(acct)) {
+            if (acct->virtual_time < earliest->virtual_time) {
+                earliest = acct;
+            }
+        }
+        batch_account = earliest;
+        batch_remaining = batch_factor;
+        return earliest;
+    }
+
     intrusive_list_t<account_t> active_accounts, inactive_accounts;
 
-    int total_shares, selector, batch_factor;
+    /* The start tag of the value that was popped most recently. */
+    uint64_t virtual_time;
+
+    int batch_factor;
+    account_t *batch_account;
+    int batch_remaining;
+
+    perfmon_counter_t *overdue_pops;
 
     availability_control_t available_control;
     value_t produce_next_value() {
         assert_thread();
 
-        selector %= total_shares * batch_factor;
-        // TODO: Maybe that line should be like this instead?
-        // It would be very fair, but there might be some issues with that (like
-        // less sequential access patterns (<-- definitely a problem on rotational drives!),
-        // maybe other problems)
-        //selector = randint(total_shares);
-
-        int batch_selector = selector / batch_factor;
-
-        account_t *acct = active_accounts.head();
-        int count = 0;
-        for (;;) {
-            count += acct->shares;
-            if (count > batch_selector) {
-                break;
-            }
-            acct = active_accounts.next(acct);
+        account_t *acct = pick_account();
+        virtual_time = acct->virtual_time;
+        acct->virtual_time += VIRTUAL_TIME_SCALE / acct->shares;
+        acct->waiting_since = get_ticks();
+        if (acct == batch_account) {
+            --batch_remaining;
         }
-        selector++;
         return acct->source->pop();
     }
 };
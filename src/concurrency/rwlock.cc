@@ -1,6 +1,10 @@
 #include "concurrency/rwlock.hpp"
 
-rwlock_t::rwlock_t() { }
+#include "arch/runtime/coro_wait_profiler.hpp"
+#include "concurrency/lock_stats.hpp"
+
+rwlock_t::rwlock_t(lock_stats_t *stats, rwlock_fairness_t fairness)
+    : stats_(stats), fairness_(fairness) { }
 
 rwlock_t::~rwlock_t() {
     guarantee(acqs_.empty());
@@ -9,14 +13,58 @@ rwlock_t::~rwlock_t() {
 void rwlock_t::add_acq(rwlock_in_line_t *acq) {
     acqs_.push_back(acq);
     pulse_pulsables(acq);
+    if (stats_ != NULL) {
+        const cond_t *granted = acq->access_ == access_t::read
+            ? &acq->read_cond_ : &acq->write_cond_;
+        if (granted->is_pulsed()) {
+            stats_->note_uncontended();
+        } else {
+            acq->queued_at_ = get_ticks();
+        }
+    }
+}
+
+void rwlock_t::note_granted(rwlock_in_line_t *acq, access_t access) {
+    if (acq->queued_at_ != 0 && acq->access_ == access) {
+        stats_->note_contended(acq->queued_at_);
+        acq->queued_at_ = 0;
+    }
 }
 
 void rwlock_t::remove_acq(rwlock_in_line_t *acq) {
     rwlock_in_line_t *subsequent = acqs_.next(acq);
+    const bool ends_write_phase = fairness_ == rwlock_fairness_t::phase_fair
+        && acq->access_ == access_t::write && acq->write_cond_.is_pulsed();
     acqs_.remove(acq);
+    if (ends_write_phase && subsequent != NULL
+        && subsequent->access_ == access_t::read) {
+        gather_waiting_readers(subsequent);
+    }
     pulse_pulsables(subsequent);
 }
 
+void rwlock_t::gather_waiting_readers(rwlock_in_line_t *first_reader) {
+    rwlock_in_line_t *writer = first_reader;
+    while (writer != NULL && writer->access_ == access_t::read) {
+        writer = acqs_.next(writer);
+    }
+    if (writer == NULL) {
+        return;
+    }
+    // Nothing behind a writer that hasn't got the lock has been pulsed, so these
+    // readers are all still waiting.
+    rwlock_in_line_t *p = acqs_.next(writer);
+    while (p != NULL) {
+        rwlock_in_line_t *next = acqs_.next(p);
+        if (p->access_ == access_t::read) {
+            rassert(!p->read_cond_.is_pulsed());
+            acqs_.remove(p);
+            acqs_.insert_before(p, writer);
+        }
+        p = next;
+    }
+}
+
 // p is a node whose situation might have changed -- a node whose previous entry is
 // different.
 void rwlock_t::pulse_pulsables(rwlock_in_line_t *p) {
@@ -30,6 +78,7 @@ void rwlock_t::pulse_pulsables(rwlock_in_line_t *p) {
         // read, the subsequent chain of nodes will already have been pulsed for
         // read.)
         if (p->access_ == access_t::write && acqs_.prev(p) == NULL) {
+            note_granted(p, access_t::write);
             p->write_cond_.pulse_if_not_already_pulsed();
         }
         return;
@@ -43,11 +92,13 @@ void rwlock_t::pulse_pulsables(rwlock_in_line_t *p) {
                 // pulsed read-acquirer.
                 return;
             }
+            note_granted(p, access_t::read);
             p->read_cond_.pulse();
 
             // Should we also pulse p for write (and exit, of course)?
             if (p->access_ == access_t::write) {
                 if (prev == NULL) {
+                    note_granted(p, access_t::write);
                     p->write_cond_.pulse();
                 }
                 return;
@@ -61,7 +112,7 @@ void rwlock_t::pulse_pulsables(rwlock_in_line_t *p) {
 
 
 rwlock_in_line_t::rwlock_in_line_t(rwlock_t *lock, access_t access)
-    : lock_(lock), access_(access) {
+    : lock_(lock), access_(access), queued_at_(0) {
     lock_->add_acq(this);
 }
 
@@ -72,6 +123,7 @@ rwlock_in_line_t::~rwlock_in_line_t() {
 
 rwlock_acq_t::rwlock_acq_t(rwlock_t *lock, access_t access)
     : rwlock_in_line_t(lock, access) {
+    coro_wait_site_t wait_site("rwlock");
     if (access == access_t::read) {
         read_signal()->wait();
     } else {
@@ -5,11 +5,28 @@
 #include "concurrency/cond_var.hpp"
 #include "containers/intrusive_list.hpp"
 
+class lock_stats_t;
 class rwlock_in_line_t;
 
+// How an `rwlock_t` orders the acquirers waiting for it.
+enum class rwlock_fairness_t {
+    // Strictly in the order they got in line.  Readers that are interleaved with
+    // writers get the lock one small group at a time.
+    fifo,
+    // Phase-fair: when a writer releases the lock and a reader is next in line, every
+    // reader that's waiting gets the lock together, including ones that got in line
+    // behind other writers.  That gathers the writers they were between, so that those
+    // run back to back.  Readers that get in line while a writer is waiting still wait
+    // for it, a writer never goes ahead of a reader that got in line before it, and
+    // writers still get the lock in the order they got in line.
+    phase_fair
+};
+
 class rwlock_t {
 public:
-    rwlock_t();
+    // `stats` may be NULL.
+    explicit rwlock_t(lock_stats_t *stats = NULL,
+                      rwlock_fairness_t fairness = rwlock_fairness_t::fifo);
     ~rwlock_t();
 
 private:
@@ -18,11 +35,18 @@ private:
     void remove_acq(rwlock_in_line_t *acq);
 
     void pulse_pulsables(rwlock_in_line_t *p);
+    // Moves the readers waiting behind the writer after `first_reader`'s run of
+    // readers in front of that writer.
+    void gather_waiting_readers(rwlock_in_line_t *first_reader);
+    // Records a contended acquisition if `acq` was waiting for `access`.
+    void note_granted(rwlock_in_line_t *acq, access_t access);
 
     // Acquirers, in order by acquisition, with the head containing one of the
     // current acquirer, the tail possibly containing a node that does not yet hold
     // the lock.
     intrusive_list_t<rwlock_in_line_t> acqs_;
+    lock_stats_t *const stats_;
+    const rwlock_fairness_t fairness_;
     DISABLE_COPYING(rwlock_t);
 };
 
@@ -51,6 +75,8 @@ private:
     const access_t access_;
     cond_t read_cond_;
     cond_t write_cond_;
+    // When we got in line, if the lock has stats and we weren't let in right away.
+    ticks_t queued_at_;
 
     DISABLE_COPYING(rwlock_in_line_t);
 };
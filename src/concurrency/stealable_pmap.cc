@@ -0,0 +1,55 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "concurrency/stealable_pmap.hpp"
+
+#include <algorithm>
+
+#include "do_on_thread.hpp"
+
+stealable_work_t::stealable_work_t(int _count, run_fn_t _run_fn, const void *_callable)
+    : count(_count),
+      run_fn(_run_fn),
+      callable(_callable),
+      home_thread(get_thread_id()),
+      next(0),
+      remaining(_count) { }
+
+void stealable_work_t::invite_thieves() {
+    const int num_threads = get_num_threads();
+    const int num_thieves = std::min(count - 1, num_threads - 1);
+    for (int i = 1; i <= num_thieves; ++i) {
+        // The message comes back to this thread before it's destroyed, so that's
+        // where the reference gets released.
+        counted_t<stealable_work_t> self(this);
+        do_on_thread(threadnum_t((home_thread.threadnum + i) % num_threads),
+                     [self]() { self->steal(); });
+    }
+}
+
+int stealable_work_t::run_some() {
+    int ran = 0;
+    for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+        run_fn(callable, i);
+        ++ran;
+    }
+    return ran;
+}
+
+void stealable_work_t::run_and_wait() {
+    rassert(get_thread_id() == home_thread);
+    const int ran = run_some();
+    if (ran > 0 && remaining.fetch_sub(ran) == ran) {
+        // We finished last, so nobody is going to pulse `done`.
+        return;
+    }
+    done.wait();
+}
+
+void stealable_work_t::steal() {
+    const int ran = run_some();
+    if (ran > 0 && remaining.fetch_sub(ran) == ran) {
+        // `run_and_wait()` can't return before this gets there, so `this` is still
+        // alive when it does.
+        stealable_work_t *self = this;
+        do_on_thread(home_thread, [self]() { self->done.pulse(); });
+    }
+}
@@ -0,0 +1,82 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_STEALABLE_PMAP_HPP_
+#define CONCURRENCY_STEALABLE_PMAP_HPP_
+
+#include <atomic>
+
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/counted.hpp"
+
+/* `stealable_pmap(count, c)` calls `c(i)` for every `i` in `[0, count)`, like
+`pmap()`, except that other threads may steal some of the calls.  The calling thread
+runs calls until there are none left to claim and then waits for any that other
+threads are still running.
+
+This is only for work that doesn't care which thread it runs on: `c` is called
+outside of any coroutine, on whichever thread claims `i`, so it must not block,
+throw, or touch anything that belongs to a particular thread (such as objects that
+derive from `single_threaded_countable_t`).  Deserializing datums is fine, since
+they count their references atomically.  Anything bound to a thread should still go
+there with `on_thread_t`.
+
+Other threads are invited to steal by a message, which only gets handled once they
+have nothing more urgent to do, so a busy thread joins in late or not at all. */
+
+class stealable_work_t : public slow_atomic_countable_t<stealable_work_t> {
+public:
+    typedef void (*run_fn_t)(const void *callable, int i);
+
+    stealable_work_t(int count, run_fn_t run_fn, const void *callable);
+
+    // Sends up to `count - 1` other threads a message asking them to steal.
+    void invite_thieves();
+
+    // Runs calls on this thread until there are none left to claim, then waits for
+    // the ones that other threads claimed.
+    void run_and_wait();
+
+private:
+    // Claims and runs calls until there are none left, returning how many it ran.
+    int run_some();
+
+    // Runs on another thread once it gets to our message.
+    void steal();
+
+    const int count;
+    const run_fn_t run_fn;
+    const void *const callable;
+    const threadnum_t home_thread;
+
+    // The next `i` that nobody has claimed yet
+    std::atomic<int> next;
+    // How many calls haven't finished yet
+    std::atomic<int> remaining;
+
+    // Pulsed on `home_thread` by the thread that finishes the last stolen call
+    cond_t done;
+
+    DISABLE_COPYING(stealable_work_t);
+};
+
+template <class callable_t>
+void stealable_pmap_run_one(const void *callable, int i) {
+    (*static_cast<const callable_t *>(callable))(i);
+}
+
+template <class callable_t>
+void stealable_pmap(int count, const callable_t &c) {
+    if (count <= 1 || get_num_threads() == 1) {
+        for (int i = 0; i < count; ++i) {
+            c(i);
+        }
+        return;
+    }
+
+    counted_t<stealable_work_t> work(
+        new stealable_work_t(count, &stealable_pmap_run_one<callable_t>, &c));
+    work->invite_thieves();
+    work->run_and_wait();
+}
+
+#endif  // CONCURRENCY_STEALABLE_PMAP_HPP_
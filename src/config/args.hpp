@@ -16,22 +16,34 @@
  */
 
 #define SOFTWARE_NAME_STRING "RethinkDB"
-#define SERIALIZER_VERSION_STRING "1.12"
+#define SERIALIZER_VERSION_STRING "1.13"
+// The last serializer version whose blocks had no checksums.  Its blocks have shorter
+// headers (see LS_UNCHECKSUMMED_HEADER_SHORTFALL); the log serializer keeps its files
+// in that format.
+#define UNCHECKSUMMED_SERIALIZER_VERSION_STRING "1.12"
 
 /**
  * Basic configuration parameters.
  */
 
-// The number of hash-based CPU shards per table.
-// This "must" be hard-coded because a cluster cannot run with
-// differing cpu sharding factors.
+// The default number of hash-based CPU shards per table.  A table's number is
+// fixed when it's created (see `namespace_semilattice_metadata_t`), because every
+// machine has to split the table the same way: the reactors on different machines
+// pair up their cpu-sharded regions.
 #define CPU_SHARDING_FACTOR                       8
 
+// The most hash-based CPU shards a table may have.
+#define MAX_CPU_SHARDING_FACTOR                   64
+
 // Defines the maximum size of the batch of IO events to process on
 // each loop iteration. A larger number will increase throughput but
 // decrease concurrency
 #define MAX_IO_EVENT_PROCESSING_BATCH_SIZE        50
 
+// The longest `--busy-poll` interval we accept, in microseconds.  Past this a thread
+// would spend more time spinning than it could ever save on wakeups.
+#define MAX_EVENT_QUEUE_BUSY_POLL_USEC            10000
+
 // The io batch factor ensures a minimum number of i/o operations
 // which are picked from any specific i/o account consecutively.
 // A higher value might be advantageous for throughput if seek times
@@ -45,6 +57,10 @@
 // useful.
 #define DEFAULT_IO_BATCH_FACTOR                   1
 
+// The conflict resolver merges contiguous writes to the same file that get
+// submitted together into a single pwritev(), up to this many bytes.
+#define MAX_COALESCED_WRITE_SIZE                  (4 * MEGABYTE)
+
 // Currently, each cache uses two IO accounts:
 // one account for writes, and one account for reads.
 // By adjusting the priorities of these accounts, reads
@@ -52,11 +68,160 @@
 #define CACHE_READS_IO_PRIORITY                   (512 / CPU_SHARDING_FACTOR)
 #define CACHE_WRITES_IO_PRIORITY                  (64 / CPU_SHARDING_FACTOR)
 
+// Once a cache's reads have been waiting this long for the disk, the I/O scheduler
+// serves them ahead of the fair schedule, so that backfills and GC can't make
+// foreground reads wait for long.
+#define CACHE_READS_IO_LATENCY_TARGET_MS          20
+
 // The cache priority to use for secondary index post construction
 // 100 = same priority as all other read operations in the cache together.
 // 0 = minimal priority
 #define SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY   5
 
+// The background defragmenter rewrites this many leaves per write transaction, in
+// a cache account of this priority, and then waits this long before the next batch.
+#define DEFRAGMENT_BATCH_LEAVES                   32
+#define DEFRAGMENT_CACHE_PRIORITY                 5
+
+// The priority of the block reads of coroutines that run below the default priority,
+// such as batch queries (see query_priority_t), backfills and secondary index
+// construction.
+#define BACKGROUND_READS_CACHE_PRIORITY           25
+#define DEFRAGMENT_BATCH_DELAY_MS                 10
+
+// Secondary index post construction sorts the new index's pairs in memory until
+// they take up this much space (per index), and then writes them out to a sorted run
+// on disk.  At most SINDEX_POST_CONSTRUCTION_MERGE_FAN_IN runs get merged at once.
+#define SINDEX_POST_CONSTRUCTION_SORT_BUFFER_SIZE (64 * MEGABYTE)
+#define SINDEX_POST_CONSTRUCTION_MERGE_FAN_IN     32
+
+// How many sorted pairs secondary index post construction bulk loads into the index
+// in each transaction.
+#define SINDEX_POST_CONSTRUCTION_PAIRS_PER_TXN    4096
+
+// Secondary index post construction reads the table (and writes the new indexes) no
+// faster than this many bytes per second, so that it doesn't crowd out queries.
+// 0 means no limit.
+#define SINDEX_POST_CONSTRUCTION_MAX_BYTES_PER_SEC (32 * MEGABYTE)
+
+// About how many bytes of rows a backfiller puts in each backfill chunk; the
+// backfillee applies each chunk in a single transaction.
+#define BACKFILL_BATCH_SIZE                       (64 * KILOBYTE)
+
+// A backfiller tells the backfillee how far through the key space it's gotten about
+// once per this many leaf nodes; the backfillee records that in its metainfo, so an
+// interrupted backfill can pick up from there.
+#define BACKFILL_PROGRESS_INTERVAL_LEAVES         64
+
+// A mirror that has this many writes (or this many bytes of writes) from the
+// broadcaster that it hasn't acked yet is lagging, and the broadcaster holds back new
+// writes until it falls behind less.  If holding back a write for
+// BROADCASTER_MAX_BACKPRESSURE_DELAY_MS doesn't help, the broadcaster stops waiting
+// for that mirror until it has caught up to half of these limits.
+#define BROADCASTER_MAX_LAG_WRITES                1000
+#define BROADCASTER_MAX_LAG_BYTES                 (64 * MEGABYTE)
+#define BROADCASTER_MAX_BACKPRESSURE_DELAY_MS     1000
+
+// The size of the chunks of pairs that an external_sorter_t reads and writes its
+// runs in (and of the chunks of rows that an unindexed order_by spills).
+#define EXTERNAL_SORT_CHUNK_SIZE                  (256 * KILOBYTE)
+
+// How many of the sorted runs an unindexed order_by spills to disk get merged into
+// one at a time.
+#define ORDER_BY_MERGE_FAN_IN                     16
+
+// How many partitions a hash join splits both of its sides into on disk, when the
+// side it hashes doesn't fit in memory.
+#define HASH_JOIN_PARTITIONS                      32
+
+// A cursor's first batch holds at most this many rows, so that the first rows come
+// back quickly.  Later batches double in size (up to CURSOR_MAX_BATCH_ELS) while the
+// client asks for each one within CURSOR_QUICK_CONTINUE_USECS of getting the last,
+// and halve when rows get more than CURSOR_COST_SPIKE_FACTOR times as slow to
+// produce as they have been.
+#define CURSOR_INITIAL_BATCH_ELS                  64
+#define CURSOR_MAX_BATCH_ELS                      (1 << 20)
+#define CURSOR_QUICK_CONTINUE_USECS               (50 * 1000)
+#define CURSOR_COST_SPIKE_FACTOR                  4
+
+// A connection stops fetching its cursors' next batches ahead of time while the ones
+// it has already fetched take up more than this.
+#define CURSOR_PREFETCH_BUDGET                    (32 * MEGABYTE)
+
+// A changefeed server holds at most this many changes for each subscription that it
+// hasn't managed to send yet.  Past that it drops them and tells the subscription
+// that it lost changes.
+#define CHANGEFEED_SERVER_QUEUE_SIZE              10000
+
+// How many queries a client connection runs at once.  The server stops reading the
+// connection's next query while this many are running.
+#define MAX_PIPELINED_QUERIES_PER_CONNECTION      64
+
+// How many compiled queries a connection keeps for reuse (see `plan_cache_t`), and
+// how big a query's shape can be before we don't bother.
+#define PLAN_CACHE_SIZE                           64
+#define PLAN_CACHE_MAX_SHAPE_SIZE                 (16 * KILOBYTE)
+
+// How many results of queries run with `result_cache: true` each thread keeps (see
+// `result_cache_t`), and the biggest query and result it keeps.
+#define RESULT_CACHE_SIZE                         128
+#define RESULT_CACHE_MAX_QUERY_SIZE               (16 * KILOBYTE)
+#define RESULT_CACHE_MAX_RESULT_SIZE              MEGABYTE
+
+// Shards send the items of a range read's stream in chunks of this many, and the
+// coordinator deserializes the chunks on all of its threads at once.
+#define RGET_RESPONSE_CHUNK_ITEMS                 256
+
+// `map` and `concatMap` evaluate a function that reads tables on this many rows at
+// once, so that the rows' reads overlap (see `overlap_calls`).
+#define FUNC_MAX_OVERLAPPING_CALLS                16
+
+// How many compiled regexes a query keeps for `match` (see `regex_cache_t`).
+#define REGEX_CACHE_SIZE                          32
+
+// The server traces one in every QUERY_TRACE_SAMPLE_INTERVAL queries on each thread
+// even when the client didn't ask for a profile, and keeps those queries along with
+// any that took longer than QUERY_TRACE_SLOW_THRESHOLD_MS (see `query_trace_log_t`).
+// Each thread keeps its last QUERY_TRACE_LOG_SIZE of them, with the query's text cut
+// off after QUERY_TRACE_MAX_QUERY_SIZE bytes.
+#define QUERY_TRACE_SAMPLE_INTERVAL               1000
+#define QUERY_TRACE_SLOW_THRESHOLD_MS             1000
+#define QUERY_TRACE_LOG_SIZE                      32
+#define QUERY_TRACE_MAX_QUERY_SIZE                (4 * KILOBYTE)
+
+// With --capture-queries, each thread writes the queries it captured once it has
+// QUERY_CAPTURE_BUFFER_SIZE bytes of them or the oldest is QUERY_CAPTURE_FLUSH_INTERVAL_MS
+// old, and the server stops capturing once the file is QUERY_CAPTURE_MAX_FILE_SIZE
+// bytes (see `query_capture_t`).
+#define QUERY_CAPTURE_BUFFER_SIZE                 (64 * KILOBYTE)
+#define QUERY_CAPTURE_FLUSH_INTERVAL_MS           1000
+#define QUERY_CAPTURE_MAX_FILE_SIZE               (4 * GIGABYTE)
+
+// Each extproc worker shares a memory segment with the main process, holding a ring
+// buffer of this size for each direction that jobs' data goes through.
+#define EXTPROC_SHM_RING_SIZE                     (1 * MEGABYTE)
+
+// How many compiled JavaScript functions each extproc worker keeps around for later
+// jobs that evaluate the same source.
+#define EXTPROC_JS_FUNCTION_CACHE_SIZE            256
+
+// With --js-in-process, V8 runs JavaScript on the calling coroutine's stack, and
+// reports a stack overflow once a script leaves less than this much of it free
+// (for V8's own native frames and ours).
+#define JS_IN_PROCESS_STACK_SLACK                 (32 * KILOBYTE)
+
+// Geo indexes key each point by its geohash this many characters long (about 4 cm
+// across), so changing it changes what existing geo indexes mean.
+#define GEOHASH_PRECISION                         12
+
+// A geo query reads at most this many geohash cells of the index, as small as that
+// allows, to cover its region.
+#define GEO_MAX_COVERING_CELLS                    16
+
+// Text indexes cut words off at this many bytes, which keeps their keys from being
+// truncated.  Changing it changes what existing text indexes mean.
+#define TEXT_INDEX_MAX_WORD_LENGTH                64
+
 // Garbage Collection uses its own two IO accounts.
 // There is one low-priority account that is meant to guarantee
 // (performance-wise) unintrusive garbage collection.
@@ -76,6 +241,17 @@
 // Size of the device block size (in bytes)
 #define DEVICE_BLOCK_SIZE                         512
 
+// How much address space the buffer arena reserves for block buffers.  Only the
+// chunks that get used are backed by memory; buffers beyond it come from malloc.
+#define BUFFER_ARENA_RESERVATION                  (256 * GIGABYTE)
+
+// Blocks bigger than this (in bytes) don't get their buffers from the buffer arena.
+#define BUFFER_ARENA_MAX_BUFFER_SIZE              (64 * KILOBYTE)
+
+// The number of NUMA nodes the buffer arena keeps separate free lists for; buffers
+// on nodes beyond these share the lists of the lower ones.
+#define BUFFER_ARENA_MAX_NUMA_NODES               8
+
 // Size of the metablock (in bytes)
 #define METABLOCK_SIZE                            (4 * KILOBYTE)
 
@@ -85,8 +261,23 @@
 // Size of each extent (in bytes)
 #define DEFAULT_EXTENT_SIZE                       (512 * KILOBYTE)
 
-// Ratio of free ram to use for the cache by default
-// TODO: DEFAULT_MAX_CACHE_RATIO is unused. Should it be deleted?
+// How much of a table striped over several files (see `striped_file_t`) goes in one
+// file before the next.  Must be a multiple of the extent size.
+#define SERIALIZER_STRIPE_SIZE                    DEFAULT_EXTENT_SIZE
+
+// The I/O priority of writes to a serializer's SSD cache (see `ssd_block_cache_t`),
+// and how many of them may be in flight before it stops taking new blocks.
+#define SSD_CACHE_WRITES_IO_PRIORITY              (CACHE_WRITES_IO_PRIORITY / 2)
+#define SSD_CACHE_MAX_WRITES_IN_FLIGHT            64
+// The default size of each table's SSD cache (see `--ssd-cache-size`), in megabytes.
+#define DEFAULT_SSD_CACHE_SIZE_MB                 1024
+
+// How much disk space a data file allocates at a time as it grows (see
+// `linux_file_t::preallocate`).
+#define FILE_PREALLOCATION_CHUNK_SIZE             (16 * MEGABYTE)
+
+// With `--cache-size auto`, the tables' caches share this fraction of the memory the
+// process may use (see `get_memory_limit`).
 #define DEFAULT_MAX_CACHE_RATIO                   0.5
 
 // The maximum number of concurrently active
@@ -102,6 +293,36 @@
 // merger serializer.
 #define MERGED_INDEX_WRITE_IO_PRIORITY            128
 
+// How many stores each shared table file (see shared_table_files_t) holds.  A
+// store's block ids are spread this far apart in the file, and the serializer's
+// in-memory index grows with the biggest block id, so this can't be large.
+#define SHARED_TABLE_FILE_SLOTS                   256
+
+// How many tables open their serializers and caches at once, when a server starts
+// or gets new tables (see store_opening_queue_t).
+#define MAX_CONCURRENT_STORE_OPENINGS             8
+
+// How often (in milliseconds) a server forgets the branches in its branch history
+// that none of the cluster's stores can still refer to.
+#define BRANCH_HISTORY_COMPACTION_INTERVAL_MS     (60 * 60 * THOUSAND)
+
+
+// How many client queries (not counting the continuations of their streams) a server
+// runs at once, and how many more wait in line for their turn, on each of its query
+// ports.  They're split evenly among the threads.  See admission_controller_t.
+#define MAX_RUNNING_QUERIES_PER_NODE              1024
+#define MAX_WAITING_QUERIES_PER_NODE              4096
+// The least the latency-following limit on a thread's running queries goes down to.
+#define ADMISSION_MIN_RUNNING_QUERIES             4
+// Queries whose smoothed latency is more than this many times the lowest recent
+// latency mean the server is taking on more than it can handle.
+#define ADMISSION_LATENCY_TOLERANCE               2.0
+// How long a query waits in line before it's refused.
+#define ADMISSION_MAX_WAIT_MS                     2000
+
+// The biggest buffer a client connection keeps around for reading its queries into.
+// Bigger queries get a buffer of their own.
+#define MAX_REUSED_QUERY_BUFFER_SIZE              (4 * MEGABYTE)
 
 // Maximum number of threads we support
 // TODO: make this dynamic where possible
@@ -110,13 +331,123 @@
 // Ticks (in milliseconds) the internal timed tasks are performed at
 #define TIMER_TICKS_IN_MS                         5
 
+// Timers of at least this many milliseconds go in the timer handler's timing wheel
+// instead of its priority queue, and ring up to TIMER_WHEEL_TICK_MS late.
+#define TIMER_WHEEL_MIN_MS                        1000
+#define TIMER_WHEEL_TICK_MS                       50
+// The number of slots in the timing wheel, which goes around every
+// TIMER_WHEEL_SLOTS * TIMER_WHEEL_TICK_MS milliseconds.
+#define TIMER_WHEEL_SLOTS                         512
+
 // How many milliseconds to allow changes to sit in memory before flushing to disk
 #define DEFAULT_FLUSH_TIMER_MS                    1000
 
-// If non-null disk_ack_signals are present, concurrent flushing can be used to reduce the
-// latency of each single flush. max_concurrent_flushes controls how many flushes can be active
-// on a specific slice at any given time.
-#define DEFAULT_MAX_CONCURRENT_FLUSHES            1
+// How many of a page cache's flushes can be in flight at any given time.  A flush issues
+// its block writes and gets in line for the next index write while the previous flushes'
+// index writes are still being written.  Txns that become ready to flush while this many
+// are in flight all go into the next flush together.
+#define DEFAULT_MAX_CONCURRENT_FLUSHES            4
+
+// How often (in milliseconds) the cache balancer redistributes memory between the
+// page caches of the tables on a server, when a total cache size is given.
+#define CACHE_BALANCER_INTERVAL_MS                1000
+
+// The smallest memory limit the cache balancer gives any page cache, so that even a
+// table nobody has touched in a while can hold its btree's upper levels.
+#define CACHE_BALANCER_MIN_CACHE_SIZE             (8 * MEGABYTE)
+
+// The cache balancer shrinks the caches' total by CACHE_BALANCER_SHRINK_RATIO each
+// time it finds memory short: more than CACHE_BALANCER_HIGH_MEMORY_USAGE of the
+// process's (or its cgroup's) memory used, or tasks stalled waiting for memory more
+// than CACHE_BALANCER_MAX_MEMORY_PRESSURE percent of the time.  Once less than
+// CACHE_BALANCER_LOW_MEMORY_USAGE of it is used, the total grows back by
+// CACHE_BALANCER_GROW_RATIO of the cache size at a time.  It never shrinks below
+// CACHE_BALANCER_MIN_TOTAL_CACHE_SIZE.
+#define CACHE_BALANCER_HIGH_MEMORY_USAGE          0.9
+#define CACHE_BALANCER_LOW_MEMORY_USAGE           0.8
+#define CACHE_BALANCER_MAX_MEMORY_PRESSURE        10.0
+#define CACHE_BALANCER_SHRINK_RATIO               0.2
+#define CACHE_BALANCER_GROW_RATIO                 0.02
+#define CACHE_BALANCER_MIN_TOTAL_CACHE_SIZE       (64 * MEGABYTE)
+
+// A batch of blocks to prefetch is skipped if it would take up more than this
+// fraction (1/n) of the cache's memory limit.
+#define CACHE_PREFETCH_MAX_MEMORY_SHARE           4
+
+// How many children of an internal node a depth-first traversal (like a range read)
+// prefetches at a time, ahead of acquiring them one after the other.
+#define BTREE_TRAVERSAL_PREFETCH_WINDOW           16
+
+// A concurrent traversal that reads its whole range splits it into at most this
+// many subranges, which get traversed at the same time.  Each subrange's traversal
+// gets at most CONCURRENT_TRAVERSAL_SUBRANGE_LOOKAHEAD pairs ahead of the callback.
+#define CONCURRENT_TRAVERSAL_MAX_SUBRANGES        4
+#define CONCURRENT_TRAVERSAL_SUBRANGE_LOOKAHEAD   64
+
+// How many random leaves a sampled distribution read walks down to in each btree,
+// and how many buckets each of its histograms has.
+#define DISTRIBUTION_SAMPLE_LEAVES                128
+#define DISTRIBUTION_SAMPLE_BUCKETS               128
+
+// The most leaf routes a btree's routing cache remembers before it starts over.
+#define BTREE_ROUTING_CACHE_MAX_ROUTES            16384
+
+// Each btree counts one in HOT_KEYS_SAMPLE_INTERVAL of its key accesses (and of its
+// range reads) in a sketch of HOT_KEYS_TRACKED keys (and ranges), halves the counts
+// every HOT_KEYS_DECAY_SAMPLES samples, and reports the top HOT_KEYS_REPORTED of them
+// in its stats.
+#define HOT_KEYS_SAMPLE_INTERVAL                  16
+#define HOT_KEYS_TRACKED                          64
+#define HOT_KEYS_DECAY_SAMPLES                    8192
+#define HOT_KEYS_REPORTED                         10
+
+// A field name gets an id in its table's field dictionary once documents have been
+// written with it spelled out FIELD_DICTIONARY_PROMOTE_COUNT times, if it's at least
+// FIELD_DICTIONARY_MIN_NAME_SIZE (and at most FIELD_DICTIONARY_MAX_NAME_SIZE) bytes
+// long and the dictionary has fewer than FIELD_DICTIONARY_MAX_NAMES names.  At most
+// FIELD_DICTIONARY_MAX_CANDIDATES names are counted at once; the counts start over
+// when there are more, so that tables whose objects are keyed by data don't fill up
+// their dictionaries.
+#define FIELD_DICTIONARY_PROMOTE_COUNT            16
+#define FIELD_DICTIONARY_MIN_NAME_SIZE            4
+#define FIELD_DICTIONARY_MAX_NAME_SIZE            128
+#define FIELD_DICTIONARY_MAX_NAMES                4096
+#define FIELD_DICTIONARY_MAX_CANDIDATES           1024
+
+// Tables created with a `write_buffer_size` keep up to that many bytes of each
+// store's recent writes in a log (see btree_write_buffer_t) instead of writing them
+// to their leaf nodes one at a time.  Zero, the default, turns the buffer off.
+#define DEFAULT_WRITE_BUFFER_SIZE                 0
+#define MAX_WRITE_BUFFER_SIZE                     (64 * MEGABYTE)
+
+// How many bytes of recently read memcached values each thread keeps in front of its
+// btrees (0 turns the cache off), and the largest value it keeps.
+#define MEMCACHED_HOT_CACHE_SIZE                  (8 * MEGABYTE)
+#define MEMCACHED_HOT_CACHE_MAX_VALUE_SIZE        KILOBYTE
+
+// How much of a streamed HTTP response body is produced (and compressed) at a time
+#define HTTP_STREAMING_CHUNK_SIZE                 (64 * KILOBYTE)
+
+// How long (in milliseconds) a `?since=` request to the admin semilattice and
+// directory apps waits for a change before answering that there wasn't one, and how
+// many past versions of their roots they keep to compute deltas against.
+#define ADMIN_LONG_POLL_TIMEOUT_MS                (30 * THOUSAND)
+#define ADMIN_JSON_HISTORY_LENGTH                 32
+
+// How often (in milliseconds) the server collects a snapshot of its stats in the
+// background.  Stats requests are answered from the latest snapshot.
+#define PERFMON_SNAPSHOT_INTERVAL_MS              1000
+
+// How often (in milliseconds) a page cache with a warm-cache manifest records which
+// of its blocks are in memory, so that a restarted server can load them up front.
+#define WARM_MANIFEST_SAVE_INTERVAL_MS            (60 * THOUSAND)
+
+// The I/O priority with which the blocks of a warm-cache manifest are loaded, low
+// enough that the queries served in the meantime don't have to wait for them.
+#define WARM_MANIFEST_IO_PRIORITY                 (CACHE_READS_IO_PRIORITY / 8)
+
+// How many blocks of a warm-cache manifest are read at a time.
+#define WARM_MANIFEST_PREFETCH_BATCH_SIZE         64
 
 // How many times the page replacement algorithm tries to find an eligible page before giving up.
 // Note that (MAX_UNSAVED_DATA_LIMIT_FRACTION ** PAGE_REPL_NUM_TRIES) is the probability that the
@@ -124,6 +455,10 @@
 // then the page replacement algorithm will on average be unable to evict pages from the cache.
 #define PAGE_REPL_NUM_TRIES                       10
 
+// How many pages the alt cache's evicter samples to pick each victim.  More samples
+// approximate LRU more closely, but cost more per eviction.
+#define EVICTION_SAMPLE_SIZE                      5
+
 // How large can the key be, in bytes?  This value needs to fit in a byte.
 #define MAX_KEY_SIZE                              250
 
@@ -132,11 +467,30 @@
 // needs to fit in a byte.
 #define MAX_IN_NODE_VALUE_SIZE                    250
 
+// How big a blob reference (maxreflen) rdb tables keep their documents in by default,
+// and the most a table may choose when it's created (see `rdb_value_t`).  Documents
+// that fit in it stay in the leaf node, so a bigger one saves a block read per
+// document of a few hundred bytes, at the cost of fewer documents per leaf node.
+// The default has to be blob::btree_maxreflen.
+#define DEFAULT_INLINE_VALUE_SIZE                 251
+#define MAX_INLINE_VALUE_SIZE                     1024
+
 // memcached specifies the maximum value size to be 1MB, but customers asked this to be much higher
 #define MAX_VALUE_SIZE                            (10 * MEGABYTE)
 
-// Values larger than this will be streamed in a get operation
-#define MAX_BUFFERED_GET_SIZE                     MAX_VALUE_SIZE // streaming is too slow for now, so we disable it completely
+// Values at least this large are sent straight from the value's buffer instead of
+// being copied into the connection's write buffer.
+#define MAX_BUFFERED_GET_SIZE                     (64 * KILOBYTE)
+
+// Gets read values larger than this from the btree, and send them to the client, a
+// chunk this size at a time, so that the whole value is never in memory at once.
+#define MEMCACHED_STREAMING_CHUNK_SIZE            MEGABYTE
+
+// An rget reads its range (and sends it to the client) in batches, of this many
+// items at first, and then twice as many each time, up to the max.  Each batch is
+// also cut off at rget_max_chunk_size bytes.
+#define MEMCACHED_RGET_FIRST_BATCH_ITEMS          16
+#define MEMCACHED_RGET_MAX_BATCH_ITEMS            4096
 
 // If a single connection sends this many 'noreply' commands, the next command will
 // have to wait until the first one finishes
@@ -168,14 +522,47 @@
 // What's the definition of a "young" extent in microseconds?
 #define GC_YOUNG_EXTENT_TIMELIMIT_MICROS          50000
 
+// How many active extents the serializer spreads foreground writes over.  Writes made
+// through the same I/O account always go to the same one.
+#define SERIALIZER_FOREGROUND_WRITE_STREAMS       4
+
+// How often the GC recomputes the age-weighted priorities of the extents it
+// chooses from.
+#define GC_PRIORITY_REFRESH_MICROS                (1000 * 1000)
+
+// While there are foreground writes, a GC that isn't running at high priority writes
+// at most GC_NICE_BYTES_PER_FOREGROUND_BYTE bytes for each byte of foreground writes,
+// plus a burst of up to GC_NICE_MAX_WRITE_CREDIT bytes.  Foreground writes count as
+// having stopped after GC_FOREGROUND_IDLE_MICROS.  A throttled GC checks again every
+// GC_THROTTLE_RETRY_MS.
+#define GC_NICE_BYTES_PER_FOREGROUND_BYTE         1.0
+#define GC_NICE_MAX_WRITE_CREDIT                  (16 * MEGABYTE)
+#define GC_FOREGROUND_IDLE_MICROS                 (1000 * 1000)
+#define GC_THROTTLE_RETRY_MS                      50
+
 // If the size of the LBA on a given disk exceeds LBA_MIN_SIZE_FOR_GC, then the fraction of the
 // entries that are live and not garbage should be at least LBA_MIN_UNGARBAGE_FRACTION.
 #define LBA_MIN_SIZE_FOR_GC                       (MEGABYTE * 1)
 #define LBA_MIN_UNGARBAGE_FRACTION                0.5
 
+// Besides garbage collecting it, we also periodically rewrite a shard of the LBA once
+// LBA_CHECKPOINT_MIN_TAIL_FRACTION times as many entries as it has live blocks have been
+// appended since it was last rewritten, so that a restart does not have to replay a long
+// tail of superseded entries. We check for this every LBA_CHECKPOINT_INTERVAL_MS.
+#define LBA_CHECKPOINT_INTERVAL_MS                (10 * 60 * 1000)
+#define LBA_CHECKPOINT_MIN_TAIL_FRACTION          0.25
+
+// Compressed blocks this large (before compression) are inflated in the blocker pool
+// instead of on the serializer's thread.
+#define SERIALIZER_DECOMPRESSION_OFFLOAD_SIZE     (64 * KILOBYTE)
+
 // I/O priority for LBA garbage collection
 #define LBA_GC_IO_PRIORITY                        8
 
+// I/O priority for reading a serializer file for a backup (see
+// `log_serializer_t::backup()`)
+#define BACKUP_IO_PRIORITY                        8
+
 // How many block ids should the LBA garbage collector rewrite before yielding?
 #define LBA_GC_BATCH_SIZE                         (1024 * 8)
 
@@ -198,14 +585,43 @@
 // block infos.
 #define LBA_RECONSTRUCTION_BATCH_SIZE             1024
 
+// Serializer startups that take at least this long get their timings logged.
+#define SERIALIZER_STARTUP_LOG_THRESHOLD_SECS     1
+
 #define COROUTINE_STACK_SIZE                      131072
 
 // How many unused coroutine stacks to keep around (maximally), before they are
 // freed. This value is per thread.
 #define COROUTINE_FREE_LIST_SIZE                  64
 
+// Past `COROUTINE_FREE_LIST_SIZE`, unused stacks give their pages back to the kernel
+// and wait in a second free list of up to this many, so that a burst of coroutines
+// doesn't have to map them all again.  This value is per thread.
+#define COROUTINE_RELEASED_FREE_LIST_SIZE         1024
+
+// How much of the top of an unused stack keeps its pages when the rest are given back.
+#define COROUTINE_STACK_RETAINED_SIZE             16384
+
 #define MAX_COROS_PER_THREAD                      10000
 
+// While the coroutine wait profiler is on, it times one in every this many
+// `coro_t::wait()`s on each thread (see `coro_wait_profiler_t`).
+#define CORO_WAIT_PROFILER_SAMPLE_INTERVAL        32
+
+// An elastic `coro_pool_t` reconsiders its size every CORO_POOL_SIZER_INTERVAL_MS.  It
+// keeps a bigger size only if that got at least CORO_POOL_SIZER_MIN_GAIN more work
+// done per second, and after one that didn't it waits CORO_POOL_SIZER_HOLD_INTERVALS
+// intervals before growing again (see `coro_pool_sizer_t`).
+#define CORO_POOL_SIZER_INTERVAL_MS               100
+#define CORO_POOL_SIZER_MIN_GAIN                  0.05
+#define CORO_POOL_SIZER_HOLD_INTERVALS            50
+
+// The slab allocator (see arch/runtime/slab_allocator.hpp) gets memory from the system
+// SLAB_SIZE bytes at a time, aligned to SLAB_SIZE, and only for objects of at most
+// SLAB_MAX_OBJECT_SIZE bytes.
+#define SLAB_SIZE                                 (64 * KILOBYTE)
+#define SLAB_MAX_OBJECT_SIZE                      256
+
 
 // Size of a cache line (used in cache_line_padded_t).
 #define CACHE_LINE_SIZE                           64
@@ -216,6 +632,10 @@
 // that the event we are waiting for has occurred in the meantime.
 #define REACTOR_RUN_UNTIL_SATISFIED_NAP           100
 
+// How often (in ms) primaries and up-to-date secondaries publish the timestamp
+// they've reached in the directory, for reads with bounded staleness.
+#define REACTOR_PUBLISH_TIMESTAMP_INTERVAL        1000
+
 
 /**
  * Message scheduler configuration
@@ -254,6 +674,7 @@
 #define CORO_PRIORITY_REACTOR                   (-1)
 #define CORO_PRIORITY_DIRECTORY_CHANGES         (-2)
 #define CORO_PRIORITY_LBA_GC                    (-2)
+#define CORO_PRIORITY_BATCH_QUERY               (-1)
 
 
 #endif  // CONFIG_ARGS_HPP_
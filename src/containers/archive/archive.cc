@@ -62,9 +62,11 @@ write_message_t::~write_message_t() {
     }
 }
 
-void write_message_t::append(const void *p, int64_t n) {
+void write_message_t::append_slow(const void *p, int64_t n) {
     while (n > 0) {
-        if (buffers_.empty() || buffers_.tail()->size == write_buffer_t::DATA_SIZE) {
+        if (buffers_.empty()
+            || buffers_.tail()->size == write_buffer_t::DATA_SIZE
+            || buffers_.tail()->external.has()) {
             buffers_.push_back(new write_buffer_t);
         }
 
@@ -78,26 +80,48 @@ void write_message_t::append(const void *p, int64_t n) {
     }
 }
 
+void write_message_t::append_buffer(const counted_t<data_buffer_t> &buf) {
+    // Copying small buffers is cheaper than giving them a `write_buffer_t` each
+    if (buf->size() < write_buffer_t::DATA_SIZE) {
+        append(buf->buf(), buf->size());
+    } else {
+        write_buffer_t *b = new write_buffer_t;
+        b->external = buf;
+        buffers_.push_back(b);
+    }
+}
+
 size_t write_message_t::size() const {
     size_t ret = 0;
     for (write_buffer_t *h = buffers_.head(); h != NULL; h = buffers_.next(h)) {
-        ret += h->size;
+        ret += h->get_size();
     }
     return ret;
 }
 
 int send_write_message(write_stream_t *s, const write_message_t *msg) {
     intrusive_list_t<write_buffer_t> *list = const_cast<write_message_t *>(msg)->unsafe_expose_buffers();
+    // Special case to pass large buffers on without copying them
+    write_message_stream_t *message_stream = dynamic_cast<write_message_stream_t *>(s);
     for (write_buffer_t *p = list->head(); p; p = list->next(p)) {
-        int64_t res = s->write(p->data, p->size);
+        if (message_stream != NULL && p->external.has()) {
+            message_stream->message()->append_buffer(p->external);
+            continue;
+        }
+        int64_t res = s->write(p->get_data(), p->get_size());
         if (res == -1) {
             return -1;
         }
-        rassert(res == p->size);
+        rassert(res == p->get_size());
     }
     return 0;
 }
 
+int64_t write_message_stream_t::write(const void *p, int64_t n) {
+    msg_.append(p, n);
+    return n;
+}
+
 write_message_t &operator<<(write_message_t &msg, const uuid_u &uuid) {
     rassert(!uuid.is_unset());
     msg.append(uuid.data(), uuid_u::static_size());
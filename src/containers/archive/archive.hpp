@@ -3,7 +3,9 @@
 #define CONTAINERS_ARCHIVE_ARCHIVE_HPP_
 
 #include <stdint.h>
+#include <string.h>
 
+#include "containers/data_buffer.hpp"
 #include "containers/intrusive_list.hpp"
 #include "utils.hpp"
 
@@ -85,10 +87,17 @@ class write_buffer_t : public intrusive_list_node_t<write_buffer_t> {
 public:
     write_buffer_t() : size(0) { }
 
+    /* Use these rather than `data` and `size`, which are unused when the buffer
+    refers to an `external` one. */
+    const char *get_data() const { return external.has() ? external->buf() : data; }
+    int64_t get_size() const { return external.has() ? external->size() : size; }
+
     static const int DATA_SIZE = 4096;
     int size;
     char data[DATA_SIZE];
 
+    counted_t<data_buffer_t> external;
+
 private:
     DISABLE_COPYING(write_buffer_t);
 };
@@ -96,15 +105,29 @@ private:
 // A set of buffers in which an atomic message to be sent on a stream
 // gets built up.  (This way we don't flush after the first four bytes
 // sent to a stream, or buffer things and then forget to manually
-// flush.  This type can be extended to support holding references to
-// large buffers, to save copying.)  Generally speaking, you serialize
-// to a write_message_t, and then flush that to a write_stream_t.
+// flush.)  It can also hold references to large buffers, to save
+// copying them.  Generally speaking, you serialize to a
+// write_message_t, and then flush that to a write_stream_t.
 class write_message_t {
 public:
     write_message_t() { }
     ~write_message_t();
 
-    void append(const void *p, int64_t n);
+    void append(const void *p, int64_t n) {
+        // Most appends are single fields that fit in the last buffer, so that
+        // case is inline and the rest is left to `append_slow()`.
+        write_buffer_t *b = buffers_.tail();
+        if (b != NULL && !b->external.has() && n <= write_buffer_t::DATA_SIZE - b->size) {
+            memcpy(b->data + b->size, p, n);
+            b->size += n;
+        } else {
+            append_slow(p, n);
+        }
+    }
+
+    // Like `append(buf->buf(), buf->size())`, but large buffers are referred
+    // to rather than copied, so `buf` mustn't change until the message is gone.
+    void append_buffer(const counted_t<data_buffer_t> &buf);
 
     size_t size() const;
 
@@ -118,6 +141,8 @@ public:
 private:
     friend int send_write_message(write_stream_t *s, const write_message_t *msg);
 
+    void append_slow(const void *p, int64_t n);
+
     intrusive_list_t<write_buffer_t> buffers_;
 
     DISABLE_COPYING(write_message_t);
@@ -132,6 +157,25 @@ write_message_t &operator<<(write_message_t& msg, const T &x) {
 // Returns 0 upon success, -1 upon failure.
 MUST_USE int send_write_message(write_stream_t *s, const write_message_t *msg);
 
+// Collects what's written to it in a `write_message_t`. `send_write_message()`
+// passes references to large buffers on to it instead of copying them, so a
+// message can go through a `send_message_write_callback_t` and still be sent
+// with `writev()` straight from the buffers it was built from.
+class write_message_stream_t : public write_stream_t {
+public:
+    write_message_stream_t() { }
+    virtual ~write_message_stream_t() { }
+
+    virtual MUST_USE int64_t write(const void *p, int64_t n);
+
+    write_message_t *message() { return &msg_; }
+
+private:
+    write_message_t msg_;
+
+    DISABLE_COPYING(write_message_stream_t);
+};
+
 template <class T>
 T *deserialize_deref(T &val) {  // NOLINT(runtime/references)
     return &val;
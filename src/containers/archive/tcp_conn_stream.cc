@@ -39,6 +39,40 @@ int64_t tcp_conn_stream_t::write(const void *p, int64_t n) {
     }
 }
 
+int64_t tcp_conn_stream_t::writev(const iovec *bufs, size_t count) {
+    int64_t n = 0;
+    for (size_t i = 0; i < count; ++i) {
+        n += bufs[i].iov_len;
+    }
+    try {
+        cond_t non_closer;
+        conn_->writev(bufs, count, &non_closer);
+        return n;
+    } catch (const tcp_conn_write_closed_exc_t &) {
+        return -1;
+    }
+}
+
+int64_t tcp_conn_stream_t::write_buffered(const void *p, int64_t n) {
+    try {
+        cond_t non_closer;
+        conn_->write_buffered(p, n, &non_closer);
+        return n;
+    } catch (const tcp_conn_write_closed_exc_t &) {
+        return -1;
+    }
+}
+
+int tcp_conn_stream_t::flush_buffer() {
+    try {
+        cond_t non_closer;
+        conn_->flush_buffer(&non_closer);
+        return 0;
+    } catch (const tcp_conn_write_closed_exc_t &) {
+        return -1;
+    }
+}
+
 void tcp_conn_stream_t::rethread(threadnum_t new_thread) {
     conn_->rethread(new_thread);
 }
@@ -98,6 +132,22 @@ int64_t keepalive_tcp_conn_stream_t::write(const void *p, int64_t n) {
     return tcp_conn_stream_t::write(p, n);
 }
 
+int64_t keepalive_tcp_conn_stream_t::writev(const iovec *bufs, size_t count) {
+    if (keepalive_callback != NULL) {
+        keepalive_callback->keepalive_write();
+    }
+
+    return tcp_conn_stream_t::writev(bufs, count);
+}
+
+int64_t keepalive_tcp_conn_stream_t::write_buffered(const void *p, int64_t n) {
+    if (keepalive_callback != NULL) {
+        keepalive_callback->keepalive_write();
+    }
+
+    return tcp_conn_stream_t::write_buffered(p, n);
+}
+
 rethread_tcp_conn_stream_t::rethread_tcp_conn_stream_t(tcp_conn_stream_t *conn, threadnum_t thread)
     : conn_(conn), old_thread_(conn->home_thread()), new_thread_(thread) {
     conn->rethread(thread);
@@ -7,6 +7,7 @@
 #include "arch/types.hpp"
 
 class signal_t;
+struct iovec;
 
 class tcp_conn_stream_t : public read_stream_t, public write_stream_t {
 public:
@@ -19,6 +20,17 @@ public:
     virtual MUST_USE int64_t read(void *p, int64_t n);
     virtual MUST_USE int64_t write(const void *p, int64_t n);
 
+    // Writes the `count` buffers in `bufs` one after another. Returns the total
+    // size written, or -1 if the connection was closed.
+    virtual MUST_USE int64_t writev(const iovec *bufs, size_t count);
+
+    // Like `write()`, but the data may sit in the connection's buffer until
+    // `flush_buffer()` or one of the other writes is called.
+    virtual MUST_USE int64_t write_buffered(const void *p, int64_t n);
+    // Returns 0 once the buffered data has been sent, or -1 if the connection
+    // was closed.
+    MUST_USE int flush_buffer();
+
     void rethread(threadnum_t new_thread);
 
     threadnum_t home_thread() const;
@@ -57,6 +69,8 @@ public:
 
     virtual MUST_USE int64_t read(void *p, int64_t n);
     virtual MUST_USE int64_t write(const void *p, int64_t n);
+    virtual MUST_USE int64_t writev(const iovec *bufs, size_t count);
+    virtual MUST_USE int64_t write_buffered(const void *p, int64_t n);
 
 private:
     keepalive_callback_t *keepalive_callback;
@@ -79,7 +79,9 @@ void cow_ptr_t<T>::set(const T &new_value) {
 template <class T>
 bool cow_ptr_t<T>::operator==(const cow_ptr_t<T> &other) const {
     guarantee(ptr.has() && other.ptr.has());
-    return *ptr == *other.ptr;
+    /* Copies share their `T`, and sharing is kept up on purpose in places like
+    the directory so that this is cheap when nothing changed */
+    return ptr.get() == other.ptr.get() || *ptr == *other.ptr;
 }
 
 template <class T>
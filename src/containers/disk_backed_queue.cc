@@ -1,14 +1,30 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "containers/disk_backed_queue.hpp"
 
+#include <algorithm>
+
+#include "arch/arch.hpp"
 #include "arch/io/disk.hpp"
-#include "buffer_cache/alt/alt.hpp"
-#include "buffer_cache/alt/blob.hpp"
-#include "buffer_cache/alt/alt_serialize_onto_blob.hpp"
 #include "serializer/config.hpp"
 
+// How much of the queue is written or read at a time.  It has to be a multiple of
+// `DEVICE_BLOCK_SIZE`.
+#define DBQ_CHUNK_SIZE MEGABYTE
+
+class internal_disk_backed_queue_t::append_stream_t : public write_stream_t {
+public:
+    explicit append_stream_t(internal_disk_backed_queue_t *_parent) : parent(_parent) { }
+
+    int64_t write(const void *p, int64_t n) {
+        parent->append(static_cast<const char *>(p), n);
+        return n;
+    }
+
+private:
+    internal_disk_backed_queue_t *parent;
 
-#define DBQ_MAX_REF_SIZE 251
+    DISABLE_COPYING(append_stream_t);
+};
 
 internal_disk_backed_queue_t::internal_disk_backed_queue_t(io_backender_t *io_backender,
                                                            const serializer_filepath_t &filename,
@@ -16,34 +32,17 @@ internal_disk_backed_queue_t::internal_disk_backed_queue_t(io_backender_t *io_ba
     : perfmon_membership(stats_parent, &perfmon_collection,
                          filename.permanent_path().c_str()),
       queue_size(0),
-      head_block_id(NULL_BLOCK_ID),
-      tail_block_id(NULL_BLOCK_ID) {
+      file_end(0),
+      write_buffer(malloc_aligned(DBQ_CHUNK_SIZE, DEVICE_BLOCK_SIZE)),
+      write_buffer_used(0),
+      read_buffer_offset(-1),
+      read_offset(0) {
     filepath_file_opener_t file_opener(filename, io_backender);
-    standard_serializer_t::create(&file_opener,
-                                  standard_serializer_t::static_config_t());
-
-    serializer.init(new standard_serializer_t(standard_serializer_t::dynamic_config_t(),
-                                              &file_opener,
-                                              &perfmon_collection));
+    file_opener.open_serializer_file_create_temporary(&file);
 
     /* Remove the file we just created from the filesystem, so that it will
-       get deleted as soon as the serializer is destroyed or if the process
-       crashes. */
+       get deleted as soon as we close it or if the process crashes. */
     file_opener.unlink_serializer_file();
-
-    alt_cache_config_t cache_dynamic_config;
-    cache_dynamic_config.page_config.memory_limit = MEGABYTE;
-    cache.init(new cache_t(serializer.get(), cache_dynamic_config,
-                           &perfmon_collection));
-    cache_conn.init(new cache_conn_t(cache.get()));
-    // Emulate cache_t::create behavior by zeroing the block with id SUPERBLOCK_ID.
-    txn_t txn(cache_conn.get(), write_durability_t::HARD,
-              repli_timestamp_t::distant_past, 1);
-    buf_lock_t block(&txn, SUPERBLOCK_ID, alt_create_t::create);
-    buf_write_t write(&block);
-    const block_size_t block_size = cache->max_block_size();
-    void *buf = write.get_data_write(block_size.value());
-    memset(buf, 0, block_size.value());
 }
 
 internal_disk_backed_queue_t::~internal_disk_backed_queue_t() { }
@@ -51,41 +50,11 @@ internal_disk_backed_queue_t::~internal_disk_backed_queue_t() { }
 void internal_disk_backed_queue_t::push(const write_message_t &wm) {
     mutex_t::acq_t mutex_acq(&mutex);
 
-    // There's no need for hard durability with an unlinked dbq file.
-    txn_t txn(cache_conn.get(), write_durability_t::SOFT,
-              repli_timestamp_t::distant_past, 2);
-
-    if (head_block_id == NULL_BLOCK_ID) {
-        add_block_to_head(&txn);
-    }
-
-    auto _head = make_scoped<buf_lock_t>(buf_parent_t(&txn), head_block_id,
-                                         access_t::write);
-    auto write = make_scoped<buf_write_t>(_head.get());
-    queue_block_t *head = static_cast<queue_block_t *>(write->get_data_write());
-
-    char buffer[DBQ_MAX_REF_SIZE];
-    memset(buffer, 0, DBQ_MAX_REF_SIZE);
-
-    blob_t blob(cache->max_block_size(), buffer, DBQ_MAX_REF_SIZE);
-
-    write_onto_blob(buf_parent_t(_head.get()), &blob, wm);
-
-    if (static_cast<size_t>((head->data + head->data_size) - reinterpret_cast<char *>(head)) + blob.refsize(cache->max_block_size()) > cache->max_block_size().value()) {
-        // The data won't fit in our current head block, so it's time to make a new one.
-        head = NULL;
-        write.reset();
-        _head.reset();
-        add_block_to_head(&txn);
-        _head.init(new buf_lock_t(buf_parent_t(&txn), head_block_id,
-                                  access_t::write));
-        write.init(new buf_write_t(_head.get()));
-        head = static_cast<queue_block_t *>(write->get_data_write());
-    }
-
-    memcpy(head->data + head->data_size, buffer,
-           blob.refsize(cache->max_block_size()));
-    head->data_size += blob.refsize(cache->max_block_size());
+    const uint32_t value_size = wm.size();
+    append(reinterpret_cast<const char *>(&value_size), sizeof(value_size));
+    append_stream_t stream(this);
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
 
     queue_size++;
 }
@@ -94,59 +63,35 @@ void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
     guarantee(size() != 0);
     mutex_t::acq_t mutex_acq(&mutex);
 
-    char buffer[DBQ_MAX_REF_SIZE];
-    // No need for hard durability with an unlinked dbq file.
-    txn_t txn(cache_conn.get(), write_durability_t::SOFT,
-              repli_timestamp_t::distant_past, 2);
-
-    buf_lock_t _tail(buf_parent_t(&txn), tail_block_id, access_t::write);
-
-    /* Grab the data from the blob and delete it. */
-    {
-        buf_read_t read(&_tail);
-        const queue_block_t *tail
-            = static_cast<const queue_block_t *>(read.get_data_read());
-        rassert(tail->data_size != tail->live_data_offset);
-        memcpy(buffer, tail->data + tail->live_data_offset,
-               blob::ref_size(cache->max_block_size(),
-                              tail->data + tail->live_data_offset,
-                              DBQ_MAX_REF_SIZE));
+    uint32_t value_size;
+    read(read_offset, sizeof(value_size), reinterpret_cast<char *>(&value_size));
+    read_offset += sizeof(value_size);
+
+    /* Most values are viewed right where they are, but a value that's split
+    between chunks is copied out first. */
+    const char *data = find_in_memory(read_offset, value_size);
+    scoped_array_t<char> copy;
+    if (data == NULL) {
+        copy.init(value_size);
+        read(read_offset, value_size, copy.data());
+        data = copy.data();
     }
+    read_offset += value_size;
 
-    /* Grab the data from the blob and delete it. */
-
-    std::vector<char> data_vec;
-
-    blob_t blob(cache->max_block_size(), buffer, DBQ_MAX_REF_SIZE);
-    {
-        blob_acq_t acq_group;
-        buffer_group_t blob_group;
-        blob.expose_all(buf_parent_t(&_tail), access_t::read,
-                        &blob_group, &acq_group);
-
-        viewer->view_buffer_group(const_view(&blob_group));
-    }
-
-    int32_t data_size;
-    int32_t live_data_offset;
-    {
-        buf_write_t write(&_tail);
-        queue_block_t *tail = static_cast<queue_block_t *>(write.get_data_write());
-        /* Record how far along in the blob we are. */
-        tail->live_data_offset += blob.refsize(cache->max_block_size());
-        data_size = tail->data_size;
-        live_data_offset = tail->live_data_offset;
-    }
-
-    blob.clear(buf_parent_t(&_tail));
+    const_buffer_group_t group;
+    group.add_buffer(value_size, data);
+    viewer->view_buffer_group(&group);
 
     queue_size--;
 
-    _tail.reset_buf_lock();
-
-    /* If that was the last blob in this block move on to the next one. */
-    if (live_data_offset == data_size) {
-        remove_block_from_tail(&txn);
+    /* Once the queue has emptied out, start again from the beginning of the
+    file instead of making it any longer. */
+    if (queue_size == 0) {
+        rassert(read_offset == file_end + static_cast<int64_t>(write_buffer_used));
+        file_end = 0;
+        write_buffer_used = 0;
+        read_buffer_offset = -1;
+        read_offset = 0;
     }
 }
 
@@ -158,46 +103,61 @@ int64_t internal_disk_backed_queue_t::size() {
     return queue_size;
 }
 
-void internal_disk_backed_queue_t::add_block_to_head(txn_t *txn) {
-    buf_lock_t _new_head(buf_parent_t(txn), alt_create_t::create);
-    buf_write_t write(&_new_head);
-    queue_block_t *new_head = static_cast<queue_block_t *>(write.get_data_write());
-    if (head_block_id == NULL_BLOCK_ID) {
-        rassert(tail_block_id == NULL_BLOCK_ID);
-        head_block_id = tail_block_id = _new_head.block_id();
-    } else {
-        buf_lock_t _old_head(buf_parent_t(txn), head_block_id,
-                             access_t::write);
-        buf_write_t old_write(&_old_head);
-        queue_block_t *old_head
-            = static_cast<queue_block_t *>(old_write.get_data_write());
-        rassert(old_head->next == NULL_BLOCK_ID);
-        old_head->next = _new_head.block_id();
-        head_block_id = _new_head.block_id();
+void internal_disk_backed_queue_t::append(const char *data, size_t size) {
+    while (size > 0) {
+        const size_t n = std::min<size_t>(size, DBQ_CHUNK_SIZE - write_buffer_used);
+        memcpy(write_buffer.get() + write_buffer_used, data, n);
+        write_buffer_used += n;
+        data += n;
+        size -= n;
+        if (write_buffer_used == DBQ_CHUNK_SIZE) {
+            flush_write_buffer();
+        }
     }
-
-    new_head->next = NULL_BLOCK_ID;
-    new_head->data_size = 0;
-    new_head->live_data_offset = 0;
 }
 
-void internal_disk_backed_queue_t::remove_block_from_tail(txn_t *txn) {
-    rassert(tail_block_id != NULL_BLOCK_ID);
-    buf_lock_t _old_tail(buf_parent_t(txn), tail_block_id,
-                         access_t::write);
+void internal_disk_backed_queue_t::flush_write_buffer() {
+    rassert(write_buffer_used == DBQ_CHUNK_SIZE);
+    file->set_size_at_least(file_end + DBQ_CHUNK_SIZE);
+    // There's no need for datasyncs with an unlinked dbq file.
+    co_write(file.get(), file_end, DBQ_CHUNK_SIZE, write_buffer.get(),
+             DEFAULT_DISK_ACCOUNT, file_t::NO_DATASYNCS);
+    file_end += DBQ_CHUNK_SIZE;
+    write_buffer_used = 0;
+}
 
-    {
-        buf_write_t old_write(&_old_tail);
-        queue_block_t *old_tail = static_cast<queue_block_t *>(old_write.get_data_write());
+const char *internal_disk_backed_queue_t::find_in_memory(int64_t offset, size_t size) {
+    if (offset >= file_end) {
+        rassert(offset - file_end + size <= write_buffer_used);
+        return write_buffer.get() + (offset - file_end);
+    }
+    if (read_buffer_offset != -1 && offset >= read_buffer_offset
+        && offset + static_cast<int64_t>(size) <= read_buffer_offset + DBQ_CHUNK_SIZE) {
+        return read_buffer.get() + (offset - read_buffer_offset);
+    }
+    return NULL;
+}
 
-        if (old_tail->next == NULL_BLOCK_ID) {
-            rassert(head_block_id == _old_tail.block_id());
-            tail_block_id = head_block_id = NULL_BLOCK_ID;
-        } else {
-            tail_block_id = old_tail->next;
+void internal_disk_backed_queue_t::read(int64_t offset, size_t size, char *out) {
+    while (size > 0) {
+        if (offset >= file_end) {
+            rassert(offset - file_end + size <= write_buffer_used);
+            memcpy(out, write_buffer.get() + (offset - file_end), size);
+            return;
+        }
+        const int64_t chunk_offset = offset - offset % DBQ_CHUNK_SIZE;
+        if (read_buffer_offset != chunk_offset) {
+            if (!read_buffer.has()) {
+                read_buffer.init(malloc_aligned(DBQ_CHUNK_SIZE, DEVICE_BLOCK_SIZE));
+            }
+            co_read(file.get(), chunk_offset, DBQ_CHUNK_SIZE, read_buffer.get(),
+                    DEFAULT_DISK_ACCOUNT);
+            read_buffer_offset = chunk_offset;
         }
+        const size_t n = std::min<size_t>(size, chunk_offset + DBQ_CHUNK_SIZE - offset);
+        memcpy(out, read_buffer.get() + (offset - chunk_offset), n);
+        out += n;
+        offset += n;
+        size -= n;
     }
-
-    _old_tail.mark_deleted();
 }
-
@@ -14,20 +14,10 @@
 #include "perfmon/core.hpp"
 #include "serializer/types.hpp"
 
-class cache_conn_t;
-class cache_t;
-class txn_t;
+class file_t;
 class io_backender_t;
 class perfmon_collection_t;
 
-struct queue_block_t {
-    block_id_t next;
-    int32_t data_size, live_data_offset;
-    char data[0];
-} __attribute__((__packed__));
-
-class value_acquisition_object_t;
-
 class buffer_group_viewer_t {
 public:
     virtual void view_buffer_group(const const_buffer_group_t *group) = 0;
@@ -39,6 +29,12 @@ protected:
     DISABLE_COPYING(buffer_group_viewer_t);
 };
 
+/* The queue is kept in a file of its own, which nothing else ever reads.  It's
+just the pushed values one after the other, each preceded by its size, so
+there's no need for a serializer or a cache: pushes fill an in-memory buffer
+that gets written out in one go when it's full, and pops read the file back in
+chunks of the same size.  Values that haven't been written out yet are popped
+straight from the buffer. */
 class internal_disk_backed_queue_t {
 public:
     internal_disk_backed_queue_t(io_backender_t *io_backender, const serializer_filepath_t& filename, perfmon_collection_t *stats_parent);
@@ -55,25 +51,36 @@ public:
     int64_t size();
 
 private:
-    void add_block_to_head(txn_t *txn);
-    void remove_block_from_tail(txn_t *txn);
+    class append_stream_t;
+
+    void append(const char *data, size_t size);
+    void flush_write_buffer();
+    // Returns a pointer to `size` bytes at `offset` if they're all in memory in
+    // one piece, or NULL.
+    const char *find_in_memory(int64_t offset, size_t size);
+    void read(int64_t offset, size_t size, char *out);
 
     mutex_t mutex;
 
-    // Serves more as sanity-checking for the cache than this type's ordering.
-    order_source_t cache_order_source;
     perfmon_collection_t perfmon_collection;
     perfmon_membership_t perfmon_membership;
 
     int64_t queue_size;
 
-    // The end we push onto.
-    block_id_t head_block_id;
-    // The end we pop from.
-    block_id_t tail_block_id;
-    scoped_ptr_t<standard_serializer_t> serializer;
-    scoped_ptr_t<cache_t> cache;
-    scoped_ptr_t<cache_conn_t> cache_conn;
+    scoped_ptr_t<file_t> file;
+
+    // Everything before `file_end` has been written to the file, and the next
+    // `write_buffer_used` bytes are in `write_buffer`.
+    int64_t file_end;
+    scoped_malloc_t<char> write_buffer;
+    size_t write_buffer_used;
+
+    // The chunk of the file last read, or nothing if `read_buffer_offset` is -1.
+    scoped_malloc_t<char> read_buffer;
+    int64_t read_buffer_offset;
+
+    // Where the next value to pop starts.
+    int64_t read_offset;
 
     DISABLE_COPYING(internal_disk_backed_queue_t);
 };
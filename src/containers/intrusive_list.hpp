@@ -111,6 +111,13 @@ public:
         ++size_;
     }
 
+    // Inserts `node` just before `successor`, which must be in the list.
+    void insert_before(T *node, T *successor) {
+        intrusive_list_node_t<T> *after = successor;
+        insert_between(node, after->prev_, after);
+        ++size_;
+    }
+
     void remove(T *value) {
         intrusive_list_node_t<T> *node = value;
         guarantee(node->in_a_list());
@@ -97,6 +97,38 @@ uuid_u generate_uuid() {
     return result;
 }
 
+TLS_with_init(uint64_t, last_time_ordered_uuid_ms, 0);
+TLS_with_init(uint16_t, time_ordered_uuid_counter, 0);
+
+uuid_u generate_time_ordered_uuid() {
+    // The random bits come from an ordinary uuid.
+    uuid_u result = generate_uuid();
+
+    uint64_t ms = current_microtime() / 1000;
+    uint16_t counter = 0;
+    const uint64_t last_ms = TLS_get_last_time_ordered_uuid_ms();
+    if (ms <= last_ms) {
+        // The clock hasn't moved (or went back), so count up from the last id.
+        ms = last_ms;
+        counter = TLS_get_time_ordered_uuid_counter() + 1;
+        if (counter > 0x0fff) {
+            ++ms;
+            counter = 0;
+        }
+    }
+    TLS_set_last_time_ordered_uuid_ms(ms);
+    TLS_set_time_ordered_uuid_counter(counter);
+
+    uint8_t *data = result.data();
+    for (int i = 0; i < 6; ++i) {
+        data[i] = static_cast<uint8_t>(ms >> (8 * (5 - i)));
+    }
+    data[6] = 0x70 | static_cast<uint8_t>(counter >> 8);
+    data[7] = static_cast<uint8_t>(counter);
+    // generate_uuid already set the variant bits in data[8].
+    return result;
+}
+
 uuid_u nil_uuid() {
     uuid_u ret;
     memset(ret.data(), 0, uuid_u::static_size());
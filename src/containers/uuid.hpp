@@ -44,6 +44,12 @@ bool operator<(const uuid_u& x, const uuid_u& y);
 Valgrind won't complain about it. */
 uuid_u generate_uuid();
 
+/* A random uuid whose first 48 bits are the time in milliseconds (and the next 12 a
+counter for ids generated in the same millisecond on this thread), so that ids
+generated one after another sort one after another.  (It's shaped like a version 7
+uuid.) */
+uuid_u generate_time_ordered_uuid();
+
 // Returns boost::uuids::nil_generator()().
 uuid_u nil_uuid();
 
@@ -15,7 +15,7 @@ extproc_job_t::extproc_job_t(extproc_pool_t *_pool,
         combined_interruptor.add(user_interruptor);
     }
 
-    worker_lock.create(pool->get_worker_semaphore(), &combined_interruptor);
+    worker_lock.create(pool, &combined_interruptor);
 
     try {
         worker_lock.get()->get_value()->acquired(&combined_interruptor);
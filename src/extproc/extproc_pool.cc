@@ -1,11 +1,43 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "extproc/extproc_pool.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "arch/runtime/coro_wait_profiler.hpp"
 #include "extproc/extproc_spawner.hpp"
 
 extproc_pool_t::extproc_pool_t(size_t worker_count) :
     ct_interruptors(&interruptor),
-    worker_semaphore(worker_count,
-                     extproc_spawner_t::get_instance()) { }
+    sub_pools(std::max<size_t>(std::min<size_t>(worker_count, get_num_threads()), 1)),
+    queue_wait(secs_to_ticks(1)),
+    queue_wait_membership(&get_global_perfmon_collection(), &queue_wait,
+                          "extproc_queue_wait")
+{
+    // Spread the workers evenly, the first sub-pools get one extra if it doesn't divide
+    for (size_t i = 0; i < sub_pools.size(); ++i) {
+        size_t count = worker_count / sub_pools.size()
+            + (i < worker_count % sub_pools.size() ? 1 : 0);
+        sub_pools[i].init(new cross_thread_semaphore_t<extproc_worker_t>(
+            count, extproc_spawner_t::get_instance()));
+    }
+
+    // Start all the worker processes now, so the first jobs don't pay for it
+    for (size_t i = 0; i < sub_pools.size(); ++i) {
+        std::vector<scoped_ptr_t<cross_thread_semaphore_t<extproc_worker_t>::lock_t> >
+            locks;
+        for (;;) {
+            scoped_ptr_t<cross_thread_semaphore_t<extproc_worker_t>::lock_t> lock(
+                new cross_thread_semaphore_t<extproc_worker_t>::lock_t(
+                    sub_pools[i].get()));
+            if (lock->get_value() == NULL) {
+                break;
+            }
+            lock->get_value()->warm_up();
+            locks.push_back(std::move(lock));
+        }
+    }
+}
 
 extproc_pool_t::~extproc_pool_t() {
     // Can only be destructed on the same thread we were created on
@@ -15,14 +47,35 @@ extproc_pool_t::~extproc_pool_t() {
     interruptor.pulse();
 }
 
-cross_thread_semaphore_t<extproc_worker_t> *extproc_pool_t::get_worker_semaphore() {
-    return &worker_semaphore;
-}
-
 signal_t *extproc_pool_t::get_shutdown_signal() {
     return ct_interruptors.get();
 }
 
+extproc_pool_t::worker_lock_t::worker_lock_t(extproc_pool_t *pool,
+                                             signal_t *interruptor) {
+    block_pm_duration wait_timer(&pool->queue_wait);
+    coro_wait_site_t wait_site("extproc queue");
+
+    const size_t home = get_thread_id().threadnum % pool->sub_pools.size();
+    for (size_t i = 0; i < pool->sub_pools.size(); ++i) {
+        lock.init(new cross_thread_semaphore_t<extproc_worker_t>::lock_t(
+            pool->sub_pools[(home + i) % pool->sub_pools.size()].get()));
+        if (lock->get_value() != NULL) {
+            return;
+        }
+        lock.reset();
+    }
+
+    lock.init(new cross_thread_semaphore_t<extproc_worker_t>::lock_t(
+        pool->sub_pools[home].get(), interruptor));
+}
+
+extproc_pool_t::worker_lock_t::~worker_lock_t() { }
+
+extproc_worker_t *extproc_pool_t::worker_lock_t::get_value() {
+    return lock->get_value();
+}
+
 extproc_pool_t::ct_interruptors_t::ct_interruptors_t(signal_t *shutdown_signal) :
     ct_signals(get_num_threads())
 {
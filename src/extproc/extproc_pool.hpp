@@ -8,6 +8,7 @@
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/cross_thread_semaphore.hpp"
 #include "extproc/extproc_worker.hpp"
+#include "perfmon/perfmon.hpp"
 
 // Extproc pool is used to acquire and release workers from any thread,
 //  must be created from within the thread pool
@@ -20,8 +21,21 @@ public:
     //  destroyed, make sure to combine with any other interruptors or shutdown may hang
     signal_t *get_shutdown_signal();
 
-    // Get the semaphore of workers to obtain a lock (may be done from any thread)
-    cross_thread_semaphore_t<extproc_worker_t> *get_worker_semaphore();
+    // Obtains a worker (may be done from any thread).  The workers are split into
+    //  sub-pools by thread, so a thread first tries its own sub-pool, then takes an
+    //  idle worker from any other sub-pool, and only waits (on its own sub-pool) if
+    //  every worker is busy.
+    class worker_lock_t {
+    public:
+        worker_lock_t(extproc_pool_t *pool, signal_t *interruptor);
+        ~worker_lock_t();
+
+        extproc_worker_t *get_value();
+
+    private:
+        scoped_ptr_t<cross_thread_semaphore_t<extproc_worker_t>::lock_t> lock;
+        DISABLE_COPYING(worker_lock_t);
+    };
 
 private:
     // The interruptor to be pulsed when shutting down
@@ -37,8 +51,13 @@ private:
         scoped_array_t<scoped_ptr_t<cross_thread_signal_t> > ct_signals;
     } ct_interruptors;
 
-    // Cross-threaded semaphore allowing workers to be acquired from any thread
-    cross_thread_semaphore_t<extproc_worker_t> worker_semaphore;
+    // Cross-threaded semaphores allowing workers to be acquired from any thread, one
+    //  per group of threads
+    scoped_array_t<scoped_ptr_t<cross_thread_semaphore_t<extproc_worker_t> > > sub_pools;
+
+    // How long jobs wait to get a worker
+    perfmon_duration_sampler_t queue_wait;
+    perfmon_membership_t queue_wait_membership;
 };
 
 #endif /* EXTPROC_EXTPROC_POOL_HPP_ */
@@ -0,0 +1,144 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "extproc/extproc_shm.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <new>
+
+#include "errors.hpp"
+#include "utils.hpp"
+
+extproc_shm_t::extproc_shm_t()
+    : rings(NULL), memory(memory_category_t::extproc_pipes) {
+    // The name only exists until we've opened it
+    static std::atomic<uint64_t> next_segment(0);
+    const std::string name = strprintf("/rethinkdb-extproc-%d-%" PRIu64,
+                                       static_cast<int>(getpid()), next_segment++);
+
+    fd.reset(shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600));
+    guarantee_err(fd.get() != INVALID_FD, "could not create extproc shared memory");
+    int res = shm_unlink(name.c_str());
+    guarantee_err(res == 0, "could not unlink extproc shared memory");
+    res = ftruncate(fd.get(), 2 * sizeof(extproc_shm_ring_t));
+    guarantee_err(res == 0, "could not size extproc shared memory");
+
+    map();
+    for (size_t i = 0; i < 2; ++i) {
+        new (&rings[i].head) std::atomic<uint64_t>(0);
+        new (&rings[i].tail) std::atomic<uint64_t>(0);
+    }
+    memory.set(2 * sizeof(extproc_shm_ring_t));
+}
+
+extproc_shm_t::extproc_shm_t(fd_t _fd)
+    : fd(_fd), rings(NULL), memory(memory_category_t::extproc_pipes) {
+    map();
+}
+
+extproc_shm_t::~extproc_shm_t() {
+    int res = munmap(rings, 2 * sizeof(extproc_shm_ring_t));
+    guarantee_err(res == 0, "could not unmap extproc shared memory");
+}
+
+void extproc_shm_t::map() {
+    void *res = mmap(NULL, 2 * sizeof(extproc_shm_ring_t), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd.get(), 0);
+    guarantee_err(res != MAP_FAILED, "could not map extproc shared memory");
+    rings = static_cast<extproc_shm_ring_t *>(res);
+}
+
+extproc_shm_ring_t *extproc_shm_t::get_ring(size_t i) {
+    guarantee(i < 2);
+    return &rings[i];
+}
+
+shm_stream_t::shm_stream_t(extproc_shm_t *shm, bool is_worker,
+                           read_stream_t *_in, write_stream_t *_out) :
+    in_ring(shm->get_ring(is_worker ? 0 : 1)),
+    out_ring(shm->get_ring(is_worker ? 1 : 0)),
+    in(_in),
+    out(_out),
+    reading_ring(false),
+    read_remaining(0) { }
+
+shm_stream_t::~shm_stream_t() {
+    if (reading_ring && read_remaining > 0) {
+        in_ring->tail.fetch_add(read_remaining, std::memory_order_release);
+    }
+}
+
+int64_t shm_stream_t::read(void *p, int64_t n) {
+    if (read_remaining == 0) {
+        frame_header_t header;
+        int64_t res = force_read(in, &header, sizeof(header));
+        if (res != static_cast<int64_t>(sizeof(header))) {
+            return res <= 0 ? res : -1;
+        }
+        if (header.size <= 0 || (header.in_ring && header.size > EXTPROC_SHM_RING_SIZE)) {
+            return -1;
+        }
+        reading_ring = header.in_ring != 0;
+        read_remaining = header.size;
+    }
+
+    const int64_t count = std::min(n, read_remaining);
+    if (!reading_ring) {
+        int64_t res = in->read(p, count);
+        if (res > 0) {
+            read_remaining -= res;
+        }
+        return res;
+    }
+
+    const uint64_t tail = in_ring->tail.load(std::memory_order_relaxed);
+    if (in_ring->head.load(std::memory_order_acquire) - tail < static_cast<uint64_t>(count)) {
+        // The writer framed bytes it never put in the ring
+        return -1;
+    }
+    const int64_t offset = tail % EXTPROC_SHM_RING_SIZE;
+    const int64_t first = std::min<int64_t>(count, EXTPROC_SHM_RING_SIZE - offset);
+    memcpy(p, in_ring->data + offset, first);
+    memcpy(static_cast<char *>(p) + first, in_ring->data, count - first);
+    in_ring->tail.store(tail + count, std::memory_order_release);
+    read_remaining -= count;
+    return count;
+}
+
+int64_t shm_stream_t::write(const void *p, int64_t n) {
+    const char *data = static_cast<const char *>(p);
+    int64_t written = 0;
+    while (written < n) {
+        const uint64_t head = out_ring->head.load(std::memory_order_relaxed);
+        const uint64_t space =
+            EXTPROC_SHM_RING_SIZE - (head - out_ring->tail.load(std::memory_order_acquire));
+
+        frame_header_t header;
+        header.in_ring = space > 0;
+        header.size = header.in_ring
+            ? std::min<int64_t>(n - written, space)
+            : n - written;
+
+        if (header.in_ring) {
+            const int64_t offset = head % EXTPROC_SHM_RING_SIZE;
+            const int64_t first = std::min<int64_t>(header.size, EXTPROC_SHM_RING_SIZE - offset);
+            memcpy(out_ring->data + offset, data + written, first);
+            memcpy(out_ring->data, data + written + first, header.size - first);
+            out_ring->head.store(head + header.size, std::memory_order_release);
+            if (out->write(&header, sizeof(header)) == -1) {
+                return -1;
+            }
+        } else {
+            // The reader is behind, so this goes over the socket after all
+            if (out->write(&header, sizeof(header)) == -1
+                || out->write(data + written, header.size) == -1) {
+                return -1;
+            }
+        }
+        written += header.size;
+    }
+    return n;
+}
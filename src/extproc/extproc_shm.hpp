@@ -0,0 +1,91 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef EXTPROC_EXTPROC_SHM_HPP_
+#define EXTPROC_EXTPROC_SHM_HPP_
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "arch/io/io_utils.hpp"
+#include "config/args.hpp"
+#include "containers/archive/archive.hpp"
+#include "perfmon/memory.hpp"
+
+// One direction's ring buffer in an `extproc_shm_t`.  Only the writer advances `head`
+//  and only the reader advances `tail`; they count bytes since the segment was made.
+struct extproc_shm_ring_t {
+    std::atomic<uint64_t> head;
+    char head_padding[CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> tail;
+    char tail_padding[CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>)];
+    char data[EXTPROC_SHM_RING_SIZE];
+};
+
+// A shared memory segment between the main process and one extproc worker, with a
+//  ring buffer for each direction.
+class extproc_shm_t {
+public:
+    // Creates a new segment, which is only reachable through `get_fd()`
+    extproc_shm_t();
+
+    // Maps a segment that another process created, taking ownership of `fd`
+    explicit extproc_shm_t(fd_t fd);
+
+    ~extproc_shm_t();
+
+    fd_t get_fd() { return fd.get(); }
+
+    // The main process writes to ring 0 and reads from ring 1, the worker the other
+    //  way around.
+    extproc_shm_ring_t *get_ring(size_t i);
+
+private:
+    void map();
+
+    scoped_fd_t fd;
+    extproc_shm_ring_t *rings;
+    // Only the main process's side of the segment counts in its memory accounting.
+    memory_accounted_t memory;
+
+    DISABLE_COPYING(extproc_shm_t);
+};
+
+// Carries a job's data through the shared segment, with only small frames going over
+//  `in` and `out` (the worker's socket) to say how much there is to read.  When the
+//  ring is full, the data goes over the socket in the frame instead, so writing
+//  never waits for the reader.
+//
+// Everything written through one `shm_stream_t` must be read through the other.
+class shm_stream_t : public read_stream_t, public write_stream_t {
+public:
+    shm_stream_t(extproc_shm_t *shm, bool is_worker,
+                 read_stream_t *in, write_stream_t *out);
+
+    // Drops the rest of a frame that was only partly read from the ring, so the
+    //  next job's stream starts at the right place.
+    ~shm_stream_t();
+
+    MUST_USE int64_t read(void *p, int64_t n);
+    MUST_USE int64_t write(const void *p, int64_t n);
+
+private:
+    // Every write becomes one or more frames: this header, followed by `size` bytes
+    //  of payload on the socket unless `in_ring` is set.
+    struct frame_header_t {
+        uint8_t in_ring;
+        int64_t size;
+    } __attribute__((__packed__));
+
+    extproc_shm_ring_t *in_ring;
+    extproc_shm_ring_t *out_ring;
+    read_stream_t *in;
+    write_stream_t *out;
+
+    // What's left of the frame we're reading
+    bool reading_ring;
+    int64_t read_remaining;
+
+    DISABLE_COPYING(shm_stream_t);
+};
+
+#endif /* EXTPROC_EXTPROC_SHM_HPP_ */
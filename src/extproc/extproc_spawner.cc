@@ -7,6 +7,7 @@
 #include <unistd.h>
 
 #include "extproc/extproc_spawner.hpp"
+#include "extproc/extproc_shm.hpp"
 #include "extproc/extproc_worker.hpp"
 #include "arch/fd_send_recv.hpp"
 
@@ -15,8 +16,8 @@ extproc_spawner_t *extproc_spawner_t::instance = NULL;
 // This is the class that runs in the external process, doing all the work
 class worker_run_t {
 public:
-    worker_run_t(fd_t _socket, pid_t _spawner_pid) :
-        socket(_socket), socket_stream(socket.get(), &blocking_watcher) {
+    worker_run_t(fd_t _socket, fd_t shm_fd, pid_t _spawner_pid) :
+        socket(_socket), socket_stream(socket.get(), &blocking_watcher), shm(shm_fd) {
         guarantee(spawner_pid == -1);
         spawner_pid = _spawner_pid;
 
@@ -58,8 +59,13 @@ public:
                 break;
             }
 
-            if (!fn(&socket_stream, &socket_stream)) {
-                break;
+            {
+                // A fresh stream each time, so a job that doesn't read everything it
+                //  was sent can't confuse the next one
+                shm_stream_t shm_stream(&shm, true, &socket_stream, &socket_stream);
+                if (!fn(&shm_stream, &shm_stream)) {
+                    break;
+                }
             }
 
             // Trade magic numbers with the parent
@@ -93,6 +99,7 @@ private:
     scoped_fd_t socket;
     blocking_fd_watcher_t blocking_watcher;
     socket_stream_t socket_stream;
+    extproc_shm_t shm;
 };
 
 pid_t worker_run_t::spawner_pid = -1;
@@ -125,8 +132,9 @@ public:
         pid_t spawner_pid = getpid();
 
         while(true) {
-            fd_t worker_socket;
-            fd_recv_result_t recv_res = recv_fds(socket.get(), 1, &worker_socket);
+            // The worker's socket and its shared memory segment
+            fd_t worker_fds[2];
+            fd_recv_result_t recv_res = recv_fds(socket.get(), 2, worker_fds);
             if (recv_res != FD_RECV_OK) {
                 break;
             }
@@ -135,13 +143,14 @@ public:
             if (res == 0) {
                 // Worker process here
                 socket.reset(); // Don't need the spawner's pipe
-                worker_run_t worker_runner(worker_socket, spawner_pid);
+                worker_run_t worker_runner(worker_fds[0], worker_fds[1], spawner_pid);
                 worker_runner.main_loop();
                 ::_exit(EXIT_FAILURE);
             }
 
             guarantee_err(res != -1, "could not fork worker process");
-            scoped_fd_t closer(worker_socket);
+            scoped_fd_t socket_closer(worker_fds[0]);
+            scoped_fd_t shm_closer(worker_fds[1]);
         }
     }
 
@@ -204,14 +213,17 @@ void extproc_spawner_t::fork_spawner() {
 }
 
 // Spawns a new worker process and returns the fd of the socket used to communicate with it
-fd_t extproc_spawner_t::spawn(object_buffer_t<socket_stream_t> *stream_out, pid_t *pid_out) {
+fd_t extproc_spawner_t::spawn(fd_t shm_fd,
+                              object_buffer_t<socket_stream_t> *stream_out,
+                              pid_t *pid_out) {
     guarantee(spawner_socket.get() != INVALID_FD);
 
     fd_t fds[2];
     int res = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
     guarantee_err(res == 0, "could not create socket pair for worker process");
 
-    res = send_fds(spawner_socket.get(), 1, &fds[1]);
+    fd_t worker_fds[2] = { fds[1], shm_fd };
+    res = send_fds(spawner_socket.get(), 2, worker_fds);
     guarantee_err(res == 0, "could not send socket file descriptor to worker process");
 
     stream_out->create(fds[0], reinterpret_cast<fd_watcher_t*>(NULL));
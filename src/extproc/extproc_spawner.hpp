@@ -20,9 +20,9 @@ public:
     extproc_spawner_t();
     ~extproc_spawner_t();
 
-    // Spawns a new worker, and returns the socket file descriptor for communication
-    //  with the worker process
-    fd_t spawn(object_buffer_t<socket_stream_t> *stream_out, pid_t *pid_out);
+    // Spawns a new worker, which maps the shared memory segment `shm_fd`, and returns
+    //  the socket file descriptor for communication with the worker process
+    fd_t spawn(fd_t shm_fd, object_buffer_t<socket_stream_t> *stream_out, pid_t *pid_out);
 
     static extproc_spawner_t *get_instance();
 
@@ -27,7 +27,7 @@ extproc_worker_t::extproc_worker_t(extproc_spawner_t *_spawner) :
 
 extproc_worker_t::~extproc_worker_t() {
     if (worker_pid != -1) {
-        socket_stream.create(socket.get(), reinterpret_cast<fd_watcher_t*>(NULL));
+        create_streams();
 
         // TODO: check that worker is extant and/or catch exceptions
         run_job(&worker_exit_fn);
@@ -37,7 +37,7 @@ extproc_worker_t::~extproc_worker_t() {
         msg << exit_code;
         int res = send_write_message(get_write_stream(), &msg);
 
-        socket_stream.reset();
+        reset_streams();
 
         if (res != 0) {
             logERR("Could not shut down worker orderly, killing it...");
@@ -54,10 +54,9 @@ void extproc_worker_t::acquired(signal_t *_interruptor) {
 
     // We create the streams here, since they are thread-dependant
     if (worker_pid == -1) {
-        socket.reset(spawner->spawn(&socket_stream, &worker_pid));
-    } else {
-        socket_stream.create(socket.get(), reinterpret_cast<fd_watcher_t*>(NULL));
+        spawn();
     }
+    create_streams();
 
     // Apply the user interruptor to our stream along with the extproc pool's interruptor
     guarantee(interruptor == NULL);
@@ -66,6 +65,13 @@ void extproc_worker_t::acquired(signal_t *_interruptor) {
     socket_stream.get()->set_interruptor(interruptor);
 }
 
+void extproc_worker_t::warm_up() {
+    guarantee(interruptor == NULL);
+    if (worker_pid == -1) {
+        spawn();
+    }
+}
+
 void extproc_worker_t::released(bool user_error, signal_t *user_interruptor) {
     guarantee(interruptor != NULL);
     bool errored = user_error;
@@ -102,7 +108,7 @@ void extproc_worker_t::released(bool user_error, signal_t *user_interruptor) {
         }
     }
 
-    socket_stream.reset();
+    reset_streams();
     interruptor = NULL;
 
     // If anything went wrong, we just kill the worker and recreate it later
@@ -119,19 +125,37 @@ void extproc_worker_t::kill_process() {
 
     // Clean up our socket fd
     socket.reset();
+    shm.reset();
+}
+
+void extproc_worker_t::spawn() {
+    shm.init(new extproc_shm_t());
+    socket.reset(spawner->spawn(shm->get_fd(), &socket_stream, &worker_pid));
+    // The stream is thread-dependant, `create_streams` recreates it when it's used
+    socket_stream.reset();
+}
+
+void extproc_worker_t::create_streams() {
+    socket_stream.create(socket.get(), reinterpret_cast<fd_watcher_t*>(NULL));
+    shm_stream.create(shm.get(), false, socket_stream.get(), socket_stream.get());
+}
+
+void extproc_worker_t::reset_streams() {
+    shm_stream.reset();
+    socket_stream.reset();
 }
 
 void extproc_worker_t::run_job(bool (*fn) (read_stream_t *, write_stream_t *)) {
     write_message_t msg;
     msg.append(&fn, sizeof(fn));
-    int res = send_write_message(get_write_stream(), &msg);
+    int res = send_write_message(socket_stream.get(), &msg);
     if (res != 0) { throw std::runtime_error("failed to send job function to worker"); }
 }
 
 read_stream_t *extproc_worker_t::get_read_stream() {
-    return socket_stream.get();
+    return shm_stream.get();
 }
 
 write_stream_t *extproc_worker_t::get_write_stream() {
-    return socket_stream.get();
+    return shm_stream.get();
 }
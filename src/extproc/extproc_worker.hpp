@@ -9,6 +9,7 @@
 #include "containers/object_buffer.hpp"
 #include "containers/scoped.hpp"
 #include "containers/archive/socket_stream.hpp"
+#include "extproc/extproc_shm.hpp"
 
 class extproc_spawner_t;
 
@@ -21,6 +22,9 @@ public:
     void acquired(signal_t *_interruptor);
     void released(bool user_error, signal_t *user_interruptor);
 
+    // Starts the worker process ahead of the first time the worker is acquired
+    void warm_up();
+
     // We accept jobs as functions that take a read stream and write stream
     //  so that they can communicate back to the job in the main process
     void run_job(bool (*fn) (read_stream_t *, write_stream_t *));
@@ -39,11 +43,18 @@ private:
     //  of our coroutine stuff
     void spawn_internal();
 
+    // The socket stream carries job functions and resynchronization, the shm stream
+    //  carries the jobs' own data (see `shm_stream_t`)
+    void create_streams();
+    void reset_streams();
+
     extproc_spawner_t *spawner;
     pid_t worker_pid;
     scoped_fd_t socket;
 
     object_buffer_t<socket_stream_t> socket_stream;
+    scoped_ptr_t<extproc_shm_t> shm;
+    object_buffer_t<shm_stream_t> shm_stream;
 
     signal_t *interruptor;
 };
@@ -13,11 +13,20 @@
 #endif
 
 #include <cmath>
-
+#include <list>
+#include <map>
+#include <unordered_map>
+
+#include "arch/io/concurrency.hpp"
+#include "arch/runtime/coro_wait_profiler.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "config/args.hpp"
 #include "rdb_protocol/rdb_protocol_json.hpp"
 #include "rdb_protocol/pseudo_time.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "containers/archive/stl_types.hpp"
 #include "extproc/extproc_job.hpp"
+#include "thread_local.hpp"
 
 #ifdef V8_PRE_3_19
 #define DECLARE_HANDLE_SCOPE(scope) v8::HandleScope scope
@@ -39,13 +48,41 @@ counted_t<const ql::datum_t> js_to_datum(const v8::Handle<v8::Value> &value,
 // Should never error.
 v8::Handle<v8::Value> js_from_datum(const counted_t<const ql::datum_t> &datum);
 
+// Worker-side cache of the compiled scripts of sources that evaluated to functions,
+// so that a worker compiles each one once rather than once per job.  The scripts
+// aren't bound to a context: every job runs its script again in a fresh context, so
+// the function it gets, and whatever its closure and globals hold, are its own.  A
+// worker runs one job at a time, so this needs no locking.  It must be destroyed
+// while its isolate still exists.
+class js_function_cache_t {
+public:
+    js_function_cache_t() { }
+    ~js_function_cache_t();
+
+    // Returns NULL if `source` isn't cached, and otherwise marks it recently used.
+    const v8::Persistent<v8::Script> *find(const std::string &source);
+    void insert(const std::string &source, const v8::Handle<v8::Script> &script);
+
+private:
+    struct entry_t {
+        boost::shared_ptr<v8::Persistent<v8::Script> > script;
+        std::list<std::string>::iterator lru_position;
+    };
+
+    // Least recently used first
+    std::list<std::string> lru;
+    std::unordered_map<std::string, entry_t> entries;
+
+    DISABLE_COPYING(js_function_cache_t);
+};
+
 // Worker-side JS evaluation environment.
 class js_env_t {
 public:
-    js_env_t();
+    explicit js_env_t(js_function_cache_t *function_cache);
     ~js_env_t();
 
-    js_result_t eval(const std::string &source);
+    js_result_t eval(const std::string &source, bool *cache_hit_out);
     js_result_t call(js_id_t id, const std::vector<counted_t<const ql::datum_t> > &args);
     void release(js_id_t id);
 
@@ -53,6 +90,7 @@ private:
     js_id_t remember_value(const v8::Handle<v8::Value> &value);
     const boost::shared_ptr<v8::Persistent<v8::Value> > find_value(js_id_t id);
 
+    js_function_cache_t *function_cache;
     js_id_t next_id;
     std::map<js_id_t, boost::shared_ptr<v8::Persistent<v8::Value> > > values;
 };
@@ -86,66 +124,346 @@ enum js_task_t {
     TASK_EVAL,
     TASK_CALL,
     TASK_RELEASE,
-    TASK_EXIT
+    TASK_EXIT,
+    TASK_CALL_BATCH
+};
+
+static bool js_in_process = false;
+
+bool set_js_in_process(bool in_process) {
+#ifdef V8_PRE_3_19
+    // There's no way to take back a `TerminateExecution` that came too late.
+    return !in_process;
+#else
+    js_in_process = in_process;
+    return true;
+#endif
+}
+
+// Terminates in-process scripts that run past their deadlines.  Scripts run without
+// yielding, so no timer on their own thread could fire in time; instead this has a
+// thread of its own, shared by the whole process.
+class js_watchdog_t {
+public:
+    js_watchdog_t() : next_ticket(0) {
+        pthread_t thread;
+        int res = pthread_create(&thread, NULL, &js_watchdog_t::run, this);
+        guarantee_xerr(res == 0, res, "Could not create JavaScript watchdog thread.");
+        res = pthread_detach(thread);
+        guarantee_xerr(res == 0, res, "Could not detach JavaScript watchdog thread.");
+    }
+
+    // Returns the ticket to `disarm()` with once the script is done.
+    uint64_t arm(v8::Isolate *isolate, uint64_t timeout_ms) {
+        // Deadlines further off than this never come anyway.
+        timeout_ms = std::min<uint64_t>(timeout_ms, 365 * 24 * 3600 * THOUSAND);
+        entry_t entry;
+        entry.isolate = isolate;
+        entry.fired = false;
+        int res = clock_gettime(CLOCK_REALTIME, &entry.deadline);
+        guarantee_err(res == 0, "clock_gettime(CLOCK_REALTIME) failed");
+        entry.deadline.tv_sec += timeout_ms / THOUSAND;
+        entry.deadline.tv_nsec += (timeout_ms % THOUSAND) * MILLION;
+        if (entry.deadline.tv_nsec >= BILLION) {
+            entry.deadline.tv_sec += 1;
+            entry.deadline.tv_nsec -= BILLION;
+        }
+
+        system_mutex_t::lock_t lock(&mutex);
+        const uint64_t ticket = next_ticket++;
+        entries.insert(std::make_pair(ticket, entry));
+        cond.signal();
+        return ticket;
+    }
+
+    // Returns whether the script ran out of time and was terminated.  The termination
+    // may have come after the script finished, so it's cancelled either way.
+    bool disarm(uint64_t ticket) {
+        system_mutex_t::lock_t lock(&mutex);
+        auto it = entries.find(ticket);
+        guarantee(it != entries.end());
+        const bool fired = it->second.fired;
+#ifndef V8_PRE_3_19
+        if (fired) {
+            v8::V8::CancelTerminateExecution(it->second.isolate);
+        }
+#endif
+        entries.erase(it);
+        return fired;
+    }
+
+private:
+    struct entry_t {
+        v8::Isolate *isolate;
+        struct timespec deadline;
+        bool fired;
+    };
+
+    static bool before(const struct timespec &a, const struct timespec &b) {
+        return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+    }
+
+    static void *run(void *arg) {
+        js_watchdog_t *self = static_cast<js_watchdog_t *>(arg);
+        system_mutex_t::lock_t lock(&self->mutex);
+        for (;;) {
+            struct timespec now;
+            int res = clock_gettime(CLOCK_REALTIME, &now);
+            guarantee_err(res == 0, "clock_gettime(CLOCK_REALTIME) failed");
+
+            bool waiting = false;
+            struct timespec next_deadline;
+            for (auto it = self->entries.begin(); it != self->entries.end(); ++it) {
+                if (it->second.fired) {
+                    continue;
+                }
+                if (!before(now, it->second.deadline)) {
+                    v8::V8::TerminateExecution(it->second.isolate);
+                    it->second.fired = true;
+                } else if (!waiting || before(it->second.deadline, next_deadline)) {
+                    waiting = true;
+                    next_deadline = it->second.deadline;
+                }
+            }
+
+            if (waiting) {
+                self->cond.timed_wait(&self->mutex, next_deadline);
+            } else {
+                self->cond.wait(&self->mutex);
+            }
+        }
+    }
+
+    system_mutex_t mutex;
+    system_cond_t cond;
+    uint64_t next_ticket;
+    std::map<uint64_t, entry_t> entries;
+
+    DISABLE_COPYING(js_watchdog_t);
+};
+
+static js_watchdog_t *get_js_watchdog() {
+    // Never destroyed, since its thread never stops.
+    static js_watchdog_t *watchdog = new js_watchdog_t();
+    return watchdog;
+}
+
+// The in-process V8 state of one server thread.  Each thread has an isolate of its
+// own, so threads never contend for V8, and scripts don't yield, so only one
+// coroutine is in it at a time.  Like a worker's function cache, it's kept for the
+// life of the process.
+class js_thread_engine_t {
+public:
+    js_thread_engine_t() : isolate(v8::Isolate::New()) { }
+
+    v8::Isolate *const isolate;
+    js_function_cache_t function_cache;
+
+private:
+    DISABLE_COPYING(js_thread_engine_t);
+};
+
+TLS_with_init(js_thread_engine_t *, js_thread_engine, NULL);
+
+static js_thread_engine_t *get_js_thread_engine() {
+    js_thread_engine_t *engine = TLS_get_js_thread_engine();
+    if (engine == NULL) {
+        engine = new js_thread_engine_t();
+        TLS_set_js_thread_engine(engine);
+    }
+    return engine;
+}
+
+// Enters an engine's isolate, with V8's stack limit set for the running coroutine's
+// stack rather than the thread's.
+class js_engine_scope_t {
+public:
+    explicit js_engine_scope_t(js_thread_engine_t *engine) :
+        locker(engine->isolate),
+        isolate_scope(engine->isolate) {
+        guarantee(coro_t::self() != NULL);
+        char *stack_bound =
+            static_cast<char *>(coro_t::self()->get_stack()->get_stack_bound());
+        v8::ResourceConstraints constraints;
+        constraints.set_stack_limit(
+            reinterpret_cast<uint32_t *>(stack_bound + JS_IN_PROCESS_STACK_SLACK));
+#ifdef V8_PRE_3_19
+        bool res = v8::SetResourceConstraints(&constraints);
+#else
+        bool res = v8::SetResourceConstraints(engine->isolate, &constraints);
+#endif
+        guarantee(res);
+    }
+
+private:
+    v8::Locker locker;
+    v8::Isolate::Scope isolate_scope;
+
+    DISABLE_COPYING(js_engine_scope_t);
 };
 
 // The job_t runs in the context of the main rethinkdb process
-js_job_t::js_job_t(extproc_pool_t *pool, signal_t *interruptor) :
-    extproc_job(pool, &worker_fn, interruptor) { }
+js_job_t::js_job_t(extproc_pool_t *pool, signal_t *_interruptor) :
+    engine(NULL), interruptor(_interruptor) {
+    if (js_in_process) {
+        engine = get_js_thread_engine();
+        inproc_env.init(new js_env_t(&engine->function_cache));
+    } else {
+        extproc_job.init(new extproc_job_t(pool, &worker_fn, interruptor));
+    }
+}
+
+js_job_t::~js_job_t() {
+    if (inproc_env.has()) {
+        // Disposing of its handles needs the isolate.
+        js_engine_scope_t engine_scope(engine);
+        inproc_env.reset();
+    }
+}
 
-js_result_t js_job_t::eval(const std::string &source) {
+void js_job_t::run_in_process(uint64_t timeout_ms, const std::function<void()> &fn) {
+    guarantee(inproc_env.has());
+    if (interruptor != NULL && interruptor->is_pulsed()) {
+        throw interrupted_exc_t();
+    }
+    js_engine_scope_t engine_scope(engine);
+    js_watchdog_t *watchdog = get_js_watchdog();
+    const uint64_t ticket = watchdog->arm(engine->isolate, timeout_ms);
+    try {
+        fn();
+    } catch (...) {
+        watchdog->disarm(ticket);
+        throw;
+    }
+    if (watchdog->disarm(ticket)) {
+        throw interrupted_exc_t();
+    }
+}
+
+js_result_t js_job_t::eval(const std::string &source, uint64_t timeout_ms,
+                           bool *cache_hit_out) {
+    if (inproc_env.has()) {
+        js_result_t result;
+        run_in_process(timeout_ms, [&]() {
+            result = inproc_env->eval(source, cache_hit_out);
+        });
+        return result;
+    }
+
+    coro_wait_site_t wait_site("extproc");
     js_task_t task = js_task_t::TASK_EVAL;
     write_message_t msg;
     msg.append(&task, sizeof(task));
     msg << source;
-    int res = send_write_message(extproc_job.write_stream(), &msg);
+    int res = send_write_message(extproc_job->write_stream(), &msg);
     if (res != 0) { throw js_worker_exc_t("failed to send data to the worker"); }
 
     js_result_t result;
-    res = deserialize(extproc_job.read_stream(), &result);
+    res = deserialize(extproc_job->read_stream(), &result);
+    if (res != ARCHIVE_SUCCESS) { throw js_worker_exc_t("failed to deserialize result from worker"); }
+    res = deserialize(extproc_job->read_stream(), cache_hit_out);
     if (res != ARCHIVE_SUCCESS) { throw js_worker_exc_t("failed to deserialize result from worker"); }
     return result;
 }
 
-js_result_t js_job_t::call(js_id_t id, const std::vector<counted_t<const ql::datum_t> > &args) {
+js_result_t js_job_t::call(js_id_t id, const std::vector<counted_t<const ql::datum_t> > &args,
+                          uint64_t timeout_ms) {
+    if (inproc_env.has()) {
+        js_result_t result;
+        run_in_process(timeout_ms, [&]() { result = inproc_env->call(id, args); });
+        return result;
+    }
+
+    coro_wait_site_t wait_site("extproc");
     js_task_t task = js_task_t::TASK_CALL;
     write_message_t msg;
     msg.append(&task, sizeof(task));
     msg << id;
     msg << args;
-    int res = send_write_message(extproc_job.write_stream(), &msg);
+    int res = send_write_message(extproc_job->write_stream(), &msg);
     if (res != 0) { throw js_worker_exc_t("failed to send data to the worker"); }
 
     js_result_t result;
-    res = deserialize(extproc_job.read_stream(), &result);
+    res = deserialize(extproc_job->read_stream(), &result);
     if (res != ARCHIVE_SUCCESS) { throw js_worker_exc_t("failed to deserialize result from worker"); }
     return result;
 }
 
+std::vector<js_result_t> js_job_t::call_batch(
+        js_id_t id,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &args_batch,
+        uint64_t timeout_ms) {
+    if (inproc_env.has()) {
+        std::vector<js_result_t> results;
+        results.reserve(args_batch.size());
+        run_in_process(timeout_ms, [&]() {
+            for (auto it = args_batch.begin(); it != args_batch.end(); ++it) {
+                results.push_back(inproc_env->call(id, *it));
+            }
+        });
+        return results;
+    }
+
+    coro_wait_site_t wait_site("extproc");
+    js_task_t task = js_task_t::TASK_CALL_BATCH;
+    write_message_t msg;
+    msg.append(&task, sizeof(task));
+    msg << id;
+    msg << args_batch;
+    int res = send_write_message(extproc_job->write_stream(), &msg);
+    if (res != 0) { throw js_worker_exc_t("failed to send data to the worker"); }
+
+    std::vector<js_result_t> results;
+    res = deserialize(extproc_job->read_stream(), &results);
+    if (res != ARCHIVE_SUCCESS) { throw js_worker_exc_t("failed to deserialize result from worker"); }
+    if (results.size() != args_batch.size()) {
+        throw js_worker_exc_t("worker returned the wrong number of results");
+    }
+    return results;
+}
+
 void js_job_t::release(js_id_t id) {
+    if (inproc_env.has()) {
+        js_engine_scope_t engine_scope(engine);
+        inproc_env->release(id);
+        return;
+    }
+
     js_task_t task = js_task_t::TASK_RELEASE;
     write_message_t msg;
     msg.append(&task, sizeof(task));
     msg << id;
-    int res = send_write_message(extproc_job.write_stream(), &msg);
+    int res = send_write_message(extproc_job->write_stream(), &msg);
     if (res != 0) { throw js_worker_exc_t("failed to send data to the worker"); }
 }
 
 void js_job_t::exit() {
+    if (inproc_env.has()) {
+        // The environment goes with the job.
+        return;
+    }
+
     js_task_t task = js_task_t::TASK_EXIT;
     write_message_t msg;
     msg.append(&task, sizeof(task));
-    int res = send_write_message(extproc_job.write_stream(), &msg);
+    int res = send_write_message(extproc_job->write_stream(), &msg);
     if (res != 0) { throw js_worker_exc_t("failed to send data to the worker"); }
 }
 
 void js_job_t::worker_error() {
-    extproc_job.worker_error();
+    if (extproc_job.has()) {
+        extproc_job->worker_error();
+    }
 }
 
 bool js_job_t::worker_fn(read_stream_t *stream_in, write_stream_t *stream_out) {
     bool running = true;
-    js_env_t js_env;
+    // This outlives the job, it's kept for the life of the worker process.  Its
+    // handles are in V8's default isolate, which the worker never disposes of, so it's
+    // never destroyed either: a static's destructor would run at exit, after V8 may
+    // have been torn down.
+    static js_function_cache_t *function_cache = new js_function_cache_t();
+    js_env_t js_env(function_cache);
 
     while (running) {
         js_task_t task;
@@ -160,9 +478,11 @@ bool js_job_t::worker_fn(read_stream_t *stream_in, write_stream_t *stream_out) {
                 res = deserialize(stream_in, &source);
                 if (res != ARCHIVE_SUCCESS) { return false; }
 
-                js_result_t js_result = js_env.eval(source);
+                bool cache_hit;
+                js_result_t js_result = js_env.eval(source, &cache_hit);
                 write_message_t msg;
                 msg << js_result;
+                msg << cache_hit;
                 res = send_write_message(stream_out, &msg);
                 if (res != 0) { return false; }
             }
@@ -183,6 +503,28 @@ bool js_job_t::worker_fn(read_stream_t *stream_in, write_stream_t *stream_out) {
                 if (res != 0) { return false; }
             }
             break;
+        case TASK_CALL_BATCH:
+            {
+                js_id_t id;
+                std::vector<std::vector<counted_t<const ql::datum_t> > > args_batch;
+                res = deserialize(stream_in, &id);
+                if (res != ARCHIVE_SUCCESS) { return false; }
+                res = deserialize(stream_in, &args_batch);
+                if (res != ARCHIVE_SUCCESS) { return false; }
+
+                // All the results go back in a single message, so a batch costs
+                // one round trip to the worker rather than one per call.
+                std::vector<js_result_t> js_results;
+                js_results.reserve(args_batch.size());
+                for (auto it = args_batch.begin(); it != args_batch.end(); ++it) {
+                    js_results.push_back(js_env.call(id, *it));
+                }
+                write_message_t msg;
+                msg << js_results;
+                res = send_write_message(stream_out, &msg);
+                if (res != 0) { return false; }
+            }
+            break;
         case TASK_RELEASE:
             {
                 js_id_t id;
@@ -206,12 +548,55 @@ static void append_caught_error(std::string *errmsg, const v8::TryCatch &try_cat
 
     v8::String::Utf8Value exception(try_catch.Exception());
     const char *message = *exception;
-    guarantee(message);
+    if (message == NULL) {
+        // The in-process watchdog terminated the script, which throws nothing.
+        errmsg->append("JavaScript execution was terminated.");
+        return;
+    }
     errmsg->append(message, strlen(message));
 }
 
+js_function_cache_t::~js_function_cache_t() {
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        it->second.script->Dispose();
+    }
+}
+
+const v8::Persistent<v8::Script> *js_function_cache_t::find(const std::string &source) {
+    auto it = entries.find(source);
+    if (it == entries.end()) {
+        return NULL;
+    }
+    lru.splice(lru.end(), lru, it->second.lru_position);
+    return it->second.script.get();
+}
+
+void js_function_cache_t::insert(const std::string &source,
+                                 const v8::Handle<v8::Script> &script) {
+    guarantee(entries.find(source) == entries.end());
+
+    if (entries.size() >= EXTPROC_JS_FUNCTION_CACHE_SIZE) {
+        auto oldest = entries.find(lru.front());
+        guarantee(oldest != entries.end());
+        oldest->second.script->Dispose();
+        entries.erase(oldest);
+        lru.pop_front();
+    }
+
+    entry_t entry;
+    entry.script.reset(new v8::Persistent<v8::Script>());
+#ifdef V8_PRE_3_19
+    *entry.script = v8::Persistent<v8::Script>::New(script);
+#else
+    entry.script->Reset(v8::Isolate::GetCurrent(), script);
+#endif
+    entry.lru_position = lru.insert(lru.end(), source);
+    entries.insert(std::make_pair(source, entry));
+}
+
 // The env_t runs in the context of the worker process
-js_env_t::js_env_t() :
+js_env_t::js_env_t(js_function_cache_t *_function_cache) :
+    function_cache(_function_cache),
     next_id(MIN_ID) { }
 
 js_env_t::~js_env_t() {
@@ -221,47 +606,63 @@ js_env_t::~js_env_t() {
     }
 }
 
-js_result_t js_env_t::eval(const std::string &source) {
+js_result_t js_env_t::eval(const std::string &source, bool *cache_hit_out) {
     js_context_t clean_context;
     js_result_t result("");
     std::string *errmsg = boost::get<std::string>(&result);
 
     DECLARE_HANDLE_SCOPE(handle_scope);
 
-    // TODO: use an "external resource" to avoid copy?
-    v8::Handle<v8::String> src = v8::String::New(source.data(), source.size());
-
     // This constructor registers itself with v8 so that any errors generated
     // within v8 will be available within this object.
     v8::TryCatch try_catch;
 
-    // Firstly, compilation may fail (because of say a syntax error)
-    v8::Handle<v8::Script> script = v8::Script::Compile(src);
-    if (script.IsEmpty()) {
-        // Get the error out of the TryCatch object
-        append_caught_error(errmsg, try_catch);
+    v8::Handle<v8::Script> script;
+    const v8::Persistent<v8::Script> *cached = function_cache->find(source);
+    *cache_hit_out = cached != NULL;
+    if (cached != NULL) {
+#ifdef V8_PRE_3_19
+        script = v8::Local<v8::Script>::New(*cached);
+#else
+        script = v8::Local<v8::Script>::New(v8::Isolate::GetCurrent(), *cached);
+#endif
     } else {
-        // Secondly, evaluation may fail because of an exception generated
-        // by the code
-        v8::Handle<v8::Value> result_val = script->Run();
-        if (result_val.IsEmpty()) {
-            // Get the error from the TryCatch object
+        // TODO: use an "external resource" to avoid copy?
+        v8::Handle<v8::String> src = v8::String::New(source.data(), source.size());
+
+        // Firstly, compilation may fail (because of say a syntax error).  The
+        // script isn't bound to `clean_context`, so later jobs can run it in theirs.
+        script = v8::Script::New(src);
+        if (script.IsEmpty()) {
+            // Get the error out of the TryCatch object
             append_caught_error(errmsg, try_catch);
+            return result;
+        }
+    }
+
+    // Secondly, evaluation may fail because of an exception generated
+    // by the code
+    v8::Handle<v8::Value> result_val = script->Run();
+    if (result_val.IsEmpty()) {
+        // Get the error from the TryCatch object
+        append_caught_error(errmsg, try_catch);
+    } else {
+        // Scripts that evaluate to functions become RQL Func terms that
+        // can be passed to map, filter, reduce, etc.
+        if (result_val->IsFunction()) {
+            if (cached == NULL) {
+                function_cache->insert(source, script);
+            }
+            v8::Handle<v8::Function> func
+                = v8::Handle<v8::Function>::Cast(result_val);
+            result = remember_value(func);
         } else {
-            // Scripts that evaluate to functions become RQL Func terms that
-            // can be passed to map, filter, reduce, etc.
-            if (result_val->IsFunction()) {
-                v8::Handle<v8::Function> func
-                    = v8::Handle<v8::Function>::Cast(result_val);
-                result = remember_value(func);
-            } else {
-                guarantee(!result_val.IsEmpty());
+            guarantee(!result_val.IsEmpty());
 
-                // JSONify result.
-                counted_t<const ql::datum_t> datum = js_to_datum(result_val, errmsg);
-                if (datum.has()) {
-                    result = datum;
-                }
+            // JSONify result.
+            counted_t<const ql::datum_t> datum = js_to_datum(result_val, errmsg);
+            if (datum.has()) {
+                result = datum;
             }
         }
     }
@@ -357,6 +758,8 @@ js_result_t js_env_t::call(js_id_t id,
 
 void js_env_t::release(js_id_t id) {
     guarantee(id < next_id);
+    // In-process, the handle would otherwise outlive the job in the server's isolate.
+    find_value(id)->Dispose();
     size_t num_erased = values.erase(id);
     guarantee(1 == num_erased);
 }
@@ -519,7 +922,7 @@ v8::Handle<v8::Value> js_from_datum(const counted_t<const ql::datum_t> &datum) {
             return date;
         } else {
             v8::Handle<v8::Object> obj = v8::Object::New();
-            const std::map<std::string, counted_t<const ql::datum_t> > &source_map = datum->as_object();
+            const ql::datum_object_t &source_map = datum->as_object();
 
             for (auto it = source_map.begin(); it != source_map.end(); ++it) {
                 DECLARE_HANDLE_SCOPE(scope);
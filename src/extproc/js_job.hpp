@@ -2,6 +2,7 @@
 #ifndef EXTPROC_JS_JOB_HPP_
 #define EXTPROC_JS_JOB_HPP_
 
+#include <functional>
 #include <vector>
 #include <string>
 
@@ -11,18 +12,35 @@
 #include "utils.hpp"
 #include "containers/archive/archive.hpp"
 #include "containers/counted.hpp"
+#include "containers/scoped.hpp"
 #include "concurrency/signal.hpp"
 #include "extproc/extproc_pool.hpp"
 #include "extproc/extproc_job.hpp"
 #include "extproc/js_runner.hpp"
 #include "rdb_protocol/datum.hpp"
 
+class js_env_t;
+class js_thread_engine_t;
+
+// Runs in the worker process given by `pool`, or, with `set_js_in_process(true)`, in
+//  this thread's in-process engine.
 class js_job_t {
 public:
     js_job_t(extproc_pool_t *pool, signal_t *interruptor);
+    ~js_job_t();
+
+    // In-process, a watchdog terminates calls that run for longer than `timeout_ms`
+    //  and they throw `interrupted_exc_t`; a worker is interrupted by its caller.
 
-    js_result_t eval(const std::string &source);
-    js_result_t call(js_id_t id, const std::vector<counted_t<const ql::datum_t> > &args);
+    // Sets `*cache_hit_out` to whether the worker already had `source` compiled.
+    js_result_t eval(const std::string &source, uint64_t timeout_ms,
+                     bool *cache_hit_out);
+    js_result_t call(js_id_t id, const std::vector<counted_t<const ql::datum_t> > &args,
+                     uint64_t timeout_ms);
+    std::vector<js_result_t> call_batch(
+        js_id_t id,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &args_batch,
+        uint64_t timeout_ms);
     void release(js_id_t id);
     void exit();
 
@@ -32,7 +50,16 @@ public:
 private:
     static bool worker_fn(read_stream_t *stream_in, write_stream_t *stream_out);
 
-    extproc_job_t extproc_job;
+    // Runs `fn` on `inproc_env` under the watchdog.
+    void run_in_process(uint64_t timeout_ms, const std::function<void()> &fn);
+
+    // Exactly one of these is set.
+    scoped_ptr_t<extproc_job_t> extproc_job;
+    scoped_ptr_t<js_env_t> inproc_env;
+
+    js_thread_engine_t *engine;
+    signal_t *interruptor;
+
     DISABLE_COPYING(js_job_t);
 };
 
@@ -1,15 +1,35 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "extproc/js_runner.hpp"
 
+#include <algorithm>
 #include <map>
 
 #include "extproc/js_job.hpp"
+#include "perfmon/perfmon.hpp"
 
 const size_t js_runner_t::CACHE_SIZE = 100;
 
 const js_id_t MIN_ID = 1;
 const js_id_t MAX_ID = UINT64_MAX;
 
+// How often the worker already had a function compiled from an earlier job when we
+//  asked it to evaluate one
+struct js_function_cache_stats_t {
+    js_function_cache_stats_t() :
+        membership(&get_global_perfmon_collection(),
+                   &hits, "js_function_cache_hits",
+                   &misses, "js_function_cache_misses") { }
+
+    perfmon_counter_t hits;
+    perfmon_counter_t misses;
+    perfmon_multi_membership_t membership;
+};
+
+static js_function_cache_stats_t *get_js_function_cache_stats() {
+    static js_function_cache_stats_t stats;
+    return &stats;
+}
+
 // This class allows us to manage timeouts in a cleaner manner
 class js_timeout_t {
 public:
@@ -41,8 +61,8 @@ private:
     signal_timer_t timer;
 };
 
-// Contains all the data relevant to a single worker process, so we can
-//  easily clear it all and replace it
+// Contains all the data relevant to a single worker process (or in-process
+//  environment), so we can easily clear it all and replace it
 class js_runner_t::job_data_t {
 public:
     job_data_t(extproc_pool_t *pool, signal_t *interruptor) :
@@ -117,8 +137,9 @@ js_result_t js_runner_t::eval(const std::string &source,
     object_buffer_t<js_timeout_t::sentry_t> sentry;
     sentry.create(&job_data->js_timeout, config.timeout_ms);
 
+    bool cache_hit;
     try {
-        result = job_data->js_job.eval(source);
+        result = job_data->js_job.eval(source, config.timeout_ms, &cache_hit);
     } catch (...) {
         // Sentry must be destroyed before the js_timeout
         sentry.reset();
@@ -133,6 +154,11 @@ js_result_t js_runner_t::eval(const std::string &source,
     js_id_t *any_id = boost::get<js_id_t>(&result);
     if (any_id != NULL) {
         cache_id(*any_id, source);
+        if (cache_hit) {
+            ++get_js_function_cache_stats()->hits;
+        } else {
+            ++get_js_function_cache_stats()->misses;
+        }
     }
 
     return result;
@@ -153,7 +179,7 @@ js_result_t js_runner_t::call(const std::string &source,
     sentry.create(&job_data->js_timeout, config.timeout_ms);
 
     try {
-        result = job_data->js_job.call(*fn_id, args);
+        result = job_data->js_job.call(*fn_id, args, config.timeout_ms);
     } catch (...) {
         // Sentry must be destroyed before the js_timeout
         sentry.reset();
@@ -173,6 +199,55 @@ js_result_t js_runner_t::call(const std::string &source,
     return result;
 }
 
+std::vector<js_result_t> js_runner_t::call_batch(
+        const std::string &source,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &args_batch,
+        const req_config_t &config) {
+    assert_thread();
+    guarantee(job_data.has());
+
+    // This will retrieve the function from the cache if it's there, or re-eval it
+    js_result_t fn = eval(source, config);
+    js_id_t *fn_id = boost::get<js_id_t>(&fn);
+    guarantee(fn_id != NULL);
+
+    const uint64_t batch_timeout_ms =
+        config.timeout_ms * std::max<uint64_t>(args_batch.size(), 1);
+    object_buffer_t<js_timeout_t::sentry_t> sentry;
+    sentry.create(&job_data->js_timeout, batch_timeout_ms);
+
+    std::vector<js_result_t> results;
+    try {
+        results = job_data->js_job.call_batch(*fn_id, args_batch, batch_timeout_ms);
+    } catch (...) {
+        // Sentry must be destroyed before the js_timeout
+        sentry.reset();
+        // This will mark the worker as errored so we don't try to re-sync with it
+        //  on the next line (since we're in a catch statement, we aren't allowed)
+        job_data->js_job.worker_error();
+        job_data.reset();
+        throw;
+    }
+
+    // Unlike `call`, there may be many of these for the same source, and the
+    // caller re-evaluates `source` if it wants the function, so drop them.
+    try {
+        for (auto it = results.begin(); it != results.end(); ++it) {
+            js_id_t *any_id = boost::get<js_id_t>(&*it);
+            if (any_id != NULL) {
+                release_id(*any_id);
+            }
+        }
+    } catch (...) {
+        sentry.reset();
+        job_data->js_job.worker_error();
+        job_data.reset();
+        throw;
+    }
+
+    return results;
+}
+
 void js_runner_t::cache_id(js_id_t id, const std::string &source) {
     guarantee(job_data.has());
     guarantee(id != INVALID_ID);
@@ -39,6 +39,15 @@ private:
     std::string info;
 };
 
+/* Whether `js_runner_t`s run JavaScript inside the server process, in a V8 isolate of
+the calling thread's own, instead of in extproc workers.  Calls then cost a function
+call rather than a round trip to another process; but a script that crashes V8 takes
+the server down with it, and scripts run on the caller's coroutine stack.  So it's
+off by default, and workers remain the place for untrusted code.  Like the other
+process-wide settings, this is set from the command line before the thread pool
+starts.  Returns false if this build's V8 is too old to support it. */
+MUST_USE bool set_js_in_process(bool in_process);
+
 // A handle to a running "javascript evaluator" job.
 class js_runner_t : public home_thread_mixin_t {
 public:
@@ -64,6 +73,15 @@ public:
                      const std::vector<counted_t<const ql::datum_t> > &args,
                      const req_config_t &config);
 
+    // Calls a previously compiled function once for each element of
+    // `args_batch`, in a single round trip to the worker.  The timeout in
+    // `config` applies to each call, so the batch as a whole gets that many
+    // times as long.  Returned function ids are not kept.
+    std::vector<js_result_t> call_batch(
+        const std::string &source,
+        const std::vector<std::vector<counted_t<const ql::datum_t> > > &args_batch,
+        const req_config_t &config);
+
 private:
     static const size_t CACHE_SIZE;
 
@@ -9,6 +9,27 @@
 #include "memcached/region.hpp"
 #include "stl_utils.hpp"
 
+// By the power of magic, the 62nd, 61st, ..., 55th bits of a byte's
+// spread value are equal to the 0th, 1st, 2nd, ..., 7th bits of the
+// byte.  This helps us meet the criterion specified below.
+static uint64_t spread_hash_byte(uint8_t ch) {
+    return (((ch * 0x80200802ULL) & 0x0884422110ULL) * 0x0101010101ULL) << 23;
+}
+
+// The spread value of every byte, so that hashing a key doesn't spend
+// two multiplications per byte.  The keys of every table on disk are
+// sharded across CPU shards by this hash, so the hash itself must
+// never change; only the way it is computed may.
+class spread_hash_table_t {
+public:
+    spread_hash_table_t() {
+        for (int i = 0; i < 256; ++i) {
+            values[i] = spread_hash_byte(i);
+        }
+    }
+    uint64_t values[256];
+};
+
 // TODO: Replace this with a real hash function, if it is not one
 // already.  It needs the property that values are uniformly
 // distributed beteween 0 and UINT64_MAX / 2, so that splitting
@@ -17,16 +38,24 @@
 uint64_t hash_region_hasher(const uint8_t *s, ssize_t len) {
     rassert(len >= 0);
 
+    // A local static, so that regions built during static initialization
+    // can't see an empty table.
+    static const spread_hash_table_t spread_hash_table;
+    const uint64_t *const values = spread_hash_table.values;
     uint64_t h = 0x47a59e381fb2dc06ULL;
-    for (ssize_t i = 0; i < len; ++i) {
-        uint8_t ch = s[i];
-
-        // By the power of magic, the 62nd, 61st, ..., 55th bits of d
-        // are equal to the 0th, 1st, 2nd, ..., 7th bits of ch.  This
-        // helps us meet the criterion specified above.
-        uint64_t d = (((ch * 0x80200802ULL) & 0x0884422110ULL) * 0x0101010101ULL) << 23;
-
-        h += d;
+    ssize_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        h += values[s[i]];
+        h = h ^ (h >> 11) ^ (h << 21);
+        h += values[s[i + 1]];
+        h = h ^ (h >> 11) ^ (h << 21);
+        h += values[s[i + 2]];
+        h = h ^ (h >> 11) ^ (h << 21);
+        h += values[s[i + 3]];
+        h = h ^ (h >> 11) ^ (h << 21);
+    }
+    for (; i < len; ++i) {
+        h += values[s[i]];
         h = h ^ (h >> 11) ^ (h << 21);
     }
 
@@ -237,6 +266,21 @@ bool region_contains_key_with_precomputed_hash(const hash_region_t<key_range_t>
 }
 
 bool region_contains_key(const hash_region_t<key_range_t> &region, const store_key_t &key) {
+    // Sharding a batch checks every key against every region, and most of
+    // the regions don't cover the key's range at all, so the hash is only
+    // worth computing once the cheaper key comparison has passed.
+    if (!region.inner.contains_key(key)) {
+        return false;
+    }
     const uint64_t hash_value = hash_region_hasher(key.contents(), key.size());
-    return region_contains_key_with_precomputed_hash(region, key, hash_value);
+    return region.beg <= hash_value && hash_value < region.end;
+}
+
+std::vector<uint64_t> hash_region_hash_keys(const std::vector<store_key_t> &keys) {
+    std::vector<uint64_t> ret;
+    ret.reserve(keys.size());
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        ret.push_back(hash_region_hasher(it->contents(), it->size()));
+    }
+    return ret;
 }
@@ -129,6 +129,11 @@ bool region_contains_key_with_precomputed_hash(const hash_region_t<key_range_t>
 
 bool region_contains_key(const hash_region_t<key_range_t> &region, const store_key_t &key);
 
+// Returns the hash_region_hasher hash of each key, in order, for requests that
+// check the same keys against many regions with
+// region_contains_key_with_precomputed_hash.
+std::vector<uint64_t> hash_region_hash_keys(const std::vector<store_key_t> &keys);
+
 template <class inner_region_t>
 bool region_overlaps(const hash_region_t<inner_region_t> &r1, const hash_region_t<inner_region_t> &r2) {
     return r1.beg < r2.end && r2.beg < r1.end
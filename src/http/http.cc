@@ -12,6 +12,7 @@
 #include <boost/algorithm/string.hpp>
 
 #include "arch/io/network.hpp"
+#include "config/args.hpp"
 #include "logger.hpp"
 #include "utils.hpp"
 
@@ -172,6 +173,7 @@ void http_res_t::set_body(const std::string& content_type, const std::string& co
         guarantee(it->key != "Content-Length");
     }
     guarantee(body.size() == 0);
+    guarantee(!body_source);
 
     add_header_line("Content-Type", content_type);
 
@@ -180,13 +182,28 @@ void http_res_t::set_body(const std::string& content_type, const std::string& co
     body = content;
 }
 
-bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
-    // Don't bother zipping anything less than 0.5k
-    size_t body_size = res->body.size();
-    if (body_size < 512) {
-        return false;
+void http_res_t::set_streamed_body(const std::string &content_type,
+                                   http_body_source_t *source) {
+    for (std::vector<header_line_t>::iterator it = header_lines.begin(); it != header_lines.end(); ++it) {
+        guarantee(it->key != "Content-Type");
+        guarantee(it->key != "Content-Length");
     }
+    guarantee(body.size() == 0);
+    guarantee(!body_source);
+
+    add_header_line("Content-Type", content_type);
+    body_source.reset(source);
+}
+
+void http_res_t::drain_body_source() {
+    guarantee(body_source);
+    while (body_source->next_chunk(HTTP_STREAMING_CHUNK_SIZE, &body)) { }
+    body_source.reset();
+    add_header_line("Content-Length", strprintf("%zu", body.size()));
+}
 
+// Returns true if the client's "Accept-Encoding" says it prefers gzip.
+static bool accepts_gzip(const http_req_t &req) {
     // See the specification for the "Accept-Encoding" header line here:
     // http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.3
     // We do not implement the entire standard, that is, we will always fallback to
@@ -274,6 +291,20 @@ bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
         return false;
     }
 
+    return true;
+}
+
+bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
+    // Don't bother zipping anything less than 0.5k
+    size_t body_size = res->body.size();
+    if (body_size < 512) {
+        return false;
+    }
+
+    if (!accepts_gzip(req)) {
+        return false;
+    }
+
     // Gzip is supported and preferred, gzip the body of the result
     scoped_array_t<char> out_buffer(body_size);
 
@@ -435,13 +466,82 @@ std::string human_readable_status(int code) {
     }
 }
 
-void write_http_msg(tcp_conn_t *conn, const http_res_t &res, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+/* Compresses a stream into gzip format a piece at a time. */
+class gzip_stream_t {
+public:
+    gzip_stream_t() : out_buffer_(HTTP_STREAMING_CHUNK_SIZE) {
+        zstream_.zalloc = Z_NULL;
+        zstream_.zfree = Z_NULL;
+        zstream_.opaque = Z_NULL;
+        // windowBits = default (15) plus 16 to use gzip encoding
+        int zres = deflateInit2(&zstream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8,
+                                Z_DEFAULT_STRATEGY);
+        guarantee(zres == Z_OK, "deflateInit2 failed: %d", zres);
+    }
+
+    ~gzip_stream_t() {
+        deflateEnd(&zstream_);
+    }
+
+    // Compresses `in`, appending whatever compressed data is ready to `*out`.  When
+    // `finish` is true, everything that's left is appended.
+    void compress(const std::string &in, bool finish, std::string *out) {
+        zstream_.next_in = reinterpret_cast<unsigned char *>(const_cast<char *>(in.data()));
+        zstream_.avail_in = in.size();
+        do {
+            zstream_.next_out = reinterpret_cast<unsigned char *>(out_buffer_.data());
+            zstream_.avail_out = out_buffer_.size();
+            int zres = deflate(&zstream_, finish ? Z_FINISH : Z_NO_FLUSH);
+            guarantee(zres != Z_STREAM_ERROR);
+            out->append(out_buffer_.data(), out_buffer_.size() - zstream_.avail_out);
+        } while (zstream_.avail_out == 0);
+        rassert(zstream_.avail_in == 0);
+    }
+
+private:
+    z_stream zstream_;
+    scoped_array_t<char> out_buffer_;
+
+    DISABLE_COPYING(gzip_stream_t);
+};
+
+/* Sends what `source` produces with chunked transfer encoding, so that neither the
+body nor its compressed form ever has to be in memory as a whole. */
+static void write_chunked_body(tcp_conn_t *conn, http_body_source_t *source, bool gzip,
+                               signal_t *closer)
+        THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+    scoped_ptr_t<gzip_stream_t> gzip_stream(gzip ? new gzip_stream_t : NULL);
+    std::string piece, chunk;
+    for (bool more = true; more;) {
+        piece.clear();
+        more = source->next_chunk(HTTP_STREAMING_CHUNK_SIZE, &piece);
+        if (gzip_stream.has()) {
+            chunk.clear();
+            gzip_stream->compress(piece, !more, &chunk);
+        } else {
+            chunk.swap(piece);
+        }
+        if (!chunk.empty()) {
+            conn->writef(closer, "%zx\r\n", chunk.size());
+            conn->write_buffered(chunk.data(), chunk.size(), closer);
+            conn->write("\r\n", 2, closer);
+        }
+    }
+    conn->write("0\r\n\r\n", 5, closer);
+}
+
+void write_http_msg(tcp_conn_t *conn, const http_res_t &res, bool gzip_body_source,
+                    signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     conn->writef(closer, "HTTP/%s %d %s\r\n", res.version.c_str(), res.code, human_readable_status(res.code).c_str());
     for (std::vector<header_line_t>::const_iterator it = res.header_lines.begin(); it != res.header_lines.end(); ++it) {
         conn->writef(closer, "%s: %s\r\n", it->key.c_str(), it->val.c_str());
     }
     conn->writef(closer, "\r\n");
-    conn->write(res.body.c_str(), res.body.size(), closer);
+    if (res.body_source) {
+        write_chunked_body(conn, res.body_source.get(), gzip_body_source, closer);
+    } else {
+        conn->write(res.body.c_str(), res.body.size(), closer);
+    }
 }
 
 void http_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn, auto_drainer_t::lock_t keepalive) {
@@ -454,14 +554,27 @@ void http_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn
     // Parse the request
     try {
         http_res_t res;
+        bool gzip_body_source = false;
         if (http_msg_parser.parse(conn.get(), &req, keepalive.get_drain_signal())) {
             application->handle(req, &res, keepalive.get_drain_signal());
             res.version = req.version;
-            maybe_gzip_response(req, &res);
+            if (res.body_source && req.version == "1.0") {
+                // HTTP/1.0 has no chunked transfer encoding
+                res.drain_body_source();
+            }
+            if (res.body_source) {
+                res.add_header_line("Transfer-Encoding", "chunked");
+                gzip_body_source = accepts_gzip(req);
+                if (gzip_body_source) {
+                    res.add_header_line("Content-Encoding", "gzip");
+                }
+            } else {
+                maybe_gzip_response(req, &res);
+            }
         } else {
             res = http_res_t(HTTP_BAD_REQUEST);
         }
-        write_http_msg(conn.get(), res, keepalive.get_drain_signal());
+        write_http_msg(conn.get(), res, gzip_body_source, keepalive.get_drain_signal());
     } catch (const interrupted_exc_t &) {
         // The query was interrupted, no response since we are shutting down
     } catch (const tcp_conn_read_closed_exc_t &) {
@@ -10,6 +10,7 @@
 #include "errors.hpp"
 #include <boost/tokenizer.hpp>
 #include <boost/shared_array.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/optional.hpp>
 
 #include "arch/types.hpp"
@@ -90,6 +91,7 @@ int content_length(const http_req_t&);
 enum http_status_code_t {
     HTTP_OK = 200,
     HTTP_NO_CONTENT = 204,
+    HTTP_NOT_MODIFIED = 304,
     HTTP_BAD_REQUEST = 400,
     HTTP_FORBIDDEN = 403,
     HTTP_NOT_FOUND = 404,
@@ -99,15 +101,33 @@ enum http_status_code_t {
     HTTP_INTERNAL_SERVER_ERROR = 500
 };
 
+/* Produces a response body a piece at a time, for bodies too big to build in memory
+all at once.  The server sends them to HTTP/1.1 clients with chunked transfer
+encoding as they're produced. */
+class http_body_source_t {
+public:
+    virtual ~http_body_source_t() { }
+
+    // Appends roughly `max_size` more bytes of the body to `*out`.  Returns false
+    // once the whole body has been produced.
+    virtual bool next_chunk(size_t max_size, std::string *out) = 0;
+};
+
 class http_res_t {
 public:
     std::string version;
     int code;
     std::vector<header_line_t> header_lines;
     std::string body;
+    // If this is set, it produces the body instead of `body`.
+    boost::shared_ptr<http_body_source_t> body_source;
 
     void add_header_line(const std::string&, const std::string&);
     void set_body(const std::string&, const std::string&);
+    // Takes ownership of `source`
+    void set_streamed_body(const std::string &content_type, http_body_source_t *source);
+    // Moves everything `body_source` produces into `body`.
+    void drain_body_source();
 
     http_res_t();
     explicit http_res_t(http_status_code_t rescode);
@@ -17,11 +17,43 @@ std::string (*cJSON_default_print)(cJSON *json) = cJSON_print_std_string;
 std::string (*cJSON_default_print)(cJSON *json) = cJSON_print_unformatted_std_string;
 #endif
 
+/* Prints a cJSON entity without any formatting, a piece at a time, so that a big
+document's text never has to be in memory all at once. */
+class cJSON_streaming_printer_t : public http_body_source_t {
+public:
+    explicit cJSON_streaming_printer_t(scoped_cJSON_t &&json);
+
+    bool next_chunk(size_t max_size, std::string *out);
+
+private:
+    // An array or object we're in the middle of printing
+    struct frame_t {
+        cJSON *container;
+        // The item to print next, or NULL if we've printed all of them
+        cJSON *next;
+        bool first;
+    };
+
+    void print_value(cJSON *item, std::string *out);
+
+    scoped_cJSON_t json_;
+    bool started_;
+    std::vector<frame_t> stack_;
+
+    DISABLE_COPYING(cJSON_streaming_printer_t);
+};
+
 void http_json_res(cJSON *json, http_res_t *result) {
     result->code = HTTP_OK;
     result->set_body("application/json", cJSON_default_print(json));
 }
 
+void http_json_res(scoped_cJSON_t *json, http_res_t *result) {
+    result->code = HTTP_OK;
+    result->set_streamed_body("application/json",
+                              new cJSON_streaming_printer_t(std::move(*json)));
+}
+
 cJSON *cJSON_merge(cJSON *lhs, cJSON *rhs) {
     guarantee(lhs->type == cJSON_Object);
     guarantee(rhs->type == cJSON_Object);
@@ -118,6 +150,61 @@ void scoped_cJSON_t::reset(cJSON *v) {
     val = v;
 }
 
+cJSON_streaming_printer_t::cJSON_streaming_printer_t(scoped_cJSON_t &&json)
+    : json_(std::move(json)), started_(false) {
+    guarantee(json_.get() != NULL);
+}
+
+bool cJSON_streaming_printer_t::next_chunk(size_t max_size, std::string *out) {
+    const size_t limit = out->size() + max_size;
+    if (!started_) {
+        started_ = true;
+        print_value(json_.get(), out);
+    }
+    while (!stack_.empty() && out->size() < limit) {
+        frame_t *frame = &stack_.back();
+        const bool is_object = frame->container->type == cJSON_Object;
+        cJSON *item = frame->next;
+        if (item == NULL) {
+            out->push_back(is_object ? '}' : ']');
+            stack_.pop_back();
+            continue;
+        }
+
+        frame->next = item->next;
+        if (!frame->first) {
+            out->push_back(',');
+        }
+        frame->first = false;
+        if (is_object) {
+            char *key = cJSON_PrintString(item->string);
+            guarantee(key);
+            out->append(key);
+            free(key);
+            out->push_back(':');
+        }
+        // This may push a frame, invalidating `frame`
+        print_value(item, out);
+    }
+    return !stack_.empty();
+}
+
+void cJSON_streaming_printer_t::print_value(cJSON *item, std::string *out) {
+    if (item->type == cJSON_Array || item->type == cJSON_Object) {
+        out->push_back(item->type == cJSON_Object ? '{' : '[');
+        frame_t frame;
+        frame.container = item;
+        frame.next = item->head;
+        frame.first = true;
+        stack_.push_back(frame);
+    } else {
+        char *s = cJSON_PrintUnformatted(item);
+        guarantee(s);
+        out->append(s);
+        free(s);
+    }
+}
+
 json_iterator_t::json_iterator_t(cJSON *target) {
     node = target->head;
 }
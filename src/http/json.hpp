@@ -10,8 +10,12 @@
 #include "containers/archive/archive.hpp"
 
 class http_res_t;
+class scoped_cJSON_t;
 
 void http_json_res(cJSON *json, http_res_t *result);
+// Takes `*json` and sends it a piece at a time as it's printed, for documents that
+// can get big.
+void http_json_res(scoped_cJSON_t *json, http_res_t *result);
 
 //TODO: do we both merge and cJSON_merge?
 //Merge two cJSON objects, crashes if there are overlapping keys
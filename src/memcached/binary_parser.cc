@@ -0,0 +1,647 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "memcached/binary_parser.hpp"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+
+#include <string>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/admission_control.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/fifo_checker.hpp"
+#include "concurrency/fifo_enforcer.hpp"
+#include "concurrency/semaphore.hpp"
+#include "containers/data_buffer.hpp"
+#include "logger.hpp"
+#include "perfmon/perfmon.hpp"
+
+namespace memcached_binary {
+
+static uint64_t decode_be(const char *bytes, size_t size) {
+    uint64_t ret = 0;
+    for (size_t i = 0; i < size; ++i) {
+        ret = (ret << 8) | static_cast<uint8_t>(bytes[i]);
+    }
+    return ret;
+}
+
+static void append_be(uint64_t value, size_t size, std::string *out) {
+    for (size_t i = size; i > 0; --i) {
+        out->push_back(static_cast<char>((value >> (8 * (i - 1))) & 0xff));
+    }
+}
+
+// Like the text protocol, expiration times of up to 30 days are relative.
+static exptime_t absolute_exptime(exptime_t exptime) {
+    if (exptime <= 60*60*24*30 && exptime > 0) {
+        exptime += time(NULL);
+    }
+    return exptime;
+}
+
+static bool is_quiet(uint8_t opcode) {
+    switch (opcode) {
+    case OP_GETQ:
+    case OP_GETKQ:
+    case OP_SETQ:
+    case OP_ADDQ:
+    case OP_REPLACEQ:
+    case OP_DELETEQ:
+    case OP_INCREMENTQ:
+    case OP_DECREMENTQ:
+    case OP_QUITQ:
+    case OP_APPENDQ:
+    case OP_PREPENDQ:
+        return true;
+    default:
+        return false;
+    }
+}
+
+struct request_t {
+    uint8_t opcode;
+    uint32_t opaque;
+    cas_t cas;
+    std::string extras;
+    // False if the key was longer than MAX_KEY_SIZE, in which case `key` is empty.
+    bool key_ok;
+    store_key_t key;
+    counted_t<data_buffer_t> value;
+};
+
+struct response_t {
+    response_t() : send(false), status(STATUS_NO_ERROR), cas(0) { }
+
+    void set_error(status_t _status, const char *message) {
+        send = true;
+        status = _status;
+        extras.clear();
+        key.clear();
+        body = message;
+        value.reset();
+    }
+
+    bool send;
+    status_t status;
+    cas_t cas;
+    std::string extras;
+    std::string key;
+    std::string body;
+    // Values fetched by gets go here instead of in `body`, so they aren't copied.
+    counted_t<data_buffer_t> value;
+};
+
+class handler_t : public home_thread_mixin_debug_only_t {
+public:
+    handler_t(memcached_interface_t *_interface,
+              namespace_interface_t<memcached_protocol_t> *_nsi,
+              int max_concurrent_queries_per_connection,
+              memcached_stats_t *_stats,
+              admission_controller_t *_admission,
+              signal_t *_interruptor)
+        : interface(_interface), nsi(_nsi), stats(_stats), admission(_admission),
+          interruptor(_interruptor),
+          requests_out_sem(max_concurrent_queries_per_connection),
+          responses_waiting(0) { }
+
+    // Handles requests until the client hangs up or sends a QUIT.
+    void serve();
+
+private:
+    // Returns false if what the client sent can't be a request.
+    bool read_request(request_t *request)
+        THROWS_ONLY(memcached_interface_t::no_more_data_exc_t);
+    void read(void *buf, size_t size)
+        THROWS_ONLY(memcached_interface_t::no_more_data_exc_t);
+
+    void handle(const request_t &request, order_token_t token,
+                fifo_enforcer_write_token_t response_token, auto_drainer_t::lock_t);
+    void write_response(const request_t &request, const response_t &response);
+
+    void perform(const request_t &request, order_token_t token, response_t *response)
+        THROWS_ONLY(cannot_perform_query_exc_t, interrupted_exc_t);
+    void perform_get(const request_t &request, order_token_t token,
+                     response_t *response);
+    void perform_store(const request_t &request, order_token_t token,
+                       response_t *response);
+    void perform_append_prepend(const request_t &request, order_token_t token,
+                                response_t *response);
+    void perform_delete(const request_t &request, order_token_t token,
+                        response_t *response);
+    void perform_incr_decr(const request_t &request, order_token_t token,
+                           response_t *response);
+
+    set_result_t write_sarc(const store_key_t &key,
+                            const counted_t<data_buffer_t> &value,
+                            mcflags_t flags, exptime_t exptime,
+                            add_policy_t add_policy, replace_policy_t replace_policy,
+                            cas_t unique, order_token_t token);
+
+    memcached_interface_t *interface;
+    namespace_interface_t<memcached_protocol_t> *nsi;
+    memcached_stats_t *stats;
+    admission_controller_t *admission;
+    signal_t *interruptor;
+
+    // Limits the number of concurrent requests
+    static_semaphore_t requests_out_sem;
+
+    // The requests are sent to the store in the order they came in...
+    order_source_t order_source;
+
+    // ...and their responses are written in that order, too.
+    fifo_enforcer_source_t response_order_source;
+    fifo_enforcer_sink_t response_order_sink;
+
+    // How many requests are done and waiting for their turn to write.  A request
+    // that's done writing only flushes the buffer if there are none, so that the
+    // responses to pipelined requests go out together.
+    int responses_waiting;
+
+    // Destroyed first, waiting for the requests' coroutines.
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(handler_t);
+};
+
+void handler_t::serve() {
+    for (;;) {
+        requests_out_sem.co_lock();
+
+        request_t request;
+        bool valid;
+        {
+            block_pm_duration read_timer(&stats->pm_conns_reading);
+            try {
+                valid = read_request(&request);
+            } catch (const memcached_interface_t::no_more_data_exc_t &) {
+                valid = false;
+            }
+        }
+        if (!valid) {
+            requests_out_sem.unlock();
+            break;
+        }
+
+        if (request.opcode == OP_QUIT || request.opcode == OP_QUITQ) {
+            // Say goodbye after everything else has been answered.
+            fifo_enforcer_sink_t::exit_write_t exiter(
+                &response_order_sink, response_order_source.enter_write());
+            exiter.wait();
+            if (request.opcode == OP_QUIT) {
+                response_t response;
+                response.send = true;
+                write_response(request, response);
+            }
+            try {
+                interface->flush_buffer(interruptor);
+            } catch (const interrupted_exc_t &) {
+                /* ignore */
+            }
+            requests_out_sem.unlock();
+            break;
+        }
+
+        const bool is_get = request.opcode == OP_GET || request.opcode == OP_GETQ
+            || request.opcode == OP_GETK || request.opcode == OP_GETKQ;
+        order_token_t token = order_source.check_in("handle_memcache_binary");
+        if (is_get) {
+            token = token.with_read_mode();
+        }
+        coro_t::spawn_now_dangerously(boost::bind(&handler_t::handle, this, request,
+                                                  token,
+                                                  response_order_source.enter_write(),
+                                                  drainer.lock()));
+    }
+}
+
+void handler_t::read(void *buf, size_t size)
+        THROWS_ONLY(memcached_interface_t::no_more_data_exc_t) {
+    if (size == 0) {
+        return;
+    }
+    try {
+        interface->read(buf, size, interruptor);
+    } catch (const interrupted_exc_t &) {
+        throw memcached_interface_t::no_more_data_exc_t();
+    }
+}
+
+bool handler_t::read_request(request_t *request)
+        THROWS_ONLY(memcached_interface_t::no_more_data_exc_t) {
+    char header[HEADER_SIZE];
+    read(header, HEADER_SIZE);
+
+    const size_t key_length = decode_be(header + 2, 2);
+    const size_t extras_length = static_cast<uint8_t>(header[4]);
+    const uint64_t body_length = decode_be(header + 8, 4);
+    if (static_cast<uint8_t>(header[0]) != REQUEST_MAGIC
+        || key_length + extras_length > body_length
+        || body_length - key_length - extras_length > MAX_VALUE_SIZE) {
+        logERR("Aborting connection %p because it sent an invalid memcached binary "
+               "protocol request", coro_t::self());
+        return false;
+    }
+
+    request->opcode = static_cast<uint8_t>(header[1]);
+    request->opaque = decode_be(header + 12, 4);
+    request->cas = decode_be(header + 16, 8);
+
+    request->extras.resize(extras_length);
+    read(&request->extras[0], extras_length);
+
+    std::string key(key_length, '\0');
+    read(&key[0], key_length);
+    request->key_ok = key_length <= MAX_KEY_SIZE;
+    if (request->key_ok) {
+        request->key = store_key_t(key);
+    }
+
+    const size_t value_length = body_length - key_length - extras_length;
+    request->value = data_buffer_t::create(value_length);
+    read(request->value->buf(), value_length);
+    return true;
+}
+
+void handler_t::handle(const request_t &request, order_token_t token,
+                       fifo_enforcer_write_token_t response_token,
+                       auto_drainer_t::lock_t) {
+    response_t response;
+    try {
+        admission_controller_t::ticket_t ticket;
+        if (admission != NULL && !ticket.admit(admission, interruptor)) {
+            response.set_error(STATUS_TEMPORARY_FAILURE, "Server overloaded");
+        } else {
+            block_pm_duration action_timer(&stats->pm_conns_acting);
+            perform(request, token, &response);
+        }
+    } catch (const cannot_perform_query_exc_t &e) {
+        response.set_error(STATUS_INTERNAL_ERROR, e.what());
+    } catch (const interrupted_exc_t &) {
+        response.send = false;
+    }
+
+    ++responses_waiting;
+    {
+        fifo_enforcer_sink_t::exit_write_t exiter(&response_order_sink, response_token);
+        exiter.wait();
+        --responses_waiting;
+
+        if (response.send) {
+            write_response(request, response);
+        }
+        if (responses_waiting == 0) {
+            block_pm_duration flush_timer(&stats->pm_conns_writing);
+            try {
+                interface->flush_buffer(interruptor);
+            } catch (const interrupted_exc_t &) {
+                /* ignore */
+            }
+        }
+    }
+
+    requests_out_sem.unlock();
+}
+
+void handler_t::write_response(const request_t &request, const response_t &response) {
+    const size_t value_size = response.value.has() ? response.value->size() : 0;
+    const size_t body_size = response.extras.size() + response.key.size()
+        + response.body.size() + value_size;
+
+    std::string header;
+    header.reserve(HEADER_SIZE + body_size - value_size);
+    header.push_back(static_cast<char>(RESPONSE_MAGIC));
+    header.push_back(static_cast<char>(request.opcode));
+    append_be(response.key.size(), 2, &header);
+    append_be(response.extras.size(), 1, &header);
+    append_be(0, 1, &header);  // The data type
+    append_be(response.status, 2, &header);
+    append_be(body_size, 4, &header);
+    append_be(request.opaque, 4, &header);
+    append_be(response.cas, 8, &header);
+    header += response.extras;
+    header += response.key;
+    header += response.body;
+
+    try {
+        if (value_size < MAX_BUFFERED_GET_SIZE) {
+            interface->write(header.data(), header.size(), interruptor);
+            if (value_size > 0) {
+                interface->write(response.value->buf(), value_size, interruptor);
+            }
+        } else {
+            iovec bufs[2];
+            bufs[0].iov_base = const_cast<char *>(header.data());
+            bufs[0].iov_len = header.size();
+            bufs[1].iov_base = response.value->buf();
+            bufs[1].iov_len = value_size;
+            interface->writev_unbuffered(bufs, 2, interruptor);
+        }
+    } catch (const interrupted_exc_t &) {
+        /* ignore */
+    }
+}
+
+void handler_t::perform(const request_t &request, order_token_t token,
+                        response_t *response)
+        THROWS_ONLY(cannot_perform_query_exc_t, interrupted_exc_t) {
+    // Quiet gets only answer hits and other quiet commands only answer failures;
+    // the `perform_*()` functions take care of that.
+    response->send = !is_quiet(request.opcode);
+
+    const size_t extras_size = request.extras.size();
+    const bool has_key = request.key.size() > 0;
+    const bool has_value = request.value->size() > 0;
+    if (!request.key_ok) {
+        response->set_error(STATUS_INVALID_ARGUMENTS, "Invalid arguments");
+        return;
+    }
+
+    switch (request.opcode) {
+    case OP_GET:
+    case OP_GETQ:
+    case OP_GETK:
+    case OP_GETKQ:
+        if (extras_size != 0 || !has_key || has_value) {
+            response->set_error(STATUS_INVALID_ARGUMENTS, "Invalid arguments");
+        } else {
+            perform_get(request, token, response);
+        }
+        break;
+    case OP_SET:
+    case OP_SETQ:
+    case OP_ADD:
+    case OP_ADDQ:
+    case OP_REPLACE:
+    case OP_REPLACEQ:
+        if (extras_size != 8 || !has_key) {
+            response->set_error(STATUS_INVALID_ARGUMENTS, "Invalid arguments");
+        } else {
+            perform_store(request, token, response);
+        }
+        break;
+    case OP_APPEND:
+    case OP_APPENDQ:
+    case OP_PREPEND:
+    case OP_PREPENDQ:
+        if (extras_size != 0 || !has_key) {
+            response->set_error(STATUS_INVALID_ARGUMENTS, "Invalid arguments");
+        } else {
+            perform_append_prepend(request, token, response);
+        }
+        break;
+    case OP_DELETE:
+    case OP_DELETEQ:
+        if (extras_size != 0 || !has_key || has_value) {
+            response->set_error(STATUS_INVALID_ARGUMENTS, "Invalid arguments");
+        } else {
+            perform_delete(request, token, response);
+        }
+        break;
+    case OP_INCREMENT:
+    case OP_INCREMENTQ:
+    case OP_DECREMENT:
+    case OP_DECREMENTQ:
+        if (extras_size != 20 || !has_key || has_value) {
+            response->set_error(STATUS_INVALID_ARGUMENTS, "Invalid arguments");
+        } else {
+            perform_incr_decr(request, token, response);
+        }
+        break;
+    case OP_NOOP:
+        break;
+    case OP_VERSION:
+        response->body = std::string("rethinkdb-") + RETHINKDB_VERSION;
+        break;
+    default:
+        response->set_error(STATUS_UNKNOWN_COMMAND, "Unknown command");
+        break;
+    }
+}
+
+void handler_t::perform_get(const request_t &request, order_token_t token,
+                            response_t *response) {
+    block_pm_duration get_timer(&stats->pm_cmd_get);
+    stats->pm_get_key_size.record(request.key.size());
+
+    // Gets are plain reads, so they don't assign CAS values the way the text
+    // protocol's "gets" does; the response's CAS is whatever the value has (0 if it
+    // never had one).
+    get_query_t get_query(request.key);
+    memcached_protocol_t::read_t read(get_query, time(NULL));
+    memcached_protocol_t::read_response_t read_response;
+    nsi->read(read, &read_response, token, interruptor);
+    get_result_t result = boost::get<get_result_t>(read_response.result);
+
+    if (!result.value.has()) {
+        if (response->send) {
+            response->set_error(STATUS_KEY_NOT_FOUND, "Not found");
+        }
+        return;
+    }
+
+    response->send = true;
+    response->cas = result.cas;
+    append_be(result.flags, 4, &response->extras);
+    if (request.opcode == OP_GETK || request.opcode == OP_GETKQ) {
+        response->key.assign(reinterpret_cast<const char *>(request.key.contents()),
+                             request.key.size());
+    }
+    response->value = result.value;
+}
+
+set_result_t handler_t::write_sarc(const store_key_t &key,
+                                   const counted_t<data_buffer_t> &value,
+                                   mcflags_t flags, exptime_t exptime,
+                                   add_policy_t add_policy,
+                                   replace_policy_t replace_policy,
+                                   cas_t unique, order_token_t token) {
+    sarc_mutation_t sarc_mutation(key, value, flags, exptime,
+                                  add_policy, replace_policy, unique);
+    memcached_protocol_t::write_t write(sarc_mutation, random(), time(NULL));
+    memcached_protocol_t::write_response_t write_response;
+    nsi->write(write, &write_response, token, interruptor);
+    return boost::get<set_result_t>(write_response.result);
+}
+
+void handler_t::perform_store(const request_t &request, order_token_t token,
+                              response_t *response) {
+    block_pm_duration set_timer(&stats->pm_cmd_set);
+    stats->pm_storage_key_size.record(request.key.size());
+    stats->pm_storage_value_size.record(request.value->size());
+
+    const mcflags_t flags = decode_be(request.extras.data(), 4);
+    const exptime_t exptime = absolute_exptime(decode_be(request.extras.data() + 4, 4));
+
+    add_policy_t add_policy;
+    replace_policy_t replace_policy;
+    cas_t unique = NO_CAS_SUPPLIED;
+    switch (request.opcode) {
+    case OP_SET:
+    case OP_SETQ:
+        add_policy = add_policy_yes;
+        replace_policy = replace_policy_yes;
+        break;
+    case OP_ADD:
+    case OP_ADDQ:
+        add_policy = add_policy_yes;
+        replace_policy = replace_policy_no;
+        break;
+    case OP_REPLACE:
+    case OP_REPLACEQ:
+        add_policy = add_policy_no;
+        replace_policy = replace_policy_yes;
+        break;
+    default:
+        unreachable();
+    }
+    if (request.cas != 0 && replace_policy == replace_policy_yes) {
+        // Like the text protocol's "cas"
+        add_policy = add_policy_no;
+        replace_policy = replace_policy_if_cas_matches;
+        unique = request.cas;
+    }
+
+    switch (write_sarc(request.key, request.value, flags, exptime,
+                       add_policy, replace_policy, unique, token)) {
+    case sr_stored:
+        response->send = !is_quiet(request.opcode);
+        break;
+    case sr_didnt_add:
+        response->set_error(STATUS_KEY_NOT_FOUND, "Not found");
+        break;
+    case sr_didnt_replace:
+        response->set_error(STATUS_KEY_EXISTS, "Data exists for key.");
+        break;
+    case sr_too_large:
+        response->set_error(STATUS_VALUE_TOO_LARGE, "Too large.");
+        break;
+    default:
+        unreachable();
+    }
+}
+
+void handler_t::perform_append_prepend(const request_t &request, order_token_t token,
+                                       response_t *response) {
+    block_pm_duration set_timer(&stats->pm_cmd_set);
+    stats->pm_storage_key_size.record(request.key.size());
+    stats->pm_storage_value_size.record(request.value->size());
+
+    const bool append = request.opcode == OP_APPEND || request.opcode == OP_APPENDQ;
+    append_prepend_mutation_t append_prepend_mutation(
+        append ? append_prepend_APPEND : append_prepend_PREPEND,
+        request.key, request.value);
+    memcached_protocol_t::write_t write(append_prepend_mutation, random(), time(NULL));
+    memcached_protocol_t::write_response_t write_response;
+    nsi->write(write, &write_response, token, interruptor);
+
+    switch (boost::get<append_prepend_result_t>(write_response.result)) {
+    case apr_success:
+        break;
+    case apr_not_found:
+        response->set_error(STATUS_ITEM_NOT_STORED, "Not stored.");
+        break;
+    case apr_too_large:
+        response->set_error(STATUS_VALUE_TOO_LARGE, "Too large.");
+        break;
+    default:
+        unreachable();
+    }
+}
+
+void handler_t::perform_delete(const request_t &request, order_token_t token,
+                               response_t *response) {
+    block_pm_duration set_timer(&stats->pm_cmd_set);
+    stats->pm_delete_key_size.record(request.key.size());
+
+    delete_mutation_t delete_mutation(request.key, false);
+    memcached_protocol_t::write_t write(delete_mutation, INVALID_CAS, time(NULL));
+    memcached_protocol_t::write_response_t write_response;
+    nsi->write(write, &write_response, token, interruptor);
+
+    switch (boost::get<delete_result_t>(write_response.result)) {
+    case dr_deleted:
+        break;
+    case dr_not_found:
+        response->set_error(STATUS_KEY_NOT_FOUND, "Not found");
+        break;
+    default:
+        unreachable();
+    }
+}
+
+void handler_t::perform_incr_decr(const request_t &request, order_token_t token,
+                                  response_t *response) {
+    block_pm_duration set_timer(&stats->pm_cmd_set);
+
+    const bool incr = request.opcode == OP_INCREMENT
+        || request.opcode == OP_INCREMENTQ;
+    const uint64_t amount = decode_be(request.extras.data(), 8);
+    const uint64_t initial = decode_be(request.extras.data() + 8, 8);
+    const uint32_t exptime = decode_be(request.extras.data() + 16, 4);
+
+    // If the key doesn't exist, we create it with the initial value, unless the
+    // expiration time is all ones.  If somebody else creates it first, we try once
+    // more to change theirs.  Those extra writes come after later requests'
+    // writes were sent, so they don't take part in the order checking.
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        incr_decr_mutation_t incr_decr_mutation(incr ? incr_decr_INCR : incr_decr_DECR,
+                                                request.key, amount);
+        memcached_protocol_t::write_t write(incr_decr_mutation, random(), time(NULL));
+        memcached_protocol_t::write_response_t write_response;
+        nsi->write(write, &write_response,
+                   attempt == 0 ? token : order_token_t::ignore, interruptor);
+        incr_decr_result_t result =
+            boost::get<incr_decr_result_t>(write_response.result);
+
+        switch (result.res) {
+        case incr_decr_result_t::idr_success:
+            append_be(result.new_value, 8, &response->body);
+            return;
+        case incr_decr_result_t::idr_not_numeric:
+            response->set_error(STATUS_NON_NUMERIC_VALUE,
+                                "Non-numeric server-side value for incr or decr");
+            return;
+        case incr_decr_result_t::idr_not_found:
+            break;
+        default:
+            unreachable();
+        }
+
+        if (exptime == UINT32_MAX) {
+            break;
+        }
+        const std::string initial_str = strprintf("%" PRIu64, initial);
+        counted_t<data_buffer_t> initial_value =
+            data_buffer_t::create(initial_str.size());
+        memcpy(initial_value->buf(), initial_str.data(), initial_str.size());
+        if (write_sarc(request.key, initial_value, 0, absolute_exptime(exptime),
+                       add_policy_yes, replace_policy_no, NO_CAS_SUPPLIED,
+                       order_token_t::ignore) == sr_stored) {
+            append_be(initial, 8, &response->body);
+            return;
+        }
+    }
+    response->set_error(STATUS_KEY_NOT_FOUND, "Not found");
+}
+
+}  // namespace memcached_binary
+
+void handle_memcache_binary(memcached_interface_t *interface,
+                            namespace_interface_t<memcached_protocol_t> *nsi,
+                            int max_concurrent_queries_per_connection,
+                            memcached_stats_t *stats,
+                            admission_controller_t *admission,
+                            signal_t *interruptor) {
+    memcached_binary::handler_t handler(interface, nsi,
+                                        max_concurrent_queries_per_connection,
+                                        stats, admission, interruptor);
+    handler.serve();
+}
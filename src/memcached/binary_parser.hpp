@@ -0,0 +1,77 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef MEMCACHED_BINARY_PARSER_HPP_
+#define MEMCACHED_BINARY_PARSER_HPP_
+
+#include <stdint.h>
+
+#include "memcached/parser.hpp"
+
+/* The memcached binary protocol frames every request and response with a fixed-size
+header, so there's nothing to tokenize and numbers go over the wire as (big-endian)
+integers.  A client that speaks it starts every request with `REQUEST_MAGIC`, which is
+how `handle_memcache()` tells it from a text protocol client. */
+class admission_controller_t;
+
+namespace memcached_binary {
+
+const uint8_t REQUEST_MAGIC = 0x80;
+const uint8_t RESPONSE_MAGIC = 0x81;
+const size_t HEADER_SIZE = 24;
+
+enum opcode_t {
+    OP_GET = 0x00,
+    OP_SET = 0x01,
+    OP_ADD = 0x02,
+    OP_REPLACE = 0x03,
+    OP_DELETE = 0x04,
+    OP_INCREMENT = 0x05,
+    OP_DECREMENT = 0x06,
+    OP_QUIT = 0x07,
+    OP_GETQ = 0x09,
+    OP_NOOP = 0x0a,
+    OP_VERSION = 0x0b,
+    OP_GETK = 0x0c,
+    OP_GETKQ = 0x0d,
+    OP_APPEND = 0x0e,
+    OP_PREPEND = 0x0f,
+    OP_SETQ = 0x11,
+    OP_ADDQ = 0x12,
+    OP_REPLACEQ = 0x13,
+    OP_DELETEQ = 0x14,
+    OP_INCREMENTQ = 0x15,
+    OP_DECREMENTQ = 0x16,
+    OP_QUITQ = 0x17,
+    OP_APPENDQ = 0x19,
+    OP_PREPENDQ = 0x1a
+};
+
+enum status_t {
+    STATUS_NO_ERROR = 0x0000,
+    STATUS_KEY_NOT_FOUND = 0x0001,
+    STATUS_KEY_EXISTS = 0x0002,
+    STATUS_VALUE_TOO_LARGE = 0x0003,
+    STATUS_INVALID_ARGUMENTS = 0x0004,
+    STATUS_ITEM_NOT_STORED = 0x0005,
+    STATUS_NON_NUMERIC_VALUE = 0x0006,
+    STATUS_UNKNOWN_COMMAND = 0x0081,
+    STATUS_INTERNAL_ERROR = 0x0084,
+    STATUS_TEMPORARY_FAILURE = 0x0086
+};
+
+}  // namespace memcached_binary
+
+/* Handles binary protocol requests from `interface` like `handle_memcache()` does
+text protocol ones: requests are carried out concurrently (up to
+`max_concurrent_queries_per_connection` at a time) and answered in order.  The quiet
+variants of the commands only send a response if something went wrong (or, for the
+quiet gets, if the key was found), so a client can send a run of them followed by a
+NOOP and get all the answers back in one go.  Requests that `admission` (if it isn't
+NULL) doesn't admit get a temporary failure. */
+void handle_memcache_binary(memcached_interface_t *interface,
+                            namespace_interface_t<memcached_protocol_t> *nsi,
+                            int max_concurrent_queries_per_connection,
+                            memcached_stats_t *stats,
+                            admission_controller_t *admission,
+                            signal_t *interruptor);
+
+#endif  // MEMCACHED_BINARY_PARSER_HPP_
@@ -21,9 +21,10 @@ public:
 
     /* We throw away the responses */
     void write(UNUSED const char *buffer, UNUSED size_t bytes, UNUSED signal_t *interruptor) { }
-    void write_unbuffered(UNUSED const char *buffer, UNUSED size_t bytes, UNUSED signal_t *interruptor) { }
+    void writev_unbuffered(UNUSED const iovec *bufs, UNUSED size_t count, UNUSED signal_t *interruptor) { }
     void flush_buffer(UNUSED signal_t *interruptor) { }
     bool is_write_open() { return false; }
+    void close() { }
 
     void read(void *buf, size_t nbytes, signal_t *interruptor) {
         if (interruptor->is_pulsed()) throw no_more_data_exc_t();
@@ -48,6 +49,14 @@ public:
         //we didn't every find a crlf unleash the exception
         if (*head) throw no_more_data_exc_t();
     }
+
+    uint8_t peek_byte(signal_t *interruptor) {
+        if (interruptor->is_pulsed()) throw no_more_data_exc_t();
+        int c = getc(file);
+        if (c == EOF) throw no_more_data_exc_t();
+        ungetc(c, file);
+        return c;
+    }
 };
 
 void import_memcache(const char *filename, namespace_interface_t<memcached_protocol_t> *nsi, signal_t *interrupter) {
@@ -56,5 +65,5 @@ void import_memcache(const char *filename, namespace_interface_t<memcached_proto
 
     file_memcached_interface_t interface(filename);
 
-    handle_memcache(&interface, nsi, MAX_CONCURRENT_QUEURIES_ON_IMPORT, NULL, interrupter);
+    handle_memcache(&interface, nsi, MAX_CONCURRENT_QUEURIES_ON_IMPORT, NULL, NULL, interrupter);
 }
@@ -12,22 +12,28 @@
 
 class agnostic_memcached_backfill_callback_t : public agnostic_backfill_callback_t {
 public:
-    agnostic_memcached_backfill_callback_t(backfill_callback_t *cb, const key_range_t &kr) : cb_(cb), kr_(kr) { }
+    agnostic_memcached_backfill_callback_t(backfill_callback_t *cb, const hash_region_t<key_range_t> &region) : cb_(cb), region_(region) { }
 
     void on_delete_range(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
-        rassert(kr_.is_superset(range));
-        cb_->on_delete_range(range, interruptor);
+        rassert(region_.inner.is_superset(range));
+        cb_->on_delete_range(hash_region_t<key_range_t>(region_.beg, region_.end, range), interruptor);
     }
 
     void on_deletion(const btree_key_t *key, repli_timestamp_t recency, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
-        rassert(kr_.contains_key(key->contents, key->size));
+        rassert(region_.inner.contains_key(key->contents, key->size));
+        if (!has_our_hash(key)) {
+            return;
+        }
         cb_->on_deletion(key, recency, interruptor);
     }
 
     void on_pair(buf_parent_t parent, repli_timestamp_t recency,
                  const btree_key_t *key, const void *val,
                  signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
-        rassert(kr_.contains_key(key->contents, key->size));
+        rassert(region_.inner.contains_key(key->contents, key->size));
+        if (!has_our_hash(key)) {
+            return;
+        }
         const memcached_value_t *value = static_cast<const memcached_value_t *>(val);
         counted_t<data_buffer_t> data_provider = value_to_data_buffer(value, parent);
         backfill_atom_t atom;
@@ -47,19 +53,30 @@ public:
         //tests to work.
     }
 
+    void on_progress(const key_range_t &sent_range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        rassert(region_.inner.is_superset(sent_range));
+        cb_->on_progress(hash_region_t<key_range_t>(region_.beg, region_.end, sent_range), interruptor);
+    }
+
+    // The traversal only knows about key ranges, so it finds the keys of every hash.
+    bool has_our_hash(const btree_key_t *key) const {
+        const uint64_t h = hash_region_hasher(key->contents, key->size);
+        return region_.beg <= h && h < region_.end;
+    }
+
     backfill_callback_t *cb_;
-    key_range_t kr_;
+    hash_region_t<key_range_t> region_;
 };
 
-void memcached_backfill(const key_range_t& key_range,
+void memcached_backfill(const hash_region_t<key_range_t> &region,
                         repli_timestamp_t since_when, backfill_callback_t *callback,
                         superblock_t *superblock,
                         buf_lock_t *sindex_block,
                         parallel_traversal_progress_t *p,
                         signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
-    agnostic_memcached_backfill_callback_t agnostic_cb(callback, key_range);
+    agnostic_memcached_backfill_callback_t agnostic_cb(callback, region);
     value_sizer_t<memcached_value_t> sizer(superblock->cache()->get_block_size());
-    do_agnostic_btree_backfill(&sizer, key_range, since_when,
+    do_agnostic_btree_backfill(&sizer, region.inner, since_when,
                                &agnostic_cb, superblock, sindex_block, p,
                                interruptor);
 }
@@ -43,14 +43,17 @@ void debug_print(printf_buffer_t *buf, const backfill_atom_t& atom);
 // on_keyvalue calls for keys within that range.
 class backfill_callback_t {
 public:
-    virtual void on_delete_range(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
+    virtual void on_delete_range(const hash_region_t<key_range_t> &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
     virtual void on_deletion(const btree_key_t *key, repli_timestamp_t recency, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
     virtual void on_keyvalue(const backfill_atom_t& atom, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
+    // Everything in `sent_region` has already been passed to the other methods.
+    virtual void on_progress(const hash_region_t<key_range_t> &sent_region, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
 protected:
     virtual ~backfill_callback_t() { }
 };
 
-void memcached_backfill(const key_range_t& key_range,
+// Only sends the keys whose hashes are in `region`.
+void memcached_backfill(const hash_region_t<key_range_t> &region,
                         repli_timestamp_t since_when,
                         backfill_callback_t *callback,
                         superblock_t *superblock,
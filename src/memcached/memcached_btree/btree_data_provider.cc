@@ -9,15 +9,22 @@
 
 counted_t<data_buffer_t> value_to_data_buffer(const memcached_value_t *value,
                                               buf_parent_t parent) {
+    return value_to_data_buffer(value, parent, 0, value->value_size());
+}
+
+counted_t<data_buffer_t> value_to_data_buffer(const memcached_value_t *value,
+                                              buf_parent_t parent,
+                                              int64_t offset, int64_t size) {
     parent.cache()->assert_thread();
 
     blob_t blob(parent.cache()->get_block_size(),
                 const_cast<memcached_value_t *>(value)->value_ref(),
                 blob::btree_maxreflen);
+    rassert(offset >= 0 && size >= 0 && offset + size <= blob.valuesize());
 
     buffer_group_t group;
     blob_acq_t acqs;
-    blob.expose_region(parent, access_t::read, 0, blob.valuesize(), &group, &acqs);
+    blob.expose_region(parent, access_t::read, offset, size, &group, &acqs);
     size_t sz = group.get_size();
     counted_t<data_buffer_t> ret = data_buffer_t::create(sz);
     buffer_group_t tmp;
@@ -12,4 +12,10 @@ struct data_buffer_t;
 counted_t<data_buffer_t> value_to_data_buffer(const memcached_value_t *value,
                                               buf_parent_t parent);
 
+// Copies just `size` bytes of the value, starting at `offset`, which only acquires
+// the blocks that hold them.
+counted_t<data_buffer_t> value_to_data_buffer(const memcached_value_t *value,
+                                              buf_parent_t parent,
+                                              int64_t offset, int64_t size);
+
 #endif // MEMCACHED_MEMCACHED_BTREE_BTREE_DATA_PROVIDER_HPP_
@@ -1,16 +1,30 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "memcached/memcached_btree/get.hpp"
 
+#include <algorithm>
+
 #include "btree/internal_node.hpp"
 #include "btree/leaf_node.hpp"
 #include "btree/operations.hpp"
 #include "memcached/memcached_btree/btree_data_provider.hpp"
+#include "memcached/memcached_btree/hot_cache.hpp"
 #include "memcached/memcached_btree/node.hpp"
 #include "memcached/memcached_btree/value.hpp"
 
 get_result_t memcached_get(const store_key_t &store_key,
+                           int64_t offset, int64_t chunk_size,
                            btree_slice_t *slice, exptime_t effective_time,
                            superblock_t *superblock) {
+    // The hot cache only has whole values.
+    memcached_hot_cache_t *hot_cache = offset == 0 ? memcached_hot_cache_t::get() : NULL;
+    uint64_t hot_cache_generation = 0;
+    if (hot_cache != NULL) {
+        get_result_t result;
+        if (hot_cache->find(slice, store_key, effective_time,
+                            &result, &hot_cache_generation)) {
+            return result;
+        }
+    }
 
     keyvalue_location_t<memcached_value_t> kv_location;
     find_keyvalue_location_for_read(superblock, store_key.btree_key(),
@@ -26,11 +40,27 @@ get_result_t memcached_get(const store_key_t &store_key,
         return get_result_t();
     }
 
+    const cas_t cas = value->has_cas() ? value->cas() : 0;
+    const int64_t value_size = value->value_size();
+    if (chunk_size > 0 && (offset > 0 || (cas != 0 && value_size > chunk_size))) {
+        const int64_t begin = std::min(offset, value_size);
+        const int64_t end = std::min(begin + chunk_size, value_size);
+        counted_t<data_buffer_t> dp
+            = value_to_data_buffer(value, buf_parent_t(&kv_location.buf),
+                                   begin, end - begin);
+        return get_result_t(dp, value->mcflags(), cas, value_size);
+    }
+
     // KSI: We could make this more efficient -- by releasing the leaf node while we
     // acquire blobs as children of this.
     counted_t<data_buffer_t> dp
         = value_to_data_buffer(value, buf_parent_t(&kv_location.buf));
 
-    return get_result_t(dp, value->mcflags(), 0);
+    get_result_t result(dp, value->mcflags(), cas);
+    if (hot_cache != NULL) {
+        hot_cache->insert(slice, store_key, result, value->exptime(),
+                          hot_cache_generation);
+    }
+    return result;
 }
 
@@ -8,7 +8,10 @@
 class btree_slice_t;
 class superblock_t;
 
-get_result_t memcached_get(const store_key_t &key, btree_slice_t *slice,
+// See `get_query_t` for `offset` and `chunk_size`.
+get_result_t memcached_get(const store_key_t &key,
+                           int64_t offset, int64_t chunk_size,
+                           btree_slice_t *slice,
                            exptime_t effective_time, superblock_t *superblock);
 
 #endif // MEMCACHED_MEMCACHED_BTREE_GET_HPP_
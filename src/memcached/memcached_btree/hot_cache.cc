@@ -0,0 +1,121 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "memcached/memcached_btree/hot_cache.hpp"
+
+#include "config/args.hpp"
+#include "containers/data_buffer.hpp"
+#include "thread_local.hpp"
+
+TLS_with_init(memcached_hot_cache_t *, memcached_hot_cache, NULL);
+
+// Kept apart from the cache, so that a read that looked in a cache that has since
+// been freed can't match the generation of the one that replaced it.
+TLS_with_init(uint64_t, memcached_hot_cache_generation, 0);
+
+memcached_hot_cache_t::memcached_hot_cache_t(size_t max_size)
+    : max_size_(max_size), size_(0) { }
+
+memcached_hot_cache_t::~memcached_hot_cache_t() {
+    assert_thread();
+    while (!entries_.empty()) {
+        remove(entries_.begin());
+    }
+}
+
+memcached_hot_cache_t *memcached_hot_cache_t::get() {
+    if (MEMCACHED_HOT_CACHE_SIZE == 0) {
+        return NULL;
+    }
+    memcached_hot_cache_t *cache = TLS_get_memcached_hot_cache();
+    if (cache == NULL) {
+        cache = new memcached_hot_cache_t(MEMCACHED_HOT_CACHE_SIZE);
+        TLS_set_memcached_hot_cache(cache);
+    }
+    return cache;
+}
+
+void memcached_hot_cache_t::forget_slice(btree_slice_t *slice) {
+    memcached_hot_cache_t *cache = TLS_get_memcached_hot_cache();
+    if (cache == NULL) {
+        return;
+    }
+    cache->invalidate_slice(slice);
+    if (cache->entries_.empty()) {
+        TLS_set_memcached_hot_cache(NULL);
+        delete cache;
+    }
+}
+
+bool memcached_hot_cache_t::find(btree_slice_t *slice, const store_key_t &key,
+                                 exptime_t effective_time, get_result_t *result_out,
+                                 uint64_t *generation_out) {
+    assert_thread();
+    auto it = entries_.find(entry_key_t(slice, key));
+    if (it != entries_.end()) {
+        entry_t *entry = it->second;
+        if (entry->exptime == 0 || effective_time < entry->exptime) {
+            lru_.remove(entry);
+            lru_.push_front(entry);
+            *result_out = entry->result;
+            return true;
+        }
+        remove(it);
+    }
+    *generation_out = TLS_get_memcached_hot_cache_generation();
+    return false;
+}
+
+void memcached_hot_cache_t::insert(btree_slice_t *slice, const store_key_t &key,
+                                   const get_result_t &result, exptime_t exptime,
+                                   uint64_t generation) {
+    assert_thread();
+    guarantee(result.value.has());
+    if (generation != TLS_get_memcached_hot_cache_generation()
+        || result.value->size() > MEMCACHED_HOT_CACHE_MAX_VALUE_SIZE) {
+        return;
+    }
+
+    const entry_key_t entry_key(slice, key);
+    auto it = entries_.find(entry_key);
+    if (it != entries_.end()) {
+        remove(it);
+    }
+
+    entry_t *entry = new entry_t;
+    entry->key = entry_key;
+    entry->result = result;
+    entry->exptime = exptime;
+    entry->size = sizeof(entry_t) + key.size() + result.value->size();
+    entries_.insert(std::make_pair(entry_key, entry));
+    lru_.push_front(entry);
+    size_ += entry->size;
+
+    while (size_ > max_size_) {
+        remove(entries_.find(lru_.tail()->key));
+    }
+}
+
+void memcached_hot_cache_t::invalidate(btree_slice_t *slice, const store_key_t &key) {
+    assert_thread();
+    TLS_set_memcached_hot_cache_generation(TLS_get_memcached_hot_cache_generation() + 1);
+    auto it = entries_.find(entry_key_t(slice, key));
+    if (it != entries_.end()) {
+        remove(it);
+    }
+}
+
+void memcached_hot_cache_t::invalidate_slice(btree_slice_t *slice) {
+    assert_thread();
+    TLS_set_memcached_hot_cache_generation(TLS_get_memcached_hot_cache_generation() + 1);
+    auto it = entries_.lower_bound(entry_key_t(slice, store_key_t::min()));
+    while (it != entries_.end() && it->first.first == slice) {
+        remove(it++);
+    }
+}
+
+void memcached_hot_cache_t::remove(std::map<entry_key_t, entry_t *>::iterator it) {
+    entry_t *entry = it->second;
+    lru_.remove(entry);
+    size_ -= entry->size;
+    entries_.erase(it);
+    delete entry;
+}
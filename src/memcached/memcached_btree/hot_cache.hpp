@@ -0,0 +1,79 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef MEMCACHED_MEMCACHED_BTREE_HOT_CACHE_HPP_
+#define MEMCACHED_MEMCACHED_BTREE_HOT_CACHE_HPP_
+
+#include <map>
+#include <utility>
+
+#include "btree/keys.hpp"
+#include "containers/intrusive_list.hpp"
+#include "memcached/queries.hpp"
+
+class btree_slice_t;
+
+/* Small values that memcached gets have recently read, so that reading them again
+doesn't have to walk down the btree and lock its blocks.  Each thread has its own
+cache, shared by the btrees on that thread and limited to `MEMCACHED_HOT_CACHE_SIZE`
+bytes; the least recently read values are dropped first.
+
+A write to a key drops its value while the write still holds the superblock for
+write, so any read that gets the superblock after it doesn't find the old value.
+A read that got the superblock before it may still be carrying the old value back
+from the btree, though.  So every drop bumps a generation number, and a read only
+records what it found if the generation hasn't changed since it looked in the
+cache. */
+class memcached_hot_cache_t : public home_thread_mixin_debug_only_t {
+public:
+    explicit memcached_hot_cache_t(size_t max_size);
+    ~memcached_hot_cache_t();
+
+    // Returns the calling thread's cache, or NULL if `MEMCACHED_HOT_CACHE_SIZE` is
+    // zero.
+    static memcached_hot_cache_t *get();
+
+    // Drops `slice`'s values from the calling thread's cache, and frees the cache if
+    // that leaves it empty.  Called when the slice is going away.
+    static void forget_slice(btree_slice_t *slice);
+
+    // Returns true and sets `*result_out` if `key`'s value is cached and hasn't
+    // expired.  Otherwise sets `*generation_out` for passing to `insert()`.
+    bool find(btree_slice_t *slice, const store_key_t &key, exptime_t effective_time,
+              get_result_t *result_out, uint64_t *generation_out);
+
+    // Records what a read found, unless the value is too big or something has been
+    // dropped since the read called `find()`.
+    void insert(btree_slice_t *slice, const store_key_t &key,
+                const get_result_t &result, exptime_t exptime, uint64_t generation);
+
+    // Called by writes to `key`, while they hold the superblock for write.
+    void invalidate(btree_slice_t *slice, const store_key_t &key);
+
+    // Called by anything that may change many of `slice`'s keys at once.
+    void invalidate_slice(btree_slice_t *slice);
+
+    size_t num_entries() const { return entries_.size(); }
+    size_t size() const { return size_; }
+
+private:
+    typedef std::pair<btree_slice_t *, store_key_t> entry_key_t;
+
+    struct entry_t : public intrusive_list_node_t<entry_t> {
+        entry_key_t key;
+        get_result_t result;
+        exptime_t exptime;
+        size_t size;
+    };
+
+    void remove(std::map<entry_key_t, entry_t *>::iterator it);
+
+    const size_t max_size_;
+
+    std::map<entry_key_t, entry_t *> entries_;
+    // Most recently read at the front
+    intrusive_list_t<entry_t> lru_;
+    size_t size_;
+
+    DISABLE_COPYING(memcached_hot_cache_t);
+};
+
+#endif  // MEMCACHED_MEMCACHED_BTREE_HOT_CACHE_HPP_
@@ -7,12 +7,20 @@
 #include "btree/leaf_node.hpp"
 #include "btree/operations.hpp"
 #include "btree/slice.hpp"
+#include "memcached/memcached_btree/hot_cache.hpp"
 
 void run_memcached_modify_oper(memcached_modify_oper_t *oper, btree_slice_t *slice,
                                const store_key_t &store_key, cas_t proposed_cas,
                                exptime_t effective_time, repli_timestamp_t timestamp,
                                superblock_t *superblock) {
 
+    // Every memcached write (set, delete, incr/decr, append/prepend, and gets'
+    // CAS assignment) comes through here.
+    memcached_hot_cache_t *hot_cache = memcached_hot_cache_t::get();
+    if (hot_cache != NULL) {
+        hot_cache->invalidate(slice, store_key);
+    }
+
     block_size_t block_size = slice->cache()->get_block_size();
 
     keyvalue_location_t<memcached_value_t> kv_location;
@@ -13,9 +13,11 @@ struct memcached_set_oper_t : public memcached_modify_oper_t {
                          exptime_t _exptime,
                          add_policy_t ap,
                          replace_policy_t rp,
-                         cas_t _req_cas)
+                         cas_t _req_cas,
+                         bool _can_add_cas)
         : data(_data), mcflags(_mcflags), exptime(_exptime),
-          add_policy(ap), replace_policy(rp), req_cas(_req_cas) { }
+          add_policy(ap), replace_policy(rp), req_cas(_req_cas),
+          can_add_cas(_can_add_cas) { }
 
     ~memcached_set_oper_t() { }
 
@@ -72,7 +74,11 @@ struct memcached_set_oper_t : public memcached_modify_oper_t {
 
         {
             scoped_malloc_t<memcached_value_t> tmp(MAX_MEMCACHED_VALUE_SIZE);
-            if ((*value)->has_cas()) {
+            // Values that gets stream in chunks need a CAS, so that the chunks can
+            // be checked against each other.
+            const bool streamed = can_add_cas
+                && data->size() > MEMCACHED_STREAMING_CHUNK_SIZE;
+            if ((*value)->has_cas() || streamed) {
                 // run_memcached_modify_oper will set an actual CAS later.
                 metadata_write(&tmp->metadata_flags, tmp->contents, mcflags, exptime, 0xCA5ADDED);
             } else {
@@ -116,6 +122,8 @@ struct memcached_set_oper_t : public memcached_modify_oper_t {
     add_policy_t add_policy;
     replace_policy_t replace_policy;
     cas_t req_cas;
+    // False if there's no proposed CAS to give the value
+    bool can_add_cas;
 
     set_result_t result;
 };
@@ -133,7 +141,8 @@ set_result_t memcached_set(const store_key_t &key,
                            repli_timestamp_t timestamp,
                            superblock_t *superblock) {
     memcached_set_oper_t oper(data, mcflags, exptime, add_policy, replace_policy,
-                              req_cas);
+                              req_cas,
+                              proposed_cas != BTREE_MODIFY_OPER_DUMMY_PROPOSED_CAS);
     run_memcached_modify_oper(&oper, slice, key, proposed_cas, effective_time,
                               timestamp, superblock);
     return oper.result;
@@ -3,6 +3,7 @@
 
 #include <inttypes.h>
 #include <stdarg.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <set>
@@ -12,6 +13,7 @@
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
+#include "concurrency/admission_control.hpp"
 #include "concurrency/coro_fifo.hpp"
 #include "concurrency/mutex.hpp"
 #include "concurrency/semaphore.hpp"
@@ -25,6 +27,7 @@
 #include "logger.hpp"
 #include "arch/os_signal.hpp"
 #include "perfmon/collect.hpp"
+#include "memcached/binary_parser.hpp"
 #include "memcached/stats.hpp"
 
 static const char *crlf = "\r\n";
@@ -37,10 +40,11 @@ struct txt_memcached_handler_t : public home_thread_mixin_debug_only_t {
                             namespace_interface_t<memcached_protocol_t> *_nsi,
                             int _max_concurrent_queries_per_connection,
                             memcached_stats_t *_stats,
+                            admission_controller_t *_admission,
                             signal_t *_interruptor)
         : interface(_interface), nsi(_nsi),
           max_concurrent_queries_per_connection(_max_concurrent_queries_per_connection),
-          stats(_stats), interruptor(_interruptor)
+          stats(_stats), admission(_admission), interruptor(_interruptor)
     { }
 
     memcached_interface_t *interface;
@@ -51,6 +55,9 @@ struct txt_memcached_handler_t : public home_thread_mixin_debug_only_t {
 
     memcached_stats_t *stats;
 
+    // May be NULL.
+    admission_controller_t *admission;
+
     signal_t *interruptor;
 
     cas_t generate_cas() {
@@ -85,32 +92,43 @@ struct txt_memcached_handler_t : public home_thread_mixin_debug_only_t {
         va_end(args);
     }
 
-    void write_unbuffered(const char *buffer, size_t bytes) THROWS_NOTHING {
+    void writev_unbuffered(const iovec *bufs, size_t count) THROWS_NOTHING {
         try {
-            interface->write_unbuffered(buffer, bytes, interruptor);
+            interface->writev_unbuffered(bufs, count, interruptor);
         } catch (const interrupted_exc_t &) {
             /* ignore */
         }
     }
 
-    void write_from_data_provider(data_buffer_t *dp) THROWS_NOTHING {
-        if (dp->size() < MAX_BUFFERED_GET_SIZE) {
-            write(dp->buf(), dp->size());
+    /* Writes the "VALUE ..." line for `key` and then the value.  Small values go into
+    the buffer, but big ones are sent right away, together with their header line and
+    the CRLF after them in a single writev, so that they aren't copied. */
+    void write_value(const store_key_t &key, mcflags_t mcflags, data_buffer_t *dp,
+                     const cas_t *cas) THROWS_NOTHING {
+        const int key_size = key.size();
+        const char *key_contents = reinterpret_cast<const char *>(key.contents());
+        const size_t value_size = dp->size();
+        const std::string header = cas != NULL
+            ? strprintf("VALUE %*.*s %u %zu %" PRIu64 "\r\n",
+                        key_size, key_size, key_contents, mcflags, value_size, *cas)
+            : strprintf("VALUE %*.*s %u %zu\r\n",
+                        key_size, key_size, key_contents, mcflags, value_size);
+        if (value_size < MAX_BUFFERED_GET_SIZE) {
+            write(header);
+            write(dp->buf(), value_size);
+            write_crlf();
         } else {
-            write_unbuffered(dp->buf(), dp->size());
+            iovec bufs[3];
+            bufs[0].iov_base = const_cast<char *>(header.data());
+            bufs[0].iov_len = header.size();
+            bufs[1].iov_base = dp->buf();
+            bufs[1].iov_len = value_size;
+            bufs[2].iov_base = const_cast<char *>(crlf);
+            bufs[2].iov_len = 2;
+            writev_unbuffered(bufs, 3);
         }
     }
 
-    void write_value_header(const char *key, size_t key_size, mcflags_t mcflags, size_t value_size) THROWS_NOTHING {
-        writef("VALUE %*.*s %u %zu\r\n",
-               static_cast<int>(key_size), static_cast<int>(key_size), key, mcflags, value_size);
-    }
-
-    void write_value_header(const char *key, size_t key_size, mcflags_t mcflags, size_t value_size, cas_t cas) THROWS_NOTHING {
-        writef("VALUE %*.*s %u %zu %" PRIu64 "\r\n",
-               static_cast<int>(key_size), static_cast<int>(key_size), key, mcflags, value_size, cas);
-    }
-
     void error() THROWS_NOTHING {
         writef("ERROR\r\n");
     }
@@ -167,6 +185,10 @@ struct txt_memcached_handler_t : public home_thread_mixin_debug_only_t {
         return interface->is_write_open();
     }
 
+    void close() {
+        interface->close();
+    }
+
     void read(void *buf, size_t nbytes) THROWS_ONLY(memcached_interface_t::no_more_data_exc_t) {
         try {
             interface->read(buf, nbytes, interruptor);
@@ -186,7 +208,7 @@ struct txt_memcached_handler_t : public home_thread_mixin_debug_only_t {
 
 class pipeliner_t {
 public:
-    explicit pipeliner_t(txt_memcached_handler_t *rh) : requests_out_sem(rh->max_concurrent_queries_per_connection), rh_(rh) { }
+    explicit pipeliner_t(txt_memcached_handler_t *rh) : requests_out_sem(rh->max_concurrent_queries_per_connection), writers_waiting_(0), rh_(rh) { }
     ~pipeliner_t() { }
 
     void lock_argparsing() {
@@ -204,6 +226,10 @@ private:
     static_semaphore_t requests_out_sem;
 
     mutex_t mutex;
+    // How many requests are done and waiting for `mutex` to write their responses.
+    // While there are any, a request that's done writing leaves the flush to them,
+    // so that the responses to pipelined requests go out together.
+    int writers_waiting_;
     txt_memcached_handler_t *rh_;
 
     DISABLE_COPYING(pipeliner_t);
@@ -234,23 +260,50 @@ public:
         pipeliner_->requests_out_sem.co_lock();
     }
 
+    // Like `done_argparsing()`, and then waits for the command's turn to run.  If it
+    // doesn't get one, answers the command with a SERVER_ERROR and returns false.
+    MUST_USE bool done_argparsing_and_admit() {
+        done_argparsing();
+
+        txt_memcached_handler_t *rh = pipeliner_->rh_;
+        if (rh->admission == NULL) {
+            return true;
+        }
+        ticket_.init(new admission_controller_t::ticket_t);
+        bool admitted;
+        try {
+            admitted = ticket_->admit(rh->admission, rh->interruptor);
+        } catch (const interrupted_exc_t &) {
+            admitted = false;
+        }
+        if (!admitted) {
+            begin_write();
+            rh->server_error("server overloaded");
+            end_write();
+        }
+        return admitted;
+    }
+
     void begin_write() {
         guarantee(state_ == has_done_argparsing);
         DEBUG_ONLY_CODE(state_ = has_begun_write);
         fifo_acq_.leave();
+        ++pipeliner_->writers_waiting_;
         mutex_acq_.reset(&pipeliner_->mutex);
+        --pipeliner_->writers_waiting_;
     }
 
     void end_write() {
         guarantee(state_ == has_begun_write);
         DEBUG_ONLY_CODE(state_ = has_ended_write);
 
-        {
+        if (pipeliner_->writers_waiting_ == 0) {
             block_pm_duration flush_timer(&pipeliner_->rh_->stats->pm_conns_writing); // FIXME: race condition here
             pipeliner_->rh_->flush_buffer();
         }
 
         mutex_acq_.reset();
+        ticket_.reset();
         pipeliner_->requests_out_sem.unlock();
     }
 
@@ -258,6 +311,7 @@ private:
     pipeliner_t *pipeliner_;
     mutex_t::acq_t mutex_acq_;
     coro_fifo_acq_t fifo_acq_;
+    scoped_ptr_t<admission_controller_t::ticket_t> ticket_;
 
     enum { untouched, has_begun_operation, has_done_argparsing, has_begun_write, has_ended_write } state_;
 
@@ -281,7 +335,7 @@ void do_one_get(txt_memcached_handler_t *rh, bool with_cas, get_t *gets, int i,
             rh->nsi->write(write, &response, token, rh->interruptor);
             gets[i].res = boost::get<get_result_t>(response.result);
         } else {
-            get_query_t get_query(gets[i].key);
+            get_query_t get_query(gets[i].key, 0, MEMCACHED_STREAMING_CHUNK_SIZE);
             memcached_protocol_t::read_t read(get_query, time(NULL));
             memcached_protocol_t::read_response_t response;
             rh->nsi->read(read, &response, token, rh->interruptor);
@@ -296,6 +350,60 @@ void do_one_get(txt_memcached_handler_t *rh, bool with_cas, get_t *gets, int i,
     }
 }
 
+/* Sends a value that's too big to read all at once.  `first_chunk` has the start of
+it; the rest is read a chunk at a time, each one after the last has been sent, so
+that we don't get ahead of the client.  If the value changes before all of it has
+been sent, there's no way to tell the client, so we close the connection. */
+void write_streamed_value(txt_memcached_handler_t *rh, const store_key_t &key,
+                          const get_result_t &first_chunk) {
+    rh->writef("VALUE %*.*s %u %" PRIi64 "\r\n",
+               key.size(), key.size(), reinterpret_cast<const char *>(key.contents()),
+               first_chunk.flags, first_chunk.value_size);
+
+    get_result_t chunk = first_chunk;
+    int64_t offset = 0;
+    for (;;) {
+        iovec buf;
+        buf.iov_base = chunk.value->buf();
+        buf.iov_len = chunk.value->size();
+        rh->writev_unbuffered(&buf, 1);
+        offset += chunk.value->size();
+        if (offset == first_chunk.value_size) {
+            break;
+        }
+        if (!rh->is_write_open() || rh->interruptor->is_pulsed()) {
+            return;
+        }
+
+        std::string error;
+        try {
+            get_query_t get_query(key, offset, MEMCACHED_STREAMING_CHUNK_SIZE);
+            memcached_protocol_t::read_t read(get_query, time(NULL));
+            memcached_protocol_t::read_response_t response;
+            rh->nsi->read(read, &response, order_token_t::ignore, rh->interruptor);
+            chunk = boost::get<get_result_t>(response.result);
+            if (!chunk.value.has()
+                || chunk.value->size() == 0
+                || chunk.cas != first_chunk.cas
+                || chunk.flags != first_chunk.flags
+                || chunk.value_size != first_chunk.value_size) {
+                error = "the value changed";
+            }
+        } catch (const cannot_perform_query_exc_t &e) {
+            error = e.what();
+        } catch (const interrupted_exc_t &) {
+            return;
+        }
+        if (!error.empty()) {
+            logINF("Closing memcached connection %p because we couldn't finish "
+                   "sending a value: %s", coro_t::self(), error.c_str());
+            rh->close();
+            return;
+        }
+    }
+    rh->write_crlf();
+}
+
 void do_get(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, bool with_cas, int argc, char **argv, order_token_t token) {
     // We should already be spawned within a coroutine.
     pipeliner_acq_t pipeliner_acq(pipeliner);
@@ -327,7 +435,9 @@ void do_get(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, bool with_cas,
         return;
     }
 
-    pipeliner_acq.done_argparsing();
+    if (!pipeliner_acq.done_argparsing_and_admit()) {
+        return;
+    }
 
     block_pm_duration get_timer(&rh->stats->pm_cmd_get);
 
@@ -363,16 +473,13 @@ void do_get(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, bool with_cas,
             if (rh->is_write_open()) {
                 const store_key_t &key = gets[i].key;
 
-                /* Write the "VALUE ..." header */
                 if (with_cas) {
-                    rh->write_value_header(reinterpret_cast<const char *>(key.contents()), key.size(), res.flags, res.value->size(), res.cas);
+                    rh->write_value(key, res.flags, res.value.get(), &res.cas);
+                } else if (res.value->size() < res.value_size) {
+                    write_streamed_value(rh, key, res);
                 } else {
-                    guarantee(res.cas == 0);
-                    rh->write_value_header(reinterpret_cast<const char *>(key.contents()), key.size(), res.flags, res.value->size());
+                    rh->write_value(key, res.flags, res.value.get(), NULL);
                 }
-
-                rh->write_from_data_provider(res.value.get());
-                rh->write_crlf();
             }
         }
     }
@@ -446,7 +553,9 @@ void do_rget(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, order_source_t
         return;
     }
 
-    pipeliner_acq.done_argparsing();
+    if (!pipeliner_acq.done_argparsing_and_admit()) {
+        return;
+    }
 
     block_pm_duration rget_timer(&rh->stats->pm_cmd_rget);
 
@@ -462,6 +571,12 @@ void do_rget(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, order_source_t
         `rget_result_t` back, if the query was truncated, we dispatch another
         `rget_query_t` starting where the last one left off. */
 
+        /* Each sub-request's results are sent to the client before the next one is
+        dispatched, so the client gets the first results right away and the writes
+        to the connection hold back the range scan if the client reads slowly.  The
+        first sub-requests are small, for the first results' sake, and later ones
+        grow, up to `MEMCACHED_RGET_MAX_BATCH_ITEMS` items. */
+
         /* The naive approach has a problem, though. Suppose that we request a
         range from 'a' to 'z', and the database is sharded at 'm'. Both the
         'a'-'m' shard and the 'm'-'z' shard will get a request. Because the
@@ -487,8 +602,10 @@ void do_rget(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, order_source_t
 
         std::set<key_range_t>::const_iterator shard_it = real_shards.begin();
 
+        uint64_t batch_items = MEMCACHED_RGET_FIRST_BATCH_ITEMS;
         while (max_items > 0) {
-            rget_query_t rget_query(region_intersection(memcached_protocol_t::region_t(range), memcached_protocol_t::region_t(*shard_it)), max_items);
+            const uint64_t query_items = std::min(max_items, batch_items);
+            rget_query_t rget_query(region_intersection(memcached_protocol_t::region_t(range), memcached_protocol_t::region_t(*shard_it)), query_items);
             memcached_protocol_t::read_t read(rget_query, time(NULL));
             memcached_protocol_t::read_response_t response;
             rh->nsi->read(read, &response, order_source->check_in("do_rget").with_read_mode(), rh->interruptor);
@@ -497,15 +614,16 @@ void do_rget(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, order_source_t
             for (std::vector<key_with_data_buffer_t>::iterator it = results.pairs.begin();
                                                                it != results.pairs.end();
                                                                ++it) {
-                rh->write_value_header(reinterpret_cast<const char *>(it->key.contents()), it->key.size(), it->mcflags, it->value_provider->size());
-                rh->write_from_data_provider(it->value_provider.get());
-                rh->write_crlf();
+                rh->write_value(it->key, it->mcflags, it->value_provider.get(), NULL);
             }
+            rh->flush_buffer();
 
-            if (results.truncated) {
+            if (results.truncated
+                || (results.pairs.size() == query_items && query_items < max_items)) {
                 /* This round of the range scan stopped because the chunk was
-                getting too big. We need to submit another range scan with the left
-                key equal to the rightmost key of the results we got */
+                getting too big, or because the batch was full. We need to submit
+                another range scan with the left key equal to the rightmost key of
+                the results we got */
                 guarantee(!results.pairs.empty());
                 range.left = results.pairs.back().key;
                 range.left.increment();
@@ -534,6 +652,8 @@ void do_rget(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, order_source_t
 
             guarantee(results.pairs.size() <= max_items);
             max_items -= results.pairs.size();
+            batch_items = std::min<uint64_t>(batch_items * 2,
+                                             MEMCACHED_RGET_MAX_BATCH_ITEMS);
         }
         rh->write_end();
 
@@ -850,7 +970,9 @@ void do_storage(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, storage_com
     to `boost::bind()` */
     storage_metadata_t metadata(mcflags, exptime, unique);
 
-    pipeliner_acq->done_argparsing();
+    if (!pipeliner_acq->done_argparsing_and_admit()) {
+        return;
+    }
 
     coro_t::spawn_now_dangerously(boost::bind(&run_storage_command, rh, pipeliner_acq.release(), sc, key, dp, metadata, noreply, token));
 }
@@ -952,7 +1074,9 @@ void do_incr_decr(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, bool i, i
         noreply = false;
     }
 
-    pipeliner_acq.done_argparsing();
+    if (!pipeliner_acq.done_argparsing_and_admit()) {
+        return;
+    }
 
     run_incr_decr(rh, &pipeliner_acq, key, delta, i, noreply, token);
 }
@@ -1052,7 +1176,9 @@ void do_delete(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, int argc, ch
         noreply = false;
     }
 
-    pipeliner_acq.done_argparsing();
+    if (!pipeliner_acq.done_argparsing_and_admit()) {
+        return;
+    }
 
     run_delete(rh, &pipeliner_acq, key, noreply, token);
 }
@@ -1101,12 +1227,30 @@ void handle_memcache(memcached_interface_t *interface,
         namespace_interface_t<memcached_protocol_t> *nsi,
         int max_concurrent_queries_per_connection,
         memcached_stats_t *stats,
+        admission_controller_t *admission,
         signal_t *interruptor) {
     logDBG("Opened memcached stream: %p", coro_t::self());
 
+    /* Binary protocol requests all start with the same magic byte, which no text
+    protocol command starts with. */
+    try {
+        if (interface->peek_byte(interruptor) == memcached_binary::REQUEST_MAGIC) {
+            handle_memcache_binary(interface, nsi, max_concurrent_queries_per_connection,
+                                   stats, admission, interruptor);
+            logDBG("Closed memcached stream: %p", coro_t::self());
+            return;
+        }
+    } catch (const memcached_interface_t::no_more_data_exc_t &) {
+        logDBG("Closed memcached stream: %p", coro_t::self());
+        return;
+    } catch (const interrupted_exc_t &) {
+        logDBG("Closed memcached stream: %p", coro_t::self());
+        return;
+    }
+
     /* This object just exists to group everything together so we don't have to pass a lot of
     context around. */
-    txt_memcached_handler_t rh(interface, nsi, max_concurrent_queries_per_connection, stats, interruptor);
+    txt_memcached_handler_t rh(interface, nsi, max_concurrent_queries_per_connection, stats, admission, interruptor);
 
     /* The commands from each individual memcached handler must be performed in the order
     that the handler parses them. This `order_source_t` is used to guarantee that. */
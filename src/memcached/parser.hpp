@@ -2,6 +2,8 @@
 #ifndef MEMCACHED_PARSER_HPP_
 #define MEMCACHED_PARSER_HPP_
 
+#include <sys/uio.h>
+
 #include <vector>
 
 #include "memcached/protocol.hpp"
@@ -19,10 +21,14 @@ memcache traffic from either a file or a TCP connection. */
 struct memcached_interface_t {
 
     virtual void write(const char *, size_t, signal_t *interruptor) = 0;
-    virtual void write_unbuffered(const char *buffer, size_t bytes, signal_t *interruptor) = 0;
+    // Flushes the buffer and then sends `bufs` straight away.
+    virtual void writev_unbuffered(const iovec *bufs, size_t count, signal_t *interruptor) = 0;
 
     virtual void flush_buffer(signal_t *interruptor) = 0;
     virtual bool is_write_open() = 0;
+    // Closes both halves of the connection, for when something goes wrong that
+    // there's no way to tell the client about.
+    virtual void close() = 0;
 
     struct no_more_data_exc_t : public std::exception {
         const char *what() const throw () {
@@ -31,14 +37,21 @@ struct memcached_interface_t {
     };
     virtual void read(void *, size_t, signal_t *interruptor) = 0;
     virtual void read_line(std::vector<char> *, signal_t *interruptor) = 0;
+    // Returns the next byte without consuming it.
+    virtual uint8_t peek_byte(signal_t *interruptor) = 0;
 
     virtual ~memcached_interface_t() { }
 };
 
+class admission_controller_t;
+
+/* If `admission` isn't NULL, commands are turned away with a SERVER_ERROR when it
+doesn't admit them. */
 void handle_memcache(memcached_interface_t *interface,
                      namespace_interface_t<memcached_protocol_t> *nsi,
                      int max_concurrent_queries_per_connection,
                      memcached_stats_t *,
+                     admission_controller_t *admission,
                      signal_t *interruptor);
 
 #endif /* MEMCACHED_PARSER_HPP_ */
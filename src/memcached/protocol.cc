@@ -4,6 +4,7 @@
 #include "errors.hpp"
 #include <boost/variant.hpp>
 
+#include "btree/defragment.hpp"
 #include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "btree/slice.hpp"
@@ -18,7 +19,9 @@
 #include "memcached/memcached_btree/erase_range.hpp"
 #include "memcached/memcached_btree/get.hpp"
 #include "memcached/memcached_btree/get_cas.hpp"
+#include "memcached/memcached_btree/hot_cache.hpp"
 #include "memcached/memcached_btree/incr_decr.hpp"
+#include "memcached/memcached_btree/node.hpp"
 #include "memcached/memcached_btree/rget.hpp"
 #include "memcached/memcached_btree/set.hpp"
 #include "memcached/queries.hpp"
@@ -46,7 +49,7 @@ write_message_t &operator<<(write_message_t &msg, const counted_t<data_buffer_t>
         msg << exists;
         int64_t size = buf->size();
         msg << size;
-        msg.append(buf->buf(), buf->size());
+        msg.append_buffer(buf);
     } else {
         bool exists = false;
         msg << exists;
@@ -73,10 +76,10 @@ archive_result_t deserialize(read_stream_t *s, counted_t<data_buffer_t> *buf) {
     return ARCHIVE_SUCCESS;
 }
 
-RDB_IMPL_SERIALIZABLE_1(get_query_t, key);
+RDB_IMPL_SERIALIZABLE_3(get_query_t, key, offset, chunk_size);
 RDB_IMPL_SERIALIZABLE_2(rget_query_t, region, maximum);
 RDB_IMPL_SERIALIZABLE_3(distribution_get_query_t, max_depth, result_limit, region);
-RDB_IMPL_SERIALIZABLE_3(get_result_t, value, flags, cas);
+RDB_IMPL_SERIALIZABLE_4(get_result_t, value, flags, cas, value_size);
 RDB_IMPL_SERIALIZABLE_3(key_with_data_buffer_t, key, mcflags, value_provider);
 RDB_IMPL_SERIALIZABLE_2(rget_result_t, pairs, truncated);
 RDB_IMPL_SERIALIZABLE_2(distribution_result_t, region, key_counts);
@@ -418,6 +421,8 @@ store_t::store_t(serializer_t *serializer,
 
 store_t::~store_t() {
     assert_thread();
+    stop_defragmenter();
+    memcached_hot_cache_t::forget_slice(btree.get());
 }
 
 namespace {
@@ -425,7 +430,8 @@ namespace {
 struct read_visitor_t : public boost::static_visitor<read_response_t> {
     read_response_t operator()(const get_query_t& get) {
         return read_response_t(
-            memcached_get(get.key, btree, effective_time, superblock));
+            memcached_get(get.key, get.offset, get.chunk_size, btree, effective_time,
+                          superblock));
     }
 
     read_response_t operator()(const rget_query_t& rget) {
@@ -553,8 +559,8 @@ public:
     explicit memcached_backfill_callback_t(chunk_fun_callback_t<memcached_protocol_t> *chunk_fun_cb)
         : chunk_fun_cb_(chunk_fun_cb) { }
 
-    void on_delete_range(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
-        chunk_fun_cb_->send_chunk(chunk_t::delete_range(region_t(range)), interruptor);
+    void on_delete_range(const region_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        chunk_fun_cb_->send_chunk(chunk_t::delete_range(range), interruptor);
     }
 
     void on_deletion(const btree_key_t *key, repli_timestamp_t recency, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
@@ -564,6 +570,11 @@ public:
     void on_keyvalue(const backfill_atom_t& atom, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
         chunk_fun_cb_->send_chunk(chunk_t::set_key(atom), interruptor);
     }
+
+    // Every chunk for `sent_region` went out before `send_chunk()` returned.
+    void on_progress(const region_t &sent_region, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        chunk_fun_cb_->send_progress(sent_region, interruptor);
+    }
     ~memcached_backfill_callback_t() { }
 
 protected:
@@ -589,7 +600,7 @@ void call_memcached_backfill(
     progress->add_constituent(&p_owner);
     repli_timestamp_t timestamp = regions[i].second.to_repli_timestamp();
     try {
-        memcached_backfill(regions[i].first.inner, timestamp, callback,
+        memcached_backfill(regions[i].first, timestamp, callback,
                            superblock, sindex_block, p, interruptor);
     } catch (const interrupted_exc_t &) {
         /* do nothing; `protocol_send_backfill()` will notice and deal with it.
@@ -597,7 +608,6 @@ void call_memcached_backfill(
     }
 }
 
-// TODO: Figure out wtf does the backfill filtering, figure out wtf constricts delete range operations to hit only a certain hash-interval, figure out what filters keys.
 void store_t::protocol_send_backfill(const region_map_t<memcached_protocol_t, state_timestamp_t> &start_point,
                                      chunk_fun_callback_t<memcached_protocol_t> *chunk_fun_cb,
                                      superblock_t *superblock,
@@ -641,6 +651,7 @@ struct receive_backfill_visitor_t : public boost::static_visitor<> {
     }
     void operator()(const backfill_chunk_t::delete_range_t& delete_range) const {
         hash_range_key_tester_t tester(&delete_range.range);
+        invalidate_hot_cache();
         memcached_erase_range(&tester, delete_range.range.inner,
                               superblock, interruptor);
     }
@@ -654,6 +665,13 @@ struct receive_backfill_visitor_t : public boost::static_visitor<> {
     }
 
 private:
+    void invalidate_hot_cache() const {
+        memcached_hot_cache_t *hot_cache = memcached_hot_cache_t::get();
+        if (hot_cache != NULL) {
+            hot_cache->invalidate_slice(btree);
+        }
+    }
+
     struct hash_range_key_tester_t : public key_tester_t {
         explicit hash_range_key_tester_t(const region_t *delete_range)
             : delete_range_(delete_range) { }
@@ -662,6 +680,9 @@ private:
             return delete_range_->beg <= h && h < delete_range_->end
                 && delete_range_->inner.contains_key(key->contents, key->size);
         }
+        bool erases_all_keys() {
+            return delete_range_->beg == 0 && delete_range_->end == HASH_REGION_HASH_SIZE;
+        }
 
         const region_t *delete_range_;
 
@@ -694,6 +715,9 @@ struct hash_key_tester_t : public key_tester_t {
         uint64_t h = hash_region_hasher(key->contents, key->size);
         return beg_ <= h && h < end_;
     }
+    bool erases_all_keys() {
+        return beg_ == 0 && end_ == HASH_REGION_HASH_SIZE;
+    }
 
 private:
     uint64_t beg_;
@@ -705,14 +729,44 @@ private:
 }   /* anonymous namespace */
 
 void store_t::protocol_reset_data(const region_t& subregion,
-                                  UNUSED btree_slice_t *btree,
+                                  btree_slice_t *btree,
                                   superblock_t *superblock,
                                   signal_t *interruptor) {
+    memcached_hot_cache_t *hot_cache = memcached_hot_cache_t::get();
+    if (hot_cache != NULL) {
+        hot_cache->invalidate_slice(btree);
+    }
     hash_key_tester_t key_tester(subregion.beg, subregion.end);
     memcached_erase_range(&key_tester, subregion.inner,
                           superblock, interruptor);
 }
 
+bool store_t::protocol_defragment_leaves(btree_slice_t *btree,
+                                        superblock_t *superblock,
+                                        store_key_t *start_key,
+                                        int max_leaves) {
+    value_sizer_t<memcached_value_t> sizer(btree->cache()->get_block_size());
+    return btree_defragment_leaves(&sizer, superblock, start_key, max_leaves);
+}
+
+// memcached tables don't have a write buffer size, so their write buffers are off
+// and never get any messages.
+
+bool store_t::protocol_write_can_be_buffered(UNUSED const write_t &write) {
+    return false;
+}
+
+bool store_t::protocol_read_merges_write_buffer(UNUSED const read_t &read) {
+    return false;
+}
+
+void store_t::protocol_flush_write_buffer(
+        UNUSED btree_slice_t *btree,
+        UNUSED superblock_t *superblock,
+        const btree_write_buffer_t::message_map_t &messages) {
+    guarantee(messages.empty());
+}
+
 class generic_debug_print_visitor_t : public boost::static_visitor<void> {
 public:
     explicit generic_debug_print_visitor_t(printf_buffer_t *buf) : buf_(buf) { }
@@ -88,6 +88,8 @@ public:
         read_t(const query_t& q, exptime_t et) : query(q), effective_time(et) { }
 
         bool use_snapshot() const { return false; }
+
+        query_priority_t priority() const { return QUERY_PRIORITY_INTERACTIVE; }
         
         bool all_read() const { return false; }
 
@@ -109,6 +111,7 @@ public:
         typedef boost::variant<get_cas_mutation_t, sarc_mutation_t, delete_mutation_t, incr_decr_mutation_t, append_prepend_mutation_t> query_t;
 
         durability_requirement_t durability() const { return DURABILITY_REQUIREMENT_DEFAULT; }
+        query_priority_t priority() const { return QUERY_PRIORITY_INTERACTIVE; }
 
         region_t get_region() const THROWS_NOTHING;
 
@@ -216,6 +219,20 @@ public:
                                  btree_slice_t *btree,
                                  superblock_t *superblock,
                                  signal_t *interruptor);
+
+        bool protocol_defragment_leaves(btree_slice_t *btree,
+                                        superblock_t *superblock,
+                                        store_key_t *start_key,
+                                        int max_leaves);
+
+        bool protocol_write_can_be_buffered(const write_t &write);
+
+        bool protocol_read_merges_write_buffer(const read_t &read);
+
+        void protocol_flush_write_buffer(
+                btree_slice_t *btree,
+                superblock_t *superblock,
+                const btree_write_buffer_t::message_map_t &messages);
     };
 
 };
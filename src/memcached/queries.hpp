@@ -33,21 +33,40 @@ struct data_buffer_t;
 
 struct get_query_t {
     store_key_t key;
-    get_query_t() { }
-    explicit get_query_t(const store_key_t& _key) : key(_key) { }
+
+    /* If `chunk_size` isn't zero and the value is longer than that, only the
+    `chunk_size` bytes starting at `offset` are returned, so that big values can be
+    streamed to the client a chunk at a time.  The value's CAS tells the reader
+    whether it changed between chunks, so a value without one is returned whole
+    when `offset` is zero. */
+    int64_t offset;
+    int64_t chunk_size;
+
+    get_query_t() : offset(0), chunk_size(0) { }
+    explicit get_query_t(const store_key_t& _key)
+        : key(_key), offset(0), chunk_size(0) { }
+    get_query_t(const store_key_t& _key, int64_t _offset, int64_t _chunk_size)
+        : key(_key), offset(_offset), chunk_size(_chunk_size) { }
 };
 
 struct get_result_t {
     get_result_t(const counted_t<data_buffer_t>& v, mcflags_t f, cas_t c) :
-        value(v), flags(f), cas(c) { }
+        value(v), flags(f), cas(c), value_size(v.has() ? v->size() : 0) { }
+    get_result_t(const counted_t<data_buffer_t>& v, mcflags_t f, cas_t c,
+                 int64_t _value_size) :
+        value(v), flags(f), cas(c), value_size(_value_size) { }
     get_result_t() :
-        value(), flags(0), cas(0) { }
+        value(), flags(0), cas(0), value_size(0) { }
 
     // NULL means not found.
     counted_t<data_buffer_t> value;
 
     mcflags_t flags;
     cas_t cas;
+
+    // The size of the whole value, which is more than `value->size()` if only a
+    // chunk of it was read.
+    int64_t value_size;
 };
 
 /* `rget` */
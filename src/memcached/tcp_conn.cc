@@ -25,9 +25,9 @@ struct tcp_conn_memcached_interface_t : public memcached_interface_t, public hom
         }
     }
 
-    void write_unbuffered(const char *buffer, size_t bytes, signal_t *interruptor) {
+    void writev_unbuffered(const iovec *bufs, size_t count, signal_t *interruptor) {
         try {
-            conn->write(buffer, bytes, interruptor);
+            conn->writev(bufs, count, interruptor);
         } catch (const tcp_conn_write_closed_exc_t &) {
             /* Ignore */
         }
@@ -45,6 +45,15 @@ struct tcp_conn_memcached_interface_t : public memcached_interface_t, public hom
         return conn->is_write_open();
     }
 
+    void close() {
+        if (conn->is_read_open()) {
+            conn->shutdown_read();
+        }
+        if (conn->is_write_open()) {
+            conn->shutdown_write();
+        }
+    }
+
     void read(void *buf, size_t nbytes, signal_t *interruptor) {
         try {
             conn->read(buf, nbytes, interruptor);
@@ -88,11 +97,20 @@ struct tcp_conn_memcached_interface_t : public memcached_interface_t, public hom
             throw no_more_data_exc_t();
         }
     }
+
+    uint8_t peek_byte(signal_t *interruptor) {
+        try {
+            const_charslice sl = conn->peek(1, interruptor);
+            return static_cast<uint8_t>(*sl.beg);
+        } catch (const tcp_conn_read_closed_exc_t &) {
+            throw no_more_data_exc_t();
+        }
+    }
 };
 
-void serve_memcache(tcp_conn_t *conn, namespace_interface_t<memcached_protocol_t> *nsi, memcached_stats_t *stats, signal_t *interruptor) {
+void serve_memcache(tcp_conn_t *conn, namespace_interface_t<memcached_protocol_t> *nsi, memcached_stats_t *stats, admission_controller_t *admission, signal_t *interruptor) {
     tcp_conn_memcached_interface_t interface(conn);
-    handle_memcache(&interface, nsi, MAX_CONCURRENT_QUERIES_PER_CONNECTION, stats, interruptor);
+    handle_memcache(&interface, nsi, MAX_CONCURRENT_QUERIES_PER_CONNECTION, stats, admission, interruptor);
 }
 
 
@@ -107,6 +125,8 @@ memcache_listener_t::memcache_listener_t(const std::set<ip_address_t> &local_add
       next_thread(0),
       parent(_parent),
       stats(parent),
+      admission(std::max(1, MAX_RUNNING_QUERIES_PER_NODE / get_num_db_threads()),
+                std::max(1, MAX_WAITING_QUERIES_PER_NODE / get_num_db_threads())),
       tcp_listener(new repeated_nonthrowing_tcp_listener_t(local_addresses, port,
           boost::bind(&memcache_listener_t::handle, this, auto_drainer_t::lock_t(&drainer), _1)))
 {
@@ -140,7 +160,8 @@ void memcache_listener_t::handle(auto_drainer_t::lock_t keepalive, const scoped_
     until the connection is closed. */
     try {
         namespace_repo_t<memcached_protocol_t>::access_t ns_access(ns_repo, namespace_id, &signal_transfer);
-        serve_memcache(conn.get(), ns_access.get_namespace_if(), &stats, &signal_transfer);
+        serve_memcache(conn.get(), ns_access.get_namespace_if(), &stats, admission.get(),
+                       &signal_transfer);
     } catch (const interrupted_exc_t &ex) {
         // Interrupted, nothing to do but return
     }
@@ -5,7 +5,9 @@
 #include <set>
 
 #include "arch/types.hpp"
+#include "concurrency/admission_control.hpp"
 #include "concurrency/auto_drainer.hpp"
+#include "concurrency/one_per_thread.hpp"
 #include "containers/scoped.hpp"
 #include "memcached/protocol.hpp"
 #include "memcached/stats.hpp"
@@ -43,6 +45,9 @@ private:
 
     memcached_stats_t stats;
 
+    /* Turns away queries when the server has too many. */
+    one_per_thread_t<admission_controller_t> admission;
+
     /* We use this to make sure that all TCP connections stop when the
     `memcached_listener_t` is destroyed. */
     auto_drainer_t drainer;
@@ -0,0 +1,170 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
+#include "containers/scoped.hpp"
+#include "microbench/microbench.hpp"
+#include "repli_timestamp.hpp"
+
+namespace microbench {
+
+static const block_size_t bench_block_size = block_size_t::unsafe_make(4096);
+
+// A leaf value is a length byte followed by that many bytes.
+class bench_value_sizer_t : public value_sizer_t<void> {
+public:
+    bench_value_sizer_t() { }
+
+    int size(const void *value) const {
+        return 1 + *static_cast<const uint8_t *>(value);
+    }
+
+    bool fits(const void *value, int length_available) const {
+        return length_available > 0 && size(value) <= length_available;
+    }
+
+    int max_possible_size() const {
+        return 256;
+    }
+
+    block_magic_t btree_leaf_magic() const {
+        block_magic_t magic = { { 'b', 'n', 'L', 'F' } };
+        return magic;
+    }
+
+    block_size_t block_size() const { return bench_block_size; }
+
+private:
+    DISABLE_COPYING(bench_value_sizer_t);
+};
+
+// The same keys every run, so that runs can be compared.
+static std::vector<store_key_t> make_keys(int count) {
+    rng_t rng(count);
+    std::vector<store_key_t> keys;
+    for (int i = 0; i < count; ++i) {
+        std::string key = "key";
+        const int length = 8 + rng.randint(16);
+        for (int j = 0; j < length; ++j) {
+            key.push_back('a' + rng.randint(26));
+        }
+        keys.push_back(store_key_t(key));
+    }
+    return keys;
+}
+
+static std::vector<char> make_value() {
+    std::vector<char> value(21, 'v');
+    value[0] = 20;
+    return value;
+}
+
+// Fills `node` with keys from `keys` until the next one wouldn't fit, and returns how
+// many it took.
+static int fill_leaf(bench_value_sizer_t *sizer, leaf_node_t *node,
+                     const std::vector<store_key_t> &keys, const std::vector<char> &value) {
+    leaf::init(sizer, node);
+    int n = 0;
+    while (n < static_cast<int>(keys.size())
+           && !leaf::is_full(sizer, node, keys[n].btree_key(), value.data())) {
+        leaf::insert(sizer, node, keys[n].btree_key(), value.data(),
+                     repli_timestamp_t::distant_past,
+                     key_modification_proof_t::real_proof());
+        ++n;
+    }
+    return n;
+}
+
+static void bench_leaf_insert(run_t *run) {
+    bench_value_sizer_t sizer;
+    scoped_malloc_t<leaf_node_t> node(bench_block_size.value());
+    const std::vector<store_key_t> keys = make_keys(1000);
+    const std::vector<char> value = make_value();
+
+    leaf::init(&sizer, node.get());
+    size_t next_key = 0;
+    run->start();
+    for (int64_t i = 0; i < run->iterations(); ++i) {
+        const btree_key_t *key = keys[next_key].btree_key();
+        if (leaf::is_full(&sizer, node.get(), key, value.data())) {
+            run->stop();
+            leaf::init(&sizer, node.get());
+            run->start();
+        }
+        leaf::insert(&sizer, node.get(), key, value.data(),
+                     repli_timestamp_t::distant_past,
+                     key_modification_proof_t::real_proof());
+        next_key = (next_key + 1) % keys.size();
+    }
+    run->stop();
+}
+MICROBENCH("btree/leaf_insert", bench_leaf_insert);
+
+static void bench_leaf_lookup(run_t *run) {
+    bench_value_sizer_t sizer;
+    scoped_malloc_t<leaf_node_t> node(bench_block_size.value());
+    const std::vector<store_key_t> keys = make_keys(1000);
+    const std::vector<char> value = make_value();
+    const int num_keys = fill_leaf(&sizer, node.get(), keys, value);
+
+    char value_out[256];
+    int found = 0;
+    run->start();
+    for (int64_t i = 0; i < run->iterations(); ++i) {
+        found += leaf::lookup(&sizer, node.get(), keys[i % num_keys].btree_key(),
+                              value_out);
+    }
+    run->stop();
+    guarantee(found == run->iterations());
+}
+MICROBENCH("btree/leaf_lookup", bench_leaf_lookup);
+
+static void bench_leaf_split(run_t *run) {
+    bench_value_sizer_t sizer;
+    scoped_malloc_t<leaf_node_t> full_node(bench_block_size.value());
+    scoped_malloc_t<leaf_node_t> node(bench_block_size.value());
+    scoped_malloc_t<leaf_node_t> rnode(bench_block_size.value());
+    fill_leaf(&sizer, full_node.get(), make_keys(1000), make_value());
+
+    store_key_t median;
+    for (int64_t i = 0; i < run->iterations(); ++i) {
+        memcpy(node.get(), full_node.get(), bench_block_size.value());
+        run->start();
+        leaf::split(&sizer, node.get(), rnode.get(), median.btree_key());
+        run->stop();
+    }
+}
+MICROBENCH("btree/leaf_split", bench_leaf_split);
+
+static void bench_internal_search(run_t *run) {
+    scoped_malloc_t<internal_node_t> node(bench_block_size.value());
+    internal_node::init(bench_block_size, node.get());
+    const std::vector<store_key_t> keys = make_keys(1000);
+    block_id_t next_block = 1;
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        if (internal_node::is_full(node.get())
+            || !internal_node::insert(bench_block_size, node.get(), it->btree_key(),
+                                      next_block, next_block + 1)) {
+            break;
+        }
+        next_block += 2;
+    }
+
+    // Most of the probes aren't in the node, like the keys a query looks up.
+    const std::vector<store_key_t> probes = make_keys(1001);
+    block_id_t sum = 0;
+    run->start();
+    for (int64_t i = 0; i < run->iterations(); ++i) {
+        sum += internal_node::lookup(node.get(), probes[i % probes.size()].btree_key());
+    }
+    run->stop();
+    guarantee(sum != 0);
+}
+MICROBENCH("btree/internal_search", bench_internal_search);
+
+}  // namespace microbench
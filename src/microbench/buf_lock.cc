@@ -0,0 +1,125 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <functional>
+
+#include "arch/io/disk.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "concurrency/pmap.hpp"
+#include "microbench/microbench.hpp"
+#include "serializer/config.hpp"
+
+namespace microbench {
+
+// How many coroutines go after the same block in the contended benchmarks.
+static const int num_contenders = 16;
+
+// A cache on a fresh serializer file, with one block in it for the benchmarks to
+// acquire.
+class bench_cache_t {
+public:
+    bench_cache_t()
+        : io_backender(file_direct_io_mode_t::buffered_desired),
+          file_opener(serializer_filepath_t(directory.path(), "cache_file"),
+                      &io_backender) {
+        standard_serializer_t::create(&file_opener,
+                                      standard_serializer_t::static_config_t());
+        serializer.init(new standard_serializer_t(
+            standard_serializer_t::dynamic_config_t(),
+            &file_opener,
+            &get_global_perfmon_collection()));
+        cache.init(new cache_t(serializer.get(), alt_cache_config_t(),
+                               &get_global_perfmon_collection()));
+        cache_conn.init(new cache_conn_t(cache.get()));
+
+        txn_t txn(cache_conn.get(), write_durability_t::HARD,
+                  repli_timestamp_t::distant_past, 1);
+        buf_lock_t block(&txn, block_id, alt_create_t::create);
+        buf_write_t write(&block);
+        memset(write.get_data_write(), 0, cache->max_block_size().value());
+    }
+
+    ~bench_cache_t() {
+        cache_conn.reset();
+        cache.reset();
+        serializer.reset();
+    }
+
+    static const block_id_t block_id = 0;
+
+    temp_directory_t directory;
+    io_backender_t io_backender;
+    filepath_file_opener_t file_opener;
+    scoped_ptr_t<standard_serializer_t> serializer;
+    scoped_ptr_t<cache_t> cache;
+    scoped_ptr_t<cache_conn_t> cache_conn;
+
+private:
+    DISABLE_COPYING(bench_cache_t);
+};
+
+static void acquire_for_read(cache_conn_t *cache_conn, bool yield_while_held) {
+    txn_t txn(cache_conn, read_access_t::read);
+    buf_lock_t block(buf_parent_t(&txn), bench_cache_t::block_id, access_t::read);
+    buf_read_t read(&block);
+    guarantee(read.get_data_read() != NULL);
+    if (yield_while_held) {
+        coro_t::yield();
+    }
+}
+
+static void acquire_for_write(cache_conn_t *cache_conn) {
+    txn_t txn(cache_conn, write_durability_t::SOFT, repli_timestamp_t::distant_past, 1);
+    buf_lock_t block(buf_parent_t(&txn), bench_cache_t::block_id, access_t::write);
+    buf_write_t write(&block);
+    static_cast<char *>(write.get_data_write())[0]++;
+    coro_t::yield();
+}
+
+static void run_contender(cache_conn_t *cache_conn, int64_t total_iterations,
+                          bool write, int i) {
+    // The first contender also does the iterations that don't divide evenly.
+    int64_t iterations = total_iterations / num_contenders;
+    if (i == 0) {
+        iterations += total_iterations % num_contenders;
+    }
+    for (int64_t j = 0; j < iterations; ++j) {
+        if (write) {
+            acquire_for_write(cache_conn);
+        } else {
+            acquire_for_read(cache_conn, true);
+        }
+    }
+}
+
+static void bench_read_uncontended(run_t *run) {
+    bench_cache_t cache;
+    run->start();
+    for (int64_t i = 0; i < run->iterations(); ++i) {
+        acquire_for_read(cache.cache_conn.get(), false);
+    }
+    run->stop();
+}
+MICROBENCH("buf_lock/read_uncontended", bench_read_uncontended);
+
+// Each contender yields while it holds the block, so that the others queue up on it.
+static void bench_contended(run_t *run, bool write) {
+    bench_cache_t cache;
+    run->start();
+    pmap(num_contenders, std::bind(&run_contender, cache.cache_conn.get(),
+                                   run->iterations(), write, std::placeholders::_1));
+    run->stop();
+}
+
+static void bench_read_contended(run_t *run) {
+    bench_contended(run, false);
+}
+MICROBENCH("buf_lock/read_contended", bench_read_contended);
+
+static void bench_write_contended(run_t *run) {
+    bench_contended(run, true);
+}
+MICROBENCH("buf_lock/write_contended", bench_write_contended);
+
+}  // namespace microbench
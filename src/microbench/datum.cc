@@ -0,0 +1,107 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+
+#include "containers/archive/string_stream.hpp"
+#include "http/json.hpp"
+#include "http/json/cJSON.hpp"
+#include "microbench/microbench.hpp"
+#include "rdb_protocol/datum.hpp"
+
+namespace microbench {
+
+// A document that looks like the ones people store: a few strings and numbers, a
+// small array and a nested object.
+static const char *const bench_document =
+    "{\"id\": \"2d5b1a1c-5c9e-4c43-9c1a-83ef6b2a3e0f\", "
+    "\"name\": \"Jane Roe\", \"email\": \"jane.roe@example.com\", "
+    "\"age\": 34, \"score\": 1234.5, \"active\": true, \"manager\": null, "
+    "\"tags\": [\"admin\", \"beta\", \"europe\", \"mobile\"], "
+    "\"address\": {\"street\": \"1 Main Street\", \"city\": \"Springfield\", "
+    "\"zip\": \"12345\", \"location\": [44.1, -72.3]}, "
+    "\"history\": [{\"at\": 1390000000, \"event\": \"signup\"}, "
+    "{\"at\": 1390086400, \"event\": \"login\"}, "
+    "{\"at\": 1390172800, \"event\": \"purchase\", \"amount\": 19.99}]}";
+
+static counted_t<const ql::datum_t> make_document() {
+    counted_t<const ql::datum_t> datum = ql::datum_t::from_json(bench_document);
+    guarantee(datum.has());
+    return datum;
+}
+
+static void bench_serialize(run_t *run) {
+    const counted_t<const ql::datum_t> datum = make_document();
+    int64_t total_size = 0;
+    run->start();
+    for (int64_t i = 0; i < run->iterations(); ++i) {
+        write_message_t wm;
+        wm << datum;
+        string_stream_t stream;
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+        total_size += stream.str().size();
+    }
+    run->stop();
+    guarantee(total_size > 0);
+}
+MICROBENCH("datum/serialize", bench_serialize);
+
+static void bench_deserialize(run_t *run) {
+    std::string serialized;
+    {
+        write_message_t wm;
+        wm << make_document();
+        string_stream_t stream;
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+        serialized = stream.str();
+    }
+
+    run->start();
+    for (int64_t i = 0; i < run->iterations(); ++i) {
+        string_read_stream_t stream(std::string(serialized), 0);
+        counted_t<const ql::datum_t> datum;
+        archive_result_t res = deserialize(&stream, &datum);
+        guarantee(res == ARCHIVE_SUCCESS);
+    }
+    run->stop();
+}
+MICROBENCH("datum/deserialize", bench_deserialize);
+
+static void bench_json_encode(run_t *run) {
+    const counted_t<const ql::datum_t> datum = make_document();
+    int64_t total_size = 0;
+    run->start();
+    for (int64_t i = 0; i < run->iterations(); ++i) {
+        std::string json;
+        datum->write_json(&json);
+        total_size += json.size();
+    }
+    run->stop();
+    guarantee(total_size > 0);
+}
+MICROBENCH("json/encode", bench_json_encode);
+
+static void bench_json_decode(run_t *run) {
+    run->start();
+    for (int64_t i = 0; i < run->iterations(); ++i) {
+        counted_t<const ql::datum_t> datum = ql::datum_t::from_json(bench_document);
+        guarantee(datum.has());
+    }
+    run->stop();
+}
+MICROBENCH("json/decode", bench_json_decode);
+
+// The same as json/decode, but through a cJSON tree the way datums used to be parsed,
+// for comparison.
+static void bench_json_decode_cjson(run_t *run) {
+    run->start();
+    for (int64_t i = 0; i < run->iterations(); ++i) {
+        scoped_cJSON_t json(cJSON_Parse(bench_document));
+        guarantee(json.get() != NULL);
+        counted_t<const ql::datum_t> datum = make_counted<const ql::datum_t>(json);
+    }
+    run->stop();
+}
+MICROBENCH("json/decode_cjson", bench_json_decode_cjson);
+
+}  // namespace microbench
@@ -0,0 +1,71 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <functional>
+#include <string>
+
+#include "arch/runtime/starter.hpp"
+#include "microbench/microbench.hpp"
+#include "utils.hpp"
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [--filter=SUBSTRING] [--min-secs=SECS] [--repetitions=N] "
+            "[--output=FILE]\n"
+            "Runs the microbenchmarks whose names contain SUBSTRING, and writes their "
+            "results as JSON to FILE (or to stdout).\n", name);
+    exit(EXIT_FAILURE);
+}
+
+static bool has_prefix(const char *arg, const char *prefix, const char **rest_out) {
+    const size_t length = strlen(prefix);
+    if (strncmp(arg, prefix, length) != 0) {
+        return false;
+    }
+    *rest_out = arg + length;
+    return true;
+}
+
+static void run_benchmarks_into(const microbench::options_t *options,
+                                std::string *results_out) {
+    *results_out = microbench::run_benchmarks(*options);
+}
+
+int main(int argc, char **argv) {
+    startup_shutdown_t startup_shutdown;
+
+    microbench::options_t options;
+    std::string output_path;
+    for (int i = 1; i < argc; ++i) {
+        const char *value;
+        if (has_prefix(argv[i], "--filter=", &value)) {
+            options.filter = value;
+        } else if (has_prefix(argv[i], "--min-secs=", &value)) {
+            options.min_secs = atof(value);
+        } else if (has_prefix(argv[i], "--repetitions=", &value)) {
+            options.repetitions = atoi(value);
+            if (options.repetitions <= 0) {
+                usage(argv[0]);
+            }
+        } else if (has_prefix(argv[i], "--output=", &value)) {
+            output_path = value;
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    std::string results;
+    run_in_thread_pool(std::bind(&run_benchmarks_into, &options, &results), 4);
+
+    if (output_path.empty()) {
+        fputs(results.c_str(), stdout);
+    } else {
+        FILE *out = fopen(output_path.c_str(), "w");
+        guarantee_err(out != NULL, "Couldn't open %s", output_path.c_str());
+        fputs(results.c_str(), out);
+        fclose(out);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "microbench/microbench.hpp"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "errors.hpp"
+
+namespace microbench {
+
+run_t::run_t(int64_t iterations)
+    : iterations_(iterations), running_(false), started_(0), elapsed_(0) { }
+
+void run_t::start() {
+    guarantee(!running_);
+    running_ = true;
+    started_ = get_ticks();
+}
+
+void run_t::stop() {
+    const ticks_t now = get_ticks();
+    guarantee(running_);
+    running_ = false;
+    elapsed_ += now - started_;
+}
+
+ticks_t run_t::elapsed() const {
+    guarantee(!running_, "A benchmark returned without stopping its timer.");
+    return elapsed_;
+}
+
+temp_directory_t::temp_directory_t() : path_(make_directory()) {
+    recreate_temporary_directory(path_);
+}
+
+temp_directory_t::~temp_directory_t() {
+    remove_directory_recursive(path_.path().c_str());
+}
+
+base_path_t temp_directory_t::make_directory() {
+    char tmpl[] = "/tmp/rdb_microbench.XXXXXX";
+    guarantee_err(mkdtemp(tmpl) != NULL, "Couldn't create a temporary directory");
+    return base_path_t(tmpl);
+}
+
+typedef std::vector<std::pair<std::string, benchmark_fun_t> > registry_t;
+
+static registry_t *get_registry() {
+    static registry_t registry;
+    return &registry;
+}
+
+registration_t::registration_t(const char *name, benchmark_fun_t fun) {
+    get_registry()->push_back(std::make_pair(std::string(name), fun));
+}
+
+static double run_once(benchmark_fun_t fun, int64_t iterations) {
+    run_t run(iterations);
+    fun(&run);
+    return ticks_to_secs(run.elapsed());
+}
+
+// Finds how many iterations it takes for a run to last `min_secs`.
+static int64_t calibrate(benchmark_fun_t fun, double min_secs) {
+    int64_t iterations = 1;
+    for (;;) {
+        const double secs = run_once(fun, iterations);
+        if (secs >= min_secs) {
+            return iterations;
+        }
+        // Aim a little past `min_secs`, without growing too much at once off of a
+        // run that was too short to time well.
+        const int64_t estimate = secs > 0
+            ? static_cast<int64_t>(iterations * min_secs * 1.2 / secs)
+            : iterations * 100;
+        iterations = std::min(iterations * 100, std::max(iterations + 1, estimate));
+    }
+}
+
+std::string run_benchmarks(const options_t &options) {
+    guarantee(options.repetitions > 0);
+    registry_t benchmarks = *get_registry();
+    std::sort(benchmarks.begin(), benchmarks.end());
+
+    std::string results;
+    for (auto it = benchmarks.begin(); it != benchmarks.end(); ++it) {
+        if (it->first.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        fprintf(stderr, "%s...", it->first.c_str());
+        fflush(stderr);
+
+        const int64_t iterations = calibrate(it->second, options.min_secs);
+        std::vector<double> ns_per_op;
+        for (int i = 0; i < options.repetitions; ++i) {
+            ns_per_op.push_back(run_once(it->second, iterations) * 1e9 / iterations);
+        }
+        std::sort(ns_per_op.begin(), ns_per_op.end());
+        const double median = ns_per_op[ns_per_op.size() / 2];
+        fprintf(stderr, " %.1f ns/op\n", median);
+
+        if (!results.empty()) {
+            results += ",\n";
+        }
+        results += strprintf("    {\"name\": \"%s\", \"iterations\": %" PRIi64 ", "
+                             "\"ns_per_op_min\": %.3f, \"ns_per_op_median\": %.3f, "
+                             "\"ns_per_op_max\": %.3f}",
+                             it->first.c_str(), iterations,
+                             ns_per_op.front(), median, ns_per_op.back());
+    }
+
+    return strprintf("{\n"
+                     "  \"version\": \"%s\",\n"
+                     "  \"time\": %" PRIu64 ",\n"
+                     "  \"min_secs\": %g,\n"
+                     "  \"repetitions\": %d,\n"
+                     "  \"benchmarks\": [\n%s\n  ]\n"
+                     "}\n",
+                     RETHINKDB_CODE_VERSION,
+                     static_cast<uint64_t>(get_secs()),
+                     options.min_secs,
+                     options.repetitions,
+                     results.c_str());
+}
+
+}  // namespace microbench
@@ -0,0 +1,91 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef MICROBENCH_MICROBENCH_HPP_
+#define MICROBENCH_MICROBENCH_HPP_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "utils.hpp"
+
+/* Microbenchmarks for the storage engine's hot paths.  They're built into
+`rethinkdb-microbench`, next to `rethinkdb-unittest`, which runs each one a few times
+and writes how long an operation took to a JSON file, so that the numbers from two runs
+can be compared.
+
+A benchmark is a function that does `run->iterations()` of the operation it measures,
+between `run->start()` and `run->stop()`.  Anything it does outside of them (setting up
+a node, refilling it) isn't counted, and it can stop and start as often as it needs to.
+The benchmarks run in a coroutine in a thread pool, so they can use the cache and the
+serializer. */
+
+namespace microbench {
+
+class run_t {
+public:
+    explicit run_t(int64_t iterations);
+
+    int64_t iterations() const { return iterations_; }
+
+    void start();
+    void stop();
+
+    ticks_t elapsed() const;
+
+private:
+    const int64_t iterations_;
+    bool running_;
+    ticks_t started_;
+    ticks_t elapsed_;
+
+    DISABLE_COPYING(run_t);
+};
+
+typedef void (*benchmark_fun_t)(run_t *run);
+
+// A scratch directory in /tmp for benchmarks that use real files, removed along with
+// everything in it when it's destroyed.
+class temp_directory_t {
+public:
+    temp_directory_t();
+    ~temp_directory_t();
+
+    const base_path_t &path() const { return path_; }
+
+private:
+    static base_path_t make_directory();
+
+    const base_path_t path_;
+
+    DISABLE_COPYING(temp_directory_t);
+};
+
+class registration_t {
+public:
+    registration_t(const char *name, benchmark_fun_t fun);
+};
+
+struct options_t {
+    options_t() : min_secs(0.2), repetitions(5) { }
+
+    // Only benchmarks whose names contain `filter` are run.
+    std::string filter;
+    // Each repetition runs for at least this long.
+    double min_secs;
+    int repetitions;
+};
+
+// Runs the benchmarks and returns their results as a JSON document.  Must be called in
+// a coroutine.
+std::string run_benchmarks(const options_t &options);
+
+}  // namespace microbench
+
+#define MICROBENCH_CAT_(a, b) a ## b
+#define MICROBENCH_CAT(a, b) MICROBENCH_CAT_(a, b)
+
+#define MICROBENCH(name, fun)                                           \
+    static microbench::registration_t                                   \
+    MICROBENCH_CAT(microbench_registration_, __LINE__)(name, fun)
+
+#endif  // MICROBENCH_MICROBENCH_HPP_
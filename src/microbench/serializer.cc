@@ -0,0 +1,76 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "microbench/microbench.hpp"
+#include "serializer/config.hpp"
+
+namespace microbench {
+
+class write_cond_t : public iocallback_t, public cond_t {
+public:
+    write_cond_t() { }
+    void on_io_complete() {
+        pulse();
+    }
+};
+
+// Writes `run->iterations()` blocks to a fresh serializer file, `batch_size` at a time,
+// and waits for each batch and its index write.  The block ids are reused every so
+// often so that the file doesn't keep growing.
+static void bench_block_writes(run_t *run, int batch_size) {
+    temp_directory_t directory;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    filepath_file_opener_t file_opener(serializer_filepath_t(directory.path(),
+                                                             "serializer_file"),
+                                       &io_backender);
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+    standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                              &file_opener,
+                              &get_global_perfmon_collection());
+
+    scoped_arena_ptr_t<ser_buffer_t> buf = ser.malloc();
+    memset(buf->cache_data, 0, ser.max_block_size().value());
+    scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+
+    const block_id_t num_block_ids = 1000;
+    block_id_t next_block_id = 0;
+    run->start();
+    for (int64_t i = 0; i < run->iterations(); i += batch_size) {
+        std::vector<buf_write_info_t> infos;
+        for (int j = 0; j < batch_size; ++j) {
+            infos.push_back(buf_write_info_t(buf.get(), ser.max_block_size(),
+                                             next_block_id));
+            next_block_id = (next_block_id + 1) % num_block_ids;
+        }
+
+        write_cond_t cb;
+        std::vector<counted_t<standard_block_token_t> > tokens
+            = ser.block_writes(infos, account.get(), &cb);
+        cb.wait();
+
+        std::vector<index_write_op_t> write_ops;
+        for (size_t j = 0; j < tokens.size(); ++j) {
+            write_ops.push_back(index_write_op_t(infos[j].block_id, tokens[j],
+                                                 repli_timestamp_t::distant_past));
+        }
+        ser.index_write(write_ops, account.get());
+    }
+    run->stop();
+}
+
+static void bench_block_write(run_t *run) {
+    bench_block_writes(run, 1);
+}
+MICROBENCH("serializer/block_write", bench_block_write);
+
+static void bench_block_write_batch(run_t *run) {
+    bench_block_writes(run, 64);
+}
+MICROBENCH("serializer/block_write_batch_64", bench_block_write_batch);
+
+}  // namespace microbench
@@ -0,0 +1,56 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "perfmon/memory.hpp"
+
+#include "perfmon/perfmon.hpp"
+
+static perfmon_counter_t pm_memory_page_cache,
+    pm_memory_cursors,
+    pm_memory_coroutine_stacks,
+    pm_memory_network_buffers,
+    pm_memory_extproc_pipes;
+static perfmon_collection_t pm_memory_collection;
+static perfmon_membership_t pm_memory_membership(&get_global_perfmon_collection(),
+                                                 &pm_memory_collection, "memory");
+static perfmon_multi_membership_t pm_memory_counters_membership(&pm_memory_collection,
+    &pm_memory_page_cache, "page_cache",
+    &pm_memory_cursors, "cursors",
+    &pm_memory_coroutine_stacks, "coroutine_stacks",
+    &pm_memory_network_buffers, "network_buffers",
+    &pm_memory_extproc_pipes, "extproc_pipes");
+
+void note_memory_change(memory_category_t category, int64_t bytes) {
+    switch (category) {
+    case memory_category_t::page_cache:
+        pm_memory_page_cache += bytes;
+        break;
+    case memory_category_t::cursors:
+        pm_memory_cursors += bytes;
+        break;
+    case memory_category_t::coroutine_stacks:
+        pm_memory_coroutine_stacks += bytes;
+        break;
+    case memory_category_t::network_buffers:
+        pm_memory_network_buffers += bytes;
+        break;
+    case memory_category_t::extproc_pipes:
+        pm_memory_extproc_pipes += bytes;
+        break;
+    default:
+        unreachable();
+    }
+}
+
+memory_accounted_t::memory_accounted_t(memory_category_t category)
+    : category_(category), bytes_(0) { }
+
+memory_accounted_t::~memory_accounted_t() {
+    set(0);
+}
+
+void memory_accounted_t::set(int64_t bytes) {
+    rassert(bytes >= 0);
+    if (bytes != bytes_) {
+        note_memory_change(category_, bytes - bytes_);
+        bytes_ = bytes;
+    }
+}
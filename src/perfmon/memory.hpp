@@ -0,0 +1,46 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef PERFMON_MEMORY_HPP_
+#define PERFMON_MEMORY_HPP_
+
+#include <stdint.h>
+
+#include "errors.hpp"
+
+/* What a node's memory goes to, so that it can be told apart in its RSS.  Each
+category's bytes are counted on each thread and show up under `memory` in the
+node's stats. */
+enum class memory_category_t {
+    // The blocks in the page caches, loaded or dirty.
+    page_cache,
+    // The batches that cursors have prefetched but not sent yet.
+    cursors,
+    // The stacks of the allocated coroutines (including the free ones).
+    coroutine_stacks,
+    // The read and write buffers of TCP connections.
+    network_buffers,
+    // The shared memory rings to extproc workers.
+    extproc_pipes
+};
+
+/* Counts some number of bytes under a category, until it's destroyed.  It can be
+updated and destroyed on any thread of the thread pool, but only there. */
+class memory_accounted_t {
+public:
+    explicit memory_accounted_t(memory_category_t category);
+    ~memory_accounted_t();
+
+    void set(int64_t bytes);
+    void add(int64_t bytes) { set(bytes_ + bytes); }
+    int64_t get() const { return bytes_; }
+
+private:
+    const memory_category_t category_;
+    int64_t bytes_;
+
+    DISABLE_COPYING(memory_accounted_t);
+};
+
+// Counts `bytes` (or stops counting them, if it's negative) under `category`.
+void note_memory_change(memory_category_t category, int64_t bytes);
+
+#endif  // PERFMON_MEMORY_HPP_
@@ -18,6 +18,10 @@ static const char * stat_per_sec = "per_sec";
 static const char * stat_count = "count";
 static const char * stat_mean = "mean";
 static const char * stat_std_dev = "std_dev";
+static const char * stat_p50 = "p50";
+static const char * stat_p90 = "p90";
+static const char * stat_p99 = "p99";
+static const char * stat_p999 = "p999";
 static const char * no_value = "-";
 
 
@@ -289,11 +293,162 @@ scoped_ptr_t<perfmon_result_t> perfmon_rate_monitor_t::output_stat(const double
     return make_scoped<perfmon_result_t>(strprintf("%.8f", stat / ticks_to_secs(length)));
 }
 
+/* perfmon_histogram_t */
+
+namespace perfmon_histogram {
+
+buckets_t::buckets_t() : count(0), max(0) {
+    for (int i = 0; i < bucket_count; ++i) {
+        counts[i] = 0;
+    }
+}
+
+int buckets_t::bucket_index(uint64_t nanos) {
+    if (nanos < static_cast<uint64_t>(sub_bucket_count)) {
+        return nanos;
+    }
+    int exponent = 63 - __builtin_clzll(nanos);
+    if (exponent > max_exponent) {
+        return bucket_count - 1;
+    }
+    // The `sub_bucket_bits` bits after the leading one pick the sub-bucket
+    int sub_bucket = (nanos >> (exponent - sub_bucket_bits)) & (sub_bucket_count - 1);
+    return (exponent - sub_bucket_bits + 1) * sub_bucket_count + sub_bucket;
+}
+
+uint64_t buckets_t::bucket_lowest_nanos(int index) {
+    if (index < sub_bucket_count) {
+        return index;
+    }
+    int exponent = index / sub_bucket_count + sub_bucket_bits - 1;
+    uint64_t sub_bucket = index % sub_bucket_count;
+    return (sub_bucket_count + sub_bucket) << (exponent - sub_bucket_bits);
+}
+
+void buckets_t::record(double secs) {
+    double nanos = std::max(secs, 0.0) * 1e9;
+    ++counts[bucket_index(static_cast<uint64_t>(nanos))];
+    ++count;
+    max = std::max(max, secs);
+}
+
+void buckets_t::aggregate(const buckets_t &b) {
+    for (int i = 0; i < bucket_count; ++i) {
+        counts[i] += b.counts[i];
+    }
+    count += b.count;
+    max = std::max(max, b.max);
+}
+
+double buckets_t::percentile(double p) const {
+    rassert(count > 0);
+    int64_t rank = std::max<int64_t>(1, ceil(p * count));
+    int64_t seen = 0;
+    for (int i = 0; i < bucket_count; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            // Report the middle of the bucket, which is off by at most half of the
+            // bucket's width
+            double nanos = (bucket_lowest_nanos(i) + bucket_lowest_nanos(i + 1)) / 2.0;
+            return std::min(max, nanos / 1e9);
+        }
+    }
+    return max;
+}
+
+}   /* namespace perfmon_histogram */
+
+perfmon_histogram_t::perfmon_histogram_t(ticks_t _length)
+    : perfmon_perthread_t<buckets_t>(), length(_length)
+{
+    for (int i = 0; i < MAX_THREADS; i++) {
+        thread_data[i] = NULL;
+    }
+}
+
+perfmon_histogram_t::~perfmon_histogram_t() {
+    for (int i = 0; i < MAX_THREADS; i++) {
+        delete thread_data[i];
+    }
+}
+
+perfmon_histogram_t::thread_info_t *perfmon_histogram_t::update(ticks_t now) {
+    int interval = now / length;
+    rassert(get_thread_id().threadnum >= 0);
+    thread_info_t *thread = thread_data[get_thread_id().threadnum];
+    if (thread == NULL) {
+        return NULL;
+    }
+
+    if (thread->current_interval == interval) {
+        /* We're up to date; nothing to do */
+    } else if (thread->current_interval + 1 == interval) {
+        /* We're one step behind */
+        thread->last_buckets = thread->current_buckets;
+        thread->current_buckets = buckets_t();
+        thread->current_interval++;
+    } else {
+        /* We're more than one step behind */
+        thread->last_buckets = thread->current_buckets = buckets_t();
+        thread->current_interval = interval;
+    }
+    return thread;
+}
+
+void perfmon_histogram_t::record(double secs) {
+    ticks_t now = get_ticks();
+    thread_info_t *thread = update(now);
+    if (thread == NULL) {
+        thread = new thread_info_t;
+        thread->current_interval = now / length;
+        thread_data[get_thread_id().threadnum] = thread;
+    }
+    thread->current_buckets.record(secs);
+}
+
+void perfmon_histogram_t::get_thread_stat(buckets_t *stat) {
+    /* Like `perfmon_sampler_t`, report the last complete interval. */
+    thread_info_t *thread = update(get_ticks());
+    if (thread != NULL) {
+        *stat = thread->last_buckets;
+    }
+}
+
+perfmon_histogram_t::buckets_t perfmon_histogram_t::combine_stats(const buckets_t *stats) {
+    buckets_t aggregated;
+    for (int i = 0; i < get_num_threads(); i++) {
+        aggregated.aggregate(stats[i]);
+    }
+    return aggregated;
+}
+
+scoped_ptr_t<perfmon_result_t> perfmon_histogram_t::output_stat(const buckets_t &aggregated) {
+    scoped_ptr_t<perfmon_result_t> stat = perfmon_result_t::alloc_map_result();
+
+    stat->insert(stat_count, new perfmon_result_t(strprintf("%" PRIi64, aggregated.count)));
+    if (aggregated.count > 0) {
+        stat->insert(stat_p50, new perfmon_result_t(strprintf("%.8f", aggregated.percentile(0.5))));
+        stat->insert(stat_p90, new perfmon_result_t(strprintf("%.8f", aggregated.percentile(0.9))));
+        stat->insert(stat_p99, new perfmon_result_t(strprintf("%.8f", aggregated.percentile(0.99))));
+        stat->insert(stat_p999, new perfmon_result_t(strprintf("%.8f", aggregated.percentile(0.999))));
+        stat->insert(stat_max, new perfmon_result_t(strprintf("%.8f", aggregated.max)));
+    } else {
+        stat->insert(stat_p50, new perfmon_result_t(no_value));
+        stat->insert(stat_p90, new perfmon_result_t(no_value));
+        stat->insert(stat_p99, new perfmon_result_t(no_value));
+        stat->insert(stat_p999, new perfmon_result_t(no_value));
+        stat->insert(stat_max, new perfmon_result_t(no_value));
+    }
+
+    return stat;
+}
+
 perfmon_duration_sampler_t::perfmon_duration_sampler_t(ticks_t length, bool _ignore_global_full_perfmon)
-    : stat(), active(), total(), recent(length, true),
+    : stat(), active(), total(), recent(length, true), recent_histogram(length),
       active_membership(&stat, &active, "active_count"),
       total_membership(&stat, &total, "total"),
       recent_membership(&stat, &recent, "recent_duration"),
+      recent_histogram_membership(&stat, &recent_histogram, "recent_duration_percentiles"),
       ignore_global_full_perfmon(_ignore_global_full_perfmon)
 { }
 
@@ -310,7 +465,9 @@ void perfmon_duration_sampler_t::begin(ticks_t *v) {
 void perfmon_duration_sampler_t::end(ticks_t *v) {
     --active;
     if (*v != 0) {
-        recent.record(ticks_to_secs(get_ticks() - *v));
+        double secs = ticks_to_secs(get_ticks() - *v);
+        recent.record(secs);
+        recent_histogram.record(secs);
     }
 }
 
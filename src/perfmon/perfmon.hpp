@@ -202,11 +202,70 @@ public:
     void record(double value = 1.0);
 };
 
+/* `perfmon_histogram_t` is like `perfmon_sampler_t`, but instead of the average
+ * it reports percentiles (p50 through p999) of the durations, in seconds,
+ * recorded during the last `length` ticks. Durations are counted in log-linear
+ * buckets (eight per power of two nanoseconds, in the style of HdrHistogram), so
+ * a reported percentile is within 1/16 of the true value. Each thread only
+ * touches its own buckets, which are allocated the first time it records, and
+ * the per-thread buckets are summed when stats are collected.
+ */
+namespace perfmon_histogram {
+
+struct buckets_t {
+    static const int sub_bucket_bits = 3;
+    static const int sub_bucket_count = 1 << sub_bucket_bits;
+    // Enough for durations up to 2^43 ns, about two and a half hours
+    static const int max_exponent = 42;
+    static const int bucket_count =
+        (max_exponent - sub_bucket_bits + 2) * sub_bucket_count;
+
+    buckets_t();
+    void record(double secs);
+    void aggregate(const buckets_t &b);
+    // Returns the duration, in seconds, below which a fraction `p` of the recorded
+    // durations lie. `count` must not be zero.
+    double percentile(double p) const;
+
+    static int bucket_index(uint64_t nanos);
+    static uint64_t bucket_lowest_nanos(int index);
+
+    uint32_t counts[bucket_count];
+    int64_t count;
+    double max;
+};
+
+}   /* namespace perfmon_histogram */
+
+class perfmon_histogram_t : public perfmon_perthread_t<perfmon_histogram::buckets_t> {
+    typedef perfmon_histogram::buckets_t buckets_t;
+    struct thread_info_t {
+        buckets_t current_buckets, last_buckets;
+        int current_interval;
+    };
+
+    // Entries are `NULL` until that thread records something
+    thread_info_t *thread_data[MAX_THREADS];
+
+    void get_thread_stat(buckets_t *);
+    buckets_t combine_stats(const buckets_t *);
+    scoped_ptr_t<perfmon_result_t> output_stat(const buckets_t &);
+
+    thread_info_t *update(ticks_t now);
+
+    ticks_t length;
+public:
+    explicit perfmon_histogram_t(ticks_t _length);
+    virtual ~perfmon_histogram_t();
+    void record(double secs);
+};
+
 /* perfmon_duration_sampler_t is a perfmon_t that monitors events that have a
  * starting and ending time. When something starts, call begin(); when
  * something ends, call end() with the same value as begin. It will produce
  * stats for the number of active events, the average length of an event, and
- * so on. If `global_full_perfmon` is false, it won't report any timing-related
+ * so on, including percentiles of the recent durations. If
+ * `global_full_perfmon` is false, it won't report any timing-related
  * stats because `get_ticks()` is rather slow.
  *
  * Frequently we're in the case where we'd like to have a single slow perfmon
@@ -221,9 +280,11 @@ private:
     perfmon_counter_t active;
     perfmon_counter_t total;
     perfmon_sampler_t recent;
+    perfmon_histogram_t recent_histogram;
     perfmon_membership_t active_membership;
     perfmon_membership_t total_membership;
     perfmon_membership_t recent_membership;
+    perfmon_membership_t recent_histogram_membership;
 
     bool ignore_global_full_perfmon;
 public:
@@ -0,0 +1,128 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "perfmon/snapshot.hpp"
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <functional>
+#include <string>
+
+#include "arch/runtime/coroutines.hpp"
+#include "perfmon/collect.hpp"
+
+perfmon_snapshotter_t::perfmon_snapshotter_t()
+    : deltas_(perfmon_result_t::alloc_map_result()),
+      latest_time_(0),
+      interval_secs_(0),
+      collect_in_progress_(false),
+      drainer_(make_scoped<auto_drainer_t>()) {
+    collect_now();
+    timer_.init(new repeating_timer_t(PERFMON_SNAPSHOT_INTERVAL_MS, this));
+}
+
+perfmon_snapshotter_t::~perfmon_snapshotter_t() {
+    assert_thread();
+    timer_.reset();
+    drainer_.reset();
+}
+
+scoped_ptr_t<perfmon_result_t> perfmon_snapshotter_t::get_stats() {
+    on_thread_t thread_switcher(home_thread());
+    return make_scoped<perfmon_result_t>(*latest_);
+}
+
+void perfmon_snapshotter_t::get_stats_and_deltas(
+        scoped_ptr_t<perfmon_result_t> *stats_out,
+        scoped_ptr_t<perfmon_result_t> *deltas_out,
+        double *interval_secs_out) {
+    on_thread_t thread_switcher(home_thread());
+    *stats_out = make_scoped<perfmon_result_t>(*latest_);
+    *deltas_out = make_scoped<perfmon_result_t>(*deltas_);
+    *interval_secs_out = interval_secs_;
+}
+
+void perfmon_snapshotter_t::on_ring() {
+    assert_thread();
+    if (collect_in_progress_) {
+        return;
+    }
+    collect_in_progress_ = true;
+    coro_t::spawn_sometime(std::bind(&perfmon_snapshotter_t::collect, this,
+                                     drainer_->lock()));
+}
+
+void perfmon_snapshotter_t::collect(auto_drainer_t::lock_t) {
+    collect_now();
+    collect_in_progress_ = false;
+}
+
+void perfmon_snapshotter_t::collect_now() {
+    assert_thread();
+    scoped_ptr_t<perfmon_result_t> stats = perfmon_get_stats();
+    const ticks_t now = get_ticks();
+
+    // Nothing below blocks, so readers never see a half-updated pair.
+    if (latest_.has()) {
+        scoped_ptr_t<perfmon_result_t> deltas = perfmon_result_t::alloc_map_result();
+        perfmon_compute_deltas(*latest_, *stats, deltas.get());
+        deltas_ = std::move(deltas);
+        interval_secs_ = ticks_to_secs(now - latest_time_);
+    }
+    latest_ = std::move(stats);
+    latest_time_ = now;
+}
+
+static bool parse_stat(const std::string &value, int64_t *int_out, double *double_out,
+                       bool *is_int_out) {
+    if (strtoi64_strict(value, 10, int_out)) {
+        *is_int_out = true;
+        return true;
+    }
+    const char *begin = value.c_str();
+    char *end;
+    *double_out = strtod(begin, &end);
+    *is_int_out = false;
+    return end != begin && *end == '\0';
+}
+
+void perfmon_compute_deltas(const perfmon_result_t &previous,
+                            const perfmon_result_t &latest,
+                            perfmon_result_t *out) {
+    rassert(out->is_map());
+    if (!previous.is_map() || !latest.is_map()) {
+        return;
+    }
+    const perfmon_result_t::internal_map_t *previous_map = previous.get_map();
+    for (auto it = latest.begin(); it != latest.end(); ++it) {
+        auto prev = previous_map->find(it->first);
+        if (prev == previous_map->end()) {
+            continue;
+        }
+        if (it->second->is_map()) {
+            scoped_ptr_t<perfmon_result_t> child = perfmon_result_t::alloc_map_result();
+            perfmon_compute_deltas(*prev->second, *it->second, child.get());
+            if (child->get_map_size() != 0) {
+                out->insert(it->first, child.release());
+            }
+        } else if (prev->second->is_string()) {
+            int64_t latest_int, previous_int;
+            double latest_double, previous_double;
+            bool latest_is_int, previous_is_int;
+            if (!parse_stat(*it->second->get_string(),
+                            &latest_int, &latest_double, &latest_is_int)
+                || !parse_stat(*prev->second->get_string(),
+                               &previous_int, &previous_double, &previous_is_int)) {
+                continue;
+            }
+            std::string delta;
+            if (latest_is_int && previous_is_int) {
+                delta = strprintf("%" PRIi64, latest_int - previous_int);
+            } else {
+                delta = strprintf("%g",
+                    (latest_is_int ? latest_int : latest_double)
+                    - (previous_is_int ? previous_int : previous_double));
+            }
+            out->insert(it->first, new perfmon_result_t(delta));
+        }
+    }
+}
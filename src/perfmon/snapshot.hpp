@@ -0,0 +1,54 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef PERFMON_SNAPSHOT_HPP_
+#define PERFMON_SNAPSHOT_HPP_
+
+#include "arch/timing.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "containers/scoped.hpp"
+#include "perfmon/core.hpp"
+
+/* `perfmon_snapshotter_t` collects all the stats every PERFMON_SNAPSHOT_INTERVAL_MS
+in the background, so that a stats request costs a copy of the latest snapshot
+instead of a visit to every perfmon on every thread.  It keeps the change of each
+numeric stat between the last two snapshots, too.  Stats are at most one interval
+old. */
+class perfmon_snapshotter_t : public repeating_timer_callback_t,
+                              public home_thread_mixin_t {
+public:
+    // Blocks, collecting the first snapshot.
+    perfmon_snapshotter_t();
+    ~perfmon_snapshotter_t();
+
+    // These may be called on any thread and return copies.  `*interval_secs_out` is
+    // set to the time between the two snapshots that `*deltas_out` compares, or 0 if
+    // there has only been one so far (in which case there are no deltas).
+    scoped_ptr_t<perfmon_result_t> get_stats();
+    void get_stats_and_deltas(scoped_ptr_t<perfmon_result_t> *stats_out,
+                              scoped_ptr_t<perfmon_result_t> *deltas_out,
+                              double *interval_secs_out);
+
+private:
+    void on_ring();
+    void collect(auto_drainer_t::lock_t lock);
+    void collect_now();
+
+    scoped_ptr_t<perfmon_result_t> latest_;
+    scoped_ptr_t<perfmon_result_t> deltas_;
+    ticks_t latest_time_;
+    double interval_secs_;
+
+    bool collect_in_progress_;
+
+    scoped_ptr_t<auto_drainer_t> drainer_;
+    scoped_ptr_t<repeating_timer_t> timer_;
+
+    DISABLE_COPYING(perfmon_snapshotter_t);
+};
+
+// Fills `out`, which must be a map, with `latest - previous` for every numeric stat
+// present in both.
+void perfmon_compute_deltas(const perfmon_result_t &previous,
+                            const perfmon_result_t &latest,
+                            perfmon_result_t *out);
+
+#endif  // PERFMON_SNAPSHOT_HPP_
@@ -16,11 +16,13 @@
 #include "arch/timing.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/one_per_thread.hpp"
 #include "containers/archive/archive.hpp"
 #include "http/http.hpp"
 
 class auth_key_t;
 class auth_semilattice_metadata_t;
+class new_semaphore_acq_t;
 template <class> class semilattice_readwrite_view_t;
 
 enum protob_server_callback_mode_t {
@@ -119,14 +121,26 @@ private:
 // // Initializes *request to a value that contains a protocol buffers object.
 // void make_empty_protob_bearer(request_t *request);
 //
+// // Makes *request hold an empty protocol buffers object again, reusing the one
+// // it has (and the memory its fields have allocated) if nothing else still
+// // refers to it.
+// void reset_protob_bearer(request_t *request);
+//
 // // Retrieves the protocol buffers object from an initialized request_t.
 // request_t::protob_type *underlying_protob_value(request_t *request);
 //
+// // In CORO_UNORDERED mode, whether the request has to wait for every request
+// // that came before it on its connection to finish.
+// bool request_waits_for_earlier(request_t *request);
+//
+// In CORO_UNORDERED mode, requests with the same token() run one at a time, in the
+// order they arrived, and the rest of a connection's requests run concurrently.
+//
 // "request_t::protob_type" does not actually have to be defined.
 
 
 template <class request_t, class response_t, class context_t>
-class protob_server_t : public http_app_t {
+class protob_server_t : public http_app_t, public home_thread_mixin_t {
 public:
     protob_server_t(const std::set<ip_address_t> &local_addresses,
                     int port,
@@ -139,7 +153,14 @@ public:
     int get_port() const;
 private:
 
-    void handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn, auto_drainer_t::lock_t);
+    // Called on whichever thread accepted the connection
+    void handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn);
+    // The requests that a connection is running in CORO_UNORDERED mode
+    class pipeline_t;
+    void handle_pipelined_request(pipeline_t *pipeline,
+                                  request_t request,
+                                  new_semaphore_acq_t *request_slot,
+                                  auto_drainer_t::lock_t keepalive);
     void send(const response_t &, tcp_conn_t *conn, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
     static auth_key_t read_auth_key(tcp_conn_t *conn, signal_t *interruptor);
 
@@ -153,11 +174,19 @@ private:
 
     protob_server_callback_mode_t cb_mode;
 
+    // Whether `tcp_listener` accepts connections on every thread.  This is set
+    // before the listener exists, because it may call `handle_conn` before its
+    // constructor returns.
+    const bool sharded_listener;
+
     /* WARNING: The order here is fragile. */
     cond_t main_shutting_down_cond;
     signal_t *shutdown_signal() { return &shutting_down_conds[get_thread_id().threadnum]; }
     boost::ptr_vector<cross_thread_signal_t> shutting_down_conds;
     auto_drainer_t auto_drainer;
+    // Connections are accepted on every thread, so each takes a lock on its own
+    // thread's drainer.
+    one_per_thread_t<auto_drainer_t> conn_drainers;
     struct pulse_on_destruct_t {
         explicit pulse_on_destruct_t(cond_t *_cond) : cond(_cond) { }
         ~pulse_on_destruct_t() { cond->pulse(); }
@@ -165,7 +194,7 @@ private:
     } pulse_sdc_on_shutdown;
     http_conn_cache_t<context_t> http_conn_cache;
 
-    scoped_ptr_t<tcp_listener_t> tcp_listener;
+    scoped_ptr_t<sharded_tcp_listener_t> tcp_listener;
 
     unsigned next_thread;
 };
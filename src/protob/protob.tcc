@@ -6,6 +6,8 @@
 
 #include <google/protobuf/stubs/common.h>
 
+#include <functional>
+#include <map>
 #include <set>
 #include <string>
 
@@ -15,8 +17,13 @@
 
 #include "arch/arch.hpp"
 #include "arch/io/network.hpp"
+#include "arch/io/tls.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/mutex.hpp"
+#include "concurrency/new_semaphore.hpp"
+#include "concurrency/rwlock.hpp"
+#include "concurrency/wait_any.hpp"
 #include "containers/auth_key.hpp"
 #include "rpc/semilattice/joins/vclock.hpp"
 #include "rpc/semilattice/view.hpp"
@@ -35,6 +42,7 @@ protob_server_t<request_t, response_t, context_t>::protob_server_t(
       on_unparsable_query(_on_unparsable_query),
       auth_metadata(_auth_metadata),
       cb_mode(_cb_mode),
+      sharded_listener(sharded_tcp_listener_t::can_shard()),
       shutting_down_conds(get_num_threads()),
       pulse_sdc_on_shutdown(&main_shutting_down_cond),
       next_thread(0) {
@@ -47,11 +55,11 @@ protob_server_t<request_t, response_t, context_t>::protob_server_t(
     }
 
     try {
-        tcp_listener.init(new tcp_listener_t(
+        tcp_listener.init(new sharded_tcp_listener_t(
             local_addresses,
             port,
             boost::bind(&protob_server_t<request_t, response_t, context_t>::handle_conn,
-                        this, _1, auto_drainer_t::lock_t(&auto_drainer))));
+                        this, _1)));
     } catch (const address_in_use_exc_t &ex) {
         throw address_in_use_exc_t(strprintf("Could not bind to RDB protocol port: %s", ex.what()));
     }
@@ -96,14 +104,112 @@ auth_key_t protob_server_t<request_t, response_t, context_t>::read_auth_key(tcp_
 }
 
 template <class request_t, class response_t, class context_t>
-void protob_server_t<request_t, response_t, context_t>::handle_conn(
-    const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
-    auto_drainer_t::lock_t keepalive) {
+class protob_server_t<request_t, response_t, context_t>::pipeline_t {
+public:
+    pipeline_t(tcp_conn_t *_conn, context_t *_ctx, signal_t *_closer)
+        : conn(_conn), ctx(_ctx), closer(_closer),
+          requests_sem(MAX_PIPELINED_QUERIES_PER_CONNECTION),
+          earlier_requests_lock(NULL, rwlock_fairness_t::phase_fair) { }
+
+    tcp_conn_t *const conn;
+    context_t *const ctx;
+    signal_t *const closer;
+
+    // Limits how many of the connection's requests run at once.
+    new_semaphore_t requests_sem;
+    // Every request gets in line for this, for write if it waits for the requests
+    // before it and for read otherwise.  It's phase-fair, so that a client that
+    // pipelines `noreply_wait`s between its queries doesn't get its queries run a
+    // few at a time.
+    rwlock_t earlier_requests_lock;
+    // Requests get in line for their token's lock, for write, so that requests
+    // with the same token run one at a time.
+    struct token_lock_t {
+        token_lock_t() : users(0) { }
+        rwlock_t lock;
+        int users;
+    };
+    std::map<int64_t, token_lock_t *> token_locks;
+    // Keeps responses from being interleaved on the connection.
+    mutex_t send_mutex;
+
+    // Destroyed first, so that the requests are done before the rest goes away.
+    auto_drainer_t drainer;
+
+private:
+    DISABLE_COPYING(pipeline_t);
+};
+
+template <class request_t, class response_t, class context_t>
+void protob_server_t<request_t, response_t, context_t>::handle_pipelined_request(
+        pipeline_t *pipeline,
+        request_t request,
+        new_semaphore_acq_t *request_slot,
+        auto_drainer_t::lock_t keepalive) {
+    scoped_ptr_t<new_semaphore_acq_t> request_slot_holder(request_slot);
+    const int64_t token = underlying_protob_value(&request)->token();
+    const bool waits_for_earlier = request_waits_for_earlier(&request);
+
+    // We're spawned right as the request arrives, and get in line for both locks
+    // before blocking, so the lines are in the order the requests arrived.
+    rwlock_in_line_t earlier_requests(&pipeline->earlier_requests_lock,
+                                      waits_for_earlier ? access_t::write
+                                                        : access_t::read);
+    typename pipeline_t::token_lock_t *token_lock;
+    {
+        auto it = pipeline->token_locks.find(token);
+        if (it == pipeline->token_locks.end()) {
+            token_lock = new typename pipeline_t::token_lock_t;
+            pipeline->token_locks.insert(std::make_pair(token, token_lock));
+        } else {
+            token_lock = it->second;
+        }
+        ++token_lock->users;
+    }
+
+    {
+        rwlock_in_line_t same_token(&token_lock->lock, access_t::write);
+        try {
+            wait_interruptible(waits_for_earlier ? earlier_requests.write_signal()
+                                                 : earlier_requests.read_signal(),
+                               keepalive.get_drain_signal());
+            wait_interruptible(same_token.write_signal(), keepalive.get_drain_signal());
 
-    // This must be read here because of home threads and stuff
-    const vclock_t<auth_key_t> auth_vclock = auth_metadata->get().auth_key;
+            response_t response;
+            if (f(request, &response, pipeline->ctx)) {
+                mutex_t::acq_t send_acq(&pipeline->send_mutex);
+                send(response, pipeline->conn, pipeline->closer);
+            }
+        } catch (const interrupted_exc_t &) {
+            // The connection is going away.
+        } catch (const tcp_conn_write_closed_exc_t &) {
+            // The connection's reader will notice, too.
+        }
+    }
 
-    threadnum_t chosen_thread = threadnum_t((next_thread++) % get_num_db_threads());
+    if (--token_lock->users == 0) {
+        pipeline->token_locks.erase(token);
+        delete token_lock;
+    }
+}
+
+template <class request_t, class response_t, class context_t>
+void protob_server_t<request_t, response_t, context_t>::handle_conn(
+    const scoped_ptr_t<tcp_conn_descriptor_t> &nconn) {
+    auto_drainer_t::lock_t keepalive(conn_drainers.get());
+
+    // This must be read on our home thread because the view lives there
+    vclock_t<auth_key_t> auth_vclock;
+    {
+        on_thread_t thread_switcher(home_thread());
+        auth_vclock = auth_metadata->get().auth_key;
+    }
+
+    // A sharded listener already accepted the connection on a thread of the
+    // kernel's choosing, so we stay there.
+    threadnum_t chosen_thread = sharded_listener
+        ? get_thread_id()
+        : threadnum_t((next_thread++) % get_num_db_threads());
     cross_thread_signal_t ct_keepalive(keepalive.get_drain_signal(), chosen_thread);
     on_thread_t rethreader(chosen_thread);
 
@@ -124,6 +230,12 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
     std::string init_error;
 
     try {
+        if (tls_ctx_t *tls_ctx = get_driver_tls_ctx()) {
+            if (!conn->start_tls(tls_ctx, tls_role_t::server, &ct_keepalive)) {
+                return;
+            }
+        }
+
         if (auth_vclock.in_conflict()) {
             throw protob_server_exc_t("authorization key is in conflict, resolve it through the admin UI before connecting clients");
         }
@@ -165,10 +277,31 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
         return;
     }
 
-    //TODO figure out how to do this with less copying
+    scoped_ptr_t<pipeline_t> pipeline;
+    if (cb_mode == CORO_UNORDERED) {
+        pipeline.init(new pipeline_t(conn.get(), &ctx, &ct_keepalive));
+    }
+
+    // Queries are read into the same buffer each time, so that a client sending a
+    // stream of big inserts doesn't get a fresh allocation (and fresh pages) for each.
+    // They're parsed into the same protocol buffers object too, whenever the last
+    // query is done with it.
+    scoped_array_t<char> data;
+    request_t request;
+
     for (;;) {
-        request_t request;
-        make_empty_protob_bearer(&request);
+        scoped_ptr_t<new_semaphore_acq_t> request_slot;
+        if (pipeline.has()) {
+            // Stop reading requests while the connection has too many running.
+            request_slot.init(new new_semaphore_acq_t(&pipeline->requests_sem, 1));
+            try {
+                wait_interruptible(request_slot->acquisition_signal(), &ct_keepalive);
+            } catch (const interrupted_exc_t &) {
+                return;
+            }
+        }
+
+        reset_protob_bearer(&request);
         bool force_response = false;
         response_t forced_response;
         std::string err;
@@ -180,7 +313,15 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
                 forced_response = on_unparsable_query(request_t(), err);
                 force_response = true;
             } else {
-                scoped_array_t<char> data(size);
+                const size_t max_reused_size = MAX_REUSED_QUERY_BUFFER_SIZE;
+                if (static_cast<size_t>(size) > data.size()
+                    || (data.size() > max_reused_size
+                        && static_cast<size_t>(size) <= max_reused_size)) {
+                    // A buffer that outgrew the limit goes away with the next
+                    // smaller query.
+                    data.reset();
+                    data.init(size);
+                }
                 conn->read(data.data(), size, &ct_keepalive);
 
                 const bool res
@@ -214,7 +355,15 @@ void protob_server_t<request_t, response_t, context_t>::handle_conn(
                 crash("unimplemented");
                 break;
             case CORO_UNORDERED:
-                crash("unimplemented");
+                if (force_response) {
+                    mutex_t::acq_t send_acq(&pipeline->send_mutex);
+                    send(forced_response, conn.get(), &ct_keepalive);
+                } else {
+                    coro_t::spawn_now_dangerously(std::bind(
+                        &protob_server_t::handle_pipelined_request, this,
+                        pipeline.get(), request, request_slot.release(),
+                        auto_drainer_t::lock_t(&pipeline->drainer)));
+                }
                 break;
             default:
                 crash("unreachable");
@@ -234,11 +383,16 @@ void protob_server_t<request_t, response_t, context_t>::send(
     tcp_conn_t *conn,
     signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     int size = res.ByteSize();
-    conn->write(&size, sizeof(res.ByteSize()), closer);
     scoped_array_t<char> data(size);
-
     res.SerializeToArray(data.data(), size);
-    conn->write(data.data(), size, closer);
+
+    // Send the size and the response with one system call
+    iovec bufs[2];
+    bufs[0].iov_base = &size;
+    bufs[0].iov_len = sizeof(size);
+    bufs[1].iov_base = data.data();
+    bufs[1].iov_len = size;
+    conn->writev(bufs, 2, closer);
 }
 
 // Used in protob_server_t::handle(...) below to combine the interruptor from the
@@ -327,7 +481,9 @@ void protob_server_t<request_t, response_t, context_t>::handle(const http_req_t
 
             response_t response;
             switch (cb_mode) {
+            // HTTP sessions only run one query at a time anyway.
             case INLINE:
+            case CORO_UNORDERED:
                 {
                     boost::shared_ptr<typename http_conn_cache_t<context_t>::http_conn_t> conn =
                         http_conn_cache.find(conn_id);
@@ -368,7 +524,6 @@ void protob_server_t<request_t, response_t, context_t>::handle(const http_req_t
                 }
                 break;
             case CORO_ORDERED:
-            case CORO_UNORDERED:
                 crash("unimplemented");
             default:
                 crash("unreachable");
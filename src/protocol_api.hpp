@@ -50,6 +50,14 @@ public:
     virtual void read_outdated(const typename protocol_t::read_t &, typename protocol_t::read_response_t *response, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) = 0;
     virtual void write(const typename protocol_t::write_t &, typename protocol_t::write_response_t *response, order_token_t tok, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) = 0;
 
+    /* Like `read_outdated()`, but only reads from replicas that are at most
+    `max_staleness` writes behind their primary. Namespaces without replicas
+    just read from the primary. */
+    virtual void read_bounded_staleness(const typename protocol_t::read_t &r, typename protocol_t::read_response_t *response, uint64_t max_staleness, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) {
+        (void)max_staleness;
+        read(r, response, order_token_t::ignore.with_read_mode(), interruptor);
+    }
+
     /* These calls are for the sole purpose of optimizing queries; don't rely
     on them for correctness. They should not block. */
     virtual std::set<typename protocol_t::region_t> get_sharding_scheme() THROWS_ONLY(cannot_perform_query_exc_t) {
@@ -288,6 +296,9 @@ template <class protocol_t>
 class chunk_fun_callback_t {
 public:
     virtual void send_chunk(const typename protocol_t::backfill_chunk_t &, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
+    /* Says that every chunk for `sent_region` has been sent already, so the
+    receiver may record that part as caught up. */
+    virtual void send_progress(const typename protocol_t::region_t &sent_region, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
 
 protected:
     chunk_fun_callback_t() { }
@@ -342,6 +353,19 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(durability_requirement_t,
                                       DURABILITY_REQUIREMENT_DEFAULT,
                                       DURABILITY_REQUIREMENT_SOFT);
 
+// Which class of work a read or write is part of:
+//  - QUERY_PRIORITY_INTERACTIVE: the queries an application waits on.
+//  - QUERY_PRIORITY_BATCH: analytics and bulk jobs, which run at a lower coroutine
+//    priority and read through a lower-priority cache account, so that they don't
+//    add to the latency of interactive queries.
+enum query_priority_t { QUERY_PRIORITY_INTERACTIVE,
+                        QUERY_PRIORITY_BATCH };
+
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(query_priority_t,
+                                      int8_t,
+                                      QUERY_PRIORITY_INTERACTIVE,
+                                      QUERY_PRIORITY_BATCH);
+
 template <class protocol_t>
 class store_view_t : public home_thread_mixin_t {
 public:
@@ -2,6 +2,9 @@
 
 #include "rdb_protocol/batching.hpp"
 
+#include <math.h>
+
+#include "config/args.hpp"
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
@@ -62,14 +65,18 @@ batchspec_t batchspec_t::with_at_most(uint64_t _max_els) const {
 }
 
 batchspec_t batchspec_t::scale_down(int64_t divisor) const {
-    // These numbers are sort of arbitrary, but they seem to work.  We divide by
-    // 7/8th of the divisor and add 8 to reduce the chances of needing a second
-    // round-trip (we add a constant because unequal division is more likely
-    // with very small sizes).  Law of large numbers says that the chances of
-    // needing a second round-trip for large, non-pathological datasets are
-    // extremely low.
-    int64_t new_els_left = (els_left * 8 / (7 * divisor)) + 8;
-    int64_t new_size_left = (size_left * 8 / (7 * divisor)) + 8;
+    // Each shard gets its share of the elements plus some slack, so that the
+    // shards' batches rarely add up to less than the whole one, which would need a
+    // second round-trip.  The number of rows a hash shard has in a range is about
+    // binomial, so two standard deviations over its share is plenty; it's also
+    // small, so a `limit` doesn't have every shard send many more rows than it
+    // needs.  (The shares are computed first so that an unlimited number of
+    // elements doesn't overflow.)  The sizes of rows vary too much for that, so
+    // for bytes we divide by 7/8th of the divisor and add 8, which seems to work.
+    const int64_t els_share = els_left / divisor;
+    int64_t new_els_left = els_share
+        + 2 * static_cast<int64_t>(std::sqrt(static_cast<double>(els_share))) + 2;
+    int64_t new_size_left = (size_left / (7 * divisor)) * 8 + 8;
     return batchspec_t(batch_type,
                        std::min(els_left, new_els_left),
                        std::min(size_left, new_size_left),
@@ -101,6 +108,43 @@ batcher_t::batcher_t(
       size_left(size),
       end_time(_end_time) { }
 
+cursor_batch_sizer_t::cursor_batch_sizer_t()
+    : max_els(CURSOR_INITIAL_BATCH_ELS),
+      batch_start(0),
+      last_sent(0),
+      usecs_per_el(0) { }
+
+void cursor_batch_sizer_t::note_request(microtime_t now) {
+    if (last_sent != 0 && now < last_sent + CURSOR_QUICK_CONTINUE_USECS) {
+        max_els = std::min<int64_t>(max_els * 2, CURSOR_MAX_BATCH_ELS);
+    }
+}
+
+batchspec_t cursor_batch_sizer_t::next_batchspec(const batchspec_t &user_batchspec,
+                                                 microtime_t now) {
+    batch_start = now;
+    return user_batchspec.with_at_most(max_els);
+}
+
+void cursor_batch_sizer_t::note_batch(size_t num_els, microtime_t now) {
+    if (num_els == 0) {
+        return;
+    }
+    const double cost = static_cast<double>(now - batch_start) / num_els;
+    if (usecs_per_el == 0) {
+        usecs_per_el = cost;
+    } else {
+        if (cost > CURSOR_COST_SPIKE_FACTOR * usecs_per_el) {
+            max_els = std::max<int64_t>(max_els / 2, CURSOR_INITIAL_BATCH_ELS);
+        }
+        usecs_per_el = 0.75 * usecs_per_el + 0.25 * cost;
+    }
+}
+
+void cursor_batch_sizer_t::note_sent(microtime_t now) {
+    last_sent = now;
+}
+
 size_t array_size_limit() { return 100000; }
 
 } // namespace ql
@@ -78,6 +78,34 @@ private:
     microtime_t end_time;
 };
 
+/* Adapts the batches of a cursor to how the client reads it, within the caps of the
+batchspec the user asked for.  (See CURSOR_INITIAL_BATCH_ELS.) */
+class cursor_batch_sizer_t {
+public:
+    cursor_batch_sizer_t();
+
+    // Notes that the client asked for a batch at `now`.  (The batch it gets may have
+    // been fetched before then.)
+    void note_request(microtime_t now);
+    // The batchspec for the next batch, which we start fetching at `now`.
+    batchspec_t next_batchspec(const batchspec_t &user_batchspec, microtime_t now);
+    // Notes that the batch, of `num_els` elements, was finished at `now`.
+    void note_batch(size_t num_els, microtime_t now);
+    // Notes that a batch was sent to the client at `now`.
+    void note_sent(microtime_t now);
+
+private:
+    int64_t max_els;
+    microtime_t batch_start;
+    // Zero until the first batch has been sent.
+    microtime_t last_sent;
+    // A moving average of how long each element has taken to produce, or zero
+    // until we know.
+    double usecs_per_el;
+
+    DISABLE_COPYING(cursor_batch_sizer_t);
+};
+
 // TODO: make user-tunable.
 size_t array_size_limit();
 
@@ -5,11 +5,15 @@
 #include <vector>
 
 #include "btree/backfill.hpp"
+#include "btree/bulk_load.hpp"
 #include "btree/concurrent_traversal.hpp"
 #include "btree/erase_range.hpp"
+#include "btree/external_sort.hpp"
+#include "btree/get_distribution.hpp"
 #include "btree/get_distribution.hpp"
 #include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
+#include "btree/superblock.hpp"
 #include "buffer_cache/alt/alt_serialize_onto_blob.hpp"
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
@@ -18,7 +22,9 @@
 #include "rdb_protocol/blob_wrapper.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/lazy_json.hpp"
+#include "rdb_protocol/text.hpp"
 #include "rdb_protocol/transform_visitors.hpp"
+#include "stl_utils.hpp"
 
 value_sizer_t<rdb_value_t>::value_sizer_t(block_size_t bs) : block_size_(bs) { }
 
@@ -35,7 +41,7 @@ bool value_sizer_t<rdb_value_t>::fits(const void *value, int length_available) c
 }
 
 int value_sizer_t<rdb_value_t>::max_possible_size() const {
-    return blob::btree_maxreflen;
+    return rdb_value_t::max_size(MAX_INLINE_VALUE_SIZE);
 }
 
 block_magic_t value_sizer_t<rdb_value_t>::leaf_magic() {
@@ -50,22 +56,31 @@ block_magic_t value_sizer_t<rdb_value_t>::btree_leaf_magic() const {
 block_size_t value_sizer_t<rdb_value_t>::block_size() const { return block_size_; }
 
 bool btree_value_fits(block_size_t bs, int data_length, const rdb_value_t *value) {
-    return blob::ref_fits(bs, data_length, value->value_ref(), blob::btree_maxreflen);
+    if (data_length < 1) {
+        return false;
+    }
+    if (value->is_wide()) {
+        if (data_length < rdb_value_t::WIDE_VALUE_HEADER_SIZE) {
+            return false;
+        }
+        data_length -= rdb_value_t::WIDE_VALUE_HEADER_SIZE;
+    }
+    return blob::ref_fits(bs, data_length, value->value_ref(), value->maxreflen());
 }
 
 // Remember that secondary indexes and the main btree both point to the same rdb
 // value -- you don't want to double-delete that value!
 void actually_delete_rdb_value(buf_parent_t parent, void *value) {
-    blob_t blob(parent.cache()->get_block_size(),
-                static_cast<rdb_value_t *>(value)->value_ref(),
-                blob::btree_maxreflen);
+    rdb_value_t *rdb_value = static_cast<rdb_value_t *>(value);
+    blob_t blob(parent.cache()->get_block_size(), rdb_value->value_ref(),
+                rdb_value->maxreflen());
     blob.clear(parent);
 }
 
 void detach_rdb_value(buf_parent_t parent, void *value) {
-    blob_t blob(parent.cache()->get_block_size(),
-                static_cast<rdb_value_t *>(value)->value_ref(),
-                blob::btree_maxreflen);
+    rdb_value_t *rdb_value = static_cast<rdb_value_t *>(value);
+    blob_t blob(parent.cache()->get_block_size(), rdb_value->value_ref(),
+                rdb_value->maxreflen());
     blob.detach_subtrees(parent);
 }
 
@@ -75,13 +90,145 @@ void rdb_get(const store_key_t &store_key, btree_slice_t *slice,
     keyvalue_location_t<rdb_value_t> kv_location;
     find_keyvalue_location_for_read(superblock, store_key.btree_key(), &kv_location,
                                     &slice->stats, trace);
+    slice->stats.pm_hot_keys.record(store_key);
 
     if (!kv_location.value.has()) {
         response->data.reset(new ql::datum_t(ql::datum_t::R_NULL));
     } else {
         response->data = get_data(kv_location.value.get(),
-                                  buf_parent_t(&kv_location.buf));
+                                  buf_parent_t(&kv_location.buf),
+                                  slice->field_dictionary());
+    }
+}
+
+class rdb_batched_get_callback_t : public depth_first_traversal_callback_t {
+public:
+    rdb_batched_get_callback_t(batched_point_read_response_t *_response,
+                               const field_dictionary_t *_dictionary,
+                               profile::trace_t *_trace)
+        : response(_response), dictionary(_dictionary), trace(_trace) { }
+
+    virtual bool handle_pair(scoped_key_value_t &&keyvalue) {
+        response->rows[store_key_t(keyvalue.key())]
+            = get_data(static_cast<const rdb_value_t *>(keyvalue.value()),
+                       keyvalue.expose_buf(), dictionary);
+        return true;
+    }
+
+    virtual profile::trace_t *get_trace() THROWS_NOTHING { return trace; }
+
+private:
+    batched_point_read_response_t *response;
+    const field_dictionary_t *dictionary;
+    profile::trace_t *trace;
+};
+
+void rdb_batched_get(const std::vector<store_key_t> &keys, btree_slice_t *slice,
+                     superblock_t *superblock,
+                     batched_point_read_response_t *response,
+                     profile::trace_t *trace) {
+    for (size_t i = 0; i < keys.size(); ++i) {
+        slice->stats.pm_keys_read.record();
+    }
+    rdb_batched_get_callback_t callback(response, slice->field_dictionary(), trace);
+    btree_keys_traversal(superblock, keys, &callback);
+}
+
+// Sets `*data_out` to the value of `key`'s latest message in `write_buffer` (R_NULL
+// for a deletion) and returns true, or returns false if the buffer has no message
+// for `key`.
+static bool get_from_write_buffer(const btree_write_buffer_t *write_buffer,
+                                  const store_key_t &key,
+                                  const field_dictionary_t *dictionary,
+                                  counted_t<const ql::datum_t> *data_out) {
+    const btree_write_buffer_t::message_t *message = write_buffer->find(key);
+    if (message == NULL) {
+        return false;
+    }
+    if (message->deletion) {
+        data_out->reset(new ql::datum_t(ql::datum_t::R_NULL));
+    } else {
+        inplace_vector_read_stream_t stream(&message->value);
+        archive_result_t res = deserialize_from_storage(&stream, data_out, dictionary);
+        guarantee_deserialization(res, "buffered rdb value");
+    }
+    return true;
+}
+
+void rdb_buffered_get(const store_key_t &key, btree_slice_t *slice,
+                      const btree_write_buffer_t *write_buffer,
+                      superblock_t *superblock, point_read_response_t *response,
+                      profile::trace_t *trace) {
+    counted_t<const ql::datum_t> data;
+    if (get_from_write_buffer(write_buffer, key, slice->field_dictionary(), &data)) {
+        superblock->release();
+        slice->stats.pm_keys_read.record();
+        slice->stats.pm_hot_keys.record(key);
+        response->data = data;
+    } else {
+        rdb_get(key, slice, superblock, response, trace);
+    }
+}
+
+void rdb_buffered_batched_get(const std::vector<store_key_t> &keys,
+                              btree_slice_t *slice,
+                              const btree_write_buffer_t *write_buffer,
+                              superblock_t *superblock,
+                              batched_point_read_response_t *response,
+                              profile::trace_t *trace) {
+    // The buffer has to be read before the superblock is released.
+    std::vector<store_key_t> btree_keys;
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        counted_t<const ql::datum_t> data;
+        if (!get_from_write_buffer(write_buffer, *it, slice->field_dictionary(),
+                                   &data)) {
+            btree_keys.push_back(*it);
+        } else if (data->get_type() != ql::datum_t::R_NULL) {
+            slice->stats.pm_keys_read.record();
+            response->rows[*it] = data;
+        }
     }
+    rdb_batched_get(btree_keys, slice, superblock, response, trace);
+}
+
+// The value of `key`, as rdb_buffered_get would read it, except that `superblock`
+// is kept.  R_NULL if there's no such row.
+static counted_t<const ql::datum_t> buffered_get_keeping_superblock(
+        const store_key_t &key, btree_slice_t *slice,
+        const btree_write_buffer_t *write_buffer, superblock_t *superblock,
+        profile::trace_t *trace) {
+    counted_t<const ql::datum_t> data;
+    if (get_from_write_buffer(write_buffer, key, slice->field_dictionary(), &data)) {
+        return data;
+    }
+    // rdb_get releases the superblock once, which this doesn't let go to zero.
+    refcount_superblock_t kept_superblock(superblock, 2);
+    point_read_response_t response;
+    rdb_get(key, slice, &kept_superblock, &response, trace);
+    return response.data;
+}
+
+// Adds a message to `write_buffer` that sets `key`'s row to `data`, or deletes it if
+// `data` is R_NULL.
+static void buffer_row(btree_write_buffer_t *write_buffer, superblock_t *superblock,
+                       btree_slice_t *slice, const store_key_t &key,
+                       const counted_t<const ql::datum_t> &data,
+                       repli_timestamp_t timestamp) {
+    btree_write_buffer_t::message_t message;
+    message.timestamp = timestamp;
+    if (data->get_type() == ql::datum_t::R_NULL) {
+        message.deletion = true;
+    } else {
+        write_message_t wm;
+        serialize_for_storage(&wm, data, slice->field_dictionary());
+        vector_stream_t stream;
+        stream.reserve(wm.size());
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+        message.value = stream.vector();
+    }
+    write_buffer->add(superblock->expose_buf(), key, message);
+    slice->stats.pm_keys_set.record();
 }
 
 void kv_location_delete(keyvalue_location_t<rdb_value_t> *kv_location,
@@ -101,8 +248,8 @@ void kv_location_delete(keyvalue_location_t<rdb_value_t> *kv_location,
         guarantee(mod_info_out->deleted.second.empty());
 
         mod_info_out->deleted.second.assign(
-                kv_location->value->value_ref(),
-                kv_location->value->value_ref()
+                kv_location->value->contents,
+                kv_location->value->contents
                 + kv_location->value->inline_size(block_size));
     }
 
@@ -112,24 +259,27 @@ void kv_location_delete(keyvalue_location_t<rdb_value_t> *kv_location,
             expired_t::NO, &null_cb);
 }
 
-void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
-                     const store_key_t &key,
-                     counted_t<const ql::datum_t> data,
-                     repli_timestamp_t timestamp,
-                     rdb_modification_info_t *mod_info_out) {
-    scoped_malloc_t<rdb_value_t> new_value(blob::btree_maxreflen);
-    memset(new_value.get(), 0, blob::btree_maxreflen);
+// Sets the value at `kv_location` to the document serialized in `wm`.
+static void kv_location_set_serialized(keyvalue_location_t<rdb_value_t> *kv_location,
+                                       const store_key_t &key,
+                                       const write_message_t &wm,
+                                       int maxreflen,
+                                       repli_timestamp_t timestamp,
+                                       rdb_modification_info_t *mod_info_out) {
+    scoped_malloc_t<rdb_value_t> new_value(rdb_value_t::max_size(maxreflen));
+    memset(new_value.get(), 0, rdb_value_t::max_size(maxreflen));
+    new_value->init(maxreflen);
 
     const block_size_t block_size = kv_location->buf.cache()->get_block_size();
     {
-        blob_t blob(block_size, new_value->value_ref(), blob::btree_maxreflen);
-        serialize_onto_blob(buf_parent_t(&kv_location->buf), &blob, data);
+        blob_t blob(block_size, new_value->value_ref(), maxreflen);
+        write_onto_blob(buf_parent_t(&kv_location->buf), &blob, wm);
     }
 
     if (mod_info_out) {
         guarantee(mod_info_out->added.second.empty());
-        mod_info_out->added.second.assign(new_value->value_ref(),
-            new_value->value_ref() + new_value->inline_size(block_size));
+        mod_info_out->added.second.assign(new_value->contents,
+            new_value->contents + new_value->inline_size(block_size));
     }
 
     if (kv_location->value.has()) {
@@ -137,8 +287,8 @@ void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
         if (mod_info_out != NULL) {
             guarantee(mod_info_out->deleted.second.empty());
             mod_info_out->deleted.second.assign(
-                    kv_location->value->value_ref(),
-                    kv_location->value->value_ref()
+                    kv_location->value->contents,
+                    kv_location->value->contents
                     + kv_location->value->inline_size(block_size));
         }
     }
@@ -150,6 +300,19 @@ void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
                           expired_t::NO, &null_cb);
 }
 
+void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
+                     const store_key_t &key,
+                     counted_t<const ql::datum_t> data,
+                     int maxreflen,
+                     field_dictionary_t *dictionary,
+                     repli_timestamp_t timestamp,
+                     rdb_modification_info_t *mod_info_out) {
+    write_message_t wm;
+    serialize_for_storage(&wm, data, dictionary);
+    kv_location_set_serialized(kv_location, key, wm, maxreflen, timestamp,
+                               mod_info_out);
+}
+
 void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
                      const store_key_t &key,
                      const std::vector<char> &value_ref,
@@ -170,119 +333,138 @@ void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
                           expired_t::NO, &null_cb);
 }
 
-batched_replace_response_t rdb_replace_and_return_superblock(
-    const btree_loc_info_t &info,
+// Calls `replacer` on `old_val` (which is R_NULL if there's no row with `key`),
+// checks the new value, and adds what that does to the row to `resp`.  Returns the
+// new value (R_NULL to delete the row), or an empty pointer if the row doesn't
+// change.  Throws if the new value isn't allowed.
+static counted_t<const ql::datum_t> replace_row(
+    const std::string &primary_key,
+    const store_key_t &key,
+    const counted_t<const ql::datum_t> &old_val,
     const btree_point_replacer_t *replacer,
-    promise_t<superblock_t *> *superblock_promise,
-    rdb_modification_info_t *mod_info_out,
-    profile::trace_t *trace)
-{
+    ql::datum_ptr_t *resp) {
     bool return_vals = replacer->should_return_vals();
-    const std::string &primary_key = *info.btree->primary_key;
-    const store_key_t &key = *info.key;
+    guarantee(old_val.has());
+    const bool started_empty = old_val->get_type() == ql::datum_t::R_NULL;
+    bool ended_empty;
+    if (!started_empty) {
+        guarantee(old_val->get(primary_key, ql::NOTHROW).has());
+    }
+    if (return_vals == RETURN_VALS) {
+        bool conflict = resp->add("old_val", old_val)
+                     || resp->add("new_val", old_val); // changed below
+        guarantee(!conflict);
+    }
+
+    counted_t<const ql::datum_t> new_val = replacer->replace(old_val);
+    if (return_vals == RETURN_VALS) {
+        bool conflict = resp->add("new_val", new_val, ql::CLOBBER);
+        guarantee(conflict); // We set it to `old_val` previously.
+    }
+    if (new_val->get_type() == ql::datum_t::R_NULL) {
+        ended_empty = true;
+    } else if (new_val->get_type() == ql::datum_t::R_OBJECT) {
+        ended_empty = false;
+        new_val->rcheck_valid_replace(
+            old_val, counted_t<const ql::datum_t>(), primary_key);
+        counted_t<const ql::datum_t> pk = new_val->get(primary_key, ql::NOTHROW);
+        rcheck_target(
+            new_val, ql::base_exc_t::GENERIC,
+            key.compare(store_key_t(pk->print_primary())) == 0,
+            (started_empty
+             ? strprintf("Primary key `%s` cannot be changed (null -> %s)",
+                         primary_key.c_str(), new_val->print().c_str())
+             : strprintf("Primary key `%s` cannot be changed (%s -> %s)",
+                         primary_key.c_str(),
+                         old_val->print().c_str(), new_val->print().c_str())));
+    } else {
+        rfail_typed_target(
+            new_val, "Inserted value must be an OBJECT (got %s):\n%s",
+            new_val->get_type_name().c_str(), new_val->print().c_str());
+    }
+
+    // We use `conflict` below to store whether or not there was a key
+    // conflict when constructing the stats object.  It defaults to `true`
+    // so that we fail an assertion if we never update the stats object.
+    bool conflict = true;
+    counted_t<const ql::datum_t> change;
+
+    // Figure out what operation we're doing (based on started_empty,
+    // ended_empty, and the result of the function call).
+    if (started_empty) {
+        if (ended_empty) {
+            conflict = resp->add("skipped", make_counted<ql::datum_t>(1.0));
+        } else {
+            conflict = resp->add("inserted", make_counted<ql::datum_t>(1.0));
+            r_sanity_check(new_val->get(primary_key, ql::NOTHROW).has());
+            change = new_val;
+        }
+    } else {
+        if (ended_empty) {
+            conflict = resp->add("deleted", make_counted<ql::datum_t>(1.0));
+            change = new_val;
+        } else {
+            r_sanity_check(
+                *old_val->get(primary_key) == *new_val->get(primary_key));
+            if (*old_val == *new_val) {
+                conflict = resp->add("unchanged",
+                                     make_counted<ql::datum_t>(1.0));
+            } else {
+                conflict = resp->add("replaced", make_counted<ql::datum_t>(1.0));
+                r_sanity_check(new_val->get(primary_key, ql::NOTHROW).has());
+                change = new_val;
+            }
+        }
+    }
+    guarantee(!conflict); // message never added twice
+    return change;
+}
+
+// Replaces the value at `kv_location`, which was found for `key`.
+batched_replace_response_t rdb_replace_at_location(
+    const btree_info_t &info,
+    keyvalue_location_t<rdb_value_t> *kv_location,
+    const store_key_t &key,
+    const btree_point_replacer_t *replacer,
+    rdb_modification_info_t *mod_info_out)
+{
     ql::datum_ptr_t resp(ql::datum_t::R_OBJECT);
     try {
-        keyvalue_location_t<rdb_value_t> kv_location;
-        find_keyvalue_location_for_write(info.superblock, info.key->btree_key(),
-                                         &kv_location,
-                                         &info.btree->slice->stats,
-                                         trace,
-                                         superblock_promise);
-
-        bool started_empty, ended_empty;
         counted_t<const ql::datum_t> old_val;
-        if (!kv_location.value.has()) {
+        if (!kv_location->value.has()) {
             // If there's no entry with this key, pass NULL to the function.
-            started_empty = true;
             old_val = make_counted<ql::datum_t>(ql::datum_t::R_NULL);
         } else {
             // Otherwise pass the entry with this key to the function.
-            started_empty = false;
-            old_val = get_data(kv_location.value.get(),
-                               buf_parent_t(&kv_location.buf));
-            guarantee(old_val->get(primary_key, ql::NOTHROW).has());
-        }
-        guarantee(old_val.has());
-        if (return_vals == RETURN_VALS) {
-            bool conflict = resp.add("old_val", old_val)
-                         || resp.add("new_val", old_val); // changed below
-            guarantee(!conflict);
+            old_val = get_data(kv_location->value.get(),
+                               buf_parent_t(&kv_location->buf),
+                               info.slice->field_dictionary());
         }
 
-        counted_t<const ql::datum_t> new_val = replacer->replace(old_val);
-        if (return_vals == RETURN_VALS) {
-            bool conflict = resp.add("new_val", new_val, ql::CLOBBER);
-            guarantee(conflict); // We set it to `old_val` previously.
-        }
-        if (new_val->get_type() == ql::datum_t::R_NULL) {
-            ended_empty = true;
-        } else if (new_val->get_type() == ql::datum_t::R_OBJECT) {
-            ended_empty = false;
-            new_val->rcheck_valid_replace(
-                old_val, counted_t<const ql::datum_t>(), primary_key);
-            counted_t<const ql::datum_t> pk = new_val->get(primary_key, ql::NOTHROW);
-            rcheck_target(
-                new_val, ql::base_exc_t::GENERIC,
-                key.compare(store_key_t(pk->print_primary())) == 0,
-                (started_empty
-                 ? strprintf("Primary key `%s` cannot be changed (null -> %s)",
-                             primary_key.c_str(), new_val->print().c_str())
-                 : strprintf("Primary key `%s` cannot be changed (%s -> %s)",
-                             primary_key.c_str(),
-                             old_val->print().c_str(), new_val->print().c_str())));
+        counted_t<const ql::datum_t> new_val
+            = replace_row(*info.primary_key, key, old_val, replacer, &resp);
+        if (!new_val.has()) {
+            // The row stays as it is.
+        } else if (new_val->get_type() == ql::datum_t::R_NULL) {
+            kv_location_delete(kv_location, key, info.timestamp,
+                               mod_info_out);
+            guarantee(!mod_info_out->deleted.second.empty());
+            guarantee(mod_info_out->added.second.empty());
+            mod_info_out->deleted.first = old_val;
         } else {
-            rfail_typed_target(
-                new_val, "Inserted value must be an OBJECT (got %s):\n%s",
-                new_val->get_type_name().c_str(), new_val->print().c_str());
-        }
-
-        // We use `conflict` below to store whether or not there was a key
-        // conflict when constructing the stats object.  It defaults to `true`
-        // so that we fail an assertion if we never update the stats object.
-        bool conflict = true;
-
-        // Figure out what operation we're doing (based on started_empty,
-        // ended_empty, and the result of the function call) and then do it.
-        if (started_empty) {
-            if (ended_empty) {
-                conflict = resp.add("skipped", make_counted<ql::datum_t>(1.0));
-            } else {
-                conflict = resp.add("inserted", make_counted<ql::datum_t>(1.0));
-                r_sanity_check(new_val->get(primary_key, ql::NOTHROW).has());
-                kv_location_set(&kv_location, *info.key, new_val, info.btree->timestamp,
-                                mod_info_out);
+            kv_location_set(kv_location, key, new_val,
+                            info.slice->value_maxreflen(),
+                            info.slice->field_dictionary(), info.timestamp,
+                            mod_info_out);
+            guarantee(!mod_info_out->added.second.empty());
+            mod_info_out->added.first = new_val;
+            if (old_val->get_type() == ql::datum_t::R_NULL) {
                 guarantee(mod_info_out->deleted.second.empty());
-                guarantee(!mod_info_out->added.second.empty());
-                mod_info_out->added.first = new_val;
-            }
-        } else {
-            if (ended_empty) {
-                conflict = resp.add("deleted", make_counted<ql::datum_t>(1.0));
-                kv_location_delete(&kv_location, *info.key, info.btree->timestamp,
-                                   mod_info_out);
+            } else {
                 guarantee(!mod_info_out->deleted.second.empty());
-                guarantee(mod_info_out->added.second.empty());
                 mod_info_out->deleted.first = old_val;
-            } else {
-                r_sanity_check(
-                    *old_val->get(primary_key) == *new_val->get(primary_key));
-                if (*old_val == *new_val) {
-                    conflict = resp.add("unchanged",
-                                         make_counted<ql::datum_t>(1.0));
-                } else {
-                    conflict = resp.add("replaced", make_counted<ql::datum_t>(1.0));
-                    r_sanity_check(new_val->get(primary_key, ql::NOTHROW).has());
-                    kv_location_set(&kv_location, *info.key, new_val,
-                                    info.btree->timestamp,
-                                    mod_info_out);
-                    guarantee(!mod_info_out->deleted.second.empty());
-                    guarantee(!mod_info_out->added.second.empty());
-                    mod_info_out->added.first = new_val;
-                    mod_info_out->deleted.first = old_val;
-                }
             }
         }
-        guarantee(!conflict); // message never added twice
     } catch (const ql::base_exc_t &e) {
         resp.add_error(e.what());
     } catch (const interrupted_exc_t &e) {
@@ -311,13 +493,20 @@ private:
     const size_t index;
 };
 
-void do_a_replace_from_batched_replace(
+// Replaces the values of `keys[begin]` and of as many of the keys after it as are
+// under the same parent node, with one walk down the tree.  The superblock is only
+// handed back once we know how many keys that is, which we put in `*end_out`.
+void do_replaces_from_batched_replace(
     auto_drainer_t::lock_t,
     fifo_enforcer_sink_t *batched_replaces_fifo_sink,
     const fifo_enforcer_write_token_t &batched_replaces_fifo_token,
-    const btree_loc_info_t &info,
-    const one_replace_t one_replace,
+    const btree_info_t *info,
+    superblock_t *superblock,
+    const std::vector<store_key_t> *keys,
+    size_t begin,
+    const btree_batched_replacer_t *replacer,
     promise_t<superblock_t *> *superblock_promise,
+    size_t *end_out,
     rdb_modification_report_cb_t *sindex_cb,
     batched_replace_response_t *stats_out,
     profile::trace_t *trace)
@@ -325,17 +514,59 @@ void do_a_replace_from_batched_replace(
     fifo_enforcer_sink_t::exit_write_t exiter(
         batched_replaces_fifo_sink, batched_replaces_fifo_token);
 
-    rdb_modification_report_t mod_report(*info.key);
-    counted_t<const ql::datum_t> res = rdb_replace_and_return_superblock(
-        info, &one_replace, superblock_promise, &mod_report.info, trace);
-    *stats_out = (*stats_out)->merge(res, ql::stats_merge);
+    std::vector<rdb_modification_report_t> mod_reports;
+    {
+        promise_t<superblock_t *> descent_superblock;
+        keyvalue_location_t<rdb_value_t> kv_location;
+        find_keyvalue_location_for_write(superblock, (*keys)[begin].btree_key(),
+                                         &kv_location, &info->slice->stats, trace,
+                                         &descent_superblock);
+
+        const size_t max_end = begin + max_writes_under_parent(&kv_location);
+        size_t end = begin + 1;
+        while (end < keys->size() && end < max_end
+               && key_is_under_parent(&kv_location, (*keys)[begin].btree_key(),
+                                      (*keys)[end].btree_key())) {
+            ++end;
+        }
+
+        *end_out = end;
+        if (kv_location.superblock == NULL) {
+            // It was handed to us on the way down the tree.
+            superblock_promise->pulse(descent_superblock.wait());
+        } else if (end > begin + 1) {
+            // The leaf's parent is the root, but max_writes_under_parent made sure
+            // that our writes can't replace it, so we don't need the superblock.
+            superblock_t *sb = kv_location.superblock;
+            kv_location.superblock = NULL;
+            superblock_promise->pulse(sb);
+        } else {
+            kv_location.pass_back_superblock = superblock_promise;
+        }
+        if (end == begin + 1) {
+            // Nothing else needs the leaf's parent.
+            release_ancestors_if_leaf_is_safe(&kv_location);
+        }
+
+        for (size_t i = begin; i < end; ++i) {
+            if (i != begin) {
+                move_keyvalue_location_for_write(&kv_location, (*keys)[i].btree_key());
+            }
+            rdb_modification_report_t mod_report((*keys)[i]);
+            one_replace_t one_replace(replacer, i);
+            counted_t<const ql::datum_t> res = rdb_replace_at_location(
+                *info, &kv_location, (*keys)[i], &one_replace, &mod_report.info);
+            *stats_out = (*stats_out)->merge(res, ql::stats_merge);
+            mod_reports.push_back(mod_report);
+        }
+    }
 
     // KSI: What is this for?  are we waiting to get in line to call on_mod_report?
     // I guess so.
 
-    // JD: Looks like this is a do_a_replace_from_batched_replace specific thing.
+    // JD: Looks like this is a do_replaces_from_batched_replace specific thing.
     exiter.wait();
-    sindex_cb->on_mod_report(mod_report);
+    sindex_cb->on_mod_reports(mod_reports);
 }
 
 batched_replace_response_t rdb_batched_replace(
@@ -358,30 +589,82 @@ batched_replace_response_t rdb_batched_replace(
         // Note the destructor ordering: We release the superblock before draining
         // on all the write operations.
         scoped_ptr_t<superblock_t> current_superblock(superblock->release());
-        for (size_t i = 0; i < keys.size(); ++i) {
+        for (size_t i = 0; i < keys.size();) {
             // Pass out the point_replace_response_t.
             promise_t<superblock_t *> superblock_promise;
+            size_t end;
             coro_t::spawn_sometime(
                 std::bind(
-                    &do_a_replace_from_batched_replace,
+                    &do_replaces_from_batched_replace,
                     auto_drainer_t::lock_t(&drainer),
                     &batched_replaces_fifo_sink,
                     batched_replaces_fifo_source.enter_write(),
 
-                    btree_loc_info_t(&info, current_superblock.release(), &keys[i]),
-                    one_replace_t(replacer, i),
+                    &info,
+                    current_superblock.release(),
+                    &keys,
+                    i,
+                    replacer,
 
                     &superblock_promise,
+                    &end,
                     sindex_cb,
                     &stats,
                     trace));
 
             current_superblock.init(superblock_promise.wait());
+            i = end;
         }
     } // Make sure the drainer is destructed before the return statement.
     return stats;
 }
 
+batched_replace_response_t rdb_buffered_batched_replace(
+    const btree_info_t &info,
+    btree_write_buffer_t *write_buffer,
+    scoped_ptr_t<superblock_t> *superblock,
+    const std::vector<store_key_t> &keys,
+    const btree_batched_replacer_t *replacer,
+    rdb_modification_report_cb_t *sindex_cb,
+    profile::trace_t *trace) {
+    counted_t<const ql::datum_t> stats(new ql::datum_t(ql::datum_t::R_OBJECT));
+    std::vector<rdb_modification_report_t> mod_reports;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        ql::datum_ptr_t resp(ql::datum_t::R_OBJECT);
+        rdb_modification_report_t mod_report(keys[i]);
+        try {
+            counted_t<const ql::datum_t> old_val = buffered_get_keeping_superblock(
+                keys[i], info.slice, write_buffer, superblock->get(), trace);
+            one_replace_t one_replace(replacer, i);
+            counted_t<const ql::datum_t> new_val
+                = replace_row(*info.primary_key, keys[i], old_val, &one_replace,
+                              &resp);
+            if (new_val.has()) {
+                buffer_row(write_buffer, superblock->get(), info.slice, keys[i],
+                           new_val, info.timestamp);
+                // The modification report has no serialized values, which only
+                // secondary indexes need.
+                if (old_val->get_type() != ql::datum_t::R_NULL) {
+                    mod_report.info.deleted.first = old_val;
+                }
+                if (new_val->get_type() != ql::datum_t::R_NULL) {
+                    mod_report.info.added.first = new_val;
+                }
+            }
+        } catch (const ql::base_exc_t &e) {
+            resp.add_error(e.what());
+        } catch (const interrupted_exc_t &e) {
+            std::string msg = strprintf("interrupted (%s:%d)", __FILE__, __LINE__);
+            resp.add_error(msg.c_str());
+        }
+        stats = stats->merge(resp.to_counted(), ql::stats_merge);
+        mod_reports.push_back(mod_report);
+    }
+    superblock->reset();
+    sindex_cb->on_mod_reports(mod_reports);
+    return stats;
+}
+
 void rdb_set(const store_key_t &key,
              counted_t<const ql::datum_t> data,
              bool overwrite,
@@ -394,18 +677,22 @@ void rdb_set(const store_key_t &key,
     keyvalue_location_t<rdb_value_t> kv_location;
     find_keyvalue_location_for_write(superblock, key.btree_key(), &kv_location,
                                      &slice->stats, trace);
+    release_ancestors_if_leaf_is_safe(&kv_location);
+    slice->stats.pm_hot_keys.record(key);
     const bool had_value = kv_location.value.has();
 
     /* update the modification report */
     if (kv_location.value.has()) {
         mod_info->deleted.first = get_data(kv_location.value.get(),
-                                           buf_parent_t(&kv_location.buf));
+                                           buf_parent_t(&kv_location.buf),
+                                           slice->field_dictionary());
     }
 
     mod_info->added.first = data;
 
     if (overwrite || !had_value) {
-        kv_location_set(&kv_location, key, data, timestamp, mod_info);
+        kv_location_set(&kv_location, key, data, slice->value_maxreflen(),
+                        slice->field_dictionary(), timestamp, mod_info);
         guarantee(mod_info->deleted.second.empty() == !had_value &&
                   !mod_info->added.second.empty());
     }
@@ -413,34 +700,68 @@ void rdb_set(const store_key_t &key,
         (had_value ? point_write_result_t::DUPLICATE : point_write_result_t::STORED);
 }
 
+void rdb_bulk_load(
+        const std::vector<std::pair<store_key_t, counted_t<const ql::datum_t> > > &rows,
+        btree_slice_t *slice,
+        repli_timestamp_t timestamp,
+        superblock_t *superblock) {
+    const block_size_t block_size = superblock->cache()->get_block_size();
+    value_sizer_t<rdb_value_t> sizer(block_size);
+    btree_bulk_loader_t loader(&sizer, superblock, timestamp);
+
+    const int maxreflen = slice->value_maxreflen();
+    scoped_malloc_t<rdb_value_t> value(rdb_value_t::max_size(maxreflen));
+    for (auto it = rows.begin(); it != rows.end(); ++it) {
+        memset(value.get(), 0, rdb_value_t::max_size(maxreflen));
+        value->init(maxreflen);
+        {
+            // The leaf node the value ends up in doesn't exist yet, so the value's
+            // blocks hang off of the txn.
+            blob_t blob(block_size, value->value_ref(), maxreflen);
+            write_message_t wm;
+            serialize_for_storage(&wm, it->second, slice->field_dictionary());
+            write_onto_blob(buf_parent_t(superblock->expose_buf().txn()), &blob, wm);
+        }
+        loader.add(it->first.btree_key(), value.get());
+        slice->stats.pm_keys_set.record();
+    }
+    loader.finish();
+}
+
 class agnostic_rdb_backfill_callback_t : public agnostic_backfill_callback_t {
 public:
     agnostic_rdb_backfill_callback_t(rdb_backfill_callback_t *cb,
-                                     const key_range_t &kr,
+                                     const rdb_protocol_t::region_t &region,
                                      btree_slice_t *slice) :
-        cb_(cb), kr_(kr), slice_(slice) { }
+        cb_(cb), region_(region), slice_(slice) { }
 
     void on_delete_range(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
-        rassert(kr_.is_superset(range));
-        cb_->on_delete_range(range, interruptor);
+        rassert(region_.inner.is_superset(range));
+        cb_->on_delete_range(rdb_protocol_t::region_t(region_.beg, region_.end, range), interruptor);
     }
 
     void on_deletion(const btree_key_t *key, repli_timestamp_t recency, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
-        rassert(kr_.contains_key(key->contents, key->size));
+        rassert(region_.inner.contains_key(key->contents, key->size));
+        if (!has_our_hash(key)) {
+            return;
+        }
         cb_->on_deletion(key, recency, interruptor);
     }
 
     void on_pair(buf_parent_t leaf_node, repli_timestamp_t recency,
                  const btree_key_t *key, const void *val,
                  signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
-        rassert(kr_.contains_key(key->contents, key->size));
+        rassert(region_.inner.contains_key(key->contents, key->size));
+        if (!has_our_hash(key)) {
+            return;
+        }
         const rdb_value_t *value = static_cast<const rdb_value_t *>(val);
 
         slice_->stats.pm_keys_read.record();
 
         rdb_protocol_details::backfill_atom_t atom;
         atom.key.assign(key->size, key->contents);
-        atom.value = get_data(value, leaf_node);
+        atom.value = get_data(value, leaf_node, slice_->field_dictionary());
         atom.recency = recency;
         cb_->on_keyvalue(atom, interruptor);
     }
@@ -449,20 +770,31 @@ public:
         cb_->on_sindexes(sindexes, interruptor);
     }
 
+    void on_progress(const key_range_t &sent_range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        rassert(region_.inner.is_superset(sent_range));
+        cb_->on_progress(rdb_protocol_t::region_t(region_.beg, region_.end, sent_range), interruptor);
+    }
+
+    // The traversal only knows about key ranges, so it finds the keys of every hash.
+    bool has_our_hash(const btree_key_t *key) const {
+        const uint64_t h = hash_region_hasher(key->contents, key->size);
+        return region_.beg <= h && h < region_.end;
+    }
+
     rdb_backfill_callback_t *cb_;
-    key_range_t kr_;
+    rdb_protocol_t::region_t region_;
     btree_slice_t *slice_;
 };
 
-void rdb_backfill(btree_slice_t *slice, const key_range_t& key_range,
+void rdb_backfill(btree_slice_t *slice, const rdb_protocol_t::region_t &region,
                   repli_timestamp_t since_when, rdb_backfill_callback_t *callback,
                   superblock_t *superblock,
                   buf_lock_t *sindex_block,
                   parallel_traversal_progress_t *p, signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t) {
-    agnostic_rdb_backfill_callback_t agnostic_cb(callback, key_range, slice);
+    agnostic_rdb_backfill_callback_t agnostic_cb(callback, region, slice);
     value_sizer_t<rdb_value_t> sizer(superblock->cache()->get_block_size());
-    do_agnostic_btree_backfill(&sizer, key_range, since_when, &agnostic_cb,
+    do_agnostic_btree_backfill(&sizer, region.inner, since_when, &agnostic_cb,
                                superblock, sindex_block, p, interruptor);
 }
 
@@ -474,18 +806,114 @@ void rdb_delete(const store_key_t &key, btree_slice_t *slice,
     keyvalue_location_t<rdb_value_t> kv_location;
     find_keyvalue_location_for_write(superblock, key.btree_key(),
             &kv_location, &slice->stats, trace);
+    release_ancestors_if_leaf_is_safe(&kv_location);
     bool exists = kv_location.value.has();
 
     /* Update the modification report. */
     if (exists) {
         mod_info->deleted.first = get_data(kv_location.value.get(),
-                                           buf_parent_t(&kv_location.buf));
+                                           buf_parent_t(&kv_location.buf),
+                                           slice->field_dictionary());
         kv_location_delete(&kv_location, key, timestamp, mod_info);
     }
     guarantee(!mod_info->deleted.second.empty() && mod_info->added.second.empty());
     response->result = (exists ? point_delete_result_t::DELETED : point_delete_result_t::MISSING);
 }
 
+void rdb_buffered_set(const store_key_t &key,
+                      counted_t<const ql::datum_t> data,
+                      bool overwrite,
+                      btree_slice_t *slice,
+                      btree_write_buffer_t *write_buffer,
+                      repli_timestamp_t timestamp,
+                      superblock_t *superblock,
+                      point_write_response_t *response_out,
+                      rdb_modification_info_t *mod_info,
+                      profile::trace_t *trace) {
+    counted_t<const ql::datum_t> old_val = buffered_get_keeping_superblock(
+        key, slice, write_buffer, superblock, trace);
+    const bool had_value = old_val->get_type() != ql::datum_t::R_NULL;
+
+    /* update the modification report */
+    if (had_value) {
+        mod_info->deleted.first = old_val;
+    }
+    mod_info->added.first = data;
+
+    if (overwrite || !had_value) {
+        buffer_row(write_buffer, superblock, slice, key, data, timestamp);
+    }
+    response_out->result =
+        (had_value ? point_write_result_t::DUPLICATE : point_write_result_t::STORED);
+}
+
+void rdb_buffered_delete(const store_key_t &key, btree_slice_t *slice,
+                         btree_write_buffer_t *write_buffer,
+                         repli_timestamp_t timestamp,
+                         superblock_t *superblock, point_delete_response_t *response,
+                         rdb_modification_info_t *mod_info,
+                         profile::trace_t *trace) {
+    counted_t<const ql::datum_t> old_val = buffered_get_keeping_superblock(
+        key, slice, write_buffer, superblock, trace);
+    const bool exists = old_val->get_type() != ql::datum_t::R_NULL;
+
+    /* Update the modification report. */
+    if (exists) {
+        mod_info->deleted.first = old_val;
+        buffer_row(write_buffer, superblock, slice, key,
+                   make_counted<ql::datum_t>(ql::datum_t::R_NULL), timestamp);
+    }
+    response->result = (exists ? point_delete_result_t::DELETED : point_delete_result_t::MISSING);
+}
+
+// Applies `message` to the value at `kv_location`, which was found for `key`.
+static void apply_write_buffer_message(keyvalue_location_t<rdb_value_t> *kv_location,
+                                       const store_key_t &key,
+                                       const btree_write_buffer_t::message_t &message,
+                                       btree_slice_t *slice) {
+    if (message.deletion) {
+        // The row may never have made it to the btree.
+        if (kv_location->value.has()) {
+            kv_location_delete(kv_location, key, message.timestamp, NULL);
+        }
+    } else {
+        write_message_t wm;
+        wm.append(message.value.data(), message.value.size());
+        kv_location_set_serialized(kv_location, key, wm, slice->value_maxreflen(),
+                                   message.timestamp, NULL);
+    }
+}
+
+void rdb_flush_write_buffer(btree_slice_t *slice,
+                            superblock_t *superblock,
+                            const btree_write_buffer_t::message_map_t &messages) {
+    auto it = messages.begin();
+    while (it != messages.end()) {
+        promise_t<superblock_t *> pass_back_superblock;
+        {
+            keyvalue_location_t<rdb_value_t> kv_location;
+            find_keyvalue_location_for_write(superblock, it->first.btree_key(),
+                                             &kv_location, &slice->stats, NULL,
+                                             &pass_back_superblock);
+            const store_key_t &found_key = it->first;
+            const int max_writes = max_writes_under_parent(&kv_location);
+            int writes = 0;
+            for (;;) {
+                apply_write_buffer_message(&kv_location, it->first, it->second, slice);
+                ++it;
+                ++writes;
+                if (it == messages.end() || writes == max_writes
+                    || !key_is_under_parent(&kv_location, found_key.btree_key(),
+                                            it->first.btree_key())) {
+                    break;
+                }
+                move_keyvalue_location_for_write(&kv_location, it->first.btree_key());
+            }
+        }
+        superblock = pass_back_superblock.wait();
+    }
+}
+
 void rdb_value_deleter_t::delete_value(buf_parent_t parent, void *value) {
     actually_delete_rdb_value(parent, value);
 }
@@ -626,6 +1054,17 @@ size_t estimate_rget_response_size(const counted_t<const ql::datum_t> &datum) {
     return serialized_size(datum);
 }
 
+// Reads a stored row's fields straight off of its blob, if it has a key directory.
+class stored_row_fields_t : public ql::row_fields_t {
+public:
+    explicit stored_row_fields_t(const lazy_json_t *_row) : row(_row) { }
+    bool get_field(const std::string &key, counted_t<const ql::datum_t> *out) const {
+        return row->get_field_if_indexed(key, out);
+    }
+private:
+    const lazy_json_t *row;
+};
+
 class rdb_rget_depth_first_traversal_callback_t
     : public concurrent_traversal_callback_t {
 public:
@@ -671,6 +1110,8 @@ public:
         ql::map_wire_func_t _sindex_function,
         sindex_multi_bool_t _sindex_multi,
         datum_range_t _sindex_range,
+        const boost::optional<ql::geo_region_t> &_geo_region,
+        const std::vector<std::string> &_text_words,
         rget_read_response_t *_response,
         btree_slice_t *_slice)
         : bad_init(false),
@@ -683,6 +1124,8 @@ public:
           primary_key_range(_primary_key_range),
           sindex_range(_sindex_range),
           sindex_multi(_sindex_multi),
+          geo_region(_geo_region),
+          text_words(_text_words),
           slice(_slice)
     {
         sindex_function = _sindex_function.compile_wire_func();
@@ -705,6 +1148,20 @@ public:
                 query_language::terminal_initialize(&*terminal, &response->result);
             }
 
+            if (!transform.empty()) {
+                if (const filter_transform_t *filter
+                        = boost::get<filter_transform_t>(&transform.front())) {
+                    prefilter_func = filter->filter_func.compile_wire_func();
+                }
+            }
+
+            if (sindex_function.has() && !terminal && transform.size() == 1) {
+                if (const ql::map_wire_func_t *map
+                        = boost::get<ql::map_wire_func_t>(&transform.front())) {
+                    covered_map_func = map->compile_wire_func();
+                }
+            }
+
             disabler.init(new profile::disabler_t(ql_env->trace));
             sampler.init(new profile::sampler_t("Range traversal doc evaluation.", ql_env->trace));
         } catch (const ql::exc_t &e2) {
@@ -736,7 +1193,21 @@ public:
 
         try {
             lazy_json_t first_value(static_cast<const rdb_value_t *>(keyvalue.value()),
-                                    keyvalue.expose_buf());
+                                    keyvalue.expose_buf(), slice->field_dictionary());
+
+            // Rows that the first filter can reject from just the stored fields it
+            // looks at never get loaded.
+            bool passed_first_filter = false;
+            if (prefilter_func.has()) {
+                bool passes;
+                if (prefilter_func->prefilter(stored_row_fields_t(&first_value),
+                                              &passes)) {
+                    if (!passes) {
+                        return true;
+                    }
+                    passed_first_filter = true;
+                }
+            }
 
             // When doing "count" queries, we don't want to actually load the json
             // value. Here we detect up-front whether we will need to load the value.
@@ -749,7 +1220,24 @@ public:
             // to be loaded, and the code would be safer (and algorithmically more
             // parallelized).
 
-            if (sindex_function.has() || !transform.empty() || !terminal
+            // A sindex read that maps each row to some of its fields (like
+            // `getAll(..., {index: ...}).pluck(...)`), with a sindex function that's
+            // also just a field, reads those fields off the sindex entry's copy of
+            // the row and never loads the rest of it.
+            counted_t<const ql::datum_t> covered_sindex_value;
+            counted_t<const ql::datum_t> covered_row;
+            if (covered_map_func.has()) {
+                stored_row_fields_t fields(&first_value);
+                if (!sindex_function->call_on_fields(fields, &covered_sindex_value)
+                    || !covered_map_func->call_on_fields(fields, &covered_row)) {
+                    covered_row.reset();
+                }
+            }
+
+            if (covered_row.has()) {
+                slice->stats.pm_keys_read.record();
+                first_value.reset();
+            } else if (sindex_function.has() || !transform.empty() || !terminal
                 || query_language::terminal_uses_value(*terminal)) {
                 // Force the value to be loaded.
                 first_value.get();
@@ -773,16 +1261,38 @@ public:
             }
 
             std::vector<lazy_json_t> data;
-            data.push_back(first_value);
+            data.push_back(covered_row.has() ? lazy_json_t(covered_row) : first_value);
 
             counted_t<const ql::datum_t> sindex_value;
-            if (sindex_function) {
+            if (covered_row.has()) {
+                sindex_value = covered_sindex_value;
+            } else if (sindex_function) {
                 sindex_value =
                     sindex_function->call(ql_env, first_value.get())->as_datum();
+            }
+            if (sindex_function) {
                 guarantee(sindex_range);
                 guarantee(sindex_multi);
 
-                if (sindex_multi == sindex_multi_bool_t::MULTI &&
+                if (sindex_multi == sindex_multi_bool_t::TEXT) {
+                    // The key is one of the value's words, tagged with which one.
+                    std::vector<std::string> words;
+                    try {
+                        words = ql::text_words_of_datum(sindex_value);
+                    } catch (const ql::datum_exc_t &e2) {
+                        response->result = e2;
+                        return false;
+                    }
+                    boost::optional<uint64_t> tag =
+                        ql::datum_t::extract_tag(key_to_unescaped_str(store_key));
+                    guarantee(tag);
+                    guarantee(words.size() > *tag);
+                    if (!ql::text_has_words(words, text_words)) {
+                        return true;
+                    }
+                    sindex_value = make_counted<const ql::datum_t>(
+                        std::string(words[*tag]));
+                } else if (sindex_multi != sindex_multi_bool_t::SINGLE &&
                     sindex_value->get_type() == ql::datum_t::R_ARRAY) {
                         boost::optional<uint64_t> tag =
                             ql::datum_t::extract_tag(key_to_unescaped_str(store_key));
@@ -790,26 +1300,40 @@ public:
                         guarantee(sindex_value->size() > *tag);
                         sindex_value = sindex_value->get(*tag);
                 }
+                if (sindex_multi == sindex_multi_bool_t::GEO) {
+                    // The range is of geohashes, and the cells it covers may stick
+                    // out of the region.
+                    ql::geo_point_t point;
+                    try {
+                        point = ql::geo_point_from_datum(sindex_value);
+                    } catch (const ql::datum_exc_t &e2) {
+                        response->result = e2;
+                        return false;
+                    }
+                    if (geo_region && !geo_region->contains(point)) {
+                        return true;
+                    }
+                    sindex_value = make_counted<const ql::datum_t>(
+                        ql::geohash_encode(point));
+                }
                 if (!sindex_range->contains(sindex_value)) {
                     return true;
                 }
             }
 
-            // Apply transforms to the data
-            {
-                rdb_protocol_details::transform_t::iterator it;
-                for (it = transform.begin(); it != transform.end(); ++it) {
+            // Apply transforms to the data (which a covered row has had already)
+            if (!transform.empty() && !covered_row.has()) {
+                std::vector<counted_t<const ql::datum_t> > tmp;
+                for (auto jt = data.begin(); jt != data.end(); ++jt) {
+                    tmp.push_back(jt->get());
+                }
+                rdb_protocol_details::transform_t::iterator it = transform.begin();
+                if (passed_first_filter) {
+                    ++it;
+                }
+                for (; it != transform.end(); ++it) {
                     try {
-                        std::vector<counted_t<const ql::datum_t> > tmp;
-
-                        for (auto jt = data.begin(); jt != data.end(); ++jt) {
-                            query_language::transform_apply(
-                                ql_env, jt->get(), &*it, &tmp);
-                        }
-                        data.clear();
-                        for (auto jt = tmp.begin(); jt != tmp.end(); ++jt) {
-                            data.push_back(lazy_json_t(*jt));
-                        }
+                        query_language::transform_apply(ql_env, &*it, &tmp);
                     } catch (const ql::datum_exc_t &e2) {
                         /* Evaluation threw so we're not going to be accepting any
                            more requests. */
@@ -817,6 +1341,10 @@ public:
                         return false;
                     }
                 }
+                data.clear();
+                for (auto jt = tmp.begin(); jt != tmp.end(); ++jt) {
+                    data.push_back(lazy_json_t(*jt));
+                }
             }
 
             if (!terminal) {
@@ -876,6 +1404,14 @@ public:
     boost::optional<datum_range_t> sindex_range;
     counted_t<ql::func_t> sindex_function;
     boost::optional<sindex_multi_bool_t> sindex_multi;
+    boost::optional<ql::geo_region_t> geo_region;
+    std::vector<std::string> text_words;
+
+    // The function of the first transform, if it's a filter.
+    counted_t<ql::func_t> prefilter_func;
+    // The function of the only transform of a sindex read with no terminal, if it's
+    // a map.
+    counted_t<ql::func_t> covered_map_func;
 
     scoped_ptr_t<profile::disabler_t> disabler;
     scoped_ptr_t<profile::sampler_t> sampler;
@@ -891,12 +1427,46 @@ public:
     void operator()(const std::vector<ql::wire_datum_map_t> &) const { }
     void operator()(const rget_read_response_t::empty_t &) const { }
     void operator()(const counted_t<const ql::datum_t> &) const { }
+    void operator()(const rget_read_response_t::top_k_t &) const { }
+    void operator()(const ql::reservoir_t &) const { }
 
     void operator()(ql::wire_datum_map_t &dm) const {  // NOLINT(runtime/references)
         dm.finalize();
     }
 };
 
+// Reads that fold a range into a terminal, and reads that run to the end of the
+// table (as exports and other full table scans do), are unlikely to come back to the
+// blocks they read any time soon, so we don't let them push out the cache's working
+// set.
+static cache_access_pattern_t rget_access_pattern(
+        const key_range_t &range,
+        const ql::batchspec_t &batchspec,
+        const boost::optional<rdb_protocol_details::terminal_t> &terminal,
+        sorting_t sorting) {
+    if (terminal || batchspec.get_batch_type() == ql::batch_type_t::TERMINAL) {
+        return cache_access_pattern_t::one_shot;
+    }
+    const bool runs_to_end = !reversed(sorting)
+        ? range.right.unbounded
+        : range.left == store_key_t::min();
+    return runs_to_end
+        ? cache_access_pattern_t::one_shot
+        : cache_access_pattern_t::normal;
+}
+
+// Reads that are going to go through their whole range split it up, so that its
+// blocks get read in parallel.  Others stop after a batch, so reading ahead in the
+// rest of the range would be wasted.
+static int rget_max_subranges(
+        const ql::batchspec_t &batchspec,
+        const boost::optional<rdb_protocol_details::terminal_t> &terminal) {
+    if (terminal || batchspec.get_batch_type() == ql::batch_type_t::TERMINAL) {
+        return CONCURRENT_TRAVERSAL_MAX_SUBRANGES;
+    }
+    return 1;
+}
+
 void rdb_rget_slice(btree_slice_t *slice, const key_range_t &range,
                     superblock_t *superblock,
                     ql::env_t *ql_env, const ql::batchspec_t &batchspec,
@@ -904,11 +1474,30 @@ void rdb_rget_slice(btree_slice_t *slice, const key_range_t &range,
                     const boost::optional<rdb_protocol_details::terminal_t> &terminal,
                     sorting_t sorting,
                     rget_read_response_t *response) {
+    slice->stats.pm_hot_keys.record(range);
+    // An unfiltered count of every key in the btree is just its population.
+    if (transform.empty() && terminal
+        && boost::get<ql::count_wire_func_t>(&*terminal) != NULL) {
+        profile::starter_t starter("Count primary index keys.", ql_env->trace);
+        int64_t count;
+        if (get_btree_key_count_if_covered(superblock, range, &count)) {
+            response->result = make_counted<const ql::datum_t>(
+                static_cast<double>(count));
+            response->last_considered_key = !reversed(sorting)
+                ? store_key_t::max() : store_key_t::min();
+            response->truncated = false;
+            return;
+        }
+    }
+
     profile::starter_t starter("Do range scan on primary index.", ql_env->trace);
     rdb_rget_depth_first_traversal_callback_t callback(
             ql_env, batchspec, transform, terminal, range, sorting, response, slice);
     btree_concurrent_traversal(slice, superblock, range, &callback,
-                               (!reversed(sorting) ? FORWARD : BACKWARD));
+                               (!reversed(sorting) ? FORWARD : BACKWARD),
+                               rget_access_pattern(range, batchspec, terminal,
+                                                   sorting),
+                               rget_max_subranges(batchspec, terminal));
 
     response->truncated = callback.batcher.should_send_batch();
 
@@ -919,6 +1508,8 @@ void rdb_rget_secondary_slice(
     btree_slice_t *slice,
     const datum_range_t &sindex_range,
     const rdb_protocol_t::region_t &sindex_region,
+    const boost::optional<ql::geo_region_t> &geo_region,
+    const std::vector<std::string> &text_words,
     superblock_t *superblock,
     ql::env_t *ql_env,
     const ql::batchspec_t &batchspec,
@@ -929,13 +1520,17 @@ void rdb_rget_secondary_slice(
     const ql::map_wire_func_t &sindex_func,
     sindex_multi_bool_t sindex_multi,
     rget_read_response_t *response) {
+    slice->stats.pm_hot_keys.record(sindex_region.inner);
     profile::starter_t starter("Do range scan on secondary index.", ql_env->trace);
     rdb_rget_depth_first_traversal_callback_t callback(
         ql_env, batchspec, transform, terminal, sindex_region.inner, pk_range,
-        sorting, sindex_func, sindex_multi, sindex_range, response, slice);
+        sorting, sindex_func, sindex_multi, sindex_range, geo_region, text_words, response,
+        slice);
     btree_concurrent_traversal(
         slice, superblock, sindex_region.inner, &callback,
-        (!reversed(sorting) ? FORWARD : BACKWARD));
+        (!reversed(sorting) ? FORWARD : BACKWARD),
+        rget_access_pattern(sindex_region.inner, batchspec, terminal, sorting),
+        rget_max_subranges(batchspec, terminal));
 
     response->truncated = callback.batcher.should_send_batch();
 
@@ -966,6 +1561,25 @@ void rdb_distribution_get(int max_depth,
     }
 }
 
+// Rows are weighed by their whole serialized size, not just by the blob reference we
+// keep in the leaf.
+class rdb_distribution_value_sizer_t : public distribution_value_sizer_t {
+public:
+    int64_t value_bytes(const void *value) {
+        return static_cast<const rdb_value_t *>(value)->value_size();
+    }
+};
+
+void rdb_distribution_sample(int num_samples, int num_buckets,
+                             const store_key_t &left_key,
+                             superblock_t *superblock,
+                             distribution_read_response_t *response) {
+    rdb_distribution_value_sizer_t value_sizer;
+    get_btree_sampled_distribution(superblock, &value_sizer, num_samples, num_buckets,
+                                   left_key, &response->key_counts,
+                                   &response->byte_counts);
+}
+
 static const int8_t HAS_VALUE = 0;
 static const int8_t HAS_NO_VALUE = 1;
 
@@ -1015,9 +1629,10 @@ RDB_IMPL_ME_SERIALIZABLE_1(rdb_erase_range_report_t, range_to_erase);
 
 rdb_modification_report_cb_t::rdb_modification_report_cb_t(
         btree_store_t<rdb_protocol_t> *store,
+        ql::changefeed::server_t *changefeed_server,
         buf_lock_t *sindex_block,
         auto_drainer_t::lock_t lock)
-    : lock_(lock), store_(store),
+    : lock_(lock), store_(store), changefeed_server_(changefeed_server),
       sindex_block_(sindex_block) {
     store_->acquire_post_constructed_sindex_superblocks_for_write(
             sindex_block_, &sindexes_);
@@ -1035,10 +1650,53 @@ void rdb_modification_report_cb_t::on_mod_report(
     store_->sindex_queue_push(wm, &acq);
 
     rdb_update_sindexes(sindexes_, &mod_report, sindex_block_->txn());
+
+    if (changefeed_server_ != NULL) {
+        changefeed_server_->send_all(mod_report);
+    }
+}
+
+void rdb_modification_report_cb_t::on_mod_reports(
+        const std::vector<rdb_modification_report_t> &mod_reports) {
+    mutex_t::acq_t acq;
+    store_->lock_sindex_queue(sindex_block_, &acq);
+
+    for (auto it = mod_reports.begin(); it != mod_reports.end(); ++it) {
+        write_message_t wm;
+        wm << rdb_sindex_change_t(*it);
+        store_->sindex_queue_push(wm, &acq);
+    }
+
+    rdb_update_sindexes(sindexes_, mod_reports, sindex_block_->txn());
+
+    if (changefeed_server_ != NULL) {
+        changefeed_server_->send_all(mod_reports);
+    }
 }
 
 typedef btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindex_access_vector_t;
 
+void deserialize_sindex_definition(
+        const secondary_index_t::opaque_definition_t &definition,
+        ql::map_wire_func_t *mapping_out, sindex_multi_bool_t *multi_out) {
+    inplace_vector_read_stream_t read_stream(&definition);
+    archive_result_t success = deserialize(&read_stream, mapping_out);
+    guarantee_deserialization(success, "sindex deserialize");
+    success = deserialize(&read_stream, multi_out);
+    guarantee_deserialization(success, "sindex deserialize");
+}
+
+// What an index value goes into the index as: itself, or for geo indexes, its
+// geohash.
+static counted_t<const ql::datum_t> sindex_key_value(
+        const counted_t<const ql::datum_t> &value, sindex_multi_bool_t multi) {
+    if (multi == sindex_multi_bool_t::GEO) {
+        return make_counted<const ql::datum_t>(
+            ql::geohash_encode(ql::geo_point_from_datum(value)));
+    }
+    return value;
+}
+
 void compute_keys(const store_key_t &primary_key, counted_t<const ql::datum_t> doc,
                   ql::map_wire_func_t *mapping, sindex_multi_bool_t multi, ql::env_t *env,
                   std::vector<store_key_t> *keys_out) {
@@ -1046,34 +1704,36 @@ void compute_keys(const store_key_t &primary_key, counted_t<const ql::datum_t> d
     counted_t<const ql::datum_t> index =
         mapping->compile_wire_func()->call(env, doc)->as_datum();
 
-    if (multi == sindex_multi_bool_t::MULTI && index->get_type() == ql::datum_t::R_ARRAY) {
+    if (multi == sindex_multi_bool_t::TEXT) {
+        // One key per distinct word, which is its entry in the word's posting list.
+        std::vector<std::string> words = ql::text_words_of_datum(index);
+        for (uint64_t i = 0; i < words.size(); ++i) {
+            keys_out->push_back(
+                store_key_t(make_counted<const ql::datum_t>(std::string(words[i]))
+                            ->print_secondary(primary_key, i)));
+        }
+    } else if (multi != sindex_multi_bool_t::SINGLE
+        && index->get_type() == ql::datum_t::R_ARRAY) {
         for (uint64_t i = 0; i < index->size(); ++i) {
             keys_out->push_back(
-                store_key_t(index->get(i, ql::THROW)->print_secondary(primary_key, i)));
+                store_key_t(sindex_key_value(index->get(i, ql::THROW), multi)
+                            ->print_secondary(primary_key, i)));
         }
     } else {
-        keys_out->push_back(store_key_t(index->print_secondary(primary_key)));
+        keys_out->push_back(
+            store_key_t(sindex_key_value(index, multi)->print_secondary(primary_key)));
     }
 }
 
 /* Used below by rdb_update_sindexes. */
 void rdb_update_single_sindex(
         const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
-        const rdb_modification_report_t *modification,
+        const std::vector<const rdb_modification_report_t *> *modifications,
         auto_drainer_t::lock_t) {
-    // Note if you get this error it's likely that you've passed in a default
-    // constructed mod_report. Don't do that.  Mod reports should always be passed
-    // to a function as an output parameter before they're passed to this
-    // function.
-    guarantee(modification->primary_key.size() != 0);
-
+    // The definition is deserialized once for the whole batch of modifications.
     ql::map_wire_func_t mapping;
     sindex_multi_bool_t multi = sindex_multi_bool_t::MULTI;
-    inplace_vector_read_stream_t read_stream(&sindex->sindex.opaque_definition);
-    archive_result_t success = deserialize(&read_stream, &mapping);
-    guarantee_deserialization(success, "sindex deserialize");
-    success = deserialize(&read_stream, &multi);
-    guarantee_deserialization(success, "sindex deserialize");
+    deserialize_sindex_definition(sindex->sindex.opaque_definition, &mapping, &multi);
 
     // TODO we just use a NULL environment here. People should not be able
     // to do anything that requires an environment like gets from other
@@ -1085,76 +1745,90 @@ void rdb_update_single_sindex(
 
     superblock_t *super_block = sindex->super_block.get();
 
-    if (modification->info.deleted.first) {
-        guarantee(!modification->info.deleted.second.empty());
-        try {
-            counted_t<const ql::datum_t> deleted = modification->info.deleted.first;
-
-            std::vector<store_key_t> keys;
-
-            compute_keys(modification->primary_key, deleted, &mapping, multi, &env, &keys);
-
-            for (auto it = keys.begin(); it != keys.end(); ++it) {
-                promise_t<superblock_t *> return_superblock_local;
-                {
-                    keyvalue_location_t<rdb_value_t> kv_location;
-
-                    find_keyvalue_location_for_write(super_block,
-                                                     it->btree_key(),
-                                                     &kv_location,
-                                                     &sindex->btree->stats,
-                                                     env.trace.get_or_null(),
-                                                     &return_superblock_local);
-
-                    if (kv_location.value.has()) {
-                        kv_location_delete(&kv_location, *it,
-                            repli_timestamp_t::distant_past, NULL);
+    for (auto mod = modifications->begin(); mod != modifications->end(); ++mod) {
+        const rdb_modification_report_t *modification = *mod;
+        // Note if you get this error it's likely that you've passed in a default
+        // constructed mod_report. Don't do that.  Mod reports should always be
+        // passed to a function as an output parameter before they're passed to
+        // this function.
+        guarantee(modification->primary_key.size() != 0);
+
+        if (modification->info.deleted.first) {
+            guarantee(!modification->info.deleted.second.empty());
+            try {
+                counted_t<const ql::datum_t> deleted = modification->info.deleted.first;
+
+                std::vector<store_key_t> keys;
+
+                compute_keys(modification->primary_key, deleted, &mapping, multi, &env,
+                             &keys);
+
+                for (auto it = keys.begin(); it != keys.end(); ++it) {
+                    promise_t<superblock_t *> return_superblock_local;
+                    {
+                        keyvalue_location_t<rdb_value_t> kv_location;
+
+                        find_keyvalue_location_for_write(super_block,
+                                                         it->btree_key(),
+                                                         &kv_location,
+                                                         &sindex->btree->stats,
+                                                         env.trace.get_or_null(),
+                                                         &return_superblock_local);
+
+                        if (kv_location.value.has()) {
+                            kv_location_delete(&kv_location, *it,
+                                repli_timestamp_t::distant_past, NULL);
+                        }
+                        // The keyvalue location gets destroyed here.
                     }
-                    // The keyvalue location gets destroyed here.
+                    super_block = return_superblock_local.wait();
                 }
-                super_block = return_superblock_local.wait();
+            } catch (const ql::base_exc_t &) {
+                // Do nothing (it wasn't actually in the index).
             }
-        } catch (const ql::base_exc_t &) {
-            // Do nothing (it wasn't actually in the index).
         }
-    }
 
-    if (modification->info.added.first) {
-        try {
-            counted_t<const ql::datum_t> added = modification->info.added.first;
+        if (modification->info.added.first) {
+            try {
+                counted_t<const ql::datum_t> added = modification->info.added.first;
 
-            std::vector<store_key_t> keys;
+                std::vector<store_key_t> keys;
 
-            compute_keys(modification->primary_key, added, &mapping, multi, &env, &keys);
+                compute_keys(modification->primary_key, added, &mapping, multi, &env,
+                             &keys);
 
-            for (auto it = keys.begin(); it != keys.end(); ++it) {
-                promise_t<superblock_t *> return_superblock_local;
-                {
-                    keyvalue_location_t<rdb_value_t> kv_location;
+                for (auto it = keys.begin(); it != keys.end(); ++it) {
+                    promise_t<superblock_t *> return_superblock_local;
+                    {
+                        keyvalue_location_t<rdb_value_t> kv_location;
 
-                    find_keyvalue_location_for_write(super_block,
-                                                     it->btree_key(),
-                                                     &kv_location,
-                                                     &sindex->btree->stats,
-                                                     env.trace.get_or_null(),
-                                                     &return_superblock_local);
+                        find_keyvalue_location_for_write(super_block,
+                                                         it->btree_key(),
+                                                         &kv_location,
+                                                         &sindex->btree->stats,
+                                                         env.trace.get_or_null(),
+                                                         &return_superblock_local);
 
-                    kv_location_set(&kv_location, *it,
-                                    modification->info.added.second,
-                                    repli_timestamp_t::distant_past);
-                    // The keyvalue location gets destroyed here.
+                        kv_location_set(&kv_location, *it,
+                                        modification->info.added.second,
+                                        repli_timestamp_t::distant_past);
+                        // The keyvalue location gets destroyed here.
+                    }
+                    super_block = return_superblock_local.wait();
                 }
-                super_block = return_superblock_local.wait();
+            } catch (const ql::base_exc_t &) {
+                // Do nothing (we just drop the row from the index).
             }
-        } catch (const ql::base_exc_t &) {
-            // Do nothing (we just drop the row from the index).
         }
     }
 }
 
-void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
-                         const rdb_modification_report_t *modification,
-                         txn_t *txn) {
+/* Each index gets a coroutine of its own, since the indexes have separate
+ * superblocks, and it applies all of `modifications` to its index in order. */
+void rdb_update_sindexes_batch(
+        const sindex_access_vector_t &sindexes,
+        const std::vector<const rdb_modification_report_t *> &modifications,
+        txn_t *txn) {
     {
         auto_drainer_t drainer;
 
@@ -1163,22 +1837,45 @@ void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
                                                     ++it) {
             coro_t::spawn_sometime(std::bind(
                         &rdb_update_single_sindex, &*it,
-                        modification, auto_drainer_t::lock_t(&drainer)));
+                        &modifications, auto_drainer_t::lock_t(&drainer)));
         }
     }
 
     /* All of the sindex have been updated now it's time to actually clear the
-     * deleted blob if it exists. */
-    if (modification->info.deleted.first) {
-        // Deleting the value unfortunately updates the ref in-place as it operates, so
-        // we need to make a copy of the blob reference that is extended to the
-        // appropriate width.
-        std::vector<char> ref_cpy(modification->info.deleted.second);
-        ref_cpy.insert(ref_cpy.end(), blob::btree_maxreflen - ref_cpy.size(), 0);
-        guarantee(ref_cpy.size() == static_cast<size_t>(blob::btree_maxreflen));
+     * deleted blobs if there are any. */
+    for (auto it = modifications.begin(); it != modifications.end(); ++it) {
+        const rdb_modification_report_t *modification = *it;
+        if (modification->info.deleted.first) {
+            // Deleting the value unfortunately updates the ref in-place as it
+            // operates, so we need to make a copy of the blob reference that is
+            // extended to the appropriate width.
+            std::vector<char> ref_cpy(modification->info.deleted.second);
+            guarantee(!ref_cpy.empty());
+            const size_t full_size
+                = reinterpret_cast<const rdb_value_t *>(ref_cpy.data())->full_size();
+            guarantee(ref_cpy.size() <= full_size);
+            ref_cpy.resize(full_size, 0);
+
+            actually_delete_rdb_value(buf_parent_t(txn), ref_cpy.data());
+        }
+    }
+}
 
-        actually_delete_rdb_value(buf_parent_t(txn), ref_cpy.data());
+void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
+                         const rdb_modification_report_t *modification,
+                         txn_t *txn) {
+    rdb_update_sindexes_batch(sindexes, make_vector(modification), txn);
+}
+
+void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
+                         const std::vector<rdb_modification_report_t> &modifications,
+                         txn_t *txn) {
+    std::vector<const rdb_modification_report_t *> pointers;
+    pointers.reserve(modifications.size());
+    for (auto it = modifications.begin(); it != modifications.end(); ++it) {
+        pointers.push_back(&*it);
     }
+    rdb_update_sindexes_batch(sindexes, pointers, txn);
 }
 
 void rdb_erase_range_sindexes(const sindex_access_vector_t &sindexes,
@@ -1191,69 +1888,69 @@ void rdb_erase_range_sindexes(const sindex_access_vector_t &sindexes,
                               false /* don't release the superblock */, interruptor);
 }
 
-class post_construct_traversal_helper_t : public btree_traversal_helper_t {
-public:
-    post_construct_traversal_helper_t(
-            btree_store_t<rdb_protocol_t> *store,
-            const std::set<uuid_u> &sindexes_to_post_construct,
-            cond_t *interrupt_myself,
-            signal_t *interruptor
-            )
-        : store_(store),
-          sindexes_to_post_construct_(sindexes_to_post_construct),
-          interrupt_myself_(interrupt_myself), interruptor_(interruptor)
-    { }
-
-    void process_a_leaf(buf_lock_t *leaf_node_buf,
-                        const btree_key_t *, const btree_key_t *,
-                        signal_t *, int *) THROWS_ONLY(interrupted_exc_t) {
-        write_token_pair_t token_pair;
-        store_->new_write_token_pair(&token_pair);
-
-        // KSI: FML
-        scoped_ptr_t<txn_t> wtxn;
-        btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindexes;
+/* Post construction doesn't insert the rows into the new indexes one at a time,
+ * which would write to random spots of the index btrees.  Instead it reads the
+ * primary btree in a snapshot and collects every new index's pairs in an
+ * external_sorter_t, and then bulk loads each (still empty) index btree from its
+ * sorted pairs, which writes every index node once, in key order.  Changes made
+ * to the primary btree in the meantime are in the sindex queue, which gets drained
+ * after this. */
+struct sindex_post_construction_t {
+    uuid_u id;
+    ql::map_wire_func_t mapping;
+    sindex_multi_bool_t multi;
+    scoped_ptr_t<external_sorter_t> sorter;
+};
 
-        try {
-            scoped_ptr_t<real_superblock_t> superblock;
+typedef boost::ptr_vector<sindex_post_construction_t> sindex_post_construction_vector_t;
 
-            // We want soft durability because having a partially constructed
-            // secondary index is okay -- we wipe it and rebuild it, if it has not
-            // been marked completely constructed.
-            store_->acquire_superblock_for_write(
-                    repli_timestamp_t::distant_past,
-                    2,  // KSI: This is not the right value.
-                    write_durability_t::SOFT,
-                    &token_pair,
-                    &wtxn,
-                    &superblock,
-                    interruptor_);
+/* Keeps post construction from going through more than
+ * SINDEX_POST_CONSTRUCTION_MAX_BYTES_PER_SEC, by napping whenever it gets ahead of
+ * that rate. */
+class post_construction_throttle_t {
+public:
+    post_construction_throttle_t() : start_ticks_(get_ticks()), bytes_(0) { }
 
-            // Acquire the sindex block.
-            const block_id_t sindex_block_id = superblock->get_sindex_block_id();
+    void consume(size_t bytes, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        if (SINDEX_POST_CONSTRUCTION_MAX_BYTES_PER_SEC == 0) {
+            return;
+        }
+        bytes_ += bytes;
+        const double due_secs = static_cast<double>(bytes_)
+            / SINDEX_POST_CONSTRUCTION_MAX_BYTES_PER_SEC;
+        const double ahead_ms
+            = (due_secs - ticks_to_secs(get_ticks() - start_ticks_)) * 1000;
+        if (ahead_ms >= 1) {
+            nap(static_cast<int64_t>(ahead_ms), interruptor);
+        }
+    }
 
-            buf_lock_t sindex_block
-                = store_->acquire_sindex_block_for_write(superblock->expose_buf(),
-                                                         sindex_block_id);
+private:
+    const ticks_t start_ticks_;
+    uint64_t bytes_;
 
-            superblock.reset();
+    DISABLE_COPYING(post_construction_throttle_t);
+};
 
-            store_->acquire_sindex_superblocks_for_write(
-                    sindexes_to_post_construct_,
-                    &sindex_block,
-                    &sindexes);
+class post_construct_traversal_helper_t : public btree_traversal_helper_t {
+public:
+    post_construct_traversal_helper_t(
+            btree_store_t<rdb_protocol_t> *store,
+            sindex_post_construction_vector_t *sindexes,
+            post_construction_throttle_t *throttle)
+        : store_(store), sindexes_(sindexes), throttle_(throttle) { }
 
-            if (sindexes.empty()) {
-                interrupt_myself_->pulse_if_not_already_pulsed();
-                return;
-            }
-        } catch (const interrupted_exc_t &e) {
-            return;
-        }
+    void process_a_leaf(buf_lock_t *leaf_node_buf,
+                        const btree_key_t *, const btree_key_t *,
+                        signal_t *interruptor, int *) THROWS_ONLY(interrupted_exc_t) {
+        // See the comment in rdb_update_single_sindex about the NULL environment.
+        cond_t non_interruptor;
+        ql::env_t env(&non_interruptor);
 
         buf_read_t leaf_read(leaf_node_buf);
         const leaf_node_t *leaf_node
             = static_cast<const leaf_node_t *>(leaf_read.get_data_read());
+        const block_size_t block_size = leaf_node_buf->cache()->get_block_size();
 
         for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
             store_->btree->stats.pm_keys_read.record();
@@ -1264,18 +1961,31 @@ public:
             guarantee(key);
 
             store_key_t pk(key);
-            rdb_modification_report_t mod_report(pk);
             const rdb_value_t *rdb_value = static_cast<const rdb_value_t *>(value);
-            const block_size_t block_size = leaf_node_buf->cache()->get_block_size();
-            mod_report.info.added
-                = std::make_pair(
-                    get_data(rdb_value, buf_parent_t(leaf_node_buf)),
-                    std::vector<char>(rdb_value->value_ref(),
-                        rdb_value->value_ref() + rdb_value->inline_size(block_size)));
-
-            rdb_update_sindexes(sindexes, &mod_report, wtxn.get());
+            counted_t<const ql::datum_t> doc
+                = get_data(rdb_value, buf_parent_t(leaf_node_buf),
+                           store_->btree->field_dictionary());
+            // The index entries refer to the row's blob, just like the ones
+            // rdb_update_single_sindex makes.
+            const std::vector<char> value_ref(
+                rdb_value->contents,
+                rdb_value->contents + rdb_value->inline_size(block_size));
+
+            for (auto jt = sindexes_->begin(); jt != sindexes_->end(); ++jt) {
+                std::vector<store_key_t> keys;
+                try {
+                    compute_keys(pk, doc, &jt->mapping, jt->multi, &env, &keys);
+                } catch (const ql::base_exc_t &) {
+                    // Do nothing (we just drop the row from the index).
+                    continue;
+                }
+                for (auto kt = keys.begin(); kt != keys.end(); ++kt) {
+                    jt->sorter->add(*kt, value_ref);
+                }
+            }
             coro_t::yield();
         }
+        throttle_->consume(block_size.value(), interruptor);
     }
 
     void postprocess_internal_node(buf_lock_t *) { }
@@ -1293,58 +2003,238 @@ public:
     access_t btree_node_mode() { return access_t::read; }
 
     btree_store_t<rdb_protocol_t> *store_;
-    const std::set<uuid_u> &sindexes_to_post_construct_;
-    cond_t *interrupt_myself_;
-    signal_t *interruptor_;
+    sindex_post_construction_vector_t *sindexes_;
+    post_construction_throttle_t *throttle_;
 };
 
+/* Used below by load_sorted_sindex, if the index btree isn't empty, which happens
+ * if we were stopped after loading it but before it was marked up to date. */
+void insert_sorted_sindex_pair(const external_sorter_t::pair_t &pair,
+                               btree_slice_t *slice,
+                               superblock_t **superblock) {
+    promise_t<superblock_t *> return_superblock_local;
+    {
+        keyvalue_location_t<rdb_value_t> kv_location;
+        find_keyvalue_location_for_write(*superblock, pair.first.btree_key(),
+                                         &kv_location, &slice->stats, NULL,
+                                         &return_superblock_local);
+        kv_location_set(&kv_location, pair.first, pair.second,
+                        repli_timestamp_t::distant_past);
+    }
+    *superblock = return_superblock_local.wait();
+}
+
+/* Writes an index's sorted pairs into its btree, a few thousand at a time per
+ * transaction.  Gives up (deleting what it's loaded) if the index gets dropped. */
+void load_sorted_sindex(btree_store_t<rdb_protocol_t> *store,
+                        sindex_post_construction_t *sindex,
+                        post_construction_throttle_t *throttle,
+                        signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t) {
+    value_sizer_t<rdb_value_t> sizer(store->cache->get_block_size());
+    // Declared before the transactions, which must be destroyed first.
+    scoped_ptr_t<alt_cache_account_t> cache_account;
+    scoped_ptr_t<btree_bulk_loader_t> loader;
+
+    std::set<uuid_u> sindex_ids;
+    sindex_ids.insert(sindex->id);
+
+    external_sorter_t::pair_t pair;
+    bool has_pair = sindex->sorter->pop(&pair);
+    store_key_t last_key;
+    bool has_last_key = false;
+    // What the last transaction loaded, which we wait for before the next one.
+    size_t bytes_loaded = 0;
+
+    for (bool first_txn = true; ; first_txn = false) {
+        write_token_pair_t token_pair;
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+
+        try {
+            // We wait before we get in line, so that writes don't wait behind us.
+            throttle->consume(bytes_loaded, interruptor);
+            bytes_loaded = 0;
+            store->new_write_token_pair(&token_pair);
+            // We don't need hard durability because a secondary index gets rebuilt
+            // if the server dies before it's marked completely constructed.
+            store->acquire_superblock_for_write(
+                    repli_timestamp_t::distant_past,
+                    2,  // KSI: This is not the right value.
+                    write_durability_t::SOFT,
+                    &token_pair,
+                    &txn,
+                    &superblock,
+                    interruptor);
+        } catch (const interrupted_exc_t &) {
+            if (loader.has()) {
+                // Nothing points at the loaded nodes yet, so we have to delete them
+                // ourselves.
+                cond_t non_interruptor;
+                write_token_pair_t cleanup_token_pair;
+                store->new_write_token_pair(&cleanup_token_pair);
+                scoped_ptr_t<txn_t> cleanup_txn;
+                scoped_ptr_t<real_superblock_t> cleanup_superblock;
+                store->acquire_superblock_for_write(
+                        repli_timestamp_t::distant_past, 2, write_durability_t::SOFT,
+                        &cleanup_token_pair, &cleanup_txn, &cleanup_superblock,
+                        &non_interruptor);
+                cleanup_superblock.reset();
+                loader->abandon(buf_parent_t(cleanup_txn.get()));
+            }
+            throw;
+        }
+
+        if (!cache_account.has()) {
+            txn->cache()->create_cache_account(SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY,
+                                               &cache_account);
+        }
+        txn->set_account(cache_account.get());
+
+        sindex_access_vector_t sindexes;
+        {
+            buf_lock_t sindex_block
+                = store->acquire_sindex_block_for_write(superblock->expose_buf(),
+                                                        superblock->get_sindex_block_id());
+            superblock.reset();
+            store->acquire_sindex_superblocks_for_write(sindex_ids, &sindex_block,
+                                                        &sindexes);
+        }
+
+        if (sindexes.empty()) {
+            // The index was dropped.
+            if (loader.has()) {
+                loader->abandon(buf_parent_t(txn.get()));
+            }
+            return;
+        }
+
+        superblock_t *sindex_superblock = sindexes[0].super_block.get();
+        btree_slice_t *sindex_slice = sindexes[0].btree;
+        if (loader.has()) {
+            loader->attach(sindex_superblock);
+        } else if (first_txn
+                   && sindex_superblock->get_root_block_id() == NULL_BLOCK_ID) {
+            loader.init(new btree_bulk_loader_t(&sizer, sindex_superblock,
+                                                repli_timestamp_t::distant_past));
+        }
+
+        for (int i = 0; has_pair && i < SINDEX_POST_CONSTRUCTION_PAIRS_PER_TXN; ++i) {
+            // Keys are unique (they end with the primary key), but if some key were
+            // computed twice the bulk loader wouldn't accept it.
+            if (!has_last_key || last_key < pair.first) {
+                if (loader.has()) {
+                    loader->add(pair.first.btree_key(), pair.second.data());
+                } else {
+                    insert_sorted_sindex_pair(pair, sindex_slice, &sindex_superblock);
+                }
+                sindex_slice->stats.pm_keys_set.record();
+                bytes_loaded += pair.first.size() + pair.second.size();
+                last_key = pair.first;
+                has_last_key = true;
+            }
+            has_pair = sindex->sorter->pop(&pair);
+        }
+
+        if (!has_pair) {
+            if (loader.has()) {
+                loader->finish();
+            }
+            return;
+        }
+        if (loader.has()) {
+            loader->detach();
+        }
+    }
+}
+
 void post_construct_secondary_indexes(
         btree_store_t<rdb_protocol_t> *store,
         const std::set<uuid_u> &sindexes_to_post_construct,
         signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t) {
-    cond_t local_interruptor;
-
-    wait_any_t wait_any(&local_interruptor, interruptor);
-
-    post_construct_traversal_helper_t helper(store,
-            sindexes_to_post_construct, &local_interruptor, interruptor);
-    /* Notice the ordering of progress_tracker and insertion_sentries matters.
-     * insertion_sentries puts pointers in the progress tracker map. Once
-     * insertion_sentries is destructed nothing has a reference to
-     * progress_tracker so we know it's safe to destruct it. */
-    parallel_traversal_progress_t progress_tracker;
-    helper.progress = &progress_tracker;
-
-    std::vector<map_insertion_sentry_t<uuid_u, const parallel_traversal_progress_t *> >
-        insertion_sentries(sindexes_to_post_construct.size());
-    auto sentry = insertion_sentries.begin();
-    for (auto it = sindexes_to_post_construct.begin();
-         it != sindexes_to_post_construct.end(); ++it) {
-        store->add_progress_tracker(&*sentry, *it, &progress_tracker);
-    }
-
-    object_buffer_t<fifo_enforcer_sink_t::exit_read_t> read_token;
-    store->new_read_token(&read_token);
-
-    // Mind the destructor ordering.
-    // The superblock must be released before txn (`btree_parallel_traversal`
-    // usually already takes care of that).
-    // The txn must be destructed before the cache_account.
-    scoped_ptr_t<alt_cache_account_t> cache_account;
-    scoped_ptr_t<txn_t> txn;
-    scoped_ptr_t<real_superblock_t> superblock;
+    sindex_post_construction_vector_t sindexes;
+    post_construction_throttle_t throttle;
+
+    {
+        parallel_traversal_progress_t progress_tracker;
+        post_construct_traversal_helper_t helper(store, &sindexes, &throttle);
+        /* Notice the ordering of progress_tracker and insertion_sentries matters.
+         * insertion_sentries puts pointers in the progress tracker map. Once
+         * insertion_sentries is destructed nothing has a reference to
+         * progress_tracker so we know it's safe to destruct it. */
+        helper.progress = &progress_tracker;
+
+        std::vector<map_insertion_sentry_t<uuid_u, const parallel_traversal_progress_t *> >
+            insertion_sentries(sindexes_to_post_construct.size());
+        auto sentry = insertion_sentries.begin();
+        for (auto it = sindexes_to_post_construct.begin();
+             it != sindexes_to_post_construct.end(); ++it) {
+            store->add_progress_tracker(&*sentry, *it, &progress_tracker);
+            ++sentry;
+        }
 
-    store->acquire_superblock_for_read(
-        &read_token,
-        &txn,
-        &superblock,
-        interruptor,
-        true /* USE_SNAPSHOT */);
+        object_buffer_t<fifo_enforcer_sink_t::exit_read_t> read_token;
+        store->new_read_token(&read_token);
+
+        // Mind the destructor ordering.
+        // The superblock must be released before txn (`btree_parallel_traversal`
+        // usually already takes care of that).
+        // The txn must be destructed before the cache_account.
+        scoped_ptr_t<alt_cache_account_t> cache_account;
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+
+        store->acquire_superblock_for_read(
+            &read_token,
+            &txn,
+            &superblock,
+            interruptor,
+            true /* USE_SNAPSHOT */);
+
+        txn->cache()->create_cache_account(SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY,
+                                           &cache_account);
+        txn->set_account(cache_account.get());
+        // We read every leaf once, so the cache shouldn't evict the pages queries
+        // use to make room for ours.
+        txn->set_access_pattern(cache_access_pattern_t::one_shot);
+
+        {
+            buf_lock_t sindex_block
+                = store->acquire_sindex_block_for_read(superblock->expose_buf(),
+                                                       superblock->get_sindex_block_id());
+            std::map<std::string, secondary_index_t> sindex_defs;
+            get_secondary_indexes(&sindex_block, &sindex_defs);
+            for (auto it = sindex_defs.begin(); it != sindex_defs.end(); ++it) {
+                if (!std_contains(sindexes_to_post_construct, it->second.id)) {
+                    continue;
+                }
+                sindex_post_construction_t *sindex = new sindex_post_construction_t;
+                sindexes.push_back(sindex);
+                sindex->id = it->second.id;
+                deserialize_sindex_definition(it->second.opaque_definition,
+                                              &sindex->mapping, &sindex->multi);
+                sindex->sorter.init(new external_sorter_t(
+                    store->io_backender_, store->base_path_,
+                    "post_construction_sort_" + uuid_to_str(sindex->id),
+                    &store->perfmon_collection,
+                    SINDEX_POST_CONSTRUCTION_SORT_BUFFER_SIZE,
+                    SINDEX_POST_CONSTRUCTION_MERGE_FAN_IN));
+            }
+        }
 
-    txn->cache()->create_cache_account(SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY,
-                                       &cache_account);
-    txn->set_account(cache_account.get());
+        if (sindexes.empty()) {
+            return;
+        }
 
-    btree_parallel_traversal(superblock.get(), &helper, &wait_any);
+        btree_parallel_traversal(superblock.get(), &helper, interruptor);
+        if (interruptor->is_pulsed()) {
+            throw interrupted_exc_t();
+        }
+    }
+
+    for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
+        it->sorter->finish_adding();
+        load_sorted_sindex(store, &*it, &throttle, interruptor);
+    }
 }
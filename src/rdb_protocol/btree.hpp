@@ -23,6 +23,7 @@ typedef rdb_protocol_t::read_response_t read_response_t;
 
 typedef rdb_protocol_t::point_read_t point_read_t;
 typedef rdb_protocol_t::point_read_response_t point_read_response_t;
+typedef rdb_protocol_t::batched_point_read_response_t batched_point_read_response_t;
 
 typedef rdb_protocol_t::rget_read_t rget_read_t;
 typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
@@ -85,6 +86,32 @@ void rdb_get(
     point_read_response_t *response,
     profile::trace_t *trace);
 
+// The same for the sorted `keys`, in one traversal.
+void rdb_batched_get(
+    const std::vector<store_key_t> &keys,
+    btree_slice_t *slice,
+    superblock_t *superblock,
+    batched_point_read_response_t *response,
+    profile::trace_t *trace);
+
+/* The same, for stores with a write buffer (see btree/write_buffer.hpp): a key's
+latest message in `write_buffer` takes precedence over what's in the btree. */
+void rdb_buffered_get(
+    const store_key_t &key,
+    btree_slice_t *slice,
+    const btree_write_buffer_t *write_buffer,
+    superblock_t *superblock,
+    point_read_response_t *response,
+    profile::trace_t *trace);
+
+void rdb_buffered_batched_get(
+    const std::vector<store_key_t> &keys,
+    btree_slice_t *slice,
+    const btree_write_buffer_t *write_buffer,
+    superblock_t *superblock,
+    batched_point_read_response_t *response,
+    profile::trace_t *trace);
+
 enum return_vals_t {
     NO_RETURN_VALS = 0,
     RETURN_VALS = 1
@@ -104,20 +131,6 @@ struct btree_info_t {
     const std::string *primary_key;
 };
 
-struct btree_loc_info_t {
-    btree_loc_info_t(const btree_info_t *_btree,
-                     superblock_t *_superblock,
-                     const store_key_t *_key)
-        : btree(_btree), superblock(_superblock), key(_key) {
-        guarantee(btree != NULL);
-        guarantee(superblock != NULL);
-        guarantee(key != NULL);
-    }
-    const btree_info_t *const btree;
-    superblock_t *const superblock;
-    const store_key_t *const key;
-};
-
 struct btree_batched_replacer_t {
     virtual ~btree_batched_replacer_t() { }
     virtual counted_t<const ql::datum_t> replace(
@@ -139,6 +152,19 @@ batched_replace_response_t rdb_batched_replace(
     rdb_modification_report_cb_t *sindex_cb,
     profile::trace_t *trace);
 
+/* Like rdb_batched_replace, but the new values are added to `write_buffer` (which
+the store has prepared) instead of being written to the btree.  The old values are
+looked up in the buffer, and then in the btree, which is only read.  The store must
+not have any secondary indexes. */
+batched_replace_response_t rdb_buffered_batched_replace(
+    const btree_info_t &info,
+    btree_write_buffer_t *write_buffer,
+    scoped_ptr_t<superblock_t> *superblock,
+    const std::vector<store_key_t> &keys,
+    const btree_batched_replacer_t *replacer,
+    rdb_modification_report_cb_t *sindex_cb,
+    profile::trace_t *trace);
+
 void rdb_set(const store_key_t &key, counted_t<const ql::datum_t> data,
              bool overwrite,
              btree_slice_t *slice, repli_timestamp_t timestamp,
@@ -147,10 +173,19 @@ void rdb_set(const store_key_t &key, counted_t<const ql::datum_t> data,
              rdb_modification_info_t *mod_info,
              profile::trace_t *trace);
 
+/* Loads `rows`, which must be sorted by key, into the empty btree much faster than
+`rdb_set` could (see btree_bulk_loader_t).  Secondary indexes aren't updated; they
+should be (re)built once the table's rows have been loaded. */
+void rdb_bulk_load(
+    const std::vector<std::pair<store_key_t, counted_t<const ql::datum_t> > > &rows,
+    btree_slice_t *slice,
+    repli_timestamp_t timestamp,
+    superblock_t *superblock);
+
 class rdb_backfill_callback_t {
 public:
     virtual void on_delete_range(
-        const key_range_t &range,
+        const rdb_protocol_t::region_t &range,
         signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
     virtual void on_deletion(
         const btree_key_t *key,
@@ -162,12 +197,19 @@ public:
     virtual void on_sindexes(
         const std::map<std::string, secondary_index_t> &sindexes,
         signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
+    // Everything in `sent_region` has already been passed to the other methods.
+    virtual void on_progress(
+        const rdb_protocol_t::region_t &sent_region,
+        signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) = 0;
 protected:
     virtual ~rdb_backfill_callback_t() { }
 };
 
 
-void rdb_backfill(btree_slice_t *slice, const key_range_t& key_range,
+/* Only sends the keys whose hashes are in `region`, and deletes ranges only for
+those hashes, so that several backfills of different hash ranges of the same keys
+can run side by side. */
+void rdb_backfill(btree_slice_t *slice, const rdb_protocol_t::region_t &region,
                   repli_timestamp_t since_when, rdb_backfill_callback_t *callback,
                   superblock_t *superblock,
                   buf_lock_t *sindex_block,
@@ -181,6 +223,31 @@ void rdb_delete(const store_key_t &key, btree_slice_t *slice, repli_timestamp_t
                 rdb_modification_info_t *mod_info,
                 profile::trace_t *trace);
 
+// Like rdb_set and rdb_delete, in the way that rdb_buffered_batched_replace is like
+// rdb_batched_replace.  The superblock isn't released.
+void rdb_buffered_set(const store_key_t &key, counted_t<const ql::datum_t> data,
+                      bool overwrite,
+                      btree_slice_t *slice, btree_write_buffer_t *write_buffer,
+                      repli_timestamp_t timestamp,
+                      superblock_t *superblock,
+                      point_write_response_t *response,
+                      rdb_modification_info_t *mod_info,
+                      profile::trace_t *trace);
+
+void rdb_buffered_delete(const store_key_t &key, btree_slice_t *slice,
+                         btree_write_buffer_t *write_buffer,
+                         repli_timestamp_t timestamp, superblock_t *superblock,
+                         point_delete_response_t *response,
+                         rdb_modification_info_t *mod_info,
+                         profile::trace_t *trace);
+
+// Writes a write buffer's messages, which are sorted by key, to the btree.  Keys
+// under the same parent node share a walk down the tree, and each leaf node is
+// written once.  The superblock isn't released.
+void rdb_flush_write_buffer(btree_slice_t *slice,
+                            superblock_t *superblock,
+                            const btree_write_buffer_t::message_map_t &messages);
+
 /* A deleter that doesn't actually delete the values. Needed for secondary
  * indexes which only have references. */
 class rdb_value_detacher_t : public value_deleter_t {
@@ -209,6 +276,8 @@ void rdb_rget_secondary_slice(
     btree_slice_t *slice,
     const datum_range_t &datum_range,
     const rdb_protocol_t::region_t &sindex_region,
+    const boost::optional<ql::geo_region_t> &geo_region,
+    const std::vector<std::string> &text_words,
     superblock_t *superblock,
     ql::env_t *ql_env,
     const ql::batchspec_t &batchspec,
@@ -225,6 +294,12 @@ void rdb_distribution_get(int max_depth,
                           superblock_t *superblock,
                           distribution_read_response_t *response);
 
+// Fills in the response's key and byte histograms from `num_samples` random leaves.
+void rdb_distribution_sample(int num_samples, int num_buckets,
+                             const store_key_t &left_key,
+                             superblock_t *superblock,
+                             distribution_read_response_t *response);
+
 /* Secondary Indexes */
 
 struct rdb_modification_info_t {
@@ -265,12 +340,17 @@ typedef boost::variant<rdb_modification_report_t,
  * modify the secondary while they perform an operation. */
 class rdb_modification_report_cb_t {
 public:
+    // `changefeed_server` may be NULL.
     rdb_modification_report_cb_t(
             btree_store_t<rdb_protocol_t> *store,
+            ql::changefeed::server_t *changefeed_server,
             buf_lock_t *sindex_block,
             auto_drainer_t::lock_t lock);
 
     void on_mod_report(const rdb_modification_report_t &mod_report);
+    // Like calling `on_mod_report` on each of them, but the indexes get updated
+    // with all of them at once.
+    void on_mod_reports(const std::vector<rdb_modification_report_t> &mod_reports);
 
     ~rdb_modification_report_cb_t();
 
@@ -278,6 +358,7 @@ private:
     /* Fields initialized by the constructor. */
     auto_drainer_t::lock_t lock_;
     btree_store_t<rdb_protocol_t> *store_;
+    ql::changefeed::server_t *changefeed_server_;
     buf_lock_t *sindex_block_;
 
     /* Fields initialized by calls to on_mod_report */
@@ -288,6 +369,10 @@ void rdb_update_sindexes(
         const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
         const rdb_modification_report_t *modification,
         txn_t *txn);
+void rdb_update_sindexes(
+        const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
+        const std::vector<rdb_modification_report_t> &modifications,
+        txn_t *txn);
 
 
 void rdb_erase_range_sindexes(
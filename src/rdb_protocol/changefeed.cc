@@ -0,0 +1,188 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/changefeed.hpp"
+
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
+#include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/error.hpp"
+
+namespace ql {
+
+namespace changefeed {
+
+server_t::server_t(mailbox_manager_t *_manager)
+    : manager(_manager),
+      stop_mailbox(manager, std::bind(&server_t::stop, this, ph::_1)) { }
+
+server_t::~server_t() { }
+
+void server_t::add_client(const uuid_u &id, const client_addr_t &addr) {
+    assert_thread();
+    clients[id].init(new client_t(manager->get_connectivity_service(), addr));
+}
+
+stop_addr_t server_t::get_stop_address() const {
+    return stop_mailbox.get_address();
+}
+
+void server_t::stop(const uuid_u &id) {
+    // The stop message comes in on the mailbox's thread, which is ours.
+    assert_thread();
+    clients.erase(id);
+}
+
+namespace {
+
+msg_t msg_from_report(const rdb_modification_report_t &report) {
+    msg_t msg;
+    msg.old_val = report.info.deleted.first;
+    msg.new_val = report.info.added.first;
+    return msg;
+}
+
+}  // namespace
+
+void server_t::send_all(const rdb_modification_report_t &report) {
+    if (!clients.empty()) {
+        send_msgs(std::vector<msg_t>(1, msg_from_report(report)));
+    }
+}
+
+void server_t::send_all(const std::vector<rdb_modification_report_t> &reports) {
+    if (!clients.empty()) {
+        std::vector<msg_t> msgs;
+        msgs.reserve(reports.size());
+        for (auto it = reports.begin(); it != reports.end(); ++it) {
+            msgs.push_back(msg_from_report(*it));
+        }
+        send_msgs(msgs);
+    }
+}
+
+void server_t::send_msgs(const std::vector<msg_t> &msgs) {
+    assert_thread();
+    for (auto it = clients.begin(); it != clients.end();) {
+        // A client whose machine went away can't stop itself.
+        if (it->second->disconnected.is_pulsed()) {
+            clients.erase(it++);
+            continue;
+        }
+        client_t *client = it->second.get();
+        if (client->queue.size() + msgs.size() > CHANGEFEED_SERVER_QUEUE_SIZE) {
+            // The client isn't keeping up.  Rather than buffer without bound, drop
+            // what it hasn't been sent and tell it that it lost changes.
+            client->queue.clear();
+            msg_t overflow;
+            overflow.overflowed = true;
+            client->queue.push_back(overflow);
+        } else {
+            client->queue.insert(client->queue.end(), msgs.begin(), msgs.end());
+        }
+        // Sending can block on the network, and we're in the middle of a write, so
+        // each client gets one coroutine that sends its messages in order.
+        if (!client->sending) {
+            client->sending = true;
+            coro_t::spawn_sometime(std::bind(&server_t::send_queued, this, it->first,
+                                             drainer.lock()));
+        }
+        ++it;
+    }
+}
+
+void server_t::send_queued(const uuid_u &id, auto_drainer_t::lock_t keepalive) {
+    assert_thread();
+    while (!keepalive.get_drain_signal()->is_pulsed()) {
+        // The client may have been stopped while we were sending.
+        auto it = clients.find(id);
+        if (it == clients.end()) {
+            return;
+        }
+        client_t *client = it->second.get();
+        if (client->queue.empty()) {
+            client->sending = false;
+            return;
+        }
+        msg_t msg = std::move(client->queue.front());
+        client->queue.pop_front();
+        send(manager, client->addr, msg);
+    }
+}
+
+subscription_t::subscription_t(mailbox_manager_t *_manager)
+    : manager(_manager),
+      id(generate_uuid()),
+      overflowed(false),
+      more_els(NULL),
+      mailbox(manager, std::bind(&subscription_t::on_msg, this, ph::_1)) { }
+
+subscription_t::~subscription_t() {
+    assert_thread();
+    for (auto it = servers.begin(); it != servers.end(); ++it) {
+        send(manager, *it, id);
+    }
+}
+
+void subscription_t::add_servers(const std::vector<stop_addr_t> &stop_addrs) {
+    servers.insert(servers.end(), stop_addrs.begin(), stop_addrs.end());
+}
+
+void subscription_t::on_msg(const msg_t &msg) {
+    assert_thread();
+    if (msg.overflowed || els.size() >= array_size_limit()) {
+        overflowed = true;
+        if (more_els != NULL) {
+            more_els->pulse_if_not_already_pulsed();
+        }
+        return;
+    }
+    std::map<std::string, counted_t<const datum_t> > change;
+    change["old_val"] = msg.old_val.has()
+        ? msg.old_val : make_counted<const datum_t>(datum_t::R_NULL);
+    change["new_val"] = msg.new_val.has()
+        ? msg.new_val : make_counted<const datum_t>(datum_t::R_NULL);
+    els.push_back(make_counted<const datum_t>(std::move(change)));
+    if (more_els != NULL) {
+        more_els->pulse_if_not_already_pulsed();
+    }
+}
+
+std::vector<counted_t<const datum_t> > subscription_t::get_els(
+        batcher_t *batcher, signal_t *interruptor) {
+    assert_thread();
+    rassert(more_els == NULL);
+    if (els.empty() && !overflowed) {
+        cond_t wait_for_els;
+        more_els = &wait_for_els;
+        try {
+            wait_interruptible(&wait_for_els, interruptor);
+        } catch (const interrupted_exc_t &) {
+            more_els = NULL;
+            throw;
+        }
+        more_els = NULL;
+    }
+    if (overflowed) {
+        overflowed = false;
+        els.clear();
+        rfail_datum(base_exc_t::GENERIC,
+                    "Changefeed buffer overflowed.  "
+                    "The changes came in faster than they were read, and some "
+                    "were lost.");
+    }
+
+    std::vector<counted_t<const datum_t> > ret;
+    while (!els.empty() && !batcher->should_send_batch()) {
+        batcher->note_el(els.front());
+        ret.push_back(std::move(els.front()));
+        els.pop_front();
+    }
+    return ret;
+}
+
+}  // namespace changefeed
+
+}  // namespace ql
@@ -0,0 +1,133 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_CHANGEFEED_HPP_
+#define RDB_PROTOCOL_CHANGEFEED_HPP_
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/counted.hpp"
+#include "containers/scoped.hpp"
+#include "containers/uuid.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rpc/connectivity/connectivity.hpp"
+#include "rpc/mailbox/typed.hpp"
+#include "rpc/serialize_macros.hpp"
+
+struct rdb_modification_report_t;
+
+/* Change feeds push the changes that writes make to a table to the queries that
+asked for them with `changes`, instead of the queries having to poll for them.  The
+query subscribes a `subscription_t` to every store that holds part of the table (with
+a `changefeed_subscribe_t` read), and each store's `server_t` sends it a message for
+every row that a write changes from then on, until the query stops it or goes away. */
+
+namespace ql {
+
+class batcher_t;
+
+namespace changefeed {
+
+// A change to a row.  A value is empty if the row didn't exist on that side of the
+// write.
+struct msg_t {
+    msg_t() : overflowed(false) { }
+
+    counted_t<const datum_t> old_val;
+    counted_t<const datum_t> new_val;
+    // Set, instead of the values, when the server dropped changes because the
+    // subscription wasn't keeping up.
+    bool overflowed;
+
+    RDB_MAKE_ME_SERIALIZABLE_3(old_val, new_val, overflowed);
+};
+
+typedef mailbox_addr_t<void(msg_t)> client_addr_t;
+// Where a subscription tells a server it doesn't want any more messages.
+typedef mailbox_addr_t<void(uuid_u)> stop_addr_t;
+
+// Lives with a store, on its thread, and sends the changes its writes make to the
+// subscriptions that have subscribed to it.
+class server_t : public home_thread_mixin_t {
+public:
+    explicit server_t(mailbox_manager_t *_manager);
+    ~server_t();
+
+    void add_client(const uuid_u &id, const client_addr_t &addr);
+    stop_addr_t get_stop_address() const;
+
+    // Called with the changes of each write, after they've been made.  Doesn't block.
+    void send_all(const rdb_modification_report_t &report);
+    void send_all(const std::vector<rdb_modification_report_t> &reports);
+
+private:
+    struct client_t {
+        client_t(connectivity_service_t *connectivity, const client_addr_t &_addr)
+            : addr(_addr), disconnected(connectivity, _addr.get_peer()),
+              sending(false) { }
+        client_addr_t addr;
+        disconnect_watcher_t disconnected;
+        // The messages that `send_queued()` hasn't sent yet, at most
+        // `CHANGEFEED_SERVER_QUEUE_SIZE` of them.
+        std::deque<msg_t> queue;
+        // Whether a `send_queued()` coroutine is running for this client.
+        bool sending;
+    };
+
+    void send_msgs(const std::vector<msg_t> &msgs);
+    void send_queued(const uuid_u &id, auto_drainer_t::lock_t keepalive);
+    void stop(const uuid_u &id);
+
+    mailbox_manager_t *const manager;
+    std::map<uuid_u, scoped_ptr_t<client_t> > clients;
+    mailbox_t<void(uuid_u)> stop_mailbox;
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(server_t);
+};
+
+// The query's end of a change feed, which buffers the changes the servers send it
+// until the query reads them.
+class subscription_t : public home_thread_mixin_t {
+public:
+    explicit subscription_t(mailbox_manager_t *_manager);
+    // Tells the servers to stop sending changes.
+    ~subscription_t();
+
+    const uuid_u &get_id() const { return id; }
+    client_addr_t get_address() const { return mailbox.get_address(); }
+    // The servers that the subscription has been added to.
+    void add_servers(const std::vector<stop_addr_t> &stop_addrs);
+
+    // Waits until there's a change, and then takes as many of them as `batcher`
+    // allows, as `{old_val, new_val}` objects.  Throws if more changes came in than
+    // we could buffer since the last call.
+    std::vector<counted_t<const datum_t> > get_els(batcher_t *batcher,
+                                                   signal_t *interruptor);
+
+private:
+    void on_msg(const msg_t &msg);
+
+    mailbox_manager_t *const manager;
+    const uuid_u id;
+    std::vector<stop_addr_t> servers;
+
+    std::deque<counted_t<const datum_t> > els;
+    // Set if `els` got full and we had to drop a change.
+    bool overflowed;
+    // Pulsed when `els` stops being empty, while `get_els` waits for it.
+    cond_t *more_els;
+
+    // Destroyed first, so that no more messages come in.
+    mailbox_t<void(msg_t)> mailbox;
+
+    DISABLE_COPYING(subscription_t);
+};
+
+}  // namespace changefeed
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_CHANGEFEED_HPP_
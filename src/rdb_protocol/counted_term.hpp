@@ -85,6 +85,11 @@ public:
         return pointee_ != NULL;
     }
 
+    // Whether this is the only pointer to the base object.
+    bool unique() const {
+        return destructable_.unique();
+    }
+
 private:
     template <class U>
     friend class protob_t;
@@ -5,12 +5,15 @@
 #include <math.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <algorithm>
+#include <limits>
 
 #include "errors.hpp"
 #include <boost/detail/endian.hpp>
 
+#include "btree/field_dictionary.hpp"
 #include "containers/archive/string_stream.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
@@ -27,6 +30,76 @@ const std::set<std::string> datum_t::_allowed_pts = std::set<std::string>();
 
 const char* const datum_t::reql_type_string = "$reql_type$";
 
+namespace {
+
+bool pair_key_less(const datum_object_t::pair_t &pair, const std::string &key) {
+    return pair.first < key;
+}
+
+bool pair_less(const datum_object_t::pair_t &left,
+               const datum_object_t::pair_t &right) {
+    return left.first < right.first;
+}
+
+}  // namespace
+
+datum_object_t::datum_object_t(std::map<std::string, counted_t<const datum_t> > &&map) {
+    pairs_.reserve(map.size());
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        pairs_.push_back(std::make_pair(it->first, std::move(it->second)));
+    }
+    map.clear();
+}
+
+datum_object_t::datum_object_t(std::vector<pair_t> &&pairs)
+    : pairs_(std::move(pairs)) {
+#ifndef NDEBUG
+    for (size_t i = 1; i < pairs_.size(); ++i) {
+        rassert(pairs_[i - 1].first < pairs_[i].first);
+    }
+#endif
+}
+
+datum_object_t::const_iterator datum_object_t::find(const std::string &key) const {
+    auto it = std::lower_bound(pairs_.begin(), pairs_.end(), key, &pair_key_less);
+    if (it != pairs_.end() && it->first == key) {
+        return it;
+    }
+    return pairs_.end();
+}
+
+MUST_USE bool datum_object_t::set(const std::string &key, counted_t<const datum_t> val,
+                                  clobber_bool_t clobber_bool) {
+    auto it = std::lower_bound(pairs_.begin(), pairs_.end(), key, &pair_key_less);
+    if (it != pairs_.end() && it->first == key) {
+        if (clobber_bool == CLOBBER) {
+            it->second = std::move(val);
+        }
+        return true;
+    }
+    pairs_.insert(it, std::make_pair(key, std::move(val)));
+    return false;
+}
+
+MUST_USE bool datum_object_t::erase(const std::string &key) {
+    auto it = std::lower_bound(pairs_.begin(), pairs_.end(), key, &pair_key_less);
+    if (it != pairs_.end() && it->first == key) {
+        pairs_.erase(it);
+        return true;
+    }
+    return false;
+}
+
+const std::string *sort_object_pairs(std::vector<datum_object_t::pair_t> *pairs) {
+    std::sort(pairs->begin(), pairs->end(), &pair_less);
+    for (size_t i = 1; i < pairs->size(); ++i) {
+        if ((*pairs)[i - 1].first == (*pairs)[i].first) {
+            return &(*pairs)[i].first;
+        }
+    }
+    return NULL;
+}
+
 datum_t::datum_t(type_t _type, bool _bool) : type(_type), r_bool(_bool) {
     r_sanity_check(_type == R_BOOL);
 }
@@ -59,8 +132,13 @@ datum_t::datum_t(std::vector<counted_t<const datum_t> > &&_array)
 
 datum_t::datum_t(std::map<std::string, counted_t<const datum_t> > &&_object)
     : type(R_OBJECT),
-      r_object(new std::map<std::string, counted_t<const datum_t> >(
-                   std::move(_object))) {
+      r_object(new datum_object_t(std::move(_object))) {
+    maybe_sanitize_ptype();
+}
+
+datum_t::datum_t(datum_object_t &&_object)
+    : type(R_OBJECT),
+      r_object(new datum_object_t(std::move(_object))) {
     maybe_sanitize_ptype();
 }
 
@@ -77,7 +155,7 @@ datum_t::datum_t(datum_t::type_t _type) : type(_type) {
         r_array = new std::vector<counted_t<const datum_t> >();
     } break;
     case R_OBJECT: {
-        r_object = new std::map<std::string, counted_t<const datum_t> >();
+        r_object = new datum_object_t();
     } break;
     case UNINITIALIZED: // fallthru
     default: unreachable();
@@ -118,7 +196,7 @@ void datum_t::init_array() {
 
 void datum_t::init_object() {
     type = R_OBJECT;
-    r_object = new std::map<std::string, counted_t<const datum_t> >();
+    r_object = new datum_object_t();
 }
 
 void datum_t::init_json(cJSON *json) {
@@ -155,12 +233,20 @@ void datum_t::init_json(cJSON *json) {
     } break;
     case cJSON_Object: {
         init_object();
+        // We sort the pairs once at the end, instead of inserting them one by one.
+        std::vector<datum_object_t::pair_t> pairs;
         json_object_iterator_t it(json);
         while (cJSON *item = it.next()) {
-            bool conflict = add(item->string, make_counted<datum_t>(item));
-            rcheck(!conflict, base_exc_t::GENERIC,
-                   strprintf("Duplicate key `%s` in JSON.", item->string));
+            std::string key(item->string);
+            check_str_validity(key);
+            pairs.push_back(std::make_pair(std::move(key),
+                                           make_counted<datum_t>(item)));
         }
+        const std::string *duplicate = sort_object_pairs(&pairs);
+        rcheck(duplicate == NULL, base_exc_t::GENERIC,
+               strprintf("Duplicate key `%s` in JSON.",
+                         duplicate == NULL ? "" : duplicate->c_str()));
+        *r_object = datum_object_t(std::move(pairs));
         maybe_sanitize_ptype();
     } break;
     default: unreachable();
@@ -203,10 +289,16 @@ bool datum_t::is_ptype() const {
 }
 
 bool datum_t::is_ptype(const std::string &reql_type) const {
-    return (reql_type == "") ? is_ptype() : is_ptype() && get_reql_type() == reql_type;
+    return (reql_type == "")
+        ? is_ptype()
+        : is_ptype() && get_reql_type_str() == reql_type.c_str();
 }
 
 std::string datum_t::get_reql_type() const {
+    return get_reql_type_str().to_std();
+}
+
+const wire_string_t &datum_t::get_reql_type_str() const {
     r_sanity_check(get_type() == R_OBJECT);
     auto maybe_reql_type = r_object->find(reql_type_string);
     r_sanity_check(maybe_reql_type != r_object->end());
@@ -217,7 +309,7 @@ std::string datum_t::get_reql_type() const {
                      maybe_reql_type->second->trunc_print().c_str(),
                      maybe_reql_type->second->get_type_name().c_str(),
                      trunc_print().c_str()));
-    return maybe_reql_type->second->as_str().to_std();
+    return maybe_reql_type->second->as_str();
 }
 
 std::string raw_type_name(datum_t::type_t type) {
@@ -256,7 +348,7 @@ std::string datum_t::trunc_print() const {
 
 void datum_t::pt_to_str_key(std::string *str_out) const {
     r_sanity_check(is_ptype());
-    if (get_reql_type() == pseudo::time_string) {
+    if (get_reql_type_str() == pseudo::time_string) {
         pseudo::time_to_str_key(*this, str_out);
     } else {
         rfail(base_exc_t::GENERIC,
@@ -347,7 +439,7 @@ void datum_t::array_to_str_key(std::string *str_out) const {
 
 int datum_t::pseudo_cmp(const datum_t &rhs) const {
     r_sanity_check(is_ptype());
-    if (get_reql_type() == pseudo::time_string) {
+    if (get_reql_type_str() == pseudo::time_string) {
         return pseudo::time_cmp(*this, rhs);
     }
 
@@ -649,6 +741,7 @@ const std::vector<counted_t<const datum_t> > &datum_t::as_array() const {
 }
 
 void datum_t::change(size_t index, counted_t<const datum_t> val) {
+    serialized_size_cache.reset();
     check_type(R_ARRAY);
     rcheck(index < r_array->size(),
            base_exc_t::NON_EXISTENCE,
@@ -658,6 +751,7 @@ void datum_t::change(size_t index, counted_t<const datum_t> val) {
 }
 
 void datum_t::insert(size_t index, counted_t<const datum_t> val) {
+    serialized_size_cache.reset();
     check_type(R_ARRAY);
     rcheck(index <= r_array->size(),
            base_exc_t::NON_EXISTENCE,
@@ -667,6 +761,7 @@ void datum_t::insert(size_t index, counted_t<const datum_t> val) {
 }
 
 void datum_t::erase(size_t index) {
+    serialized_size_cache.reset();
     check_type(R_ARRAY);
     rcheck(index < r_array->size(),
            base_exc_t::NON_EXISTENCE,
@@ -676,6 +771,7 @@ void datum_t::erase(size_t index) {
 }
 
 void datum_t::erase_range(size_t start, size_t end) {
+    serialized_size_cache.reset();
     check_type(R_ARRAY);
     rcheck(start < r_array->size(),
            base_exc_t::NON_EXISTENCE,
@@ -693,6 +789,7 @@ void datum_t::erase_range(size_t start, size_t end) {
 }
 
 void datum_t::splice(size_t index, counted_t<const datum_t> values) {
+    serialized_size_cache.reset();
     check_type(R_ARRAY);
     rcheck(index <= r_array->size(),
            base_exc_t::NON_EXISTENCE,
@@ -718,8 +815,7 @@ counted_t<const datum_t> datum_t::get(size_t index, throw_bool_t throw_bool) con
 
 counted_t<const datum_t> datum_t::get(const std::string &key,
                                       throw_bool_t throw_bool) const {
-    std::map<std::string, counted_t<const datum_t> >::const_iterator it
-        = as_object().find(key);
+    datum_object_t::const_iterator it = as_object().find(key);
     if (it != as_object().end()) return it->second;
     if (throw_bool == THROW) {
         rfail(base_exc_t::NON_EXISTENCE,
@@ -728,7 +824,7 @@ counted_t<const datum_t> datum_t::get(const std::string &key,
     return counted_t<const datum_t>();
 }
 
-const std::map<std::string, counted_t<const datum_t> > &datum_t::as_object() const {
+const datum_object_t &datum_t::as_object() const {
     check_type(R_OBJECT);
     return *r_object;
 }
@@ -748,7 +844,7 @@ cJSON *datum_t::as_json_raw() const {
     } break;
     case R_OBJECT: {
         scoped_cJSON_t obj(cJSON_CreateObject());
-        for (std::map<std::string, counted_t<const datum_t> >::const_iterator
+        for (datum_object_t::const_iterator
                  it = r_object->begin(); it != r_object->end(); ++it) {
             obj.AddItemToObject(it->first.c_str(), it->second->as_json_raw());
         }
@@ -764,6 +860,319 @@ scoped_cJSON_t datum_t::as_json() const {
     return scoped_cJSON_t(as_json_raw());
 }
 
+namespace {
+
+// Escapes a string the way cJSON's `print_string_ptr` does.
+void write_json_string(const char *str, std::string *out) {
+    out->push_back('"');
+    const char *run = str;
+    for (const char *p = str; *p != '\0'; ++p) {
+        const unsigned char ch = *p;
+        if (ch > 31 && ch != '"' && ch != '\\') {
+            continue;
+        }
+        out->append(run, p - run);
+        run = p + 1;
+        switch (ch) {
+        case '\\': out->append("\\\\"); break;
+        case '"': out->append("\\\""); break;
+        case '\b': out->append("\\b"); break;
+        case '\f': out->append("\\f"); break;
+        case '\n': out->append("\\n"); break;
+        case '\r': out->append("\\r"); break;
+        case '\t': out->append("\\t"); break;
+        default: {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", ch);
+            out->append(buf);
+        } break;
+        }
+    }
+    out->append(run);
+    out->push_back('"');
+}
+
+}  // namespace
+
+void datum_t::write_json(std::string *out) const {
+    switch (get_type()) {
+    case R_NULL: out->append("null"); break;
+    case R_BOOL: out->append(as_bool() ? "true" : "false"); break;
+    case R_NUM: {
+        // so we can use `isfinite` in a GCC 4.4.3-compatible way
+        using namespace std;  // NOLINT(build/namespaces)
+        guarantee(isfinite(r_num));
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.20g", r_num);
+        out->append(buf);
+    } break;
+    case R_STR: write_json_string(r_str->c_str(), out); break;
+    case R_ARRAY: {
+        out->push_back('[');
+        for (size_t i = 0; i < r_array->size(); ++i) {
+            if (i != 0) {
+                out->push_back(',');
+            }
+            (*r_array)[i]->write_json(out);
+        }
+        out->push_back(']');
+    } break;
+    case R_OBJECT: {
+        out->push_back('{');
+        for (auto it = r_object->begin(); it != r_object->end(); ++it) {
+            if (it != r_object->begin()) {
+                out->push_back(',');
+            }
+            write_json_string(it->first.c_str(), out);
+            out->push_back(':');
+            it->second->write_json(out);
+        }
+        out->push_back('}');
+    } break;
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
+namespace {
+
+const char *skip_json_space(const char *json) {
+    while (*json != '\0' && static_cast<unsigned char>(*json) <= 32) {
+        ++json;
+    }
+    return json;
+}
+
+bool parse_json_hex4(const char *json, unsigned *out) {
+    *out = 0;
+    for (int i = 0; i < 4; ++i) {
+        const char ch = json[i];
+        int digit;
+        if (ch >= '0' && ch <= '9') {
+            digit = ch - '0';
+        } else if (ch >= 'a' && ch <= 'f') {
+            digit = ch - 'a' + 10;
+        } else if (ch >= 'A' && ch <= 'F') {
+            digit = ch - 'A' + 10;
+        } else {
+            return false;
+        }
+        *out = (*out << 4) | digit;
+    }
+    return true;
+}
+
+void append_utf8(unsigned uc, std::string *out) {
+    if (uc < 0x80) {
+        out->push_back(uc);
+    } else if (uc < 0x800) {
+        out->push_back(0xC0 | (uc >> 6));
+        out->push_back(0x80 | (uc & 0x3F));
+    } else if (uc < 0x10000) {
+        out->push_back(0xE0 | (uc >> 12));
+        out->push_back(0x80 | ((uc >> 6) & 0x3F));
+        out->push_back(0x80 | (uc & 0x3F));
+    } else {
+        out->push_back(0xF0 | (uc >> 18));
+        out->push_back(0x80 | ((uc >> 12) & 0x3F));
+        out->push_back(0x80 | ((uc >> 6) & 0x3F));
+        out->push_back(0x80 | (uc & 0x3F));
+    }
+}
+
+// Parses the string whose opening quote is at `json`, decoding escapes the way
+// cJSON's `parse_string` does: unknown escapes stand for the escaped character,
+// and `\u0000` and unpaired surrogates are dropped.  Returns the text after the
+// closing quote, or NULL.
+const char *parse_json_string(const char *json, std::string *out) {
+    if (*json != '"') {
+        return NULL;
+    }
+    const char *run = ++json;
+    for (;;) {
+        const char ch = *json;
+        if (ch != '"' && ch != '\\' && ch != '\0') {
+            ++json;
+            continue;
+        }
+        out->append(run, json - run);
+        if (ch == '"') {
+            return json + 1;
+        } else if (ch == '\0' || json[1] == '\0') {
+            return NULL;
+        }
+        ++json;
+        switch (*json) {
+        case 'b': out->push_back('\b'); ++json; break;
+        case 'f': out->push_back('\f'); ++json; break;
+        case 'n': out->push_back('\n'); ++json; break;
+        case 'r': out->push_back('\r'); ++json; break;
+        case 't': out->push_back('\t'); ++json; break;
+        case 'u': {
+            unsigned uc;
+            if (!parse_json_hex4(json + 1, &uc)) {
+                return NULL;
+            }
+            json += 5;
+            if ((uc >= 0xDC00 && uc <= 0xDFFF) || uc == 0) {
+                break;
+            }
+            if (uc >= 0xD800 && uc <= 0xDBFF) {
+                if (json[0] != '\\' || json[1] != 'u') {
+                    break;
+                }
+                unsigned uc2;
+                if (!parse_json_hex4(json + 2, &uc2)) {
+                    return NULL;
+                }
+                json += 6;
+                if (uc2 < 0xDC00 || uc2 > 0xDFFF) {
+                    break;
+                }
+                uc = 0x10000 | ((uc & 0x3FF) << 10) | (uc2 & 0x3FF);
+            }
+            append_utf8(uc, out);
+        } break;
+        default: out->push_back(*json); ++json; break;
+        }
+        run = json;
+    }
+}
+
+}  // namespace
+
+const char *datum_t::init_json_text(const char *json) {
+    switch (*json) {
+    case 'n': {
+        if (strncmp(json, "null", 4) != 0) {
+            return NULL;
+        }
+        type = R_NULL;
+        return json + 4;
+    }
+    case 't': {
+        if (strncmp(json, "true", 4) != 0) {
+            return NULL;
+        }
+        type = R_BOOL;
+        r_bool = true;
+        return json + 4;
+    }
+    case 'f': {
+        if (strncmp(json, "false", 5) != 0) {
+            return NULL;
+        }
+        type = R_BOOL;
+        r_bool = false;
+        return json + 5;
+    }
+    case '"': {
+        std::string str;
+        json = parse_json_string(json, &str);
+        if (json != NULL) {
+            init_str(str.size(), str.data());
+        }
+        return json;
+    }
+    case '[': {
+        init_array();
+        json = skip_json_space(json + 1);
+        if (*json == ']') {
+            return json + 1;
+        }
+        for (;;) {
+            counted_t<datum_t> item = make_counted<datum_t>();
+            json = item->init_json_text(json);
+            if (json == NULL) {
+                return NULL;
+            }
+            add(std::move(item));
+            json = skip_json_space(json);
+            if (*json == ']') {
+                return json + 1;
+            } else if (*json != ',') {
+                return NULL;
+            }
+            json = skip_json_space(json + 1);
+        }
+    }
+    case '{': {
+        init_object();
+        // We sort the pairs once at the end, instead of inserting them one by one.
+        std::vector<datum_object_t::pair_t> pairs;
+        json = skip_json_space(json + 1);
+        if (*json != '}') {
+            for (;;) {
+                std::string key;
+                json = parse_json_string(json, &key);
+                if (json == NULL) {
+                    return NULL;
+                }
+                json = skip_json_space(json);
+                if (*json != ':') {
+                    return NULL;
+                }
+                counted_t<datum_t> item = make_counted<datum_t>();
+                json = item->init_json_text(skip_json_space(json + 1));
+                if (json == NULL) {
+                    return NULL;
+                }
+                pairs.push_back(std::make_pair(std::move(key), std::move(item)));
+                json = skip_json_space(json);
+                if (*json == '}') {
+                    break;
+                } else if (*json != ',') {
+                    return NULL;
+                }
+                json = skip_json_space(json + 1);
+            }
+        }
+        const std::string *duplicate = sort_object_pairs(&pairs);
+        rcheck(duplicate == NULL, base_exc_t::GENERIC,
+               strprintf("Duplicate key `%s` in JSON.",
+                         duplicate == NULL ? "" : duplicate->c_str()));
+        *r_object = datum_object_t(std::move(pairs));
+        maybe_sanitize_ptype();
+        return json + 1;
+    }
+    default: {
+        if (*json != '-' && !(*json >= '0' && *json <= '9')) {
+            return NULL;
+        }
+        double num;
+        const char *end;
+        // Like cJSON, we read a hexadecimal prefix as a zero followed by garbage
+        // rather than letting `strtod` accept it.
+        if (json[0] == '0' && (json[1] == 'x' || json[1] == 'X')) {
+            num = 0;
+            end = json + 1;
+        } else {
+            char *strtod_end;
+            num = strtod(json, &strtod_end);
+            if (strtod_end == json) {
+                return NULL;
+            }
+            end = strtod_end;
+        }
+        // so we can use `isfinite` in a GCC 4.4.3-compatible way
+        using namespace std;  // NOLINT(build/namespaces)
+        rcheck(isfinite(num), base_exc_t::GENERIC,
+               strprintf("Non-finite value `%lf` in JSON.", num));
+        type = R_NUM;
+        r_num = num;
+        return end;
+    }
+    }
+}
+
+counted_t<const datum_t> datum_t::from_json(const char *json) {
+    counted_t<datum_t> d = make_counted<datum_t>();
+    if (d->init_json_text(skip_json_space(json)) == NULL) {
+        return counted_t<const datum_t>();
+    }
+    return d;
+}
+
 // TODO: make STR and OBJECT convertible to sequence?
 counted_t<datum_stream_t>
 datum_t::as_datum_stream(const protob_t<const Backtrace> &backtrace) const {
@@ -785,6 +1194,7 @@ datum_t::as_datum_stream(const protob_t<const Backtrace> &backtrace) const {
 };
 
 void datum_t::add(counted_t<const datum_t> val) {
+    serialized_size_cache.reset();
     check_type(R_ARRAY);
     r_sanity_check(val.has());
     r_array->push_back(val);
@@ -793,15 +1203,15 @@ void datum_t::add(counted_t<const datum_t> val) {
 
 MUST_USE bool datum_t::add(const std::string &key, counted_t<const datum_t> val,
                            clobber_bool_t clobber_bool) {
+    serialized_size_cache.reset();
     check_type(R_OBJECT);
     check_str_validity(key);
     r_sanity_check(val.has());
-    bool key_in_obj = r_object->count(key) > 0;
-    if (!key_in_obj || (clobber_bool == CLOBBER)) (*r_object)[key] = val;
-    return key_in_obj;
+    return r_object->set(key, val, clobber_bool);
 }
 
 MUST_USE bool datum_t::delete_field(const std::string &key) {
+    serialized_size_cache.reset();
     return r_object->erase(key);
 }
 
@@ -809,7 +1219,7 @@ counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs) const {
     if (get_type() != R_OBJECT || rhs->get_type() != R_OBJECT) { return rhs; }
 
     datum_ptr_t d(as_object());
-    const std::map<std::string, counted_t<const datum_t> > &rhs_obj = rhs->as_object();
+    const datum_object_t &rhs_obj = rhs->as_object();
     for (auto it = rhs_obj.begin(); it != rhs_obj.end(); ++it) {
         counted_t<const datum_t> sub_lhs = d->get(it->first, NOTHROW);
         bool is_literal = it->second->is_ptype(pseudo::literal_string);
@@ -835,7 +1245,7 @@ counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs) const {
 counted_t<const datum_t> datum_t::merge(counted_t<const datum_t> rhs,
                                         merge_resoluter_t f) const {
     datum_ptr_t d(as_object());
-    const std::map<std::string, counted_t<const datum_t> > &rhs_obj = rhs->as_object();
+    const datum_object_t &rhs_obj = rhs->as_object();
     for (auto it = rhs_obj.begin(); it != rhs_obj.end(); ++it) {
         if (counted_t<const datum_t> left = get(it->first, NOTHROW)) {
             bool b = d.add(it->first, f(it->first, left, it->second), CLOBBER);
@@ -855,6 +1265,68 @@ int derived_cmp(T a, T b) {
 }
 
 
+namespace {
+
+// Mixes `value` into `seed`, the way boost::hash_combine does.
+size_t hash_combine(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+// FNV-1a.
+size_t hash_bytes(const char *data, size_t size) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(h);
+}
+
+}  // namespace
+
+size_t datum_t::hash() const {
+    const size_t type_hash = static_cast<size_t>(get_type());
+    switch (get_type()) {
+    case R_NULL: return type_hash;
+    case R_BOOL: return hash_combine(type_hash, as_bool());
+    case R_NUM: {
+        // -0.0 and 0.0 compare equal.
+        const double d = as_num() == 0 ? 0.0 : as_num();
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        return hash_combine(type_hash, static_cast<size_t>(bits ^ (bits >> 32)));
+    }
+    case R_STR: return hash_combine(type_hash,
+                                    hash_bytes(as_str().data(), as_str().size()));
+    case R_ARRAY: {
+        size_t h = type_hash;
+        const std::vector<counted_t<const datum_t> > &arr = as_array();
+        for (auto it = arr.begin(); it != arr.end(); ++it) {
+            h = hash_combine(h, (*it)->hash());
+        }
+        return h;
+    }
+    case R_OBJECT: {
+        if (is_ptype()) {
+            // Pseudotypes compare by their own rules, so we only hash what those
+            // all agree on.
+            const std::string reql_type = get_reql_type();
+            return hash_combine(type_hash, hash_bytes(reql_type.data(),
+                                                      reql_type.size()));
+        }
+        size_t h = type_hash;
+        const datum_object_t &obj = as_object();
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            h = hash_combine(h, hash_bytes(it->first.data(), it->first.size()));
+            h = hash_combine(h, it->second->hash());
+        }
+        return h;
+    }
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
 int datum_t::cmp(const datum_t &rhs) const {
     if (is_ptype() && !rhs.is_ptype()) {
         return 1;
@@ -885,14 +1357,16 @@ int datum_t::cmp(const datum_t &rhs) const {
     } unreachable();
     case R_OBJECT: {
         if (is_ptype()) {
-            if (get_reql_type() != rhs.get_reql_type()) {
-                return derived_cmp(get_reql_type(), rhs.get_reql_type());
+            // This runs for every time comparison, so compare the type names in
+            //  place rather than copying them out.
+            const int type_cmpval = get_reql_type_str().compare(rhs.get_reql_type_str());
+            if (type_cmpval != 0) {
+                return type_cmpval;
             }
             return pseudo_cmp(rhs);
         } else {
-            const std::map<std::string, counted_t<const datum_t> > &obj = as_object();
-            const std::map<std::string, counted_t<const datum_t> > &rhs_obj
-                = rhs.as_object();
+            const datum_object_t &obj = as_object();
+            const datum_object_t &rhs_obj = rhs.as_object();
             auto it = obj.begin();
             auto it2 = rhs_obj.begin();
             while (it != obj.end() && it2 != rhs_obj.end()) {
@@ -960,26 +1434,32 @@ void datum_t::init_from_pb(const Datum *d) {
         check_str_validity(r_str);
     } break;
     case Datum::R_JSON: {
-        scoped_cJSON_t cjson(cJSON_Parse(d->r_str().c_str()));
-        init_json(cjson.get());
+        rcheck(init_json_text(skip_json_space(d->r_str().c_str())) != NULL,
+               base_exc_t::GENERIC, "Failed to parse JSON datum.");
     } break;
     case Datum::R_ARRAY: {
         init_array();
+        r_array->reserve(d->r_array_size());
         for (int i = 0; i < d->r_array_size(); ++i) {
             r_array->push_back(make_counted<datum_t>(&d->r_array(i)));
         }
     } break;
     case Datum::R_OBJECT: {
         init_object();
+        std::vector<datum_object_t::pair_t> pairs;
+        pairs.reserve(d->r_object_size());
         for (int i = 0; i < d->r_object_size(); ++i) {
             const Datum_AssocPair *ap = &d->r_object(i);
             const std::string &key = ap->key();
             check_str_validity(key);
-            rcheck(r_object->count(key) == 0,
-                   base_exc_t::GENERIC,
-                   strprintf("Duplicate key %s in object.", key.c_str()));
-            (*r_object)[key] = make_counted<datum_t>(&ap->val());
+            pairs.push_back(std::make_pair(key, make_counted<datum_t>(&ap->val())));
         }
+        const std::string *duplicate = sort_object_pairs(&pairs);
+        rcheck(duplicate == NULL,
+               base_exc_t::GENERIC,
+               strprintf("Duplicate key %s in object.",
+                         duplicate == NULL ? "" : duplicate->c_str()));
+        *r_object = datum_object_t(std::move(pairs));
         std::set<std::string> allowed_ptypes = { pseudo::literal_string };
         maybe_sanitize_ptype(allowed_ptypes);
     } break;
@@ -1050,7 +1530,9 @@ void datum_t::write_to_protobuf(Datum *d, use_json_t use_json) const {
     } break;
     case use_json_t::YES: {
         d->set_type(Datum::R_JSON);
-        d->set_r_str(as_json().PrintUnformatted());
+        std::string *json = d->mutable_r_str();
+        json->clear();
+        write_json(json);
     } break;
     default: unreachable();
     }
@@ -1065,17 +1547,227 @@ enum class datum_serialized_type_t {
     R_STR = 6,
     INT_NEGATIVE = 7,
     INT_POSITIVE = 8,
+    R_OBJECT_INDEXED = 9,
+    R_OBJECT_DICT = 10,
 };
 
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(datum_serialized_type_t, int8_t,
                                       datum_serialized_type_t::R_ARRAY,
-                                      datum_serialized_type_t::INT_POSITIVE);
+                                      datum_serialized_type_t::R_OBJECT_DICT);
+
+// Objects are serialized as R_OBJECT_INDEXED: the number of pairs, then a directory
+// of the keys in sorted order, then the values in the same order.  Each directory
+// entry is the key followed by a `uint32_t` giving the distance from the end of the
+// entry to the start of its value, so that `deserialize_field` can pick one value
+// out without parsing the others.  R_OBJECT, the older format that interleaves keys
+// and values, is still read.
+//
+// Stored documents (see serialize_for_storage) serialize objects as R_OBJECT_DICT
+// instead, which is the same except that each directory entry's key is a varint:
+// one more than the key's id in the table's field dictionary, or zero followed by
+// the key itself.
+namespace {
+
+size_t key_serialized_size(const std::string &key,
+                           const field_dictionary_t *dictionary) {
+    if (dictionary == NULL) {
+        return serialized_size(key);
+    }
+    uint64_t id;
+    if (dictionary->find(key, &id)) {
+        return varint_uint64_serialized_size(id + 1);
+    }
+    return varint_uint64_serialized_size(0) + serialized_size(key);
+}
+
+void serialize_key(write_message_t *wm, const std::string &key,
+                   field_dictionary_t *dictionary) {
+    if (dictionary == NULL) {
+        *wm << key;
+        return;
+    }
+    uint64_t id;
+    if (dictionary->find(key, &id)) {
+        serialize_varint_uint64(wm, id + 1);
+    } else {
+        serialize_varint_uint64(wm, 0);
+        *wm << key;
+        dictionary->note_missing(key);
+    }
+}
+
+// Reads an R_OBJECT_DICT directory entry's key, pointing `*key_out` at its name in
+// `dictionary`, or at `*buffer` if the key was written out, so that looking a key
+// up doesn't have to copy it.
+archive_result_t deserialize_dict_key(read_stream_t *s,
+                                      const field_dictionary_t *dictionary,
+                                      std::string *buffer,
+                                      const std::string **key_out) {
+    uint64_t ref;
+    archive_result_t res = deserialize_varint_uint64(s, &ref);
+    if (res) {
+        return res;
+    }
+    if (ref == 0) {
+        res = deserialize(s, buffer);
+        if (res) {
+            return res;
+        }
+        *key_out = buffer;
+        return ARCHIVE_SUCCESS;
+    }
+    if (dictionary == NULL) {
+        return ARCHIVE_RANGE_ERROR;
+    }
+    *key_out = dictionary->name(ref - 1);
+    return *key_out == NULL ? ARCHIVE_RANGE_ERROR : ARCHIVE_SUCCESS;
+}
+
+size_t object_serialized_size(const datum_object_t &object,
+                              const field_dictionary_t *dictionary) {
+    size_t sz = varint_uint64_serialized_size(object.size());
+    for (auto it = object.begin(); it != object.end(); ++it) {
+        sz += key_serialized_size(it->first, dictionary)
+            + serialized_size_t<uint32_t>::value
+            + storage_serialized_size(it->second, dictionary);
+    }
+    return sz;
+}
+
+void serialize_object(write_message_t *wm, const datum_object_t &object,
+                      field_dictionary_t *dictionary) {
+    serialize_varint_uint64(wm, object.size());
+
+    std::vector<size_t> entry_sizes;
+    std::vector<size_t> value_sizes;
+    entry_sizes.reserve(object.size());
+    value_sizes.reserve(object.size());
+    size_t directory_remaining = 0;
+    for (auto it = object.begin(); it != object.end(); ++it) {
+        value_sizes.push_back(storage_serialized_size(it->second, dictionary));
+        entry_sizes.push_back(key_serialized_size(it->first, dictionary)
+                              + serialized_size_t<uint32_t>::value);
+        directory_remaining += entry_sizes.back();
+    }
+
+    size_t values_before = 0;
+    size_t i = 0;
+    for (auto it = object.begin(); it != object.end(); ++it, ++i) {
+        directory_remaining -= entry_sizes[i];
+        const size_t offset = directory_remaining + values_before;
+        guarantee(offset <= std::numeric_limits<uint32_t>::max());
+        serialize_key(wm, it->first, dictionary);
+        *wm << static_cast<uint32_t>(offset);
+        values_before += value_sizes[i];
+    }
+    rassert(directory_remaining == 0);
+
+    for (auto it = object.begin(); it != object.end(); ++it) {
+        serialize_for_storage(wm, it->second, dictionary);
+    }
+}
+
+// Reads an R_OBJECT_INDEXED or R_OBJECT_DICT object.
+archive_result_t deserialize_object(read_stream_t *s, datum_serialized_type_t type,
+                                    const field_dictionary_t *dictionary,
+                                    datum_object_t *object_out) {
+    uint64_t num_pairs;
+    archive_result_t res = deserialize_varint_uint64(s, &num_pairs);
+    if (res) {
+        return res;
+    }
+
+    std::vector<std::string> keys;
+    for (uint64_t i = 0; i < num_pairs; ++i) {
+        std::string key;
+        if (type == datum_serialized_type_t::R_OBJECT_DICT) {
+            const std::string *name;
+            res = deserialize_dict_key(s, dictionary, &key, &name);
+            if (!res && name != &key) {
+                key = *name;
+            }
+        } else {
+            res = deserialize(s, &key);
+        }
+        if (res) {
+            return res;
+        }
+        if (!keys.empty() && !(keys.back() < key)) {
+            return ARCHIVE_RANGE_ERROR;
+        }
+        uint32_t offset;
+        res = deserialize(s, &offset);
+        if (res) {
+            return res;
+        }
+        keys.push_back(std::move(key));
+    }
+
+    std::vector<datum_object_t::pair_t> pairs;
+    pairs.reserve(keys.size());
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        counted_t<const datum_t> value;
+        res = deserialize_from_storage(s, &value, dictionary);
+        if (res) {
+            return res;
+        }
+        pairs.push_back(std::make_pair(std::move(*it), std::move(value)));
+    }
+    *object_out = datum_object_t(std::move(pairs));
+    return ARCHIVE_SUCCESS;
+}
+
+// Reads an array the way a std::vector is deserialized, passing `dictionary` on to
+// its elements.
+archive_result_t deserialize_array(read_stream_t *s,
+                                   const field_dictionary_t *dictionary,
+                                   std::vector<counted_t<const datum_t> > *array_out) {
+    uint64_t size;
+    archive_result_t res = deserialize_varint_uint64(s, &size);
+    if (res) {
+        return res;
+    }
+    if (size > std::numeric_limits<size_t>::max()) {
+        return ARCHIVE_RANGE_ERROR;
+    }
+    array_out->resize(size);
+    for (uint64_t i = 0; i < size; ++i) {
+        res = deserialize_from_storage(s, &(*array_out)[i], dictionary);
+        if (res) {
+            return res;
+        }
+    }
+    return ARCHIVE_SUCCESS;
+}
+
+// Reads and discards `n` bytes.
+archive_result_t skip_bytes(read_stream_t *s, uint64_t n) {
+    char buf[1024];
+    while (n > 0) {
+        const int64_t chunk = std::min<uint64_t>(n, sizeof(buf));
+        int64_t num_read = force_read(s, buf, chunk);
+        if (num_read == -1) {
+            return ARCHIVE_SOCK_ERROR;
+        }
+        if (num_read < chunk) {
+            return ARCHIVE_SOCK_EOF;
+        }
+        n -= chunk;
+    }
+    return ARCHIVE_SUCCESS;
+}
+
+}  // namespace
 
 // This must be kept in sync with operator<<(write_message_t &, const counted_t<const
 // datum_T> &).
 size_t serialized_size(const counted_t<const datum_t> &datum) {
     r_sanity_check(datum.has());
-    size_t sz = 1; // 1 byte for the type
+    size_t sz;
+    if (datum->serialized_size_cache.get(&sz)) {
+        return sz;
+    }
+    sz = 1; // 1 byte for the type
     switch (datum->get_type()) {
     case datum_t::R_ARRAY: {
         sz += serialized_size(datum->as_array());
@@ -1094,7 +1786,7 @@ size_t serialized_size(const counted_t<const datum_t> &datum) {
         }
     } break;
     case datum_t::R_OBJECT: {
-        sz += serialized_size(datum->as_object());
+        sz += object_serialized_size(datum->as_object(), NULL);
     } break;
     case datum_t::R_STR: {
         sz += serialized_size(datum->as_str());
@@ -1103,6 +1795,7 @@ size_t serialized_size(const counted_t<const datum_t> &datum) {
     default:
         unreachable();
     }
+    datum->serialized_size_cache.set(sz);
     return sz;
 }
 
@@ -1143,9 +1836,8 @@ write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t>
         }
     } break;
     case datum_t::R_OBJECT: {
-        wm << datum_serialized_type_t::R_OBJECT;
-        const std::map<std::string, counted_t<const datum_t> > &value = datum->as_object();
-        wm << value;
+        wm << datum_serialized_type_t::R_OBJECT_INDEXED;
+        serialize_object(&wm, datum->as_object(), NULL);
     } break;
     case datum_t::R_STR: {
         wm << datum_serialized_type_t::R_STR;
@@ -1159,7 +1851,63 @@ write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t>
     return wm;
 }
 
+// Only arrays and objects are serialized differently for storage, and only the
+// objects' keys.  Their sizes aren't cached, since each dictionary gives a different
+// one.
+size_t storage_serialized_size(const counted_t<const datum_t> &datum,
+                               const field_dictionary_t *dictionary) {
+    r_sanity_check(datum.has());
+    if (dictionary == NULL) {
+        return serialized_size(datum);
+    }
+    switch (datum->get_type()) {
+    case datum_t::R_ARRAY: {
+        const std::vector<counted_t<const datum_t> > &array = datum->as_array();
+        size_t sz = 1 + varint_uint64_serialized_size(array.size());
+        for (auto it = array.begin(); it != array.end(); ++it) {
+            sz += storage_serialized_size(*it, dictionary);
+        }
+        return sz;
+    }
+    case datum_t::R_OBJECT:
+        return 1 + object_serialized_size(datum->as_object(), dictionary);
+    default:
+        return serialized_size(datum);
+    }
+}
+
+void serialize_for_storage(write_message_t *wm, const counted_t<const datum_t> &datum,
+                           field_dictionary_t *dictionary) {
+    r_sanity_check(datum.has());
+    if (dictionary == NULL) {
+        *wm << datum;
+        return;
+    }
+    switch (datum->get_type()) {
+    case datum_t::R_ARRAY: {
+        const std::vector<counted_t<const datum_t> > &array = datum->as_array();
+        *wm << datum_serialized_type_t::R_ARRAY;
+        serialize_varint_uint64(wm, array.size());
+        for (auto it = array.begin(); it != array.end(); ++it) {
+            serialize_for_storage(wm, *it, dictionary);
+        }
+    } break;
+    case datum_t::R_OBJECT: {
+        *wm << datum_serialized_type_t::R_OBJECT_DICT;
+        serialize_object(wm, datum->as_object(), dictionary);
+    } break;
+    default:
+        *wm << datum;
+    }
+}
+
 archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum) {
+    return deserialize_from_storage(s, datum, NULL);
+}
+
+archive_result_t deserialize_from_storage(read_stream_t *s,
+                                          counted_t<const datum_t> *datum,
+                                          const field_dictionary_t *dictionary) {
     datum_serialized_type_t type;
     archive_result_t res = deserialize(s, &type);
     if (res) {
@@ -1169,7 +1917,7 @@ archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum)
     switch (type) {
     case datum_serialized_type_t::R_ARRAY: {
         std::vector<counted_t<const datum_t> > value;
-        res = deserialize(s, &value);
+        res = deserialize_array(s, dictionary, &value);
         if (res) {
             return res;
         }
@@ -1242,6 +1990,19 @@ archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum)
             return ARCHIVE_RANGE_ERROR;
         }
     } break;
+    case datum_serialized_type_t::R_OBJECT_INDEXED:  // fall through
+    case datum_serialized_type_t::R_OBJECT_DICT: {
+        datum_object_t value;
+        res = deserialize_object(s, type, dictionary, &value);
+        if (res) {
+            return res;
+        }
+        try {
+            datum->reset(new datum_t(std::move(value)));
+        } catch (const base_exc_t &) {
+            return ARCHIVE_RANGE_ERROR;
+        }
+    } break;
     case datum_serialized_type_t::R_STR: {
         wire_string_t *value;
         res = deserialize(s, &value);
@@ -1262,6 +2023,59 @@ archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum)
     return ARCHIVE_SUCCESS;
 }
 
+archive_result_t deserialize_field(read_stream_t *s, const std::string &key,
+                                   const field_dictionary_t *dictionary,
+                                   bool *indexed_out,
+                                   counted_t<const datum_t> *value_out) {
+    value_out->reset();
+    datum_serialized_type_t type;
+    archive_result_t res = deserialize(s, &type);
+    if (res) {
+        return res;
+    }
+    if (type != datum_serialized_type_t::R_OBJECT_INDEXED
+        && type != datum_serialized_type_t::R_OBJECT_DICT) {
+        *indexed_out = false;
+        return ARCHIVE_SUCCESS;
+    }
+    *indexed_out = true;
+
+    uint64_t num_pairs;
+    res = deserialize_varint_uint64(s, &num_pairs);
+    if (res) {
+        return res;
+    }
+    std::string buffer;
+    for (uint64_t i = 0; i < num_pairs; ++i) {
+        const std::string *entry_key = &buffer;
+        if (type == datum_serialized_type_t::R_OBJECT_DICT) {
+            res = deserialize_dict_key(s, dictionary, &buffer, &entry_key);
+        } else {
+            res = deserialize(s, &buffer);
+        }
+        if (res) {
+            return res;
+        }
+        uint32_t offset;
+        res = deserialize(s, &offset);
+        if (res) {
+            return res;
+        }
+        if (*entry_key == key) {
+            res = skip_bytes(s, offset);
+            if (res) {
+                return res;
+            }
+            return deserialize_from_storage(s, value_out, dictionary);
+        }
+        if (key < *entry_key) {
+            // The directory is sorted, so the key isn't in it.
+            break;
+        }
+    }
+    return ARCHIVE_SUCCESS;
+}
+
 write_message_t &operator<<(write_message_t &wm, const empty_ok_t<const counted_t<const datum_t> > &datum) {
     const counted_t<const datum_t> *pointer = datum.get();
     const bool has = pointer->has();
@@ -1306,6 +2120,12 @@ void wire_datum_map_t::set(counted_t<const datum_t> key, counted_t<const datum_t
     map[key] = val;
 }
 
+counted_t<const datum_t> *wire_datum_map_t::find(counted_t<const datum_t> key) {
+    r_sanity_check(state == COMPILED);
+    auto it = map.find(key);
+    return it == map.end() ? NULL : &it->second;
+}
+
 void wire_datum_map_t::compile() {
     if (state == COMPILED) return;
     while (!map_pb.empty()) {
@@ -1327,10 +2147,23 @@ void wire_datum_map_t::finalize() {
     state = SERIALIZABLE;
 }
 
+namespace {
+
+bool group_less(
+    const std::pair<counted_t<const datum_t>, counted_t<const datum_t> > &a,
+    const std::pair<counted_t<const datum_t>, counted_t<const datum_t> > &b) {
+    return *a.first < *b.first;
+}
+
+}  // namespace
+
 counted_t<const datum_t> wire_datum_map_t::to_arr() const {
     r_sanity_check(state == COMPILED);
+    std::vector<std::pair<counted_t<const datum_t>, counted_t<const datum_t> > >
+        groups(map.begin(), map.end());
+    std::sort(groups.begin(), groups.end(), group_less);
     datum_ptr_t arr(datum_t::R_ARRAY);
-    for (auto it = map.begin(); it != map.end(); ++it) {
+    for (auto it = groups.begin(); it != groups.end(); ++it) {
         datum_ptr_t obj(datum_t::R_OBJECT);
         bool b1 = obj.add("group", it->first);
         bool b2 = obj.add("reduction", it->second);
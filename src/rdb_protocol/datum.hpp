@@ -2,16 +2,19 @@
 #ifndef RDB_PROTOCOL_DATUM_HPP_
 #define RDB_PROTOCOL_DATUM_HPP_
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "errors.hpp"
 #include <boost/optional.hpp>
 
+#include "arch/runtime/slab_allocator.hpp"
 #include "btree/keys.hpp"
 #include "containers/archive/archive.hpp"
 #include "containers/counted.hpp"
@@ -21,10 +24,12 @@
 #include "rdb_protocol/error.hpp"
 
 class Datum;
+class field_dictionary_t;
 
 RDB_DECLARE_SERIALIZABLE(Datum);
 
 namespace ql {
+class datum_object_t;
 class datum_stream_t;
 class env_t;
 class val_t;
@@ -49,8 +54,29 @@ enum clobber_bool_t { NOCLOBBER = 0, CLOBBER = 1};
 
 enum class use_json_t { NO = 0, YES = 1 };
 
+// Remembers a datum's serialized size once it has been computed, since sending a
+// datum needs it again at every level of nesting.  Datums may be shared between
+// threads, hence the atomic.
+class serialized_size_cache_t {
+public:
+    serialized_size_cache_t() : size_plus_one(0) { }
+    bool get(size_t *size_out) const {
+        size_t s = size_plus_one.load(std::memory_order_relaxed);
+        *size_out = s - 1;
+        return s != 0;
+    }
+    void set(size_t size) const {
+        size_plus_one.store(size + 1, std::memory_order_relaxed);
+    }
+    void reset() {
+        size_plus_one.store(0, std::memory_order_relaxed);
+    }
+private:
+    mutable std::atomic<size_t> size_plus_one;
+};
+
 // A `datum_t` is basically a JSON value, although we may extend it later.
-class datum_t : public slow_atomic_countable_t<datum_t> {
+class datum_t : public slow_atomic_countable_t<datum_t>, public slab_allocated_t {
 public:
     // This ordering is important, because we use it to sort objects of
     // disparate type.  It should be alphabetical.
@@ -74,6 +100,7 @@ public:
     explicit datum_t(const char *cstr);
     explicit datum_t(std::vector<counted_t<const datum_t> > &&_array);
     explicit datum_t(std::map<std::string, counted_t<const datum_t> > &&object);
+    explicit datum_t(datum_object_t &&object);
 
     // These construct a datum from an equivalent representation.
     datum_t();
@@ -119,7 +146,7 @@ public:
     // Access an element of an array.
     counted_t<const datum_t> get(size_t index, throw_bool_t throw_bool = THROW) const;
     // Use of `get` is preferred to `as_object` when possible.
-    const std::map<std::string, counted_t<const datum_t> > &as_object() const;
+    const datum_object_t &as_object() const;
 
     // Access an element of an object.
     counted_t<const datum_t> get(const std::string &key,
@@ -133,6 +160,13 @@ public:
 
     cJSON *as_json_raw() const;
     scoped_cJSON_t as_json() const;
+    // Appends the same text as `as_json().PrintUnformatted()` to `out`, without
+    // building a cJSON tree first.
+    void write_json(std::string *out) const;
+    // Parses JSON the way `cJSON_Parse` does (stopping at the first NUL and
+    // ignoring anything after the value), but straight into datums.  Returns an
+    // empty pointer if the text isn't JSON.
+    static counted_t<const datum_t> from_json(const char *json);
     counted_t<datum_stream_t> as_datum_stream(
             const protob_t<const Backtrace> &backtrace) const;
 
@@ -149,6 +183,9 @@ public:
     bool operator>(const datum_t &rhs) const;
     bool operator>=(const datum_t &rhs) const;
 
+    // Data that compare equal hash the same.
+    size_t hash() const;
+
     void runtime_fail(base_exc_t::type_t exc_type,
                       const char *test, const char *file, int line,
                       std::string msg) const NORETURN;
@@ -188,6 +225,8 @@ private:
     void init_array();
     void init_object();
     void init_json(cJSON *json);
+    // Returns the text after the value, or NULL if the text isn't JSON.
+    MUST_USE const char *init_json_text(const char *json);
 
     void check_str_validity(const wire_string_t *str);
     void check_str_validity(const std::string &str);
@@ -199,17 +238,24 @@ private:
     void bool_to_str_key(std::string *str_out) const;
     void array_to_str_key(std::string *str_out) const;
 
+    // Like `get_reql_type`, but without copying the string out.
+    const wire_string_t &get_reql_type_str() const;
     int pseudo_cmp(const datum_t &rhs) const;
     static const std::set<std::string> _allowed_pts;
     void maybe_sanitize_ptype(const std::set<std::string> &allowed_pts = _allowed_pts);
 
+    // Reset by everything above that changes the datum, which only happens
+    // before it's shared.
+    friend size_t serialized_size(const counted_t<const datum_t> &datum);
+    serialized_size_cache_t serialized_size_cache;
+
     type_t type;
     union {
         bool r_bool;
         double r_num;
         wire_string_t *r_str;
         std::vector<counted_t<const datum_t> > *r_array;
-        std::map<std::string, counted_t<const datum_t> > *r_object;
+        datum_object_t *r_object;
     };
 
 public:
@@ -219,11 +265,76 @@ private:
     DISABLE_COPYING(datum_t);
 };
 
+// The fields of an object.  They're kept sorted by key in a single vector, which
+// takes one allocation instead of one per field, and which is faster to look things
+// up in and iterate over than a tree for objects of the sizes documents have.  It
+// has the parts of `std::map`'s const interface that we use.
+class datum_object_t {
+public:
+    typedef std::string key_type;
+    typedef std::pair<std::string, counted_t<const datum_t> > pair_t;
+    typedef std::vector<pair_t>::const_iterator const_iterator;
+    typedef std::vector<pair_t>::const_reverse_iterator const_reverse_iterator;
+
+    datum_object_t() { }
+    explicit datum_object_t(std::map<std::string, counted_t<const datum_t> > &&map);
+    // `pairs` must be sorted by key, without duplicate keys.
+    explicit datum_object_t(std::vector<pair_t> &&pairs);
+
+    const_iterator begin() const { return pairs_.begin(); }
+    const_iterator end() const { return pairs_.end(); }
+    const_reverse_iterator rbegin() const { return pairs_.rbegin(); }
+    const_reverse_iterator rend() const { return pairs_.rend(); }
+    size_t size() const { return pairs_.size(); }
+    bool empty() const { return pairs_.empty(); }
+
+    const_iterator find(const std::string &key) const;
+    size_t count(const std::string &key) const { return find(key) == end() ? 0 : 1; }
+
+    // Returns true if the key was already there, in which case the value is only
+    // replaced if `clobber_bool` is CLOBBER.
+    MUST_USE bool set(const std::string &key, counted_t<const datum_t> val,
+                      clobber_bool_t clobber_bool);
+    // Returns true if the key was there.
+    MUST_USE bool erase(const std::string &key);
+
+private:
+    std::vector<pair_t> pairs_;
+};
+
+// Sorts `pairs` by key for `datum_object_t`'s constructor, returning a pointer to a
+// duplicated key if there is one and NULL otherwise.
+const std::string *sort_object_pairs(std::vector<datum_object_t::pair_t> *pairs);
+
 size_t serialized_size(const counted_t<const datum_t> &datum);
 
 write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t> &datum);
 archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum);
 
+// How documents are stored in a table: like the above, except that an object's keys
+// that have ids in the table's `dictionary` are written as those ids (and the ones
+// that don't get noted in it).  With a NULL dictionary, the same as the above.
+size_t storage_serialized_size(const counted_t<const datum_t> &datum,
+                               const field_dictionary_t *dictionary);
+void serialize_for_storage(write_message_t *wm, const counted_t<const datum_t> &datum,
+                           field_dictionary_t *dictionary);
+// Reads either format; the dictionary is needed for what serialize_for_storage wrote
+// with one.
+archive_result_t deserialize_from_storage(read_stream_t *s,
+                                          counted_t<const datum_t> *datum,
+                                          const field_dictionary_t *dictionary);
+
+// Reads just the value of `key` off a serialized object, leaving `*value_out` empty
+// if the object has no such key.  Sets `*indexed_out` to false, having read only the
+// type byte, if the datum wasn't serialized as an object with a key directory (it
+// isn't an object, or it was written in the older format), in which case the
+// caller has to deserialize the whole datum (from the start) instead.  `dictionary`
+// is as for deserialize_from_storage.
+archive_result_t deserialize_field(read_stream_t *s, const std::string &key,
+                                   const field_dictionary_t *dictionary,
+                                   bool *indexed_out,
+                                   counted_t<const datum_t> *value_out);
+
 write_message_t &operator<<(write_message_t &wm, const empty_ok_t<const counted_t<const datum_t> > &datum);
 archive_result_t deserialize(read_stream_t *s, empty_ok_ref_t<counted_t<const datum_t> > datum);
 
@@ -286,6 +397,19 @@ private:
     DISABLE_COPYING(datum_ptr_t);
 };
 
+// For hash tables keyed by data.
+struct datum_value_hash_t {
+    size_t operator()(const counted_t<const datum_t> &a) const {
+        return a->hash();
+    }
+};
+struct datum_value_equal_t {
+    bool operator()(const counted_t<const datum_t> &a,
+                    const counted_t<const datum_t> &b) const {
+        return *a == *b;
+    }
+};
+
 // This is like a `wire_datum_t` but for gmr.  We need it because gmr allows
 // non-strings as keys, while the data model we pinched from JSON doesn't.  See
 // README.md for more info.
@@ -295,21 +419,21 @@ public:
     bool has(counted_t<const datum_t> key);
     counted_t<const datum_t> get(counted_t<const datum_t> key);
     void set(counted_t<const datum_t> key, counted_t<const datum_t> val);
+    // Returns the value for `key`, which can be replaced in place, or NULL if
+    // there isn't one.  (Each row of a grouped map reduce needs only this one
+    // lookup.)
+    counted_t<const datum_t> *find(counted_t<const datum_t> key);
 
     void compile();
     void finalize();
 
     counted_t<const datum_t> to_arr() const;
 private:
-    struct datum_value_compare_t {
-        bool operator()(counted_t<const datum_t> a, counted_t<const datum_t> b) const {
-            return *a < *b;
-        }
-    };
-
-    std::map<counted_t<const datum_t>,
-             counted_t<const datum_t>,
-             datum_value_compare_t> map;
+    // Groups are only put in order once, by `to_arr`.
+    std::unordered_map<counted_t<const datum_t>,
+                       counted_t<const datum_t>,
+                       datum_value_hash_t,
+                       datum_value_equal_t> map;
     std::vector<std::pair<Datum, Datum> > map_pb;
 
 public:
@@ -1,9 +1,17 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/datum_stream.hpp"
 
+#include <algorithm>
+#include <exception>
+#include <functional>
 #include <map>
 
 #include "clustering/administration/metadata.hpp"
+#include "concurrency/pmap.hpp"
+#include "config/args.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "containers/disk_backed_queue.hpp"
+#include "containers/uuid.hpp"
 #include "rdb_protocol/batching.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
@@ -29,7 +37,13 @@ void rdb_namespace_interface_t::read(
     profile::splitter_t splitter(env_->trace);
     r_sanity_check(read.profile == env_->profile());
     /* Do the actual read. */
-    internal_->read(read, response, tok, interruptor);
+    if (env_->query_priority != QUERY_PRIORITY_INTERACTIVE) {
+        rdb_protocol_t::read_t prioritized = read;
+        prioritized.query_priority = env_->query_priority;
+        internal_->read(prioritized, response, tok, interruptor);
+    } else {
+        internal_->read(read, response, tok, interruptor);
+    }
     /* Append the results of the parallel tasks to the current trace */
     splitter.give_splits(response->n_shards, response->event_log);
 }
@@ -44,7 +58,13 @@ void rdb_namespace_interface_t::read_outdated(
     /* propagate whether or not we're doing profiles */
     r_sanity_check(read.profile == env_->profile());
     /* Do the actual read. */
-    internal_->read_outdated(read, response, interruptor);
+    if (env_->query_priority != QUERY_PRIORITY_INTERACTIVE) {
+        rdb_protocol_t::read_t prioritized = read;
+        prioritized.query_priority = env_->query_priority;
+        internal_->read_outdated(prioritized, response, interruptor);
+    } else {
+        internal_->read_outdated(read, response, interruptor);
+    }
     /* Append the results of the profile to the current task */
     splitter.give_splits(response->n_shards, response->event_log);
 }
@@ -59,6 +79,7 @@ void rdb_namespace_interface_t::write(
     profile::splitter_t splitter(env_->trace);
     /* propagate whether or not we're doing profiles */
     write->profile = env_->profile();
+    write->query_priority = env_->query_priority;
     /* Do the actual read. */
     internal_->write(*write, response, tok, interruptor);
     /* Append the results of the profile to the current task */
@@ -391,15 +412,20 @@ sindex_readgen_t::sindex_readgen_t(
     const std::string &_sindex,
     datum_range_t range,
     profile_bool_t profile,
-    sorting_t sorting)
-    : readgen_t(global_optargs, range, profile, sorting), sindex(_sindex) { }
+    sorting_t sorting,
+    const boost::optional<geo_region_t> &_geo_region,
+    const std::vector<std::string> &_text_words)
+    : readgen_t(global_optargs, range, profile, sorting), sindex(_sindex),
+      geo_region(_geo_region), text_words(_text_words) { }
 
 scoped_ptr_t<readgen_t> sindex_readgen_t::make(
-    env_t *env, const std::string &sindex, datum_range_t range, sorting_t sorting) {
+    env_t *env, const std::string &sindex, datum_range_t range, sorting_t sorting,
+    const boost::optional<geo_region_t> &geo_region,
+    const std::vector<std::string> &text_words) {
     return scoped_ptr_t<readgen_t>(
         new sindex_readgen_t(
             env->global_optargs.get_all_optargs(),
-            sindex, range, env->profile(), sorting));
+            sindex, range, env->profile(), sorting, geo_region, text_words));
 }
 
 class sindex_compare_t {
@@ -434,7 +460,8 @@ rget_read_t sindex_readgen_t::next_read_impl(
         batchspec,
         transform,
         boost::optional<terminal_t>(),
-        sindex_rangespec_t(sindex, region_t(active_range), original_datum_range),
+        sindex_rangespec_t(sindex, region_t(active_range), original_datum_range,
+                           geo_region, text_words),
         sorting);
 }
 
@@ -471,7 +498,9 @@ boost::optional<read_t> sindex_readgen_t::sindex_sort_read(
                         sindex_rangespec_t(
                             sindex,
                             region_t(key_range_t(rng)),
-                            original_datum_range),
+                            original_datum_range,
+                            geo_region,
+                            text_words),
                         sorting),
                     profile);
             }
@@ -489,6 +518,16 @@ std::string sindex_readgen_t::sindex_name() const {
 }
 
 // DATUM_STREAM_T
+bool datum_stream_t::top_k(UNUSED env_t *env, UNUSED const top_k_wire_func_t &f,
+                           UNUSED std::vector<counted_t<const datum_t> > *out) {
+    return false;
+}
+
+bool datum_stream_t::sample(UNUSED env_t *env, UNUSED const sample_wire_func_t &f,
+                            UNUSED reservoir_t *out) {
+    return false;
+}
+
 counted_t<datum_stream_t> datum_stream_t::slice(size_t l, size_t r) {
     return make_counted<slice_datum_stream_t>(l, r, this->counted_from_this());
 }
@@ -588,14 +627,13 @@ counted_t<const datum_t> eager_datum_stream_t::gmr(env_t *env,
         while (counted_t<const datum_t> el = next(env, batchspec)) {
             counted_t<const datum_t> el_group = group->call(env, el)->as_datum();
             counted_t<const datum_t> el_map = map->call(env, el)->as_datum();
-            if (!wd_map.has(el_group)) {
+            if (counted_t<const datum_t> *acc = wd_map.find(el_group)) {
+                *acc = reduce->call(env, *acc, el_map)->as_datum();
+            } else {
                 wd_map.set(el_group,
                            base.has()
                            ? reduce->call(env, base, el_map)->as_datum()
                            : el_map);
-            } else {
-                wd_map.set(el_group,
-                           reduce->call(env, wd_map.get(el_group), el_map)->as_datum());
             }
             sampler.new_sample();
         }
@@ -665,6 +703,24 @@ counted_t<const datum_t> lazy_datum_stream_t::count(env_t *env) {
     return boost::get<counted_t<const datum_t> >(res);
 }
 
+bool lazy_datum_stream_t::top_k(env_t *env, const top_k_wire_func_t &f,
+                                std::vector<counted_t<const datum_t> > *out) {
+    rget_read_response_t::result_t res = reader.run_terminal(env, f);
+    rget_read_response_t::top_k_t *top = boost::get<rget_read_response_t::top_k_t>(&res);
+    r_sanity_check(top);
+    *out = std::move(*top);
+    return true;
+}
+
+bool lazy_datum_stream_t::sample(env_t *env, const sample_wire_func_t &f,
+                                 reservoir_t *out) {
+    rget_read_response_t::result_t res = reader.run_terminal(env, f);
+    reservoir_t *reservoir = boost::get<reservoir_t>(&res);
+    r_sanity_check(reservoir);
+    *out = std::move(*reservoir);
+    return true;
+}
+
 counted_t<const datum_t> lazy_datum_stream_t::reduce(
     env_t *env, counted_t<val_t> base_val, counted_t<func_t> f) {
     rget_read_response_t::result_t res
@@ -762,6 +818,33 @@ bool array_datum_stream_t::is_array() {
     return true;
 }
 
+// CHANGEFEED_DATUM_STREAM_T
+changefeed_datum_stream_t::changefeed_datum_stream_t(
+    scoped_ptr_t<changefeed::subscription_t> &&_sub,
+    const protob_t<const Backtrace> &bt_src)
+    : eager_datum_stream_t(bt_src), sub(std::move(_sub)) { }
+
+counted_t<const datum_t> changefeed_datum_stream_t::count(UNUSED env_t *env) {
+    rfail(base_exc_t::GENERIC, "Cannot call `count` on an infinite stream.");
+}
+
+counted_t<const datum_t> changefeed_datum_stream_t::reduce(
+    UNUSED env_t *env, UNUSED counted_t<val_t> base_val, UNUSED counted_t<func_t> f) {
+    rfail(base_exc_t::GENERIC, "Cannot call `reduce` on an infinite stream.");
+}
+
+counted_t<const datum_t> changefeed_datum_stream_t::gmr(
+    UNUSED env_t *env, UNUSED counted_t<func_t> g, UNUSED counted_t<func_t> m,
+    UNUSED counted_t<const datum_t> d, UNUSED counted_t<func_t> r) {
+    rfail(base_exc_t::GENERIC, "Cannot call `grouped_map_reduce` on an infinite stream.");
+}
+
+std::vector<counted_t<const datum_t> >
+changefeed_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
+    batcher_t batcher = batchspec.to_batcher();
+    return sub->get_els(&batcher, env->interruptor);
+}
+
 // INDEXED_SORT_DATUM_STREAM_T
 indexed_sort_datum_stream_t::indexed_sort_datum_stream_t(
     counted_t<datum_stream_t> stream,
@@ -803,6 +886,344 @@ indexed_sort_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batc
     return ret;
 }
 
+// SORT_DATUM_STREAM_T
+struct sort_datum_stream_t::run_t {
+    // A run that's kept in memory.
+    explicit run_t(std::vector<counted_t<const datum_t> > &&_chunk)
+        : chunk(std::move(_chunk)), pos(0), level(0) { }
+
+    // A run that's spilled to disk.
+    run_t(io_backender_t *io_backender, const serializer_filepath_t &filename)
+        : queue(new disk_backed_queue_t<std::vector<counted_t<const datum_t> > >(
+                    io_backender, filename, &get_global_perfmon_collection())),
+          pos(0), level(0) { }
+
+    // Makes `head()` the run's smallest remaining element, reading in the next
+    // chunk if we're done with this one.  Returns false if there are none left.
+    bool load_head() {
+        if (pos == chunk.size()) {
+            chunk.clear();
+            pos = 0;
+            if (!queue.has() || queue->empty()) {
+                return false;
+            }
+            queue->pop(&chunk);
+            r_sanity_check(!chunk.empty());
+        }
+        return true;
+    }
+
+    const counted_t<const datum_t> &head() const { return chunk[pos]; }
+
+    // Empty if the run is only in memory.
+    scoped_ptr_t<disk_backed_queue_t<std::vector<counted_t<const datum_t> > > > queue;
+
+    // The chunk we're reading from, and how far we've gotten in it.
+    std::vector<counted_t<const datum_t> > chunk;
+    size_t pos;
+
+    // How many times the run's elements have been merged.
+    int level;
+};
+
+namespace {
+
+// Orders runs by their smallest elements, so that the heap of them has the run with
+// the smallest element on top.
+class run_head_greater_t {
+public:
+    run_head_greater_t(
+        env_t *_env, profile::sampler_t *_sampler,
+        const std::function<bool(env_t *,  // NOLINT(readability/casting)
+                                 profile::sampler_t *,
+                                 const counted_t<const datum_t> &,
+                                 const counted_t<const datum_t> &)> *_lt_cmp)
+        : env(_env), sampler(_sampler), lt_cmp(_lt_cmp) { }
+
+    template <class run_t>
+    bool operator()(const run_t *left, const run_t *right) const {
+        return (*lt_cmp)(env, sampler, right->head(), left->head());
+    }
+
+private:
+    env_t *env;
+    profile::sampler_t *sampler;
+    const std::function<bool(env_t *,  // NOLINT(readability/casting)
+                             profile::sampler_t *,
+                             const counted_t<const datum_t> &,
+                             const counted_t<const datum_t> &)> *lt_cmp;
+};
+
+// Writes elements onto a run's queue, a chunk at a time.
+class run_writer_t {
+public:
+    explicit run_writer_t(
+        disk_backed_queue_t<std::vector<counted_t<const datum_t> > > *_queue)
+        : queue(_queue), chunk_bytes(0) { }
+
+    ~run_writer_t() {
+        rassert(chunk.empty(), "run_writer_t destroyed without being flushed.");
+    }
+
+    void write(counted_t<const datum_t> &&datum) {
+        chunk_bytes += serialized_size(datum);
+        chunk.push_back(std::move(datum));
+        if (chunk_bytes >= EXTERNAL_SORT_CHUNK_SIZE) {
+            flush();
+        }
+    }
+
+    void flush() {
+        if (!chunk.empty()) {
+            queue->push(chunk);
+            chunk.clear();
+            chunk_bytes = 0;
+        }
+    }
+
+    // Drops the elements that haven't been flushed, for when the run is being
+    // thrown away.
+    void discard() {
+        chunk.clear();
+        chunk_bytes = 0;
+    }
+
+private:
+    disk_backed_queue_t<std::vector<counted_t<const datum_t> > > *const queue;
+    std::vector<counted_t<const datum_t> > chunk;
+    size_t chunk_bytes;
+
+    DISABLE_COPYING(run_writer_t);
+};
+
+}  // namespace
+
+sort_datum_stream_t::sort_datum_stream_t(
+    counted_t<datum_stream_t> stream,
+    std::function<bool(env_t *,  // NOLINT(readability/casting)
+                       profile::sampler_t *,
+                       const counted_t<const datum_t> &,
+                       const counted_t<const datum_t> &)> _lt_cmp,
+    const boost::optional<order_wire_func_t> &_order)
+    : wrapper_datum_stream_t(stream), lt_cmp(_lt_cmp), order(_order),
+      read_all(false), index(0) { }
+
+sort_datum_stream_t::~sort_datum_stream_t() { }
+
+counted_t<datum_stream_t> sort_datum_stream_t::slice(size_t l, size_t r) {
+    if (!read_all && (!limit || r < *limit)) {
+        limit = r;
+    }
+    return datum_stream_t::slice(l, r);
+}
+
+bool sort_datum_stream_t::is_exhausted() const {
+    return read_all && index == data.size() && merge_heap.empty()
+        && batch_cache_exhausted();
+}
+
+std::vector<counted_t<const datum_t> >
+sort_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
+    if (!read_all) {
+        read_source(env);
+    }
+
+    std::vector<counted_t<const datum_t> > ret;
+    batcher_t batcher = batchspec.to_batcher();
+    if (runs.empty()) {
+        for (; index < data.size() && !batcher.should_send_batch(); ++index) {
+            batcher.note_el(data[index]);
+            ret.push_back(std::move(data[index]));
+        }
+    } else {
+        profile::sampler_t sampler("Merging spilled sorted runs.", env->trace);
+        counted_t<const datum_t> datum;
+        while (!batcher.should_send_batch() && pop_merged(env, &sampler, &datum)) {
+            batcher.note_el(datum);
+            ret.push_back(std::move(datum));
+        }
+    }
+    return ret;
+}
+
+void sort_datum_stream_t::read_source(env_t *env) {
+    r_sanity_check(!read_all);
+    read_all = true;
+
+    profile::sampler_t sampler("Sorting in-memory.", env->trace);
+    if (limit && *limit <= array_size_limit()) {
+        read_source_into_heap(env, &sampler);
+        return;
+    }
+
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    for (;;) {
+        std::vector<counted_t<const datum_t> > batch = source->next_batch(env, batchspec);
+        if (batch.empty()) {
+            break;
+        }
+        std::move(batch.begin(), batch.end(), std::back_inserter(data));
+        if (data.size() > array_size_limit()) {
+            rcheck(env->io_backender != NULL, base_exc_t::GENERIC,
+                   strprintf("Array over size limit %zu.", data.size()).c_str());
+            spill(env, &sampler);
+        }
+    }
+
+    sort_data(env, &sampler);
+    if (!runs.empty()) {
+        // The rest of the elements are merged with the spilled runs, straight out
+        // of memory.
+        runs.push_back(make_scoped<run_t>(std::move(data)));
+        data.clear();
+        start_merging(env, &sampler, 0, runs.size());
+    }
+}
+
+void sort_datum_stream_t::read_source_into_heap(env_t *env,
+                                                profile::sampler_t *sampler) {
+    // `data` is a heap with the largest of the elements we're keeping on top.
+    auto cmp = std::bind(lt_cmp, env, sampler, ph::_1, ph::_2);
+    const size_t k = *limit;
+    if (order && k > 0 && source->top_k(env, top_k_wire_func_t(*order, k), &data)) {
+        return;
+    }
+
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    for (;;) {
+        std::vector<counted_t<const datum_t> > batch = source->next_batch(env, batchspec);
+        if (batch.empty()) {
+            break;
+        }
+        for (auto it = batch.begin(); it != batch.end(); ++it) {
+            if (data.size() < k) {
+                data.push_back(std::move(*it));
+                std::push_heap(data.begin(), data.end(), cmp);
+            } else if (k > 0 && cmp(*it, data.front())) {
+                std::pop_heap(data.begin(), data.end(), cmp);
+                data.back() = std::move(*it);
+                std::push_heap(data.begin(), data.end(), cmp);
+            }
+        }
+    }
+    std::sort_heap(data.begin(), data.end(), cmp);
+}
+
+void sort_datum_stream_t::sort_data(env_t *env, profile::sampler_t *sampler) {
+    if (!order) {
+        std::sort(data.begin(), data.end(),
+                  std::bind(lt_cmp, env, sampler, ph::_1, ph::_2));
+        return;
+    }
+
+    // We evaluate the order's functions once per element, and then most
+    // comparisons are a `memcmp`.
+    typedef std::pair<sort_key_t, counted_t<const datum_t> > keyed_t;
+    std::vector<keyed_t> keyed;
+    keyed.reserve(data.size());
+    for (auto it = data.begin(); it != data.end(); ++it) {
+        keyed.push_back(std::make_pair(order->key(env, *it), std::move(*it)));
+        sampler->new_sample();
+    }
+    std::sort(keyed.begin(), keyed.end(),
+              [](const keyed_t &l, const keyed_t &r) { return l.first < r.first; });
+    for (size_t i = 0; i < keyed.size(); ++i) {
+        data[i] = std::move(keyed[i].second);
+    }
+}
+
+void sort_datum_stream_t::spill(env_t *env, profile::sampler_t *sampler) {
+    r_sanity_check(env->io_backender != NULL && env->spill_path);
+    sort_data(env, sampler);
+
+    scoped_ptr_t<run_t> run = make_scoped<run_t>(
+        env->io_backender,
+        serializer_filepath_t(*env->spill_path,
+                              "order_by_" + uuid_to_str(generate_uuid())));
+    {
+        run_writer_t writer(run->queue.get());
+        for (auto it = data.begin(); it != data.end(); ++it) {
+            writer.write(std::move(*it));
+        }
+        writer.flush();
+    }
+    data.clear();
+    runs.push_back(std::move(run));
+
+    // Each run has a file and a cache of its own, so we don't let them pile up.
+    // Whenever the newest ORDER_BY_MERGE_FAN_IN runs have all been merged the same
+    // number of times, we merge them into one, so that every element gets written
+    // out a logarithmic number of times.
+    while (runs.size() >= ORDER_BY_MERGE_FAN_IN) {
+        const size_t begin = runs.size() - ORDER_BY_MERGE_FAN_IN;
+        bool same_level = true;
+        for (size_t i = begin; i < runs.size(); ++i) {
+            same_level = same_level && runs[i]->level == runs.back()->level;
+        }
+        if (!same_level) {
+            break;
+        }
+        merge_runs(env, sampler, begin, runs.size());
+    }
+}
+
+void sort_datum_stream_t::merge_runs(env_t *env, profile::sampler_t *sampler,
+                                     size_t begin, size_t end) {
+    const int level = runs[begin]->level + 1;
+    start_merging(env, sampler, begin, end);
+
+    scoped_ptr_t<run_t> merged = make_scoped<run_t>(
+        env->io_backender,
+        serializer_filepath_t(*env->spill_path,
+                              "order_by_" + uuid_to_str(generate_uuid())));
+    {
+        run_writer_t writer(merged->queue.get());
+        counted_t<const datum_t> datum;
+        while (pop_merged(env, sampler, &datum)) {
+            writer.write(std::move(datum));
+        }
+        writer.flush();
+    }
+
+    merged->level = level;
+
+    // Destroying the merged runs deletes their files.
+    runs.erase(runs.begin() + begin, runs.begin() + end);
+    runs.push_back(std::move(merged));
+}
+
+void sort_datum_stream_t::start_merging(env_t *env, profile::sampler_t *sampler,
+                                        size_t begin, size_t end) {
+    r_sanity_check(merge_heap.empty());
+    for (size_t i = begin; i < end; ++i) {
+        if (runs[i]->load_head()) {
+            merge_heap.push_back(runs[i].get());
+        }
+    }
+    std::make_heap(merge_heap.begin(), merge_heap.end(),
+                   run_head_greater_t(env, sampler, &lt_cmp));
+}
+
+bool sort_datum_stream_t::pop_merged(env_t *env, profile::sampler_t *sampler,
+                                     counted_t<const datum_t> *out) {
+    if (merge_heap.empty()) {
+        return false;
+    }
+
+    run_head_greater_t cmp(env, sampler, &lt_cmp);
+    std::pop_heap(merge_heap.begin(), merge_heap.end(), cmp);
+    run_t *run = merge_heap.back();
+    *out = std::move(run->chunk[run->pos]);
+    ++run->pos;
+
+    if (run->load_head()) {
+        std::push_heap(merge_heap.begin(), merge_heap.end(), cmp);
+    } else {
+        merge_heap.pop_back();
+    }
+    return true;
+}
+
 // MAP_DATUM_STREAM_T
 map_datum_stream_t::map_datum_stream_t(counted_t<func_t> _f,
                                        counted_t<datum_stream_t> _source)
@@ -813,10 +1234,8 @@ std::vector<counted_t<const datum_t> >
 map_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
     std::vector<counted_t<const datum_t> > v = source->next_batch(env, batchspec);
     profile::sampler_t sampler("Mapping eagerly.", env->trace);
-    for (auto it = v.begin(); it != v.end(); ++it) {
-        *it = f->call(env, *it)->as_datum();
-        sampler.new_sample();
-    }
+    f->map_batch(env, &v);
+    sampler.new_sample();
     return v;
 }
 
@@ -864,12 +1283,9 @@ filter_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec)
         if (v.size() == 0) {
             break;
         }
-        for (auto it = v.begin(); it != v.end(); ++it) {
-            if (f->filter_call(env, *it, default_filter_val)) {
-                ret.push_back(std::move(*it));
-            }
-            sampler.new_sample();
-        }
+        f->filter_batch(env, &v, default_filter_val);
+        std::move(v.begin(), v.end(), std::back_inserter(ret));
+        sampler.new_sample();
     }
     return ret;
 }
@@ -885,7 +1301,22 @@ std::vector<counted_t<const datum_t> >
 concatmap_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
     profile::sampler_t sampler("Concat_mapping eagerly.", env->trace);
     for (;;) {
-        if (!subsource.has()) {
+        if (!subsource.has() && f->can_overlap_calls()) {
+            if (pending.empty()) {
+                call_overlapped(env, batchspec);
+                if (pending.empty()) {
+                    return std::vector<counted_t<const datum_t> >();
+                }
+            }
+            std::vector<counted_t<const datum_t> > v;
+            v.swap(pending.front().first_batch);
+            subsource = pending.front().rest;
+            pending.pop_front();
+            sampler.new_sample();
+            if (v.size() != 0) {
+                return v;
+            }
+        } else if (!subsource.has()) {
             counted_t<const datum_t> arg = source->next(env, batchspec);
             if (!arg.has()) {
                 return std::vector<counted_t<const datum_t> >();
@@ -903,6 +1334,291 @@ concatmap_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchsp
     }
 }
 
+void concatmap_datum_stream_t::call_overlapped(env_t *env,
+                                               const batchspec_t &batchspec) {
+    std::vector<counted_t<const datum_t> > args = source->next_batch(env, batchspec);
+    std::vector<pending_t> results(args.size());
+    overlap_calls(env, args.size(), [&](size_t i) {
+        results[i].rest = f->call(env, args[i])->as_seq(env);
+        results[i].first_batch = results[i].rest->next_batch(env, batchspec);
+    });
+    std::move(results.begin(), results.end(), std::back_inserter(pending));
+}
+
+// EQ_JOIN_DATUM_STREAM_T
+static counted_t<const datum_t> join_pair(const counted_t<const datum_t> &left,
+                                          const counted_t<const datum_t> &right) {
+    datum_ptr_t pair(datum_t::R_OBJECT);
+    UNUSED bool b1 = pair.add("left", left);
+    UNUSED bool b2 = pair.add("right", right);
+    return pair.to_counted();
+}
+
+eq_join_datum_stream_t::eq_join_datum_stream_t(counted_t<datum_stream_t> _source,
+                                               counted_t<func_t> _left_field,
+                                               counted_t<table_t> _table,
+                                               const std::string &_index)
+    : wrapper_datum_stream_t(_source), left_field(_left_field), table(_table),
+      index(_index) {
+    guarantee(left_field.has() && table.has());
+}
+
+std::vector<counted_t<const datum_t> >
+eq_join_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
+    std::vector<counted_t<const datum_t> > ret;
+    profile::sampler_t sampler("Joining eagerly.", env->trace);
+    while (ret.size() == 0) {
+        std::vector<counted_t<const datum_t> > lefts = source->next_batch(env, batchspec);
+        if (lefts.size() == 0) {
+            break;
+        }
+        std::vector<counted_t<const datum_t> > keys;
+        keys.reserve(lefts.size());
+        for (auto it = lefts.begin(); it != lefts.end(); ++it) {
+            keys.push_back(left_field->call(env, *it)->as_datum());
+        }
+
+        if (index == table->get_pkey()) {
+            std::vector<counted_t<const datum_t> > rights = table->get_rows(env, keys);
+            for (size_t i = 0; i < lefts.size(); ++i) {
+                if (rights[i]->get_type() != datum_t::R_NULL) {
+                    ret.push_back(join_pair(lefts[i], rights[i]));
+                }
+                sampler.new_sample();
+            }
+        } else {
+            for (size_t i = 0; i < lefts.size(); ++i) {
+                counted_t<datum_stream_t> rights
+                    = table->get_all(env, keys[i], index, backtrace());
+                for (;;) {
+                    std::vector<counted_t<const datum_t> > v
+                        = rights->next_batch(env, batchspec);
+                    if (v.size() == 0) {
+                        break;
+                    }
+                    for (auto it = v.begin(); it != v.end(); ++it) {
+                        ret.push_back(join_pair(lefts[i], *it));
+                    }
+                }
+                sampler.new_sample();
+            }
+        }
+    }
+    return ret;
+}
+
+// HASH_JOIN_DATUM_STREAM_T
+struct hash_join_datum_stream_t::partition_t {
+    typedef disk_backed_queue_t<std::vector<counted_t<const datum_t> > > queue_t;
+
+    explicit partition_t(env_t *env)
+        : lefts(new queue_t(env->io_backender,
+                            serializer_filepath_t(*env->spill_path,
+                                                  "join_" + uuid_to_str(generate_uuid())),
+                            &get_global_perfmon_collection())),
+          rights(new queue_t(env->io_backender,
+                             serializer_filepath_t(*env->spill_path,
+                                                   "join_" + uuid_to_str(generate_uuid())),
+                             &get_global_perfmon_collection())),
+          left_writer(lefts.get()), right_writer(rights.get()) { }
+
+    // If the join gets interrupted or fails while the partitions are being written,
+    // they're thrown away.
+    ~partition_t() {
+        left_writer.discard();
+        right_writer.discard();
+    }
+
+    scoped_ptr_t<queue_t> lefts;
+    scoped_ptr_t<queue_t> rights;
+    run_writer_t left_writer;
+    run_writer_t right_writer;
+};
+
+// The value of `field` in `row`, or NULL if it doesn't have one.
+static counted_t<const datum_t> join_key(const counted_t<const datum_t> &row,
+                                         const std::string &field) {
+    if (row->get_type() != datum_t::R_OBJECT) {
+        return counted_t<const datum_t>();
+    }
+    return row->get(field, NOTHROW);
+}
+
+hash_join_datum_stream_t::hash_join_datum_stream_t(counted_t<datum_stream_t> _source,
+                                                   counted_t<datum_stream_t> _right,
+                                                   counted_t<func_t> _f,
+                                                   const std::string &_left_field,
+                                                   const std::string &_right_field,
+                                                   bool _outer)
+    : wrapper_datum_stream_t(_source), right(_right), f(_f),
+      left_field(_left_field), right_field(_right_field), outer(_outer),
+      built(false), num_rows(0), partition_index(0) {
+    guarantee(right.has() && f.has());
+}
+
+hash_join_datum_stream_t::~hash_join_datum_stream_t() { }
+
+bool hash_join_datum_stream_t::is_exhausted() const {
+    return wrapper_datum_stream_t::is_exhausted()
+        && partition_index == partitions.size();
+}
+
+std::vector<counted_t<const datum_t> >
+hash_join_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
+    std::vector<counted_t<const datum_t> > ret;
+    profile::sampler_t sampler("Hash joining.", env->trace);
+    while (ret.size() == 0 && partitions.empty()) {
+        std::vector<counted_t<const datum_t> > lefts = source->next_batch(env, batchspec);
+        if (lefts.size() == 0) {
+            return ret;
+        }
+        // Like the nested loops, we don't read `right` if there are no left rows.
+        if (!built) {
+            build(env, &lefts);
+        }
+        for (auto it = lefts.begin(); it != lefts.end(); ++it) {
+            join(env, *it, &ret);
+            sampler.new_sample();
+        }
+    }
+
+    while (ret.size() == 0 && partition_index < partitions.size()) {
+        partition_t *partition = partitions[partition_index].get();
+        if (partition->rights.has()) {
+            rows.clear();
+            std::vector<counted_t<const datum_t> > chunk;
+            while (!partition->rights->empty()) {
+                partition->rights->pop(&chunk);
+                for (auto it = chunk.begin(); it != chunk.end(); ++it) {
+                    rows[join_key(*it, right_field)].push_back(std::move(*it));
+                }
+            }
+            partition->rights.reset();
+        }
+        if (partition->lefts->empty()) {
+            // This deletes the partition's files.
+            partitions[partition_index].reset();
+            ++partition_index;
+            continue;
+        }
+        std::vector<counted_t<const datum_t> > lefts;
+        partition->lefts->pop(&lefts);
+        for (auto it = lefts.begin(); it != lefts.end(); ++it) {
+            join(env, *it, &ret);
+            sampler.new_sample();
+        }
+    }
+    return ret;
+}
+
+void hash_join_datum_stream_t::build(env_t *env,
+                                     std::vector<counted_t<const datum_t> > *lefts) {
+    r_sanity_check(!built);
+    built = true;
+
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    for (;;) {
+        std::vector<counted_t<const datum_t> > batch = right->next_batch(env, batchspec);
+        if (batch.empty()) {
+            break;
+        }
+        for (auto it = batch.begin(); it != batch.end(); ++it) {
+            add_right(*it);
+        }
+        if (partitions.empty() && num_rows > array_size_limit()) {
+            rcheck(env->io_backender != NULL, base_exc_t::GENERIC,
+                   strprintf("Array over size limit %zu.", num_rows).c_str());
+            r_sanity_check(env->spill_path);
+            partitions.reserve(HASH_JOIN_PARTITIONS);
+            for (size_t i = 0; i < HASH_JOIN_PARTITIONS; ++i) {
+                partitions.push_back(make_scoped<partition_t>(env));
+            }
+            for (auto jt = rows.begin(); jt != rows.end(); ++jt) {
+                partition_t *partition
+                    = partitions[jt->first->hash() % HASH_JOIN_PARTITIONS].get();
+                for (auto kt = jt->second.begin(); kt != jt->second.end(); ++kt) {
+                    partition->right_writer.write(std::move(*kt));
+                }
+            }
+            rows.clear();
+        }
+    }
+    if (partitions.empty()) {
+        return;
+    }
+
+    for (;;) {
+        for (auto it = lefts->begin(); it != lefts->end(); ++it) {
+            counted_t<const datum_t> key = left_key(env, *it);
+            partitions[key->hash() % HASH_JOIN_PARTITIONS]->left_writer.write(
+                std::move(*it));
+        }
+        *lefts = source->next_batch(env, batchspec);
+        if (lefts->empty()) {
+            break;
+        }
+    }
+    for (auto it = partitions.begin(); it != partitions.end(); ++it) {
+        (*it)->left_writer.flush();
+        (*it)->right_writer.flush();
+    }
+}
+
+void hash_join_datum_stream_t::add_right(const counted_t<const datum_t> &row) {
+    if (!first_right.has()) {
+        first_right = row;
+    }
+    counted_t<const datum_t> key = join_key(row, right_field);
+    if (!key.has()) {
+        if (!bad_right.has()) {
+            bad_right = row;
+        }
+        return;
+    }
+    if (partitions.empty()) {
+        rows[key].push_back(row);
+        ++num_rows;
+    } else {
+        partitions[key->hash() % HASH_JOIN_PARTITIONS]->right_writer.write(
+            counted_t<const datum_t>(row));
+    }
+}
+
+counted_t<const datum_t> hash_join_datum_stream_t::left_key(
+        env_t *env, const counted_t<const datum_t> &left) {
+    r_sanity_check(first_right.has());
+    // The nested loops would call `f` on `left` and each right row, so these are
+    // errors.  Calling it reports them.
+    if (bad_right.has()) {
+        f->call(env, left, bad_right);
+        r_sanity_check(false);
+    }
+    counted_t<const datum_t> key = join_key(left, left_field);
+    if (!key.has()) {
+        f->call(env, left, first_right);
+        r_sanity_check(false);
+    }
+    return key;
+}
+
+void hash_join_datum_stream_t::join(env_t *env, const counted_t<const datum_t> &left,
+                                    std::vector<counted_t<const datum_t> > *out) {
+    if (first_right.has()) {
+        auto it = rows.find(left_key(env, left));
+        if (it != rows.end()) {
+            for (auto jt = it->second.begin(); jt != it->second.end(); ++jt) {
+                out->push_back(join_pair(left, *jt));
+            }
+            return;
+        }
+    }
+    if (outer) {
+        datum_ptr_t pair(datum_t::R_OBJECT);
+        UNUSED bool b = pair.add("left", left);
+        out->push_back(pair.to_counted());
+    }
+}
+
 // SLICE_DATUM_STREAM_T
 slice_datum_stream_t::slice_datum_stream_t(uint64_t _left, uint64_t _right,
                                            counted_t<datum_stream_t> _src)
@@ -1097,11 +1813,24 @@ bool union_datum_stream_t::is_exhausted() const {
             return false;
         }
     }
-    return batch_cache_exhausted();
+    return read_batches.empty() && batch_cache_exhausted();
 }
 
 std::vector<counted_t<const datum_t> >
 union_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
+    // A union's order is unspecified, so rather than wait on each stream's reads in
+    // turn, we wait on all of their reads at once.  A profiled query's events
+    // would get interleaved, though.
+    if (read_batches.empty() && !env->trace.has()) {
+        read_concurrently(env, batchspec);
+    }
+    if (!read_batches.empty()) {
+        std::vector<counted_t<const datum_t> > batch = std::move(read_batches.front());
+        read_batches.pop_front();
+        return batch;
+    }
+
+    // Whatever doesn't read from the shards, and the last stream that does.
     for (; streams_index < streams.size(); ++streams_index) {
         std::vector<counted_t<const datum_t> > batch
             = streams[streams_index]->next_batch(env, batchspec);
@@ -1112,4 +1841,36 @@ union_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec)
     return std::vector<counted_t<const datum_t> >();
 }
 
+void union_datum_stream_t::read_concurrently(env_t *env, const batchspec_t &batchspec) {
+    std::vector<datum_stream_t *> reading;
+    for (auto it = streams.begin(); it != streams.end(); ++it) {
+        if ((*it)->reads_from_shards() && !(*it)->is_exhausted()) {
+            reading.push_back(it->get());
+        }
+    }
+    if (reading.size() < 2) {
+        return;
+    }
+
+    std::vector<std::vector<counted_t<const datum_t> > > batches(reading.size());
+    std::vector<std::exception_ptr> exceptions(reading.size());
+    pmap(reading.size(), [&](int i) {
+        try {
+            batches[i] = reading[i]->next_batch(env, batchspec);
+        } catch (const std::exception &) {
+            exceptions[i] = std::current_exception();
+        }
+    });
+    for (size_t i = 0; i < reading.size(); ++i) {
+        if (exceptions[i] != std::exception_ptr()) {
+            std::rethrow_exception(exceptions[i]);
+        }
+    }
+    for (size_t i = 0; i < reading.size(); ++i) {
+        if (!batches[i].empty()) {
+            read_batches.push_back(std::move(batches[i]));
+        }
+    }
+}
+
 } // namespace ql
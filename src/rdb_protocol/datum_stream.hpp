@@ -8,6 +8,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -89,6 +90,7 @@ typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
 typedef rdb_protocol_t::region_t region_t;
 
 class scope_env_t;
+class table_t;
 class datum_stream_t : public single_threaded_countable_t<datum_stream_t>,
                        public pb_rcheckable_t {
 public:
@@ -111,8 +113,15 @@ public:
                                          counted_t<const datum_t> d,
                                          counted_t<func_t> r) = 0;
 
+    // Puts the `k` smallest elements, sorted, in `*out`, if the stream can find
+    // them where its data lives; returns false (having done nothing) otherwise.
+    virtual bool top_k(env_t *env, const top_k_wire_func_t &f,
+                       std::vector<counted_t<const datum_t> > *out);
+    // Likewise puts a uniform random sample of the stream's elements in `*out`.
+    virtual bool sample(env_t *env, const sample_wire_func_t &f, reservoir_t *out);
+
     // stream -> stream (always eager)
-    counted_t<datum_stream_t> slice(size_t l, size_t r);
+    virtual counted_t<datum_stream_t> slice(size_t l, size_t r);
     counted_t<datum_stream_t> zip();
     counted_t<datum_stream_t> indexes_of(counted_t<func_t> f);
 
@@ -128,6 +137,10 @@ public:
     // Prefer `next_batch`.  Cannot be used in conjunction with `next_batch`.
     virtual counted_t<const datum_t> next(env_t *env, const batchspec_t &batchspec);
     virtual bool is_exhausted() const = 0;
+    // Whether `next_batch` just waits on reads from the shards, without evaluating
+    // anything on `env`, so that other streams can get batches with the same `env`
+    // at the same time.
+    virtual bool reads_from_shards() const { return false; }
 
 protected:
     bool batch_cache_exhausted() const;
@@ -226,13 +239,99 @@ public:
 private:
     virtual bool is_exhausted() const {
         return (!subsource || subsource->is_exhausted())
+            && pending.empty()
             && wrapper_datum_stream_t::is_exhausted();
     }
     std::vector<counted_t<const datum_t> >
     next_batch_impl(env_t *env, const batchspec_t &batchspec);
 
+    // Calls `f` on a batch of `source`'s rows at once (see `overlap_calls`), and
+    // queues each result's first batch and the rest of it.
+    void call_overlapped(env_t *env, const batchspec_t &batchspec);
+
     counted_t<func_t> f;
     counted_t<datum_stream_t> subsource;
+
+    struct pending_t {
+        std::vector<counted_t<const datum_t> > first_batch;
+        counted_t<datum_stream_t> rest;
+    };
+    std::deque<pending_t> pending;
+};
+
+// Joins each row of `source` to the rows of `table` whose `index` is the row's
+// `left_field`.  The lookups for a batch of left rows are done together, so for
+// the primary key they're one read per shard.
+class eq_join_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    eq_join_datum_stream_t(counted_t<datum_stream_t> _source,
+                           counted_t<func_t> _left_field,
+                           counted_t<table_t> _table,
+                           const std::string &_index);
+
+private:
+    std::vector<counted_t<const datum_t> >
+    next_batch_impl(env_t *env, const batchspec_t &batchspec);
+
+    counted_t<func_t> left_field;
+    counted_t<table_t> table;
+    std::string index;
+};
+
+// Joins each row of `source` to the rows of `right` whose `right_field` equals its
+// `left_field`, which is what `f` tests, in the order the nested loops of
+// `inner_join` and `outer_join` would.  The rows of `right` go into a hash table.
+// If there are more of them than the array size limit, both sides get split into
+// partitions on disk by hash, and are joined a partition at a time (which puts the
+// results in partition order).
+class hash_join_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    hash_join_datum_stream_t(counted_t<datum_stream_t> _source,
+                             counted_t<datum_stream_t> _right,
+                             counted_t<func_t> _f,
+                             const std::string &_left_field,
+                             const std::string &_right_field,
+                             bool _outer);
+    ~hash_join_datum_stream_t();
+
+    virtual bool is_exhausted() const;
+
+private:
+    struct partition_t;
+
+    std::vector<counted_t<const datum_t> >
+    next_batch_impl(env_t *env, const batchspec_t &batchspec);
+
+    // Reads `right` into `rows`, or into partitions along with `*lefts` and the
+    // rest of `source` if it's too big.
+    void build(env_t *env, std::vector<counted_t<const datum_t> > *lefts);
+    void add_right(const counted_t<const datum_t> &row);
+    // The key `left` joins on, once there are right rows.
+    counted_t<const datum_t> left_key(env_t *env, const counted_t<const datum_t> &left);
+    void join(env_t *env, const counted_t<const datum_t> &left,
+              std::vector<counted_t<const datum_t> > *out);
+
+    const counted_t<datum_stream_t> right;
+    const counted_t<func_t> f;
+    const std::string left_field;
+    const std::string right_field;
+    const bool outer;
+
+    bool built;
+    // The first row of `right`, and the first one without `right_field`, which
+    // `f` gets called on to report the errors the nested loops would.
+    counted_t<const datum_t> first_right;
+    counted_t<const datum_t> bad_right;
+
+    // The rows of `right` (or of the current partition) by `right_field`.
+    std::unordered_map<counted_t<const datum_t>,
+                       std::vector<counted_t<const datum_t> >,
+                       datum_value_hash_t,
+                       datum_value_equal_t> rows;
+    size_t num_rows;
+
+    std::vector<scoped_ptr_t<partition_t> > partitions;
+    size_t partition_index;
 };
 
 // This class generates the `read_t`s used in range reads.  It's used by
@@ -316,12 +415,16 @@ public:
         env_t *env,
         const std::string &sindex,
         datum_range_t range = datum_range_t::universe(),
-        sorting_t sorting = sorting_t::UNORDERED);
+        sorting_t sorting = sorting_t::UNORDERED,
+        const boost::optional<geo_region_t> &geo_region = boost::none,
+        const std::vector<std::string> &text_words = std::vector<std::string>());
 private:
     sindex_readgen_t(
         const std::map<std::string, wire_func_t> &global_optargs,
         const std::string &sindex, datum_range_t sindex_range,
-        profile_bool_t profile, sorting_t sorting);
+        profile_bool_t profile, sorting_t sorting,
+        const boost::optional<geo_region_t> &geo_region,
+        const std::vector<std::string> &text_words);
     virtual rget_read_t next_read_impl(
         const key_range_t &active_range,
         const transform_t &transform,
@@ -336,6 +439,8 @@ private:
     virtual std::string sindex_name() const; // Used for error checking.
 
     const std::string sindex;
+    const boost::optional<geo_region_t> geo_region;
+    const std::vector<std::string> text_words;
 };
 
 class reader_t {
@@ -389,12 +494,16 @@ public:
                                          counted_t<func_t> m,
                                          counted_t<const datum_t> base,
                                          counted_t<func_t> r);
+    virtual bool top_k(env_t *env, const top_k_wire_func_t &f,
+                       std::vector<counted_t<const datum_t> > *out);
+    virtual bool sample(env_t *env, const sample_wire_func_t &f, reservoir_t *out);
     virtual bool is_array() { return false; }
     virtual counted_t<const datum_t> as_array(UNUSED env_t *env) {
         return counted_t<const datum_t>();  // Cannot be converted implicitly.
     }
 
     bool is_exhausted() const;
+    virtual bool reads_from_shards() const { return true; }
 private:
     std::vector<counted_t<const datum_t> >
     next_batch_impl(env_t *env, const batchspec_t &batchspec);
@@ -427,6 +536,34 @@ private:
     counted_t<const datum_t> arr;
 };
 
+// The changes that writes make to a table, from `table.changes()`.  It never runs
+// out, so it can only be read through a cursor.
+class changefeed_datum_stream_t : public eager_datum_stream_t {
+public:
+    changefeed_datum_stream_t(scoped_ptr_t<changefeed::subscription_t> &&_sub,
+                              const protob_t<const Backtrace> &bt_src);
+    virtual bool is_exhausted() const { return false; }
+
+private:
+    virtual bool is_array() { return false; }
+    virtual counted_t<const datum_t> as_array(UNUSED env_t *env) {
+        return counted_t<const datum_t>();
+    }
+    virtual counted_t<const datum_t> count(env_t *env);
+    virtual counted_t<const datum_t> reduce(env_t *env,
+                                            counted_t<val_t> base_val,
+                                            counted_t<func_t> f);
+    virtual counted_t<const datum_t> gmr(env_t *env,
+                                         counted_t<func_t> g,
+                                         counted_t<func_t> m,
+                                         counted_t<const datum_t> d,
+                                         counted_t<func_t> r);
+    virtual std::vector<counted_t<const datum_t> >
+    next_batch_impl(env_t *env, const batchspec_t &batchspec);
+
+    scoped_ptr_t<changefeed::subscription_t> sub;
+};
+
 class slice_datum_stream_t : public wrapper_datum_stream_t {
 public:
     slice_datum_stream_t(uint64_t left, uint64_t right, counted_t<datum_stream_t> src);
@@ -465,6 +602,64 @@ private:
     std::vector<counted_t<const datum_t> > data;
 };
 
+/* Sorts the whole of its source, for an order_by that can't use an index.  Nothing
+gets read until the first batch is asked for, so if the stream gets sliced (say by
+a `limit`) first, only the elements that can make it through the slice are kept,
+in a heap -- or, given `order` (the same order as `lt_cmp`) and a source that reads
+a table, just those elements get picked out by the shards.  Otherwise, if the
+source turns out to have more elements than the array
+size limit, sorted runs of them get spilled to disk (when the env_t allows it) and
+are merged as batches get read. */
+class sort_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    sort_datum_stream_t(
+        counted_t<datum_stream_t> stream,
+        std::function<bool(env_t *,  // NOLINT(readability/casting)
+                           profile::sampler_t *,
+                           const counted_t<const datum_t> &,
+                           const counted_t<const datum_t> &)> lt_cmp,
+        const boost::optional<order_wire_func_t> &order = boost::none);
+    ~sort_datum_stream_t();
+
+    virtual counted_t<datum_stream_t> slice(size_t l, size_t r);
+    virtual bool is_exhausted() const;
+
+private:
+    struct run_t;
+
+    virtual std::vector<counted_t<const datum_t> >
+    next_batch_impl(env_t *env, const batchspec_t &batchspec);
+
+    void read_source(env_t *env);
+    void read_source_into_heap(env_t *env, profile::sampler_t *sampler);
+    void sort_data(env_t *env, profile::sampler_t *sampler);
+    void spill(env_t *env, profile::sampler_t *sampler);
+    void merge_runs(env_t *env, profile::sampler_t *sampler, size_t begin, size_t end);
+    void start_merging(env_t *env, profile::sampler_t *sampler,
+                       size_t begin, size_t end);
+    bool pop_merged(env_t *env, profile::sampler_t *sampler,
+                    counted_t<const datum_t> *out);
+
+    std::function<bool(env_t *,  // NOLINT(readability/casting)
+                       profile::sampler_t *,
+                       const counted_t<const datum_t> &,
+                       const counted_t<const datum_t> &)> lt_cmp;
+    const boost::optional<order_wire_func_t> order;
+
+    // We only need to keep the `limit` smallest elements, if we've been sliced.
+    boost::optional<size_t> limit;
+    bool read_all;
+
+    // The sorted elements, if they all fit in memory.
+    std::vector<counted_t<const datum_t> > data;
+    size_t index;
+
+    // Otherwise, the sorted runs we merge, and the heap of them that's ordered by
+    // their smallest elements.
+    std::vector<scoped_ptr_t<run_t> > runs;
+    std::vector<run_t *> merge_heap;
+};
+
 class union_datum_stream_t : public datum_stream_t {
 public:
     union_datum_stream_t(const std::vector<counted_t<datum_stream_t> > &_streams,
@@ -494,9 +689,15 @@ public:
 private:
     std::vector<counted_t<const datum_t> >
     next_batch_impl(env_t *env, const batchspec_t &batchspec);
+    void read_concurrently(env_t *env, const batchspec_t &batchspec);
 
     std::vector<counted_t<datum_stream_t> > streams;
     size_t streams_index;
+
+    // Batches that streams reading from the shards got at the same time, which we
+    // hand out before asking any of them for more, so there's at most one per
+    // stream.
+    std::deque<std::vector<counted_t<const datum_t> > > read_batches;
 };
 
 } // namespace ql
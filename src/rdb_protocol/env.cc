@@ -1,13 +1,16 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/env.hpp"
 
+#include "arch/runtime/coroutines.hpp"
 #include "clustering/administration/database_metadata.hpp"
 #include "clustering/administration/metadata.hpp"
+#include "config/args.hpp"
 #include "extproc/js_runner.hpp"
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/term_walker.hpp"
+#include "thread_local.hpp"
 
 namespace ql {
 
@@ -98,6 +101,12 @@ void env_t::do_eval_callback() {
     }
 }
 
+int env_t::coro_priority() const {
+    return query_priority == QUERY_PRIORITY_BATCH
+        ? CORO_PRIORITY_BATCH_QUERY
+        : coro_t::self()->get_priority();
+}
+
 profile_bool_t env_t::profile() {
     return trace.has() ? profile_bool_t::PROFILE : profile_bool_t::DONT_PROFILE;
 }
@@ -159,6 +168,19 @@ js_runner_t *env_t::get_js_runner() {
     return &js_runner;
 }
 
+namespace {
+
+TLS_with_init(uint64_t, envs_created, 0);
+
+// Each thread counts its own envs, and the thread number keeps their ids apart.
+uint64_t new_env_id() {
+    const uint64_t n = TLS_get_envs_created();
+    TLS_set_envs_created(n + 1);
+    return n * (MAX_THREADS + 1) + (get_thread_id().threadnum + 1);
+}
+
+}  // namespace
+
 env_t::env_t(
     extproc_pool_t *_extproc_pool,
     base_namespace_repo_t<rdb_protocol_t> *_ns_repo,
@@ -177,6 +199,9 @@ env_t::env_t(
   : evals_since_yield(0),
     global_optargs(query),
     extproc_pool(_extproc_pool),
+    io_backender(NULL),
+    mailbox_manager(NULL),
+    id(new_env_id()),
     cluster_access(_ns_repo,
                    _namespaces_semilattice_metadata,
                    _databases_semilattice_metadata,
@@ -184,6 +209,8 @@ env_t::env_t(
                    _directory_read_manager,
                    _this_machine),
     interruptor(_interruptor),
+    trace_is_sampled(false),
+    query_priority(QUERY_PRIORITY_INTERACTIVE),
     eval_callback(NULL)
 {
     if (query.has()) {
@@ -192,6 +219,11 @@ env_t::env_t(
             profile_arg->as_bool()) {
             trace.init(new profile::trace_t());
         }
+        counted_t<const datum_t> priority_arg = static_optarg("priority", query);
+        if (priority_arg.has() && priority_arg->get_type() == datum_t::type_t::R_STR &&
+            priority_arg->as_str() == "batch") {
+            query_priority = QUERY_PRIORITY_BATCH;
+        }
     }
 }
 
@@ -213,6 +245,9 @@ env_t::env_t(
   : evals_since_yield(0),
     global_optargs(protob_t<Query>()),
     extproc_pool(_extproc_pool),
+    io_backender(NULL),
+    mailbox_manager(NULL),
+    id(new_env_id()),
     cluster_access(_ns_repo,
                    _namespaces_semilattice_metadata,
                    _databases_semilattice_metadata,
@@ -220,6 +255,8 @@ env_t::env_t(
                    _directory_read_manager,
                    _this_machine),
     interruptor(_interruptor),
+    trace_is_sampled(false),
+    query_priority(QUERY_PRIORITY_INTERACTIVE),
     eval_callback(NULL)
 {
     if (_profile == profile_bool_t::PROFILE) {
@@ -230,6 +267,9 @@ env_t::env_t(
 env_t::env_t(signal_t *_interruptor)
   : evals_since_yield(0),
     extproc_pool(NULL),
+    io_backender(NULL),
+    mailbox_manager(NULL),
+    id(new_env_id()),
     cluster_access(NULL,
                    clone_ptr_t<watchable_t<cow_ptr_t<ns_metadata_t> > >(),
                    clone_ptr_t<watchable_t<databases_semilattice_metadata_t> >(),
@@ -238,6 +278,8 @@ env_t::env_t(signal_t *_interruptor)
                    NULL,
                    uuid_u()),
     interruptor(_interruptor),
+    trace_is_sampled(false),
+    query_priority(QUERY_PRIORITY_INTERACTIVE),
     eval_callback(NULL)
 { }
 
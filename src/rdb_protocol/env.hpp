@@ -13,6 +13,8 @@
 #include "extproc/js_runner.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/regex_cache.hpp"
+#include "rdb_protocol/result_cache.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/val.hpp"
 
@@ -20,6 +22,7 @@ class extproc_pool_t;
 
 namespace ql {
 class datum_t;
+class plan_params_t;
 class term_t;
 
 /* If and optarg with the given key is present and is of type DATUM it will be
@@ -151,13 +154,52 @@ public:
     // js_runner_t.
     extproc_pool_t *extproc_pool;
 
+    // What a query spills data that doesn't fit in memory with, and where it puts
+    // it.  If `io_backender` is NULL, the query can't spill, and fails once the
+    // data gets bigger than the array size limit.
+    io_backender_t *io_backender;
+    boost::optional<base_path_t> spill_path;
+
+    // What a change feed gets the changes from the stores with.  If it's NULL, the
+    // query can't use change feeds.
+    mailbox_manager_t *mailbox_manager;
+
+    // Different for every env there has been, so that terms can keep values for
+    // the env that's evaluating them (see `folded_term_t`).
+    const uint64_t id;
+
+    // The values of the query's plan parameters (see `plan_cache_t`).  Its compiled
+    // term tree can be shared with other queries of the same shape, so it reads
+    // them from here.
+    std::vector<counted_t<const datum_t> > plan_params;
+
+    // The regexes that `match` has compiled for the query.
+    regex_cache_t regex_cache;
+
+    // Set while the query's result might get cached (see `result_cache_t`), to
+    // collect the versions of the tables it reads.
+    scoped_ptr_t<table_versions_t> table_versions;
+
     // Access to the cluster, for talking over the cluster or about the cluster.
     cluster_access_t cluster_access;
 
+    // Set, with the table's current shard map, when the query fails because the
+    // client routed it by an older one (see `check_shard_map_version`).
+    counted_t<const datum_t> stale_shard_map;
+
     // The interruptor signal while a query evaluates.  This can get overwritten!
     signal_t *interruptor;
 
     scoped_ptr_t<profile::trace_t> trace;
+    // True if `trace` is only there because the server sampled the query for its
+    // query trace log, in which case the client doesn't get it.
+    bool trace_is_sampled;
+
+    // Set by the `priority` optarg; the query's reads and writes carry it to the
+    // shards, and batch queries run at a lower coroutine priority.
+    query_priority_t query_priority;
+    // The coroutine priority to evaluate the query at.
+    int coro_priority() const;
 
     profile_bool_t profile();
 
@@ -174,8 +216,11 @@ private:
 class compile_env_t {
 public:
     explicit compile_env_t(var_visibility_t &&_visibility)
-        : visibility(std::move(_visibility)) { }
+        : visibility(std::move(_visibility)), plan_params(NULL) { }
     var_visibility_t visibility;
+    // The literals to compile as plan parameters, or NULL.  (Function bodies get
+    // their own compile_env_t, without any.)
+    plan_params_t *plan_params;
 };
 
 // This is an environment for evaluating things that use variables in scope.  It
@@ -23,7 +23,11 @@ public:
 
         // The only thing that cares about these is `default`.
         EMPTY_USER, // An error caused by `r.error` with no arguments.
-        NON_EXISTENCE // An error related to the absence of an expected value.
+        NON_EXISTENCE, // An error related to the absence of an expected value.
+
+        // The query was routed by a stale shard map (see
+        // `check_shard_map_version`).
+        STALE_SHARD_MAP
     };
     explicit base_exc_t(type_t type) : type_(type) { }
     virtual ~base_exc_t() throw () { }
@@ -32,7 +36,7 @@ protected:
     type_t type_;
 };
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
-    base_exc_t::type_t, int8_t, base_exc_t::GENERIC, base_exc_t::NON_EXISTENCE);
+    base_exc_t::type_t, int8_t, base_exc_t::GENERIC, base_exc_t::STALE_SHARD_MAP);
 
 // NOTE: you usually want to inherit from `rcheckable_t` instead of calling this
 // directly.
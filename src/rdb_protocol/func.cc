@@ -1,5 +1,10 @@
 #include "rdb_protocol/func.hpp"
 
+#include <algorithm>
+#include <exception>
+
+#include "concurrency/pmap.hpp"
+#include "config/args.hpp"
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/minidriver.hpp"
@@ -10,6 +15,82 @@
 
 namespace ql {
 
+namespace {
+
+// The fields of a row we already have.
+class datum_row_fields_t : public row_fields_t {
+public:
+    explicit datum_row_fields_t(const counted_t<const datum_t> &_row) : row(_row) { }
+    bool get_field(const std::string &key, counted_t<const datum_t> *out) const {
+        *out = row->get(key, NOTHROW);
+        return true;
+    }
+private:
+    const counted_t<const datum_t> &row;
+};
+
+// Whether `t` can be evaluated by several calls at once: it doesn't write, wait
+// for something, or use the query's JavaScript runner.  Sets `*reads_tables` if it
+// reads a table.
+bool overlappable_term(const Term &t, bool *reads_tables) {
+    switch (t.type()) {
+    case Term::TABLE:
+        *reads_tables = true;
+        break;
+    case Term::JAVASCRIPT:
+    case Term::INSERT:
+    case Term::UPDATE:
+    case Term::DELETE:
+    case Term::REPLACE:
+    case Term::FOREACH:
+    case Term::SYNC:
+    case Term::CHANGES:
+    case Term::DB_CREATE:
+    case Term::DB_DROP:
+    case Term::TABLE_CREATE:
+    case Term::TABLE_DROP:
+    case Term::INDEX_CREATE:
+    case Term::INDEX_DROP:
+    case Term::INDEX_WAIT:
+        return false;
+    default:
+        break;
+    }
+    for (int i = 0; i < t.args_size(); ++i) {
+        if (!overlappable_term(t.args(i), reads_tables)) {
+            return false;
+        }
+    }
+    for (int i = 0; i < t.optargs_size(); ++i) {
+        if (!overlappable_term(t.optargs(i).val(), reads_tables)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+void overlap_calls(env_t *env, size_t count, const std::function<void(size_t)> &fn) {
+    const size_t window = env->trace.has() ? 1 : FUNC_MAX_OVERLAPPING_CALLS;
+    std::vector<std::exception_ptr> exceptions(std::min(count, window));
+    for (size_t begin = 0; begin < count; begin += window) {
+        const size_t end = std::min(count, begin + window);
+        pmap(end - begin, [&](int64_t j) {
+            try {
+                fn(begin + j);
+            } catch (const std::exception &) {
+                exceptions[j] = std::current_exception();
+            }
+        });
+        for (size_t j = 0; j < end - begin; ++j) {
+            if (exceptions[j] != std::exception_ptr()) {
+                std::rethrow_exception(exceptions[j]);
+            }
+        }
+    }
+}
+
 func_t::func_t(const protob_t<const Backtrace> &bt_source)
   : pb_rcheckable_t(bt_source) { }
 func_t::~func_t() { }
@@ -32,6 +113,107 @@ counted_t<val_t> func_t::call(env_t *env,
     return call(env, make_vector(arg1, arg2), eval_flags);
 }
 
+void func_t::map_batch(env_t *env, std::vector<counted_t<const datum_t> > *data) const {
+    if (data->size() > 1 && can_overlap_calls()) {
+        overlap_calls(env, data->size(), [&](size_t i) {
+            (*data)[i] = call(env, (*data)[i])->as_datum();
+        });
+        return;
+    }
+    std::vector<counted_t<const datum_t> > batch_results;
+    const bool batched = batch_call(env, *data, &batch_results);
+    for (size_t i = 0; i < data->size(); ++i) {
+        env->throw_if_interruptor_pulsed();
+        env->maybe_yield();
+        counted_t<const datum_t> result;
+        bool evaluated;
+        if (batched) {
+            result = std::move(batch_results[i]);
+            evaluated = result.has();
+        } else {
+            try {
+                evaluated = fast_call((*data)[i], &result);
+            } catch (const base_exc_t &) {
+                evaluated = false;
+            }
+        }
+        (*data)[i] = evaluated ? std::move(result) : call(env, (*data)[i])->as_datum();
+    }
+}
+
+void func_t::filter_batch(env_t *env,
+                          std::vector<counted_t<const datum_t> > *data,
+                          counted_t<func_t> default_filter_val) const {
+    std::vector<counted_t<const datum_t> > batch_results;
+    const bool batched = batch_call(env, *data, &batch_results);
+    auto kept = data->begin();
+    for (size_t i = 0; i < data->size(); ++i) {
+        env->throw_if_interruptor_pulsed();
+        env->maybe_yield();
+        const counted_t<const datum_t> &row = (*data)[i];
+        bool keep = false;
+        bool evaluated;
+        if (batched) {
+            evaluated = batch_results[i].has();
+            if (evaluated) {
+                keep = batch_results[i]->as_bool();
+            }
+        } else {
+            evaluated = row->get_type() == datum_t::R_OBJECT
+                && prefilter(datum_row_fields_t(row), &keep);
+        }
+        if (!evaluated) {
+            keep = filter_call(env, row, default_filter_val);
+        }
+        if (keep) {
+            *kept = std::move((*data)[i]);
+            ++kept;
+        }
+    }
+    data->erase(kept, data->end());
+}
+
+bool func_t::prefilter(const row_fields_t &row, bool *out) const {
+    try {
+        return fast_filter(row, out);
+    } catch (const base_exc_t &) {
+        return false;
+    }
+}
+
+bool func_t::call_on_fields(const row_fields_t &row,
+                            counted_t<const datum_t> *out) const {
+    try {
+        return fast_call_on_fields(row, out);
+    } catch (const base_exc_t &) {
+        return false;
+    }
+}
+
+bool func_t::fast_call(UNUSED const counted_t<const datum_t> &arg,
+                       UNUSED counted_t<const datum_t> *out) const {
+    return false;
+}
+
+bool func_t::fast_filter(UNUSED const row_fields_t &row, UNUSED bool *out) const {
+    return false;
+}
+
+bool func_t::fast_call_on_fields(UNUSED const row_fields_t &row,
+                                 UNUSED counted_t<const datum_t> *out) const {
+    return false;
+}
+
+bool func_t::can_overlap_calls() const {
+    return false;
+}
+
+bool func_t::batch_call(UNUSED env_t *env,
+                        UNUSED const std::vector<counted_t<const datum_t> > &data,
+                        UNUSED std::vector<counted_t<const datum_t> > *out) const {
+    return false;
+}
+
 void func_t::assert_deterministic(const char *extra_msg) const {
     rcheck(is_deterministic(),
            base_exc_t::GENERIC,
@@ -43,7 +225,97 @@ reql_func_t::reql_func_t(const protob_t<const Backtrace> backtrace,
                          std::vector<sym_t> _arg_names,
                          counted_t<term_t> _body)
     : func_t(backtrace), captured_scope(_captured_scope),
-      arg_names(std::move(_arg_names)), body(std::move(_body)) { }
+      arg_names(std::move(_arg_names)), body(std::move(_body)),
+      shape(shape_t::GENERIC), comparison(NULL), invert_comparison(false),
+      overlappable(false) {
+    init_shape();
+    bool reads_tables = false;
+    overlappable = overlappable_term(*body->get_src(), &reads_tables) && reads_tables;
+}
+
+void reql_func_t::init_shape() {
+    const Term &t = *body->get_src();
+    // Calls with the wrong number of arguments are errors, which `call` reports.
+    if (arg_names.size() > 1) {
+        return;
+    }
+    if (t.type() == Term::DATUM) {
+        shape = shape_t::CONSTANT;
+        constant = make_counted<const datum_t>(&t.datum());
+        return;
+    }
+
+    std::string field;
+    if (is_field_of_arg(t, &field)) {
+        shape = shape_t::FIELD;
+        fields.push_back(field);
+        return;
+    }
+
+    // `pluck` on a sequence maps it with `pluck` and `_NO_RECURSE_`, which doesn't
+    // matter for an object.
+    if ((t.type() == Term::HAS_FIELDS && t.optargs_size() == 0)
+        || (t.type() == Term::PLUCK && t.optargs_size() <= 1)) {
+        if (t.args_size() < 2 || !is_arg(t.args(0))) {
+            return;
+        }
+        if (t.optargs_size() == 1 && t.optargs(0).key() != "_NO_RECURSE_") {
+            return;
+        }
+        for (int i = 1; i < t.args_size(); ++i) {
+            if (t.args(i).type() != Term::DATUM
+                || t.args(i).datum().type() != Datum::R_STR) {
+                fields.clear();
+                return;
+            }
+            fields.push_back(t.args(i).datum().r_str());
+        }
+        shape = t.type() == Term::PLUCK ? shape_t::PLUCK : shape_t::HAS_FIELDS;
+        return;
+    }
+
+    if (t.args_size() != 2 || t.optargs_size() != 0
+        || t.args(1).type() != Term::DATUM
+        || !is_field_of_arg(t.args(0), &field)) {
+        return;
+    }
+    // These are the same as in predicate_term_t.
+    switch (t.type()) {
+    case Term::EQ: comparison = &datum_t::operator==; break; // NOLINT
+    case Term::NE:
+        comparison = &datum_t::operator==; // NOLINT
+        invert_comparison = true;
+        break;
+    case Term::LT: comparison = &datum_t::operator<; break; // NOLINT
+    case Term::LE: comparison = &datum_t::operator<=; break; // NOLINT
+    case Term::GT: comparison = &datum_t::operator>; break; // NOLINT
+    case Term::GE: comparison = &datum_t::operator>=; break; // NOLINT
+    default: return;
+    }
+    shape = shape_t::COMPARISON;
+    fields.push_back(field);
+    constant = make_counted<const datum_t>(&t.args(1).datum());
+}
+
+bool reql_func_t::is_arg(const Term &t) const {
+    if (t.type() == Term::IMPLICIT_VAR) {
+        return function_emits_implicit_variable(arg_names);
+    }
+    return t.type() == Term::VAR && arg_names.size() == 1
+        && t.args_size() == 1 && t.args(0).type() == Term::DATUM
+        && t.args(0).datum().type() == Datum::R_NUM
+        && t.args(0).datum().r_num() == static_cast<double>(arg_names[0].value);
+}
+
+bool reql_func_t::is_field_of_arg(const Term &t, std::string *field_out) const {
+    if (t.type() != Term::GET_FIELD || t.args_size() != 2 || t.optargs_size() != 0
+        || !is_arg(t.args(0)) || t.args(1).type() != Term::DATUM
+        || t.args(1).datum().type() != Datum::R_STR) {
+        return false;
+    }
+    *field_out = t.args(1).datum().r_str();
+    return true;
+}
 
 reql_func_t::~reql_func_t() { }
 
@@ -77,6 +349,10 @@ bool reql_func_t::is_deterministic() const {
     return body->is_deterministic();
 }
 
+bool reql_func_t::can_overlap_calls() const {
+    return overlappable;
+}
+
 js_func_t::js_func_t(const std::string &_js_source,
                      uint64_t timeout_ms,
                      protob_t<const Backtrace> backtrace)
@@ -118,6 +394,43 @@ counted_t<val_t> js_func_t::call(
     }
 }
 
+bool js_func_t::batch_call(env_t *env,
+                           const std::vector<counted_t<const datum_t> > &data,
+                           std::vector<counted_t<const datum_t> > *out) const {
+    if (data.size() < 2) {
+        return false;
+    }
+    r_sanity_check(!js_source.empty());
+
+    js_runner_t::req_config_t config;
+    config.timeout_ms = js_timeout_ms;
+
+    std::vector<std::vector<counted_t<const datum_t> > > args_batch;
+    args_batch.reserve(data.size());
+    for (auto it = data.begin(); it != data.end(); ++it) {
+        args_batch.push_back(make_vector(*it));
+    }
+
+    std::vector<js_result_t> results;
+    try {
+        results = env->get_js_runner()->call_batch(js_source, args_batch, config);
+    } catch (const js_worker_exc_t &e) {
+        // Calling them one at a time gives the right error for the call that
+        // crashed or timed out.
+        return false;
+    } catch (const interrupted_exc_t &e) {
+        return false;
+    }
+
+    out->clear();
+    out->reserve(results.size());
+    for (auto it = results.begin(); it != results.end(); ++it) {
+        counted_t<const datum_t> *datum = boost::get<counted_t<const datum_t> >(&*it);
+        out->push_back(datum != NULL ? *datum : counted_t<const datum_t>());
+    }
+    return true;
+}
+
 bool js_func_t::is_deterministic() const {
     return false;
 }
@@ -223,7 +536,7 @@ bool filter_match(counted_t<const datum_t> predicate, counted_t<const datum_t> v
     if (predicate->is_ptype(pseudo::literal_string)) {
         return *predicate->get(pseudo::value_key) == *value;
     } else {
-        const std::map<std::string, counted_t<const datum_t> > &obj = predicate->as_object();
+        const datum_object_t &obj = predicate->as_object();
         for (auto it = obj.begin(); it != obj.end(); ++it) {
             r_sanity_check(it->second.has());
             counted_t<const datum_t> elt = value->get(it->first, NOTHROW);
@@ -252,6 +565,116 @@ bool reql_func_t::filter_helper(env_t *env, counted_t<const datum_t> arg) const
     }
 }
 
+bool reql_func_t::fast_call(const counted_t<const datum_t> &arg,
+                            counted_t<const datum_t> *out) const {
+    if (shape == shape_t::CONSTANT) {
+        *out = constant;
+        return true;
+    }
+    if (shape == shape_t::GENERIC || arg->get_type() != datum_t::R_OBJECT) {
+        return false;
+    }
+    return eval_shape(datum_row_fields_t(arg), out);
+}
+
+bool reql_func_t::eval_shape(const row_fields_t &row,
+                             counted_t<const datum_t> *out) const {
+    switch (shape) {
+    case shape_t::CONSTANT:
+        *out = constant;
+        return true;
+    case shape_t::HAS_FIELDS: {
+        // The same as `contains`.
+        bool result = true;
+        for (auto it = fields.begin(); it != fields.end(); ++it) {
+            counted_t<const datum_t> value;
+            if (!row.get_field(*it, &value)) {
+                return false;
+            }
+            if (!value.has() || value->get_type() == datum_t::R_NULL) {
+                result = false;
+                break;
+            }
+        }
+        *out = make_counted<const datum_t>(datum_t::R_BOOL, result);
+        return true;
+    }
+    case shape_t::PLUCK: {
+        // The same as `project` with string paths.
+        datum_ptr_t result(datum_t::R_OBJECT);
+        for (auto it = fields.begin(); it != fields.end(); ++it) {
+            counted_t<const datum_t> value;
+            if (!row.get_field(*it, &value)) {
+                return false;
+            }
+            if (value.has()) {
+                UNUSED bool b = result.add(*it, value, CLOBBER);
+            }
+        }
+        *out = result.to_counted();
+        return true;
+    }
+    case shape_t::FIELD: // fallthru
+    case shape_t::COMPARISON: {
+        // A missing field is an error, which we leave to the interpreter to report.
+        counted_t<const datum_t> value;
+        if (!row.get_field(fields[0], &value) || !value.has()) {
+            return false;
+        }
+        if (shape == shape_t::FIELD) {
+            *out = value;
+        } else {
+            const bool result
+                = (value.get()->*comparison)(*constant) != invert_comparison;
+            *out = make_counted<const datum_t>(datum_t::R_BOOL, result);
+        }
+        return true;
+    }
+    case shape_t::GENERIC: return false;
+    default: unreachable();
+    }
+}
+
+bool reql_func_t::fast_call_on_fields(const row_fields_t &row,
+                                      counted_t<const datum_t> *out) const {
+    return eval_shape(row, out);
+}
+
+bool reql_func_t::fast_filter(const row_fields_t &row, bool *out) const {
+    // The same as `filter_helper`, and `filter_match` for an object.
+    if (shape == shape_t::CONSTANT && constant->get_type() == datum_t::R_OBJECT) {
+        if (constant->is_ptype()) {
+            return false;
+        }
+        const datum_object_t &obj = constant->as_object();
+        for (auto it = obj.begin(); it != obj.end(); ++it) {
+            counted_t<const datum_t> elt;
+            if (!row.get_field(it->first, &elt) || !elt.has()) {
+                return false;
+            }
+            if (it->second->get_type() == datum_t::R_OBJECT
+                && elt->get_type() == datum_t::R_OBJECT) {
+                if (!filter_match(it->second, elt, this)) {
+                    *out = false;
+                    return true;
+                }
+            } else if (*elt != *it->second) {
+                *out = false;
+                return true;
+            }
+        }
+        *out = true;
+        return true;
+    }
+
+    counted_t<const datum_t> d;
+    if (!eval_shape(row, &d)) {
+        return false;
+    }
+    *out = d->as_bool();
+    return true;
+}
+
 std::string reql_func_t::print_source() const {
     std::string ret = "function (captures = " + captured_scope.print() + ") (args = [";
     for (size_t i = 0; i < arg_names.size(); ++i) {
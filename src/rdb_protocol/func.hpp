@@ -2,6 +2,7 @@
 #ifndef RDB_PROTOCOL_FUNC_HPP_
 #define RDB_PROTOCOL_FUNC_HPP_
 
+#include <functional>
 #include <map>
 #include <string>
 #include <utility>
@@ -24,6 +25,21 @@ namespace ql {
 
 class func_visitor_t;
 
+// The top-level fields of a row that's an object, for `func_t::prefilter` to read
+// one at a time, so that they can come straight off a stored document.
+class row_fields_t {
+public:
+    // Sets `*out` to the field `key`, or empties it if there isn't one.  Returns
+    // false if the field can't be read this way.
+    virtual bool get_field(const std::string &key,
+                           counted_t<const datum_t> *out) const = 0;
+protected:
+    row_fields_t() { }
+    virtual ~row_fields_t() { }
+private:
+    DISABLE_COPYING(row_fields_t);
+};
+
 class func_t : public slow_atomic_countable_t<func_t>, public pb_rcheckable_t {
 public:
     virtual ~func_t();
@@ -46,6 +62,28 @@ public:
                      counted_t<const datum_t> arg,
                      counted_t<func_t> default_filter_val) const;
 
+    // These do the same as `call` or `filter_call` on each element of `data`, in
+    // place, but functions of a few common shapes (see `reql_func_t`) get evaluated
+    // without going through the interpreter for each element.
+    void map_batch(env_t *env, std::vector<counted_t<const datum_t> > *data) const;
+    void filter_batch(env_t *env,
+                      std::vector<counted_t<const datum_t> > *data,
+                      counted_t<func_t> default_filter_val) const;
+
+    // Tells what `filter_call` would for an object row, looking only at the
+    // fields it needs through `row`.  Returns false if it can't: the function
+    // isn't of one of those shapes, a field can't be read, or evaluating it
+    // would be an error (which `filter_call` handles).
+    bool prefilter(const row_fields_t &row, bool *out) const;
+
+    // Likewise tells what `call` would for an object row, from just the fields it
+    // needs.
+    bool call_on_fields(const row_fields_t &row, counted_t<const datum_t> *out) const;
+
+    // Whether the function reads tables and does nothing else that calls running
+    // at the same time could get in each other's way with (see `overlap_calls`).
+    virtual bool can_overlap_calls() const;
+
     // These are simple, they call the vector version of call.
     counted_t<val_t> call(env_t *env, eval_flags_t eval_flags = NO_FLAGS) const;
     counted_t<val_t> call(env_t *env,
@@ -62,6 +100,22 @@ protected:
 private:
     virtual bool filter_helper(env_t *env, counted_t<const datum_t> arg) const = 0;
 
+    // Evaluate the function directly, if they can.  (They can throw, in which
+    // case the caller goes through `call` or `filter_call` instead, to get the
+    // usual error.)
+    virtual bool fast_call(const counted_t<const datum_t> &arg,
+                           counted_t<const datum_t> *out) const;
+    virtual bool fast_filter(const row_fields_t &row, bool *out) const;
+    virtual bool fast_call_on_fields(const row_fields_t &row,
+                                     counted_t<const datum_t> *out) const;
+
+    // Evaluates the function on every element of `data` at once, if it can,
+    // putting the results in `out`.  An empty result means that element has to
+    // go through `call` or `filter_call` instead (to get the usual error).
+    virtual bool batch_call(env_t *env,
+                            const std::vector<counted_t<const datum_t> > &data,
+                            std::vector<counted_t<const datum_t> > *out) const;
+
     DISABLE_COPYING(func_t);
 };
 
@@ -78,6 +132,7 @@ public:
         const std::vector<counted_t<const datum_t> > &args,
         eval_flags_t eval_flags) const;
     bool is_deterministic() const;
+    bool can_overlap_calls() const;
 
     std::string print_source() const;
 
@@ -87,6 +142,17 @@ private:
     friend class wire_func_serialization_visitor_t;
     bool filter_helper(env_t *env, counted_t<const datum_t> arg) const;
 
+    bool fast_call(const counted_t<const datum_t> &arg,
+                   counted_t<const datum_t> *out) const;
+    bool fast_filter(const row_fields_t &row, bool *out) const;
+    bool fast_call_on_fields(const row_fields_t &row,
+                             counted_t<const datum_t> *out) const;
+    bool eval_shape(const row_fields_t &row, counted_t<const datum_t> *out) const;
+
+    void init_shape();
+    bool is_arg(const Term &t) const;
+    bool is_field_of_arg(const Term &t, std::string *field_out) const;
+
     // Only contains the parts of the scope that `body` uses.
     var_scope_t captured_scope;
 
@@ -96,6 +162,20 @@ private:
     // The body of the function, which gets ->eval(...) called when call(...) is called.
     counted_t<term_t> body;
 
+    // The shapes of `body` that `fast_call` evaluates directly: a constant, like
+    // `filter`'s object shortcut; a field of the argument, like `r.row('a')`; a
+    // comparison of a field of the argument with a constant, like
+    // `r.row('a').eq(5)`; or `r.row.hasFields(...)` or `r.row.pluck(...)` with just
+    // field names.
+    enum class shape_t { GENERIC, CONSTANT, FIELD, COMPARISON, HAS_FIELDS, PLUCK };
+    shape_t shape;
+    std::vector<std::string> fields;
+    counted_t<const datum_t> constant;
+    bool (datum_t::*comparison)(const datum_t &rhs) const;
+    bool invert_comparison;
+
+    bool overlappable;
+
     DISABLE_COPYING(reql_func_t);
 };
 
@@ -122,6 +202,11 @@ private:
     friend class wire_func_serialization_visitor_t;
     bool filter_helper(env_t *env, counted_t<const datum_t> arg) const;
 
+    // Makes all the calls in one round trip to the worker process.
+    bool batch_call(env_t *env,
+                    const std::vector<counted_t<const datum_t> > &data,
+                    std::vector<counted_t<const datum_t> > *out) const;
+
     std::string js_source;
     uint64_t js_timeout_ms;
 
@@ -153,6 +238,13 @@ counted_t<func_t> new_get_field_func(counted_t<const datum_t> obj,
 counted_t<func_t> new_eq_comparison_func(counted_t<const datum_t> obj,
                                          const protob_t<const Backtrace> &bt_src);
 
+// Runs `fn(i)` for each `i` below `count`, in coroutines up to
+// FUNC_MAX_OVERLAPPING_CALLS at a time, so that calls of a function that reads
+// tables wait for their reads together.  If any throw, the exception of the first
+// (by `i`) gets rethrown once they're done.  They run one at a time if the query
+// is being profiled, so that the trace's events don't get mixed up.
+void overlap_calls(env_t *env, size_t count, const std::function<void(size_t)> &fn);
+
 
 class js_result_visitor_t : public boost::static_visitor<counted_t<val_t> > {
 public:
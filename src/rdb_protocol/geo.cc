@@ -0,0 +1,190 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/geo.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+
+namespace ql {
+
+// The mean radius of the Earth.
+static const double EARTH_RADIUS_M = 6371008.8;
+
+static const char *const GEOHASH_ALPHABET = "0123456789bcdefghjkmnpqrstuvwxyz";
+
+static double radians(double degrees) {
+    return degrees * M_PI / 180;
+}
+
+static double degrees(double radians) {
+    return radians * 180 / M_PI;
+}
+
+geo_point_t geo_point_from_datum(const counted_t<const datum_t> &datum) {
+    rcheck_datum(datum->get_type() == datum_t::R_OBJECT, base_exc_t::GENERIC,
+                 strprintf("Expected a point (an object with `lat` and `lon` fields) "
+                           "but found %s.", datum->trunc_print().c_str()));
+    const double lat = datum->get("lat")->as_num();
+    const double lon = datum->get("lon")->as_num();
+    rcheck_datum(lat >= -90 && lat <= 90, base_exc_t::GENERIC,
+                 strprintf("Latitude `%g` is not between -90 and 90.", lat));
+    rcheck_datum(lon >= -180 && lon <= 180, base_exc_t::GENERIC,
+                 strprintf("Longitude `%g` is not between -180 and 180.", lon));
+    return geo_point_t(lat, lon);
+}
+
+std::string geohash_encode(const geo_point_t &point, size_t precision) {
+    double lat_low = -90, lat_high = 90;
+    double lon_low = -180, lon_high = 180;
+    std::string res;
+    res.reserve(precision);
+    // The bits alternate between longitude and latitude, starting with longitude.
+    bool lon_bit = true;
+    while (res.size() < precision) {
+        int index = 0;
+        for (int bit = 0; bit < 5; ++bit) {
+            double *low = lon_bit ? &lon_low : &lat_low;
+            double *high = lon_bit ? &lon_high : &lat_high;
+            const double value = lon_bit ? point.lon : point.lat;
+            const double mid = (*low + *high) / 2;
+            index <<= 1;
+            if (value >= mid) {
+                index |= 1;
+                *low = mid;
+            } else {
+                *high = mid;
+            }
+            lon_bit = !lon_bit;
+        }
+        res.push_back(GEOHASH_ALPHABET[index]);
+    }
+    return res;
+}
+
+double geo_distance(const geo_point_t &a, const geo_point_t &b) {
+    // The haversine formula
+    const double dlat = radians(b.lat - a.lat);
+    const double dlon = radians(b.lon - a.lon);
+    const double h = sin(dlat / 2) * sin(dlat / 2)
+        + cos(radians(a.lat)) * cos(radians(b.lat)) * sin(dlon / 2) * sin(dlon / 2);
+    return 2 * EARTH_RADIUS_M * asin(std::min(1.0, sqrt(h)));
+}
+
+geo_region_t::geo_region_t() : is_circle(false), radius_m(0) { }
+
+geo_region_t geo_region_t::box(const geo_point_t &corner1, const geo_point_t &corner2) {
+    geo_region_t res;
+    res.low = geo_point_t(std::min(corner1.lat, corner2.lat),
+                          std::min(corner1.lon, corner2.lon));
+    res.high = geo_point_t(std::max(corner1.lat, corner2.lat),
+                           std::max(corner1.lon, corner2.lon));
+    return res;
+}
+
+geo_region_t geo_region_t::circle(const geo_point_t &center, double radius_m) {
+    geo_region_t res;
+    res.is_circle = true;
+    res.center = center;
+    res.radius_m = radius_m;
+
+    const double angle = radius_m / EARTH_RADIUS_M;
+    const double dlat = degrees(angle);
+    res.low.lat = std::max(-90.0, center.lat - dlat);
+    res.high.lat = std::min(90.0, center.lat + dlat);
+    const double cos_lat = cos(radians(center.lat));
+    if (res.low.lat == -90 || res.high.lat == 90 || angle >= M_PI / 2
+        || sin(angle) >= cos_lat) {
+        res.low.lon = -180;
+        res.high.lon = 180;
+    } else {
+        const double dlon = degrees(asin(sin(angle) / cos_lat));
+        res.low.lon = center.lon - dlon;
+        res.high.lon = center.lon + dlon;
+    }
+    return res;
+}
+
+bool geo_region_t::contains(const geo_point_t &point) const {
+    if (is_circle) {
+        return geo_distance(center, point) <= radius_m;
+    }
+    return low.lat <= point.lat && point.lat <= high.lat
+        && low.lon <= point.lon && point.lon <= high.lon;
+}
+
+// The cell of a grid with `count` cells across `extent` that `value` is in.
+static int64_t cell_of(double value, double extent, int64_t count) {
+    const int64_t res = static_cast<int64_t>(floor(value / extent * count));
+    return std::max<int64_t>(0, std::min<int64_t>(count - 1, res));
+}
+
+std::vector<std::string> geo_region_t::covering_cells() const {
+    // The longitude ranges of the bounding box, split at the antimeridian.
+    std::vector<std::pair<double, double> > lon_ranges;
+    if (high.lon - low.lon >= 360) {
+        lon_ranges.push_back(std::make_pair(-180.0, 180.0));
+    } else if (low.lon < -180) {
+        lon_ranges.push_back(std::make_pair(low.lon + 360, 180.0));
+        lon_ranges.push_back(std::make_pair(-180.0, high.lon));
+    } else if (high.lon > 180) {
+        lon_ranges.push_back(std::make_pair(low.lon, 180.0));
+        lon_ranges.push_back(std::make_pair(-180.0, high.lon - 360));
+    } else {
+        lon_ranges.push_back(std::make_pair(low.lon, high.lon));
+    }
+
+    // Geohashes of `precision` characters split longitude into
+    // 2^ceil(5 * precision / 2) columns and latitude into 2^floor(5 * precision / 2)
+    // rows.  Past the precision with too many cells, there are only more of them.
+    size_t precision = 0;
+    for (size_t p = 1; p <= GEOHASH_PRECISION; ++p) {
+        const int64_t columns = int64_t(1) << ((5 * p + 1) / 2);
+        const int64_t rows = int64_t(1) << (5 * p / 2);
+        const int64_t row_count = cell_of(high.lat + 90, 180, rows)
+            - cell_of(low.lat + 90, 180, rows) + 1;
+        int64_t cells = 0;
+        for (auto it = lon_ranges.begin(); it != lon_ranges.end(); ++it) {
+            cells += row_count * (cell_of(it->second + 180, 360, columns)
+                                  - cell_of(it->first + 180, 360, columns) + 1);
+        }
+        if (cells > GEO_MAX_COVERING_CELLS) {
+            break;
+        }
+        precision = p;
+    }
+
+    std::vector<std::string> res;
+    if (precision == 0) {
+        // The region needs more than GEO_MAX_COVERING_CELLS of even the largest cells,
+        // so we read the whole index.
+        res.push_back("");
+        return res;
+    }
+
+    const int64_t columns = int64_t(1) << ((5 * precision + 1) / 2);
+    const int64_t rows = int64_t(1) << (5 * precision / 2);
+    const double column_width = 360.0 / columns;
+    const double row_height = 180.0 / rows;
+    const int64_t first_row = cell_of(low.lat + 90, 180, rows);
+    const int64_t last_row = cell_of(high.lat + 90, 180, rows);
+    for (auto it = lon_ranges.begin(); it != lon_ranges.end(); ++it) {
+        const int64_t first_column = cell_of(it->first + 180, 360, columns);
+        const int64_t last_column = cell_of(it->second + 180, 360, columns);
+        for (int64_t row = first_row; row <= last_row; ++row) {
+            for (int64_t column = first_column; column <= last_column; ++column) {
+                // Each cell is named by the geohash of any point in it, like its
+                // center.
+                const geo_point_t cell_center(-90 + (row + 0.5) * row_height,
+                                              -180 + (column + 0.5) * column_width);
+                res.push_back(geohash_encode(cell_center, precision));
+            }
+        }
+    }
+    return res;
+}
+
+}  // namespace ql
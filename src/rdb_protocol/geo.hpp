@@ -0,0 +1,72 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_GEO_HPP_
+#define RDB_PROTOCOL_GEO_HPP_
+
+#include <string>
+#include <vector>
+
+#include "config/args.hpp"
+#include "containers/archive/archive.hpp"
+#include "containers/counted.hpp"
+#include "rpc/serialize_macros.hpp"
+
+namespace ql {
+class datum_t;
+
+/* A geo index (`index_create(..., {geo: true})`) maps each row to a point -- an
+object with numeric `lat` and `lon` fields, in degrees -- or to an array of them, and
+indexes each point under its geohash.  Each character of a geohash splits the cell
+named by the ones before it 32 ways, so the points in a cell are a range of the
+index, and any region is covered by the ranges of a few cells. */
+
+struct geo_point_t {
+    geo_point_t() : lat(0), lon(0) { }
+    geo_point_t(double _lat, double _lon) : lat(_lat), lon(_lon) { }
+
+    double lat;
+    double lon;
+
+    RDB_MAKE_ME_SERIALIZABLE_2(lat, lon);
+};
+
+// Throws if `datum` isn't a point.
+geo_point_t geo_point_from_datum(const counted_t<const datum_t> &datum);
+
+// The first `precision` characters of `point`'s geohash.
+std::string geohash_encode(const geo_point_t &point,
+                           size_t precision = GEOHASH_PRECISION);
+
+// The great-circle distance between two points, in meters.
+double geo_distance(const geo_point_t &a, const geo_point_t &b);
+
+// The points in a box between two corners (which doesn't cross the antimeridian),
+// or those within a distance of a center.
+class geo_region_t {
+public:
+    // Only for deserialization.
+    geo_region_t();
+
+    static geo_region_t box(const geo_point_t &corner1, const geo_point_t &corner2);
+    static geo_region_t circle(const geo_point_t &center, double radius_m);
+
+    bool contains(const geo_point_t &point) const;
+
+    // Geohash prefixes whose cells cover the region between them: the smallest cells
+    // that there are at most GEO_MAX_COVERING_CELLS of.
+    std::vector<std::string> covering_cells() const;
+
+    RDB_MAKE_ME_SERIALIZABLE_5(is_circle, low, high, center, radius_m);
+
+private:
+    bool is_circle;
+    // The bounding box.  A circle's longitudes may go past +/-180 degrees, when it
+    // crosses the antimeridian, and span all longitudes when it covers a pole.
+    geo_point_t low, high;
+    // Only used by circles.
+    geo_point_t center;
+    double radius_m;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_GEO_HPP_
@@ -1,37 +1,78 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/lazy_json.hpp"
 
-#include "containers/archive/buffer_group_stream.hpp"
-#include "rdb_protocol/blob_wrapper.hpp"
+#include "buffer_cache/alt/blob.hpp"
 
 counted_t<const ql::datum_t> get_data(const rdb_value_t *value,
-                                      buf_parent_t parent) {
-    rdb_blob_wrapper_t blob(parent.cache()->get_block_size(),
-                            const_cast<rdb_value_t *>(value)->value_ref(),
-                            blob::btree_maxreflen);
-
+                                      buf_parent_t parent,
+                                      const field_dictionary_t *dictionary) {
     counted_t<const ql::datum_t> data;
 
-    blob_acq_t acq_group;
-    buffer_group_t buffer_group;
-    blob.expose_all(parent, access_t::read, &buffer_group, &acq_group);
-    buffer_group_read_stream_t read_stream(const_view(&buffer_group));
-    archive_result_t res = deserialize(&read_stream, &data);
+    // The datum is deserialized straight off the blob's leaf blocks, which get
+    // acquired as the deserializer gets to them.
+    blob_read_stream_t read_stream(parent, value->value_ref(), value->maxreflen());
+    archive_result_t res = deserialize_from_storage(&read_stream, &data, dictionary);
     guarantee_deserialization(res, "rdb value");
 
     return data;
 }
 
+counted_t<const ql::datum_t> get_data_field(const rdb_value_t *value,
+                                            buf_parent_t parent,
+                                            const field_dictionary_t *dictionary,
+                                            const std::string &key) {
+    counted_t<const ql::datum_t> field;
+    bool indexed;
+    {
+        blob_read_stream_t read_stream(parent, value->value_ref(),
+                                       value->maxreflen());
+        archive_result_t res = deserialize_field(&read_stream, key, dictionary,
+                                                 &indexed, &field);
+        guarantee_deserialization(res, "rdb value field");
+    }
+    if (!indexed) {
+        field = get_data(value, parent, dictionary)->get(key, ql::NOTHROW);
+    }
+    return field;
+}
+
 const counted_t<const ql::datum_t> &lazy_json_t::get() const {
     guarantee(pointee.has());
     if (!pointee->ptr.has()) {
-        pointee->ptr = get_data(pointee->rdb_value, pointee->parent);
+        pointee->ptr = get_data(pointee->rdb_value, pointee->parent,
+                                pointee->dictionary);
         pointee->rdb_value = NULL;
         pointee->parent = buf_parent_t();
+        pointee->dictionary = NULL;
     }
     return pointee->ptr;
 }
 
+counted_t<const ql::datum_t> lazy_json_t::get_field(const std::string &key) const {
+    guarantee(pointee.has());
+    if (pointee->ptr.has()) {
+        return pointee->ptr->get(key, ql::NOTHROW);
+    }
+    return get_data_field(pointee->rdb_value, pointee->parent, pointee->dictionary,
+                          key);
+}
+
+bool lazy_json_t::get_field_if_indexed(const std::string &key,
+                                       counted_t<const ql::datum_t> *out) const {
+    guarantee(pointee.has());
+    if (pointee->ptr.has()) {
+        *out = pointee->ptr->get(key, ql::NOTHROW);
+        return true;
+    }
+    blob_read_stream_t read_stream(pointee->parent, pointee->rdb_value->value_ref(),
+                                   pointee->rdb_value->maxreflen());
+    bool indexed;
+    archive_result_t res = deserialize_field(&read_stream, key, pointee->dictionary,
+                                             &indexed, out);
+    guarantee_deserialization(res, "rdb value field");
+    return indexed;
+}
+
 bool lazy_json_t::references_parent() const {
     return pointee.has() && !pointee->parent.empty();
 }
@@ -2,42 +2,110 @@
 #ifndef RDB_PROTOCOL_LAZY_JSON_HPP_
 #define RDB_PROTOCOL_LAZY_JSON_HPP_
 
+#include <string.h>
+
 #include "buffer_cache/alt/alt.hpp"
 #include "buffer_cache/alt/blob.hpp"
 #include "rdb_protocol/datum.hpp"
 
+/* A document's value in a btree leaf node: a blob reference, which keeps documents
+that fit in it inline.  Values written with the default maxreflen,
+blob::btree_maxreflen, are just the reference, which starts with a byte no greater
+than that.  Tables that keep bigger documents inline (see `inline_value_size` in
+`namespace_semilattice_metadata_t`) write values that start with
+WIDE_VALUE_MARKER and the maxreflen as a uint16_t, followed by the reference.  So
+every value says how to read it, and a table's setting can differ from the one its
+old values were written with. */
 struct rdb_value_t {
     char contents[];
 
 public:
+    static const uint8_t WIDE_VALUE_MARKER = 255;
+    static const int WIDE_VALUE_HEADER_SIZE = sizeof(uint8_t) + sizeof(uint16_t);
+
+    // How much room to allocate for a new value whose reference has the given
+    // maxreflen.
+    static int max_size(int maxreflen) {
+        return maxreflen == blob::btree_maxreflen
+            ? maxreflen : WIDE_VALUE_HEADER_SIZE + maxreflen;
+    }
+
+    // Sets up a zeroed value of max_size(maxreflen) bytes for a reference with the
+    // given maxreflen.
+    void init(int maxreflen) {
+        if (maxreflen != blob::btree_maxreflen) {
+            rassert(maxreflen > blob::btree_maxreflen && maxreflen <= UINT16_MAX);
+            contents[0] = WIDE_VALUE_MARKER;
+            const uint16_t wide_maxreflen = maxreflen;
+            memcpy(contents + sizeof(uint8_t), &wide_maxreflen, sizeof(wide_maxreflen));
+        }
+    }
+
+    bool is_wide() const {
+        return static_cast<uint8_t>(contents[0]) == WIDE_VALUE_MARKER;
+    }
+
+    int maxreflen() const {
+        if (!is_wide()) {
+            return blob::btree_maxreflen;
+        }
+        uint16_t wide_maxreflen;
+        memcpy(&wide_maxreflen, contents + sizeof(uint8_t), sizeof(wide_maxreflen));
+        return wide_maxreflen;
+    }
+
+    // The size the value takes up in the leaf node.
     int inline_size(block_size_t bs) const {
-        return blob::ref_size(bs, contents, blob::btree_maxreflen);
+        return header_size() + blob::ref_size(bs, value_ref(), maxreflen());
+    }
+
+    // The size of the value if its reference were as big as it can get.
+    int full_size() const {
+        return header_size() + maxreflen();
     }
 
     int64_t value_size() const {
-        return blob::value_size(contents, blob::btree_maxreflen);
+        return blob::value_size(value_ref(), maxreflen());
     }
 
+    // The blob reference, to be used with maxreflen().
     const char *value_ref() const {
-        return contents;
+        return contents + header_size();
     }
 
     char *value_ref() {
-        return contents;
+        return contents + header_size();
+    }
+
+private:
+    int header_size() const {
+        return is_wide() ? WIDE_VALUE_HEADER_SIZE : 0;
     }
 };
 
+// `dictionary` is the table's field dictionary, which the value may have been
+// written with (see serialize_for_storage).
 counted_t<const ql::datum_t> get_data(const rdb_value_t *value,
-                                      buf_parent_t parent);
+                                      buf_parent_t parent,
+                                      const field_dictionary_t *dictionary);
+
+// Loads just the field `key` of the stored object, without deserializing its other
+// fields when the object was stored with a key directory.  Returns an empty pointer
+// if the object has no such field.
+counted_t<const ql::datum_t> get_data_field(const rdb_value_t *value,
+                                            buf_parent_t parent,
+                                            const field_dictionary_t *dictionary,
+                                            const std::string &key);
 
 class lazy_json_pointee_t : public single_threaded_countable_t<lazy_json_pointee_t> {
-    lazy_json_pointee_t(const rdb_value_t *_rdb_value, buf_parent_t _parent)
-        : rdb_value(_rdb_value), parent(_parent) {
+    lazy_json_pointee_t(const rdb_value_t *_rdb_value, buf_parent_t _parent,
+                        const field_dictionary_t *_dictionary)
+        : rdb_value(_rdb_value), parent(_parent), dictionary(_dictionary) {
         guarantee(rdb_value != NULL);
     }
 
     explicit lazy_json_pointee_t(const counted_t<const ql::datum_t> &_ptr)
-        : ptr(_ptr), rdb_value(NULL), parent() {
+        : ptr(_ptr), rdb_value(NULL), parent(), dictionary(NULL) {
         guarantee(ptr);
     }
 
@@ -50,6 +118,7 @@ class lazy_json_pointee_t : public single_threaded_countable_t<lazy_json_pointee
     // the transaction with which to load it.  Non-NULL only if ptr is empty.
     const rdb_value_t *rdb_value;
     buf_parent_t parent;
+    const field_dictionary_t *dictionary;
 
     DISABLE_COPYING(lazy_json_pointee_t);
 };
@@ -59,10 +128,18 @@ public:
     explicit lazy_json_t(const counted_t<const ql::datum_t> &ptr)
         : pointee(new lazy_json_pointee_t(ptr)) { }
 
-    lazy_json_t(const rdb_value_t *rdb_value, buf_parent_t parent)
-        : pointee(new lazy_json_pointee_t(rdb_value, parent)) { }
+    lazy_json_t(const rdb_value_t *rdb_value, buf_parent_t parent,
+                const field_dictionary_t *dictionary)
+        : pointee(new lazy_json_pointee_t(rdb_value, parent, dictionary)) { }
 
     const counted_t<const ql::datum_t> &get() const;
+    // Like get()->get(key, NOTHROW), but doesn't load the whole value unless it has
+    // to.  The value stays unloaded, so this doesn't make references_parent() false.
+    counted_t<const ql::datum_t> get_field(const std::string &key) const;
+    // Like get_field, but returns false instead of loading the whole value, if it
+    // wasn't stored with a key directory.
+    bool get_field_if_indexed(const std::string &key,
+                              counted_t<const ql::datum_t> *out) const;
     bool references_parent() const;
     void reset();
 
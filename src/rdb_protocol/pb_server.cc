@@ -6,6 +6,7 @@
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/profile.hpp"
+#include "rdb_protocol/query_capture.hpp"
 #include "rdb_protocol/stream_cache.hpp"
 #include "rpc/semilattice/view/field.hpp"
 
@@ -18,14 +19,18 @@ Response on_unparsable_query2(ql::protob_t<Query> q, std::string msg) {
 
 query2_server_t::query2_server_t(const std::set<ip_address_t> &local_addresses,
                                  int port,
-                                 rdb_protocol_t::context_t *_ctx) :
+                                 rdb_protocol_t::context_t *_ctx,
+                                 query_capture_t *_query_capture) :
     server(local_addresses,
            port,
            boost::bind(&query2_server_t::handle, this, _1, _2, _3),
            &on_unparsable_query2,
            _ctx->auth_metadata,
-           INLINE),
-    ctx(_ctx), parser_id(generate_uuid()), thread_counters(0)
+           CORO_UNORDERED),
+    ctx(_ctx), query_capture(_query_capture), parser_id(generate_uuid()),
+    thread_counters(0),
+    admission(std::max(1, MAX_RUNNING_QUERIES_PER_NODE / get_num_db_threads()),
+              std::max(1, MAX_WAITING_QUERIES_PER_NODE / get_num_db_threads()))
 { }
 
 http_app_t *query2_server_t::get_http_app() {
@@ -42,6 +47,7 @@ namespace ql {
              rdb_protocol_t::context_t *ctx,
              signal_t *interruptor,
              Response *res,
+             plan_cache_t *plan_cache,
              stream_cache2_t *stream_cache2);
 }
 
@@ -67,15 +73,36 @@ bool query2_server_t::handle(ql::protob_t<Query> q,
     guarantee(interruptor);
     response_out->set_token(q->token());
 
+    if (query_capture != NULL) {
+        if (!query2_context->capture_checked) {
+            query2_context->capture_checked = true;
+            query2_context->capture_id = query_capture->new_connection();
+        }
+        if (query2_context->capture_id != 0) {
+            query_capture->note_query(query2_context->capture_id, *q);
+        }
+    }
+
     counted_t<const ql::datum_t> noreply = static_optarg("noreply", q);
     bool response_needed = !(noreply.has() &&
          noreply->get_type() == ql::datum_t::type_t::R_BOOL &&
          noreply->as_bool());
     try {
+        // Only new queries are turned away; the rest are for queries that have
+        // already been let in.
+        admission_controller_t::ticket_t ticket;
+        if (q->type() == Query_QueryType_START
+            && !ticket.admit(admission.get(), interruptor)) {
+            ql::fill_error(response_out, Response::RUNTIME_ERROR,
+                           "Server overloaded, try again later.");
+            return response_needed;
+        }
         scoped_ops_running_stat_t stat(&ctx->ql_ops_running);
+        block_pm_duration latency_timer(&ctx->ql_query_latency);
         guarantee(ctx->directory_read_manager);
         // `ql::run` will set the status code
-        ql::run(q, ctx, interruptor, response_out, stream_cache2);
+        ql::run(q, ctx, interruptor, response_out, &query2_context->plan_cache,
+                stream_cache2);
     } catch (const ql::exc_t &e) {
         fill_error(response_out, Response::COMPILE_ERROR, e.what(), e.backtrace());
     } catch (const ql::datum_exc_t &e) {
@@ -95,6 +122,21 @@ void make_empty_protob_bearer(ql::protob_t<Query> *request) {
     *request = ql::make_counted_query();
 }
 
+void reset_protob_bearer(ql::protob_t<Query> *request) {
+    // A pipelined query's coroutine, or a cursor's terms, may still point into it.
+    if (request->has() && request->unique()) {
+        (*request)->Clear();
+    } else {
+        make_empty_protob_bearer(request);
+    }
+}
+
 Query *underlying_protob_value(ql::protob_t<Query> *request) {
     return request->get();
 }
+
+// A NOREPLY_WAIT promises that the connection's earlier queries, noreply ones
+// included, are done.
+bool request_waits_for_earlier(ql::protob_t<Query> *request) {
+    return (*request)->type() == Query_QueryType_NOREPLY_WAIT;
+}
@@ -6,32 +6,45 @@
 #include <set>
 #include <string>
 
+#include "concurrency/admission_control.hpp"
 #include "protob/protob.hpp"
 #include "protocol_api.hpp"
+#include "rdb_protocol/plan_cache.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/stream_cache.hpp"
 
 namespace ql { template <class> class protob_t; }
+class query_capture_t;
 
 // Overloads used by protob_server_t.
 void make_empty_protob_bearer(ql::protob_t<Query> *request);
+void reset_protob_bearer(ql::protob_t<Query> *request);
 Query *underlying_protob_value(ql::protob_t<Query> *request);
+bool request_waits_for_earlier(ql::protob_t<Query> *request);
 
 class query2_server_t {
 public:
+    // If `_query_capture` isn't NULL, the queries on the connections it samples are
+    // written to it.
     query2_server_t(const std::set<ip_address_t> &local_addresses, int port,
-                    rdb_protocol_t::context_t *_ctx);
+                    rdb_protocol_t::context_t *_ctx,
+                    query_capture_t *_query_capture = NULL);
 
     http_app_t *get_http_app();
 
     int get_port() const;
 
     struct context_t {
-        context_t() : interruptor(0) { }
+        context_t() : interruptor(0), capture_checked(false), capture_id(0) { }
         static const int32_t no_auth_magic_number = VersionDummy::V0_1;
         static const int32_t auth_magic_number = VersionDummy::V0_2;
+        ql::plan_cache_t plan_cache;
         ql::stream_cache2_t stream_cache2;
         signal_t *interruptor;
+        // Whether the query capture has seen this connection yet, and its id in the
+        // capture (0 if it isn't captured).
+        bool capture_checked;
+        uint64_t capture_id;
     };
 private:
     MUST_USE bool handle(ql::protob_t<Query> q,
@@ -39,8 +52,11 @@ private:
                          context_t *query2_context);
     protob_server_t<ql::protob_t<Query>, Response, context_t> server;
     rdb_protocol_t::context_t *ctx;
+    query_capture_t *query_capture;
     uuid_u parser_id;
     one_per_thread_t<int> thread_counters;
+    // Turns away new queries when the server has too many.
+    one_per_thread_t<admission_controller_t> admission;
 
     DISABLE_COPYING(query2_server_t);
 };
@@ -0,0 +1,137 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/plan_cache.hpp"
+
+#include "config/args.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/term.hpp"
+
+namespace ql {
+
+plan_params_t::plan_params_t(const std::vector<const Term *> &terms)
+    : compiled(terms.size(), false) {
+    for (size_t i = 0; i < terms.size(); ++i) {
+        indices[terms[i]] = i;
+    }
+}
+
+bool plan_params_t::compile_param(const Term *t, size_t *index_out) {
+    std::map<const Term *, size_t>::const_iterator it = indices.find(t);
+    if (it == indices.end()) {
+        return false;
+    }
+    compiled[it->second] = true;
+    *index_out = it->second;
+    return true;
+}
+
+bool plan_params_t::all_compiled() const {
+    for (auto it = compiled.begin(); it != compiled.end(); ++it) {
+        if (!*it) {
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace {
+
+// Whether the `i`th argument of `t` is a parameter, if it's a literal.
+bool is_param_position(const Term &t, int i) {
+    return (t.type() == Term::GET && i == 1) || (t.type() == Term::GET_ALL && i >= 1);
+}
+
+// Appends `t`'s shape to `key`, and the literals in it that are parameters to
+// `params` (unless that's NULL).  Returns false if the shape gets bigger than
+// PLAN_CACHE_MAX_SHAPE_SIZE.
+bool append_shape(const Term &t, bool is_param, std::vector<const Term *> *params,
+                  std::string *key) {
+    key->append(strprintf("(%d", static_cast<int>(t.type())));
+    if (t.type() == Term::DATUM) {
+        if (is_param) {
+            key->push_back('?');
+            params->push_back(&t);
+        } else {
+            if (key->size() + t.datum().ByteSize() > PLAN_CACHE_MAX_SHAPE_SIZE) {
+                return false;
+            }
+            const std::string datum = t.datum().SerializeAsString();
+            key->append(strprintf(" %zu:", datum.size()));
+            key->append(datum);
+        }
+    }
+
+    // Literals in functions get sent to the shards as terms, and optargs can get
+    // turned into functions (see `op_term_t::lazy_literal_optarg`), so neither has
+    // parameters.
+    std::vector<const Term *> *arg_params = t.type() == Term::FUNC ? NULL : params;
+    for (int i = 0; i < t.args_size(); ++i) {
+        const Term &arg = t.args(i);
+        if (!append_shape(arg,
+                          arg_params != NULL && arg.type() == Term::DATUM
+                          && is_param_position(t, i),
+                          arg_params, key)) {
+            return false;
+        }
+    }
+    for (int i = 0; i < t.optargs_size(); ++i) {
+        const std::string &optarg_key = t.optargs(i).key();
+        key->append(strprintf(" %zu:", optarg_key.size()));
+        key->append(optarg_key);
+        if (!append_shape(t.optargs(i).val(), false, NULL, key)) {
+            return false;
+        }
+    }
+    key->push_back(')');
+    return key->size() <= PLAN_CACHE_MAX_SHAPE_SIZE;
+}
+
+}  // namespace
+
+plan_cache_t::plan_cache_t() : uses(0) { }
+
+plan_cache_t::~plan_cache_t() { }
+
+counted_t<term_t> plan_cache_t::compile(env_t *env, const protob_t<const Term> &t) {
+    env->plan_params.clear();
+    compile_env_t compile_env((var_visibility_t()));
+
+    std::string key;
+    std::vector<const Term *> params;
+    if (!append_shape(*t, false, &params, &key)) {
+        // Big queries are mostly big because of big literals, like the documents
+        // of an insert, so there's little chance that we'd see them again.
+        return compile_term(&compile_env, t);
+    }
+
+    for (auto it = params.begin(); it != params.end(); ++it) {
+        env->plan_params.push_back(make_counted<const datum_t>(&(*it)->datum()));
+    }
+    ++uses;
+    std::map<std::string, plan_t>::iterator it = plans.find(key);
+    if (it != plans.end()) {
+        it->second.last_used = uses;
+        return it->second.root;
+    }
+
+    plan_params_t plan_params(params);
+    compile_env.plan_params = &plan_params;
+    counted_t<term_t> root = compile_term(&compile_env, t);
+    if (plan_params.all_compiled()) {
+        if (plans.size() >= PLAN_CACHE_SIZE) {
+            std::map<std::string, plan_t>::iterator lru = plans.begin();
+            for (auto jt = plans.begin(); jt != plans.end(); ++jt) {
+                if (jt->second.last_used < lru->second.last_used) {
+                    lru = jt;
+                }
+            }
+            plans.erase(lru);
+        }
+        plan_t plan;
+        plan.root = root;
+        plan.last_used = uses;
+        plans.insert(std::make_pair(std::move(key), plan));
+    }
+    return root;
+}
+
+}  // namespace ql
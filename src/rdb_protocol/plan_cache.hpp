@@ -0,0 +1,63 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_PLAN_CACHE_HPP_
+#define RDB_PROTOCOL_PLAN_CACHE_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "containers/counted.hpp"
+#include "rdb_protocol/counted_term.hpp"
+
+namespace ql {
+
+class env_t;
+class term_t;
+
+// The literals of a query that its compiled term tree reads out of the query's
+// `env_t` (see `env_t::plan_params`), instead of having them compiled in.
+class plan_params_t {
+public:
+    explicit plan_params_t(const std::vector<const Term *> &terms);
+
+    // If `t` is one of the parameters, returns true and sets `*index_out` to its
+    // index in `env_t::plan_params`.
+    bool compile_param(const Term *t, size_t *index_out);
+    // Whether every parameter got compiled as one.  If one didn't, something
+    // (like a rewrite term) copied or read its literal.
+    bool all_compiled() const;
+
+private:
+    std::map<const Term *, size_t> indices;
+    std::vector<bool> compiled;
+};
+
+/* Caches the compiled term trees of a connection's queries, so that one with the
+same shape as an earlier query doesn't need compiling again.  Queries have the
+same shape if they have the same terms and literals, except for the keys passed to
+`get` and `get_all`, which are the plans' parameters.  (Literals inside functions
+aren't parameters, because functions get sent to the shards as terms.) */
+class plan_cache_t {
+public:
+    plan_cache_t();
+    ~plan_cache_t();
+
+    // Compiles the preprocessed query term `t`, or finds the compilation of an
+    // earlier query with its shape, and sets up `env->plan_params` for it.
+    counted_t<term_t> compile(env_t *env, const protob_t<const Term> &t);
+
+private:
+    struct plan_t {
+        counted_t<term_t> root;
+        uint64_t last_used;
+    };
+
+    std::map<std::string, plan_t> plans;
+    uint64_t uses;
+
+    DISABLE_COPYING(plan_cache_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_PLAN_CACHE_HPP_
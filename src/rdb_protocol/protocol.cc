@@ -2,11 +2,13 @@
 #include "rdb_protocol/protocol.hpp"
 
 #include <algorithm>
+#include <limits>
 
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
 #include "arch/io/disk.hpp"
+#include "btree/defragment.hpp"
 #include "btree/erase_range.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "btree/slice.hpp"
@@ -14,9 +16,12 @@
 #include "clustering/administration/metadata.hpp"
 #include "clustering/reactor/reactor.hpp"
 #include "concurrency/cross_thread_watchable.hpp"
+#include "concurrency/mutex.hpp"
 #include "concurrency/pmap.hpp"
+#include "concurrency/stealable_pmap.hpp"
 #include "concurrency/wait_any.hpp"
 #include "containers/archive/archive.hpp"
+#include "containers/archive/varint.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "protob/protob.hpp"
 #include "rdb_protocol/btree.hpp"
@@ -42,6 +47,8 @@ typedef rdb_protocol_t::read_response_t read_response_t;
 
 typedef rdb_protocol_t::point_read_t point_read_t;
 typedef rdb_protocol_t::point_read_response_t point_read_response_t;
+typedef rdb_protocol_t::batched_point_read_t batched_point_read_t;
+typedef rdb_protocol_t::batched_point_read_response_t batched_point_read_response_t;
 
 typedef rdb_protocol_t::rget_read_t rget_read_t;
 typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
@@ -54,6 +61,10 @@ typedef rdb_protocol_t::sindex_list_response_t sindex_list_response_t;
 
 typedef rdb_protocol_t::sindex_status_t sindex_status_t;
 typedef rdb_protocol_t::sindex_status_response_t sindex_status_response_t;
+typedef rdb_protocol_t::changefeed_subscribe_t changefeed_subscribe_t;
+typedef rdb_protocol_t::changefeed_subscribe_response_t changefeed_subscribe_response_t;
+typedef rdb_protocol_t::shard_versions_t shard_versions_t;
+typedef rdb_protocol_t::shard_versions_response_t shard_versions_response_t;
 
 typedef rdb_protocol_t::write_t write_t;
 typedef rdb_protocol_t::write_response_t write_response_t;
@@ -366,6 +377,11 @@ bool range_key_tester_t::key_should_be_erased(const btree_key_t *key) {
         && delete_range->inner.contains_key(key->contents, key->size);
 }
 
+bool range_key_tester_t::erases_all_keys() {
+    // The erase is already limited to `delete_range->inner`.
+    return delete_range->beg == 0 && delete_range->end == HASH_REGION_HASH_SIZE;
+}
+
 typedef boost::variant<rdb_modification_report_t,
                        rdb_erase_range_report_t>
         sindex_change_t;
@@ -375,18 +391,23 @@ void add_status(const single_sindex_status_t &new_status,
     status_out->blocks_processed += new_status.blocks_processed;
     status_out->blocks_total += new_status.blocks_total;
     status_out->ready &= new_status.ready;
+    // The shards are constructed at once, so the index is ready when the slowest is.
+    status_out->secs_remaining = std::max(status_out->secs_remaining,
+                                          new_status.secs_remaining);
 }
 
 }  // namespace rdb_protocol_details
 
 rdb_protocol_t::context_t::context_t()
     : extproc_pool(NULL), ns_repo(NULL),
-    cross_thread_namespace_watchables(get_num_threads()),
-    cross_thread_database_watchables(get_num_threads()),
+    io_backender(NULL), base_path("."),
+    mailbox_manager(NULL),
     directory_read_manager(NULL),
     signals(get_num_threads()),
     ql_stats_membership(&get_global_perfmon_collection(), &ql_stats_collection, "query_language"),
-    ql_ops_running_membership(&ql_stats_collection, &ql_ops_running, "ops_running")
+    ql_ops_running_membership(&ql_stats_collection, &ql_ops_running, "ops_running"),
+    ql_query_latency(secs_to_ticks(1)),
+    ql_query_latency_membership(&ql_stats_collection, &ql_query_latency, "query_latency")
 { }
 
 rdb_protocol_t::context_t::context_t(
@@ -399,29 +420,34 @@ rdb_protocol_t::context_t::context_t(
     directory_read_manager_t<cluster_directory_metadata_t>
         *_directory_read_manager,
     machine_id_t _machine_id,
-    perfmon_collection_t *global_stats)
+    perfmon_collection_t *global_stats,
+    io_backender_t *_io_backender,
+    const base_path_t &_base_path,
+    mailbox_manager_t *_mailbox_manager)
     : extproc_pool(_extproc_pool), ns_repo(_ns_repo),
-      cross_thread_namespace_watchables(get_num_threads()),
-      cross_thread_database_watchables(get_num_threads()),
+      io_backender(_io_backender), base_path(_base_path),
+      mailbox_manager(_mailbox_manager),
       cluster_metadata(_cluster_metadata),
       auth_metadata(_auth_metadata),
       directory_read_manager(_directory_read_manager),
       signals(get_num_threads()),
       machine_id(_machine_id),
       ql_stats_membership(global_stats, &ql_stats_collection, "query_language"),
-      ql_ops_running_membership(&ql_stats_collection, &ql_ops_running, "ops_running")
+      ql_ops_running_membership(&ql_stats_collection, &ql_ops_running, "ops_running"),
+      ql_query_latency(secs_to_ticks(1)),
+      ql_query_latency_membership(&ql_stats_collection, &ql_query_latency, "query_latency")
 {
-    for (int thread = 0; thread < get_num_threads(); ++thread) {
-        cross_thread_namespace_watchables[thread].init(new cross_thread_watchable_variable_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > >(
-                                                    clone_ptr_t<semilattice_watchable_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > > >
-                                                        (new semilattice_watchable_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > >(
-                                                            metadata_field(&cluster_semilattice_metadata_t::rdb_namespaces, _cluster_metadata))), threadnum_t(thread)));
+    cross_thread_namespace_watchables.init(new cross_thread_watchable_snapshots_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > >(
+                                            clone_ptr_t<semilattice_watchable_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > > >
+                                                (new semilattice_watchable_t<cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > >(
+                                                    metadata_field(&cluster_semilattice_metadata_t::rdb_namespaces, _cluster_metadata)))));
 
-        cross_thread_database_watchables[thread].init(new cross_thread_watchable_variable_t<databases_semilattice_metadata_t>(
-                                                    clone_ptr_t<semilattice_watchable_t<databases_semilattice_metadata_t> >
-                                                        (new semilattice_watchable_t<databases_semilattice_metadata_t>(
-                                                            metadata_field(&cluster_semilattice_metadata_t::databases, _cluster_metadata))), threadnum_t(thread)));
+    cross_thread_database_watchables.init(new cross_thread_watchable_snapshots_t<databases_semilattice_metadata_t>(
+                                            clone_ptr_t<semilattice_watchable_t<databases_semilattice_metadata_t> >
+                                                (new semilattice_watchable_t<databases_semilattice_metadata_t>(
+                                                    metadata_field(&cluster_semilattice_metadata_t::databases, _cluster_metadata)))));
 
+    for (int thread = 0; thread < get_num_threads(); ++thread) {
         signals[thread].init(new cross_thread_signal_t(&interruptor, threadnum_t(thread)));
     }
 }
@@ -460,12 +486,30 @@ store_key_t sindex_list_region_key() {
     return store_key_t();
 }
 
+region_t region_from_keys(const std::vector<store_key_t> &keys,
+                          const std::vector<uint64_t> &key_hashes);
+
+// The hash of `key`, which is `key_hashes[i]` unless the request came over the
+// network without its key hashes (they aren't serialized).
+uint64_t batch_key_hash(const std::vector<uint64_t> &key_hashes, size_t i,
+                        const store_key_t &key) {
+    if (key_hashes.empty()) {
+        return hash_region_hasher(key.contents(), key.size());
+    }
+    rassert(i < key_hashes.size());
+    return key_hashes[i];
+}
+
 /* read_t::get_region implementation */
 struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const point_read_t &pr) const {
         return rdb_protocol_t::monokey_region(pr.key);
     }
 
+    region_t operator()(const batched_point_read_t &bpr) const {
+        return region_from_keys(bpr.keys, bpr.key_hashes);
+    }
+
     region_t operator()(const rget_read_t &rg) const {
         return rg.region;
     }
@@ -481,12 +525,28 @@ struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const sindex_status_t &ss) const {
         return ss.region;
     }
+
+    region_t operator()(const changefeed_subscribe_t &s) const {
+        return s.region;
+    }
+
+    region_t operator()(const shard_versions_t &sv) const {
+        return sv.region;
+    }
 };
 
 region_t read_t::get_region() const THROWS_NOTHING {
     return boost::apply_visitor(rdb_r_get_region_visitor(), read);
 }
 
+bool read_t::use_snapshot() const THROWS_NOTHING {
+    if (boost::get<rget_read_t>(&read)) {
+        return true;
+    }
+    const distribution_read_t *dg = boost::get<distribution_read_t>(&read);
+    return dg != NULL && dg->method == distribution_method_t::SAMPLE;
+}
+
 struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
     explicit rdb_r_shard_visitor_t(const hash_region_t<key_range_t> *_region,
                                    profile_bool_t _profile, read_t *_read_out)
@@ -507,6 +567,27 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return keyed_read(pr, pr.key);
     }
 
+    bool operator()(const batched_point_read_t &bpr) const {
+        std::vector<store_key_t> shard_keys;
+        std::vector<uint64_t> shard_key_hashes;
+        for (size_t i = 0; i < bpr.keys.size(); ++i) {
+            const uint64_t hash_value = batch_key_hash(bpr.key_hashes, i, bpr.keys[i]);
+            if (region_contains_key_with_precomputed_hash(*region, bpr.keys[i],
+                                                          hash_value)) {
+                shard_keys.push_back(bpr.keys[i]);
+                shard_key_hashes.push_back(hash_value);
+            }
+        }
+        if (!shard_keys.empty()) {
+            *read_out = read_t(batched_point_read_t(std::move(shard_keys),
+                                                    std::move(shard_key_hashes)),
+                               profile);
+            return true;
+        } else {
+            return false;
+        }
+    }
+
     template <class T>
     bool rangey_read(const T &arg) const {
         const hash_region_t<key_range_t> intersection
@@ -542,6 +623,14 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return rangey_read(ss);
     }
 
+    bool operator()(const changefeed_subscribe_t &s) const {
+        return rangey_read(s);
+    }
+
+    bool operator()(const shard_versions_t &sv) const {
+        return rangey_read(sv);
+    }
+
     const hash_region_t<key_range_t> *region;
     profile_bool_t profile;
     read_t *read_out;
@@ -549,7 +638,11 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
 
 bool read_t::shard(const hash_region_t<key_range_t> &region,
                    read_t *read_out) const THROWS_NOTHING {
-    return boost::apply_visitor(rdb_r_shard_visitor_t(&region, profile, read_out), read);
+    if (!boost::apply_visitor(rdb_r_shard_visitor_t(&region, profile, read_out), read)) {
+        return false;
+    }
+    read_out->query_priority = query_priority;
+    return true;
 }
 
 /* A visitor to handle this unsharding process for us. */
@@ -583,9 +676,118 @@ void scale_down_distribution(size_t result_limit, std::map<store_key_t, int64_t>
     }
 }
 
+void erase_keys_outside_range(const key_range_t &range,
+                              std::map<store_key_t, int64_t> *key_counts) {
+    for (std::map<store_key_t, int64_t>::iterator it = key_counts->begin(); it != key_counts->end(); ) {
+        if (!range.contains_key(it->first)) {
+            std::map<store_key_t, int64_t>::iterator tmp = it;
+            ++it;
+            key_counts->erase(tmp);
+        } else {
+            ++it;
+        }
+    }
+}
+
+int64_t total_distribution_count(const std::map<store_key_t, int64_t> &key_counts) {
+    int64_t total = 0;
+    for (std::map<store_key_t, int64_t>::const_iterator it = key_counts.begin(); it != key_counts.end(); ++it) {
+        total += it->second;
+    }
+    return total;
+}
+
+// Scales the counts up by `scale_factor` and adds them to `key_counts_out`.
+void add_scaled_distribution(double scale_factor,
+                             const std::map<store_key_t, int64_t> &key_counts,
+                             std::map<store_key_t, int64_t> *key_counts_out) {
+    guarantee(scale_factor >= 1.0);
+    for (std::map<store_key_t, int64_t>::const_iterator it = key_counts.begin(); it != key_counts.end(); ++it) {
+        (*key_counts_out)[it->first] = static_cast<int64_t>(it->second * scale_factor);
+    }
+}
+
+// Whether a key from a shard's rget response comes before the point where the
+// unsharded response is cut off.
+class rget_key_cutoff_t {
+public:
+    rget_key_cutoff_t(const store_key_t &_last_considered_key, bool _reversed)
+        : last_considered_key(_last_considered_key), is_reversed(_reversed) { }
+    bool admits(const store_key_t &key) const {
+        return !is_reversed ? key <= last_considered_key : key >= last_considered_key;
+    }
+private:
+    const store_key_t &last_considered_key;
+    const bool is_reversed;
+};
+
+// The next item of one shard's stream in the merge of sorted rget responses.
+struct rget_merge_head_t {
+    explicit rget_merge_head_t(stream_t *_stream) : stream(_stream), pos(0) { }
+    const store_key_t &key() const { return (*stream)[pos].key; }
+    stream_t *stream;
+    size_t pos;
+};
+
+// Orders the heap in the merge so that the head whose key comes first in the
+// read's sort order is on top.
+class rget_merge_head_later_t {
+public:
+    explicit rget_merge_head_later_t(bool _reversed) : is_reversed(_reversed) { }
+    bool operator()(const rget_merge_head_t &a, const rget_merge_head_t &b) const {
+        return !is_reversed ? b.key() < a.key() : a.key() < b.key();
+    }
+private:
+    bool is_reversed;
+};
+
+// Turns the serialized chunks of the shards' rget streams into items, spreading the
+// chunks over whichever threads are free, and appends them to the streams in their order.
+static void deserialize_rget_stream_chunks(read_response_t *responses, size_t count) {
+    std::vector<std::pair<rget_read_response_t *, size_t> > chunks;
+    for (size_t i = 0; i < count; ++i) {
+        auto rr = boost::get<rget_read_response_t>(&responses[i].response);
+        guarantee(rr != NULL);
+        for (size_t j = 0; j < rr->stream_chunks.size(); ++j) {
+            chunks.push_back(std::make_pair(rr, j));
+        }
+    }
+    if (chunks.empty()) {
+        return;
+    }
+
+    // Deserializing doesn't block or touch anything bound to a thread (datums count
+    // their references atomically), so idle threads can steal chunks while busy ones
+    // leave them to us.
+    std::vector<stream_t> items(chunks.size());
+    stealable_pmap(static_cast<int>(chunks.size()), [&](int i) {
+        inplace_vector_read_stream_t s(
+            &chunks[i].first->stream_chunks[chunks[i].second]);
+        archive_result_t res = deserialize(&s, &items[i]);
+        guarantee_deserialization(res, "rget response chunk");
+    });
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        stream_t *stream = boost::get<stream_t>(&chunks[i].first->result);
+        guarantee(stream != NULL);
+        if (stream->empty()) {
+            stream->swap(items[i]);
+        } else {
+            stream->reserve(stream->size() + items[i].size());
+            for (auto it = items[i].begin(); it != items[i].end(); ++it) {
+                stream->push_back(std::move(*it));
+            }
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        auto rr = boost::get<rget_read_response_t>(&responses[i].response);
+        std::vector<std::vector<char> >().swap(rr->stream_chunks);
+    }
+}
+
 class rdb_r_unshard_visitor_t : public boost::static_visitor<void> {
 public:
-    rdb_r_unshard_visitor_t(const read_response_t *_responses,
+    rdb_r_unshard_visitor_t(read_response_t *_responses,
                             size_t _count,
                             read_response_t *_response_out,
                             rdb_protocol_t::context_t *ctx,
@@ -593,10 +795,8 @@ public:
         : responses(_responses), count(_count), response_out(_response_out),
           ql_env(ctx->extproc_pool,
                  ctx->ns_repo,
-                 ctx->cross_thread_namespace_watchables[get_thread_id().threadnum].get()
-                     ->get_watchable(),
-                 ctx->cross_thread_database_watchables[get_thread_id().threadnum].get()
-                     ->get_watchable(),
+                 ctx->cross_thread_namespace_watchables->get_watchable(),
+                 ctx->cross_thread_database_watchables->get_watchable(),
                  ctx->cluster_metadata,
                  NULL,
                  interruptor,
@@ -604,7 +804,7 @@ public:
                  ql::protob_t<Query>())
     { }
 
-    rdb_r_unshard_visitor_t(const read_response_t *_responses,
+    rdb_r_unshard_visitor_t(read_response_t *_responses,
                             size_t _count,
                             read_response_t *_response_out,
                             signal_t *interruptor)
@@ -618,6 +818,18 @@ public:
         *response_out = responses[0];
     }
 
+    void operator()(const batched_point_read_t &) {
+        response_out->response = batched_point_read_response_t();
+        batched_point_read_response_t *res
+            = boost::get<batched_point_read_response_t>(&response_out->response);
+        for (size_t i = 0; i < count; ++i) {
+            const batched_point_read_response_t *shard_res
+                = boost::get<batched_point_read_response_t>(&responses[i].response);
+            guarantee(shard_res != NULL);
+            res->rows.insert(shard_res->rows.begin(), shard_res->rows.end());
+        }
+    }
+
     void operator()(const rget_read_t &rg) {
         response_out->response = rget_read_response_t();
         rget_read_response_t *rg_response
@@ -669,37 +881,34 @@ public:
             // Find the largest hash shard for this key range
             key_range_t range = results[i].region.inner;
             size_t largest_index = i;
-            size_t largest_size = 0;
-            size_t total_range_keys = 0;
+            int64_t largest_size = 0;
+            int64_t largest_bytes = 0;
+            int64_t total_range_keys = 0;
+            int64_t total_range_bytes = 0;
 
             while (i < results.size() && results[i].region.inner == range) {
-                size_t tmp_total_keys = 0;
-                for (std::map<store_key_t, int64_t>::const_iterator mit = results[i].key_counts.begin(); mit != results[i].key_counts.end(); ++mit) {
-                    tmp_total_keys += mit->second;
-                }
+                const int64_t tmp_total_keys = total_distribution_count(results[i].key_counts);
+                const int64_t tmp_total_bytes = total_distribution_count(results[i].byte_counts);
 
                 if (tmp_total_keys > largest_size) {
                     largest_size = tmp_total_keys;
+                    largest_bytes = tmp_total_bytes;
                     largest_index = i;
                 }
 
                 total_range_keys += tmp_total_keys;
+                total_range_bytes += tmp_total_bytes;
                 ++i;
             }
 
+            // Scale up the selected hash shard's counts to stand for all of them.
             if (largest_size > 0) {
-                // Scale up the selected hash shard
-                double scale_factor = static_cast<double>(total_range_keys) / static_cast<double>(largest_size);
-
-                guarantee(scale_factor >= 1.0);  // Directly provable from code above.
-
-                for (std::map<store_key_t, int64_t>::iterator mit = results[largest_index].key_counts.begin();
-                     mit != results[largest_index].key_counts.end();
-                     ++mit) {
-                    mit->second = static_cast<int64_t>(mit->second * scale_factor);
-                }
-
-                res.key_counts.insert(results[largest_index].key_counts.begin(), results[largest_index].key_counts.end());
+                add_scaled_distribution(static_cast<double>(total_range_keys) / static_cast<double>(largest_size),
+                                        results[largest_index].key_counts, &res.key_counts);
+            }
+            if (largest_bytes > 0) {
+                add_scaled_distribution(std::max(1.0, static_cast<double>(total_range_bytes) / static_cast<double>(largest_bytes)),
+                                        results[largest_index].byte_counts, &res.byte_counts);
             }
         }
 
@@ -707,6 +916,9 @@ public:
         if (dg.result_limit > 0 && res.key_counts.size() > dg.result_limit) {
             scale_down_distribution(dg.result_limit, &res.key_counts);
         }
+        if (dg.result_limit > 0 && res.byte_counts.size() > dg.result_limit) {
+            scale_down_distribution(dg.result_limit, &res.byte_counts);
+        }
 
         response_out->response = res;
     }
@@ -730,8 +942,32 @@ public:
         }
     }
 
+    void operator()(UNUSED const changefeed_subscribe_t &s) {
+        *response_out = read_response_t(changefeed_subscribe_response_t());
+        auto s_response
+            = boost::get<changefeed_subscribe_response_t>(&response_out->response);
+        for (size_t i = 0; i < count; ++i) {
+            auto resp = boost::get<changefeed_subscribe_response_t>(
+                &responses[i].response);
+            guarantee(resp);
+            s_response->servers.insert(s_response->servers.end(),
+                                       resp->servers.begin(), resp->servers.end());
+        }
+    }
+
+    void operator()(UNUSED const shard_versions_t &sv) {
+        *response_out = read_response_t(shard_versions_response_t());
+        auto sv_response
+            = boost::get<shard_versions_response_t>(&response_out->response);
+        for (size_t i = 0; i < count; ++i) {
+            auto resp = boost::get<shard_versions_response_t>(&responses[i].response);
+            guarantee(resp);
+            sv_response->versions.insert(resp->versions.begin(), resp->versions.end());
+        }
+    }
+
 private:
-    const read_response_t *responses;
+    read_response_t *responses;
     size_t count;
     read_response_t *response_out;
     ql::env_t ql_env;
@@ -756,66 +992,66 @@ private:
             }
         }
 
+        deserialize_rget_stream_chunks(responses, count);
+
         rg_response->result = stream_t();
         stream_t *res_stream = boost::get<stream_t>(&rg_response->result);
 
-        if (rg.sorting == sorting_t::UNORDERED) {
-            for (size_t i = 0; i < count; ++i) {
-                // TODO: we're ignoring the limit when recombining.
-                auto rr = boost::get<rget_read_response_t>(&responses[i].response);
-                guarantee(rr != NULL);
-
-                const stream_t *stream = boost::get<stream_t>(&(rr->result));
-
-                for (auto it = stream->begin(); it != stream->end(); ++it) {
-                    if ((it->key <= rg_response->last_considered_key
-                         && !reversed(rg.sorting))
-                        || (it->key >= rg_response->last_considered_key
-                            && reversed(rg.sorting))) {
-                        res_stream->push_back(*it);
-                    }
-                }
+        // The shards' streams are moved out of rather than copied, and each one
+        // is freed as soon as it has been used up.
+        std::vector<stream_t *> streams;
+        size_t total_size = 0;
+        for (size_t i = 0; i < count; ++i) {
+            // TODO: we're ignoring the limit when recombining.
+            auto rr = boost::get<rget_read_response_t>(&responses[i].response);
+            guarantee(rr != NULL);
 
+            stream_t *stream = boost::get<stream_t>(&(rr->result));
+            guarantee(stream != NULL);
+            streams.push_back(stream);
+            total_size += stream->size();
+            if (rg.sorting == sorting_t::UNORDERED) {
                 rg_response->truncated = rg_response->truncated || rr->truncated;
             }
-        } else {
-            std::vector<std::pair<stream_t::const_iterator, stream_t::const_iterator> >
-                iterators;
-
-            for (size_t i = 0; i < count; ++i) {
-                // TODO: we're ignoring the limit when recombining.
-                auto rr = boost::get<rget_read_response_t>(&responses[i].response);
-                guarantee(rr != NULL);
-
-                const stream_t *stream = boost::get<stream_t>(&(rr->result));
-                iterators.push_back(std::make_pair(stream->begin(), stream->end()));
-            }
-
-            while (true) {
-                store_key_t key_to_beat = !reversed(rg.sorting)
-                    ? store_key_t::max() : store_key_t::min();
-                stream_t::const_iterator *value = NULL;
-
-                for (auto it = iterators.begin(); it != iterators.end(); ++it) {
-                    if (it->first == it->second) {
-                        continue;
-                    }
+        }
+        res_stream->reserve(total_size);
 
-                    if ((!reversed(rg.sorting)
-                         && it->first->key <= key_to_beat
-                         && it->first->key <= rg_response->last_considered_key)
-                        || (reversed(rg.sorting)
-                            && it->first->key >= key_to_beat
-                            && it->first->key >= rg_response->last_considered_key)) {
-                        key_to_beat = it->first->key;
-                        value = &it->first;
+        const rget_key_cutoff_t cutoff(rg_response->last_considered_key,
+                                       reversed(rg.sorting));
+        if (rg.sorting == sorting_t::UNORDERED) {
+            for (auto it = streams.begin(); it != streams.end(); ++it) {
+                for (auto jt = (*it)->begin(); jt != (*it)->end(); ++jt) {
+                    if (cutoff.admits(jt->key)) {
+                        res_stream->push_back(std::move(*jt));
                     }
                 }
-                if (value != NULL) {
-                    res_stream->push_back(**value);
-                    ++(*value);
+                stream_t().swap(**it);
+            }
+        } else {
+            /* Each shard's stream is already sorted, so this is a k-way merge
+            with a heap of the streams that still have items before the
+            cutoff, ordered by their next key. */
+            std::vector<rget_merge_head_t> heads;
+            for (auto it = streams.begin(); it != streams.end(); ++it) {
+                if (!(*it)->empty() && cutoff.admits((*it)->front().key)) {
+                    heads.push_back(rget_merge_head_t(*it));
+                } else {
+                    stream_t().swap(**it);
+                }
+            }
+            const rget_merge_head_later_t later(reversed(rg.sorting));
+            std::make_heap(heads.begin(), heads.end(), later);
+            while (!heads.empty()) {
+                std::pop_heap(heads.begin(), heads.end(), later);
+                rget_merge_head_t *head = &heads.back();
+                res_stream->push_back(std::move((*head->stream)[head->pos]));
+                ++head->pos;
+                if (head->pos < head->stream->size()
+                    && cutoff.admits((*head->stream)[head->pos].key)) {
+                    std::push_heap(heads.begin(), heads.end(), later);
                 } else {
-                    break;
+                    stream_t().swap(*head->stream);
+                    heads.pop_back();
                 }
             }
         }
@@ -891,16 +1127,47 @@ private:
                             = rhs_arr->get(f)->get("group");
                         counted_t<const ql::datum_t> val
                             = rhs_arr->get(f)->get("reduction");
-                        if (!map->has(key)) {
-                            map->set(key, val);
-                        } else {
+                        if (counted_t<const ql::datum_t> *acc = map->find(key)) {
                             counted_t<ql::func_t> r
                                 = local_gmr_func.compile_reduce();
-                            map->set(key, r->call(&ql_env, map->get(key), val)->as_datum());
+                            *acc = r->call(&ql_env, *acc, val)->as_datum();
+                        } else {
+                            map->set(key, val);
                         }
                     }
                 }
                 boost::get<ql::wire_datum_map_t>(rg_response->result).finalize();
+            } else if (const ql::top_k_wire_func_t *top_k_func =
+                    boost::get<ql::top_k_wire_func_t>(&*rg.terminal)) {
+                rg_response->result = rget_read_response_t::top_k_t();
+                rget_read_response_t::top_k_t *top =
+                    boost::get<rget_read_response_t::top_k_t>(&rg_response->result);
+
+                for (size_t i = 0; i < count; ++i) {
+                    const rget_read_response_t *_rr =
+                        boost::get<rget_read_response_t>(&responses[i].response);
+                    guarantee(_rr);
+                    const rget_read_response_t::top_k_t *rhs =
+                        boost::get<rget_read_response_t::top_k_t>(&(_rr->result));
+                    r_sanity_check(rhs);
+                    for (auto it = rhs->begin(); it != rhs->end(); ++it) {
+                        top_k_func->add(&ql_env, *it, top);
+                    }
+                }
+            } else if (const ql::sample_wire_func_t *sample_func =
+                    boost::get<ql::sample_wire_func_t>(&*rg.terminal)) {
+                rg_response->result = ql::reservoir_t();
+                ql::reservoir_t *reservoir =
+                    boost::get<ql::reservoir_t>(&rg_response->result);
+
+                for (size_t i = 0; i < count; ++i) {
+                    rget_read_response_t *_rr =
+                        boost::get<rget_read_response_t>(&responses[i].response);
+                    guarantee(_rr);
+                    ql::reservoir_t *rhs = boost::get<ql::reservoir_t>(&(_rr->result));
+                    r_sanity_check(rhs);
+                    sample_func->merge(std::move(*rhs), reservoir);
+                }
             } else {
                 unreachable();
             }
@@ -947,7 +1214,8 @@ void read_t::unshard(read_response_t *responses, size_t count,
 
 // TODO: This entire type is suspect, given the performance for
 // batched_replaces_t.  Is it used in anything other than assertions?
-region_t region_from_keys(const std::vector<store_key_t> &keys) {
+region_t region_from_keys(const std::vector<store_key_t> &keys,
+                          const std::vector<uint64_t> &key_hashes) {
     // It shouldn't be empty, but we let the places that would break use a
     // guarantee.
     rassert(!keys.empty());
@@ -960,8 +1228,8 @@ region_t region_from_keys(const std::vector<store_key_t> &keys) {
     uint64_t min_hash_value = HASH_REGION_HASH_SIZE - 1;
     uint64_t max_hash_value = 0;
 
-    for (auto it = keys.begin(); it != keys.end(); ++it) {
-        const store_key_t &key = *it;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        const store_key_t &key = keys[i];
         if (key < min_key) {
             min_key = key;
         }
@@ -969,7 +1237,7 @@ region_t region_from_keys(const std::vector<store_key_t> &keys) {
             max_key = key;
         }
 
-        const uint64_t hash_value = hash_region_hasher(key.contents(), key.size());
+        const uint64_t hash_value = batch_key_hash(key_hashes, i, key);
         if (hash_value < min_hash_value) {
             min_hash_value = hash_value;
         }
@@ -985,7 +1253,7 @@ region_t region_from_keys(const std::vector<store_key_t> &keys) {
 
 struct rdb_w_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const batched_replace_t &br) const {
-        return region_from_keys(br.keys);
+        return region_from_keys(br.keys, br.key_hashes);
     }
     region_t operator()(const batched_insert_t &bi) const {
         std::vector<store_key_t> keys;
@@ -993,7 +1261,7 @@ struct rdb_w_get_region_visitor : public boost::static_visitor<region_t> {
         for (auto it = bi.inserts.begin(); it != bi.inserts.end(); ++it) {
             keys.emplace_back((*it)->get(bi.pkey)->print_primary());
         }
-        return region_from_keys(keys);
+        return region_from_keys(keys, bi.key_hashes);
     }
 
     region_t operator()(const point_write_t &pw) const {
@@ -1046,9 +1314,13 @@ struct rdb_w_shard_visitor_t : public boost::static_visitor<bool> {
 
     bool operator()(const batched_replace_t &br) const {
         std::vector<store_key_t> shard_keys;
-        for (auto it = br.keys.begin(); it != br.keys.end(); ++it) {
-            if (region_contains_key(*region, *it)) {
-                shard_keys.push_back(*it);
+        std::vector<uint64_t> shard_key_hashes;
+        for (size_t i = 0; i < br.keys.size(); ++i) {
+            const uint64_t hash_value = batch_key_hash(br.key_hashes, i, br.keys[i]);
+            if (region_contains_key_with_precomputed_hash(*region, br.keys[i],
+                                                          hash_value)) {
+                shard_keys.push_back(br.keys[i]);
+                shard_key_hashes.push_back(hash_value);
             }
         }
         if (!shard_keys.empty()) {
@@ -1058,7 +1330,8 @@ struct rdb_w_shard_visitor_t : public boost::static_visitor<bool> {
                     br.pkey,
                     br.f.compile_wire_func(),
                     br.optargs,
-                    br.return_vals),
+                    br.return_vals,
+                    std::move(shard_key_hashes)),
                 durability_requirement,
                 profile);
             return true;
@@ -1069,16 +1342,30 @@ struct rdb_w_shard_visitor_t : public boost::static_visitor<bool> {
 
     bool operator()(const batched_insert_t &bi) const {
         std::vector<counted_t<const ql::datum_t> > shard_inserts;
-        for (auto it = bi.inserts.begin(); it != bi.inserts.end(); ++it) {
-            store_key_t key((*it)->get(bi.pkey)->print_primary());
-            if (region_contains_key(*region, key)) {
-                shard_inserts.push_back(*it);
+        std::vector<uint64_t> shard_key_hashes;
+        for (size_t i = 0; i < bi.inserts.size(); ++i) {
+            // Printing the primary key is the expensive part, so it's only done for
+            // the inserts whose hash is in the region.
+            uint64_t hash_value;
+            if (bi.key_hashes.empty()) {
+                const store_key_t key(bi.inserts[i]->get(bi.pkey)->print_primary());
+                hash_value = hash_region_hasher(key.contents(), key.size());
+            } else {
+                hash_value = bi.key_hashes[i];
+            }
+            if (region->beg <= hash_value && hash_value < region->end) {
+                const store_key_t key(bi.inserts[i]->get(bi.pkey)->print_primary());
+                if (region->inner.contains_key(key)) {
+                    shard_inserts.push_back(bi.inserts[i]);
+                    shard_key_hashes.push_back(hash_value);
+                }
             }
         }
         if (!shard_inserts.empty()) {
             *write_out = write_t(
                 batched_insert_t(
-                    std::move(shard_inserts), bi.pkey, bi.upsert, bi.return_vals),
+                    std::move(shard_inserts), bi.pkey, bi.upsert, bi.return_vals,
+                    std::move(shard_key_hashes)),
                 durability_requirement,
                 profile);
             return true;
@@ -1130,7 +1417,11 @@ struct rdb_w_shard_visitor_t : public boost::static_visitor<bool> {
 bool write_t::shard(const region_t &region,
                     write_t *write_out) const THROWS_NOTHING {
     const rdb_w_shard_visitor_t v(&region, durability_requirement, profile, write_out);
-    return boost::apply_visitor(v, write);
+    if (!boost::apply_visitor(v, write)) {
+        return false;
+    }
+    write_out->query_priority = query_priority;
+    return true;
 }
 
 template <class T>
@@ -1227,8 +1518,14 @@ store_t::store_t(serializer_t *serializer,
                  const base_path_t &base_path) :
     btree_store_t<rdb_protocol_t>(serializer, perfmon_name, cache_target,
             create, parent_perfmon_collection, _ctx, io, base_path),
+    version_id(generate_uuid()),
+    write_version(0),
     ctx(_ctx)
 {
+    if (ctx != NULL && ctx->mailbox_manager != NULL) {
+        changefeed_server.init(new ql::changefeed::server_t(ctx->mailbox_manager));
+    }
+
     // Make sure to continue bringing sindexes up-to-date if it was interrupted earlier
 
     // This uses a dummy interruptor because this is the only thing using the store at
@@ -1267,6 +1564,7 @@ store_t::store_t(serializer_t *serializer,
 
 store_t::~store_t() {
     assert_thread();
+    stop_defragmenter();
 }
 
 // TODO: get rid of this extra response_t copy on the stack
@@ -1275,7 +1573,16 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         response->response = point_read_response_t();
         point_read_response_t *res =
             boost::get<point_read_response_t>(&response->response);
-        rdb_get(get.key, btree, superblock, res, ql_env.trace.get_or_null());
+        rdb_buffered_get(get.key, btree, &store->write_buffer, superblock, res,
+                         ql_env.trace.get_or_null());
+    }
+
+    void operator()(const batched_point_read_t &get) {
+        response->response = batched_point_read_response_t();
+        batched_point_read_response_t *res =
+            boost::get<batched_point_read_response_t>(&response->response);
+        rdb_buffered_batched_get(get.keys, btree, &store->write_buffer, superblock,
+                                 res, ql_env.trace.get_or_null());
     }
 
     void operator()(const rget_read_t &rget) {
@@ -1330,9 +1637,26 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             success = deserialize(&read_stream, &multi_bool);
             guarantee_deserialization(success, "sindex description");
 
+            if (rget.sindex->geo_region && multi_bool != sindex_multi_bool_t::GEO) {
+                res->result = ql::datum_exc_t(
+                    ql::base_exc_t::GENERIC,
+                    strprintf("Index `%s` is not a geo index.",
+                              rget.sindex->id.c_str()));
+                return;
+            }
+            if (!rget.sindex->text_words.empty()
+                && multi_bool != sindex_multi_bool_t::TEXT) {
+                res->result = ql::datum_exc_t(
+                    ql::base_exc_t::GENERIC,
+                    strprintf("Index `%s` is not a text index.",
+                              rget.sindex->id.c_str()));
+                return;
+            }
+
             rdb_rget_secondary_slice(
                 store->get_sindex_slice(rget.sindex->id),
                 rget.sindex->original_range, rget.sindex->region,
+                rget.sindex->geo_region, rget.sindex->text_words,
                 sindex_sb.get(), &ql_env, rget.batchspec, rget.transform,
                 rget.terminal, rget.region.inner, rget.sorting,
                 sindex_mapping, multi_bool, res);
@@ -1342,22 +1666,24 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
     void operator()(const distribution_read_t &dg) {
         response->response = distribution_read_response_t();
         distribution_read_response_t *res = boost::get<distribution_read_response_t>(&response->response);
-        rdb_distribution_get(dg.max_depth, dg.region.inner.left,
-                             superblock, res);
-        for (std::map<store_key_t, int64_t>::iterator it = res->key_counts.begin(); it != res->key_counts.end(); ) {
-            if (!dg.region.inner.contains_key(store_key_t(it->first))) {
-                std::map<store_key_t, int64_t>::iterator tmp = it;
-                ++it;
-                res->key_counts.erase(tmp);
-            } else {
-                ++it;
-            }
+        if (dg.method == distribution_method_t::SAMPLE) {
+            rdb_distribution_sample(DISTRIBUTION_SAMPLE_LEAVES,
+                                    DISTRIBUTION_SAMPLE_BUCKETS,
+                                    dg.region.inner.left, superblock, res);
+        } else {
+            rdb_distribution_get(dg.max_depth, dg.region.inner.left,
+                                 superblock, res);
         }
+        erase_keys_outside_range(dg.region.inner, &res->key_counts);
+        erase_keys_outside_range(dg.region.inner, &res->byte_counts);
 
         // If the result is larger than the requested limit, scale it down
         if (dg.result_limit > 0 && res->key_counts.size() > dg.result_limit) {
             scale_down_distribution(dg.result_limit, &res->key_counts);
         }
+        if (dg.result_limit > 0 && res->byte_counts.size() > dg.result_limit) {
+            scale_down_distribution(dg.result_limit, &res->byte_counts);
+        }
 
         res->region = dg.region;
     }
@@ -1381,6 +1707,23 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         }
     }
 
+    void operator()(const changefeed_subscribe_t &s) {
+        superblock->release();
+        response->response = changefeed_subscribe_response_t();
+        if (changefeed_server != NULL) {
+            changefeed_server->add_client(s.id, s.addr);
+            boost::get<changefeed_subscribe_response_t>(&response->response)
+                ->servers.push_back(changefeed_server->get_stop_address());
+        }
+    }
+
+    void operator()(UNUSED const shard_versions_t &sv) {
+        superblock->release();
+        response->response = shard_versions_response_t();
+        boost::get<shard_versions_response_t>(&response->response)
+            ->versions[store->version_id] = store->write_version;
+    }
+
     void operator()(const sindex_status_t &sindex_status) {
         response->response = sindex_status_response_t();
         auto res = &boost::get<sindex_status_response_t>(response->response);
@@ -1409,6 +1752,13 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
                     } else {
                         s->blocks_processed = frac.estimate_of_released_nodes;
                         s->blocks_total = frac.estimate_of_total_nodes;
+                        if (s->blocks_processed > 0
+                            && s->blocks_total > s->blocks_processed) {
+                            s->secs_remaining =
+                                store->get_progress_elapsed_secs(it->second.id)
+                                * (s->blocks_total - s->blocks_processed)
+                                / s->blocks_processed;
+                        }
                     }
                 }
             }
@@ -1416,7 +1766,8 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
     }
 
     rdb_read_visitor_t(btree_slice_t *_btree,
-                       btree_store_t<rdb_protocol_t> *_store,
+                       store_t *_store,
+                       ql::changefeed::server_t *_changefeed_server,
                        superblock_t *_superblock,
                        rdb_protocol_t::context_t *ctx,
                        read_response_t *_response,
@@ -1425,14 +1776,13 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         response(_response),
         btree(_btree),
         store(_store),
+        changefeed_server(_changefeed_server),
         superblock(_superblock),
         interruptor(_interruptor, ctx->signals[get_thread_id().threadnum].get()),
         ql_env(ctx->extproc_pool,
                ctx->ns_repo,
-               ctx->cross_thread_namespace_watchables[get_thread_id().threadnum].get()
-                   ->get_watchable(),
-               ctx->cross_thread_database_watchables[get_thread_id().threadnum].get()
-                   ->get_watchable(),
+               ctx->cross_thread_namespace_watchables->get_watchable(),
+               ctx->cross_thread_database_watchables->get_watchable(),
                ctx->cluster_metadata,
                NULL,
                &interruptor,
@@ -1455,7 +1805,8 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
 private:
     read_response_t *response;
     btree_slice_t *btree;
-    btree_store_t<rdb_protocol_t> *store;
+    store_t *store;
+    ql::changefeed::server_t *changefeed_server;
     superblock_t *superblock;
     wait_any_t interruptor;
     ql::env_t ql_env;
@@ -1469,7 +1820,7 @@ void store_t::protocol_read(const read_t &read,
                             superblock_t *superblock,
                             signal_t *interruptor) {
     rdb_read_visitor_t v(
-        btree, this,
+        btree, this, changefeed_server.get_or_null(),
         superblock,
         ctx, response, read.profile, interruptor);
     {
@@ -1529,20 +1880,29 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
     void operator()(const batched_replace_t &br) {
         ql_env.global_optargs.init_optargs(br.optargs);
         rdb_modification_report_cb_t sindex_cb(
-            store, &sindex_block,
+            store, changefeed_server, &sindex_block,
             auto_drainer_t::lock_t(&store->drainer));
         func_replacer_t replacer(&ql_env, br.f, br.return_vals);
-        response->response =
-            rdb_batched_replace(
-                btree_info_t(btree, timestamp,
-                             &br.pkey),
-                superblock, br.keys, &replacer, &sindex_cb,
-                ql_env.trace.get_or_null());
+        if (store->buffers_writes()) {
+            response->response =
+                rdb_buffered_batched_replace(
+                    btree_info_t(btree, timestamp, &br.pkey),
+                    &store->write_buffer, superblock, br.keys, &replacer, &sindex_cb,
+                    ql_env.trace.get_or_null());
+        } else {
+            response->response =
+                rdb_batched_replace(
+                    btree_info_t(btree, timestamp,
+                                 &br.pkey),
+                    superblock, br.keys, &replacer, &sindex_cb,
+                    ql_env.trace.get_or_null());
+        }
     }
 
     void operator()(const batched_insert_t &bi) {
         rdb_modification_report_cb_t sindex_cb(
             store,
+            changefeed_server,
             &sindex_block,
             auto_drainer_t::lock_t(&store->drainer));
         datum_replacer_t replacer(&bi.inserts, bi.upsert, bi.pkey, bi.return_vals);
@@ -1551,12 +1911,20 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         for (auto it = bi.inserts.begin(); it != bi.inserts.end(); ++it) {
             keys.emplace_back((*it)->get(bi.pkey)->print_primary());
         }
-        response->response =
-            rdb_batched_replace(
-                btree_info_t(btree, timestamp,
-                             &bi.pkey),
-                superblock, keys, &replacer, &sindex_cb,
-                ql_env.trace.get_or_null());
+        if (store->buffers_writes()) {
+            response->response =
+                rdb_buffered_batched_replace(
+                    btree_info_t(btree, timestamp, &bi.pkey),
+                    &store->write_buffer, superblock, keys, &replacer, &sindex_cb,
+                    ql_env.trace.get_or_null());
+        } else {
+            response->response =
+                rdb_batched_replace(
+                    btree_info_t(btree, timestamp,
+                                 &bi.pkey),
+                    superblock, keys, &replacer, &sindex_cb,
+                    ql_env.trace.get_or_null());
+        }
     }
 
     void operator()(const point_write_t &w) {
@@ -1565,8 +1933,14 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
             boost::get<point_write_response_t>(&response->response);
 
         rdb_modification_report_t mod_report(w.key);
-        rdb_set(w.key, w.data, w.overwrite, btree, timestamp, superblock->get(),
-                res, &mod_report.info, ql_env.trace.get_or_null());
+        if (store->buffers_writes()) {
+            rdb_buffered_set(w.key, w.data, w.overwrite, btree, &store->write_buffer,
+                             timestamp, superblock->get(), res, &mod_report.info,
+                             ql_env.trace.get_or_null());
+        } else {
+            rdb_set(w.key, w.data, w.overwrite, btree, timestamp, superblock->get(),
+                    res, &mod_report.info, ql_env.trace.get_or_null());
+        }
 
         update_sindexes(&mod_report);
     }
@@ -1577,8 +1951,14 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
             boost::get<point_delete_response_t>(&response->response);
 
         rdb_modification_report_t mod_report(d.key);
-        rdb_delete(d.key, btree, timestamp, superblock->get(), res,
-                &mod_report.info, ql_env.trace.get_or_null());
+        if (store->buffers_writes()) {
+            rdb_buffered_delete(d.key, btree, &store->write_buffer, timestamp,
+                                superblock->get(), res, &mod_report.info,
+                                ql_env.trace.get_or_null());
+        } else {
+            rdb_delete(d.key, btree, timestamp, superblock->get(), res,
+                    &mod_report.info, ql_env.trace.get_or_null());
+        }
 
         update_sindexes(&mod_report);
     }
@@ -1637,6 +2017,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
 
     rdb_write_visitor_t(btree_slice_t *_btree,
                         btree_store_t<rdb_protocol_t> *_store,
+                        ql::changefeed::server_t *_changefeed_server,
                         txn_t *_txn,
                         scoped_ptr_t<superblock_t> *_superblock,
                         repli_timestamp_t _timestamp,
@@ -1645,6 +2026,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
                         signal_t *_interruptor) :
         btree(_btree),
         store(_store),
+        changefeed_server(_changefeed_server),
         txn(_txn),
         response(_response),
         superblock(_superblock),
@@ -1652,8 +2034,8 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         interruptor(_interruptor, ctx->signals[get_thread_id().threadnum].get()),
         ql_env(ctx->extproc_pool,
                ctx->ns_repo,
-               ctx->cross_thread_namespace_watchables[get_thread_id().threadnum].get()->get_watchable(),
-               ctx->cross_thread_database_watchables[get_thread_id().threadnum].get()->get_watchable(),
+               ctx->cross_thread_namespace_watchables->get_watchable(),
+               ctx->cross_thread_database_watchables->get_watchable(),
                ctx->cluster_metadata,
                NULL,
                &interruptor,
@@ -1689,10 +2071,15 @@ private:
         store->acquire_post_constructed_sindex_superblocks_for_write(&sindex_block,
                                                                      &sindexes);
         rdb_update_sindexes(sindexes, mod_report, txn);
+
+        if (changefeed_server != NULL) {
+            changefeed_server->send_all(*mod_report);
+        }
     }
 
     btree_slice_t *btree;
     btree_store_t<rdb_protocol_t> *store;
+    ql::changefeed::server_t *changefeed_server;
     txn_t *txn;
     write_response_t *response;
     scoped_ptr_t<superblock_t> *superblock;
@@ -1710,7 +2097,7 @@ void store_t::protocol_write(const write_t &write,
                              btree_slice_t *btree,
                              scoped_ptr_t<superblock_t> *superblock,
                              signal_t *interruptor) {
-    rdb_write_visitor_t v(btree, this,
+    rdb_write_visitor_t v(btree, this, changefeed_server.get_or_null(),
                           (*superblock)->expose_buf().txn(),
                           superblock,
                           timestamp.to_repli_timestamp(), ctx,
@@ -1719,6 +2106,9 @@ void store_t::protocol_write(const write_t &write,
         profile::starter_t start_write("Perform write on shard.", v.get_env()->trace);
         boost::apply_visitor(v, write.write);
     }
+    // Only once the write is done, so that a `shard_versions_t` read that sees the
+    // new version is followed by reads that see the write.
+    ++write_version;
 
     response->n_shards = 1;
     response->event_log = v.extract_event_log();
@@ -1735,8 +2125,12 @@ struct rdb_backfill_chunk_get_btree_repli_timestamp_visitor_t : public boost::st
         return repli_timestamp_t::invalid;
     }
 
-    repli_timestamp_t operator()(const backfill_chunk_t::key_value_pair_t &kv) {
-        return kv.backfill_atom.recency;
+    repli_timestamp_t operator()(const backfill_chunk_t::key_value_pairs_t &kvs) {
+        repli_timestamp_t recency = repli_timestamp_t::distant_past;
+        for (auto it = kvs.backfill_atoms.begin(); it != kvs.backfill_atoms.end(); ++it) {
+            recency = superceding_recency(recency, it->recency);
+        }
+        return recency;
     }
 
     repli_timestamp_t operator()(const backfill_chunk_t::sindexes_t &) {
@@ -1754,39 +2148,76 @@ public:
     typedef backfill_chunk_t chunk_t;
 
     explicit rdb_backfill_callback_impl_t(chunk_fun_callback_t<rdb_protocol_t> *_chunk_fun_cb)
-        : chunk_fun_cb(_chunk_fun_cb) { }
+        : chunk_fun_cb(_chunk_fun_cb), batch_size(0) { }
     ~rdb_backfill_callback_impl_t() { }
 
-    void on_delete_range(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
-        chunk_fun_cb->send_chunk(chunk_t::delete_range(region_t(range)), interruptor);
+    void on_delete_range(const region_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        mutex_t::acq_t acq(&send_mutex);
+        send_batch_locked(interruptor);
+        chunk_fun_cb->send_chunk(chunk_t::delete_range(range), interruptor);
     }
 
     void on_deletion(const btree_key_t *key, repli_timestamp_t recency, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        mutex_t::acq_t acq(&send_mutex);
+        send_batch_locked(interruptor);
         chunk_fun_cb->send_chunk(chunk_t::delete_key(to_store_key(key), recency), interruptor);
     }
 
     void on_keyvalue(const rdb_backfill_atom_t &atom, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
-        chunk_fun_cb->send_chunk(chunk_t::set_key(atom), interruptor);
+        batch.push_back(atom);
+        batch_size += atom.key.size() + serialized_size(atom.value);
+        if (batch_size >= BACKFILL_BATCH_SIZE) {
+            send_batch(interruptor);
+        }
     }
 
     void on_sindexes(const std::map<std::string, secondary_index_t> &sindexes, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        mutex_t::acq_t acq(&send_mutex);
+        send_batch_locked(interruptor);
         chunk_fun_cb->send_chunk(chunk_t::sindexes(sindexes), interruptor);
     }
 
+    void on_progress(const region_t &sent_region, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        mutex_t::acq_t acq(&send_mutex);
+        send_batch_locked(interruptor);
+        chunk_fun_cb->send_progress(sent_region, interruptor);
+    }
+
+    // Sends the rows that haven't been sent yet.  Must be called once the
+    // traversal is over.
+    void send_batch(signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        mutex_t::acq_t acq(&send_mutex);
+        send_batch_locked(interruptor);
+    }
+
 protected:
     store_key_t to_store_key(const btree_key_t *key) {
         return store_key_t(key->size, key->contents);
     }
 
 private:
+    void send_batch_locked(signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+        if (!batch.empty()) {
+            std::vector<rdb_backfill_atom_t> atoms;
+            atoms.swap(batch);
+            batch_size = 0;
+            chunk_fun_cb->send_chunk(chunk_t::set_keys(atoms), interruptor);
+        }
+    }
+
     chunk_fun_callback_t<rdb_protocol_t> *chunk_fun_cb;
+    std::vector<rdb_backfill_atom_t> batch;
+    size_t batch_size;
+    // Held while sending, so that a progress message can't overtake a batch
+    // that another leaf's coroutine took out of `batch` but is still sending.
+    mutex_t send_mutex;
 
     DISABLE_COPYING(rdb_backfill_callback_impl_t);
 };
 
 void call_rdb_backfill(int i, btree_slice_t *btree,
                        const std::vector<std::pair<region_t, state_timestamp_t> > &regions,
-                       rdb_backfill_callback_t *callback,
+                       chunk_fun_callback_t<rdb_protocol_t> *chunk_fun_cb,
                        superblock_t *superblock,
                        buf_lock_t *sindex_block,
                        backfill_progress_t *progress,
@@ -1795,9 +2226,13 @@ void call_rdb_backfill(int i, btree_slice_t *btree,
     scoped_ptr_t<traversal_progress_t> p_owned(p);
     progress->add_constituent(&p_owned);
     repli_timestamp_t timestamp = regions[i].second.to_repli_timestamp();
+    // Each region batches its own rows, so that a batch is a run of consecutive
+    // keys.
+    rdb_backfill_callback_impl_t callback(chunk_fun_cb);
     try {
-        rdb_backfill(btree, regions[i].first.inner, timestamp, callback,
+        rdb_backfill(btree, regions[i].first, timestamp, &callback,
                      superblock, sindex_block, p, interruptor);
+        callback.send_batch(interruptor);
     } catch (const interrupted_exc_t &) {
         /* do nothing; `protocol_send_backfill()` will notice that interruptor
         has been pulsed */
@@ -1813,11 +2248,10 @@ void store_t::protocol_send_backfill(const region_map_t<rdb_protocol_t, state_ti
                                      signal_t *interruptor)
                                      THROWS_ONLY(interrupted_exc_t) {
     with_priority_t p(CORO_PRIORITY_BACKFILL_SENDER);
-    rdb_backfill_callback_impl_t callback(chunk_fun_cb);
     std::vector<std::pair<region_t, state_timestamp_t> > regions(start_point.begin(), start_point.end());
     refcount_superblock_t refcount_wrapper(superblock, regions.size());
     pmap(regions.size(), std::bind(&call_rdb_backfill, ph::_1,
-                                   btree, regions, &callback,
+                                   btree, regions, chunk_fun_cb,
                                    &refcount_wrapper, sindex_block, progress,
                                    interruptor));
 
@@ -1843,12 +2277,13 @@ struct rdb_receive_backfill_visitor_t : public boost::static_visitor<void> {
 
     void operator()(const backfill_chunk_t::delete_key_t &delete_key) {
         point_delete_response_t response;
-        rdb_modification_report_t mod_report(delete_key.key);
+        std::vector<rdb_modification_report_t> mod_reports(
+            1, rdb_modification_report_t(delete_key.key));
         rdb_delete(delete_key.key, btree, delete_key.recency,
-                   superblock, &response, &mod_report.info,
+                   superblock, &response, &mod_reports[0].info,
                    static_cast<profile::trace_t *>(NULL));
 
-        update_sindexes(&mod_report);
+        update_sindexes(mod_reports);
     }
 
     void operator()(const backfill_chunk_t::delete_range_t &delete_range) {
@@ -1859,16 +2294,19 @@ struct rdb_receive_backfill_visitor_t : public boost::static_visitor<void> {
                         interruptor);
     }
 
-    void operator()(const backfill_chunk_t::key_value_pair_t &kv) {
-        const rdb_backfill_atom_t& bf_atom = kv.backfill_atom;
-        point_write_response_t response;
-        rdb_modification_report_t mod_report(bf_atom.key);
-        rdb_set(bf_atom.key, bf_atom.value, true,
-                btree, bf_atom.recency,
-                superblock, &response,
-                &mod_report.info, static_cast<profile::trace_t *>(NULL));
+    void operator()(const backfill_chunk_t::key_value_pairs_t &kvs) {
+        std::vector<rdb_modification_report_t> mod_reports;
+        mod_reports.reserve(kvs.backfill_atoms.size());
+        for (auto it = kvs.backfill_atoms.begin(); it != kvs.backfill_atoms.end(); ++it) {
+            point_write_response_t response;
+            mod_reports.push_back(rdb_modification_report_t(it->key));
+            rdb_set(it->key, it->value, true,
+                    btree, it->recency,
+                    superblock, &response,
+                    &mod_reports.back().info, static_cast<profile::trace_t *>(NULL));
+        }
 
-        update_sindexes(&mod_report);
+        update_sindexes(mod_reports);
     }
 
     void operator()(const backfill_chunk_t::sindexes_t &s) {
@@ -1891,18 +2329,20 @@ struct rdb_receive_backfill_visitor_t : public boost::static_visitor<void> {
     }
 
 private:
-    void update_sindexes(rdb_modification_report_t *mod_report) {
+    void update_sindexes(const std::vector<rdb_modification_report_t> &mod_reports) {
         mutex_t::acq_t acq;
         store->lock_sindex_queue(&sindex_block, &acq);
 
-        write_message_t wm;
-        wm << rdb_sindex_change_t(*mod_report);
-        store->sindex_queue_push(wm, &acq);
+        for (auto it = mod_reports.begin(); it != mod_reports.end(); ++it) {
+            write_message_t wm;
+            wm << rdb_sindex_change_t(*it);
+            store->sindex_queue_push(wm, &acq);
+        }
 
         sindex_access_vector_t sindexes;
         store->acquire_post_constructed_sindex_superblocks_for_write(
                 &sindex_block, &sindexes);
-        rdb_update_sindexes(sindexes, mod_report, txn);
+        rdb_update_sindexes(sindexes, mod_reports, txn);
     }
 
     btree_store_t<rdb_protocol_t> *store;
@@ -1925,6 +2365,7 @@ void store_t::protocol_receive_backfill(btree_slice_t *btree,
                                      superblock,
                                      interruptor);
     boost::apply_visitor(v, chunk.val);
+    ++write_version;
 }
 
 void store_t::protocol_reset_data(const region_t& subregion,
@@ -1942,6 +2383,43 @@ void store_t::protocol_reset_data(const region_t& subregion,
                     &sindex_block,
                     superblock, this,
                     interruptor);
+    ++write_version;
+}
+
+bool store_t::protocol_defragment_leaves(btree_slice_t *btree,
+                                        superblock_t *superblock,
+                                        store_key_t *start_key,
+                                        int max_leaves) {
+    value_sizer_t<rdb_value_t> sizer(btree->cache()->get_block_size());
+    return btree_defragment_leaves(&sizer, superblock, start_key, max_leaves);
+}
+
+// Only the writes of documents go through the write buffer.
+struct write_can_be_buffered_visitor_t : public boost::static_visitor<bool> {
+    bool operator()(const batched_replace_t &) const { return true; }
+    bool operator()(const batched_insert_t &) const { return true; }
+    bool operator()(const point_write_t &) const { return true; }
+    bool operator()(const point_delete_t &) const { return true; }
+    bool operator()(const sindex_create_t &) const { return false; }
+    bool operator()(const sindex_drop_t &) const { return false; }
+    bool operator()(const sync_t &) const { return false; }
+};
+
+bool store_t::protocol_write_can_be_buffered(const write_t &write) {
+    return boost::apply_visitor(write_can_be_buffered_visitor_t(), write.write);
+}
+
+bool store_t::protocol_read_merges_write_buffer(const read_t &read) {
+    // See rdb_buffered_get and rdb_buffered_batched_get.
+    return boost::get<point_read_t>(&read.read) != NULL
+        || boost::get<batched_point_read_t>(&read.read) != NULL;
+}
+
+void store_t::protocol_flush_write_buffer(
+        btree_slice_t *btree,
+        superblock_t *superblock,
+        const btree_write_buffer_t::message_map_t &messages) {
+    rdb_flush_write_buffer(btree, superblock, messages);
 }
 
 region_t rdb_protocol_t::cpu_sharding_subspace(int subregion_number,
@@ -1960,22 +2438,96 @@ region_t rdb_protocol_t::cpu_sharding_subspace(int subregion_number,
 }
 
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_details::rget_item_t, key, sindex_key, data);
-RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_details::single_sindex_status_t,
-                           blocks_total, blocks_processed, ready);
+RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_details::single_sindex_status_t,
+                           blocks_total, blocks_processed, ready, secs_remaining);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_read_response_t, data);
-RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::rget_read_response_t,
-                           result, key_range, truncated, last_considered_key);
-RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::distribution_read_response_t,
-                           region, key_counts);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::batched_point_read_response_t, rows);
+// A `stream_t` result is sent as chunks of RGET_RESPONSE_CHUNK_ITEMS items, each
+// prefixed by its size, that are left serialized when we deserialize the response.
+void rdb_protocol_t::rget_read_response_t::rdb_serialize(
+        write_message_t &msg /* NOLINT */) const {
+    const stream_t *stream = boost::get<stream_t>(&result);
+    msg << (stream != NULL);
+    if (stream == NULL) {
+        msg << result;
+    } else {
+        const size_t num_chunks = stream_chunks.size()
+            + ceil_divide(stream->size(), RGET_RESPONSE_CHUNK_ITEMS);
+        serialize_varint_uint64(&msg, num_chunks);
+        // Chunks we haven't deserialized yet come before any items in `stream`.
+        for (auto it = stream_chunks.begin(); it != stream_chunks.end(); ++it) {
+            serialize_varint_uint64(&msg, it->size());
+            msg.append(it->data(), it->size());
+        }
+        for (size_t i = 0; i < stream->size(); i += RGET_RESPONSE_CHUNK_ITEMS) {
+            const size_t end = std::min<size_t>(stream->size(),
+                                                i + RGET_RESPONSE_CHUNK_ITEMS);
+            write_message_t chunk_msg;
+            serialize_varint_uint64(&chunk_msg, end - i);
+            for (size_t j = i; j < end; ++j) {
+                chunk_msg << (*stream)[j];
+            }
+            serialize_varint_uint64(&msg, chunk_msg.size());
+            intrusive_list_t<write_buffer_t> *buffers
+                = chunk_msg.unsafe_expose_buffers();
+            for (write_buffer_t *b = buffers->head(); b != NULL; b = buffers->next(b)) {
+                msg.append(b->get_data(), b->get_size());
+            }
+        }
+    }
+    msg << key_range;
+    msg << truncated;
+    msg << last_considered_key;
+}
+
+archive_result_t rdb_protocol_t::rget_read_response_t::rdb_deserialize(
+        read_stream_t *s) {
+    bool is_stream;
+    archive_result_t res = deserialize(s, &is_stream);
+    if (res) { return res; }
+    stream_chunks.clear();
+    if (!is_stream) {
+        res = deserialize(s, &result);
+        if (res) { return res; }
+    } else {
+        result = stream_t();
+        uint64_t num_chunks;
+        res = deserialize_varint_uint64(s, &num_chunks);
+        if (res) { return res; }
+        for (uint64_t i = 0; i < num_chunks; ++i) {
+            uint64_t chunk_size;
+            res = deserialize_varint_uint64(s, &chunk_size);
+            if (res) { return res; }
+            if (chunk_size > std::numeric_limits<size_t>::max()) {
+                return ARCHIVE_RANGE_ERROR;
+            }
+            stream_chunks.push_back(std::vector<char>(chunk_size));
+            int64_t num_read = force_read(s, stream_chunks.back().data(), chunk_size);
+            if (num_read == -1) { return ARCHIVE_SOCK_ERROR; }
+            if (static_cast<uint64_t>(num_read) < chunk_size) { return ARCHIVE_SOCK_EOF; }
+        }
+    }
+    res = deserialize(s, &key_range);
+    if (res) { return res; }
+    res = deserialize(s, &truncated);
+    if (res) { return res; }
+    res = deserialize(s, &last_considered_key);
+    return res;
+}
+RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::distribution_read_response_t,
+                           region, key_counts, byte_counts);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sindex_list_response_t, sindexes);
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::read_response_t,
                            response, event_log, n_shards);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sindex_status_response_t, statuses);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::changefeed_subscribe_response_t, servers);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::shard_versions_response_t, versions);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_read_t, key);
-RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::sindex_rangespec_t,
-                           id, region, original_range);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::batched_point_read_t, keys);
+RDB_IMPL_ME_SERIALIZABLE_5(rdb_protocol_t::sindex_rangespec_t,
+                           id, region, original_range, geo_region, text_words);
 
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(key_range_t::bound_t, int8_t,
                                       key_range_t::open, key_range_t::none);
@@ -1986,11 +2538,13 @@ RDB_IMPL_ME_SERIALIZABLE_7(rdb_protocol_t::rget_read_t,
                            region, optargs, batchspec,
                            transform, terminal, sindex, sorting);
 
-RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::distribution_read_t,
-                           max_depth, result_limit, region);
+RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::distribution_read_t,
+                           max_depth, result_limit, region, method);
 RDB_IMPL_ME_SERIALIZABLE_0(rdb_protocol_t::sindex_list_t);
 RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::sindex_status_t, sindexes, region);
-RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::read_t, read, profile);
+RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::changefeed_subscribe_t, id, addr, region);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::shard_versions_t, region);
+RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::read_t, read, profile, query_priority);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_write_response_t, result);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_delete_response_t, result);
@@ -2012,14 +2566,14 @@ RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::sindex_create_t, id, mapping, region,
 RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::sindex_drop_t, id, region);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sync_t, region);
 
-RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_t::write_t,
-                           write, durability_requirement, profile);
+RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::write_t,
+                           write, durability_requirement, profile, query_priority);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::backfill_chunk_t::delete_key_t, key);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::backfill_chunk_t::delete_range_t, range);
 
-RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::backfill_chunk_t::key_value_pair_t,
-                           backfill_atom);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::backfill_chunk_t::key_value_pairs_t,
+                           backfill_atoms);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::backfill_chunk_t::sindexes_t, sindexes);
 
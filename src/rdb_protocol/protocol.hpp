@@ -24,9 +24,13 @@
 #include "http/json/cJSON.hpp"
 #include "memcached/region.hpp"
 #include "protocol_api.hpp"
+#include "rdb_protocol/changefeed.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/geo.hpp"
 #include "rdb_protocol/profile.hpp"
+#include "rdb_protocol/query_trace_log.hpp"
 #include "rdb_protocol/rdb_protocol_json.hpp"
+#include "rdb_protocol/result_cache.hpp"
 #include "rdb_protocol/wire_func.hpp"
 #include "rdb_protocol/batching.hpp"
 #include "utils.hpp"
@@ -34,7 +38,7 @@
 class extproc_pool_t;
 class cluster_directory_metadata_t;
 template <class> class cow_ptr_t;
-template <class> class cross_thread_watchable_variable_t;
+template <class> class cross_thread_watchable_snapshots_t;
 class cross_thread_signal_t;
 class databases_semilattice_metadata_t;
 template <class> class directory_read_manager_t;
@@ -85,6 +89,17 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
         sorting_t, int8_t,
         sorting_t::UNORDERED, sorting_t::DESCENDING);
 
+enum class distribution_method_t {
+    // Counts the keys under the nodes down to some depth, supposing that every
+    // subtree holds as many keys as every other one.
+    DEPTH,
+    // Samples random leaves and builds equi-depth histograms of keys and bytes.
+    SAMPLE
+};
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
+        distribution_method_t, int8_t,
+        distribution_method_t::DEPTH, distribution_method_t::SAMPLE);
+
 namespace ql {
 class datum_t;
 class env_t;
@@ -164,7 +179,9 @@ typedef std::list<transform_variant_t> transform_t;
 
 typedef boost::variant<ql::gmr_wire_func_t,
                        ql::count_wire_func_t,
-                       ql::reduce_wire_func_t> terminal_variant_t;
+                       ql::reduce_wire_func_t,
+                       ql::top_k_wire_func_t,
+                       ql::sample_wire_func_t> terminal_variant_t;
 typedef terminal_variant_t terminal_t;
 
 void bring_sindexes_up_to_date(
@@ -192,23 +209,29 @@ struct rget_item_t {
 struct single_sindex_status_t {
     single_sindex_status_t()
         : blocks_processed(0),
-          blocks_total(0), ready(true)
+          blocks_total(0), ready(true), secs_remaining(0)
     { }
     single_sindex_status_t(size_t _blocks_processed, size_t _blocks_total, bool _ready)
         : blocks_processed(_blocks_processed),
-          blocks_total(_blocks_total), ready(_ready) { }
+          blocks_total(_blocks_total), ready(_ready), secs_remaining(0) { }
     size_t blocks_processed, blocks_total;
     bool ready;
+    // About how long until the index's blocks are all processed, going by how fast
+    // they've been processed so far (0 if we can't tell yet).
+    double secs_remaining;
 
     RDB_DECLARE_ME_SERIALIZABLE;
 };
 
 } // namespace rdb_protocol_details
 
-enum class sindex_multi_bool_t { SINGLE = 0, MULTI = 1};
+// A `GEO` index is also a multi index, of points under their geohashes (see
+// rdb_protocol/geo.hpp), and so is a `TEXT` index, of rows under the words of a
+// string (see rdb_protocol/text.hpp).
+enum class sindex_multi_bool_t { SINGLE = 0, MULTI = 1, GEO = 2, TEXT = 3 };
 
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(sindex_multi_bool_t, int8_t,
-        sindex_multi_bool_t::SINGLE, sindex_multi_bool_t::MULTI);
+        sindex_multi_bool_t::SINGLE, sindex_multi_bool_t::TEXT);
 
 class cluster_semilattice_metadata_t;
 class auth_semilattice_metadata_t;
@@ -238,19 +261,31 @@ struct rdb_protocol_t {
                   directory_read_manager_t<
                       cluster_directory_metadata_t> *_directory_read_manager,
                   uuid_u _machine_id,
-                  perfmon_collection_t *global_stats);
+                  perfmon_collection_t *global_stats,
+                  io_backender_t *_io_backender,
+                  const base_path_t &_base_path,
+                  mailbox_manager_t *_mailbox_manager);
         ~context_t();
 
         extproc_pool_t *extproc_pool;
         namespace_repo_t<rdb_protocol_t> *ns_repo;
 
-        /* These arrays contain a watchable for each thread.
-         * ie cross_thread_namespace_watchables[0] is a watchable for thread 0. */
-        scoped_array_t< scoped_ptr_t< cross_thread_watchable_variable_t< cow_ptr_t<
-            namespaces_semilattice_metadata_t<rdb_protocol_t> > > > >
+        // What queries spill data that doesn't fit in memory with, and where they
+        // put it.  If `io_backender` is NULL, they don't spill.
+        io_backender_t *io_backender;
+        base_path_t base_path;
+
+        // What the stores send changes to change feeds with.  If it's NULL, the
+        // stores don't support change feeds.
+        mailbox_manager_t *mailbox_manager;
+
+        /* These give each thread its own watchable of the metadata; call
+         * `get_watchable()` on the thread that will use it. */
+        scoped_ptr_t< cross_thread_watchable_snapshots_t< cow_ptr_t<
+            namespaces_semilattice_metadata_t<rdb_protocol_t> > > >
                 cross_thread_namespace_watchables;
-        scoped_array_t< scoped_ptr_t< cross_thread_watchable_variable_t<
-            databases_semilattice_metadata_t> > > cross_thread_database_watchables;
+        scoped_ptr_t< cross_thread_watchable_snapshots_t<
+            databases_semilattice_metadata_t> > cross_thread_database_watchables;
         boost::shared_ptr< semilattice_readwrite_view_t<
             cluster_semilattice_metadata_t> > cluster_metadata;
         boost::shared_ptr< semilattice_readwrite_view_t<auth_semilattice_metadata_t> >
@@ -266,6 +301,14 @@ struct rdb_protocol_t {
         perfmon_membership_t ql_stats_membership;
         perfmon_counter_t ql_ops_running;
         perfmon_membership_t ql_ops_running_membership;
+        perfmon_duration_sampler_t ql_query_latency;
+        perfmon_membership_t ql_query_latency_membership;
+
+        // Queries the server traced on its own, and slow ones
+        query_trace_log_t query_traces;
+
+        // The results of queries run with `result_cache: true`
+        ql::result_cache_t result_cache;
     };
 
     struct point_read_response_t {
@@ -276,12 +319,21 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    struct batched_point_read_response_t {
+        // The rows that exist, by primary key.
+        std::map<store_key_t, counted_t<const ql::datum_t> > rows;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct rget_read_response_t {
          // Present if there was no terminal
         typedef std::vector<rdb_protocol_details::rget_item_t> stream_t;
 
         class empty_t { RDB_MAKE_ME_SERIALIZABLE_0() };
 
+        // For `top_k`, the smallest elements, sorted.
+        typedef std::vector<counted_t<const ql::datum_t> > top_k_t;
+
         typedef boost::variant<
             // Error.
             ql::exc_t,
@@ -291,6 +343,8 @@ struct rdb_protocol_t {
             counted_t<const ql::datum_t>,
             empty_t, // for `reduce`, sometimes
             ql::wire_datum_map_t, // for `gmr`, always
+            top_k_t,
+            ql::reservoir_t, // for `sample`
 
             // Streaming Result.
             stream_t
@@ -301,6 +355,12 @@ struct rdb_protocol_t {
         bool truncated;
         store_key_t last_considered_key;
 
+        // A `stream_t` result goes over the wire in chunks of items, which are
+        // kept serialized here (with `result` an empty stream) until unsharding
+        // turns them into datums, so that it can be done on several threads.
+        // This is empty unless we've just been deserialized.
+        std::vector<std::vector<char> > stream_chunks;
+
         // Code seems to depend on a default-initialized rget_read_response_t
         // having a `stream_t` in this variant.  TODO: wtf?
         rget_read_response_t() : result(stream_t()), truncated(false) { }
@@ -323,6 +383,10 @@ struct rdb_protocol_t {
         region_t region;
         std::map<store_key_t, int64_t> key_counts;
 
+        // The same for the number of bytes the rows take up, with buckets of their
+        // own.  Only distribution_method_t::SAMPLE fills this in.
+        std::map<store_key_t, int64_t> byte_counts;
+
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
@@ -341,12 +405,31 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    struct changefeed_subscribe_response_t {
+        changefeed_subscribe_response_t() { }
+        // Where to stop each of the stores' servers from sending us changes.
+        std::vector<ql::changefeed::stop_addr_t> servers;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    struct shard_versions_response_t {
+        shard_versions_response_t() { }
+        // Each store's `version_id` and `write_version`.
+        std::map<uuid_u, uint64_t> versions;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct read_response_t {
         typedef boost::variant<point_read_response_t,
                                rget_read_response_t,
                                distribution_read_response_t,
                                sindex_list_response_t,
-                               sindex_status_response_t> variant_t;
+                               sindex_status_response_t,
+                               batched_point_read_response_t,
+                               changefeed_subscribe_response_t,
+                               shard_versions_response_t> variant_t;
         variant_t response;
         profile::event_log_t event_log;
         size_t n_shards;
@@ -368,6 +451,34 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    // Point reads of several keys, which each shard does in one traversal.
+    class batched_point_read_t {
+    public:
+        batched_point_read_t() { }
+        explicit batched_point_read_t(std::vector<store_key_t> &&_keys)
+            : keys(std::move(_keys)) {
+            r_sanity_check(keys.size() != 0);
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+            key_hashes = hash_region_hash_keys(keys);
+        }
+        // For sharding, with keys that are already sorted and hashed.
+        batched_point_read_t(std::vector<store_key_t> &&_keys,
+                             std::vector<uint64_t> &&_key_hashes)
+            : keys(std::move(_keys)), key_hashes(std::move(_key_hashes)) {
+            rassert(keys.size() == key_hashes.size());
+        }
+
+        // Sorted, without duplicates.
+        std::vector<store_key_t> keys;
+        // The hash_region_hasher hash of each key, so that sharding the read across
+        // every CPU shard doesn't hash each key again for every region.  Not
+        // serialized, so it's empty in a read that came over the network.
+        std::vector<uint64_t> key_hashes;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct sindex_rangespec_t {
         sindex_rangespec_t() { }
         sindex_rangespec_t(const std::string &_id,
@@ -375,11 +486,22 @@ struct rdb_protocol_t {
                            // sometimes smaller than the datum range below when
                            // dealing with truncated keys.
                            const region_t &_region,
-                           const datum_range_t _original_range)
-            : id(_id), region(_region), original_range(_original_range) { }
+                           const datum_range_t _original_range,
+                           const boost::optional<ql::geo_region_t> &_geo_region
+                               = boost::none,
+                           const std::vector<std::string> &_text_words
+                               = std::vector<std::string>())
+            : id(_id), region(_region), original_range(_original_range),
+              geo_region(_geo_region), text_words(_text_words) { }
         std::string id; // What sindex we're using.
         region_t region; // What keyspace we're currently operating on.
         datum_range_t original_range; // For dealing with truncation.
+        // Set by geo queries, which only want the points in the range's cells
+        // that are also in this region.
+        boost::optional<ql::geo_region_t> geo_region;
+        // Set by text queries, which only want the rows in the range's posting list
+        // that also have all of these words (sorted).
+        std::vector<std::string> text_words;
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
@@ -423,16 +545,24 @@ struct rdb_protocol_t {
     class distribution_read_t {
     public:
         distribution_read_t()
-            : max_depth(0), result_limit(0), region(region_t::universe())
+            : max_depth(0), result_limit(0), region(region_t::universe()),
+              method(distribution_method_t::DEPTH)
         { }
         distribution_read_t(int _max_depth, size_t _result_limit)
             : max_depth(_max_depth), result_limit(_result_limit),
-              region(region_t::universe())
+              region(region_t::universe()), method(distribution_method_t::DEPTH)
+        { }
+        distribution_read_t(distribution_method_t _method, int _max_depth,
+                            size_t _result_limit)
+            : max_depth(_max_depth), result_limit(_result_limit),
+              region(region_t::universe()), method(_method)
         { }
 
+        // Only used by distribution_method_t::DEPTH.
         int max_depth;
         size_t result_limit;
         region_t region;
+        distribution_method_t method;
 
         RDB_DECLARE_ME_SERIALIZABLE;
     };
@@ -454,14 +584,43 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    // Has every store in `region` send the changes its writes make to `addr`, until
+    // it gets a stop message with `id`.  It's a read so that it gets routed to the
+    // stores like one; it doesn't read anything.
+    class changefeed_subscribe_t {
+    public:
+        changefeed_subscribe_t() { }
+        changefeed_subscribe_t(const uuid_u &_id,
+                               const ql::changefeed::client_addr_t &_addr)
+            : id(_id), addr(_addr), region(region_t::universe()) { }
+        uuid_u id;
+        ql::changefeed::client_addr_t addr;
+        region_t region;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
+    // Gets how many writes every store in `region` has done, so that the query layer
+    // can tell whether a table has changed since it last looked (see
+    // `ql::result_cache_t`).
+    class shard_versions_t {
+    public:
+        shard_versions_t() : region(region_t::universe()) { }
+        region_t region;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct read_t {
         typedef boost::variant<point_read_t,
                                rget_read_t,
                                distribution_read_t,
                                sindex_list_t,
-                               sindex_status_t> variant_t;
+                               sindex_status_t,
+                               batched_point_read_t,
+                               changefeed_subscribe_t,
+                               shard_versions_t> variant_t;
         variant_t read;
         profile_bool_t profile;
+        query_priority_t query_priority;
 
         region_t get_region() const THROWS_NOTHING;
         // Returns true if the read has any operation for this region.  Returns
@@ -469,21 +628,26 @@ struct rdb_protocol_t {
         bool shard(const region_t &region,
                    read_t *read_out) const THROWS_NOTHING;
 
+        // May move the rows out of `responses`, which shouldn't be used again.
         void unshard(read_response_t *responses, size_t count,
                      read_response_t *response, context_t *ctx,
                      signal_t *interruptor) const
             THROWS_ONLY(interrupted_exc_t);
 
-        read_t() { }
+        read_t() : query_priority(QUERY_PRIORITY_INTERACTIVE) { }
         read_t(const variant_t &r, profile_bool_t _profile)
-            : read(r), profile(_profile) { }
+            : read(r), profile(_profile),
+              query_priority(QUERY_PRIORITY_INTERACTIVE) { }
 
-        // Only use snapshotting if we're doing a range get.
-        bool use_snapshot() const THROWS_NOTHING { return boost::get<rget_read_t>(&read); }
+        // Only use snapshotting if we're doing a range get, or sampling the
+        // distribution, which holds the superblock while it walks to many leaves.
+        bool use_snapshot() const THROWS_NOTHING;
 
         // Returns true if this read should be sent to every replica.
         bool all_read() const THROWS_NOTHING { return boost::get<sindex_status_t>(&read); }
 
+        query_priority_t priority() const { return query_priority; }
+
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
@@ -554,13 +718,21 @@ struct rdb_protocol_t {
             const std::string &_pkey,
             const counted_t<ql::func_t> &func,
             const std::map<std::string, ql::wire_func_t > &_optargs,
-            bool _return_vals)
-            : keys(std::move(_keys)), pkey(_pkey), f(func), optargs(_optargs),
-              return_vals(_return_vals) {
+            bool _return_vals,
+            // The keys' hashes, if they're already known (when sharding).
+            std::vector<uint64_t> &&_key_hashes = std::vector<uint64_t>())
+            : keys(std::move(_keys)), key_hashes(std::move(_key_hashes)), pkey(_pkey),
+              f(func), optargs(_optargs), return_vals(_return_vals) {
             r_sanity_check(keys.size() != 0);
             r_sanity_check(keys.size() == 1 || !return_vals);
+            if (key_hashes.empty()) {
+                key_hashes = hash_region_hash_keys(keys);
+            }
+            rassert(key_hashes.size() == keys.size());
         }
         std::vector<store_key_t> keys;
+        // The hash of each key, as in `batched_point_read_t`.  Not serialized.
+        std::vector<uint64_t> key_hashes;
         std::string pkey;
         ql::wire_func_t f;
         std::map<std::string, ql::wire_func_t > optargs;
@@ -572,9 +744,11 @@ struct rdb_protocol_t {
         batched_insert_t() { }
         batched_insert_t(
             std::vector<counted_t<const ql::datum_t> > &&_inserts,
-            const std::string &_pkey, bool _upsert, bool _return_vals)
-            : inserts(std::move(_inserts)), pkey(_pkey),
-              upsert(_upsert), return_vals(_return_vals) {
+            const std::string &_pkey, bool _upsert, bool _return_vals,
+            // The primary keys' hashes, if they're already known (when sharding).
+            std::vector<uint64_t> &&_key_hashes = std::vector<uint64_t>())
+            : inserts(std::move(_inserts)), key_hashes(std::move(_key_hashes)),
+              pkey(_pkey), upsert(_upsert), return_vals(_return_vals) {
             r_sanity_check(inserts.size() != 0);
             r_sanity_check(inserts.size() == 1 || !return_vals);
 #ifndef NDEBUG
@@ -593,8 +767,20 @@ struct rdb_protocol_t {
                 r_sanity_check(false); // throws, so can't do this in exception handler
             }
 #endif // NDEBUG
+            if (key_hashes.empty()) {
+                key_hashes.reserve(inserts.size());
+                for (auto it = inserts.begin(); it != inserts.end(); ++it) {
+                    const store_key_t key((*it)->get(pkey)->print_primary());
+                    key_hashes.push_back(hash_region_hasher(key.contents(), key.size()));
+                }
+            }
+            rassert(key_hashes.size() == inserts.size());
         }
         std::vector<counted_t<const ql::datum_t> > inserts;
+        // The hash of each insert's primary key, as in `batched_point_read_t`.  With
+        // it, sharding only prints the primary keys of the inserts whose hash falls
+        // in a region.  Not serialized.
+        std::vector<uint64_t> key_hashes;
         std::string pkey;
         bool upsert;
         bool return_vals;
@@ -678,6 +864,7 @@ struct rdb_protocol_t {
 
         durability_requirement_t durability_requirement;
         profile_bool_t profile;
+        query_priority_t query_priority;
 
         region_t get_region() const THROWS_NOTHING;
         // Returns true if the write had any side effects applicable to the
@@ -689,40 +876,50 @@ struct rdb_protocol_t {
             const THROWS_NOTHING;
 
         durability_requirement_t durability() const { return durability_requirement; }
+        query_priority_t priority() const { return query_priority; }
 
-        write_t() : durability_requirement(DURABILITY_REQUIREMENT_DEFAULT) { }
+        write_t() : durability_requirement(DURABILITY_REQUIREMENT_DEFAULT),
+                    query_priority(QUERY_PRIORITY_INTERACTIVE) { }
         write_t(const batched_replace_t &br,
                 durability_requirement_t durability,
                 profile_bool_t _profile)
-            : write(br), durability_requirement(durability), profile(_profile) { }
+            : write(br), durability_requirement(durability), profile(_profile),
+              query_priority(QUERY_PRIORITY_INTERACTIVE) { }
         write_t(const batched_insert_t &bi,
                 durability_requirement_t durability,
                 profile_bool_t _profile)
-            : write(bi), durability_requirement(durability), profile(_profile) { }
+            : write(bi), durability_requirement(durability), profile(_profile),
+              query_priority(QUERY_PRIORITY_INTERACTIVE) { }
         write_t(const point_write_t &w,
                 durability_requirement_t durability,
                 profile_bool_t _profile)
-            : write(w), durability_requirement(durability), profile(_profile) { }
+            : write(w), durability_requirement(durability), profile(_profile),
+              query_priority(QUERY_PRIORITY_INTERACTIVE) { }
         write_t(const point_delete_t &d,
                 durability_requirement_t durability,
                 profile_bool_t _profile)
-            : write(d), durability_requirement(durability), profile(_profile) { }
+            : write(d), durability_requirement(durability), profile(_profile),
+              query_priority(QUERY_PRIORITY_INTERACTIVE) { }
         write_t(const sindex_create_t &c, profile_bool_t _profile)
             : write(c), durability_requirement(DURABILITY_REQUIREMENT_DEFAULT),
-              profile(_profile) { }
+              profile(_profile),
+              query_priority(QUERY_PRIORITY_INTERACTIVE) { }
         write_t(const sindex_drop_t &c, profile_bool_t _profile)
             : write(c), durability_requirement(DURABILITY_REQUIREMENT_DEFAULT),
-              profile(_profile) { }
+              profile(_profile),
+              query_priority(QUERY_PRIORITY_INTERACTIVE) { }
         write_t(const sindex_create_t &c,
                 durability_requirement_t durability,
                 profile_bool_t _profile)
             : write(c), durability_requirement(durability),
-              profile(_profile) { }
+              profile(_profile),
+              query_priority(QUERY_PRIORITY_INTERACTIVE) { }
         write_t(const sindex_drop_t &c,
                 durability_requirement_t durability,
                 profile_bool_t _profile)
             : write(c), durability_requirement(durability),
-              profile(_profile) { }
+              profile(_profile),
+              query_priority(QUERY_PRIORITY_INTERACTIVE) { }
         /*  Note that for durability != DURABILITY_REQUIREMENT_HARD, sync might
          *  not have the desired effect (of writing unsaved data to disk).
          *  However there are cases where we use sync internally (such as when
@@ -732,7 +929,8 @@ struct rdb_protocol_t {
         write_t(const sync_t &c,
                 durability_requirement_t durability,
                 profile_bool_t _profile)
-            : write(c), durability_requirement(durability), profile(_profile) { }
+            : write(c), durability_requirement(durability), profile(_profile),
+              query_priority(QUERY_PRIORITY_INTERACTIVE) { }
 
         RDB_DECLARE_ME_SERIALIZABLE;
     };
@@ -756,11 +954,15 @@ struct rdb_protocol_t {
 
             RDB_DECLARE_ME_SERIALIZABLE;
         };
-        struct key_value_pair_t {
-            rdb_protocol_details::backfill_atom_t backfill_atom;
+        /* Rows are sent in batches of consecutive keys (of up to about
+        `BACKFILL_BATCH_SIZE` bytes), so that the backfillee can apply each batch
+        in one transaction instead of one per row. */
+        struct key_value_pairs_t {
+            std::vector<rdb_protocol_details::backfill_atom_t> backfill_atoms;
 
-            key_value_pair_t() { }
-            explicit key_value_pair_t(const rdb_protocol_details::backfill_atom_t& _backfill_atom) : backfill_atom(_backfill_atom) { }
+            key_value_pairs_t() { }
+            explicit key_value_pairs_t(const std::vector<rdb_protocol_details::backfill_atom_t> &_backfill_atoms)
+                : backfill_atoms(_backfill_atoms) { }
 
             RDB_DECLARE_ME_SERIALIZABLE;
         };
@@ -774,7 +976,7 @@ struct rdb_protocol_t {
             RDB_DECLARE_ME_SERIALIZABLE;
         };
 
-        typedef boost::variant<delete_range_t, delete_key_t, key_value_pair_t, sindexes_t> value_t;
+        typedef boost::variant<delete_range_t, delete_key_t, key_value_pairs_t, sindexes_t> value_t;
 
         backfill_chunk_t() { }
         explicit backfill_chunk_t(const value_t &_val) : val(_val) { }
@@ -786,8 +988,8 @@ struct rdb_protocol_t {
         static backfill_chunk_t delete_key(const store_key_t& key, const repli_timestamp_t& recency) {
             return backfill_chunk_t(delete_key_t(key, recency));
         }
-        static backfill_chunk_t set_key(const rdb_protocol_details::backfill_atom_t& key) {
-            return backfill_chunk_t(key_value_pair_t(key));
+        static backfill_chunk_t set_keys(const std::vector<rdb_protocol_details::backfill_atom_t> &keys) {
+            return backfill_chunk_t(key_value_pairs_t(keys));
         }
 
         static backfill_chunk_t sindexes(const std::map<std::string, secondary_index_t> &sindexes) {
@@ -814,6 +1016,14 @@ struct rdb_protocol_t {
                 const base_path_t &base_path);
         ~store_t();
 
+        // Empty if there's no mailbox manager to send changes with.
+        scoped_ptr_t<ql::changefeed::server_t> changefeed_server;
+
+        // The store's writes since it was created in this process, under an id that
+        // tells it apart from other stores and from earlier incarnations of itself.
+        const uuid_u version_id;
+        uint64_t write_version;
+
     private:
         friend struct read_visitor_t;
         void protocol_read(const read_t &read,
@@ -848,6 +1058,20 @@ struct rdb_protocol_t {
                                  btree_slice_t *btree,
                                  superblock_t *superblock,
                                  signal_t *interruptor);
+
+        bool protocol_defragment_leaves(btree_slice_t *btree,
+                                        superblock_t *superblock,
+                                        store_key_t *start_key,
+                                        int max_leaves);
+
+        bool protocol_write_can_be_buffered(const write_t &write);
+
+        bool protocol_read_merges_write_buffer(const read_t &read);
+
+        void protocol_flush_write_buffer(
+                btree_slice_t *btree,
+                superblock_t *superblock,
+                const btree_write_buffer_t::message_map_t &messages);
         context_t *ctx;
     };
 
@@ -861,6 +1085,7 @@ between the source and destination machines. */
 struct range_key_tester_t : public key_tester_t {
     explicit range_key_tester_t(const rdb_protocol_t::region_t *_delete_range) : delete_range(_delete_range) { }
     bool key_should_be_erased(const btree_key_t *key);
+    bool erases_all_keys();
 
     const rdb_protocol_t::region_t *delete_range;
 };
@@ -4,10 +4,16 @@
 #include <time.h>
 #include <math.h>
 
+#include <map>
+#include <vector>
+
 #include "errors.hpp"
 #include <boost/date_time.hpp>
 
+#include "arch/runtime/runtime.hpp"
+#include "config/args.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "utils.hpp"
 
 namespace ql {
 namespace pseudo {
@@ -53,6 +59,29 @@ const boost::local_time::time_zone_ptr utc(
     new boost::local_time::posix_time_zone("UTC"));
 const boost::local_time::local_date_time epoch(raw_epoch, utc);
 
+// Constructing a `posix_time_zone` parses its POSIX TZ string, which is most of the
+// cost of taking a time apart.  Times only ever carry a sanitized `[+-]HH:MM`
+// offset, so there are few distinct zones and we keep them around, one cache per
+// thread so that nobody has to take a lock.
+boost::local_time::time_zone_ptr get_zone(const std::string &sanitized_tz) {
+    typedef std::map<std::string, boost::local_time::time_zone_ptr> zone_cache_t;
+    static std::vector<cache_line_padded_t<zone_cache_t> > zone_caches(MAX_THREADS);
+
+    const int thread = get_thread_id().threadnum;
+    if (thread < 0 || thread >= MAX_THREADS) {
+        return boost::local_time::time_zone_ptr(
+            new boost::local_time::posix_time_zone(sanitized_tz));
+    }
+    zone_cache_t *cache = &zone_caches[thread].value;
+    auto it = cache->find(sanitized_tz);
+    if (it == cache->end()) {
+        boost::local_time::time_zone_ptr zone(
+            new boost::local_time::posix_time_zone(sanitized_tz));
+        it = cache->insert(std::make_pair(sanitized_tz, zone)).first;
+    }
+    return it->second;
+}
+
 // Boost's documentation on what errors may be thrown where is somewhat lacking,
 // so this is probably a slight superset of what we actually need to handle.  We
 // may also need to catch the following exceptions in the future, but I omitted
@@ -398,9 +427,7 @@ time_t time_to_boost(counted_t<const datum_t> d) {
     add_seconds_to_ptime(&t, raw_sec);
 
     if (counted_t<const datum_t> tz = d->get(timezone_key, NOTHROW)) {
-        boost::local_time::time_zone_ptr zone(
-            new boost::local_time::posix_time_zone(sanitize::tz(tz->as_str().to_std())));
-        return time_t(t, zone);
+        return time_t(t, get_zone(sanitize::tz(tz->as_str().to_std())));
     } else {
         return time_t(t, utc);
     }
@@ -426,7 +453,7 @@ std::string time_to_iso8601(counted_t<const datum_t> d) {
         } else {
             ss.imbue(no_tz_format);
         }
-        ss << time_to_boost(d);
+        ss << t;
         std::string s = ss.str();
         size_t dot_off = s.find('.');
         return (dot_off == std::string::npos) ? s :
@@ -446,8 +473,9 @@ counted_t<const datum_t> time_now() {
 }
 
 int time_cmp(const datum_t &x, const datum_t &y) {
-    r_sanity_check(x.is_ptype(time_string));
-    r_sanity_check(y.is_ptype(time_string));
+    // `datum_t::cmp` has already checked both types on the way here.
+    rassert(x.is_ptype(time_string));
+    rassert(y.is_ptype(time_string));
     return x.get(epoch_time_key)->cmp(*y.get(epoch_time_key));
 }
 
@@ -570,8 +598,7 @@ counted_t<const datum_t> make_time(
         } catch (const datum_exc_t &e) {
             rfail_target(target, base_exc_t::GENERIC, "%s", e.what());
         }
-        boost::local_time::time_zone_ptr zone(
-            new boost::local_time::posix_time_zone(tz));
+        boost::local_time::time_zone_ptr zone = get_zone(tz);
         return boost_to_time(time_t(ptime, zone) - zone->base_utc_offset(), target);
     } HANDLE_BOOST_ERRORS(target);
 }
@@ -0,0 +1,151 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_capture.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <functional>
+
+#include "arch/runtime/runtime.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/types.hpp"
+#include "concurrency/pmap.hpp"
+#include "config/args.hpp"
+#include "logger.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+query_capture_t::query_capture_t(const query_capture_options_t &options)
+    : path(*options.file),
+      connection_sample_interval(options.connection_sample_interval),
+      bytes_written(0),
+      stopped(false),
+      thread_buffers(get_num_threads()) {
+    guarantee(connection_sample_interval > 0);
+
+    int res;
+    do {
+        res = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    } while (res == -1 && get_errno() == EINTR);
+    if (res == -1) {
+        throw query_capture_exc_t(strprintf("Could not create the query capture file "
+                                            "'%s': %s", path.c_str(),
+                                            errno_string(get_errno()).c_str()));
+    }
+    fd.reset(res);
+
+    std::string magic(QUERY_CAPTURE_MAGIC);
+    bool ok;
+    int errsv = 0;
+    write_blocking(&magic, &ok, &errsv);
+    if (!ok) {
+        throw query_capture_exc_t(strprintf("Could not write to the query capture file "
+                                            "'%s': %s", path.c_str(),
+                                            errno_string(errsv).c_str()));
+    }
+}
+
+query_capture_t::~query_capture_t() {
+    pmap(get_num_threads(), std::bind(&query_capture_t::flush_on_thread,
+                                      this, std::placeholders::_1));
+}
+
+uint64_t query_capture_t::new_connection() {
+    const int thread = get_thread_id().threadnum;
+    thread_buffer_t *buffer = &thread_buffers[thread];
+    const uint64_t n = buffer->connections++;
+    if (n % connection_sample_interval != 0) {
+        return 0;
+    }
+    // Unique across threads without them having to agree on anything.
+    return n * get_num_threads() + thread + 1;
+}
+
+void query_capture_t::note_query(uint64_t connection_id, const Query &query) {
+    rassert(connection_id != 0);
+    const microtime_t now = current_microtime();
+
+    std::string serialized;
+    query.SerializeToString(&serialized);
+    const int64_t time = now;
+    const uint32_t size = serialized.size();
+
+    thread_buffer_t *buffer = &thread_buffers[get_thread_id().threadnum];
+    if (buffer->data.empty()) {
+        buffer->oldest = now;
+    }
+    buffer->data.append(reinterpret_cast<const char *>(&time), sizeof(time));
+    buffer->data.append(reinterpret_cast<const char *>(&connection_id),
+                        sizeof(connection_id));
+    buffer->data.append(reinterpret_cast<const char *>(&size), sizeof(size));
+    buffer->data.append(serialized);
+
+    if (buffer->data.size() >= QUERY_CAPTURE_BUFFER_SIZE
+        || now - buffer->oldest >= QUERY_CAPTURE_FLUSH_INTERVAL_MS * THOUSAND) {
+        // Take the records first, so that the thread's other queries don't wait for
+        // them to be written.
+        std::string data;
+        data.swap(buffer->data);
+        flush(&data);
+    }
+}
+
+void query_capture_t::flush(std::string *data) {
+    if (data->empty()) {
+        return;
+    }
+    bool ok;
+    int errsv = 0;
+    thread_pool_t::run_in_blocker_pool(std::bind(&query_capture_t::write_blocking,
+                                                 this, data, &ok, &errsv));
+    if (!ok) {
+        // `write_blocking` only fails once; after that it drops everything.
+        if (errsv != 0) {
+            logERR("Stopped capturing queries because writing to '%s' failed: %s\n",
+                   path.c_str(), errno_string(errsv).c_str());
+        } else {
+            logWRN("Stopped capturing queries because '%s' reached %" PRIi64 " bytes.\n",
+                   path.c_str(), static_cast<int64_t>(QUERY_CAPTURE_MAX_FILE_SIZE));
+        }
+    }
+}
+
+void query_capture_t::flush_on_thread(int thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    std::string data;
+    data.swap(thread_buffers[thread].data);
+    flush(&data);
+}
+
+void query_capture_t::write_blocking(const std::string *data, bool *ok_out,
+                                     int *errsv_out) {
+    system_mutex_t::lock_t lock(&write_mutex);
+    *ok_out = true;
+    if (stopped) {
+        return;
+    }
+    if (bytes_written + static_cast<int64_t>(data->size())
+        > QUERY_CAPTURE_MAX_FILE_SIZE) {
+        stopped = true;
+        *ok_out = false;
+        return;
+    }
+
+    size_t offset = 0;
+    while (offset < data->size()) {
+        ssize_t res = ::write(fd.get(), data->data() + offset, data->size() - offset);
+        if (res == -1) {
+            if (get_errno() == EINTR) {
+                continue;
+            }
+            stopped = true;
+            *ok_out = false;
+            *errsv_out = get_errno();
+            return;
+        }
+        offset += res;
+    }
+    bytes_written += data->size();
+}
@@ -0,0 +1,97 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_QUERY_CAPTURE_HPP_
+#define RDB_PROTOCOL_QUERY_CAPTURE_HPP_
+
+#include <exception>
+#include <string>
+
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
+#include "arch/io/concurrency.hpp"
+#include "arch/io/io_utils.hpp"
+#include "containers/scoped.hpp"
+#include "utils.hpp"
+
+class Query;
+
+// The first bytes of a capture file.
+#define QUERY_CAPTURE_MAGIC "RQLCAP01"
+
+struct query_capture_options_t {
+    query_capture_options_t() : connection_sample_interval(1) { }
+
+    // Where to write the captured queries; nothing is captured if this is empty.
+    boost::optional<std::string> file;
+    // One in every `connection_sample_interval` client connections is captured.
+    int connection_sample_interval;
+};
+
+class query_capture_exc_t : public std::exception {
+public:
+    explicit query_capture_exc_t(const std::string &_info) : info(_info) { }
+    ~query_capture_exc_t() throw () { }
+    const char *what() const throw () {
+        return info.c_str();
+    }
+private:
+    std::string info;
+};
+
+/* `query_capture_t` writes the queries clients send to a file, with when they arrived
+and which connection they came on, so that `test/performance/replay.py` can send the
+same queries to a test cluster later with the same timing.  It captures every query
+on the connections it samples rather than sampling queries, so that cursors and
+`noreply_wait`s still make sense when they're replayed.
+
+After `QUERY_CAPTURE_MAGIC`, the file has a record per query:
+    int64_t   when the query arrived, in microseconds since the epoch
+    uint64_t  the connection's id in the capture (never 0)
+    uint32_t  the size of the query
+    ...       the `Query` protobuf, as the client sent it
+with the integers in the server's byte order.  Records are written a thread's worth
+at a time, so they're only roughly in the order the queries arrived. */
+class query_capture_t {
+public:
+    // Creates the file, or truncates it if it already exists.
+    explicit query_capture_t(const query_capture_options_t &options);
+    // Writes out what the threads still have buffered; must be called in a coroutine.
+    ~query_capture_t();
+
+    // Called on a connection's thread before its first query.  Returns the id to
+    // capture its queries under, or 0 if it isn't sampled.
+    uint64_t new_connection();
+
+    // Called on the query's thread before the query is run.
+    void note_query(uint64_t connection_id, const Query &query);
+
+private:
+    struct thread_buffer_t {
+        thread_buffer_t() : connections(0), oldest(0) { }
+        uint64_t connections;
+        std::string data;
+        // When the first record in `data` arrived.
+        microtime_t oldest;
+    };
+
+    void flush(std::string *data);
+    void flush_on_thread(int thread);
+    // Returns false if the write failed, with `errsv_out` set, or if the file got too
+    // big.  Run in the blocker pool.
+    void write_blocking(const std::string *data, bool *ok_out, int *errsv_out);
+
+    const std::string path;
+    const int connection_sample_interval;
+
+    // These are only used in the blocker pool, under `write_mutex`.
+    system_mutex_t write_mutex;
+    scoped_fd_t fd;
+    int64_t bytes_written;
+    bool stopped;
+
+    scoped_array_t<thread_buffer_t> thread_buffers;
+
+    DISABLE_COPYING(query_capture_t);
+};
+
+#endif  // RDB_PROTOCOL_QUERY_CAPTURE_HPP_
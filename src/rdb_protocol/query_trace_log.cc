@@ -0,0 +1,66 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_trace_log.hpp"
+
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/pmap.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+query_trace_log_t::query_trace_log_t() : thread_logs(get_num_threads()) { }
+
+bool query_trace_log_t::should_sample() {
+    thread_log_t *log = &thread_logs[get_thread_id().threadnum];
+    if (++log->queries_since_sample < QUERY_TRACE_SAMPLE_INTERVAL) {
+        return false;
+    }
+    log->queries_since_sample = 0;
+    return true;
+}
+
+void query_trace_log_t::note_query(const Query &query,
+                                   microtime_t start_time,
+                                   ticks_t duration,
+                                   const boost::optional<std::string> &trace_json) {
+    double duration_secs = ticks_to_secs(duration);
+    if (!trace_json && duration_secs * 1000 < QUERY_TRACE_SLOW_THRESHOLD_MS) {
+        return;
+    }
+
+    traced_query_t traced;
+    traced.query = query.query().ShortDebugString();
+    if (traced.query.size() > QUERY_TRACE_MAX_QUERY_SIZE) {
+        traced.query.resize(QUERY_TRACE_MAX_QUERY_SIZE);
+        traced.query += "...";
+    }
+    traced.start_time = start_time;
+    traced.duration_secs = duration_secs;
+    if (trace_json) {
+        traced.trace_json = *trace_json;
+    }
+
+    std::deque<traced_query_t> *queries =
+        &thread_logs[get_thread_id().threadnum].queries;
+    queries->push_back(std::move(traced));
+    if (queries->size() > QUERY_TRACE_LOG_SIZE) {
+        queries->pop_front();
+    }
+}
+
+void query_trace_log_t::get_queries_on_thread(
+        int thread, std::vector<traced_query_t> *queries_out) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    const std::deque<traced_query_t> &queries = thread_logs[thread].queries;
+    queries_out->assign(queries.begin(), queries.end());
+}
+
+std::vector<traced_query_t> query_trace_log_t::get_queries() {
+    std::vector<std::vector<traced_query_t> > per_thread(get_num_threads());
+    pmap(get_num_threads(), [&](int thread) {
+        get_queries_on_thread(thread, &per_thread[thread]);
+    });
+
+    std::vector<traced_query_t> queries;
+    for (auto it = per_thread.begin(); it != per_thread.end(); ++it) {
+        queries.insert(queries.end(), it->begin(), it->end());
+    }
+    return queries;
+}
@@ -0,0 +1,63 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_QUERY_TRACE_LOG_HPP_
+#define RDB_PROTOCOL_QUERY_TRACE_LOG_HPP_
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
+#include "containers/scoped.hpp"
+#include "utils.hpp"
+
+class Query;
+
+/* A query that `query_trace_log_t` kept. */
+struct traced_query_t {
+    std::string query;
+    microtime_t start_time;
+    double duration_secs;
+    // The query's trace as JSON, or empty if the query wasn't sampled and was only
+    // kept for being slow.
+    std::string trace_json;
+};
+
+/* `query_trace_log_t` lets us find slow queries in production without the clients
+having to ask for profiles.  It picks one in every `QUERY_TRACE_SAMPLE_INTERVAL`
+queries to trace like a `profile: true` query (including the reads and writes on
+the shards), without sending the trace to the client, and keeps those queries and
+any slow ones for the admin HTTP server.  Every thread samples and keeps its own
+queries, so queries never wait on each other for it. */
+class query_trace_log_t {
+public:
+    query_trace_log_t();
+
+    // Called on the query's thread before it starts; true means it should be traced.
+    bool should_sample();
+
+    // Called on the query's thread once the query has been handled, with its trace
+    // as JSON if it was sampled.
+    void note_query(const Query &query,
+                    microtime_t start_time,
+                    ticks_t duration,
+                    const boost::optional<std::string> &trace_json);
+
+    // Returns the queries every thread has kept, oldest first on each thread.
+    std::vector<traced_query_t> get_queries();
+
+private:
+    void get_queries_on_thread(int thread, std::vector<traced_query_t> *queries_out);
+
+    struct thread_log_t {
+        thread_log_t() : queries_since_sample(0) { }
+        int queries_since_sample;
+        std::deque<traced_query_t> queries;
+    };
+    scoped_array_t<thread_log_t> thread_logs;
+
+    DISABLE_COPYING(query_trace_log_t);
+};
+
+#endif  // RDB_PROTOCOL_QUERY_TRACE_LOG_HPP_
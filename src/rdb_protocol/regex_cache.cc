@@ -0,0 +1,34 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/regex_cache.hpp"
+
+#include <re2/re2.h>
+
+#include "config/args.hpp"
+
+namespace ql {
+
+regex_cache_t::regex_cache_t() : uses(0) { }
+
+regex_cache_t::~regex_cache_t() { }
+
+const re2::RE2 *regex_cache_t::get(const std::string &pattern) {
+    ++uses;
+    std::map<std::string, regex_t>::iterator it = regexes.find(pattern);
+    if (it == regexes.end()) {
+        if (regexes.size() >= REGEX_CACHE_SIZE) {
+            std::map<std::string, regex_t>::iterator lru = regexes.begin();
+            for (auto jt = regexes.begin(); jt != regexes.end(); ++jt) {
+                if (jt->second.last_used < lru->second.last_used) {
+                    lru = jt;
+                }
+            }
+            regexes.erase(lru);
+        }
+        it = regexes.insert(std::make_pair(pattern, regex_t())).first;
+        it->second.regex.init(new re2::RE2(pattern));
+    }
+    it->second.last_used = uses;
+    return it->second.regex.get();
+}
+
+}  // namespace ql
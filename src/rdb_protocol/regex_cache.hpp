@@ -0,0 +1,42 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_REGEX_CACHE_HPP_
+#define RDB_PROTOCOL_REGEX_CACHE_HPP_
+
+#include <map>
+#include <string>
+
+#include "containers/scoped.hpp"
+#include "errors.hpp"
+
+namespace re2 {
+class RE2;
+}  // namespace re2
+
+namespace ql {
+
+// The regexes that a query's `match` calls have compiled, so that a `match` in a
+// `filter` compiles its pattern once instead of once per row.
+class regex_cache_t {
+public:
+    regex_cache_t();
+    ~regex_cache_t();
+
+    // Returns `pattern` compiled, which may have failed to compile (see
+    // `RE2::ok`).  It's valid until the next call.
+    const re2::RE2 *get(const std::string &pattern);
+
+private:
+    struct regex_t {
+        scoped_ptr_t<re2::RE2> regex;
+        uint64_t last_used;
+    };
+
+    std::map<std::string, regex_t> regexes;
+    uint64_t uses;
+
+    DISABLE_COPYING(regex_cache_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_REGEX_CACHE_HPP_
@@ -0,0 +1,181 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/result_cache.hpp"
+
+#include "arch/runtime/runtime.hpp"
+#include "config/args.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+namespace ql {
+
+namespace {
+
+// Whether `t` gives the same result every time the tables it reads hold the same
+// data, and doesn't change them.
+bool is_cacheable_term(const Term &t) {
+    switch (t.type()) {
+    case Term::JAVASCRIPT:
+    case Term::NOW:
+    case Term::SAMPLE:
+    case Term::INSERT:
+    case Term::UPDATE:
+    case Term::DELETE:
+    case Term::REPLACE:
+    case Term::FOREACH:
+    case Term::SYNC:
+    case Term::CHANGES:
+    // These read (or change) the metadata, which the stores' versions don't cover.
+    case Term::INFO:
+    case Term::SHARD_MAP:
+    case Term::DB_CREATE:
+    case Term::DB_DROP:
+    case Term::DB_LIST:
+    case Term::TABLE_CREATE:
+    case Term::TABLE_DROP:
+    case Term::TABLE_LIST:
+    case Term::INDEX_CREATE:
+    case Term::INDEX_DROP:
+    case Term::INDEX_LIST:
+    case Term::INDEX_STATUS:
+    case Term::INDEX_WAIT:
+        return false;
+    default:
+        break;
+    }
+    for (int i = 0; i < t.args_size(); ++i) {
+        if (!is_cacheable_term(t.args(i))) {
+            return false;
+        }
+    }
+    for (int i = 0; i < t.optargs_size(); ++i) {
+        // Outdated reads can be older than the versions we'd get.
+        if (t.optargs(i).key() == "use_outdated"
+            || !is_cacheable_term(t.optargs(i).val())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Gets the versions of the stores of table `access`.  Returns false if it can't.
+bool read_table_versions(env_t *env, rdb_namespace_access_t *access,
+                         std::map<uuid_u, uint64_t> *versions_out) {
+    rdb_protocol_t::read_t read(rdb_protocol_t::shard_versions_t(),
+                                profile_bool_t::DONT_PROFILE);
+    try {
+        rdb_protocol_t::read_response_t res;
+        access->get_namespace_if().read(
+            read, &res, order_token_t::ignore, env->interruptor);
+        auto sv_res =
+            boost::get<rdb_protocol_t::shard_versions_response_t>(&res.response);
+        r_sanity_check(sv_res);
+        *versions_out = std::move(sv_res->versions);
+        return true;
+    } catch (const cannot_perform_query_exc_t &) {
+        return false;
+    }
+}
+
+}  // namespace
+
+void note_table_versions(env_t *env, rdb_namespace_access_t *access,
+                         const uuid_u &table_id) {
+    table_versions_t *versions = env->table_versions.get_or_null();
+    if (versions == NULL || versions->failed
+        || versions->tables.find(table_id) != versions->tables.end()) {
+        return;
+    }
+    if (!read_table_versions(env, access, &versions->tables[table_id])) {
+        versions->failed = true;
+    }
+}
+
+result_cache_t::result_cache_t() : thread_caches(get_num_threads()) { }
+
+bool result_cache_t::cache_key(const Query &q, std::string *key_out) {
+    bool requested = false;
+    for (int i = 0; i < q.global_optargs_size(); ++i) {
+        const Query::AssocPair &ap = q.global_optargs(i);
+        // A query routed by a shard map has to be checked against the current
+        // map (see `check_shard_map_version`).
+        if (ap.key() == "use_outdated" || ap.key() == "shard_map_version") {
+            return false;
+        }
+        if (ap.key() == "result_cache") {
+            requested = ap.val().type() == Term::DATUM
+                && ap.val().datum().type() == Datum::R_BOOL
+                && ap.val().datum().r_bool();
+        }
+    }
+    if (!requested || !is_cacheable_term(q.query())) {
+        return false;
+    }
+
+    // The query and its global optargs (like the default database), and how the
+    // client wants the result.
+    key_out->assign(q.accepts_r_json() ? "j" : "d");
+    const std::string query = q.query().SerializeAsString();
+    key_out->append(strprintf("%zu:", query.size()));
+    key_out->append(query);
+    for (int i = 0; i < q.global_optargs_size(); ++i) {
+        const std::string optarg = q.global_optargs(i).SerializeAsString();
+        key_out->append(strprintf("%zu:", optarg.size()));
+        key_out->append(optarg);
+    }
+    return key_out->size() <= RESULT_CACHE_MAX_QUERY_SIZE;
+}
+
+bool result_cache_t::get(env_t *env, const std::string &key, Datum *datum_out) {
+    thread_cache_t *cache = &thread_caches[get_thread_id().threadnum];
+    auto it = cache->entries.find(key);
+    if (it == cache->entries.end()) {
+        return false;
+    }
+
+    // Reading the versions blocks, so the entry might change meanwhile.
+    const table_versions_t versions = it->second.versions;
+    for (auto jt = versions.tables.begin(); jt != versions.tables.end(); ++jt) {
+        rdb_namespace_access_t access(jt->first, env);
+        std::map<uuid_u, uint64_t> current;
+        if (!read_table_versions(env, &access, &current) || current != jt->second) {
+            it = cache->entries.find(key);
+            if (it != cache->entries.end()
+                && it->second.versions.tables == versions.tables) {
+                cache->entries.erase(it);
+            }
+            return false;
+        }
+    }
+
+    it = cache->entries.find(key);
+    if (it == cache->entries.end() || it->second.versions.tables != versions.tables) {
+        return false;
+    }
+    it->second.last_used = ++cache->uses;
+    return datum_out->ParseFromString(it->second.result);
+}
+
+void result_cache_t::put(const std::string &key, const table_versions_t &versions,
+                         const Datum &datum) {
+    if (versions.failed
+        || static_cast<size_t>(datum.ByteSize()) > RESULT_CACHE_MAX_RESULT_SIZE) {
+        return;
+    }
+    thread_cache_t *cache = &thread_caches[get_thread_id().threadnum];
+    if (cache->entries.size() >= RESULT_CACHE_SIZE
+        && cache->entries.find(key) == cache->entries.end()) {
+        auto lru = cache->entries.begin();
+        for (auto it = cache->entries.begin(); it != cache->entries.end(); ++it) {
+            if (it->second.last_used < lru->second.last_used) {
+                lru = it;
+            }
+        }
+        cache->entries.erase(lru);
+    }
+    entry_t *entry = &cache->entries[key];
+    entry->versions = versions;
+    entry->result = datum.SerializeAsString();
+    entry->last_used = ++cache->uses;
+}
+
+}  // namespace ql
@@ -0,0 +1,80 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_RESULT_CACHE_HPP_
+#define RDB_PROTOCOL_RESULT_CACHE_HPP_
+
+#include <map>
+#include <string>
+
+#include "containers/scoped.hpp"
+#include "containers/uuid.hpp"
+
+class Datum;
+class Query;
+
+namespace ql {
+
+class env_t;
+class rdb_namespace_access_t;
+
+// The write versions of the stores of each table a query reads (see
+// `rdb_protocol_t::shard_versions_t`), from before it first read the table.
+struct table_versions_t {
+    table_versions_t() : failed(false) { }
+    std::map<uuid_u, std::map<uuid_u, uint64_t> > tables;
+    // Set if we couldn't get some table's versions.
+    bool failed;
+};
+
+// Notes the versions of table `table_id` in `env->table_versions`, if the env's query
+// might have its result cached and they aren't there yet.  Called before the query
+// reads the table.
+void note_table_versions(env_t *env, rdb_namespace_access_t *access,
+                         const uuid_u &table_id);
+
+/* Keeps the results of the queries that ask for it with the `result_cache` optarg,
+and answers the same query with the same result for as long as none of the stores of
+the tables it read have been written to, which costs one small read of every table
+instead of running the query.  That's for dashboards and the like, which run the same
+expensive aggregations over and over while the tables hardly change.
+
+Only queries that give the same result for the same data are cached: no writes, `js`,
+`now` or `sample`, nothing that reads the cluster's metadata, and no outdated reads.
+Each thread keeps its own results, so queries never wait on each other for it. */
+class result_cache_t {
+public:
+    result_cache_t();
+
+    // If `q` asked for its result to be cached and can be, returns true and sets
+    // `*key_out` to what it's cached under.
+    static bool cache_key(const Query &q, std::string *key_out);
+
+    // If the result of the query with `key` is cached and still good, returns true
+    // and sets `*datum_out` to it.
+    bool get(env_t *env, const std::string &key, Datum *datum_out);
+
+    // Caches `datum` as the result of the query with `key`, which read the tables
+    // in `versions`.
+    void put(const std::string &key, const table_versions_t &versions,
+             const Datum &datum);
+
+private:
+    struct entry_t {
+        table_versions_t versions;
+        // The serialized `Datum`.
+        std::string result;
+        uint64_t last_used;
+    };
+
+    struct thread_cache_t {
+        thread_cache_t() : uses(0) { }
+        std::map<std::string, entry_t> entries;
+        uint64_t uses;
+    };
+    scoped_array_t<thread_cache_t> thread_caches;
+
+    DISABLE_COPYING(result_cache_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_RESULT_CACHE_HPP_
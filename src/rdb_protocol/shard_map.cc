@@ -0,0 +1,158 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/shard_map.hpp"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "arch/crc32c.hpp"
+#include "clustering/administration/metadata.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rpc/directory/read_manager.hpp"
+
+namespace ql {
+
+namespace {
+
+counted_t<const datum_t> key_datum(const store_key_t &key) {
+    return make_counted<const datum_t>(
+        std::string(reinterpret_cast<const char *>(key.contents()), key.size()));
+}
+
+// Where a client driver can reach `machine`, according to the directory.
+counted_t<const datum_t> machine_datum(
+        const machine_id_t &machine,
+        const std::map<machine_id_t, std::pair<std::vector<std::string>, int> > &addresses) {
+    datum_ptr_t res(datum_t::R_OBJECT);
+    bool b = res.add("machine", make_counted<const datum_t>(uuid_to_str(machine)));
+    auto it = addresses.find(machine);
+    if (it == addresses.end() || it->second.second == 0) {
+        b |= res.add("hosts", make_counted<const datum_t>(datum_t::R_NULL));
+        b |= res.add("port", make_counted<const datum_t>(datum_t::R_NULL));
+    } else {
+        datum_ptr_t hosts(datum_t::R_ARRAY);
+        for (auto jt = it->second.first.begin(); jt != it->second.first.end(); ++jt) {
+            hosts.add(make_counted<const datum_t>(std::string(*jt)));
+        }
+        b |= res.add("hosts", hosts.to_counted());
+        b |= res.add("port", make_counted<const datum_t>(
+                         static_cast<double>(it->second.second)));
+    }
+    r_sanity_check(!b);
+    return res.to_counted();
+}
+
+}  // namespace
+
+counted_t<const datum_t> table_shard_map(env_t *env, const uuid_u &table_id,
+                                         const rcheckable_t *parent) {
+    rcheck_target(parent, base_exc_t::GENERIC,
+                  env->cluster_access.directory_read_manager != NULL,
+                  "Cannot get a shard map inside a query that runs on the shards.");
+
+    persistable_blueprint_t<rdb_protocol_t> blueprint;
+    nonoverlapping_regions_t<rdb_protocol_t> shards;
+    {
+        cow_ptr_t<namespaces_semilattice_metadata_t<rdb_protocol_t> > namespaces
+            = env->cluster_access.namespaces_semilattice_metadata->get();
+        auto it = namespaces->namespaces.find(table_id);
+        rcheck_target(parent, base_exc_t::GENERIC,
+                      it != namespaces->namespaces.end() && !it->second.is_deleted(),
+                      "Table does not exist.");
+        const namespace_semilattice_metadata_t<rdb_protocol_t> &ns
+            = it->second.get_ref();
+        rcheck_target(parent, base_exc_t::GENERIC,
+                      !ns.blueprint.in_conflict() && !ns.shards.in_conflict(),
+                      "The table's sharding metadata is in conflict.");
+        blueprint = ns.blueprint.get();
+        shards = ns.shards.get();
+    }
+
+    // Each machine's addresses and driver port.
+    std::map<machine_id_t, std::pair<std::vector<std::string>, int> > addresses;
+    {
+        directory_read_manager_t<cluster_directory_metadata_t> *directory
+            = env->cluster_access.directory_read_manager;
+        on_thread_t rethreader(directory->home_thread());
+        const change_tracking_map_t<peer_id_t, cluster_directory_metadata_t> root
+            = directory->get_root_view()->get();
+        const std::map<peer_id_t, cluster_directory_metadata_t> &peers
+            = root.get_inner();
+        for (auto it = peers.begin(); it != peers.end(); ++it) {
+            if (it->second.peer_type == SERVER_PEER) {
+                addresses[it->second.machine_id]
+                    = std::make_pair(it->second.ips, it->second.reql_port);
+            }
+        }
+    }
+
+    // `shards` is a set ordered by region, which for regions that span all of the
+    // hashes is the order of their keys.
+    datum_ptr_t shards_datum(datum_t::R_ARRAY);
+    for (auto it = shards.begin(); it != shards.end(); ++it) {
+        counted_t<const datum_t> primary
+            = make_counted<const datum_t>(datum_t::R_NULL);
+        datum_ptr_t replicas(datum_t::R_ARRAY);
+        for (auto jt = blueprint.machines_roles.begin();
+             jt != blueprint.machines_roles.end(); ++jt) {
+            for (auto kt = jt->second.begin(); kt != jt->second.end(); ++kt) {
+                if (!region_is_superset(kt->first, *it)) {
+                    continue;
+                }
+                if (kt->second == blueprint_role_primary) {
+                    primary = machine_datum(jt->first, addresses);
+                } else if (kt->second == blueprint_role_secondary) {
+                    replicas.add(machine_datum(jt->first, addresses));
+                }
+            }
+        }
+
+        datum_ptr_t shard(datum_t::R_OBJECT);
+        bool b = shard.add("left", key_datum(it->inner.left));
+        b |= shard.add("right", it->inner.right.unbounded
+                       ? make_counted<const datum_t>(datum_t::R_NULL)
+                       : key_datum(it->inner.right.key));
+        b |= shard.add("primary", primary);
+        b |= shard.add("replicas", replicas.to_counted());
+        r_sanity_check(!b);
+        shards_datum.add(shard.to_counted());
+    }
+    counted_t<const datum_t> shards_array = shards_datum.to_counted();
+
+    // Datums print their objects' keys in order, so the same map always prints the
+    // same way.
+    const std::string printed = shards_array->print();
+    datum_ptr_t res(datum_t::R_OBJECT);
+    bool b = res.add("version", make_counted<const datum_t>(
+                         static_cast<double>(crc32c(0, printed.data(),
+                                                    printed.size()))));
+    b |= res.add("shards", shards_array);
+    r_sanity_check(!b);
+    return res.to_counted();
+}
+
+void check_shard_map_version(env_t *env, const uuid_u &table_id,
+                             const rcheckable_t *parent) {
+    if (env->cluster_access.directory_read_manager == NULL) {
+        // We're on a shard, where the query was checked already.
+        return;
+    }
+    counted_t<val_t> version = env->global_optargs.get_optarg(env, "shard_map_version");
+    if (!version.has()) {
+        return;
+    }
+    const double expected = version->as_num();
+    counted_t<const datum_t> shard_map = table_shard_map(env, table_id, parent);
+    const double actual = shard_map->get("version")->as_num();
+    if (expected != actual) {
+        env->stale_shard_map = shard_map;
+        rfail_target(parent, base_exc_t::STALE_SHARD_MAP,
+                     "Shard map version %.0f is stale (the table's is %.0f).",
+                     expected, actual);
+    }
+}
+
+}  // namespace ql
@@ -0,0 +1,44 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_SHARD_MAP_HPP_
+#define RDB_PROTOCOL_SHARD_MAP_HPP_
+
+#include "containers/counted.hpp"
+#include "containers/uuid.hpp"
+
+namespace ql {
+
+class datum_t;
+class env_t;
+class rcheckable_t;
+
+/* A table's shard map tells a client driver which machines have each of the
+table's shards, so that it can send a point read or write straight to the shard's
+primary instead of through whichever server it's connected to.  It looks like
+
+    {"version": 1234567,
+     "shards": [{"left": "S", "right": "Sm",
+                 "primary": {"machine": "<uuid>", "hosts": ["10.0.0.1"],
+                             "port": 28015},
+                 "replicas": [...]},
+                {"left": "Sm", "right": null, ...}]}
+
+The shards are in key order.  "left" (inclusive) and "right" (exclusive, or null
+at the end) bound the shard's primary keys in the form the btree stores them (see
+`datum_t::print_primary`).  A machine the server can't see has null "hosts" and
+"port", and a shard without a primary has a null "primary".  "version" changes
+whenever anything else in the map does. */
+counted_t<const datum_t> table_shard_map(env_t *env, const uuid_u &table_id,
+                                         const rcheckable_t *parent);
+
+/* If the query has a "shard_map_version" global optarg, which a driver sets when it
+routes a query by its shard map, and that isn't the version of the table's map
+any more, this puts the table's map in `env->stale_shard_map` and fails with a
+`STALE_SHARD_MAP` error.  The driver gets the new map in a `STALE_SHARD_MAP`
+response, and sends the query again to where the map says, rather than having
+its queries quietly forwarded over the cluster from then on. */
+void check_shard_map_version(env_t *env, const uuid_u &table_id,
+                             const rcheckable_t *parent);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_SHARD_MAP_HPP_
@@ -0,0 +1,132 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/sort_key.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "containers/wire_string.hpp"
+
+namespace ql {
+
+namespace {
+
+const char missing_tag = 0;
+
+// Appends an encoding of `value` that no other value's encoding starts with, and
+// returns false if it's a type we don't encode.
+bool encode_value(const datum_t &value, std::string *out) {
+    if (value.is_ptype()) {
+        return false;
+    }
+    switch (value.get_type()) {
+    case datum_t::R_NULL:
+    case datum_t::R_BOOL:
+    case datum_t::R_NUM:
+    case datum_t::R_STR:
+        break;
+    case datum_t::R_ARRAY:
+    case datum_t::R_OBJECT:
+        return false;
+    case datum_t::UNINITIALIZED:  // fallthru
+    default:
+        unreachable();
+    }
+
+    // Types are ordered by their enum values, after missing values.
+    out->push_back(static_cast<char>(1 + static_cast<int>(value.get_type())));
+    switch (value.get_type()) {
+    case datum_t::R_NULL:
+        break;
+    case datum_t::R_BOOL:
+        out->push_back(value.as_bool() ? 1 : 0);
+        break;
+    case datum_t::R_NUM: {
+        // `-0.0 == 0.0`, so they need the same encoding.
+        const double num = value.as_num() == 0 ? 0.0 : value.as_num();
+        uint64_t bits;
+        memcpy(&bits, &num, sizeof(bits));
+        // Negative numbers have every bit flipped, so that bigger magnitudes come
+        // first, and positive ones only the sign bit, so they come after.
+        bits = (bits & (uint64_t(1) << 63)) ? ~bits : bits | (uint64_t(1) << 63);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out->push_back(static_cast<char>((bits >> shift) & 0xFF));
+        }
+    } break;
+    case datum_t::R_STR: {
+        // Zero bytes are escaped, so that the terminator is the smallest thing that
+        // can follow the string and a string's encoding sorts before the encodings
+        // of the strings it's a prefix of.
+        const wire_string_t &str = value.as_str();
+        for (size_t i = 0; i < str.size(); ++i) {
+            out->push_back(str.data()[i]);
+            if (str.data()[i] == 0) {
+                out->push_back(1);
+            }
+        }
+        out->push_back(0);
+        out->push_back(0);
+    } break;
+    case datum_t::R_ARRAY:
+    case datum_t::R_OBJECT:
+    case datum_t::UNINITIALIZED:  // fallthru
+    default:
+        unreachable();
+    }
+    return true;
+}
+
+}  // namespace
+
+void sort_key_t::append(counted_t<const datum_t> value, bool descending) {
+    if (encoded_all) {
+        const size_t begin = prefix.size();
+        if (!value.has()) {
+            prefix.push_back(missing_tag);
+        } else if (!encode_value(*value, &prefix)) {
+            encoded_all = false;
+        }
+        if (descending) {
+            // Encodings are prefix-free, so flipping their bits reverses their order.
+            for (size_t i = begin; i < prefix.size(); ++i) {
+                prefix[i] = ~prefix[i];
+            }
+        }
+    }
+    values.push_back(std::make_pair(descending, std::move(value)));
+}
+
+int sort_key_t::cmp(const sort_key_t &other) const {
+    const size_t common = std::min(prefix.size(), other.prefix.size());
+    const int res = memcmp(prefix.data(), other.prefix.data(), common);
+    if (res != 0) {
+        return res;
+    }
+    if (encoded_all && other.encoded_all) {
+        r_sanity_check(prefix.size() == other.prefix.size());
+        return 0;
+    }
+    // One of them has a value we couldn't encode, and we can't tell it apart from
+    // the other's value without looking at both.
+    return cmp_values(other);
+}
+
+int sort_key_t::cmp_values(const sort_key_t &other) const {
+    r_sanity_check(values.size() == other.values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        const counted_t<const datum_t> &l = values[i].second;
+        const counted_t<const datum_t> &r = other.values[i].second;
+        int res;
+        if (!l.has() || !r.has()) {
+            res = static_cast<int>(l.has()) - static_cast<int>(r.has());
+        } else {
+            res = l->cmp(*r);
+        }
+        if (res != 0) {
+            return values[i].first ? -res : res;
+        }
+    }
+    return 0;
+}
+
+}  // namespace ql
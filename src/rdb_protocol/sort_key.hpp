@@ -0,0 +1,41 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_SORT_KEY_HPP_
+#define RDB_PROTOCOL_SORT_KEY_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "containers/counted.hpp"
+#include "rdb_protocol/datum.hpp"
+
+namespace ql {
+
+/* The values an element is ordered by, worked out once so that sorting doesn't
+re-evaluate them on every comparison.  As many of the leading values as are nulls,
+bools, numbers or strings are also encoded into `prefix` so that `memcmp` orders them
+like `datum_t::cmp`, and most comparisons never look at the datums.  A value that's
+missing (the function hit a non-existence error) sorts before everything else. */
+class sort_key_t {
+public:
+    sort_key_t() : encoded_all(true) { }
+
+    // `value` may be empty, for a missing value.
+    void append(counted_t<const datum_t> value, bool descending);
+
+    // Like `datum_t::cmp`, value by value, with the descending ones reversed.
+    int cmp(const sort_key_t &other) const;
+    bool operator<(const sort_key_t &other) const { return cmp(other) < 0; }
+
+private:
+    int cmp_values(const sort_key_t &other) const;
+
+    std::string prefix;
+    // Whether every value is in `prefix`.
+    bool encoded_all;
+    std::vector<std::pair<bool, counted_t<const datum_t> > > values;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_SORT_KEY_HPP_
@@ -1,6 +1,9 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/stream_cache.hpp"
 
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
 #include "rdb_protocol/env.hpp"
 
 namespace ql {
@@ -20,8 +23,83 @@ void stream_cache2_t::insert(int64_t key,
 }
 
 void stream_cache2_t::erase(int64_t key) {
-    size_t num_erased = streams.erase(key);
-    guarantee(num_erased == 1);
+    boost::ptr_map<int64_t, entry_t>::iterator it = streams.find(key);
+    guarantee(it != streams.end());
+    // This waits for any prefetch to stop.
+    it->second->drainer.reset();
+    prefetched_size -= it->second->prefetched_size;
+    prefetched_memory.set(prefetched_size);
+    streams.erase(it);
+}
+
+std::vector<counted_t<const datum_t> > stream_cache2_t::next_batch(
+        entry_t *entry, signal_t *interruptor) {
+    entry->batch_sizer.note_request(current_microtime());
+    if (entry->prefetch_done.has()) {
+        wait_interruptible(entry->prefetch_done.get(), interruptor);
+        entry->prefetch_done.reset();
+        prefetched_size -= entry->prefetched_size;
+        prefetched_memory.set(prefetched_size);
+        entry->prefetched_size = 0;
+        if (entry->prefetch_exception != std::exception_ptr()) {
+            std::rethrow_exception(entry->prefetch_exception);
+        }
+        return std::move(entry->prefetched);
+    }
+
+    // Reset the env_t's interruptor to a good one before we use it.  This may be a
+    // hack.  (I'd rather not have env_t be mutable this way -- could we construct
+    // a new env_t instead?  Why do we keep env_t's around anymore?)
+    entry->env->interruptor = interruptor;
+
+    std::vector<counted_t<const datum_t> > ds
+        = entry->stream->next_batch(
+            entry->env.get(),
+            entry->batch_sizer.next_batchspec(
+                batchspec_t::user(batch_type_t::NORMAL, entry->env.get()),
+                current_microtime()));
+    entry->batch_sizer.note_batch(ds.size(), current_microtime());
+    return ds;
+}
+
+void stream_cache2_t::maybe_start_prefetch(entry_t *entry) {
+    // A profiled query's trace goes out with the batch that made it, so we don't
+    // make batches ahead of time for them.
+    if ((entry->env->trace.has() && !entry->env->trace_is_sampled)
+        || prefetched_size >= CURSOR_PREFETCH_BUDGET) {
+        return;
+    }
+    guarantee(!entry->prefetch_done.has());
+    entry->prefetch_done.init(new cond_t);
+    entry->prefetch_exception = std::exception_ptr();
+    coro_t::spawn_sometime(std::bind(&stream_cache2_t::prefetch, this, entry,
+                                     entry->drainer->lock()));
+}
+
+void stream_cache2_t::prefetch(entry_t *entry, auto_drainer_t::lock_t keepalive) {
+    // Erasing the entry interrupts us.
+    entry->env->interruptor = keepalive.get_drain_signal();
+    try {
+        entry->prefetched = entry->stream->next_batch(
+            entry->env.get(),
+            entry->batch_sizer.next_batchspec(
+                batchspec_t::user(batch_type_t::NORMAL, entry->env.get()),
+                current_microtime()));
+        entry->batch_sizer.note_batch(entry->prefetched.size(), current_microtime());
+        if (!keepalive.get_drain_signal()->is_pulsed()) {
+            for (auto it = entry->prefetched.begin();
+                 it != entry->prefetched.end();
+                 ++it) {
+                entry->prefetched_size += serialized_size(*it);
+            }
+            prefetched_size += entry->prefetched_size;
+            prefetched_memory.set(prefetched_size);
+        }
+    } catch (const std::exception &) {
+        // We give the client the error when it asks for the batch.
+        entry->prefetch_exception = std::current_exception();
+    }
+    entry->prefetch_done->pulse();
 }
 
 bool stream_cache2_t::serve(int64_t key, Response *res, signal_t *interruptor) {
@@ -29,32 +107,38 @@ bool stream_cache2_t::serve(int64_t key, Response *res, signal_t *interruptor) {
     if (it == streams.end()) return false;
     entry_t *entry = it->second;
     entry->last_activity = time(0);
+    // We can't erase the entry in the catch block, because that waits for its
+    // prefetch.
+    std::exception_ptr exception;
     try {
-        // Reset the env_t's interruptor to a good one before we use it.  This may be a
-        // hack.  (I'd rather not have env_t be mutable this way -- could we construct
-        // a new env_t instead?  Why do we keep env_t's around anymore?)
-        entry->env->interruptor = interruptor;
-
-        std::vector<counted_t<const datum_t> > ds
-            = entry->stream->next_batch(
-                entry->env.get(),
-                batchspec_t::user(batch_type_t::NORMAL, entry->env.get()));
+        with_priority_t priority(entry->env->coro_priority());
+        std::vector<counted_t<const datum_t> > ds = next_batch(entry, interruptor);
         for (auto d = ds.begin(); d != ds.end(); ++d) {
             (*d)->write_to_protobuf(res->add_response(), entry->use_json);
         }
-        if (entry->env->trace.has()) {
+        if (entry->env->trace_is_sampled) {
+            // The query trace log already has what it wants from the trace, so we
+            // don't let it grow with every batch.
+            UNUSED profile::event_log_t discarded
+                = std::move(*entry->env->trace).extract_event_log();
+        } else if (entry->env->trace.has()) {
             entry->env->trace->as_datum()->write_to_protobuf(
                 res->mutable_profile(), entry->use_json);
         }
-    } catch (const std::exception &e) {
+    } catch (const std::exception &) {
+        exception = std::current_exception();
+    }
+    if (exception != std::exception_ptr()) {
         erase(key);
-        throw;
+        std::rethrow_exception(exception);
     }
+    entry->batch_sizer.note_sent(current_microtime());
     if (entry->stream->is_exhausted() || res->response_size() == 0) {
         erase(key);
         res->set_type(Response::SUCCESS_SEQUENCE);
     } else {
         res->set_type(Response::SUCCESS_PARTIAL);
+        maybe_start_prefetch(entry);
     }
 
     return true;
@@ -72,7 +156,9 @@ stream_cache2_t::entry_t::entry_t(time_t _last_activity,
       use_json(_use_json),
       env(std::move(env_ptr)),
       stream(_stream),
-      max_age(DEFAULT_MAX_AGE) { }
+      max_age(DEFAULT_MAX_AGE),
+      prefetched_size(0),
+      drainer(new auto_drainer_t) { }
 
 stream_cache2_t::entry_t::~entry_t() { }
 
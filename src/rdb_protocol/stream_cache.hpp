@@ -4,13 +4,18 @@
 
 #include <time.h>
 
+#include <exception>
 #include <map>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/ptr_container/ptr_map.hpp>
 
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/signal.hpp"
 #include "containers/scoped.hpp"
+#include "perfmon/memory.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/ql2.pb.h"
 
@@ -20,9 +25,15 @@ class env_t;
 
 namespace ql {
 
+/* Once it has served a batch of a stream, the stream cache starts fetching the next
+one in the background, so that the CONTINUE for it doesn't have to wait on the
+shards.  (The prefetches of a connection's streams only compete with each other and
+with the connection's running queries, which CORO_UNORDERED mode bounds.)  A
+connection's queries run concurrently, but never two with the same token. */
 class stream_cache2_t {
 public:
-    stream_cache2_t() { }
+    stream_cache2_t()
+        : prefetched_size(0), prefetched_memory(memory_category_t::cursors) { }
     MUST_USE bool contains(int64_t key);
     void insert(int64_t key,
                 use_json_t use_json,
@@ -33,6 +44,13 @@ public:
 private:
     void maybe_evict();
 
+    struct entry_t;
+    // Gets the next batch for `entry`, from its prefetch if there is one.
+    std::vector<counted_t<const datum_t> > next_batch(entry_t *entry,
+                                                      signal_t *interruptor);
+    void maybe_start_prefetch(entry_t *entry);
+    void prefetch(entry_t *entry, auto_drainer_t::lock_t keepalive);
+
     struct entry_t {
         ~entry_t(); // `env_t` is incomplete
         static const time_t DEFAULT_MAX_AGE = 0; // 0 = never evict
@@ -44,11 +62,25 @@ private:
         use_json_t use_json;
         scoped_ptr_t<env_t> env;
         counted_t<datum_stream_t> stream;
+        cursor_batch_sizer_t batch_sizer;
         time_t max_age;
+
+        // Set while a prefetch is running or its batch hasn't been served.
+        scoped_ptr_t<cond_t> prefetch_done;
+        std::vector<counted_t<const datum_t> > prefetched;
+        size_t prefetched_size;
+        std::exception_ptr prefetch_exception;
+        // Destroyed first, so that it waits for the prefetch to stop before the
+        // environment and stream it uses go away.
+        scoped_ptr_t<auto_drainer_t> drainer;
     private:
         DISABLE_COPYING(entry_t);
     };
 
+    // How big the batches that have been prefetched but not served yet are, in all.
+    size_t prefetched_size;
+    // Counts `prefetched_size` in the node's memory accounting.
+    memory_accounted_t prefetched_memory;
     boost::ptr_map<int64_t, entry_t> streams;
     DISABLE_COPYING(stream_cache2_t);
 };
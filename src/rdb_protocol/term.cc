@@ -5,6 +5,8 @@
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/plan_cache.hpp"
+#include "rdb_protocol/query_trace_log.hpp"
 #include "rdb_protocol/stream_cache.hpp"
 #include "rdb_protocol/term_walker.hpp"
 #include "rdb_protocol/validate.hpp"
@@ -16,9 +18,65 @@
 
 namespace ql {
 
-counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
+namespace {
+
+/* A subtree of a function body that's deterministic and doesn't use any variables,
+like `r.expr([1, 2, 3])` or `r.epoch_time(0)`, evaluates to the same thing every
+time the function is called.  So the first evaluation in an env keeps its value for
+the rest of them.  The terms can be shared between queries (see `plan_cache_t`), and
+plan parameters differ between them, so the value is only good for that env. */
+class folded_term_t : public term_t {
+public:
+    explicit folded_term_t(counted_t<term_t> _term)
+        : term_t(_term->get_src()), term(std::move(_term)), env_id(0),
+          foldable(true) { }
+private:
+    virtual void accumulate_captures(var_captures_t *captures) const {
+        term->accumulate_captures(captures);
+    }
+    virtual bool is_deterministic() const { return true; }
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, eval_flags_t flags) {
+        if (!foldable || flags != NO_FLAGS) {
+            return term->eval(env, flags);
+        }
+        if (value.has() && env_id == env->env->id) {
+            return value;
+        }
+        counted_t<val_t> ret = term->eval(env, flags);
+        if (ret->get_type().get_raw_type() == val_t::type_t::DATUM) {
+            value = ret;
+            env_id = env->env->id;
+        } else {
+            // Streams have state, and functions are cheap to make anyway.
+            foldable = false;
+        }
+        return ret;
+    }
+    virtual const char *name() const { return term->name(); }
+
+    const counted_t<term_t> term;
+    counted_t<val_t> value;
+    uint64_t env_id;
+    bool foldable;
+};
+
+bool is_foldable(const Term &t, const counted_t<term_t> &term) {
+    // Literals and terms without arguments are as cheap as looking up a value.
+    if (t.type() == Term::DATUM || t.type() == Term::FUNC
+        || (t.args_size() == 0 && t.optargs_size() == 0)) {
+        return false;
+    }
+    if (!term->is_deterministic()) {
+        return false;
+    }
+    var_captures_t captures;
+    term->accumulate_captures(&captures);
+    return captures.vars_captured.empty() && !captures.implicit_is_captured;
+}
+
+counted_t<term_t> compile_unfolded_term(compile_env_t *env, protob_t<const Term> t) {
     switch (t->type()) {
-    case Term::DATUM:              return make_datum_term(t);
+    case Term::DATUM:              return make_datum_term(env, t);
     case Term::MAKE_ARRAY:         return make_make_array_term(env, t);
     case Term::MAKE_OBJ:           return make_make_obj_term(env, t);
     case Term::VAR:                return make_var_term(env, t);
@@ -29,6 +87,9 @@ counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
     case Term::TABLE:              return make_table_term(env, t);
     case Term::GET:                return make_get_term(env, t);
     case Term::GET_ALL:            return make_get_all_term(env, t);
+    case Term::GET_IN_BOX:         return make_get_in_box_term(env, t);
+    case Term::GET_IN_CIRCLE:      return make_get_in_circle_term(env, t);
+    case Term::GET_BY_WORDS:       return make_get_by_words_term(env, t);
     case Term::EQ:                 // fallthru
     case Term::NE:                 // fallthru
     case Term::LT:                 // fallthru
@@ -95,6 +156,7 @@ counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
     case Term::TABLE_DROP:         return make_table_drop_term(env, t);
     case Term::TABLE_LIST:         return make_table_list_term(env, t);
     case Term::SYNC:               return make_sync_term(env, t);
+    case Term::CHANGES:            return make_changes_term(env, t);
     case Term::INDEX_CREATE:       return make_sindex_create_term(env, t);
     case Term::INDEX_DROP:         return make_sindex_drop_term(env, t);
     case Term::INDEX_LIST:         return make_sindex_list_term(env, t);
@@ -109,6 +171,7 @@ counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
     case Term::ASC:                return make_asc_term(env, t);
     case Term::DESC:               return make_desc_term(env, t);
     case Term::INFO:               return make_info_term(env, t);
+    case Term::SHARD_MAP:          return make_shard_map_term(env, t);
     case Term::MATCH:              return make_match_term(env, t);
     case Term::UPCASE:             return make_upcase_term(env, t);
     case Term::DOWNCASE:           return make_downcase_term(env, t);
@@ -163,10 +226,57 @@ counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
     unreachable();
 }
 
+}  // namespace
+
+counted_t<term_t> compile_term(compile_env_t *env, protob_t<const Term> t) {
+    counted_t<term_t> term = compile_unfolded_term(env, t);
+    // Outside of functions, terms are only evaluated once anyway.
+    if (env->visibility.in_function() && is_foldable(*t, term)) {
+        return make_counted<folded_term_t>(std::move(term));
+    }
+    return term;
+}
+
+/* Hands a started query to the server's query trace log once `run` is done with it.
+It has to be constructed after the query's `env_t`, so that it's destroyed while the
+`env_t` (and its trace) is still around, unless the `env_t` went to the stream
+cache, which is when `note_trace` must be called. */
+class query_trace_noter_t {
+public:
+    query_trace_noter_t(query_trace_log_t *_log,
+                        const protob_t<Query> &_query,
+                        microtime_t _start_time,
+                        ticks_t _start_ticks,
+                        const scoped_ptr_t<env_t> *_env)
+        : log(_log), query(_query), start_time(_start_time),
+          start_ticks(_start_ticks), env(_env) { }
+    ~query_trace_noter_t() {
+        if (env->has()) {
+            note_trace();
+        }
+        log->note_query(*query, start_time, get_ticks() - start_ticks, trace_json);
+    }
+    void note_trace() {
+        if ((*env)->trace_is_sampled) {
+            trace_json = (*env)->trace->as_datum()->as_json().PrintUnformatted();
+        }
+    }
+private:
+    query_trace_log_t *log;
+    protob_t<Query> query;
+    microtime_t start_time;
+    ticks_t start_ticks;
+    const scoped_ptr_t<env_t> *env;
+    boost::optional<std::string> trace_json;
+
+    DISABLE_COPYING(query_trace_noter_t);
+};
+
 void run(protob_t<Query> q,
          rdb_protocol_t::context_t *ctx,
          signal_t *interruptor,
          Response *res,
+         plan_cache_t *plan_cache,
          stream_cache2_t *stream_cache2) {
     try {
         validate_pb(*q);
@@ -183,20 +293,31 @@ void run(protob_t<Query> q,
 
     switch (q->type()) {
     case Query_QueryType_START: {
-        threadnum_t th = get_thread_id();
+        microtime_t start_time = current_microtime();
+        ticks_t start_ticks = get_ticks();
         scoped_ptr_t<ql::env_t> env(
             new ql::env_t(
                 ctx->extproc_pool, ctx->ns_repo,
-                ctx->cross_thread_namespace_watchables[th.threadnum]->get_watchable(),
-                ctx->cross_thread_database_watchables[th.threadnum]->get_watchable(),
+                ctx->cross_thread_namespace_watchables->get_watchable(),
+                ctx->cross_thread_database_watchables->get_watchable(),
                 ctx->cluster_metadata, ctx->directory_read_manager,
                 interruptor, ctx->machine_id, q));
+        env->io_backender = ctx->io_backender;
+        env->spill_path = ctx->base_path;
+        env->mailbox_manager = ctx->mailbox_manager;
+        if (!env->trace.has() && ctx->query_traces.should_sample()) {
+            env->trace.init(new profile::trace_t());
+            env->trace_is_sampled = true;
+        }
+        // The prefetches of the query's stream inherit this priority.
+        with_priority_t priority(env->coro_priority());
+        query_trace_noter_t trace_noter(&ctx->query_traces, q, start_time, start_ticks,
+                                        &env);
 
         counted_t<term_t> root_term;
         try {
             Term *t = q->mutable_query();
-            compile_env_t compile_env((var_visibility_t()));
-            root_term = compile_term(&compile_env, q.make_child(t));
+            root_term = plan_cache->compile(env.get(), q.make_child(t));
             // TODO: handle this properly
         } catch (const exc_t &e) {
             fill_error(res, Response::COMPILE_ERROR, e.what(), e.backtrace());
@@ -218,6 +339,20 @@ void run(protob_t<Query> q,
             return;
         }
 
+        std::string result_cache_key;
+        // Not when the client wants a profile, which a cached result wouldn't have.
+        const bool result_cacheable = (!env->trace.has() || env->trace_is_sampled)
+            && result_cache_t::cache_key(*q, &result_cache_key);
+        if (result_cacheable) {
+            if (ctx->result_cache.get(env.get(), result_cache_key,
+                                      res->add_response())) {
+                res->set_type(Response_ResponseType_SUCCESS_ATOM);
+                return;
+            }
+            res->clear_response();
+            env->table_versions.init(new table_versions_t());
+        }
+
         try {
             scope_env_t scope_env(env.get(), var_scope_t());
             counted_t<val_t> val = root_term->eval(&scope_env);
@@ -225,7 +360,11 @@ void run(protob_t<Query> q,
                 res->set_type(Response_ResponseType_SUCCESS_ATOM);
                 counted_t<const datum_t> d = val->as_datum();
                 d->write_to_protobuf(res->add_response(), use_json);
-                if (env->trace.has()) {
+                if (result_cacheable) {
+                    ctx->result_cache.put(result_cache_key, *env->table_versions,
+                                          res->response(0));
+                }
+                if (env->trace.has() && !env->trace_is_sampled) {
                     env->trace->as_datum()->write_to_protobuf(
                         res->mutable_profile(), use_json);
                 }
@@ -234,11 +373,17 @@ void run(protob_t<Query> q,
                 if (counted_t<const datum_t> arr = seq->as_array(env.get())) {
                     res->set_type(Response_ResponseType_SUCCESS_ATOM);
                     arr->write_to_protobuf(res->add_response(), use_json);
-                    if (env->trace.has()) {
+                    if (result_cacheable) {
+                        ctx->result_cache.put(result_cache_key, *env->table_versions,
+                                              res->response(0));
+                    }
+                    if (env->trace.has() && !env->trace_is_sampled) {
                         env->trace->as_datum()->write_to_protobuf(
                             res->mutable_profile(), use_json);
                     }
                 } else {
+                    trace_noter.note_trace();
+                    env->table_versions.reset();
                     stream_cache2->insert(token, use_json, std::move(env), seq);
                     bool b = stream_cache2->serve(token, res, interruptor);
                     r_sanity_check(b);
@@ -249,6 +394,15 @@ void run(protob_t<Query> q,
                                val->get_type().name());
             }
         } catch (const exc_t &e) {
+            if (e.get_type() == base_exc_t::STALE_SHARD_MAP && env.has()
+                && env->stale_shard_map.has()) {
+                // The client routed the query by an old shard map; send it the
+                // current one.
+                res->clear_response();
+                res->set_type(Response::STALE_SHARD_MAP);
+                env->stale_shard_map->write_to_protobuf(res->add_response(), use_json);
+                return;
+            }
             fill_error(res, Response::RUNTIME_ERROR, e.what(), e.backtrace());
             return;
         } catch (const datum_exc_t &e) {
@@ -292,9 +446,9 @@ void run(protob_t<Query> q,
         }
 
         // NOREPLY_WAIT is just a no-op.
-        // This works because we only evaluate one Query at a time
-        // on the connection level. Once we get to the NOREPLY_WAIT Query
-        // we know that all previous Queries have completed processing.
+        // This works because the server doesn't start a NOREPLY_WAIT
+        // Query until all of the connection's previous Queries have
+        // completed processing (see `request_waits_for_earlier`).
 
         // Send back a WAIT_COMPLETE response.
         res->set_type(Response_ResponseType_WAIT_COMPLETE);
@@ -124,6 +124,10 @@ private:
         case Term::TABLE:
         case Term::GET:
         case Term::GET_ALL:
+        case Term::GET_IN_BOX:
+        case Term::GET_IN_CIRCLE:
+        case Term::GET_BY_WORDS:
+        case Term::CHANGES:
         case Term::EQ:
         case Term::NE:
         case Term::LT:
@@ -184,6 +188,7 @@ private:
         case Term::ASC:
         case Term::DESC:
         case Term::INFO:
+        case Term::SHARD_MAP:
         case Term::MATCH:
         case Term::UPCASE:
         case Term::DOWNCASE:
@@ -285,6 +290,10 @@ private:
         case Term::TABLE:
         case Term::GET:
         case Term::GET_ALL:
+        case Term::GET_IN_BOX:
+        case Term::GET_IN_CIRCLE:
+        case Term::GET_BY_WORDS:
+        case Term::CHANGES:
         case Term::EQ:
         case Term::NE:
         case Term::LT:
@@ -347,6 +356,7 @@ private:
         case Term::ASC:
         case Term::DESC:
         case Term::INFO:
+        case Term::SHARD_MAP:
         case Term::MATCH:
         case Term::UPCASE:
         case Term::DOWNCASE:
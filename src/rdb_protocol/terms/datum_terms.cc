@@ -4,6 +4,7 @@
 #include <string>
 
 #include "rdb_protocol/op.hpp"
+#include "rdb_protocol/plan_cache.hpp"
 
 namespace ql {
 
@@ -21,6 +22,22 @@ private:
     counted_t<val_t> raw_val;
 };
 
+// A literal whose value the query supplies in `env_t::plan_params`.
+class plan_param_term_t : public term_t {
+public:
+    plan_param_term_t(protob_t<const Term> t, size_t _index)
+        : term_t(t), index(_index) { }
+private:
+    virtual void accumulate_captures(var_captures_t *) const { /* do nothing */ }
+    virtual bool is_deterministic() const { return true; }
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        r_sanity_check(index < env->env->plan_params.size());
+        return new_val(env->env->plan_params[index]);
+    }
+    virtual const char *name() const { return "datum"; }
+    const size_t index;
+};
+
 class constant_term_t : public op_term_t {
 public:
     constant_term_t(compile_env_t *env, protob_t<const Term> t,
@@ -77,7 +94,11 @@ private:
     virtual const char *name() const { return "make_obj"; }
 };
 
-counted_t<term_t> make_datum_term(const protob_t<const Term> &term) {
+counted_t<term_t> make_datum_term(compile_env_t *env, const protob_t<const Term> &term) {
+    size_t index;
+    if (env->plan_params != NULL && env->plan_params->compile_param(term.get(), &index)) {
+        return make_counted<plan_param_term_t>(term, index);
+    }
     return make_counted<datum_term_t>(term);
 }
 counted_t<term_t> make_constant_term(compile_env_t *env, const protob_t<const Term> &term,
@@ -6,6 +6,7 @@
 
 #include "clustering/administration/main/ports.hpp"
 #include "clustering/administration/suggester.hpp"
+#include "config/args.hpp"
 #include "containers/wire_string.hpp"
 #include "rdb_protocol/meta_utils.hpp"
 #include "rdb_protocol/op.hpp"
@@ -176,7 +177,9 @@ public:
     table_create_term_t(compile_env_t *env, const protob_t<const Term> &term) :
         meta_write_op_t(env, term, argspec_t(1, 2),
                         optargspec_t({"datacenter", "primary_key",
-                                    "cache_size", "durability"})) { }
+                                    "cache_size", "cpu_sharding_factor",
+                                    "inline_value_size", "write_buffer_size",
+                                    "time_ordered_keys", "durability"})) { }
 private:
     virtual std::string write_eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         uuid_u dc_id = nil_uuid();
@@ -204,6 +207,40 @@ private:
             cache_size = v->as_int<int64_t>();
         }
 
+        int32_t cpu_sharding_factor = CPU_SHARDING_FACTOR;
+        if (counted_t<val_t> v = optarg(env, "cpu_sharding_factor")) {
+            cpu_sharding_factor = v->as_int<int32_t>();
+            rcheck(cpu_sharding_factor >= 1
+                   && cpu_sharding_factor <= MAX_CPU_SHARDING_FACTOR,
+                   base_exc_t::GENERIC,
+                   strprintf("`cpu_sharding_factor` must be between 1 and %d.",
+                             MAX_CPU_SHARDING_FACTOR));
+        }
+
+        int32_t inline_value_size = DEFAULT_INLINE_VALUE_SIZE;
+        if (counted_t<val_t> v = optarg(env, "inline_value_size")) {
+            inline_value_size = v->as_int<int32_t>();
+            rcheck(inline_value_size >= DEFAULT_INLINE_VALUE_SIZE
+                   && inline_value_size <= MAX_INLINE_VALUE_SIZE,
+                   base_exc_t::GENERIC,
+                   strprintf("`inline_value_size` must be between %d and %d.",
+                             DEFAULT_INLINE_VALUE_SIZE, MAX_INLINE_VALUE_SIZE));
+        }
+
+        int64_t write_buffer_size = DEFAULT_WRITE_BUFFER_SIZE;
+        if (counted_t<val_t> v = optarg(env, "write_buffer_size")) {
+            write_buffer_size = v->as_int<int64_t>();
+            rcheck(write_buffer_size >= 0 && write_buffer_size <= MAX_WRITE_BUFFER_SIZE,
+                   base_exc_t::GENERIC,
+                   strprintf("`write_buffer_size` must be between 0 and %" PRIi64 ".",
+                             static_cast<int64_t>(MAX_WRITE_BUFFER_SIZE)));
+        }
+
+        bool time_ordered_keys = false;
+        if (counted_t<val_t> v = optarg(env, "time_ordered_keys")) {
+            time_ordered_keys = v->as_bool();
+        }
+
         uuid_u db_id;
         name_string_t tbl_name;
         if (num_args() == 1) {
@@ -234,7 +271,9 @@ private:
             namespace_semilattice_metadata_t<rdb_protocol_t> ns =
                 new_namespace<rdb_protocol_t>(env->env->cluster_access.this_machine, db_id, dc_id, tbl_name,
                                               primary_key, port_defaults::reql_port,
-                                              cache_size);
+                                              cache_size, cpu_sharding_factor,
+                                              inline_value_size, write_buffer_size,
+                                              time_ordered_keys);
 
             // Set Durability
             std::map<datacenter_id_t, ack_expectation_t> *ack_map =
@@ -448,6 +487,32 @@ private:
     virtual const char *name() const { return "sync"; }
 };
 
+class changes_term_t : public op_term_t {
+public:
+    changes_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(1)) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<table_t> t = arg(env, 0)->as_table();
+        return new_val(env->env, t->changes(env->env, this, backtrace()));
+    }
+    virtual bool is_deterministic() const { return false; }
+    virtual const char *name() const { return "changes"; }
+};
+
+class shard_map_term_t : public op_term_t {
+public:
+    shard_map_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(1)) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<table_t> t = arg(env, 0)->as_table();
+        return new_val(t->shard_map(env->env));
+    }
+    virtual bool is_deterministic() const { return false; }
+    virtual const char *name() const { return "shard_map"; }
+};
+
 class table_term_t : public op_term_t {
 public:
     table_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -509,12 +574,17 @@ private:
                 = make_counted<union_datum_stream_t>(streams, backtrace());
             return new_val(stream, table);
         } else {
-            datum_ptr_t arr(datum_t::R_ARRAY);
+            std::vector<counted_t<const datum_t> > keys;
+            keys.reserve(num_args() - 1);
             for (size_t i = 1; i < num_args(); ++i) {
-                counted_t<const datum_t> key = arg(env, i)->as_datum();
-                counted_t<const datum_t> row = table->get_row(env->env, key);
-                if (row->get_type() != datum_t::R_NULL) {
-                    arr.add(row);
+                keys.push_back(arg(env, i)->as_datum());
+            }
+            std::vector<counted_t<const datum_t> > rows
+                = table->get_rows(env->env, keys);
+            datum_ptr_t arr(datum_t::R_ARRAY);
+            for (auto it = rows.begin(); it != rows.end(); ++it) {
+                if ((*it)->get_type() != datum_t::R_NULL) {
+                    arr.add(*it);
                 }
             }
             counted_t<datum_stream_t> stream
@@ -525,6 +595,80 @@ private:
     virtual const char *name() const { return "get_all"; }
 };
 
+class get_in_region_term_t : public op_term_t {
+public:
+    get_in_region_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(3), optargspec_t({ "index" })) { }
+private:
+    virtual geo_region_t region(scope_env_t *env) = 0;
+
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<table_t> table = arg(env, 0)->as_table();
+        counted_t<val_t> index = optarg(env, "index");
+        rcheck(index, base_exc_t::GENERIC,
+               strprintf("%s requires a geo index (the `index` optarg).", name()));
+        geo_region_t r = region(env);
+        counted_t<datum_stream_t> stream
+            = table->get_in_region(env->env, r, index->as_str().to_std(), backtrace());
+        return new_val(stream, table);
+    }
+};
+
+static geo_point_t point_arg(counted_t<val_t> val) {
+    try {
+        return geo_point_from_datum(val->as_datum());
+    } catch (const datum_exc_t &e) {
+        rfail_target(val.get(), e.get_type(), "%s", e.what());
+    }
+}
+
+class get_in_box_term_t : public get_in_region_term_t {
+public:
+    get_in_box_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : get_in_region_term_t(env, term) { }
+private:
+    virtual geo_region_t region(scope_env_t *env) {
+        return geo_region_t::box(point_arg(arg(env, 1)),
+                                 point_arg(arg(env, 2)));
+    }
+    virtual const char *name() const { return "get_in_box"; }
+};
+
+class get_in_circle_term_t : public get_in_region_term_t {
+public:
+    get_in_circle_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : get_in_region_term_t(env, term) { }
+private:
+    virtual geo_region_t region(scope_env_t *env) {
+        geo_point_t center = point_arg(arg(env, 1));
+        counted_t<val_t> radius_val = arg(env, 2);
+        double radius = radius_val->as_num();
+        rcheck_target(radius_val.get(), base_exc_t::GENERIC, radius >= 0,
+                      strprintf("Radius `%g` is negative.", radius));
+        return geo_region_t::circle(center, radius);
+    }
+    virtual const char *name() const { return "get_in_circle"; }
+};
+
+class get_by_words_term_t : public op_term_t {
+public:
+    get_by_words_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(2), optargspec_t({ "index" })) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<table_t> table = arg(env, 0)->as_table();
+        std::string text = arg(env, 1)->as_str().to_std();
+        counted_t<val_t> index = optarg(env, "index");
+        rcheck(index, base_exc_t::GENERIC,
+               "get_by_words requires a text index (the `index` optarg).");
+        counted_t<datum_stream_t> stream
+            = table->get_by_words(env->env, text, index->as_str().to_std(),
+                                  backtrace());
+        return new_val(stream, table);
+    }
+    virtual const char *name() const { return "get_by_words"; }
+};
+
 counted_t<term_t> make_db_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<db_term_t>(env, term);
 }
@@ -541,6 +685,18 @@ counted_t<term_t> make_get_all_term(compile_env_t *env, const protob_t<const Ter
     return make_counted<get_all_term_t>(env, term);
 }
 
+counted_t<term_t> make_get_in_box_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<get_in_box_term_t>(env, term);
+}
+
+counted_t<term_t> make_get_in_circle_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<get_in_circle_term_t>(env, term);
+}
+
+counted_t<term_t> make_get_by_words_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<get_by_words_term_t>(env, term);
+}
+
 counted_t<term_t> make_db_create_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<db_create_term_t>(env, term);
 }
@@ -569,6 +725,13 @@ counted_t<term_t> make_sync_term(compile_env_t *env, const protob_t<const Term>
     return make_counted<sync_term_t>(env, term);
 }
 
+counted_t<term_t> make_changes_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<changes_term_t>(env, term);
+}
+counted_t<term_t> make_shard_map_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<shard_map_term_t>(env, term);
+}
+
 
 
 } // namespace ql
@@ -11,13 +11,13 @@ public:
 
     counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         const wire_string_t &data = arg(env, 0)->as_str();
-        scoped_cJSON_t cjson(cJSON_Parse(data.c_str()));
-        rcheck(cjson.get() != NULL, base_exc_t::GENERIC,
+        counted_t<const datum_t> datum = datum_t::from_json(data.c_str());
+        rcheck(datum.has(), base_exc_t::GENERIC,
                strprintf("Failed to parse \"%s\" as JSON.",
                  (data.size() > 40
                   ? (data.to_std().substr(0, 37) + "...").c_str()
                   : data.c_str())));
-        return new_val(make_counted<const datum_t>(cjson.get()));
+        return new_val(datum);
     }
 
     virtual const char *name() const { return "json"; }
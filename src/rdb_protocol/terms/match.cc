@@ -15,7 +15,8 @@ public:
 private:
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         std::string str = arg(env, 0)->as_str().to_std();
-        RE2 regexp(arg(env, 1)->as_str().c_str());
+        const RE2 &regexp =
+            *env->env->regex_cache.get(arg(env, 1)->as_str().to_std());
         if (!regexp.ok()) {
             rfail(base_exc_t::GENERIC,
                   "Error in regexp `%s` (portion `%s`): %s",
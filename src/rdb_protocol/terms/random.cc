@@ -33,10 +33,14 @@ public:
         }
 
         std::vector<counted_t<const datum_t> > result;
-        result.reserve(num);
-        size_t element_number = 0;
-        batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
-        {
+        reservoir_t reservoir;
+        // A table's shards each sample their own rows, and only send us those.
+        if (seq->sample(env->env, sample_wire_func_t(num), &reservoir)) {
+            result = std::move(reservoir.sample);
+        } else {
+            result.reserve(num);
+            size_t element_number = 0;
+            batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
             profile::sampler_t sampler("Sampling elements.", env->env->trace);
             while (counted_t<const datum_t> row = seq->next(env->env, batchspec)) {
                 element_number++;
@@ -237,39 +237,6 @@ public:
     virtual const char *name() const { return "outer_join"; }
 };
 
-class eq_join_term_t : public rewrite_term_t {
-public:
-    eq_join_term_t(compile_env_t *env, const protob_t<const Term> &term) :
-        rewrite_term_t(env, term, argspec_t(3), rewrite) { }
-private:
-
-    static r::reql_t rewrite(protob_t<const Term> in,
-                             UNUSED const pb_rcheckable_t *bt_src,
-                             protob_t<const Term> optargs_in) {
-        const Term &left = in->args(0);
-        const Term &left_attr = in->args(1);
-        const Term &right = in->args(2);
-
-        auto row = pb::dummy_var_t::EQJOIN_ROW;
-        auto v = pb::dummy_var_t::EQJOIN_V;
-
-        r::reql_t get_all =
-            r::expr(right).get_all(
-                r::expr(left_attr)(row, r::optarg("_SHORTCUT_", GET_FIELD_SHORTCUT)));
-
-        get_all.copy_optargs_from_term(*optargs_in);
-
-        return
-            r::expr(left).concat_map(
-                r::fun(row,
-                    std::move(get_all).map(
-                        r::fun(v,
-                            r::object(r::optarg("left", row),
-                                      r::optarg("right", v))))));
-    }
-    virtual const char *name() const { return "inner_join"; }
-};
-
 class delete_term_t : public rewrite_term_t {
 public:
     delete_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -388,14 +355,17 @@ counted_t<term_t> make_groupby_term(compile_env_t *env, const protob_t<const Ter
     return make_counted<groupby_term_t>(env, term);
 }
 counted_t<term_t> make_inner_join_term(compile_env_t *env, const protob_t<const Term> &term) {
+    if (counted_t<term_t> hash_join = maybe_make_hash_join_term(env, term, false)) {
+        return hash_join;
+    }
     return make_counted<inner_join_term_t>(env, term);
 }
 counted_t<term_t> make_outer_join_term(compile_env_t *env, const protob_t<const Term> &term) {
+    if (counted_t<term_t> hash_join = maybe_make_hash_join_term(env, term, true)) {
+        return hash_join;
+    }
     return make_counted<outer_join_term_t>(env, term);
 }
-counted_t<term_t> make_eq_join_term(compile_env_t *env, const protob_t<const Term> &term) {
-    return make_counted<eq_join_term_t>(env, term);
-}
 counted_t<term_t> make_update_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<update_term_t>(env, term);
 }
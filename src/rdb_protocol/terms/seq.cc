@@ -164,6 +164,118 @@ private:
     virtual const char *name() const { return "zip"; }
 };
 
+class eq_join_term_t : public op_term_t {
+public:
+    eq_join_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(3), optargspec_t({"index"})) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<datum_stream_t> left = arg(env, 0)->as_seq(env->env);
+        counted_t<func_t> left_field = arg(env, 1)->as_func(GET_FIELD_SHORTCUT);
+        counted_t<table_t> right = arg(env, 2)->as_table();
+        counted_t<val_t> index = optarg(env, "index");
+        std::string index_str = index ? index->as_str().to_std() : right->get_pkey();
+        return new_val(env->env,
+                       make_counted<eq_join_datum_stream_t>(
+                           left, left_field, right, index_str));
+    }
+    virtual const char *name() const { return "eq_join"; }
+};
+
+class hash_join_term_t : public op_term_t {
+public:
+    hash_join_term_t(compile_env_t *env, const protob_t<const Term> &term,
+                     const std::string &_left_field, const std::string &_right_field,
+                     bool _outer)
+        : op_term_t(env, term, argspec_t(3)), left_field(_left_field),
+          right_field(_right_field), outer(_outer) { }
+private:
+    virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
+        counted_t<datum_stream_t> left = arg(env, 0)->as_seq(env->env);
+        counted_t<datum_stream_t> right = arg(env, 1)->as_seq(env->env);
+        counted_t<func_t> f = arg(env, 2)->as_func();
+        return new_val(env->env,
+                       make_counted<hash_join_datum_stream_t>(
+                           left, right, f, left_field, right_field, outer));
+    }
+    virtual const char *name() const { return outer ? "outer_join" : "inner_join"; }
+
+    const std::string left_field;
+    const std::string right_field;
+    const bool outer;
+};
+
+// If `t` is `r.row(field)` for the variable `var`, sets `*field_out`.
+static bool is_field_of_var(const Term &t, double var, std::string *field_out) {
+    if (t.type() != Term::GET_FIELD || t.args_size() != 2 || t.optargs_size() != 0) {
+        return false;
+    }
+    const Term &v = t.args(0);
+    if (v.type() != Term::VAR || v.args_size() != 1
+        || v.args(0).type() != Term::DATUM
+        || v.args(0).datum().type() != Datum::R_NUM
+        || v.args(0).datum().r_num() != var) {
+        return false;
+    }
+    if (t.args(1).type() != Term::DATUM || t.args(1).datum().type() != Datum::R_STR) {
+        return false;
+    }
+    *field_out = t.args(1).datum().r_str();
+    return true;
+}
+
+counted_t<term_t> maybe_make_hash_join_term(compile_env_t *env,
+                                            const protob_t<const Term> &term,
+                                            bool outer) {
+    if (term->args_size() != 3 || term->optargs_size() != 0) {
+        return counted_t<term_t>();
+    }
+    // The join function has to be a literal `function(l, r) { return
+    // l(left_field).eq(r(right_field)); }`, with the fields either way around.
+    const Term &func = term->args(2);
+    if (func.type() != Term::FUNC || func.args_size() != 2
+        || func.optargs_size() != 0) {
+        return counted_t<term_t>();
+    }
+    std::vector<double> vars;
+    const Term &arg_names = func.args(0);
+    if (arg_names.type() == Term::DATUM
+        && arg_names.datum().type() == Datum::R_ARRAY) {
+        for (int i = 0; i < arg_names.datum().r_array_size(); ++i) {
+            const Datum &d = arg_names.datum().r_array(i);
+            if (d.type() != Datum::R_NUM) {
+                return counted_t<term_t>();
+            }
+            vars.push_back(d.r_num());
+        }
+    } else if (arg_names.type() == Term::MAKE_ARRAY) {
+        for (int i = 0; i < arg_names.args_size(); ++i) {
+            const Term &t = arg_names.args(i);
+            if (t.type() != Term::DATUM || t.datum().type() != Datum::R_NUM) {
+                return counted_t<term_t>();
+            }
+            vars.push_back(t.datum().r_num());
+        }
+    }
+    if (vars.size() != 2 || vars[0] == vars[1]) {
+        return counted_t<term_t>();
+    }
+
+    const Term &body = func.args(1);
+    if (body.type() != Term::EQ || body.args_size() != 2 || body.optargs_size() != 0) {
+        return counted_t<term_t>();
+    }
+    std::string left_field, right_field;
+    if ((is_field_of_var(body.args(0), vars[0], &left_field)
+         && is_field_of_var(body.args(1), vars[1], &right_field))
+        || (is_field_of_var(body.args(0), vars[1], &right_field)
+            && is_field_of_var(body.args(1), vars[0], &left_field))) {
+        return make_counted<hash_join_term_t>(env, term, left_field, right_field,
+                                              outer);
+    }
+    return counted_t<term_t>();
+}
+
 counted_t<term_t> make_between_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<between_term_t>(env, term);
 }
@@ -185,6 +297,9 @@ counted_t<term_t> make_count_term(compile_env_t *env, const protob_t<const Term>
 counted_t<term_t> make_union_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<union_term_t>(env, term);
 }
+counted_t<term_t> make_eq_join_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<eq_join_term_t>(env, term);
+}
 counted_t<term_t> make_zip_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<zip_term_t>(env, term);
 }
@@ -16,7 +16,7 @@ namespace ql {
 class sindex_create_term_t : public op_term_t {
 public:
     sindex_create_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : op_term_t(env, term, argspec_t(2, 3), optargspec_t({"multi"})) { }
+        : op_term_t(env, term, argspec_t(2, 3), optargspec_t({"multi", "geo", "text"})) { }
 
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         counted_t<table_t> table = arg(env, 0)->as_table();
@@ -43,12 +43,19 @@ public:
         }
         r_sanity_check(index_func.has());
 
-        /* Check if we're doing a multi index or a normal index. */
+        /* Check if we're doing a multi index, a geo index, a text index or a
+           normal index. */
         counted_t<val_t> multi_val = optarg(env, "multi");
-        sindex_multi_bool_t multi =
-            (multi_val && multi_val->as_datum()->as_bool()
-             ? sindex_multi_bool_t::MULTI
-             : sindex_multi_bool_t::SINGLE);
+        counted_t<val_t> geo_val = optarg(env, "geo");
+        counted_t<val_t> text_val = optarg(env, "text");
+        sindex_multi_bool_t multi = sindex_multi_bool_t::SINGLE;
+        if (text_val && text_val->as_datum()->as_bool()) {
+            multi = sindex_multi_bool_t::TEXT;
+        } else if (geo_val && geo_val->as_datum()->as_bool()) {
+            multi = sindex_multi_bool_t::GEO;
+        } else if (multi_val && multi_val->as_datum()->as_bool()) {
+            multi = sindex_multi_bool_t::MULTI;
+        }
 
         bool success = table->sindex_create(env->env, name, index_func, multi);
         if (success) {
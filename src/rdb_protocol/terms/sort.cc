@@ -4,13 +4,11 @@
 #include <string>
 #include <utility>
 
-#include "errors.hpp"
-#include <boost/bind.hpp>
-
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/op.hpp"
+#include "rdb_protocol/sort_key.hpp"
 #include "rdb_protocol/term_walker.hpp"
 
 namespace ql {
@@ -51,60 +49,21 @@ public:
         : op_term_t(env, term, argspec_t(1, -1),
           optargspec_t({"index"})), src_term(term) { }
 private:
-    enum order_direction_t { ASC, DESC };
     class lt_cmp_t {
     public:
         typedef bool result_type;
-        explicit lt_cmp_t(
-            std::vector<std::pair<order_direction_t, counted_t<func_t> > > _comparisons)
-            : comparisons(std::move(_comparisons)) { }
+        explicit lt_cmp_t(const order_wire_func_t &_order) : order(_order) { }
 
         bool operator()(env_t *env,
                         profile::sampler_t *sampler,
                         counted_t<const datum_t> l,
                         counted_t<const datum_t> r) const {
             sampler->new_sample();
-            for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
-                counted_t<const datum_t> lval;
-                counted_t<const datum_t> rval;
-                try {
-                    lval = it->second->call(env, l)->as_datum();
-                } catch (const base_exc_t &e) {
-                    if (e.get_type() != base_exc_t::NON_EXISTENCE) {
-                        throw;
-                    }
-                }
-
-                try {
-                    rval = it->second->call(env, r)->as_datum();
-                } catch (const base_exc_t &e) {
-                    if (e.get_type() != base_exc_t::NON_EXISTENCE) {
-                        throw;
-                    }
-                }
-
-                if (!lval.has() && !rval.has()) {
-                    continue;
-                }
-                if (!lval.has()) {
-                    return true != (it->first == DESC);
-                }
-                if (!rval.has()) {
-                    return false != (it->first == DESC);
-                }
-                // TODO: use datum_t::cmp instead to be faster
-                if (*lval == *rval) {
-                    continue;
-                }
-                return (*lval < *rval) != (it->first == DESC);
-            }
-
-            return false;
+            return order.lt(env, l, r);
         }
 
     private:
-        const std::vector<std::pair<order_direction_t, counted_t<func_t> > >
-            comparisons;
+        const order_wire_func_t order;
     };
 
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
@@ -113,13 +72,16 @@ private:
         for (size_t i = 1; i < num_args(); ++i) {
             if (get_src()->args(i).type() == Term::DESC) {
                 comparisons.push_back(
-                        std::make_pair(DESC, arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
+                        std::make_pair(order_direction_t::DESC,
+                                       arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
             } else {
                 comparisons.push_back(
-                        std::make_pair(ASC, arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
+                        std::make_pair(order_direction_t::ASC,
+                                       arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
             }
         }
-        lt_cmp_t lt_cmp(comparisons);
+        const order_wire_func_t order(comparisons);
+        lt_cmp_t lt_cmp(order);
 
         counted_t<table_t> tbl;
         counted_t<datum_stream_t> seq;
@@ -167,23 +129,7 @@ private:
             }
             rcheck(!comparisons.empty(), base_exc_t::GENERIC,
                    "Must specify something to order by.");
-            std::vector<counted_t<const datum_t> > to_sort;
-            batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
-            for (;;) {
-                std::vector<counted_t<const datum_t> > data
-                    = seq->next_batch(env->env, batchspec);
-                if (data.size() == 0) {
-                    break;
-                }
-                std::move(data.begin(), data.end(), std::back_inserter(to_sort));
-                rcheck(to_sort.size() <= array_size_limit(), base_exc_t::GENERIC,
-                       strprintf("Array over size limit %zu.", to_sort.size()).c_str());
-            }
-            profile::sampler_t sampler("Sorting in-memory.", env->env->trace);
-            auto fn = boost::bind(lt_cmp, env->env, &sampler, _1, _2);
-            std::sort(to_sort.begin(), to_sort.end(), fn);
-            seq = make_counted<array_datum_stream_t>(
-                make_counted<const datum_t>(std::move(to_sort)), backtrace());
+            seq = make_counted<sort_datum_stream_t>(seq, lt_cmp, order);
         }
         return tbl.has() ? new_val(seq, tbl) : new_val(env->env, seq);
     }
@@ -199,32 +145,29 @@ public:
     distinct_term_t(compile_env_t *env, const protob_t<const Term> &term)
         : op_term_t(env, term, argspec_t(1)) { }
 private:
-    static bool lt_cmp(env_t *,
-                       counted_t<const datum_t> l,
-                       counted_t<const datum_t> r) {
-        return *l < *r;
-    }
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         counted_t<datum_stream_t> s = arg(env, 0)->as_seq(env->env);
-        std::vector<counted_t<const datum_t> > arr;
-        counted_t<const datum_t> last;
+        // Each element is its own sort key, which orders like `datum_t::cmp`.
+        typedef std::pair<sort_key_t, counted_t<const datum_t> > keyed_t;
+        std::vector<keyed_t> arr;
         batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
         {
             profile::sampler_t sampler("Evaluating elements in distinct.",
                                        env->env->trace);
             while (counted_t<const datum_t> d = s->next(env->env, batchspec)) {
-                arr.push_back(std::move(d));
+                sort_key_t key;
+                key.append(d, false);
+                arr.push_back(std::make_pair(std::move(key), std::move(d)));
                 rcheck_array_size(arr, base_exc_t::GENERIC);
                 sampler.new_sample();
             }
         }
         std::sort(arr.begin(), arr.end(),
-                  std::bind(lt_cmp, env->env,
-                            ph::_1, ph::_2));
+                  [](const keyed_t &l, const keyed_t &r) { return l.first < r.first; });
         std::vector<counted_t<const datum_t> > toret;
         for (auto it = arr.begin(); it != arr.end(); ++it) {
-            if (toret.size() == 0 || **it != *toret[toret.size()-1]) {
-                toret.push_back(std::move(*it));
+            if (it == arr.begin() || (it - 1)->first.cmp(it->first) != 0) {
+                toret.push_back(std::move(it->second));
             }
         }
         return new_val(make_counted<const datum_t>(std::move(toret)));
@@ -42,7 +42,7 @@ counted_t<term_t> make_branch_term(compile_env_t *env, const protob_t<const Term
 counted_t<term_t> make_funcall_term(compile_env_t *env, const protob_t<const Term> &term);
 
 // datum_terms.cc
-counted_t<term_t> make_datum_term(const protob_t<const Term> &term);
+counted_t<term_t> make_datum_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_constant_term(compile_env_t *env, const protob_t<const Term> &term,
                                      double constant, const char *name);
 counted_t<term_t> make_make_array_term(compile_env_t *env, const protob_t<const Term> &term);
@@ -53,6 +53,9 @@ counted_t<term_t> make_db_term(compile_env_t *env, const protob_t<const Term> &t
 counted_t<term_t> make_table_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_get_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_get_all_term(compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_get_in_box_term(compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_get_in_circle_term(compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_get_by_words_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_db_create_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_db_drop_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_db_list_term(compile_env_t *env, const protob_t<const Term> &term);
@@ -60,6 +63,8 @@ counted_t<term_t> make_table_create_term(compile_env_t *env, const protob_t<cons
 counted_t<term_t> make_table_drop_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_table_list_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_sync_term(compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_changes_term(compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_shard_map_term(compile_env_t *env, const protob_t<const Term> &term);
 
 // error.cc
 counted_t<term_t> make_error_term(compile_env_t *env, const protob_t<const Term> &term);
@@ -102,7 +107,6 @@ counted_t<term_t> make_skip_term(compile_env_t *env, const protob_t<const Term>
 counted_t<term_t> make_groupby_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_inner_join_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_outer_join_term(compile_env_t *env, const protob_t<const Term> &term);
-counted_t<term_t> make_eq_join_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_update_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_delete_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_difference_term(compile_env_t *env, const protob_t<const Term> &term);
@@ -116,6 +120,12 @@ counted_t<term_t> make_filter_term(compile_env_t *env, const protob_t<const Term
 counted_t<term_t> make_concatmap_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_count_term(compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_union_term(compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_eq_join_term(compile_env_t *env, const protob_t<const Term> &term);
+// Returns an empty pointer unless the join function of `inner_join` or
+// `outer_join` is of a shape that can be hash joined.
+counted_t<term_t> maybe_make_hash_join_term(compile_env_t *env,
+                                            const protob_t<const Term> &term,
+                                            bool outer);
 counted_t<term_t> make_zip_term(compile_env_t *env, const protob_t<const Term> &term);
 
 // sindex.cc
@@ -33,6 +33,7 @@ public:
                "Variable name not found.");
 
         varname = var;
+        slot = 0;
     }
 
 private:
@@ -45,8 +46,10 @@ private:
     }
 
     sym_t varname;
+    // Where `varname` was in the scope last time (see `var_scope_t::lookup_var`).
+    size_t slot;
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
-        return new_val(env->scope.lookup_var(varname));
+        return new_val(env->scope.lookup_var(varname, &slot));
     }
     virtual const char *name() const { return "var"; }
 };
@@ -1,9 +1,12 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 
+#include <exception>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/op.hpp"
@@ -41,6 +44,62 @@ durability_requirement_t parse_durability_optarg(counted_t<val_t> arg,
                  str.c_str());
 }
 
+// Writes one batch of a multi-row insert in its own coroutine, so that the insert can
+// read and parse its next batch while the last one is being written.  The owner must
+// `wait` for a started write before going away.
+class pipelined_insert_t {
+public:
+    pipelined_insert_t() { }
+    ~pipelined_insert_t() {
+        guarantee(!done.has(), "pipelined_insert_t destroyed with a write running");
+    }
+
+    bool running() const { return done.has(); }
+
+    void start(env_t *env, counted_t<table_t> table,
+               std::vector<counted_t<const datum_t> > &&datums,
+               bool upsert, durability_requirement_t durability_requirement) {
+        guarantee(!done.has());
+        done.init(new cond_t);
+        coro_t::spawn_sometime(std::bind(&pipelined_insert_t::run, this, env, table,
+                                         std::move(datums), upsert,
+                                         durability_requirement));
+    }
+
+    // Waits for the running write (if any) to finish, and returns its stats, or
+    // what it threw.  Doesn't throw, so it may be called on the way out of an error.
+    std::exception_ptr wait(counted_t<const datum_t> *stats_out) {
+        if (!done.has()) {
+            return std::exception_ptr();
+        }
+        done->wait_lazily_unordered();
+        done.reset();
+        *stats_out = std::move(result);
+        std::exception_ptr exc = std::move(error);
+        error = std::exception_ptr();
+        return exc;
+    }
+
+private:
+    void run(env_t *env, counted_t<table_t> table,
+             std::vector<counted_t<const datum_t> > datums,
+             bool upsert, durability_requirement_t durability_requirement) {
+        try {
+            result = table->batched_insert(env, std::move(datums), upsert,
+                                           durability_requirement, false);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        done->pulse();
+    }
+
+    scoped_ptr_t<cond_t> done;
+    counted_t<const datum_t> result;
+    std::exception_ptr error;
+
+    DISABLE_COPYING(pipelined_insert_t);
+};
+
 class insert_term_t : public op_term_t {
 public:
     insert_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -53,7 +112,11 @@ private:
                             size_t *keys_skipped_out,
                             counted_t<const datum_t> *datum_out) {
         if (!(*datum_out)->get(tbl->get_pkey(), NOTHROW).has()) {
-            std::string key = uuid_to_str(generate_uuid());
+            // Time-ordered keys go at the end of each hash shard's btree, so
+            // inserts keep writing the same few leaves.
+            std::string key = uuid_to_str(tbl->has_time_ordered_keys()
+                                          ? generate_time_ordered_uuid()
+                                          : generate_uuid());
             counted_t<const datum_t> keyd(new datum_t(std::string(key)));
             datum_ptr_t d(datum_t::R_OBJECT);
             bool conflict = d.add(tbl->get_pkey(), keyd);
@@ -105,26 +168,60 @@ private:
             rcheck(!return_vals, base_exc_t::GENERIC,
                    "Optarg RETURN_VALS is invalid for multi-row inserts.");
 
+            // Each batch is written while we read the next one.  A profiled query
+            // does one thing at a time, so that its trace makes sense.
+            const bool pipelined = !env->env->trace.has();
+            pipelined_insert_t in_flight;
+            std::exception_ptr read_error;
             batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
-            for (;;) {
-                std::vector<counted_t<const datum_t> > datums
-                    = datum_stream->next_batch(env->env, batchspec);
-                if (datums.empty()) {
-                    break;
-                }
+            try {
+                for (;;) {
+                    std::vector<counted_t<const datum_t> > datums
+                        = datum_stream->next_batch(env->env, batchspec);
+
+                    counted_t<const datum_t> replace_stats;
+                    std::exception_ptr write_error = in_flight.wait(&replace_stats);
+                    if (write_error) {
+                        std::rethrow_exception(write_error);
+                    }
+                    if (replace_stats.has()) {
+                        stats = stats->merge(replace_stats, stats_merge);
+                    }
+
+                    if (datums.empty()) {
+                        break;
+                    }
+
+                    for (auto it = datums.begin(); it != datums.end(); ++it) {
+                        try {
+                            maybe_generate_key(t, &generated_keys, &keys_skipped, &*it);
+                        } catch (const base_exc_t &) {
+                            // We just ignore it, the same error will be handled in
+                            // `replace`.  TODO: that solution sucks.
+                        }
+                    }
 
-                for (auto it = datums.begin(); it != datums.end(); ++it) {
-                    try {
-                        maybe_generate_key(t, &generated_keys, &keys_skipped, &*it);
-                    } catch (const base_exc_t &) {
-                        // We just ignore it, the same error will be handled in
-                        // `replace`.  TODO: that solution sucks.
+                    if (pipelined) {
+                        in_flight.start(env->env, t, std::move(datums), upsert,
+                                        durability_requirement);
+                    } else {
+                        replace_stats = t->batched_insert(
+                            env->env, std::move(datums), upsert,
+                            durability_requirement, false);
+                        stats = stats->merge(replace_stats, stats_merge);
                     }
                 }
+            } catch (...) {
+                read_error = std::current_exception();
+            }
 
-                counted_t<const datum_t> replace_stats = t->batched_insert(
-                    env->env, std::move(datums), upsert, durability_requirement, false);
-                stats = stats->merge(replace_stats, stats_merge);
+            // We can't wait inside the catch block.  If a write was running when we
+            // failed to read the next batch, its error is the one to report, since
+            // it happened first.
+            if (read_error) {
+                counted_t<const datum_t> ignored_stats;
+                std::exception_ptr write_error = in_flight.wait(&ignored_stats);
+                std::rethrow_exception(write_error ? write_error : read_error);
             }
         }
 
@@ -212,6 +309,17 @@ private:
             rcheck(!return_vals, base_exc_t::GENERIC,
                    "Optarg RETURN_VALS is invalid for multi-row modifications.");
 
+            // A deterministic replacement runs on the shards, which read each row
+            // themselves, so the selection only has to send us the primary keys.
+            // (`batched_replace` only looks at `vals` when it applies the function
+            // here.)
+            const bool keys_only = f->is_deterministic();
+            if (keys_only) {
+                ds = ds->map(new_get_field_func(
+                    make_counted<const datum_t>(std::string(tbl->get_pkey())),
+                    backtrace()));
+            }
+
             batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
             for (;;) {
                 std::vector<counted_t<const datum_t> > vals
@@ -220,9 +328,13 @@ private:
                     break;
                 }
                 std::vector<counted_t<const datum_t> > keys;
-                keys.reserve(vals.size());
-                for (auto it = vals.begin(); it != vals.end(); ++it) {
-                    keys.push_back((*it)->get(tbl->get_pkey()));
+                if (keys_only) {
+                    keys = vals;
+                } else {
+                    keys.reserve(vals.size());
+                    for (auto it = vals.begin(); it != vals.end(); ++it) {
+                        keys.push_back((*it)->get(tbl->get_pkey()));
+                    }
                 }
                 counted_t<const datum_t> replace_stats = tbl->batched_replace(
                     env->env, vals, keys,
@@ -0,0 +1,73 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/text.hpp"
+
+#include <algorithm>
+
+#include "config/args.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+
+namespace ql {
+
+static bool is_word_char(char c) {
+    const unsigned char u = static_cast<unsigned char>(c);
+    return u >= 0x80 || (u >= '0' && u <= '9') || (u >= 'a' && u <= 'z')
+        || (u >= 'A' && u <= 'Z');
+}
+
+static void add_words(const std::string &text, std::vector<std::string> *words_out) {
+    size_t i = 0;
+    while (i < text.size()) {
+        while (i < text.size() && !is_word_char(text[i])) {
+            ++i;
+        }
+        std::string word;
+        while (i < text.size() && is_word_char(text[i])) {
+            if (word.size() < TEXT_INDEX_MAX_WORD_LENGTH) {
+                const char c = text[i];
+                word.push_back(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+            }
+            ++i;
+        }
+        if (!word.empty()) {
+            words_out->push_back(word);
+        }
+    }
+}
+
+static void sort_unique(std::vector<std::string> *words) {
+    std::sort(words->begin(), words->end());
+    words->erase(std::unique(words->begin(), words->end()), words->end());
+}
+
+std::vector<std::string> text_words(const std::string &text) {
+    std::vector<std::string> res;
+    add_words(text, &res);
+    sort_unique(&res);
+    return res;
+}
+
+std::vector<std::string> text_words_of_datum(const counted_t<const datum_t> &datum) {
+    std::vector<std::string> res;
+    if (datum->get_type() == datum_t::R_ARRAY) {
+        for (size_t i = 0; i < datum->size(); ++i) {
+            add_words(datum->get(i)->as_str().to_std(), &res);
+        }
+    } else {
+        add_words(datum->as_str().to_std(), &res);
+    }
+    sort_unique(&res);
+    return res;
+}
+
+bool text_has_words(const std::vector<std::string> &words,
+                    const std::vector<std::string> &required) {
+    for (auto it = required.begin(); it != required.end(); ++it) {
+        if (!std::binary_search(words.begin(), words.end(), *it)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace ql
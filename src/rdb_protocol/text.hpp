@@ -0,0 +1,32 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_TEXT_HPP_
+#define RDB_PROTOCOL_TEXT_HPP_
+
+#include <string>
+#include <vector>
+
+#include "containers/counted.hpp"
+
+namespace ql {
+class datum_t;
+
+/* A text index (`index_create(..., {text: true})`) maps each row to a string, or an
+array of strings, and indexes the row once under each distinct word in it.  Since
+secondary index keys are the key followed by the primary key, each word's entries
+-- its posting list -- are one range of the index, sorted by primary key. */
+
+// The distinct words of `text`, sorted: its runs of letters and digits (any non-ASCII
+// byte counts as a letter), lowercased and cut off at TEXT_INDEX_MAX_WORD_LENGTH.
+std::vector<std::string> text_words(const std::string &text);
+
+// The distinct words of a text index value.  Throws if it isn't a string or an array
+// of strings.
+std::vector<std::string> text_words_of_datum(const counted_t<const datum_t> &datum);
+
+// Whether `words` (sorted, as above) has each of `required`.
+bool text_has_words(const std::vector<std::string> &words,
+                    const std::vector<std::string> &required);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_TEXT_HPP_
@@ -27,6 +27,15 @@ public:
         *res_out = exc_t(exc, func.get_bt().get(), 1);
     }
 
+    void operator()(const top_k_wire_func_t &func) const {
+        *res_out = exc_t(exc, func.get_bt().get(), 1);
+    }
+
+    NORETURN void operator()(const sample_wire_func_t &) const {
+        r_sanity_check(false);  // Server should never crash here.
+        unreachable();
+    }
+
 private:
     const datum_exc_t exc;
     rget_read_response_t::result_t *res_out;
@@ -78,11 +87,10 @@ void transform_exception(const datum_exc_t &exc,
 
 namespace query_language {
 
-/* A visitor for applying a transformation to a bit of json. */
+/* A visitor for applying a transformation to a batch of json, in place. */
 class transform_visitor_t : public boost::static_visitor<void> {
 public:
-    transform_visitor_t(counted_t<const ql::datum_t> _arg,
-                        std::vector<counted_t<const ql::datum_t> > *_out,
+    transform_visitor_t(std::vector<counted_t<const ql::datum_t> > *_data,
                         ql::env_t *_ql_env);
 
     void operator()(const ql::map_wire_func_t &func) const;
@@ -90,37 +98,51 @@ public:
     void operator()(const ql::concatmap_wire_func_t &func) const;
 
 private:
-    counted_t<const ql::datum_t> arg;
-    std::vector<counted_t<const ql::datum_t> > *out;
+    std::vector<counted_t<const ql::datum_t> > *data;
     ql::env_t *ql_env;
 };
 
 transform_visitor_t::transform_visitor_t(
-    counted_t<const ql::datum_t> _arg,
-    std::vector<counted_t<const ql::datum_t> > *_out,
+    std::vector<counted_t<const ql::datum_t> > *_data,
     ql::env_t *_ql_env)
-    : arg(_arg), out(_out), ql_env(_ql_env) { }
+    : data(_data), ql_env(_ql_env) { }
 
 // All of this logic is analogous to the eager logic in datum_stream.cc.  This
 // code duplication needs to go away, but I'm not 100% sure how to do it (there
 // are sometimes minor differences between the lazy and eager evaluations) and
 // it definitely isn't making it into 1.4.
 void transform_visitor_t::operator()(const ql::map_wire_func_t &func) const {
-    out->push_back(func.compile_wire_func()->call(ql_env, arg)->as_datum());
+    func.compile_wire_func()->map_batch(ql_env, data);
 }
 
 void transform_visitor_t::operator()(const ql::concatmap_wire_func_t &func) const {
-    counted_t<ql::datum_stream_t> ds
-        = func.compile_wire_func()->call(ql_env, arg)->as_seq(ql_env);
+    counted_t<ql::func_t> f = func.compile_wire_func();
+    std::vector<counted_t<const ql::datum_t> > out;
     ql::batchspec_t batchspec
         = ql::batchspec_t::user(ql::batch_type_t::TERMINAL, ql_env);
-    {
+    if (f->can_overlap_calls() && !ql_env->trace.has()) {
+        std::vector<std::vector<counted_t<const ql::datum_t> > > results(data->size());
+        ql::overlap_calls(ql_env, data->size(), [&](size_t i) {
+            counted_t<ql::datum_stream_t> ds
+                = f->call(ql_env, (*data)[i])->as_seq(ql_env);
+            while (counted_t<const ql::datum_t> d = ds->next(ql_env, batchspec)) {
+                results[i].push_back(d);
+            }
+        });
+        for (auto it = results.begin(); it != results.end(); ++it) {
+            std::move(it->begin(), it->end(), std::back_inserter(out));
+        }
+    } else {
         profile::sampler_t sampler("Evaluating elements in concat map.", ql_env->trace);
-        while (counted_t<const ql::datum_t> d = ds->next(ql_env, batchspec)) {
-            out->push_back(d);
-            sampler.new_sample();
+        for (auto it = data->begin(); it != data->end(); ++it) {
+            counted_t<ql::datum_stream_t> ds = f->call(ql_env, *it)->as_seq(ql_env);
+            while (counted_t<const ql::datum_t> d = ds->next(ql_env, batchspec)) {
+                out.push_back(d);
+                sampler.new_sample();
+            }
         }
     }
+    data->swap(out);
 }
 
 void transform_visitor_t::operator()(const filter_transform_t &transf) const {
@@ -128,16 +150,13 @@ void transform_visitor_t::operator()(const filter_transform_t &transf) const {
     counted_t<ql::func_t> default_filter_val = transf.default_filter_val ?
         transf.default_filter_val->compile_wire_func() :
         counted_t<ql::func_t>();
-    if (f->filter_call(ql_env, arg, default_filter_val)) {
-        out->push_back(arg);
-    }
+    f->filter_batch(ql_env, data, default_filter_val);
 }
 
 void transform_apply(ql::env_t *ql_env,
-                     counted_t<const ql::datum_t> json,
                      const rdb_protocol_details::transform_variant_t *t,
-                     std::vector<counted_t<const ql::datum_t> > *out) {
-    boost::apply_visitor(transform_visitor_t(json, out, ql_env), *t);
+                     std::vector<counted_t<const ql::datum_t> > *data) {
+    boost::apply_visitor(transform_visitor_t(data, ql_env), *t);
 }
 
 /* A visitor for applying a terminal to a bit of json. */
@@ -150,6 +169,8 @@ public:
     void operator()(const ql::count_wire_func_t &) const;
     void operator()(const ql::gmr_wire_func_t &) const;
     void operator()(const ql::reduce_wire_func_t &) const;
+    void operator()(const ql::top_k_wire_func_t &) const;
+    void operator()(const ql::sample_wire_func_t &) const;
 private:
     lazy_json_t json;
     ql::env_t *ql_env;
@@ -172,15 +193,15 @@ void terminal_visitor_t::operator()(const ql::gmr_wire_func_t &func) const {
     counted_t<const ql::datum_t> el = json.get();
     counted_t<const ql::datum_t> el_group
         = func.compile_group()->call(ql_env, el)->as_datum();
-    counted_t<const ql::datum_t> elm = json.get();
     counted_t<const ql::datum_t> el_map
-        = func.compile_map()->call(ql_env, elm)->as_datum();
+        = func.compile_map()->call(ql_env, el)->as_datum();
 
-    if (!obj->has(el_group)) {
-        obj->set(el_group, el_map);
+    // Each shard reduces its rows into one value per group before anything gets
+    // sent back, so unsharding only has a value per group per shard to combine.
+    if (counted_t<const ql::datum_t> *acc = obj->find(el_group)) {
+        *acc = func.compile_reduce()->call(ql_env, *acc, el_map)->as_datum();
     } else {
-        counted_t<const ql::datum_t> lhs = obj->get(el_group);
-        obj->set(el_group, func.compile_reduce()->call(ql_env, lhs, el_map)->as_datum());
+        obj->set(el_group, el_map);
     }
 }
 
@@ -200,6 +221,18 @@ void terminal_visitor_t::operator()(const ql::reduce_wire_func_t &func) const {
     }
 }
 
+void terminal_visitor_t::operator()(const ql::top_k_wire_func_t &func) const {
+    rget_read_response_t::top_k_t *top = boost::get<rget_read_response_t::top_k_t>(out);
+    guarantee(top);
+    func.add(ql_env, json.get(), top);
+}
+
+void terminal_visitor_t::operator()(const ql::sample_wire_func_t &func) const {
+    ql::reservoir_t *reservoir = boost::get<ql::reservoir_t>(out);
+    guarantee(reservoir);
+    func.add(json.get(), reservoir);
+}
+
 void terminal_apply(ql::env_t *ql_env,
                     lazy_json_t json,
                     const rdb_protocol_details::terminal_variant_t *t,
@@ -232,6 +265,14 @@ public:
         *out = rget_read_response_t::empty_t();
     }
 
+    void operator()(const ql::top_k_wire_func_t &) const {
+        *out = rget_read_response_t::top_k_t();
+    }
+
+    void operator()(const ql::sample_wire_func_t &) const {
+        *out = ql::reservoir_t();
+    }
+
 private:
     rget_read_response_t::result_t *out;
 };
@@ -246,6 +287,8 @@ public:
     bool operator()(const ql::gmr_wire_func_t &) const { return true; }
     bool operator()(const ql::count_wire_func_t &) const { return false; }
     bool operator()(const ql::reduce_wire_func_t &) const { return true; }
+    bool operator()(const ql::top_k_wire_func_t &) const { return true; }
+    bool operator()(const ql::sample_wire_func_t &) const { return true; }
 };
 
 bool terminal_uses_value(const rdb_protocol_details::terminal_variant_t &t) {
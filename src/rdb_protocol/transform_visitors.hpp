@@ -24,9 +24,10 @@ void transform_exception(const datum_exc_t &exc,
 
 namespace query_language {
 
-void transform_apply(ql::env_t *ql_env, counted_t<const ql::datum_t> json,
+// Applies a transformation to each of `data`, in place.
+void transform_apply(ql::env_t *ql_env,
                      const rdb_protocol_details::transform_variant_t *t,
-                     std::vector<counted_t<const ql::datum_t> > *out);
+                     std::vector<counted_t<const ql::datum_t> > *data);
 
 // Sets the result type based on a terminal.
 void terminal_initialize(const rdb_protocol_details::terminal_variant_t *t,
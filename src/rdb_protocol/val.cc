@@ -5,7 +5,9 @@
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/meta_utils.hpp"
 #include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/shard_map.hpp"
 #include "rdb_protocol/term.hpp"
+#include "rdb_protocol/text.hpp"
 
 namespace ql {
 
@@ -16,6 +18,7 @@ table_t::table_t(env_t *env,
       db(_db),
       name(_name),
       use_outdated(_use_outdated),
+      time_ordered_keys(false),
       bounds(datum_range_t::universe()),
       sorting(sorting_t::UNORDERED) {
     uuid_u db_id = db->id;
@@ -30,11 +33,13 @@ table_t::table_t(env_t *env,
         ns_searcher(&namespaces_metadata.get()->namespaces);
     // TODO: fold into iteration below
     namespace_predicate_t pred(&table_name, &db_id);
-    uuid_u id = meta_get_uuid(&ns_searcher, pred,
-                              strprintf("Table `%s` does not exist.",
-                                        table_name.c_str()), this);
+    id = meta_get_uuid(&ns_searcher, pred,
+                       strprintf("Table `%s` does not exist.",
+                                 table_name.c_str()), this);
+    check_shard_map_version(env, id, this);
 
     access.init(new rdb_namespace_access_t(id, env));
+    note_table_versions(env, access.get(), id);
 
     metadata_search_status_t status;
     const_metadata_searcher_t<namespace_semilattice_metadata_t<rdb_protocol_t> >::iterator
@@ -45,6 +50,9 @@ table_t::table_t(env_t *env,
     guarantee(!ns_metadata_it->second.is_deleted());
     r_sanity_check(!ns_metadata_it->second.get_ref().primary_key.in_conflict());
     pkey =  ns_metadata_it->second.get_ref().primary_key.get();
+    const vclock_t<bool> &time_ordered
+        = ns_metadata_it->second.get_ref().time_ordered_keys;
+    time_ordered_keys = !time_ordered.in_conflict() && time_ordered.get();
 }
 
 counted_t<const datum_t> table_t::make_error_datum(const base_exc_t &exception) {
@@ -248,6 +256,10 @@ counted_t<const datum_t> table_t::sindex_status(env_t *env, std::set<std::string
                 status["blocks_total"] =
                     make_counted<const datum_t>(
                         safe_to_double(it->second.blocks_total));
+                if (it->second.secs_remaining > 0) {
+                    status["seconds_remaining"] =
+                        make_counted<const datum_t>(it->second.secs_remaining);
+                }
             }
             status["ready"] = make_counted<const datum_t>(datum_t::R_BOOL, it->second.ready);
             std::string index_name = it->first;
@@ -262,6 +274,34 @@ counted_t<const datum_t> table_t::sindex_status(env_t *env, std::set<std::string
     }
 }
 
+counted_t<datum_stream_t> table_t::changes(env_t *env, const rcheckable_t *parent,
+                                           const protob_t<const Backtrace> &bt) {
+    rcheck_target(parent, base_exc_t::GENERIC,
+                  bounds.is_universe() && sorting == sorting_t::UNORDERED,
+                  "changes can only be applied directly to a table.");
+    rcheck_target(parent, base_exc_t::GENERIC, env->mailbox_manager != NULL,
+                  "Change feeds aren't available here.");
+    scoped_ptr_t<changefeed::subscription_t> sub(
+        new changefeed::subscription_t(env->mailbox_manager));
+    rdb_protocol_t::changefeed_subscribe_t subscribe(sub->get_id(),
+                                                     sub->get_address());
+    rdb_protocol_t::read_t read(subscribe, env->profile());
+    try {
+        rdb_protocol_t::read_response_t res;
+        access->get_namespace_if().read(
+            read, &res, order_token_t::ignore, env->interruptor);
+        auto s_res =
+            boost::get<rdb_protocol_t::changefeed_subscribe_response_t>(&res.response);
+        r_sanity_check(s_res);
+        rcheck_target(parent, base_exc_t::GENERIC, !s_res->servers.empty(),
+                      "Change feeds aren't available here.");
+        sub->add_servers(s_res->servers);
+    } catch (const cannot_perform_query_exc_t &ex) {
+        rfail(ql::base_exc_t::GENERIC, "cannot perform read: %s", ex.what());
+    }
+    return make_counted<changefeed_datum_stream_t>(std::move(sub), bt);
+}
+
 MUST_USE bool table_t::sync(env_t *env, const rcheckable_t *parent) {
     rcheck_target(parent, base_exc_t::GENERIC,
                   bounds.is_universe() && sorting == sorting_t::UNORDERED,
@@ -287,6 +327,12 @@ MUST_USE bool table_t::sync_depending_on_durability(env_t *env,
 
 const std::string &table_t::get_pkey() { return pkey; }
 
+bool table_t::has_time_ordered_keys() { return time_ordered_keys; }
+
+counted_t<const datum_t> table_t::shard_map(env_t *env) {
+    return table_shard_map(env, id, this);
+}
+
 counted_t<const datum_t> table_t::get_row(env_t *env, counted_t<const datum_t> pval) {
     std::string pks = pval->print_primary();
     rdb_protocol_t::read_t read(
@@ -304,6 +350,41 @@ counted_t<const datum_t> table_t::get_row(env_t *env, counted_t<const datum_t> p
     return p_res->data;
 }
 
+std::vector<counted_t<const datum_t> > table_t::get_rows(
+        env_t *env, const std::vector<counted_t<const datum_t> > &pvals) {
+    if (pvals.size() == 1) {
+        return std::vector<counted_t<const datum_t> >(1, get_row(env, pvals[0]));
+    }
+    std::vector<store_key_t> keys;
+    keys.reserve(pvals.size());
+    for (auto it = pvals.begin(); it != pvals.end(); ++it) {
+        keys.push_back(store_key_t((*it)->print_primary()));
+    }
+    rdb_protocol_t::read_t read(
+            rdb_protocol_t::batched_point_read_t(std::vector<store_key_t>(keys)),
+            env->profile());
+    rdb_protocol_t::read_response_t res;
+    if (use_outdated) {
+        access->get_namespace_if().read_outdated(read, &res, env->interruptor);
+    } else {
+        access->get_namespace_if().read(
+            read, &res, order_token_t::ignore, env->interruptor);
+    }
+    rdb_protocol_t::batched_point_read_response_t *p_res =
+        boost::get<rdb_protocol_t::batched_point_read_response_t>(&res.response);
+    r_sanity_check(p_res);
+
+    std::vector<counted_t<const datum_t> > rows;
+    rows.reserve(keys.size());
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        auto row = p_res->rows.find(*it);
+        rows.push_back(row != p_res->rows.end()
+                       ? row->second
+                       : make_counted<const datum_t>(datum_t::R_NULL));
+    }
+    return rows;
+}
+
 counted_t<datum_stream_t> table_t::get_all(
         env_t *env,
         counted_t<const datum_t> value,
@@ -329,6 +410,77 @@ counted_t<datum_stream_t> table_t::get_all(
     }
 }
 
+counted_t<datum_stream_t> table_t::get_in_region(
+        env_t *env,
+        const geo_region_t &region,
+        const std::string &geo_sindex_id,
+        const protob_t<const Backtrace> &bt) {
+    rcheck_src(bt.get(), base_exc_t::GENERIC, !sindex_id,
+            "Cannot chain geo queries and other indexed operations.");
+    rcheck_src(bt.get(), base_exc_t::GENERIC, geo_sindex_id != get_pkey(),
+            strprintf("The primary index `%s` is not a geo index.",
+                      geo_sindex_id.c_str()));
+    r_sanity_check(sorting == sorting_t::UNORDERED);
+    r_sanity_check(bounds.is_universe());
+
+    // One read of the index per covering cell, each of the geohashes that start
+    // with the cell's ('{' comes right after 'z', the last geohash character).  The
+    // cells don't overlap, so a row only comes back more than once if more than one
+    // of its points is in the region, as with other multi indexes.
+    std::vector<std::string> cells = region.covering_cells();
+    std::vector<counted_t<datum_stream_t> > streams;
+    for (auto it = cells.begin(); it != cells.end(); ++it) {
+        datum_range_t range = it->empty()
+            ? datum_range_t::universe()
+            : datum_range_t(make_counted<const datum_t>(std::string(*it)),
+                            key_range_t::closed,
+                            make_counted<const datum_t>(*it + "{"),
+                            key_range_t::open);
+        streams.push_back(make_counted<lazy_datum_stream_t>(
+            access.get(),
+            use_outdated,
+            sindex_readgen_t::make(env, geo_sindex_id, range, sorting_t::UNORDERED,
+                                   region),
+            bt));
+    }
+    return make_counted<union_datum_stream_t>(streams, bt);
+}
+
+counted_t<datum_stream_t> table_t::get_by_words(
+        env_t *env,
+        const std::string &text,
+        const std::string &text_sindex_id,
+        const protob_t<const Backtrace> &bt) {
+    rcheck_src(bt.get(), base_exc_t::GENERIC, !sindex_id,
+            "Cannot chain text queries and other indexed operations.");
+    rcheck_src(bt.get(), base_exc_t::GENERIC, text_sindex_id != get_pkey(),
+            strprintf("The primary index `%s` is not a text index.",
+                      text_sindex_id.c_str()));
+    r_sanity_check(sorting == sorting_t::UNORDERED);
+    r_sanity_check(bounds.is_universe());
+
+    std::vector<std::string> words = text_words(text);
+    rcheck_src(bt.get(), base_exc_t::GENERIC, !words.empty(),
+            strprintf("`%s` has no words to search for.", text.c_str()));
+
+    // We intersect the posting lists by reading just one of them, and having the
+    // shards drop the rows that don't also have the other words.  The longest word
+    // is the likeliest to have the shortest list.
+    auto longest = words.begin();
+    for (auto it = words.begin(); it != words.end(); ++it) {
+        if (it->size() > longest->size()) {
+            longest = it;
+        }
+    }
+    counted_t<const datum_t> key = make_counted<const datum_t>(std::string(*longest));
+    return make_counted<lazy_datum_stream_t>(
+        access.get(),
+        use_outdated,
+        sindex_readgen_t::make(env, text_sindex_id, datum_range_t(key),
+                               sorting_t::UNORDERED, boost::none, words),
+        bt);
+}
+
 void table_t::add_sorting(const std::string &new_sindex_id, sorting_t _sorting,
                           const rcheckable_t *parent) {
     r_sanity_check(_sorting != sorting_t::UNORDERED);
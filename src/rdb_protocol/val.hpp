@@ -37,12 +37,29 @@ public:
     counted_t<datum_stream_t> as_datum_stream(env_t *env,
                                               const protob_t<const Backtrace> &bt);
     const std::string &get_pkey();
+    // Whether the primary keys that inserts generate should be time-ordered.
+    bool has_time_ordered_keys();
     counted_t<const datum_t> get_row(env_t *env, counted_t<const datum_t> pval);
+    // The rows for each of `pvals`, in order, with one read per shard.
+    std::vector<counted_t<const datum_t> > get_rows(
+            env_t *env, const std::vector<counted_t<const datum_t> > &pvals);
     counted_t<datum_stream_t> get_all(
             env_t *env,
             counted_t<const datum_t> value,
             const std::string &sindex_id,
             const protob_t<const Backtrace> &bt);
+    // The rows with a point in `region`, by the geo index `geo_sindex_id`.
+    counted_t<datum_stream_t> get_in_region(
+            env_t *env,
+            const geo_region_t &region,
+            const std::string &geo_sindex_id,
+            const protob_t<const Backtrace> &bt);
+    // The rows with all of the words of `text`, by the text index `text_sindex_id`.
+    counted_t<datum_stream_t> get_by_words(
+            env_t *env,
+            const std::string &text,
+            const std::string &text_sindex_id,
+            const protob_t<const Backtrace> &bt);
     void add_sorting(
         const std::string &sindex_id, sorting_t sorting,
         const rcheckable_t *parent);
@@ -76,6 +93,10 @@ public:
     counted_t<const datum_t> sindex_status(env_t *env,
         std::set<std::string> sindex);
     MUST_USE bool sync(env_t *env, const rcheckable_t *parent);
+    counted_t<datum_stream_t> changes(env_t *env, const rcheckable_t *parent,
+                                      const protob_t<const Backtrace> &bt);
+    // Which machines have the table's shards (see `table_shard_map`).
+    counted_t<const datum_t> shard_map(env_t *env);
 
     counted_t<const db_t> db;
     const std::string name;
@@ -98,7 +119,9 @@ private:
         env_t *env, durability_requirement_t durability_requirement);
 
     bool use_outdated;
+    uuid_u id;
     std::string pkey;
+    bool time_ordered_keys;
     scoped_ptr_t<rdb_namespace_access_t> access;
 
     boost::optional<std::string> sindex_id;
@@ -1,6 +1,8 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/var_types.hpp"
 
+#include <algorithm>
+
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/env.hpp"
@@ -48,6 +50,14 @@ var_captures_t &var_captures_t::operator=(var_captures_t &&movee) {
 }
 
 
+namespace {
+
+bool var_less(const std::pair<sym_t, counted_t<const datum_t> > &var, sym_t varname) {
+    return var.first < varname;
+}
+
+}  // namespace
+
 var_scope_t::var_scope_t() : implicit_depth(0) { }
 
 var_scope_t var_scope_t::with_func_arg_list(const std::vector<sym_t> &arg_names,
@@ -63,18 +73,26 @@ var_scope_t var_scope_t::with_func_arg_list(const std::vector<sym_t> &arg_names,
         ++ret.implicit_depth;
     }
 
+    ret.vars.reserve(vars.size() + arg_names.size());
     for (size_t i = 0; i < arg_names.size(); ++i) {
-        ret.vars.insert(std::make_pair(arg_names[i], arg_values[i]));
+        auto it = std::lower_bound(ret.vars.begin(), ret.vars.end(), arg_names[i],
+                                   &var_less);
+        if (it == ret.vars.end() || arg_names[i] < it->first) {
+            ret.vars.insert(it, std::make_pair(arg_names[i], arg_values[i]));
+        }
     }
     return ret;
 }
 
 var_scope_t var_scope_t::filtered_by_captures(const var_captures_t &captures) const {
     var_scope_t ret;
+    ret.vars.reserve(captures.vars_captured.size());
+    // Both are sorted, so `ret.vars` comes out sorted.
+    auto vars_it = vars.begin();
     for (auto it = captures.vars_captured.begin(); it != captures.vars_captured.end(); ++it) {
-        auto vars_it = vars.find(*it);
-        r_sanity_check(vars_it != vars.end());
-        ret.vars.insert(*vars_it);
+        vars_it = std::lower_bound(vars_it, vars.end(), *it, &var_less);
+        r_sanity_check(vars_it != vars.end() && !(*it < vars_it->first));
+        ret.vars.push_back(*vars_it);
     }
     ret.implicit_depth = implicit_depth;
     if (captures.implicit_is_captured) {
@@ -85,10 +103,19 @@ var_scope_t var_scope_t::filtered_by_captures(const var_captures_t &captures) co
 }
 
 counted_t<const datum_t> var_scope_t::lookup_var(sym_t varname) const {
-    auto it = vars.find(varname);
+    size_t slot = vars.size();
+    return lookup_var(varname, &slot);
+}
+
+counted_t<const datum_t> var_scope_t::lookup_var(sym_t varname, size_t *slot) const {
+    if (*slot < vars.size() && vars[*slot].first.value == varname.value) {
+        return vars[*slot].second;
+    }
+    auto it = std::lower_bound(vars.begin(), vars.end(), varname, &var_less);
     // This is a sanity check because we should never have constructed an expression
     // with an invalid variable name.
-    r_sanity_check(it != vars.end());
+    r_sanity_check(it != vars.end() && !(varname < it->first));
+    *slot = it - vars.begin();
     return it->second;
 }
 
@@ -143,9 +170,16 @@ void var_scope_t::rdb_serialize(write_message_t &msg) const {  // NOLINT(runtime
 }
 
 archive_result_t var_scope_t::rdb_deserialize(read_stream_t *s) {
-    std::map<sym_t, counted_t<const datum_t> > local_vars;
+    std::vector<std::pair<sym_t, counted_t<const datum_t> > > local_vars;
     archive_result_t res = deserialize(s, &local_vars);
     if (res) { return res; }
+    // They were serialized from a sorted vector (or a map), but it costs little to
+    // make sure.
+    std::sort(local_vars.begin(), local_vars.end(),
+              [](const std::pair<sym_t, counted_t<const datum_t> > &x,
+                 const std::pair<sym_t, counted_t<const datum_t> > &y) {
+                  return x.first < y.first;
+              });
 
     uint32_t local_implicit_depth;
     res = deserialize(s, &local_implicit_depth);
@@ -28,6 +28,9 @@ public:
 
     uint32_t get_implicit_depth() const { return implicit_depth; }
 
+    // True in the body of a function, which may get evaluated many times.
+    bool in_function() const { return !visibles.empty() || implicit_depth > 0; }
+
 private:
     friend class var_scope_t;
     friend void debug_print(printf_buffer_t *buf, const var_visibility_t &var_visibility);
@@ -61,6 +64,10 @@ public:
     var_scope_t filtered_by_captures(const var_captures_t &captures) const;
 
     counted_t<const datum_t> lookup_var(sym_t varname) const;
+    // Like `lookup_var`, but first tries the variable's position from the last
+    // lookup, and stores its position in `*slot`.  A variable term evaluated once
+    // per row finds its variable in the same place every time.
+    counted_t<const datum_t> lookup_var(sym_t varname, size_t *slot) const;
     counted_t<const datum_t> lookup_implicit() const;
 
     // Dumps a complete "human readable" description of the var_scope_t.  Is used by
@@ -73,7 +80,9 @@ public:
     archive_result_t rdb_deserialize(read_stream_t *s);
 
 private:
-    std::map<sym_t, counted_t<const datum_t> > vars;
+    // Sorted by name.  It's copied for every function call, which is cheaper for
+    // a vector than for a map.  (It's serialized the same way as a map, too.)
+    std::vector<std::pair<sym_t, counted_t<const datum_t> > > vars;
 
     uint32_t implicit_depth;
 
@@ -153,5 +153,133 @@ counted_t<func_t> gmr_wire_func_t::compile_reduce() const {
     return reduce.compile_wire_func();
 }
 
+order_wire_func_t::order_wire_func_t(
+    const std::vector<std::pair<order_direction_t, counted_t<func_t> > > &_comparisons) {
+    for (auto it = _comparisons.begin(); it != _comparisons.end(); ++it) {
+        comparisons.push_back(std::make_pair(it->first, map_wire_func_t(it->second)));
+    }
+}
+
+namespace {
+
+// Returns an empty pointer if `f` fails on `el` with a NON_EXISTENCE error.
+counted_t<const datum_t> call_for_order(env_t *env, const counted_t<func_t> &f,
+                                        const counted_t<const datum_t> &el) {
+    try {
+        return f->call(env, el)->as_datum();
+    } catch (const base_exc_t &e) {
+        if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+            throw;
+        }
+        return counted_t<const datum_t>();
+    }
+}
+
+}  // namespace
+
+bool order_wire_func_t::lt(env_t *env,
+                           const counted_t<const datum_t> &l,
+                           const counted_t<const datum_t> &r) const {
+    for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+        counted_t<func_t> f = it->second.compile_wire_func();
+        counted_t<const datum_t> lval = call_for_order(env, f, l);
+        counted_t<const datum_t> rval = call_for_order(env, f, r);
+
+        const bool desc = it->first == order_direction_t::DESC;
+        if (!lval.has() && !rval.has()) {
+            continue;
+        }
+        if (!lval.has()) {
+            return true != desc;
+        }
+        if (!rval.has()) {
+            return false != desc;
+        }
+        // TODO: use datum_t::cmp instead to be faster
+        if (*lval == *rval) {
+            continue;
+        }
+        return (*lval < *rval) != desc;
+    }
+
+    return false;
+}
+
+sort_key_t order_wire_func_t::key(env_t *env,
+                                  const counted_t<const datum_t> &el) const {
+    sort_key_t ret;
+    for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+        ret.append(call_for_order(env, it->second.compile_wire_func(), el),
+                   it->first == order_direction_t::DESC);
+    }
+    return ret;
+}
+
+protob_t<const Backtrace> order_wire_func_t::get_bt() const {
+    r_sanity_check(!comparisons.empty());
+    return comparisons[0].second.get_bt();
+}
+
+void top_k_wire_func_t::add(env_t *env, counted_t<const datum_t> el,
+                            std::vector<counted_t<const datum_t> > *top) const {
+    // Most elements don't make it in once `top` is full, and they only cost one
+    // comparison.
+    if (k == 0 || (top->size() == k && !order.lt(env, el, top->back()))) {
+        return;
+    }
+    size_t lo = 0;
+    size_t hi = top->size();
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (order.lt(env, el, (*top)[mid])) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    top->insert(top->begin() + lo, std::move(el));
+    if (top->size() > k) {
+        top->pop_back();
+    }
+}
+
+void sample_wire_func_t::add(counted_t<const datum_t> el,
+                             reservoir_t *reservoir) const {
+    ++reservoir->seen;
+    if (reservoir->sample.size() < n) {
+        reservoir->sample.push_back(std::move(el));
+    } else {
+        const size_t index = randsize(reservoir->seen);
+        if (index < n) {
+            reservoir->sample[index] = std::move(el);
+        }
+    }
+}
+
+void sample_wire_func_t::merge(reservoir_t &&other, reservoir_t *reservoir) const {
+    reservoir_t merged;
+    merged.seen = reservoir->seen + other.seen;
+    // We draw from the union one element at a time, from each side in proportion
+    // to how many of its elements haven't been drawn.  A side can't run out of
+    // sampled elements first, because it has `n` of them or all of its elements.
+    uint64_t left = reservoir->seen;
+    uint64_t right = other.seen;
+    while (merged.sample.size() < n && left + right > 0) {
+        std::vector<counted_t<const datum_t> > *from;
+        if (randsize(left + right) < left) {
+            from = &reservoir->sample;
+            --left;
+        } else {
+            from = &other.sample;
+            --right;
+        }
+        guarantee(!from->empty());
+        const size_t index = randsize(from->size());
+        merged.sample.push_back(std::move((*from)[index]));
+        (*from)[index] = std::move(from->back());
+        from->pop_back();
+    }
+    *reservoir = std::move(merged);
+}
 
 }  // namespace ql
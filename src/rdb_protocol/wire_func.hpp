@@ -7,9 +7,11 @@
 #include <string>
 #include <vector>
 
+#include "containers/archive/stl_types.hpp"
 #include "containers/uuid.hpp"
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/pb_utils.hpp"
+#include "rdb_protocol/sort_key.hpp"
 #include "rdb_protocol/sym.hpp"
 #include "rdb_protocol/var_types.hpp"
 #include "rpc/serialize_macros.hpp"
@@ -19,6 +21,7 @@ class Datum;
 class Term;
 
 namespace ql {
+class datum_t;
 class func_t;
 class env_t;
 
@@ -101,6 +104,89 @@ private:
     reduce_wire_func_t reduce;
 };
 
+enum class order_direction_t { ASC, DESC };
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
+    order_direction_t, int8_t, order_direction_t::ASC, order_direction_t::DESC);
+
+// The comparisons an order_by without an index sorts by, in order of precedence.
+class order_wire_func_t {
+public:
+    order_wire_func_t() { }
+    explicit order_wire_func_t(
+        const std::vector<std::pair<order_direction_t, counted_t<func_t> > > &comparisons);
+
+    // Whether `l` sorts before `r`.  Elements that a comparison's function fails on
+    // with a NON_EXISTENCE error sort before the ones it doesn't, ascending.
+    bool lt(env_t *env,
+            const counted_t<const datum_t> &l,
+            const counted_t<const datum_t> &r) const;
+    // The values `el` gets sorted by, which order like `lt` does.  Sorting by these
+    // calls the functions once per element instead of twice per comparison.
+    sort_key_t key(env_t *env, const counted_t<const datum_t> &el) const;
+
+    protob_t<const Backtrace> get_bt() const;
+
+    RDB_MAKE_ME_SERIALIZABLE_1(comparisons);
+
+private:
+    std::vector<std::pair<order_direction_t, map_wire_func_t> > comparisons;
+};
+
+// The terminal for an order_by followed by a limit, which has each shard send back
+// just its `k` smallest elements, sorted.
+class top_k_wire_func_t {
+public:
+    top_k_wire_func_t() : k(0) { }
+    top_k_wire_func_t(const order_wire_func_t &_order, uint64_t _k)
+        : order(_order), k(_k) { }
+
+    const order_wire_func_t &get_order() const { return order; }
+    uint64_t get_k() const { return k; }
+
+    // Adds `el` to `top`, the sorted `k` smallest elements seen so far, if it's
+    // among them.
+    void add(env_t *env, counted_t<const datum_t> el,
+             std::vector<counted_t<const datum_t> > *top) const;
+
+    protob_t<const Backtrace> get_bt() const { return order.get_bt(); }
+
+    RDB_MAKE_ME_SERIALIZABLE_2(order, k);
+
+private:
+    order_wire_func_t order;
+    uint64_t k;
+};
+
+// A uniform random sample, without replacement, of the `seen` elements seen so far.
+struct reservoir_t {
+    reservoir_t() : seen(0) { }
+    uint64_t seen;
+    std::vector<counted_t<const datum_t> > sample;
+
+    RDB_MAKE_ME_SERIALIZABLE_2(seen, sample);
+};
+
+// The terminal for `sample`, which has each shard send back a sample of `n` of its
+// elements, and how many it had, so that the samples can be combined with each
+// shard weighted by its number of elements.
+class sample_wire_func_t {
+public:
+    sample_wire_func_t() : n(0) { }
+    explicit sample_wire_func_t(uint64_t _n) : n(_n) { }
+
+    uint64_t get_n() const { return n; }
+
+    void add(counted_t<const datum_t> el, reservoir_t *reservoir) const;
+    // Makes `*reservoir` a sample of the elements it and `other` are samples of,
+    // which mustn't overlap.
+    void merge(reservoir_t &&other, reservoir_t *reservoir) const;
+
+    RDB_MAKE_ME_SERIALIZABLE_1(n);
+
+private:
+    uint64_t n;
+};
+
 }  // namespace ql
 
 #endif  // RDB_PROTOCOL_WIRE_FUNC_HPP_
@@ -2,6 +2,7 @@
 #include "rpc/connectivity/cluster.hpp"
 
 #include <netinet/in.h>
+#include <zlib.h>
 
 #include <functional>
 
@@ -9,11 +10,13 @@
 #include <boost/optional.hpp>
 
 #include "arch/io/network.hpp"
+#include "arch/io/tls.hpp"
 #include "arch/timing.hpp"
 
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/pmap.hpp"
 #include "concurrency/semaphore.hpp"
+#include "concurrency/wait_any.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "containers/object_buffer.hpp"
 #include "containers/uuid.hpp"
@@ -23,6 +26,22 @@
 // Number of messages after which the message handling loop yields
 #define MESSAGE_HANDLER_MAX_BATCH_SIZE           8
 
+// How long a main connection and its class connections wait for each other
+#define CLASS_STREAM_TIMEOUT_MS                  10000
+
+// Messages shorter than this go uncompressed even on compressed connections
+#define CLUSTER_COMPRESSION_MIN_SIZE             1024
+// Messages smaller than this are buffered and sent together with the others that
+// are sent to the same connection before its thread gets back to its event loop
+#define CLUSTER_COALESCE_MAX_SIZE                4096
+
+static uint8_t cluster_compressed_classes = 0;
+
+void set_cluster_compressed_classes(uint8_t class_mask) {
+    guarantee((class_mask & (1 << static_cast<int>(message_class_t::control))) == 0);
+    cluster_compressed_classes = class_mask;
+}
+
 const std::string connectivity_cluster_t::cluster_proto_header("RethinkDB cluster\n");
 const std::string connectivity_cluster_t::cluster_version(RETHINKDB_CODE_VERSION);
 
@@ -112,7 +131,7 @@ connectivity_cluster_t::run_t::run_t(connectivity_cluster_t *p,
     `connection_map` on each thread and notifying any listeners that we're now
     connected to ourself. The destructor will remove us from the
     `connection_map` and again notify any listeners. */
-    connection_to_ourself(this, parent->me, NULL, routing_table[parent->me]),
+    connection_to_ourself(this, parent->me, NULL, 0, routing_table[parent->me]),
 
     listener(new tcp_listener_t(cluster_listener_socket.get(),
                                 std::bind(&connectivity_cluster_t::run_t::on_new_connection,
@@ -146,15 +165,23 @@ void connectivity_cluster_t::run_t::join(const peer_address_t &address) THROWS_N
 
 connectivity_cluster_t::run_t::connection_entry_t::connection_entry_t(run_t *p,
                                                                       peer_id_t id,
-                                                                      tcp_conn_stream_t *c,
+                                                                      tcp_conn_stream_t *const *c,
+                                                                      uint8_t compressed,
                                                                       const peer_address_t &a) THROWS_NOTHING :
-    conn(c), address(a), session_id(generate_uuid()),
+    conn(c == NULL ? NULL : c[static_cast<int>(message_class_t::control)]),
+    compressed_classes(compressed),
+    address(a), session_id(generate_uuid()),
     pm_collection(),
     pm_bytes_sent(secs_to_ticks(1), true),
     pm_collection_membership(&p->parent->connectivity_collection, &pm_collection, uuid_to_str(id.get_uuid())),
     pm_bytes_sent_membership(&pm_collection, &pm_bytes_sent, "bytes_sent"),
-    parent(p), peer(id),
-    entries(new one_per_thread_t<entry_installation_t>(this)) {
+    parent(p), peer(id) {
+    for (int i = 0; i < num_message_classes; ++i) {
+        class_conns[i] = c == NULL ? NULL : c[i];
+        flush_pending[i] = false;
+    }
+    /* This makes us visible to senders, so `class_conns` must be ready first */
+    entries.init(new one_per_thread_t<entry_installation_t>(this));
     if (peer != parent->parent->me && parent->heartbeat_manager != NULL) {
         parent->heartbeat_manager->begin_peer_heartbeat(peer);
     }
@@ -169,8 +196,27 @@ connectivity_cluster_t::run_t::connection_entry_t::~connection_entry_t() THROWS_
     entries.reset();
 
     /* `~entry_installation_t` destroys the `auto_drainer_t`'s in entries,
-    so nothing can be holding the `send_mutex`. */
-    guarantee(!send_mutex.is_locked());
+    so nothing can be holding the `send_mutexes`. */
+    for (int i = 0; i < num_message_classes; ++i) {
+        guarantee(!send_mutexes[i].is_locked());
+    }
+}
+
+int connectivity_cluster_t::run_t::connection_entry_t::get_conn_index(
+        message_class_t message_class) {
+    int i = static_cast<int>(message_class);
+    if (class_conns[i] == NULL) {
+        i = static_cast<int>(message_class_t::control);
+    }
+    return i;
+}
+
+tcp_conn_stream_t *connectivity_cluster_t::run_t::connection_entry_t::get_conn(
+        message_class_t message_class, mutex_t **send_mutex_out, bool *compressed_out) {
+    int i = get_conn_index(message_class);
+    *send_mutex_out = &send_mutexes[i];
+    *compressed_out = (compressed_classes & (1 << i)) != 0;
+    return class_conns[i];
 }
 
 static void ping_connection_watcher(peer_id_t peer, peers_list_callback_t *connect_disconnect_cb) THROWS_NOTHING {
@@ -220,7 +266,13 @@ void connectivity_cluster_t::run_t::on_new_connection(const scoped_ptr_t<tcp_con
     nconn->make_overcomplicated(&conn);
     keepalive_tcp_conn_stream_t conn_stream(conn);
 
-    handle(&conn_stream, boost::none, boost::none, lock, NULL);
+    if (tls_ctx_t *tls_ctx = get_cluster_tls_ctx()) {
+        if (!conn->start_tls(tls_ctx, tls_role_t::server, lock.get_drain_signal())) {
+            return;
+        }
+    }
+
+    handle(&conn_stream, boost::none, boost::none, lock, NULL, NULL);
 }
 
 void connectivity_cluster_t::run_t::connect_to_peer(const peer_address_t *address,
@@ -254,8 +306,20 @@ void connectivity_cluster_t::run_t::connect_to_peer(const peer_address_t *addres
         try {
             keepalive_tcp_conn_stream_t conn(selected_addr->ip(), selected_addr->port().value(),
                                              drainer_lock.get_drain_signal(), cluster_client_port);
-            if (!*successful_join) {
-                handle(&conn, expected_id, boost::optional<peer_address_t>(*address), drainer_lock, successful_join);
+            tls_ctx_t *tls_ctx = get_cluster_tls_ctx();
+            if (tls_ctx != NULL
+                && !conn.get_underlying_conn()->start_tls(tls_ctx, tls_role_t::client,
+                                                          drainer_lock.get_drain_signal())) {
+                /* The handshake failed or we're shutting down */
+            } else if (!*successful_join) {
+                /* If all of our connections come from `cluster_client_port`, TCP
+                can't tell a second one to the same address apart from the first,
+                so everything goes on the main connection. */
+                class_streams_t class_streams;
+                if (cluster_client_port == 0) {
+                    open_class_streams(*selected_addr, drainer_lock, &class_streams);
+                }
+                handle(&conn, expected_id, boost::optional<peer_address_t>(*address), drainer_lock, successful_join, &class_streams);
             }
         } catch (const tcp_conn_t::connect_failed_exc_t &) {
             /* Ignore */
@@ -307,20 +371,35 @@ void connectivity_cluster_t::run_t::join_blocking(
     }
 }
 
+static void close_cluster_conn(tcp_conn_stream_t *conn) {
+    if (conn->is_read_open()) {
+        conn->shutdown_read();
+    }
+    if (conn->is_write_open()) {
+        conn->shutdown_write();
+    }
+}
+
 class cluster_conn_closing_subscription_t : public signal_t::subscription_t {
 public:
-    explicit cluster_conn_closing_subscription_t(tcp_conn_stream_t *conn) : conn_(conn) { }
+    explicit cluster_conn_closing_subscription_t(tcp_conn_stream_t *conn) {
+        add(conn);
+    }
 
-    virtual void run() {
-        if (conn_->is_read_open()) {
-            conn_->shutdown_read();
+    // Also closes `conn`, if it isn't NULL
+    void add(tcp_conn_stream_t *conn) {
+        if (conn != NULL) {
+            conns_.push_back(conn);
         }
-        if (conn_->is_write_open()) {
-            conn_->shutdown_write();
+    }
+
+    virtual void run() {
+        for (auto it = conns_.begin(); it != conns_.end(); ++it) {
+            close_cluster_conn(*it);
         }
     }
 private:
-    tcp_conn_stream_t *conn_;
+    std::vector<tcp_conn_stream_t *> conns_;
     DISABLE_COPYING(cluster_conn_closing_subscription_t);
 };
 
@@ -486,72 +565,26 @@ bool is_similar_peer_address(const peer_address_t &left,
     return left_loopback_only || right_loopback_only;
 }
 
-// Critical section: we must check for conflicts and register ourself
-//  without the interference of any other connections. This ensures that
-//  any conflicts are resolved consistently. It also ensures that if we get
-//  two connections from different nodes, one will find out about the other.
-bool connectivity_cluster_t::run_t::get_routing_table_to_send_and_add_peer(
-        const peer_id_t &other_peer_id,
-        const peer_address_t &other_peer_addr,
-        object_buffer_t<map_insertion_sentry_t<peer_id_t, peer_address_t> > *routing_table_entry_sentry,
-        std::map<peer_id_t, std::set<host_and_port_t> > *result) {
-    mutex_t::acq_t acq(&new_connection_mutex);
-
-    // Here's how this situation can happen:
-    // 1. We are connected to another node.
-    // 2. The connection is interrupted.
-    // 3. The other node gives up on the original TCP connection, but we have not given up on it yet.
-    // 4. The other node tries to reconnect, and the new TCP connection gets through and this node ends up here.
-    // 5. We now have a duplicate connection to the other node.
-    if (routing_table.find(other_peer_id) != routing_table.end()) {
-        // In this case, just exit this function, which will close the connection
-        // This will happen until the old connection dies
-        // TODO: ensure that the old connection shuts down?
-        return false;
-    }
-
-    // Make a serializable copy of `routing_table` before exiting the critical section
-    result->clear();
-    for (auto it = routing_table.begin(); it != routing_table.end(); ++it) {
-        result->insert(std::make_pair(it->first, it->second.hosts()));
-    }
-
-    // Register ourselves while in the critical section, so that whoever comes next will see us
-    routing_table_entry_sentry->create(&routing_table, other_peer_id, other_peer_addr);
-
-    return true;
-}
-
-// We log error conditions as follows:
-// - silent: network error; conflict between parallel connections
-// - warning: invalid header
-// - error: id or address don't match expected id or address; deserialization range error; unknown error
-// In all cases we close the connection and quit.
-void connectivity_cluster_t::run_t::handle(
-        /* `conn` should remain valid until `handle()` returns.
-         * `handle()` does not take ownership of `conn`. */
-        keepalive_tcp_conn_stream_t *conn,
-        boost::optional<peer_id_t> expected_id,
-        boost::optional<peer_address_t> expected_address,
-        auto_drainer_t::lock_t drainer_lock,
-        bool *successful_join) THROWS_NOTHING
-{
-    parent->assert_thread();
-
-    // Get the name of our peer, for error reporting.
-    ip_address_t peer_addr;
-    std::string peerstr = "(unknown)";
-    if (!conn->get_underlying_conn()->getpeername(&peer_addr))
-        peerstr = peer_addr.to_string();
-    const char *peername = peerstr.c_str();
-
-    // Make sure that if we're ordered to shut down, any pending read
-    // or write gets interrupted.
-    cluster_conn_closing_subscription_t conn_closer_1(conn);
-    conn_closer_1.reset(drainer_lock.get_drain_signal());
+/* What each side of a cluster connection sends after the protocol header and the
+version checks */
+struct connectivity_cluster_t::run_t::stream_header_t {
+    peer_id_t id;
+    std::set<host_and_port_t> hosts;
+    /* `message_class_t::control` on a main connection */
+    message_class_t message_class;
+    /* Ties a node's class connections to its main connection */
+    uuid_u session;
+    /* Bit `1 << c` is set for each class `c` that the sender opened a connection
+    for. Only meaningful on a main connection. */
+    uint8_t class_streams;
+    /* Bit `1 << c` is set for each class `c` that the sender offers to compress */
+    uint8_t compressed_classes;
+};
 
-    // Each side sends a header followed by its own ID and address, then receives and checks the
-    // other side's.
+bool connectivity_cluster_t::run_t::exchange_headers(tcp_conn_stream_t *conn,
+                                                     const stream_header_t &ours,
+                                                     stream_header_t *theirs,
+                                                     const char *peername) {
     {
         write_message_t msg;
         msg.append(cluster_proto_header.c_str(), cluster_proto_header.length());
@@ -561,10 +594,14 @@ void connectivity_cluster_t::run_t::handle(
         msg.append(cluster_arch_bitsize.data(), cluster_arch_bitsize.length());
         msg << static_cast<uint64_t>(cluster_build_mode.length());
         msg.append(cluster_build_mode.data(), cluster_build_mode.length());
-        msg << parent->me;
-        msg << routing_table[parent->me].hosts();
+        msg << ours.id;
+        msg << ours.hosts;
+        msg << ours.message_class;
+        msg << ours.session;
+        msg << ours.class_streams;
+        msg << ours.compressed_classes;
         if (send_write_message(conn, &msg))
-            return; // network error.
+            return false; // network error.
     }
 
     // Receive & check header.
@@ -575,12 +612,12 @@ void connectivity_cluster_t::run_t::handle(
         for (uint64_t i = 0; i < cluster_proto_header.length(); i += r) {
             r = conn->read(buffer, std::min(buffer_size, int64_t(cluster_proto_header.length() - i)));
             if (-1 == r)
-                return; // network error.
+                return false; // network error.
             rassert(r >= 0);
             // If EOF or remote_header does not match header, terminate connection.
             if (0 == r || memcmp(cluster_proto_header.c_str() + i, buffer, r) != 0) {
                 logWRN("Received invalid clustering header from %s, closing connection -- something might be connecting to the wrong port.", peername);
-                return;
+                return false;
             }
         }
     }
@@ -590,14 +627,14 @@ void connectivity_cluster_t::run_t::handle(
         std::string remote_version;
 
         if (!deserialize_compatible_string(conn, &remote_version, peername)) {
-            return;
+            return false;
         }
 
         if (remote_version != cluster_version) {
             logWRN("Connection attempt with a RethinkDB node of the wrong version, "
                    "peer: %s, local version: %s, remote version: %s, connection dropped\n",
                    peername, cluster_version.c_str(), remote_version.c_str());
-            return;
+            return false;
         }
     }
 
@@ -606,14 +643,14 @@ void connectivity_cluster_t::run_t::handle(
         std::string remote_arch_bitsize;
 
         if (!deserialize_compatible_string(conn, &remote_arch_bitsize, peername)) {
-            return;
+            return false;
         }
 
         if (remote_arch_bitsize != cluster_arch_bitsize) {
             logWRN("Connection attempt with a RethinkDB node of the wrong architecture, "
                    "peer: %s, local: %s, remote: %s, connection dropped\n",
                    peername, cluster_arch_bitsize.c_str(), remote_arch_bitsize.c_str());
-            return;
+            return false;
         }
 
     }
@@ -623,26 +660,418 @@ void connectivity_cluster_t::run_t::handle(
         std::string remote_build_mode;
 
         if (!deserialize_compatible_string(conn, &remote_build_mode, peername)) {
-            return;
+            return false;
         }
 
         if (remote_build_mode != cluster_build_mode) {
             logWRN("Connection attempt with a RethinkDB node of the wrong build mode, "
                    "peer: %s, local: %s, remote: %s, connection dropped\n",
                    peername, cluster_build_mode.c_str(), remote_build_mode.c_str());
-            return;
+            return false;
         }
     }
 
     // Receive id, host/ports.
-    peer_id_t other_id;
-    std::set<host_and_port_t> other_peer_addr_hosts;
-    if (deserialize_and_check(conn, &other_id, peername) ||
-        deserialize_and_check(conn, &other_peer_addr_hosts, peername))
+    return !deserialize_and_check(conn, &theirs->id, peername)
+        && !deserialize_and_check(conn, &theirs->hosts, peername)
+        && !deserialize_and_check(conn, &theirs->message_class, peername)
+        && !deserialize_and_check(conn, &theirs->session, peername)
+        && !deserialize_and_check(conn, &theirs->class_streams, peername)
+        && !deserialize_and_check(conn, &theirs->compressed_classes, peername);
+}
+
+// Copies the whole of `message` into `out`
+static void flatten_message(write_message_t *message, std::vector<char> *out) {
+    out->clear();
+    out->reserve(message->size());
+    intrusive_list_t<write_buffer_t> *buffers = message->unsafe_expose_buffers();
+    for (write_buffer_t *p = buffers->head(); p != NULL; p = buffers->next(p)) {
+        out->insert(out->end(), p->get_data(), p->get_data() + p->get_size());
+    }
+}
+
+/* On compressed connections, each message goes in a frame: a `uint8_t` that's 1 if
+the message is deflated, the size of the rest of the frame as a `uint64_t`, and then
+the message, preceded by its inflated size as a `uint64_t` if it's deflated. Messages
+shorter than CLUSTER_COMPRESSION_MIN_SIZE, or that deflate doesn't shrink, are
+framed as they are. */
+
+static void frame_message(const std::vector<char> &message, std::vector<char> *frame_out) {
+    const size_t prefix_size = sizeof(uint8_t) + sizeof(uint64_t);
+    frame_out->clear();
+    if (message.size() >= CLUSTER_COMPRESSION_MIN_SIZE) {
+        uLongf deflated_size = compressBound(message.size());
+        frame_out->resize(prefix_size + sizeof(uint64_t) + deflated_size);
+        char *deflated = frame_out->data() + prefix_size + sizeof(uint64_t);
+        int res = compress2(reinterpret_cast<Bytef *>(deflated), &deflated_size,
+                            reinterpret_cast<const Bytef *>(message.data()),
+                            message.size(), Z_BEST_SPEED);
+        guarantee(res == Z_OK, "compress2 failed with error %d", res);
+        if (sizeof(uint64_t) + deflated_size < message.size()) {
+            const uint8_t deflated_flag = 1;
+            const uint64_t frame_size = sizeof(uint64_t) + deflated_size;
+            const uint64_t inflated_size = message.size();
+            memcpy(frame_out->data(), &deflated_flag, sizeof(deflated_flag));
+            memcpy(frame_out->data() + sizeof(uint8_t), &frame_size, sizeof(frame_size));
+            memcpy(frame_out->data() + prefix_size, &inflated_size, sizeof(inflated_size));
+            frame_out->resize(prefix_size + frame_size);
+            return;
+        }
+    }
+
+    const uint8_t deflated_flag = 0;
+    const uint64_t frame_size = message.size();
+    frame_out->resize(prefix_size + message.size());
+    memcpy(frame_out->data(), &deflated_flag, sizeof(deflated_flag));
+    memcpy(frame_out->data() + sizeof(uint8_t), &frame_size, sizeof(frame_size));
+    memcpy(frame_out->data() + prefix_size, message.data(), message.size());
+}
+
+// Reads a frame written by `frame_message()` and returns the message in it. Throws
+// `fake_archive_exc_t` if the connection closes or the frame is invalid.
+static std::vector<char> read_framed_message(tcp_conn_stream_t *conn) {
+    uint8_t deflated_flag;
+    uint64_t frame_size;
+    if (deserialize(conn, &deflated_flag) != ARCHIVE_SUCCESS
+        || deserialize(conn, &frame_size) != ARCHIVE_SUCCESS
+        || deflated_flag > 1
+        || frame_size > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+        throw fake_archive_exc_t();
+    }
+
+    std::vector<char> frame(frame_size);
+    if (force_read(conn, frame.data(), frame_size) != static_cast<int64_t>(frame_size)) {
+        throw fake_archive_exc_t();
+    }
+    if (deflated_flag == 0) {
+        return frame;
+    }
+
+    uint64_t inflated_size;
+    if (frame_size < sizeof(inflated_size)) {
+        throw fake_archive_exc_t();
+    }
+    memcpy(&inflated_size, frame.data(), sizeof(inflated_size));
+    // Deflate can't shrink anything by more than a factor of about 1032
+    if (inflated_size / 2048 > frame_size) {
+        throw fake_archive_exc_t();
+    }
+    std::vector<char> message(inflated_size);
+    uLongf size = inflated_size;
+    int res = uncompress(reinterpret_cast<Bytef *>(message.data()), &size,
+                         reinterpret_cast<const Bytef *>(frame.data() + sizeof(inflated_size)),
+                         frame_size - sizeof(inflated_size));
+    if (res != Z_OK || size != inflated_size) {
+        throw fake_archive_exc_t();
+    }
+    return message;
+}
+
+// Reads messages off of `conn` and hands them to `message_handler` until `conn` is
+// closed or something invalid arrives on it
+static void handle_messages(message_handler_t *message_handler, peer_id_t peer,
+                            tcp_conn_stream_t *conn, bool compressed) {
+    /* Read messages off the connection until it's closed, which may be due to
+    network events, or the other end shutting down, or us shutting down. */
+    try {
+        int messages_handled_since_yield = 0;
+        while (true) {
+            // These might raise fake_archive_exc_t
+            if (compressed) {
+                vector_read_stream_t message(read_framed_message(conn));
+                message_handler->on_message(peer, &message);
+            } else {
+                message_handler->on_message(peer, conn);
+            }
+
+            ++messages_handled_since_yield;
+            if (messages_handled_since_yield >= MESSAGE_HANDLER_MAX_BATCH_SIZE) {
+                coro_t::yield();
+                messages_handled_since_yield = 0;
+            }
+        }
+    } catch (const fake_archive_exc_t &) {
+        /* The exception broke us out of the loop, and that's what we
+        wanted. This could either be because we lost contact with the peer
+        or because the cluster is shutting down and `close_conn()` got
+        called. */
+    }
+
+    if(conn->is_read_open()) {
+        logWRN("Received invalid data on a cluster connection. Disconnecting.");
+    }
+}
+
+struct connectivity_cluster_t::run_t::parked_stream_t {
+    parked_stream_t(tcp_conn_stream_t *_conn, peer_id_t _peer, message_class_t _message_class) :
+        conn(_conn), peer(_peer), message_class(_message_class) { }
+
+    tcp_conn_stream_t *const conn;
+    const peer_id_t peer;
+    const message_class_t message_class;
+
+    /* Pulsed when a main connection's `handle()` takes `conn` */
+    cond_t claimed;
+    /* Pulsed when that `handle()` is done with `conn` */
+    cond_t released;
+};
+
+/* The class connections that a main connection's `handle()` has claimed. The
+destructor hands them back to the coroutines that parked them. */
+class connectivity_cluster_t::run_t::class_stream_claims_t {
+public:
+    class_stream_claims_t() {
+        for (int i = 0; i < num_message_classes; ++i) {
+            streams[i] = NULL;
+        }
+    }
+    ~class_stream_claims_t() {
+        for (int i = 0; i < num_message_classes; ++i) {
+            if (streams[i] != NULL) {
+                streams[i]->released.pulse();
+            }
+        }
+    }
+
+    void claim(parked_stream_t *stream) {
+        const int i = static_cast<int>(stream->message_class);
+        guarantee(streams[i] == NULL);
+        streams[i] = stream;
+        stream->claimed.pulse();
+    }
+
+    // Fills in `conns_out[i]` for each class `i` we have a connection for
+    void get_conns(tcp_conn_stream_t **conns_out) const {
+        for (int i = 0; i < num_message_classes; ++i) {
+            if (streams[i] != NULL) {
+                conns_out[i] = streams[i]->conn;
+            }
+        }
+    }
+
+private:
+    parked_stream_t *streams[num_message_classes];
+
+    DISABLE_COPYING(class_stream_claims_t);
+};
+
+void connectivity_cluster_t::run_t::open_class_streams(const ip_and_port_t &address,
+                                                       auto_drainer_t::lock_t drainer_lock,
+                                                       class_streams_t *streams_out) THROWS_NOTHING {
+    parent->assert_thread();
+    streams_out->session = generate_uuid();
+    const std::string peerstr = address.ip().to_string();
+
+    for (int i = 0; i < num_message_classes; ++i) {
+        if (i == static_cast<int>(message_class_t::control)) {
+            continue;
+        }
+        try {
+            scoped_ptr_t<tcp_conn_stream_t> conn(
+                new tcp_conn_stream_t(address.ip(), address.port().value(),
+                                      drainer_lock.get_drain_signal()));
+            tls_ctx_t *tls_ctx = get_cluster_tls_ctx();
+            if (tls_ctx != NULL
+                && !conn->get_underlying_conn()->start_tls(tls_ctx, tls_role_t::client,
+                                                           drainer_lock.get_drain_signal())) {
+                continue;
+            }
+
+            cluster_conn_closing_subscription_t conn_closer(conn.get());
+            conn_closer.reset(drainer_lock.get_drain_signal());
+
+            stream_header_t our_header;
+            our_header.id = parent->me;
+            our_header.hosts = routing_table[parent->me].hosts();
+            our_header.message_class = static_cast<message_class_t>(i);
+            our_header.session = streams_out->session;
+            our_header.class_streams = 0;
+            our_header.compressed_classes = cluster_compressed_classes;
+            stream_header_t their_header;
+            if (exchange_headers(conn.get(), our_header, &their_header, peerstr.c_str())) {
+                streams_out->peer_ids[i] = their_header.id;
+                streams_out->conns[i] = std::move(conn);
+            }
+        } catch (const tcp_conn_t::connect_failed_exc_t &) {
+            /* Ignore; this class will go on the main connection */
+        } catch (const interrupted_exc_t &) {
+            /* Ignore */
+        }
+    }
+}
+
+void connectivity_cluster_t::run_t::park_class_stream(tcp_conn_stream_t *conn,
+                                                      peer_id_t peer,
+                                                      message_class_t message_class,
+                                                      uuid_u session,
+                                                      auto_drainer_t::lock_t drainer_lock) THROWS_NOTHING {
+    parent->assert_thread();
+    parked_stream_t parked(conn, peer, message_class);
+    multimap_insertion_sentry_t<uuid_u, parked_stream_t *> parking(
+        &parked_class_streams, session, &parked);
+
+    // The main connection may have gotten here first
+    std::map<uuid_u, cond_t *>::iterator main_conn = class_stream_waiters.find(session);
+    if (main_conn != class_stream_waiters.end() && !main_conn->second->is_pulsed()) {
+        main_conn->second->pulse();
+    }
+
+    signal_timer_t timeout;
+    timeout.start(CLASS_STREAM_TIMEOUT_MS);
+    wait_any_t waiter(&parked.claimed, &timeout, drainer_lock.get_drain_signal());
+    waiter.wait_lazily_unordered();
+    if (parked.claimed.is_pulsed()) {
+        // The main connection's `handle()` is using `conn` until it releases it,
+        // which it does even if we're shutting down.
+        parked.released.wait_lazily_unordered();
+    }
+}
+
+bool connectivity_cluster_t::run_t::claim_class_streams(peer_id_t peer,
+                                                        uuid_u session,
+                                                        uint8_t class_mask,
+                                                        signal_t *interruptor,
+                                                        class_stream_claims_t *claims) THROWS_NOTHING {
+    parent->assert_thread();
+    if ((class_mask & (1 << static_cast<int>(message_class_t::control))) != 0
+        || class_mask >= (1 << num_message_classes)) {
+        return false;
+    }
+
+    signal_timer_t timeout;
+    timeout.start(CLASS_STREAM_TIMEOUT_MS);
+    wait_any_t timeout_or_interruptor(&timeout, interruptor);
+    while (true) {
+        parked_stream_t *found[num_message_classes] = { };
+        uint8_t found_mask = 0;
+        auto range = parked_class_streams.equal_range(session);
+        for (auto it = range.first; it != range.second; ++it) {
+            parked_stream_t *stream = it->second;
+            const int i = static_cast<int>(stream->message_class);
+            if (stream->peer == peer && (class_mask & (1 << i)) != 0
+                && !stream->claimed.is_pulsed()) {
+                found[i] = stream;
+                found_mask |= 1 << i;
+            }
+        }
+        if (found_mask == class_mask) {
+            for (int i = 0; i < num_message_classes; ++i) {
+                if (found[i] != NULL) {
+                    claims->claim(found[i]);
+                }
+            }
+            return true;
+        }
+
+        cond_t arrived;
+        map_insertion_sentry_t<uuid_u, cond_t *> waiting(&class_stream_waiters, session, &arrived);
+        try {
+            wait_interruptible(&arrived, &timeout_or_interruptor);
+        } catch (const interrupted_exc_t &) {
+            return false;
+        }
+    }
+}
+
+// Critical section: we must check for conflicts and register ourself
+//  without the interference of any other connections. This ensures that
+//  any conflicts are resolved consistently. It also ensures that if we get
+//  two connections from different nodes, one will find out about the other.
+bool connectivity_cluster_t::run_t::get_routing_table_to_send_and_add_peer(
+        const peer_id_t &other_peer_id,
+        const peer_address_t &other_peer_addr,
+        object_buffer_t<map_insertion_sentry_t<peer_id_t, peer_address_t> > *routing_table_entry_sentry,
+        std::map<peer_id_t, std::set<host_and_port_t> > *result) {
+    mutex_t::acq_t acq(&new_connection_mutex);
+
+    // Here's how this situation can happen:
+    // 1. We are connected to another node.
+    // 2. The connection is interrupted.
+    // 3. The other node gives up on the original TCP connection, but we have not given up on it yet.
+    // 4. The other node tries to reconnect, and the new TCP connection gets through and this node ends up here.
+    // 5. We now have a duplicate connection to the other node.
+    if (routing_table.find(other_peer_id) != routing_table.end()) {
+        // In this case, just exit this function, which will close the connection
+        // This will happen until the old connection dies
+        // TODO: ensure that the old connection shuts down?
+        return false;
+    }
+
+    // Make a serializable copy of `routing_table` before exiting the critical section
+    result->clear();
+    for (auto it = routing_table.begin(); it != routing_table.end(); ++it) {
+        result->insert(std::make_pair(it->first, it->second.hosts()));
+    }
+
+    // Register ourselves while in the critical section, so that whoever comes next will see us
+    routing_table_entry_sentry->create(&routing_table, other_peer_id, other_peer_addr);
+
+    return true;
+}
+
+// We log error conditions as follows:
+// - silent: network error; conflict between parallel connections
+// - warning: invalid header
+// - error: id or address don't match expected id or address; deserialization range error; unknown error
+// In all cases we close the connection and quit.
+void connectivity_cluster_t::run_t::handle(
+        /* `conn` should remain valid until `handle()` returns.
+         * `handle()` does not take ownership of `conn`. */
+        keepalive_tcp_conn_stream_t *conn,
+        boost::optional<peer_id_t> expected_id,
+        boost::optional<peer_address_t> expected_address,
+        auto_drainer_t::lock_t drainer_lock,
+        bool *successful_join,
+        /* The class connections we opened to the peer before `conn`, or NULL if
+         * the peer opened `conn` to us. */
+        class_streams_t *class_streams) THROWS_NOTHING
+{
+    parent->assert_thread();
+
+    // Get the name of our peer, for error reporting.
+    ip_address_t peer_addr;
+    std::string peerstr = "(unknown)";
+    if (!conn->get_underlying_conn()->getpeername(&peer_addr))
+        peerstr = peer_addr.to_string();
+    const char *peername = peerstr.c_str();
+
+    // Make sure that if we're ordered to shut down, any pending read
+    // or write gets interrupted.
+    cluster_conn_closing_subscription_t conn_closer_1(conn);
+    conn_closer_1.reset(drainer_lock.get_drain_signal());
+
+    // Each side sends a header followed by its own ID and address, then receives and checks the
+    // other side's.
+    stream_header_t our_header;
+    our_header.id = parent->me;
+    our_header.hosts = routing_table[parent->me].hosts();
+    our_header.message_class = message_class_t::control;
+    our_header.session = class_streams == NULL ? nil_uuid() : class_streams->session;
+    our_header.class_streams = 0;
+    our_header.compressed_classes = cluster_compressed_classes;
+    for (int i = 0; i < num_message_classes && class_streams != NULL; ++i) {
+        if (class_streams->conns[i].has()) {
+            our_header.class_streams |= 1 << i;
+        }
+    }
+
+    stream_header_t their_header;
+    if (!exchange_headers(conn, our_header, &their_header, peername)) {
         return;
+    }
+    peer_id_t other_id = their_header.id;
+
+    if (their_header.message_class != message_class_t::control) {
+        // This is one of the peer's class connections, not its main connection
+        if (class_streams == NULL) {
+            park_class_stream(conn, other_id, their_header.message_class,
+                              their_header.session, drainer_lock);
+        }
+        return;
+    }
 
     // Look up the ip addresses for the other host
-    peer_address_t other_peer_addr(other_peer_addr_hosts);
+    peer_address_t other_peer_addr(their_header.hosts);
 
     /* Sanity checks */
     if (other_id == parent->me) {
@@ -672,6 +1101,36 @@ void connectivity_cluster_t::run_t::handle(
         return;
     }
 
+    /* Gather the connections for each message class */
+    tcp_conn_stream_t *class_conns[num_message_classes];
+    class_stream_claims_t class_stream_claims;
+    for (int i = 0; i < num_message_classes; ++i) {
+        class_conns[i] = NULL;
+    }
+    if (class_streams != NULL) {
+        for (int i = 0; i < num_message_classes; ++i) {
+            if (class_streams->conns[i].has()) {
+                if (class_streams->peer_ids[i] != other_id) {
+                    logERR("received inconsistent routing information (wrong ID on a class connection) from %s, closing connection", peername);
+                    return;
+                }
+                class_conns[i] = class_streams->conns[i].get();
+            }
+        }
+    } else if (their_header.class_streams != 0) {
+        if (!claim_class_streams(other_id, their_header.session, their_header.class_streams,
+                                 drainer_lock.get_drain_signal(), &class_stream_claims)) {
+            return;
+        }
+        class_stream_claims.get_conns(class_conns);
+    }
+    class_conns[static_cast<int>(message_class_t::control)] = conn;
+    for (int i = 0; i < num_message_classes; ++i) {
+        if (class_conns[i] != conn) {
+            conn_closer_1.add(class_conns[i]);
+        }
+    }
+
     // Just saying that we're still on the rpc listener thread.
     parent->assert_thread();
 
@@ -786,50 +1245,58 @@ void connectivity_cluster_t::run_t::handle(
 
     cross_thread_signal_t connection_thread_drain_signal(drainer_lock.get_drain_signal(), chosen_thread);
 
-    rethread_tcp_conn_stream_t unregister_conn(conn, INVALID_THREAD);
+    object_buffer_t<rethread_tcp_conn_stream_t> unregister_conns[num_message_classes];
+    for (int i = 0; i < num_message_classes; ++i) {
+        if (class_conns[i] != NULL) {
+            unregister_conns[i].create(class_conns[i], INVALID_THREAD);
+        }
+    }
     on_thread_t conn_threader(chosen_thread);
-    rethread_tcp_conn_stream_t reregister_conn(conn, get_thread_id());
+    object_buffer_t<rethread_tcp_conn_stream_t> reregister_conns[num_message_classes];
+    for (int i = 0; i < num_message_classes; ++i) {
+        if (class_conns[i] != NULL) {
+            reregister_conns[i].create(class_conns[i], get_thread_id());
+        }
+    }
 
     // Make sure that if we're ordered to shut down, any pending read
     // or write gets interrupted.
     cluster_conn_closing_subscription_t conn_closer_2(conn);
+    for (int i = 0; i < num_message_classes; ++i) {
+        if (class_conns[i] != conn) {
+            conn_closer_2.add(class_conns[i]);
+        }
+    }
     conn_closer_2.reset(&connection_thread_drain_signal);
 
     {
         /* `connection_entry_t` is the public interface of this coroutine. Its
         constructor registers it in the `connectivity_cluster_t`'s connection
         map and notifies any connect listeners. */
-        connection_entry_t conn_structure(this, other_id, conn, other_peer_addr);
+        const uint8_t compressed_classes =
+            our_header.compressed_classes & their_header.compressed_classes;
+        connection_entry_t conn_structure(this, other_id, class_conns, compressed_classes,
+                                          other_peer_addr);
         object_buffer_t<heartbeat_keepalive_t> keepalive;
 
         if (heartbeat_manager != NULL) {
             keepalive.create(conn, heartbeat_manager, other_id);
         }
 
-        /* Main message-handling loop: read messages off the connection until
-        it's closed, which may be due to network events, or the other end
-        shutting down, or us shutting down. */
-        try {
-            int messages_handled_since_yield = 0;
-            while (true) {
-                message_handler->on_message(other_id, conn); // might raise fake_archive_exc_t
-
-                ++messages_handled_since_yield;
-                if (messages_handled_since_yield >= MESSAGE_HANDLER_MAX_BATCH_SIZE) {
-                    coro_t::yield();
-                    messages_handled_since_yield = 0;
+        /* Main message-handling loops: one per connection. Once one of the
+        peer's connections is gone, messages in its class can't be delivered in
+        order anymore, so we close the others too and let the peer reconnect. */
+        pmap(num_message_classes, [&](int i) {
+            if (class_conns[i] != NULL) {
+                const bool compressed = (compressed_classes & (1 << i)) != 0;
+                handle_messages(message_handler, other_id, class_conns[i], compressed);
+                for (int j = 0; j < num_message_classes; ++j) {
+                    if (class_conns[j] != NULL) {
+                        close_cluster_conn(class_conns[j]);
+                    }
                 }
             }
-        } catch (const fake_archive_exc_t &) {
-            /* The exception broke us out of the loop, and that's what we
-            wanted. This could either be because we lost contact with the peer
-            or because the cluster is shutting down and `close_conn()` got
-            called. */
-        }
-
-        if(conn->is_read_open()) {
-            logWRN("Received invalid data on a cluster connection. Disconnecting.");
-        }
+        });
 
         /* The `conn_structure` destructor removes us from the connection map
         and notifies any disconnect listeners. */
@@ -881,32 +1348,35 @@ connectivity_service_t *connectivity_cluster_t::get_connectivity_service() THROW
     return this;
 }
 
-void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_callback_t *callback) THROWS_NOTHING {
+void connectivity_cluster_t::send_message(peer_id_t dest, message_class_t message_class,
+                                          send_message_write_callback_t *callback) THROWS_NOTHING {
     // We could be on _any_ thread.
 
     guarantee(!dest.is_nil());
 
-    /* We currently write the message to a vector_stream_t, then
-       serialize that as a string. It's horribly inefficient, of course. */
-    // TODO: If we don't do it this way, we (or the caller) will need
-    // to worry about having the writer run on the connection thread.
-    vector_stream_t buffer;
-    // Reserve some space to reduce overhead (especially for small messages)
-    buffer.reserve(1024);
+    /* The callback's output is collected in a `write_message_t`, which refers to
+    large buffers (e.g. values) instead of copying them, so they can go to the
+    socket with `writev()` without ever being copied into one contiguous message.
+    It's only flattened when it has to be: for delivery to ourself and for
+    compression. */
+    write_message_stream_t buffer;
     {
         ASSERT_FINITE_CORO_WAITING;
         callback->write(&buffer);
     }
+    write_message_t *message = buffer.message();
 
 #ifdef CLUSTER_MESSAGE_DEBUGGING
     {
+        std::vector<char> flat;
+        flatten_message(message, &flat);
         printf_buffer_t buf;
         buf.appendf("from ");
         debug_print(&buf, me);
         buf.appendf(" to ");
         debug_print(&buf, dest);
         buf.appendf("\n");
-        print_hd(buffer.vector().data(), 0, buffer.vector().size());
+        print_hd(flat.data(), 0, flat.size());
     }
 #endif
 
@@ -936,36 +1406,89 @@ void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_cal
         conn_structure_lock = it->second.second;
     }
 
-    size_t bytes_sent = buffer.vector().size();
+    size_t bytes_sent = message->size();
 
     if (conn_structure->conn == NULL) {
         // We're sending a message to ourself
         guarantee(dest == me);
         // We could be on any thread here! Oh no!
         std::vector<char> buffer_data;
-        buffer.swap(&buffer_data);
+        flatten_message(message, &buffer_data);
         vector_read_stream_t read_stream(std::move(buffer_data));
         current_run->message_handler->on_message(me, &read_stream);
     } else {
         guarantee(dest != me);
+
+        mutex_t *send_mutex;
+        bool compressed;
+        tcp_conn_stream_t *conn = conn_structure->get_conn(message_class, &send_mutex,
+                                                           &compressed);
+
+        /* Compress here rather than on the connection's thread, so senders on
+        different threads don't wait for each other's compression. */
+        std::vector<char> frame;
+        std::vector<iovec> iov;
+        if (compressed) {
+            std::vector<char> flat;
+            flatten_message(message, &flat);
+            frame_message(flat, &frame);
+            bytes_sent = frame.size();
+            iovec v;
+            v.iov_base = frame.data();
+            v.iov_len = frame.size();
+            iov.push_back(v);
+        } else {
+            intrusive_list_t<write_buffer_t> *buffers = message->unsafe_expose_buffers();
+            for (write_buffer_t *p = buffers->head(); p != NULL; p = buffers->next(p)) {
+                iovec v;
+                v.iov_base = const_cast<char *>(p->get_data());
+                v.iov_len = p->get_size();
+                iov.push_back(v);
+            }
+        }
+
         on_thread_t threader(conn_structure->conn->home_thread());
 
         /* Acquire the send-mutex so we don't collide with other things trying
         to send on the same connection. */
-        mutex_t::acq_t acq(&conn_structure->send_mutex);
+        mutex_t::acq_t acq(send_mutex);
 
         {
-            int64_t res = conn_structure->conn->write(buffer.vector().data(),
-                                                      buffer.vector().size());
+            int64_t res;
+            if (bytes_sent < CLUSTER_COALESCE_MAX_SIZE) {
+                res = 0;
+                for (size_t i = 0; i < iov.size() && res != -1; ++i) {
+                    res = conn->write_buffered(iov[i].iov_base, iov[i].iov_len);
+                }
+                res = res == -1 ? -1 : bytes_sent;
+                int index = conn_structure->get_conn_index(message_class);
+                if (res != -1 && !conn_structure->flush_pending[index]) {
+                    /* The flush needs a lock on this thread's `auto_drainer_t` for
+                    the connection entry. If it's going away, flush right now. */
+                    std::map<peer_id_t, std::pair<run_t::connection_entry_t *, auto_drainer_t::lock_t> >::const_iterator it =
+                        thread_info.get()->connection_map.find(dest);
+                    if (it != thread_info.get()->connection_map.end()
+                        && it->second.first == conn_structure) {
+                        conn_structure->flush_pending[index] = true;
+                        coro_t::spawn_later_ordered(std::bind(
+                            &connectivity_cluster_t::flush_conn_later,
+                            conn_structure, index, it->second.second));
+                    } else if (conn->flush_buffer() == -1) {
+                        res = -1;
+                    }
+                }
+            } else {
+                res = conn->writev(iov.data(), iov.size());
+            }
             if (res == -1) {
                 /* Close the other half of the connection to make sure that
                    `connectivity_cluster_t::run_t::handle()` notices that something is
                    up */
-                if (conn_structure->conn->is_read_open()) {
-                    conn_structure->conn->shutdown_read();
+                if (conn->is_read_open()) {
+                    conn->shutdown_read();
                 }
             } else {
-                guarantee(res == static_cast<int64_t>(buffer.vector().size()));
+                guarantee(res == static_cast<int64_t>(bytes_sent));
             }
         }
     }
@@ -973,6 +1496,51 @@ void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_cal
     conn_structure->pm_bytes_sent.record(bytes_sent);
 }
 
+void connectivity_cluster_t::flush_conn(run_t::connection_entry_t *conn_structure,
+                                        int index) {
+    tcp_conn_stream_t *conn = conn_structure->class_conns[index];
+    guarantee(get_thread_id() == conn->home_thread());
+    mutex_t::acq_t acq(&conn_structure->send_mutexes[index]);
+    if (conn->flush_buffer() == -1) {
+        if (conn->is_read_open()) {
+            conn->shutdown_read();
+        }
+    }
+}
+
+void connectivity_cluster_t::flush_conn_later(run_t::connection_entry_t *conn_structure,
+                                              int index,
+                                              UNUSED auto_drainer_t::lock_t lock) {
+    /* Messages buffered from now on need another flush, since we might already
+    be past them */
+    conn_structure->flush_pending[index] = false;
+    flush_conn(conn_structure, index);
+}
+
+void connectivity_cluster_t::flush_messages(peer_id_t dest) THROWS_NOTHING {
+    run_t::connection_entry_t *conn_structure;
+    auto_drainer_t::lock_t conn_structure_lock;
+    {
+        std::map<peer_id_t, std::pair<run_t::connection_entry_t *, auto_drainer_t::lock_t> > *connection_map =
+            &thread_info.get()->connection_map;
+        std::map<peer_id_t, std::pair<run_t::connection_entry_t *, auto_drainer_t::lock_t> >::const_iterator it =
+            connection_map->find(dest);
+        if (it == connection_map->end() || it->second.first->conn == NULL) {
+            // Messages to ourself are never buffered
+            return;
+        }
+        conn_structure = it->second.first;
+        conn_structure_lock = it->second.second;
+    }
+
+    on_thread_t threader(conn_structure->conn->home_thread());
+    for (int i = 0; i < num_message_classes; ++i) {
+        if (conn_structure->flush_pending[i]) {
+            flush_conn(conn_structure, i);
+        }
+    }
+}
+
 void connectivity_cluster_t::kill_connection(peer_id_t peer) THROWS_NOTHING {
     std::map<peer_id_t, std::pair<run_t::connection_entry_t *, auto_drainer_t::lock_t> > *connection_map =
         &thread_info.get()->connection_map;
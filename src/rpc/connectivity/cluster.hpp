@@ -55,6 +55,12 @@ private:
     std::vector<peer_address_t> vec;
 };
 
+/* The message classes that we offer to compress on connections to other nodes, as
+bits `1 << class`. Like the other process-wide settings, this is set from the
+command line before the thread pool starts. A class is only compressed if both
+nodes offer it and it has a connection of its own; `control` never is. */
+void set_cluster_compressed_classes(uint8_t class_mask);
+
 class connectivity_cluster_t :
     public connectivity_service_t,
     public message_service_t,
@@ -94,20 +100,47 @@ public:
         public:
             /* The constructor registers us in every thread's `connection_map`;
             the destructor deregisters us. Both also notify all subscribers. */
-            connection_entry_t(run_t *, peer_id_t, tcp_conn_stream_t *,
+            connection_entry_t(run_t *, peer_id_t, tcp_conn_stream_t *const *class_conns,
+                               uint8_t compressed_classes,
                                const peer_address_t &peer) THROWS_NOTHING;
             ~connection_entry_t() THROWS_NOTHING;
 
-            /* NULL for our "connection" to ourself */
+            /* Returns the index in `class_conns` of the connection that messages
+            of `message_class` go on */
+            int get_conn_index(message_class_t message_class);
+
+            /* Returns the connection that messages of `message_class` go on, the
+            mutex to hold while writing to it, and whether messages on it are
+            framed and compressed */
+            tcp_conn_stream_t *get_conn(message_class_t message_class,
+                                        mutex_t **send_mutex_out,
+                                        bool *compressed_out);
+
+            /* The main connection, which carries `message_class_t::control`
+            messages and those of any class without a connection of its own. NULL
+            for our "connection" to ourself */
             tcp_conn_stream_t *conn;
 
+            /* Indexed by message class; `class_conns[control]` is `conn`, and the
+            others are NULL if the peer didn't open a connection for that class.
+            All of them are on `conn`'s thread. */
+            tcp_conn_stream_t *class_conns[num_message_classes];
+
+            /* The classes whose connections both sides agreed to compress */
+            uint8_t compressed_classes;
+
             /* `connection_t` contains the addresses so that we can call
             `get_peers_list()` on any thread. Otherwise, we would have to go
             cross-thread to access the routing table. */
             peer_address_t address;
 
-            /* Unused for our connection to ourself */
-            mutex_t send_mutex;
+            /* Indexed like `class_conns`. Unused for our connection to ourself */
+            mutex_t send_mutexes[num_message_classes];
+
+            /* Indexed like `class_conns`. True while a coroutine is waiting to
+            flush the small messages buffered on that connection. Only accessed
+            on `conn`'s thread. */
+            bool flush_pending[num_message_classes];
 
             uuid_u session_id;
 
@@ -156,8 +189,58 @@ public:
             DISABLE_COPYING(variable_setter_t);
         };
 
+        /* Before a node sends the header on its main connection to a peer, it
+        opens a connection for each of the other message classes. These carry the
+        same header, except for the class and a session ID that ties them to the
+        main connection. */
+        struct class_streams_t {
+            uuid_u session;
+            /* Indexed by message class; NULL for classes we couldn't connect */
+            scoped_ptr_t<tcp_conn_stream_t> conns[num_message_classes];
+            peer_id_t peer_ids[num_message_classes];
+        };
+
+        /* What each side of a connection sends after the version checks */
+        struct stream_header_t;
+
+        /* Sends `ours` and receives and checks the other side's header. Returns
+        false if the connection should be closed. */
+        static bool exchange_headers(tcp_conn_stream_t *conn,
+                                     const stream_header_t &ours,
+                                     stream_header_t *theirs,
+                                     const char *peername);
+
+        /* A class connection that a peer opened to us, waiting in
+        `parked_class_streams` for its main connection's `handle()` to claim it */
+        struct parked_stream_t;
+        class class_stream_claims_t;
+
         void on_new_connection(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn, auto_drainer_t::lock_t lock) THROWS_NOTHING;
 
+        /* Opens the connections for the message classes other than `control` to
+        `address`. Classes that fail get no connection. */
+        void open_class_streams(const ip_and_port_t &address,
+                                auto_drainer_t::lock_t drainer_lock,
+                                class_streams_t *streams_out) THROWS_NOTHING;
+
+        /* Runs in the `handle()` of a class connection that a peer opened to us.
+        Returns once the main connection is done with it, or if no main connection
+        claims it in time. */
+        void park_class_stream(tcp_conn_stream_t *conn,
+                               peer_id_t peer,
+                               message_class_t message_class,
+                               uuid_u session,
+                               auto_drainer_t::lock_t drainer_lock) THROWS_NOTHING;
+
+        /* Waits for the class connections in `class_mask` with the given session
+        to be parked, and hands them to `claims`. Returns false if they don't all
+        show up in time. */
+        bool claim_class_streams(peer_id_t peer,
+                                 uuid_u session,
+                                 uint8_t class_mask,
+                                 signal_t *interruptor,
+                                 class_stream_claims_t *claims) THROWS_NOTHING;
+
         /* `connectivity_cluster_t::connect_to_peer` is spawned for each known
         ip address of a peer which we want to connect to, all but one should
         fail */
@@ -193,7 +276,8 @@ public:
             boost::optional<peer_id_t> expected_id,
             boost::optional<peer_address_t> expected_address,
             auto_drainer_t::lock_t,
-            bool *successful_join) THROWS_NOTHING;
+            bool *successful_join,
+            class_streams_t *class_streams) THROWS_NOTHING;
 
         connectivity_cluster_t *parent;
 
@@ -220,6 +304,11 @@ public:
         redundant connections to the same peer. */
         mutex_t new_connection_mutex;
 
+        /* Class connections from peers, by session ID, and the main connections
+        waiting for more of them to arrive */
+        std::multimap<uuid_u, parked_stream_t *> parked_class_streams;
+        std::map<uuid_u, cond_t *> class_stream_waiters;
+
         scoped_ptr_t<tcp_bound_socket_t> cluster_listener_socket;
         int cluster_listener_port;
         int cluster_client_port;
@@ -250,7 +339,8 @@ public:
 
     /* `message_service_t` public methods: */
     connectivity_service_t *get_connectivity_service() THROWS_NOTHING;
-    void send_message(peer_id_t, send_message_write_callback_t *callback) THROWS_NOTHING;
+    void send_message(peer_id_t, message_class_t, send_message_write_callback_t *callback) THROWS_NOTHING;
+    void flush_messages(peer_id_t) THROWS_NOTHING;
     void kill_connection(peer_id_t) THROWS_NOTHING;
 
     /* Other public methods: */
@@ -279,6 +369,14 @@ private:
         publisher_controller_t<peers_list_callback_t *> publisher;
     };
 
+    /* Sends what's buffered on `conn_structure->class_conns[index]`. Must be
+    called on that connection's thread. */
+    static void flush_conn(run_t::connection_entry_t *conn_structure, int index);
+    /* Spawned by `send_message()` to do `flush_conn()` once the coroutines
+    queued before it have had a chance to buffer messages too */
+    static void flush_conn_later(run_t::connection_entry_t *conn_structure, int index,
+                                 auto_drainer_t::lock_t);
+
     /* `connectivity_service_t` private methods: */
     rwi_lock_assertion_t *get_peers_list_lock() THROWS_NOTHING;
     publisher_t<peers_list_callback_t *> *get_peers_list_publisher() THROWS_NOTHING;
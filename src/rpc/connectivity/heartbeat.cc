@@ -23,8 +23,8 @@ heartbeat_manager_t::per_thread_data_t::~per_thread_data_t() {
     }
 }
 
-heartbeat_manager_t::per_thread_data_t::conn_data_t::conn_data_t() :
-    outstanding(0),
+heartbeat_manager_t::per_thread_data_t::conn_data_t::conn_data_t(int64_t now_ms) :
+    detector(now_ms, HEARTBEAT_INTERVAL_MS, HEARTBEAT_ACCEPTABLE_PAUSE_MS),
     tracker(NULL) {
     // Do nothing
 }
@@ -32,7 +32,8 @@ heartbeat_manager_t::per_thread_data_t::conn_data_t::conn_data_t() :
 
 void heartbeat_manager_t::begin_peer_heartbeat(const peer_id_t &peer_id) {
     per_thread_data_t *data = thread_data.get();
-    guarantee(data->connections.insert(std::make_pair(peer_id, per_thread_data_t::conn_data_t())).second == true);
+    const int64_t now_ms = get_ticks() / MILLION;
+    guarantee(data->connections.insert(std::make_pair(peer_id, per_thread_data_t::conn_data_t(now_ms))).second == true);
 
     if (data->timer_token == NULL) {
         rassert(data->connections.size() == 1);
@@ -64,6 +65,7 @@ void heartbeat_manager_t::on_timer() {
     ASSERT_FINITE_CORO_WAITING;
     heartbeat_manager_t *self = this;
     per_thread_data_t *data = self->thread_data.get();
+    const int64_t now_ms = get_ticks() / MILLION;
     for (std::map<peer_id_t, per_thread_data_t::conn_data_t>::iterator it = data->connections.begin();
          it != data->connections.end(); ++it) {
         bool read_done = false;
@@ -74,9 +76,20 @@ void heartbeat_manager_t::on_timer() {
             write_done = it->second.tracker->check_and_reset_writes();
         }
 
-        if (it->second.outstanding >= HEARTBEAT_TIMEOUT_INTERVALS) {
+        if (read_done) {
+            // We've read data from the socket since the last timer.  (This only
+            // knows arrival times to within a timer interval, which the detector's
+            // minimum spread covers.)
+            it->second.detector.arrival(now_ms);
+        }
+
+        const double phi = it->second.detector.phi(now_ms);
+        if (phi >= HEARTBEAT_PHI_THRESHOLD) {
             const std::string peer_str(uuid_to_str(it->first.get_uuid()).c_str());
-            logERR("Heartbeat timeout, killing connection to peer: %s.", peer_str.c_str());
+            logERR("Heartbeat timeout, killing connection to peer: %s "
+                   "(nothing heard for %" PRIi64 " ms, phi %.1f).",
+                   peer_str.c_str(), now_ms - it->second.detector.last_arrival_ms(),
+                   phi);
             coro_t::spawn_later_ordered(std::bind(&heartbeat_manager_t::kill_connection_wrapper,
                                                   self,
                                                   it->first,
@@ -88,13 +101,6 @@ void heartbeat_manager_t::on_timer() {
                                                   it->first,
                                                   auto_drainer_t::lock_t(&data->drainer)));
         }
-
-        if (read_done) {
-            // If we've read data from the socket since the last timer, clear the outstanding acks
-            it->second.outstanding = 0;
-        }
-
-        ++it->second.outstanding;
     }
 }
 
@@ -103,5 +109,5 @@ void heartbeat_manager_t::kill_connection_wrapper(const peer_id_t peer, UNUSED a
 }
 
 void heartbeat_manager_t::send_message_wrapper(const peer_id_t peer, UNUSED auto_drainer_t::lock_t keepalive) {
-    message_service->send_message(peer, &writer);
+    message_service->send_message(peer, message_class_t::control, &writer);
 }
@@ -9,6 +9,7 @@
 #include "concurrency/one_per_thread.hpp"
 #include "rpc/connectivity/connectivity.hpp"
 #include "rpc/connectivity/messages.hpp"
+#include "rpc/connectivity/phi_accrual.hpp"
 #include "utils.hpp"
 
 
@@ -33,8 +34,14 @@ public:
     void set_keepalive_tracker(const peer_id_t &peer_id, heartbeat_keepalive_tracker_t *tracker);
 
 private:
-    static const int64_t HEARTBEAT_INTERVAL_MS = 2000;
-    static const uint32_t HEARTBEAT_TIMEOUT_INTERVALS = 5;
+    // A heartbeat goes out on every connection that has been quiet for this long.
+    static const int64_t HEARTBEAT_INTERVAL_MS = 250;
+    // A connection is killed once the phi-accrual detector is this sure that the
+    // peer is gone (phi 8 means a 1 in 10^8 chance of a false positive).
+    static constexpr double HEARTBEAT_PHI_THRESHOLD = 8.0;
+    // How much later than usual heartbeats may arrive before the detector starts
+    // to worry, to ride out short stalls on either side.
+    static const int64_t HEARTBEAT_ACCEPTABLE_PAUSE_MS = 500;
 
     void on_timer();
 
@@ -55,8 +62,9 @@ private:
         timer_token_t *timer_token;
 
         struct conn_data_t {
-            conn_data_t();
-            uint32_t outstanding;
+            explicit conn_data_t(int64_t now_ms);
+            // Learns how far apart reads from the peer usually are.
+            phi_accrual_detector_t detector;
             heartbeat_keepalive_tracker_t *tracker;
         };
 
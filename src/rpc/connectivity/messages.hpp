@@ -6,6 +6,7 @@ class connectivity_service_t;
 class peer_id_t;
 class write_stream_t;
 
+#include "containers/archive/archive.hpp"
 #include "containers/archive/string_stream.hpp"
 
 namespace boost {
@@ -46,6 +47,16 @@ no further messages are delivered. This gives a natural way to make sure that no
 messages are still being delivered at the time that the `application_t`
 destructor is called. */
 
+/* Messages are sent in one of these classes. `connectivity_cluster_t` gives each
+class its own connection to a peer where it can, so that a big backfill doesn't
+hold up heartbeats or queries. Messages are only delivered in the order they were
+sent if they are to the same peer and in the same class. */
+enum class message_class_t { control = 0, query, bulk };
+static const int num_message_classes = 3;
+
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(message_class_t, int8_t,
+                                      message_class_t::control, message_class_t::bulk);
+
 class send_message_write_callback_t {
 public:
     virtual ~send_message_write_callback_t() { }
@@ -54,7 +65,12 @@ public:
 
 class message_service_t  {
 public:
-    virtual void send_message(peer_id_t dest_peer, send_message_write_callback_t *callback) = 0;
+    virtual void send_message(peer_id_t dest_peer, message_class_t message_class,
+                              send_message_write_callback_t *callback) = 0;
+    /* Small messages may be held back for a moment so that several of them go
+    out in one write. `flush_messages()` is a hint to send any that are being held
+    for `dest_peer` now, e.g. before waiting for a reply to them. */
+    virtual void flush_messages(peer_id_t dest_peer) = 0;
     virtual void kill_connection(peer_id_t dest_peer) = 0;
     virtual connectivity_service_t *get_connectivity_service() = 0;
 protected:
@@ -91,15 +91,19 @@ private:
     send_message_write_callback_t *subwriter;
 };
 
-void message_multiplexer_t::client_t::send_message(peer_id_t dest, send_message_write_callback_t *callback) {
+void message_multiplexer_t::client_t::send_message(peer_id_t dest, message_class_t message_class, send_message_write_callback_t *callback) {
     tagged_message_writer_t writer(tag, callback);
     {
         semaphore_acq_t outstanding_write_acq (outstanding_writes_semaphores.get());
-        parent->message_service->send_message(dest, &writer);
+        parent->message_service->send_message(dest, message_class, &writer);
         // Release outstanding_writes_semaphore
     }
 }
 
+void message_multiplexer_t::client_t::flush_messages(peer_id_t peer) {
+    parent->message_service->flush_messages(peer);
+}
+
 void message_multiplexer_t::client_t::kill_connection(peer_id_t peer) {
     parent->message_service->kill_connection(peer);
 }
@@ -59,7 +59,8 @@ public:
                  int max_outstanding = DEFAULT_MAX_OUTSTANDING_WRITES_PER_THREAD);
         ~client_t();
         connectivity_service_t *get_connectivity_service();
-        void send_message(peer_id_t, send_message_write_callback_t *callback);
+        void send_message(peer_id_t, message_class_t, send_message_write_callback_t *callback);
+        void flush_messages(peer_id_t);
         void kill_connection(peer_id_t);
     private:
         friend class message_multiplexer_t;
@@ -0,0 +1,55 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rpc/connectivity/phi_accrual.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+
+phi_accrual_detector_t::phi_accrual_detector_t(int64_t now_ms,
+                                               int64_t first_interval_ms,
+                                               int64_t acceptable_pause_ms)
+    : acceptable_pause_ms_(acceptable_pause_ms),
+      last_arrival_ms_(now_ms),
+      sum_(0),
+      sum_of_squares_(0) {
+    guarantee(first_interval_ms > 0);
+    // Two samples a quarter of the interval apart either way, so that the first
+    // real arrivals don't make the spread collapse.
+    add_interval(first_interval_ms - first_interval_ms / 4);
+    add_interval(first_interval_ms + first_interval_ms / 4);
+}
+
+void phi_accrual_detector_t::add_interval(int64_t interval_ms) {
+    intervals_.push_back(interval_ms);
+    sum_ += interval_ms;
+    sum_of_squares_ += static_cast<double>(interval_ms) * interval_ms;
+    if (intervals_.size() > WINDOW_SIZE) {
+        const double oldest = intervals_.front();
+        intervals_.pop_front();
+        sum_ -= oldest;
+        sum_of_squares_ -= oldest * oldest;
+    }
+}
+
+void phi_accrual_detector_t::arrival(int64_t now_ms) {
+    add_interval(std::max<int64_t>(now_ms - last_arrival_ms_, 0));
+    last_arrival_ms_ = now_ms;
+}
+
+double phi_accrual_detector_t::phi(int64_t now_ms) const {
+    const double n = intervals_.size();
+    const double mean = sum_ / n + acceptable_pause_ms_;
+    const double variance = std::max(sum_of_squares_ / n - (sum_ / n) * (sum_ / n), 0.0);
+    const double std_dev = std::max(sqrt(variance),
+                                    static_cast<double>(MIN_STD_DEV_MS));
+
+    // The logistic approximation of the normal distribution's tail that Akka and
+    // Cassandra use; it's within 0.02% of the real thing.
+    const double y = (now_ms - last_arrival_ms_ - mean) / std_dev;
+    const double e = exp(-y * (1.5976 + 0.070566 * y * y));
+    if (now_ms - last_arrival_ms_ > mean) {
+        return -log10(e / (1.0 + e));
+    } else {
+        return -log10(1.0 - 1.0 / (1.0 + e));
+    }
+}
@@ -0,0 +1,53 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RPC_CONNECTIVITY_PHI_ACCRUAL_HPP_
+#define RPC_CONNECTIVITY_PHI_ACCRUAL_HPP_
+
+#include <stdint.h>
+
+#include <deque>
+
+#include "utils.hpp"
+
+/* A phi-accrual failure detector (Hayashibara et al.).  Instead of declaring a peer
+dead after a fixed time without hearing from it, it learns how far apart the
+arrivals from the peer usually are, and `phi(now)` says how unlikely it is that
+the peer is still alive but just hasn't been heard from yet: phi is -log10 of
+the probability that an arrival comes this late.  So a peer on a quiet, steady
+link is declared dead soon after it stops, and one on a jittery link is given
+more time.
+
+Times are in milliseconds. */
+class phi_accrual_detector_t {
+public:
+    // Until it has seen some arrivals, the detector assumes they're about
+    // `first_interval_ms` apart.  Arrivals may be up to `acceptable_pause_ms` later
+    // than usual (say, because of a pause on either side) before phi starts to grow.
+    phi_accrual_detector_t(int64_t now_ms, int64_t first_interval_ms,
+                           int64_t acceptable_pause_ms);
+
+    void arrival(int64_t now_ms);
+
+    double phi(int64_t now_ms) const;
+
+    int64_t last_arrival_ms() const { return last_arrival_ms_; }
+
+private:
+    // How many of the latest intervals the detector remembers.
+    static const size_t WINDOW_SIZE = 100;
+    // Links that are busy all the time have almost no spread in their intervals,
+    // which would make phi shoot up at the smallest delay.
+    static const int64_t MIN_STD_DEV_MS = 100;
+
+    void add_interval(int64_t interval_ms);
+
+    const int64_t acceptable_pause_ms_;
+    int64_t last_arrival_ms_;
+
+    // The last WINDOW_SIZE intervals between arrivals, and their sum
+    // and sum of squares.
+    std::deque<int64_t> intervals_;
+    double sum_;
+    double sum_of_squares_;
+};
+
+#endif  // RPC_CONNECTIVITY_PHI_ACCRUAL_HPP_
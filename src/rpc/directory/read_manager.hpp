@@ -15,6 +15,18 @@
 #include "rpc/connectivity/messages.hpp"
 #include "containers/incremental_lenses.hpp"
 
+/* `directory_reuse_unchanged(old_value, &new_value)` is called when a peer sends
+an update to its directory entry, before subscribers hear about it. It may make
+the parts of `new_value` that didn't change share memory with `old_value`, so
+that subscribers which only look at part of the directory (usually through an
+`incremental_map_lens_t`) can tell that their part is unchanged without a deep
+comparison. If it returns false, nothing changed and subscribers aren't told
+about the update at all. The default does nothing and returns true. */
+template<class metadata_t>
+bool directory_reuse_unchanged(UNUSED const metadata_t &old_value, UNUSED metadata_t *new_value) {
+    return true;
+}
+
 template<class metadata_t>
 class directory_read_manager_t :
     public home_thread_mixin_t,
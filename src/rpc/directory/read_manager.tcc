@@ -238,6 +238,9 @@ void directory_read_manager_t<metadata_t>::propagate_update(peer_id_t peer, uuid
                         //The session was deleted we can ignore this update.
                         return false;
                     }
+                    if (!directory_reuse_unchanged(var_it->second, _new_value.get())) {
+                        return false;
+                    }
                     map->begin_version();
                     map->set_value(_peer, std::move(*_new_value));
                     return true;
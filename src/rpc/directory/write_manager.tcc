@@ -105,13 +105,13 @@ private:
 template<class metadata_t>
 void directory_write_manager_t<metadata_t>::send_initialization(peer_id_t peer, const metadata_t &initial_value, fifo_enforcer_state_t metadata_fifo_state, auto_drainer_t::lock_t) THROWS_NOTHING {
     initialization_writer_t writer(initial_value, metadata_fifo_state);
-    message_service->send_message(peer, &writer);
+    message_service->send_message(peer, message_class_t::control, &writer);
 }
 
 template<class metadata_t>
 void directory_write_manager_t<metadata_t>::send_update(peer_id_t peer, const boost::shared_ptr<metadata_t> &new_value, fifo_enforcer_write_token_t metadata_fifo_token, auto_drainer_t::lock_t) THROWS_NOTHING {
     update_writer_t writer(*new_value, metadata_fifo_token);
-    message_service->send_message(peer, &writer);
+    message_service->send_message(peer, message_class_t::control, &writer);
 }
 
 #endif  // RPC_DIRECTORY_WRITE_MANAGER_TCC_
@@ -15,10 +15,12 @@
 const int raw_mailbox_t::address_t::ANY_THREAD = -1;
 
 raw_mailbox_t::address_t::address_t() :
-    peer(peer_id_t()), thread(ANY_THREAD), mailbox_id(0) { }
+    peer(peer_id_t()), thread(ANY_THREAD), mailbox_id(0),
+    message_class(message_class_t::query) { }
 
 raw_mailbox_t::address_t::address_t(const address_t &a) :
-    peer(a.peer), thread(a.thread), mailbox_id(a.mailbox_id) { }
+    peer(a.peer), thread(a.thread), mailbox_id(a.mailbox_id),
+    message_class(a.message_class) { }
 
 bool raw_mailbox_t::address_t::is_nil() const {
     return peer.is_nil();
@@ -33,10 +35,12 @@ std::string raw_mailbox_t::address_t::human_readable() const {
     return strprintf("%s:%d:%" PRIu64, uuid_to_str(peer.get_uuid()).c_str(), thread, mailbox_id);
 }
 
-raw_mailbox_t::raw_mailbox_t(mailbox_manager_t *m, mailbox_read_callback_t *_callback) :
+raw_mailbox_t::raw_mailbox_t(mailbox_manager_t *m, mailbox_read_callback_t *_callback,
+                             message_class_t _message_class) :
     manager(m),
     mailbox_id(manager->register_mailbox(this)),
-    callback(_callback) {
+    callback(_callback),
+    message_class(_message_class) {
     // Do nothing
 }
 
@@ -50,6 +54,7 @@ raw_mailbox_t::address_t raw_mailbox_t::get_address() const {
     a.peer = manager->get_connectivity_service()->get_me();
     a.thread = home_thread().threadnum;
     a.mailbox_id = mailbox_id;
+    a.message_class = message_class;
     return a;
 }
 
@@ -88,7 +93,7 @@ void send(mailbox_manager_t *src, raw_mailbox_t::address_t dest, mailbox_write_c
     guarantee(src);
     guarantee(!dest.is_nil());
     raw_mailbox_writer_t writer(dest.thread, dest.mailbox_id, callback);
-    src->message_service->send_message(dest.peer, &writer);
+    src->message_service->send_message(dest.peer, dest.message_class, &writer);
 }
 
 mailbox_manager_t::mailbox_manager_t(message_service_t *ms) :
@@ -45,6 +45,8 @@ private:
 
     mailbox_read_callback_t *callback;
 
+    const message_class_t message_class;
+
     auto_drainer_t drainer;
 
     DISABLE_COPYING(raw_mailbox_t);
@@ -74,7 +76,7 @@ public:
         friend struct raw_mailbox_t;
         friend class mailbox_manager_t;
 
-        RDB_MAKE_ME_SERIALIZABLE_3(peer, thread, mailbox_id);
+        RDB_MAKE_ME_SERIALIZABLE_4(peer, thread, mailbox_id, message_class);
 
         /* The peer on which the mailbox is located */
         peer_id_t peer;
@@ -85,9 +87,16 @@ public:
 
         /* The ID of the mailbox */
         id_t mailbox_id;
+
+        /* The class that messages to the mailbox are sent in */
+        message_class_t message_class;
     };
 
-    raw_mailbox_t(mailbox_manager_t *, mailbox_read_callback_t *callback);
+    /* Messages to the mailbox are sent in `message_class`. Only mailboxes that get
+    big messages whose order relative to other mailboxes' doesn't matter, like
+    backfill chunks, should use `message_class_t::bulk`. */
+    raw_mailbox_t(mailbox_manager_t *, mailbox_read_callback_t *callback,
+                  message_class_t message_class = message_class_t::query);
     ~raw_mailbox_t();
 
     address_t get_address() const;
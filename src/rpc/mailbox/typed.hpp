@@ -100,8 +100,9 @@ public:
     typedef mailbox_addr_t< void() > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void()> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void()> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -158,8 +159,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void(arg0_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void(arg0_t)> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -223,8 +225,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void(arg0_t, arg1_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void(arg0_t, arg1_t)> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -293,8 +296,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void(arg0_t, arg1_t, arg2_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void(arg0_t, arg1_t, arg2_t)> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -368,8 +372,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t)> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -448,8 +453,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t)> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -533,8 +539,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t)> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -623,8 +630,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t)> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -718,8 +726,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t)> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -818,8 +827,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t)> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -923,8 +933,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t)> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -1033,8 +1044,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t)> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -1148,8 +1160,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t)> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -1268,8 +1281,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t, arg12_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t, arg12_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t, arg12_t)> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -1393,8 +1407,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t, arg12_t, arg13_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t, arg12_t, arg13_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const boost::function< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t, arg12_t, arg13_t)> &f,
+              message_class_t message_class = message_class_t::query) :
+        reader(this), fun(f), mailbox(manager, &reader, message_class)
         { }
 
     address_t get_address() const {
@@ -10,6 +10,11 @@ void semilattice_join(cow_ptr_t<T> *a, const cow_ptr_t<T> &b) {
     semilattice_join(change.get(), *b);
 }
 
+template <class T>
+cow_ptr_t<T> semilattice_delta(const cow_ptr_t<T> &a, const cow_ptr_t<T> &b) {
+    return cow_ptr_t<T>(semilattice_delta(*a, *b));
+}
+
 template <class T>
 bool operator==(const cow_ptr_t<T> &a, const cow_ptr_t<T> &b) {
     return *a == *b;
@@ -3,24 +3,37 @@
 #define RPC_SEMILATTICE_JOINS_DELETABLE_HPP_
 
 #include "containers/archive/boost_types.hpp"
+#include "containers/counted.hpp"
 #include "rpc/serialize_macros.hpp"
 
 class printf_buffer_t;
 
 
+template <class T>
+class deletable_value_t : public slow_atomic_countable_t<deletable_value_t<T> > {
+public:
+    explicit deletable_value_t(const T &_value) : value(_value) { }
+    T value;
+};
+
 //a deletable wrapper allows a piece of metadata to be deleted (this makes up
 //for the fact that we don't have inverses in semilattices)
+
+/* Copies of a `deletable_t` share its value until one of them is changed with
+`get_mutable`, so copying a map of them (which is what happens to the cluster
+metadata on every change) copies pointers rather than every object in it, and
+joins and comparisons can skip the entries that are still shared. */
 template <class T>
 class deletable_t {
 public:
-    deletable_t() : t(T()) { }
-    explicit deletable_t(const T &_t) : t(_t) { }
+    deletable_t() : value(make_counted<deletable_value_t<T> >(T())) { }
+    explicit deletable_t(const T &_t) : value(make_counted<deletable_value_t<T> >(_t)) { }
 
     bool is_deleted() const {
-        return !t;
+        return !value.has();
     }
     void mark_deleted() {
-        t = boost::optional<T>();
+        value.reset();
     }
 
     /* return an object which when joined in will cause the object to be deleted */
@@ -33,22 +46,54 @@ public:
     /* Usage: [get_copy] returns a copy of the object, [get_ref] is for efficiency, and
        [get_mutable] is for when you need to modify something. */
     const T &get_ref() const {
-        guarantee(t);
-        return *t;
+        guarantee(value.has());
+        return value->value;
     }
     T get_copy() const {
-        guarantee(t);
-        return *t;
+        guarantee(value.has());
+        return value->value;
     }
     T *get_mutable() {
-        guarantee(t);
-        return &*t;
+        guarantee(value.has());
+        if (!value.unique()) {
+            value = make_counted<deletable_value_t<T> >(value->value);
+        }
+        return &value->value;
+    }
+
+    /* Whether `other` is a copy that neither of us has changed since. */
+    bool shares_value_with(const deletable_t &other) const {
+        return value.get() == other.value.get();
     }
 
     typedef T value_t;
     typedef T value_type;
-    boost::optional<T> t;
-    RDB_MAKE_ME_SERIALIZABLE_1(t)
+
+    // Serialized the way a `boost::optional<T>` is, which is what this used to hold.
+    friend class write_message_t;
+    void rdb_serialize(write_message_t &msg /* NOLINT */) const {
+        const bool exists = value.has();
+        msg << exists;
+        if (exists) {
+            msg << value->value;
+        }
+    }
+    friend class archive_deserializer_t;
+    archive_result_t rdb_deserialize(read_stream_t *s) {
+        bool exists;
+        archive_result_t res = deserialize(s, &exists);
+        if (res) { return res; }
+        if (!exists) {
+            value.reset();
+            return ARCHIVE_SUCCESS;
+        }
+        value = make_counted<deletable_value_t<T> >(T());
+        return deserialize(s, &value->value);
+    }
+
+private:
+    // Empty if the object has been deleted.
+    counted_t<deletable_value_t<T> > value;
 };
 
 template <class T>
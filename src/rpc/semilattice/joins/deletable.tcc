@@ -7,14 +7,17 @@
 //semilattice concept for deletable_t
 template <class T>
 bool operator==(const deletable_t<T> &a, const deletable_t<T> &b) {
-    return (a.is_deleted() && b.is_deleted())
+    return a.shares_value_with(b)
+        || (a.is_deleted() && b.is_deleted())
         || ((!a.is_deleted() && !b.is_deleted())
             && (a.get_ref() == b.get_ref()));
 }
 
 template <class T>
 void semilattice_join(deletable_t<T> *a, const deletable_t<T> &b) {
-    if (b.is_deleted()) {
+    if (a->shares_value_with(b)) {
+        return;
+    } else if (b.is_deleted()) {
         *a = b;
     } else if (a->is_deleted()) {
         return;
@@ -25,12 +25,32 @@ You can also use this with templated types, but it's pretty hacky:
     };
     template<class T>
     RDB_MAKE_SEMILATTICE_JOINABLE_2(pair_t<T>, a, b)
+
+`semilattice_delta(a, b)`, where `b` is `a` joined with something, returns a
+value that brings anything that already has `a` up to `b` when it's joined in.
+The `semilattice_manager_t` sends these instead of the whole metadata. By
+default it's just `b`; maps and `cow_ptr_t`s only keep what changed, and types
+made with `RDB_MAKE_SEMILATTICE_DELTA_[n]()` take the delta of each field, so
+you only need that macro on types that lead down to big maps. Their fields must
+be assignable and the type default-constructible.
 */
 
+template <class T>
+T semilattice_delta(UNUSED const T &a, const T &b) {
+    return b;
+}
+
 #define RDB_MAKE_SEMILATTICE_JOINABLE_0(type_t) \
     inline void semilattice_join(UNUSED type_t *_a_, UNUSED const type_t &_b_) { \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_0(type_t) \
+    inline type_t semilattice_delta(UNUSED const type_t &_a_, UNUSED const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_0(type_t) \
     inline bool operator==(UNUSED const type_t &_a_, UNUSED const type_t &_b_) { \
         return true; \
@@ -47,6 +67,14 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field1, _b_.field1); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_1(type_t, field1) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_1(type_t, field1) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1; \
@@ -64,6 +92,15 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field2, _b_.field2); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_2(type_t, field1, field2) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_2(type_t, field1, field2) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2; \
@@ -82,6 +119,16 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field3, _b_.field3); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_3(type_t, field1, field2, field3) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_3(type_t, field1, field2, field3) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3; \
@@ -101,6 +148,17 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field4, _b_.field4); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_4(type_t, field1, field2, field3, field4) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_4(type_t, field1, field2, field3, field4) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4; \
@@ -121,6 +179,18 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field5, _b_.field5); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_5(type_t, field1, field2, field3, field4, field5) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_5(type_t, field1, field2, field3, field4, field5) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5; \
@@ -142,6 +212,19 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field6, _b_.field6); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_6(type_t, field1, field2, field3, field4, field5, field6) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        _d_.field6 = semilattice_delta(_a_.field6, _b_.field6); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_6(type_t, field1, field2, field3, field4, field5, field6) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5 && _a_.field6 == _b_.field6; \
@@ -164,6 +247,20 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field7, _b_.field7); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_7(type_t, field1, field2, field3, field4, field5, field6, field7) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        _d_.field6 = semilattice_delta(_a_.field6, _b_.field6); \
+        _d_.field7 = semilattice_delta(_a_.field7, _b_.field7); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_7(type_t, field1, field2, field3, field4, field5, field6, field7) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5 && _a_.field6 == _b_.field6 && _a_.field7 == _b_.field7; \
@@ -187,6 +284,21 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field8, _b_.field8); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_8(type_t, field1, field2, field3, field4, field5, field6, field7, field8) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        _d_.field6 = semilattice_delta(_a_.field6, _b_.field6); \
+        _d_.field7 = semilattice_delta(_a_.field7, _b_.field7); \
+        _d_.field8 = semilattice_delta(_a_.field8, _b_.field8); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_8(type_t, field1, field2, field3, field4, field5, field6, field7, field8) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5 && _a_.field6 == _b_.field6 && _a_.field7 == _b_.field7 && _a_.field8 == _b_.field8; \
@@ -211,6 +323,22 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field9, _b_.field9); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_9(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        _d_.field6 = semilattice_delta(_a_.field6, _b_.field6); \
+        _d_.field7 = semilattice_delta(_a_.field7, _b_.field7); \
+        _d_.field8 = semilattice_delta(_a_.field8, _b_.field8); \
+        _d_.field9 = semilattice_delta(_a_.field9, _b_.field9); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_9(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5 && _a_.field6 == _b_.field6 && _a_.field7 == _b_.field7 && _a_.field8 == _b_.field8 && _a_.field9 == _b_.field9; \
@@ -236,6 +364,23 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field10, _b_.field10); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_10(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        _d_.field6 = semilattice_delta(_a_.field6, _b_.field6); \
+        _d_.field7 = semilattice_delta(_a_.field7, _b_.field7); \
+        _d_.field8 = semilattice_delta(_a_.field8, _b_.field8); \
+        _d_.field9 = semilattice_delta(_a_.field9, _b_.field9); \
+        _d_.field10 = semilattice_delta(_a_.field10, _b_.field10); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_10(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5 && _a_.field6 == _b_.field6 && _a_.field7 == _b_.field7 && _a_.field8 == _b_.field8 && _a_.field9 == _b_.field9 && _a_.field10 == _b_.field10; \
@@ -262,6 +407,24 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field11, _b_.field11); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_11(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        _d_.field6 = semilattice_delta(_a_.field6, _b_.field6); \
+        _d_.field7 = semilattice_delta(_a_.field7, _b_.field7); \
+        _d_.field8 = semilattice_delta(_a_.field8, _b_.field8); \
+        _d_.field9 = semilattice_delta(_a_.field9, _b_.field9); \
+        _d_.field10 = semilattice_delta(_a_.field10, _b_.field10); \
+        _d_.field11 = semilattice_delta(_a_.field11, _b_.field11); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_11(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5 && _a_.field6 == _b_.field6 && _a_.field7 == _b_.field7 && _a_.field8 == _b_.field8 && _a_.field9 == _b_.field9 && _a_.field10 == _b_.field10 && _a_.field11 == _b_.field11; \
@@ -289,6 +452,25 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field12, _b_.field12); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_12(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        _d_.field6 = semilattice_delta(_a_.field6, _b_.field6); \
+        _d_.field7 = semilattice_delta(_a_.field7, _b_.field7); \
+        _d_.field8 = semilattice_delta(_a_.field8, _b_.field8); \
+        _d_.field9 = semilattice_delta(_a_.field9, _b_.field9); \
+        _d_.field10 = semilattice_delta(_a_.field10, _b_.field10); \
+        _d_.field11 = semilattice_delta(_a_.field11, _b_.field11); \
+        _d_.field12 = semilattice_delta(_a_.field12, _b_.field12); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_12(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5 && _a_.field6 == _b_.field6 && _a_.field7 == _b_.field7 && _a_.field8 == _b_.field8 && _a_.field9 == _b_.field9 && _a_.field10 == _b_.field10 && _a_.field11 == _b_.field11 && _a_.field12 == _b_.field12; \
@@ -317,6 +499,26 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field13, _b_.field13); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_13(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12, field13) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        _d_.field6 = semilattice_delta(_a_.field6, _b_.field6); \
+        _d_.field7 = semilattice_delta(_a_.field7, _b_.field7); \
+        _d_.field8 = semilattice_delta(_a_.field8, _b_.field8); \
+        _d_.field9 = semilattice_delta(_a_.field9, _b_.field9); \
+        _d_.field10 = semilattice_delta(_a_.field10, _b_.field10); \
+        _d_.field11 = semilattice_delta(_a_.field11, _b_.field11); \
+        _d_.field12 = semilattice_delta(_a_.field12, _b_.field12); \
+        _d_.field13 = semilattice_delta(_a_.field13, _b_.field13); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_13(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12, field13) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5 && _a_.field6 == _b_.field6 && _a_.field7 == _b_.field7 && _a_.field8 == _b_.field8 && _a_.field9 == _b_.field9 && _a_.field10 == _b_.field10 && _a_.field11 == _b_.field11 && _a_.field12 == _b_.field12 && _a_.field13 == _b_.field13; \
@@ -346,6 +548,27 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field14, _b_.field14); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_14(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12, field13, field14) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        _d_.field6 = semilattice_delta(_a_.field6, _b_.field6); \
+        _d_.field7 = semilattice_delta(_a_.field7, _b_.field7); \
+        _d_.field8 = semilattice_delta(_a_.field8, _b_.field8); \
+        _d_.field9 = semilattice_delta(_a_.field9, _b_.field9); \
+        _d_.field10 = semilattice_delta(_a_.field10, _b_.field10); \
+        _d_.field11 = semilattice_delta(_a_.field11, _b_.field11); \
+        _d_.field12 = semilattice_delta(_a_.field12, _b_.field12); \
+        _d_.field13 = semilattice_delta(_a_.field13, _b_.field13); \
+        _d_.field14 = semilattice_delta(_a_.field14, _b_.field14); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_14(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12, field13, field14) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5 && _a_.field6 == _b_.field6 && _a_.field7 == _b_.field7 && _a_.field8 == _b_.field8 && _a_.field9 == _b_.field9 && _a_.field10 == _b_.field10 && _a_.field11 == _b_.field11 && _a_.field12 == _b_.field12 && _a_.field13 == _b_.field13 && _a_.field14 == _b_.field14; \
@@ -376,6 +599,28 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field15, _b_.field15); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_15(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12, field13, field14, field15) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        _d_.field6 = semilattice_delta(_a_.field6, _b_.field6); \
+        _d_.field7 = semilattice_delta(_a_.field7, _b_.field7); \
+        _d_.field8 = semilattice_delta(_a_.field8, _b_.field8); \
+        _d_.field9 = semilattice_delta(_a_.field9, _b_.field9); \
+        _d_.field10 = semilattice_delta(_a_.field10, _b_.field10); \
+        _d_.field11 = semilattice_delta(_a_.field11, _b_.field11); \
+        _d_.field12 = semilattice_delta(_a_.field12, _b_.field12); \
+        _d_.field13 = semilattice_delta(_a_.field13, _b_.field13); \
+        _d_.field14 = semilattice_delta(_a_.field14, _b_.field14); \
+        _d_.field15 = semilattice_delta(_a_.field15, _b_.field15); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_15(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12, field13, field14, field15) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5 && _a_.field6 == _b_.field6 && _a_.field7 == _b_.field7 && _a_.field8 == _b_.field8 && _a_.field9 == _b_.field9 && _a_.field10 == _b_.field10 && _a_.field11 == _b_.field11 && _a_.field12 == _b_.field12 && _a_.field13 == _b_.field13 && _a_.field14 == _b_.field14 && _a_.field15 == _b_.field15; \
@@ -407,6 +652,29 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field16, _b_.field16); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_16(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12, field13, field14, field15, field16) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        _d_.field6 = semilattice_delta(_a_.field6, _b_.field6); \
+        _d_.field7 = semilattice_delta(_a_.field7, _b_.field7); \
+        _d_.field8 = semilattice_delta(_a_.field8, _b_.field8); \
+        _d_.field9 = semilattice_delta(_a_.field9, _b_.field9); \
+        _d_.field10 = semilattice_delta(_a_.field10, _b_.field10); \
+        _d_.field11 = semilattice_delta(_a_.field11, _b_.field11); \
+        _d_.field12 = semilattice_delta(_a_.field12, _b_.field12); \
+        _d_.field13 = semilattice_delta(_a_.field13, _b_.field13); \
+        _d_.field14 = semilattice_delta(_a_.field14, _b_.field14); \
+        _d_.field15 = semilattice_delta(_a_.field15, _b_.field15); \
+        _d_.field16 = semilattice_delta(_a_.field16, _b_.field16); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_16(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12, field13, field14, field15, field16) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5 && _a_.field6 == _b_.field6 && _a_.field7 == _b_.field7 && _a_.field8 == _b_.field8 && _a_.field9 == _b_.field9 && _a_.field10 == _b_.field10 && _a_.field11 == _b_.field11 && _a_.field12 == _b_.field12 && _a_.field13 == _b_.field13 && _a_.field14 == _b_.field14 && _a_.field15 == _b_.field15 && _a_.field16 == _b_.field16; \
@@ -439,6 +707,30 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field17, _b_.field17); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_17(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12, field13, field14, field15, field16, field17) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        _d_.field6 = semilattice_delta(_a_.field6, _b_.field6); \
+        _d_.field7 = semilattice_delta(_a_.field7, _b_.field7); \
+        _d_.field8 = semilattice_delta(_a_.field8, _b_.field8); \
+        _d_.field9 = semilattice_delta(_a_.field9, _b_.field9); \
+        _d_.field10 = semilattice_delta(_a_.field10, _b_.field10); \
+        _d_.field11 = semilattice_delta(_a_.field11, _b_.field11); \
+        _d_.field12 = semilattice_delta(_a_.field12, _b_.field12); \
+        _d_.field13 = semilattice_delta(_a_.field13, _b_.field13); \
+        _d_.field14 = semilattice_delta(_a_.field14, _b_.field14); \
+        _d_.field15 = semilattice_delta(_a_.field15, _b_.field15); \
+        _d_.field16 = semilattice_delta(_a_.field16, _b_.field16); \
+        _d_.field17 = semilattice_delta(_a_.field17, _b_.field17); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_17(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12, field13, field14, field15, field16, field17) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5 && _a_.field6 == _b_.field6 && _a_.field7 == _b_.field7 && _a_.field8 == _b_.field8 && _a_.field9 == _b_.field9 && _a_.field10 == _b_.field10 && _a_.field11 == _b_.field11 && _a_.field12 == _b_.field12 && _a_.field13 == _b_.field13 && _a_.field14 == _b_.field14 && _a_.field15 == _b_.field15 && _a_.field16 == _b_.field16 && _a_.field17 == _b_.field17; \
@@ -472,6 +764,31 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field18, _b_.field18); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_18(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12, field13, field14, field15, field16, field17, field18) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        _d_.field6 = semilattice_delta(_a_.field6, _b_.field6); \
+        _d_.field7 = semilattice_delta(_a_.field7, _b_.field7); \
+        _d_.field8 = semilattice_delta(_a_.field8, _b_.field8); \
+        _d_.field9 = semilattice_delta(_a_.field9, _b_.field9); \
+        _d_.field10 = semilattice_delta(_a_.field10, _b_.field10); \
+        _d_.field11 = semilattice_delta(_a_.field11, _b_.field11); \
+        _d_.field12 = semilattice_delta(_a_.field12, _b_.field12); \
+        _d_.field13 = semilattice_delta(_a_.field13, _b_.field13); \
+        _d_.field14 = semilattice_delta(_a_.field14, _b_.field14); \
+        _d_.field15 = semilattice_delta(_a_.field15, _b_.field15); \
+        _d_.field16 = semilattice_delta(_a_.field16, _b_.field16); \
+        _d_.field17 = semilattice_delta(_a_.field17, _b_.field17); \
+        _d_.field18 = semilattice_delta(_a_.field18, _b_.field18); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_18(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12, field13, field14, field15, field16, field17, field18) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5 && _a_.field6 == _b_.field6 && _a_.field7 == _b_.field7 && _a_.field8 == _b_.field8 && _a_.field9 == _b_.field9 && _a_.field10 == _b_.field10 && _a_.field11 == _b_.field11 && _a_.field12 == _b_.field12 && _a_.field13 == _b_.field13 && _a_.field14 == _b_.field14 && _a_.field15 == _b_.field15 && _a_.field16 == _b_.field16 && _a_.field17 == _b_.field17 && _a_.field18 == _b_.field18; \
@@ -506,6 +823,32 @@ You can also use this with templated types, but it's pretty hacky:
         semilattice_join(&_a_->field19, _b_.field19); \
     } \
     extern int semilattice_joinable_force_semicolon_declaration
+#define RDB_MAKE_SEMILATTICE_DELTA_19(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12, field13, field14, field15, field16, field17, field18, field19) \
+    inline type_t semilattice_delta(const type_t &_a_, const type_t &_b_) { \
+        using ::semilattice_delta; \
+        type_t _d_; \
+        _d_.field1 = semilattice_delta(_a_.field1, _b_.field1); \
+        _d_.field2 = semilattice_delta(_a_.field2, _b_.field2); \
+        _d_.field3 = semilattice_delta(_a_.field3, _b_.field3); \
+        _d_.field4 = semilattice_delta(_a_.field4, _b_.field4); \
+        _d_.field5 = semilattice_delta(_a_.field5, _b_.field5); \
+        _d_.field6 = semilattice_delta(_a_.field6, _b_.field6); \
+        _d_.field7 = semilattice_delta(_a_.field7, _b_.field7); \
+        _d_.field8 = semilattice_delta(_a_.field8, _b_.field8); \
+        _d_.field9 = semilattice_delta(_a_.field9, _b_.field9); \
+        _d_.field10 = semilattice_delta(_a_.field10, _b_.field10); \
+        _d_.field11 = semilattice_delta(_a_.field11, _b_.field11); \
+        _d_.field12 = semilattice_delta(_a_.field12, _b_.field12); \
+        _d_.field13 = semilattice_delta(_a_.field13, _b_.field13); \
+        _d_.field14 = semilattice_delta(_a_.field14, _b_.field14); \
+        _d_.field15 = semilattice_delta(_a_.field15, _b_.field15); \
+        _d_.field16 = semilattice_delta(_a_.field16, _b_.field16); \
+        _d_.field17 = semilattice_delta(_a_.field17, _b_.field17); \
+        _d_.field18 = semilattice_delta(_a_.field18, _b_.field18); \
+        _d_.field19 = semilattice_delta(_a_.field19, _b_.field19); \
+        return _d_; \
+    } \
+    extern int semilattice_delta_force_semicolon_declaration
 #define RDB_MAKE_EQUALITY_COMPARABLE_19(type_t, field1, field2, field3, field4, field5, field6, field7, field8, field9, field10, field11, field12, field13, field14, field15, field16, field17, field18, field19) \
     inline bool operator==(const type_t &_a_, const type_t &_b_) { \
         return _a_.field1 == _b_.field1 && _a_.field2 == _b_.field2 && _a_.field3 == _b_.field3 && _a_.field4 == _b_.field4 && _a_.field5 == _b_.field5 && _a_.field6 == _b_.field6 && _a_.field7 == _b_.field7 && _a_.field8 == _b_.field8 && _a_.field9 == _b_.field9 && _a_.field10 == _b_.field10 && _a_.field11 == _b_.field11 && _a_.field12 == _b_.field12 && _a_.field13 == _b_.field13 && _a_.field14 == _b_.field14 && _a_.field15 == _b_.field15 && _a_.field16 == _b_.field16 && _a_.field17 == _b_.field17 && _a_.field18 == _b_.field18 && _a_.field19 == _b_.field19; \
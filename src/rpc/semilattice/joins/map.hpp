@@ -5,7 +5,8 @@
 #include <map>
 
 /* We join `std::map`s by taking their union and resolving conflicts by doing a
-semilattice join on the values. */
+semilattice join on the values. A delta between two maps is the entries that
+were added or changed; the values need an `==` operator. */
 
 namespace std {
 
@@ -21,6 +22,18 @@ void semilattice_join(std::map<key_t, value_t> *a, const std::map<key_t, value_t
     }
 }
 
+template<class key_t, class value_t>
+std::map<key_t, value_t> semilattice_delta(const std::map<key_t, value_t> &a, const std::map<key_t, value_t> &b) {
+    std::map<key_t, value_t> delta;
+    for (typename std::map<key_t, value_t>::const_iterator it = b.begin(); it != b.end(); it++) {
+        typename std::map<key_t, value_t>::const_iterator it2 = a.find(it->first);
+        if (it2 == a.end() || !(it2->second == it->second)) {
+            delta.insert(delta.end(), *it);
+        }
+    }
+    return delta;
+}
+
 }   /* namespace std */
 
 #endif /* RPC_SEMILATTICE_JOINS_MAP_HPP_ */
@@ -3,9 +3,11 @@
 #define RPC_SEMILATTICE_SEMILATTICE_MANAGER_HPP_
 
 #include <map>
+#include <set>
 #include <utility>
 
 #include "rpc/mailbox/mailbox.hpp"
+#include "rpc/semilattice/joins/macros.hpp"
 #include "rpc/semilattice/view.hpp"
 
 class cond_t;
@@ -29,6 +31,13 @@ constraints:
     such that `metadata_t` is a semilattice and `semilattice_join(a, b)` sets
     `*a` to the semilattice-join of `*a` and `b`.
 
+4. It may overload `semilattice_delta()` (see `rpc/semilattice/joins/macros.hpp`)
+    so that changes are sent to peers without the parts that didn't change.
+
+Each peer gets our whole metadata when it connects, and then only deltas. A
+delta names the version it was taken against; if a peer gets one against a
+version it hasn't seen from us, it asks us for the whole metadata again.
+
 Currently it's not thread-safe at all; all accesses to the metadata must be on
 the home thread of the `semilattice_manager_t`. */
 
@@ -57,6 +66,8 @@ private:
     };
 
     class metadata_writer_t;
+    class delta_writer_t;
+    class metadata_query_writer_t;
     class sync_from_query_writer_t;
     class sync_from_reply_writer_t;
     class sync_to_query_writer_t;
@@ -70,7 +81,11 @@ private:
 
     /* These are spawned in new coroutines. */
     void send_metadata_to_peer(peer_id_t, metadata_t, metadata_version_t, auto_drainer_t::lock_t);
+    void send_delta_to_peer(peer_id_t, metadata_t, metadata_version_t base_version, metadata_version_t, auto_drainer_t::lock_t);
+    void request_metadata_from_peer(peer_id_t, auto_drainer_t::lock_t);
     void deliver_metadata_on_home_thread(peer_id_t sender, metadata_t, metadata_version_t, auto_drainer_t::lock_t);
+    void deliver_delta_on_home_thread(peer_id_t sender, metadata_t, metadata_version_t base_version, metadata_version_t, auto_drainer_t::lock_t);
+    void deliver_metadata_query_on_home_thread(peer_id_t sender, auto_drainer_t::lock_t);
     void deliver_sync_from_query_on_home_thread(peer_id_t sender, sync_from_query_id_t query_id, auto_drainer_t::lock_t);
     void deliver_sync_from_reply_on_home_thread(peer_id_t sender, sync_from_query_id_t query_id, metadata_version_t version, auto_drainer_t::lock_t);
     void deliver_sync_to_query_on_home_thread(peer_id_t sender, sync_to_query_id_t query_id, metadata_version_t version, auto_drainer_t::lock_t);
@@ -78,6 +93,7 @@ private:
 
     static void call_function_with_no_args(const boost::function<void()> &);
     void join_metadata_locally(metadata_t);
+    void note_version_from_peer(peer_id_t peer, metadata_version_t version);
     void wait_for_version_from_peer(peer_id_t peer, metadata_version_t version, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, sync_failed_exc_t);
 
     message_service_t *const message_service;
@@ -92,6 +108,10 @@ private:
     std::multimap<std::pair<peer_id_t, metadata_version_t>, cond_t *> version_waiters;
     mutex_assertion_t peer_version_mutex;
 
+    /* Peers we've asked for their whole metadata after a gap in their deltas,
+    so we don't ask again for every delta until it arrives */
+    std::set<peer_id_t> metadata_queries_sent;
+
     sync_from_query_id_t next_sync_from_query_id;
     std::map<sync_from_query_id_t, promise_t<metadata_version_t> *> sync_from_waiters;
 
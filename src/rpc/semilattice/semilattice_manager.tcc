@@ -61,8 +61,13 @@ void semilattice_manager_t<metadata_t>::root_view_t::join(const metadata_t &adde
     parent->assert_thread();
 
     metadata_version_t new_version = ++parent->metadata_version;
+    metadata_t old_metadata = parent->metadata;
     parent->join_metadata_locally(added_metadata);
 
+    /* Peers that have seen `new_version - 1` already have everything in
+    `old_metadata` that came from us, so we only send them what changed. */
+    metadata_t delta = semilattice_delta(old_metadata, parent->metadata);
+
     /* Distribute changes to all peers we can currently see. If we can't
     currently see a peer, that's OK; it will hear about the metadata change when
     it reconnects, via the `semilattice_manager_t`'s `on_connect()` handler. */
@@ -71,14 +76,16 @@ void semilattice_manager_t<metadata_t>::root_view_t::join(const metadata_t &adde
     for (std::set<peer_id_t>::iterator it = peers.begin(); it != peers.end(); it++) {
         if (*it != parent->message_service->get_connectivity_service()->get_me()) {
             coro_t::spawn_sometime(boost::bind(
-                &semilattice_manager_t<metadata_t>::send_metadata_to_peer, parent,
-                *it, added_metadata, new_version,
+                &semilattice_manager_t<metadata_t>::send_delta_to_peer, parent,
+                *it, delta, new_version - 1, new_version,
                 auto_drainer_t::lock_t(parent->drainers.get())));
         }
     }
 }
 
 static const char message_code_metadata = 'M';
+static const char message_code_delta = 'D';
+static const char message_code_metadata_query = 'Q';
 static const char message_code_sync_from_query = 'F';
 static const char message_code_sync_from_reply = 'f';
 static const char message_code_sync_to_query = 'T';
@@ -104,6 +111,41 @@ private:
     metadata_version_t mdv;
 };
 
+template <class metadata_t>
+class semilattice_manager_t<metadata_t>::delta_writer_t : public send_message_write_callback_t {
+public:
+    delta_writer_t(const metadata_t &_delta, metadata_version_t _base_mdv, metadata_version_t _mdv) :
+        delta(_delta), base_mdv(_base_mdv), mdv(_mdv) { }
+
+    void write(write_stream_t *stream) {
+        write_message_t msg;
+        uint8_t code = message_code_delta;
+        msg << code;
+        msg << delta;
+        msg << base_mdv;
+        msg << mdv;
+        int res = send_write_message(stream, &msg);
+        if (res) { throw fake_archive_exc_t(); }
+    }
+private:
+    const metadata_t &delta;
+    metadata_version_t base_mdv, mdv;
+};
+
+template <class metadata_t>
+class semilattice_manager_t<metadata_t>::metadata_query_writer_t : public send_message_write_callback_t {
+public:
+    metadata_query_writer_t() { }
+
+    void write(write_stream_t *stream) {
+        write_message_t msg;
+        uint8_t code = message_code_metadata_query;
+        msg << code;
+        int res = send_write_message(stream, &msg);
+        if (res) { throw fake_archive_exc_t(); }
+    }
+};
+
 template <class metadata_t>
 class semilattice_manager_t<metadata_t>::sync_from_query_writer_t : public send_message_write_callback_t {
 public:
@@ -189,7 +231,7 @@ void semilattice_manager_t<metadata_t>::root_view_t::sync_from(peer_id_t peer, s
     map_insertion_sentry_t<sync_from_query_id_t, promise_t<metadata_version_t> *> response_listener(&parent->sync_from_waiters, query_id, &response_cond);
     disconnect_watcher_t watcher(parent->message_service->get_connectivity_service(), peer);
     sync_from_query_writer_t writer(query_id);
-    parent->message_service->send_message(peer, &writer);
+    parent->message_service->send_message(peer, message_class_t::control, &writer);
     wait_any_t waiter(response_cond.get_ready_signal(), &watcher);
     wait_interruptible(&waiter, interruptor);   /* May throw `interrupted_exc_t` */
     if (watcher.is_pulsed()) {
@@ -207,7 +249,7 @@ void semilattice_manager_t<metadata_t>::root_view_t::sync_to(peer_id_t peer, sig
     map_insertion_sentry_t<sync_to_query_id_t, cond_t *> response_listener(&parent->sync_to_waiters, query_id, &response_cond);
     disconnect_watcher_t watcher(parent->message_service->get_connectivity_service(), peer);
     sync_to_query_writer_t writer(query_id, parent->metadata_version);
-    parent->message_service->send_message(peer, &writer);
+    parent->message_service->send_message(peer, message_class_t::control, &writer);
     wait_any_t waiter(&response_cond, &watcher);
     wait_interruptible(&waiter, interruptor);   /* May throw `interrupted_exc_t` */
     if (watcher.is_pulsed()) {
@@ -246,6 +288,28 @@ void semilattice_manager_t<metadata_t>::on_message(peer_id_t sender, read_stream
                 sender, added_metadata, change_version, auto_drainer_t::lock_t(drainers.get())));
             break;
         }
+        case message_code_delta: {
+            metadata_t delta;
+            metadata_version_t base_version, change_version;
+            {
+                int res = deserialize(stream, &delta);
+                if (res) { throw fake_archive_exc_t(); }
+                res = deserialize(stream, &base_version);
+                if (res) { throw fake_archive_exc_t(); }
+                res = deserialize(stream, &change_version);
+                if (res) { throw fake_archive_exc_t(); }
+            }
+            coro_t::spawn_sometime(boost::bind(
+                &semilattice_manager_t<metadata_t>::deliver_delta_on_home_thread, this,
+                sender, delta, base_version, change_version, auto_drainer_t::lock_t(drainers.get())));
+            break;
+        }
+        case message_code_metadata_query: {
+            coro_t::spawn_sometime(boost::bind(
+                &semilattice_manager_t<metadata_t>::deliver_metadata_query_on_home_thread, this,
+                sender, auto_drainer_t::lock_t(drainers.get())));
+            break;
+        }
         case message_code_sync_from_query: {
             sync_from_query_id_t query_id;
             {
@@ -317,22 +381,66 @@ void semilattice_manager_t<metadata_t>::on_connect(peer_id_t peer) {
 }
 
 template<class metadata_t>
-void semilattice_manager_t<metadata_t>::on_disconnect(peer_id_t) {
+void semilattice_manager_t<metadata_t>::on_disconnect(peer_id_t peer) {
     assert_thread();
 
-    /* ignore */
+    /* The peer sends us its whole metadata again if it reconnects */
+    metadata_queries_sent.erase(peer);
 }
 
 template<class metadata_t>
 void semilattice_manager_t<metadata_t>::send_metadata_to_peer(peer_id_t peer, metadata_t m, metadata_version_t mv, auto_drainer_t::lock_t) {
     metadata_writer_t writer(m, mv);
-    message_service->send_message(peer, &writer);
+    message_service->send_message(peer, message_class_t::control, &writer);
+}
+
+template<class metadata_t>
+void semilattice_manager_t<metadata_t>::send_delta_to_peer(peer_id_t peer, metadata_t delta, metadata_version_t base_mv, metadata_version_t mv, auto_drainer_t::lock_t) {
+    delta_writer_t writer(delta, base_mv, mv);
+    message_service->send_message(peer, message_class_t::control, &writer);
+}
+
+template<class metadata_t>
+void semilattice_manager_t<metadata_t>::request_metadata_from_peer(peer_id_t peer, auto_drainer_t::lock_t) {
+    metadata_query_writer_t writer;
+    message_service->send_message(peer, message_class_t::control, &writer);
 }
 
 template<class metadata_t>
 void semilattice_manager_t<metadata_t>::deliver_metadata_on_home_thread(peer_id_t sender, metadata_t md, metadata_version_t mv, auto_drainer_t::lock_t) {
     on_thread_t thread_switcher(home_thread());
     join_metadata_locally(md);
+    metadata_queries_sent.erase(sender);
+    note_version_from_peer(sender, mv);
+}
+
+template<class metadata_t>
+void semilattice_manager_t<metadata_t>::deliver_delta_on_home_thread(peer_id_t sender, metadata_t delta, metadata_version_t base_mv, metadata_version_t mv, auto_drainer_t::lock_t keepalive) {
+    on_thread_t thread_switcher(home_thread());
+    /* Joining in a delta never hurts, even if we can't count on it to bring us
+    all the way up to `mv` */
+    join_metadata_locally(delta);
+    typename std::map<peer_id_t, metadata_version_t>::iterator it = last_versions_seen.find(sender);
+    if (it != last_versions_seen.end() && it->second >= base_mv) {
+        note_version_from_peer(sender, mv);
+    } else if (metadata_queries_sent.insert(sender).second) {
+        /* We missed a change that the delta was taken against, so we need
+        the sender's whole metadata to catch up */
+        coro_t::spawn_sometime(boost::bind(
+            &semilattice_manager_t<metadata_t>::request_metadata_from_peer, this,
+            sender, keepalive));
+    }
+}
+
+template<class metadata_t>
+void semilattice_manager_t<metadata_t>::deliver_metadata_query_on_home_thread(peer_id_t sender, auto_drainer_t::lock_t keepalive) {
+    on_thread_t thread_switcher(home_thread());
+    send_metadata_to_peer(sender, metadata, metadata_version, keepalive);
+}
+
+template<class metadata_t>
+void semilattice_manager_t<metadata_t>::note_version_from_peer(peer_id_t sender, metadata_version_t mv) {
+    assert_thread();
     DEBUG_VAR mutex_assertion_t::acq_t acq(&peer_version_mutex);
     std::pair<typename std::map<peer_id_t, metadata_version_t>::iterator, bool> inserted =
         last_versions_seen.insert(std::make_pair(sender, mv));
@@ -351,7 +459,7 @@ template<class metadata_t>
 void semilattice_manager_t<metadata_t>::deliver_sync_from_query_on_home_thread(peer_id_t sender, sync_from_query_id_t query_id, auto_drainer_t::lock_t) {
     on_thread_t thread_switcher(home_thread());
     sync_from_reply_writer_t writer(query_id, metadata_version);
-    message_service->send_message(sender, &writer);
+    message_service->send_message(sender, message_class_t::control, &writer);
 }
 
 template<class metadata_t>
@@ -379,7 +487,7 @@ void semilattice_manager_t<metadata_t>::deliver_sync_to_query_on_home_thread(pee
         return;
     }
     sync_to_reply_writer_t writer(query_id);
-    message_service->send_message(sender, &writer);
+    message_service->send_message(sender, message_class_t::control, &writer);
 }
 
 template<class metadata_t>
@@ -0,0 +1,62 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/block_compression.hpp"
+
+#include <inttypes.h>
+#include <zlib.h>
+
+#include "config/args.hpp"
+#include "utils.hpp"
+
+uint32_t compress_block(const ser_buffer_t *buf, block_size_t block_size,
+                        ser_buffer_t *out) {
+    const size_t overhead = sizeof(ls_buf_data_t) + sizeof(compressed_block_header_t);
+    // Blocks get padded to DEVICE_BLOCK_SIZE on disk, so the compressed block has to
+    // fit into fewer device blocks than the uncompressed one to be of any use.
+    const size_t aligned_size = ceil_aligned(block_size.ser_value(), DEVICE_BLOCK_SIZE);
+    if (aligned_size <= DEVICE_BLOCK_SIZE
+        || aligned_size - DEVICE_BLOCK_SIZE <= overhead) {
+        return 0;
+    }
+    uLongf compressed_size = aligned_size - DEVICE_BLOCK_SIZE - overhead;
+
+    compressed_block_header_t *header
+        = reinterpret_cast<compressed_block_header_t *>(out->cache_data);
+    Bytef *dest = reinterpret_cast<Bytef *>(header + 1);
+    int res = compress2(dest, &compressed_size,
+                        reinterpret_cast<const Bytef *>(buf->cache_data),
+                        block_size.value(), Z_BEST_SPEED);
+    if (res == Z_BUF_ERROR) {
+        return 0;
+    }
+    guarantee(res == Z_OK, "compress2 failed with error %d", res);
+
+    out->ser_header = buf->ser_header;
+    header->magic = COMPRESSED_BLOCK_MAGIC;
+    header->compressed_size = compressed_size;
+    return overhead + compressed_size;
+}
+
+void decompress_block(const ser_buffer_t *compressed,
+                      uint32_t compressed_ser_block_size,
+                      block_size_t block_size,
+                      ser_buffer_t *out) {
+    guarantee(compressed_ser_block_size
+              >= sizeof(ls_buf_data_t) + sizeof(compressed_block_header_t));
+    const compressed_block_header_t *header
+        = reinterpret_cast<const compressed_block_header_t *>(compressed->cache_data);
+    guarantee(header->magic == COMPRESSED_BLOCK_MAGIC,
+              "Corrupted compressed block (bad magic %" PRIu32 ")", header->magic);
+    guarantee(header->compressed_size <= compressed_ser_block_size
+              - sizeof(ls_buf_data_t) - sizeof(compressed_block_header_t));
+
+    uLongf size = block_size.value();
+    int res = uncompress(reinterpret_cast<Bytef *>(out->cache_data), &size,
+                         reinterpret_cast<const Bytef *>(header + 1),
+                         header->compressed_size);
+    guarantee(res == Z_OK, "Corrupted compressed block (uncompress failed with "
+              "error %d)", res);
+    guarantee(size == block_size.value(),
+              "Corrupted compressed block (inflated to %lu bytes, expected %" PRIu32 ")",
+              size, block_size.value());
+    out->ser_header = compressed->ser_header;
+}
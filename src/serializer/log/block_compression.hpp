@@ -0,0 +1,43 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_BLOCK_COMPRESSION_HPP_
+#define SERIALIZER_LOG_BLOCK_COMPRESSION_HPP_
+
+#include "serializer/types.hpp"
+
+/* When log_serializer_dynamic_config_t::compress_blocks is set, the log serializer
+deflates the cache data of each block it writes, and stores the result instead of the
+block if that takes up fewer device blocks on disk.  Since the serializer only ever
+writes blocks of its configured block size, a block whose ser_block_size in the LBA is
+smaller than that is a compressed block, laid out like this:
+
+    ls_buf_data_t           (as for any other block)
+    compressed_block_header_t
+    the deflated cache data
+
+Reading a compressed block inflates it back into a buffer of the configured block
+size, so nothing above the serializer ever sees a compressed block. */
+
+struct compressed_block_header_t {
+    // COMPRESSED_BLOCK_MAGIC, to catch blocks that were mistaken for compressed ones.
+    uint32_t magic;
+    uint32_t compressed_size;
+} __attribute__((__packed__));
+
+static const uint32_t COMPRESSED_BLOCK_MAGIC = 0x7a62646c;  // "ldbz"
+
+/* Compresses the cache data of `buf`, which is a block of size `block_size`, into
+`out`, which has to have room for a block of that size.  Returns the ser_block_size of
+the compressed block, or 0 (leaving `out` undefined) if compressing doesn't save any
+space on disk. */
+uint32_t compress_block(const ser_buffer_t *buf, block_size_t block_size,
+                        ser_buffer_t *out);
+
+/* Inflates the compressed block `compressed`, whose ser_block_size is
+`compressed_ser_block_size`, into `out`, which receives a block of size
+`block_size`. */
+void decompress_block(const ser_buffer_t *compressed,
+                      uint32_t compressed_ser_block_size,
+                      block_size_t block_size,
+                      ser_buffer_t *out);
+
+#endif  // SERIALIZER_LOG_BLOCK_COMPRESSION_HPP_
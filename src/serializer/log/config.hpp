@@ -15,7 +15,10 @@ struct log_serializer_dynamic_config_t {
         gc_low_ratio = DEFAULT_GC_LOW_RATIO;
         gc_high_ratio = DEFAULT_GC_HIGH_RATIO;
         read_ahead = true;
+        compress_blocks = false;
         io_batch_factor = DEFAULT_IO_BATCH_FACTOR;
+        discard_freed_extents = true;
+        separate_value_blocks = true;
     }
 
     /* When the proportion of garbage blocks hits gc_high_ratio, then the serializer will collect
@@ -27,10 +30,27 @@ struct log_serializer_dynamic_config_t {
     i/o priority of the account. */
     int32_t io_batch_factor;
 
-    /* Enable reading more data than requested to let the cache warmup more quickly esp. on rotational drives */
+    /* Enable reading more data than requested to let the cache warmup more quickly esp. on rotational drives.
+    How much more is adjusted at runtime, see read_ahead_window_t. */
     bool read_ahead;
 
-    RDB_MAKE_ME_SERIALIZABLE_4(gc_low_ratio, gc_high_ratio, io_batch_factor, read_ahead);
+    /* Store blocks deflated on disk when that saves space, see block_compression.hpp.
+    Compressed blocks can be read regardless of this setting. */
+    bool compress_blocks;
+
+    /* Tell the file system (and so an SSD) when an extent in the middle of the file
+    is freed, instead of leaving the dead data for the device to copy around. */
+    bool discard_freed_extents;
+
+    /* Write the blocks of large values (see LS_BUF_VALUE_BLOCK) to extents of their
+    own, a value log next to the btree's nodes, and keep them apart when the GC moves
+    them too.  Then the extents of btree nodes stay small and hot, and collecting them
+    doesn't copy large values around. */
+    bool separate_value_blocks;
+
+    RDB_MAKE_ME_SERIALIZABLE_7(gc_low_ratio, gc_high_ratio, io_batch_factor, read_ahead,
+                               compress_blocks, discard_freed_extents,
+                               separate_value_blocks);
 };
 
 /* This is equivalent to log_serializer_static_config_t below, but is an on-disk
@@ -8,14 +8,60 @@
 #include <boost/bind.hpp>
 
 #include "arch/arch.hpp"
+#include "arch/crc32c.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "concurrency/mutex.hpp"
 #include "perfmon/perfmon.hpp"
+#include "serializer/log/block_compression.hpp"
 #include "serializer/log/log_serializer.hpp"
 #include "stl_utils.hpp"
 
-// Max amount of bytes which can be read ahead in one i/o transaction (if enabled)
-const int64_t APPROXIMATE_READ_AHEAD_SIZE = 32 * DEFAULT_BTREE_BLOCK_SIZE;
+// The amount of bytes which are read ahead in one i/o transaction when the serializer
+// starts up, and the bounds that read_ahead_window_t keeps it in.
+const int64_t MIN_READ_AHEAD_SIZE = 4 * DEFAULT_BTREE_BLOCK_SIZE;
+const int64_t INITIAL_READ_AHEAD_SIZE = 32 * DEFAULT_BTREE_BLOCK_SIZE;
+const int64_t MAX_READ_AHEAD_SIZE = 256 * DEFAULT_BTREE_BLOCK_SIZE;
+
+// How many read-ahead blocks read_ahead_window_t looks at before adjusting the window.
+const int64_t READ_AHEAD_ADJUSTMENT_SAMPLE = 256;
+
+// The checksum that belongs in the header of `buf`, a block whose ser_block_size is
+// `ser_block_size` (see `ls_buf_data_t::checksum`).
+uint32_t block_checksum(const ser_buffer_t *buf, uint32_t ser_block_size) {
+    const char *block = reinterpret_cast<const char *>(buf);
+    const size_t checksum_offset = offsetof(ls_buf_data_t, checksum);
+    const size_t rest_offset = checksum_offset + sizeof(buf->ser_header.checksum);
+    guarantee(ser_block_size >= rest_offset);
+    const uint32_t crc = crc32c(0, block, checksum_offset);
+    return crc32c(crc, block + rest_offset, ser_block_size - rest_offset);
+}
+
+bool block_checksum_ok(const ser_buffer_t *buf, uint32_t ser_block_size) {
+    return buf->ser_header.checksum == block_checksum(buf, ser_block_size);
+}
+
+void guarantee_block_checksum(const ser_buffer_t *buf, uint32_t ser_block_size,
+                              int64_t offset) {
+    guarantee(block_checksum_ok(buf, ser_block_size),
+              "The block at offset %" PRIi64 " of the data file is corrupted (its "
+              "checksum doesn't match its contents).", offset);
+}
+
+void unchecksummed_block_to_buffer(ser_buffer_t *buf) {
+    block_id_t block_id;
+    memcpy(&block_id, reinterpret_cast<char *>(buf) + LS_UNCHECKSUMMED_HEADER_SHORTFALL,
+           sizeof(block_id));
+    buf->ser_header.block_id = block_id;
+    buf->ser_header.checksum = 0;
+    buf->ser_header.flags = 0;
+}
+
+void buffer_to_unchecksummed_block(const ser_buffer_t *buf, block_size_t block_size,
+                                   ser_buffer_t *out) {
+    char *const block = reinterpret_cast<char *>(out);
+    memcpy(block, &buf->ser_header.block_id, sizeof(block_id_t));
+    memcpy(block + sizeof(block_id_t), buf->cache_data, block_size.value());
+}
 
 // Identifies an extent, the time we started writing to the
 // extent, whether it's the extent we're currently writing to, and
@@ -27,6 +73,9 @@ private:
         block_size_t block_size;
         bool token_referenced;
         bool index_referenced;
+        // True if the block was handed out by a read-ahead and hasn't been read
+        // since.
+        bool read_ahead;
     };
 
 public:
@@ -135,7 +184,7 @@ public:
         } else {
             *relative_offset_out = offset;
             *block_index_out = block_infos.size();
-            block_infos.push_back(block_info_t{offset, block_size, false, false});
+            block_infos.push_back(block_info_t{offset, block_size, false, false, false});
             update_stats(NULL, &block_infos.back());
             return true;
         }
@@ -209,11 +258,11 @@ public:
 
         auto it = find_lower_bound_iter(relative_offset);
         if (it == block_infos.end()) {
-            block_infos.push_back(block_info_t{relative_offset, block_size, false, true});
+            block_infos.push_back(block_info_t{relative_offset, block_size, false, true, false});
             update_stats(NULL, &block_infos.back());
         } else if (it->relative_offset > relative_offset) {
             guarantee(it->relative_offset >= relative_offset + aligned_value(block_size));
-            auto new_block = block_infos.insert(it, block_info_t{relative_offset, block_size, false, true});
+            auto new_block = block_infos.insert(it, block_info_t{relative_offset, block_size, false, true, false});
             update_stats(NULL, &*new_block);
         } else {
             guarantee(it->relative_offset == relative_offset);
@@ -224,6 +273,32 @@ public:
         }
     }
 
+    void mark_read_ahead(int64_t offset) {
+        guarantee(state != state_reconstructing);
+        guarantee(offset >= extent_ref.offset() && offset < extent_ref.offset() + UINT32_MAX);
+
+        auto it = find_lower_bound_iter(offset - extent_ref.offset());
+        guarantee(it != block_infos.end()
+                  && it->relative_offset == offset - extent_ref.offset());
+        it->read_ahead = true;
+    }
+
+    // Returns whether the block at the given offset was marked by mark_read_ahead,
+    // and clears the mark.
+    bool take_read_ahead_mark(int64_t offset) {
+        guarantee(state != state_reconstructing);
+        guarantee(offset >= extent_ref.offset() && offset < extent_ref.offset() + UINT32_MAX);
+        const uint32_t relative_offset = offset - extent_ref.offset();
+
+        auto it = find_lower_bound_iter(relative_offset);
+        if (it == block_infos.end() || it->relative_offset != relative_offset
+            || !it->read_ahead) {
+            return false;
+        }
+        it->read_ahead = false;
+        return true;
+    }
+
     void mark_garbage_indexwise(unsigned int block_index) {
         guarantee(state != state_reconstructing);
         guarantee(block_infos[block_index].index_referenced);
@@ -325,6 +400,19 @@ private:
     data_block_manager_t *const parent;
 
 public:
+    // The cost-benefit ratio of GCing the extent: the garbage it frees up, per byte
+    // of live data read and rewritten, weighted by how long the extent has gone
+    // without being GCed.  Data that has stayed alive for long is likely to stay
+    // alive, so it's worth compacting an old extent even if it has less garbage than
+    // a young one whose garbage is still growing.
+    double gc_benefit() const {
+        const double live_fraction
+            = 1.0 - static_cast<double>(garbage_bytes()) / parent->static_config->extent_size();
+        const microtime_t now = parent->gc_priority_time;
+        const double age = now > timestamp ? now - timestamp : 0;
+        return (1.0 - live_fraction) * (age + 1) / (1.0 + live_fraction);
+    }
+
     extent_reference_t extent_ref;
 
     // When we started writing to the extent (this time).
@@ -340,7 +428,7 @@ public:
         // It has been, or is being, reconstructed from data on disk.
         state_reconstructing,
         // We are currently putting things on this extent. It is equal to
-        // last_data_extent.
+        // one of active_extents.
         state_active,
         // Not active, but not a GC candidate yet. It is in young_extent_queue.
         state_young,
@@ -379,9 +467,16 @@ private:
 // Later, rewrite this so that we have a special interface through which to order
 // garbage collection.
 
-data_block_manager_t::data_block_manager_t(const log_serializer_dynamic_config_t *_dynamic_config, extent_manager_t *em, log_serializer_t *_serializer, const log_serializer_on_disk_static_config_t *_static_config, log_serializer_stats_t *_stats)
+data_block_manager_t::data_block_manager_t(const log_serializer_dynamic_config_t *_dynamic_config, extent_manager_t *em, log_serializer_t *_serializer, const log_serializer_on_disk_static_config_t *_static_config, bool _unchecksummed_blocks, log_serializer_stats_t *_stats)
     : stats(_stats), shutdown_callback(NULL), state(state_unstarted), dynamic_config(_dynamic_config),
-      static_config(_static_config), extent_manager(em), serializer(_serializer),
+      static_config(_static_config), unchecksummed_blocks(_unchecksummed_blocks),
+      extent_manager(em), serializer(_serializer),
+      next_write_stream(0),
+      gc_priority_time(current_microtime()),
+      gc_write_credit(GC_NICE_MAX_WRITE_CREDIT), last_foreground_write_time(0),
+      gc_throttle_timer(NULL),
+      read_ahead_window(MIN_READ_AHEAD_SIZE, INITIAL_READ_AHEAD_SIZE,
+                        MAX_READ_AHEAD_SIZE),
       gc_state(), gc_stats(stats)
 {
     rassert(dynamic_config != NULL);
@@ -446,16 +541,19 @@ void data_block_manager_t::start_existing(file_t *file,
             reconstructed_extents.push_back(e);
         }
 
-        active_extent = entries.get(offset / extent_manager->extent_size);
-        guarantee(active_extent != NULL);
+        active_extents[0] = entries.get(offset / extent_manager->extent_size);
+        guarantee(active_extents[0] != NULL);
 
         /* Turn the extent from a reconstructing extent into an active extent */
-        guarantee(active_extent->state == gc_entry_t::state_reconstructing);
-        reconstructed_extents.remove(active_extent);
+        guarantee(active_extents[0]->state == gc_entry_t::state_reconstructing);
+        reconstructed_extents.remove(active_extents[0]);
 
-        active_extent->make_active();
+        active_extents[0]->make_active();
     } else {
-        active_extent = NULL;
+        active_extents[0] = NULL;
+    }
+    for (int i = 1; i < NUM_WRITE_STREAMS; ++i) {
+        active_extents[i] = NULL;
     }
 
     /* Convert any extents that we found live blocks in, but that are not active
@@ -549,12 +647,13 @@ void read_ahead_interval(const int64_t block_offset,
 void read_ahead_offset_and_size(int64_t off_in,
                                 int64_t ser_block_size_in,
                                 int64_t extent_size,
+                                int64_t read_ahead_size,
                                 const std::vector<uint32_t> &boundaries,
                                 int64_t *offset_out, int64_t *size_out) {
     int64_t offset;
     int64_t end_offset;
     read_ahead_interval(off_in, ser_block_size_in, extent_size,
-                        APPROXIMATE_READ_AHEAD_SIZE,
+                        read_ahead_size,
                         DEVICE_BLOCK_SIZE,
                         boundaries,
                         &offset,
@@ -564,6 +663,43 @@ void read_ahead_offset_and_size(int64_t off_in,
     *size_out = end_offset - offset;
 }
 
+read_ahead_window_t::read_ahead_window_t(int64_t min_size, int64_t initial_size,
+                                         int64_t max_size)
+    : min_size_(min_size), max_size_(max_size), size_(initial_size),
+      blocks_read_ahead_(0), blocks_wasted_(0) {
+    guarantee(0 < min_size && min_size <= initial_size && initial_size <= max_size);
+}
+
+void read_ahead_window_t::note_blocks_read_ahead(int64_t count) {
+    blocks_read_ahead_ += count;
+    maybe_adjust();
+}
+
+void read_ahead_window_t::note_block_wasted() {
+    ++blocks_wasted_;
+    maybe_adjust();
+}
+
+void read_ahead_window_t::maybe_adjust() {
+    if (size_ == 0 || blocks_read_ahead_ < READ_AHEAD_ADJUSTMENT_SAMPLE) {
+        return;
+    }
+
+    if (blocks_wasted_ * 2 >= blocks_read_ahead_) {
+        // At least half the blocks were read again, so most of the read-ahead went
+        // to waste.
+        size_ /= 2;
+        if (size_ < min_size_) {
+            size_ = 0;
+        }
+    } else if (blocks_wasted_ * 8 <= blocks_read_ahead_) {
+        size_ = std::min(size_ * 2, max_size_);
+    }
+
+    blocks_read_ahead_ = 0;
+    blocks_wasted_ = 0;
+}
+
 class dbm_read_ahead_t {
 public:
     static std::vector<uint32_t> get_boundaries(data_block_manager_t *parent,
@@ -589,6 +725,7 @@ public:
         read_ahead_offset_and_size(off_in,
                                    ser_block_size_in,
                                    parent->static_config->extent_size(),
+                                   parent->read_ahead_window.size(),
                                    boundaries,
                                    &read_ahead_offset,
                                    &read_ahead_size);
@@ -613,6 +750,7 @@ public:
                                                relative_end_offset) - 1;
 
         bool handled_required_block = false;
+        int64_t blocks_read_ahead = 0;
 
         for (; lower_it < upper_it; ++lower_it) {
             const char *current_buf
@@ -639,9 +777,36 @@ public:
                     continue;
                 }
 
-                scoped_malloc_t<ser_buffer_t> data = parent->serializer->malloc();
-                memcpy(data.get(), current_buf, info.ser_block_size);
                 guarantee(info.ser_block_size <= *(lower_it + 1) - *lower_it);
+                if (!parent->unchecksummed_blocks
+                    && !block_checksum_ok(reinterpret_cast<const ser_buffer_t *>(current_buf),
+                                          info.ser_block_size)) {
+                    // Reading the block for real will report it.
+                    continue;
+                }
+
+                // The block in the layout it has in memory.
+                const ser_buffer_t *block
+                    = reinterpret_cast<const ser_buffer_t *>(current_buf);
+                uint32_t ser_block_size = info.ser_block_size;
+                scoped_arena_ptr_t<ser_buffer_t> unchecksummed;
+                if (parent->unchecksummed_blocks) {
+                    unchecksummed = parent->serializer->malloc();
+                    memcpy(reinterpret_cast<char *>(unchecksummed.get())
+                           + LS_UNCHECKSUMMED_HEADER_SHORTFALL,
+                           current_buf, info.ser_block_size);
+                    unchecksummed_block_to_buffer(unchecksummed.get());
+                    block = unchecksummed.get();
+                    ser_block_size += LS_UNCHECKSUMMED_HEADER_SHORTFALL;
+                }
+
+                scoped_arena_ptr_t<ser_buffer_t> data = parent->serializer->malloc();
+                const block_size_t block_size = parent->serializer->max_block_size();
+                if (info.ser_block_size < parent->static_config->block_size().ser_value()) {
+                    decompress_block(block, ser_block_size, block_size, data.get());
+                } else {
+                    memcpy(data.get(), block, ser_block_size);
+                }
 
                 counted_t<ls_block_token_pointee_t> ls_token
                     = parent->serializer->generate_block_token(current_offset,
@@ -650,6 +815,12 @@ public:
                 counted_t<standard_block_token_t> token
                     = to_standard_block_token(block_id, ls_token);
 
+                // The extent can't have been collected during the read, since the
+                // block is still live.
+                parent->entries.get(parent->static_config->extent_index(current_offset))
+                    ->mark_read_ahead(current_offset);
+                ++blocks_read_ahead;
+
                 parent->serializer->offer_buf_to_read_ahead_callbacks(
                         block_id,
                         std::move(data),
@@ -658,6 +829,7 @@ public:
         }
 
         guarantee(handled_required_block);
+        parent->read_ahead_window.note_blocks_read_ahead(blocks_read_ahead);
     }
 };
 
@@ -670,12 +842,22 @@ bool data_block_manager_t::should_perform_read_ahead(int64_t offset) {
     // If the extent was written, we don't perform read ahead because it would
     // a) be potentially useless and b) has an elevated risk of conflicting with
     // active writes on the io queue.
-    return !entry->was_written && serializer->should_perform_read_ahead();
+    return !entry->was_written && read_ahead_window.size() > 0
+        && serializer->should_perform_read_ahead();
+}
+
+void data_block_manager_t::note_block_read(int64_t offset) {
+    gc_entry_t *entry = entries.get(static_config->extent_index(offset));
+    guarantee(entry != NULL);
+    if (entry->take_read_ahead_mark(offset)) {
+        read_ahead_window.note_block_wasted();
+    }
 }
 
 void data_block_manager_t::read(int64_t off_in, uint32_t ser_block_size_in,
                                 void *buf_out, file_account_t *io_account) {
     guarantee(state == state_ready);
+    note_block_read(off_in);
     if (should_perform_read_ahead(off_in)) {
         dbm_read_ahead_t::perform_read_ahead(this, off_in, ser_block_size_in,
                                              buf_out, io_account);
@@ -696,12 +878,44 @@ void data_block_manager_t::read(int64_t off_in, uint32_t ser_block_size_in,
             memcpy(buf_out, buf.get() + (off_in - floor_off_in), ser_block_size_in);
         }
     }
+    if (!unchecksummed_blocks) {
+        guarantee_block_checksum(static_cast<const ser_buffer_t *>(buf_out),
+                                 ser_block_size_in, off_in);
+    }
 }
 
 std::vector<counted_t<ls_block_token_pointee_t> >
 data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
                                   file_account_t *io_account,
                                   iocallback_t *cb) {
+    int64_t bytes = 0;
+    for (auto it = writes.begin(); it != writes.end(); ++it) {
+        bytes += gc_entry_t::aligned_value(it->block_size);
+    }
+    gc_write_credit = std::min<int64_t>(
+        gc_write_credit
+        + static_cast<int64_t>(bytes * GC_NICE_BYTES_PER_FOREGROUND_BYTE),
+        GC_NICE_MAX_WRITE_CREDIT);
+    last_foreground_write_time = current_microtime();
+
+    return write_blocks_apart(writes, choose_write_stream(io_account),
+                              VALUE_WRITE_STREAM, io_account, cb);
+}
+
+int data_block_manager_t::choose_write_stream(file_account_t *io_account) {
+    auto it = write_streams.find(io_account);
+    if (it == write_streams.end()) {
+        it = write_streams.insert(std::make_pair(io_account, next_write_stream)).first;
+        next_write_stream = (next_write_stream + 1) % SERIALIZER_FOREGROUND_WRITE_STREAMS;
+    }
+    return it->second;
+}
+
+std::vector<counted_t<ls_block_token_pointee_t> >
+data_block_manager_t::write_blocks(const std::vector<buf_write_info_t> &writes,
+                                   int write_stream,
+                                   file_account_t *io_account,
+                                   iocallback_t *cb) {
     // Either we're ready to write, or we're shutting down and just finished reading
     // blocks for gc and called do_write.
     guarantee(state == state_ready ||
@@ -710,10 +924,15 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
     // These tokens are grouped by extent.  You can do a contiguous write in each
     // extent.
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > token_groups
-        = gimme_some_new_offsets(writes);
+        = gimme_some_new_offsets(writes, write_stream);
 
     for (auto it = writes.begin(); it != writes.end(); ++it) {
+        // (The flags were set by the log serializer, or read from disk by the GC.)
         it->buf->ser_header.block_id = it->block_id;
+        if (!unchecksummed_blocks) {
+            it->buf->ser_header.checksum = block_checksum(it->buf,
+                                                          it->block_size.ser_value());
+        }
     }
 
     struct intermediate_cb_t : public iocallback_t {
@@ -741,7 +960,7 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
 
         const int64_t front_offset = token_groups[i].front()->offset();
         const int64_t back_offset = token_groups[i].back()->offset()
-            + gc_entry_t::aligned_value(token_groups[i].back()->block_size());
+            + gc_entry_t::aligned_value(token_groups[i].back()->on_disk_block_size());
 
         guarantee(divides(DEVICE_BLOCK_SIZE, front_offset));
 
@@ -753,7 +972,7 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
 
         for (size_t j = 0; j < token_groups[i].size(); ++j) {
             const int64_t j_offset = token_groups[i][j]->offset();
-            const block_size_t j_block_size = token_groups[i][j]->block_size();
+            const block_size_t j_block_size = token_groups[i][j]->on_disk_block_size();
             guarantee(j_offset == last_written_offset);
             const size_t j_aligned_size = gc_entry_t::aligned_value(j_block_size);
 
@@ -789,6 +1008,58 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
     return ret;
 }
 
+std::vector<counted_t<ls_block_token_pointee_t> >
+data_block_manager_t::write_blocks_apart(const std::vector<buf_write_info_t> &writes,
+                                         int write_stream,
+                                         int value_write_stream,
+                                         file_account_t *io_account,
+                                         iocallback_t *cb) {
+    std::vector<buf_write_info_t> kinds[2];
+    std::vector<size_t> indices[2];
+    for (size_t i = 0; i < writes.size(); ++i) {
+        // Unchecksummed blocks have no flags.
+        const int kind = dynamic_config->separate_value_blocks && !unchecksummed_blocks
+            && (writes[i].buf->ser_header.flags & LS_BUF_VALUE_BLOCK) != 0;
+        kinds[kind].push_back(writes[i]);
+        indices[kind].push_back(i);
+    }
+    if (kinds[1].empty()) {
+        return write_blocks(writes, write_stream, io_account, cb);
+    } else if (kinds[0].empty()) {
+        return write_blocks(writes, value_write_stream, io_account, cb);
+    }
+
+    struct both_written_cb_t : public iocallback_t {
+        void on_io_complete() {
+            --ops_remaining;
+            if (ops_remaining == 0) {
+                iocallback_t *local_cb = cb;
+                delete this;
+                local_cb->on_io_complete();
+            }
+        }
+
+        int ops_remaining;
+        iocallback_t *cb;
+    };
+
+    both_written_cb_t *both_written_cb = new both_written_cb_t;
+    both_written_cb->ops_remaining = 2;
+    both_written_cb->cb = cb;
+
+    std::vector<counted_t<ls_block_token_pointee_t> > ret(writes.size());
+    const int streams[2] = { write_stream, value_write_stream };
+    for (int kind = 0; kind < 2; ++kind) {
+        std::vector<counted_t<ls_block_token_pointee_t> > tokens
+            = write_blocks(kinds[kind], streams[kind], io_account, both_written_cb);
+        guarantee(tokens.size() == indices[kind].size());
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            ret[indices[kind][i]] = std::move(tokens[i]);
+        }
+    }
+    return ret;
+}
+
 void data_block_manager_t::destroy_entry(gc_entry_t *entry) {
     rassert(entry != NULL);
     entry->destroy();
@@ -837,6 +1108,10 @@ void data_block_manager_t::check_and_handle_empty_extent(uint64_t extent_id) {
     }
 }
 
+bool data_block_manager_t::gc_is_urgent() const {
+    return garbage_ratio() > dynamic_config->gc_high_ratio * 1.02;
+}
+
 file_account_t *data_block_manager_t::choose_gc_io_account() {
     // Start going into high priority as soon as the garbage ratio is more than
     // 2% above the configured goal.
@@ -847,7 +1122,7 @@ file_account_t *data_block_manager_t::choose_gc_io_account() {
 
     // This means that we can end up oscillating between both accounts, which
     // is probably fine. TODO: Make sure it actually is in practice!
-    if (garbage_ratio() > dynamic_config->gc_high_ratio * 1.02) {
+    if (gc_is_urgent()) {
         return gc_io_account_high.get();
     } else {
         return gc_io_account_nice.get();
@@ -954,9 +1229,17 @@ void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num
                                                       writes[i].buf->ser_header.block_id));
             }
 
+            int64_t bytes = 0;
+            for (size_t i = 0; i < num_writes; ++i) {
+                bytes += gc_entry_t::aligned_value(writes[i].block_size);
+            }
+            parent->gc_write_credit -= bytes;
+
             new_block_tokens
-                = parent->many_writes(the_writes, parent->choose_gc_io_account(),
-                                      &block_write_cond);
+                = parent->write_blocks_apart(the_writes, GC_WRITE_STREAM,
+                                             GC_VALUE_WRITE_STREAM,
+                                             parent->choose_gc_io_account(),
+                                             &block_write_cond);
 
             guarantee(new_block_tokens.size() == num_writes);
         }
@@ -1017,7 +1300,8 @@ void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num
 
         // Step 4B: Commit the transaction to the serializer, emptying
         // out all the i_array bits.
-        parent->serializer->index_write(index_write_ops, parent->choose_gc_io_account());
+        parent->serializer->index_write(index_write_ops, std::function<void()>(),
+                                        parent->choose_gc_io_account());
 
         ASSERT_NO_CORO_WAITING;
 
@@ -1052,8 +1336,17 @@ void data_block_manager_t::run_gc() {
                     return;
                 }
 
+                if (gc_is_throttled()) {
+                    if (gc_throttle_timer == NULL) {
+                        gc_throttle_timer = fire_timer_once(GC_THROTTLE_RETRY_MS, this);
+                    }
+                    return;
+                }
+
                 ASSERT_NO_CORO_WAITING;
 
+                refresh_gc_priorities();
+
                 ++stats->pm_serializer_data_extents_gced;
 
                 /* grab the entry */
@@ -1172,6 +1465,13 @@ void data_block_manager_t::run_gc() {
                     ser_buffer_t *block = reinterpret_cast<ser_buffer_t *>(gc_state.gc_blocks.get() + gc_state.current_entry->relative_offset(i));
                     const int64_t block_offset = gc_state.current_entry->extent_ref.offset()
                         + gc_state.current_entry->relative_offset(i);
+                    // Otherwise writing it out again would give the corrupted block
+                    // a good checksum.
+                    if (!unchecksummed_blocks) {
+                        guarantee_block_checksum(
+                            block, gc_state.current_entry->block_size(i).ser_value(),
+                            block_offset);
+                    }
 
                     gc_writes.push_back(gc_write_t(block, block_offset,
                                                    gc_state.current_entry->block_size(i)));
@@ -1234,8 +1534,8 @@ void data_block_manager_t::run_gc() {
 void data_block_manager_t::prepare_metablock(data_block_manager::metablock_mixin_t *metablock) {
     guarantee(state == state_ready || state == state_shutting_down);
 
-    if (active_extent != NULL) {
-        metablock->active_extent = active_extent->extent_ref.offset();
+    if (active_extents[0] != NULL) {
+        metablock->active_extent = active_extents[0]->extent_ref.offset();
     } else {
         metablock->active_extent = NULL_OFFSET;
     }
@@ -1262,10 +1562,17 @@ void data_block_manager_t::actually_shutdown() {
 
     guarantee(reconstructed_extents.head() == NULL);
 
-    if (active_extent != NULL) {
-        UNUSED int64_t extent = active_extent->extent_ref.release();
-        delete active_extent;
-        active_extent = NULL;
+    if (gc_throttle_timer != NULL) {
+        cancel_timer(gc_throttle_timer);
+        gc_throttle_timer = NULL;
+    }
+
+    for (int i = 0; i < NUM_WRITE_STREAMS; ++i) {
+        if (active_extents[i] != NULL) {
+            UNUSED int64_t extent = active_extents[i]->extent_ref.release();
+            delete active_extents[i];
+            active_extents[i] = NULL;
+        }
     }
 
     while (gc_entry_t *entry = young_extent_queue.head()) {
@@ -1286,17 +1593,20 @@ void data_block_manager_t::actually_shutdown() {
 }
 
 std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes) {
+data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes,
+                                             int write_stream) {
     ASSERT_NO_CORO_WAITING;
+    rassert(write_stream >= 0 && write_stream < NUM_WRITE_STREAMS);
+    gc_entry_t *&extent = active_extents[write_stream];
 
     // Start a new extent if necessary.
-    if (active_extent == NULL) {
-        active_extent = new gc_entry_t(this);
+    if (extent == NULL) {
+        extent = new gc_entry_t(this);
         ++stats->pm_serializer_data_extents_allocated;
     }
 
 
-    guarantee(active_extent->state == gc_entry_t::state_active);
+    guarantee(extent->state == gc_entry_t::state_active);
 
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > ret;
 
@@ -1304,25 +1614,25 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
     for (auto it = writes.begin(); it != writes.end(); ++it) {
         uint32_t relative_offset = valgrind_undefined<uint32_t>(UINT32_MAX);
         unsigned int block_index = valgrind_undefined<unsigned int>(UINT_MAX);
-        if (!active_extent->new_offset(it->block_size,
-                                       &relative_offset, &block_index)) {
-            // Move the active_extent gc_entry_t to the young extent queue (if it's
+        if (!extent->new_offset(it->block_size,
+                                &relative_offset, &block_index)) {
+            // Move the active gc_entry_t to the young extent queue (if it's
             // not already empty), and make a new gc_entry_t.
-            if (active_extent->num_live_blocks() == 0) {
-                gc_entry_t *old_active_extent = active_extent;
-                active_extent = new gc_entry_t(this);
-                destroy_entry(old_active_extent);
+            if (extent->num_live_blocks() == 0) {
+                gc_entry_t *old_extent = extent;
+                extent = new gc_entry_t(this);
+                destroy_entry(old_extent);
             } else {
-                active_extent->state = gc_entry_t::state_young;
-                young_extent_queue.push_back(active_extent);
+                extent->state = gc_entry_t::state_young;
+                young_extent_queue.push_back(extent);
                 mark_unyoung_entries();
-                active_extent = new gc_entry_t(this);
+                extent = new gc_entry_t(this);
             }
 
             ++stats->pm_serializer_data_extents_allocated;
-            const bool succeeded = active_extent->new_offset(it->block_size,
-                                                             &relative_offset,
-                                                             &block_index);
+            const bool succeeded = extent->new_offset(it->block_size,
+                                                      &relative_offset,
+                                                      &block_index);
             guarantee(succeeded);
 
             // Push the current group of tokens, if it's nonempty, onto the return vector.
@@ -1332,9 +1642,9 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
             }
         }
 
-        const int64_t offset = active_extent->extent_ref.offset() + relative_offset;
-        active_extent->was_written = true;
-        active_extent->mark_live_tokenwise(block_index);
+        const int64_t offset = extent->extent_ref.offset() + relative_offset;
+        extent->was_written = true;
+        extent->mark_live_tokenwise(block_index);
 
         tokens.push_back(serializer->generate_block_token(offset, it->block_size));
     }
@@ -1395,8 +1705,36 @@ bool data_block_manager_t::do_we_want_to_start_gcing() const {
     return garbage_ratio() > dynamic_config->gc_high_ratio;
 }
 
+void data_block_manager_t::refresh_gc_priorities() {
+    const microtime_t now = current_microtime();
+    if (now - gc_priority_time >= GC_PRIORITY_REFRESH_MICROS) {
+        gc_priority_time = now;
+        gc_pq.rebuild();
+    }
+}
+
+bool data_block_manager_t::gc_is_throttled() {
+    if (gc_is_urgent()) {
+        return false;
+    }
+    if (current_microtime() - last_foreground_write_time > GC_FOREGROUND_IDLE_MICROS) {
+        // Whatever the GC does while there's nothing else going on shouldn't make it
+        // wait once foreground writes come back.
+        gc_write_credit = std::max<int64_t>(gc_write_credit, 0);
+        return false;
+    }
+    return gc_write_credit < 0;
+}
+
+void data_block_manager_t::on_timer() {
+    gc_throttle_timer = NULL;
+    if (state == state_ready) {
+        start_gc();
+    }
+}
+
 bool gc_entry_less_t::operator()(const gc_entry_t *x, const gc_entry_t *y) {
-    return x->garbage_bytes() < y->garbage_bytes();
+    return x->gc_benefit() < y->gc_benefit();
 }
 
 /****************
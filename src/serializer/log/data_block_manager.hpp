@@ -2,8 +2,10 @@
 #ifndef SERIALIZER_LOG_DATA_BLOCK_MANAGER_HPP_
 #define SERIALIZER_LOG_DATA_BLOCK_MANAGER_HPP_
 
+#include <map>
 #include <vector>
 
+#include "arch/timer.hpp"
 #include "arch/types.hpp"
 #include "containers/bitset.hpp"
 #include "containers/priority_queue.hpp"
@@ -18,6 +20,17 @@ class log_serializer_t;
 
 class data_block_manager_t;
 
+/* `buf` holds a block of a file from serializer version
+UNCHECKSUMMED_SERIALIZER_VERSION_STRING, read in LS_UNCHECKSUMMED_HEADER_SHORTFALL bytes
+past its start.  This gives it the full header, so that it's laid out like any other
+block in memory. */
+void unchecksummed_block_to_buffer(ser_buffer_t *buf);
+
+/* Lays out `buf`, a block of size `block_size` in memory, the way a file from
+serializer version UNCHECKSUMMED_SERIALIZER_VERSION_STRING stores it, in `out`. */
+void buffer_to_unchecksummed_block(const ser_buffer_t *buf, block_size_t block_size,
+                                   ser_buffer_t *out);
+
 class gc_entry_t;
 
 struct gc_entry_less_t {
@@ -29,7 +42,40 @@ struct shutdown_callback_t;  // see log_serializer.hpp.
 struct metablock_mixin_t;  // see log_serializer.hpp.
 }  // namespace data_block_manager
 
-class data_block_manager_t {
+/* Decides how much data is read around a block read for the purposes of read-ahead.
+Read-ahead helps warming up the cache, but a block that was read ahead and then gets
+read from disk again was a waste of bandwidth: the cache either did not want it or
+did not keep it.  The window grows while read-ahead blocks are rarely read again, and
+shrinks when many are.  Once it would drop below `min_size`, read-ahead is turned off
+for good, which happens on fast disks and once the cache has warmed up. */
+class read_ahead_window_t {
+public:
+    read_ahead_window_t(int64_t min_size, int64_t initial_size, int64_t max_size);
+
+    // Returns 0 if read-ahead has been turned off.
+    int64_t size() const { return size_; }
+
+    // Called with the number of blocks a read-ahead handed out besides the one that
+    // was actually requested.
+    void note_blocks_read_ahead(int64_t count);
+    // Called when a block that had been read ahead gets read from disk again.
+    void note_block_wasted();
+
+private:
+    void maybe_adjust();
+
+    const int64_t min_size_;
+    const int64_t max_size_;
+    int64_t size_;
+
+    // What happened since the window was last adjusted.
+    int64_t blocks_read_ahead_;
+    int64_t blocks_wasted_;
+
+    DISABLE_COPYING(read_ahead_window_t);
+};
+
+class data_block_manager_t : private timer_callback_t {
     friend class gc_entry_t;
     friend class dbm_read_ahead_t;
 private:
@@ -52,9 +98,12 @@ private:
     };
 
 public:
+    // `unchecksummed_blocks` says that the file is from serializer version
+    // UNCHECKSUMMED_SERIALIZER_VERSION_STRING.  Blocks are then passed to us as they
+    // are on disk, and have no checksums or flags.
     data_block_manager_t(const log_serializer_dynamic_config_t *dynamic_config, extent_manager_t *em,
                          log_serializer_t *serializer, const log_serializer_on_disk_static_config_t *static_config,
-                         log_serializer_stats_t *parent);
+                         bool unchecksummed_blocks, log_serializer_stats_t *parent);
     ~data_block_manager_t();
 
     /* When initializing the database from scratch, call start() with just the
@@ -97,20 +146,63 @@ public:
     // ratio of garbage to blocks in the system
     double garbage_ratio() const;
 
+    // Writes blocks on behalf of the serializer's users.  Blocks written through
+    // the same io_account go to the same active extent, see active_extents.
     std::vector<counted_t<ls_block_token_pointee_t> >
     many_writes(const std::vector<buf_write_info_t> &writes,
                 file_account_t *io_account,
                 iocallback_t *cb);
 
-    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-    gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes);
-
 
 private:
     void actually_shutdown();
 
+    // Foreground writes use write streams 0 through
+    // SERIALIZER_FOREGROUND_WRITE_STREAMS - 1, except for value blocks (see
+    // LS_BUF_VALUE_BLOCK), which all go to the one after those.  The GC has a write
+    // stream for each kind of block after that.
+    static const int VALUE_WRITE_STREAM = SERIALIZER_FOREGROUND_WRITE_STREAMS;
+    static const int GC_WRITE_STREAM = SERIALIZER_FOREGROUND_WRITE_STREAMS + 1;
+    static const int GC_VALUE_WRITE_STREAM = SERIALIZER_FOREGROUND_WRITE_STREAMS + 2;
+    static const int NUM_WRITE_STREAMS = SERIALIZER_FOREGROUND_WRITE_STREAMS + 3;
+
+    // Returns the foreground write stream that writes through io_account go to.
+    int choose_write_stream(file_account_t *io_account);
+
+    std::vector<counted_t<ls_block_token_pointee_t> >
+    write_blocks(const std::vector<buf_write_info_t> &writes,
+                 int write_stream,
+                 file_account_t *io_account,
+                 iocallback_t *cb);
+
+    // Like write_blocks, but sends value blocks to value_write_stream, if
+    // separate_value_blocks is set.  The tokens are still in the order of writes.
+    std::vector<counted_t<ls_block_token_pointee_t> >
+    write_blocks_apart(const std::vector<buf_write_info_t> &writes,
+                       int write_stream,
+                       int value_write_stream,
+                       file_account_t *io_account,
+                       iocallback_t *cb);
+
+    // Assigns offsets in the write stream's active extent to the writes, moving on
+    // to a new active extent whenever it fills up.
+    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
+    gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes,
+                           int write_stream);
+
+    // True if the garbage ratio is so far above gc_high_ratio that the GC has to
+    // catch up at high priority.
+    bool gc_is_urgent() const;
     file_account_t *choose_gc_io_account();
 
+    // Recomputes the order of gc_pq if gc_priority_time is outdated.
+    void refresh_gc_priorities();
+
+    // True if the GC should wait for more foreground writes before it relocates
+    // another extent.  See gc_write_credit.
+    bool gc_is_throttled();
+    void on_timer();
+
     /* Checks whether the extent is empty and if it is, notifies the extent manager
        and cleans up */
     void check_and_handle_empty_extent(uint64_t extent_id);
@@ -129,6 +221,9 @@ private:
 
     bool should_perform_read_ahead(int64_t offset);
 
+    // Clears the block's read-ahead mark, and tells read_ahead_window if it was set.
+    void note_block_read(int64_t offset);
+
     /* internal garbage collection structures */
     struct gc_read_callback_t : public iocallback_t {
         data_block_manager_t *parent;
@@ -157,6 +252,7 @@ private:
 
     const log_serializer_dynamic_config_t* const dynamic_config;
     const log_serializer_on_disk_static_config_t* const static_config;
+    const bool unchecksummed_blocks;
 
     extent_manager_t *const extent_manager;
     log_serializer_t *const serializer;
@@ -172,8 +268,23 @@ private:
     /* Contains every extent in the gc_entry_t::state_reconstructing state */
     intrusive_list_t<gc_entry_t> reconstructed_extents;
 
-    /* Contains the extent in the gc_entry_t::state_active state. */
-    gc_entry_t *active_extent;
+    /* Contains the extents in the gc_entry_t::state_active state, one (or NULL) for
+    each write stream.  Each page cache writing to the file has its own io account,
+    and so its own write stream, which lets the device absorb their flushes as
+    separate sequential streams instead of one interleaved one.  The GC relocates
+    live blocks to an extent of its own: blocks that survived a GC tend to stay
+    alive, so keeping them apart from freshly written blocks gives extents that
+    either become garbage quickly or hardly at all.
+
+    Only the extent of write stream 0 is recorded in the metablock; after a restart,
+    the other active extents are treated like any other old extent. */
+    gc_entry_t *active_extents[NUM_WRITE_STREAMS];
+
+    // The write streams that io accounts have been assigned to, and the stream the
+    // next new io account is assigned to.  Each cache keeps its io account for as
+    // long as it exists, so this stays small.
+    std::map<file_account_t *, int> write_streams;
+    int next_write_stream;
 
     /* Contains every extent in the gc_entry_t::state_young state */
     intrusive_list_t<gc_entry_t> young_extent_queue;
@@ -181,6 +292,23 @@ private:
     /* Contains every extent in the gc_entry_t::state_old state */
     priority_queue_t<gc_entry_t *, gc_entry_less_t> gc_pq;
 
+    /* gc_pq orders extents by how much garbage they let us reclaim for the live data
+    that has to be copied, weighted by their age (see gc_entry_t::gc_benefit).  Since
+    the age changes all the time, the ages are computed relative to gc_priority_time,
+    and gc_pq gets rebuilt whenever gc_priority_time is updated. */
+    microtime_t gc_priority_time;
+
+    /* How many bytes the GC may write before it has to wait for more foreground
+    writes.  Foreground writes add GC_NICE_BYTES_PER_FOREGROUND_BYTE for each byte
+    written, GC writes take away one.  This only applies as long as there have been
+    foreground writes in the last GC_FOREGROUND_IDLE_MICROS, and the GC isn't urgent
+    (see gc_is_urgent()). */
+    int64_t gc_write_credit;
+    microtime_t last_foreground_write_time;
+    // The timer that resumes a throttled GC, or NULL.
+    timer_token_t *gc_throttle_timer;
+
+    read_ahead_window_t read_ahead_window;
 
     /* Buffer used during GC. */
     std::vector<gc_write_t> gc_writes;
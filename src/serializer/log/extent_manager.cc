@@ -65,6 +65,9 @@ class extent_zone_t {
 
     file_t *const dbfile;
 
+    // Whether to discard extents that get freed but stay in the file.
+    const bool discard_freed_extents;
+
     // The number of free extents in the file.
     size_t held_extents_;
 
@@ -73,8 +76,9 @@ public:
         return held_extents_;
     }
 
-    extent_zone_t(file_t *_dbfile, size_t _extent_size)
-        : extent_size(_extent_size), dbfile(_dbfile), held_extents_(0) {
+    extent_zone_t(file_t *_dbfile, size_t _extent_size, bool _discard_freed_extents)
+        : extent_size(_extent_size), dbfile(_dbfile),
+          discard_freed_extents(_discard_freed_extents), held_extents_(0) {
         // (Avoid a bunch of reallocations by resize calls (avoiding O(n log n)
         // work on average).)
         extents.reserve(dbfile->get_size() / extent_size);
@@ -176,6 +180,16 @@ public:
         }
     }
 
+    std::vector<extent_reference_t> copy_extent_references_in_use() {
+        std::vector<extent_reference_t> extent_refs;
+        for (size_t id = 0; id < extents.size(); ++id) {
+            if (extents[id].state() == extent_info_t::state_in_use) {
+                extent_refs.push_back(make_extent_reference(id * extent_size));
+            }
+        }
+        return extent_refs;
+    }
+
     void release_extent(extent_reference_t &&extent_ref) {
         int64_t extent = extent_ref.release();
         extent_info_t *info = &extents[offset_to_id(extent)];
@@ -187,18 +201,25 @@ public:
             free_queue.push(offset_to_id(extent));
             ++held_extents_;
             try_shrink_file();
+            // If the extent is still inside the file, let the device forget its
+            // contents.  This happens before anyone can be handed the extent again.
+            if (discard_freed_extents && offset_to_id(extent) < extents.size()) {
+                dbfile->discard(extent, extent_size);
+            }
         }
     }
 };
 
 extent_manager_t::extent_manager_t(file_t *file,
                                    const log_serializer_on_disk_static_config_t *static_config,
+                                   const log_serializer_dynamic_config_t *dynamic_config,
                                    log_serializer_stats_t *_stats)
     : stats(_stats), extent_size(static_config->extent_size()),
       state(state_reserving_extents) {
     guarantee(divides(DEVICE_BLOCK_SIZE, extent_size));
 
-    zone.init(new extent_zone_t(file, extent_size));
+    zone.init(new extent_zone_t(file, extent_size,
+                                dynamic_config->discard_freed_extents));
 }
 
 extent_manager_t::~extent_manager_t() {
@@ -300,3 +321,20 @@ size_t extent_manager_t::held_extents() {
     assert_thread();
     return zone->held_extents();
 }
+
+std::vector<extent_reference_t> extent_manager_t::copy_extent_references_in_use() {
+    assert_thread();
+    rassert(state == state_running);
+    return zone->copy_extent_references_in_use();
+}
+
+void extent_manager_t::release_extent_references(
+        std::vector<extent_reference_t> &&extent_refs) {
+    assert_thread();
+    // Like the references from `copy_extent_reference()`, these don't count towards
+    // the extents in use.
+    for (auto it = extent_refs.begin(); it != extent_refs.end(); ++it) {
+        zone->release_extent(std::move(*it));
+    }
+    extent_refs.clear();
+}
@@ -101,6 +101,7 @@ public:
 
     extent_manager_t(file_t *file,
                      const log_serializer_on_disk_static_config_t *static_config,
+                     const log_serializer_dynamic_config_t *dynamic_config,
                      log_serializer_stats_t *);
     ~extent_manager_t();
 
@@ -136,6 +137,12 @@ public:
     /* Number of extents that have been released but not handed back out again. */
     size_t held_extents();
 
+    /* Takes a reference to every extent that's in use, so that none of them can be
+    reused (or discarded) while something copies them, e.g. for a backup.  The
+    references must be given back with `release_extent_references()`. */
+    MUST_USE std::vector<extent_reference_t> copy_extent_references_in_use();
+    void release_extent_references(std::vector<extent_reference_t> &&extent_refs);
+
     log_serializer_stats_t *const stats;
     const uint64_t extent_size;   /* Same as static_config->extent_size */
 
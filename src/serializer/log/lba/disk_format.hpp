@@ -62,6 +62,8 @@ static const block_id_t PADDING_BLOCK_ID = NULL_BLOCK_ID;
 struct lba_entry_t {
     block_id_t block_id;
 
+    // The size of the block on disk.  It is smaller than the serializer's block size
+    // for compressed blocks, see serializer/log/block_compression.hpp.
     uint32_t ser_block_size;
 
     // TODO: Remove the need for these fields (or this zero field).  Remove the
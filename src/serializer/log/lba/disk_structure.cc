@@ -189,10 +189,48 @@ void lba_disk_structure_t::sync(file_account_t *io_account, sync_callback_t *cb)
     }
 }
 
-struct reader_t
+lba_read_budget_t::lba_read_budget_t(int max_extents)
+    : available(max_extents) {
+    guarantee(max_extents > 0);
+}
+
+lba_read_budget_t::~lba_read_budget_t() {
+    rassert(waiters.empty());
+}
+
+bool lba_read_budget_t::try_acquire() {
+    if (available == 0) {
+        return false;
+    }
+    --available;
+    return true;
+}
+
+void lba_read_budget_t::wait(waiter_t *waiter) {
+    if (try_acquire()) {
+        waiter->on_lba_read_budget_available();
+    } else {
+        waiters.push_back(waiter);
+    }
+}
+
+void lba_read_budget_t::release() {
+    if (waiters.empty()) {
+        ++available;
+    } else {
+        // Hand the budget over directly, so that the releasing shard can't grab it
+        // back before the waiting ones get their turn.
+        waiter_t *waiter = waiters.front();
+        waiters.pop_front();
+        waiter->on_lba_read_budget_available();
+    }
+}
+
+struct reader_t : public lba_read_budget_t::waiter_t
 {
     lba_disk_structure_t *ds;   // The disk structure we are reading from
     in_memory_index_t *index;   // The in-memory-index we are reading into
+    lba_read_budget_t *budget;   // Limits how many extents we may have in memory
     lba_disk_structure_t::read_callback_t *rcb;   // Who to call back when we finish
 
     /* extent_reader_t takes care of reading a single extent. */
@@ -225,7 +263,6 @@ struct reader_t
             }
         }
         void start_reading() {
-            parent->active_readers++;
             extent->read_step_1(&read_info, this);
         }
         void on_extent_read() {   // Called when our extent has been read from disk
@@ -240,8 +277,7 @@ struct reader_t
         }
         void done() {
             extent->read_step_2(&read_info, parent->index);
-            parent->active_readers--;
-            parent->start_more_readers();
+            parent->budget->release();
             if (index == static_cast<int>(parent->readers.size()) - 1) {
                 parent->done();
             } else {
@@ -254,12 +290,12 @@ struct reader_t
 
     int next_reader;   // The index of the next reader that we should call start_reading() on
 
-    // The number of readers that have done start_reading() but not done(). Used to throttle the
-    // reading process so that we stay under LBA_READ_BUFFER_SIZE.
-    int active_readers;
+    // True while we are in the budget's queue of waiters.
+    bool waiting_for_budget;
 
-    reader_t(lba_disk_structure_t *_ds, in_memory_index_t *_index, lba_disk_structure_t::read_callback_t *cb)
-        : ds(_ds), index(_index), rcb(cb)
+    reader_t(lba_disk_structure_t *_ds, in_memory_index_t *_index,
+             lba_read_budget_t *_budget, lba_disk_structure_t::read_callback_t *cb)
+        : ds(_ds), index(_index), budget(_budget), rcb(cb)
     {
         for (lba_disk_extent_t *e = ds->extents_in_superblock.head();
              e != NULL; e = ds->extents_in_superblock.next(e)) {
@@ -275,16 +311,29 @@ struct reader_t
             done();
         } else {
             next_reader = 0;
-            active_readers = 0;
+            waiting_for_budget = false;
             start_more_readers();
         }
     }
 
+    /* Starts reading as many extents as the budget allows.  Extents are started in
+    order, so the extent that has to be applied to the index next has always been
+    started, and finished extents always make way for more. */
     void start_more_readers() {
-        int limit = std::max<int>(LBA_READ_BUFFER_SIZE / ds->em->extent_size / LBA_SHARD_FACTOR, 1);
-        while (next_reader != static_cast<int>(readers.size()) && active_readers < limit) {
+        while (next_reader != static_cast<int>(readers.size()) && budget->try_acquire()) {
             readers[next_reader++]->start_reading();
         }
+        if (next_reader != static_cast<int>(readers.size())) {
+            waiting_for_budget = true;
+            budget->wait(this);
+        }
+    }
+
+    void on_lba_read_budget_available() {
+        rassert(waiting_for_budget);
+        waiting_for_budget = false;
+        readers[next_reader++]->start_reading();
+        start_more_readers();
     }
 
     void done() {
@@ -293,8 +342,9 @@ struct reader_t
     }
 };
 
-void lba_disk_structure_t::read(in_memory_index_t *index, read_callback_t *cb) {
-    new reader_t(this, index, cb);
+void lba_disk_structure_t::read(in_memory_index_t *index, lba_read_budget_t *budget,
+                                read_callback_t *cb) {
+    new reader_t(this, index, budget, cb);
 }
 
 void lba_disk_structure_t::prepare_metablock(lba_shard_metablock_t *mb_out) {
@@ -2,6 +2,7 @@
 #ifndef SERIALIZER_LOG_LBA_DISK_STRUCTURE_HPP_
 #define SERIALIZER_LOG_LBA_DISK_STRUCTURE_HPP_
 
+#include <deque>
 #include <set>
 
 #include "arch/types.hpp"
@@ -12,6 +13,34 @@
 class lba_load_fsm_t;
 class lba_writer_t;
 
+/* Limits how many LBA extents are held in memory at once while the LBA is being read
+at startup.  It is shared by all shards, so that shards with many extents can use the
+read buffer space that shards with few extents don't need. */
+class lba_read_budget_t {
+public:
+    struct waiter_t {
+        virtual void on_lba_read_budget_available() = 0;
+        virtual ~waiter_t() {}
+    };
+
+    explicit lba_read_budget_t(int max_extents);
+    ~lba_read_budget_t();
+
+    // Takes one extent's worth of the budget if there is any left.
+    bool try_acquire();
+    // Hands one extent's worth of the budget to `waiter` (by calling
+    // `on_lba_read_budget_available()`) as soon as there is some. Waiters are served
+    // in order.
+    void wait(waiter_t *waiter);
+    void release();
+
+private:
+    int available;
+    std::deque<waiter_t *> waiters;
+
+    DISABLE_COPYING(lba_read_budget_t);
+};
+
 class lba_disk_structure_t :
     public extent_t::read_callback_t
 {
@@ -54,12 +83,13 @@ public:
                          file_account_t *io_account, extent_transaction_t *txn);
 
     // If you call read(), then the in_memory_index_t will be populated and then the read_callback_t
-    // will be called when it is done.
+    // will be called when it is done. Extents are read ahead of being applied to the
+    // index as far as `budget` allows.
     struct read_callback_t {
         virtual void on_lba_extents_read() = 0;
         virtual ~read_callback_t() {}
     };
-    void read(in_memory_index_t *index, read_callback_t *cb);
+    void read(in_memory_index_t *index, lba_read_budget_t *budget, read_callback_t *cb);
 
     void prepare_metablock(lba_shard_metablock_t *mb_out);
 
@@ -2,17 +2,145 @@
 #include "serializer/log/lba/in_memory_index.hpp"
 
 #include <inttypes.h>
+#include <string.h>
+
+#include <algorithm>
 
 #include "serializer/log/lba/disk_format.hpp"
 
+in_memory_index_t::chunk_t::chunk_t()
+    : count(0), base_recency(repli_timestamp_t::invalid),
+      min_recency(0), max_recency(0) {
+    memset(infos, 0, sizeof(infos));
+}
+
 in_memory_index_t::in_memory_index_t() : end_block_id_(0) { }
 
+in_memory_index_t::~in_memory_index_t() {
+    for (auto it = chunks_.begin(); it != chunks_.end(); ++it) {
+        delete *it;
+    }
+}
+
 block_id_t in_memory_index_t::end_block_id() {
     return end_block_id_;
 }
 
+bool in_memory_index_t::is_empty(const packed_info_t &packed) {
+    return packed.offset_and_size == 0 && packed.recency_code == 0;
+}
+
+index_block_info_t in_memory_index_t::unpack(const chunk_t *chunk,
+                                             const packed_info_t &packed) {
+    rassert(packed.recency_code != OVERFLOW_CODE);
+
+    const uint64_t offset_code = packed.offset_and_size & ((1ull << OFFSET_BITS) - 1);
+    const flagged_off64_t offset = offset_code == 0
+        ? flagged_off64_t::unused()
+        : flagged_off64_t::make((offset_code - 1) * DEVICE_BLOCK_SIZE);
+
+    repli_timestamp_t recency = repli_timestamp_t::invalid;
+    if (packed.recency_code != 0) {
+        recency.longtime = chunk->base_recency.longtime + (packed.recency_code - 1);
+    }
+
+    return index_block_info_t(offset, recency, packed.offset_and_size >> OFFSET_BITS);
+}
+
+in_memory_index_t::pack_result_t
+in_memory_index_t::pack(const chunk_t *chunk, const index_block_info_t &info,
+                        packed_info_t *packed_out) {
+    uint64_t offset_code;
+    if (info.offset == flagged_off64_t::unused()) {
+        offset_code = 0;
+    } else if (info.offset.has_value()
+               && divides(DEVICE_BLOCK_SIZE, info.offset.get_value())
+               && info.offset.get_value() / DEVICE_BLOCK_SIZE
+                  < static_cast<int64_t>((1ull << OFFSET_BITS) - 1)) {
+        offset_code = info.offset.get_value() / DEVICE_BLOCK_SIZE + 1;
+    } else {
+        return DOES_NOT_FIT;
+    }
+
+    if (info.ser_block_size >= (1ull << SIZE_BITS)) {
+        return DOES_NOT_FIT;
+    }
+
+    uint32_t recency_code;
+    if (info.recency == repli_timestamp_t::invalid) {
+        recency_code = 0;
+    } else if (chunk->base_recency != repli_timestamp_t::invalid
+               && info.recency >= chunk->base_recency
+               && info.recency.longtime - chunk->base_recency.longtime
+                  <= MAX_RECENCY_DELTA) {
+        recency_code = info.recency.longtime - chunk->base_recency.longtime + 1;
+    } else {
+        return RECENCY_OUT_OF_RANGE;
+    }
+
+    packed_out->offset_and_size
+        = offset_code | (static_cast<uint64_t>(info.ser_block_size) << OFFSET_BITS);
+    packed_out->recency_code = recency_code;
+    return PACKED;
+}
+
+bool in_memory_index_t::rebase(chunk_t *chunk, repli_timestamp_t recency) {
+    rassert(recency != repli_timestamp_t::invalid);
+
+    uint64_t lo = recency.longtime;
+    uint64_t hi = recency.longtime;
+    if (chunk->base_recency != repli_timestamp_t::invalid
+        && std::max(hi, chunk->max_recency) - std::min(lo, chunk->min_recency)
+           > MAX_RECENCY_DELTA) {
+        // Don't bother looking at every entry if the recency is far away from all of
+        // them, which is the common reason for getting here.
+        return false;
+    }
+
+    for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+        const uint32_t code = chunk->infos[i].recency_code;
+        if (code != 0 && code != OVERFLOW_CODE) {
+            const uint64_t r = chunk->base_recency.longtime + (code - 1);
+            lo = std::min(lo, r);
+            hi = std::max(hi, r);
+        }
+    }
+    if (hi - lo > MAX_RECENCY_DELTA) {
+        return false;
+    }
+
+    // Leave room both below and above, so that we don't have to rebase again for
+    // every new recency that is a little older or newer than all the others.
+    const uint64_t slack = (MAX_RECENCY_DELTA - (hi - lo)) / 2;
+    const uint64_t new_base = lo >= slack ? lo - slack : 0;
+
+    for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+        uint32_t *code = &chunk->infos[i].recency_code;
+        if (*code != 0 && *code != OVERFLOW_CODE) {
+            const uint64_t r = chunk->base_recency.longtime + (*code - 1);
+            *code = r - new_base + 1;
+        }
+    }
+    chunk->base_recency.longtime = new_base;
+    chunk->min_recency = lo;
+    chunk->max_recency = hi;
+    return true;
+}
+
 index_block_info_t in_memory_index_t::get_block_info(block_id_t id) {
-    return infos_.get(id);
+    const size_t chunk_id = id / CHUNK_SIZE;
+    if (chunk_id >= chunks_.size() || chunks_[chunk_id] == NULL) {
+        return index_block_info_t();
+    }
+
+    const chunk_t *chunk = chunks_[chunk_id];
+    const packed_info_t &packed = chunk->infos[id % CHUNK_SIZE];
+    if (packed.recency_code == OVERFLOW_CODE) {
+        auto it = overflow_.find(id);
+        guarantee(it != overflow_.end());
+        return it->second;
+    }
+    return unpack(chunk, packed);
 }
 
 void in_memory_index_t::set_block_info(block_id_t id, repli_timestamp_t recency,
@@ -21,7 +149,59 @@ void in_memory_index_t::set_block_info(block_id_t id, repli_timestamp_t recency,
         end_block_id_ = id + 1;
     }
 
-    index_block_info_t info(offset, recency, ser_block_size);
-    infos_.set(id, info);
-}
+    const index_block_info_t info(offset, recency, ser_block_size);
+    const bool is_default = info == index_block_info_t();
+
+    const size_t chunk_id = id / CHUNK_SIZE;
+    if (chunk_id >= chunks_.size() || chunks_[chunk_id] == NULL) {
+        if (is_default) {
+            return;
+        }
+        if (chunk_id >= chunks_.size()) {
+            chunks_.resize(chunk_id + 1, NULL);
+        }
+        chunks_[chunk_id] = new chunk_t;
+    }
+    chunk_t *chunk = chunks_[chunk_id];
+    packed_info_t *slot = &chunk->infos[id % CHUNK_SIZE];
+
+    // Forget about the old value first, so that it doesn't get in the way of a
+    // rebase.
+    if (!is_empty(*slot)) {
+        if (slot->recency_code == OVERFLOW_CODE) {
+            overflow_.erase(id);
+        }
+        slot->offset_and_size = 0;
+        slot->recency_code = 0;
+        --chunk->count;
+    }
 
+    if (!is_default) {
+        packed_info_t packed;
+        pack_result_t res = pack(chunk, info, &packed);
+        if (res == RECENCY_OUT_OF_RANGE && rebase(chunk, recency)) {
+            res = pack(chunk, info, &packed);
+        }
+        if (res == PACKED) {
+            *slot = packed;
+            if (recency != repli_timestamp_t::invalid) {
+                chunk->min_recency = std::min(chunk->min_recency, recency.longtime);
+                chunk->max_recency = std::max(chunk->max_recency, recency.longtime);
+            }
+        } else {
+            overflow_[id] = info;
+            slot->offset_and_size = 0;
+            slot->recency_code = OVERFLOW_CODE;
+        }
+        ++chunk->count;
+    }
+
+    if (chunk->count == 0) {
+        chunks_[chunk_id] = NULL;
+        delete chunk;
+
+        while (!chunks_.empty() && chunks_.back() == NULL) {
+            chunks_.pop_back();
+        }
+    }
+}
@@ -2,7 +2,9 @@
 #ifndef SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
 #define SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
 
-#include "containers/two_level_array.hpp"
+#include <map>
+#include <vector>
+
 #include "config/args.hpp"
 #include "serializer/serializer.hpp"
 #include "serializer/log/lba/disk_format.hpp"
@@ -20,7 +22,6 @@ struct index_block_info_t {
           recency(_recency),
           ser_block_size(_ser_block_size) { }
 
-    // For two_level_array_t.
     bool operator==(const index_block_info_t &other) const {
         return offset == other.offset &&
             recency == other.recency &&
@@ -33,13 +34,19 @@ struct index_block_info_t {
 } __attribute__((__packed__));
 
 
+/* The in-memory index holds an index_block_info_t for every block id, which for big
+tables is a lot of memory that would be better spent on the page cache.  So instead
+of the 20 bytes of an index_block_info_t, each entry is packed into 12: the offset in
+units of DEVICE_BLOCK_SIZE, the block size, and the recency as a delta from a base
+recency that all block ids of a chunk share.  The rare entries that don't fit (such
+as a recency that is too far away from the rest of the chunk) are kept in a separate
+map instead.  Like two_level_array_t, chunks that only hold default values are
+freed. */
 
 class in_memory_index_t {
-    two_level_array_t<index_block_info_t> infos_;
-    block_id_t end_block_id_;
-
 public:
     in_memory_index_t();
+    ~in_memory_index_t();
 
     // end_block_id is one greater than the max block id.
     block_id_t end_block_id();
@@ -48,6 +55,49 @@ public:
     void set_block_info(block_id_t id, repli_timestamp_t recency,
                         flagged_off64_t offset, uint32_t ser_block_size);
 
+private:
+    struct packed_info_t {
+        // The low OFFSET_BITS hold the offset divided by DEVICE_BLOCK_SIZE plus one,
+        // or zero for an unused offset.  The remaining bits hold the block size.
+        uint64_t offset_and_size;
+        // Zero for an invalid recency, OVERFLOW_CODE if the entry is in overflow_,
+        // and the recency minus the chunk's base_recency plus one otherwise.
+        uint32_t recency_code;
+    } __attribute__((__packed__));
+
+    static const uint32_t OVERFLOW_CODE = UINT32_MAX;
+    static const uint64_t MAX_RECENCY_DELTA = OVERFLOW_CODE - 2;
+    static const int OFFSET_BITS = 40;
+    static const int SIZE_BITS = 64 - OFFSET_BITS;
+
+    static const size_t CHUNK_SIZE = 1 << 14;
+
+    struct chunk_t {
+        chunk_t();
+        // How many entries are not all zero.
+        size_t count;
+        repli_timestamp_t base_recency;
+        // Bounds on the recencies of the packed entries.  They are only made tighter
+        // by a rebase, so they can be looser than necessary.
+        uint64_t min_recency;
+        uint64_t max_recency;
+        packed_info_t infos[CHUNK_SIZE];
+    };
+
+    static bool is_empty(const packed_info_t &packed);
+    static index_block_info_t unpack(const chunk_t *chunk, const packed_info_t &packed);
+    enum pack_result_t { PACKED, RECENCY_OUT_OF_RANGE, DOES_NOT_FIT };
+    static pack_result_t pack(const chunk_t *chunk, const index_block_info_t &info,
+                              packed_info_t *packed_out);
+    // Tries to pick a base recency for `chunk` that covers both `recency` and the
+    // recencies of all its packed entries, and repacks them.
+    static bool rebase(chunk_t *chunk, repli_timestamp_t recency);
+
+    std::vector<chunk_t *> chunks_;
+    std::map<block_id_t, index_block_info_t> overflow_;
+    block_id_t end_block_id_;
+
+    DISABLE_COPYING(in_memory_index_t);
 };
 
 #endif  // SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
@@ -20,6 +20,7 @@ lba_list_t::lba_list_t(extent_manager_t *em,
 {
     for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
         gc_active[i] = false;
+        entries_since_checkpoint[i] = 0;
         disk_structures[i] = NULL;
     }
 }
@@ -53,8 +54,9 @@ void lba_list_t::prepare_metablock(metablock_mixin_t *mb_out) {
            (LBA_NUM_INLINE_ENTRIES - inline_lba_entries_count) * sizeof(lba_entry_t));
 }
 
+/* Every shard starts reading its LBA extents as soon as its own superblock has been
+loaded, and all shards read in parallel, sharing one read budget. */
 class lba_start_fsm_t :
-    private lba_disk_structure_t::load_callback_t,
     private lba_disk_structure_t::read_callback_t
 {
 public:
@@ -63,7 +65,9 @@ public:
     lba_list_t::ready_callback_t *callback;
 
     lba_start_fsm_t(lba_list_t *l, lba_list_t::metablock_mixin_t *last_metablock)
-        : owner(l), callback(NULL)
+        : owner(l), callback(NULL),
+          read_budget(std::max<int>(LBA_READ_BUFFER_SIZE / l->extent_manager->extent_size,
+                                    1))
     {
         rassert(owner->state == lba_list_t::state_unstarted);
         owner->state = lba_list_t::state_starting_up;
@@ -75,24 +79,24 @@ public:
                last_metablock->inline_lba_entries,
                last_metablock->inline_lba_entries_count * sizeof(lba_entry_t));
         
+        // Shards don't have to wait for each other, because they cover disjoint sets
+        // of block ids.  But none of them may be done before all of them have been
+        // constructed, so cbs_out counts them all from the start.
         cbs_out = LBA_SHARD_FACTOR;
+        for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
+            shard_loaders[i].parent = this;
+            shard_loaders[i].shard = i;
+        }
         for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
             owner->disk_structures[i] = new lba_disk_structure_t(
                 owner->extent_manager, owner->dbfile,
                 &last_metablock->shards[i]);
-            owner->disk_structures[i]->set_load_callback(this);
+            owner->disk_structures[i]->set_load_callback(&shard_loaders[i]);
         }
     }
 
-    void on_lba_load() {
-        rassert(cbs_out > 0);
-        cbs_out--;
-        if (cbs_out == 0) {
-            cbs_out = LBA_SHARD_FACTOR;
-            for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
-                owner->disk_structures[i]->read(&owner->in_memory_index, this);
-            }
-        }
+    void on_shard_load(int shard) {
+        owner->disk_structures[shard]->read(&owner->in_memory_index, &read_budget, this);
     }
 
     void on_lba_extents_read() {
@@ -112,10 +116,24 @@ public:
             }
             
             owner->state = lba_list_t::state_ready;
+            owner->checkpoint_timer.init(
+                new repeating_timer_t(LBA_CHECKPOINT_INTERVAL_MS, owner));
             if (callback) callback->on_lba_ready();
             delete this;
         }
     }
+
+private:
+    struct shard_loader_t : public lba_disk_structure_t::load_callback_t {
+        void on_lba_load() {
+            parent->on_shard_load(shard);
+        }
+        lba_start_fsm_t *parent;
+        int shard;
+    };
+
+    shard_loader_t shard_loaders[LBA_SHARD_FACTOR];
+    lba_read_budget_t read_budget;
 };
 
 bool lba_list_t::start_existing(file_t *file, metablock_mixin_t *last_metablock,
@@ -219,6 +237,7 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
         current disk_structure, so it's meaningless but harmless to call add_entry(). However,
         since our changes are also being put into the in_memory_index, they will be
         incorporated into the new disk_structure that the GC creates, so they won't get lost. */
+        ++entries_since_checkpoint[e.block_id % LBA_SHARD_FACTOR];
         disk_structures[e.block_id % LBA_SHARD_FACTOR]->add_entry(
                 e.block_id,
                 e.recency,
@@ -284,11 +303,23 @@ void lba_list_t::sync(file_account_t *io_account, sync_callback_t *cb) {
 void lba_list_t::consider_gc() {
     for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
         if (we_want_to_gc(i)) {
-            rassert(!gc_active[i]);
-            gc_active[i] = true;
-            coro_t *gc_coro = coro_t::spawn_sometime(std::bind(&lba_list_t::gc,
-                    this, i, auto_drainer_t::lock_t(gc_drainer.get())));
-            gc_coro->set_priority(CORO_PRIORITY_LBA_GC);
+            start_gc(i);
+        }
+    }
+}
+
+void lba_list_t::start_gc(int lba_shard) {
+    rassert(!gc_active[lba_shard]);
+    gc_active[lba_shard] = true;
+    coro_t *gc_coro = coro_t::spawn_sometime(std::bind(&lba_list_t::gc,
+            this, lba_shard, auto_drainer_t::lock_t(gc_drainer.get())));
+    gc_coro->set_priority(CORO_PRIORITY_LBA_GC);
+}
+
+void lba_list_t::on_ring() {
+    for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
+        if (we_want_to_checkpoint(i)) {
+            start_gc(i);
         }
     }
 }
@@ -301,6 +332,9 @@ void lba_list_t::gc(int lba_shard, auto_drainer_t::lock_t) {
     txns.push_back(new extent_transaction_t());
     extent_manager->begin_transaction(&txns.back());
 
+    // Entries appended from here on are not covered by what we are going to write.
+    entries_since_checkpoint[lba_shard] = 0;
+
     // Fetch a list of current LBA extents, minus the active one
     const std::set<lba_disk_extent_t *> gced_extents =
         disk_structures[lba_shard]->get_inactive_extents();
@@ -427,10 +461,23 @@ bool lba_list_t::we_want_to_gc(int i) {
     return true;
 }
 
+bool lba_list_t::we_want_to_checkpoint(int i) {
+    if (gc_active[i] || state != lba_list_t::state_ready) {
+        return false;
+    }
+
+    // A tail of less than one extent is read quickly enough anyway.
+    const int64_t entries_live = end_block_id() / LBA_SHARD_FACTOR;
+    const int64_t tail = entries_since_checkpoint[i];
+    return tail >= disk_structures[i]->num_entries_that_can_fit_in_an_extent()
+        && tail >= entries_live * LBA_CHECKPOINT_MIN_TAIL_FRACTION;
+}
+
 void lba_list_t::shutdown_gc() {
     guarantee(state == state_ready);
     guarantee(coro_t::self() != NULL);
 
+    checkpoint_timer.reset();
     state = state_gc_shutting_down;
 
     // Wait for active GC coroutines to finish
@@ -4,6 +4,7 @@
 
 #include <functional>
 
+#include "arch/timing.hpp"
 #include "concurrency/signal.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "containers/scoped.hpp"
@@ -16,7 +17,7 @@
 class lba_start_fsm_t;
 class lba_syncer_t;
 
-class lba_list_t
+class lba_list_t : private repeating_timer_callback_t
 {
     friend class lba_start_fsm_t;
     friend class lba_syncer_t;
@@ -127,6 +128,21 @@ private:
     // gc. The integer is which shard to GC.
     bool we_want_to_gc(int i);
 
+    void start_gc(int lba_shard);
+
+    /* A garbage collection rewrites the live entries of a shard into a compact run of
+    extents, which is what startup reads first. Everything appended afterwards is a tail
+    that startup has to replay on top of it. `on_ring()` periodically rewrites shards
+    whose tail has grown long, even when they don't have enough garbage to be
+    collected. */
+    void on_ring();
+    bool we_want_to_checkpoint(int i);
+
+    // How many entries have been appended to each shard since it was last rewritten (or
+    // since we started up).
+    int64_t entries_since_checkpoint[LBA_SHARD_FACTOR];
+    scoped_ptr_t<repeating_timer_t> checkpoint_timer;
+
     DISABLE_COPYING(lba_list_t);
 };
 
@@ -1,23 +1,35 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "serializer/log/log_serializer.hpp"
 
+#include <inttypes.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <functional>
 
+#include "arch/arch.hpp"
 #include "arch/io/disk.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "buffer_cache/alt/blob.hpp"
 #include "buffer_cache/types.hpp"
 #include "logger.hpp"
 #include "perfmon/perfmon.hpp"
+#include "serializer/log/block_compression.hpp"
 #include "serializer/log/data_block_manager.hpp"
-
-filepath_file_opener_t::filepath_file_opener_t(const serializer_filepath_t &filepath,
-                                               io_backender_t *backender)
+#include "serializer/log/ssd_cache.hpp"
+#include "serializer/log/striped_file.hpp"
+
+filepath_file_opener_t::filepath_file_opener_t(
+        const serializer_filepath_t &filepath,
+        io_backender_t *backender,
+        const std::vector<serializer_filepath_t> &stripe_filepaths,
+        const boost::optional<ssd_cache_file_t> &cache_file)
     : filepath_(filepath),
+      stripe_filepaths_(stripe_filepaths),
+      cache_file_(cache_file),
       backender_(backender),
       opened_temporary_(false) { }
 
@@ -35,6 +47,14 @@ std::string filepath_file_opener_t::current_file_name() const {
     return opened_temporary_ ? temporary_file_name() : file_name();
 }
 
+std::vector<std::string> filepath_file_opener_t::current_stripe_file_names() const {
+    std::vector<std::string> names;
+    for (auto it = stripe_filepaths_.begin(); it != stripe_filepaths_.end(); ++it) {
+        names.push_back(opened_temporary_ ? it->temporary_path() : it->permanent_path());
+    }
+    return names;
+}
+
 void filepath_file_opener_t::open_serializer_file(const std::string &path, int extra_flags, scoped_ptr_t<file_t> *file_out) {
     const file_open_result_t res = open_file(path.c_str(),
                                              linux_file_t::mode_read | linux_file_t::mode_write | extra_flags,
@@ -53,10 +73,27 @@ void filepath_file_opener_t::open_serializer_file(const std::string &path, int e
     }
 }
 
+void filepath_file_opener_t::open_stripe_files(const std::vector<std::string> &paths,
+                                               int extra_flags,
+                                               scoped_ptr_t<file_t> *file_out) {
+    std::vector<scoped_ptr_t<file_t> > files;
+    files.push_back(std::move(*file_out));
+    for (auto it = paths.begin(); it != paths.end(); ++it) {
+        scoped_ptr_t<file_t> file;
+        open_serializer_file(*it, extra_flags, &file);
+        files.push_back(std::move(file));
+    }
+    file_out->init(new striped_file_t(std::move(files), SERIALIZER_STRIPE_SIZE));
+}
+
 void filepath_file_opener_t::open_serializer_file_create_temporary(scoped_ptr_t<file_t> *file_out) {
     mutex_assertion_t::acq_t acq(&reentrance_mutex_);
-    open_serializer_file(temporary_file_name(), linux_file_t::mode_create | linux_file_t::mode_truncate, file_out);
+    const int extra_flags = linux_file_t::mode_create | linux_file_t::mode_truncate;
+    open_serializer_file(temporary_file_name(), extra_flags, file_out);
     opened_temporary_ = true;
+    if (!stripe_filepaths_.empty()) {
+        open_stripe_files(current_stripe_file_names(), extra_flags, file_out);
+    }
 }
 
 void filepath_file_opener_t::move_serializer_file_to_permanent_location() {
@@ -66,6 +103,18 @@ void filepath_file_opener_t::move_serializer_file_to_permanent_location() {
     mutex_assertion_t::acq_t acq(&reentrance_mutex_);
 
     guarantee(opened_temporary_);
+
+    // The main file goes last, since whether it exists says whether the others do.
+    for (auto it = stripe_filepaths_.begin(); it != stripe_filepaths_.end(); ++it) {
+        const int stripe_res = ::rename(it->temporary_path().c_str(),
+                                        it->permanent_path().c_str());
+        if (stripe_res != 0) {
+            crash("Could not rename database file %s to permanent location %s\n",
+                  it->temporary_path().c_str(), it->permanent_path().c_str());
+        }
+        guarantee_fsync_parent_directory(it->permanent_path().c_str());
+    }
+
     const int res = ::rename(temporary_file_name().c_str(), file_name().c_str());
 
     if (res != 0) {
@@ -81,6 +130,26 @@ void filepath_file_opener_t::move_serializer_file_to_permanent_location() {
 void filepath_file_opener_t::open_serializer_file_existing(scoped_ptr_t<file_t> *file_out) {
     mutex_assertion_t::acq_t acq(&reentrance_mutex_);
     open_serializer_file(current_file_name(), 0, file_out);
+
+    // A file that was created without stripes stays that way.
+    const std::vector<std::string> stripe_names = current_stripe_file_names();
+    size_t num_stripes = 0;
+    for (auto it = stripe_names.begin(); it != stripe_names.end(); ++it) {
+        if (::access(it->c_str(), F_OK) == 0) {
+            ++num_stripes;
+        }
+    }
+    if (num_stripes == 0) {
+        return;
+    }
+    if (num_stripes != stripe_names.size()) {
+        fail_due_to_user_error("Database file \"%s\" is striped over %zu of the %zu "
+                               "stripe directories.  A table has to keep the stripe "
+                               "directories it was created with.",
+                               current_file_name().c_str(), num_stripes,
+                               stripe_names.size());
+    }
+    open_stripe_files(stripe_names, 0, file_out);
 }
 
 void filepath_file_opener_t::unlink_serializer_file() {
@@ -91,6 +160,30 @@ void filepath_file_opener_t::unlink_serializer_file() {
     guarantee(opened_temporary_);
     const int res = ::unlink(current_file_name().c_str());
     guarantee_err(res == 0, "unlink() failed");
+    const std::vector<std::string> stripe_names = current_stripe_file_names();
+    for (auto it = stripe_names.begin(); it != stripe_names.end(); ++it) {
+        const int stripe_res = ::unlink(it->c_str());
+        guarantee_err(stripe_res == 0, "unlink() failed");
+    }
+}
+
+void filepath_file_opener_t::open_cache_file(scoped_ptr_t<file_t> *file_out) {
+    if (!cache_file_) {
+        return;
+    }
+    // Without the cache, things are just slower, so we don't crash over it.
+    const file_open_result_t res
+        = open_file(cache_file_->path.c_str(),
+                    linux_file_t::mode_read | linux_file_t::mode_write
+                    | linux_file_t::mode_create | linux_file_t::mode_truncate,
+                    backender_, file_out);
+    if (res.outcome == file_open_result_t::ERROR) {
+        logWRN("Could not open the SSD cache file \"%s\" (%s), so the table in \"%s\" "
+               "will do without it.", cache_file_->path.c_str(),
+               errno_string(res.errsv).c_str(), file_name().c_str());
+        return;
+    }
+    (*file_out)->set_size(cache_file_->size);
 }
 
 #ifdef SEMANTIC_SERIALIZER_CHECK
@@ -115,6 +208,8 @@ void filepath_file_opener_t::open_semantic_checking_file(scoped_ptr_t<semantic_c
 log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
     : serializer_collection(),
       pm_serializer_block_reads(secs_to_ticks(1)),
+      pm_serializer_ssd_cache_hits(),
+      pm_serializer_ssd_cache_misses(),
       pm_serializer_index_reads(),
       pm_serializer_block_writes(),
       pm_serializer_index_writes(secs_to_ticks(1)),
@@ -131,6 +226,8 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
       parent_collection_membership(parent, &serializer_collection, "serializer"),
       stats_membership(&serializer_collection,
           &pm_serializer_block_reads, "serializer_block_reads",
+          &pm_serializer_ssd_cache_hits, "serializer_ssd_cache_hits",
+          &pm_serializer_ssd_cache_misses, "serializer_ssd_cache_misses",
           &pm_serializer_index_reads, "serializer_index_reads",
           &pm_serializer_block_writes, "serializer_block_writes",
           &pm_serializer_index_writes, "serializer_index_writes",
@@ -152,7 +249,7 @@ void log_serializer_t::create(serializer_file_opener_t *file_opener, static_conf
     scoped_ptr_t<file_t> file;
     file_opener->open_serializer_file_create_temporary(&file);
 
-    co_static_header_write(file.get(), on_disk_config, sizeof(*on_disk_config));
+    co_static_header_write(file.get(), false, on_disk_config, sizeof(*on_disk_config));
 
     metablock_t metablock;
     bzero(&metablock, sizeof(metablock));
@@ -189,6 +286,9 @@ struct ls_start_existing_fsm_t :
         rassert(ser->state == log_serializer_t::state_unstarted);
         ser->state = log_serializer_t::state_starting_up;
 
+        file_name = file_opener->file_name();
+        start_ticks = get_ticks();
+
         scoped_ptr_t<file_t> dbfile;
         file_opener->open_serializer_file_existing(&dbfile);
         ser->dbfile = dbfile.release();
@@ -211,6 +311,7 @@ struct ls_start_existing_fsm_t :
             if (static_header_read(ser->dbfile,
                     &ser->static_config,
                     sizeof(log_serializer_on_disk_static_config_t),
+                    &ser->unchecksummed_blocks,
                     this)) {
                 crash("static_header_read always returns false");
                 // start_existing_state = state_find_metablock;
@@ -226,6 +327,7 @@ struct ls_start_existing_fsm_t :
         if (start_existing_state == state_find_metablock) {
             // STATE D
             ser->extent_manager = new extent_manager_t(ser->dbfile, &ser->static_config,
+                                                       &ser->dynamic_config,
                                                        ser->stats.get());
             {
                 // We never end up releasing the static header extent reference.  Nobody says we
@@ -238,8 +340,17 @@ struct ls_start_existing_fsm_t :
             ser->metablock_manager = new mb_manager_t(ser->extent_manager);
             ser->lba_index = new lba_list_t(ser->extent_manager,
                     std::bind(&log_serializer_t::write_metablock, ser,
-                              std::placeholders::_1, std::placeholders::_2));
-            ser->data_block_manager = new data_block_manager_t(&ser->dynamic_config, ser->extent_manager, ser, &ser->static_config, ser->stats.get());
+                              std::placeholders::_1, std::function<void()>(),
+                              std::placeholders::_2));
+            if (ser->unchecksummed_blocks) {
+                logWRN("The database file \"%s\" is from serializer version %s, whose "
+                       "blocks have no checksums.  It is kept in that format, so its "
+                       "blocks won't be checked for corruption.  Use `rethinkdb dump` "
+                       "and `rethinkdb restore` to move the data to a new file if you "
+                       "want them checked.",
+                       file_name.c_str(), UNCHECKSUMMED_SERIALIZER_VERSION_STRING);
+            }
+            ser->data_block_manager = new data_block_manager_t(&ser->dynamic_config, ser->extent_manager, ser, &ser->static_config, ser->unchecksummed_blocks, ser->stats.get());
 
             // STATE E
             if (ser->metablock_manager->start_existing(ser->dbfile, &metablock_found, &metablock_buffer, this)) {
@@ -255,6 +366,7 @@ struct ls_start_existing_fsm_t :
         if (start_existing_state == state_start_lba) {
             // STATE G
             guarantee(metablock_found, "Could not find any valid metablock.");
+            lba_start_ticks = get_ticks();
 
             // STATE H
             if (ser->lba_index->start_existing(ser->dbfile, &metablock_buffer.lba_index_part, this)) {
@@ -269,6 +381,7 @@ struct ls_start_existing_fsm_t :
         }
 
         if (start_existing_state == state_reconstruct) {
+            reconstruct_start_ticks = get_ticks();
             ser->data_block_manager->start_reconstruct();
             start_existing_state = state_reconstruct_ongoing;
             num_blocks_reconstructed = 0;
@@ -298,6 +411,7 @@ struct ls_start_existing_fsm_t :
         }
 
         if (start_existing_state == state_finish) {
+            log_startup_timings();
             start_existing_state = state_done;
             rassert(ser->state == log_serializer_t::state_starting_up);
             ser->state = log_serializer_t::state_ready;
@@ -339,9 +453,33 @@ struct ls_start_existing_fsm_t :
         next_starting_up_step();
     }
 
+    // Startup of big files is dominated by reading the LBA and reconstructing the data
+    // block manager's view of the extents from it, so we log how long that takes.
+    void log_startup_timings() {
+        const ticks_t now = get_ticks();
+        const double total_secs = ticks_to_secs(now - start_ticks);
+        if (total_secs < SERIALIZER_STARTUP_LOG_THRESHOLD_SECS) {
+            return;
+        }
+        logINF("Loaded database file \"%s\" in %.2fs (metablock: %.2fs, "
+               "LBA: %.2fs, reconstructing %" PRIu64 " blocks: %.2fs).",
+               file_name.c_str(), total_secs,
+               ticks_to_secs(lba_start_ticks - start_ticks),
+               ticks_to_secs(reconstruct_start_ticks - lba_start_ticks),
+               static_cast<uint64_t>(ser->lba_index->end_block_id()),
+               ticks_to_secs(now - reconstruct_start_ticks));
+    }
+
     log_serializer_t *ser;
     cond_t *to_signal_when_done;
 
+    std::string file_name;
+    // When startup began, when we found the metablock and started reading the LBA,
+    // and when the LBA had been read and we started reconstructing.
+    ticks_t start_ticks;
+    ticks_t lba_start_ticks;
+    ticks_t reconstruct_start_ticks;
+
     enum state_t {
         state_start,
         state_read_static_header,
@@ -375,6 +513,7 @@ log_serializer_t::log_serializer_t(dynamic_config_t _dynamic_config, serializer_
       expecting_no_more_tokens(false),
 #endif
       dynamic_config(_dynamic_config),
+      unchecksummed_blocks(false),
       shutdown_callback(NULL),
       state(state_unstarted),
       dbfile(NULL),
@@ -388,6 +527,13 @@ log_serializer_t::log_serializer_t(dynamic_config_t _dynamic_config, serializer_
     ls_start_existing_fsm_t *s = new ls_start_existing_fsm_t(this);
     cond_t cond;
     if (!s->run(&cond, file_opener)) cond.wait();
+
+    scoped_ptr_t<file_t> cache_file;
+    file_opener->open_cache_file(&cache_file);
+    if (cache_file.has()) {
+        ssd_cache.init(new ssd_block_cache_t(std::move(cache_file),
+                                             static_config.block_size().ser_value()));
+    }
 }
 
 log_serializer_t::~log_serializer_t() {
@@ -400,10 +546,9 @@ log_serializer_t::~log_serializer_t() {
     rassert(active_write_count == 0);
 }
 
-scoped_malloc_t<ser_buffer_t> log_serializer_t::malloc() {
-    scoped_malloc_t<ser_buffer_t> buf(
-        malloc_aligned(static_config.block_size().ser_value(),
-                       DEVICE_BLOCK_SIZE));
+scoped_arena_ptr_t<ser_buffer_t> log_serializer_t::malloc() {
+    scoped_arena_ptr_t<ser_buffer_t> buf(
+        buffer_arena_malloc(max_block_size().ser_value()));
 
     return buf;
 }
@@ -423,12 +568,60 @@ void log_serializer_t::block_read(const counted_t<ls_block_token_pointee_t> &tok
     ticks_t pm_time;
     stats->pm_serializer_block_reads.begin(&pm_time);
 
-    data_block_manager->read(token->offset_, token->block_size().ser_value(),
-                             buf, io_account);
+    if (token->is_compressed()) {
+        scoped_arena_ptr_t<ser_buffer_t> compressed = malloc();
+        const uint32_t compressed_size
+            = read_block_data(token->offset_, token->on_disk_block_size().ser_value(),
+                              compressed.get(), io_account);
+
+        // Inflating a big block takes long enough to hold up everything else on
+        // this thread, so we leave that to the blocker pool.
+        if (static_config.block_size().ser_value() >= SERIALIZER_DECOMPRESSION_OFFLOAD_SIZE) {
+            thread_pool_t::run_in_blocker_pool(
+                std::bind(&decompress_block, compressed.get(), compressed_size,
+                          max_block_size(), buf));
+        } else {
+            decompress_block(compressed.get(), compressed_size,
+                             max_block_size(), buf);
+        }
+    } else {
+        read_block_data(token->offset_, token->on_disk_block_size().ser_value(), buf,
+                        io_account);
+    }
 
     stats->pm_serializer_block_reads.end(&pm_time);
 }
 
+uint32_t log_serializer_t::read_block_data(int64_t offset, uint32_t ser_block_size,
+                                           ser_buffer_t *buf,
+                                           file_account_t *io_account) {
+    if (!unchecksummed_blocks) {
+        read_block_bytes(offset, ser_block_size, buf, io_account);
+        return ser_block_size;
+    }
+    read_block_bytes(offset, ser_block_size,
+                     reinterpret_cast<char *>(buf) + LS_UNCHECKSUMMED_HEADER_SHORTFALL,
+                     io_account);
+    unchecksummed_block_to_buffer(buf);
+    return ser_block_size + LS_UNCHECKSUMMED_HEADER_SHORTFALL;
+}
+
+void log_serializer_t::read_block_bytes(int64_t offset, uint32_t ser_block_size,
+                                        void *buf, file_account_t *io_account) {
+    if (!ssd_cache.has()) {
+        data_block_manager->read(offset, ser_block_size, buf, io_account);
+        return;
+    }
+    if (ssd_cache->read(offset, ser_block_size, buf)) {
+        ++stats->pm_serializer_ssd_cache_hits;
+        return;
+    }
+    ++stats->pm_serializer_ssd_cache_misses;
+    data_block_manager->read(offset, ser_block_size, buf, io_account);
+    // The caller's token keeps the offset from being forgotten until we're done.
+    ssd_cache->offer(offset, ser_block_size, buf);
+}
+
 // God this is such a hack.
 #ifndef SEMANTIC_SERIALIZER_CHECK
 counted_t<ls_block_token_pointee_t>
@@ -447,7 +640,9 @@ get_ls_block_token(const counted_t<scs_block_token_t<log_serializer_t> >& tok) {
 #endif  // SEMANTIC_SERIALIZER_CHECK
 
 
-void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_ops, file_account_t *io_account) {
+void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_ops,
+                                   const std::function<void()> &on_writes_reflected,
+                                   file_account_t *io_account) {
     assert_thread();
     ticks_t pm_time;
     stats->pm_serializer_index_writes.begin(&pm_time);
@@ -482,10 +677,11 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_op
                 // Write new token to index, or remove from index as appropriate.
                 if (token.has()) {
                     offset = flagged_off64_t::make(token->offset_);
-                    ser_block_size = token->block_size().ser_value();
+                    ser_block_size = token->on_disk_block_size().ser_value();
 
                     /* mark the life */
-                    data_block_manager->mark_live(offset.get_value(), token->block_size());
+                    data_block_manager->mark_live(offset.get_value(),
+                                                  token->on_disk_block_size());
                 } else {
                     offset = flagged_off64_t::unused();
                     ser_block_size = 0;
@@ -501,7 +697,7 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t> &write_op
         }
     }
 
-    index_write_finish(&txn, io_account);
+    index_write_finish(&txn, on_writes_reflected, io_account);
 
     stats->pm_serializer_index_writes.end(&pm_time);
 }
@@ -517,7 +713,9 @@ void log_serializer_t::index_write_prepare(extent_transaction_t *txn) {
     extent_manager->begin_transaction(txn);
 }
 
-void log_serializer_t::index_write_finish(extent_transaction_t *txn, file_account_t *io_account) {
+void log_serializer_t::index_write_finish(extent_transaction_t *txn,
+                                          const std::function<void()> &on_writes_reflected,
+                                          file_account_t *io_account) {
     /* Sync the LBA */
     struct : public cond_t, public lba_list_t::sync_callback_t {
         void on_lba_sync() { pulse(); }
@@ -529,7 +727,7 @@ void log_serializer_t::index_write_finish(extent_transaction_t *txn, file_accoun
     extent_manager->end_transaction(txn);
 
     /* Write the metablock */
-    write_metablock(on_lba_sync, io_account);
+    write_metablock(on_lba_sync, on_writes_reflected, io_account);
 
     active_write_count--;
 
@@ -551,6 +749,7 @@ void log_serializer_t::index_write_finish(extent_transaction_t *txn, file_accoun
 }
 
 void log_serializer_t::write_metablock(const signal_t &safe_to_write_cond,
+                                       const std::function<void()> &on_in_line,
                                        file_account_t *io_account) {
     assert_thread();
     metablock_t mb_buffer;
@@ -565,6 +764,12 @@ void log_serializer_t::write_metablock(const signal_t &safe_to_write_cond,
     cond_t on_prev_write_submitted_metablock;
     metablock_waiter_queue.push_back(&on_prev_write_submitted_metablock);
 
+    /* From here on, a later index write can only write its metablock after ours, and
+    the extent manager transaction is over, so our caller can let one begin. */
+    if (on_in_line) {
+        on_in_line();
+    }
+
     safe_to_write_cond.wait();
     if (waiting_for_prev_write) on_prev_write_submitted_metablock.wait();
     guarantee(metablock_waiter_queue.front() == &on_prev_write_submitted_metablock);
@@ -600,8 +805,65 @@ log_serializer_t::block_writes(const std::vector<buf_write_info_t> &write_infos,
     assert_thread();
     stats->pm_serializer_block_writes += write_infos.size();
 
+    for (auto it = write_infos.begin(); it != write_infos.end(); ++it) {
+        // A smaller block would be mistaken for a compressed one when it's read.
+        guarantee(it->block_size == max_block_size());
+        // (Compressed copies of the block keep its header.)
+        it->buf->ser_header.flags
+            = dynamic_config.separate_value_blocks && blob::is_blob_block(it->buf->cache_data)
+            ? LS_BUF_VALUE_BLOCK : 0;
+    }
+
+    if (!dynamic_config.compress_blocks && !unchecksummed_blocks) {
+        std::vector<counted_t<ls_block_token_pointee_t> > result
+            = data_block_manager->many_writes(write_infos, io_account, cb);
+        guarantee(result.size() == write_infos.size());
+        return result;
+    }
+
+    // Holds on to the blocks we write instead of the callers' until they have been
+    // written.
+    struct compressed_writes_t : public iocallback_t {
+        void on_io_complete() {
+            iocallback_t *local_cb = cb;
+            delete this;
+            local_cb->on_io_complete();
+        }
+
+        std::vector<scoped_arena_ptr_t<ser_buffer_t> > bufs;
+        iocallback_t *cb;
+    };
+
+    compressed_writes_t *compressed_writes = new compressed_writes_t;
+    compressed_writes->cb = cb;
+
+    std::vector<buf_write_info_t> infos;
+    infos.reserve(write_infos.size());
+    for (auto it = write_infos.begin(); it != write_infos.end(); ++it) {
+        scoped_arena_ptr_t<ser_buffer_t> buf = malloc();
+        if (unchecksummed_blocks) {
+            // We keep the file in its own format, which has no room for the header
+            // of a compressed block either.
+            buffer_to_unchecksummed_block(it->buf, it->block_size, buf.get());
+            infos.push_back(buf_write_info_t(buf.get(), static_config.block_size(),
+                                             it->block_id));
+            compressed_writes->bufs.push_back(std::move(buf));
+            continue;
+        }
+        const uint32_t compressed_size = compress_block(it->buf, it->block_size,
+                                                        buf.get());
+        if (compressed_size != 0) {
+            infos.push_back(buf_write_info_t(buf.get(),
+                                             block_size_t::unsafe_make(compressed_size),
+                                             it->block_id));
+            compressed_writes->bufs.push_back(std::move(buf));
+        } else {
+            infos.push_back(*it);
+        }
+    }
+
     std::vector<counted_t<ls_block_token_pointee_t> > result
-        = data_block_manager->many_writes(write_infos, io_account, cb);
+        = data_block_manager->many_writes(infos, io_account, compressed_writes);
     guarantee(result.size() == write_infos.size());
     return result;
 }
@@ -650,6 +912,10 @@ void log_serializer_t::unregister_block_token(ls_block_token_pointee_t *token) {
     if (last_token_for_offset) {
         // Mark offset garbage in GC
         data_block_manager->mark_garbage_tokenwise_with_offset(token->offset_);
+        // Nobody can read the block any more, and its space may get reused.
+        if (ssd_cache.has()) {
+            ssd_cache->forget(token->offset_);
+        }
     }
 
     if (offset_tokens.empty() && state == state_shutting_down && shutdown_state == shutdown_waiting_on_block_tokens) {
@@ -690,11 +956,19 @@ void log_serializer_t::remap_block_to_new_offset(int64_t current_offset, int64_t
 
         data_block_manager->mark_garbage_tokenwise_with_offset(current_offset);
         data_block_manager->mark_live_tokenwise_with_offset(new_offset);
+        if (ssd_cache.has()) {
+            ssd_cache->move(current_offset, new_offset);
+        }
     }
 }
 
 block_size_t log_serializer_t::max_block_size() const {
-    return static_config.block_size();
+    // An unchecksummed block gets a longer header in memory than on disk, and keeps
+    // all of its cache data.
+    return unchecksummed_blocks
+        ? block_size_t::unsafe_make(static_config.block_size().ser_value()
+                                    + LS_UNCHECKSUMMED_HEADER_SHORTFALL)
+        : static_config.block_size();
 }
 
 bool log_serializer_t::coop_lock_and_check() {
@@ -703,6 +977,53 @@ bool log_serializer_t::coop_lock_and_check() {
     return dbfile->coop_lock_and_check();
 }
 
+void log_serializer_t::backup(file_t *target, signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t) {
+    assert_thread();
+    guarantee(state == state_ready);
+
+    metablock_t metablock;
+    std::vector<extent_reference_t> extent_refs;
+    {
+        // Extents are only freed once a metablock that doesn't point to them has been
+        // written, so everything the newest metablock points to is still in use.
+        ASSERT_NO_CORO_WAITING;
+        metablock_manager->get_last_written_metablock(&metablock);
+        extent_refs = extent_manager->copy_extent_references_in_use();
+    }
+
+    try {
+        const int64_t extent_size = static_config.extent_size();
+        co_static_header_write(target, unchecksummed_blocks, &static_config,
+                               sizeof(log_serializer_on_disk_static_config_t));
+        target->set_size_at_least(extent_refs.back().offset() + extent_size);
+
+        scoped_ptr_t<file_account_t> io_account
+            = make_scoped<file_account_t>(dbfile, BACKUP_IO_PRIORITY);
+        scoped_malloc_t<char> buf(malloc_aligned(extent_size, DEVICE_BLOCK_SIZE));
+        for (auto it = extent_refs.begin(); it != extent_refs.end(); ++it) {
+            // The first extent only holds the static header and the metablocks, which
+            // are written anew.
+            if (it->offset() == 0) {
+                continue;
+            }
+            if (interruptor->is_pulsed()) {
+                throw interrupted_exc_t();
+            }
+            co_read(dbfile, it->offset(), extent_size, buf.get(), io_account.get());
+            co_write(target, it->offset(), extent_size, buf.get(),
+                     DEFAULT_DISK_ACCOUNT, file_t::NO_DATASYNCS);
+        }
+
+        // This syncs the extents before it writes the metablock.
+        mb_manager_t::create(target, extent_size, &metablock);
+    } catch (const interrupted_exc_t &) {
+        extent_manager->release_extent_references(std::move(extent_refs));
+        throw;
+    }
+    extent_manager->release_extent_references(std::move(extent_refs));
+}
+
 // TODO: Should be called end_block_id I guess (or should subtract 1 frim end_block_id?
 block_id_t log_serializer_t::max_block_id() {
     assert_thread();
@@ -884,11 +1205,11 @@ void log_serializer_t::unregister_read_ahead_cb(serializer_read_ahead_callback_t
 
 void log_serializer_t::offer_buf_to_read_ahead_callbacks(
         block_id_t block_id,
-        scoped_malloc_t<ser_buffer_t> &&buf,
+        scoped_arena_ptr_t<ser_buffer_t> &&buf,
         const counted_t<standard_block_token_t> &token) {
     assert_thread();
 
-    scoped_malloc_t<ser_buffer_t> local_buf = std::move(buf);
+    scoped_arena_ptr_t<ser_buffer_t> local_buf = std::move(buf);
     for (size_t i = 0; local_buf.has() && i < read_ahead_callbacks.size(); ++i) {
         read_ahead_callbacks[i]->offer_read_ahead_buf(block_id,
                                                       &local_buf,
@@ -910,6 +1231,17 @@ ls_block_token_pointee_t::ls_block_token_pointee_t(log_serializer_t *serializer,
     serializer_->register_block_token(this, initial_offset);
 }
 
+block_size_t ls_block_token_pointee_t::block_size() const {
+    // Every block is written at that size, and comes back at it when read even if
+    // it's compressed or unchecksummed on disk.
+    return serializer_->max_block_size();
+}
+
+bool ls_block_token_pointee_t::is_compressed() const {
+    // See block_compression.hpp.
+    return block_size_.ser_value() < serializer_->static_config.block_size().ser_value();
+}
+
 void ls_block_token_pointee_t::do_destroy() {
     serializer_->assert_thread();
     rassert(ref_count_ == 0);
@@ -921,7 +1253,7 @@ void debug_print(printf_buffer_t *buf,
                  const counted_t<ls_block_token_pointee_t> &token) {
     if (token.has()) {
         buf->appendf("ls_block_token{%" PRIi64 ", +%" PRIu32 "}",
-                     token->offset(), token->block_size().ser_value());
+                     token->offset(), token->on_disk_block_size().ser_value());
     } else {
         buf->appendf("nil");
     }
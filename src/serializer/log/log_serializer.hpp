@@ -22,6 +22,7 @@
 
 class cond_t;
 class data_block_manager_t;
+class ssd_block_cache_t;
 struct block_magic_t;
 class io_backender_t;
 class log_serializer_t;
@@ -54,11 +55,26 @@ struct log_serializer_metablock_t {
 // TODO: This header data should maybe go to the cache
 typedef metablock_manager_t<log_serializer_metablock_t> mb_manager_t;
 
-// Used to open a file (with the given filepath) for the log serializer.
+// Where a serializer keeps its SSD cache, and how big the cache is.
+struct ssd_cache_file_t {
+    ssd_cache_file_t(const std::string &_path, int64_t _size)
+        : path(_path), size(_size) { }
+    std::string path;
+    int64_t size;
+};
+
+// Used to open a file (with the given filepath) for the log serializer.  If
+// `stripe_filepaths` isn't empty, a new file is striped over it and `filepath` (see
+// `striped_file_t`), and an existing file is too if it was created that way.  If
+// `cache_file` is set, the serializer caches blocks there (see `ssd_block_cache_t`).
 class filepath_file_opener_t : public serializer_file_opener_t {
 public:
     filepath_file_opener_t(const serializer_filepath_t &filepath,
-                           io_backender_t *backender);
+                           io_backender_t *backender,
+                           const std::vector<serializer_filepath_t> &stripe_filepaths
+                               = std::vector<serializer_filepath_t>(),
+                           const boost::optional<ssd_cache_file_t> &cache_file
+                               = boost::none);
     ~filepath_file_opener_t();
 
     // The path of the final position of the file.
@@ -68,6 +84,7 @@ public:
     void move_serializer_file_to_permanent_location();
     void open_serializer_file_existing(scoped_ptr_t<file_t> *file_out);
     void unlink_serializer_file();
+    void open_cache_file(scoped_ptr_t<file_t> *file_out);
 #ifdef SEMANTIC_SERIALIZER_CHECK
     void open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out);
 #endif
@@ -75,6 +92,14 @@ public:
 private:
     void open_serializer_file(const std::string &path, int extra_flags, scoped_ptr_t<file_t> *file_out);
 
+    // Opens the stripe files (with the given paths) and stripes `*file_out` over
+    // them too.
+    void open_stripe_files(const std::vector<std::string> &paths, int extra_flags,
+                           scoped_ptr_t<file_t> *file_out);
+
+    // The current names of the stripe files, like current_file_name().
+    std::vector<std::string> current_stripe_file_names() const;
+
     // The path of the temporary file.  This is file_name() with some suffix appended.
     std::string temporary_file_name() const;
 
@@ -84,6 +109,11 @@ private:
     // The filepath of the final position of the file.
     const serializer_filepath_t filepath_;
 
+    // The other files of a striped file.
+    const std::vector<serializer_filepath_t> stripe_filepaths_;
+
+    const boost::optional<ssd_cache_file_t> cache_file_;
+
     io_backender_t *const backender_;
 
     // Makes sure that only one member function gets called at a time.  Some of them are blocking,
@@ -136,7 +166,7 @@ public:
 
 public:
     /* Implementation of the serializer_t API */
-    scoped_malloc_t<ser_buffer_t> malloc();
+    scoped_arena_ptr_t<ser_buffer_t> malloc();
 
 #ifndef SEMANTIC_SERIALIZER_CHECK
     using serializer_t::make_io_account;
@@ -154,7 +184,12 @@ public:
 
     void block_read(const counted_t<ls_block_token_pointee_t> &token, ser_buffer_t *buf, file_account_t *io_account);
 
-    void index_write(const std::vector<index_write_op_t> &write_ops, file_account_t *io_account);
+#ifndef SEMANTIC_SERIALIZER_CHECK
+    using serializer_t::index_write;
+#endif
+    void index_write(const std::vector<index_write_op_t> &write_ops,
+                     const std::function<void()> &on_writes_reflected,
+                     file_account_t *io_account);
 
     std::vector<counted_t<ls_block_token_pointee_t> > block_writes(const std::vector<buf_write_info_t> &write_infos,
                                                                    file_account_t *io_account, iocallback_t *cb);
@@ -163,6 +198,14 @@ public:
 
     bool coop_lock_and_check();
 
+    /* Copies the serializer's contents, as of the newest metablock on disk, to
+    `target`, which becomes a serializer file of its own.  Reads and writes carry on
+    meanwhile: the extents the metablock points to are kept from being reused (or
+    garbage collected away) until the copy is done, so nothing it needs gets
+    overwritten.  Only the extents that are in use are copied.  Must not overlap with
+    the serializer's shutdown. */
+    void backup(file_t *target, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
+
 private:
     void register_block_token(ls_block_token_pointee_t *token, int64_t offset);
     bool tokens_exist_for_offset(int64_t off);
@@ -171,16 +214,26 @@ private:
     counted_t<ls_block_token_pointee_t> generate_block_token(int64_t offset,
                                                              block_size_t block_size);
 
+    // Reads a block (that is, `ser_block_size` bytes of it on disk) into `buf` in the
+    // layout it has in memory, and returns its ser_block_size in that layout.
+    uint32_t read_block_data(int64_t offset, uint32_t ser_block_size, ser_buffer_t *buf,
+                             file_account_t *io_account);
+    // Reads a block's bytes as they are on disk, from the SSD cache if it has them.
+    void read_block_bytes(int64_t offset, uint32_t ser_block_size, void *buf,
+                          file_account_t *io_account);
+
     void offer_buf_to_read_ahead_callbacks(
             block_id_t block_id,
-            scoped_malloc_t<ser_buffer_t> &&buf,
+            scoped_arena_ptr_t<ser_buffer_t> &&buf,
             const counted_t<standard_block_token_t>& token);
     bool should_perform_read_ahead();
 
     /* Starts a new transaction, updates perfmons etc. */
     void index_write_prepare(extent_transaction_t *txn);
     /* Finishes a write transaction */
-    void index_write_finish(extent_transaction_t *txn, file_account_t *io_account);
+    void index_write_finish(extent_transaction_t *txn,
+                            const std::function<void()> &on_writes_reflected,
+                            file_account_t *io_account);
 
     /* This mess is because the serializer is still mostly FSM-based */
     bool shutdown(cond_t *cb);
@@ -191,8 +244,12 @@ private:
     /* Prepare a new metablock, then wait until safe_to_write_cond is pulsed.
     Finally write the new metablock to disk. Returns once the write is complete.
     This function writes the metablock in the state that it has when called, i.e.
-    it does not block between calling and preparing the new metablock. */
-    void write_metablock(const signal_t &safe_to_write_cond, file_account_t *io_account);
+    it does not block between calling and preparing the new metablock.  Calls
+    on_in_line (unless it's empty) once it has gotten in line for the metablock
+    manager, before it blocks. */
+    void write_metablock(const signal_t &safe_to_write_cond,
+                         const std::function<void()> &on_in_line,
+                         file_account_t *io_account);
 
     typedef log_serializer_metablock_t metablock_t;
     void prepare_metablock(metablock_t *mb_buffer);
@@ -214,6 +271,9 @@ private:
 
     const dynamic_config_t dynamic_config;
     static_config_t static_config;
+    // Whether the file is from serializer version
+    // UNCHECKSUMMED_SERIALIZER_VERSION_STRING, which we keep it in.
+    bool unchecksummed_blocks;
 
     cond_t *shutdown_callback;
 
@@ -240,6 +300,9 @@ private:
     lba_list_t *lba_index;
     data_block_manager_t *data_block_manager;
 
+    // Empty unless the file opener gave us a cache file.
+    scoped_ptr_t<ssd_block_cache_t> ssd_cache;
+
     /* The running index writes organize themselves into a list so that they can be sure to
     write their metablocks in the correct order. The first element in the list
     is the oldest transaction that started but did not finish. */
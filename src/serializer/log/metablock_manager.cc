@@ -216,6 +216,7 @@ void metablock_manager_t<metablock_t>::co_start_existing(file_t *file, bool *mb_
         *mb_found = true;
         memcpy(mb_buffer, last_good_mb, METABLOCK_SIZE);
         memcpy(mb_out, &(mb_buffer->metablock), sizeof(metablock_t));
+        last_written_metablock = mb_buffer->metablock;
     }
     mb_buffer_in_use = false;
     state = state_ready;
@@ -251,6 +252,7 @@ void metablock_manager_t<metablock_t>::co_write_metablock(metablock_t *mb, file_
 
     ++head;
 
+    last_written_metablock = *mb;
     state = state_ready;
     mb_buffer_in_use = false;
 }
@@ -267,6 +269,12 @@ bool metablock_manager_t<metablock_t>::write_metablock(metablock_t *mb, file_acc
     return false;
 }
 
+template<class metablock_t>
+void metablock_manager_t<metablock_t>::get_last_written_metablock(metablock_t *mb_out) const {
+    rassert(state == state_ready || state == state_writing);
+    *mb_out = last_written_metablock;
+}
+
 template<class metablock_t>
 void metablock_manager_t<metablock_t>::shutdown() {
 
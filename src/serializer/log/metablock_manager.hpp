@@ -98,6 +98,10 @@ public:
     bool write_metablock(metablock_t *mb, file_account_t *io_account, metablock_write_callback_t *cb);
     void co_write_metablock(metablock_t *mb, file_account_t *io_account);
 
+    /* The newest metablock that's on disk.  What it points to stays valid at least
+    until a later write of `write_metablock()` has finished. */
+    void get_last_written_metablock(metablock_t *mb_out) const;
+
     void shutdown();
 
     void read_next_metablock();
@@ -142,6 +146,8 @@ private:
     // true: we're using the buffer, no one else can
     bool mb_buffer_in_use;
 
+    metablock_t last_written_metablock;
+
     // Just some compartmentalization to make this mildly cleaner.
     struct startup {
         /* these are only used in the beginning when we want to find the metablock */
@@ -0,0 +1,152 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/ssd_cache.hpp"
+
+#include <string.h>
+
+#include <functional>
+
+#include "arch/arch.hpp"
+#include "arch/crc32c.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "config/args.hpp"
+
+ssd_block_cache_t::ssd_block_cache_t(scoped_ptr_t<file_t> &&_file,
+                                     uint32_t max_block_size)
+    : file(std::move(_file)),
+      slot_size(ceil_aligned(max_block_size, DEVICE_BLOCK_SIZE)),
+      writes_in_flight(0) {
+    read_account.init(new file_account_t(file.get(), CACHE_READS_IO_PRIORITY));
+    write_account.init(new file_account_t(file.get(), SSD_CACHE_WRITES_IO_PRIORITY));
+
+    const size_t num = file->get_size() / slot_size;
+    slot_generations.resize(num, 0);
+    free_slots.reserve(num);
+    // Hand out the slots at the start of the file first.
+    for (size_t i = num; i > 0; --i) {
+        free_slots.push_back(i - 1);
+    }
+}
+
+ssd_block_cache_t::~ssd_block_cache_t() {
+    assert_thread();
+}
+
+bool ssd_block_cache_t::read(int64_t offset, uint32_t size, void *buf) {
+    assert_thread();
+    auto it = entries.find(offset);
+    if (it == entries.end() || !it->second.ready || it->second.size != size) {
+        return false;
+    }
+    const size_t slot = it->second.slot;
+    const uint64_t generation = it->second.generation;
+    lru.splice(lru.begin(), lru, it->second.lru_position);
+
+    scoped_malloc_t<char> data(malloc_aligned(slot_size, DEVICE_BLOCK_SIZE));
+    co_read(file.get(), slot * slot_size, slot_size, data.get(), read_account.get());
+
+    // The block may have been dropped (and its slot reused) while we were reading.
+    it = entries.find(offset);
+    if (it == entries.end() || it->second.slot != slot
+        || it->second.generation != generation) {
+        return false;
+    }
+    if (crc32c(0, data.get(), size) != it->second.checksum) {
+        drop(it);
+        return false;
+    }
+    memcpy(buf, data.get(), size);
+    return true;
+}
+
+void ssd_block_cache_t::offer(int64_t offset, uint32_t size, const void *buf) {
+    assert_thread();
+    guarantee(size <= slot_size);
+    if (entries.count(offset) != 0 || writes_in_flight >= SSD_CACHE_MAX_WRITES_IN_FLIGHT) {
+        // If the device can't keep up, the block just doesn't get cached.
+        return;
+    }
+    size_t slot;
+    if (!take_slot(&slot)) {
+        return;
+    }
+    const uint64_t generation = ++slot_generations[slot];
+
+    entry_t entry;
+    entry.slot = slot;
+    entry.generation = generation;
+    entry.size = size;
+    entry.checksum = crc32c(0, buf, size);
+    entry.ready = false;
+    entry.lru_position = lru.insert(lru.begin(), offset);
+    entries.insert(std::make_pair(offset, entry));
+
+    char *data = static_cast<char *>(malloc_aligned(slot_size, DEVICE_BLOCK_SIZE));
+    memcpy(data, buf, size);
+    memset(data + size, 0, slot_size - size);
+    ++writes_in_flight;
+    coro_t::spawn_sometime(std::bind(&ssd_block_cache_t::write_slot, this,
+                                     offset, slot, generation, data,
+                                     auto_drainer_t::lock_t(&drainer)));
+}
+
+void ssd_block_cache_t::write_slot(int64_t offset, size_t slot, uint64_t generation,
+                                   char *data, auto_drainer_t::lock_t) {
+    scoped_malloc_t<char> holder(data);
+    co_write(file.get(), slot * slot_size, slot_size, data, write_account.get(),
+             file_t::NO_DATASYNCS);
+    --writes_in_flight;
+
+    auto it = entries.find(offset);
+    if (it != entries.end() && it->second.slot == slot
+        && it->second.generation == generation) {
+        it->second.ready = true;
+    }
+}
+
+void ssd_block_cache_t::move(int64_t offset, int64_t new_offset) {
+    assert_thread();
+    auto it = entries.find(offset);
+    if (it == entries.end()) {
+        return;
+    }
+    if (!it->second.ready || entries.count(new_offset) != 0) {
+        // (The write's completion would look for the block under its old offset.)
+        drop(it);
+        return;
+    }
+    entry_t entry = it->second;
+    entries.erase(it);
+    *entry.lru_position = new_offset;
+    entries.insert(std::make_pair(new_offset, entry));
+}
+
+void ssd_block_cache_t::forget(int64_t offset) {
+    assert_thread();
+    auto it = entries.find(offset);
+    if (it != entries.end()) {
+        drop(it);
+    }
+}
+
+bool ssd_block_cache_t::take_slot(size_t *slot_out) {
+    if (free_slots.empty()) {
+        if (lru.empty()) {
+            // The file is too small to hold any blocks.
+            return false;
+        }
+        drop(entries.find(lru.back()));
+    }
+    *slot_out = free_slots.back();
+    free_slots.pop_back();
+    return true;
+}
+
+void ssd_block_cache_t::drop(std::unordered_map<int64_t, entry_t>::iterator it) {
+    guarantee(it != entries.end());
+    // If the block is still being written, the slot's next user gets a new
+    // generation, so the write's completion is ignored.  A write that lands after the
+    // next user's is caught by the checksum.
+    free_slots.push_back(it->second.slot);
+    lru.erase(it->second.lru_position);
+    entries.erase(it);
+}
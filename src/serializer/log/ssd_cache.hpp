@@ -0,0 +1,86 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_SSD_CACHE_HPP_
+#define SERIALIZER_LOG_SSD_CACHE_HPP_
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "arch/types.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "containers/scoped.hpp"
+#include "utils.hpp"
+
+/* A second-level block cache, in a file on a faster device than the data file (say,
+an SSD in front of a HDD RAID).  The page cache only asks the serializer for blocks it
+doesn't have, so the log serializer offers every block it reads from the data file to
+this cache, and reads of it after the page cache has let it go come from the faster
+device instead.
+
+Blocks are found by their offset in the data file.  What's at an offset can't change
+while there are block tokens for it, and the serializer forgets an offset as soon as
+the last token for it goes away (and moves it along when the GC moves the block), so
+the cache never returns stale blocks.  A checksum kept in memory catches the rest.
+The cache starts out empty every time. */
+class ssd_block_cache_t : public home_thread_mixin_t {
+public:
+    // Uses all of `file`, in slots big enough for a block of `max_block_size` bytes.
+    ssd_block_cache_t(scoped_ptr_t<file_t> &&file, uint32_t max_block_size);
+    ~ssd_block_cache_t();
+
+    // Reads the `size` bytes of the block at `offset` in the data file into `buf`, and
+    // returns true, if they're in the cache.  Blocks the coroutine.
+    bool read(int64_t offset, uint32_t size, void *buf);
+
+    // Offers the `size` bytes of the block at `offset` that were just read from the
+    // data file.  The cache writes them in the background, if it takes them.
+    void offer(int64_t offset, uint32_t size, const void *buf);
+
+    // The block at `offset` was moved to `new_offset`.
+    void move(int64_t offset, int64_t new_offset);
+
+    // The block at `offset` is gone.
+    void forget(int64_t offset);
+
+    size_t num_slots() const { return slot_generations.size(); }
+
+private:
+    struct entry_t {
+        size_t slot;
+        // Which use of the slot this is, see `slot_generations`.
+        uint64_t generation;
+        uint32_t size;
+        uint32_t checksum;
+        // Whether the block has been written to its slot yet.
+        bool ready;
+        std::list<int64_t>::iterator lru_position;
+    };
+
+    void write_slot(int64_t offset, size_t slot, uint64_t generation, char *data,
+                    auto_drainer_t::lock_t keepalive);
+
+    // Drops the least recently used entry if there's no free slot.
+    bool take_slot(size_t *slot_out);
+
+    void drop(std::unordered_map<int64_t, entry_t>::iterator it);
+
+    scoped_ptr_t<file_t> file;
+    scoped_ptr_t<file_account_t> read_account;
+    scoped_ptr_t<file_account_t> write_account;
+    const int64_t slot_size;
+
+    std::unordered_map<int64_t, entry_t> entries;
+    // The offsets of the blocks in `entries`, most recently used first.
+    std::list<int64_t> lru;
+    std::vector<size_t> free_slots;
+    // Incremented each time a slot is given to a block, so that a read or write of
+    // the slot that finishes after that knows it's out of date.
+    std::vector<uint64_t> slot_generations;
+    int writes_in_flight;
+
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(ssd_block_cache_t);
+};
+
+#endif  // SERIALIZER_LOG_SSD_CACHE_HPP_
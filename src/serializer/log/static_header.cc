@@ -21,7 +21,7 @@ bool static_header_check(file_t *file) {
     }
 }
 
-void co_static_header_write(file_t *file, void *data, size_t data_size) {
+void co_static_header_write(file_t *file, bool unchecksummed_blocks, void *data, size_t data_size) {
     static_header_t *buffer = reinterpret_cast<static_header_t *>(malloc_aligned(DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE));
     rassert(sizeof(static_header_t) + data_size < DEVICE_BLOCK_SIZE);
 
@@ -33,7 +33,13 @@ void co_static_header_write(file_t *file, void *data, size_t data_size) {
     memcpy(buffer->software_name, SOFTWARE_NAME_STRING, sizeof(SOFTWARE_NAME_STRING));
 
     rassert(sizeof(SERIALIZER_VERSION_STRING) < 16);
-    memcpy(buffer->version, SERIALIZER_VERSION_STRING, sizeof(SERIALIZER_VERSION_STRING));
+    rassert(sizeof(UNCHECKSUMMED_SERIALIZER_VERSION_STRING) < 16);
+    if (unchecksummed_blocks) {
+        memcpy(buffer->version, UNCHECKSUMMED_SERIALIZER_VERSION_STRING,
+               sizeof(UNCHECKSUMMED_SERIALIZER_VERSION_STRING));
+    } else {
+        memcpy(buffer->version, SERIALIZER_VERSION_STRING, sizeof(SERIALIZER_VERSION_STRING));
+    }
 
     memcpy(buffer->data, data, data_size);
 
@@ -45,7 +51,7 @@ void co_static_header_write(file_t *file, void *data, size_t data_size) {
 }
 
 void co_static_header_write_helper(file_t *file, static_header_write_callback_t *cb, void *data, size_t data_size) {
-    co_static_header_write(file, data, data_size);
+    co_static_header_write(file, false, data, data_size);
     cb->on_static_header_write();
 }
 
@@ -54,7 +60,7 @@ bool static_header_write(file_t *file, void *data, size_t data_size, static_head
     return false;
 }
 
-void co_static_header_read(file_t *file, static_header_read_callback_t *callback, void *data_out, size_t data_size) {
+void co_static_header_read(file_t *file, static_header_read_callback_t *callback, void *data_out, size_t data_size, bool *unchecksummed_blocks_out) {
     rassert(sizeof(static_header_t) + data_size < DEVICE_BLOCK_SIZE);
     static_header_t *buffer = reinterpret_cast<static_header_t *>(malloc_aligned(DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE));
     co_read(file, 0, DEVICE_BLOCK_SIZE, buffer, DEFAULT_DISK_ACCOUNT);
@@ -62,7 +68,11 @@ void co_static_header_read(file_t *file, static_header_read_callback_t *callback
         fail_due_to_user_error("This doesn't appear to be a RethinkDB data file.");
     }
 
-    if (memcmp(buffer->version, SERIALIZER_VERSION_STRING, sizeof(SERIALIZER_VERSION_STRING)) != 0) {
+    *unchecksummed_blocks_out
+        = memcmp(buffer->version, UNCHECKSUMMED_SERIALIZER_VERSION_STRING,
+                 sizeof(UNCHECKSUMMED_SERIALIZER_VERSION_STRING)) == 0;
+    if (!*unchecksummed_blocks_out
+        && memcmp(buffer->version, SERIALIZER_VERSION_STRING, sizeof(SERIALIZER_VERSION_STRING)) != 0) {
         fail_due_to_user_error("File version is incorrect. This file was created with "
                                "RethinkDB's serializer version %s, but you are trying "
                                "to read it with version %s.  See "
@@ -76,7 +86,7 @@ void co_static_header_read(file_t *file, static_header_read_callback_t *callback
     free(buffer);
 }
 
-bool static_header_read(file_t *file, void *data_out, size_t data_size, static_header_read_callback_t *cb) {
-    coro_t::spawn_later_ordered(boost::bind(co_static_header_read, file, cb, data_out, data_size));
+bool static_header_read(file_t *file, void *data_out, size_t data_size, bool *unchecksummed_blocks_out, static_header_read_callback_t *cb) {
+    coro_t::spawn_later_ordered(boost::bind(co_static_header_read, file, cb, data_out, data_size, unchecksummed_blocks_out));
     return false;
 }
@@ -18,7 +18,9 @@ struct static_header_write_callback_t {
     virtual ~static_header_write_callback_t() {}
 };
 
-void co_static_header_write(file_t *file, void *data, size_t data_size);
+/* Writes the header of a file in the current serializer version, or in
+UNCHECKSUMMED_SERIALIZER_VERSION_STRING if `unchecksummed_blocks` is true. */
+void co_static_header_write(file_t *file, bool unchecksummed_blocks, void *data, size_t data_size);
 
 bool static_header_write(file_t *file, void *data, size_t data_size, static_header_write_callback_t *cb);
 
@@ -27,6 +29,8 @@ struct static_header_read_callback_t {
     virtual ~static_header_read_callback_t() {}
 };
 
-bool static_header_read(file_t *file, void *data_out, size_t data_size, static_header_read_callback_t *cb);
+/* Sets `*unchecksummed_blocks_out` to whether the file is in serializer version
+UNCHECKSUMMED_SERIALIZER_VERSION_STRING rather than the current one. */
+bool static_header_read(file_t *file, void *data_out, size_t data_size, bool *unchecksummed_blocks_out, static_header_read_callback_t *cb);
 
 #endif /* SERIALIZER_LOG_STATIC_HEADER_HPP_ */
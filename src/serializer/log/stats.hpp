@@ -9,6 +9,8 @@ struct log_serializer_stats_t {
     explicit log_serializer_stats_t(perfmon_collection_t *perfmon_collection);
 
     perfmon_duration_sampler_t pm_serializer_block_reads;
+    perfmon_counter_t pm_serializer_ssd_cache_hits;
+    perfmon_counter_t pm_serializer_ssd_cache_misses;
     perfmon_counter_t pm_serializer_index_reads;
     perfmon_counter_t pm_serializer_block_writes;
     perfmon_duration_sampler_t pm_serializer_index_writes;
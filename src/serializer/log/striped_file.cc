@@ -0,0 +1,187 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/striped_file.hpp"
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/pmap.hpp"
+#include "utils.hpp"
+
+namespace {
+
+// The accounts behind one of a striped file's accounts, one for each file.
+struct file_accounts_t {
+    std::vector<scoped_ptr_t<file_account_t> > accounts;
+};
+
+}  // namespace
+
+striped_file_t::striped_file_t(std::vector<scoped_ptr_t<file_t> > &&_files,
+                               int64_t _stripe_size)
+    : files(std::move(_files)), stripe_size(_stripe_size), size(0) {
+    guarantee(!files.empty());
+    guarantee(stripe_size > 0 && divides(DEVICE_BLOCK_SIZE, stripe_size));
+
+    // The files may have been grown past what they hold (see `set_size_at_least`),
+    // so the striped file is as big as what the biggest of them could hold.
+    const int64_t n = files.size();
+    for (int64_t i = 0; i < n; ++i) {
+        const int64_t file_size = files[i]->get_size();
+        const int64_t stripes = file_size / stripe_size;
+        const int64_t rest = file_size % stripe_size;
+        int64_t end = 0;
+        if (rest != 0) {
+            end = (stripes * n + i) * stripe_size + rest;
+        } else if (stripes != 0) {
+            end = ((stripes - 1) * n + i + 1) * stripe_size;
+        }
+        size = std::max(size, end);
+    }
+    // ... and then every file has to be able to hold its part of that.
+    for (size_t i = 0; i < files.size(); ++i) {
+        files[i]->set_size_at_least(file_size_for(size, stripe_size, files.size(), i));
+    }
+}
+
+striped_file_t::~striped_file_t() { }
+
+int64_t striped_file_t::file_size_for(int64_t size, int64_t stripe_size,
+                                      size_t num_files, size_t i) {
+    const int64_t n = num_files;
+    const int64_t stripes = size / stripe_size;
+    int64_t file_size = (stripes / n) * stripe_size;
+    if (static_cast<int64_t>(i) < stripes % n) {
+        file_size += stripe_size;
+    } else if (static_cast<int64_t>(i) == stripes % n) {
+        file_size += size % stripe_size;
+    }
+    return file_size;
+}
+
+int64_t striped_file_t::get_size() {
+    return size;
+}
+
+void striped_file_t::set_size(int64_t new_size) {
+    for (size_t i = 0; i < files.size(); ++i) {
+        files[i]->set_size(file_size_for(new_size, stripe_size, files.size(), i));
+    }
+    size = new_size;
+}
+
+void striped_file_t::set_size_at_least(int64_t new_size) {
+    if (size < new_size) {
+        for (size_t i = 0; i < files.size(); ++i) {
+            files[i]->set_size_at_least(
+                file_size_for(new_size, stripe_size, files.size(), i));
+        }
+        size = new_size;
+    }
+}
+
+void striped_file_t::discard(int64_t offset, int64_t length) {
+    while (length > 0) {
+        const int64_t piece = std::min(length, stripe_size - offset % stripe_size);
+        files[file_index(offset, piece)]->discard(file_offset(offset), piece);
+        offset += piece;
+        length -= piece;
+    }
+}
+
+void striped_file_t::datasync() {
+    pmap(files.size(), [this](int i) { files[i]->datasync(); });
+}
+
+size_t striped_file_t::file_index(int64_t offset, int64_t length) const {
+    guarantee(length > 0);
+    guarantee(offset / stripe_size == (offset + length - 1) / stripe_size,
+              "An I/O request of %" PRIi64 " bytes at %" PRIi64 " crosses a stripe "
+              "boundary of a striped file.", length, offset);
+    return (offset / stripe_size) % files.size();
+}
+
+int64_t striped_file_t::file_offset(int64_t offset) const {
+    return (offset / stripe_size / files.size()) * stripe_size + offset % stripe_size;
+}
+
+file_account_t *striped_file_t::file_account(file_account_t *account, size_t i) {
+    if (account == DEFAULT_DISK_ACCOUNT) {
+        // Each file has a default account of its own.
+        return DEFAULT_DISK_ACCOUNT;
+    }
+    return static_cast<file_accounts_t *>(account->get_account())->accounts[i].get();
+}
+
+void striped_file_t::read_async(int64_t offset, size_t length, void *buf,
+                                file_account_t *account, linux_iocallback_t *cb) {
+    const size_t i = file_index(offset, length);
+    files[i]->read_async(file_offset(offset), length, buf, file_account(account, i), cb);
+}
+
+void striped_file_t::write_async(int64_t offset, size_t length, const void *buf,
+                                 file_account_t *account, linux_iocallback_t *cb,
+                                 wrap_in_datasyncs_t wrap_in_datasyncs) {
+    const size_t i = file_index(offset, length);
+    if (wrap_in_datasyncs == WRAP_IN_DATASYNCS && files.size() > 1) {
+        // The leading datasync has to cover the writes to the other files too
+        // (metablocks are written like this, and they point at everything).
+        coro_t::spawn_sometime(std::bind(&striped_file_t::sync_others_and_write, this,
+                                         i, offset, length, buf, account, cb));
+    } else {
+        files[i]->write_async(file_offset(offset), length, buf,
+                              file_account(account, i), cb, wrap_in_datasyncs);
+    }
+}
+
+void striped_file_t::sync_others_and_write(size_t i, int64_t offset, size_t length,
+                                           const void *buf, file_account_t *account,
+                                           linux_iocallback_t *cb) {
+    pmap(files.size(), [this, i](int j) {
+        if (static_cast<size_t>(j) != i) {
+            files[j]->datasync();
+        }
+    });
+    files[i]->write_async(file_offset(offset), length, buf, file_account(account, i),
+                          cb, WRAP_IN_DATASYNCS);
+}
+
+void striped_file_t::writev_async(int64_t offset, size_t length,
+                                  scoped_array_t<iovec> &&bufs,
+                                  file_account_t *account, linux_iocallback_t *cb) {
+    const size_t i = file_index(offset, length);
+    files[i]->writev_async(file_offset(offset), length, std::move(bufs),
+                           file_account(account, i), cb);
+}
+
+void *striped_file_t::create_account(int priority, int outstanding_requests_limit) {
+    file_accounts_t *accounts = new file_accounts_t;
+    for (size_t i = 0; i < files.size(); ++i) {
+        accounts->accounts.push_back(make_scoped<file_account_t>(
+            files[i].get(), priority, outstanding_requests_limit));
+    }
+    return accounts;
+}
+
+void striped_file_t::destroy_account(void *account) {
+    delete static_cast<file_accounts_t *>(account);
+}
+
+void striped_file_t::set_account_latency_target(void *account,
+                                                int64_t latency_target_ms) {
+    file_accounts_t *accounts = static_cast<file_accounts_t *>(account);
+    for (size_t i = 0; i < accounts->accounts.size(); ++i) {
+        accounts->accounts[i]->set_latency_target(latency_target_ms);
+    }
+}
+
+bool striped_file_t::coop_lock_and_check() {
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!files[i]->coop_lock_and_check()) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_STRIPED_FILE_HPP_
+#define SERIALIZER_LOG_STRIPED_FILE_HPP_
+
+#include <vector>
+
+#include "arch/types.hpp"
+#include "containers/scoped.hpp"
+
+/* A serializer file spread over several files, usually on different devices, so that
+one table can use all of their bandwidth.  The file is cut into stripes of
+`stripe_size` bytes that are dealt out to the files in turn: stripe `i` is stripe
+`i / n` of file `i % n`.  With stripes of whole extents, an extent's offset says
+which device it's on, so the extent manager doesn't have to know about any of this.
+
+No I/O request may cross a stripe boundary, which holds for everything the log
+serializer does as long as the stripe size is a multiple of the extent size.  Each
+account is made of an account on each file, so that each device's requests are
+scheduled (and limited) on their own. */
+class striped_file_t : public file_t {
+public:
+    // `files` must be non-empty.  Their sizes must be the ones a `striped_file_t`
+    // with the same files and stripe size left them with.
+    striped_file_t(std::vector<scoped_ptr_t<file_t> > &&files, int64_t stripe_size);
+    ~striped_file_t();
+
+    int64_t get_size();
+    void set_size(int64_t size);
+    void set_size_at_least(int64_t size);
+    void discard(int64_t offset, int64_t length);
+    void datasync();
+
+    void read_async(int64_t offset, size_t length, void *buf,
+                    file_account_t *account, linux_iocallback_t *cb);
+    void write_async(int64_t offset, size_t length, const void *buf,
+                     file_account_t *account, linux_iocallback_t *cb,
+                     wrap_in_datasyncs_t wrap_in_datasyncs);
+    void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
+                      file_account_t *account, linux_iocallback_t *cb);
+
+    void *create_account(int priority, int outstanding_requests_limit);
+    void destroy_account(void *account);
+    void set_account_latency_target(void *account, int64_t latency_target_ms);
+
+    bool coop_lock_and_check();
+
+    // How big file `i` of `num_files` needs to be to hold everything in the first
+    // `size` bytes of the striped file.
+    static int64_t file_size_for(int64_t size, int64_t stripe_size,
+                                 size_t num_files, size_t i);
+
+private:
+    // Which file holds the `length` bytes at `offset`, and where in it they are.
+    size_t file_index(int64_t offset, int64_t length) const;
+    int64_t file_offset(int64_t offset) const;
+
+    // The account on file `i` that stands in for `account`.
+    file_account_t *file_account(file_account_t *account, size_t i);
+
+    // Writes and syncs a block like `write_async` with `WRAP_IN_DATASYNCS`, once the
+    // other files have been synced.  The block may depend on any earlier write.
+    void sync_others_and_write(size_t i, int64_t offset, size_t length,
+                               const void *buf, file_account_t *account,
+                               linux_iocallback_t *cb);
+
+    std::vector<scoped_ptr_t<file_t> > files;
+    const int64_t stripe_size;
+    int64_t size;
+
+    DISABLE_COPYING(striped_file_t);
+};
+
+#endif  // SERIALIZER_LOG_STRIPED_FILE_HPP_
@@ -26,6 +26,7 @@ merger_serializer_t::~merger_serializer_t() {
 }
 
 void merger_serializer_t::index_write(const std::vector<index_write_op_t> &write_ops,
+                                      const std::function<void()> &on_writes_reflected,
                                       file_account_t *) {
     rassert(coro_t::self() != NULL);
     assert_thread();
@@ -44,6 +45,11 @@ void merger_serializer_t::index_write(const std::vector<index_write_op_t> &write
         unhandled_index_write_waiter_exists = true;
     }
 
+    // Any later index write gets merged after ours.
+    if (on_writes_reflected) {
+        on_writes_reflected();
+    }
+
     // Check if we can initiate a new index write
     if (num_active_writes < max_active_writes) {
         ++num_active_writes;
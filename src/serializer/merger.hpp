@@ -29,7 +29,7 @@ public:
 
     /* serializer_t interface */
 
-    scoped_malloc_t<ser_buffer_t> malloc() { return inner->malloc(); }
+    scoped_arena_ptr_t<ser_buffer_t> malloc() { return inner->malloc(); }
 
     /* Allocates a new io account for the underlying file.
     Use delete to free it. */
@@ -85,7 +85,9 @@ public:
 
     /* index_write() applies all given index operations in an atomic way */
     /* This is where merger_serializer_t merges operations */
+    using serializer_t::index_write;
     void index_write(const std::vector<index_write_op_t> &write_ops,
+                     const std::function<void()> &on_writes_reflected,
                      file_account_t *io_account);
 
     // Returns block tokens in the same order as write_infos.
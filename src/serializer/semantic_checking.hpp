@@ -11,6 +11,7 @@
 
 #include "arch/types.hpp"
 #include "config/args.hpp"
+#include "containers/two_level_array.hpp"
 #include "serializer/serializer.hpp"
 
 /* This is a thin wrapper around the log serializer that makes sure that the
@@ -49,7 +50,7 @@ public:
     semantic_checking_serializer_t(dynamic_config_t config, serializer_file_opener_t *file_opener, perfmon_collection_t *perfmon_collection);
     ~semantic_checking_serializer_t();
 
-    scoped_malloc_t<ser_buffer_t> malloc();
+    scoped_arena_ptr_t<ser_buffer_t> malloc();
 
     using serializer_t::make_io_account;
     file_account_t *make_io_account(int priority, int outstanding_requests_limit);
@@ -57,7 +58,10 @@ public:
 
     void block_read(const counted_t< scs_block_token_t<inner_serializer_t> > &_token, ser_buffer_t *buf, file_account_t *io_account);
 
-    void index_write(const std::vector<index_write_op_t> &write_ops, file_account_t *io_account);
+    using serializer_t::index_write;
+    void index_write(const std::vector<index_write_op_t> &write_ops,
+                     const std::function<void()> &on_writes_reflected,
+                     file_account_t *io_account);
 
     std::vector<counted_t< scs_block_token_t<inner_serializer_t> > >
     block_writes(const std::vector<buf_write_info_t> &write_infos, file_account_t *io_account, iocallback_t *cb);
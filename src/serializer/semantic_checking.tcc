@@ -61,7 +61,7 @@ template<class inner_serializer_t>
 semantic_checking_serializer_t<inner_serializer_t>::~semantic_checking_serializer_t() { }
 
 template<class inner_serializer_t>
-scoped_malloc_t<ser_buffer_t>
+scoped_arena_ptr_t<ser_buffer_t>
 semantic_checking_serializer_t<inner_serializer_t>::malloc() {
     return inner_serializer.malloc();
 }
@@ -131,7 +131,9 @@ block_read(const counted_t< scs_block_token_t<inner_serializer_t> > &_token, ser
 
 template<class inner_serializer_t>
 void semantic_checking_serializer_t<inner_serializer_t>::
-index_write(const std::vector<index_write_op_t> &write_ops, file_account_t *io_account) {
+index_write(const std::vector<index_write_op_t> &write_ops,
+            const std::function<void()> &on_writes_reflected,
+            file_account_t *io_account) {
     std::vector<index_write_op_t> inner_ops;
     inner_ops.reserve(write_ops.size());
 
@@ -163,7 +165,7 @@ index_write(const std::vector<index_write_op_t> &write_ops, file_account_t *io_a
     }
 
     int our_index_write = ++last_index_write_started;
-    inner_serializer.index_write(inner_ops, io_account);
+    inner_serializer.index_write(inner_ops, on_writes_reflected, io_account);
     guarantee(last_index_write_finished == our_index_write - 1, "Serializer completed index_writes in the wrong order");
     last_index_write_finished = our_index_write;
 }
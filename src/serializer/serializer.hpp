@@ -2,6 +2,7 @@
 #ifndef SERIALIZER_SERIALIZER_HPP_
 #define SERIALIZER_SERIALIZER_HPP_
 
+#include <functional>
 #include <vector>
 
 #include "utils.hpp"
@@ -48,7 +49,7 @@ public:
     /* The buffers that are used with do_read() and do_write() must be allocated using
     these functions. They can be safely called from any thread. */
 
-    virtual scoped_malloc_t<ser_buffer_t> malloc() = 0;
+    virtual scoped_arena_ptr_t<ser_buffer_t> malloc() = 0;
 
     /* Allocates a new io account for the underlying file.
     Use delete to free it. */
@@ -101,8 +102,19 @@ public:
     /* Reads the block's actual data */
     virtual counted_t<standard_block_token_t> index_read(block_id_t block_id) = 0;
 
-    /* index_write() applies all given index operations in an atomic way */
-    virtual void index_write(const std::vector<index_write_op_t>& write_ops, file_account_t *io_account) = 0;
+    /* index_write() applies all given index operations in an atomic way.  Index
+    writes get applied, and become durable, in the order in which they are called.
+    Once this call's place in that order is fixed, it calls `on_writes_reflected`
+    (unless that is empty), which happens before its operations are on disk.  This
+    lets a caller that needs its index writes to happen in order start the next one
+    without waiting for the previous one to return. */
+    virtual void index_write(const std::vector<index_write_op_t> &write_ops,
+                             const std::function<void()> &on_writes_reflected,
+                             file_account_t *io_account) = 0;
+    void index_write(const std::vector<index_write_op_t> &write_ops,
+                     file_account_t *io_account) {
+        index_write(write_ops, std::function<void()>(), io_account);
+    }
 
     // Returns block tokens in the same order as write_infos.
     virtual std::vector<counted_t<standard_block_token_t> >
@@ -55,7 +55,7 @@ void prep_serializer(
     on_thread_t thread_switcher(ser->home_thread());
 
     /* Write the initial configuration block */
-    scoped_malloc_t<ser_buffer_t> buf = ser->malloc();
+    scoped_arena_ptr_t<ser_buffer_t> buf = ser->malloc();
     multiplexer_config_block_t *c
         = reinterpret_cast<multiplexer_config_block_t *>(buf->cache_data);
 
@@ -99,7 +99,7 @@ void create_proxies(const std::vector<serializer_t *>& underlying,
     on_thread_t thread_switcher(ser->home_thread());
 
     /* Load config block */
-    scoped_malloc_t<ser_buffer_t> buf = ser->malloc();
+    scoped_arena_ptr_t<ser_buffer_t> buf = ser->malloc();
     ser->block_read(ser->index_read(CONFIG_BLOCK_ID.ser_id), buf.get(), DEFAULT_DISK_ACCOUNT);
     multiplexer_config_block_t *c
         = reinterpret_cast<multiplexer_config_block_t *>(buf->cache_data);
@@ -150,7 +150,7 @@ serializer_multiplexer_t::serializer_multiplexer_t(const std::vector<serializer_
         on_thread_t thread_switcher(underlying[0]->home_thread());
 
         /* Load config block */
-        scoped_malloc_t<ser_buffer_t> buf = underlying[0]->malloc();
+        scoped_arena_ptr_t<ser_buffer_t> buf = underlying[0]->malloc();
         underlying[0]->block_read(underlying[0]->index_read(CONFIG_BLOCK_ID.ser_id), buf.get(), DEFAULT_DISK_ACCOUNT);
 
         multiplexer_config_block_t *c
@@ -211,7 +211,7 @@ translator_serializer_t::translator_serializer_t(serializer_t *_inner, int _mod_
     rassert(mod_id < mod_count);
 }
 
-scoped_malloc_t<ser_buffer_t> translator_serializer_t::malloc() {
+scoped_arena_ptr_t<ser_buffer_t> translator_serializer_t::malloc() {
     return inner->malloc();
 }
 
@@ -219,11 +219,13 @@ file_account_t *translator_serializer_t::make_io_account(int priority, int outst
     return inner->make_io_account(priority, outstanding_requests_limit);
 }
 
-void translator_serializer_t::index_write(const std::vector<index_write_op_t> &write_ops, file_account_t *io_account) {
+void translator_serializer_t::index_write(const std::vector<index_write_op_t> &write_ops,
+                                          const std::function<void()> &on_writes_reflected,
+                                          file_account_t *io_account) {
     std::vector<index_write_op_t> translated_ops(write_ops);
     for (std::vector<index_write_op_t>::iterator it = translated_ops.begin(); it < translated_ops.end(); ++it)
         it->block_id = translate_block_id(it->block_id);
-    inner->index_write(translated_ops, io_account);
+    inner->index_write(translated_ops, on_writes_reflected, io_account);
 }
 
 std::vector<counted_t<standard_block_token_t> >
@@ -289,7 +291,7 @@ bool translator_serializer_t::get_delete_bit(block_id_t id) {
 
 void translator_serializer_t::offer_read_ahead_buf(
         block_id_t block_id,
-        scoped_malloc_t<ser_buffer_t> *buf,
+        scoped_arena_ptr_t<ser_buffer_t> *buf,
         const counted_t<standard_block_token_t> &token) {
     inner->assert_thread();
 
@@ -308,7 +310,7 @@ void translator_serializer_t::offer_read_ahead_buf(
 
     // Okay, we take ownership of the buf, it's ours (even if read_ahead_callback is
     // NULL).
-    scoped_malloc_t<ser_buffer_t> local_buf = std::move(*buf);
+    scoped_arena_ptr_t<ser_buffer_t> local_buf = std::move(*buf);
 
     if (read_ahead_callback != NULL) {
         const block_id_t inner_block_id = untranslate_block_id_to_id(block_id, mod_count, mod_id, cfgid);
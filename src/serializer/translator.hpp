@@ -110,12 +110,15 @@ public:
     are greater than or equal to 'min' and such that ((id - min) % mod_count) == mod_id. */
     translator_serializer_t(serializer_t *inner, int mod_count, int mod_id, config_block_id_t cfgid);
 
-    scoped_malloc_t<ser_buffer_t> malloc();
+    scoped_arena_ptr_t<ser_buffer_t> malloc();
 
     /* Allocates a new io account for the underlying file */
     file_account_t *make_io_account(int priority, int outstanding_requests_limit);
 
-    void index_write(const std::vector<index_write_op_t> &write_ops, file_account_t *io_account);
+    using serializer_t::index_write;
+    void index_write(const std::vector<index_write_op_t> &write_ops,
+                     const std::function<void()> &on_writes_reflected,
+                     file_account_t *io_account);
 
     std::vector<counted_t<standard_block_token_t> >
     block_writes(const std::vector<buf_write_info_t> &write_infos, file_account_t *io_account, iocallback_t *cb);
@@ -140,7 +143,7 @@ public:
 
 public:
     void offer_read_ahead_buf(block_id_t block_id,
-                              scoped_malloc_t<ser_buffer_t> *buf,
+                              scoped_arena_ptr_t<ser_buffer_t> *buf,
                               const counted_t<standard_block_token_t> &token);
 };
 
@@ -8,6 +8,7 @@
 #include <string>
 #include <utility>
 
+#include "arch/buffer_arena.hpp"
 #include "containers/counted.hpp"
 #include "containers/scoped.hpp"
 #include "errors.hpp"
@@ -22,9 +23,27 @@ typedef uint64_t block_id_t;
 // The first bytes of any block stored on disk or (as it happens) cached in memory.
 struct ls_buf_data_t {
     block_id_t block_id;
+    // The CRC32C of the block as it's stored on disk, that is of its first
+    // ser_block_size bytes, leaving out this field.  The data block manager sets it
+    // when it writes the block and checks it when it reads the block back.
+    uint32_t checksum;
+    // LS_BUF_VALUE_BLOCK or zero.  Also keeps the cache's part of the block 8-byte
+    // aligned.
+    uint32_t flags;
 } __attribute__((__packed__));
 
-// For use via scoped_malloc_t, a buffer that represents a block on disk.  Contains
+// Files from serializer version UNCHECKSUMMED_SERIALIZER_VERSION_STRING have just the
+// block id for a header, so the cache's part of their blocks starts this many bytes
+// earlier.  The log serializer keeps such files in that format, and gives their blocks
+// the full header (with no checksum or flags) in memory.
+#define LS_UNCHECKSUMMED_HEADER_SHORTFALL (sizeof(ls_buf_data_t) - sizeof(block_id_t))
+
+// Marks the blocks that hold the parts of large values that don't fit in the btree's
+// leaf nodes.  The log serializer keeps them in extents of their own, apart from the
+// btree's nodes.
+#define LS_BUF_VALUE_BLOCK 1
+
+// For use via scoped_arena_ptr_t, a buffer that represents a block on disk.  Contains
 // convenient access to the serializer header and cache portion of the block.  This
 // is better than (e.g.) performing arithmetic on void pointers when passing bufs
 // between the cache and serializer.  When used in memory, this structure _might_ be
@@ -90,7 +109,12 @@ class log_serializer_t;
 class ls_block_token_pointee_t {
 public:
     int64_t offset() const { return offset_; }
-    block_size_t block_size() const { return block_size_; }
+    // The size of the block as seen by the cache.
+    block_size_t block_size() const;
+    // The size the block takes up on disk, which is smaller than block_size() if
+    // the block is compressed (see serializer/log/block_compression.hpp).
+    block_size_t on_disk_block_size() const { return block_size_; }
+    bool is_compressed() const;
 
 private:
     friend class log_serializer_t;
@@ -105,7 +129,7 @@ private:
     log_serializer_t *serializer_;
     intptr_t ref_count_;
 
-    // The block's size.
+    // The block's size on disk.
     block_size_t block_size_;
 
     // The block's offset on disk.
@@ -142,6 +166,9 @@ public:
     virtual void move_serializer_file_to_permanent_location() = 0;
     virtual void open_serializer_file_existing(scoped_ptr_t<file_t> *file_out) = 0;
     virtual void unlink_serializer_file() = 0;
+    // Opens (emptying it) the file to keep a cache of blocks in, on a faster device
+    // than the serializer file (see `ssd_block_cache_t`), if there's to be one.
+    virtual void open_cache_file(UNUSED scoped_ptr_t<file_t> *file_out) { }
 #ifdef SEMANTIC_SERIALIZER_CHECK
     virtual void open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out) = 0;
 #endif
@@ -183,6 +210,10 @@ struct scs_block_token_t {
         return inner_token->block_size();
     }
 
+    int64_t offset() const {
+        return inner_token->offset();
+    }
+
     block_id_t block_id;    // NULL_BLOCK_ID if not associated with a block id
     scs_block_info_t info;      // invariant: info.state != scs_block_info_t::state_deleted
     counted_t<typename serializer_traits_t<inner_serializer_t>::block_token_type> inner_token;
@@ -268,7 +299,7 @@ public:
     // ownership of the `ser_buffer_t *` from `*buf`.  It's also free to decline
     // ownership, by leaving the pointer owned by `*buf`.
     virtual void offer_read_ahead_buf(block_id_t block_id,
-                                      scoped_malloc_t<ser_buffer_t> *buf,
+                                      scoped_arena_ptr_t<ser_buffer_t> *buf,
                                       const counted_t<standard_block_token_t> &token) = 0;
 };
 
@@ -34,6 +34,12 @@ public:
         return t;
     }
 
+    // The number of writes between `earlier` and this timestamp, or zero if
+    // `earlier` isn't earlier.
+    uint64_t writes_since(state_timestamp_t earlier) const {
+        return num > earlier.num ? num - earlier.num : 0;
+    }
+
     // TODO get rid of this. This is only for a hack until we know what to do with timestamps
     repli_timestamp_t to_repli_timestamp() const {
         repli_timestamp_t ts;
@@ -0,0 +1,91 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <unistd.h>
+
+#include "concurrency/queue/accounting.hpp"
+#include "concurrency/queue/unlimited_fifo.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+void run_fair_shares_test() {
+    accounting_queue_t<int> queue(1);
+    unlimited_fifo_queue_t<int> low_source, high_source;
+    for (int i = 0; i < 1000; ++i) {
+        low_source.push(0);
+        high_source.push(1);
+    }
+    accounting_queue_t<int>::account_t low(&queue, &low_source, 1);
+    accounting_queue_t<int>::account_t high(&queue, &high_source, 3);
+
+    int counts[2] = { 0, 0 };
+    for (int i = 0; i < 400; ++i) {
+        ASSERT_TRUE(queue.available->get());
+        ++counts[queue.pop()];
+    }
+    ASSERT_EQ(100, counts[0]);
+    ASSERT_EQ(300, counts[1]);
+}
+
+TEST(AccountingQueueTest, FairShares) {
+    run_in_thread_pool(run_fair_shares_test);
+}
+
+void run_idle_account_gets_no_credit_test() {
+    accounting_queue_t<int> queue(1);
+    unlimited_fifo_queue_t<int> busy_source, idle_source;
+    accounting_queue_t<int>::account_t busy(&queue, &busy_source, 1);
+    accounting_queue_t<int>::account_t idle(&queue, &idle_source, 1);
+
+    for (int i = 0; i < 100; ++i) {
+        busy_source.push(0);
+        ASSERT_EQ(0, queue.pop());
+    }
+
+    // After having been idle, the second account shares evenly with the first
+    // instead of monopolizing the queue to catch up.
+    for (int i = 0; i < 10; ++i) {
+        busy_source.push(0);
+        idle_source.push(1);
+    }
+    int counts[2] = { 0, 0 };
+    for (int i = 0; i < 10; ++i) {
+        ++counts[queue.pop()];
+    }
+    ASSERT_LE(4, counts[0]);
+    ASSERT_LE(4, counts[1]);
+}
+
+TEST(AccountingQueueTest, IdleAccountGetsNoCredit) {
+    run_in_thread_pool(run_idle_account_gets_no_credit_test);
+}
+
+void run_latency_target_test() {
+    perfmon_counter_t overdue_pops;
+    accounting_queue_t<int> queue(1, &overdue_pops);
+    unlimited_fifo_queue_t<int> bulk_source, urgent_source;
+    for (int i = 0; i < 100; ++i) {
+        bulk_source.push(0);
+        urgent_source.push(1);
+    }
+    accounting_queue_t<int>::account_t bulk(&queue, &bulk_source, 1000);
+    accounting_queue_t<int>::account_t urgent(&queue, &urgent_source, 1);
+
+    // Both accounts start out even; after that the bulk account would be served
+    // a thousand times for each time the urgent one is.
+    ASSERT_EQ(0, queue.pop());
+    ASSERT_EQ(1, queue.pop());
+    ASSERT_EQ(0, queue.pop());
+
+    // Once the urgent account is past its target, it is served next although the
+    // fair schedule would serve the bulk account many more times first.
+    urgent.set_latency_target(1);
+    usleep(1000);
+    ASSERT_EQ(1, queue.pop());
+}
+
+TEST(AccountingQueueTest, LatencyTarget) {
+    run_in_thread_pool(run_latency_target_test);
+}
+
+}  // namespace unittest
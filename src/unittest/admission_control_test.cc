@@ -0,0 +1,97 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/admission_control.hpp"
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+void run_query(admission_controller_t *controller, cond_t *done, int *admitted,
+               int *refused) {
+    admission_controller_t::ticket_t ticket;
+    cond_t non_interruptor;
+    if (ticket.admit(controller, &non_interruptor)) {
+        ++*admitted;
+        done->wait();
+    } else {
+        ++*refused;
+    }
+}
+
+void run_queue_test() {
+    // Two run at once, and two more can wait for their turn.
+    admission_controller_t controller(2, 2);
+    cond_t done;
+    int admitted = 0, refused = 0;
+    for (int i = 0; i < 5; ++i) {
+        coro_t::spawn_now_dangerously(std::bind(&run_query, &controller, &done,
+                                                &admitted, &refused));
+    }
+    EXPECT_EQ(2, admitted);
+    EXPECT_EQ(2, controller.num_running());
+    EXPECT_EQ(2u, controller.num_waiting());
+    // The fifth one is turned away right away.
+    EXPECT_EQ(1, refused);
+
+    // Once the first two are done, the waiting ones get their turn.
+    done.pulse();
+    while (admitted + refused < 5 || controller.num_running() > 0) {
+        coro_t::yield();
+    }
+    EXPECT_EQ(4, admitted);
+    EXPECT_EQ(0u, controller.num_waiting());
+}
+
+TEST(AdmissionControlTest, Queue) {
+    run_in_thread_pool(run_queue_test);
+}
+
+void run_wait_timeout_test() {
+    admission_controller_t controller(1, 1);
+    cond_t done;
+    int admitted = 0, refused = 0;
+    coro_t::spawn_now_dangerously(std::bind(&run_query, &controller, &done,
+                                            &admitted, &refused));
+    coro_t::spawn_now_dangerously(std::bind(&run_query, &controller, &done,
+                                            &admitted, &refused));
+    EXPECT_EQ(1u, controller.num_waiting());
+
+    // The waiting one gives up once it has waited long enough.
+    nap(ADMISSION_MAX_WAIT_MS + 100);
+    EXPECT_EQ(1, refused);
+    EXPECT_EQ(0u, controller.num_waiting());
+
+    done.pulse();
+    while (controller.num_running() > 0) {
+        coro_t::yield();
+    }
+    EXPECT_EQ(1, admitted);
+}
+
+TEST(AdmissionControlTest, WaitTimeout) {
+    run_in_thread_pool(run_wait_timeout_test);
+}
+
+void run_latency_test() {
+    const int max_running = 32;
+    admission_controller_t controller(max_running, 0);
+    cond_t non_interruptor;
+    // Fast queries, and then slow ones: the limit shrinks.
+    for (int i = 0; i < 200; ++i) {
+        admission_controller_t::ticket_t ticket;
+        ASSERT_TRUE(ticket.admit(&controller, &non_interruptor));
+        nap(i < 100 ? 1 : 20);
+    }
+    EXPECT_GT(max_running, controller.limit());
+    EXPECT_LE(ADMISSION_MIN_RUNNING_QUERIES, controller.limit());
+}
+
+TEST(AdmissionControlTest, LimitFollowsLatency) {
+    run_in_thread_pool(run_latency_test);
+}
+
+}  // namespace unittest
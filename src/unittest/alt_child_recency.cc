@@ -0,0 +1,88 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "arch/io/disk.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "serializer/config.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+repli_timestamp_t child_recency_timestamp(uint64_t longtime) {
+    repli_timestamp_t ret;
+    ret.longtime = longtime;
+    return ret;
+}
+
+// Writes the child (and thus its parent, the superblock) with the given recency.
+void write_child(cache_conn_t *cache_conn, block_id_t child_id,
+                 repli_timestamp_t recency) {
+    txn_t txn(cache_conn, write_durability_t::HARD, recency, 1);
+    buf_lock_t parent(buf_parent_t(&txn), SUPERBLOCK_ID, access_t::write);
+    buf_lock_t child(&parent, child_id, access_t::write);
+    buf_write_t child_write(&child);
+}
+
+void run_child_recency_test() {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    cache_t cache(&serializer, alt_cache_config_t(),
+                  &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    block_id_t child_id;
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD,
+                  child_recency_timestamp(1), 1);
+        buf_lock_t parent(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        buf_write_t parent_write(&parent);
+        buf_lock_t child(&parent, alt_create_t::create);
+        buf_write_t child_write(&child);
+        child_id = child.block_id();
+    }
+
+    {
+        txn_t txn(&cache_conn, read_access_t::read);
+        buf_lock_t parent(buf_parent_t(&txn), SUPERBLOCK_ID, access_t::read);
+        ASSERT_EQ(child_recency_timestamp(1),
+                  buf_lock_t::get_child_recency(buf_parent_t(&parent), child_id));
+        parent.snapshot_subdag();
+
+        // A snapshotted parent keeps seeing the child as it was when it was
+        // snapshotted.
+        write_child(&cache_conn, child_id, child_recency_timestamp(5));
+        ASSERT_EQ(child_recency_timestamp(1),
+                  buf_lock_t::get_child_recency(buf_parent_t(&parent), child_id));
+        {
+            buf_lock_t child(&parent, child_id, access_t::read);
+            ASSERT_EQ(child_recency_timestamp(1), child.get_recency());
+        }
+    }
+
+    {
+        txn_t txn(&cache_conn, read_access_t::read);
+        buf_lock_t parent(buf_parent_t(&txn), SUPERBLOCK_ID, access_t::read);
+        ASSERT_EQ(child_recency_timestamp(5),
+                  buf_lock_t::get_child_recency(buf_parent_t(&parent), child_id));
+        buf_lock_t child(&parent, child_id, access_t::read);
+        ASSERT_EQ(child_recency_timestamp(5), child.get_recency());
+    }
+}
+
+TEST(AltChildRecency, SnapshottedAndNot) {
+    run_in_thread_pool(&run_child_recency_test);
+}
+
+}  // namespace unittest
@@ -13,7 +13,7 @@ void dump_to_string(write_message_t *msg, std::string *out) {
 
     out->clear();
     for (write_buffer_t *p = buffers->head(); p; p = buffers->next(p)) {
-        out->append(p->data, p->data + p->size);
+        out->append(p->get_data(), p->get_data() + p->get_size());
     }
 }
 
@@ -34,6 +34,34 @@ TEST(WriteMessageTest, Variant) {
     ASSERT_EQ(15u, s.size());
 }
 
+TEST(WriteMessageTest, AppendBuffer) {
+    counted_t<data_buffer_t> small = data_buffer_t::create(10);
+    memset(small->buf(), 's', small->size());
+    counted_t<data_buffer_t> large = data_buffer_t::create(write_buffer_t::DATA_SIZE * 2);
+    memset(large->buf(), 'l', large->size());
 
+    write_message_t msg;
+    msg.append("a", 1);
+    msg.append_buffer(small);
+    msg.append_buffer(large);
+    msg.append("b", 1);
+
+    // The large buffer is referred to, not copied.
+    intrusive_list_t<write_buffer_t> *buffers = msg.unsafe_expose_buffers();
+    ASSERT_EQ(3u, buffers->size());
+    ASSERT_EQ(large->buf(), buffers->next(buffers->head())->get_data());
+
+    // Sending to a `write_message_stream_t` keeps the reference.
+    write_message_stream_t stream;
+    ASSERT_EQ(0, send_write_message(&stream, &msg));
+    ASSERT_EQ(large->buf(), stream.message()->unsafe_expose_buffers()->next(
+                  stream.message()->unsafe_expose_buffers()->head())->get_data());
+
+    std::string s;
+    dump_to_string(stream.message(), &s);
+    ASSERT_EQ(msg.size(), s.size());
+    ASSERT_EQ(std::string("a") + std::string(10, 's')
+              + std::string(large->size(), 'l') + "b", s);
+}
 
 }  // namespace unittest
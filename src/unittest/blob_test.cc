@@ -78,8 +78,29 @@ public:
         }
     }
 
+    void check_stream(txn_t *txn) {
+        SCOPED_TRACE("check_stream");
+        blob_read_stream_t stream(buf_parent_t(txn), buf_.data(), buf_.size());
+
+        // An odd chunk size, so that reads straddle the leaf blocks' boundaries.
+        const int64_t chunk_size = 1000;
+        std::string contents;
+        for (;;) {
+            char chunk[chunk_size];
+            int64_t res = stream.read(chunk, chunk_size);
+            ASSERT_LE(0, res);
+            contents.append(chunk, res);
+            if (res < chunk_size) {
+                break;
+            }
+        }
+        ASSERT_EQ(0, stream.read(NULL, 0));
+        ASSERT_TRUE(expected_ == contents);
+    }
+
     void check(txn_t *txn) {
         check_region(txn, 0, expected_.size());
+        check_stream(txn);
         check_normalization(txn);
     }
 
@@ -0,0 +1,51 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <stdlib.h>
+#include <string.h>
+
+#include "containers/scoped.hpp"
+#include "serializer/log/block_compression.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+scoped_arena_ptr_t<ser_buffer_t> make_block(block_size_t block_size) {
+    scoped_arena_ptr_t<ser_buffer_t> buf(block_size.ser_value());
+    buf->ser_header.block_id = 1234;
+    return buf;
+}
+
+TEST(BlockCompressionTest, Roundtrip) {
+    const block_size_t block_size = block_size_t::unsafe_make(4096);
+    scoped_arena_ptr_t<ser_buffer_t> block = make_block(block_size);
+    for (uint32_t i = 0; i < block_size.value(); ++i) {
+        block->cache_data[i] = "{\"name\": \"value\"}"[i % 17];
+    }
+
+    scoped_arena_ptr_t<ser_buffer_t> compressed = make_block(block_size);
+    const uint32_t compressed_size = compress_block(block.get(), block_size,
+                                                    compressed.get());
+    ASSERT_NE(0u, compressed_size);
+    ASSERT_LT(compressed_size, block_size.ser_value() - DEVICE_BLOCK_SIZE);
+
+    scoped_arena_ptr_t<ser_buffer_t> decompressed = make_block(block_size);
+    decompressed->ser_header.block_id = 0;
+    decompress_block(compressed.get(), compressed_size, block_size,
+                     decompressed.get());
+    ASSERT_EQ(1234u, decompressed->ser_header.block_id);
+    ASSERT_EQ(0, memcmp(block->cache_data, decompressed->cache_data,
+                        block_size.value()));
+}
+
+TEST(BlockCompressionTest, Incompressible) {
+    const block_size_t block_size = block_size_t::unsafe_make(4096);
+    scoped_arena_ptr_t<ser_buffer_t> block = make_block(block_size);
+    srand(0);
+    for (uint32_t i = 0; i < block_size.value(); ++i) {
+        block->cache_data[i] = rand();
+    }
+
+    scoped_arena_ptr_t<ser_buffer_t> compressed = make_block(block_size);
+    ASSERT_EQ(0u, compress_block(block.get(), block_size, compressed.get()));
+}
+
+}  // namespace unittest
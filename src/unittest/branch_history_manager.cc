@@ -33,6 +33,7 @@ void in_memory_branch_history_manager_t<protocol_t>::create_branch(branch_id_t b
     rassert(bh.branches.find(branch_id) == bh.branches.end());
     nap(10, interruptor);
     bh.branches[branch_id] = bc;
+    recent_branches.insert(branch_id);
 }
 
 template <class protocol_t>
@@ -60,10 +61,23 @@ template <class protocol_t>
 void in_memory_branch_history_manager_t<protocol_t>::import_branch_history(const branch_history_t<protocol_t> &new_records, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
     nap(10, interruptor);
     for (typename std::map<branch_id_t, branch_birth_certificate_t<protocol_t> >::const_iterator it = new_records.branches.begin(); it != new_records.branches.end(); it++) {
-        bh.branches.insert(std::make_pair(it->first, it->second));
+        if (bh.branches.insert(std::make_pair(it->first, it->second)).second) {
+            recent_branches.insert(it->first);
+        }
     }
 }
 
+template <class protocol_t>
+void in_memory_branch_history_manager_t<protocol_t>::compact_branch_history(const std::set<branch_id_t> &live_branches, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
+    nap(10, interruptor);
+    std::set<branch_id_t> roots = live_branches;
+    roots.insert(recent_branches.begin(), recent_branches.end());
+    recent_branches.clear();
+    branch_history_t<protocol_t> live;
+    collect_branch_ancestry(bh, roots, &live);
+    bh.branches.swap(live.branches);
+}
+
 }  // namespace unittest
 
 
@@ -16,9 +16,11 @@ public:
     void create_branch(branch_id_t branch_id, const branch_birth_certificate_t<protocol_t> &bc, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
     void export_branch_history(branch_id_t branch, branch_history_t<protocol_t> *out) THROWS_NOTHING;
     void import_branch_history(const branch_history_t<protocol_t> &new_records, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
+    void compact_branch_history(const std::set<branch_id_t> &live_branches, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t);
 
 private:
     branch_history_t<protocol_t> bh;
+    std::set<branch_id_t> recent_branches;
 };
 
 }  // namespace unittest
@@ -0,0 +1,129 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "unittest/gtest.hpp"
+
+#include "arch/io/disk.hpp"
+#include "btree/get_distribution.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/protocol.hpp"
+#include "serializer/config.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+counted_t<const ql::datum_t> bulk_load_row(int i) {
+    // Every so often a row is too big to fit in the leaf node.
+    if (i % 100 == 0) {
+        return make_counted<ql::datum_t>(std::string(3000, 'a' + i % 26));
+    }
+    return make_counted<ql::datum_t>(static_cast<double>(i));
+}
+
+void run_bulk_load_test() {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    cache_t cache(&serializer, alt_cache_config_t(),
+                  &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD, repli_timestamp_t::invalid, 1);
+        buf_lock_t superblock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        buf_write_t sb_write(&superblock);
+        btree_slice_t::init_superblock(&superblock,
+                                       std::vector<char>(), std::vector<char>());
+    }
+
+    btree_slice_t slice(&cache, &get_global_perfmon_collection(), "unittest");
+
+    // Enough rows for a btree three levels deep.
+    const int num_rows = 50000;
+    {
+        std::vector<std::pair<store_key_t, counted_t<const ql::datum_t> > > rows;
+        for (int i = 0; i < num_rows; ++i) {
+            rows.push_back(std::make_pair(store_key_t(strprintf("row%08d", 2 * i)),
+                                          bulk_load_row(2 * i)));
+        }
+
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        rdb_bulk_load(rows, &slice, repli_timestamp_t::distant_past, superblock.get());
+    }
+
+    {
+        // The btree works like any other: we can add rows between the loaded ones.
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        for (int i = 0; i < 1000; ++i) {
+            point_write_response_t response;
+            rdb_modification_info_t mod_info;
+            rdb_set(store_key_t(strprintf("row%08d", 2 * i + 1)), bulk_load_row(2 * i + 1),
+                    true, &slice, repli_timestamp_t::distant_past, superblock.get(),
+                    &response, &mod_info, static_cast<profile::trace_t *>(NULL));
+            ASSERT_EQ(point_write_result_t::STORED, response.result);
+        }
+    }
+
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                                 &superblock, &txn);
+        for (int i = 0; i < 2 * num_rows + 1; ++i) {
+            point_read_response_t response;
+            rdb_get(store_key_t(strprintf("row%08d", i)), &slice, superblock.get(),
+                    &response, NULL);
+            if (i % 2 == 0 || i < 2000) {
+                ASSERT_TRUE(response.data.has());
+                ASSERT_EQ(*bulk_load_row(i), *response.data);
+            } else {
+                ASSERT_EQ(ql::datum_t(ql::datum_t::R_NULL), *response.data);
+            }
+            superblock.reset();
+            get_btree_superblock(txn.get(), access_t::read, &superblock);
+        }
+
+        // Counting every row doesn't need a scan, but counting some of them does.
+        int64_t count;
+        ASSERT_TRUE(get_btree_key_count_if_covered(superblock.get(),
+                                                   key_range_t::universe(), &count));
+        ASSERT_EQ(num_rows + 1000, count);
+        ASSERT_FALSE(get_btree_key_count_if_covered(
+                         superblock.get(),
+                         key_range_t(key_range_t::open, store_key_t("row00000000"),
+                                     key_range_t::none, store_key_t()),
+                         &count));
+    }
+}
+
+TEST(BTreeBulkLoad, LoadAndRead) {
+    run_in_thread_pool(&run_bulk_load_test);
+}
+
+}  // namespace unittest
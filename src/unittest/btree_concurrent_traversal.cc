@@ -0,0 +1,126 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "unittest/gtest.hpp"
+
+#include "arch/io/disk.hpp"
+#include "btree/concurrent_traversal.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "rdb_protocol/btree.hpp"
+#include "serializer/config.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+class key_collector_t : public concurrent_traversal_callback_t {
+public:
+    key_collector_t() { }
+
+    bool handle_pair(scoped_key_value_t &&keyvalue,
+                     concurrent_traversal_fifo_enforcer_signal_t waiter)
+        THROWS_ONLY(interrupted_exc_t) {
+        store_key_t key(keyvalue.key());
+        keyvalue.reset();
+        waiter.wait_interruptible();
+        keys.push_back(key);
+        return true;
+    }
+
+    std::vector<store_key_t> keys;
+};
+
+void run_split_traversal_test() {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    cache_t cache(&serializer, alt_cache_config_t(),
+                  &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD, repli_timestamp_t::invalid, 1);
+        buf_lock_t superblock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        buf_write_t sb_write(&superblock);
+        btree_slice_t::init_superblock(&superblock,
+                                       std::vector<char>(), std::vector<char>());
+    }
+
+    btree_slice_t slice(&cache, &get_global_perfmon_collection(), "unittest");
+
+    const int num_rows = 20000;
+    std::vector<store_key_t> all_keys;
+    {
+        std::vector<std::pair<store_key_t, counted_t<const ql::datum_t> > > rows;
+        for (int i = 0; i < num_rows; ++i) {
+            all_keys.push_back(store_key_t(strprintf("row%08d", i)));
+            rows.push_back(std::make_pair(all_keys.back(),
+                                          make_counted<ql::datum_t>(
+                                              static_cast<double>(i))));
+        }
+
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        rdb_bulk_load(rows, &slice, repli_timestamp_t::distant_past, superblock.get());
+    }
+
+    // Whole ranges, and ranges whose bounds are keys in the btree.
+    std::vector<std::pair<int, int> > bounds;
+    bounds.push_back(std::make_pair(0, num_rows));
+    bounds.push_back(std::make_pair(1234, 17777));
+    bounds.push_back(std::make_pair(5000, 5005));
+
+    for (auto it = bounds.begin(); it != bounds.end(); ++it) {
+        const key_range_t range(key_range_t::closed, all_keys[it->first],
+                                key_range_t::open,
+                                it->second == num_rows
+                                    ? store_key_t::max()
+                                    : all_keys[it->second]);
+        std::vector<store_key_t> expected(all_keys.begin() + it->first,
+                                          all_keys.begin() + it->second);
+
+        for (int max_subranges = 1; max_subranges <= 8; max_subranges *= 2) {
+            for (int d = 0; d < 2; ++d) {
+                const direction_t direction = d == 0 ? FORWARD : BACKWARD;
+                scoped_ptr_t<txn_t> txn;
+                scoped_ptr_t<real_superblock_t> superblock;
+                get_btree_superblock_and_txn_for_reading(&cache_conn,
+                                                         CACHE_SNAPSHOTTED_NO,
+                                                         &superblock, &txn);
+                key_collector_t collector;
+                ASSERT_TRUE(btree_concurrent_traversal(
+                    &slice, superblock.get(), range, &collector, direction,
+                    cache_access_pattern_t::normal, max_subranges));
+                if (direction == BACKWARD) {
+                    std::reverse(collector.keys.begin(), collector.keys.end());
+                }
+                ASSERT_EQ(expected, collector.keys);
+            }
+        }
+    }
+}
+
+TEST(BTreeConcurrentTraversal, SplitRanges) {
+    run_in_thread_pool(&run_split_traversal_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,158 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "unittest/gtest.hpp"
+
+#include "arch/io/disk.hpp"
+#include "btree/defragment.hpp"
+#include "btree/internal_node.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/protocol.hpp"
+#include "serializer/config.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+const int defragment_num_rows = 2000;
+
+store_key_t defragment_key(int i) {
+    return store_key_t(strprintf("row%08d", i));
+}
+
+counted_t<const ql::datum_t> defragment_row(int i) {
+    return make_counted<ql::datum_t>(std::string(200, 'a' + i % 26));
+}
+
+int count_leaves(buf_lock_t *node) {
+    buf_read_t read(node);
+    if (!node::is_internal(static_cast<const node_t *>(read.get_data_read()))) {
+        return 1;
+    }
+    auto internal = static_cast<const internal_node_t *>(read.get_data_read());
+    int count = 0;
+    for (int i = 0; i < internal->npairs; ++i) {
+        buf_lock_t child(node, internal_node::get_pair_by_index(internal, i)->lnode,
+                         access_t::read);
+        count += count_leaves(&child);
+    }
+    return count;
+}
+
+int count_leaves(cache_conn_t *cache_conn) {
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn_for_reading(cache_conn, CACHE_SNAPSHOTTED_NO,
+                                             &superblock, &txn);
+    buf_lock_t root(superblock->expose_buf(), superblock->get_root_block_id(),
+                    access_t::read);
+    return count_leaves(&root);
+}
+
+void run_defragment_test() {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    cache_t cache(&serializer, alt_cache_config_t(),
+                  &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD, repli_timestamp_t::invalid, 1);
+        buf_lock_t superblock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        buf_write_t sb_write(&superblock);
+        btree_slice_t::init_superblock(&superblock,
+                                       std::vector<char>(), std::vector<char>());
+    }
+
+    btree_slice_t slice(&cache, &get_global_perfmon_collection(), "unittest");
+
+    // Fill the btree, and then delete most of it.
+    for (int i = 0; i < defragment_num_rows; ++i) {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        point_write_response_t response;
+        rdb_modification_info_t mod_info;
+        rdb_set(defragment_key(i), defragment_row(i), true, &slice,
+                repli_timestamp_t::distant_past, superblock.get(),
+                &response, &mod_info, static_cast<profile::trace_t *>(NULL));
+    }
+    for (int i = 0; i < defragment_num_rows; ++i) {
+        if (i % 4 == 0) {
+            continue;
+        }
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        point_delete_response_t response;
+        rdb_modification_info_t mod_info;
+        rdb_delete(defragment_key(i), &slice, repli_timestamp_t::distant_past,
+                   superblock.get(), &response, &mod_info,
+                   static_cast<profile::trace_t *>(NULL));
+    }
+    const int leaves_before = count_leaves(&cache_conn);
+
+    // Small batches, so that batches end both in the middle of a parent's leaves
+    // and at the end of them.
+    value_sizer_t<rdb_value_t> sizer(cache.get_block_size());
+    store_key_t start_key = store_key_t::min();
+    int batches = 0;
+    for (bool more = true; more; ++batches) {
+        ASSERT_GT(defragment_num_rows, batches);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 3,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        more = btree_defragment_leaves(&sizer, superblock.get(), &start_key, 3);
+    }
+    const int leaves_after = count_leaves(&cache_conn);
+    EXPECT_GE(leaves_before, leaves_after);
+    EXPECT_LE(leaves_after / 3, batches);
+
+    // The rows are all still there.
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                             &superblock, &txn);
+    for (int i = 0; i < defragment_num_rows; ++i) {
+        point_read_response_t response;
+        rdb_get(defragment_key(i), &slice, superblock.get(), &response, NULL);
+        if (i % 4 == 0) {
+            ASSERT_TRUE(response.data.has());
+            ASSERT_EQ(*defragment_row(i), *response.data);
+        } else {
+            ASSERT_EQ(ql::datum_t::R_NULL, response.data->get_type());
+        }
+        superblock.reset();
+        get_btree_superblock(txn.get(), access_t::read, &superblock);
+    }
+}
+
+TEST(BTreeDefragment, RowsSurvive) {
+    run_in_thread_pool(run_defragment_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,119 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <map>
+#include <string>
+
+#include "unittest/gtest.hpp"
+
+#include "arch/io/disk.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/protocol.hpp"
+#include "serializer/config.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+int64_t total_count(const std::map<store_key_t, int64_t> &counts) {
+    int64_t total = 0;
+    for (auto it = counts.begin(); it != counts.end(); ++it) {
+        total += it->second;
+    }
+    return total;
+}
+
+void run_sampled_distribution_test() {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    cache_t cache(&serializer, alt_cache_config_t(),
+                  &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD, repli_timestamp_t::invalid, 1);
+        buf_lock_t superblock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        buf_write_t sb_write(&superblock);
+        btree_slice_t::init_superblock(&superblock,
+                                       std::vector<char>(), std::vector<char>());
+    }
+
+    btree_slice_t slice(&cache, &get_global_perfmon_collection(), "unittest");
+
+    // Most of the rows are small and start with "a", but the few rows that start
+    // with "b" are big.
+    const int num_small_rows = 20000;
+    const int num_big_rows = 200;
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        for (int i = 0; i < num_small_rows + num_big_rows; ++i) {
+            const bool big = i >= num_small_rows;
+            counted_t<const ql::datum_t> row = big
+                ? make_counted<ql::datum_t>(std::string(10000, 'x'))
+                : make_counted<ql::datum_t>(static_cast<double>(i));
+            point_write_response_t response;
+            rdb_modification_info_t mod_info;
+            rdb_set(store_key_t(strprintf("%s%08d", big ? "b" : "a", i)), row,
+                    true, &slice, repli_timestamp_t::distant_past, superblock.get(),
+                    &response, &mod_info, static_cast<profile::trace_t *>(NULL));
+            ASSERT_EQ(point_write_result_t::STORED, response.result);
+        }
+    }
+
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_YES,
+                                             &superblock, &txn);
+    distribution_read_response_t response;
+    rdb_distribution_sample(512, 16, store_key_t::min(), superblock.get(), &response);
+
+    // The estimates are random, but with this many samples they should be in the
+    // right ballpark, and the few leaves with big rows should get sampled.
+    const int64_t num_rows = num_small_rows + num_big_rows;
+    const int64_t estimated_rows = total_count(response.key_counts);
+    ASSERT_LT(num_rows / 2, estimated_rows);
+    ASSERT_GT(num_rows * 2, estimated_rows);
+
+    ASSERT_FALSE(response.key_counts.empty());
+    ASSERT_EQ(store_key_t::min(), response.key_counts.begin()->first);
+    ASSERT_GE(17u, response.key_counts.size());
+    ASSERT_FALSE(response.byte_counts.empty());
+    ASSERT_EQ(store_key_t::min(), response.byte_counts.begin()->first);
+    ASSERT_GE(17u, response.byte_counts.size());
+
+    // Most of the bytes are in the big rows, so unlike the keys, most of the
+    // byte-weighted buckets start at "b" keys.
+    int key_buckets_in_b = 0;
+    for (auto it = response.key_counts.begin(); it != response.key_counts.end(); ++it) {
+        key_buckets_in_b += store_key_t("b") < it->first ? 1 : 0;
+    }
+    int byte_buckets_in_b = 0;
+    for (auto it = response.byte_counts.begin(); it != response.byte_counts.end(); ++it) {
+        byte_buckets_in_b += store_key_t("b") < it->first ? 1 : 0;
+    }
+    ASSERT_GT(byte_buckets_in_b, key_buckets_in_b);
+    ASSERT_LT(static_cast<int>(response.byte_counts.size()) / 2, byte_buckets_in_b);
+}
+
+TEST(BTreeDistribution, Sampled) {
+    run_in_thread_pool(&run_sampled_distribution_test);
+}
+
+}  // namespace unittest
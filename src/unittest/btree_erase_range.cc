@@ -0,0 +1,156 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "unittest/gtest.hpp"
+
+#include "arch/io/disk.hpp"
+#include "btree/erase_range.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/protocol.hpp"
+#include "serializer/config.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+counted_t<const ql::datum_t> erase_range_row(int i) {
+    // Some of the rows are big enough to need blobs, which the erase must delete.
+    if (i % 50 == 0) {
+        return make_counted<ql::datum_t>(std::string(3000, 'a' + i % 26));
+    }
+    return make_counted<ql::datum_t>(static_cast<double>(i));
+}
+
+store_key_t erase_range_key(int i) {
+    return store_key_t(strprintf("row%08d", i));
+}
+
+int64_t get_population(superblock_t *superblock) {
+    buf_lock_t stat_block(buf_parent_t(superblock->expose_buf().txn()),
+                          superblock->get_stat_block_id(), access_t::read);
+    buf_read_t read(&stat_block);
+    return static_cast<const btree_statblock_t *>(read.get_data_read())->population;
+}
+
+void run_erase_range_drops_subtrees_test() {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    cache_t cache(&serializer, alt_cache_config_t(),
+                  &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD, repli_timestamp_t::invalid, 1);
+        buf_lock_t superblock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        buf_write_t sb_write(&superblock);
+        btree_slice_t::init_superblock(&superblock,
+                                       std::vector<char>(), std::vector<char>());
+    }
+
+    btree_slice_t slice(&cache, &get_global_perfmon_collection(), "unittest");
+
+    // Enough rows for a btree three levels deep, so that the erase drops whole
+    // internal nodes' worth of leaves and descends into those at its edges.
+    const int num_rows = 50000;
+    {
+        std::vector<std::pair<store_key_t, counted_t<const ql::datum_t> > > rows;
+        for (int i = 0; i < num_rows; ++i) {
+            rows.push_back(std::make_pair(erase_range_key(i), erase_range_row(i)));
+        }
+
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        rdb_bulk_load(rows, &slice, repli_timestamp_t::distant_past, superblock.get());
+    }
+
+    // We erase the rows in (left, right].
+    const int left = 10000;
+    const int right = 40000;
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        ensure_stat_block(superblock.get());
+        const int64_t population_before = get_population(superblock.get());
+
+        value_sizer_t<rdb_value_t> sizer(cache.get_block_size());
+        always_true_key_tester_t tester;
+        rdb_value_deleter_t deleter;
+        const store_key_t left_key = erase_range_key(left);
+        const store_key_t right_key = erase_range_key(right);
+        cond_t non_interruptor;
+        btree_erase_range_generic(&sizer, &tester, &deleter,
+                                  left_key.btree_key(), right_key.btree_key(),
+                                  superblock.get(), &non_interruptor,
+                                  false /* don't release the superblock */);
+
+        ASSERT_EQ(right - left, population_before - get_population(superblock.get()));
+    }
+
+    {
+        // The btree still works like any other: we can put rows back into the
+        // erased range.
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        for (int i = left + 1; i <= left + 1000; ++i) {
+            point_write_response_t response;
+            rdb_modification_info_t mod_info;
+            rdb_set(erase_range_key(i), erase_range_row(i), true, &slice,
+                    repli_timestamp_t::distant_past, superblock.get(),
+                    &response, &mod_info, static_cast<profile::trace_t *>(NULL));
+            ASSERT_EQ(point_write_result_t::STORED, response.result);
+        }
+    }
+
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                                 &superblock, &txn);
+        for (int i = 0; i < num_rows; ++i) {
+            point_read_response_t response;
+            rdb_get(erase_range_key(i), &slice, superblock.get(), &response, NULL);
+            if (i <= left + 1000 || i > right) {
+                ASSERT_TRUE(response.data.has());
+                ASSERT_EQ(*erase_range_row(i), *response.data);
+            } else {
+                ASSERT_EQ(ql::datum_t(ql::datum_t::R_NULL), *response.data);
+            }
+            superblock.reset();
+            get_btree_superblock(txn.get(), access_t::read, &superblock);
+        }
+    }
+}
+
+TEST(BTreeEraseRange, DropsSubtrees) {
+    run_in_thread_pool(&run_erase_range_drops_subtrees_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,120 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "unittest/gtest.hpp"
+
+#include "arch/io/disk.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "config/args.hpp"
+#include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/lazy_json.hpp"
+#include "rdb_protocol/protocol.hpp"
+#include "serializer/config.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+counted_t<const ql::datum_t> inline_values_row(int i, size_t size) {
+    return make_counted<ql::datum_t>(std::string(size, 'a' + i % 26));
+}
+
+// Writes a row and returns the value that went into its leaf node.
+std::vector<char> set_inline_values_row(cache_conn_t *cache_conn, btree_slice_t *slice,
+                                        int i, size_t size) {
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn(cache_conn, write_access_t::write, 1,
+                                 repli_timestamp_t::distant_past,
+                                 write_durability_t::SOFT,
+                                 &superblock, &txn);
+    point_write_response_t response;
+    rdb_modification_info_t mod_info;
+    rdb_set(store_key_t(strprintf("row%08d", i)), inline_values_row(i, size),
+            true, slice, repli_timestamp_t::distant_past, superblock.get(),
+            &response, &mod_info, static_cast<profile::trace_t *>(NULL));
+    EXPECT_EQ(point_write_result_t::STORED, response.result);
+    return mod_info.added.second;
+}
+
+void run_inline_values_test() {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    cache_t cache(&serializer, alt_cache_config_t(),
+                  &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD, repli_timestamp_t::invalid, 1);
+        buf_lock_t superblock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        buf_write_t sb_write(&superblock);
+        btree_slice_t::init_superblock(&superblock,
+                                       std::vector<char>(), std::vector<char>());
+    }
+
+    btree_slice_t slice(&cache, &get_global_perfmon_collection(), "unittest");
+
+    // Rows written with the default inline value size: a 600-byte row doesn't fit.
+    for (int i = 0; i < 100; ++i) {
+        const std::vector<char> value = set_inline_values_row(&cache_conn, &slice,
+                                                              i, 600);
+        ASSERT_FALSE(value.empty());
+        EXPECT_FALSE(reinterpret_cast<const rdb_value_t *>(value.data())->is_wide());
+        EXPECT_GE(DEFAULT_INLINE_VALUE_SIZE, static_cast<int>(value.size()));
+    }
+
+    // Then the table keeps them inline, next to the rows it wrote before.
+    slice.set_value_maxreflen(MAX_INLINE_VALUE_SIZE);
+    for (int i = 100; i < 200; ++i) {
+        const std::vector<char> value = set_inline_values_row(&cache_conn, &slice,
+                                                              i, 600);
+        ASSERT_FALSE(value.empty());
+        const rdb_value_t *rdb_value
+            = reinterpret_cast<const rdb_value_t *>(value.data());
+        EXPECT_TRUE(rdb_value->is_wide());
+        EXPECT_EQ(MAX_INLINE_VALUE_SIZE, rdb_value->maxreflen());
+        EXPECT_LT(600, static_cast<int>(value.size()));
+    }
+    // ... but not the ones that are still too big.
+    {
+        const std::vector<char> value = set_inline_values_row(&cache_conn, &slice,
+                                                              200, 3000);
+        EXPECT_GT(100u, value.size());
+    }
+
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                                 &superblock, &txn);
+        for (int i = 0; i <= 200; ++i) {
+            point_read_response_t response;
+            rdb_get(store_key_t(strprintf("row%08d", i)), &slice, superblock.get(),
+                    &response, NULL);
+            ASSERT_TRUE(response.data.has());
+            ASSERT_EQ(*inline_values_row(i, i < 200 ? 600 : 3000), *response.data);
+            superblock.reset();
+            get_btree_superblock(txn.get(), access_t::read, &superblock);
+        }
+    }
+}
+
+TEST(BTreeInlineValues, WideValues) {
+    run_in_thread_pool(run_inline_values_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,58 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/routing_cache.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(BTreeRoutingCache, FindLeaf) {
+    btree_routing_cache_t cache;
+    const store_key_t b("b"), d("d"), f("f");
+
+    // Three leaves: (-inf, b], (b, d], and (f, +inf).  We don't know about (d, f].
+    cache.add_leaf(NULL, b.btree_key(), 10, cache.version());
+    cache.add_leaf(b.btree_key(), d.btree_key(), 11, cache.version());
+    cache.add_leaf(f.btree_key(), NULL, 13, cache.version());
+    ASSERT_EQ(3u, cache.num_routes());
+
+    block_id_t leaf_id;
+    ASSERT_TRUE(cache.find_leaf(store_key_t("a").btree_key(), &leaf_id));
+    ASSERT_EQ(10u, leaf_id);
+    ASSERT_TRUE(cache.find_leaf(b.btree_key(), &leaf_id));
+    ASSERT_EQ(10u, leaf_id);
+    ASSERT_TRUE(cache.find_leaf(store_key_t("c").btree_key(), &leaf_id));
+    ASSERT_EQ(11u, leaf_id);
+    ASSERT_TRUE(cache.find_leaf(d.btree_key(), &leaf_id));
+    ASSERT_EQ(11u, leaf_id);
+    ASSERT_FALSE(cache.find_leaf(store_key_t("e").btree_key(), &leaf_id));
+    ASSERT_FALSE(cache.find_leaf(f.btree_key(), &leaf_id));
+    ASSERT_TRUE(cache.find_leaf(store_key_t("g").btree_key(), &leaf_id));
+    ASSERT_EQ(13u, leaf_id);
+}
+
+TEST(BTreeRoutingCache, InvalidateAndWriters) {
+    btree_routing_cache_t cache;
+    const store_key_t key("k");
+    block_id_t leaf_id;
+
+    // A route found by a walk that began before the tree changed gets dropped.
+    const uint64_t old_version = cache.version();
+    cache.invalidate();
+    cache.add_leaf(NULL, NULL, 7, old_version);
+    ASSERT_FALSE(cache.find_leaf(key.btree_key(), &leaf_id));
+
+    cache.add_leaf(NULL, NULL, 7, cache.version());
+    ASSERT_TRUE(cache.find_leaf(key.btree_key(), &leaf_id));
+    ASSERT_EQ(7u, leaf_id);
+
+    // No routes are followed while a write is in progress.
+    cache.add_writer();
+    ASSERT_FALSE(cache.find_leaf(key.btree_key(), &leaf_id));
+    cache.remove_writer();
+    ASSERT_TRUE(cache.find_leaf(key.btree_key(), &leaf_id));
+
+    cache.invalidate();
+    ASSERT_EQ(0u, cache.num_routes());
+    ASSERT_FALSE(cache.find_leaf(key.btree_key(), &leaf_id));
+}
+
+}  // namespace unittest
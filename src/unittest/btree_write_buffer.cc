@@ -0,0 +1,123 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "unittest/gtest.hpp"
+
+#include "arch/io/disk.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
+#include "btree/write_buffer.hpp"
+#include "buffer_cache/alt/alt.hpp"
+#include "serializer/config.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+btree_write_buffer_t::message_t write_buffer_message(int i, bool deletion) {
+    btree_write_buffer_t::message_t message;
+    message.timestamp = repli_timestamp_t::distant_past.next();
+    message.deletion = deletion;
+    if (!deletion) {
+        const std::string value = strprintf("value%d", i);
+        message.value.assign(value.begin(), value.end());
+    }
+    return message;
+}
+
+void add_write_buffer_message(cache_conn_t *cache_conn, btree_write_buffer_t *buffer,
+                              int i, bool deletion) {
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn(cache_conn, write_access_t::write, 2,
+                                 repli_timestamp_t::distant_past,
+                                 write_durability_t::SOFT,
+                                 &superblock, &txn);
+    buffer->prepare(superblock->get());
+    buffer->add(superblock->expose_buf(), store_key_t(strprintf("key%04d", i % 50)),
+                write_buffer_message(i, deletion));
+}
+
+void run_write_buffer_test() {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    cache_t cache(&serializer, alt_cache_config_t(),
+                  &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD, repli_timestamp_t::invalid, 1);
+        buf_lock_t superblock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        buf_write_t sb_write(&superblock);
+        btree_slice_t::init_superblock(&superblock,
+                                       std::vector<char>(), std::vector<char>());
+    }
+
+    btree_write_buffer_t buffer;
+    buffer.set_max_size(MEGABYTE);
+    EXPECT_TRUE(buffer.enabled());
+    EXPECT_TRUE(buffer.empty());
+
+    // 200 messages for 50 keys, the last of which (i >= 150) delete every other key.
+    for (int i = 0; i < 200; ++i) {
+        add_write_buffer_message(&cache_conn, &buffer, i, i >= 150 && i % 2 == 0);
+    }
+    EXPECT_FALSE(buffer.full());
+
+    // The log gives back each key's latest message.
+    btree_write_buffer_t reloaded;
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                                 &superblock, &txn);
+        reloaded.load(superblock->get());
+    }
+    for (int k = 0; k < 50; ++k) {
+        const store_key_t key(strprintf("key%04d", k));
+        const btree_write_buffer_t::message_t *message = reloaded.find(key);
+        ASSERT_TRUE(message != NULL);
+        ASSERT_EQ(buffer.find(key)->value, message->value);
+        EXPECT_EQ(k % 2 == 0, message->deletion);
+    }
+
+    // Taking the messages empties the log.
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        btree_write_buffer_t::message_map_t messages;
+        reloaded.take_all(superblock->expose_buf(), &messages);
+        EXPECT_EQ(50u, messages.size());
+        EXPECT_TRUE(reloaded.empty());
+    }
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                                 &superblock, &txn);
+        reloaded.load(superblock->get());
+        EXPECT_TRUE(reloaded.empty());
+    }
+}
+
+TEST(BTreeWriteBuffer, LogSurvivesReload) {
+    run_in_thread_pool(run_write_buffer_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,49 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <stdint.h>
+#include <string.h>
+
+#include <set>
+#include <vector>
+
+#include "arch/buffer_arena.hpp"
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(BufferArenaTest, AllocateAndReuse) {
+    // The arena is process-wide, so the tests that run after this one get their
+    // block buffers from it too.
+    init_buffer_arena(huge_page_mode_t::transparent_desired);
+
+    const size_t n = 1000;
+    std::vector<void *> bufs;
+    for (size_t i = 0; i < n; ++i) {
+        void *buf = buffer_arena_malloc(4 * KILOBYTE);
+        ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(buf) % DEVICE_BLOCK_SIZE);
+        memset(buf, static_cast<int>(i), 4 * KILOBYTE);
+        bufs.push_back(buf);
+    }
+    std::set<void *> distinct(bufs.begin(), bufs.end());
+    ASSERT_EQ(n, distinct.size());
+
+    for (size_t i = 0; i < n; ++i) {
+        buffer_arena_free(bufs[i]);
+    }
+    // The freed buffers are handed out again before any new memory is used.
+    for (size_t i = 0; i < n; ++i) {
+        void *buf = buffer_arena_malloc(4 * KILOBYTE);
+        ASSERT_EQ(1u, distinct.count(buf));
+        bufs[i] = buf;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        buffer_arena_free(bufs[i]);
+    }
+
+    // Buffers too big for the arena come from malloc, and are freed the same way.
+    scoped_arena_ptr_t<char> big(static_cast<size_t>(BUFFER_ARENA_MAX_BUFFER_SIZE + 1));
+    ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(big.get()) % DEVICE_BLOCK_SIZE);
+    memset(big.get(), 0, BUFFER_ARENA_MAX_BUFFER_SIZE + 1);
+}
+
+}  // namespace unittest
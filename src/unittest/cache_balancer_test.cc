@@ -0,0 +1,88 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "buffer_cache/alt/cache_balancer.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+typedef alt_cache_balancer_t::cache_data_t cache_data_t;
+
+uint64_t sum(const std::vector<uint64_t> &limits) {
+    uint64_t ret = 0;
+    for (auto it = limits.begin(); it != limits.end(); ++it) {
+        ret += *it;
+    }
+    return ret;
+}
+
+TEST(CacheBalancerTest, MissesAttractMemory) {
+    const uint64_t total = GIGABYTE;
+    std::vector<cache_data_t> caches;
+    // A cold table that fills its cache but hasn't read anything lately, and a hot
+    // table of the same size that misses all the time.
+    caches.push_back(cache_data_t(total / 2, 0));
+    caches.push_back(cache_data_t(total / 2, 100 * MEGABYTE));
+
+    std::vector<uint64_t> limits
+        = alt_cache_balancer_t::compute_memory_limits(total, caches);
+    ASSERT_EQ(2u, limits.size());
+    ASSERT_LE(sum(limits), total);
+    ASSERT_LT(limits[0], limits[1]);
+    ASSERT_LE(static_cast<uint64_t>(CACHE_BALANCER_MIN_CACHE_SIZE), limits[0]);
+}
+
+TEST(CacheBalancerTest, IdleCachesKeepTheirShare) {
+    const uint64_t total = GIGABYTE;
+    std::vector<cache_data_t> caches;
+    caches.push_back(cache_data_t(100 * MEGABYTE, 0));
+    caches.push_back(cache_data_t(300 * MEGABYTE, 0));
+
+    std::vector<uint64_t> limits
+        = alt_cache_balancer_t::compute_memory_limits(total, caches);
+    ASSERT_EQ(2u, limits.size());
+    ASSERT_LE(sum(limits), total);
+    ASSERT_LE(100 * MEGABYTE, limits[0]);
+    ASSERT_LE(300 * MEGABYTE, limits[1]);
+}
+
+TEST(CacheBalancerTest, TooManyCaches) {
+    const uint64_t total = 10 * CACHE_BALANCER_MIN_CACHE_SIZE;
+    std::vector<cache_data_t> caches(40, cache_data_t(MEGABYTE, MEGABYTE));
+
+    std::vector<uint64_t> limits
+        = alt_cache_balancer_t::compute_memory_limits(total, caches);
+    ASSERT_EQ(40u, limits.size());
+    ASSERT_LE(sum(limits), total);
+    ASSERT_EQ(limits.front(), limits.back());
+}
+
+TEST(CacheBalancerTest, TotalFollowsMemoryState) {
+    typedef alt_cache_balancer_t::memory_state_t memory_state_t;
+    const uint64_t max_total = GIGABYTE;
+    uint64_t total = max_total;
+
+    // It shrinks while memory is short, but not below the minimum,
+    uint64_t shrunk = alt_cache_balancer_t::compute_total_cache_size(
+        total, max_total, memory_state_t::SHORT);
+    ASSERT_LT(shrunk, total);
+    for (int i = 0; i < 100; ++i) {
+        total = alt_cache_balancer_t::compute_total_cache_size(
+            total, max_total, memory_state_t::SHORT);
+    }
+    ASSERT_EQ(static_cast<uint64_t>(CACHE_BALANCER_MIN_TOTAL_CACHE_SIZE), total);
+
+    // stays put while it's tight,
+    ASSERT_EQ(total, alt_cache_balancer_t::compute_total_cache_size(
+                  total, max_total, memory_state_t::TIGHT));
+
+    // and grows back to the full size once there's plenty.
+    uint64_t grown = alt_cache_balancer_t::compute_total_cache_size(
+        total, max_total, memory_state_t::PLENTY);
+    ASSERT_LT(total, grown);
+    for (int i = 0; i < 100; ++i) {
+        total = alt_cache_balancer_t::compute_total_cache_size(
+            total, max_total, memory_state_t::PLENTY);
+    }
+    ASSERT_EQ(max_total, total);
+}
+
+}  // namespace unittest
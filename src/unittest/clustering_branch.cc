@@ -162,6 +162,70 @@ TEST(ClusteringBranch, ReadWrite) {
     run_in_thread_pool_with_broadcaster(&run_read_write_test);
 }
 
+/* The `BatchedWrites` test sends many writes to the broadcaster at once, so that
+they go to the mirror together, and checks that each gets a response. */
+
+class counting_write_callback_t : public broadcaster_t<dummy_protocol_t>::write_callback_t, public cond_t {
+public:
+    counting_write_callback_t() : responses(0) { }
+    void on_response(peer_id_t, const dummy_protocol_t::write_response_t &) {
+        ++responses;
+    }
+    void on_done() {
+        pulse();
+    }
+    int responses;
+};
+
+void run_batched_writes_test(UNUSED io_backender_t *io_backender,
+                             simple_mailbox_cluster_t *cluster,
+                             branch_history_manager_t<dummy_protocol_t> *branch_history_manager,
+                             UNUSED clone_ptr_t<watchable_t<boost::optional<broadcaster_business_card_t<dummy_protocol_t> > > > broadcaster_metadata_view,
+                             scoped_ptr_t<broadcaster_t<dummy_protocol_t> > *broadcaster,
+                             UNUSED test_store_t<dummy_protocol_t> *store,
+                             scoped_ptr_t<listener_t<dummy_protocol_t> > *initial_listener,
+                             order_source_t *order_source) {
+    replier_t<dummy_protocol_t> replier(initial_listener->get(), cluster->get_mailbox_manager(), branch_history_manager);
+    let_stuff_happen();
+
+    const int num_writes = 200;
+    std::map<std::string, std::string> values_inserted;
+    boost::ptr_vector<counting_write_callback_t> callbacks;
+    for (int i = 0; i < num_writes; i++) {
+        unittest::fake_fifo_enforcement_t enforce;
+        fifo_enforcer_sink_t::exit_write_t exiter(&enforce.sink, enforce.source.enter_write());
+
+        dummy_protocol_t::write_t w;
+        std::string key = std::string(1, 'a' + randint(26));
+        w.values[key] = values_inserted[key] = strprintf("%d", i);
+        callbacks.push_back(new counting_write_callback_t);
+        cond_t non_interruptor;
+        spawn_write_fake_ack_checker_t ack_checker;
+        (*broadcaster)->spawn_write(w, &exiter, order_source->check_in("unittest::run_batched_writes_test(write)"), &callbacks.back(), &non_interruptor, &ack_checker);
+    }
+    for (int i = 0; i < num_writes; i++) {
+        callbacks[i].wait_lazily_unordered();
+        EXPECT_EQ(1, callbacks[i].responses);
+    }
+
+    for (std::map<std::string, std::string>::iterator it = values_inserted.begin();
+            it != values_inserted.end(); it++) {
+        unittest::fake_fifo_enforcement_t enforce;
+        fifo_enforcer_sink_t::exit_read_t exiter(&enforce.sink, enforce.source.enter_read());
+
+        dummy_protocol_t::read_t r;
+        r.keys.keys.insert(it->first);
+        cond_t non_interruptor;
+        dummy_protocol_t::read_response_t resp;
+        (*broadcaster)->read(r, &resp, &exiter, order_source->check_in("unittest::run_batched_writes_test(read)").with_read_mode(), &non_interruptor);
+        EXPECT_EQ(it->second, resp.values[it->first]);
+    }
+}
+
+TEST(ClusteringBranch, BatchedWrites) {
+    run_in_thread_pool_with_broadcaster(&run_batched_writes_test);
+}
+
 /* The `Backfill` test starts up a node with one mirror, inserts some data, and
 then adds another mirror. */
 
@@ -318,4 +382,37 @@ TEST(ClusteringBranch, PartialBackfill) {
     run_in_thread_pool_with_broadcaster(&run_partial_backfill_test);
 }
 
+/* `HistoryCompaction` makes sure that compacting the branch history keeps exactly
+the live branches and their ancestors. */
+
+TEST(ClusteringBranch, HistoryCompaction) {
+    const dummy_protocol_t::region_t region = dummy_protocol_t::region_t::universe();
+    branch_history_t<dummy_protocol_t> history;
+    const branch_id_t a = generate_uuid(), b = generate_uuid(), c = generate_uuid(),
+        d = generate_uuid();
+    const version_t origins[4] = {
+        version_t::zero(), version_t(a, state_timestamp_t::zero()),
+        version_t::zero(), version_t(b, state_timestamp_t::zero())
+    };
+    const branch_id_t ids[4] = { a, b, c, d };
+    for (int i = 0; i < 4; ++i) {
+        branch_birth_certificate_t<dummy_protocol_t> bc;
+        bc.region = region;
+        bc.initial_timestamp = state_timestamp_t::zero();
+        bc.origin = region_map_t<dummy_protocol_t, version_range_t>(region, version_range_t(origins[i]));
+        history.branches[ids[i]] = bc;
+    }
+
+    std::set<branch_id_t> live;
+    live.insert(d);
+    live.insert(generate_uuid());  // Branches we've never heard of are skipped.
+    branch_history_t<dummy_protocol_t> compacted;
+    collect_branch_ancestry(history, live, &compacted);
+    EXPECT_EQ(3u, compacted.branches.size());
+    EXPECT_EQ(1u, compacted.branches.count(a));
+    EXPECT_EQ(1u, compacted.branches.count(b));
+    EXPECT_EQ(0u, compacted.branches.count(c));
+    EXPECT_EQ(1u, compacted.branches.count(d));
+}
+
 }   /* namespace unittest */
@@ -1,12 +1,14 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "unittest/gtest.hpp"
 
+#include "arch/timing.hpp"
 #include "clustering/immediate_consistency/branch/broadcaster.hpp"
 #include "clustering/immediate_consistency/branch/listener.hpp"
 #include "clustering/immediate_consistency/branch/replier.hpp"
 #include "clustering/immediate_consistency/query/master.hpp"
 #include "clustering/reactor/blueprint.hpp"
 #include "clustering/reactor/namespace_interface.hpp"
+#include "config/args.hpp"
 #include "unittest/branch_history_manager.hpp"
 #include "unittest/clustering_utils.hpp"
 #include "mock/dummy_protocol.hpp"
@@ -83,5 +85,40 @@ TEST(ClusteringNamespaceInterface, ReadOutdated) {
     unittest::run_in_thread_pool(&run_read_outdated_test);
 }
 
+static void run_read_bounded_staleness_test() {
+    test_cluster_group_t<dummy_protocol_t> cluster_group(2);
+
+    cluster_group.construct_all_reactors(cluster_group.compile_blueprint("p,s"));
+
+    cluster_group.wait_until_blueprint_is_satisfied("p,s");
+
+    scoped_ptr_t<cluster_namespace_interface_t<dummy_protocol_t> > namespace_if;
+    cluster_group.make_namespace_interface(0, &namespace_if);
+
+    order_source_t order_source;
+    cond_t non_interruptor;
+
+    dummy_protocol_t::write_t w;
+    dummy_protocol_t::write_response_t wr;
+    w.values["a"] = "b";
+    namespace_if->write(w, &wr, order_source.check_in("unittest::run_read_bounded_staleness_test"), &non_interruptor);
+
+    /* Once the secondary has published the write's timestamp, reads with no
+    staleness allowed can go to either replica and must see it. */
+    nap(2 * REACTOR_PUBLISH_TIMESTAMP_INTERVAL);
+
+    for (int i = 0; i < 10; ++i) {
+        dummy_protocol_t::read_t r;
+        dummy_protocol_t::read_response_t rr;
+        r.keys.keys.insert("a");
+        namespace_if->read_bounded_staleness(r, &rr, 0, &non_interruptor);
+        EXPECT_EQ("b", rr.values["a"]);
+    }
+}
+
+TEST(ClusteringNamespaceInterface, ReadBoundedStaleness) {
+    unittest::run_in_thread_pool(&run_read_bounded_staleness_test);
+}
+
 }   /* namespace unittest */
 
@@ -57,4 +57,56 @@ TEST(ClusteringSuggester, NewNamespace) {
     EXPECT_EQ(machines.size(), blueprint.machines_roles.size());
 }
 
+TEST(ClusteringSuggester, BusyShardsCountForMore) {
+    datacenter_id_t datacenter = generate_uuid();
+    machine_id_t machines[2] = { generate_uuid(), generate_uuid() };
+    dummy_protocol_t::region_t busy_shard('a', 'h'), other_shards[2] = {
+        dummy_protocol_t::region_t('i', 'p'), dummy_protocol_t::region_t('q', 'z') };
+
+    std::map<machine_id_t, datacenter_id_t> machine_data_centers;
+    std::map<machine_id_t, reactor_business_card_t<dummy_protocol_t> > directory;
+    for (int i = 0; i < 2; i++) {
+        machine_data_centers[machines[i]] = datacenter;
+        reactor_business_card_t<dummy_protocol_t> rb;
+        rb.activities[generate_uuid()] = reactor_business_card_t<dummy_protocol_t>::activity_entry_t(a_thru_z_region(), reactor_business_card_t<dummy_protocol_t>::nothing_t());
+        directory[machines[i]] = rb;
+    }
+
+    /* Some other machine is the primary for the busy shard right now. */
+    reactor_business_card_t<dummy_protocol_t>::primary_t primary;
+    primary.writes_per_second = 5000;
+    reactor_business_card_t<dummy_protocol_t> rb;
+    rb.activities[generate_uuid()] = reactor_business_card_t<dummy_protocol_t>::activity_entry_t(busy_shard, primary);
+    directory[generate_uuid()] = rb;
+
+    nonoverlapping_regions_t<dummy_protocol_t> shards;
+    ASSERT_TRUE(shards.add_region(busy_shard));
+    ASSERT_TRUE(shards.add_region(other_shards[0]));
+    ASSERT_TRUE(shards.add_region(other_shards[1]));
+
+    std::map<machine_id_t, int> usage;
+    persistable_blueprint_t<dummy_protocol_t> blueprint = suggest_blueprint<dummy_protocol_t>(
+        directory,
+        datacenter,
+        std::map<datacenter_id_t, int>(),
+        shards,
+        machine_data_centers,
+        region_map_t<dummy_protocol_t, machine_id_t>(dummy_protocol_t::region_t::universe(), nil_uuid()),
+        region_map_t<dummy_protocol_t, std::set<machine_id_t> >(),
+        &usage,
+        true);
+
+    /* Whichever machine gets the busy shard shouldn't get any other. */
+    for (int i = 0; i < 2; i++) {
+        std::map<dummy_protocol_t::region_t, blueprint_role_t> roles = blueprint.machines_roles[machines[i]];
+        if (roles[busy_shard] == blueprint_role_primary) {
+            EXPECT_EQ(blueprint_role_nothing, roles[other_shards[0]]);
+            EXPECT_EQ(blueprint_role_nothing, roles[other_shards[1]]);
+        } else {
+            EXPECT_EQ(blueprint_role_primary, roles[other_shards[0]]);
+            EXPECT_EQ(blueprint_role_primary, roles[other_shards[1]]);
+        }
+    }
+}
+
 }  // namespace unittest
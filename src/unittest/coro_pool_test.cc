@@ -0,0 +1,79 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <algorithm>
+#include <functional>
+
+#include "arch/timing.hpp"
+#include "concurrency/coro_pool.hpp"
+#include "concurrency/mutex.hpp"
+#include "concurrency/queue/unlimited_fifo.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+struct elastic_pool_state_t {
+    elastic_pool_state_t() : sizer(1, 64, 1, &collection, "pool"),
+                             running(0), max_running(0), max_limit(0), done(0) { }
+    perfmon_collection_t collection;
+    coro_pool_sizer_t sizer;
+    // If `mutex` isn't `NULL`, the items take turns with it, so more workers don't
+    // get more done.
+    mutex_t *mutex;
+    int running, max_running, max_limit, done;
+};
+
+void run_item(elastic_pool_state_t *state, UNUSED int item, UNUSED signal_t *interruptor) {
+    ++state->running;
+    state->max_running = std::max(state->max_running, state->running);
+    state->max_limit = std::max(state->max_limit, state->sizer.limit());
+    if (state->mutex != NULL) {
+        mutex_t::acq_t acq(state->mutex);
+        nap(2);
+    } else {
+        nap(5);
+    }
+    --state->running;
+    ++state->done;
+}
+
+void run_elastic_pool(elastic_pool_state_t *state, int items) {
+    unlimited_fifo_queue_t<int> queue;
+    boost_function_callback_t<int> callback(
+        std::bind(&run_item, state, std::placeholders::_1, std::placeholders::_2));
+    coro_pool_t<int> pool(&state->sizer, &queue, &callback);
+    for (int i = 0; i < items; ++i) {
+        queue.push(i);
+    }
+    while (state->done < items) {
+        nap(10);
+    }
+}
+
+void elastic_pool_grows() {
+    elastic_pool_state_t state;
+    state.mutex = NULL;
+    run_elastic_pool(&state, 4000);
+    EXPECT_GE(state.max_limit, 8);
+    EXPECT_LE(state.max_running, 64);
+    EXPECT_LE(state.max_running, state.max_limit);
+}
+
+TEST(CoroPoolTest, ElasticGrows) {
+    run_in_thread_pool(&elastic_pool_grows, 1);
+}
+
+void elastic_pool_stays_small_when_bound() {
+    elastic_pool_state_t state;
+    mutex_t mutex;
+    state.mutex = &mutex;
+    run_elastic_pool(&state, 500);
+    // It tries one more worker, sees that it didn't help, and goes back.
+    EXPECT_LE(state.max_limit, 2);
+    EXPECT_EQ(1, state.sizer.limit());
+}
+
+TEST(CoroPoolTest, ElasticStaysSmallWhenBound) {
+    run_in_thread_pool(&elastic_pool_stays_small_when_bound, 1);
+}
+
+}  // namespace unittest
@@ -0,0 +1,36 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/coro_wait_profiler.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+void run_attributes_waits_to_sites() {
+    coro_wait_profiler_t::set_enabled(true);
+    {
+        coro_wait_site_t outer("outer site");
+        coro_wait_site_t inner("inner site");
+        for (int i = 0; i < CORO_WAIT_PROFILER_SAMPLE_INTERVAL * 10; ++i) {
+            coro_t::yield();
+        }
+    }
+    coro_wait_profiler_t::set_enabled(false);
+
+    std::string stacks = coro_wait_profiler_t::get_folded_stacks();
+    EXPECT_NE(std::string::npos, stacks.find("outer site;inner site "));
+
+    // Turning it back on starts over
+    coro_wait_profiler_t::set_enabled(true);
+    coro_wait_profiler_t::set_enabled(false);
+    EXPECT_EQ(std::string::npos,
+              coro_wait_profiler_t::get_folded_stacks().find("outer site"));
+}
+
+TEST(CoroWaitProfiler, AttributesWaitsToSites) {
+    run_in_thread_pool(&run_attributes_waits_to_sites);
+}
+
+}  // namespace unittest
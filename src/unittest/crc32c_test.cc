@@ -0,0 +1,32 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+
+#include "arch/crc32c.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(Crc32cTest, KnownValues) {
+    EXPECT_EQ(0u, crc32c(0, "", 0));
+    EXPECT_EQ(0xe3069283u, crc32c(0, "123456789", 9));
+    const std::string zeros(32, '\0');
+    EXPECT_EQ(0x8a9136aau, crc32c(0, zeros.data(), zeros.size()));
+}
+
+TEST(Crc32cTest, Incremental) {
+    std::string data;
+    for (int i = 0; i < 1000; ++i) {
+        data.push_back(static_cast<char>(i * 7 + i / 13));
+    }
+    const uint32_t whole = crc32c(0, data.data(), data.size());
+    // Splitting it anywhere, including at unaligned places, gives the same checksum.
+    for (size_t split = 0; split <= 17; ++split) {
+        uint32_t crc = crc32c(0, data.data(), split);
+        crc = crc32c(crc, data.data() + split, data.size() - split);
+        EXPECT_EQ(whole, crc);
+    }
+    data[500] ^= 1;
+    EXPECT_NE(whole, crc32c(0, data.data(), data.size()));
+}
+
+}  // namespace unittest
@@ -66,4 +66,48 @@ TEST(CrossThreadWatchable, CrossThreadWatchableTest) {
     unittest::run_in_thread_pool(&runCrossThreadWatchabletest, 2);
 }
 
+void wait_for_value(cross_thread_watchable_snapshots_t<int> *ctw, int thread,
+                    int expected_value) {
+    on_thread_t switcher((threadnum_t(thread)));
+    signal_timer_t timer;
+    timer.start(5000);
+    ctw->get_watchable()->run_until_satisfied(boost::bind(&equals, expected_value, _1),
+                                              &timer);
+}
+
+void runCrossThreadSnapshotsTest() {
+    const int num_threads = 3;
+    watchable_variable_t<int> watchable(0);
+    cross_thread_watchable_snapshots_t<int> ctw(watchable.get_watchable());
+
+    try {
+        for (int i = 1; i <= 1000; ++i) {
+            watchable.set_value(i);
+            // Let some changes pile up, so that threads skip versions.
+            if (i % 25 != 0) {
+                continue;
+            }
+            for (int thread = 0; thread < num_threads; ++thread) {
+                wait_for_value(&ctw, thread, i);
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        ASSERT_TRUE(false);
+    }
+
+    // Once they've caught up, every thread shares the same snapshot.
+    counted_t<const cross_thread_watchable_snapshots_t<int>::snapshot_t> snapshot
+        = ctw.get_snapshot();
+    ASSERT_EQ(1000, snapshot->value);
+    ASSERT_EQ(1000u, snapshot->version);
+    for (int thread = 1; thread < num_threads; ++thread) {
+        on_thread_t switcher((threadnum_t(thread)));
+        ASSERT_EQ(snapshot.get(), ctw.get_snapshot().get());
+    }
+}
+
+TEST(CrossThreadWatchable, Snapshots) {
+    unittest::run_in_thread_pool(&runCrossThreadSnapshotsTest, 3);
+}
+
 } //namespace unittest
@@ -0,0 +1,607 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "config/args.hpp"
+#include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/counted_term.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/wire_func.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+bool num_less(UNUSED ql::env_t *env, UNUSED profile::sampler_t *sampler,
+              const counted_t<const ql::datum_t> &left,
+              const counted_t<const ql::datum_t> &right) {
+    return left->as_num() < right->as_num();
+}
+
+// Makes a stream of the numbers below `num_elements` in a scrambled order, out of
+// arrays that each fit under the array size limit.
+counted_t<ql::datum_stream_t> scrambled_numbers(size_t num_elements) {
+    const ql::protob_t<const Backtrace> backtrace = ql::make_counted_backtrace();
+    std::vector<counted_t<ql::datum_stream_t> > streams;
+    std::vector<counted_t<const ql::datum_t> > arr;
+    for (size_t i = 0; i < num_elements; ++i) {
+        arr.push_back(make_counted<ql::datum_t>(
+                          static_cast<double>((i * 7919) % num_elements)));
+        if (arr.size() == ql::array_size_limit() || i + 1 == num_elements) {
+            streams.push_back(make_counted<ql::array_datum_stream_t>(
+                                  make_counted<ql::datum_t>(std::move(arr)), backtrace));
+            arr.clear();
+        }
+    }
+    return make_counted<ql::union_datum_stream_t>(streams, backtrace);
+}
+
+// Reads the stream, checking that it gives `first`, `first + 1`, ... `last - 1`.
+void check_sorted_numbers(ql::env_t *env, counted_t<ql::datum_stream_t> stream,
+                          size_t first, size_t last) {
+    const ql::batchspec_t batchspec
+        = ql::batchspec_t::user(ql::batch_type_t::NORMAL, env);
+    size_t next = first;
+    for (;;) {
+        std::vector<counted_t<const ql::datum_t> > batch
+            = stream->next_batch(env, batchspec);
+        if (batch.empty()) {
+            break;
+        }
+        for (auto it = batch.begin(); it != batch.end(); ++it) {
+            ASSERT_EQ(static_cast<double>(next), (*it)->as_num());
+            ++next;
+        }
+    }
+    ASSERT_EQ(last, next);
+}
+
+void run_spilling_sort_test() {
+    recreate_temporary_directory(base_path_t("."));
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    cond_t interruptor;
+    ql::env_t env(&interruptor);
+    env.io_backender = &io_backender;
+    env.spill_path = base_path_t(".");
+
+    // More elements than the array size limit, so that they get spilled.
+    const size_t num_elements = 2 * ql::array_size_limit() + 1234;
+    check_sorted_numbers(
+        &env,
+        make_counted<ql::sort_datum_stream_t>(scrambled_numbers(num_elements),
+                                              &num_less),
+        0, num_elements);
+}
+
+TEST(DatumStreamTest, SpillingSort) {
+    run_in_thread_pool(&run_spilling_sort_test);
+}
+
+void run_sort_without_spilling_test() {
+    cond_t interruptor;
+    ql::env_t env(&interruptor);
+
+    // Without an io_backender, sorting more than the array size limit fails, like
+    // it does for arrays.
+    counted_t<ql::datum_stream_t> stream = make_counted<ql::sort_datum_stream_t>(
+        scrambled_numbers(ql::array_size_limit() + 1), &num_less);
+    ASSERT_THROW(stream->next_batch(
+                     &env, ql::batchspec_t::user(ql::batch_type_t::NORMAL, &env)),
+                 ql::base_exc_t);
+
+    // But a sliced sort only keeps the elements it needs.
+    const size_t num_elements = 3 * ql::array_size_limit();
+    counted_t<ql::datum_stream_t> sorted = make_counted<ql::sort_datum_stream_t>(
+        scrambled_numbers(num_elements), &num_less);
+    check_sorted_numbers(&env, sorted->slice(10, 1000), 10, 1000);
+}
+
+TEST(DatumStreamTest, SortWithoutSpilling) {
+    run_in_thread_pool(&run_sort_without_spilling_test);
+}
+
+void run_top_k_test() {
+    cond_t interruptor;
+    ql::env_t env(&interruptor);
+    const ql::protob_t<const Backtrace> backtrace = ql::make_counted_backtrace();
+
+    // The largest five `n`s, in descending order, of objects that each shard might
+    // have added to its own list.
+    std::vector<std::pair<ql::order_direction_t, counted_t<ql::func_t> > > comparisons;
+    comparisons.push_back(std::make_pair(
+        ql::order_direction_t::DESC,
+        ql::new_get_field_func(make_counted<ql::datum_t>("n"), backtrace)));
+    const ql::top_k_wire_func_t top_k(ql::order_wire_func_t(comparisons), 5);
+
+    const size_t num_elements = 1000;
+    std::vector<counted_t<const ql::datum_t> > shards[3];
+    for (size_t i = 0; i < num_elements; ++i) {
+        std::map<std::string, counted_t<const ql::datum_t> > obj;
+        obj["n"] = make_counted<ql::datum_t>(
+            static_cast<double>((i * 7919) % num_elements));
+        top_k.add(&env, make_counted<ql::datum_t>(std::move(obj)), &shards[i % 3]);
+    }
+
+    // Merging them gives the five largest overall, the way unsharding does.
+    std::vector<counted_t<const ql::datum_t> > merged;
+    for (size_t i = 0; i < 3; ++i) {
+        ASSERT_EQ(5u, shards[i].size());
+        for (auto it = shards[i].begin(); it != shards[i].end(); ++it) {
+            top_k.add(&env, *it, &merged);
+        }
+    }
+    ASSERT_EQ(5u, merged.size());
+    for (size_t i = 0; i < merged.size(); ++i) {
+        ASSERT_EQ(static_cast<double>(num_elements - 1 - i),
+                  merged[i]->get("n")->as_num());
+    }
+}
+
+TEST(DatumStreamTest, TopK) {
+    run_in_thread_pool(&run_top_k_test);
+}
+
+void run_sample_merge_test() {
+    // Two shards of very different sizes, numbered so we can tell them apart.
+    const ql::sample_wire_func_t func(100);
+    ql::reservoir_t small, large;
+    for (int i = 0; i < 50; ++i) {
+        func.add(make_counted<ql::datum_t>(static_cast<double>(i)), &small);
+    }
+    for (int i = 0; i < 10000; ++i) {
+        func.add(make_counted<ql::datum_t>(static_cast<double>(1000 + i)), &large);
+    }
+    ASSERT_EQ(50u, small.sample.size());
+    ASSERT_EQ(100u, large.sample.size());
+
+    func.merge(std::move(large), &small);
+    ASSERT_EQ(10050u, small.seen);
+    ASSERT_EQ(100u, small.sample.size());
+    std::set<double> values;
+    for (auto it = small.sample.begin(); it != small.sample.end(); ++it) {
+        values.insert((*it)->as_num());
+    }
+    ASSERT_EQ(100u, values.size());
+    // Nearly all of it should come from the larger shard.
+    ASSERT_LT(std::distance(values.begin(), values.lower_bound(1000.0)), 10);
+}
+
+TEST(DatumStreamTest, SampleMerge) {
+    run_in_thread_pool(&run_sample_merge_test);
+}
+
+counted_t<const ql::datum_t> object_with_field(const std::string &key, double value) {
+    std::map<std::string, counted_t<const ql::datum_t> > obj;
+    obj[key] = make_counted<ql::datum_t>(value);
+    return make_counted<ql::datum_t>(std::move(obj));
+}
+
+void run_batch_functions_test() {
+    cond_t interruptor;
+    ql::env_t env(&interruptor);
+    const ql::protob_t<const Backtrace> backtrace = ql::make_counted_backtrace();
+
+    std::vector<counted_t<const ql::datum_t> > data;
+    for (size_t i = 0; i < 10; ++i) {
+        data.push_back(object_with_field("a", static_cast<double>(i % 3)));
+    }
+    data.push_back(object_with_field("b", 1.0));
+
+    // `filter`'s object shortcut, a function that returns the object.
+    std::map<std::string, counted_t<const ql::datum_t> > predicate;
+    predicate["a"] = make_counted<ql::datum_t>(1.0);
+    counted_t<ql::func_t> filter_func = ql::new_constant_func(
+        make_counted<ql::datum_t>(std::move(predicate)), backtrace);
+    std::vector<counted_t<const ql::datum_t> > filtered = data;
+    filter_func->filter_batch(&env, &filtered, counted_t<ql::func_t>());
+    ASSERT_EQ(3u, filtered.size());
+    for (auto it = filtered.begin(); it != filtered.end(); ++it) {
+        ASSERT_EQ(1.0, (*it)->get("a")->as_num());
+    }
+
+    // A missing field is still an error for `map`, from whichever row has it.
+    counted_t<ql::func_t> get_a = ql::new_get_field_func(
+        make_counted<ql::datum_t>("a"), backtrace);
+    std::vector<counted_t<const ql::datum_t> > mapped(data.begin(), data.end() - 1);
+    get_a->map_batch(&env, &mapped);
+    for (size_t i = 0; i < mapped.size(); ++i) {
+        ASSERT_EQ(static_cast<double>(i % 3), mapped[i]->as_num());
+    }
+    mapped = data;
+    ASSERT_THROW(get_a->map_batch(&env, &mapped), ql::base_exc_t);
+}
+
+TEST(DatumStreamTest, BatchFunctions) {
+    run_in_thread_pool(&run_batch_functions_test);
+}
+
+// Makes a stream of objects with `key` set to each of `values`, out of arrays that
+// each fit under the array size limit.
+counted_t<ql::datum_stream_t> objects_with_field(const std::string &key,
+                                                 const std::vector<double> &values) {
+    const ql::protob_t<const Backtrace> backtrace = ql::make_counted_backtrace();
+    std::vector<counted_t<ql::datum_stream_t> > streams;
+    std::vector<counted_t<const ql::datum_t> > arr;
+    for (size_t i = 0; i < values.size(); ++i) {
+        arr.push_back(object_with_field(key, values[i]));
+        if (arr.size() == ql::array_size_limit() || i + 1 == values.size()) {
+            streams.push_back(make_counted<ql::array_datum_stream_t>(
+                                  make_counted<ql::datum_t>(std::move(arr)), backtrace));
+            arr.clear();
+        }
+    }
+    return make_counted<ql::union_datum_stream_t>(streams, backtrace);
+}
+
+std::vector<counted_t<const ql::datum_t> > read_all(
+        ql::env_t *env, counted_t<ql::datum_stream_t> stream) {
+    const ql::batchspec_t batchspec
+        = ql::batchspec_t::user(ql::batch_type_t::NORMAL, env);
+    std::vector<counted_t<const ql::datum_t> > ret;
+    for (;;) {
+        std::vector<counted_t<const ql::datum_t> > batch
+            = stream->next_batch(env, batchspec);
+        if (batch.empty()) {
+            return ret;
+        }
+        ret.insert(ret.end(), batch.begin(), batch.end());
+    }
+}
+
+void run_hash_join_test() {
+    recreate_temporary_directory(base_path_t("."));
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    cond_t interruptor;
+    ql::env_t env(&interruptor);
+    env.io_backender = &io_backender;
+    env.spill_path = base_path_t(".");
+    const ql::protob_t<const Backtrace> backtrace = ql::make_counted_backtrace();
+    // The join function only gets called to report errors, so any will do here.
+    counted_t<ql::func_t> f = ql::new_get_field_func(
+        make_counted<ql::datum_t>("a"), backtrace);
+
+    // Matches come in the order of the left rows, and then of the right rows.
+    std::vector<double> lefts = { 3, 0, 7, 1 };
+    std::vector<double> rights = { 0, 1, 2, 0, 1, 2 };
+    std::vector<counted_t<const ql::datum_t> > inner = read_all(
+        &env, make_counted<ql::hash_join_datum_stream_t>(
+            objects_with_field("a", lefts), objects_with_field("b", rights),
+            f, "a", "b", false));
+    ASSERT_EQ(4u, inner.size());
+    ASSERT_EQ(0.0, inner[0]->get("left")->get("a")->as_num());
+    ASSERT_EQ(0.0, inner[1]->get("right")->get("b")->as_num());
+    ASSERT_EQ(1.0, inner[3]->get("left")->get("a")->as_num());
+    std::vector<counted_t<const ql::datum_t> > outer = read_all(
+        &env, make_counted<ql::hash_join_datum_stream_t>(
+            objects_with_field("a", lefts), objects_with_field("b", rights),
+            f, "a", "b", true));
+    ASSERT_EQ(6u, outer.size());
+    ASSERT_EQ(3.0, outer[0]->get("left")->get("a")->as_num());
+    ASSERT_FALSE(outer[0]->get("right", ql::NOTHROW).has());
+
+    // A row without the field is an error, like it is for the join function.
+    ASSERT_THROW(read_all(&env, make_counted<ql::hash_join_datum_stream_t>(
+                              objects_with_field("a", lefts),
+                              objects_with_field("c", rights),
+                              f, "a", "b", false)),
+                 ql::base_exc_t);
+
+    // More right rows than the array size limit get partitioned onto disk.
+    const size_t num_rights = ql::array_size_limit() + 1234;
+    lefts.clear();
+    rights.clear();
+    size_t expected_matches = 0;
+    for (size_t i = 0; i < num_rights; ++i) {
+        rights.push_back(static_cast<double>(i));
+        const size_t left = (i * 7919) % (num_rights + 10);
+        lefts.push_back(static_cast<double>(left));
+        expected_matches += left < num_rights ? 1 : 0;
+    }
+    std::vector<counted_t<const ql::datum_t> > spilled = read_all(
+        &env, make_counted<ql::hash_join_datum_stream_t>(
+            objects_with_field("a", lefts), objects_with_field("b", rights),
+            f, "a", "b", true));
+    ASSERT_EQ(num_rights, spilled.size());
+    size_t matches = 0;
+    for (auto it = spilled.begin(); it != spilled.end(); ++it) {
+        counted_t<const ql::datum_t> right = (*it)->get("right", ql::NOTHROW);
+        if (right.has()) {
+            ASSERT_EQ((*it)->get("left")->get("a")->as_num(),
+                      right->get("b")->as_num());
+            ++matches;
+        }
+    }
+    ASSERT_EQ(expected_matches, matches);
+}
+
+TEST(DatumStreamTest, HashJoin) {
+    run_in_thread_pool(&run_hash_join_test);
+}
+
+// A row whose fields can only be read if they're in `readable`.
+class test_row_fields_t : public ql::row_fields_t {
+public:
+    test_row_fields_t(const counted_t<const ql::datum_t> &_row,
+                      const std::set<std::string> &_readable)
+        : row(_row), readable(_readable) { }
+    bool get_field(const std::string &key, counted_t<const ql::datum_t> *out) const {
+        if (readable.count(key) == 0) {
+            return false;
+        }
+        *out = row->get(key, ql::NOTHROW);
+        return true;
+    }
+private:
+    counted_t<const ql::datum_t> row;
+    std::set<std::string> readable;
+};
+
+void run_prefilter_test() {
+    const ql::protob_t<const Backtrace> backtrace = ql::make_counted_backtrace();
+    std::map<std::string, counted_t<const ql::datum_t> > predicate;
+    predicate["a"] = make_counted<ql::datum_t>(1.0);
+    counted_t<ql::func_t> filter_func = ql::new_constant_func(
+        make_counted<ql::datum_t>(std::move(predicate)), backtrace);
+
+    const std::set<std::string> a_readable = { "a" };
+    bool passes;
+    ASSERT_TRUE(filter_func->prefilter(
+                    test_row_fields_t(object_with_field("a", 1.0), a_readable),
+                    &passes));
+    ASSERT_TRUE(passes);
+    ASSERT_TRUE(filter_func->prefilter(
+                    test_row_fields_t(object_with_field("a", 2.0), a_readable),
+                    &passes));
+    ASSERT_FALSE(passes);
+
+    // It can't tell when it can't read the field, or when the row not having it
+    // is an error that filter_call deals with.
+    ASSERT_FALSE(filter_func->prefilter(
+                     test_row_fields_t(object_with_field("a", 1.0),
+                                       std::set<std::string>()),
+                     &passes));
+    ASSERT_FALSE(filter_func->prefilter(
+                     test_row_fields_t(object_with_field("b", 1.0), a_readable),
+                     &passes));
+}
+
+TEST(DatumStreamTest, Prefilter) {
+    run_in_thread_pool(&run_prefilter_test);
+}
+
+void run_call_on_fields_test() {
+    const ql::protob_t<const Backtrace> backtrace = ql::make_counted_backtrace();
+    counted_t<ql::func_t> pluck_a = ql::new_pluck_func(
+        make_counted<ql::datum_t>("a"), backtrace);
+    const std::set<std::string> a_readable = { "a" };
+
+    std::map<std::string, counted_t<const ql::datum_t> > fields;
+    fields["a"] = make_counted<ql::datum_t>(1.0);
+    fields["b"] = make_counted<ql::datum_t>(2.0);
+    counted_t<const ql::datum_t> plucked;
+    ASSERT_TRUE(pluck_a->call_on_fields(
+                    test_row_fields_t(make_counted<ql::datum_t>(std::move(fields)),
+                                      a_readable),
+                    &plucked));
+    ASSERT_EQ(1u, plucked->as_object().size());
+    ASSERT_EQ(1.0, plucked->get("a")->as_num());
+
+    // Plucking a field the row doesn't have isn't an error.
+    ASSERT_TRUE(pluck_a->call_on_fields(
+                    test_row_fields_t(object_with_field("b", 1.0), a_readable),
+                    &plucked));
+    ASSERT_EQ(0u, plucked->as_object().size());
+
+    ASSERT_FALSE(pluck_a->call_on_fields(
+                     test_row_fields_t(object_with_field("a", 1.0),
+                                       std::set<std::string>()),
+                     &plucked));
+}
+
+TEST(DatumStreamTest, CallOnFields) {
+    run_in_thread_pool(&run_call_on_fields_test);
+}
+
+// How many elements a batch under `batchspec` would hold.
+int64_t batch_els(const ql::batchspec_t &batchspec) {
+    ql::batcher_t batcher = batchspec.to_batcher();
+    const counted_t<const ql::datum_t> el = make_counted<ql::datum_t>(0.0);
+    int64_t els = 1;
+    while (!batcher.note_el(el)) {
+        ++els;
+    }
+    return els;
+}
+
+void run_scale_down_test() {
+    const ql::batchspec_t batchspec
+        = ql::batchspec_t::user(ql::batch_type_t::TERMINAL,
+                                counted_t<const ql::datum_t>());
+    // With no limit on elements, each shard's batch is limited by size.
+    ASSERT_LT(1000, batch_els(batchspec.scale_down(8)));
+    // A limit is split between the shards, with a little slack.
+    const int64_t limited = batch_els(batchspec.with_at_most(10).scale_down(8));
+    ASSERT_LE(2, limited);
+    ASSERT_GE(5, limited);
+    const int64_t bigger = batch_els(batchspec.with_at_most(8000).scale_down(8));
+    ASSERT_LE(1000, bigger);
+    ASSERT_GE(1100, bigger);
+}
+
+TEST(DatumStreamTest, ScaleDown) {
+    run_in_thread_pool(&run_scale_down_test);
+}
+
+// Has `sizer` fetch a batch of as many elements as it asks for, taking `usecs`, for
+// a client that asks for it at `*now`; returns the number of elements.
+int64_t fetch_batch(ql::cursor_batch_sizer_t *sizer,
+                    const ql::batchspec_t &user_batchspec,
+                    microtime_t usecs, microtime_t *now) {
+    sizer->note_request(*now);
+    const int64_t els = batch_els(sizer->next_batchspec(user_batchspec, *now));
+    *now += usecs;
+    sizer->note_batch(els, *now);
+    sizer->note_sent(*now);
+    return els;
+}
+
+TEST(DatumStreamTest, CursorBatchSizer) {
+    const ql::batchspec_t user_batchspec
+        = ql::batchspec_t::user(ql::batch_type_t::NORMAL,
+                                counted_t<const ql::datum_t>());
+    ql::cursor_batch_sizer_t sizer;
+    microtime_t now = 1000 * 1000;
+
+    // A client that asks for each batch as soon as it gets the last one gets
+    // batches twice as big each time.
+    ASSERT_EQ(CURSOR_INITIAL_BATCH_ELS, fetch_batch(&sizer, user_batchspec, 100, &now));
+    ASSERT_EQ(2 * CURSOR_INITIAL_BATCH_ELS,
+              fetch_batch(&sizer, user_batchspec, 200, &now));
+
+    // A slow client doesn't.
+    now += 10 * CURSOR_QUICK_CONTINUE_USECS;
+    ASSERT_EQ(2 * CURSOR_INITIAL_BATCH_ELS,
+              fetch_batch(&sizer, user_batchspec, 1000 * 1000, &now));
+
+    // And rows that suddenly got much slower to produce halve the batches.
+    now += 10 * CURSOR_QUICK_CONTINUE_USECS;
+    ASSERT_EQ(CURSOR_INITIAL_BATCH_ELS,
+              fetch_batch(&sizer, user_batchspec, 100, &now));
+
+    // The user's own limit still holds.
+    ASSERT_EQ(1, fetch_batch(&sizer, user_batchspec.with_at_most(1), 100, &now));
+}
+
+// Stands in for a table's stream: hands out `batches` in turn, giving up the CPU
+// before each one the way a read from the shards would, and fails instead of
+// handing out the batch at `fail_at`.
+class shard_reading_stream_t : public ql::eager_datum_stream_t {
+public:
+    shard_reading_stream_t(std::vector<std::vector<counted_t<const ql::datum_t> > >
+                               &&_batches,
+                           size_t _fail_at,
+                           size_t *_reads_in_flight,
+                           size_t *_max_reads_in_flight)
+        : ql::eager_datum_stream_t(ql::make_counted_backtrace()),
+          batches(std::move(_batches)), index(0), done(false), fail_at(_fail_at),
+          reads_in_flight(_reads_in_flight),
+          max_reads_in_flight(_max_reads_in_flight) { }
+
+    bool is_exhausted() const { return done && batch_cache_exhausted(); }
+    bool reads_from_shards() const { return true; }
+
+private:
+    bool is_array() { return false; }
+    std::vector<counted_t<const ql::datum_t> >
+    next_batch_impl(UNUSED ql::env_t *env, UNUSED const ql::batchspec_t &batchspec) {
+        ++*reads_in_flight;
+        *max_reads_in_flight = std::max(*max_reads_in_flight, *reads_in_flight);
+        coro_t::yield();
+        --*reads_in_flight;
+        if (index == fail_at) {
+            throw ql::datum_exc_t(ql::base_exc_t::GENERIC, "The shard went away.");
+        }
+        if (index == batches.size()) {
+            done = true;
+            return std::vector<counted_t<const ql::datum_t> >();
+        }
+        return std::move(batches[index++]);
+    }
+
+    std::vector<std::vector<counted_t<const ql::datum_t> > > batches;
+    size_t index;
+    bool done;
+    const size_t fail_at;
+    size_t *const reads_in_flight;
+    size_t *const max_reads_in_flight;
+};
+
+// Makes a union of table streams, the i-th with `num_batches[i]` batches of ten
+// rows, holding the numbers below the total number of rows once each.  The stream
+// numbered `failing_stream`, if any, fails at its second batch.
+counted_t<ql::datum_stream_t> union_of_table_streams(
+        const std::vector<size_t> &num_batches, size_t failing_stream,
+        size_t *reads_in_flight, size_t *max_reads_in_flight) {
+    std::vector<counted_t<ql::datum_stream_t> > streams;
+    size_t next_row = 0;
+    for (size_t i = 0; i < num_batches.size(); ++i) {
+        std::vector<std::vector<counted_t<const ql::datum_t> > >
+            batches(num_batches[i]);
+        for (size_t j = 0; j < batches.size(); ++j) {
+            for (size_t k = 0; k < 10; ++k) {
+                batches[j].push_back(make_counted<ql::datum_t>(
+                                         static_cast<double>(next_row++)));
+            }
+        }
+        streams.push_back(make_counted<shard_reading_stream_t>(
+                              std::move(batches),
+                              i == failing_stream ? 1 : SIZE_MAX,
+                              reads_in_flight, max_reads_in_flight));
+    }
+    return make_counted<ql::union_datum_stream_t>(streams,
+                                                  ql::make_counted_backtrace());
+}
+
+// Checks that `rows` are the numbers below `num_rows`, each exactly once.
+void check_each_row_once(const std::vector<counted_t<const ql::datum_t> > &rows,
+                         size_t num_rows) {
+    ASSERT_EQ(num_rows, rows.size());
+    std::set<double> seen;
+    for (auto it = rows.begin(); it != rows.end(); ++it) {
+        const double n = (*it)->as_num();
+        ASSERT_LE(0.0, n);
+        ASSERT_GT(static_cast<double>(num_rows), n);
+        ASSERT_TRUE(seen.insert(n).second);
+    }
+}
+
+void run_union_read_concurrently_test() {
+    cond_t interruptor;
+    ql::env_t env(&interruptor);
+    size_t reads_in_flight = 0;
+    size_t max_reads_in_flight = 0;
+
+    // Every row comes out exactly once, and the streams are read at the same time.
+    const std::vector<size_t> three_each = { 3, 3, 3, 3 };
+    check_each_row_once(
+        read_all(&env, union_of_table_streams(three_each, SIZE_MAX,
+                                              &reads_in_flight,
+                                              &max_reads_in_flight)),
+        120);
+    ASSERT_EQ(4u, max_reads_in_flight);
+    ASSERT_EQ(0u, reads_in_flight);
+
+    // A stream with no rows doesn't hold up the others, and streams that run out
+    // sooner than others don't either.
+    const std::vector<size_t> uneven = { 2, 0, 5, 1 };
+    check_each_row_once(
+        read_all(&env, union_of_table_streams(uneven, SIZE_MAX,
+                                              &reads_in_flight,
+                                              &max_reads_in_flight)),
+        80);
+    ASSERT_EQ(0u, reads_in_flight);
+
+    // An error reading one stream is an error reading the union, once the other
+    // streams' reads are done.
+    ASSERT_THROW(read_all(&env, union_of_table_streams(three_each, 1,
+                                                       &reads_in_flight,
+                                                       &max_reads_in_flight)),
+                 ql::base_exc_t);
+    ASSERT_EQ(0u, reads_in_flight);
+}
+
+TEST(DatumStreamTest, UnionReadConcurrently) {
+    run_in_thread_pool(&run_union_read_concurrently_test);
+}
+
+}  // namespace unittest
@@ -1,5 +1,8 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 
+#include "btree/field_dictionary.hpp"
+#include "config/args.hpp"
+#include "containers/archive/stl_types.hpp"
 #include "containers/archive/string_stream.hpp"
 #include "rdb_protocol/datum.hpp"
 #include "unittest/gtest.hpp"
@@ -62,6 +65,271 @@ TEST(DatumTest, NumericSerialization) {
     test_datum_serialization(make_counted<ql::datum_t>(std::move(vec)));
 }
 
+TEST(DatumTest, ObjectFields) {
+    ql::datum_ptr_t object(ql::datum_t::R_OBJECT);
+    const char *keys[] = { "m", "b", "z", "a", "q" };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        ASSERT_FALSE(object.add(keys[i], make_counted<ql::datum_t>(static_cast<double>(i))));
+    }
+    ASSERT_TRUE(object.add("b", make_counted<ql::datum_t>(10.0), ql::NOCLOBBER));
+    ASSERT_EQ(1.0, object->get("b")->as_num());
+    ASSERT_TRUE(object.add("b", make_counted<ql::datum_t>(10.0), ql::CLOBBER));
+    ASSERT_EQ(10.0, object->get("b")->as_num());
+    ASSERT_TRUE(object.delete_field("m"));
+    ASSERT_FALSE(object.delete_field("m"));
+    ASSERT_FALSE(object->get("m", ql::NOTHROW).has());
+
+    counted_t<const ql::datum_t> datum = object.to_counted();
+    const ql::datum_object_t &fields = datum->as_object();
+    ASSERT_EQ(4u, fields.size());
+    std::vector<std::string> sorted_keys;
+    for (auto it = fields.begin(); it != fields.end(); ++it) {
+        sorted_keys.push_back(it->first);
+    }
+    ASSERT_EQ((std::vector<std::string>{ "a", "b", "q", "z" }), sorted_keys);
+    ASSERT_EQ(3.0, fields.find("a")->second->as_num());
+    ASSERT_TRUE(fields.find("c") == fields.end());
+
+    // Objects with the same fields are equal however they were built.
+    std::map<std::string, counted_t<const ql::datum_t> > map;
+    map["z"] = make_counted<ql::datum_t>(2.0);
+    map["q"] = make_counted<ql::datum_t>(4.0);
+    map["b"] = make_counted<ql::datum_t>(10.0);
+    map["a"] = make_counted<ql::datum_t>(3.0);
+    ASSERT_EQ(*datum, ql::datum_t(std::move(map)));
+    ASSERT_EQ(*datum, ql::datum_t(datum->as_json()));
+    test_datum_serialization(datum);
+}
+
+std::string serialize_to_string(const counted_t<const ql::datum_t> &datum) {
+    string_stream_t write_stream;
+    write_message_t wm;
+    wm << datum;
+    int write_res = send_write_message(&write_stream, &wm);
+    EXPECT_EQ(0, write_res);
+    EXPECT_EQ(serialized_size(datum), write_stream.str().size());
+    return write_stream.str();
+}
+
+counted_t<const ql::datum_t> read_field(const std::string &serialized,
+                                        const std::string &key, bool *indexed_out) {
+    string_read_stream_t read_stream(std::string(serialized), 0);
+    counted_t<const ql::datum_t> value;
+    EXPECT_EQ(ARCHIVE_SUCCESS,
+              deserialize_field(&read_stream, key, NULL, indexed_out, &value));
+    return value;
+}
+
+TEST(DatumTest, SerializedSizeCache) {
+    // Each level's size is cached when the level above asks for it, so the sizes
+    // must still be right when they're asked for again.
+    counted_t<const ql::datum_t> datum = make_counted<ql::datum_t>(std::string("leaf"));
+    std::vector<counted_t<const ql::datum_t> > levels;
+    for (int i = 0; i < 10; ++i) {
+        std::map<std::string, counted_t<const ql::datum_t> > map;
+        map["a"] = datum;
+        map["b"] = make_counted<ql::datum_t>(static_cast<double>(i));
+        datum = make_counted<ql::datum_t>(std::move(map));
+        levels.push_back(datum);
+    }
+    size_t size = serialized_size(datum);
+    ASSERT_EQ(size, serialized_size(datum));
+    ASSERT_EQ(size, serialize_to_string(datum).size());
+    for (auto it = levels.begin(); it != levels.end(); ++it) {
+        serialize_to_string(*it);
+    }
+}
+
+TEST(DatumTest, ObjectFieldDeserialization) {
+    std::map<std::string, counted_t<const ql::datum_t> > inner;
+    inner["x"] = make_counted<ql::datum_t>(1.0);
+    inner["y"] = make_counted<ql::datum_t>(std::string(1000, 'y'));
+
+    std::map<std::string, counted_t<const ql::datum_t> > object;
+    object["a"] = make_counted<ql::datum_t>(std::string(100, 'a'));
+    object["b"] = make_counted<ql::datum_t>(std::move(inner));
+    object["c"] = make_counted<ql::datum_t>(ql::datum_t::R_NULL);
+    object["id"] = make_counted<ql::datum_t>(-2.5);
+    object["z"] = make_counted<ql::datum_t>(ql::datum_t::R_BOOL, true);
+    const counted_t<const ql::datum_t> datum
+        = make_counted<ql::datum_t>(std::map<std::string, counted_t<const ql::datum_t> >(object));
+    test_datum_serialization(datum);
+
+    const std::string serialized = serialize_to_string(datum);
+    for (auto it = object.begin(); it != object.end(); ++it) {
+        bool indexed;
+        counted_t<const ql::datum_t> value = read_field(serialized, it->first, &indexed);
+        ASSERT_TRUE(indexed);
+        ASSERT_TRUE(value.has());
+        ASSERT_EQ(*it->second, *value);
+    }
+    const char *absent[] = { "", "0", "aa", "d", "zz" };
+    for (size_t i = 0; i < sizeof(absent) / sizeof(absent[0]); ++i) {
+        bool indexed;
+        ASSERT_FALSE(read_field(serialized, absent[i], &indexed).has());
+        ASSERT_TRUE(indexed);
+    }
+
+    // Non-objects don't have a directory to read a field from.
+    bool indexed;
+    read_field(serialize_to_string(object["a"]), "a", &indexed);
+    ASSERT_FALSE(indexed);
+}
+
+std::string serialize_for_storage_to_string(const counted_t<const ql::datum_t> &datum,
+                                            field_dictionary_t *dictionary) {
+    string_stream_t write_stream;
+    write_message_t wm;
+    serialize_for_storage(&wm, datum, dictionary);
+    int write_res = send_write_message(&write_stream, &wm);
+    EXPECT_EQ(0, write_res);
+    EXPECT_EQ(storage_serialized_size(datum, dictionary), write_stream.str().size());
+    return write_stream.str();
+}
+
+TEST(DatumTest, FieldDictionary) {
+    std::map<std::string, counted_t<const ql::datum_t> > inner;
+    inner["description"] = make_counted<ql::datum_t>(std::string("inner"));
+    inner["x"] = make_counted<ql::datum_t>(1.0);
+    std::map<std::string, counted_t<const ql::datum_t> > object;
+    object["id"] = make_counted<ql::datum_t>(7.0);
+    object["description"] = make_counted<ql::datum_t>(std::string("outer"));
+    object["list_of_things"] = make_counted<ql::datum_t>(
+        std::vector<counted_t<const ql::datum_t> >(
+            3, make_counted<ql::datum_t>(std::move(inner))));
+    const counted_t<const ql::datum_t> datum
+        = make_counted<ql::datum_t>(std::move(object));
 
+    field_dictionary_t dictionary;
+    const std::string unassigned = serialize_for_storage_to_string(datum, &dictionary);
+    for (int i = 1; i < FIELD_DICTIONARY_PROMOTE_COUNT; ++i) {
+        serialize_for_storage_to_string(datum, &dictionary);
+    }
+    ASSERT_TRUE(dictionary.assign_pending_ids());
+    // "id" and "x" are too short to be worth an id.
+    ASSERT_EQ(2u, dictionary.size());
+    ASSERT_FALSE(dictionary.assign_pending_ids());
+
+    const std::string assigned = serialize_for_storage_to_string(datum, &dictionary);
+    ASSERT_LT(assigned.size(), unassigned.size());
+    const std::string *serializations[] = { &unassigned, &assigned };
+    for (size_t i = 0; i < 2; ++i) {
+        string_read_stream_t read_stream(std::string(*serializations[i]), 0);
+        counted_t<const ql::datum_t> deserialized;
+        ASSERT_EQ(ARCHIVE_SUCCESS,
+                  deserialize_from_storage(&read_stream, &deserialized, &dictionary));
+        ASSERT_EQ(*datum, *deserialized);
+
+        const char *keys[] = { "id", "description", "list_of_things" };
+        for (size_t j = 0; j < sizeof(keys) / sizeof(keys[0]); ++j) {
+            string_read_stream_t field_stream(std::string(*serializations[i]), 0);
+            bool indexed;
+            counted_t<const ql::datum_t> value;
+            ASSERT_EQ(ARCHIVE_SUCCESS,
+                      deserialize_field(&field_stream, keys[j], &dictionary,
+                                        &indexed, &value));
+            ASSERT_TRUE(indexed);
+            ASSERT_TRUE(value.has());
+            ASSERT_EQ(*datum->get(keys[j]), *value);
+        }
+    }
+
+    // The ids can't be read without the dictionary.
+    string_read_stream_t read_stream(std::string(assigned), 0);
+    counted_t<const ql::datum_t> deserialized;
+    ASSERT_EQ(ARCHIVE_RANGE_ERROR, deserialize(&read_stream, &deserialized));
+
+    // Without a dictionary, it's the usual serialization.
+    ASSERT_EQ(serialize_to_string(datum), serialize_for_storage_to_string(datum, NULL));
+}
+
+TEST(DatumTest, OldObjectFormat) {
+    // Objects used to be serialized as a type byte of 5 followed by the std::map.
+    std::map<std::string, counted_t<const ql::datum_t> > object;
+    object["a"] = make_counted<ql::datum_t>(1.0);
+    object["b"] = make_counted<ql::datum_t>(std::string("b"));
+
+    string_stream_t write_stream;
+    write_message_t wm;
+    wm << static_cast<int8_t>(5);
+    wm << object;
+    ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+
+    {
+        string_read_stream_t read_stream(std::string(write_stream.str()), 0);
+        counted_t<const ql::datum_t> deserialized_datum;
+        ASSERT_EQ(ARCHIVE_SUCCESS, deserialize(&read_stream, &deserialized_datum));
+        ASSERT_EQ(ql::datum_t(std::map<std::string, counted_t<const ql::datum_t> >(object)),
+                  *deserialized_datum);
+    }
+
+    bool indexed;
+    read_field(write_stream.str(), "a", &indexed);
+    ASSERT_FALSE(indexed);
+}
+
+TEST(DatumTest, WireDatumMap) {
+    // Equal data hash the same, so they find the same group.
+    ASSERT_EQ(ql::datum_t(0.0).hash(), ql::datum_t(-0.0).hash());
+    std::vector<counted_t<const ql::datum_t> > arr;
+    arr.push_back(make_counted<ql::datum_t>(1.0));
+    arr.push_back(make_counted<ql::datum_t>(std::string("a")));
+    ASSERT_EQ(ql::datum_t(std::vector<counted_t<const ql::datum_t> >(arr)).hash(),
+              ql::datum_t(std::vector<counted_t<const ql::datum_t> >(arr)).hash());
+
+    ql::wire_datum_map_t map;
+    const char *groups[] = { "c", "a", "b", "a", "c", "a" };
+    for (size_t i = 0; i < sizeof(groups) / sizeof(groups[0]); ++i) {
+        counted_t<const ql::datum_t> group
+            = make_counted<ql::datum_t>(std::string(groups[i]));
+        if (counted_t<const ql::datum_t> *count = map.find(group)) {
+            *count = make_counted<ql::datum_t>((*count)->as_num() + 1);
+        } else {
+            map.set(group, make_counted<ql::datum_t>(1.0));
+        }
+    }
+    ASSERT_TRUE(map.find(make_counted<ql::datum_t>(std::string("d"))) == NULL);
+
+    // Whatever order the groups are kept in, they come out sorted.
+    counted_t<const ql::datum_t> result = map.to_arr();
+    ASSERT_EQ(3u, result->size());
+    const char *sorted_groups[] = { "a", "b", "c" };
+    const double counts[] = { 3.0, 1.0, 2.0 };
+    for (size_t i = 0; i < result->size(); ++i) {
+        ASSERT_EQ(sorted_groups[i], result->get(i)->get("group")->as_str().to_std());
+        ASSERT_EQ(counts[i], result->get(i)->get("reduction")->as_num());
+    }
+}
+
+TEST(DatumTest, JsonText) {
+    // The direct encoder and parser agree with cJSON.
+    const char *texts[] = {
+        "null", "true", "false", "0", "-1.5", "6.02214179e23", "0.1",
+        "\"\"", "\"a\\\"b\\\\c\\/d\\n\\t\\u0001\"", "\"\\u00e9\\u20ac\\ud83d\\ude00\"",
+        "\"\\u0000x\\udc00y\"", "[]", "{}", " [ 1 , [ 2 , 3 ] , { } ] ",
+        "{\"b\": [true, null], \"a\": {\"c\": \"d\"}}",
+        "[1, 2] trailing garbage",
+    };
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+        scoped_cJSON_t cjson(cJSON_Parse(texts[i]));
+        ASSERT_TRUE(cjson.get() != NULL);
+        ql::datum_t expected(cjson.get());
+        counted_t<const ql::datum_t> parsed = ql::datum_t::from_json(texts[i]);
+        ASSERT_TRUE(parsed.has()) << texts[i];
+        ASSERT_EQ(expected, *parsed) << texts[i];
+
+        std::string json;
+        parsed->write_json(&json);
+        ASSERT_EQ(expected.as_json().PrintUnformatted(), json);
+    }
+
+    const char *bad_texts[] = {
+        "", "nul", "[1, 2", "[1 2]", "[1,]", "{\"a\" 1}", "{a: 1}", "{\"a\": 1,}",
+        "\"abc", "-", "\"\\u12\"",
+    };
+    for (size_t i = 0; i < sizeof(bad_texts) / sizeof(bad_texts[0]); ++i) {
+        ASSERT_FALSE(ql::datum_t::from_json(bad_texts[i]).has()) << bad_texts[i];
+    }
+}
 
 }  // namespace unittest
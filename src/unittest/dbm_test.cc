@@ -48,6 +48,44 @@ TEST(DBMTest, ReadAheadInterval) {
     ASSERT_EQ(100, end_offset);
 }
 
+void read_ahead_with_waste(read_ahead_window_t *window, int64_t blocks, int64_t wasted) {
+    for (int64_t i = 0; i < wasted; ++i) {
+        window->note_block_wasted();
+    }
+    window->note_blocks_read_ahead(blocks);
+}
+
+TEST(DBMTest, ReadAheadWindow) {
+    read_ahead_window_t window(100, 800, 1600);
+    ASSERT_EQ(800, window.size());
+
+    // Nothing is adjusted until enough blocks have been read ahead.
+    read_ahead_with_waste(&window, 10, 10);
+    ASSERT_EQ(800, window.size());
+
+    // Little waste grows the window, up to the maximum.
+    read_ahead_with_waste(&window, 1000, 0);
+    ASSERT_EQ(1600, window.size());
+    read_ahead_with_waste(&window, 1000, 0);
+    ASSERT_EQ(1600, window.size());
 
+    // Moderate waste leaves it alone.
+    read_ahead_with_waste(&window, 1000, 300);
+    ASSERT_EQ(1600, window.size());
+
+    // Lots of waste shrinks it, until read-ahead turns itself off.
+    read_ahead_with_waste(&window, 1000, 600);
+    ASSERT_EQ(800, window.size());
+    read_ahead_with_waste(&window, 1000, 600);
+    read_ahead_with_waste(&window, 1000, 600);
+    read_ahead_with_waste(&window, 1000, 600);
+    ASSERT_EQ(100, window.size());
+    read_ahead_with_waste(&window, 1000, 600);
+    ASSERT_EQ(0, window.size());
+
+    // And it stays off.
+    read_ahead_with_waste(&window, 1000, 0);
+    ASSERT_EQ(0, window.size());
+}
 
 }  // namespace unittest
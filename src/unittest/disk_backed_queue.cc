@@ -74,6 +74,44 @@ TEST(DiskBackedQueue, BigVals) {
     unittest::run_in_thread_pool(&run_big_values_test, 2);
 }
 
+void run_interleaved_test() {
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    const serializer_filepath_t serializer_path = dbq_serializer_path();
+
+    disk_backed_queue_t<std::string> queue(&io_backender, serializer_path, &get_global_perfmon_collection());
+    std::queue<std::string> ref_queue;
+
+    // Pops catch up with pushes now and then, so values get read from memory,
+    // from the file, and from both at once, and the queue starts over whenever
+    // it's empty.
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 5000; ++i) {
+            std::string val(randint(1000), 'a' + i % 26);
+            queue.push(val);
+            ref_queue.push(val);
+            if (randint(3) == 0) {
+                std::string x;
+                queue.pop(&x);
+                EXPECT_EQ(ref_queue.front(), x);
+                ref_queue.pop();
+            }
+        }
+        while (!ref_queue.empty()) {
+            EXPECT_FALSE(queue.empty());
+            std::string x;
+            queue.pop(&x);
+            EXPECT_EQ(ref_queue.front(), x);
+            ref_queue.pop();
+        }
+        EXPECT_TRUE(queue.empty());
+    }
+}
+
+TEST(DiskBackedQueue, Interleaved) {
+    unittest::run_in_thread_pool(&run_interleaved_test, 2);
+}
+
 static void randomly_delay(int, signal_t *) {
     nap(randint(100));
 }
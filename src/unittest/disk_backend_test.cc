@@ -0,0 +1,88 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <limits.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include <functional>
+
+#include "arch/io/disk.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+struct cond_iocallback_t : public iocallback_t, public cond_t {
+    void on_io_complete() {
+        pulse();
+    }
+};
+
+void run_roundtrip_test(file_io_backend_t io_backend) {
+    temp_file_t temp_file;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired,
+                                DEFAULT_MAX_CONCURRENT_IO_REQUESTS,
+                                io_backend);
+
+    scoped_ptr_t<file_t> file;
+    file_open_result_t res = open_file(temp_file.name().permanent_path().c_str(),
+                                       linux_file_t::mode_read
+                                       | linux_file_t::mode_write
+                                       | linux_file_t::mode_create,
+                                       &io_backender, &file);
+    ASSERT_NE(file_open_result_t::ERROR, res.outcome);
+
+    // Use more iovecs than a single pwritev() accepts, so that the backend has to
+    // split the write up.
+    const size_t num_chunks = IOV_MAX + 3;
+    const size_t chunk_size = DEVICE_BLOCK_SIZE;
+    const size_t total_size = num_chunks * chunk_size;
+    file->set_size(2 * total_size);
+
+    scoped_malloc_t<char> source(malloc_aligned(total_size, DEVICE_BLOCK_SIZE));
+    for (size_t i = 0; i < total_size; ++i) {
+        source.get()[i] = static_cast<char>(i * 7 + i / chunk_size);
+    }
+
+    {
+        cond_iocallback_t cb;
+        file->write_async(0, total_size, source.get(), DEFAULT_DISK_ACCOUNT, &cb,
+                          file_t::WRAP_IN_DATASYNCS);
+        cb.wait();
+    }
+
+    {
+        scoped_array_t<iovec> iovecs(num_chunks);
+        for (size_t i = 0; i < num_chunks; ++i) {
+            iovecs[i].iov_base = source.get() + i * chunk_size;
+            iovecs[i].iov_len = chunk_size;
+        }
+        cond_iocallback_t cb;
+        file->writev_async(total_size, total_size, std::move(iovecs),
+                           DEFAULT_DISK_ACCOUNT, &cb);
+        cb.wait();
+    }
+
+    scoped_malloc_t<char> dest(malloc_aligned(2 * total_size, DEVICE_BLOCK_SIZE));
+    {
+        cond_iocallback_t cb;
+        file->read_async(0, 2 * total_size, dest.get(), DEFAULT_DISK_ACCOUNT, &cb);
+        cb.wait();
+    }
+    ASSERT_EQ(0, memcmp(source.get(), dest.get(), total_size));
+    ASSERT_EQ(0, memcmp(source.get(), dest.get() + total_size, total_size));
+}
+
+TEST(DiskBackendTest, PoolRoundtrip) {
+    run_in_thread_pool(std::bind(run_roundtrip_test, file_io_backend_t::pool));
+}
+
+TEST(DiskBackendTest, UringRoundtrip) {
+    // Falls back to the pool backend where io_uring is not available, in which case
+    // this just repeats the test above.
+    run_in_thread_pool(std::bind(run_roundtrip_test, file_io_backend_t::uring_desired));
+}
+
+}  // namespace unittest
@@ -36,8 +36,12 @@ struct test_driver_t {
     std::set<accounting_diskmgr_action_t *> actions_that_have_begun;
     std::set<accounting_diskmgr_action_t *> actions_that_are_done;
 
+    // Whether the conflict resolver is waiting for us to call flush_ready_writes().
+    bool flush_scheduled;
+
     int old_thread_id;
-    test_driver_t() : conflict_resolver(&get_global_perfmon_collection()) {
+    test_driver_t() : conflict_resolver(&get_global_perfmon_collection()),
+                      flush_scheduled(false) {
         /* Fake thread-context to make perfmons work. */
         old_thread_id = linux_thread_pool_t::get_thread_id();
         linux_thread_pool_t::set_thread_id(0);
@@ -55,6 +59,22 @@ struct test_driver_t {
         conflict_resolver.submit(a);
     }
 
+    void enable_write_coalescing() {
+        conflict_resolver.schedule_flush_fun = boost::bind(
+            &test_driver_t::schedule_flush, this);
+    }
+
+    void schedule_flush() {
+        ASSERT_FALSE(flush_scheduled);
+        flush_scheduled = true;
+    }
+
+    void flush() {
+        ASSERT_TRUE(flush_scheduled);
+        flush_scheduled = false;
+        conflict_resolver.flush_ready_writes();
+    }
+
     action_t *make_action() {
         action_t *ret = new action_t;
         allocated_actions.push_back(ret);
@@ -278,6 +298,48 @@ TEST(DiskConflictTest, WriteReadSuperrange) {
     r.go();
 }
 
+/* CoalesceContiguousWrites verifies that contiguous writes that become ready together
+are run as one operation, and that non-contiguous ones are left alone. */
+
+TEST(DiskConflictTest, CoalesceContiguousWrites) {
+    test_driver_t d;
+    d.enable_write_coalescing();
+    const std::string a(DEVICE_BLOCK_SIZE, 'a');
+    const std::string b(DEVICE_BLOCK_SIZE, 'b');
+    const std::string c(DEVICE_BLOCK_SIZE, 'c');
+    // Submitted out of order; the conflict resolver sorts them by offset.
+    write_test_t w2(&d, DEVICE_BLOCK_SIZE, b);
+    write_test_t w1(&d, 0, a);
+    write_test_t w3(&d, 4 * DEVICE_BLOCK_SIZE, c);
+    ASSERT_FALSE(w1.was_sent());
+    ASSERT_FALSE(w2.was_sent());
+    ASSERT_FALSE(w3.was_sent());
+
+    d.flush();
+    ASSERT_EQ(2u, d.running_actions.size());
+    ASSERT_FALSE(w1.was_sent());
+    ASSERT_FALSE(w2.was_sent());
+    ASSERT_TRUE(w3.was_sent());
+
+    accounting_diskmgr_action_t *coalesced = NULL;
+    for (auto it = d.running_actions.begin(); it != d.running_actions.end(); ++it) {
+        if (*it != w3.action) {
+            coalesced = *it;
+        }
+    }
+    ASSERT_TRUE(coalesced != NULL);
+    ASSERT_EQ(0, coalesced->get_offset());
+    ASSERT_EQ(2u * DEVICE_BLOCK_SIZE, coalesced->get_count());
+
+    d.permit(coalesced);
+    ASSERT_TRUE(w1.was_completed());
+    ASSERT_TRUE(w2.was_completed());
+    w3.go();
+
+    read_test_t r(&d, 0, a + b);
+    r.go();
+}
+
 /* MetaTest is a sanity check to make sure that the above tests are actually testing something. */
 
 void cause_test_failure() {
@@ -0,0 +1,56 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "btree/external_sort.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// Adds `num_pairs` pairs in a scrambled order, and checks that they come out sorted.
+void run_external_sort_test(int num_pairs, size_t buffer_size, size_t fan_in) {
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    external_sorter_t sorter(&io_backender, base_path_t("."), "external_sort_test",
+                             &get_global_perfmon_collection(), buffer_size, fan_in);
+
+    for (int i = 0; i < num_pairs; ++i) {
+        const int n = (i * 7919) % num_pairs;
+        const std::string value = strprintf("value %d", n);
+        sorter.add(store_key_t(strprintf("key%08d", n)),
+                   std::vector<char>(value.begin(), value.end()));
+    }
+    ASSERT_EQ(num_pairs, sorter.num_pairs());
+    sorter.finish_adding();
+
+    external_sorter_t::pair_t pair;
+    for (int i = 0; i < num_pairs; ++i) {
+        ASSERT_TRUE(sorter.pop(&pair));
+        ASSERT_EQ(store_key_t(strprintf("key%08d", i)), pair.first);
+        ASSERT_EQ(strprintf("value %d", i),
+                  std::string(pair.second.begin(), pair.second.end()));
+    }
+    ASSERT_FALSE(sorter.pop(&pair));
+}
+
+void run_in_memory_test() {
+    run_external_sort_test(1000, 64 * MEGABYTE, 32);
+}
+
+TEST(ExternalSort, InMemory) {
+    run_in_thread_pool(&run_in_memory_test);
+}
+
+void run_multi_pass_merge_test() {
+    // A small buffer makes dozens of runs, and a fan-in of four makes merging them
+    // take several passes.
+    run_external_sort_test(10000, 64 * KILOBYTE, 4);
+}
+
+TEST(ExternalSort, MultiPassMerge) {
+    run_in_thread_pool(&run_multi_pass_merge_test);
+}
+
+}  // namespace unittest
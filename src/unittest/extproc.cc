@@ -6,9 +6,11 @@
 
 #include "arch/runtime/coroutines.hpp"
 #include "containers/archive/archive.hpp"
+#include "containers/archive/stl_types.hpp"
 #include "extproc/extproc_pool.hpp"
 #include "extproc/extproc_spawner.hpp"
 #include "extproc/extproc_job.hpp"
+#include "extproc/extproc_shm.hpp"
 #include "rpc/serialize_macros.hpp"
 #include "unittest/gtest.hpp"
 
@@ -133,6 +135,40 @@ private:
     uint64_t last_value;
 };
 
+// Sends a payload to the worker and gets it back.
+class echo_job_t {
+public:
+    echo_job_t(extproc_pool_t *pool, signal_t *interruptor) :
+        extproc_job(pool, &worker_fn, interruptor) { }
+
+    std::string run(const std::string &payload) {
+        write_message_t wm;
+        wm << payload;
+        int res = send_write_message(extproc_job.write_stream(), &wm);
+        guarantee(res == 0);
+
+        std::string result;
+        res = deserialize(extproc_job.read_stream(), &result);
+        guarantee(res == ARCHIVE_SUCCESS);
+        return result;
+    }
+
+private:
+    static bool worker_fn(read_stream_t *stream_in, write_stream_t *stream_out) {
+        std::string payload;
+        int res = deserialize(stream_in, &payload);
+        guarantee(res == ARCHIVE_SUCCESS);
+
+        write_message_t wm;
+        wm << payload;
+        res = send_write_message(stream_out, &wm);
+        guarantee(res == 0);
+        return true;
+    }
+
+    extproc_job_t extproc_job;
+};
+
 void run_simple_job_test() {
     extproc_pool_t pool(2);
     fib_job_t job(10, &pool, NULL);
@@ -145,6 +181,27 @@ TEST(ExtProc, SimpleJob) {
     unittest::run_in_thread_pool(boost::bind(&run_simple_job_test));
 }
 
+void run_large_payload_test() {
+    extproc_pool_t pool(1);
+
+    // Smaller than the shared memory ring, and big enough that some of it may have to
+    //  go over the socket after all
+    const size_t sizes[] = { 100, EXTPROC_SHM_RING_SIZE / 2, 3 * EXTPROC_SHM_RING_SIZE };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        std::string payload;
+        for (size_t j = 0; j < sizes[i]; ++j) {
+            payload.push_back(static_cast<char>('a' + j % 26));
+        }
+        echo_job_t job(&pool, NULL);
+        ASSERT_EQ(payload, job.run(payload));
+    }
+}
+
+TEST(ExtProc, LargePayload) {
+    extproc_spawner_t extproc_spawner;
+    unittest::run_in_thread_pool(boost::bind(&run_large_payload_test));
+}
+
 void run_talkative_job_test() {
     extproc_pool_t pool(2);
 
@@ -205,6 +262,21 @@ TEST(ExtProc, MultiJob) {
     }
 }
 
+void run_work_stealing_test() {
+    // With two threads, each worker is in its own sub-pool.  Both jobs run on this
+    //  thread, so the second only gets a worker by taking the other thread's.
+    extproc_pool_t pool(2);
+
+    collatz_job_t first_job(78, &pool, NULL);
+    collatz_job_t second_job(78, &pool, NULL);
+    ASSERT_EQ(first_job.step(), second_job.step());
+}
+
+TEST(ExtProc, WorkStealing) {
+    extproc_spawner_t extproc_spawner;
+    unittest::run_in_thread_pool(boost::bind(&run_work_stealing_test), 2);
+}
+
 class base_crash_job_t {
 public:
     base_crash_job_t(extproc_pool_t *pool,
@@ -0,0 +1,73 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "rdb_protocol/geo.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(GeoTest, GeohashEncode) {
+    EXPECT_EQ("ezs42", ql::geohash_encode(ql::geo_point_t(42.6, -5.6), 5));
+    EXPECT_EQ("u4pruydqqvj",
+              ql::geohash_encode(ql::geo_point_t(57.64911, 10.40744), 11));
+}
+
+TEST(GeoTest, Distance) {
+    // One degree of latitude is about 111 km.
+    const double d = ql::geo_distance(ql::geo_point_t(0, 0), ql::geo_point_t(1, 0));
+    EXPECT_LT(111000, d);
+    EXPECT_GT(111400, d);
+}
+
+// Whether one of `region`'s covering cells is a prefix of `point`'s geohash, i.e.
+// whether a read of the index for `region` would find `point`.
+bool covered(const ql::geo_region_t &region, const ql::geo_point_t &point) {
+    const std::string hash = ql::geohash_encode(point);
+    std::vector<std::string> cells = region.covering_cells();
+    EXPECT_LE(cells.size(), static_cast<size_t>(GEO_MAX_COVERING_CELLS));
+    for (auto it = cells.begin(); it != cells.end(); ++it) {
+        if (hash.compare(0, it->size(), *it) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST(GeoTest, Box) {
+    ql::geo_region_t box = ql::geo_region_t::box(ql::geo_point_t(40.8, -73.9),
+                                                 ql::geo_point_t(40.7, -74.0));
+    const ql::geo_point_t inside(40.75, -73.95);
+    EXPECT_TRUE(box.contains(inside));
+    EXPECT_TRUE(covered(box, inside));
+    EXPECT_FALSE(box.contains(ql::geo_point_t(40.75, -73.8)));
+    EXPECT_FALSE(box.contains(ql::geo_point_t(40.9, -73.95)));
+}
+
+TEST(GeoTest, Circle) {
+    const ql::geo_point_t center(51.5, -0.1);
+    ql::geo_region_t circle = ql::geo_region_t::circle(center, 10000);
+    EXPECT_TRUE(circle.contains(center));
+    EXPECT_TRUE(covered(circle, center));
+    const ql::geo_point_t near(51.55, -0.05);
+    EXPECT_TRUE(circle.contains(near));
+    EXPECT_TRUE(covered(circle, near));
+    EXPECT_FALSE(circle.contains(ql::geo_point_t(51.7, -0.1)));
+}
+
+TEST(GeoTest, CircleAcrossAntimeridian) {
+    ql::geo_region_t circle = ql::geo_region_t::circle(ql::geo_point_t(0, 179.99),
+                                                       50000);
+    const ql::geo_point_t other_side(0, -179.9);
+    EXPECT_TRUE(circle.contains(other_side));
+    EXPECT_TRUE(covered(circle, other_side));
+}
+
+TEST(GeoTest, HugeRegion) {
+    ql::geo_region_t circle = ql::geo_region_t::circle(ql::geo_point_t(0, 0), 2e7);
+    std::vector<std::string> cells = circle.covering_cells();
+    ASSERT_EQ(1u, cells.size());
+    EXPECT_EQ("", cells[0]);
+}
+
+}  // namespace unittest
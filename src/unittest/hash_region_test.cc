@@ -113,8 +113,60 @@ TEST(HashRegionTest, SpecialNonSquareRegionJoin) {
 }
 
 
+// The CPU shard of every key on disk depends on this hash, so it must
+// never change.
+uint64_t reference_hash(const std::string &s) {
+    uint64_t h = 0x47a59e381fb2dc06ULL;
+    for (size_t i = 0; i < s.size(); ++i) {
+        uint8_t ch = s[i];
+        uint64_t d = (((ch * 0x80200802ULL) & 0x0884422110ULL) * 0x0101010101ULL) << 23;
+        h += d;
+        h = h ^ (h >> 11) ^ (h << 21);
+    }
+    return h & 0x7fffffffffffffffULL;
+}
+
+TEST(HashRegionTest, HasherIsStable) {
+    std::string s;
+    for (int i = 0; i < 300; ++i) {
+        const uint64_t h = hash_region_hasher(reinterpret_cast<const uint8_t *>(s.data()),
+                                              s.size());
+        ASSERT_EQ(reference_hash(s), h);
+        ASSERT_LT(h, HASH_REGION_HASH_SIZE);
+        s.push_back(static_cast<char>(i * 37 + 11));
+    }
+}
 
+TEST(HashRegionTest, RegionContainsKey) {
+    const store_key_t key("Gamma");
+    const uint64_t h = hash_region_hasher(key.contents(), key.size());
+    key_range_t kr(key_range_t::closed, store_key_t("Alpha"), key_range_t::open, store_key_t("Delta"));
+    key_range_t other(key_range_t::closed, store_key_t("Delta"), key_range_t::none, store_key_t());
 
+    ASSERT_TRUE(region_contains_key(hash_region_t<key_range_t>(h, h + 1, kr), key));
+    ASSERT_FALSE(region_contains_key(hash_region_t<key_range_t>(h + 1, h + 2, kr), key));
+    ASSERT_FALSE(region_contains_key(hash_region_t<key_range_t>(h, h + 1, other), key));
+    ASSERT_FALSE(region_contains_key(hash_region_t<key_range_t>(), key));
+}
+
+TEST(HashRegionTest, PrecomputedHashes) {
+    std::vector<store_key_t> keys;
+    keys.push_back(store_key_t("Alpha"));
+    keys.push_back(store_key_t("Gamma"));
+    keys.push_back(store_key_t());
+    const std::vector<uint64_t> hashes = hash_region_hash_keys(keys);
+    ASSERT_EQ(keys.size(), hashes.size());
+
+    const hash_region_t<key_range_t> universe = hash_region_t<key_range_t>::universe();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        const uint64_t h = hash_region_hasher(keys[i].contents(), keys[i].size());
+        ASSERT_EQ(h, hashes[i]);
+        const hash_region_t<key_range_t> mono(h, h + 1, universe.inner);
+        ASSERT_TRUE(region_contains_key_with_precomputed_hash(mono, keys[i], hashes[i]));
+        ASSERT_EQ(region_contains_key(mono, keys[i]),
+                  region_contains_key_with_precomputed_hash(mono, keys[i], hashes[i]));
+    }
+}
 
 }  // namespace unittest
 
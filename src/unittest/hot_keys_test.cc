@@ -0,0 +1,56 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "btree/hot_keys.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(HotKeysTest, FindsHeavyHitters) {
+    hot_key_sketch_t sketch(16);
+    // Two hot keys among a thousand cold ones, each read once.
+    for (int i = 0; i < 1000; ++i) {
+        sketch.record(strprintf("cold%d", i));
+        if (i % 4 == 0) {
+            sketch.record("hot");
+        }
+        if (i % 8 == 0) {
+            sketch.record("warm");
+        }
+    }
+
+    std::vector<hot_key_sketch_t::entry_t> top = sketch.top(2);
+    ASSERT_EQ(2u, top.size());
+    EXPECT_EQ("hot", top[0].key);
+    EXPECT_EQ("warm", top[1].key);
+    for (size_t i = 0; i < top.size(); ++i) {
+        // The counts never underestimate, and overestimate by at most the error.
+        const uint64_t actual = (i == 0 ? 250 : 125);
+        EXPECT_LE(actual, top[i].count);
+        EXPECT_LE(top[i].count - top[i].error, actual);
+    }
+}
+
+TEST(HotKeysTest, Decay) {
+    hot_key_sketch_t sketch(4);
+    for (int i = 0; i < 10; ++i) {
+        sketch.record("old");
+    }
+    sketch.record("once");
+    sketch.decay();
+
+    std::vector<hot_key_sketch_t::entry_t> top = sketch.top(4);
+    ASSERT_EQ(1u, top.size());
+    EXPECT_EQ("old", top[0].key);
+    EXPECT_EQ(5u, top[0].count);
+
+    for (int i = 0; i < 6; ++i) {
+        sketch.record("new");
+    }
+    top = sketch.top(4);
+    ASSERT_EQ(2u, top.size());
+    EXPECT_EQ("new", top[0].key);
+}
+
+}  // namespace unittest
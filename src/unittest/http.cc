@@ -13,6 +13,7 @@
 #include "arch/io/network.hpp"
 #include "unittest/gtest.hpp"
 #include "http/http.hpp"
+#include "http/json.hpp"
 #include "http/routing_app.hpp"
 
 namespace unittest {
@@ -221,4 +222,21 @@ TEST(Http, InterruptRoutingApp) {
     run_in_thread_pool(boost::bind(&run_routing_app_test));
 }
 
+TEST(Http, StreamedJson) {
+    const char *text = "{\"a\":[1,2.5,\"x\\\"y\",{},[]],\"b\":{\"c\":null,\"d\":true},"
+        "\"e\":\"\",\"f\":[[[false]]]}";
+    scoped_cJSON_t json(cJSON_Parse(text));
+    ASSERT_TRUE(json.get() != NULL);
+    const std::string expected = json.PrintUnformatted();
+
+    // However small the chunks, the pieces add up to the whole document.
+    http_res_t res;
+    http_json_res(&json, &res);
+    ASSERT_TRUE(json.get() == NULL);
+    ASSERT_TRUE(res.body_source.get() != NULL);
+    std::string streamed;
+    while (res.body_source->next_chunk(1, &streamed)) { }
+    EXPECT_EQ(expected, streamed);
+}
+
 }
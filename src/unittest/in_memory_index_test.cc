@@ -0,0 +1,112 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <map>
+
+#include "serializer/log/lba/in_memory_index.hpp"
+#include "unittest/gtest.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+void check_matches(in_memory_index_t *index,
+                   const std::map<block_id_t, index_block_info_t> &expected,
+                   block_id_t end_block_id) {
+    ASSERT_EQ(end_block_id, index->end_block_id());
+    for (block_id_t id = 0; id < end_block_id; ++id) {
+        auto it = expected.find(id);
+        const index_block_info_t info
+            = it == expected.end() ? index_block_info_t() : it->second;
+        ASSERT_TRUE(info == index->get_block_info(id)) << "block id " << id;
+    }
+}
+
+TEST(InMemoryIndexTest, Unset) {
+    in_memory_index_t index;
+    ASSERT_EQ(0u, index.end_block_id());
+    ASSERT_TRUE(index_block_info_t() == index.get_block_info(12345));
+}
+
+TEST(InMemoryIndexTest, Roundtrip) {
+    in_memory_index_t index;
+    std::map<block_id_t, index_block_info_t> expected;
+    block_id_t end_block_id = 0;
+
+    const block_id_t num_ids = 100000;
+    for (int i = 0; i < 300000; ++i) {
+        const block_id_t id = randint(num_ids);
+
+        flagged_off64_t offset;
+        uint32_t ser_block_size;
+        switch (randint(8)) {
+        case 0:
+            // A deleted block.
+            offset = flagged_off64_t::unused();
+            ser_block_size = 0;
+            break;
+        case 1:
+            // An offset that isn't a multiple of DEVICE_BLOCK_SIZE.
+            offset = flagged_off64_t::make(randint(1 << 30) * 2 + 1);
+            ser_block_size = 4096;
+            break;
+        case 2:
+            // A block that is too big to be packed.
+            offset = flagged_off64_t::make(randint(1 << 20) * DEVICE_BLOCK_SIZE);
+            ser_block_size = 1 << 25;
+            break;
+        default:
+            offset = flagged_off64_t::make(
+                (static_cast<int64_t>(randint(1 << 30)) << 8) * DEVICE_BLOCK_SIZE);
+            ser_block_size = 1 + randint(8192);
+            break;
+        }
+
+        repli_timestamp_t recency;
+        switch (randint(8)) {
+        case 0:
+            recency = repli_timestamp_t::invalid;
+            break;
+        case 1:
+            // Far away from all the other recencies.
+            recency.longtime = (static_cast<uint64_t>(randint(1 << 30)) << 33) + i;
+            break;
+        default:
+            // Mostly increasing, like real recencies.
+            recency.longtime = 1000000 + i - randint(1000);
+            break;
+        }
+
+        index.set_block_info(id, recency, offset, ser_block_size);
+        const index_block_info_t info(offset, recency, ser_block_size);
+        if (info == index_block_info_t()) {
+            expected.erase(id);
+        } else {
+            expected[id] = info;
+        }
+        end_block_id = std::max(end_block_id, id + 1);
+    }
+    check_matches(&index, expected, end_block_id);
+
+    // Setting everything back to the default works too.
+    for (block_id_t id = 0; id < end_block_id; ++id) {
+        index.set_block_info(id, repli_timestamp_t::invalid,
+                             flagged_off64_t::unused(), 0);
+    }
+    check_matches(&index, std::map<block_id_t, index_block_info_t>(), end_block_id);
+}
+
+TEST(InMemoryIndexTest, DecreasingRecencies) {
+    // Recencies that keep getting older, as they can during LBA reconstruction, must
+    // be rebased correctly.
+    in_memory_index_t index;
+    std::map<block_id_t, index_block_info_t> expected;
+    const block_id_t num_ids = 50000;
+    for (block_id_t id = 0; id < num_ids; ++id) {
+        repli_timestamp_t recency;
+        recency.longtime = (num_ids - id) * 1000000ull;
+        flagged_off64_t offset = flagged_off64_t::make(id * 8 * DEVICE_BLOCK_SIZE);
+        index.set_block_info(id, recency, offset, 4096);
+        expected[id] = index_block_info_t(offset, recency, 4096);
+    }
+    check_matches(&index, expected, num_ids);
+}
+
+}  // namespace unittest
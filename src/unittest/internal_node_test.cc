@@ -1,11 +1,14 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include <algorithm>
+#include <set>
+#include <string>
 #include <vector>
 
 #include "unittest/gtest.hpp"
 
 #include "btree/internal_node.hpp"
 #include "btree/node.hpp"
+#include "containers/scoped.hpp"
 
 namespace unittest {
 
@@ -61,6 +64,57 @@ TEST(InternalNodeTest, Offsets) {
     EXPECT_EQ(9u, sizeof(btree_internal_pair));
 }
 
+std::string random_key_string(rng_t *rng, int min_length) {
+    // Few distinct bytes (including zero), so keys often share prefixes.
+    const char chars[3] = { '\0', 'a', 'b' };
+    std::string ret;
+    const int length = min_length + rng->randint(20);
+    for (int i = 0; i < length; ++i) {
+        ret.push_back(chars[rng->randint(3)]);
+    }
+    return ret;
+}
 
-}  // namespace unittest
+int sign(int x) {
+    return x < 0 ? -1 : x > 0 ? 1 : 0;
+}
+
+TEST(InternalNodeTest, KeyPrefixComparison) {
+    rng_t rng;
+    for (int i = 0; i < 10000; ++i) {
+        store_key_t left(random_key_string(&rng, 0));
+        store_key_t right(random_key_string(&rng, 0));
+        ASSERT_EQ(sign(btree_key_cmp(left.btree_key(), right.btree_key())),
+                  sign(btree_key_cmp(left.btree_key(), btree_key_prefix(left.btree_key()),
+                                     right.btree_key())));
+    }
+}
 
+TEST(InternalNodeTest, GetOffsetIndex) {
+    const block_size_t block_size = block_size_t::unsafe_make(4096);
+    scoped_malloc_t<internal_node_t> node(block_size.value());
+    internal_node::init(block_size, node.get());
+
+    rng_t rng;
+    std::set<std::string> keys;
+    for (block_id_t i = 1; keys.size() < 100; i += 2) {
+        std::string key = random_key_string(&rng, 1);
+        if (keys.count(key) == 0) {
+            ASSERT_TRUE(internal_node::insert(block_size, node.get(),
+                                              store_key_t(key).btree_key(), i, i + 1));
+            keys.insert(key);
+        }
+    }
+    verify(block_size, node.get());
+
+    std::vector<std::string> sorted(keys.begin(), keys.end());
+    for (int i = 0; i < 1000; ++i) {
+        const std::string probe = random_key_string(&rng, 0);
+        const int expected = std::lower_bound(sorted.begin(), sorted.end(), probe)
+            - sorted.begin();
+        ASSERT_EQ(expected, internal_node::get_offset_index(node.get(),
+                                                            store_key_t(probe).btree_key()));
+    }
+}
+
+}  // namespace unittest
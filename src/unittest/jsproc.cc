@@ -140,6 +140,115 @@ TEST(JSProc, EvalAndCall) {
     unittest::run_in_thread_pool(boost::bind(&run_eval_and_call_test));
 }
 
+void run_call_batch_test() {
+    extproc_pool_t extproc_pool(1);
+    js_runner_t js_runner;
+
+    js_runner.begin(&extproc_pool, NULL);
+
+    const std::string source_code =
+        "(function (x) { if (x < 0) { throw 'negative'; } return x * 2; })";
+
+    js_runner_t::req_config_t config;
+    config.timeout_ms = 10000;
+
+    std::vector<std::vector<counted_t<const ql::datum_t> > > args_batch;
+    for (int i = 0; i < 5; ++i) {
+        args_batch.push_back(
+            std::vector<counted_t<const ql::datum_t> >(
+                1, make_counted<const ql::datum_t>(static_cast<double>(i == 3 ? -1 : i))));
+    }
+
+    // Call the function on the whole batch
+    std::vector<js_result_t> results =
+        js_runner.call_batch(source_code, args_batch, config);
+    ASSERT_TRUE(js_runner.connected());
+    ASSERT_EQ(args_batch.size(), results.size());
+
+    // Check results, which come back in order, with the error in its place
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (i == 3) {
+            ASSERT_TRUE(boost::get<std::string>(&results[i]) != NULL);
+            continue;
+        }
+        counted_t<const ql::datum_t> *res_datum =
+            boost::get<counted_t<const ql::datum_t> >(&results[i]);
+        ASSERT_TRUE(res_datum != NULL);
+        ASSERT_TRUE(res_datum->has());
+        ASSERT_EQ(static_cast<int64_t>(i * 2), (*res_datum)->as_int());
+    }
+}
+
+TEST(JSProc, CallBatch) {
+    extproc_spawner_t extproc_spawner;
+    unittest::run_in_thread_pool(boost::bind(&run_call_batch_test));
+}
+
+void run_function_cache_test() {
+    // One worker, so the second runner's job gets the worker that compiled the
+    //  function for the first
+    extproc_pool_t extproc_pool(1);
+
+    const std::string source_code = "(function (x) { return x + 1; })";
+
+    js_runner_t::req_config_t config;
+    config.timeout_ms = 10000;
+
+    for (int i = 0; i < 2; ++i) {
+        js_runner_t js_runner;
+        js_runner.begin(&extproc_pool, NULL);
+
+        js_result_t result = js_runner.eval(source_code, config);
+        ASSERT_TRUE(boost::get<js_id_t>(&result) != NULL);
+
+        result = js_runner.call(source_code,
+                                std::vector<counted_t<const ql::datum_t> >(
+                                    1, make_counted<const ql::datum_t>(static_cast<double>(i))),
+                                config);
+        counted_t<const ql::datum_t> *res_datum =
+            boost::get<counted_t<const ql::datum_t> >(&result);
+        ASSERT_TRUE(res_datum != NULL);
+        ASSERT_EQ(i + 1, (*res_datum)->as_int());
+    }
+}
+
+TEST(JSProc, FunctionCache) {
+    extproc_spawner_t extproc_spawner;
+    unittest::run_in_thread_pool(boost::bind(&run_function_cache_test));
+}
+
+void run_function_cache_isolation_test() {
+    extproc_pool_t extproc_pool(1);
+
+    // Each job that gets this from the cache must get a counter of its own
+    const std::string source_code =
+        "(function () { var n = 0; return function () { return ++n; }; })()";
+
+    js_runner_t::req_config_t config;
+    config.timeout_ms = 10000;
+
+    for (int i = 0; i < 2; ++i) {
+        js_runner_t js_runner;
+        js_runner.begin(&extproc_pool, NULL);
+
+        js_result_t result = js_runner.eval(source_code, config);
+        ASSERT_TRUE(boost::get<js_id_t>(&result) != NULL);
+
+        result = js_runner.call(source_code,
+                                std::vector<counted_t<const ql::datum_t> >(),
+                                config);
+        counted_t<const ql::datum_t> *res_datum =
+            boost::get<counted_t<const ql::datum_t> >(&result);
+        ASSERT_TRUE(res_datum != NULL);
+        ASSERT_EQ(1, (*res_datum)->as_int());
+    }
+}
+
+TEST(JSProc, FunctionCacheIsolation) {
+    extproc_spawner_t extproc_spawner;
+    unittest::run_in_thread_pool(boost::bind(&run_function_cache_isolation_test));
+}
+
 void run_broken_function_test() {
     extproc_pool_t extproc_pool(1);
     js_runner_t js_runner;
@@ -367,3 +476,68 @@ TEST(JSProc, Passthrough) {
     extproc_spawner_t extproc_spawner;
     unittest::run_in_thread_pool(boost::bind(&run_passthrough_test));
 }
+
+void run_in_process_test() {
+    if (!set_js_in_process(true)) {
+        // This build's V8 can't run JavaScript in-process.
+        return;
+    }
+    // The pool's workers go unused.
+    extproc_pool_t extproc_pool(1);
+
+    js_runner_t::req_config_t config;
+    config.timeout_ms = 10000;
+
+    {
+        js_runner_t js_runner;
+        js_runner.begin(&extproc_pool, NULL);
+
+        const std::string source_code = "(function (x) { return x * 3; })";
+        js_result_t result = js_runner.eval(source_code, config);
+        ASSERT_TRUE(boost::get<js_id_t>(&result) != NULL);
+
+        result = js_runner.call(source_code,
+                                std::vector<counted_t<const ql::datum_t> >(
+                                    1, make_counted<const ql::datum_t>(7.0)),
+                                config);
+        counted_t<const ql::datum_t> *res_datum =
+            boost::get<counted_t<const ql::datum_t> >(&result);
+        ASSERT_TRUE(res_datum != NULL);
+        ASSERT_EQ(21, (*res_datum)->as_int());
+    }
+
+    // The watchdog stops scripts that don't stop on their own, and the thread's
+    //  engine keeps working afterwards.
+    {
+        js_runner_t js_runner;
+        js_runner.begin(&extproc_pool, NULL);
+
+        const std::string loop_source = "(function () { for (var x = 0; x < 4e10; x++) {} })";
+        js_result_t result = js_runner.eval(loop_source, config);
+        ASSERT_TRUE(boost::get<js_id_t>(&result) != NULL);
+
+        config.timeout_ms = 10;
+        ASSERT_THROW(js_runner.call(loop_source,
+                                    std::vector<counted_t<const ql::datum_t> >(),
+                                    config), interrupted_exc_t);
+        ASSERT_FALSE(js_runner.connected());
+    }
+    {
+        js_runner_t js_runner;
+        js_runner.begin(&extproc_pool, NULL);
+
+        config.timeout_ms = 10000;
+        js_result_t result = js_runner.eval("1 + 2", config);
+        counted_t<const ql::datum_t> *res_datum =
+            boost::get<counted_t<const ql::datum_t> >(&result);
+        ASSERT_TRUE(res_datum != NULL);
+        ASSERT_EQ(3, (*res_datum)->as_int());
+    }
+
+    ASSERT_TRUE(set_js_in_process(false));
+}
+
+TEST(JSProc, InProcess) {
+    extproc_spawner_t extproc_spawner;
+    unittest::run_in_thread_pool(boost::bind(&run_in_process_test));
+}
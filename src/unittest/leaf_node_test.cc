@@ -69,9 +69,10 @@ private:
 
 class LeafNodeTracker {
 public:
-    LeafNodeTracker() : bs_(block_size_t::unsafe_make(4096)), sizer_(bs_), node_(bs_.value()),
-                        tstamp_counter_(0) {
-        leaf::init(&sizer_, node_.get());
+    explicit LeafNodeTracker(leaf_key_format_t format = leaf_key_format_t::full)
+        : bs_(block_size_t::unsafe_make(4096)), sizer_(bs_), node_(bs_.value()),
+          tstamp_counter_(0) {
+        leaf::init(&sizer_, node_.get(), format);
         Print();
     }
 
@@ -155,19 +156,17 @@ public:
         if (can_level) {
             ASSERT_TRUE(!sibling->kv_.empty());
             if (nodecmp_value < 0) {
-                // Copy keys from front of sibling until and including replacement key.
+                // Copy keys from front of sibling up to and including the
+                // replacement key, which is at least the last key copied.
 
                 std::map<store_key_t, std::string>::iterator p = sibling->kv_.begin();
-                while (p != sibling->kv_.end() && p->first < replacement) {
+                ASSERT_TRUE(p != sibling->kv_.end() && p->first <= replacement);
+                while (p != sibling->kv_.end() && p->first <= replacement) {
                     kv_[p->first] = p->second;
                     std::map<store_key_t, std::string>::iterator prev = p;
                     ++p;
                     sibling->kv_.erase(prev);
                 }
-                ASSERT_TRUE(p != sibling->kv_.end());
-                ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(replacement));
-                kv_[p->first] = p->second;
-                sibling->kv_.erase(p);
             } else {
                 // Copy keys from end of sibling until but not including replacement key.
 
@@ -180,7 +179,7 @@ public:
                     sibling->kv_.erase(prev);
                 }
 
-                ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(replacement));
+                ASSERT_TRUE(p->first <= replacement);
             }
         }
 
@@ -190,13 +189,19 @@ public:
         sibling->Verify();
     }
 
-    void Split(LeafNodeTracker *right) {
+    void Split(LeafNodeTracker *right, bool for_append = false,
+               store_key_t *median_out = NULL) {
         ASSERT_EQ(bs_.ser_value(), right->bs_.ser_value());
 
         ASSERT_TRUE(leaf::is_empty(right->node()));
 
-        store_key_t median;
-        leaf::split(&sizer_, node(), right->node(), median.btree_key());
+        store_key_t local_median;
+        store_key_t &median = median_out != NULL ? *median_out : local_median;
+        if (for_append) {
+            leaf::split_for_append(&sizer_, node(), right->node(), median.btree_key());
+        } else {
+            leaf::split(&sizer_, node(), right->node(), median.btree_key());
+        }
 
         std::map<store_key_t, std::string>::iterator p = kv_.end();
         --p;
@@ -207,7 +212,8 @@ public:
             kv_.erase(prev);
         }
 
-        ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(median));
+        // The median sets the halves apart, but needn't be a key of either.
+        ASSERT_TRUE(p->first <= median);
     }
 
     bool IsFull(const store_key_t& key, const std::string& value) {
@@ -219,6 +225,23 @@ public:
         return kv_.end() != kv_.find(key);
     }
 
+    bool IsUnderfull() {
+        return leaf::is_underfull(&sizer_, node());
+    }
+
+    bool IsSafeForWrite() {
+        return leaf::is_safe_for_write(&sizer_, node());
+    }
+
+    // Removes keys, from the back, until the node is underfull.
+    void RemoveUntilUnderfull() {
+        while (!IsUnderfull()) {
+            ASSERT_FALSE(kv_.empty());
+            store_key_t key = (--kv_.end())->first;
+            Remove(key);
+        }
+    }
+
     repli_timestamp_t NextTimestamp() {
         ++tstamp_counter_;
         repli_timestamp_t ret;
@@ -287,6 +310,16 @@ public:
             printf("\n");
         }
         ASSERT_TRUE(receptor.map() == kv_);
+
+        // The iterators see the live keys, whole, in order.
+        std::map<store_key_t, std::string>::const_iterator p = kv_.begin();
+        for (auto it = leaf::begin(*node()); it != leaf::end(*node()); ++it, ++p) {
+            ASSERT_TRUE(p != kv_.end());
+            ASSERT_EQ(key_to_debug_str(p->first), key_to_debug_str(store_key_t((*it).first)));
+            const short_value_t *value = static_cast<const short_value_t *>((*it).second);
+            ASSERT_EQ(p->second, short_value_buffer_t(value).as_str());
+        }
+        ASSERT_TRUE(p == kv_.end());
     }
 
 public:
@@ -615,4 +648,204 @@ TEST(LeafNodeTest, Fullness) {
     ASSERT_TRUE(node.IsFull(store_key_t(strprintf("a%d", i)), strprintf("A%d", i)));
 }
 
+TEST(LeafNodeTest, SafeForWrite) {
+    LeafNodeTracker node;
+    // An empty node is underfull.
+    ASSERT_FALSE(node.IsSafeForWrite());
+
+    const store_key_t big_key(std::string(MAX_KEY_SIZE, 'z'));
+    const std::string big_value(255, 'Z');
+    int i = 0;
+    while (node.IsUnderfull()) {
+        ASSERT_TRUE(node.Insert(store_key_t(strprintf("a%05d", i)), strprintf("A%d", i)));
+        ++i;
+    }
+    ASSERT_TRUE(node.IsSafeForWrite());
+    ASSERT_FALSE(node.IsFull(big_key, big_value));
+
+    // Once the largest entry might not fit, it isn't safe.
+    while (node.IsSafeForWrite()) {
+        ASSERT_FALSE(node.IsFull(big_key, big_value));
+        ASSERT_TRUE(node.Insert(store_key_t(strprintf("a%05d", i)), strprintf("A%d", i)));
+        ++i;
+    }
+    ASSERT_FALSE(node.IsUnderfull());
+}
+
+// Fills the node with keys that start with `prefix` until it's full, and returns
+// the number of keys inserted.
+int FillWithPrefix(LeafNodeTracker *tracker, const std::string &prefix, const std::string &suffix) {
+    int i = 0;
+    while (tracker->Insert(store_key_t(prefix + strprintf("%05d", i) + suffix), strprintf("V%d", i))) {
+        ++i;
+    }
+    return i;
+}
+
+TEST(LeafNodeTest, AppendSplitting) {
+    LeafNodeTracker left;
+    const int count = FillWithPrefix(&left, "a", "");
+    ASSERT_TRUE(leaf::is_append(left.node(), store_key_t(strprintf("a%05d", count)).btree_key()));
+    ASSERT_FALSE(leaf::is_append(left.node(), store_key_t("a").btree_key()));
+
+    LeafNodeTracker right;
+    left.Split(&right, true);
+
+    // The left node keeps all but the last key, and the appends go to the right.
+    ASSERT_FALSE(left.IsUnderfull());
+    ASSERT_TRUE(right.IsUnderfull());
+    for (int i = count; i < count + 10; ++i) {
+        ASSERT_TRUE(right.Insert(store_key_t(strprintf("a%05d", i)), strprintf("V%d", i)));
+    }
+    right.Verify();
+}
+
+TEST(LeafNodeTest, PrefixCompressedSplitting) {
+    const std::string prefix(100, 'p');
+
+    LeafNodeTracker full;
+    const int full_count = FillWithPrefix(&full, prefix, "");
+
+    LeafNodeTracker left(leaf_key_format_t::prefix_compressed);
+    const int count = FillWithPrefix(&left, prefix, "");
+    // The node's prefix starts out empty, so the entries are a byte bigger.
+    ASSERT_LE(count, full_count);
+
+    LeafNodeTracker right(leaf_key_format_t::prefix_compressed);
+    left.Split(&right);
+    left.Verify();
+    right.Verify();
+    ASSERT_EQ(leaf_key_format_t::prefix_compressed, leaf::key_format(right.node()));
+
+    // The split gave both halves the prefix their keys have in common, so
+    // the halves have room for many more keys like theirs than the whole
+    // node had.
+    const int left_count = left.kv_.size() + FillWithPrefix(&left, prefix, "x");
+    ASSERT_GT(left_count, 2 * full_count);
+
+    // Keys that share less of the prefix still work.
+    ASSERT_TRUE(right.Insert(store_key_t(prefix.substr(0, 50) + "q"), "Q"));
+    ASSERT_TRUE(right.Insert(store_key_t(""), "empty"));
+    right.Remove(store_key_t(prefix + strprintf("%05d", count - 1)));
+}
+
+TEST(LeafNodeTest, SplittingTruncatesMedian) {
+    const std::string prefix(100, 'p');
+    const std::string suffix(100, 's');
+
+    LeafNodeTracker left;
+    FillWithPrefix(&left, prefix, suffix);
+    LeafNodeTracker right;
+    store_key_t median;
+    left.Split(&right, false, &median);
+
+    // The median only needs enough of the right node's first key to tell it from
+    // the left node's last key, which differ in their numbers.
+    ASSERT_LE(median.size(), static_cast<int>(prefix.size() + 5));
+    ASSERT_TRUE((--left.kv_.end())->first <= median);
+    ASSERT_TRUE(median < right.kv_.begin()->first);
+}
+
+TEST(LeafNodeTest, PrefixCompressedRandomOutOfOrder) {
+    rng_t rng;
+    const std::string prefix = "some_table_id:some_index_name:";
+
+    for (int try_num = 0; try_num < 10; ++try_num) {
+        LeafNodeTracker tracker(leaf_key_format_t::prefix_compressed);
+        LeafNodeTracker right(leaf_key_format_t::prefix_compressed);
+        FillWithPrefix(&tracker, prefix, std::string(20, 'z'));
+        tracker.Split(&right);
+
+        const int num_keys = 30;
+        store_key_t key_pool[num_keys];
+        for (int i = 0; i < num_keys; ++i) {
+            // Keys share anywhere from none to all of the prefix.
+            std::string key = prefix.substr(0, rng.randint(prefix.size() + 1));
+            const int length = rng.randint(100);
+            for (int j = 0; j < length; ++j) {
+                key.push_back('a' + rng.randint(3));
+            }
+            key_pool[i] = store_key_t(key);
+        }
+
+        const int num_ops = 3000;
+        for (int i = 0; i < num_ops; ++i) {
+            const store_key_t &key = key_pool[rng.randint(num_keys)];
+            repli_timestamp_t tstamp;
+            tstamp.longtime = rng.randint(num_ops);
+
+            if (rng.randint(2) == 1) {
+                tracker.Insert(key, std::string(rng.randint(100), 'a' + rng.randint(26)), tstamp);
+            } else {
+                if (tracker.ShouldHave(key)) {
+                    tracker.Remove(key);
+                }
+            }
+        }
+    }
+}
+
+TEST(LeafNodeTest, PrefixCompressedMerging) {
+    LeafNodeTracker left(leaf_key_format_t::prefix_compressed);
+    LeafNodeTracker left_rest(leaf_key_format_t::prefix_compressed);
+    FillWithPrefix(&left, std::string(60, 'a'), "");
+    left.Split(&left_rest);
+    left.RemoveUntilUnderfull();
+
+    LeafNodeTracker right(leaf_key_format_t::prefix_compressed);
+    LeafNodeTracker right_rest(leaf_key_format_t::prefix_compressed);
+    FillWithPrefix(&right, std::string(60, 'b'), "");
+    right.Split(&right_rest);
+    right.RemoveUntilUnderfull();
+
+    // The nodes have different prefixes, so left's keys get stored in full.
+    ASSERT_TRUE(leaf::is_mergable(&right.sizer_, left.node(), right.node()));
+    right.Merge(&left);
+}
+
+TEST(LeafNodeTest, MixedFormatMerging) {
+    LeafNodeTracker left(leaf_key_format_t::prefix_compressed);
+    LeafNodeTracker left_rest(leaf_key_format_t::prefix_compressed);
+    FillWithPrefix(&left, std::string(60, 'a'), "");
+    left.Split(&left_rest);
+    left.RemoveUntilUnderfull();
+
+    LeafNodeTracker right;
+    for (int i = 0; i < 40; ++i) {
+        right.Insert(store_key_t(strprintf("b%d", i)), strprintf("B%d", i));
+    }
+
+    ASSERT_TRUE(leaf::is_mergable(&right.sizer_, left.node(), right.node()));
+    right.Merge(&left);
+
+    // And the other way around.
+    LeafNodeTracker full_left;
+    for (int i = 0; i < 40; ++i) {
+        full_left.Insert(store_key_t(strprintf("a%d", i)), strprintf("A%d", i));
+    }
+    left_rest.RemoveUntilUnderfull();
+    ASSERT_TRUE(leaf::is_mergable(&right.sizer_, full_left.node(), left_rest.node()));
+    left_rest.Merge(&full_left);
+}
+
+TEST(LeafNodeTest, PrefixCompressedLeveling) {
+    LeafNodeTracker left(leaf_key_format_t::prefix_compressed);
+    left.Insert(store_key_t("a0"), "A0");
+
+    LeafNodeTracker right(leaf_key_format_t::prefix_compressed);
+    LeafNodeTracker right_rest(leaf_key_format_t::prefix_compressed);
+    FillWithPrefix(&right, std::string(60, 'b'), "");
+    right.Split(&right_rest);
+
+    bool could_level;
+    left.Level(-1, &right, &could_level);
+    ASSERT_TRUE(could_level);
+
+    // Leveling into a full-key node, which the entries take up more room in.
+    LeafNodeTracker full_right;
+    full_right.Insert(store_key_t(std::string(60, 'c')), "C");
+    full_right.Level(1, &right_rest, &could_level);
+    ASSERT_TRUE(could_level);
+}
+
 }  // namespace unittest
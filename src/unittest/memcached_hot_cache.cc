@@ -0,0 +1,92 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "containers/data_buffer.hpp"
+#include "memcached/memcached_btree/hot_cache.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// The cache never looks at the slices, only compares them.
+static btree_slice_t *fake_slice(uintptr_t n) {
+    return reinterpret_cast<btree_slice_t *>(n);
+}
+
+static get_result_t make_result(const std::string &value, mcflags_t flags) {
+    counted_t<data_buffer_t> buffer = data_buffer_t::create(value.size());
+    memcpy(buffer->buf(), value.data(), value.size());
+    return get_result_t(buffer, flags, 0);
+}
+
+static std::string value_of(const get_result_t &result) {
+    return std::string(result.value->buf(), result.value->size());
+}
+
+void run_find_and_invalidate_test() {
+    memcached_hot_cache_t cache(MEGABYTE);
+    const store_key_t a("a"), b("b");
+    get_result_t result;
+    uint64_t generation;
+
+    ASSERT_FALSE(cache.find(fake_slice(1), a, 100, &result, &generation));
+    cache.insert(fake_slice(1), a, make_result("apple", 7), 0, generation);
+    ASSERT_TRUE(cache.find(fake_slice(1), a, 100, &result, &generation));
+    ASSERT_EQ("apple", value_of(result));
+    ASSERT_EQ(7u, result.flags);
+
+    // Slices don't share keys
+    ASSERT_FALSE(cache.find(fake_slice(2), a, 100, &result, &generation));
+
+    // A write that comes along while a read is in the btree keeps the read from
+    // recording its (possibly old) value.
+    ASSERT_FALSE(cache.find(fake_slice(1), b, 100, &result, &generation));
+    cache.invalidate(fake_slice(1), b);
+    cache.insert(fake_slice(1), b, make_result("banana", 0), 0, generation);
+    ASSERT_FALSE(cache.find(fake_slice(1), b, 100, &result, &generation));
+
+    cache.invalidate(fake_slice(1), a);
+    ASSERT_FALSE(cache.find(fake_slice(1), a, 100, &result, &generation));
+    ASSERT_EQ(0u, cache.num_entries());
+    ASSERT_EQ(0u, cache.size());
+}
+
+TEST(MemcachedHotCache, FindAndInvalidate) {
+    run_in_thread_pool(&run_find_and_invalidate_test);
+}
+
+void run_expiration_and_eviction_test() {
+    memcached_hot_cache_t cache(4 * KILOBYTE);
+    get_result_t result;
+    uint64_t generation;
+
+    ASSERT_FALSE(cache.find(fake_slice(1), store_key_t("x"), 100, &result, &generation));
+    cache.insert(fake_slice(1), store_key_t("x"), make_result("x", 0), 150, generation);
+    ASSERT_TRUE(cache.find(fake_slice(1), store_key_t("x"), 149, &result, &generation));
+    ASSERT_FALSE(cache.find(fake_slice(1), store_key_t("x"), 150, &result, &generation));
+    ASSERT_EQ(0u, cache.num_entries());
+
+    // Values that are too big aren't kept at all, and the least recently read ones
+    // make room for new ones.
+    cache.insert(fake_slice(1), store_key_t("big"),
+                 make_result(std::string(2 * KILOBYTE, 'z'), 0), 0, generation);
+    ASSERT_EQ(0u, cache.num_entries());
+    for (int i = 0; i < 100; ++i) {
+        cache.insert(fake_slice(1), store_key_t(strprintf("%d", i)),
+                     make_result(std::string(100, 'v'), 0), 0, generation);
+        ASSERT_TRUE(cache.find(fake_slice(1), store_key_t("0"), 0,
+                               &result, &generation));
+        ASSERT_LE(cache.size(), static_cast<size_t>(4 * KILOBYTE));
+    }
+    ASSERT_FALSE(cache.find(fake_slice(1), store_key_t("1"), 0, &result, &generation));
+    ASSERT_TRUE(cache.find(fake_slice(1), store_key_t("99"), 0, &result, &generation));
+
+    cache.insert(fake_slice(2), store_key_t("0"), make_result("w", 0), 0, generation);
+    cache.invalidate_slice(fake_slice(1));
+    ASSERT_EQ(1u, cache.num_entries());
+    ASSERT_TRUE(cache.find(fake_slice(2), store_key_t("0"), 0, &result, &generation));
+}
+
+TEST(MemcachedHotCache, ExpirationAndEviction) {
+    run_in_thread_pool(&run_expiration_and_eviction_test);
+}
+
+}  // namespace unittest
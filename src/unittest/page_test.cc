@@ -44,11 +44,11 @@ class test_txn_t;
 class test_cache_t : public page_cache_t {
 public:
     test_cache_t(serializer_t *serializer, alt_memory_tracker_t *tracker)
-        : page_cache_t(serializer, page_cache_config_t(), tracker),
+        : page_cache_t(serializer, page_cache_config_t(), tracker, NULL),
           tracker_(tracker) { }
     test_cache_t(serializer_t *serializer, alt_memory_tracker_t *tracker,
                  uint64_t memory_limit)
-        : page_cache_t(serializer, make_config(memory_limit), tracker),
+        : page_cache_t(serializer, make_config(memory_limit), tracker, NULL),
           tracker_(tracker) { }
 
     void flush(scoped_ptr_t<test_txn_t> txn) {
@@ -312,6 +312,54 @@ TEST(PageTest, WriteWaitForFlush) {
     run_in_thread_pool(run_WriteWaitForFlush, 4);
 }
 
+void run_ManyDependentTxns() {
+    mock_ser_t mock;
+    // More txns than can be flushing at once, so that later ones share flushes.
+    const int num_txns = 10 * DEFAULT_MAX_CONCURRENT_FLUSHES;
+    block_id_t block_id = NULL_BLOCK_ID;
+    {
+        test_cache_t page_cache(mock.ser.get(), mock.tracker.get());
+        for (int i = 0; i < num_txns; ++i) {
+            auto txn = make_scoped<test_txn_t>(&page_cache);
+            {
+                scoped_ptr_t<current_page_acq_t> acq;
+                if (i == 0) {
+                    acq = make_scoped<current_page_acq_t>(txn.get(),
+                                                          alt_create_t::create);
+                    block_id = acq->block_id();
+                } else {
+                    acq = make_scoped<current_page_acq_t>(txn.get(), block_id,
+                                                          access_t::write);
+                }
+                acq->write_acq_signal()->wait();
+                page_acq_t page_acq;
+                page_acq.init(acq->current_page_for_write(), &page_cache);
+                page_acq.buf_ready_signal()->wait();
+                *static_cast<int *>(page_acq.get_buf_write()) = i;
+            }
+            page_cache.flush(std::move(txn));
+        }
+        // The page cache's destructor waits for the flushes.
+    }
+
+    test_cache_t page_cache(mock.ser.get(), mock.tracker.get());
+    auto txn = make_scoped<test_txn_t>(&page_cache);
+    {
+        current_page_acq_t acq(txn.get(), block_id, access_t::read);
+        acq.read_acq_signal()->wait();
+        page_acq_t page_acq;
+        page_acq.init(acq.current_page_for_read(), &page_cache);
+        page_acq.buf_ready_signal()->wait();
+        ASSERT_EQ(num_txns - 1, *static_cast<const int *>(
+                      page_acq.get_buf_read(cache_access_pattern_t::normal)));
+    }
+    page_cache.flush(std::move(txn));
+}
+
+TEST(PageTest, ManyDependentTxns) {
+    run_in_thread_pool(run_ManyDependentTxns, 4);
+}
+
 class bigger_test_t {
 public:
     explicit bigger_test_t(uint64_t _memory_limit)
@@ -1089,7 +1137,8 @@ private:
     void check_page_acq(page_acq_t *page_acq, const std::string &expected) {
         const uint32_t n = page_acq->get_buf_size();
         ASSERT_EQ(4080u, n);
-        const char *const p = static_cast<const char *>(page_acq->get_buf_read());
+        const char *const p = static_cast<const char *>(
+                page_acq->get_buf_read(cache_access_pattern_t::normal));
 
         ASSERT_LE(expected.size() + 1, n);
         ASSERT_EQ(expected, std::string(p));
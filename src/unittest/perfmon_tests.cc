@@ -6,6 +6,7 @@
 #include <cmath>  // for std::isnan -- read the comment below.
 
 #include "perfmon/perfmon.hpp"
+#include "perfmon/snapshot.hpp"
 #include "unittest/gtest.hpp"
 
 namespace unittest {
@@ -57,4 +58,66 @@ TEST(PerfmonTest, StddevComputation) {
     }
 }
 
+TEST(PerfmonTest, HistogramPercentiles) {
+    typedef perfmon_histogram::buckets_t t;
+
+    // Bucket boundaries are contiguous and every value lands in the bucket that
+    // covers it
+    for (int i = 0; i < t::bucket_count - 1; ++i) {
+        EXPECT_LT(t::bucket_lowest_nanos(i), t::bucket_lowest_nanos(i + 1));
+        EXPECT_EQ(i, t::bucket_index(t::bucket_lowest_nanos(i)));
+        EXPECT_EQ(i, t::bucket_index(t::bucket_lowest_nanos(i + 1) - 1));
+    }
+    EXPECT_EQ(t::bucket_count - 1, t::bucket_index(UINT64_MAX));
+
+    // Durations of 1..1000 microseconds
+    t first_half, second_half;
+    for (int us = 1; us <= 1000; ++us) {
+        (us % 2 == 0 ? first_half : second_half).record(us * 1e-6);
+    }
+    t stats;
+    stats.aggregate(first_half);
+    stats.aggregate(second_half);
+
+    EXPECT_EQ(1000, stats.count);
+    EXPECT_DOUBLE_EQ(1000e-6, stats.max);
+    const double percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i) {
+        double expected = percentiles[i] * 1000e-6;
+        EXPECT_NEAR(expected, stats.percentile(percentiles[i]), expected / 16);
+    }
+    EXPECT_DOUBLE_EQ(1000e-6, stats.percentile(1.0));
+}
+
+TEST(PerfmonTest, SnapshotDeltas) {
+    scoped_ptr_t<perfmon_result_t> previous = perfmon_result_t::alloc_map_result();
+    previous->insert("count", new perfmon_result_t("10"));
+    previous->insert("rate", new perfmon_result_t("1.5"));
+    previous->insert("name", new perfmon_result_t("foo"));
+    previous->insert("gone", new perfmon_result_t("3"));
+    scoped_ptr_t<perfmon_result_t> previous_child = perfmon_result_t::alloc_map_result();
+    previous_child->insert("count", new perfmon_result_t("7"));
+    previous->insert("child", previous_child.release());
+
+    scoped_ptr_t<perfmon_result_t> latest = perfmon_result_t::alloc_map_result();
+    latest->insert("count", new perfmon_result_t("25"));
+    latest->insert("rate", new perfmon_result_t("1"));
+    latest->insert("name", new perfmon_result_t("bar"));
+    latest->insert("new", new perfmon_result_t("4"));
+    scoped_ptr_t<perfmon_result_t> latest_child = perfmon_result_t::alloc_map_result();
+    latest_child->insert("count", new perfmon_result_t("5"));
+    latest->insert("child", latest_child.release());
+
+    scoped_ptr_t<perfmon_result_t> deltas = perfmon_result_t::alloc_map_result();
+    perfmon_compute_deltas(*previous, *latest, deltas.get());
+
+    const perfmon_result_t &result = *deltas;
+    const perfmon_result_t::internal_map_t *map = result.get_map();
+    ASSERT_EQ(3u, map->size());
+    EXPECT_EQ("15", *map->at("count")->get_string());
+    EXPECT_EQ("-0.5", *map->at("rate")->get_string());
+    const perfmon_result_t &child = *map->at("child");
+    EXPECT_EQ("-2", *child.get_map()->at("count")->get_string());
+}
+
 }  // namespace unittest
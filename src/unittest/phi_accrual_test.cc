@@ -0,0 +1,41 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rpc/connectivity/phi_accrual.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(PhiAccrualTest, SteadyArrivals) {
+    phi_accrual_detector_t detector(0, 250, 500);
+    int64_t now = 0;
+    for (int i = 0; i < 200; ++i) {
+        now += 250;
+        detector.arrival(now);
+    }
+    // Right after an arrival, and for a while after the next one is due, the peer
+    // is fine.
+    EXPECT_LT(detector.phi(now), 1.0);
+    EXPECT_LT(detector.phi(now + 500), 1.0);
+    // A few seconds of silence, though, is very unlikely.
+    EXPECT_GT(detector.phi(now + 2000), 8.0);
+    // And phi only grows.
+    EXPECT_LT(detector.phi(now + 1000), detector.phi(now + 1200));
+}
+
+TEST(PhiAccrualTest, JitteryArrivals) {
+    phi_accrual_detector_t steady(0, 250, 500);
+    phi_accrual_detector_t jittery(0, 250, 500);
+    int64_t now = 0;
+    for (int i = 0; i < 200; ++i) {
+        // Both average an arrival a second, but the jittery one's come 400 and 1600
+        // ms apart.
+        now += 1000;
+        steady.arrival(now);
+        jittery.arrival(now + (i % 2 == 0 ? -600 : 0));
+    }
+    // The same silence worries the detector less on a link whose arrivals are
+    // spread out more.
+    EXPECT_GT(steady.phi(now + 2500), jittery.phi(now + 2500));
+    EXPECT_LT(jittery.phi(now + 2500), 8.0);
+}
+
+}  // namespace unittest
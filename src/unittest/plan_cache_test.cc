@@ -0,0 +1,54 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/plan_cache.hpp"
+#include "rdb_protocol/term.hpp"
+#include "rdb_protocol/term_walker.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+ql::protob_t<const Term> preprocessed(ql::r::reql_t &&query) {
+    ql::protob_t<Term> term = query.release_counted();
+    ql::preprocess_term(term.get());
+    return term;
+}
+
+ql::protob_t<const Term> get_query(const std::string &table, double key) {
+    return preprocessed(ql::r::db("test").call(Term::TABLE, table).call(Term::GET, key));
+}
+
+void run_plan_cache_test() {
+    cond_t interruptor;
+    ql::env_t env(&interruptor);
+    ql::plan_cache_t plan_cache;
+
+    // Gets of different keys share their plan, with the key as its parameter.
+    counted_t<ql::term_t> get_one = plan_cache.compile(&env, get_query("t", 1));
+    ASSERT_EQ(1u, env.plan_params.size());
+    ASSERT_EQ(1.0, env.plan_params[0]->as_num());
+    counted_t<ql::term_t> get_two = plan_cache.compile(&env, get_query("t", 2));
+    ASSERT_EQ(get_one.get(), get_two.get());
+    ASSERT_EQ(1u, env.plan_params.size());
+    ASSERT_EQ(2.0, env.plan_params[0]->as_num());
+
+    // Other literals are part of the shape.
+    ASSERT_NE(get_one.get(), plan_cache.compile(&env, get_query("u", 1)).get());
+
+    // And `delete` is rewritten into a `replace` of a copy of the get, which can't
+    // read the key out of the env, so that doesn't get cached.
+    counted_t<ql::term_t> delete_one = plan_cache.compile(
+        &env, preprocessed(ql::r::db("test").call(Term::TABLE, "t")
+                           .call(Term::GET, 1.0).call(Term::DELETE)));
+    ASSERT_NE(delete_one.get(),
+              plan_cache.compile(
+                  &env, preprocessed(ql::r::db("test").call(Term::TABLE, "t")
+                                     .call(Term::GET, 1.0).call(Term::DELETE))).get());
+}
+
+TEST(PlanCache, SharesPlansOfTheSameShape) {
+    run_in_thread_pool(&run_plan_cache_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,37 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "containers/priority_queue.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+struct pointee_less_t {
+    bool operator()(const int *x, const int *y) {
+        return *x < *y;
+    }
+};
+
+TEST(PriorityQueueTest, Rebuild) {
+    const int n = 100;
+    int keys[n];
+    priority_queue_t<int *, pointee_less_t> pq;
+    for (int i = 0; i < n; ++i) {
+        keys[i] = i;
+        pq.push(&keys[i]);
+    }
+
+    // Reverse the order of all keys behind the queue's back.
+    for (int i = 0; i < n; ++i) {
+        keys[i] = n - 1 - i;
+    }
+    pq.rebuild();
+    pq.validate();
+
+    for (int i = 0; i < n; ++i) {
+        int *top = pq.pop();
+        ASSERT_EQ(n - 1 - i, *top);
+        ASSERT_EQ(&keys[i], top);
+    }
+    ASSERT_TRUE(pq.empty());
+}
+
+}  // namespace unittest
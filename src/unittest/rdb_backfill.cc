@@ -59,7 +59,8 @@ void run_with_broadcaster(
     boost::shared_ptr<semilattice_readwrite_view_t<auth_semilattice_metadata_t> > dummy_auth;
     rdb_protocol_t::context_t ctx(&extproc_pool, NULL, slm.get_root_view(),
                                   dummy_auth, &read_manager, generate_uuid(),
-                                  &get_global_perfmon_collection());
+                                  &get_global_perfmon_collection(),
+                                  &io_backender, base_path_t("."));
 
     /* Set up a broadcaster and initial listener */
     test_store_t<rdb_protocol_t> initial_store(&io_backender, &order_source, &ctx);
@@ -73,6 +73,59 @@ void insert_rows_and_pulse_when_done(int start, int finish,
     pulse_when_done->pulse();
 }
 
+class insert_rows_replacer_t : public btree_batched_replacer_t {
+public:
+    explicit insert_rows_replacer_t(
+            const std::vector<counted_t<const ql::datum_t> > *rows)
+        : rows_(rows) { }
+    counted_t<const ql::datum_t> replace(
+            const counted_t<const ql::datum_t> &, size_t index) const {
+        return (*rows_)[index];
+    }
+    bool should_return_vals() const { return false; }
+private:
+    const std::vector<counted_t<const ql::datum_t> > *const rows_;
+};
+
+// Like insert_rows, but in one batch, so that rows in the same leaf get written
+// together.
+void batched_insert_rows(int start, int finish, btree_store_t<rdb_protocol_t> *store) {
+    guarantee(start <= finish);
+    std::vector<counted_t<const ql::datum_t> > rows;
+    std::vector<store_key_t> keys;
+    for (int i = start; i < finish; ++i) {
+        std::string data = strprintf("{\"id\" : %d, \"sid\" : %d}", i, i * i);
+        rows.push_back(
+            make_counted<ql::datum_t>(scoped_cJSON_t(cJSON_Parse(data.c_str()))));
+        keys.push_back(store_key_t(
+            make_counted<const ql::datum_t>(static_cast<double>(i))->print_primary()));
+    }
+
+    cond_t dummy_interruptor;
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> real_superblock;
+    write_token_pair_t token_pair;
+    store->new_write_token_pair(&token_pair);
+    store->acquire_superblock_for_write(
+        repli_timestamp_t::invalid,
+        1, write_durability_t::SOFT,
+        &token_pair, &txn, &real_superblock, &dummy_interruptor);
+
+    buf_lock_t sindex_block
+        = store->acquire_sindex_block_for_write(real_superblock->expose_buf(),
+                                                real_superblock->get_sindex_block_id());
+    rdb_modification_report_cb_t sindex_cb(store, NULL, &sindex_block,
+                                           auto_drainer_t::lock_t(&store->drainer));
+    insert_rows_replacer_t replacer(&rows);
+    const std::string primary_key("id");
+    scoped_ptr_t<superblock_t> superblock(real_superblock.release());
+    batched_replace_response_t response = rdb_batched_replace(
+        btree_info_t(store->btree.get(), repli_timestamp_t::invalid, &primary_key),
+        &superblock, keys, &replacer, &sindex_cb,
+        static_cast<profile::trace_t *>(NULL));
+    ASSERT_EQ(finish - start, response->get("inserted")->as_int());
+}
+
 std::string create_sindex(btree_store_t<rdb_protocol_t> *store) {
     cond_t dummy_interruptor;
     std::string sindex_id = uuid_to_str(generate_uuid());
@@ -364,6 +417,50 @@ TEST(RDBBtree, SindexPostConstruct) {
     run_in_thread_pool(&run_sindex_post_construction);
 }
 
+void run_batched_insert_test() {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    rdb_protocol_t::store_t store(
+            &serializer,
+            "unit_test_store",
+            GIGABYTE,
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."));
+
+    // Enough rows in one batch for the leaves to split a few times while the batch
+    // writes to them.
+    batched_insert_rows(0, (TOTAL_KEYS_TO_INSERT * 9) / 10, &store);
+
+    std::string sindex_id = create_sindex(&store);
+
+    cond_t background_inserts_done;
+    spawn_writes_and_bring_sindexes_up_to_date(&store, sindex_id,
+            &background_inserts_done);
+    background_inserts_done.wait();
+
+    check_keys_are_present(&store, sindex_id);
+}
+
+TEST(RDBBtree, BatchedInsert) {
+    run_in_thread_pool(&run_batched_insert_test);
+}
+
 void run_erase_range_test() {
     recreate_temporary_directory(base_path_t("."));
     temp_file_t temp_file;
@@ -97,6 +97,17 @@ void mock_namespace_interface_t::read_visitor_t::operator()(const rdb_protocol_t
     }
 }
 
+void mock_namespace_interface_t::read_visitor_t::operator()(const rdb_protocol_t::batched_point_read_t &get) {
+    response->response = rdb_protocol_t::batched_point_read_response_t();
+    rdb_protocol_t::batched_point_read_response_t &res = boost::get<rdb_protocol_t::batched_point_read_response_t>(response->response);
+
+    for (auto it = get.keys.begin(); it != get.keys.end(); ++it) {
+        if (data->find(*it) != data->end()) {
+            res.rows[*it] = make_counted<ql::datum_t>(scoped_cJSON_t(data->at(*it)->DeepCopy()));
+        }
+    }
+}
+
 void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(UNUSED const rdb_protocol_t::rget_read_t &rget) {
     throw cannot_perform_query_exc_t("unimplemented");
 }
@@ -267,7 +278,11 @@ namespace_id_t test_rdb_env_t::add_table(const std::string &table_name,
                                       table_name_string,
                                       primary_key,
                                       port_defaults::reql_port,
-                                      GIGABYTE);
+                                      GIGABYTE,
+                                      CPU_SHARDING_FACTOR,
+                                      DEFAULT_INLINE_VALUE_SIZE,
+                                      DEFAULT_WRITE_BUFFER_SIZE,
+                                      false);
 
     // Set up initial data
     std::map<store_key_t, scoped_cJSON_t*> *data = new std::map<store_key_t, scoped_cJSON_t*>();
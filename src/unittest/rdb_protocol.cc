@@ -75,7 +75,8 @@ void run_with_namespace_interface(boost::function<void(namespace_interface_t<rdb
     boost::shared_ptr<semilattice_readwrite_view_t<auth_semilattice_metadata_t> > dummy_auth;
     rdb_protocol_t::context_t ctx(&extproc_pool, NULL, slm.get_root_view(),
                                   dummy_auth, &read_manager, generate_uuid(),
-                                  &get_global_perfmon_collection());
+                                  &get_global_perfmon_collection(),
+                                  &io_backender, base_path_t("."));
 
     for (size_t i = 0; i < store_shards.size(); ++i) {
         underlying_stores.push_back(
@@ -165,6 +166,50 @@ TEST(RDBProtocol, OvershardedGetSet) {
     run_in_thread_pool_with_namespace_interface(&run_get_set_test, true);
 }
 
+/* `BatchedGet` tests reading keys from both shards with one batched point read */
+void run_batched_get_test(namespace_interface_t<rdb_protocol_t> *nsi, order_source_t *osource) {
+    const char *keys[] = { "a", "b", "x", "y" };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        rdb_protocol_t::write_t write(
+                rdb_protocol_t::point_write_t(store_key_t(keys[i]),
+                    make_counted<ql::datum_t>(static_cast<double>(i))),
+                DURABILITY_REQUIREMENT_DEFAULT,
+                profile_bool_t::DONT_PROFILE);
+        rdb_protocol_t::write_response_t response;
+
+        cond_t interruptor;
+        nsi->write(write, &response, osource->check_in("unittest::run_batched_get_test(rdb_protocol.cc-A)"), &interruptor);
+    }
+
+    std::vector<store_key_t> read_keys;
+    read_keys.push_back(store_key_t("y"));
+    read_keys.push_back(store_key_t("a"));
+    read_keys.push_back(store_key_t("z"));
+    read_keys.push_back(store_key_t("a"));
+    rdb_protocol_t::read_t read(rdb_protocol_t::batched_point_read_t(std::move(read_keys)),
+            profile_bool_t::PROFILE);
+    rdb_protocol_t::read_response_t response;
+
+    cond_t interruptor;
+    nsi->read(read, &response, osource->check_in("unittest::run_batched_get_test(rdb_protocol.cc-B)"), &interruptor);
+
+    if (rdb_protocol_t::batched_point_read_response_t *maybe_batched_response = boost::get<rdb_protocol_t::batched_point_read_response_t>(&response.response)) {
+        ASSERT_EQ(2u, maybe_batched_response->rows.size());
+        ASSERT_EQ(ql::datum_t(0.0), *maybe_batched_response->rows[store_key_t("a")]);
+        ASSERT_EQ(ql::datum_t(3.0), *maybe_batched_response->rows[store_key_t("y")]);
+    } else {
+        ADD_FAILURE() << "got wrong result back";
+    }
+}
+
+TEST(RDBProtocol, BatchedGet) {
+    run_in_thread_pool_with_namespace_interface(&run_batched_get_test, false);
+}
+
+TEST(RDBProtocol, OvershardedBatchedGet) {
+    run_in_thread_pool_with_namespace_interface(&run_batched_get_test, true);
+}
+
 std::string create_sindex(namespace_interface_t<rdb_protocol_t> *nsi,
                           order_source_t *osource) {
     std::string id = uuid_to_str(generate_uuid());
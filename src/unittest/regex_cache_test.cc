@@ -0,0 +1,35 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <re2/re2.h>
+
+#include "config/args.hpp"
+#include "rdb_protocol/regex_cache.hpp"
+#include "unittest/gtest.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+TEST(RegexCacheTest, ReusesCompiledRegexes) {
+    ql::regex_cache_t cache;
+    const RE2 *regex = cache.get("a+b");
+    ASSERT_TRUE(regex->ok());
+    ASSERT_TRUE(RE2::FullMatch("aab", *regex));
+    ASSERT_EQ(regex, cache.get("a+b"));
+    ASSERT_NE(regex, cache.get("a*b"));
+
+    ASSERT_FALSE(cache.get("(")->ok());
+}
+
+TEST(RegexCacheTest, EvictsLeastRecentlyUsed) {
+    ql::regex_cache_t cache;
+    const RE2 *first = cache.get("x0");
+    for (int i = 1; i < REGEX_CACHE_SIZE; ++i) {
+        cache.get(strprintf("x%d", i));
+        // Keep using the first one, so that it stays.
+        ASSERT_EQ(first, cache.get("x0"));
+    }
+    // The cache is full, so this pushes out "x1" rather than "x0".
+    cache.get("y");
+    ASSERT_EQ(first, cache.get("x0"));
+}
+
+}  // namespace unittest
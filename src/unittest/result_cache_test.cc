@@ -0,0 +1,54 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/result_cache.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+Query make_query(ql::r::reql_t &&term, bool result_cache) {
+    Query q;
+    q.set_type(Query::START);
+    q.set_token(1);
+    *q.mutable_query() = *term.release_counted();
+    Query::AssocPair *ap = q.add_global_optargs();
+    ap->set_key("result_cache");
+    *ap->mutable_val() = *ql::r::boolean(result_cache).release_counted();
+    return q;
+}
+
+ql::r::reql_t table(const std::string &name) {
+    return ql::r::db("test").call(Term::TABLE, name);
+}
+
+TEST(ResultCache, CacheKey) {
+    std::string key1, key2;
+    ASSERT_TRUE(ql::result_cache_t::cache_key(
+                    make_query(table("t").call(Term::COUNT), true), &key1));
+    ASSERT_TRUE(ql::result_cache_t::cache_key(
+                    make_query(table("u").call(Term::COUNT), true), &key2));
+    EXPECT_NE(key1, key2);
+    ASSERT_TRUE(ql::result_cache_t::cache_key(
+                    make_query(table("t").call(Term::COUNT), true), &key2));
+    EXPECT_EQ(key1, key2);
+
+    // Only queries that ask for it,
+    EXPECT_FALSE(ql::result_cache_t::cache_key(
+                     make_query(table("t").call(Term::COUNT), false), &key1));
+    // that don't write,
+    EXPECT_FALSE(ql::result_cache_t::cache_key(
+                     make_query(table("t").call(Term::GET, 1.0).call(Term::DELETE),
+                                true),
+                     &key1));
+    // and that give the same result for the same data.
+    EXPECT_FALSE(ql::result_cache_t::cache_key(
+                     make_query(table("t").call(Term::SAMPLE, 1.0), true), &key1));
+    EXPECT_FALSE(ql::result_cache_t::cache_key(
+                     make_query(ql::r::db("test").call(Term::TABLE, "t",
+                                                       ql::r::optarg("use_outdated",
+                                                                     true))
+                                .call(Term::COUNT),
+                                true),
+                     &key1));
+}
+
+}  // namespace unittest
@@ -23,7 +23,8 @@ public:
         service(s),
         sequence_number(0)
         { }
-    void send(int message, peer_id_t peer) {
+    void send(int message, peer_id_t peer,
+              message_class_t message_class = message_class_t::control) {
         class writer_t : public send_message_write_callback_t {
         public:
             explicit writer_t(int _data) : data(_data) { }
@@ -36,7 +37,7 @@ public:
             }
             int32_t data;
         } writer(message);
-        service->send_message(peer, &writer);
+        service->send_message(peer, message_class, &writer);
     }
     void expect(int message, peer_id_t peer) {
         expect_delivered(message);
@@ -208,6 +209,72 @@ TEST(RPCConnectivityTest, OrderingMultiThread) {
     unittest::run_in_thread_pool(&run_ordering_test, 3);
 }
 
+/* `ClassOrdering` tests that messages in each message class arrive in the order
+they were sent in, even though the classes may go on separate connections. */
+
+void run_class_ordering_test() {
+    connectivity_cluster_t c1, c2;
+    recording_test_application_t a1(&c1), a2(&c2);
+    connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a1, 0, NULL);
+    connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a2, 0, NULL);
+
+    cr1.join(c2.get_peer_address(c2.get_me()));
+
+    let_stuff_happen();
+
+    for (int i = 0; i < 10 * num_message_classes; i++) {
+        a1.send(i, c2.get_me(), static_cast<message_class_t>(i % num_message_classes));
+    }
+
+    let_stuff_happen();
+
+    for (int i = 0; i < 9 * num_message_classes; i++) {
+        a2.expect_order(i, i + num_message_classes);
+    }
+}
+TEST(RPCConnectivityTest, ClassOrdering) {
+    unittest::run_in_thread_pool(&run_class_ordering_test);
+}
+TEST(RPCConnectivityTest, ClassOrderingMultiThread) {
+    unittest::run_in_thread_pool(&run_class_ordering_test, 3);
+}
+
+/* `FlushMessages` checks that small messages, which are buffered so they can go out
+together, still arrive in order when they're flushed explicitly. */
+
+void run_flush_messages_test() {
+    connectivity_cluster_t c1, c2;
+    recording_test_application_t a1(&c1), a2(&c2);
+    connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a1, 0, NULL);
+    connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a2, 0, NULL);
+
+    cr1.join(c2.get_peer_address(c2.get_me()));
+
+    let_stuff_happen();
+
+    for (int i = 0; i < 100; i++) {
+        a1.send(i, c2.get_me());
+        if (i % 10 == 0) {
+            c1.flush_messages(c2.get_me());
+        }
+    }
+    // Flushing when nothing is buffered, or for ourself, does nothing
+    c1.flush_messages(c2.get_me());
+    c1.flush_messages(c1.get_me());
+
+    let_stuff_happen();
+
+    for (int i = 0; i < 99; i++) {
+        a2.expect_order(i, i+1);
+    }
+}
+TEST(RPCConnectivityTest, FlushMessages) {
+    unittest::run_in_thread_pool(&run_flush_messages_test);
+}
+TEST(RPCConnectivityTest, FlushMessagesMultiThread) {
+    unittest::run_in_thread_pool(&run_flush_messages_test, 3);
+}
+
 /* `GetPeersList` confirms that the behavior of `cluster_t::get_peers_list()` is
 correct. */
 
@@ -504,34 +571,44 @@ TEST(RPCConnectivityTest, Multiplexer) {
 
 class binary_test_application_t : public message_handler_t {
 public:
-    explicit binary_test_application_t(message_service_t *s) :
+    // Each message holds the spectrum `_repeats` times
+    explicit binary_test_application_t(message_service_t *s, int _repeats = 1) :
         service(s),
+        repeats(_repeats),
         got_spectrum(false)
         { }
-    void send_spectrum(peer_id_t peer) {
+    void send_spectrum(peer_id_t peer,
+                       message_class_t message_class = message_class_t::control) {
         class dump_spectrum_writer_t : public send_message_write_callback_t {
         public:
+            explicit dump_spectrum_writer_t(int _repeats) : repeats(_repeats) { }
             virtual ~dump_spectrum_writer_t() { }
             void write(write_stream_t *stream) {
                 char spectrum[CHAR_MAX - CHAR_MIN + 1];
                 for (int i = CHAR_MIN; i <= CHAR_MAX; i++) spectrum[i - CHAR_MIN] = i;
-                int64_t res = stream->write(spectrum, CHAR_MAX - CHAR_MIN + 1);
-                if (res != CHAR_MAX - CHAR_MIN + 1) { throw fake_archive_exc_t(); }
+                for (int r = 0; r < repeats; ++r) {
+                    int64_t res = stream->write(spectrum, CHAR_MAX - CHAR_MIN + 1);
+                    if (res != CHAR_MAX - CHAR_MIN + 1) { throw fake_archive_exc_t(); }
+                }
             }
-        } writer;
-        service->send_message(peer, &writer);
+            int repeats;
+        } writer(repeats);
+        service->send_message(peer, message_class, &writer);
     }
     void on_message(peer_id_t, read_stream_t *stream) {
-        char spectrum[CHAR_MAX - CHAR_MIN + 1];
-        int64_t res = force_read(stream, spectrum, CHAR_MAX - CHAR_MIN + 1);
-        if (res != CHAR_MAX - CHAR_MIN + 1) { throw fake_archive_exc_t(); }
+        for (int r = 0; r < repeats; ++r) {
+            char spectrum[CHAR_MAX - CHAR_MIN + 1];
+            int64_t res = force_read(stream, spectrum, CHAR_MAX - CHAR_MIN + 1);
+            if (res != CHAR_MAX - CHAR_MIN + 1) { throw fake_archive_exc_t(); }
 
-        for (int i = CHAR_MIN; i <= CHAR_MAX; i++) {
-            EXPECT_EQ(spectrum[i - CHAR_MIN], i);
+            for (int i = CHAR_MIN; i <= CHAR_MAX; i++) {
+                EXPECT_EQ(spectrum[i - CHAR_MIN], i);
+            }
         }
         got_spectrum = true;
     }
     message_service_t *service;
+    int repeats;
     bool got_spectrum;
 };
 
@@ -558,6 +635,52 @@ TEST(RPCConnectivityTest, BinaryDataMultiThread) {
     unittest::run_in_thread_pool(&run_binary_data_test, 3);
 }
 
+/* `Compression` sends messages that are worth compressing, and some that aren't,
+over compressed connections. */
+
+void run_compression_test() {
+    set_cluster_compressed_classes(1 << static_cast<int>(message_class_t::bulk));
+    {
+        connectivity_cluster_t c1, c2;
+        binary_test_application_t a1(&c1, 64), a2(&c2, 64);
+        connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a1, 0, NULL);
+        connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a2, 0, NULL);
+        cr1.join(c2.get_peer_address(c2.get_me()));
+
+        let_stuff_happen();
+
+        a1.send_spectrum(c2.get_me(), message_class_t::bulk);
+        a2.send_spectrum(c1.get_me(), message_class_t::bulk);
+
+        let_stuff_happen();
+
+        EXPECT_TRUE(a1.got_spectrum);
+        EXPECT_TRUE(a2.got_spectrum);
+    }
+    {
+        connectivity_cluster_t c1, c2;
+        binary_test_application_t a1(&c1), a2(&c2);
+        connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a1, 0, NULL);
+        connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a2, 0, NULL);
+        cr1.join(c2.get_peer_address(c2.get_me()));
+
+        let_stuff_happen();
+
+        a1.send_spectrum(c2.get_me(), message_class_t::bulk);
+
+        let_stuff_happen();
+
+        EXPECT_TRUE(a2.got_spectrum);
+    }
+    set_cluster_compressed_classes(0);
+}
+TEST(RPCConnectivityTest, Compression) {
+    unittest::run_in_thread_pool(&run_compression_test);
+}
+TEST(RPCConnectivityTest, CompressionMultiThread) {
+    unittest::run_in_thread_pool(&run_compression_test, 3);
+}
+
 /* `PeerIDSemantics` makes sure that `peer_id_t::is_nil()` works as expected. */
 
 void run_peer_id_semantics_test() {
@@ -3,8 +3,8 @@
 
 #include "arch/timing.hpp"
 #include "rpc/connectivity/cluster.hpp"
-#include "rpc/directory/read_manager.hpp"
-#include "rpc/directory/write_manager.hpp"
+#include "rpc/directory/read_manager.tcc"
+#include "rpc/directory/write_manager.tcc"
 #include "unittest/unittest_utils.hpp"
 
 namespace unittest {
@@ -108,4 +108,54 @@ TEST(RPCDirectoryTest, DestructorRace) {
     unittest::run_in_thread_pool(&run_destructor_race_test, 1);
 }
 
+/* `UnchangedUpdate` tests that subscribers don't hear about updates which
+`directory_reuse_unchanged()` says changed nothing. */
+
+class noisy_int_t {
+public:
+    noisy_int_t() : value(0), noise(0) { }
+    noisy_int_t(int v, int n) : value(v), noise(n) { }
+    int value, noise;
+    RDB_MAKE_ME_SERIALIZABLE_2(value, noise);
+};
+
+bool directory_reuse_unchanged(const noisy_int_t &old_value, noisy_int_t *new_value) {
+    return old_value.value != new_value->value;
+}
+
+void run_unchanged_update_test() {
+    connectivity_cluster_t c1, c2;
+    directory_read_manager_t<noisy_int_t> rm1(&c1), rm2(&c2);
+    watchable_variable_t<noisy_int_t> w1(noisy_int_t(101, 0)), w2(noisy_int_t(202, 0));
+    directory_write_manager_t<noisy_int_t> wm1(&c1, w1.get_watchable()), wm2(&c2, w2.get_watchable());
+    connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &rm1, 0, NULL);
+    connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &rm2, 0, NULL);
+    cr2.join(c1.get_peer_address(c1.get_me()));
+    let_stuff_happen();
+
+    int notifications = 0;
+    watchable_t<change_tracking_map_t<peer_id_t, noisy_int_t> >::subscription_t subs(
+        [&notifications]() { ++notifications; });
+    {
+        watchable_t<change_tracking_map_t<peer_id_t, noisy_int_t> >::freeze_t freeze(rm2.get_root_view());
+        subs.reset(rm2.get_root_view(), &freeze);
+    }
+
+    w1.set_value(noisy_int_t(101, 1));
+    let_stuff_happen();
+    EXPECT_EQ(0, notifications);
+    EXPECT_EQ(0, rm2.get_root_view()->get().get_inner().find(c1.get_me())->second.noise);
+
+    w1.set_value(noisy_int_t(151, 2));
+    let_stuff_happen();
+    EXPECT_EQ(1, notifications);
+    EXPECT_EQ(151, rm2.get_root_view()->get().get_inner().find(c1.get_me())->second.value);
+}
+TEST(RPCDirectoryTest, UnchangedUpdate) {
+    unittest::run_in_thread_pool(&run_unchanged_update_test, 1);
+}
+
 }   /* namespace unittest */
+
+template class directory_read_manager_t<unittest::noisy_int_t>;
+template class directory_write_manager_t<unittest::noisy_int_t>;
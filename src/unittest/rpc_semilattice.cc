@@ -3,8 +3,10 @@
 #include <boost/bind.hpp>
 
 #include "containers/archive/archive.hpp"
+#include "containers/archive/stl_types.hpp"
 #include "unittest/unittest_utils.hpp"
 #include "rpc/semilattice/semilattice_manager.hpp"
+#include "rpc/semilattice/joins/deletable.hpp"
 #include "rpc/semilattice/joins/map.hpp"
 #include "rpc/semilattice/view/field.hpp"
 #include "rpc/semilattice/view/member.hpp"
@@ -28,6 +30,10 @@ inline void semilattice_join(sl_int_t *a, sl_int_t b) {
     a->i |= b.i;
 }
 
+inline bool operator==(const sl_int_t &a, const sl_int_t &b) {
+    return a.i == b.i;
+}
+
 class sl_pair_t {
 public:
     sl_pair_t(sl_int_t _x, sl_int_t _y) : x(_x), y(_y) { }
@@ -281,7 +287,122 @@ TEST(RPCSemilatticeTest, MemberViewMultiThread) {
     unittest::run_in_thread_pool(&run_member_view_test, 3);
 }
 
+/* `MapDelta` makes sure that a delta between two maps only has the entries
+that changed. */
+
+TEST(RPCSemilatticeTest, MapDelta) {
+    std::map<std::string, sl_int_t> a;
+    a["foo"] = sl_int_t(1);
+    a["bar"] = sl_int_t(2);
+    std::map<std::string, sl_int_t> b = a;
+    b["bar"] = sl_int_t(6);
+    b["baz"] = sl_int_t(8);
+
+    std::map<std::string, sl_int_t> delta = semilattice_delta(a, b);
+    EXPECT_EQ(2u, delta.size());
+    EXPECT_EQ(0u, delta.count("foo"));
+    EXPECT_EQ(6u, delta["bar"].i);
+    EXPECT_EQ(8u, delta["baz"].i);
+}
+
+/* `DeletableSharing` makes sure that copies of a `deletable_t` share its value
+until one of them is changed, and that sharing doesn't leak changes. */
+
+TEST(RPCSemilatticeTest, DeletableSharing) {
+    std::map<std::string, deletable_t<sl_int_t> > a;
+    a["foo"] = make_deletable(sl_int_t(1));
+    a["bar"] = make_deletable(sl_int_t(2));
+    std::map<std::string, deletable_t<sl_int_t> > b = a;
+    EXPECT_TRUE(a["foo"].shares_value_with(b["foo"]));
+
+    b["bar"].get_mutable()->i = 6;
+    EXPECT_TRUE(a["foo"].shares_value_with(b["foo"]));
+    EXPECT_FALSE(a["bar"].shares_value_with(b["bar"]));
+    EXPECT_EQ(2u, a["bar"].get_ref().i);
+
+    semilattice_join(&a, b);
+    EXPECT_EQ(1u, a["foo"].get_ref().i);
+    EXPECT_EQ(6u, a["bar"].get_ref().i);
+    EXPECT_TRUE(a == b);
+
+    std::map<std::string, deletable_t<sl_int_t> > delta = semilattice_delta(a, b);
+    EXPECT_EQ(0u, delta.size());
+
+    b["foo"].mark_deleted();
+    semilattice_join(&a, b);
+    EXPECT_TRUE(a["foo"].is_deleted());
+    EXPECT_EQ(6u, b["bar"].get_ref().i);
+}
+
+/* `DeltaExchange` makes sure that nodes which only hear about changes through
+deltas still end up with the same metadata. */
+
+void run_delta_exchange_test() {
+    typedef std::map<std::string, sl_int_t> sl_map_t;
+    sl_map_t initial1, initial2;
+    initial1["foo"] = sl_int_t(1);
+    initial2["bar"] = sl_int_t(2);
+
+    connectivity_cluster_t cluster1, cluster2;
+    semilattice_manager_t<sl_map_t> slm1(&cluster1, initial1), slm2(&cluster2, initial2);
+    connectivity_cluster_t::run_t run1(&cluster1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &slm1, 0, NULL);
+    connectivity_cluster_t::run_t run2(&cluster2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &slm2, 0, NULL);
+
+    run1.join(cluster2.get_peer_address(cluster2.get_me()));
+
+    /* Block until the connection is established */
+    {
+        struct : public cond_t, public peers_list_callback_t {
+            void on_connect(UNUSED peer_id_t peer) {
+                pulse();
+            }
+            void on_disconnect(UNUSED peer_id_t peer) { }
+        } connection_established;
+        connectivity_service_t::peers_list_subscription_t subs(&connection_established);
+
+        {
+            ASSERT_FINITE_CORO_WAITING;
+            connectivity_service_t::peers_list_freeze_t freeze(&cluster1);
+            if (!cluster1.get_peer_connected(cluster2.get_me())) {
+                subs.reset(&cluster1, &freeze);
+            } else {
+                connection_established.pulse();
+            }
+        }
+
+        connection_established.wait_lazily_unordered();
+    }
+
+    cond_t non_interruptor;
+    slm1.get_root_view()->sync_from(cluster2.get_me(), &non_interruptor);
+    slm2.get_root_view()->sync_from(cluster1.get_me(), &non_interruptor);
+
+    /* Join in the whole metadata with one change, like most callers do */
+    for (int i = 0; i < 10; ++i) {
+        sl_map_t change = slm1.get_root_view()->get();
+        change["foo"] = sl_int_t(change["foo"].i | (4 << i));
+        slm1.get_root_view()->join(change);
+    }
+    sl_map_t change = slm2.get_root_view()->get();
+    change["baz"] = sl_int_t(8);
+    slm2.get_root_view()->join(change);
+
+    slm1.get_root_view()->sync_to(cluster2.get_me(), &non_interruptor);
+    slm2.get_root_view()->sync_to(cluster1.get_me(), &non_interruptor);
+
+    sl_map_t md1 = slm1.get_root_view()->get(), md2 = slm2.get_root_view()->get();
+    EXPECT_EQ(3u, md1.size());
+    EXPECT_TRUE(md1 == md2);
+    EXPECT_EQ(4093u, md2["foo"].i);
+    EXPECT_EQ(2u, md2["bar"].i);
+    EXPECT_EQ(8u, md1["baz"].i);
+}
+TEST(RPCSemilatticeTest, DeltaExchange) {
+    unittest::run_in_thread_pool(&run_delta_exchange_test, 2);
+}
+
 }   /* namespace unittest */
 
 #include "rpc/semilattice/semilattice_manager.tcc"
 template class semilattice_manager_t<unittest::sl_int_t>;
+template class semilattice_manager_t<std::map<std::string, unittest::sl_int_t> >;
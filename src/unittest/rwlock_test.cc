@@ -2,6 +2,7 @@
 #include <functional>
 
 #include "arch/runtime/coroutines.hpp"
+#include "concurrency/lock_stats.hpp"
 #include "concurrency/pmap.hpp"
 #include "concurrency/rwlock.hpp"
 #include "unittest/gtest.hpp"
@@ -56,6 +57,113 @@ TEST(RwlockTest, ReadAfterWrite) {
     run_in_thread_pool(&read_after_write);
 }
 
+std::string lock_stat(perfmon_collection_t *collection, const std::string &name) {
+    void *ctx = collection->begin_stats();
+    collection->visit_stats(ctx);
+    scoped_ptr_t<perfmon_result_t> result = collection->end_stats(ctx);
+    const perfmon_result_t *lock = result->get_map()->at("lock");
+    return *lock->get_map()->at(name)->get_string();
+}
+
+void contention_stats() {
+    perfmon_collection_t collection;
+    lock_stats_t stats(&collection, "lock");
+    rwlock_t lock(&stats);
+
+    {
+        // The first reader gets in right away, the writer has to wait for it.
+        scoped_ptr_t<rwlock_in_line_t> reader(
+            new rwlock_in_line_t(&lock, access_t::read));
+        rwlock_in_line_t writer(&lock, access_t::write);
+        ASSERT_TRUE(reader->read_signal()->is_pulsed());
+        ASSERT_FALSE(writer.write_signal()->is_pulsed());
+        reader.reset();
+        ASSERT_TRUE(writer.write_signal()->is_pulsed());
+    }
+
+    EXPECT_EQ("2", lock_stat(&collection, "acquisitions"));
+    EXPECT_EQ("1", lock_stat(&collection, "contended"));
+}
+
+TEST(RwlockTest, ContentionStats) {
+    run_in_thread_pool(&contention_stats, 1);
+}
+
+// A writer holds the lock, with a reader, another writer and another reader waiting
+// behind it.
+void interleaved_waiters(rwlock_fairness_t fairness) {
+    rwlock_t lock(NULL, fairness);
+    scoped_ptr_t<rwlock_in_line_t> w1(new rwlock_in_line_t(&lock, access_t::write));
+    scoped_ptr_t<rwlock_in_line_t> r1(new rwlock_in_line_t(&lock, access_t::read));
+    scoped_ptr_t<rwlock_in_line_t> w2(new rwlock_in_line_t(&lock, access_t::write));
+    scoped_ptr_t<rwlock_in_line_t> r2(new rwlock_in_line_t(&lock, access_t::read));
+    ASSERT_TRUE(w1->write_signal()->is_pulsed());
+    ASSERT_FALSE(r1->read_signal()->is_pulsed());
+
+    w1.reset();
+    ASSERT_TRUE(r1->read_signal()->is_pulsed());
+    ASSERT_FALSE(w2->write_signal()->is_pulsed());
+    if (fairness == rwlock_fairness_t::fifo) {
+        ASSERT_FALSE(r2->read_signal()->is_pulsed());
+        r1.reset();
+        ASSERT_TRUE(w2->write_signal()->is_pulsed());
+        ASSERT_FALSE(r2->read_signal()->is_pulsed());
+        w2.reset();
+        ASSERT_TRUE(r2->read_signal()->is_pulsed());
+    } else {
+        // The second reader joins the first one's phase, so the second writer waits
+        // for both.
+        ASSERT_TRUE(r2->read_signal()->is_pulsed());
+        r1.reset();
+        ASSERT_FALSE(w2->write_signal()->is_pulsed());
+        // A reader that gets in line while the writer waits has to wait for it.
+        rwlock_in_line_t r3(&lock, access_t::read);
+        ASSERT_FALSE(r3.read_signal()->is_pulsed());
+        r2.reset();
+        ASSERT_TRUE(w2->write_signal()->is_pulsed());
+        w2.reset();
+        ASSERT_TRUE(r3.read_signal()->is_pulsed());
+    }
+}
+
+TEST(RwlockTest, FifoInterleaved) {
+    run_in_thread_pool(std::bind(&interleaved_waiters, rwlock_fairness_t::fifo), 1);
+}
+
+TEST(RwlockTest, PhaseFairInterleaved) {
+    run_in_thread_pool(std::bind(&interleaved_waiters, rwlock_fairness_t::phase_fair),
+                       1);
+}
+
+// Writers that readers were interleaved with run back to back once the readers have
+// been let in together.
+void phase_fair_batches_writers() {
+    rwlock_t lock(NULL, rwlock_fairness_t::phase_fair);
+    scoped_ptr_t<rwlock_in_line_t> w1(new rwlock_in_line_t(&lock, access_t::write));
+    scoped_ptr_t<rwlock_in_line_t> r1(new rwlock_in_line_t(&lock, access_t::read));
+    scoped_ptr_t<rwlock_in_line_t> w2(new rwlock_in_line_t(&lock, access_t::write));
+    scoped_ptr_t<rwlock_in_line_t> r2(new rwlock_in_line_t(&lock, access_t::read));
+    scoped_ptr_t<rwlock_in_line_t> w3(new rwlock_in_line_t(&lock, access_t::write));
+    scoped_ptr_t<rwlock_in_line_t> r3(new rwlock_in_line_t(&lock, access_t::read));
+
+    w1.reset();
+    ASSERT_TRUE(r1->read_signal()->is_pulsed());
+    ASSERT_TRUE(r2->read_signal()->is_pulsed());
+    ASSERT_TRUE(r3->read_signal()->is_pulsed());
+    r1.reset();
+    r2.reset();
+    r3.reset();
+    ASSERT_TRUE(w2->write_signal()->is_pulsed());
+    ASSERT_FALSE(w3->write_signal()->is_pulsed());
+    w2.reset();
+    ASSERT_TRUE(w3->write_signal()->is_pulsed());
+    w3.reset();
+}
+
+TEST(RwlockTest, PhaseFairBatchesWriters) {
+    run_in_thread_pool(&phase_fair_batches_writers, 1);
+}
+
 
 
 }  // namespace unittest
@@ -1,7 +1,11 @@
 #include <functional>
 
+#include "arch/arch.hpp"
+#include "arch/runtime/coroutines.hpp"
 #include "arch/runtime/starter.hpp"
+#include "buffer_cache/types.hpp"
 #include "serializer/config.hpp"
+#include "serializer/log/static_header.hpp"
 #include "unittest/mock_file.hpp"
 #include "unittest/gtest.hpp"
 
@@ -29,7 +33,7 @@ void run_AddDeleteRepeatedly(bool perform_index_write) {
                               &file_opener,
                               &get_global_perfmon_collection());
 
-    scoped_malloc_t<ser_buffer_t> buf = ser.malloc();
+    scoped_arena_ptr_t<ser_buffer_t> buf = ser.malloc();
     memset(buf->cache_data, 0, ser.max_block_size().value());
 
     scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
@@ -86,5 +90,253 @@ TEST(SerializerTest, AddDeleteRepeatedlyWithIndex) {
     run_in_thread_pool(std::bind(run_AddDeleteRepeatedly, true), 4);
 }
 
+void run_pipelined_index_write(standard_serializer_t *ser, file_account_t *account,
+                               block_id_t block_id,
+                               counted_t<standard_block_token_t> token,
+                               cond_t *reflected, cond_t *done) {
+    std::vector<index_write_op_t> write_ops;
+    write_ops.push_back(index_write_op_t(block_id, token,
+                                         repli_timestamp_t::distant_past));
+    ser->index_write(write_ops, std::bind(&cond_t::pulse, reflected), account);
+    done->pulse();
+}
+
+void run_PipelinedIndexWrites() {
+    mock_file_opener_t file_opener;
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+    standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                              &file_opener,
+                              &get_global_perfmon_collection());
+
+    scoped_arena_ptr_t<ser_buffer_t> buf = ser.malloc();
+    memset(buf->cache_data, 0, ser.max_block_size().value());
+    scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+
+    const block_id_t n = 20;
+    std::vector<buf_write_info_t> infos;
+    for (block_id_t i = 0; i < n; ++i) {
+        infos.push_back(buf_write_info_t(buf.get(), ser.max_block_size(), i));
+    }
+    struct : public iocallback_t, public cond_t {
+        void on_io_complete() {
+            pulse();
+        }
+    } cb;
+    std::vector<counted_t<standard_block_token_t> > tokens
+        = ser.block_writes(infos, account.get(), &cb);
+    cb.wait();
+
+    // Each index write starts as soon as the previous one is in line, without
+    // waiting for it to be written.
+    scoped_array_t<cond_t> reflected(n);
+    scoped_array_t<cond_t> done(n);
+    for (block_id_t i = 0; i < n; ++i) {
+        coro_t::spawn_sometime(std::bind(&run_pipelined_index_write, &ser,
+                                         account.get(), i, tokens[i],
+                                         &reflected[i], &done[i]));
+        reflected[i].wait();
+    }
+    for (block_id_t i = 0; i < n; ++i) {
+        done[i].wait();
+        ASSERT_TRUE(ser.index_read(i).has());
+    }
+}
+
+TEST(SerializerTest, PipelinedIndexWrites) {
+    run_in_thread_pool(run_PipelinedIndexWrites, 4);
+}
+
+void run_SeparateValueBlocks(bool separate_value_blocks) {
+    mock_file_opener_t file_opener;
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+    standard_serializer_t::dynamic_config_t dynamic_config;
+    dynamic_config.separate_value_blocks = separate_value_blocks;
+    standard_serializer_t ser(dynamic_config, &file_opener,
+                              &get_global_perfmon_collection());
+
+    // A btree node and a blob leaf node, written together.
+    scoped_arena_ptr_t<ser_buffer_t> node_buf = ser.malloc();
+    memset(node_buf->cache_data, 0, ser.max_block_size().value());
+    scoped_arena_ptr_t<ser_buffer_t> value_buf = ser.malloc();
+    memset(value_buf->cache_data, 0, ser.max_block_size().value());
+    const block_magic_t blob_leaf_magic = { { 'l', 'a', 'r', 'l' } };
+    *reinterpret_cast<block_magic_t *>(value_buf->cache_data) = blob_leaf_magic;
+
+    scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+    std::vector<buf_write_info_t> infos;
+    infos.push_back(buf_write_info_t(node_buf.get(), ser.max_block_size(), 0));
+    infos.push_back(buf_write_info_t(value_buf.get(), ser.max_block_size(), 1));
+    struct : public iocallback_t, public cond_t {
+        void on_io_complete() {
+            pulse();
+        }
+    } cb;
+    std::vector<counted_t<standard_block_token_t> > tokens
+        = ser.block_writes(infos, account.get(), &cb);
+    cb.wait();
+
+    ASSERT_EQ(2u, tokens.size());
+    const int64_t extent_size = standard_serializer_t::static_config_t().extent_size();
+    EXPECT_EQ(separate_value_blocks,
+              tokens[0]->offset() / extent_size != tokens[1]->offset() / extent_size);
+    EXPECT_EQ(separate_value_blocks ? static_cast<uint32_t>(LS_BUF_VALUE_BLOCK) : 0u,
+              value_buf->ser_header.flags);
+    EXPECT_EQ(0u, node_buf->ser_header.flags);
+}
+
+TEST(SerializerTest, SeparateValueBlocks) {
+    run_in_thread_pool(std::bind(run_SeparateValueBlocks, true), 4);
+}
+
+TEST(SerializerTest, KeepValueBlocksWithNodes) {
+    run_in_thread_pool(std::bind(run_SeparateValueBlocks, false), 4);
+}
+
+#ifndef SEMANTIC_SERIALIZER_CHECK
+// Writes blocks 0 to n - 1, with block i filled with `fill + i`.
+void write_filled_blocks(standard_serializer_t *ser, file_account_t *account,
+                         block_id_t n, char fill) {
+    std::vector<scoped_arena_ptr_t<ser_buffer_t> > bufs;
+    std::vector<buf_write_info_t> infos;
+    for (block_id_t i = 0; i < n; ++i) {
+        bufs.push_back(ser->malloc());
+        memset(bufs.back()->cache_data, fill + i, ser->max_block_size().value());
+        infos.push_back(buf_write_info_t(bufs.back().get(), ser->max_block_size(), i));
+    }
+    struct : public iocallback_t, public cond_t {
+        void on_io_complete() {
+            pulse();
+        }
+    } cb;
+    std::vector<counted_t<standard_block_token_t> > tokens
+        = ser->block_writes(infos, account, &cb);
+    cb.wait();
+
+    std::vector<index_write_op_t> write_ops;
+    for (block_id_t i = 0; i < n; ++i) {
+        write_ops.push_back(index_write_op_t(i, tokens[i],
+                                             repli_timestamp_t::distant_past));
+    }
+    ser->index_write(write_ops, account);
+}
+
+void run_backup(standard_serializer_t *ser, file_t *target, cond_t *done) {
+    cond_t non_interruptor;
+    ser->backup(target, &non_interruptor);
+    done->pulse();
+}
+
+void run_Backup() {
+    mock_file_opener_t file_opener;
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+    mock_file_opener_t backup_file_opener;
+    const block_id_t n = 10;
+    {
+        standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                                  &file_opener,
+                                  &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        write_filled_blocks(&ser, account.get(), n, 'a');
+
+        scoped_ptr_t<file_t> target;
+        backup_file_opener.open_serializer_file_create_temporary(&target);
+        // The backup gets the blocks as they were when it started, even though
+        // they're all rewritten (over and over, so that their old extents would be
+        // freed) while it copies them.
+        cond_t done;
+        coro_t::spawn_now_dangerously(std::bind(&run_backup, &ser, target.get(), &done));
+        for (int round = 0; round < 20; ++round) {
+            write_filled_blocks(&ser, account.get(), n, 'A');
+        }
+        done.wait();
+        backup_file_opener.move_serializer_file_to_permanent_location();
+    }
+
+    standard_serializer_t backup(standard_serializer_t::dynamic_config_t(),
+                                 &backup_file_opener,
+                                 &get_global_perfmon_collection());
+    scoped_ptr_t<file_account_t> account(backup.make_io_account(1));
+    scoped_arena_ptr_t<ser_buffer_t> buf = backup.malloc();
+    ASSERT_EQ(n, backup.max_block_id());
+    for (block_id_t i = 0; i < n; ++i) {
+        counted_t<standard_block_token_t> token = backup.index_read(i);
+        ASSERT_TRUE(token.has());
+        backup.block_read(token, buf.get(), account.get());
+        EXPECT_EQ('a' + static_cast<char>(i), buf->cache_data[0]);
+    }
+}
+
+TEST(SerializerTest, Backup) {
+    run_in_thread_pool(run_Backup, 4);
+}
+
+void run_UnchecksummedFile() {
+    mock_file_opener_t file_opener;
+    const standard_serializer_t::static_config_t static_config;
+    standard_serializer_t::create(&file_opener, static_config);
+    {
+        // As if the file had been created by the older version.
+        scoped_ptr_t<file_t> file;
+        file_opener.open_serializer_file_existing(&file);
+        standard_serializer_t::static_config_t on_disk_config = static_config;
+        co_static_header_write(file.get(), true, &on_disk_config,
+                               sizeof(log_serializer_on_disk_static_config_t));
+    }
+
+    const block_id_t n = 10;
+    std::vector<int64_t> offsets;
+    {
+        standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                                  &file_opener,
+                                  &get_global_perfmon_collection());
+        // The cache gets as much room in each block as it had before.
+        ASSERT_EQ(static_config.block_size().ser_value() - sizeof(block_id_t),
+                  ser.max_block_size().value());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        write_filled_blocks(&ser, account.get(), n, 'a');
+        for (block_id_t i = 0; i < n; ++i) {
+            offsets.push_back(ser.index_read(i)->offset());
+        }
+    }
+
+    {
+        // The blocks are stored in the old format, with just their block ids in front
+        // of their cache data.
+        scoped_ptr_t<file_t> file;
+        file_opener.open_serializer_file_existing(&file);
+        const uint32_t ser_block_size = static_config.block_size().ser_value();
+        scoped_malloc_t<char> block(malloc_aligned(ser_block_size, DEVICE_BLOCK_SIZE));
+        for (block_id_t i = 0; i < n; ++i) {
+            co_read(file.get(), offsets[i], ser_block_size, block.get(),
+                    DEFAULT_DISK_ACCOUNT);
+            block_id_t block_id;
+            memcpy(&block_id, block.get(), sizeof(block_id));
+            EXPECT_EQ(i, block_id);
+            EXPECT_EQ('a' + static_cast<char>(i), block.get()[sizeof(block_id_t)]);
+            EXPECT_EQ('a' + static_cast<char>(i), block.get()[ser_block_size - 1]);
+        }
+    }
+
+    standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                              &file_opener,
+                              &get_global_perfmon_collection());
+    scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+    scoped_arena_ptr_t<ser_buffer_t> buf = ser.malloc();
+    for (block_id_t i = 0; i < n; ++i) {
+        counted_t<standard_block_token_t> token = ser.index_read(i);
+        ASSERT_TRUE(token.has());
+        ser.block_read(token, buf.get(), account.get());
+        EXPECT_EQ(i, buf->ser_header.block_id);
+        EXPECT_EQ('a' + static_cast<char>(i), buf->cache_data[0]);
+        EXPECT_EQ('a' + static_cast<char>(i),
+                  buf->cache_data[ser.max_block_size().value() - 1]);
+    }
+}
+
+TEST(SerializerTest, UnchecksummedFile) {
+    run_in_thread_pool(run_UnchecksummedFile, 4);
+}
+#endif  // SEMANTIC_SERIALIZER_CHECK
+
 
 }  // namespace unittest
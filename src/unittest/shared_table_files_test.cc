@@ -0,0 +1,98 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <stdlib.h>
+
+#include "arch/io/disk.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "clustering/administration/main/shared_table_files.hpp"
+#include "config/args.hpp"
+#include "serializer/translator.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+static void write_block(translator_serializer_t *ser, block_id_t block_id) {
+    on_thread_t th(ser->home_thread());
+    scoped_arena_ptr_t<ser_buffer_t> buf = ser->malloc();
+    memset(buf->cache_data, 0, ser->max_block_size().value());
+
+    struct : public iocallback_t, public cond_t {
+        void on_io_complete() {
+            pulse();
+        }
+    } cb;
+    std::vector<buf_write_info_t> infos;
+    infos.push_back(buf_write_info_t(buf.get(), ser->max_block_size(), block_id));
+    std::vector<counted_t<standard_block_token_t> > tokens
+        = ser->block_writes(infos, DEFAULT_DISK_ACCOUNT, &cb);
+    cb.wait();
+
+    std::vector<index_write_op_t> write_ops;
+    write_ops.push_back(index_write_op_t(block_id, tokens[0],
+                                         repli_timestamp_t::distant_past));
+    ser->index_write(write_ops, DEFAULT_DISK_ACCOUNT);
+}
+
+static block_id_t max_block_id(translator_serializer_t *ser) {
+    on_thread_t th(ser->home_thread());
+    return ser->max_block_id();
+}
+
+void run_shared_table_files_test() {
+    char tmpl[] = "/tmp/rdb_unittest.XXXXXX";
+    guarantee_err(mkdtemp(tmpl) != NULL, "Couldn't create a temporary directory");
+    const base_path_t base_path(tmpl);
+    recreate_temporary_directory(base_path);
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    const namespace_id_t a = generate_uuid(), b = generate_uuid(), c = generate_uuid();
+
+    {
+        shared_table_files_t files(&io_backender, base_path, true);
+        std::vector<translator_serializer_t *> sers;
+        ASSERT_FALSE(files.find_table(a, &sers));
+
+        std::vector<translator_serializer_t *> a_sers = files.create_table(a, 2);
+        ASSERT_EQ(2u, a_sers.size());
+        // Not findable until it's been created
+        ASSERT_FALSE(files.find_table(a, &sers));
+        write_block(a_sers[0], 0);
+        write_block(a_sers[0], 1);
+        files.table_created(a);
+        ASSERT_TRUE(files.find_table(a, &sers));
+        ASSERT_EQ(a_sers, sers);
+        ASSERT_EQ(2, max_block_id(a_sers[0]));
+
+        std::vector<translator_serializer_t *> b_sers = files.create_table(b, 1);
+        write_block(b_sers[0], 0);
+        files.table_created(b);
+
+        // Dropping a table wipes its slots before another table gets them.
+        ASSERT_TRUE(files.destroy_table(a));
+        ASSERT_FALSE(files.destroy_table(a));
+        std::vector<translator_serializer_t *> c_sers
+            = files.create_table(c, SHARED_TABLE_FILE_SLOTS);
+        ASSERT_EQ(0, max_block_id(a_sers[0]));
+        files.table_created(c);
+    }
+
+    {
+        // Everything is where we left it after a restart.
+        shared_table_files_t files(&io_backender, base_path, true);
+        std::vector<translator_serializer_t *> sers;
+        ASSERT_FALSE(files.find_table(a, &sers));
+        ASSERT_TRUE(files.find_table(b, &sers));
+        ASSERT_EQ(1u, sers.size());
+        ASSERT_EQ(1, max_block_id(sers[0]));
+        ASSERT_TRUE(files.find_table(c, &sers));
+        ASSERT_EQ(static_cast<size_t>(SHARED_TABLE_FILE_SLOTS), sers.size());
+    }
+
+    remove_directory_recursive(tmpl);
+}
+
+TEST(SharedTableFiles, CreateDestroyReopen) {
+    run_in_thread_pool(&run_shared_table_files_test, 4);
+}
+
+}  // namespace unittest
@@ -0,0 +1,78 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "arch/runtime/slab_allocator.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "config/args.hpp"
+#include "concurrency/pmap.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+void reuses_freed_blocks() {
+    void *p = slab_allocate(40);
+    slab_deallocate(p, 40);
+    // Same size class, same thread.
+    void *q = slab_allocate(48);
+    EXPECT_EQ(p, q);
+    slab_deallocate(q, 48);
+
+    // Too big for a slab.
+    void *big = slab_allocate(SLAB_MAX_OBJECT_SIZE + 1);
+    memset(big, 0, SLAB_MAX_OBJECT_SIZE + 1);
+    slab_deallocate(big, SLAB_MAX_OBJECT_SIZE + 1);
+}
+
+TEST(SlabAllocatorTest, ReusesFreedBlocks) {
+    run_in_thread_pool(&reuses_freed_blocks, 1);
+}
+
+void free_on_thread(std::vector<std::vector<void *> > *blocks, int thread) {
+    on_thread_t thread_switcher((threadnum_t(thread)));
+    for (void *p : (*blocks)[thread]) {
+        slab_deallocate(p, 64);
+    }
+}
+
+void frees_from_other_threads() {
+    const int num_threads = get_num_threads();
+    // Enough to need more than one slab per thread.
+    const size_t count = 2 * SLAB_SIZE / 64;
+    std::vector<std::vector<void *> > blocks(num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+        for (size_t j = 0; j < count; ++j) {
+            void *p = slab_allocate(64);
+            memset(p, i, 64);
+            blocks[i].push_back(p);
+        }
+    }
+    // All allocated here, but `blocks[i]` is freed on thread `i`.
+    pmap(num_threads, std::bind(&free_on_thread, &blocks, std::placeholders::_1));
+
+    // They all come back to this thread.
+    std::vector<void *> again;
+    for (size_t j = 0; j < count * num_threads; ++j) {
+        again.push_back(slab_allocate(64));
+    }
+    std::vector<void *> all;
+    for (const auto &b : blocks) {
+        all.insert(all.end(), b.begin(), b.end());
+    }
+    std::sort(all.begin(), all.end());
+    std::sort(again.begin(), again.end());
+    EXPECT_TRUE(all == again);
+    for (void *p : again) {
+        slab_deallocate(p, 64);
+    }
+}
+
+TEST(SlabAllocatorTest, FreesFromOtherThreads) {
+    run_in_thread_pool(&frees_from_other_threads, 4);
+}
+
+}  // namespace unittest
@@ -0,0 +1,79 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <map>
+#include <string>
+#include <vector>
+
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/sort_key.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+int sign(int x) {
+    return (x > 0) - (x < 0);
+}
+
+std::vector<counted_t<const ql::datum_t> > sort_key_test_values() {
+    std::vector<counted_t<const ql::datum_t> > values;
+    values.push_back(make_counted<ql::datum_t>(ql::datum_t::R_NULL));
+    values.push_back(make_counted<ql::datum_t>(ql::datum_t::R_BOOL, false));
+    values.push_back(make_counted<ql::datum_t>(ql::datum_t::R_BOOL, true));
+    const double nums[] = { -1e300, -2.5, -1, -0.0, 0.0, 1e-300, 1, 2.5, 1e300 };
+    for (size_t i = 0; i < sizeof(nums) / sizeof(nums[0]); ++i) {
+        values.push_back(make_counted<ql::datum_t>(nums[i]));
+    }
+    const std::string strs[] = { "", std::string("\0", 1), std::string("a\0", 2),
+                                 "a", "ab", "b", "\xff" };
+    for (size_t i = 0; i < sizeof(strs) / sizeof(strs[0]); ++i) {
+        values.push_back(make_counted<ql::datum_t>(std::string(strs[i])));
+    }
+    std::vector<counted_t<const ql::datum_t> > arr;
+    values.push_back(make_counted<ql::datum_t>(std::move(arr)));
+    arr.push_back(make_counted<ql::datum_t>(1.0));
+    values.push_back(make_counted<ql::datum_t>(std::move(arr)));
+    std::map<std::string, counted_t<const ql::datum_t> > obj;
+    obj["a"] = make_counted<ql::datum_t>(1.0);
+    values.push_back(make_counted<ql::datum_t>(std::move(obj)));
+    return values;
+}
+
+void run_sort_key_test() {
+    std::vector<counted_t<const ql::datum_t> > values = sort_key_test_values();
+    // A missing value sorts before everything.
+    values.push_back(counted_t<const ql::datum_t>());
+
+    for (size_t i = 0; i < values.size(); ++i) {
+        for (size_t j = 0; j < values.size(); ++j) {
+            for (int desc = 0; desc < 2; ++desc) {
+                // A second value, to check that the first one decides.
+                ql::sort_key_t l, r;
+                l.append(values[i], desc);
+                l.append(values[0], false);
+                r.append(values[j], desc);
+                r.append(values.back(), false);
+
+                int expected;
+                if (!values[i].has() || !values[j].has()) {
+                    expected = values[i].has() - values[j].has();
+                } else {
+                    expected = sign(values[i]->cmp(*values[j]));
+                }
+                if (desc) {
+                    expected = -expected;
+                }
+                if (expected == 0) {
+                    // Then the second value decides: null after missing.
+                    expected = 1;
+                }
+                EXPECT_EQ(expected, sign(l.cmp(r))) << i << " " << j << " " << desc;
+            }
+        }
+    }
+}
+
+TEST(SortKeyTest, OrdersLikeDatums) {
+    run_in_thread_pool(&run_sort_key_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,82 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <vector>
+
+#include "arch/arch.hpp"
+#include "arch/timing.hpp"
+#include "containers/scoped.hpp"
+#include "serializer/log/ssd_cache.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/mock_file.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+const uint32_t block_size = DEVICE_BLOCK_SIZE - 100;
+
+scoped_ptr_t<ssd_block_cache_t> make_cache(std::vector<char> *data, int num_slots) {
+    data->resize(num_slots * DEVICE_BLOCK_SIZE);
+    return make_scoped<ssd_block_cache_t>(
+        make_scoped<mock_file_t>(mock_file_t::mode_rw, data), block_size);
+}
+
+void run_offer_read_test() {
+    std::vector<char> data;
+    scoped_ptr_t<ssd_block_cache_t> cache = make_cache(&data, 2);
+    ASSERT_EQ(2u, cache->num_slots());
+
+    std::vector<char> block(block_size, 'x');
+    std::vector<char> buf(block_size);
+    EXPECT_FALSE(cache->read(0, block_size, buf.data()));
+
+    cache->offer(0, block_size, block.data());
+    // The block isn't read back until it's been written.
+    nap(50);
+    ASSERT_TRUE(cache->read(0, block_size, buf.data()));
+    EXPECT_EQ(block, buf);
+    EXPECT_FALSE(cache->read(0, block_size - 1, buf.data()));
+
+    // Moved blocks are found at their new offset.
+    cache->move(0, 4 * DEVICE_BLOCK_SIZE);
+    EXPECT_FALSE(cache->read(0, block_size, buf.data()));
+    EXPECT_TRUE(cache->read(4 * DEVICE_BLOCK_SIZE, block_size, buf.data()));
+
+    cache->forget(4 * DEVICE_BLOCK_SIZE);
+    EXPECT_FALSE(cache->read(4 * DEVICE_BLOCK_SIZE, block_size, buf.data()));
+}
+
+TEST(SsdCacheTest, OfferRead) {
+    run_in_thread_pool(run_offer_read_test);
+}
+
+void run_eviction_test() {
+    std::vector<char> data;
+    scoped_ptr_t<ssd_block_cache_t> cache = make_cache(&data, 2);
+
+    std::vector<char> buf(block_size);
+    for (int i = 0; i < 3; ++i) {
+        std::vector<char> block(block_size, 'a' + i);
+        cache->offer(i * DEVICE_BLOCK_SIZE, block_size, block.data());
+        nap(50);
+        if (i == 1) {
+            // Use the first block, so that the second one is the one to go.
+            EXPECT_TRUE(cache->read(0, block_size, buf.data()));
+        }
+    }
+    EXPECT_TRUE(cache->read(0, block_size, buf.data()));
+    EXPECT_EQ('a', buf[0]);
+    EXPECT_FALSE(cache->read(DEVICE_BLOCK_SIZE, block_size, buf.data()));
+    EXPECT_TRUE(cache->read(2 * DEVICE_BLOCK_SIZE, block_size, buf.data()));
+    EXPECT_EQ('c', buf[0]);
+
+    // A block that got corrupted on the device is a miss.
+    memset(data.data(), 0, data.size());
+    EXPECT_FALSE(cache->read(0, block_size, buf.data()));
+}
+
+TEST(SsdCacheTest, Eviction) {
+    run_in_thread_pool(run_eviction_test);
+}
+
+}  // namespace unittest
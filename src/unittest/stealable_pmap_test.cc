@@ -0,0 +1,55 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <atomic>
+#include <vector>
+
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/stealable_pmap.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+void run_every_index_once() {
+    const int count = 10000;
+    std::vector<std::atomic<int> > runs(count);
+    for (int i = 0; i < count; ++i) {
+        runs[i].store(0);
+    }
+
+    stealable_pmap(count, [&](int i) {
+        runs[i].fetch_add(1);
+    });
+
+    for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(1, runs[i].load());
+    }
+}
+
+TEST(StealablePmap, EveryIndexOnce) {
+    run_in_thread_pool(&run_every_index_once, 4);
+}
+
+void run_idle_thread_steals() {
+    const threadnum_t home_thread = get_thread_id();
+    std::atomic<bool> stolen(false);
+
+    // This thread claims 0 first and can't get to 1 until 0 returns, so 0 only
+    // returns if the other thread steals 1.
+    stealable_pmap(2, [&](int i) {
+        if (i == 0) {
+            while (!stolen.load()) { }
+        } else {
+            EXPECT_NE(home_thread.threadnum, get_thread_id().threadnum);
+            stolen.store(true);
+        }
+    });
+
+    ASSERT_TRUE(stolen.load());
+}
+
+TEST(StealablePmap, IdleThreadSteals) {
+    run_in_thread_pool(&run_idle_thread_steals, 2);
+}
+
+}  // namespace unittest
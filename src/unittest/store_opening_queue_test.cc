@@ -0,0 +1,55 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <functional>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "clustering/administration/store_opening_queue.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+void open_store(store_opening_queue_t *queue, bool is_primary, int id,
+                std::vector<int> *order, cond_t *done) {
+    store_opening_queue_t::acq_t slot(queue, is_primary);
+    order->push_back(id);
+    done->wait();
+}
+
+void run_primaries_first_test() {
+    store_opening_queue_t queue(1);
+    scoped_ptr_t<store_opening_queue_t::acq_t> first(
+        new store_opening_queue_t::acq_t(&queue, false));
+
+    std::vector<int> order;
+    cond_t done;
+    coro_t::spawn_now_dangerously(std::bind(&open_store, &queue, false, 1, &order,
+                                            &done));
+    coro_t::spawn_now_dangerously(std::bind(&open_store, &queue, false, 2, &order,
+                                            &done));
+    coro_t::spawn_now_dangerously(std::bind(&open_store, &queue, true, 3, &order,
+                                            &done));
+    EXPECT_EQ(3u, queue.num_waiting());
+    EXPECT_TRUE(order.empty());
+
+    // The slot goes to the primary, and then to the others in turn.
+    done.pulse();
+    first.reset();
+    while (order.size() < 3) {
+        coro_t::yield();
+    }
+    EXPECT_EQ(3, order[0]);
+    EXPECT_EQ(1, order[1]);
+    EXPECT_EQ(2, order[2]);
+    EXPECT_EQ(0u, queue.num_waiting());
+
+    // Now that everybody has left, the slot is free again.
+    store_opening_queue_t::acq_t last(&queue, false);
+}
+
+TEST(StoreOpeningQueueTest, PrimariesFirst) {
+    run_in_thread_pool(run_primaries_first_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,84 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <vector>
+
+#include "arch/arch.hpp"
+#include "containers/scoped.hpp"
+#include "serializer/log/striped_file.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/mock_file.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+const int64_t stripe_size = 2 * DEVICE_BLOCK_SIZE;
+
+TEST(StripedFileTest, FileSizes) {
+    // Seven and a half stripes over three files: 0 3 6 | 1 4 7(half) | 2 5.
+    const int64_t size = 7 * stripe_size + stripe_size / 2;
+    EXPECT_EQ(3 * stripe_size, striped_file_t::file_size_for(size, stripe_size, 3, 0));
+    EXPECT_EQ(2 * stripe_size + stripe_size / 2,
+              striped_file_t::file_size_for(size, stripe_size, 3, 1));
+    EXPECT_EQ(2 * stripe_size, striped_file_t::file_size_for(size, stripe_size, 3, 2));
+    EXPECT_EQ(0, striped_file_t::file_size_for(0, stripe_size, 3, 1));
+}
+
+scoped_ptr_t<striped_file_t> make_striped_file(std::vector<std::vector<char> > *datas) {
+    std::vector<scoped_ptr_t<file_t> > files;
+    for (size_t i = 0; i < datas->size(); ++i) {
+        files.push_back(make_scoped<mock_file_t>(mock_file_t::mode_rw, &(*datas)[i]));
+    }
+    return make_scoped<striped_file_t>(std::move(files), stripe_size);
+}
+
+void run_round_robin_test() {
+    const int num_stripes = 7;
+    std::vector<std::vector<char> > datas(3);
+    scoped_malloc_t<char> buf(malloc_aligned(DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE));
+    {
+        scoped_ptr_t<striped_file_t> file = make_striped_file(&datas);
+        file->set_size_at_least(num_stripes * stripe_size);
+        EXPECT_EQ(num_stripes * stripe_size, file->get_size());
+
+        // Mark the second block of each stripe with the stripe's number.
+        for (int i = 0; i < num_stripes; ++i) {
+            memset(buf.get(), 'a' + i, DEVICE_BLOCK_SIZE);
+            co_write(file.get(), i * stripe_size + DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE,
+                     buf.get(), DEFAULT_DISK_ACCOUNT,
+                     i == num_stripes - 1
+                     ? file_t::WRAP_IN_DATASYNCS : file_t::NO_DATASYNCS);
+        }
+    }
+
+    ASSERT_EQ(3 * stripe_size, static_cast<int64_t>(datas[0].size()));
+    ASSERT_EQ(2 * stripe_size, static_cast<int64_t>(datas[1].size()));
+    ASSERT_EQ(2 * stripe_size, static_cast<int64_t>(datas[2].size()));
+    for (int i = 0; i < num_stripes; ++i) {
+        const std::vector<char> &data = datas[i % 3];
+        const int64_t offset = (i / 3) * stripe_size;
+        EXPECT_EQ(0, data[offset]);
+        EXPECT_EQ('a' + i, data[offset + DEVICE_BLOCK_SIZE]);
+    }
+
+    // Opening the files again gives the same striped file.
+    scoped_ptr_t<striped_file_t> file = make_striped_file(&datas);
+    EXPECT_EQ(num_stripes * stripe_size, file->get_size());
+    for (int i = 0; i < num_stripes; ++i) {
+        co_read(file.get(), i * stripe_size + DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE,
+                buf.get(), DEFAULT_DISK_ACCOUNT);
+        EXPECT_EQ('a' + i, buf.get()[0]);
+    }
+
+    // Shrinking it shrinks each of the files.
+    file->set_size(4 * stripe_size);
+    EXPECT_EQ(2 * stripe_size, static_cast<int64_t>(datas[0].size()));
+    EXPECT_EQ(stripe_size, static_cast<int64_t>(datas[1].size()));
+    EXPECT_EQ(stripe_size, static_cast<int64_t>(datas[2].size()));
+}
+
+TEST(StripedFileTest, RoundRobin) {
+    run_in_thread_pool(run_round_robin_test);
+}
+
+}  // namespace unittest
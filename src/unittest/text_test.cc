@@ -0,0 +1,48 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "config/args.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/text.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(TextTest, Words) {
+    std::vector<std::string> words = ql::text_words("The cat, the HAT & the bat2.");
+    std::vector<std::string> expected = { "bat2", "cat", "hat", "the" };
+    EXPECT_EQ(expected, words);
+
+    EXPECT_TRUE(ql::text_words("  ,;.!  ").empty());
+
+    // Non-ASCII bytes are left alone, as parts of words.
+    words = ql::text_words("caf\xc3\xa9 au lait");
+    expected = { "au", "caf\xc3\xa9", "lait" };
+    EXPECT_EQ(expected, words);
+}
+
+TEST(TextTest, LongWords) {
+    const std::string long_word(TEXT_INDEX_MAX_WORD_LENGTH + 10, 'a');
+    std::vector<std::string> words = ql::text_words(long_word);
+    ASSERT_EQ(1u, words.size());
+    EXPECT_EQ(std::string(TEXT_INDEX_MAX_WORD_LENGTH, 'a'), words[0]);
+}
+
+TEST(TextTest, WordsOfArray) {
+    ql::datum_ptr_t arr(ql::datum_t::R_ARRAY);
+    arr.add(make_counted<const ql::datum_t>("red fish"));
+    arr.add(make_counted<const ql::datum_t>("blue fish"));
+    std::vector<std::string> words = ql::text_words_of_datum(arr.to_counted());
+    std::vector<std::string> expected = { "blue", "fish", "red" };
+    EXPECT_EQ(expected, words);
+}
+
+TEST(TextTest, HasWords) {
+    std::vector<std::string> words = ql::text_words("one fish two fish");
+    EXPECT_TRUE(ql::text_has_words(words, ql::text_words("fish two")));
+    EXPECT_TRUE(ql::text_has_words(words, std::vector<std::string>()));
+    EXPECT_FALSE(ql::text_has_words(words, ql::text_words("red fish")));
+}
+
+}  // namespace unittest
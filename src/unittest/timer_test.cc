@@ -1,6 +1,9 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <vector>
+
 #include "unittest/gtest.hpp"
 
+#include "arch/timer.hpp"
 #include "arch/timing.hpp"
 #include "concurrency/pmap.hpp"
 #include "unittest/unittest_utils.hpp"
@@ -33,6 +36,56 @@ TEST(TimerTest, TestApproximateWaitTimes) {
     unittest::run_in_thread_pool(run_TestApproximateWaitTimes);
 }
 
+void walk_coarse_wait_times(int i) {
+    // These go in the timing wheel, which rings them up to a tick late, but never early.
+    ticks_t t = get_ticks();
+    for (int j = 0; j < 2; ++j) {
+        const int64_t ms = TIMER_WHEEL_MIN_MS + wait_array[i][j] * 10;
+        nap(ms);
+        const ticks_t t2 = get_ticks();
+        const int64_t diff = static_cast<int64_t>(t2) - static_cast<int64_t>(t);
+        ASSERT_LE(ms * MILLION, diff);
+        ASSERT_LT(diff, (ms + TIMER_WHEEL_TICK_MS + 2) * MILLION);
+        t = t2;
+    }
+}
+
+void run_TestCoarseWaitTimes() {
+    pmap(2, walk_coarse_wait_times);
+}
+
+TEST(TimerTest, TestCoarseWaitTimes) {
+    unittest::run_in_thread_pool(run_TestCoarseWaitTimes);
+}
+
+struct counting_timer_callback_t : public timer_callback_t {
+    counting_timer_callback_t() : count(0) { }
+    void on_timer() { ++count; }
+    int count;
+};
+
+void run_TestCancelCoarseTimers() {
+    // Lots of timeouts that get canceled before they ring, mixed with ones that do.
+    counting_timer_callback_t canceled, rung;
+    std::vector<timer_token_t *> tokens;
+    for (int i = 0; i < 1000; ++i) {
+        tokens.push_back(fire_timer_once(TIMER_WHEEL_MIN_MS + i, &canceled));
+    }
+    timer_token_t *repeating = add_timer(TIMER_WHEEL_MIN_MS, &rung);
+    fire_timer_once(TIMER_WHEEL_MIN_MS, &rung);
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        cancel_timer(tokens[i]);
+    }
+    nap(2 * TIMER_WHEEL_MIN_MS + 4 * TIMER_WHEEL_TICK_MS);
+    cancel_timer(repeating);
+    EXPECT_EQ(0, canceled.count);
+    EXPECT_EQ(3, rung.count);
+}
+
+TEST(TimerTest, TestCancelCoarseTimers) {
+    unittest::run_in_thread_pool(run_TestCancelCoarseTimers);
+}
+
 
 
 
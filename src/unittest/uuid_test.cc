@@ -88,5 +88,16 @@ TEST(UuidTest, Sha1) {
     check_sha(empty, empty_expected);
 }
 
+TEST(UuidTest, TimeOrdered) {
+    std::string last = uuid_to_str(generate_time_ordered_uuid());
+    for (int i = 0; i < 10000; ++i) {
+        std::string next = uuid_to_str(generate_time_ordered_uuid());
+        ASSERT_LT(last, next);
+        ASSERT_TRUE(is_uuid(next));
+        ASSERT_EQ('7', next[14]);
+        last = next;
+    }
+}
+
 
 }  // namespace unittest
@@ -0,0 +1,39 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/var_types.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+counted_t<const ql::datum_t> num(double d) {
+    return make_counted<const ql::datum_t>(d);
+}
+
+TEST(VarTypesTest, ScopeLookups) {
+    ql::var_scope_t outer = ql::var_scope_t().with_func_arg_list(
+        { ql::sym_t(5), ql::sym_t(2) }, { num(5), num(2) });
+    ql::var_scope_t scope = outer.with_func_arg_list({ ql::sym_t(3) }, { num(3) });
+
+    ASSERT_EQ(2, scope.lookup_var(ql::sym_t(2))->as_num());
+    ASSERT_EQ(3, scope.lookup_var(ql::sym_t(3))->as_num());
+    ASSERT_EQ(5, scope.lookup_var(ql::sym_t(5))->as_num());
+
+    // The slot from one lookup finds the variable straight away in the next, and a
+    // wrong one is fixed up.
+    size_t slot = 0;
+    ASSERT_EQ(5, scope.lookup_var(ql::sym_t(5), &slot)->as_num());
+    ASSERT_EQ(2u, slot);
+    ASSERT_EQ(5, scope.lookup_var(ql::sym_t(5), &slot)->as_num());
+    ASSERT_EQ(2, outer.lookup_var(ql::sym_t(2), &slot)->as_num());
+    ASSERT_EQ(0u, slot);
+
+    ql::var_captures_t captures;
+    captures.vars_captured.insert(ql::sym_t(5));
+    captures.vars_captured.insert(ql::sym_t(2));
+    ql::var_scope_t filtered = scope.filtered_by_captures(captures);
+    ASSERT_EQ(2, filtered.lookup_var(ql::sym_t(2))->as_num());
+    ASSERT_EQ(5, filtered.lookup_var(ql::sym_t(5))->as_num());
+    ASSERT_FALSE(filtered.compute_visibility().contains_var(ql::sym_t(3)));
+}
+
+}  // namespace unittest
@@ -0,0 +1,65 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "buffer_cache/alt/warm_manifest.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TEST(WarmManifestTest, RoundTrip) {
+    temp_file_t temp_file;
+    const std::string path = temp_file.name().permanent_path();
+
+    std::vector<block_id_t> block_ids;
+    for (block_id_t i = 0; i < 1000; ++i) {
+        block_ids.push_back((i * 7919) % 1000);
+    }
+    ASSERT_TRUE(alt::write_warm_manifest(path, block_ids));
+
+    std::vector<block_id_t> read_ids;
+    ASSERT_TRUE(alt::read_warm_manifest(path, &read_ids));
+    ASSERT_EQ(block_ids, read_ids);
+
+    // An empty manifest is a valid one.
+    ASSERT_TRUE(alt::write_warm_manifest(path, std::vector<block_id_t>()));
+    ASSERT_TRUE(alt::read_warm_manifest(path, &read_ids));
+    ASSERT_TRUE(read_ids.empty());
+}
+
+TEST(WarmManifestTest, RejectsBadFiles) {
+    temp_file_t temp_file;
+    const std::string path = temp_file.name().permanent_path();
+    std::vector<block_id_t> read_ids;
+
+    ASSERT_FALSE(alt::read_warm_manifest(path + ".missing", &read_ids));
+
+    // A truncated manifest is ignored rather than half-loaded.
+    std::vector<block_id_t> block_ids(100, 5);
+    ASSERT_TRUE(alt::write_warm_manifest(path, block_ids));
+    ASSERT_EQ(0, truncate(path.c_str(), 100));
+    ASSERT_FALSE(alt::read_warm_manifest(path, &read_ids));
+    ASSERT_TRUE(read_ids.empty());
+
+    FILE *f = fopen(path.c_str(), "w");
+    ASSERT_TRUE(f != NULL);
+    fputs("this is not a manifest at all", f);
+    fclose(f);
+    ASSERT_FALSE(alt::read_warm_manifest(path, &read_ids));
+
+    // A count whose size in bytes wraps around to the file's size.
+    f = fopen(path.c_str(), "w");
+    ASSERT_TRUE(f != NULL);
+    fputs("rdbwarm1", f);
+    const uint64_t wrapping_count = 1ULL << 61;
+    ASSERT_EQ(1u, fwrite(&wrapping_count, sizeof(wrapping_count), 1, f));
+    fclose(f);
+    ASSERT_FALSE(alt::read_warm_manifest(path, &read_ids));
+    ASSERT_TRUE(read_ids.empty());
+}
+
+}  // namespace unittest
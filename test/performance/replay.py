@@ -0,0 +1,208 @@
+#!/usr/bin/python
+# Copyright 2010-2014 RethinkDB, all rights reserved.
+
+# Replays the queries a server captured with `--capture-queries` against another
+# server, on as many connections as they were captured from and with the same timing
+# (or sped up), and reports how long the replayed queries took.
+#
+# The capture file holds the queries exactly as the clients sent them, so the tables
+# they use have to exist on the server they're replayed against.  Load a copy of the
+# production data (with `rethinkdb restore`) before replaying writes.
+
+import sys, os, struct, socket, threading, time, json
+from optparse import OptionParser
+
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, os.path.pardir, "drivers", "python")))
+from rethinkdb import ql2_pb2 as p
+
+CAPTURE_MAGIC = "RQLCAP01"
+RECORD_HEADER = struct.Struct("=qQI")
+
+def read_capture(path):
+    """Returns the captured queries as a dict from connection id to a list of
+    (microseconds, serialized query) pairs, in the order they arrived."""
+    connections = {}
+    with open(path, "rb") as f:
+        if f.read(len(CAPTURE_MAGIC)) != CAPTURE_MAGIC:
+            raise RuntimeError("%s isn't a query capture file" % path)
+        while True:
+            header = f.read(RECORD_HEADER.size)
+            if len(header) < RECORD_HEADER.size:
+                # The server may have been killed part way through a record.
+                break
+            time_us, connection_id, size = RECORD_HEADER.unpack(header)
+            query = f.read(size)
+            if len(query) < size:
+                break
+            connections.setdefault(connection_id, []).append((time_us, query))
+    for queries in connections.itervalues():
+        queries.sort(key=lambda q: q[0])
+    return connections
+
+def expects_response(serialized):
+    query = p.Query()
+    query.ParseFromString(serialized)
+    for pair in query.global_optargs:
+        if pair.key == "noreply":
+            datum = pair.val.datum
+            return not (datum.type == p.Datum.R_BOOL and datum.r_bool)
+    return True
+
+class Connection(object):
+    def __init__(self, host, port, auth_key):
+        self.sock = socket.create_connection((host, port))
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.sock.sendall(struct.pack("<L", p.VersionDummy.V0_2))
+        self.sock.sendall(struct.pack("<L", len(auth_key)) + auth_key)
+        response = ""
+        while not response.endswith("\0"):
+            chunk = self.sock.recv(1)
+            if chunk == "":
+                raise RuntimeError("Server closed the connection during the handshake")
+            response += chunk
+        if response != "SUCCESS\0":
+            raise RuntimeError("Server refused the connection: %s" % response.rstrip("\0"))
+
+    def send(self, serialized):
+        self.sock.sendall(struct.pack("<L", len(serialized)) + serialized)
+
+    def recv_exactly(self, n):
+        data = ""
+        while len(data) < n:
+            chunk = self.sock.recv(n - len(data))
+            if chunk == "":
+                raise RuntimeError("Server closed the connection")
+            data += chunk
+        return data
+
+    def recv(self):
+        size = struct.unpack("<L", self.recv_exactly(4))[0]
+        response = p.Response()
+        response.ParseFromString(self.recv_exactly(size))
+        return response
+
+class Replayer(object):
+    """Replays one captured connection's queries on a connection of its own."""
+
+    def __init__(self, opts, queries, start_time, first_query_us):
+        self.opts = opts
+        self.queries = queries
+        self.start_time = start_time
+        self.first_query_us = first_query_us
+        self.lock = threading.Lock()
+        self.sent = { }
+        self.outstanding = 0
+        self.done_sending = False
+        self.all_received = threading.Event()
+        self.latencies = [ ]
+        self.errors = 0
+
+    def run(self):
+        conn = Connection(self.opts.host, self.opts.port, self.opts.auth_key)
+        reader = threading.Thread(target=self.receive, args=(conn,))
+        reader.daemon = True
+        reader.start()
+
+        for time_us, serialized in self.queries:
+            if self.opts.speed > 0:
+                due = self.start_time + (time_us - self.first_query_us) / 1e6 / self.opts.speed
+                delay = due - time.time()
+                if delay > 0:
+                    time.sleep(delay)
+            query = p.Query()
+            query.ParseFromString(serialized)
+            with self.lock:
+                if expects_response(serialized):
+                    self.sent[query.token] = time.time()
+                    self.outstanding += 1
+            conn.send(serialized)
+
+        with self.lock:
+            self.done_sending = True
+            if self.outstanding == 0:
+                self.all_received.set()
+        self.all_received.wait()
+        conn.sock.close()
+
+    def receive(self, conn):
+        while True:
+            try:
+                response = conn.recv()
+            except (RuntimeError, socket.error):
+                self.all_received.set()
+                return
+            now = time.time()
+            with self.lock:
+                sent = self.sent.pop(response.token, None)
+                if sent is not None:
+                    self.latencies.append(now - sent)
+                    self.outstanding -= 1
+                if response.type in (p.Response.CLIENT_ERROR, p.Response.COMPILE_ERROR, p.Response.RUNTIME_ERROR):
+                    self.errors += 1
+                if self.done_sending and self.outstanding == 0:
+                    self.all_received.set()
+                    return
+
+def percentile(sorted_values, fraction):
+    if not sorted_values:
+        return 0
+    return sorted_values[min(len(sorted_values) - 1, int(fraction * len(sorted_values)))]
+
+def main():
+    parser = OptionParser(usage="%prog [options] CAPTURE_FILE")
+    parser.add_option("--host", default="localhost")
+    parser.add_option("--port", type="int", default=28015)
+    parser.add_option("--auth-key", default="")
+    parser.add_option("--speed", type="float", default=1.0,
+                      help="replay this many times faster than the queries were captured; 0 sends them as fast as the server takes them")
+    parser.add_option("--max-connections", type="int", default=0,
+                      help="only replay this many of the captured connections")
+    parser.add_option("--output", help="also write the results to this file as JSON")
+    (opts, args) = parser.parse_args()
+    if len(args) != 1:
+        parser.error("expected the capture file")
+
+    connections = read_capture(args[0])
+    ids = sorted(connections.keys())
+    if opts.max_connections > 0:
+        ids = ids[:opts.max_connections]
+    if not ids:
+        print "No queries in %s" % args[0]
+        return
+    first_query_us = min(connections[i][0][0] for i in ids)
+    total_queries = sum(len(connections[i]) for i in ids)
+    print "Replaying %d queries on %d connections..." % (total_queries, len(ids))
+
+    start_time = time.time() + 1
+    replayers = [Replayer(opts, connections[i], start_time, first_query_us) for i in ids]
+    threads = [threading.Thread(target=r.run) for r in replayers]
+    for t in threads:
+        t.daemon = True
+        t.start()
+    for t in threads:
+        while t.is_alive():
+            t.join(1)
+    duration = time.time() - start_time
+
+    latencies = sorted(l for r in replayers for l in r.latencies)
+    results = {
+        "queries": total_queries,
+        "connections": len(ids),
+        "errors": sum(r.errors for r in replayers),
+        "duration_secs": duration,
+        "queries_per_sec": total_queries / duration if duration > 0 else 0,
+        "latency_secs": {
+            "p50": percentile(latencies, 0.5),
+            "p90": percentile(latencies, 0.9),
+            "p99": percentile(latencies, 0.99),
+            "p99.9": percentile(latencies, 0.999),
+            "max": latencies[-1] if latencies else 0
+        }
+    }
+    print json.dumps(results, indent=4, sort_keys=True)
+    if opts.output:
+        with open(opts.output, "w") as f:
+            json.dump(results, f, indent=4, sort_keys=True)
+
+if __name__ == "__main__":
+    main()
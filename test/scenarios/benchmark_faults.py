@@ -0,0 +1,210 @@
+#!/usr/bin/env python
+# Copyright 2010-2014 RethinkDB, all rights reserved.
+
+# Runs the stress client against a cluster, does something disruptive to the cluster
+# part way through (kills a replica, adds one, or splits a shard), and reports how
+# far throughput dropped, how long it took to come back, how fast the backfill went
+# and what the 99th percentile latency was until it did.
+#
+# The stress client always talks to the first node, which the faults never touch,
+# so what it sees is the cost of the fault to the rest of the cluster.
+
+import sys, os, time, json, threading, subprocess, signal
+sys.path.append(os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, 'common')))
+import http_admin, driver, scenario_common
+from vcoptparse import *
+
+op = OptParser()
+scenario_common.prepare_option_parser_mode_flags(op)
+op["num-nodes"] = IntFlag("--num-nodes", 3)
+op["fault"] = ChoiceFlag("--fault", ["kill-replica", "add-replica", "reshard"], "kill-replica")
+op["split-point"] = StringFlag("--split-point", "m")
+op["warmup"] = IntFlag("--warmup", 30)
+op["before"] = IntFlag("--before", 30)
+op["after"] = IntFlag("--after", 120)
+op["stress"] = StringFlag("--stress", os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, os.path.pardir, 'bench', 'stress-client', 'stress')))
+op["stress-flags"] = StringFlag("--stress-flags", "-c 64 -w 0/1/1/8")
+op["recovery-threshold"] = FloatFlag("--recovery-threshold", 0.9)
+op["recovery-window"] = IntFlag("--recovery-window", 5)
+op["output"] = StringFlag("--output", None)
+opts = op.parse(sys.argv)
+
+if opts["num-nodes"] < 3:
+    raise ValueError("--num-nodes must be at least 3: one for the stress client, a replica, and one to add or kill")
+
+class ProgressPoller(object):
+    """Polls /ajax/progress once a second, summing the progress of every backfill in
+    the cluster."""
+
+    def __init__(self, http):
+        self.http = http
+        self.samples = []
+        self.stopping = threading.Event()
+        self.thread = threading.Thread(target = self.run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def run(self):
+        while not self.stopping.is_set():
+            done, total = 0, 0
+            try:
+                progress = self.http.get_progress()
+            except Exception:
+                progress = {}
+            for namespaces in progress.itervalues():
+                for activities in namespaces.itervalues():
+                    for regions in activities.itervalues():
+                        for pairs in regions.itervalues():
+                            for pair in pairs:
+                                if isinstance(pair, list):
+                                    done += pair[0]
+                                    total += pair[1]
+            self.samples.append((time.time(), done, total))
+            self.stopping.wait(1)
+
+    def stop(self):
+        self.stopping.set()
+        self.thread.join()
+
+    def backfill_rate(self, start, end):
+        """Returns how many units of backfill progress per second were made between
+        `start` and `end`, and for how many seconds backfills were running."""
+        running = [s for s in self.samples if start <= s[0] <= end and s[2] > 0]
+        if len(running) < 2:
+            return 0, 0
+        seconds = running[-1][0] - running[0][0]
+        progress = max(0, running[-1][1] - running[0][1])
+        return (progress / seconds if seconds > 0 else 0), seconds
+
+def read_timeline(path):
+    """Returns (second, queries, p50, p90, p99, p99.9, max) for each second of the
+    stress client's run, with latencies in microseconds."""
+    timeline = []
+    with open(path) as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) == 7:
+                timeline.append(tuple(int(x) for x in fields))
+    return timeline
+
+def analyze(timeline, baseline_start, fault_start):
+    baseline = [t for t in timeline if baseline_start <= t[0] < fault_start]
+    after = [t for t in timeline if t[0] >= fault_start]
+    if not baseline or not after:
+        raise RuntimeError("The stress client didn't run long enough to measure anything")
+    baseline_qps = sum(t[1] for t in baseline) / float(len(baseline))
+    baseline_p99 = sorted(t[4] for t in baseline)[len(baseline) / 2]
+
+    threshold = opts["recovery-threshold"] * baseline_qps
+    window = opts["recovery-window"]
+    recovered_at = None
+    for i in xrange(len(after) - window + 1):
+        if all(t[1] >= threshold for t in after[i:i + window]):
+            recovered_at = after[i][0]
+            break
+    transition = [t for t in after if recovered_at is None or t[0] < recovered_at]
+    if not transition:
+        transition = after[:1]
+
+    return {
+        "baseline_qps": baseline_qps,
+        "baseline_p99_us": baseline_p99,
+        "min_qps_after_fault": min(t[1] for t in after),
+        "time_to_recover_secs": None if recovered_at is None else recovered_at - fault_start,
+        "p99_during_transition_us": max(t[4] for t in transition),
+        "max_latency_during_transition_us": max(t[6] for t in transition)
+    }
+
+with driver.Metacluster() as metacluster:
+    cluster = driver.Cluster(metacluster)
+    executable_path, command_prefix, serve_options = scenario_common.parse_mode_flags(opts)
+    print "Starting cluster..."
+    processes = [driver.Process(cluster,
+                                driver.Files(metacluster, db_path = "db-%d" % i, log_path = "create-output-%d" % i,
+                                             executable_path = executable_path, command_prefix = command_prefix),
+                                log_path = "serve-output-%d" % i,
+                                executable_path = executable_path, command_prefix = command_prefix, extra_options = serve_options)
+                 for i in xrange(opts["num-nodes"])]
+    for process in processes:
+        process.wait_until_started_up()
+
+    print "Creating namespace..."
+    # Only the first node is never disrupted, so that's the one we talk to.
+    http = http_admin.ClusterAccess([("localhost", processes[0].http_port)])
+    primary_dc = http.add_datacenter()
+    secondary_dc = http.add_datacenter()
+    http.move_server_to_datacenter(processes[0].files.machine_name, primary_dc)
+    for process in processes[1:]:
+        http.move_server_to_datacenter(process.files.machine_name, secondary_dc)
+    replicas = opts["num-nodes"] - 1
+    if opts["fault"] == "add-replica":
+        # Leave a node free for the new replica to go on.
+        replicas -= 1
+    ns = scenario_common.prepare_table_for_workload(opts, http, primary = primary_dc,
+        affinities = {primary_dc: 0, secondary_dc: replicas})
+    http.wait_until_blueprint_satisfied(ns)
+    cluster.check()
+    http.check_no_issues()
+
+    if opts["protocol"] == "memcached":
+        server = "sockmemcached,localhost:%d" % (ns.port + processes[0].port_offset)
+    else:
+        server = "rethinkdb,localhost:%d+test+%s" % (28015 + processes[0].port_offset, ns.name)
+    duration = opts["warmup"] + opts["before"] + opts["after"]
+    timeline_path = os.path.abspath("latency_timeline.txt")
+    command_line = [opts["stress"], "-s", server, "-d", "%ds" % duration,
+                    "-T", timeline_path, "--ignore-protocol-errors"] + opts["stress-flags"].split()
+    print "Running %r..." % command_line
+    stress = subprocess.Popen(command_line, stdout = open("stress-output", "w"), stderr = subprocess.STDOUT)
+    stress_start = time.time()
+    poller = ProgressPoller(http_admin.ClusterAccess([("localhost", processes[0].http_port)]))
+
+    try:
+        time.sleep(opts["warmup"] + opts["before"])
+        if stress.poll() is not None:
+            raise RuntimeError("The stress client exited early; see stress-output")
+
+        fault_start = int(round(time.time() - stress_start))
+        if opts["fault"] == "kill-replica":
+            print "Killing a replica..."
+            victim = processes[-1]
+            victim.close()
+            # Wait for the rest of the cluster to notice before giving up on it.
+            time.sleep(10)
+            http.declare_machine_dead(victim.files.machine_name)
+            http.set_namespace_affinities(ns, {secondary_dc: replicas - 1})
+        elif opts["fault"] == "add-replica":
+            print "Adding a replica..."
+            http.set_namespace_affinities(ns, {secondary_dc: replicas + 1})
+        else:
+            print "Splitting at %r..." % opts["split-point"]
+            http.add_namespace_shard(ns, opts["split-point"])
+        http.wait_until_blueprint_satisfied(ns, timeout = opts["after"])
+        settled = time.time() - stress_start
+        print "Blueprint satisfied %d seconds after the fault." % (settled - fault_start)
+
+        while stress.poll() is None:
+            time.sleep(1)
+        if stress.returncode != 0:
+            raise RuntimeError("The stress client failed with exit code %d; see stress-output" % stress.returncode)
+    finally:
+        poller.stop()
+        if stress.poll() is None:
+            stress.send_signal(signal.SIGINT)
+            stress.wait()
+
+    results = analyze(read_timeline(timeline_path), opts["warmup"], fault_start)
+    results["fault"] = opts["fault"]
+    results["blueprint_satisfied_after_secs"] = settled - fault_start
+    rate, seconds = poller.backfill_rate(stress_start + fault_start, time.time())
+    results["backfill_progress_per_sec"] = rate
+    results["backfill_secs"] = seconds
+
+    print json.dumps(results, indent = 4, sort_keys = True)
+    if opts["output"] is not None:
+        with open(opts["output"], "w") as f:
+            json.dump(results, f, indent = 4, sort_keys = True)
+
+    cluster.check()
+    http.check_no_issues()
+    cluster.check_and_stop()